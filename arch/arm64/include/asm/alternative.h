@@ -266,6 +266,33 @@ alternative_endif
 
 		_asm_extable	8888b,\l;
 	.endm
+
+	/* no unprivileged LDNP/STNP, UAO falls back to plain LDTR/STTR */
+	.macro uao_ldnp l, reg1, reg2, addr, off
+		alternative_if_not ARM64_HAS_UAO
+8888:			ldnp	\reg1, \reg2, [\addr, #\off];
+8889:			nop;
+		alternative_else
+			ldtr	\reg1, [\addr, #\off];
+			ldtr	\reg2, [\addr, #(\off + 8)];
+		alternative_endif
+
+		_asm_extable	8888b,\l;
+		_asm_extable	8889b,\l;
+	.endm
+
+	.macro uao_stnp l, reg1, reg2, addr, off
+		alternative_if_not ARM64_HAS_UAO
+8888:			stnp	\reg1, \reg2, [\addr, #\off];
+8889:			nop;
+		alternative_else
+			sttr	\reg1, [\addr, #\off];
+			sttr	\reg2, [\addr, #(\off + 8)];
+		alternative_endif
+
+		_asm_extable	8888b,\l;
+		_asm_extable	8889b,\l;
+	.endm
 #else
 	.macro uao_ldp l, reg1, reg2, addr, post_inc
 		USER(\l, ldp \reg1, \reg2, [\addr], \post_inc)
@@ -276,6 +303,12 @@ alternative_endif
 	.macro uao_user_alternative l, inst, alt_inst, reg, addr, post_inc
 		USER(\l, \inst \reg, [\addr], \post_inc)
 	.endm
+	.macro uao_ldnp l, reg1, reg2, addr, off
+		USER(\l, ldnp \reg1, \reg2, [\addr, #\off])
+	.endm
+	.macro uao_stnp l, reg1, reg2, addr, off
+		USER(\l, stnp \reg1, \reg2, [\addr, #\off])
+	.endm
 #endif
 
 #endif  /*  __ASSEMBLY__  */
@@ -25,6 +25,7 @@
 #include <linux/types.h>
 #include <linux/mm.h>
 #include <linux/cpu.h>
+#include <linux/sizes.h>
 #include <asm/cpu.h>
 #include <asm/cpufeature.h>
 #include <asm/cpu_ops.h>
@@ -799,6 +800,32 @@ static bool has_no_hw_prefetch(const struct arm64_cpu_capabilities *entry, int _
 		MIDR_CPU_VAR_REV(1, MIDR_REVISION_MASK));
 }
 
+unsigned long arm64_nt_copy_threshold __read_mostly = SZ_64K;
+EXPORT_SYMBOL_GPL(arm64_nt_copy_threshold);
+
+static int __init parse_nt_copy_threshold(char *str)
+{
+	arm64_nt_copy_threshold = memparse(str, NULL);
+	return 0;
+}
+early_param("nt_copy_threshold", parse_nt_copy_threshold);
+
+static bool has_nt_large_copy(const struct arm64_cpu_capabilities *entry,
+			      int __unused)
+{
+	static const struct midr_range kryo2xx[] = {
+		MIDR_ALL_VERSIONS(MIDR_KRYO2XX_GOLD),
+		MIDR_ALL_VERSIONS(MIDR_KRYO2XX_SILVER),
+		{},
+	};
+
+	/*
+	 * The L2 of Kryo 260 is small enough that a large copy evicts the
+	 * working set of everything else running on the cluster.
+	 */
+	return is_midr_in_range_list(read_cpuid_id(), kryo2xx);
+}
+
 static bool hyp_offset_low(const struct arm64_cpu_capabilities *entry,
 			   int __unused)
 {
@@ -1111,6 +1138,12 @@ static const struct arm64_cpu_capabilities arm64_features[] = {
 		.type = ARM64_CPUCAP_WEAK_LOCAL_CPU_FEATURE,
 		.matches = has_no_hw_prefetch,
 	},
+	{
+		.desc = "Non-temporal large copies",
+		.capability = ARM64_HAS_NT_LARGE_COPY,
+		.type = ARM64_CPUCAP_WEAK_LOCAL_CPU_FEATURE,
+		.matches = has_nt_large_copy,
+	},
 #ifdef CONFIG_ARM64_UAO
 	{
 		.desc = "User Access Override",
@@ -91,6 +91,9 @@
 #include "bfq-mq.h"
 #include "blk-wbt.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/bfq.h>
+
 /* Expiration time of sync (0) and async (1) requests, in ns. */
 static const u64 bfq_fifo_expire[2] = { NSEC_PER_SEC / 4, NSEC_PER_SEC / 8 };
 
@@ -896,6 +899,49 @@ static unsigned int bfq_wr_duration(struct bfq_data *bfqd)
 	return dur;
 }
 
+static const char *bfq_dev_name(struct bfq_data *bfqd)
+{
+	struct device *dev = bfqd->queue->backing_dev_info->dev;
+
+	return dev ? dev_name(dev) : "unknown";
+}
+
+/*
+ * Android launches fork from zygote and issue their I/O from several
+ * threads of a process that is new to the device, which the generic
+ * heuristics below take for a large burst. In launch mode the queues of
+ * a process are interactive while it is inside its launch window
+ * instead, and weight raising ends with the window.
+ */
+static bool bfq_bfqq_in_launch(struct bfq_data *bfqd, struct bfq_queue *bfqq)
+{
+	return bfqd->bfq_launch_wr_time && bfqq->launch_wr_end &&
+		time_is_after_jiffies(bfqq->launch_wr_end);
+}
+
+static unsigned int bfq_interactive_wr_duration(struct bfq_data *bfqd,
+						struct bfq_queue *bfqq)
+{
+	if (bfq_bfqq_in_launch(bfqd, bfqq))
+		return bfqq->launch_wr_end - jiffies;
+
+	return bfq_wr_duration(bfqd);
+}
+
+/* Called in the context of the task allocating a request on bfqq */
+static void bfq_update_launch_wr_end(struct bfq_data *bfqd,
+				     struct bfq_queue *bfqq)
+{
+	unsigned long start;
+
+	if (!bfqd->bfq_launch_wr_time || !bfq_bfqq_sync(bfqq))
+		return;
+
+	start = schedtune_task_launch_time(current);
+	if (start && time_is_after_jiffies(start + bfqd->bfq_launch_wr_time))
+		bfqq->launch_wr_end = start + bfqd->bfq_launch_wr_time;
+}
+
 /* switch back from soft real-time to interactive weight raising */
 static void switch_back_to_interactive_wr(struct bfq_queue *bfqq,
 					  struct bfq_data *bfqd)
@@ -1437,7 +1483,8 @@ static void bfq_update_bfqq_wr_on_rq_arrival(struct bfq_data *bfqd,
 		if (interactive) {
 			bfqq->service_from_wr = 0;
 			bfqq->wr_coeff = bfqd->bfq_wr_coeff;
-			bfqq->wr_cur_max_time = bfq_wr_duration(bfqd);
+			bfqq->wr_cur_max_time =
+				bfq_interactive_wr_duration(bfqd, bfqq);
 		} else {
 			/*
 			 * No interactive weight raising in progress
@@ -1477,7 +1524,8 @@ static void bfq_update_bfqq_wr_on_rq_arrival(struct bfq_data *bfqd,
 	} else if (old_wr_coeff > 1) {
 		if (interactive) { /* update wr coeff and duration */
 			bfqq->wr_coeff = bfqd->bfq_wr_coeff;
-			bfqq->wr_cur_max_time = bfq_wr_duration(bfqd);
+			bfqq->wr_cur_max_time =
+				bfq_interactive_wr_duration(bfqd, bfqq);
 		} else if (in_burst) {
 			bfqq->wr_coeff = 1;
 			bfq_log_bfqq(bfqd, bfqq,
@@ -1550,7 +1598,7 @@ static void bfq_bfqq_handle_idle_busy_switch(struct bfq_data *bfqd,
 					     struct request *rq,
 					     bool *interactive)
 {
-	bool soft_rt, in_burst,	wr_or_deserves_wr,
+	bool soft_rt, in_burst,	wr_or_deserves_wr, launch,
 		bfqq_wants_to_preempt,
 		idle_for_long_time = bfq_bfqq_idle_for_long_time(bfqd, bfqq),
 		/*
@@ -1586,9 +1634,13 @@ static void bfq_bfqq_handle_idle_busy_switch(struct bfq_data *bfqd,
 	soft_rt = bfqd->bfq_wr_max_softrt_rate > 0 &&
 		!in_burst &&
 		time_is_before_jiffies(bfqq->soft_rt_next_start);
-	*interactive =
-		!in_burst &&
-		idle_for_long_time;
+	launch = bfq_bfqq_in_launch(bfqd, bfqq);
+	if (bfqd->bfq_launch_wr_time)
+		*interactive = launch;
+	else
+		*interactive =
+			!in_burst &&
+			idle_for_long_time;
 	wr_or_deserves_wr = bfqd->low_latency &&
 		(bfqq->wr_coeff > 1 ||
 		 (bfq_bfqq_sync(bfqq) &&
@@ -1665,6 +1717,12 @@ static void bfq_bfqq_handle_idle_busy_switch(struct bfq_data *bfqd,
 
 			if (old_wr_coeff != bfqq->wr_coeff)
 				bfqq->entity.prio_changed = 1;
+			if (old_wr_coeff > 1 || bfqq->wr_coeff > 1)
+				trace_bfq_wr_raise(bfq_dev_name(bfqd),
+					bfqq->pid, old_wr_coeff,
+					bfqq->wr_coeff,
+					jiffies_to_msecs(bfqq->wr_cur_max_time),
+					launch, *interactive, soft_rt);
 		}
 	}
 
@@ -1745,6 +1803,7 @@ static void bfq_add_request(struct request *rq)
 						 rq, &interactive);
 	else {
 		if (bfqd->low_latency && old_wr_coeff == 1 && !rq_is_sync(rq) &&
+		    !bfqd->bfq_launch_wr_time &&
 		    time_is_before_jiffies(
 				bfqq->last_wr_start_finish +
 				bfqd->bfq_wr_min_inter_arr_async)) {
@@ -2074,6 +2133,11 @@ static void bfq_bfqq_end_wr(struct bfq_queue *bfqq)
 {
 	BUG_ON(!bfqq);
 
+	if (bfqq->wr_coeff > 1)
+		trace_bfq_wr_end(bfq_dev_name(bfqq->bfqd), bfqq->pid,
+				 bfqq->wr_coeff, jiffies_to_msecs(jiffies -
+						bfqq->last_wr_start_finish));
+
 	if (bfq_bfqq_busy(bfqq)) {
 		bfqq->bfqd->wr_busy_queues--;
 		BUG_ON(bfqq->bfqd->wr_busy_queues < 0);
@@ -5452,6 +5516,8 @@ static void bfq_prepare_request(struct request *rq, struct bio *bio)
 	bfq_log_bfqq(bfqq->bfqd, bfqq,
 		     "new allocated %d", bfqq->allocated);
 
+	bfq_update_launch_wr_end(bfqd, bfqq);
+
 	bfqq->ref++;
 	bfq_log_bfqq(bfqd, bfqq, "%p: bfqq %p, %d", rq, bfqq, bfqq->ref);
 
@@ -5726,6 +5792,7 @@ static int bfq_init_queue(struct request_queue *q, struct elevator_type *e)
 					      * high-definition compressed
 					      * video.
 					      */
+	bfqd->bfq_launch_wr_time = 0;
 	bfqd->wr_busy_queues = 0;
 
 	/*
@@ -5878,6 +5945,7 @@ SHOW_FUNCTION(bfq_wr_min_idle_time_show, bfqd->bfq_wr_min_idle_time, 1);
 SHOW_FUNCTION(bfq_wr_min_inter_arr_async_show, bfqd->bfq_wr_min_inter_arr_async,
 	1);
 SHOW_FUNCTION(bfq_wr_max_softrt_rate_show, bfqd->bfq_wr_max_softrt_rate, 0);
+SHOW_FUNCTION(bfq_launch_wr_time_show, bfqd->bfq_launch_wr_time, 1);
 #undef SHOW_FUNCTION
 
 #define USEC_SHOW_FUNCTION(__FUNC, __VAR)				\
@@ -5928,6 +5996,8 @@ STORE_FUNCTION(bfq_wr_min_inter_arr_async_store,
 		&bfqd->bfq_wr_min_inter_arr_async, 0, INT_MAX, 1);
 STORE_FUNCTION(bfq_wr_max_softrt_rate_store, &bfqd->bfq_wr_max_softrt_rate, 0,
 		INT_MAX, 0);
+STORE_FUNCTION(bfq_launch_wr_time_store, &bfqd->bfq_launch_wr_time, 0,
+		INT_MAX, 1);
 #undef STORE_FUNCTION
 
 #define USEC_STORE_FUNCTION(__FUNC, __PTR, MIN, MAX)			\
@@ -6051,6 +6121,7 @@ static struct elv_fs_entry bfq_attrs[] = {
 	BFQ_ATTR(wr_min_idle_time),
 	BFQ_ATTR(wr_min_inter_arr_async),
 	BFQ_ATTR(wr_max_softrt_rate),
+	BFQ_ATTR(launch_wr_time),
 	BFQ_ATTR(weights),
 	__ATTR_NULL
 };
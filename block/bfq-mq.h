@@ -343,6 +343,12 @@ struct bfq_queue {
 
 	unsigned long split_time; /* time of last split */
 	unsigned long first_IO_time; /* time of first I/O for this queue */
+
+	/*
+	 * End of the launch window of the process owning the queue, see
+	 * bfq_launch_wr_time.
+	 */
+	unsigned long launch_wr_end;
 };
 
 /**
@@ -603,6 +609,12 @@ struct bfq_data {
 
 	/* Max service-rate for a soft real-time queue, in sectors/sec */
 	unsigned int bfq_wr_max_softrt_rate;
+	/*
+	 * If not zero, the queues of a process are deemed interactive,
+	 * and only them, for this long after the process has moved into
+	 * an app_launch schedtune group (jiffies).
+	 */
+	unsigned int bfq_launch_wr_time;
 	/*
 	 * Cached value of the product R*T, used for computing the
 	 * maximum duration of weight raising automatically.
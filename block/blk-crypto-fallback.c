@@ -17,6 +17,7 @@
 #include <linux/mempool.h>
 #include <linux/module.h>
 #include <linux/random.h>
+#include <linux/sizes.h>
 
 #include "blk-crypto-internal.h"
 
@@ -30,6 +31,11 @@ module_param_named(num_keyslots, blk_crypto_num_keyslots, uint, 0);
 MODULE_PARM_DESC(num_keyslots,
 		 "Number of keyslots for the blk-crypto crypto API fallback");
 
+static unsigned int parallel_chunk_kb = 64;
+module_param(parallel_chunk_kb, uint, 0644);
+MODULE_PARM_DESC(parallel_chunk_kb,
+		 "Split the en/decryption of larger bios across cpus in chunks of at least this many KiB, 0 to disable");
+
 static unsigned int num_prealloc_fallback_crypt_ctxs = 128;
 module_param(num_prealloc_fallback_crypt_ctxs, uint, 0);
 MODULE_PARM_DESC(num_prealloc_crypt_fallback_ctxs,
@@ -63,6 +69,9 @@ static mempool_t *bio_fallback_crypt_ctx_pool;
 static DEFINE_MUTEX(tfms_init_lock);
 static bool tfms_inited[BLK_ENCRYPTION_MODE_MAX];
 
+/* Limit on the chunks one bio is split into for parallel en/decryption */
+#define BLK_CRYPTO_MAX_CHUNKS	8U
+
 struct blk_crypto_decrypt_work {
 	struct work_struct work;
 	struct bio *bio;
@@ -77,6 +86,7 @@ static struct blk_crypto_keyslot {
 /* The following few vars are only used during the crypto API fallback */
 static struct keyslot_manager *blk_crypto_ksm;
 static struct workqueue_struct *blk_crypto_wq;
+static struct workqueue_struct *blk_crypto_chunk_wq;
 static mempool_t *blk_crypto_bounce_page_pool;
 static struct kmem_cache *blk_crypto_decrypt_work_cache;
 
@@ -197,27 +207,24 @@ static struct bio *blk_crypto_clone_bio(struct bio *bio_src)
 	return bio;
 }
 
-static int blk_crypto_alloc_cipher_req(struct bio *src_bio,
-				       struct skcipher_request **ciph_req_ret,
-				       struct crypto_wait *wait)
+static struct skcipher_request *
+blk_crypto_alloc_cipher_req(const struct bio_crypt_ctx *bc,
+			    struct crypto_wait *wait)
 {
 	struct skcipher_request *ciph_req;
 	const struct blk_crypto_keyslot *slotp;
 
-	slotp = &blk_crypto_keyslots[src_bio->bi_crypt_context->bc_keyslot];
+	slotp = &blk_crypto_keyslots[bc->bc_keyslot];
 	ciph_req = skcipher_request_alloc(slotp->tfms[slotp->crypto_mode],
 					  GFP_NOIO);
-	if (!ciph_req) {
-		src_bio->bi_status = BLK_STS_RESOURCE;
-		return -ENOMEM;
-	}
+	if (!ciph_req)
+		return NULL;
 
 	skcipher_request_set_callback(ciph_req,
 				      CRYPTO_TFM_REQ_MAY_BACKLOG |
 				      CRYPTO_TFM_REQ_MAY_SLEEP,
 				      crypto_req_done, wait);
-	*ciph_req_ret = ciph_req;
-	return 0;
+	return ciph_req;
 }
 
 static int blk_crypto_split_bio_if_needed(struct bio **bio_ptr)
@@ -262,6 +269,187 @@ static void blk_crypto_dun_to_iv(const u64 dun[BLK_CRYPTO_DUN_ARRAY_SIZE],
 		iv->dun[i] = cpu_to_le64(dun[i]);
 }
 
+/*
+ * A range of whole segments of a bio, en/decrypted by one cpu.  For
+ * encryption the bio is the bounce bio, and the plaintext pages in its bvecs
+ * are replaced by bounce pages as the chunk goes.
+ */
+struct blk_crypto_chunk {
+	struct work_struct work;
+	struct bio *bio;
+	const struct bio_crypt_ctx *bc;
+	struct bvec_iter iter;
+	u64 dun[BLK_CRYPTO_DUN_ARRAY_SIZE];
+	bool encrypt;
+	/* Bounce pages put in the bvecs from iter.bi_idx on */
+	unsigned int nr_bounce;
+	blk_status_t status;
+	atomic_t *remaining;
+	struct completion *done;
+};
+
+static void blk_crypto_crypt_chunk(struct blk_crypto_chunk *chunk)
+{
+	struct bio *bio = chunk->bio;
+	const unsigned int data_unit_size = chunk->bc->bc_key->data_unit_size;
+	struct skcipher_request *ciph_req;
+	DECLARE_CRYPTO_WAIT(wait);
+	union blk_crypto_iv iv;
+	struct scatterlist src, dst;
+	struct bio_vec bv;
+	struct bvec_iter iter;
+	unsigned int i;
+	int err;
+
+	ciph_req = blk_crypto_alloc_cipher_req(chunk->bc, &wait);
+	if (!ciph_req) {
+		chunk->status = BLK_STS_RESOURCE;
+		return;
+	}
+
+	sg_init_table(&src, 1);
+	sg_init_table(&dst, 1);
+	/* Decryption is done in place */
+	skcipher_request_set_crypt(ciph_req, &src, chunk->encrypt ? &dst : &src,
+				   data_unit_size, iv.bytes);
+
+	__bio_for_each_segment(bv, bio, iter, chunk->iter) {
+		if (chunk->encrypt) {
+			struct page *ciphertext_page =
+				mempool_alloc(blk_crypto_bounce_page_pool,
+					      GFP_NOIO);
+
+			if (!ciphertext_page) {
+				chunk->status = BLK_STS_RESOURCE;
+				goto out;
+			}
+			bio->bi_io_vec[iter.bi_idx].bv_page = ciphertext_page;
+			chunk->nr_bounce++;
+			sg_set_page(&dst, ciphertext_page, data_unit_size,
+				    bv.bv_offset);
+		}
+		sg_set_page(&src, bv.bv_page, data_unit_size, bv.bv_offset);
+
+		/* En/decrypt each data unit in this segment */
+		for (i = 0; i < bv.bv_len; i += data_unit_size) {
+			blk_crypto_dun_to_iv(chunk->dun, &iv);
+			if (chunk->encrypt)
+				err = crypto_skcipher_encrypt(ciph_req);
+			else
+				err = crypto_skcipher_decrypt(ciph_req);
+			if (crypto_wait_req(err, &wait)) {
+				chunk->status = chunk->encrypt ?
+					BLK_STS_RESOURCE : BLK_STS_IOERR;
+				goto out;
+			}
+			bio_crypt_dun_increment(chunk->dun, 1);
+			src.offset += data_unit_size;
+			dst.offset += data_unit_size;
+		}
+	}
+out:
+	skcipher_request_free(ciph_req);
+}
+
+static void blk_crypto_chunk_work(struct work_struct *work)
+{
+	struct blk_crypto_chunk *chunk =
+		container_of(work, struct blk_crypto_chunk, work);
+
+	blk_crypto_crypt_chunk(chunk);
+	if (atomic_dec_and_test(chunk->remaining))
+		complete(chunk->done);
+}
+
+/*
+ * En/decrypt the data units of @bio in @bi_iter starting at @dun, with the
+ * keyslot of @bc already held.  Bios larger than parallel_chunk_kb are split
+ * at segment boundaries into up to one chunk per online cpu.  The caller does
+ * the first chunk and blk_crypto_chunk_wq the others, which never wait for
+ * anything, so the caller can wait for them even from blk_crypto_wq.
+ *
+ * On failure of an encryption the bounce pages are freed again.
+ */
+static blk_status_t blk_crypto_crypt_bio(struct bio *bio,
+					 const struct bio_crypt_ctx *bc,
+					 struct bvec_iter bi_iter,
+					 const u64 *dun, bool encrypt)
+{
+	struct blk_crypto_chunk chunks[BLK_CRYPTO_MAX_CHUNKS];
+	unsigned int chunk_bytes = READ_ONCE(parallel_chunk_kb) * SZ_1K;
+	unsigned int dus_bits = bc->bc_key->data_unit_size_bits;
+	unsigned int nr = 1, n = 0, bytes = 0, target, i;
+	DECLARE_COMPLETION_ONSTACK(done);
+	blk_status_t status = BLK_STS_OK;
+	atomic_t remaining;
+	struct bio_vec bv;
+	struct bvec_iter iter;
+
+	if (chunk_bytes && bi_iter.bi_size > chunk_bytes)
+		nr = min3(DIV_ROUND_UP(bi_iter.bi_size, chunk_bytes),
+			  num_online_cpus(), BLK_CRYPTO_MAX_CHUNKS);
+	target = DIV_ROUND_UP(bi_iter.bi_size, nr);
+
+	chunks[0].iter = bi_iter;
+	memcpy(chunks[0].dun, dun, sizeof(chunks[0].dun));
+	if (nr > 1) {
+		__bio_for_each_segment(bv, bio, iter, bi_iter) {
+			if (bytes >= target && n + 1 < nr) {
+				chunks[n].iter.bi_size = bytes;
+				chunks[n + 1].iter = iter;
+				memcpy(chunks[n + 1].dun, chunks[n].dun,
+				       sizeof(chunks[n].dun));
+				bio_crypt_dun_increment(chunks[n + 1].dun,
+							bytes >> dus_bits);
+				n++;
+				bytes = 0;
+			}
+			bytes += bv.bv_len;
+		}
+		chunks[n].iter.bi_size = bytes;
+		nr = n + 1;
+	}
+
+	atomic_set(&remaining, nr - 1);
+	for (i = 0; i < nr; i++) {
+		chunks[i].bio = bio;
+		chunks[i].bc = bc;
+		chunks[i].encrypt = encrypt;
+		chunks[i].nr_bounce = 0;
+		chunks[i].status = BLK_STS_OK;
+		chunks[i].remaining = &remaining;
+		chunks[i].done = &done;
+		if (i) {
+			INIT_WORK_ONSTACK(&chunks[i].work,
+					  blk_crypto_chunk_work);
+			queue_work(blk_crypto_chunk_wq, &chunks[i].work);
+		}
+	}
+
+	blk_crypto_crypt_chunk(&chunks[0]);
+	if (nr > 1)
+		wait_for_completion(&done);
+
+	for (i = 0; i < nr; i++) {
+		if (i)
+			destroy_work_on_stack(&chunks[i].work);
+		if (!status)
+			status = chunks[i].status;
+	}
+
+	if (status && encrypt) {
+		for (i = 0; i < nr; i++) {
+			unsigned int idx = chunks[i].iter.bi_idx;
+
+			while (chunks[i].nr_bounce--)
+				mempool_free(bio->bi_io_vec[idx++].bv_page,
+					     blk_crypto_bounce_page_pool);
+		}
+	}
+
+	return status;
+}
+
 /*
  * The crypto API fallback's encryption routine.
  * Allocate a bounce bio for encryption, encrypt the input bio using crypto API,
@@ -271,15 +459,9 @@ static void blk_crypto_dun_to_iv(const u64 dun[BLK_CRYPTO_DUN_ARRAY_SIZE],
 static int blk_crypto_encrypt_bio(struct bio **bio_ptr)
 {
 	struct bio *src_bio;
-	struct skcipher_request *ciph_req = NULL;
-	DECLARE_CRYPTO_WAIT(wait);
-	u64 curr_dun[BLK_CRYPTO_DUN_ARRAY_SIZE];
-	union blk_crypto_iv iv;
-	struct scatterlist src, dst;
 	struct bio *enc_bio;
-	unsigned int i, j;
-	int data_unit_size;
 	struct bio_crypt_ctx *bc;
+	blk_status_t status;
 	int err = 0;
 
 	/* Split the bio if it's too big for single page bvec */
@@ -289,7 +471,6 @@ static int blk_crypto_encrypt_bio(struct bio **bio_ptr)
 
 	src_bio = *bio_ptr;
 	bc = src_bio->bi_crypt_context;
-	data_unit_size = bc->bc_key->data_unit_size;
 
 	/* Allocate bounce bio for encryption */
 	enc_bio = blk_crypto_clone_bio(src_bio);
@@ -308,52 +489,13 @@ static int blk_crypto_encrypt_bio(struct bio **bio_ptr)
 		goto out_put_enc_bio;
 	}
 
-	/* and then allocate an skcipher_request for it */
-	err = blk_crypto_alloc_cipher_req(src_bio, &ciph_req, &wait);
-	if (err)
+	/* Encrypt each page into a bounce page of the bounce bio */
+	status = blk_crypto_crypt_bio(enc_bio, bc, enc_bio->bi_iter,
+				      bc->bc_dun, true);
+	if (status) {
+		src_bio->bi_status = status;
+		err = blk_status_to_errno(status);
 		goto out_release_keyslot;
-
-	memcpy(curr_dun, bc->bc_dun, sizeof(curr_dun));
-	sg_init_table(&src, 1);
-	sg_init_table(&dst, 1);
-
-	skcipher_request_set_crypt(ciph_req, &src, &dst, data_unit_size,
-				   iv.bytes);
-
-	/* Encrypt each page in the bounce bio */
-	for (i = 0; i < enc_bio->bi_vcnt; i++) {
-		struct bio_vec *enc_bvec = &enc_bio->bi_io_vec[i];
-		struct page *plaintext_page = enc_bvec->bv_page;
-		struct page *ciphertext_page =
-			mempool_alloc(blk_crypto_bounce_page_pool, GFP_NOIO);
-
-		enc_bvec->bv_page = ciphertext_page;
-
-		if (!ciphertext_page) {
-			src_bio->bi_status = BLK_STS_RESOURCE;
-			err = -ENOMEM;
-			goto out_free_bounce_pages;
-		}
-
-		sg_set_page(&src, plaintext_page, data_unit_size,
-			    enc_bvec->bv_offset);
-		sg_set_page(&dst, ciphertext_page, data_unit_size,
-			    enc_bvec->bv_offset);
-
-		/* Encrypt each data unit in this page */
-		for (j = 0; j < enc_bvec->bv_len; j += data_unit_size) {
-			blk_crypto_dun_to_iv(curr_dun, &iv);
-			err = crypto_wait_req(crypto_skcipher_encrypt(ciph_req),
-					      &wait);
-			if (err) {
-				i++;
-				src_bio->bi_status = BLK_STS_RESOURCE;
-				goto out_free_bounce_pages;
-			}
-			bio_crypt_dun_increment(curr_dun, 1);
-			src.offset += data_unit_size;
-			dst.offset += data_unit_size;
-		}
 	}
 
 	enc_bio->bi_private = src_bio;
@@ -362,14 +504,7 @@ static int blk_crypto_encrypt_bio(struct bio **bio_ptr)
 
 	enc_bio = NULL;
 	err = 0;
-	goto out_free_ciph_req;
 
-out_free_bounce_pages:
-	while (i > 0)
-		mempool_free(enc_bio->bi_io_vec[--i].bv_page,
-			     blk_crypto_bounce_page_pool);
-out_free_ciph_req:
-	skcipher_request_free(ciph_req);
 out_release_keyslot:
 	bio_crypt_ctx_release_keyslot(bc);
 out_put_enc_bio:
@@ -397,19 +532,9 @@ static void blk_crypto_decrypt_bio(struct work_struct *work)
 	struct blk_crypto_decrypt_work *decrypt_work =
 		container_of(work, struct blk_crypto_decrypt_work, work);
 	struct bio *bio = decrypt_work->bio;
-	struct skcipher_request *ciph_req = NULL;
-	DECLARE_CRYPTO_WAIT(wait);
-	struct bio_vec bv;
-	struct bvec_iter iter;
-	u64 curr_dun[BLK_CRYPTO_DUN_ARRAY_SIZE];
-	union blk_crypto_iv iv;
-	struct scatterlist sg;
 	struct bio_crypt_ctx *bc = bio->bi_crypt_context;
 	struct bio_fallback_crypt_ctx *f_ctx =
 		container_of(bc, struct bio_fallback_crypt_ctx, crypt_ctx);
-	const int data_unit_size = bc->bc_key->data_unit_size;
-	unsigned int i;
-	int err;
 
 	/*
 	 * Use the crypto API fallback keyslot manager to get a crypto_skcipher
@@ -420,37 +545,10 @@ static void blk_crypto_decrypt_bio(struct work_struct *work)
 		goto out_no_keyslot;
 	}
 
-	/* and then allocate an skcipher_request for it */
-	err = blk_crypto_alloc_cipher_req(bio, &ciph_req, &wait);
-	if (err)
-		goto out;
-
-	memcpy(curr_dun, f_ctx->fallback_dun, sizeof(curr_dun));
-	sg_init_table(&sg, 1);
-	skcipher_request_set_crypt(ciph_req, &sg, &sg, data_unit_size,
-				   iv.bytes);
-
 	/* Decrypt each segment in the bio */
-	__bio_for_each_segment(bv, bio, iter, f_ctx->crypt_iter) {
-		struct page *page = bv.bv_page;
+	bio->bi_status = blk_crypto_crypt_bio(bio, bc, f_ctx->crypt_iter,
+					      f_ctx->fallback_dun, false);
 
-		sg_set_page(&sg, page, data_unit_size, bv.bv_offset);
-
-		/* Decrypt each data unit in the segment */
-		for (i = 0; i < bv.bv_len; i += data_unit_size) {
-			blk_crypto_dun_to_iv(curr_dun, &iv);
-			if (crypto_wait_req(crypto_skcipher_decrypt(ciph_req),
-					    &wait)) {
-				bio->bi_status = BLK_STS_IOERR;
-				goto out;
-			}
-			bio_crypt_dun_increment(curr_dun, 1);
-			sg.offset += data_unit_size;
-		}
-	}
-
-out:
-	skcipher_request_free(ciph_req);
 	bio_crypt_ctx_release_keyslot(bc);
 out_no_keyslot:
 	kmem_cache_free(blk_crypto_decrypt_work_cache, decrypt_work);
@@ -613,6 +711,12 @@ int __init blk_crypto_fallback_init(void)
 	if (!blk_crypto_wq)
 		return -ENOMEM;
 
+	blk_crypto_chunk_wq = alloc_workqueue("blk_crypto_chunk_wq",
+					      WQ_UNBOUND | WQ_HIGHPRI |
+					      WQ_MEM_RECLAIM, 0);
+	if (!blk_crypto_chunk_wq)
+		return -ENOMEM;
+
 	blk_crypto_keyslots = kcalloc(blk_crypto_num_keyslots,
 				      sizeof(blk_crypto_keyslots[0]),
 				      GFP_KERNEL);
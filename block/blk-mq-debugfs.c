@@ -158,6 +158,78 @@ static ssize_t queue_write_hint_store(void *data, const char __user *buf,
 	return count;
 }
 
+static const char *const class_lat_name[] = {
+	[IOPRIO_CLASS_NONE]	= "none",
+	[IOPRIO_CLASS_RT]	= "rt",
+	[IOPRIO_CLASS_BE]	= "be",
+	[IOPRIO_CLASS_IDLE]	= "idle",
+};
+
+/* Time from allocation to completion, so scheduler queueing included */
+void blk_mq_debugfs_class_lat_done(struct request *rq)
+{
+	struct blk_class_lat *lat;
+	unsigned int class;
+	u64 ns;
+
+	if (!rq->alloc_time_ns || blk_rq_is_passthrough(rq))
+		return;
+
+	class = IOPRIO_PRIO_CLASS(req_get_ioprio(rq));
+	if (class > IOPRIO_CLASS_IDLE)
+		return;
+
+	ns = ktime_get_ns() - rq->alloc_time_ns;
+	lat = &rq->q->class_lat[class][rq_data_dir(rq)];
+	atomic64_inc(&lat->nr);
+	atomic64_add(ns, &lat->total_ns);
+	/* Racy, a concurrent completion may hide a slightly smaller max */
+	if (ns > READ_ONCE(lat->max_ns))
+		WRITE_ONCE(lat->max_ns, ns);
+}
+
+static int queue_class_lat_show(void *data, struct seq_file *m)
+{
+	struct request_queue *q = data;
+	struct blk_class_lat *lat;
+	u64 nr, total;
+	int class, dir;
+
+	for (class = 0; class <= IOPRIO_CLASS_IDLE; class++) {
+		for (dir = READ; dir <= WRITE; dir++) {
+			lat = &q->class_lat[class][dir];
+			nr = atomic64_read(&lat->nr);
+			total = atomic64_read(&lat->total_ns);
+			seq_printf(m, "%s %s: samples=%llu, mean=%llu, max=%llu\n",
+				   class_lat_name[class],
+				   dir == READ ? "read" : "write", nr,
+				   nr ? div64_u64(total, nr) : 0,
+				   READ_ONCE(lat->max_ns));
+		}
+	}
+
+	return 0;
+}
+
+static ssize_t queue_class_lat_write(void *data, const char __user *buf,
+				     size_t count, loff_t *ppos)
+{
+	struct request_queue *q = data;
+	struct blk_class_lat *lat;
+	int class, dir;
+
+	for (class = 0; class <= IOPRIO_CLASS_IDLE; class++) {
+		for (dir = READ; dir <= WRITE; dir++) {
+			lat = &q->class_lat[class][dir];
+			atomic64_set(&lat->nr, 0);
+			atomic64_set(&lat->total_ns, 0);
+			WRITE_ONCE(lat->max_ns, 0);
+		}
+	}
+
+	return count;
+}
+
 static int queue_poll_stat_show(void *data, struct seq_file *m)
 {
 	struct request_queue *q = data;
@@ -759,6 +831,7 @@ static const struct blk_mq_debugfs_attr blk_mq_debugfs_queue_attrs[] = {
 	{"requeue_list", 0400, .seq_ops = &queue_requeue_list_seq_ops},
 	{"state", 0600, queue_state_show, queue_state_write},
 	{"write_hints", 0600, queue_write_hint_show, queue_write_hint_store},
+	{"class_latency", 0600, queue_class_lat_show, queue_class_lat_write},
 	{},
 };
 
@@ -97,4 +97,14 @@ static inline bool blk_mq_sched_needs_restart(struct blk_mq_hw_ctx *hctx)
 	return test_bit(BLK_MQ_S_SCHED_RESTART, &hctx->state);
 }
 
+/*
+ * Reads of the realtime class, which is what blk_mq_make_request() gives
+ * to the foreground schedtune groups, are served ahead of everything else.
+ */
+static inline bool blk_mq_sched_rq_is_fg(struct request *rq)
+{
+	return rq_data_dir(rq) == READ &&
+		IOPRIO_PRIO_CLASS(req_get_ioprio(rq)) == IOPRIO_CLASS_RT;
+}
+
 #endif
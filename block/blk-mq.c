@@ -327,6 +327,9 @@ static struct request *blk_mq_rq_ctx_init(struct blk_mq_alloc_data *data,
 	rq->rl = NULL;
 	set_start_time_ns(rq);
 	rq->io_start_time_ns = 0;
+#endif
+#ifdef CONFIG_BLK_DEBUG_FS
+	rq->alloc_time_ns = ktime_get_ns();
 #endif
 	rq->nr_phys_segments = 0;
 #if defined(CONFIG_BLK_DEV_INTEGRITY)
@@ -511,6 +514,7 @@ EXPORT_SYMBOL_GPL(blk_mq_free_request);
 inline void __blk_mq_end_request(struct request *rq, blk_status_t error)
 {
 	blk_account_io_done(rq);
+	blk_mq_debugfs_class_lat_done(rq);
 
 	if (rq->end_io) {
 		wbt_done(rq->q->rq_wb, &rq->issue_stat);
@@ -1634,6 +1638,26 @@ static void blk_mq_try_issue_directly(struct blk_mq_hw_ctx *hctx,
 	}
 }
 
+/*
+ * Bios submitted without an ioprio, by tasks that never called
+ * ioprio_set(), get the class of their schedtune group, so that the
+ * schedulers can tell top-app reads from background installs.
+ */
+static void blk_mq_bio_set_class(struct bio *bio)
+{
+	struct io_context *ioc = current->io_context;
+	int class;
+
+	if (ioprio_valid(bio_prio(bio)))
+		return;
+	if (ioc && ioprio_valid(ioc->ioprio))
+		return;
+
+	class = schedtune_task_ioprio_class(current);
+	if (class != IOPRIO_CLASS_NONE)
+		bio_set_prio(bio, IOPRIO_PRIO_VALUE(class, IOPRIO_NORM));
+}
+
 static blk_qc_t blk_mq_make_request(struct request_queue *q, struct bio *bio)
 {
 	const int is_sync = op_is_sync(bio->bi_opf);
@@ -1653,6 +1677,8 @@ static blk_qc_t blk_mq_make_request(struct request_queue *q, struct bio *bio)
 	if (!bio_integrity_prep(bio))
 		return BLK_QC_T_NONE;
 
+	blk_mq_bio_set_class(bio);
+
 	if (!is_flush_fua && !blk_queue_nomerges(q) &&
 	    blk_attempt_plug_merge(q, bio, &request_count, &same_queue_rq))
 		return BLK_QC_T_NONE;
@@ -24,23 +24,50 @@
  *
  * Upper layers will call keyslot_manager_get_slot_for_key() to program a
  * key into some slot in the inline encryption hardware.
+ *
+ * A key that is already in a slot that is in use is found and grabbed without
+ * taking ksm->lock, which is only needed to take an idle slot or to program
+ * one.  With many per-file keys the slots are reprogrammed all the time, so
+ * idle slots whose key was found again get a second chance before they are
+ * reused, and keys that were only ever used once are evicted first.
  */
 #include <crypto/algapi.h>
 #include <linux/keyslot-manager.h>
 #include <linux/atomic.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
 #include <linux/mutex.h>
+#include <linux/percpu.h>
 #include <linux/pm_runtime.h>
+#include <linux/rculist.h>
+#include <linux/seq_file.h>
 #include <linux/wait.h>
 #include <linux/blkdev.h>
 #include <linux/overflow.h>
 
 struct keyslot {
 	atomic_t slot_refs;
+	/* The key was found again since the slot was last skipped for reuse */
+	bool referenced;
 	struct list_head idle_slot_node;
 	struct hlist_node hash_node;
 	struct blk_crypto_key key;
 };
 
+/* Hot path counters, per cpu so that lookups don't share a cache line */
+struct keyslot_manager_stats {
+	u64 hits;
+	u64 idle_hits;
+	u64 misses;
+	u64 waits;
+	u64 programs;
+	u64 program_errors;
+	u64 program_ns;
+	u64 replaced;
+	u64 evicts;
+	u64 evict_ns;
+};
+
 struct keyslot_manager {
 	unsigned int num_slots;
 	struct keyslot_mgmt_ll_ops ksm_ll_ops;
@@ -71,6 +98,12 @@ struct keyslot_manager {
 	struct hlist_head *slot_hashtable;
 	unsigned int slot_hashtable_size;
 
+	struct keyslot_manager_stats __percpu *stats;
+	/* Slowest program and evict calls, protected by 'lock' */
+	u64 max_program_ns;
+	u64 max_evict_ns;
+	struct dentry *debugfs;
+
 	/* Per-keyslot data */
 	struct keyslot slots[];
 };
@@ -131,6 +164,98 @@ static inline void keyslot_manager_hw_exit(struct keyslot_manager *ksm)
 	keyslot_manager_pm_put(ksm);
 }
 
+#define keyslot_manager_stat_inc(ksm, field) \
+	this_cpu_inc((ksm)->stats->field)
+#define keyslot_manager_stat_add(ksm, field, val) \
+	this_cpu_add((ksm)->stats->field, val)
+
+static struct dentry *keyslot_manager_debugfs_root;
+
+static int keyslot_manager_stats_show(struct seq_file *m, void *v)
+{
+	struct keyslot_manager *ksm = m->private;
+	struct keyslot_manager_stats sum = { 0 };
+	unsigned int slot, in_use = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		const struct keyslot_manager_stats *s =
+			per_cpu_ptr(ksm->stats, cpu);
+
+		sum.hits += s->hits;
+		sum.idle_hits += s->idle_hits;
+		sum.misses += s->misses;
+		sum.waits += s->waits;
+		sum.programs += s->programs;
+		sum.program_errors += s->program_errors;
+		sum.program_ns += s->program_ns;
+		sum.replaced += s->replaced;
+		sum.evicts += s->evicts;
+		sum.evict_ns += s->evict_ns;
+	}
+
+	for (slot = 0; slot < ksm->num_slots; slot++)
+		if (atomic_read(&ksm->slots[slot].slot_refs))
+			in_use++;
+
+	seq_printf(m, "slots: %u in use %u\n", ksm->num_slots, in_use);
+	seq_printf(m, "hits: %llu idle %llu\n", sum.hits, sum.idle_hits);
+	seq_printf(m, "misses: %llu waits %llu\n", sum.misses, sum.waits);
+	seq_printf(m, "programs: %llu errors %llu replaced %llu\n",
+		   sum.programs, sum.program_errors, sum.replaced);
+	seq_printf(m, "program_us: total %llu avg %llu max %llu\n",
+		   div_u64(sum.program_ns, NSEC_PER_USEC),
+		   sum.programs ? div64_u64(sum.program_ns,
+					    sum.programs * NSEC_PER_USEC) : 0,
+		   div_u64(READ_ONCE(ksm->max_program_ns), NSEC_PER_USEC));
+	seq_printf(m, "evicts: %llu\n", sum.evicts);
+	seq_printf(m, "evict_us: total %llu avg %llu max %llu\n",
+		   div_u64(sum.evict_ns, NSEC_PER_USEC),
+		   sum.evicts ? div64_u64(sum.evict_ns,
+					  sum.evicts * NSEC_PER_USEC) : 0,
+		   div_u64(READ_ONCE(ksm->max_evict_ns), NSEC_PER_USEC));
+
+	return 0;
+}
+
+static int keyslot_manager_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, keyslot_manager_stats_show, inode->i_private);
+}
+
+/* Not atomic against lookups on other cpus, which is fine for statistics */
+static ssize_t keyslot_manager_stats_write(struct file *file,
+					   const char __user *buf,
+					   size_t count, loff_t *ppos)
+{
+	struct keyslot_manager *ksm = file_inode(file)->i_private;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(ksm->stats, cpu), 0, sizeof(*ksm->stats));
+	WRITE_ONCE(ksm->max_program_ns, 0);
+	WRITE_ONCE(ksm->max_evict_ns, 0);
+
+	return count;
+}
+
+static const struct file_operations keyslot_manager_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = keyslot_manager_stats_open,
+	.read = seq_read,
+	.write = keyslot_manager_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init keyslot_manager_debugfs_init(void)
+{
+	keyslot_manager_debugfs_root = debugfs_create_dir("keyslot_manager",
+							  NULL);
+	return 0;
+}
+subsys_initcall(keyslot_manager_debugfs_init);
+
 /**
  * keyslot_manager_create() - Create a keyslot manager
  * @dev: Device for runtime power management (NULL if none)
@@ -200,6 +325,10 @@ struct keyslot_manager *keyslot_manager_create(
 
 	spin_lock_init(&ksm->idle_slots_lock);
 
+	ksm->stats = alloc_percpu(struct keyslot_manager_stats);
+	if (!ksm->stats)
+		goto err_free_ksm;
+
 	ksm->slot_hashtable_size = roundup_pow_of_two(num_slots);
 	ksm->slot_hashtable = kvmalloc_array(ksm->slot_hashtable_size,
 					     sizeof(ksm->slot_hashtable[0]),
@@ -209,6 +338,13 @@ struct keyslot_manager *keyslot_manager_create(
 	for (i = 0; i < ksm->slot_hashtable_size; i++)
 		INIT_HLIST_HEAD(&ksm->slot_hashtable[i]);
 
+	/* Statistics of devices without a name are not exported */
+	if (dev && !IS_ERR_OR_NULL(keyslot_manager_debugfs_root))
+		ksm->debugfs = debugfs_create_file(dev_name(dev), 0600,
+						   keyslot_manager_debugfs_root,
+						   ksm,
+						   &keyslot_manager_stats_fops);
+
 	return ksm;
 
 err_free_ksm:
@@ -241,6 +377,16 @@ static void remove_slot_from_lru_list(struct keyslot_manager *ksm, int slot)
 	spin_unlock_irqrestore(&ksm->idle_slots_lock, flags);
 }
 
+static bool keyslot_has_key(const struct keyslot *slotp,
+			     const struct blk_crypto_key *key)
+{
+	return slotp->key.hash == key->hash &&
+	       slotp->key.crypto_mode == key->crypto_mode &&
+	       slotp->key.size == key->size &&
+	       slotp->key.data_unit_size == key->data_unit_size &&
+	       !crypto_memneq(slotp->key.raw, key->raw, key->size);
+}
+
 static int find_keyslot(struct keyslot_manager *ksm,
 			const struct blk_crypto_key *key)
 {
@@ -248,16 +394,56 @@ static int find_keyslot(struct keyslot_manager *ksm,
 	const struct keyslot *slotp;
 
 	hlist_for_each_entry(slotp, head, hash_node) {
-		if (slotp->key.hash == key->hash &&
-		    slotp->key.crypto_mode == key->crypto_mode &&
-		    slotp->key.size == key->size &&
-		    slotp->key.data_unit_size == key->data_unit_size &&
-		    !crypto_memneq(slotp->key.raw, key->raw, key->size))
+		if (keyslot_has_key(slotp, key))
 			return slotp - ksm->slots;
 	}
 	return -ENOKEY;
 }
 
+static void keyslot_mark_referenced(struct keyslot *slotp)
+{
+	if (!READ_ONCE(slotp->referenced))
+		WRITE_ONCE(slotp->referenced, true);
+}
+
+/*
+ * Find and grab a slot that has the key and is in use, without ksm->lock.
+ *
+ * The slots are never freed while the keyslot manager is in use, and a slot
+ * that is moved to another bucket under ksm->lock is added to the head of
+ * that bucket, so the walk always ends and at worst misses the key.  While a
+ * reference is held the slot can't be reprogrammed, so the key is checked
+ * again once it is taken.  Idle slots are left to find_and_grab_keyslot(),
+ * which takes them off the LRU list.
+ */
+static int find_and_grab_keyslot_lockless(struct keyslot_manager *ksm,
+					  const struct blk_crypto_key *key)
+{
+	const struct hlist_head *head = hash_bucket_for_key(ksm, key);
+	struct keyslot *slotp;
+	int slot = -ENOKEY;
+
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(slotp, head, hash_node) {
+		if (!keyslot_has_key(slotp, key))
+			continue;
+		if (!atomic_inc_not_zero(&slotp->slot_refs))
+			break;
+		slot = slotp - ksm->slots;
+		if (!keyslot_has_key(slotp, key)) {
+			keyslot_manager_put_slot(ksm, slot);
+			slot = -ENOKEY;
+		}
+		break;
+	}
+	rcu_read_unlock();
+
+	if (slot >= 0)
+		keyslot_mark_referenced(slotp);
+
+	return slot;
+}
+
 static int find_and_grab_keyslot(struct keyslot_manager *ksm,
 				 const struct blk_crypto_key *key)
 {
@@ -269,10 +455,42 @@ static int find_and_grab_keyslot(struct keyslot_manager *ksm,
 	if (atomic_inc_return(&ksm->slots[slot].slot_refs) == 1) {
 		/* Took first reference to this slot; remove it from LRU list */
 		remove_slot_from_lru_list(ksm, slot);
+		keyslot_manager_stat_inc(ksm, idle_hits);
+	} else {
+		keyslot_manager_stat_inc(ksm, hits);
 	}
+	keyslot_mark_referenced(&ksm->slots[slot]);
 	return slot;
 }
 
+/*
+ * Second chance replacement: take the least recently used idle slot whose key
+ * wasn't found again since it was last skipped, moving the others to the back
+ * of the list.  After one pass over the list every slot is unreferenced, so
+ * this takes at most num_slots steps.  Called with ksm->lock held for writing
+ * and at least one idle slot.
+ */
+static struct keyslot *keyslot_manager_pick_idle_slot(
+					struct keyslot_manager *ksm)
+{
+	struct keyslot *slotp;
+	unsigned int n = ksm->num_slots;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ksm->idle_slots_lock, flags);
+	for (;;) {
+		slotp = list_first_entry(&ksm->idle_slots, struct keyslot,
+					 idle_slot_node);
+		if (!slotp->referenced || !n--)
+			break;
+		WRITE_ONCE(slotp->referenced, false);
+		list_move_tail(&slotp->idle_slot_node, &ksm->idle_slots);
+	}
+	spin_unlock_irqrestore(&ksm->idle_slots_lock, flags);
+
+	return slotp;
+}
+
 /**
  * keyslot_manager_get_slot_for_key() - Program a key into a keyslot.
  * @ksm: The keyslot manager to program the key into.
@@ -292,16 +510,26 @@ int keyslot_manager_get_slot_for_key(struct keyslot_manager *ksm,
 	int slot;
 	int err;
 	struct keyslot *idle_slot;
+	ktime_t start;
+	u64 delta;
 
 	if (keyslot_manager_is_passthrough(ksm))
 		return 0;
 
+	slot = find_and_grab_keyslot_lockless(ksm, key);
+	if (slot >= 0) {
+		keyslot_manager_stat_inc(ksm, hits);
+		return slot;
+	}
+
 	down_read(&ksm->lock);
 	slot = find_and_grab_keyslot(ksm, key);
 	up_read(&ksm->lock);
 	if (slot != -ENOKEY)
 		return slot;
 
+	keyslot_manager_stat_inc(ksm, misses);
+
 	for (;;) {
 		keyslot_manager_hw_enter(ksm);
 		slot = find_and_grab_keyslot(ksm, key);
@@ -318,28 +546,43 @@ int keyslot_manager_get_slot_for_key(struct keyslot_manager *ksm,
 			break;
 
 		keyslot_manager_hw_exit(ksm);
+		keyslot_manager_stat_inc(ksm, waits);
 		wait_event(ksm->idle_slots_wait_queue,
 			   !list_empty(&ksm->idle_slots));
 	}
 
-	idle_slot = list_first_entry(&ksm->idle_slots, struct keyslot,
-					     idle_slot_node);
+	idle_slot = keyslot_manager_pick_idle_slot(ksm);
 	slot = idle_slot - ksm->slots;
 
+	start = ktime_get();
 	err = ksm->ksm_ll_ops.keyslot_program(ksm, key, slot);
+	delta = ktime_to_ns(ktime_sub(ktime_get(), start));
+	keyslot_manager_stat_add(ksm, program_ns, delta);
+	if (delta > ksm->max_program_ns)
+		WRITE_ONCE(ksm->max_program_ns, delta);
+	keyslot_manager_stat_inc(ksm, programs);
 	if (err) {
+		keyslot_manager_stat_inc(ksm, program_errors);
 		wake_up(&ksm->idle_slots_wait_queue);
 		keyslot_manager_hw_exit(ksm);
 		return err;
 	}
 
-	/* Move this slot to the hash list for the new key. */
-	if (idle_slot->key.crypto_mode != BLK_ENCRYPTION_MODE_INVALID)
-		hlist_del(&idle_slot->hash_node);
-	hlist_add_head(&idle_slot->hash_node, hash_bucket_for_key(ksm, key));
-
-	atomic_set(&idle_slot->slot_refs, 1);
+	/*
+	 * Move this slot to the hash list for the new key.  The slot is idle,
+	 * so lockless lookups that still see the old key can't grab it, and the
+	 * key is written before the reference that lets them.
+	 */
+	if (idle_slot->key.crypto_mode != BLK_ENCRYPTION_MODE_INVALID) {
+		hlist_del_rcu(&idle_slot->hash_node);
+		keyslot_manager_stat_inc(ksm, replaced);
+	}
 	idle_slot->key = *key;
+	idle_slot->referenced = false;
+	hlist_add_head_rcu(&idle_slot->hash_node,
+			   hash_bucket_for_key(ksm, key));
+
+	atomic_set_release(&idle_slot->slot_refs, 1);
 
 	remove_slot_from_lru_list(ksm, slot);
 
@@ -455,6 +698,8 @@ int keyslot_manager_evict_key(struct keyslot_manager *ksm,
 	int slot;
 	int err;
 	struct keyslot *slotp;
+	ktime_t start;
+	u64 delta;
 
 	if (keyslot_manager_is_passthrough(ksm)) {
 		if (ksm->ksm_ll_ops.keyslot_evict) {
@@ -479,12 +724,19 @@ int keyslot_manager_evict_key(struct keyslot_manager *ksm,
 		err = -EBUSY;
 		goto out_unlock;
 	}
+	start = ktime_get();
 	err = ksm->ksm_ll_ops.keyslot_evict(ksm, key, slot);
+	delta = ktime_to_ns(ktime_sub(ktime_get(), start));
+	keyslot_manager_stat_add(ksm, evict_ns, delta);
+	if (delta > ksm->max_evict_ns)
+		WRITE_ONCE(ksm->max_evict_ns, delta);
+	keyslot_manager_stat_inc(ksm, evicts);
 	if (err)
 		goto out_unlock;
 
-	hlist_del(&slotp->hash_node);
+	hlist_del_rcu(&slotp->hash_node);
 	memzero_explicit(&slotp->key, sizeof(slotp->key));
+	slotp->referenced = false;
 	err = 0;
 out_unlock:
 	keyslot_manager_hw_exit(ksm);
@@ -538,6 +790,8 @@ EXPORT_SYMBOL_GPL(keyslot_manager_private);
 void keyslot_manager_destroy(struct keyslot_manager *ksm)
 {
 	if (ksm) {
+		debugfs_remove(ksm->debugfs);
+		free_percpu(ksm->stats);
 		kvfree(ksm->slot_hashtable);
 		memzero_explicit(ksm, struct_size(ksm, slots, ksm->num_slots));
 		kvfree(ksm);
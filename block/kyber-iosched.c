@@ -72,6 +72,12 @@ static const unsigned int kyber_batch_size[] = {
 	[KYBER_OTHER] = 8,
 };
 
+/*
+ * Foreground reads dispatched in a row before the domain batches get a
+ * request in.
+ */
+static const unsigned int kyber_fg_batch = 8;
+
 struct kyber_queue_data {
 	struct request_queue *q;
 
@@ -97,8 +103,11 @@ struct kyber_queue_data {
 struct kyber_hctx_data {
 	spinlock_t lock;
 	struct list_head rqs[KYBER_NUM_DOMAINS];
+	/* Foreground reads, they hold tokens of KYBER_READ */
+	struct list_head fg_rqs;
 	unsigned int cur_domain;
 	unsigned int batching;
+	unsigned int fg_batching;
 	wait_queue_entry_t domain_wait[KYBER_NUM_DOMAINS];
 	atomic_t wait_index[KYBER_NUM_DOMAINS];
 };
@@ -388,9 +397,11 @@ static int kyber_init_hctx(struct blk_mq_hw_ctx *hctx, unsigned int hctx_idx)
 		INIT_LIST_HEAD(&khd->domain_wait[i].entry);
 		atomic_set(&khd->wait_index[i], 0);
 	}
+	INIT_LIST_HEAD(&khd->fg_rqs);
 
 	khd->cur_domain = 0;
 	khd->batching = 0;
+	khd->fg_batching = 0;
 
 	hctx->sched_data = khd;
 
@@ -498,6 +509,10 @@ static void kyber_flush_busy_ctxs(struct kyber_hctx_data *khd,
 	list_for_each_entry_safe(rq, next, &rq_list, queuelist) {
 		unsigned int sched_domain;
 
+		if (blk_mq_sched_rq_is_fg(rq)) {
+			list_move_tail(&rq->queuelist, &khd->fg_rqs);
+			continue;
+		}
 		sched_domain = rq_sched_domain(rq);
 		list_move_tail(&rq->queuelist, &khd->rqs[sched_domain]);
 	}
@@ -515,9 +530,9 @@ static int kyber_domain_wake(wait_queue_entry_t *wait, unsigned mode, int flags,
 
 static int kyber_get_domain_token(struct kyber_queue_data *kqd,
 				  struct kyber_hctx_data *khd,
-				  struct blk_mq_hw_ctx *hctx)
+				  struct blk_mq_hw_ctx *hctx,
+				  unsigned int sched_domain)
 {
-	unsigned int sched_domain = khd->cur_domain;
 	struct sbitmap_queue *domain_tokens = &kqd->domain_tokens[sched_domain];
 	wait_queue_entry_t *wait = &khd->domain_wait[sched_domain];
 	struct sbq_wait_state *ws;
@@ -572,7 +587,7 @@ kyber_dispatch_cur_domain(struct kyber_queue_data *kqd,
 	}
 
 	if (rq) {
-		nr = kyber_get_domain_token(kqd, khd, hctx);
+		nr = kyber_get_domain_token(kqd, khd, hctx, khd->cur_domain);
 		if (nr >= 0) {
 			khd->batching++;
 			rq_set_domain_token(rq, nr);
@@ -585,6 +600,33 @@ kyber_dispatch_cur_domain(struct kyber_queue_data *kqd,
 	return NULL;
 }
 
+static struct request *kyber_dispatch_fg(struct kyber_queue_data *kqd,
+					 struct kyber_hctx_data *khd,
+					 struct blk_mq_hw_ctx *hctx,
+					 bool *flushed)
+{
+	struct request *rq;
+	int nr;
+
+	if (list_empty(&khd->fg_rqs)) {
+		kyber_flush_busy_ctxs(khd, hctx);
+		*flushed = true;
+	}
+
+	rq = list_first_entry_or_null(&khd->fg_rqs, struct request, queuelist);
+	if (!rq)
+		return NULL;
+
+	nr = kyber_get_domain_token(kqd, khd, hctx, KYBER_READ);
+	if (nr < 0)
+		return NULL;
+
+	khd->fg_batching++;
+	rq_set_domain_token(rq, nr);
+	list_del_init(&rq->queuelist);
+	return rq;
+}
+
 static struct request *kyber_dispatch_request(struct blk_mq_hw_ctx *hctx)
 {
 	struct kyber_queue_data *kqd = hctx->queue->elevator->elevator_data;
@@ -596,7 +638,18 @@ static struct request *kyber_dispatch_request(struct blk_mq_hw_ctx *hctx)
 	spin_lock(&khd->lock);
 
 	/*
-	 * First, if we are still entitled to batch, try to dispatch a request
+	 * Foreground reads go ahead of any batch, but only kyber_fg_batch of
+	 * them in a row, so the others are delayed and never starved.
+	 */
+	if (khd->fg_batching < kyber_fg_batch) {
+		rq = kyber_dispatch_fg(kqd, khd, hctx, &flushed);
+		if (rq)
+			goto out;
+	}
+	khd->fg_batching = 0;
+
+	/*
+	 * Then, if we are still entitled to batch, try to dispatch a request
 	 * from the batch.
 	 */
 	if (khd->batching < kyber_batch_size[khd->cur_domain]) {
@@ -641,7 +694,7 @@ static bool kyber_has_work(struct blk_mq_hw_ctx *hctx)
 		if (!list_empty_careful(&khd->rqs[i]))
 			return true;
 	}
-	return false;
+	return !list_empty_careful(&khd->fg_rqs);
 }
 
 #define KYBER_LAT_SHOW_STORE(op)					\
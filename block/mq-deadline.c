@@ -31,6 +31,8 @@ static const int write_expire = 5 * HZ; /* ditto for writes, these limits are SO
 static const int writes_starved = 2;    /* max times reads can starve a write */
 static const int fifo_batch = 16;       /* # of sequential requests treated as one
 				     by the above parameters. For throughput. */
+static const int fg_batch = 8;		/* foreground reads before any other
+				     request gets a turn, 0 disables them */
 
 struct deadline_data {
 	/*
@@ -42,6 +44,8 @@ struct deadline_data {
 	 */
 	struct rb_root sort_list[2];
 	struct list_head fifo_list[2];
+	/* foreground reads are on the READ sort_list and on fg_fifo */
+	struct list_head fg_fifo;
 
 	/*
 	 * next in sort order. read, write or both are NULL
@@ -49,12 +53,14 @@ struct deadline_data {
 	struct request *next_rq[2];
 	unsigned int batching;		/* number of sequential requests made */
 	unsigned int starved;		/* times reads have starved writes */
+	unsigned int fg_batching;	/* foreground reads in a row */
 
 	/*
 	 * settings that change how the i/o scheduler behaves
 	 */
 	int fifo_expire[2];
 	int fifo_batch;
+	int fg_batch;
 	int writes_starved;
 	int front_merges;
 
@@ -140,7 +146,8 @@ static void dd_merged_requests(struct request_queue *q, struct request *req,
 {
 	/*
 	 * if next expires before rq, assign its expire time to rq
-	 * and move into next position (next will be deleted) in fifo
+	 * and move into next position (next will be deleted) in fifo,
+	 * which for reads may be the foreground fifo or the other one
 	 */
 	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist)) {
 		if (time_before((unsigned long)next->fifo_time,
@@ -174,13 +181,35 @@ deadline_move_request(struct deadline_data *dd, struct request *rq)
 	deadline_remove_request(rq->q, rq);
 }
 
+static inline struct list_head *
+deadline_fifo(struct deadline_data *dd, struct request *rq)
+{
+	if (blk_mq_sched_rq_is_fg(rq))
+		return &dd->fg_fifo;
+
+	return &dd->fifo_list[rq_data_dir(rq)];
+}
+
+/*
+ * oldest request of ddir, foreground reads only once there are no others.
+ * Requires at least one request of ddir.
+ */
+static inline struct request *
+deadline_fifo_first(struct deadline_data *dd, int ddir)
+{
+	if (!list_empty(&dd->fifo_list[ddir]))
+		return rq_entry_fifo(dd->fifo_list[ddir].next);
+
+	return rq_entry_fifo(dd->fg_fifo.next);
+}
+
 /*
  * deadline_check_fifo returns 0 if there are no expired requests on the fifo,
- * 1 otherwise. Requires !list_empty(&dd->fifo_list[data_dir])
+ * 1 otherwise. Requires at least one request of ddir.
  */
 static inline int deadline_check_fifo(struct deadline_data *dd, int ddir)
 {
-	struct request *rq = rq_entry_fifo(dd->fifo_list[ddir].next);
+	struct request *rq = deadline_fifo_first(dd, ddir);
 
 	/*
 	 * rq is expired!
@@ -191,6 +220,29 @@ static inline int deadline_check_fifo(struct deadline_data *dd, int ddir)
 	return 0;
 }
 
+/*
+ * whether the foreground reads may go once more, they have to step aside
+ * after fg_batch of them and whenever anything else has expired
+ */
+static bool deadline_fg_may_dispatch(struct deadline_data *dd)
+{
+	struct request *rq;
+	int ddir;
+
+	if (list_empty(&dd->fg_fifo) || dd->fg_batching >= dd->fg_batch)
+		return false;
+
+	for (ddir = READ; ddir <= WRITE; ddir++) {
+		if (list_empty(&dd->fifo_list[ddir]))
+			continue;
+		rq = rq_entry_fifo(dd->fifo_list[ddir].next);
+		if (time_after_eq(jiffies, (unsigned long)rq->fifo_time))
+			return false;
+	}
+
+	return true;
+}
+
 /*
  * deadline_dispatch_requests selects the best request according to
  * read/write expire, fifo_batch, etc
@@ -208,7 +260,15 @@ static struct request *__dd_dispatch_request(struct blk_mq_hw_ctx *hctx)
 		goto done;
 	}
 
-	reads = !list_empty(&dd->fifo_list[READ]);
+	if (deadline_fg_may_dispatch(dd)) {
+		rq = rq_entry_fifo(dd->fg_fifo.next);
+		dd->fg_batching++;
+		deadline_move_request(dd, rq);
+		goto done;
+	}
+	dd->fg_batching = 0;
+
+	reads = !list_empty(&dd->fifo_list[READ]) || !list_empty(&dd->fg_fifo);
 	writes = !list_empty(&dd->fifo_list[WRITE]);
 
 	/*
@@ -266,7 +326,7 @@ static struct request *__dd_dispatch_request(struct blk_mq_hw_ctx *hctx)
 		 * direction, or we have run out of higher-sectored requests.
 		 * Start again from the request with the earliest expiry time.
 		 */
-		rq = rq_entry_fifo(dd->fifo_list[data_dir].next);
+		rq = deadline_fifo_first(dd, data_dir);
 	} else {
 		/*
 		 * The last req was the same dir and we have a next request in
@@ -306,6 +366,7 @@ static void dd_exit_queue(struct elevator_queue *e)
 
 	BUG_ON(!list_empty(&dd->fifo_list[READ]));
 	BUG_ON(!list_empty(&dd->fifo_list[WRITE]));
+	BUG_ON(!list_empty(&dd->fg_fifo));
 
 	kfree(dd);
 }
@@ -331,6 +392,7 @@ static int dd_init_queue(struct request_queue *q, struct elevator_type *e)
 
 	INIT_LIST_HEAD(&dd->fifo_list[READ]);
 	INIT_LIST_HEAD(&dd->fifo_list[WRITE]);
+	INIT_LIST_HEAD(&dd->fg_fifo);
 	dd->sort_list[READ] = RB_ROOT;
 	dd->sort_list[WRITE] = RB_ROOT;
 	dd->fifo_expire[READ] = read_expire;
@@ -338,6 +400,7 @@ static int dd_init_queue(struct request_queue *q, struct elevator_type *e)
 	dd->writes_starved = writes_starved;
 	dd->front_merges = 1;
 	dd->fifo_batch = fifo_batch;
+	dd->fg_batch = fg_batch;
 	spin_lock_init(&dd->lock);
 	INIT_LIST_HEAD(&dd->dispatch);
 
@@ -418,7 +481,7 @@ static void dd_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 		 * set expire time and add to fifo list
 		 */
 		rq->fifo_time = jiffies + dd->fifo_expire[data_dir];
-		list_add_tail(&rq->queuelist, &dd->fifo_list[data_dir]);
+		list_add_tail(&rq->queuelist, deadline_fifo(dd, rq));
 	}
 }
 
@@ -445,7 +508,8 @@ static bool dd_has_work(struct blk_mq_hw_ctx *hctx)
 
 	return !list_empty_careful(&dd->dispatch) ||
 		!list_empty_careful(&dd->fifo_list[0]) ||
-		!list_empty_careful(&dd->fifo_list[1]);
+		!list_empty_careful(&dd->fifo_list[1]) ||
+		!list_empty_careful(&dd->fg_fifo);
 }
 
 /*
@@ -479,6 +543,7 @@ SHOW_FUNCTION(deadline_write_expire_show, dd->fifo_expire[WRITE], 1);
 SHOW_FUNCTION(deadline_writes_starved_show, dd->writes_starved, 0);
 SHOW_FUNCTION(deadline_front_merges_show, dd->front_merges, 0);
 SHOW_FUNCTION(deadline_fifo_batch_show, dd->fifo_batch, 0);
+SHOW_FUNCTION(deadline_fg_batch_show, dd->fg_batch, 0);
 #undef SHOW_FUNCTION
 
 #define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
@@ -502,6 +567,7 @@ STORE_FUNCTION(deadline_write_expire_store, &dd->fifo_expire[WRITE], 0, INT_MAX,
 STORE_FUNCTION(deadline_writes_starved_store, &dd->writes_starved, INT_MIN, INT_MAX, 0);
 STORE_FUNCTION(deadline_front_merges_store, &dd->front_merges, 0, 1, 0);
 STORE_FUNCTION(deadline_fifo_batch_store, &dd->fifo_batch, 0, INT_MAX, 0);
+STORE_FUNCTION(deadline_fg_batch_store, &dd->fg_batch, 0, INT_MAX, 0);
 #undef STORE_FUNCTION
 
 #define DD_ATTR(name) \
@@ -514,6 +580,7 @@ static struct elv_fs_entry deadline_attrs[] = {
 	DD_ATTR(writes_starved),
 	DD_ATTR(front_merges),
 	DD_ATTR(fifo_batch),
+	DD_ATTR(fg_batch),
 	__ATTR_NULL
 };
 
@@ -134,6 +134,17 @@ module_param_named(debug_mask, binder_debug_mask, uint, 0644);
 char *binder_devices_param = CONFIG_ANDROID_BINDER_DEVICES;
 module_param_named(devices, binder_devices_param, charp, 0444);
 
+/*
+ * Hand the next queued oneway transaction of a node straight to the
+ * looper thread that frees the previous one, instead of queueing it for
+ * the proc and waking some thread. Only done when the free is the last
+ * command of the write, so the thread's next step is the read that picks
+ * it up. Bursts then drain on one thread, in order, without a wakeup per
+ * message.
+ */
+static bool binder_oneway_batch = true;
+module_param_named(oneway_batch, binder_oneway_batch, bool, 0644);
+
 static DECLARE_WAIT_QUEUE_HEAD(binder_user_error_wait);
 static int binder_stop_on_user_error;
 
@@ -205,6 +216,57 @@ static inline void binder_stats_created(enum binder_stat_types type)
 	atomic_inc(&binder_stats.obj_created[type]);
 }
 
+/*
+ * Latency histograms, always on. Bucket i counts events that took
+ * [2^i, 2^(i+1)) us, bucket 0 also takes everything under 1us and the
+ * last bucket everything above.
+ *
+ * queue:  work queued for a proc until a thread dequeues it
+ * wakeup: a thread being woken for work until it dequeues it
+ * reply:  a synchronous transaction queued until it is replied to
+ */
+#define BINDER_LAT_BUCKETS 20
+
+enum binder_lat_types {
+	BINDER_LAT_QUEUE,
+	BINDER_LAT_WAKEUP,
+	BINDER_LAT_REPLY,
+	BINDER_LAT_COUNT
+};
+
+static const char * const binder_lat_strings[] = {
+	"queue",
+	"wakeup",
+	"reply",
+};
+
+struct binder_lat_hist {
+	atomic_t bucket[BINDER_LAT_BUCKETS];
+};
+
+/*
+ * Per-node histograms are refcounted on their own, so a transaction can
+ * still account its reply after the target node is gone.
+ */
+struct binder_node_lat {
+	refcount_t ref;
+	struct binder_lat_hist hist[BINDER_LAT_COUNT];
+};
+
+static void binder_lat_add(struct binder_lat_hist *hist, u64 ns)
+{
+	u64 us = ns / NSEC_PER_USEC;
+	int i = us ? min_t(int, ilog2(us), BINDER_LAT_BUCKETS - 1) : 0;
+
+	atomic_inc(&hist->bucket[i]);
+}
+
+static void binder_node_lat_put(struct binder_node_lat *lat)
+{
+	if (lat && refcount_dec_and_test(&lat->ref))
+		kfree(lat);
+}
+
 struct binder_transaction_log binder_transaction_log;
 struct binder_transaction_log binder_transaction_log_failed;
 
@@ -322,6 +384,8 @@ struct binder_error {
  *                        (invariant after initialized)
  * @async_todo:           list of async work items
  *                        (protected by @proc->inner_lock)
+ * @lat:                  latency histograms of transactions to this node
+ *                        (invariant after initialized, may be NULL)
  *
  * Bookkeeping structure for binder nodes.
  */
@@ -363,6 +427,7 @@ struct binder_node {
 	};
 	bool has_async_transaction;
 	struct list_head async_todo;
+	struct binder_node_lat *lat;
 };
 
 struct binder_ref_death {
@@ -502,6 +567,8 @@ struct binder_priority {
  * @outer_lock:           no nesting under innor or node lock
  *                        Lock order: 1) outer, 2) node, 3) inner
  * @binderfs_entry:       process-specific binderfs log file
+ * @lat:                  latency histograms of work for this proc
+ *                        (atomics, no lock needed)
  *
  * Bookkeeping structure for binder processes
  */
@@ -534,6 +601,7 @@ struct binder_proc {
 	spinlock_t inner_lock;
 	spinlock_t outer_lock;
 	struct dentry *binderfs_entry;
+	struct binder_lat_hist lat[BINDER_LAT_COUNT];
 };
 
 enum {
@@ -579,6 +647,9 @@ enum {
  *                        when outstanding transactions are cleaned up
  *                        (protected by @proc->inner_lock)
  * @task:                 struct task_struct for this thread
+ * @wakeup_ns:            time the thread was last woken for work, 0 once
+ *                        accounted
+ *                        (protected by @proc->inner_lock)
  *
  * Bookkeeping structure for binder threads.
  */
@@ -599,6 +670,7 @@ struct binder_thread {
 	atomic_t tmp_ref;
 	bool is_dead;
 	struct task_struct *task;
+	u64 wakeup_ns;
 };
 
 struct binder_transaction {
@@ -620,6 +692,13 @@ struct binder_transaction {
 	bool    set_priority_called;
 	kuid_t	sender_euid;
 	binder_uintptr_t security_ctx;
+	/**
+	 * @enqueue_ns: time the transaction was queued to its target
+	 * @lat:        histograms of the target node a reply is accounted
+	 *              to, holds a reference
+	 */
+	u64 enqueue_ns;
+	struct binder_node_lat *lat;
 	/**
 	 * @lock:  protects @from, @to_proc, and @to_thread
 	 *
@@ -1070,6 +1149,7 @@ static void binder_wakeup_thread_ilocked(struct binder_proc *proc,
 	assert_spin_locked(&proc->inner_lock);
 
 	if (thread) {
+		thread->wakeup_ns = ktime_get_ns();
 		if (sync)
 			wake_up_interruptible_sync(&thread->wait);
 		else
@@ -1350,20 +1430,27 @@ static struct binder_node *binder_new_node(struct binder_proc *proc,
 	new_node = kmem_cache_zalloc(binder_node_pool, GFP_KERNEL);
 	if (!new_node)
 		return NULL;
+	/* the node works without its histograms */
+	new_node->lat = kzalloc(sizeof(*new_node->lat), GFP_KERNEL);
+	if (new_node->lat)
+		refcount_set(&new_node->lat->ref, 1);
 	binder_inner_proc_lock(proc);
 	node = binder_init_node_ilocked(proc, new_node, fp);
 	binder_inner_proc_unlock(proc);
-	if (node != new_node)
+	if (node != new_node) {
 		/*
 		 * The node was already added by another thread
 		 */
+		binder_node_lat_put(new_node->lat);
 		kmem_cache_free(binder_node_pool, new_node);
+	}
 
 	return node;
 }
 
 static void binder_free_node(struct binder_node *node)
 {
+	binder_node_lat_put(node->lat);
 	kmem_cache_free(binder_node_pool, node);
 	binder_stats_deleted(BINDER_STAT_NODE);
 }
@@ -2096,6 +2183,7 @@ static void binder_free_transaction(struct binder_transaction *t)
 		 */
 		spin_unlock(&t->lock);
 	}
+	binder_node_lat_put(t->lat);
 	kmem_cache_free(binder_transaction_pool, t);
 	binder_stats_deleted(BINDER_STAT_TRANSACTION);
 }
@@ -2875,6 +2963,7 @@ static bool binder_proc_transaction(struct binder_transaction *t,
 	if (!thread && !pending_async)
 		thread = binder_select_thread_ilocked(proc);
 
+	t->enqueue_ns = ktime_get_ns();
 	if (thread) {
 		binder_transaction_priority(thread->task, t, node_prio,
 					    node->inherit_rt);
@@ -3521,10 +3610,17 @@ static void binder_transaction(struct binder_proc *proc,
 		}
 		BUG_ON(t->buffer->async_transaction != 0);
 		binder_pop_transaction_ilocked(target_thread, in_reply_to);
+		t->enqueue_ns = ktime_get_ns();
 		binder_enqueue_thread_work_ilocked(target_thread, &t->work);
+		target_thread->wakeup_ns = t->enqueue_ns;
 		binder_inner_proc_unlock(target_proc);
 		wake_up_interruptible_sync(&target_thread->wait);
 		binder_restore_priority(current, in_reply_to->saved_priority);
+		binder_lat_add(&proc->lat[BINDER_LAT_REPLY],
+			       t->enqueue_ns - in_reply_to->enqueue_ns);
+		if (in_reply_to->lat)
+			binder_lat_add(&in_reply_to->lat->hist[BINDER_LAT_REPLY],
+				       t->enqueue_ns - in_reply_to->enqueue_ns);
 		binder_free_transaction(in_reply_to);
 	} else if (!(t->flags & TF_ONE_WAY)) {
 		BUG_ON(t->buffer->async_transaction != 0);
@@ -3860,6 +3956,13 @@ static int binder_thread_write(struct binder_proc *proc,
 						&buf_node->async_todo);
 				if (!w) {
 					buf_node->has_async_transaction = false;
+				} else if (binder_oneway_batch && ptr == end &&
+					   !thread->transaction_stack &&
+					   (thread->looper &
+					    (BINDER_LOOPER_STATE_ENTERED |
+					     BINDER_LOOPER_STATE_REGISTERED))) {
+					binder_enqueue_thread_work_ilocked(
+							thread, w);
 				} else {
 					binder_enqueue_work_ilocked(
 							w, &proc->todo);
@@ -4279,8 +4382,36 @@ static int binder_thread_read(struct binder_proc *proc,
 
 		switch (w->type) {
 		case BINDER_WORK_TRANSACTION: {
+			u64 now = ktime_get_ns(), wakeup_ns = thread->wakeup_ns;
+
+			thread->wakeup_ns = 0;
 			binder_inner_proc_unlock(proc);
 			t = container_of(w, struct binder_transaction, work);
+			/* a wakeup from before this was queued isn't for it */
+			if (wakeup_ns < t->enqueue_ns)
+				wakeup_ns = 0;
+			binder_lat_add(&proc->lat[BINDER_LAT_QUEUE],
+				       now - t->enqueue_ns);
+			if (wakeup_ns)
+				binder_lat_add(&proc->lat[BINDER_LAT_WAKEUP],
+					       now - wakeup_ns);
+			if (t->buffer->target_node &&
+			    t->buffer->target_node->lat) {
+				struct binder_node_lat *lat =
+					t->buffer->target_node->lat;
+
+				binder_lat_add(&lat->hist[BINDER_LAT_QUEUE],
+					       now - t->enqueue_ns);
+				if (wakeup_ns)
+					binder_lat_add(
+						&lat->hist[BINDER_LAT_WAKEUP],
+						now - wakeup_ns);
+				/* the reply is accounted to the node too */
+				if (!(t->flags & TF_ONE_WAY)) {
+					refcount_inc(&lat->ref);
+					t->lat = lat;
+				}
+			}
 		} break;
 		case BINDER_WORK_RETURN_ERROR: {
 			struct binder_error *e = container_of(
@@ -6000,6 +6131,63 @@ int binder_stats_show(struct seq_file *m, void *unused)
 	return 0;
 }
 
+static void print_binder_lat_hist(struct seq_file *m, const char *prefix,
+				  struct binder_lat_hist *hist)
+{
+	int i, j, last;
+
+	for (i = 0; i < BINDER_LAT_COUNT; i++) {
+		last = -1;
+		for (j = 0; j < BINDER_LAT_BUCKETS; j++)
+			if (atomic_read(&hist[i].bucket[j]))
+				last = j;
+		if (last < 0)
+			continue;
+
+		seq_printf(m, "%s%s:", prefix, binder_lat_strings[i]);
+		for (j = 0; j <= last; j++)
+			seq_printf(m, " %d", atomic_read(&hist[i].bucket[j]));
+		seq_puts(m, "\n");
+	}
+}
+
+static void print_binder_proc_lat(struct seq_file *m,
+				  struct binder_proc *proc)
+{
+	struct binder_node *node;
+	struct rb_node *n;
+
+	seq_printf(m, "proc %d\n", proc->pid);
+	seq_printf(m, "context %s\n", proc->context->name);
+	print_binder_lat_hist(m, "  ", proc->lat);
+
+	binder_inner_proc_lock(proc);
+	for (n = rb_first(&proc->nodes); n != NULL; n = rb_next(n)) {
+		node = rb_entry(n, struct binder_node, rb_node);
+		if (!node->lat)
+			continue;
+		seq_printf(m, "  node %d u%016llx c%016llx\n",
+			   node->debug_id, (u64)node->ptr, (u64)node->cookie);
+		print_binder_lat_hist(m, "    ", node->lat->hist);
+	}
+	binder_inner_proc_unlock(proc);
+}
+
+int binder_latency_show(struct seq_file *m, void *unused)
+{
+	struct binder_proc *proc;
+
+	seq_printf(m, "binder latency: log2 us buckets, %d to >= %luus\n",
+		   BINDER_LAT_BUCKETS, 1UL << (BINDER_LAT_BUCKETS - 1));
+
+	mutex_lock(&binder_procs_lock);
+	hlist_for_each_entry(proc, &binder_procs, proc_node)
+		print_binder_proc_lat(m, proc);
+	mutex_unlock(&binder_procs_lock);
+
+	return 0;
+}
+
 int binder_transactions_show(struct seq_file *m, void *unused)
 {
 	struct binder_proc *proc;
@@ -6224,6 +6412,11 @@ static int __init binder_init(void)
 				    binder_debugfs_dir_entry_root,
 				    NULL,
 				    &binder_transactions_fops);
+		debugfs_create_file("latency",
+				    0444,
+				    binder_debugfs_dir_entry_root,
+				    NULL,
+				    &binder_latency_fops);
 		debugfs_create_file("transaction_log",
 				    0444,
 				    binder_debugfs_dir_entry_root,
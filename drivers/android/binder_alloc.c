@@ -369,6 +369,59 @@ static inline struct vm_area_struct *binder_alloc_get_vma(
 	return vma;
 }
 
+static int binder_small_class(size_t size)
+{
+	if (size > BINDER_SMALL_MAX)
+		return -1;
+
+	size = max_t(size_t, size, BINDER_SMALL_MIN);
+	return order_base_2(size) - ilog2(BINDER_SMALL_MIN);
+}
+
+static struct binder_buffer *binder_small_get_locked(
+		struct binder_alloc *alloc, int class)
+{
+	struct binder_buffer *buffer;
+
+	buffer = list_first_entry_or_null(&alloc->small_free[class],
+					  struct binder_buffer, cache_entry);
+	if (!buffer) {
+		alloc->small_misses++;
+		return NULL;
+	}
+
+	list_del(&buffer->cache_entry);
+	alloc->small_count[class]--;
+	alloc->small_hits++;
+	buffer->cached = 0;
+	return buffer;
+}
+
+/*
+ * Park a freed small buffer instead of merging it. It keeps its pages and
+ * stays out of both trees; neighbours see it as allocated, so they never
+ * merge into it. Nothing is cached once the vma is gone.
+ */
+static bool binder_small_put_locked(struct binder_alloc *alloc,
+				    struct binder_buffer *buffer,
+				    size_t buffer_size)
+{
+	int class = binder_small_class(buffer_size);
+
+	if (class < 0 || (BINDER_SMALL_MIN << class) != buffer_size)
+		return false;
+
+	if (alloc->small_count[class] >= BINDER_SMALL_CACHED_MAX ||
+	    !binder_alloc_get_vma(alloc))
+		return false;
+
+	rb_erase(&buffer->rb_node, &alloc->allocated_buffers);
+	buffer->cached = 1;
+	list_add(&buffer->cache_entry, &alloc->small_free[class]);
+	alloc->small_count[class]++;
+	return true;
+}
+
 static struct binder_buffer *binder_alloc_new_buf_locked(
 				struct binder_alloc *alloc,
 				size_t data_size,
@@ -382,8 +435,8 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 	struct rb_node *best_fit = NULL;
 	void __user *has_page_addr;
 	void __user *end_page_addr;
-	size_t size, data_offsets_size;
-	int ret;
+	size_t size, req_size, data_offsets_size;
+	int class, ret;
 
 	if (!binder_alloc_get_vma(alloc)) {
 		binder_alloc_debug(BINDER_DEBUG_USER_ERROR,
@@ -418,6 +471,19 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 
 	/* Pad 0-size buffers so they get assigned unique addresses */
 	size = max(size, sizeof(void *));
+	req_size = size;
+
+	/*
+	 * Small buffers get a whole size class so they can be cached when
+	 * freed, and come straight off the class list when one is cached.
+	 */
+	class = binder_small_class(size);
+	if (class >= 0) {
+		size = BINDER_SMALL_MIN << class;
+		buffer = binder_small_get_locked(alloc, class);
+		if (buffer)
+			goto got_buffer;
+	}
 
 	while (n) {
 		buffer = rb_entry(n, struct binder_buffer, rb_node);
@@ -507,6 +573,7 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 	}
 
 	rb_erase(best_fit, &alloc->free_buffers);
+got_buffer:
 	buffer->free = 0;
 	buffer->allow_user_free = 0;
 	binder_insert_allocated_buffer_locked(alloc, buffer);
@@ -518,10 +585,11 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 	buffer->async_transaction = is_async;
 	buffer->extra_buffers_size = extra_buffers_size;
 	if (is_async) {
-		alloc->free_async_space -= size + sizeof(struct binder_buffer);
+		alloc->free_async_space -= req_size +
+			sizeof(struct binder_buffer);
 		binder_alloc_debug(BINDER_DEBUG_BUFFER_ALLOC_ASYNC,
 			     "%d: binder_alloc_buf size %zd async free %zd\n",
-			      alloc->pid, size, alloc->free_async_space);
+			      alloc->pid, req_size, alloc->free_async_space);
 	}
 	return buffer;
 
@@ -621,6 +689,36 @@ static void binder_delete_free_buffer(struct binder_alloc *alloc,
 	kmem_cache_free(binder_buffer_pool, buffer);
 }
 
+static void binder_release_buf_locked(struct binder_alloc *alloc,
+				      struct binder_buffer *buffer,
+				      size_t buffer_size)
+{
+	binder_update_page_range(alloc, 0,
+		(void __user *)PAGE_ALIGN((uintptr_t)buffer->user_data),
+		(void __user *)(((uintptr_t)
+			  buffer->user_data + buffer_size) & PAGE_MASK));
+
+	buffer->free = 1;
+	if (!list_is_last(&buffer->entry, &alloc->buffers)) {
+		struct binder_buffer *next = binder_buffer_next(buffer);
+
+		if (next->free) {
+			rb_erase(&next->rb_node, &alloc->free_buffers);
+			binder_delete_free_buffer(alloc, next);
+		}
+	}
+	if (alloc->buffers.next != &buffer->entry) {
+		struct binder_buffer *prev = binder_buffer_prev(buffer);
+
+		if (prev->free) {
+			binder_delete_free_buffer(alloc, buffer);
+			rb_erase(&prev->rb_node, &alloc->free_buffers);
+			buffer = prev;
+		}
+	}
+	binder_insert_free_buffer(alloc, buffer);
+}
+
 static void binder_free_buf_locked(struct binder_alloc *alloc,
 				   struct binder_buffer *buffer)
 {
@@ -650,31 +748,44 @@ static void binder_free_buf_locked(struct binder_alloc *alloc,
 			      alloc->pid, size, alloc->free_async_space);
 	}
 
-	binder_update_page_range(alloc, 0,
-		(void __user *)PAGE_ALIGN((uintptr_t)buffer->user_data),
-		(void __user *)(((uintptr_t)
-			  buffer->user_data + buffer_size) & PAGE_MASK));
+	if (binder_small_put_locked(alloc, buffer, buffer_size))
+		return;
 
 	rb_erase(&buffer->rb_node, &alloc->allocated_buffers);
-	buffer->free = 1;
-	if (!list_is_last(&buffer->entry, &alloc->buffers)) {
-		struct binder_buffer *next = binder_buffer_next(buffer);
+	binder_release_buf_locked(alloc, buffer, buffer_size);
+}
 
-		if (next->free) {
-			rb_erase(&next->rb_node, &alloc->free_buffers);
-			binder_delete_free_buffer(alloc, next);
-		}
-	}
-	if (alloc->buffers.next != &buffer->entry) {
-		struct binder_buffer *prev = binder_buffer_prev(buffer);
+static void binder_alloc_drain_small_locked(struct binder_alloc *alloc)
+{
+	struct binder_buffer *buffer;
+	int i;
 
-		if (prev->free) {
-			binder_delete_free_buffer(alloc, buffer);
-			rb_erase(&prev->rb_node, &alloc->free_buffers);
-			buffer = prev;
+	for (i = 0; i < BINDER_SMALL_CLASSES; i++) {
+		while (!list_empty(&alloc->small_free[i])) {
+			buffer = list_first_entry(&alloc->small_free[i],
+						  struct binder_buffer,
+						  cache_entry);
+			list_del(&buffer->cache_entry);
+			buffer->cached = 0;
+			binder_release_buf_locked(alloc, buffer,
+				binder_alloc_buffer_size(alloc, buffer));
 		}
+		alloc->small_count[i] = 0;
 	}
-	binder_insert_free_buffer(alloc, buffer);
+}
+
+/**
+ * binder_alloc_drain_small() - return cached small buffers
+ * @alloc:	binder_alloc for this proc
+ *
+ * Merge every buffer parked on the small size class lists back into the
+ * free tree and put their pages on the lru.
+ */
+void binder_alloc_drain_small(struct binder_alloc *alloc)
+{
+	mutex_lock(&alloc->mutex);
+	binder_alloc_drain_small_locked(alloc);
+	mutex_unlock(&alloc->mutex);
 }
 
 /**
@@ -775,6 +886,8 @@ void binder_alloc_deferred_release(struct binder_alloc *alloc)
 	mutex_lock(&alloc->mutex);
 	BUG_ON(alloc->vma);
 
+	binder_alloc_drain_small_locked(alloc);
+
 	while ((n = rb_first(&alloc->allocated_buffers))) {
 		buffer = rb_entry(n, struct binder_buffer, rb_node);
 
@@ -870,6 +983,7 @@ void binder_alloc_print_pages(struct seq_file *m,
 	int active = 0;
 	int lru = 0;
 	int free = 0;
+	int cached = 0;
 
 	mutex_lock(&alloc->mutex);
 	/*
@@ -887,9 +1001,13 @@ void binder_alloc_print_pages(struct seq_file *m,
 				lru++;
 		}
 	}
+	for (i = 0; i < BINDER_SMALL_CLASSES; i++)
+		cached += alloc->small_count[i];
 	mutex_unlock(&alloc->mutex);
 	seq_printf(m, "  pages: %d:%d:%d\n", active, lru, free);
 	seq_printf(m, "  pages high watermark: %zu\n", alloc->pages_high);
+	seq_printf(m, "  small buffers: %d cached, %lu hits, %lu misses\n",
+		   cached, alloc->small_hits, alloc->small_misses);
 }
 
 /**
@@ -1029,9 +1147,13 @@ static struct shrinker binder_shrinker = {
  */
 void binder_alloc_init(struct binder_alloc *alloc)
 {
+	int i;
+
 	alloc->pid = current->group_leader->pid;
 	mutex_init(&alloc->mutex);
 	INIT_LIST_HEAD(&alloc->buffers);
+	for (i = 0; i < BINDER_SMALL_CLASSES; i++)
+		INIT_LIST_HEAD(&alloc->small_free[i]);
 }
 
 int binder_alloc_shrinker_init(void)
@@ -31,9 +31,11 @@ struct binder_transaction;
  * struct binder_buffer - buffer used for binder transactions
  * @entry:              entry alloc->buffers
  * @rb_node:            node for allocated_buffers/free_buffers rb trees
+ * @cache_entry:        entry in alloc->small_free while @cached
  * @free:               %true if buffer is free
  * @allow_user_free:    %true if user is allowed to free buffer
  * @async_transaction:  %true if buffer is in use for an async txn
+ * @cached:             %true if buffer is parked on a small size class list
  * @debug_id:           unique ID for debugging
  * @transaction:        pointer to associated struct binder_transaction
  * @target_node:        struct binder_node associated with this buffer
@@ -46,12 +48,16 @@ struct binder_transaction;
  */
 struct binder_buffer {
 	struct list_head entry; /* free and allocated entries by address */
-	struct rb_node rb_node; /* free entry by size or allocated entry */
-				/* by address */
+	union {
+		struct rb_node rb_node; /* free entry by size or allocated */
+					/* entry by address */
+		struct list_head cache_entry; /* cached small buffer */
+	};
 	unsigned free:1;
 	unsigned allow_user_free:1;
 	unsigned async_transaction:1;
-	unsigned debug_id:29;
+	unsigned cached:1;
+	unsigned debug_id:28;
 
 	struct binder_transaction *transaction;
 
@@ -62,6 +68,17 @@ struct binder_buffer {
 	void __user *user_data;
 };
 
+/*
+ * Small buffers are rounded up to a power of two size class between
+ * BINDER_SMALL_MIN and BINDER_SMALL_MAX. When freed they are parked, with
+ * their pages, on a per-class list instead of being merged back, so the
+ * next allocation of that class is a list pop.
+ */
+#define BINDER_SMALL_MIN	32
+#define BINDER_SMALL_MAX	256
+#define BINDER_SMALL_CLASSES	4
+#define BINDER_SMALL_CACHED_MAX	32
+
 /**
  * struct binder_lru_page - page object used for binder shrinker
  * @page_ptr: pointer to physical page in mmap'd space
@@ -92,6 +109,10 @@ struct binder_lru_page {
  * @buffer_size:        size of address space specified via mmap
  * @pid:                pid for associated binder_proc (invariant after init)
  * @pages_high:         high watermark of offset in @pages
+ * @small_free:         cached free buffers per small size class
+ * @small_count:        number of buffers on each @small_free list
+ * @small_hits:         small allocations served from @small_free
+ * @small_misses:       small allocations that went to @free_buffers
  *
  * Bookkeeping structure for per-proc address space management for binder
  * buffers. It is normally initialized during binder_init() and binder_mmap()
@@ -112,6 +133,10 @@ struct binder_alloc {
 	uint32_t buffer_free;
 	int pid;
 	size_t pages_high;
+	struct list_head small_free[BINDER_SMALL_CLASSES];
+	unsigned int small_count[BINDER_SMALL_CLASSES];
+	unsigned long small_hits;
+	unsigned long small_misses;
 };
 
 #ifdef CONFIG_ANDROID_BINDER_IPC_SELFTEST
@@ -138,6 +163,7 @@ extern void binder_alloc_free_buf(struct binder_alloc *alloc,
 extern int binder_alloc_mmap_handler(struct binder_alloc *alloc,
 				     struct vm_area_struct *vma);
 extern void binder_alloc_deferred_release(struct binder_alloc *alloc);
+extern void binder_alloc_drain_small(struct binder_alloc *alloc);
 extern int binder_alloc_get_allocated_count(struct binder_alloc *alloc);
 extern void binder_alloc_print_allocated(struct seq_file *m,
 					 struct binder_alloc *alloc);
@@ -19,11 +19,15 @@
 
 #include <linux/mm_types.h>
 #include <linux/err.h>
+#include <linux/ktime.h>
 #include "binder_alloc.h"
 
 #define BUFFER_NUM 5
 #define BUFFER_MIN_SIZE (PAGE_SIZE / 8)
 
+#define BENCH_ITERS 10000
+#define BENCH_DEPTH 8
+
 static bool binder_selftest_run = true;
 static int binder_selftest_failures;
 static DEFINE_MUTEX(binder_selftest_lock);
@@ -147,6 +151,9 @@ static void binder_selftest_free_buf(struct binder_alloc *alloc,
 	for (i = 0; i < BUFFER_NUM; i++)
 		binder_alloc_free_buf(alloc, buffers[seq[i]]);
 
+	/* Cached small buffers keep their pages until drained */
+	binder_alloc_drain_small(alloc);
+
 	for (i = 0; i < end / PAGE_SIZE; i++) {
 		/**
 		 * Error message on a free page can be false positive
@@ -280,6 +287,56 @@ static void binder_selftest_alloc_offset(struct binder_alloc *alloc,
 	}
 }
 
+/*
+ * Alloc/free throughput and latency for a few transaction sizes, keeping
+ * BENCH_DEPTH buffers in flight like a busy server would.
+ */
+static void binder_selftest_bench_size(struct binder_alloc *alloc,
+				       size_t size)
+{
+	struct binder_buffer *buffers[BENCH_DEPTH] = { NULL };
+	u64 t, ns, total = 0, worst = 0;
+	int i, slot;
+
+	for (i = 0; i < BENCH_ITERS; i++) {
+		slot = i % BENCH_DEPTH;
+		t = ktime_get_ns();
+		if (buffers[slot])
+			binder_alloc_free_buf(alloc, buffers[slot]);
+		buffers[slot] = binder_alloc_new_buf(alloc, size, 0, 0, 0);
+		ns = ktime_get_ns() - t;
+
+		if (IS_ERR(buffers[slot])) {
+			pr_err("bench: alloc of %zu failed\n", size);
+			buffers[slot] = NULL;
+			binder_selftest_failures++;
+			break;
+		}
+		total += ns;
+		worst = max(worst, ns);
+	}
+
+	for (slot = 0; slot < BENCH_DEPTH; slot++)
+		if (buffers[slot])
+			binder_alloc_free_buf(alloc, buffers[slot]);
+	binder_alloc_drain_small(alloc);
+
+	if (i)
+		pr_info("bench: size %zu: %llu ns/op avg, %llu ns worst, %llu ops/s\n",
+			size, div64_u64(total, i), worst,
+			total ? div64_u64((u64)i * NSEC_PER_SEC, total) : 0);
+}
+
+static void binder_selftest_bench(struct binder_alloc *alloc)
+{
+	static const size_t sizes[] = { 16, 64, 256, 1024, 4 * PAGE_SIZE };
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++)
+		binder_selftest_bench_size(alloc, sizes[i]);
+	binder_selftest_free_page(alloc);
+}
+
 /**
  * binder_selftest_alloc() - Test alloc and free of buffer pages.
  * @alloc: Pointer to alloc struct.
@@ -287,7 +344,8 @@ static void binder_selftest_alloc_offset(struct binder_alloc *alloc,
  * Allocate BUFFER_NUM buffers to cover all page alignment cases,
  * then free them in all orders possible. Check that pages are
  * correctly allocated, put onto lru when buffers are freed, and
- * are freed when binder_alloc_free_page is called.
+ * are freed when binder_alloc_free_page is called. Then time the
+ * alloc/free path for a few buffer sizes.
  */
 void binder_selftest_alloc(struct binder_alloc *alloc)
 {
@@ -300,6 +358,7 @@ void binder_selftest_alloc(struct binder_alloc *alloc)
 		goto done;
 	pr_info("STARTED\n");
 	binder_selftest_alloc_offset(alloc, end_offset, 0);
+	binder_selftest_bench(alloc);
 	binder_selftest_run = false;
 	if (binder_selftest_failures > 0)
 		pr_info("%d tests FAILED\n", binder_selftest_failures);
@@ -114,6 +114,9 @@ DEFINE_SHOW_ATTRIBUTE(binder_state);
 int binder_transactions_show(struct seq_file *m, void *unused);
 DEFINE_SHOW_ATTRIBUTE(binder_transactions);
 
+int binder_latency_show(struct seq_file *m, void *unused);
+DEFINE_SHOW_ATTRIBUTE(binder_latency);
+
 int binder_transaction_log_show(struct seq_file *m, void *unused);
 DEFINE_SHOW_ATTRIBUTE(binder_transaction_log);
 
@@ -9,6 +9,7 @@
 #include <linux/mm.h>
 #include <linux/moduleparam.h>
 #include <linux/oom.h>
+#include <linux/simple_lmk.h>
 #include <linux/sort.h>
 #include <linux/vmpressure.h>
 #include <uapi/linux/sched/types.h>
@@ -46,6 +47,24 @@ static const unsigned short adjs[] = {
 	0 /* FOREGROUND_APP_ADJ */
 };
 
+/* Buckets of the kill latency histogram, in powers of two of 1 ms */
+#define NR_LATENCY_BUCKETS 11
+
+/* Index bucket value for thread groups that are being released */
+#define SLMK_BUCKET_DEAD SHRT_MIN
+
+/*
+ * Thread groups indexed by the adj band they currently fall in, where
+ * bucket i holds adjs from adjs[i + 1] up to adjs[i] - 1. Maintained on
+ * fork, exit and oom_score_adj writes so that a reclaim only has to look
+ * at the bands it actually kills from, rather than at every process.
+ */
+static struct hlist_head victim_index[ARRAY_SIZE(adjs) - 1];
+static DEFINE_SPINLOCK(victim_index_lock);
+
+static unsigned int kill_latency[NR_LATENCY_BUCKETS];
+static ktime_t pressure_start;
+
 static struct victim_info victims[MAX_VICTIMS];
 static DECLARE_WAIT_QUEUE_HEAD(oom_waitq);
 static DECLARE_COMPLETION(reclaim_done);
@@ -62,56 +81,101 @@ static int victim_size_cmp(const void *lhs_ptr, const void *rhs_ptr)
 	return rhs->size - lhs->size;
 }
 
-static bool vtsk_is_duplicate(int vlen, struct task_struct *vtsk)
+static unsigned long get_total_mm_pages(struct mm_struct *mm)
 {
+	unsigned long pages = 0;
 	int i;
 
-	for (i = 0; i < vlen; i++) {
-		if (same_thread_group(victims[i].tsk, vtsk))
-			return true;
-	}
+	for (i = 0; i < NR_MM_COUNTERS; i++)
+		pages += get_mm_counter(mm, i);
 
-	return false;
+	return pages;
 }
 
-static unsigned long get_total_mm_pages(struct mm_struct *mm)
+static int adj_to_bucket(short adj)
 {
-	unsigned long pages = 0;
 	int i;
 
-	for (i = 0; i < NR_MM_COUNTERS; i++)
-		pages += get_mm_counter(mm, i);
+	for (i = 1; i < ARRAY_SIZE(adjs); i++) {
+		if (adj >= adjs[i])
+			return i - 1;
+	}
 
-	return pages;
+	return -1;
+}
+
+static void victim_index_update(struct signal_struct *sig)
+{
+	int bucket;
+
+	if (sig->slmk_bucket == SLMK_BUCKET_DEAD)
+		return;
+
+	bucket = adj_to_bucket(READ_ONCE(sig->oom_score_adj)) + 1;
+	if (bucket == sig->slmk_bucket)
+		return;
+
+	if (sig->slmk_bucket)
+		hlist_del(&sig->slmk_node);
+	if (bucket)
+		hlist_add_head(&sig->slmk_node, &victim_index[bucket - 1]);
+	sig->slmk_bucket = bucket;
 }
 
-static unsigned long find_victims(int *vindex, unsigned short target_adj_min,
-				  unsigned short target_adj_max)
+void simple_lmk_adj_changed(struct signal_struct *sig)
 {
+	spin_lock(&victim_index_lock);
+	victim_index_update(sig);
+	spin_unlock(&victim_index_lock);
+}
+
+/* Called under tasklist_lock for each new thread group */
+void simple_lmk_task_fork(struct task_struct *p)
+{
+	if (p->flags & PF_KTHREAD)
+		return;
+
+	simple_lmk_adj_changed(p->signal);
+}
+
+/* Called under tasklist_lock when a thread group is released */
+void simple_lmk_signal_exit(struct signal_struct *sig)
+{
+	spin_lock(&victim_index_lock);
+	if (sig->slmk_bucket > 0)
+		hlist_del(&sig->slmk_node);
+	sig->slmk_bucket = SLMK_BUCKET_DEAD;
+	spin_unlock(&victim_index_lock);
+}
+
+static unsigned long find_victims(int *vindex, int bucket)
+{
+	unsigned short target_adj_min = adjs[bucket + 1];
+	unsigned short target_adj_max = adjs[bucket];
 	unsigned long pages_found = 0;
 	int old_vindex = *vindex;
-	struct task_struct *tsk;
+	struct signal_struct *sig;
 
-	for_each_process(tsk) {
-		struct signal_struct *sig;
-		struct task_struct *vtsk;
+	spin_lock(&victim_index_lock);
+	hlist_for_each_entry(sig, &victim_index[bucket], slmk_node) {
+		struct task_struct *tsk, *vtsk;
 		short adj;
 
 		/*
-		 * Search for suitable tasks with the targeted importance (adj).
-		 * Since only tasks with a positive adj can be targeted, that
-		 * naturally excludes tasks which shouldn't be killed, like init
-		 * and kthreads. Although oom_score_adj can still be changed
-		 * while this code runs, it doesn't really matter. We just need
-		 * to make sure that if the adj changes, we won't deadlock
-		 * trying to lock a task that we locked earlier.
+		 * Although oom_score_adj can still be changed while this code
+		 * runs, it doesn't really matter. The index moves a thread
+		 * group under victim_index_lock, so each one is seen at most
+		 * once and we won't deadlock trying to lock a task that we
+		 * locked earlier.
 		 */
-		sig = tsk->signal;
 		adj = READ_ONCE(sig->oom_score_adj);
 		if (adj < target_adj_min || adj > target_adj_max - 1 ||
-		    sig->flags & (SIGNAL_GROUP_EXIT | SIGNAL_GROUP_COREDUMP) ||
-		    (thread_group_empty(tsk) && tsk->flags & PF_EXITING) ||
-		    vtsk_is_duplicate(*vindex, tsk))
+		    sig->flags & (SIGNAL_GROUP_EXIT | SIGNAL_GROUP_COREDUMP))
+			continue;
+
+		tsk = list_first_or_null_rcu(&sig->thread_head,
+					     struct task_struct, thread_node);
+		if (!tsk || (thread_group_empty(tsk) && tsk->flags & PF_EXITING))
 			continue;
 
 		vtsk = find_lock_task_mm(tsk);
@@ -130,6 +194,7 @@ static unsigned long find_victims(int *vindex, unsigned short target_adj_min,
 		if (++*vindex == MAX_VICTIMS)
 			break;
 	}
+	spin_unlock(&victim_index_lock);
 
 	/*
 	 * Sort the victims in descending order of size to prioritize killing
@@ -142,6 +207,17 @@ static unsigned long find_victims(int *vindex, unsigned short target_adj_min,
 	return pages_found;
 }
 
+static void record_kill_latency(void)
+{
+	s64 ms = ktime_ms_delta(ktime_get(), pressure_start);
+	int i = 0;
+
+	while (i < NR_LATENCY_BUCKETS - 1 && ms >= (1LL << i))
+		i++;
+
+	kill_latency[i]++;
+}
+
 static int process_victims(int vlen, unsigned long pages_needed)
 {
 	unsigned long pages_found = 0;
@@ -172,10 +248,10 @@ static void scan_and_kill(unsigned long pages_needed)
 	int i, nr_to_kill = 0, nr_found = 0;
 	unsigned long pages_found = 0;
 
-	/* Hold an RCU read lock while traversing the global process list */
+	/* Hold an RCU read lock while looking at the indexed thread groups */
 	rcu_read_lock();
-	for (i = 1; i < ARRAY_SIZE(adjs); i++) {
-		pages_found += find_victims(&nr_found, adjs[i], adjs[i - 1]);
+	for (i = 0; i < ARRAY_SIZE(victim_index); i++) {
+		pages_found += find_victims(&nr_found, i);
 		if (pages_found >= pages_needed || nr_found == MAX_VICTIMS)
 			break;
 	}
@@ -237,6 +313,8 @@ static void scan_and_kill(unsigned long pages_needed)
 	/* Wait until all the victims die or until the timeout is reached */
 	if (!wait_for_completion_timeout(&reclaim_done, RECLAIM_EXPIRES))
 		pr_info("Timeout hit waiting for victims to die, proceeding\n");
+	else
+		record_kill_latency();
 
 	/* Clean up for future reclaim invocations */
 	write_lock(&mm_free_lock);
@@ -280,8 +358,10 @@ void simple_lmk_mm_freed(struct mm_struct *mm)
 static int simple_lmk_vmpressure_cb(struct notifier_block *nb,
 				    unsigned long pressure, void *data)
 {
-	if (pressure == 100 && !atomic_cmpxchg_acquire(&needs_reclaim, 0, 1))
+	if (pressure == 100 && !atomic_cmpxchg_acquire(&needs_reclaim, 0, 1)) {
+		pressure_start = ktime_get();
 		wake_up(&oom_waitq);
+	}
 
 	return NOTIFY_OK;
 }
@@ -311,7 +391,27 @@ static const struct kernel_param_ops simple_lmk_init_ops = {
 	.set = simple_lmk_init_set
 };
 
+/* Time from a critical vmpressure event until all victims freed their mm */
+static int kill_latency_get(char *buf, const struct kernel_param *kp)
+{
+	int i, len = 0;
+
+	for (i = 0; i < NR_LATENCY_BUCKETS - 1; i++)
+		len += scnprintf(buf + len, PAGE_SIZE - len, "<%ums: %u\n",
+				 1U << i, READ_ONCE(kill_latency[i]));
+	len += scnprintf(buf + len, PAGE_SIZE - len, ">=%ums: %u\n",
+			 1U << (NR_LATENCY_BUCKETS - 2),
+			 READ_ONCE(kill_latency[i]));
+
+	return len;
+}
+
+static const struct kernel_param_ops kill_latency_ops = {
+	.get = kill_latency_get
+};
+
 /* Needed to prevent Android from thinking there's no LMK and thus rebooting */
 #undef MODULE_PARAM_PREFIX
 #define MODULE_PARAM_PREFIX "lowmemorykiller."
 module_param_cb(minfree, &simple_lmk_init_ops, NULL, 0200);
+module_param_cb(kill_latency_hist, &kill_latency_ops, NULL, 0444);
@@ -28,6 +28,7 @@
 #include <linux/pm_runtime.h>
 #include <linux/pinctrl/devinfo.h>
 #include <linux/platform_device.h>
+#include <soc/qcom/boot_stats.h>
 
 #include "base.h"
 #include "power/power.h"
@@ -382,6 +383,7 @@ static int really_probe(struct device *dev, struct device_driver *drv)
 	int local_trigger_count = atomic_read(&deferred_trigger_count);
 	bool test_remove = IS_ENABLED(CONFIG_DEBUG_TEST_DRIVER_REMOVE) &&
 			   !drv->suppress_bind_attrs;
+	u64 start;
 
 	if (defer_all_probes) {
 		/*
@@ -399,6 +401,7 @@ static int really_probe(struct device *dev, struct device_driver *drv)
 		return ret;
 
 	atomic_inc(&probe_count);
+	start = ktime_get_ns();
 	pr_debug("bus: '%s': %s: probing driver %s with device %s\n",
 		 drv->bus->name, __func__, drv->name, dev_name(dev));
 	if (!list_empty(&dev->devres_head)) {
@@ -466,6 +469,7 @@ static int really_probe(struct device *dev, struct device_driver *drv)
 		dev->pm_domain->sync(dev);
 
 	driver_bound(dev);
+	boot_timing_probe(dev, drv, start, 0);
 	ret = 1;
 	pr_debug("bus: '%s': %s: bound device %s to driver %s\n",
 		 drv->bus->name, __func__, dev_name(dev), drv->name);
@@ -506,6 +510,7 @@ static int really_probe(struct device *dev, struct device_driver *drv)
 		       "%s: probe of %s failed with error %d\n",
 		       drv->name, dev_name(dev), ret);
 	}
+	boot_timing_probe(dev, drv, start, ret);
 	/*
 	 * Ignore errors returned by ->probe so that the next driver can try
 	 * its luck.
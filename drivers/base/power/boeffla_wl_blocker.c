@@ -64,6 +64,9 @@ static void build_search_string(char *list1, char *list2)
 		wl_blocker_active = true;
 	else
 		wl_blocker_active = false;
+
+	// hash the new list and mark the wakelocks already registered
+	wl_blocker_update();
 }
 
 
@@ -21,3 +21,8 @@
 #define LENGTH_LIST_WL				300
 #define LENGTH_LIST_WL_DEFAULT		239
 #define LENGTH_LIST_WL_SEARCH		LENGTH_LIST_WL + LENGTH_LIST_WL_DEFAULT + 5
+
+// wake lock names handled have maximum length=50 and minimum=1
+#define LENGTH_WL_NAME_MAX		50
+
+void wl_blocker_update(void);
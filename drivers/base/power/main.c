@@ -34,6 +34,9 @@
 #include <linux/cpufreq.h>
 #include <linux/timer.h>
 #include <linux/wakeup_reason.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
 
 #include "../base.h"
 #include "power.h"
@@ -200,18 +203,68 @@ void device_pm_move_last(struct device *dev)
 	list_move_tail(&dev->power.entry, &dpm_list);
 }
 
-static ktime_t initcall_debug_start(struct device *dev)
+/*
+ * Callbacks of the last suspend/resume cycle that took at least
+ * dpm_times_min_us, kept in a ring in debugfs pm_device_times and
+ * cleared when the next cycle starts.
+ */
+#define DPM_TIMES_SIZE		512
+#define DPM_TIMES_NAME_LEN	40
+
+struct dpm_time {
+	char		name[DPM_TIMES_NAME_LEN];
+	const char	*info;
+	int		event;
+	int		error;
+	u32		usecs;
+};
+
+static struct dpm_time *dpm_times;
+static unsigned int dpm_times_head;
+static unsigned int dpm_times_count;
+static u32 dpm_times_min_us = 100;
+static DEFINE_SPINLOCK(dpm_times_lock);
+
+static void dpm_times_record(struct device *dev, pm_message_t state,
+			     const char *info, int error, s64 nsecs)
 {
-	ktime_t calltime = 0;
+	struct dpm_time *t;
+	unsigned long flags;
+	u32 usecs = min_t(s64, nsecs / NSEC_PER_USEC, U32_MAX);
 
+	if (!dpm_times || usecs < READ_ONCE(dpm_times_min_us))
+		return;
+
+	spin_lock_irqsave(&dpm_times_lock, flags);
+	t = &dpm_times[dpm_times_head];
+	strlcpy(t->name, dev_name(dev), sizeof(t->name));
+	t->info = info;
+	t->event = state.event;
+	t->error = error;
+	t->usecs = usecs;
+	dpm_times_head = (dpm_times_head + 1) % DPM_TIMES_SIZE;
+	if (dpm_times_count < DPM_TIMES_SIZE)
+		dpm_times_count++;
+	spin_unlock_irqrestore(&dpm_times_lock, flags);
+}
+
+static void dpm_times_reset(void)
+{
+	spin_lock_irq(&dpm_times_lock);
+	dpm_times_head = 0;
+	dpm_times_count = 0;
+	spin_unlock_irq(&dpm_times_lock);
+}
+
+static ktime_t initcall_debug_start(struct device *dev)
+{
 	if (pm_print_times_enabled) {
 		pr_info("calling  %s+ @ %i, parent: %s\n",
 			dev_name(dev), task_pid_nr(current),
 			dev->parent ? dev_name(dev->parent) : "none");
-		calltime = ktime_get();
 	}
 
-	return calltime;
+	return ktime_get();
 }
 
 static void initcall_debug_report(struct device *dev, ktime_t calltime,
@@ -228,6 +281,18 @@ static void initcall_debug_report(struct device *dev, ktime_t calltime,
 		pr_info("call %s+ returned %d after %Ld usecs\n", dev_name(dev),
 			error, (unsigned long long)nsecs >> 10);
 	}
+
+	dpm_times_record(dev, state, info, error, nsecs);
+}
+
+/*
+ * With pm_async set to 2 every device is handled asynchronously, and the
+ * waits below on parents, children and device links are the only ordering.
+ */
+static bool dpm_async(struct device *dev)
+{
+	return pm_async_enabled > 1 ||
+		(pm_async_enabled && dev->power.async_suspend);
 }
 
 /**
@@ -240,7 +305,7 @@ static void dpm_wait(struct device *dev, bool async)
 	if (!dev)
 		return;
 
-	if (async || (pm_async_enabled && dev->power.async_suspend))
+	if (async || dpm_async(dev))
 		wait_for_completion(&dev->power.completion);
 }
 
@@ -619,8 +684,7 @@ static int device_resume_noirq(struct device *dev, pm_message_t state, bool asyn
 
 static bool is_async(struct device *dev)
 {
-	return dev->power.async_suspend && pm_async_enabled
-		&& !pm_trace_is_enabled();
+	return dpm_async(dev) && !pm_trace_is_enabled();
 }
 
 static void async_resume_noirq(void *data, async_cookie_t cookie)
@@ -1791,6 +1855,8 @@ int dpm_prepare(pm_message_t state)
 	trace_suspend_resume(TPS("dpm_prepare"), state.event, true);
 	might_sleep();
 
+	dpm_times_reset();
+
 	/*
 	 * Give a chance for the known devices to complete their probes, before
 	 * disable probing of devices. This sync point is important at least
@@ -1933,3 +1999,49 @@ void device_pm_check_callbacks(struct device *dev)
 		 !dev->driver->suspend && !dev->driver->resume));
 	spin_unlock_irq(&dev->power.lock);
 }
+
+static int dpm_times_show(struct seq_file *s, void *unused)
+{
+	unsigned int i, idx;
+
+	seq_puts(s, "device\tcallback\tusecs\terror\n");
+
+	spin_lock_irq(&dpm_times_lock);
+	idx = (dpm_times_head + DPM_TIMES_SIZE - dpm_times_count) %
+		DPM_TIMES_SIZE;
+	for (i = 0; i < dpm_times_count; i++) {
+		struct dpm_time *t = &dpm_times[(idx + i) % DPM_TIMES_SIZE];
+
+		seq_printf(s, "%s\t%s%s\t%u\t%d\n", t->name, t->info ?: "",
+			   pm_verb(t->event), t->usecs, t->error);
+	}
+	spin_unlock_irq(&dpm_times_lock);
+
+	return 0;
+}
+
+static int dpm_times_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dpm_times_show, NULL);
+}
+
+static const struct file_operations dpm_times_fops = {
+	.open		= dpm_times_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init dpm_times_init(void)
+{
+	dpm_times = kcalloc(DPM_TIMES_SIZE, sizeof(*dpm_times), GFP_KERNEL);
+	if (!dpm_times)
+		return -ENOMEM;
+
+	debugfs_create_file("pm_device_times", 0444, NULL, NULL,
+			    &dpm_times_fops);
+	debugfs_create_u32("pm_device_times_min_us", 0644, NULL,
+			   &dpm_times_min_us);
+	return 0;
+}
+late_initcall(dpm_times_init);
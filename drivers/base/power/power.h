@@ -151,6 +151,10 @@ extern void device_pm_move_after(struct device *, struct device *);
 extern void device_pm_move_last(struct device *);
 extern void device_pm_check_callbacks(struct device *dev);
 
+/* drivers/base/power/wakeup.c */
+extern unsigned long wakeup_source_event_count(struct wakeup_source *ws);
+extern unsigned long wakeup_source_wakeup_count(struct wakeup_source *ws);
+
 static inline bool device_pm_initialized(struct device *dev)
 {
 	return dev->power.in_dpm_list;
@@ -24,6 +24,9 @@
 #include <linux/interrupt.h>
 #include <linux/irqdesc.h>
 #include <linux/wakeup_reason.h> /*Add-HMI_M516_A01-51*/
+#include <linux/hashtable.h>
+#include <linux/percpu.h>
+#include <linux/stringhash.h>
 #include "power.h"
 
 #ifndef CONFIG_SUSPEND
@@ -39,6 +42,7 @@ bool wl_blocker_active = false;
 bool wl_blocker_debug = false;
 
 static void wakeup_source_deactivate(struct wakeup_source *ws);
+static bool wl_blocker_lookup(const char *name);
 #endif
 
 /*
@@ -168,7 +172,7 @@ static void wakeup_source_record(struct wakeup_source *ws)
 
 	spin_lock_irqsave(&deleted_ws.lock, flags);
 
-	if (ws->event_count) {
+	if (wakeup_source_event_count(ws)) {
 		deleted_ws.total_time =
 			ktime_add(deleted_ws.total_time, ws->total_time);
 		deleted_ws.prevent_sleep_time =
@@ -177,11 +181,11 @@ static void wakeup_source_record(struct wakeup_source *ws)
 		deleted_ws.max_time =
 			ktime_compare(deleted_ws.max_time, ws->max_time) > 0 ?
 				deleted_ws.max_time : ws->max_time;
-		deleted_ws.event_count += ws->event_count;
+		deleted_ws.event_count += wakeup_source_event_count(ws);
 		deleted_ws.active_count += ws->active_count;
 		deleted_ws.relax_count += ws->relax_count;
 		deleted_ws.expire_count += ws->expire_count;
-		deleted_ws.wakeup_count += ws->wakeup_count;
+		deleted_ws.wakeup_count += wakeup_source_wakeup_count(ws);
 	}
 
 	spin_unlock_irqrestore(&deleted_ws.lock, flags);
@@ -225,8 +229,14 @@ void wakeup_source_add(struct wakeup_source *ws)
 	spin_lock_init(&ws->lock);
 	setup_timer(&ws->timer, pm_wakeup_timer_fn, (unsigned long)ws);
 	ws->active = false;
+	/* Callers may be atomic; without the counters all events are locked */
+	ws->pcpu = alloc_percpu_gfp(struct wakeup_source_pcpu,
+				    GFP_NOWAIT | __GFP_NOWARN);
 
 	spin_lock_irqsave(&events_lock, flags);
+#ifdef CONFIG_BOEFFLA_WL_BLOCKER
+	ws->wl_blocked = wl_blocker_lookup(ws->name);
+#endif
 	list_add_rcu(&ws->entry, &wakeup_sources);
 	spin_unlock_irqrestore(&events_lock, flags);
 }
@@ -254,9 +264,47 @@ void wakeup_source_remove(struct wakeup_source *ws)
 	 * this wakeup source as not registered.
 	 */
 	ws->timer.function = NULL;
+
+	if (ws->pcpu) {
+		struct wakeup_source_pcpu __percpu *pcpu = ws->pcpu;
+		unsigned long flags;
+
+		spin_lock_irqsave(&ws->lock, flags);
+		ws->event_count = wakeup_source_event_count(ws);
+		ws->wakeup_count = wakeup_source_wakeup_count(ws);
+		ws->pcpu = NULL;
+		spin_unlock_irqrestore(&ws->lock, flags);
+		free_percpu(pcpu);
+	}
 }
 EXPORT_SYMBOL_GPL(wakeup_source_remove);
 
+unsigned long wakeup_source_event_count(struct wakeup_source *ws)
+{
+	unsigned long count = READ_ONCE(ws->event_count);
+	int cpu;
+
+	if (ws->pcpu)
+		for_each_possible_cpu(cpu)
+			count += READ_ONCE(per_cpu_ptr(ws->pcpu,
+						       cpu)->event_count);
+
+	return count;
+}
+
+unsigned long wakeup_source_wakeup_count(struct wakeup_source *ws)
+{
+	unsigned long count = READ_ONCE(ws->wakeup_count);
+	int cpu;
+
+	if (ws->pcpu)
+		for_each_possible_cpu(cpu)
+			count += READ_ONCE(per_cpu_ptr(ws->pcpu,
+						       cpu)->wakeup_count);
+
+	return count;
+}
+
 /**
  * wakeup_source_register - Create wakeup source and add it to the list.
  * @dev: Device this wakeup source is associated with (or NULL if virtual).
@@ -609,12 +657,97 @@ static void wakeup_source_activate(struct wakeup_source *ws)
 }
 
 #ifdef CONFIG_BOEFFLA_WL_BLOCKER
+/*
+ * The search list is split into a hash of names whenever it is rewritten,
+ * and every wakeup source carries the result of its lookup, so activating
+ * a wakelock costs a single flag test rather than a scan of the list.
+ */
+#define WL_BLOCKER_HASH_BITS	6
+
+struct wl_blocker_entry {
+	struct hlist_node node;
+	const char *name;
+	unsigned int len;
+};
+
+static DEFINE_HASHTABLE(wl_blocker_hash, WL_BLOCKER_HASH_BITS);
+// names and entries of the current hash, protected by events_lock
+static char *wl_blocker_names;
+static struct wl_blocker_entry *wl_blocker_entries;
+
+static bool wl_blocker_lookup(const char *name)
+{
+	struct wl_blocker_entry *e;
+	unsigned int len = strlen(name);
+	u32 hash;
+
+	if (!wl_blocker_entries || len < 1 || len > LENGTH_WL_NAME_MAX)
+		return false;
+
+	hash = full_name_hash(NULL, name, len);
+	hash_for_each_possible(wl_blocker_hash, e, node, hash)
+		if (e->len == len && !memcmp(e->name, name, len))
+			return true;
+
+	return false;
+}
+
+// AP: rebuild the hash from list_wl_search and mark all wakeup sources
+void wl_blocker_update(void)
+{
+	struct wl_blocker_entry *entries = NULL, *old_entries;
+	struct wakeup_source *ws;
+	char *names, *old_names, *p, *tok;
+	unsigned long flags;
+	unsigned int n = 0;
+
+	names = kstrdup(list_wl_search, GFP_KERNEL);
+	if (!names)
+		return;
+
+	// a list of N names has at most N + 1 separators
+	for (p = names; *p; p++)
+		if (*p == ';')
+			n++;
+
+	entries = kcalloc(n + 1, sizeof(*entries), GFP_KERNEL);
+	if (!entries) {
+		kfree(names);
+		return;
+	}
+
+	spin_lock_irqsave(&events_lock, flags);
+	old_names = wl_blocker_names;
+	old_entries = wl_blocker_entries;
+	hash_init(wl_blocker_hash);
+
+	n = 0;
+	p = names;
+	while ((tok = strsep(&p, ";")) != NULL) {
+		struct wl_blocker_entry *e = &entries[n];
+
+		if (!*tok)
+			continue;
+		e->name = tok;
+		e->len = strlen(tok);
+		hash_add(wl_blocker_hash, &e->node,
+			 full_name_hash(NULL, tok, e->len));
+		n++;
+	}
+	wl_blocker_names = names;
+	wl_blocker_entries = entries;
+
+	list_for_each_entry(ws, &wakeup_sources, entry)
+		ws->wl_blocked = wl_blocker_lookup(ws->name);
+	spin_unlock_irqrestore(&events_lock, flags);
+
+	kfree(old_entries);
+	kfree(old_names);
+}
+
 // AP: Function to check if a wakelock is on the wakelock blocker list
 static bool check_for_block(struct wakeup_source *ws)
 {
-	char wakelock_name[52] = {0};
-	int length;
-
 	// if debug mode on, print every wakelock requested
 	if (wl_blocker_debug)
 		printk("Boeffla WL blocker: %s requested\n", ws->name);
@@ -626,15 +759,8 @@ static bool check_for_block(struct wakeup_source *ws)
 	// only if ws structure is valid
 	if (ws)
 	{
-		// wake lock names handled have maximum length=50 and minimum=1
-		length = strlen(ws->name);
-		if ((length > 50) || (length < 1))
-			return false;
-
 		// check if wakelock is in wake lock list to be blocked
-		sprintf(wakelock_name, ";%s;", ws->name);
-
-		if(strstr(list_wl_search, wakelock_name) == NULL)
+		if (!ws->wl_blocked)
 			return false;
 
 		// wake lock is in list, print it if debug mode on
@@ -685,6 +811,29 @@ static void wakeup_source_report_event(struct wakeup_source *ws, bool hard)
 #endif
 }
 
+/*
+ * An event on a source that is already active without a timeout changes
+ * nothing but its counters, so count it on this cpu without the lock. If
+ * the source is deactivated concurrently, that is as if the deactivation
+ * came right after this event.
+ */
+static bool wakeup_source_report_active(struct wakeup_source *ws)
+{
+	if (!ws->pcpu || !READ_ONCE(ws->active) || READ_ONCE(ws->timer_expires))
+		return false;
+#ifdef CONFIG_BOEFFLA_WL_BLOCKER
+	if (wl_blocker_debug || READ_ONCE(ws->wl_blocked))
+		return false;
+#endif
+
+	this_cpu_inc(ws->pcpu->event_count);
+	/* This is racy, but the counter is approximate anyway. */
+	if (events_check_enabled)
+		this_cpu_inc(ws->pcpu->wakeup_count);
+
+	return true;
+}
+
 /**
  * __pm_stay_awake - Notify the PM core of a wakeup event.
  * @ws: Wakeup source object associated with the source of the event.
@@ -698,6 +847,9 @@ void __pm_stay_awake(struct wakeup_source *ws)
 	if (!ws)
 		return;
 
+	if (wakeup_source_report_active(ws))
+		return;
+
 	spin_lock_irqsave(&ws->lock, flags);
 
 	wakeup_source_report_event(ws, false);
@@ -1199,8 +1351,8 @@ static int print_wakeup_source_stats(struct seq_file *m,
 	}
 
 	seq_printf(m, "%-32s\t%lu\t\t%lu\t\t%lu\t\t%lu\t\t%lld\t\t%lld\t\t%lld\t\t%lld\t\t%lld\n",
-		   ws->name, active_count, ws->event_count,
-		   ws->wakeup_count, ws->expire_count,
+		   ws->name, active_count, wakeup_source_event_count(ws),
+		   wakeup_source_wakeup_count(ws), ws->expire_count,
 		   ktime_to_ms(active_time), ktime_to_ms(total_time),
 		   ktime_to_ms(max_time), ktime_to_ms(ws->last_time),
 		   ktime_to_ms(prevent_sleep_time));
@@ -30,9 +30,19 @@ static ssize_t _name##_show(struct device *dev,				\
 }									\
 static DEVICE_ATTR_RO(_name)
 
+#define wakeup_sum_attr(_name)						\
+static ssize_t _name##_show(struct device *dev,				\
+			    struct device_attribute *attr, char *buf)	\
+{									\
+	struct wakeup_source *ws = dev_get_drvdata(dev);		\
+									\
+	return sprintf(buf, "%lu\n", wakeup_source_##_name(ws));	\
+}									\
+static DEVICE_ATTR_RO(_name)
+
 wakeup_attr(active_count);
-wakeup_attr(event_count);
-wakeup_attr(wakeup_count);
+wakeup_sum_attr(event_count);
+wakeup_sum_attr(wakeup_count);
 wakeup_attr(expire_count);
 
 static ssize_t active_time_ms_show(struct device *dev,
@@ -8,8 +8,11 @@
  */
 
 #include <linux/vmalloc.h>
-#include <linux/jhash.h>
+#include <linux/xxhash.h>
 #include <linux/highmem.h>
+#include <linux/log2.h>
+#include <linux/rcupdate.h>
+#include <linux/sched/clock.h>
 
 #include "zram_drv.h"
 
@@ -28,9 +31,40 @@ u64 zram_dedup_meta_size(struct zram *zram)
 	return (u64)atomic64_read(&zram->stats.meta_data_size);
 }
 
+u64 zram_dedup_hits(struct zram *zram)
+{
+	return (u64)atomic64_read(&zram->stats.dedup_hits);
+}
+
+u64 zram_dedup_misses(struct zram *zram)
+{
+	return (u64)atomic64_read(&zram->stats.dedup_misses);
+}
+
+u64 zram_dedup_time(struct zram *zram)
+{
+	return (u64)atomic64_read(&zram->stats.dedup_time);
+}
+
+static inline struct zram_hash *zram_dedup_bucket(struct zram *zram,
+				u32 checksum)
+{
+	return &zram->hash[checksum & (zram->hash_size - 1)];
+}
+
+/*
+ * The checksum only picks a candidate; every hit is still confirmed
+ * with a full compare, so a fast non-cryptographic hash is enough.
+ */
 static u32 zram_dedup_checksum(unsigned char *mem)
 {
-	return jhash(mem, PAGE_SIZE, 0);
+#if BITS_PER_LONG == 64
+	u64 h = xxh64(mem, PAGE_SIZE, 0);
+
+	return (u32)(h ^ (h >> 32));
+#else
+	return xxh32(mem, PAGE_SIZE, 0);
+#endif
 }
 
 void zram_dedup_insert(struct zram *zram, struct zram_entry *new,
@@ -45,7 +79,7 @@ void zram_dedup_insert(struct zram *zram, struct zram_entry *new,
 		return;
 
 	new->checksum = checksum;
-	hash = &zram->hash[checksum % zram->hash_size];
+	hash = zram_dedup_bucket(zram, checksum);
 	rb_root = &hash->rb_root;
 
 	spin_lock(&hash->lock);
@@ -61,7 +95,7 @@ void zram_dedup_insert(struct zram *zram, struct zram_entry *new,
 			rb_node = &parent->rb_left;
 	}
 
-	rb_link_node(&new->rb_node, parent, rb_node);
+	rb_link_node_rcu(&new->rb_node, parent, rb_node);
 	rb_insert_color(&new->rb_node, rb_root);
 	spin_unlock(&hash->lock);
 }
@@ -91,23 +125,25 @@ static unsigned long zram_dedup_put(struct zram *zram,
 				struct zram_entry *entry)
 {
 	struct zram_hash *hash;
-	u32 checksum;
-	unsigned long val;
 
-	checksum = entry->checksum;
-	hash = &zram->hash[checksum % zram->hash_size];
+	/* Dropping a non-final reference doesn't touch the tree */
+	if (atomic_long_add_unless(&entry->refcount, -1, 1)) {
+		atomic64_sub(entry->len, &zram->stats.dup_data_size);
+		return 1;
+	}
 
-	spin_lock(&hash->lock);
+	hash = zram_dedup_bucket(zram, entry->checksum);
 
-	val = --entry->refcount;
-	if (!entry->refcount)
+	spin_lock(&hash->lock);
+	if (atomic_long_dec_and_test(&entry->refcount)) {
 		rb_erase(&entry->rb_node, &hash->rb_root);
-	else
-		atomic64_sub(entry->len, &zram->stats.dup_data_size);
-
+		spin_unlock(&hash->lock);
+		return 0;
+	}
 	spin_unlock(&hash->lock);
+	atomic64_sub(entry->len, &zram->stats.dup_data_size);
 
-	return val;
+	return 1;
 }
 
 static struct zram_entry *__zram_dedup_get(struct zram *zram,
@@ -127,7 +163,8 @@ static struct zram_entry *__zram_dedup_get(struct zram *zram,
 	}
 
 again:
-	entry->refcount++;
+	/* Entries in the tree have refcount >= 1 while hash->lock is held */
+	atomic_long_inc(&entry->refcount);
 	atomic64_add(entry->len, &zram->stats.dup_data_size);
 	spin_unlock(&hash->lock);
 
@@ -155,6 +192,47 @@ static struct zram_entry *__zram_dedup_get(struct zram *zram,
 	return NULL;
 }
 
+/*
+ * Lockless lookup. rbtree updates are done with WRITE_ONCE() so a
+ * concurrent walk can only miss a node, never loop; entries are freed
+ * after a grace period, so a dead one just fails inc_not_zero. Only
+ * the first node with this checksum is tried here; real collisions
+ * fall back to the locked walk in zram_dedup_get().
+ */
+static struct zram_entry *zram_dedup_get_fast(struct zram *zram,
+				struct zram_hash *hash, unsigned char *mem,
+				u32 checksum)
+{
+	struct zram_entry *entry = NULL;
+	struct rb_node *rb_node;
+
+	rcu_read_lock();
+	rb_node = rcu_dereference_raw(hash->rb_root.rb_node);
+	while (rb_node) {
+		entry = rb_entry(rb_node, struct zram_entry, rb_node);
+		if (checksum == entry->checksum)
+			break;
+
+		if (checksum < entry->checksum)
+			rb_node = rcu_dereference_raw(rb_node->rb_left);
+		else
+			rb_node = rcu_dereference_raw(rb_node->rb_right);
+	}
+
+	if (!rb_node || !atomic_long_inc_not_zero(&entry->refcount)) {
+		rcu_read_unlock();
+		return NULL;
+	}
+	rcu_read_unlock();
+
+	atomic64_add(entry->len, &zram->stats.dup_data_size);
+	if (zram_dedup_match(zram, entry, mem))
+		return entry;
+
+	zram_entry_free(zram, entry);
+	return NULL;
+}
+
 static struct zram_entry *zram_dedup_get(struct zram *zram,
 				unsigned char *mem, u32 checksum)
 {
@@ -162,7 +240,11 @@ static struct zram_entry *zram_dedup_get(struct zram *zram,
 	struct zram_entry *entry;
 	struct rb_node *rb_node;
 
-	hash = &zram->hash[checksum % zram->hash_size];
+	hash = zram_dedup_bucket(zram, checksum);
+
+	entry = zram_dedup_get_fast(zram, hash, mem, checksum);
+	if (entry)
+		return entry;
 
 	spin_lock(&hash->lock);
 	rb_node = hash->rb_root.rb_node;
@@ -186,16 +268,24 @@ struct zram_entry *zram_dedup_find(struct zram *zram, struct page *page,
 {
 	void *mem;
 	struct zram_entry *entry;
+	u64 start;
 
 	if (!zram_dedup_enabled(zram))
 		return NULL;
 
+	start = local_clock();
 	mem = kmap_atomic(page);
 	*checksum = zram_dedup_checksum(mem);
 
 	entry = zram_dedup_get(zram, mem, *checksum);
 	kunmap_atomic(mem);
 
+	if (entry)
+		atomic64_inc(&zram->stats.dedup_hits);
+	else
+		atomic64_inc(&zram->stats.dedup_misses);
+	atomic64_add(local_clock() - start, &zram->stats.dedup_time);
+
 	return entry;
 }
 
@@ -206,7 +296,7 @@ void zram_dedup_init_entry(struct zram *zram, struct zram_entry *entry,
 		return;
 
 	entry->handle = handle;
-	entry->refcount = 1;
+	atomic_long_set(&entry->refcount, 1);
 	entry->len = len;
 }
 
@@ -232,6 +322,8 @@ int zram_dedup_init(struct zram *zram, size_t num_pages)
 	zram->hash_size = num_pages >> ZRAM_HASH_SHIFT;
 	zram->hash_size = min_t(size_t, ZRAM_HASH_SIZE_MAX, zram->hash_size);
 	zram->hash_size = max_t(size_t, ZRAM_HASH_SIZE_MIN, zram->hash_size);
+	/* buckets are picked by masking the checksum */
+	zram->hash_size = rounddown_pow_of_two(zram->hash_size);
 	zram->hash = vzalloc(zram->hash_size * sizeof(struct zram_hash));
 	if (!zram->hash) {
 		pr_err("Error allocating zram entry hash\n");
@@ -8,6 +8,9 @@ struct zram_entry;
 
 u64 zram_dedup_dup_size(struct zram *zram);
 u64 zram_dedup_meta_size(struct zram *zram);
+u64 zram_dedup_hits(struct zram *zram);
+u64 zram_dedup_misses(struct zram *zram);
+u64 zram_dedup_time(struct zram *zram);
 
 void zram_dedup_insert(struct zram *zram, struct zram_entry *new,
 				u32 checksum);
@@ -24,6 +27,9 @@ void zram_dedup_fini(struct zram *zram);
 
 static inline u64 zram_dedup_dup_size(struct zram *zram) { return 0; }
 static inline u64 zram_dedup_meta_size(struct zram *zram) { return 0; }
+static inline u64 zram_dedup_hits(struct zram *zram) { return 0; }
+static inline u64 zram_dedup_misses(struct zram *zram) { return 0; }
+static inline u64 zram_dedup_time(struct zram *zram) { return 0; }
 
 static inline void zram_dedup_insert(struct zram *zram, struct zram_entry *new,
 			u32 checksum) { }
@@ -33,6 +33,9 @@
 #include <linux/sysfs.h>
 #include <linux/debugfs.h>
 #include <linux/cpuhotplug.h>
+#include <linux/delay.h>
+#include <linux/sched/stat.h>
+#include <linux/msm_drm_notify.h>
 
 #include "zram_drv.h"
 
@@ -399,6 +402,46 @@ static ssize_t writeback_limit_show(struct device *dev,
 	return scnprintf(buf, PAGE_SIZE, "%llu\n", val);
 }
 
+static struct zram_wb_ra *zram_wb_ra_alloc(void)
+{
+	struct zram_wb_ra *ra;
+	int i;
+
+	ra = kzalloc(sizeof(*ra), GFP_KERNEL);
+	if (!ra)
+		return NULL;
+
+	spin_lock_init(&ra->lock);
+	for (i = 0; i < ZRAM_WB_RA_PAGES; i++) {
+		ra->pages[i] = alloc_page(GFP_KERNEL);
+		if (!ra->pages[i])
+			goto fail;
+	}
+
+	return ra;
+fail:
+	while (i--)
+		__free_page(ra->pages[i]);
+	kfree(ra);
+	return NULL;
+}
+
+static void zram_wb_ra_free(struct zram_wb_ra *ra)
+{
+	int i;
+
+	if (!ra)
+		return;
+
+	/* The window pages are the bio's buffers until it completes */
+	while (READ_ONCE(ra->state) == ZRAM_RA_INFLIGHT)
+		msleep(1);
+
+	for (i = 0; i < ZRAM_WB_RA_PAGES; i++)
+		__free_page(ra->pages[i]);
+	kfree(ra);
+}
+
 static void reset_bdev(struct zram *zram)
 {
 	struct block_device *bdev;
@@ -418,6 +461,9 @@ static void reset_bdev(struct zram *zram)
 
 	kvfree(zram->bitmap);
 	zram->bitmap = NULL;
+
+	zram_wb_ra_free(zram->wb_ra);
+	zram->wb_ra = NULL;
 }
 
 static ssize_t backing_dev_show(struct device *dev,
@@ -460,6 +506,7 @@ static ssize_t backing_dev_store(struct device *dev,
 	struct address_space *mapping;
 	unsigned int bitmap_sz, old_block_size = 0;
 	unsigned long nr_pages, *bitmap = NULL;
+	struct zram_wb_ra *wb_ra = NULL;
 	struct block_device *bdev = NULL;
 	int err;
 	struct zram *zram = dev_to_zram(dev);
@@ -512,6 +559,9 @@ static ssize_t backing_dev_store(struct device *dev,
 		goto out;
 	}
 
+	/* read-ahead is an optimisation only, go on without it */
+	wb_ra = zram_wb_ra_alloc();
+
 	old_block_size = block_size(bdev);
 	err = set_blocksize(bdev, PAGE_SIZE);
 	if (err)
@@ -524,6 +574,7 @@ static ssize_t backing_dev_store(struct device *dev,
 	zram->backing_dev = backing_dev;
 	zram->bitmap = bitmap;
 	zram->nr_pages = nr_pages;
+	zram->wb_ra = wb_ra;
 	up_write(&zram->init_lock);
 
 	pr_info("setup backing device %s\n", file_name);
@@ -531,6 +582,8 @@ static ssize_t backing_dev_store(struct device *dev,
 
 	return len;
 out:
+	zram_wb_ra_free(wb_ra);
+
 	if (bitmap)
 		kvfree(bitmap);
 
@@ -563,10 +616,44 @@ static unsigned long alloc_block_bdev(struct zram *zram)
 	return blk_idx;
 }
 
+/*
+ * Extend a batch: claim the block right after @blk_idx so the batch
+ * stays contiguous on the backing device. Returns 0 if it is taken.
+ */
+static unsigned long alloc_block_bdev_next(struct zram *zram,
+					unsigned long blk_idx)
+{
+	blk_idx++;
+	if (blk_idx >= zram->nr_pages)
+		return 0;
+
+	if (test_and_set_bit(blk_idx, zram->bitmap))
+		return 0;
+
+	atomic64_inc(&zram->stats.bd_count);
+	return blk_idx;
+}
+
+static void zram_wb_ra_invalidate(struct zram *zram, unsigned long blk_idx)
+{
+	struct zram_wb_ra *ra = zram->wb_ra;
+	unsigned long flags;
+
+	if (!ra)
+		return;
+
+	spin_lock_irqsave(&ra->lock, flags);
+	if (blk_idx >= ra->start && blk_idx < ra->start + ra->nr)
+		__clear_bit(blk_idx - ra->start, &ra->valid);
+	spin_unlock_irqrestore(&ra->lock, flags);
+}
+
 static void free_block_bdev(struct zram *zram, unsigned long blk_idx)
 {
 	int was_set;
 
+	zram_wb_ra_invalidate(zram, blk_idx);
+
 	was_set = test_and_clear_bit(blk_idx, zram->bitmap);
 	WARN_ON_ONCE(!was_set);
 	atomic64_dec(&zram->stats.bd_count);
@@ -581,6 +668,115 @@ static void zram_page_end_io(struct bio *bio)
 	bio_put(bio);
 }
 
+/*
+ * Swap-in of written back pages tends to walk neighbouring slots, and
+ * writeback lays those out contiguously. So when a block is read back,
+ * the blocks following it are read into a small per-device window and
+ * later faults on them are served with a memcpy instead of an I/O.
+ * Blocks are dropped from the window when freed or rewritten.
+ */
+static bool zram_wb_ra_read(struct zram *zram, struct bio_vec *bvec,
+				unsigned long blk_idx)
+{
+	struct zram_wb_ra *ra = zram->wb_ra;
+	unsigned long flags;
+	bool hit = false;
+
+	if (!ra)
+		return false;
+
+	spin_lock_irqsave(&ra->lock, flags);
+	if (ra->state == ZRAM_RA_READY && blk_idx >= ra->start &&
+			blk_idx < ra->start + ra->nr &&
+			test_bit(blk_idx - ra->start, &ra->valid)) {
+		void *src = kmap_atomic(ra->pages[blk_idx - ra->start]);
+		void *dst = kmap_atomic(bvec->bv_page);
+
+		memcpy(dst + bvec->bv_offset, src, bvec->bv_len);
+		kunmap_atomic(dst);
+		kunmap_atomic(src);
+		hit = true;
+	}
+	spin_unlock_irqrestore(&ra->lock, flags);
+
+	if (hit)
+		atomic64_inc(&zram->stats.bd_ra_hits);
+	return hit;
+}
+
+static void zram_wb_ra_end_io(struct bio *bio)
+{
+	struct zram_wb_ra *ra = bio->bi_private;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ra->lock, flags);
+	if (bio->bi_status) {
+		ra->valid = 0;
+		ra->state = ZRAM_RA_IDLE;
+	} else {
+		ra->state = ZRAM_RA_READY;
+	}
+	spin_unlock_irqrestore(&ra->lock, flags);
+	bio_put(bio);
+}
+
+static void zram_wb_ra_start(struct zram *zram, unsigned long blk_idx)
+{
+	struct zram_wb_ra *ra = zram->wb_ra;
+	unsigned long flags, start = blk_idx + 1;
+	unsigned int i, nr = 0;
+	struct bio *bio;
+
+	if (!ra)
+		return;
+
+	spin_lock_irqsave(&ra->lock, flags);
+	if (ra->state == ZRAM_RA_INFLIGHT ||
+			(ra->state == ZRAM_RA_READY && ra->start == start)) {
+		spin_unlock_irqrestore(&ra->lock, flags);
+		return;
+	}
+
+	while (nr < ZRAM_WB_RA_PAGES && start + nr < zram->nr_pages &&
+			test_bit(start + nr, zram->bitmap))
+		nr++;
+
+	if (!nr) {
+		spin_unlock_irqrestore(&ra->lock, flags);
+		return;
+	}
+
+	ra->state = ZRAM_RA_INFLIGHT;
+	ra->start = start;
+	ra->nr = nr;
+	ra->valid = BIT(nr) - 1;
+	spin_unlock_irqrestore(&ra->lock, flags);
+
+	bio = bio_alloc(GFP_ATOMIC, nr);
+	if (!bio)
+		goto fail;
+
+	bio->bi_iter.bi_sector = start * (PAGE_SIZE >> 9);
+	bio_set_dev(bio, zram->bdev);
+	bio->bi_opf = REQ_OP_READ | REQ_RAHEAD;
+	bio->bi_end_io = zram_wb_ra_end_io;
+	bio->bi_private = ra;
+	for (i = 0; i < nr; i++) {
+		if (!bio_add_page(bio, ra->pages[i], PAGE_SIZE, 0)) {
+			bio_put(bio);
+			goto fail;
+		}
+	}
+
+	submit_bio(bio);
+	return;
+fail:
+	spin_lock_irqsave(&ra->lock, flags);
+	ra->valid = 0;
+	ra->state = ZRAM_RA_IDLE;
+	spin_unlock_irqrestore(&ra->lock, flags);
+}
+
 /*
  * Returns 1 if the submission is successful.
  */
@@ -615,76 +811,140 @@ static int read_from_bdev_async(struct zram *zram, struct bio_vec *bvec,
 #define HUGE_WRITEBACK 1
 #define IDLE_WRITEBACK 2
 
-static ssize_t writeback_store(struct device *dev,
-		struct device_attribute *attr, const char *buf, size_t len)
-{
-	struct zram *zram = dev_to_zram(dev);
-	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
-	unsigned long index;
-	struct bio bio;
-	struct bio_vec bio_vec;
-	struct page *page;
-	ssize_t ret, sz;
-	char mode_buf[8];
-	int mode = -1;
-	unsigned long blk_idx = 0;
+/* Pages gathered into one contiguous write bio */
+#define ZRAM_WB_BATCH_PAGES	32
 
-	sz = strscpy(mode_buf, buf, sizeof(mode_buf));
-	if (sz <= 0)
-		return -EINVAL;
+struct zram_wb_batch {
+	unsigned long blk_start;
+	unsigned int nr;
+	u32 index[ZRAM_WB_BATCH_PAGES];
+	struct page *pages[ZRAM_WB_BATCH_PAGES];
+};
 
-	/* ignore trailing newline */
-	if (mode_buf[sz - 1] == '\n')
-		mode_buf[sz - 1] = 0x00;
+static void zram_wb_abort_slot(struct zram *zram, u32 index)
+{
+	zram_slot_lock(zram, index);
+	zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+	zram_clear_flag(zram, index, ZRAM_IDLE);
+	zram_slot_unlock(zram, index);
+}
 
-	if (!strcmp(mode_buf, "idle"))
-		mode = IDLE_WRITEBACK;
-	else if (!strcmp(mode_buf, "huge"))
-		mode = HUGE_WRITEBACK;
+/*
+ * Write out a batch with a single bio and switch every slot that was not
+ * touched meanwhile over to its block. Blocks of slots that changed are
+ * given back. As before, an I/O error only skips the affected pages.
+ */
+static void zram_wb_flush(struct zram *zram, struct zram_wb_batch *wb)
+{
+	struct bio *bio;
+	unsigned int i;
+	int ret = -ENOMEM;
 
-	if (mode == -1)
-		return -EINVAL;
+	if (!wb->nr)
+		return;
 
-	down_read(&zram->init_lock);
-	if (!init_done(zram)) {
-		ret = -EINVAL;
-		goto release_init_lock;
+	bio = bio_alloc(GFP_KERNEL, wb->nr);
+	if (bio) {
+		bio_set_dev(bio, zram->bdev);
+		bio->bi_iter.bi_sector = wb->blk_start * (PAGE_SIZE >> 9);
+		bio->bi_opf = REQ_OP_WRITE | REQ_SYNC;
+		for (i = 0; i < wb->nr; i++)
+			bio_add_page(bio, wb->pages[i], PAGE_SIZE, 0);
+
+		ret = submit_bio_wait(bio);
+		bio_put(bio);
 	}
 
-	if (!zram->backing_dev) {
-		ret = -ENODEV;
-		goto release_init_lock;
+	for (i = 0; i < wb->nr; i++) {
+		u32 index = wb->index[i];
+		unsigned long blk_idx = wb->blk_start + i;
+
+		if (ret) {
+			zram_wb_abort_slot(zram, index);
+			free_block_bdev(zram, blk_idx);
+			continue;
+		}
+
+		atomic64_inc(&zram->stats.bd_writes);
+		/* a read-ahead may have raced with the write above */
+		zram_wb_ra_invalidate(zram, blk_idx);
+		/*
+		 * We released zram_slot_lock so need to check if the slot was
+		 * changed. If there is freeing for the slot, we can catch it
+		 * easily by zram_allocated.
+		 * A subtle case is the slot is freed/reallocated/marked as
+		 * ZRAM_IDLE again. To close the race, idle_store doesn't
+		 * mark ZRAM_IDLE once it found the slot was ZRAM_UNDER_WB.
+		 * Thus, we could close the race by checking ZRAM_IDLE bit.
+		 */
+		zram_slot_lock(zram, index);
+		if (!zram_allocated(zram, index) ||
+			  !zram_test_flag(zram, index, ZRAM_IDLE)) {
+			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+			zram_clear_flag(zram, index, ZRAM_IDLE);
+			zram_slot_unlock(zram, index);
+			free_block_bdev(zram, blk_idx);
+			continue;
+		}
+
+		zram_free_page(zram, index);
+		zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+		zram_set_flag(zram, index, ZRAM_WB);
+		zram_set_element(zram, index, blk_idx);
+		atomic64_inc(&zram->stats.pages_stored);
+		spin_lock(&zram->wb_limit_lock);
+		if (zram->wb_limit_enable && zram->bd_wb_limit > 0)
+			zram->bd_wb_limit -=  1UL << (PAGE_SHIFT - 12);
+		spin_unlock(&zram->wb_limit_lock);
+		zram_slot_unlock(zram, index);
 	}
 
-	page = alloc_page(GFP_KERNEL);
-	if (!page) {
-		ret = -ENOMEM;
-		goto release_init_lock;
+	wb->nr = 0;
+}
+
+/*
+ * Write @mode pages back to the backing device in contiguous batches.
+ * Stops early once @budget_ns (if non-zero) has been spent.
+ * Caller must hold init_lock for read.
+ */
+static int zram_writeback(struct zram *zram, int mode, u64 budget_ns)
+{
+	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
+	unsigned long index, blk_idx;
+	struct zram_wb_batch *wb;
+	u64 deadline = 0;
+	int i, ret = 0;
+
+	wb = kzalloc(sizeof(*wb), GFP_KERNEL);
+	if (!wb)
+		return -ENOMEM;
+
+	for (i = 0; i < ZRAM_WB_BATCH_PAGES; i++) {
+		wb->pages[i] = alloc_page(GFP_KERNEL);
+		if (!wb->pages[i]) {
+			ret = -ENOMEM;
+			goto out;
+		}
 	}
 
+	if (budget_ns)
+		deadline = ktime_get_ns() + budget_ns;
+
 	for (index = 0; index < nr_pages; index++) {
 		struct bio_vec bvec;
 
-		bvec.bv_page = page;
-		bvec.bv_len = PAGE_SIZE;
-		bvec.bv_offset = 0;
+		if (deadline && ktime_get_ns() > deadline)
+			break;
 
 		spin_lock(&zram->wb_limit_lock);
-		if (zram->wb_limit_enable && !zram->bd_wb_limit) {
+		if (zram->wb_limit_enable && zram->bd_wb_limit <
+				(u64)(wb->nr + 1) << (PAGE_SHIFT - 12)) {
 			spin_unlock(&zram->wb_limit_lock);
 			ret = -EIO;
 			break;
 		}
 		spin_unlock(&zram->wb_limit_lock);
 
-		if (!blk_idx) {
-			blk_idx = alloc_block_bdev(zram);
-			if (!blk_idx) {
-				ret = -ENOSPC;
-				break;
-			}
-		}
-
 		zram_slot_lock(zram, index);
 		if (!zram_allocated(zram, index))
 			goto next;
@@ -708,75 +968,202 @@ static ssize_t writeback_store(struct device *dev,
 		/* Need for hugepage writeback racing */
 		zram_set_flag(zram, index, ZRAM_IDLE);
 		zram_slot_unlock(zram, index);
-		if (zram_bvec_read(zram, &bvec, index, 0, NULL)) {
-			zram_slot_lock(zram, index);
-			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
-			zram_clear_flag(zram, index, ZRAM_IDLE);
-			zram_slot_unlock(zram, index);
-			continue;
-		}
-
-		bio_init(&bio, &bio_vec, 1);
-		bio_set_dev(&bio, zram->bdev);
-		bio.bi_iter.bi_sector = blk_idx * (PAGE_SIZE >> 9);
-		bio.bi_opf = REQ_OP_WRITE | REQ_SYNC;
 
-		bio_add_page(&bio, bvec.bv_page, bvec.bv_len,
-				bvec.bv_offset);
-		/*
-		 * XXX: A single page IO would be inefficient for write
-		 * but it would be not bad as starter.
-		 */
-		ret = submit_bio_wait(&bio);
-		if (ret) {
-			zram_slot_lock(zram, index);
-			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
-			zram_clear_flag(zram, index, ZRAM_IDLE);
-			zram_slot_unlock(zram, index);
-			continue;
+		blk_idx = 0;
+		if (wb->nr)
+			blk_idx = alloc_block_bdev_next(zram,
+					wb->blk_start + wb->nr - 1);
+		if (!blk_idx) {
+			zram_wb_flush(zram, wb);
+			blk_idx = alloc_block_bdev(zram);
+			if (!blk_idx) {
+				zram_wb_abort_slot(zram, index);
+				ret = -ENOSPC;
+				break;
+			}
+			wb->blk_start = blk_idx;
 		}
 
-		atomic64_inc(&zram->stats.bd_writes);
-		/*
-		 * We released zram_slot_lock so need to check if the slot was
-		 * changed. If there is freeing for the slot, we can catch it
-		 * easily by zram_allocated.
-		 * A subtle case is the slot is freed/reallocated/marked as
-		 * ZRAM_IDLE again. To close the race, idle_store doesn't
-		 * mark ZRAM_IDLE once it found the slot was ZRAM_UNDER_WB.
-		 * Thus, we could close the race by checking ZRAM_IDLE bit.
-		 */
-		zram_slot_lock(zram, index);
-		if (!zram_allocated(zram, index) ||
-			  !zram_test_flag(zram, index, ZRAM_IDLE)) {
-			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
-			zram_clear_flag(zram, index, ZRAM_IDLE);
-			goto next;
+		bvec.bv_page = wb->pages[wb->nr];
+		bvec.bv_len = PAGE_SIZE;
+		bvec.bv_offset = 0;
+		if (zram_bvec_read(zram, &bvec, index, 0, NULL)) {
+			zram_wb_abort_slot(zram, index);
+			free_block_bdev(zram, blk_idx);
+			continue;
 		}
 
-		zram_free_page(zram, index);
-		zram_clear_flag(zram, index, ZRAM_UNDER_WB);
-		zram_set_flag(zram, index, ZRAM_WB);
-		zram_set_element(zram, index, blk_idx);
-		blk_idx = 0;
-		atomic64_inc(&zram->stats.pages_stored);
-		spin_lock(&zram->wb_limit_lock);
-		if (zram->wb_limit_enable && zram->bd_wb_limit > 0)
-			zram->bd_wb_limit -=  1UL << (PAGE_SHIFT - 12);
-		spin_unlock(&zram->wb_limit_lock);
+		wb->index[wb->nr++] = index;
+		if (wb->nr == ZRAM_WB_BATCH_PAGES)
+			zram_wb_flush(zram, wb);
+		continue;
 next:
 		zram_slot_unlock(zram, index);
 	}
 
-	if (blk_idx)
-		free_block_bdev(zram, blk_idx);
-	ret = len;
-	__free_page(page);
-release_init_lock:
-	up_read(&zram->init_lock);
+	zram_wb_flush(zram, wb);
+out:
+	for (i = 0; i < ZRAM_WB_BATCH_PAGES; i++)
+		if (wb->pages[i])
+			__free_page(wb->pages[i]);
+	kfree(wb);
+
+	return ret;
+}
+
+static ssize_t writeback_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	ssize_t ret, sz;
+	char mode_buf[8];
+	int mode = -1;
+
+	sz = strscpy(mode_buf, buf, sizeof(mode_buf));
+	if (sz <= 0)
+		return -EINVAL;
+
+	/* ignore trailing newline */
+	if (mode_buf[sz - 1] == '\n')
+		mode_buf[sz - 1] = 0x00;
+
+	if (!strcmp(mode_buf, "idle"))
+		mode = IDLE_WRITEBACK;
+	else if (!strcmp(mode_buf, "huge"))
+		mode = HUGE_WRITEBACK;
+
+	if (mode == -1)
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		ret = -EINVAL;
+		goto release_init_lock;
+	}
+
+	if (!zram->backing_dev) {
+		ret = -ENODEV;
+		goto release_init_lock;
+	}
+
+	ret = zram_writeback(zram, mode, 0);
+	if (!ret)
+		ret = len;
+release_init_lock:
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+
+/*
+ * Background writeback of idle pages. Every ZRAM_WB_IDLE_PERIOD, while
+ * the screen is off or nothing else is runnable, spend at most
+ * idle_writeback_budget_ms writing back pages marked idle.
+ */
+#define ZRAM_WB_IDLE_PERIOD	(30 * HZ)
+
+static bool zram_screen_off;
+
+static bool zram_wb_idle_allowed(void)
+{
+	/* the worker itself is runnable */
+	return READ_ONCE(zram_screen_off) || nr_running() <= 1;
+}
+
+static void zram_wb_idle_work(struct work_struct *work)
+{
+	struct zram *zram = container_of(to_delayed_work(work),
+					struct zram, wb_idle_work);
+	u64 budget_ms;
+
+	down_read(&zram->init_lock);
+	budget_ms = READ_ONCE(zram->wb_idle_budget_ms);
+	if (!init_done(zram) || !budget_ms) {
+		up_read(&zram->init_lock);
+		return;
+	}
+
+	if (zram->backing_dev && zram_wb_idle_allowed())
+		zram_writeback(zram, IDLE_WRITEBACK,
+				budget_ms * NSEC_PER_MSEC);
+	up_read(&zram->init_lock);
+
+	queue_delayed_work(system_freezable_power_efficient_wq,
+			&zram->wb_idle_work, ZRAM_WB_IDLE_PERIOD);
+}
+
+static void zram_wb_idle_kick(struct zram *zram)
+{
+	if (READ_ONCE(zram->wb_idle_budget_ms))
+		mod_delayed_work(system_freezable_power_efficient_wq,
+				&zram->wb_idle_work, ZRAM_WB_IDLE_PERIOD);
+}
+
+static void zram_wb_idle_cancel(struct zram *zram)
+{
+	cancel_delayed_work_sync(&zram->wb_idle_work);
+}
+
+static ssize_t idle_writeback_budget_ms_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	u64 val;
+
+	if (kstrtoull(buf, 10, &val))
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	WRITE_ONCE(zram->wb_idle_budget_ms, val);
+	if (init_done(zram))
+		zram_wb_idle_kick(zram);
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
+static ssize_t idle_writeback_budget_ms_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%llu\n",
+			READ_ONCE(zram->wb_idle_budget_ms));
+}
+
+#ifdef CONFIG_MSM_DRM_NOTIFY
+static int zram_drm_notifier_cb(struct notifier_block *nb,
+				unsigned long action, void *data)
+{
+	struct msm_drm_notifier *evdata = data;
+	int *blank = evdata->data;
 
-	return ret;
+	if (action != MSM_DRM_EVENT_BLANK ||
+			evdata->id != MSM_DRM_PRIMARY_DISPLAY)
+		return NOTIFY_OK;
+
+	WRITE_ONCE(zram_screen_off, *blank != MSM_DRM_BLANK_UNBLANK);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block zram_drm_notifier = {
+	.notifier_call = zram_drm_notifier_cb,
+};
+
+static void zram_wb_idle_register(void)
+{
+	msm_drm_register_client(&zram_drm_notifier);
+}
+
+static void zram_wb_idle_unregister(void)
+{
+	msm_drm_unregister_client(&zram_drm_notifier);
 }
+#else
+static void zram_wb_idle_register(void) {};
+static void zram_wb_idle_unregister(void) {};
+#endif
 
 struct zram_work {
 	struct work_struct work;
@@ -831,14 +1218,26 @@ static int read_from_bdev_sync(struct zram *zram, struct bio_vec *bvec,
 static int read_from_bdev(struct zram *zram, struct bio_vec *bvec,
 			unsigned long entry, struct bio *parent, bool sync)
 {
+	int ret;
+
 	atomic64_inc(&zram->stats.bd_reads);
+	if (zram_wb_ra_read(zram, bvec, entry))
+		return 0;
+
 	if (sync)
 		return read_from_bdev_sync(zram, bvec, entry, parent);
-	else
-		return read_from_bdev_async(zram, bvec, entry, parent);
+
+	ret = read_from_bdev_async(zram, bvec, entry, parent);
+	if (ret == 1)
+		zram_wb_ra_start(zram, entry);
+	return ret;
 }
 #else
 static inline void reset_bdev(struct zram *zram) {};
+static void zram_wb_idle_kick(struct zram *zram) {};
+static void zram_wb_idle_cancel(struct zram *zram) {};
+static void zram_wb_idle_register(void) {};
+static void zram_wb_idle_unregister(void) {};
 static int read_from_bdev(struct zram *zram, struct bio_vec *bvec,
 			unsigned long entry, struct bio *parent, bool sync)
 {
@@ -1133,10 +1532,11 @@ static ssize_t bd_stat_show(struct device *dev,
 
 	down_read(&zram->init_lock);
 	ret = scnprintf(buf, PAGE_SIZE,
-		"%8llu %8llu %8llu\n",
+		"%8llu %8llu %8llu %8llu\n",
 			FOUR_K((u64)atomic64_read(&zram->stats.bd_count)),
 			FOUR_K((u64)atomic64_read(&zram->stats.bd_reads)),
-			FOUR_K((u64)atomic64_read(&zram->stats.bd_writes)));
+			FOUR_K((u64)atomic64_read(&zram->stats.bd_writes)),
+			FOUR_K((u64)atomic64_read(&zram->stats.bd_ra_hits)));
 	up_read(&zram->init_lock);
 
 	return ret;
@@ -1161,12 +1561,36 @@ static ssize_t debug_stat_show(struct device *dev,
 	return ret;
 }
 
+#ifdef CONFIG_ZRAM_DEDUP
+static ssize_t dedup_stat_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	ssize_t ret;
+
+	down_read(&zram->init_lock);
+	ret = scnprintf(buf, PAGE_SIZE,
+			"%8llu %8llu %8llu %8llu %8llu\n",
+			zram_dedup_dup_size(zram),
+			zram_dedup_meta_size(zram),
+			zram_dedup_hits(zram),
+			zram_dedup_misses(zram),
+			zram_dedup_time(zram));
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+#endif
+
 static DEVICE_ATTR_RO(io_stat);
 static DEVICE_ATTR_RO(mm_stat);
 #ifdef CONFIG_ZRAM_WRITEBACK
 static DEVICE_ATTR_RO(bd_stat);
 #endif
 static DEVICE_ATTR_RO(debug_stat);
+#ifdef CONFIG_ZRAM_DEDUP
+static DEVICE_ATTR_RO(dedup_stat);
+#endif
 
 static unsigned long zram_entry_handle(struct zram *zram,
 		struct zram_entry *entry)
@@ -1213,7 +1637,8 @@ void zram_entry_free(struct zram *zram, struct zram_entry *entry)
 	if (!zram_dedup_enabled(zram))
 		return;
 
-	kfree(entry);
+	/* lockless dedup lookups may still be looking at it */
+	kfree_rcu(entry, rcu);
 
 	atomic64_sub(sizeof(*entry), &zram->stats.meta_data_size);
 }
@@ -1279,6 +1704,9 @@ static void zram_free_page(struct zram *zram, size_t index)
 		atomic64_dec(&zram->stats.huge_pages);
 	}
 
+	zram_clear_flag(zram, index, ZRAM_RECOMP);
+	zram_clear_flag(zram, index, ZRAM_INCOMPRESSIBLE);
+
 	if (zram_test_flag(zram, index, ZRAM_WB)) {
 		zram_clear_flag(zram, index, ZRAM_WB);
 		free_block_bdev(zram, zram_get_element(zram, index));
@@ -1311,28 +1739,27 @@ static void zram_free_page(struct zram *zram, size_t index)
 		~(1UL << ZRAM_LOCK | 1UL << ZRAM_UNDER_WB));
 }
 
-static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
-				struct bio *bio, bool partial_io)
+static struct zcomp *zram_slot_comp(struct zram *zram, u32 index)
+{
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	if (zram_test_flag(zram, index, ZRAM_RECOMP))
+		return zram->recomp;
+#endif
+	return zram->comp;
+}
+
+/*
+ * Decompress a slot held in zsmalloc into @page. Caller must hold the
+ * slot lock and the slot must not be ZRAM_WB.
+ */
+static int zram_read_from_zspool(struct zram *zram, struct page *page,
+				u32 index)
 {
 	int ret;
 	struct zram_entry *entry;
 	unsigned int size;
 	void *src, *dst;
 
-	zram_slot_lock(zram, index);
-	if (zram_test_flag(zram, index, ZRAM_WB)) {
-		struct bio_vec bvec;
-
-		zram_slot_unlock(zram, index);
-
-		bvec.bv_page = page;
-		bvec.bv_len = PAGE_SIZE;
-		bvec.bv_offset = 0;
-		return read_from_bdev(zram, &bvec,
-				zram_get_element(zram, index),
-				bio, partial_io);
-	}
-
 	entry = zram_get_entry(zram, index);
 	if (!entry || zram_test_flag(zram, index, ZRAM_SAME)) {
 		unsigned long value;
@@ -1342,7 +1769,6 @@ static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
 		mem = kmap_atomic(page);
 		zram_fill_page(mem, PAGE_SIZE, value);
 		kunmap_atomic(mem);
-		zram_slot_unlock(zram, index);
 		return 0;
 	}
 
@@ -1356,14 +1782,39 @@ static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
 		kunmap_atomic(dst);
 		ret = 0;
 	} else {
-		struct zcomp_strm *zstrm = zcomp_stream_get(zram->comp);
+		struct zcomp *comp = zram_slot_comp(zram, index);
+		struct zcomp_strm *zstrm = zcomp_stream_get(comp);
 
 		dst = kmap_atomic(page);
 		ret = zcomp_decompress(zstrm, src, size, dst);
 		kunmap_atomic(dst);
-		zcomp_stream_put(zram->comp);
+		zcomp_stream_put(comp);
 	}
 	zs_unmap_object(zram->mem_pool, zram_entry_handle(zram, entry));
+
+	return ret;
+}
+
+static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
+				struct bio *bio, bool partial_io)
+{
+	int ret;
+
+	zram_slot_lock(zram, index);
+	if (zram_test_flag(zram, index, ZRAM_WB)) {
+		struct bio_vec bvec;
+
+		zram_slot_unlock(zram, index);
+
+		bvec.bv_page = page;
+		bvec.bv_len = PAGE_SIZE;
+		bvec.bv_offset = 0;
+		return read_from_bdev(zram, &bvec,
+				zram_get_element(zram, index),
+				bio, partial_io);
+	}
+
+	ret = zram_read_from_zspool(zram, page, index);
 	zram_slot_unlock(zram, index);
 
 	/* Should NEVER happen. Return bio error if it does. */
@@ -1574,6 +2025,223 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec,
 	return ret;
 }
 
+#ifdef CONFIG_ZRAM_MULTI_COMP
+static ssize_t recomp_algorithm_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	size_t sz;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	sz = zcomp_available_show(zram->recomp_algorithm, buf);
+	up_read(&zram->init_lock);
+
+	return sz;
+}
+
+static ssize_t recomp_algorithm_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	char compressor[ARRAY_SIZE(zram->recomp_algorithm)];
+	size_t sz;
+
+	strlcpy(compressor, buf, sizeof(compressor));
+	/* ignore trailing newline */
+	sz = strlen(compressor);
+	if (sz > 0 && compressor[sz - 1] == '\n')
+		compressor[sz - 1] = 0x00;
+
+	if (!zcomp_available_algorithm(compressor))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change algorithm for initialized device\n");
+		return -EBUSY;
+	}
+
+	strcpy(zram->recomp_algorithm, compressor);
+	up_write(&zram->init_lock);
+	return len;
+}
+
+static ssize_t recomp_stat_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	ssize_t ret;
+
+	down_read(&zram->init_lock);
+	ret = scnprintf(buf, PAGE_SIZE,
+			"%8llu %8llu\n",
+			(u64)atomic64_read(&zram->stats.recomp_pages),
+			(u64)atomic64_read(&zram->stats.recomp_saved));
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+
+/*
+ * Re-encode one slot with the secondary algorithm. Runs entirely under
+ * the slot lock, so the new object is allocated without direct reclaim.
+ * Slots that don't shrink are marked ZRAM_INCOMPRESSIBLE and skipped by
+ * later passes until they are rewritten.
+ */
+static int zram_recompress(struct zram *zram, u32 index, struct page *page)
+{
+	struct zram_entry *entry;
+	struct zcomp_strm *zstrm;
+	unsigned int comp_len_old, comp_len_new;
+	void *src, *dst;
+	int ret;
+
+	comp_len_old = zram_get_obj_size(zram, index);
+	ret = zram_read_from_zspool(zram, page, index);
+	if (ret)
+		return ret;
+
+	zstrm = zcomp_stream_get(zram->recomp);
+	src = kmap_atomic(page);
+	ret = zcomp_compress(zstrm, src, &comp_len_new);
+	kunmap_atomic(src);
+
+	if (ret) {
+		zcomp_stream_put(zram->recomp);
+		return ret;
+	}
+
+	if (comp_len_new >= huge_class_size || comp_len_new >= comp_len_old) {
+		zcomp_stream_put(zram->recomp);
+		zram_set_flag(zram, index, ZRAM_INCOMPRESSIBLE);
+		return 0;
+	}
+
+	entry = zram_entry_alloc(zram, comp_len_new,
+				__GFP_KSWAPD_RECLAIM |
+				__GFP_NOWARN |
+				__GFP_HIGHMEM |
+				__GFP_MOVABLE);
+	if (!entry) {
+		zcomp_stream_put(zram->recomp);
+		return -ENOMEM;
+	}
+
+	dst = zs_map_object(zram->mem_pool,
+			    zram_entry_handle(zram, entry), ZS_MM_WO);
+	memcpy(dst, zstrm->buffer, comp_len_new);
+	zcomp_stream_put(zram->recomp);
+	zs_unmap_object(zram->mem_pool, zram_entry_handle(zram, entry));
+
+	zram_free_page(zram, index);
+	zram_set_entry(zram, index, entry);
+	zram_set_obj_size(zram, index, comp_len_new);
+	zram_set_flag(zram, index, ZRAM_RECOMP);
+
+	atomic64_add(comp_len_new, &zram->stats.compr_data_size);
+	atomic64_inc(&zram->stats.pages_stored);
+	atomic64_inc(&zram->stats.recomp_pages);
+	atomic64_add(comp_len_old - comp_len_new, &zram->stats.recomp_saved);
+
+	return 0;
+}
+
+#define IDLE_RECOMPRESS		0x1
+#define HUGE_RECOMPRESS		0x2
+
+static ssize_t recompress_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
+	unsigned long index;
+	struct page *page;
+	ssize_t ret = len, sz;
+	char mode_buf[10];
+	int mode = 0;
+
+	sz = strscpy(mode_buf, buf, sizeof(mode_buf));
+	if (sz <= 0)
+		return -EINVAL;
+
+	/* ignore trailing newline */
+	if (mode_buf[sz - 1] == '\n')
+		mode_buf[sz - 1] = 0x00;
+
+	if (!strcmp(mode_buf, "idle"))
+		mode = IDLE_RECOMPRESS;
+	else if (!strcmp(mode_buf, "huge"))
+		mode = HUGE_RECOMPRESS;
+	else if (!strcmp(mode_buf, "huge_idle"))
+		mode = IDLE_RECOMPRESS | HUGE_RECOMPRESS;
+
+	if (!mode)
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		ret = -EINVAL;
+		goto release_init_lock;
+	}
+
+	if (!zram->recomp) {
+		ret = -ENODEV;
+		goto release_init_lock;
+	}
+
+	/* dedup entries may be shared and are matched with the primary */
+	if (zram_dedup_enabled(zram)) {
+		ret = -EOPNOTSUPP;
+		goto release_init_lock;
+	}
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page) {
+		ret = -ENOMEM;
+		goto release_init_lock;
+	}
+
+	for (index = 0; index < nr_pages; index++) {
+		int err = 0;
+
+		zram_slot_lock(zram, index);
+		if (!zram_allocated(zram, index))
+			goto next;
+
+		if (zram_test_flag(zram, index, ZRAM_WB) ||
+				zram_test_flag(zram, index, ZRAM_SAME) ||
+				zram_test_flag(zram, index, ZRAM_UNDER_WB) ||
+				zram_test_flag(zram, index, ZRAM_RECOMP) ||
+				zram_test_flag(zram, index, ZRAM_INCOMPRESSIBLE))
+			goto next;
+
+		if ((mode & IDLE_RECOMPRESS) &&
+				!zram_test_flag(zram, index, ZRAM_IDLE))
+			goto next;
+		if ((mode & HUGE_RECOMPRESS) &&
+				!zram_test_flag(zram, index, ZRAM_HUGE))
+			goto next;
+
+		err = zram_recompress(zram, index, page);
+next:
+		zram_slot_unlock(zram, index);
+
+		if (err) {
+			ret = err;
+			break;
+		}
+		cond_resched();
+	}
+
+	__free_page(page);
+release_init_lock:
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+#endif
+
 /*
  * zram_bio_discard - handler on discard request
  * @index: physical block index in PAGE_SIZE units
@@ -1810,10 +2478,18 @@ static void zram_reset_device(struct zram *zram)
 	part_stat_set_all(&zram->disk->part0, 0);
 
 	up_write(&zram->init_lock);
+	/* the worker sees !init_done from now on and won't re-arm */
+	zram_wb_idle_cancel(zram);
 	/* I/O operation under all of CPU are done so let's free */
 	zram_meta_free(zram, disksize);
 	memset(&zram->stats, 0, sizeof(zram->stats));
 	zcomp_destroy(comp);
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	if (zram->recomp) {
+		zcomp_destroy(zram->recomp);
+		zram->recomp = NULL;
+	}
+#endif
 	reset_bdev(zram);
 }
 
@@ -1855,11 +2531,27 @@ static ssize_t disksize_store(struct device *dev,
 		goto out_free_meta;
 	}
 
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	if (zram->recomp_algorithm[0]) {
+		struct zcomp *recomp = zcomp_create(zram->recomp_algorithm);
+
+		if (IS_ERR(recomp)) {
+			pr_err("Cannot initialise %s recompressing backend\n",
+					zram->recomp_algorithm);
+			zcomp_destroy(comp);
+			err = PTR_ERR(recomp);
+			goto out_free_meta;
+		}
+		zram->recomp = recomp;
+	}
+#endif
+
 	zram->comp = comp;
 	zram->disksize = disksize;
 	set_capacity(zram->disk, zram->disksize >> SECTOR_SHIFT);
 
 	revalidate_disk(zram->disk);
+	zram_wb_idle_kick(zram);
 	up_write(&zram->init_lock);
 
 	return len;
@@ -1952,6 +2644,12 @@ static DEVICE_ATTR_RW(backing_dev);
 static DEVICE_ATTR_WO(writeback);
 static DEVICE_ATTR_RW(writeback_limit);
 static DEVICE_ATTR_RW(writeback_limit_enable);
+static DEVICE_ATTR_RW(idle_writeback_budget_ms);
+#endif
+#ifdef CONFIG_ZRAM_MULTI_COMP
+static DEVICE_ATTR_RW(recomp_algorithm);
+static DEVICE_ATTR_WO(recompress);
+static DEVICE_ATTR_RO(recomp_stat);
 #endif
 #ifdef CONFIG_ZRAM_DEDUP
 static DEVICE_ATTR_RW(use_dedup);
@@ -1974,6 +2672,12 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_writeback.attr,
 	&dev_attr_writeback_limit.attr,
 	&dev_attr_writeback_limit_enable.attr,
+	&dev_attr_idle_writeback_budget_ms.attr,
+#endif
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	&dev_attr_recomp_algorithm.attr,
+	&dev_attr_recompress.attr,
+	&dev_attr_recomp_stat.attr,
 #endif
 	&dev_attr_use_dedup.attr,
 	&dev_attr_io_stat.attr,
@@ -1982,6 +2686,9 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_bd_stat.attr,
 #endif
 	&dev_attr_debug_stat.attr,
+#ifdef CONFIG_ZRAM_DEDUP
+	&dev_attr_dedup_stat.attr,
+#endif
 	NULL,
 };
 
@@ -2016,6 +2723,7 @@ static int zram_add(void)
 	init_rwsem(&zram->init_lock);
 #ifdef CONFIG_ZRAM_WRITEBACK
 	spin_lock_init(&zram->wb_limit_lock);
+	INIT_DELAYED_WORK(&zram->wb_idle_work, zram_wb_idle_work);
 #endif
 	queue = blk_alloc_queue(GFP_KERNEL);
 	if (!queue) {
@@ -2206,6 +2914,7 @@ static void destroy_devices(void)
 {
 	class_unregister(&zram_control_class);
 	idr_for_each(&zram_index_idr, &zram_remove_cb, NULL);
+	zram_wb_idle_unregister();
 	zram_debugfs_destroy();
 	idr_destroy(&zram_index_idr);
 	unregister_blkdev(zram_major, "zram");
@@ -2229,9 +2938,11 @@ static int __init zram_init(void)
 	}
 
 	zram_debugfs_create();
+	zram_wb_idle_register();
 	zram_major = register_blkdev(0, "zram");
 	if (zram_major <= 0) {
 		pr_err("Unable to get major number\n");
+		zram_wb_idle_unregister();
 		class_unregister(&zram_control_class);
 		cpuhp_remove_multi_state(CPUHP_ZCOMP_PREPARE);
 		return -EBUSY;
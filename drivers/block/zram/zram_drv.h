@@ -19,6 +19,7 @@
 #include <linux/zsmalloc.h>
 #include <linux/crypto.h>
 #include <linux/spinlock.h>
+#include <linux/workqueue.h>
 
 #include "zcomp.h"
 #include "zram_dedup.h"
@@ -52,6 +53,8 @@ enum zram_pageflags {
 	ZRAM_UNDER_WB,	/* page is under writeback */
 	ZRAM_HUGE,	/* Incompressible page */
 	ZRAM_IDLE,	/* not accessed page since last idle marking */
+	ZRAM_RECOMP,	/* page is compressed by the secondary algorithm */
+	ZRAM_INCOMPRESSIBLE,	/* secondary algorithm gave no gain */
 
 	__NR_ZRAM_PAGEFLAGS,
 };
@@ -62,8 +65,12 @@ struct zram_entry {
 	struct rb_node rb_node;
 	u32 len;
 	u32 checksum;
-	unsigned long refcount;
-	unsigned long handle;
+	atomic_long_t refcount;
+	union {
+		unsigned long handle;
+		/* handle is dead once refcount drops to zero */
+		struct rcu_head rcu;
+	};
 };
 
 /* Allocated for each disk page */
@@ -96,14 +103,42 @@ struct zram_stats {
 					 * duplicated
 					 */
 	atomic64_t meta_data_size;	/* size of zram_entries */
+	atomic64_t dedup_hits;		/* no. of pages found by dedup */
+	atomic64_t dedup_misses;	/* no. of dedup lookups that failed */
+	atomic64_t dedup_time;		/* ns spent in dedup lookups */
 	atomic64_t miss_free;		/* no. of missed free */
 #ifdef	CONFIG_ZRAM_WRITEBACK
 	atomic64_t bd_count;		/* no. of pages in backing device */
 	atomic64_t bd_reads;		/* no. of reads from backing device */
 	atomic64_t bd_writes;		/* no. of writes from backing device */
+	atomic64_t bd_ra_hits;		/* no. of reads served by read-ahead */
+#endif
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	atomic64_t recomp_pages;	/* no. of recompressed pages */
+	atomic64_t recomp_saved;	/* bytes saved by recompression */
 #endif
 };
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+/* Blocks read ahead after a backing device read */
+#define ZRAM_WB_RA_PAGES	8
+
+enum zram_wb_ra_state {
+	ZRAM_RA_IDLE,
+	ZRAM_RA_INFLIGHT,
+	ZRAM_RA_READY,
+};
+
+struct zram_wb_ra {
+	spinlock_t lock;
+	int state;
+	unsigned long start;	/* first block of the window */
+	unsigned int nr;
+	unsigned long valid;	/* blocks not freed since they were read */
+	struct page *pages[ZRAM_WB_RA_PAGES];
+};
+#endif
+
 struct zram_hash {
 	spinlock_t lock;
 	struct rb_root rb_root;
@@ -130,6 +165,11 @@ struct zram {
 	 */
 	u64 disksize;	/* bytes */
 	char compressor[CRYPTO_MAX_ALG_NAME];
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	/* secondary, higher-ratio algorithm used to recompress idle pages */
+	struct zcomp *recomp;
+	char recomp_algorithm[CRYPTO_MAX_ALG_NAME];
+#endif
 	/*
 	 * zram is claimed so open request will be failed
 	 */
@@ -144,6 +184,9 @@ struct zram {
 	unsigned int old_block_size;
 	unsigned long *bitmap;
 	unsigned long nr_pages;
+	struct zram_wb_ra *wb_ra;
+	u64 wb_idle_budget_ms;
+	struct delayed_work wb_idle_work;
 #endif
 #ifdef CONFIG_ZRAM_MEMORY_TRACKING
 	struct dentry *debugfs_dir;
@@ -23,6 +23,7 @@
 #include <linux/cdev.h>
 #include <linux/list.h>
 #include <linux/hash.h>
+#include <linux/hashtable.h>
 #include <linux/msm_ion.h>
 #include <soc/qcom/secure_buffer.h>
 #include <linux/rpmsg.h>
@@ -49,6 +50,8 @@
 #include <soc/qcom/ramdump.h>
 #include <linux/debugfs.h>
 #include <linux/pm_qos.h>
+#include <linux/poll.h>
+#include <linux/seq_file.h>
 
 #define TZ_PIL_PROTECT_MEM_SUBSYS_ID 0x0C
 #define TZ_PIL_CLEAR_PROTECT_MEM_SUBSYS_ID 0x0D
@@ -108,6 +111,14 @@
 #define INIT_FILELEN_MAX (2*1024*1024)
 #define INIT_MEMLEN_MAX  (8*1024*1024)
 #define MAX_CACHE_BUF_SIZE (8*1024*1024)
+/* Freed maps kept mapped per file, so fds passed every frame stay mapped */
+#define MAX_CACHED_MAPS (16)
+#define MAX_CACHED_MAPS_SIZE (64*1024*1024)
+#define FASTRPC_MAP_HASH_BITS (5)
+/* Per method latency histograms kept per file, the rest go to "other" */
+#define FASTRPC_LAT_METHODS (16)
+/* Bucket i counts [2^(i-1), 2^i) us, the last one everything above */
+#define FASTRPC_LAT_BUCKETS (16)
 
 #define PERF_END (void)0
 
@@ -135,6 +146,8 @@ static int fastrpc_pdr_notifier_cb(struct notifier_block *nb,
 					void *data);
 static struct dentry *debugfs_root;
 static struct dentry *debugfs_global_file;
+static struct dentry *debugfs_lat_file;
+static bool fastrpc_lat_enabled;
 
 static inline uint64_t buf_page_start(uint64_t buf)
 {
@@ -232,6 +245,18 @@ struct smq_invoke_ctx {
 	uint32_t *crc;
 	unsigned int magic;
 	uint64_t ctxid;
+	/* async invoke, completed onto fl->async_done instead of work */
+	int async;
+	int async_queued;
+	uint64_t job_id;
+	remote_arg_t *upra;
+	struct list_head async_node;
+	uint64_t submit_ns;
+	uint64_t done_ns;
+	/* phase timestamps, only taken with latency histograms enabled */
+	uint64_t start_ns;
+	uint64_t args_ns;
+	uint64_t sent_ns;
 };
 
 struct fastrpc_ctx_lst {
@@ -314,6 +339,8 @@ struct fastrpc_apps {
 
 struct fastrpc_mmap {
 	struct hlist_node hn;
+	struct hlist_node hash_hn;
+	struct list_head cache_node;
 	struct fastrpc_file *fl;
 	struct fastrpc_apps *apps;
 	int fd;
@@ -346,6 +373,38 @@ enum fastrpc_perfkeys {
 	PERF_KEY_MAX = 9,
 };
 
+enum fastrpc_lat_phase {
+	FASTRPC_LAT_ARGS,	/* get_args and cache maintenance */
+	FASTRPC_LAT_SEND,	/* fastrpc_invoke_send */
+	FASTRPC_LAT_DSP,	/* sent until the response arrived */
+	FASTRPC_LAT_PUTARGS,	/* inv_args and put_args */
+	FASTRPC_LAT_TOTAL,
+	FASTRPC_LAT_MAX,
+};
+
+static const char * const fastrpc_lat_names[FASTRPC_LAT_MAX] = {
+	[FASTRPC_LAT_ARGS] = "args",
+	[FASTRPC_LAT_SEND] = "send",
+	[FASTRPC_LAT_DSP] = "dsp",
+	[FASTRPC_LAT_PUTARGS] = "putargs",
+	[FASTRPC_LAT_TOTAL] = "total",
+};
+
+struct fastrpc_lat_hist {
+	uint32_t handle;
+	uint32_t method;
+	uint64_t count;
+	uint64_t total_us[FASTRPC_LAT_MAX];
+	uint32_t bucket[FASTRPC_LAT_MAX][FASTRPC_LAT_BUCKETS];
+};
+
+struct fastrpc_lat {
+	struct fastrpc_lat_hist session;
+	struct fastrpc_lat_hist other;
+	int num_methods;
+	struct fastrpc_lat_hist methods[FASTRPC_LAT_METHODS];
+};
+
 struct fastrpc_perf {
 	int64_t count;
 	int64_t flush;
@@ -364,9 +423,30 @@ struct fastrpc_file {
 	struct hlist_node hn;
 	spinlock_t hlock;
 	struct hlist_head maps;
+	/* per file maps hashed by fd, protected by map_mutex */
+	DECLARE_HASHTABLE(map_hash, FASTRPC_MAP_HASH_BITS);
+	/* freed maps still mapped, most recent first */
+	struct list_head cached_maps;
+	int num_cached_maps;
+	size_t cached_maps_size;
+	uint64_t map_hits;
+	uint64_t map_cache_hits;
+	uint64_t map_misses;
 	struct hlist_head cached_bufs;
 	struct hlist_head remote_bufs;
 	struct fastrpc_ctx_lst clst;
+	/* completed async invokes, protected by async_lock */
+	spinlock_t async_lock;
+	struct list_head async_done;
+	wait_queue_head_t async_wait;
+	uint64_t async_job_id;
+	int async_inflight;
+	uint64_t async_jobs;
+	uint64_t async_lat_total_us;
+	uint64_t async_lat_max_us;
+	/* latency histograms, allocated on the first profiled invoke */
+	spinlock_t lat_lock;
+	struct fastrpc_lat *lat;
 	struct fastrpc_session_ctx *sctx;
 	struct fastrpc_buf *init_mem;
 	struct fastrpc_session_ctx *secsctx;
@@ -597,9 +677,16 @@ static void fastrpc_mmap_add(struct fastrpc_mmap *map)
 		struct fastrpc_file *fl = map->fl;
 
 		hlist_add_head(&map->hn, &fl->maps);
+		hash_add(fl->map_hash, &map->hash_hn, map->fd);
 	}
 }
 
+static void fastrpc_mmap_unlink(struct fastrpc_mmap *map)
+{
+	hlist_del_init(&map->hn);
+	hash_del(&map->hash_hn);
+}
+
 static int fastrpc_mmap_find(struct fastrpc_file *fl, int fd,
 		uintptr_t va, size_t len, int mflags, int refs,
 		struct fastrpc_mmap **ppmap)
@@ -630,7 +717,7 @@ static int fastrpc_mmap_find(struct fastrpc_file *fl, int fd,
 		}
 		spin_unlock(&me->hlock);
 	} else {
-		hlist_for_each_entry_safe(map, n, &fl->maps, hn) {
+		hash_for_each_possible_safe(fl->map_hash, map, n, hash_hn, fd) {
 			if (va >= map->va &&
 				va + len <= map->va + map->len &&
 				map->fd == fd) {
@@ -705,7 +792,7 @@ static int fastrpc_mmap_remove(struct fastrpc_file *fl, uintptr_t va,
 			map->raddr + map->len == va + len &&
 			map->refs == 1) {
 			match = map;
-			hlist_del_init(&map->hn);
+			fastrpc_mmap_unlink(map);
 			break;
 		}
 	}
@@ -716,6 +803,92 @@ static int fastrpc_mmap_remove(struct fastrpc_file *fl, uintptr_t va,
 	return -ENOTTY;
 }
 
+static void fastrpc_mmap_free(struct fastrpc_mmap *map, uint32_t flags);
+
+static void fastrpc_mmap_cache_evict(struct fastrpc_mmap *map)
+{
+	struct fastrpc_file *fl = map->fl;
+
+	list_del_init(&map->cache_node);
+	fl->num_cached_maps--;
+	fl->cached_maps_size -= map->size;
+	/* take it through the regular teardown */
+	map->refs = 1;
+	fastrpc_mmap_free(map, 1);
+}
+
+/*
+ * Called with map_mutex held when the last reference to a per file map is
+ * dropped. Plain invoke maps are parked still mapped on the SMMU, the
+ * oldest ones are unmapped once the cache goes over its bounds.
+ */
+static bool fastrpc_mmap_cache_put(struct fastrpc_mmap *map)
+{
+	struct fastrpc_file *fl = map->fl;
+
+	if (!fl || map->flags || map->raddr || fl->file_close ||
+		(map->attr & FASTRPC_ATTR_KEEP_MAP) ||
+		map->size > MAX_CACHED_MAPS_SIZE)
+		return false;
+
+	list_add(&map->cache_node, &fl->cached_maps);
+	fl->num_cached_maps++;
+	fl->cached_maps_size += map->size;
+
+	while (fl->num_cached_maps > MAX_CACHED_MAPS ||
+		fl->cached_maps_size > MAX_CACHED_MAPS_SIZE)
+		fastrpc_mmap_cache_evict(list_last_entry(&fl->cached_maps,
+			struct fastrpc_mmap, cache_node));
+
+	return true;
+}
+
+static int fastrpc_mmap_cache_get(struct fastrpc_file *fl, int fd,
+	unsigned int attr, uintptr_t va, size_t len, int mflags,
+	struct fastrpc_mmap **ppmap)
+{
+	struct fastrpc_mmap *map, *n;
+	struct dma_buf *buf;
+	bool same;
+
+	if (mflags)
+		return -ENOTTY;
+
+	list_for_each_entry_safe(map, n, &fl->cached_maps, cache_node) {
+		if (map->fd != fd || map->attr != attr || va < map->va ||
+			va + len > map->va + map->len)
+			continue;
+
+		/* the fd may have been closed and reused for another buffer */
+		buf = dma_buf_get(fd);
+		if (IS_ERR_OR_NULL(buf))
+			return -ENOTTY;
+		same = (buf == map->buf);
+		dma_buf_put(buf);
+		if (!same) {
+			fastrpc_mmap_cache_evict(map);
+			continue;
+		}
+
+		list_del_init(&map->cache_node);
+		fl->num_cached_maps--;
+		fl->cached_maps_size -= map->size;
+		map->refs = 1;
+		fastrpc_mmap_add(map);
+		*ppmap = map;
+		return 0;
+	}
+
+	return -ENOTTY;
+}
+
+static void fastrpc_mmap_cache_flush(struct fastrpc_file *fl)
+{
+	while (!list_empty(&fl->cached_maps))
+		fastrpc_mmap_cache_evict(list_first_entry(&fl->cached_maps,
+			struct fastrpc_mmap, cache_node));
+}
+
 static void fastrpc_mmap_free(struct fastrpc_mmap *map, uint32_t flags)
 {
 	struct fastrpc_apps *me = &gfa;
@@ -749,9 +922,11 @@ static void fastrpc_mmap_free(struct fastrpc_mmap *map, uint32_t flags)
 	} else {
 		map->refs--;
 		if (!map->refs)
-			hlist_del_init(&map->hn);
+			fastrpc_mmap_unlink(map);
 		if (map->refs > 0 && !flags)
 			return;
+		if (!flags && fastrpc_mmap_cache_put(map))
+			return;
 	}
 	if (map->flags == ADSP_MMAP_HEAP_ADDR ||
 				map->flags == ADSP_MMAP_REMOTE_HEAP_ADDR) {
@@ -825,13 +1000,22 @@ static int fastrpc_mmap_create(struct fastrpc_file *fl, int fd,
 		goto bail;
 	}
 	chan = &apps->channel[cid];
-	if (!fastrpc_mmap_find(fl, fd, va, len, mflags, 1, ppmap))
+	if (!fastrpc_mmap_find(fl, fd, va, len, mflags, 1, ppmap)) {
+		fl->map_hits++;
 		return 0;
+	}
+	if (!fastrpc_mmap_cache_get(fl, fd, attr, va, len, mflags, ppmap)) {
+		fl->map_cache_hits++;
+		return 0;
+	}
+	fl->map_misses++;
 	map = kzalloc(sizeof(*map), GFP_KERNEL);
 	VERIFY(err, !IS_ERR_OR_NULL(map));
 	if (err)
 		goto bail;
 	INIT_HLIST_NODE(&map->hn);
+	INIT_HLIST_NODE(&map->hash_hn);
+	INIT_LIST_HEAD(&map->cache_node);
 	map->flags = mflags;
 	map->refs = 1;
 	map->fl = fl;
@@ -992,6 +1176,9 @@ static int fastrpc_mmap_create(struct fastrpc_file *fl, int fd,
 bail:
 	if (err && map)
 		fastrpc_mmap_free(map, 0);
+	/* give back what the cache holds, the next map may then succeed */
+	if (err)
+		fastrpc_mmap_cache_flush(fl);
 	return err;
 }
 
@@ -1260,6 +1447,7 @@ static int context_alloc(struct fastrpc_file *fl, uint32_t kernel,
 	ctx->pid = current->pid;
 	ctx->tgid = fl->tgid;
 	init_completion(&ctx->work);
+	INIT_LIST_HEAD(&ctx->async_node);
 	ctx->magic = FASTRPC_CTX_MAGIC;
 
 	spin_lock(&fl->hlock);
@@ -1328,10 +1516,36 @@ static void context_free(struct smq_invoke_ctx *ctx)
 	kfree(ctx);
 }
 
+/*
+ * An async context has no thread waiting on it, it is queued for the
+ * next FASTRPC_IOCTL_ASYNC_RESPONSE instead. The response and the SSR
+ * notification can both complete it, only the first one queues it.
+ */
+static void context_complete(struct smq_invoke_ctx *ctx)
+{
+	struct fastrpc_file *fl = ctx->fl;
+	unsigned long flags;
+
+	if (!ctx->done_ns)
+		ctx->done_ns = ktime_get_ns();
+	if (!ctx->async) {
+		complete(&ctx->work);
+		return;
+	}
+
+	spin_lock_irqsave(&fl->async_lock, flags);
+	if (!ctx->async_queued) {
+		ctx->async_queued = 1;
+		list_add_tail(&ctx->async_node, &fl->async_done);
+	}
+	spin_unlock_irqrestore(&fl->async_lock, flags);
+	wake_up_interruptible(&fl->async_wait);
+}
+
 static void context_notify_user(struct smq_invoke_ctx *ctx, int retval)
 {
 	ctx->retval = retval;
-	complete(&ctx->work);
+	context_complete(ctx);
 }
 
 
@@ -1342,10 +1556,10 @@ static void fastrpc_notify_users(struct fastrpc_file *me)
 
 	spin_lock(&me->hlock);
 	hlist_for_each_entry_safe(ictx, n, &me->clst.pending, hn) {
-		complete(&ictx->work);
+		context_complete(ictx);
 	}
 	hlist_for_each_entry_safe(ictx, n, &me->clst.interrupted, hn) {
-		complete(&ictx->work);
+		context_complete(ictx);
 	}
 	spin_unlock(&me->hlock);
 
@@ -1360,11 +1574,11 @@ static void fastrpc_notify_users_staticpd_pdr(struct fastrpc_file *me)
 	spin_lock(&me->hlock);
 	hlist_for_each_entry_safe(ictx, n, &me->clst.pending, hn) {
 		if (ictx->msg.pid)
-			complete(&ictx->work);
+			context_complete(ictx);
 	}
 	hlist_for_each_entry_safe(ictx, n, &me->clst.interrupted, hn) {
 		if (ictx->msg.pid)
-			complete(&ictx->work);
+			context_complete(ictx);
 	}
 	spin_unlock(&me->hlock);
 }
@@ -1933,6 +2147,83 @@ static void fastrpc_init(struct fastrpc_apps *me)
 
 static int fastrpc_release_current_dsp_process(struct fastrpc_file *fl);
 
+static inline uint64_t fastrpc_lat_ts(struct smq_invoke_ctx *ctx)
+{
+	return ctx->start_ns ? ktime_get_ns() : 0;
+}
+
+static void fastrpc_lat_add(struct fastrpc_lat_hist *hist, uint64_t *us)
+{
+	int i, b;
+
+	hist->count++;
+	for (i = 0; i < FASTRPC_LAT_MAX; i++) {
+		b = min_t(int, fls64(us[i]), FASTRPC_LAT_BUCKETS - 1);
+		hist->total_us[i] += us[i];
+		hist->bucket[i][b]++;
+	}
+}
+
+/* Called once the invoke has been fully processed, put_args included */
+static void fastrpc_lat_record(struct fastrpc_file *fl,
+				struct smq_invoke_ctx *ctx)
+{
+	struct fastrpc_lat *lat;
+	struct fastrpc_lat_hist *hist = NULL;
+	uint32_t handle = ctx->msg.invoke.header.handle;
+	uint32_t method = REMOTE_SCALARS_METHOD(ctx->sc);
+	uint64_t us[FASTRPC_LAT_MAX], end_ns, sent_ns;
+	int i;
+
+	if (!ctx->start_ns || !ctx->sent_ns || !ctx->done_ns)
+		return;
+
+	/* An async response can beat the sender to taking its timestamp */
+	sent_ns = min(ctx->sent_ns, ctx->done_ns);
+	end_ns = ktime_get_ns();
+	us[FASTRPC_LAT_ARGS] = div_u64(ctx->args_ns - ctx->start_ns,
+					NSEC_PER_USEC);
+	us[FASTRPC_LAT_SEND] = div_u64(sent_ns - ctx->args_ns,
+					NSEC_PER_USEC);
+	us[FASTRPC_LAT_DSP] = div_u64(ctx->done_ns - sent_ns,
+					NSEC_PER_USEC);
+	us[FASTRPC_LAT_PUTARGS] = div_u64(end_ns - ctx->done_ns,
+					NSEC_PER_USEC);
+	us[FASTRPC_LAT_TOTAL] = div_u64(end_ns - ctx->start_ns,
+					NSEC_PER_USEC);
+
+	if (!fl->lat) {
+		lat = kzalloc(sizeof(*lat), GFP_KERNEL);
+		if (!lat)
+			return;
+		spin_lock(&fl->lat_lock);
+		if (!fl->lat) {
+			fl->lat = lat;
+			lat = NULL;
+		}
+		spin_unlock(&fl->lat_lock);
+		kfree(lat);
+	}
+
+	spin_lock(&fl->lat_lock);
+	lat = fl->lat;
+	fastrpc_lat_add(&lat->session, us);
+	for (i = 0; i < lat->num_methods; i++) {
+		if (lat->methods[i].handle == handle &&
+				lat->methods[i].method == method) {
+			hist = &lat->methods[i];
+			break;
+		}
+	}
+	if (!hist && lat->num_methods < FASTRPC_LAT_METHODS) {
+		hist = &lat->methods[lat->num_methods++];
+		hist->handle = handle;
+		hist->method = method;
+	}
+	fastrpc_lat_add(hist ? hist : &lat->other, us);
+	spin_unlock(&fl->lat_lock);
+}
+
 static int fastrpc_internal_invoke(struct fastrpc_file *fl, uint32_t mode,
 				   uint32_t kernel,
 				   struct fastrpc_ioctl_invoke_crc *inv)
@@ -1984,6 +2275,8 @@ static int fastrpc_internal_invoke(struct fastrpc_file *fl, uint32_t mode,
 	VERIFY(err, 0 == context_alloc(fl, kernel, inv, &ctx));
 	if (err)
 		goto bail;
+	if (READ_ONCE(fastrpc_lat_enabled))
+		ctx->start_ns = ktime_get_ns();
 
 	if (REMOTE_SCALARS_LENGTH(ctx->sc)) {
 		PERF(fl->profile, GET_COUNTER(perf_counter, PERF_GETARGS),
@@ -1998,6 +2291,7 @@ static int fastrpc_internal_invoke(struct fastrpc_file *fl, uint32_t mode,
 		inv_args_pre(ctx);
 		PERF_END);
 	}
+	ctx->args_ns = fastrpc_lat_ts(ctx);
 
 	PERF(fl->profile, GET_COUNTER(perf_counter, PERF_LINK),
 	VERIFY(err, 0 == fastrpc_invoke_send(ctx, kernel, invoke->handle));
@@ -2005,6 +2299,7 @@ static int fastrpc_internal_invoke(struct fastrpc_file *fl, uint32_t mode,
 
 	if (err)
 		goto bail;
+	ctx->sent_ns = fastrpc_lat_ts(ctx);
  wait:
 	if (kernel)
 		wait_for_completion(&ctx->work);
@@ -2029,6 +2324,7 @@ static int fastrpc_internal_invoke(struct fastrpc_file *fl, uint32_t mode,
 	PERF_END);
 	if (err)
 		goto bail;
+	fastrpc_lat_record(fl, ctx);
  bail:
 	if (ctx && interrupted == -ERESTARTSYS)
 		context_save_interrupted(ctx);
@@ -2054,6 +2350,136 @@ static int fastrpc_internal_invoke(struct fastrpc_file *fl, uint32_t mode,
 	return err;
 }
 
+/*
+ * Submit an invoke and return as soon as the message is sent. The result
+ * is collected with fastrpc_internal_async_response() once the context
+ * has been queued on fl->async_done.
+ */
+static int fastrpc_internal_invoke_async(struct fastrpc_file *fl,
+				struct fastrpc_ioctl_invoke_async *ainv)
+{
+	struct smq_invoke_ctx *ctx = NULL;
+	struct fastrpc_ioctl_invoke_crc *inv = &ainv->inv;
+	struct fastrpc_ioctl_invoke *invoke = &inv->inv;
+	unsigned long flags;
+	int err = 0, cid = fl->cid;
+
+	VERIFY(err, cid >= ADSP_DOMAIN_ID && cid < NUM_CHANNELS);
+	if (err) {
+		err = -ECHRNG;
+		goto bail;
+	}
+	VERIFY(err, fl->sctx != NULL);
+	if (err) {
+		err = -EBADR;
+		goto bail;
+	}
+	VERIFY(err, invoke->handle != FASTRPC_STATIC_HANDLE_KERNEL);
+	if (err)
+		goto bail;
+
+	VERIFY(err, 0 == context_alloc(fl, 0, inv, &ctx));
+	if (err)
+		goto bail;
+	if (READ_ONCE(fastrpc_lat_enabled))
+		ctx->start_ns = ktime_get_ns();
+
+	if (REMOTE_SCALARS_LENGTH(ctx->sc)) {
+		VERIFY(err, 0 == get_args(0, ctx));
+		if (err)
+			goto bail;
+	}
+
+	if (!fl->sctx->smmu.coherent)
+		inv_args_pre(ctx);
+	ctx->args_ns = fastrpc_lat_ts(ctx);
+
+	ctx->async = 1;
+	ctx->upra = invoke->pra;
+	ctx->submit_ns = ktime_get_ns();
+	spin_lock_irqsave(&fl->async_lock, flags);
+	ctx->job_id = ++fl->async_job_id;
+	fl->async_inflight++;
+	spin_unlock_irqrestore(&fl->async_lock, flags);
+
+	VERIFY(err, 0 == fastrpc_invoke_send(ctx, 0, invoke->handle));
+	if (err) {
+		spin_lock_irqsave(&fl->async_lock, flags);
+		fl->async_inflight--;
+		spin_unlock_irqrestore(&fl->async_lock, flags);
+		goto bail;
+	}
+	ctx->sent_ns = fastrpc_lat_ts(ctx);
+	ainv->job_id = ctx->job_id;
+	return 0;
+ bail:
+	if (ctx)
+		context_free(ctx);
+	return err;
+}
+
+static int fastrpc_internal_async_response(struct fastrpc_file *fl,
+				struct fastrpc_ioctl_async_response *ares)
+{
+	struct smq_invoke_ctx *ctx = NULL;
+	unsigned long flags;
+	uint64_t lat_us;
+	int err = 0, inflight;
+
+	while (!ctx) {
+		spin_lock_irqsave(&fl->async_lock, flags);
+		ctx = list_first_entry_or_null(&fl->async_done,
+				struct smq_invoke_ctx, async_node);
+		if (ctx) {
+			list_del_init(&ctx->async_node);
+			fl->async_inflight--;
+			lat_us = div_u64(ctx->done_ns - ctx->submit_ns,
+					NSEC_PER_USEC);
+			fl->async_jobs++;
+			fl->async_lat_total_us += lat_us;
+			if (lat_us > fl->async_lat_max_us)
+				fl->async_lat_max_us = lat_us;
+		}
+		inflight = fl->async_inflight;
+		spin_unlock_irqrestore(&fl->async_lock, flags);
+		if (ctx)
+			break;
+
+		/* Nothing submitted, nothing will ever complete */
+		if (!inflight) {
+			err = -ENOENT;
+			goto bail;
+		}
+		if (ares->flags & FASTRPC_ASYNC_NONBLOCK) {
+			err = -EAGAIN;
+			goto bail;
+		}
+		err = wait_event_interruptible(fl->async_wait,
+				!list_empty(&fl->async_done));
+		if (err)
+			goto bail;
+	}
+
+	if (!fl->sctx->smmu.coherent)
+		inv_args(ctx);
+
+	err = ctx->retval;
+	if (!err)
+		err = put_args(0, ctx, ctx->upra);
+	if (!err)
+		fastrpc_lat_record(fl, ctx);
+	if (fl->ssrcount != fl->apps->channel[fl->cid].ssrcount)
+		err = ECONNRESET;
+
+	ares->job_id = ctx->job_id;
+	ares->retval = err;
+	ares->latency_us = lat_us;
+	context_free(ctx);
+	err = 0;
+ bail:
+	return err;
+}
+
 static int fastrpc_get_adsp_session(char *name, int *session)
 {
 	struct fastrpc_apps *me = &gfa;
@@ -2992,6 +3418,7 @@ static int fastrpc_file_free(struct fastrpc_file *fl)
 	hlist_del_init(&fl->hn);
 	spin_unlock(&fl->apps->hlock);
 	kfree(fl->debug_buf);
+	kfree(fl->lat);
 
 	if (!fl->sctx) {
 		kfree(fl);
@@ -3003,12 +3430,15 @@ static int fastrpc_file_free(struct fastrpc_file *fl)
 	if (!IS_ERR_OR_NULL(fl->init_mem))
 		fastrpc_buf_free(fl->init_mem, 0);
 	fastrpc_context_list_dtor(fl);
+	/* The async contexts still queued were freed with the rest */
+	INIT_LIST_HEAD(&fl->async_done);
 	fastrpc_cached_buf_list_free(fl);
 	mutex_lock(&fl->map_mutex);
+	fastrpc_mmap_cache_flush(fl);
 	do {
 		lmap = NULL;
 		hlist_for_each_entry_safe(map, n, &fl->maps, hn) {
-			hlist_del_init(&map->hn);
+			fastrpc_mmap_unlink(map);
 			lmap = map;
 			break;
 		}
@@ -3183,6 +3613,28 @@ static ssize_t fastrpc_debugfs_read(struct file *filp, char __user *buffer,
 		len += scnprintf(fileinfo + len, DEBUGFS_SIZE - len,
 			"%s %5s %d\n", "smmu.faults", ":",
 			fl->sctx->smmu.faults);
+		len += scnprintf(fileinfo + len, DEBUGFS_SIZE - len,
+			"%s %8s %llu\n", "map_hits", ":", fl->map_hits);
+		len += scnprintf(fileinfo + len, DEBUGFS_SIZE - len,
+			"%s %2s %llu\n", "map_cache_hits", ":",
+			fl->map_cache_hits);
+		len += scnprintf(fileinfo + len, DEBUGFS_SIZE - len,
+			"%s %6s %llu\n", "map_misses", ":", fl->map_misses);
+		len += scnprintf(fileinfo + len, DEBUGFS_SIZE - len,
+			"%s %5s %d (%zu bytes)\n", "cached_maps", ":",
+			fl->num_cached_maps, fl->cached_maps_size);
+		len += scnprintf(fileinfo + len, DEBUGFS_SIZE - len,
+			"%s %6s %llu\n", "async_jobs", ":", fl->async_jobs);
+		len += scnprintf(fileinfo + len, DEBUGFS_SIZE - len,
+			"%s %2s %d\n", "async_inflight", ":",
+			fl->async_inflight);
+		len += scnprintf(fileinfo + len, DEBUGFS_SIZE - len,
+			"%s %3s %llu us\n", "async_lat_avg", ":",
+			fl->async_jobs ? div64_u64(fl->async_lat_total_us,
+					fl->async_jobs) : 0);
+		len += scnprintf(fileinfo + len, DEBUGFS_SIZE - len,
+			"%s %3s %llu us\n", "async_lat_max", ":",
+			fl->async_lat_max_us);
 
 		len += scnprintf(fileinfo + len, DEBUGFS_SIZE - len,
 			"\n=======%s %s %s======\n", title,
@@ -3287,6 +3739,100 @@ static const struct file_operations debugfs_fops = {
 	.open = fastrpc_debugfs_open,
 	.read = fastrpc_debugfs_read,
 };
+
+static void fastrpc_lat_show_hist(struct seq_file *m,
+				struct fastrpc_lat_hist *hist)
+{
+	int i, j;
+
+	for (i = 0; i < FASTRPC_LAT_MAX; i++) {
+		seq_printf(m, "  %-8s avg %6llu us:", fastrpc_lat_names[i],
+			div64_u64(hist->total_us[i], hist->count));
+		for (j = 0; j < FASTRPC_LAT_BUCKETS; j++)
+			seq_printf(m, " %u", hist->bucket[i][j]);
+		seq_putc(m, '\n');
+	}
+}
+
+static int fastrpc_lat_show(struct seq_file *m, void *v)
+{
+	struct fastrpc_apps *me = &gfa;
+	struct fastrpc_file *fl;
+	struct fastrpc_lat *lat;
+	int i;
+
+	seq_printf(m, "enabled: %d\nbucket i counts [2^(i-1), 2^i) us\n",
+		READ_ONCE(fastrpc_lat_enabled));
+
+	spin_lock(&me->hlock);
+	hlist_for_each_entry(fl, &me->drivers, hn) {
+		spin_lock(&fl->lat_lock);
+		lat = fl->lat;
+		if (!lat || !lat->session.count) {
+			spin_unlock(&fl->lat_lock);
+			continue;
+		}
+		seq_printf(m, "\ntgid %d cid %d: %llu invokes\n",
+			fl->tgid, fl->cid, lat->session.count);
+		fastrpc_lat_show_hist(m, &lat->session);
+		for (i = 0; i < lat->num_methods; i++) {
+			seq_printf(m, "handle 0x%x method %u: %llu invokes\n",
+				lat->methods[i].handle, lat->methods[i].method,
+				lat->methods[i].count);
+			fastrpc_lat_show_hist(m, &lat->methods[i]);
+		}
+		if (lat->other.count) {
+			seq_printf(m, "other methods: %llu invokes\n",
+				lat->other.count);
+			fastrpc_lat_show_hist(m, &lat->other);
+		}
+		spin_unlock(&fl->lat_lock);
+	}
+	spin_unlock(&me->hlock);
+
+	return 0;
+}
+
+static int fastrpc_lat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, fastrpc_lat_show, inode->i_private);
+}
+
+/* Writing 1 clears the histograms of all files and starts profiling */
+static ssize_t fastrpc_lat_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	struct fastrpc_apps *me = &gfa;
+	struct fastrpc_file *fl;
+	bool enable;
+	int err;
+
+	err = kstrtobool_from_user(buf, count, &enable);
+	if (err)
+		return err;
+
+	if (enable && !READ_ONCE(fastrpc_lat_enabled)) {
+		spin_lock(&me->hlock);
+		hlist_for_each_entry(fl, &me->drivers, hn) {
+			spin_lock(&fl->lat_lock);
+			if (fl->lat)
+				memset(fl->lat, 0, sizeof(*fl->lat));
+			spin_unlock(&fl->lat_lock);
+		}
+		spin_unlock(&me->hlock);
+	}
+	WRITE_ONCE(fastrpc_lat_enabled, enable);
+
+	return count;
+}
+
+static const struct file_operations debugfs_lat_fops = {
+	.open = fastrpc_lat_open,
+	.read = seq_read,
+	.write = fastrpc_lat_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
 static int fastrpc_channel_open(struct fastrpc_file *fl)
 {
 	struct fastrpc_apps *me = &gfa;
@@ -3366,6 +3912,12 @@ static int fastrpc_device_open(struct inode *inode, struct file *filp)
 	context_list_ctor(&fl->clst);
 	spin_lock_init(&fl->hlock);
 	INIT_HLIST_HEAD(&fl->maps);
+	hash_init(fl->map_hash);
+	INIT_LIST_HEAD(&fl->cached_maps);
+	spin_lock_init(&fl->async_lock);
+	spin_lock_init(&fl->lat_lock);
+	INIT_LIST_HEAD(&fl->async_done);
+	init_waitqueue_head(&fl->async_wait);
 	INIT_HLIST_HEAD(&fl->perf);
 	INIT_HLIST_HEAD(&fl->cached_bufs);
 	INIT_HLIST_HEAD(&fl->remote_bufs);
@@ -3518,6 +4070,8 @@ static long fastrpc_device_ioctl(struct file *file, unsigned int ioctl_num,
 {
 	union {
 		struct fastrpc_ioctl_invoke_crc inv;
+		struct fastrpc_ioctl_invoke_async ainv;
+		struct fastrpc_ioctl_async_response ares;
 		struct fastrpc_ioctl_mmap mmap;
 		struct fastrpc_ioctl_mmap_64 mmap64;
 		struct fastrpc_ioctl_munmap munmap;
@@ -3583,6 +4137,30 @@ static long fastrpc_device_ioctl(struct file *file, unsigned int ioctl_num,
 		if (err)
 			goto bail;
 		break;
+	case FASTRPC_IOCTL_INVOKE_ASYNC:
+		K_COPY_FROM_USER(err, 0, &p.ainv, param, sizeof(p.ainv));
+		if (err)
+			goto bail;
+		VERIFY(err, 0 == (err = fastrpc_internal_invoke_async(fl,
+						&p.ainv)));
+		if (err)
+			goto bail;
+		K_COPY_TO_USER(err, 0, param, &p.ainv, sizeof(p.ainv));
+		if (err)
+			goto bail;
+		break;
+	case FASTRPC_IOCTL_ASYNC_RESPONSE:
+		K_COPY_FROM_USER(err, 0, &p.ares, param, sizeof(p.ares));
+		if (err)
+			goto bail;
+		VERIFY(err, 0 == (err = fastrpc_internal_async_response(fl,
+						&p.ares)));
+		if (err)
+			goto bail;
+		K_COPY_TO_USER(err, 0, param, &p.ares, sizeof(p.ares));
+		if (err)
+			goto bail;
+		break;
 	case FASTRPC_IOCTL_MMAP:
 		K_COPY_FROM_USER(err, 0, &p.mmap, param,
 						sizeof(p.mmap));
@@ -3863,9 +4441,25 @@ static int fastrpc_get_service_location_notify(struct notifier_block *nb,
 	return NOTIFY_DONE;
 }
 
+static unsigned int fastrpc_device_poll(struct file *file, poll_table *wait)
+{
+	struct fastrpc_file *fl = (struct fastrpc_file *)file->private_data;
+	unsigned int mask = 0;
+	unsigned long flags;
+
+	poll_wait(file, &fl->async_wait, wait);
+	spin_lock_irqsave(&fl->async_lock, flags);
+	if (!list_empty(&fl->async_done))
+		mask |= POLLIN | POLLRDNORM;
+	spin_unlock_irqrestore(&fl->async_lock, flags);
+
+	return mask;
+}
+
 static const struct file_operations fops = {
 	.open = fastrpc_device_open,
 	.release = fastrpc_device_release,
+	.poll = fastrpc_device_poll,
 	.unlocked_ioctl = fastrpc_device_ioctl,
 	.compat_ioctl = compat_fastrpc_device_ioctl,
 };
@@ -4450,6 +5044,11 @@ static int __init fastrpc_device_init(void)
 			current->comm, __func__);
 		debugfs_remove_recursive(debugfs_root);
 		debugfs_root = NULL;
+	} else {
+		debugfs_lat_file = debugfs_create_file("latency", 0644,
+			debugfs_root, NULL, &debugfs_lat_fops);
+		if (IS_ERR_OR_NULL(debugfs_lat_file))
+			debugfs_lat_file = NULL;
 	}
 	memset(me, 0, sizeof(*me));
 	fastrpc_init(me);
@@ -32,6 +32,10 @@
 #define FASTRPC_IOCTL_INVOKE_CRC _IOWR('R', 11, struct fastrpc_ioctl_invoke_crc)
 #define FASTRPC_IOCTL_CONTROL   _IOWR('R', 12, struct fastrpc_ioctl_control)
 #define FASTRPC_IOCTL_MUNMAP_FD _IOWR('R', 13, struct fastrpc_ioctl_munmap_fd)
+#define FASTRPC_IOCTL_INVOKE_ASYNC \
+			_IOWR('R', 16, struct fastrpc_ioctl_invoke_async)
+#define FASTRPC_IOCTL_ASYNC_RESPONSE \
+			_IOWR('R', 17, struct fastrpc_ioctl_async_response)
 
 #define FASTRPC_GLINK_GUID "fastrpcglink-apps-dsp"
 #define FASTRPC_SMD_GUID "fastrpcsmd-apps-dsp"
@@ -71,6 +75,9 @@
 #define FASTRPC_INIT_CREATE_STATIC  2
 #define FASTRPC_INIT_ATTACH_SENSORS 3
 
+/* Retrives the remote method index from the scalars parameter */
+#define REMOTE_SCALARS_METHOD(sc)        (((sc) >> 24) & 0x1f)
+
 /* Retrives number of input buffers from the scalars parameter */
 #define REMOTE_SCALARS_INBUFS(sc)        (((sc) >> 16) & 0x0ff)
 
@@ -186,6 +193,21 @@ struct fastrpc_ioctl_invoke_crc {
 	unsigned int *crc;
 };
 
+struct fastrpc_ioctl_invoke_async {
+	struct fastrpc_ioctl_invoke_crc inv;
+	uint64_t job_id;	/* returned, matches the async response */
+};
+
+/* Fail with EAGAIN instead of waiting when nothing has completed yet */
+#define FASTRPC_ASYNC_NONBLOCK	0x1
+
+struct fastrpc_ioctl_async_response {
+	uint32_t flags;		/* FASTRPC_ASYNC_* */
+	int retval;		/* result of the completed invoke */
+	uint64_t job_id;	/* job the result belongs to */
+	uint64_t latency_us;	/* submit to completion by the DSP */
+};
+
 struct fastrpc_ioctl_init {
 	uint32_t flags;		/* one of FASTRPC_INIT_* macros */
 	uintptr_t file;		/* pointer to elf file */
@@ -368,8 +368,12 @@ static ssize_t diag_dbgfs_read_mempool(struct file *file, char __user *ubuf,
 			"%-10s\t"
 			"%-5s\t"
 			"%-5s\t"
-			"%-5s\n",
-			"POOL", "HANDLE", "COUNT", "SIZE", "ITEMSIZE");
+			"%-5s\t"
+			"%-5s\t"
+			"%-8s\t"
+			"%-8s\n",
+			"POOL", "HANDLE", "COUNT", "SIZE", "ITEMSIZE",
+			"HWM", "FAILED", "PCP_HITS");
 	bytes_in_buffer += bytes_written;
 	bytes_remaining = buf_size - bytes_in_buffer;
 
@@ -380,12 +384,18 @@ static ssize_t diag_dbgfs_read_mempool(struct file *file, char __user *ubuf,
 			"%-10p\t"
 			"%-5d\t"
 			"%-5d\t"
-			"%-5d\n",
+			"%-5d\t"
+			"%-5d\t"
+			"%-8u\t"
+			"%-8u\n",
 			mempool->name,
 			mempool->pool,
 			mempool->count,
 			mempool->poolsize,
-			mempool->itemsize);
+			mempool->itemsize,
+			mempool->hwm,
+			mempool->fail_cnt,
+			mempool->pcp_hits);
 		bytes_in_buffer += bytes_written;
 
 		/* Check if there is room to add another table entry */
@@ -413,6 +423,7 @@ static ssize_t diag_dbgfs_read_usbinfo(struct file *file, char __user *ubuf,
 	unsigned int bytes_written = 0;
 	unsigned int bytes_in_buffer = 0;
 	struct diag_usb_info *usb_info = NULL;
+	bool idle;
 
 	if (diag_dbgfs_usbinfo_index >= NUM_DIAG_USB_DEV) {
 		/* Done. Reset to prepare for future requests */
@@ -432,6 +443,8 @@ static ssize_t diag_dbgfs_read_usbinfo(struct file *file, char __user *ubuf,
 		usb_info = &diag_usb[i];
 		if (!usb_info->enabled)
 			continue;
+		/* rates are only refreshed by traffic */
+		idle = time_after(jiffies, usb_info->rate_stamp + 2 * HZ);
 		bytes_written = scnprintf(buf+bytes_in_buffer, bytes_remaining,
 			"id: %d\n"
 			"name: %s\n"
@@ -446,7 +459,12 @@ static ssize_t diag_dbgfs_read_usbinfo(struct file *file, char __user *ubuf,
 			"read work pending: %d\n"
 			"read done work pending: %d\n"
 			"event work pending: %d\n"
-			"max size supported: %d\n\n",
+			"max size supported: %d\n"
+			"sg write count: %lu\n"
+			"tx bytes: %llu\n"
+			"tx bytes/sec: %lu\n"
+			"dropped: %lu (%llu bytes)\n"
+			"drops/sec: %lu\n\n",
 			usb_info->id,
 			usb_info->name,
 			usb_info->hdl,
@@ -460,7 +478,13 @@ static ssize_t diag_dbgfs_read_usbinfo(struct file *file, char __user *ubuf,
 			work_pending(&usb_info->read_work),
 			work_pending(&usb_info->read_done_work),
 			work_pending(&usb_info->event_work),
-			usb_info->max_size);
+			usb_info->max_size,
+			usb_info->sg_write_cnt,
+			usb_info->tx_bytes,
+			idle ? 0 : usb_info->tx_bps,
+			usb_info->drop_cnt,
+			usb_info->drop_bytes,
+			idle ? 0 : usb_info->drop_ps);
 		bytes_in_buffer += bytes_written;
 
 		/* Check if there is room to add another table entry */
@@ -16,9 +16,11 @@
 #include <linux/kmemleak.h>
 #include <linux/workqueue.h>
 #include <linux/uaccess.h>
+#include <linux/rcupdate.h>
 #include "diagchar.h"
 #include "diagfwd_cntl.h"
 #include "diag_masks.h"
+#include "diag_dci.h"
 #include "diagfwd_peripheral.h"
 #include "diag_ipc_logging.h"
 
@@ -29,6 +31,39 @@
 
 #define MAX_USERSPACE_BUF_SIZ	100000
 
+#define DIAG_CMD_EXT_MSG	0x79
+
+/*
+ * Flattened copy of the global log and msg masks, used to filter packets
+ * logged on the apps processor. Msg masks are looked up through buckets
+ * of DIAG_MASK_SNAP_BKT_SZ SSIDs that map into @msg_rt.
+ */
+#define DIAG_MASK_SNAP_LOG_BYTES	LOG_ITEMS_TO_SIZE(MAX_ITEMS_ALLOWED + 1)
+#define DIAG_MASK_SNAP_BKT_SHIFT	5
+#define DIAG_MASK_SNAP_BKT_SZ		(1 << DIAG_MASK_SNAP_BKT_SHIFT)
+#define DIAG_MASK_SNAP_NUM_BKT		(0x10000 >> DIAG_MASK_SNAP_BKT_SHIFT)
+
+struct diag_mask_snapshot {
+	struct rcu_head rcu;
+	uint8_t log_status;
+	uint8_t msg_status;
+	uint32_t log_items[MAX_EQUIP_ID];
+	uint8_t log[MAX_EQUIP_ID][DIAG_MASK_SNAP_LOG_BYTES];
+	/* 1 + bucket index into msg_rt, 0 if no SSID in the bucket */
+	uint16_t bkt[DIAG_MASK_SNAP_NUM_BKT];
+	uint32_t *msg_rt;
+};
+
+/*
+ * Drop log and F3 packets written by apps clients when the current
+ * global masks have them turned off, before they are framed and sent.
+ */
+static bool apps_mask_filter = true;
+module_param(apps_mask_filter, bool, 0644);
+
+static struct diag_mask_snapshot __rcu *diag_mask_snap;
+static DEFINE_MUTEX(diag_mask_snap_mutex);
+
 struct diag_mask_info msg_mask;
 struct diag_mask_info msg_bt_mask;
 struct diag_mask_info log_mask;
@@ -2423,9 +2458,232 @@ void diag_send_updates_peripheral(uint8_t peripheral)
 	}
 }
 
+static void diag_mask_snap_free(struct rcu_head *head)
+{
+	struct diag_mask_snapshot *snap;
+
+	snap = container_of(head, struct diag_mask_snapshot, rcu);
+	kfree(snap->msg_rt);
+	kfree(snap);
+}
+
+static void diag_mask_snap_log(struct diag_mask_snapshot *snap)
+{
+	struct diag_log_mask_t *item;
+	uint32_t size;
+	int i;
+
+	mutex_lock(&log_mask.lock);
+	snap->log_status = log_mask.status;
+	item = (struct diag_log_mask_t *)log_mask.ptr;
+	for (i = 0; item && i < MAX_EQUIP_ID; i++, item++) {
+		if (item->equip_id >= MAX_EQUIP_ID)
+			continue;
+		mutex_lock(&item->lock);
+		size = min_t(uint32_t, LOG_ITEMS_TO_SIZE(item->num_items_tools),
+			     item->range);
+		size = min_t(uint32_t, size, DIAG_MASK_SNAP_LOG_BYTES);
+		if (item->ptr && size) {
+			memcpy(snap->log[item->equip_id], item->ptr, size);
+			snap->log_items[item->equip_id] =
+				min_t(uint32_t, item->num_items_tools,
+				      size * 8);
+		}
+		mutex_unlock(&item->lock);
+	}
+	mutex_unlock(&log_mask.lock);
+}
+
+static int diag_mask_snap_msg(struct diag_mask_snapshot *snap)
+{
+	struct diag_msg_mask_t *first, *item;
+	uint32_t ssid, last, nbkt = 0;
+	uint16_t bkt;
+	int i, err = 0;
+
+	mutex_lock(&msg_mask.lock);
+	mutex_lock(&driver->msg_mask_lock);
+	snap->msg_status = msg_mask.status;
+	first = (struct diag_msg_mask_t *)msg_mask.ptr;
+
+	/* Give every bucket holding a known SSID a slot in msg_rt */
+	for (i = 0, item = first; item && i < driver->msg_mask_tbl_count;
+	     i++, item++) {
+		last = item->ssid_first + min(item->range, item->range_tools);
+		for (ssid = item->ssid_first; ssid < last && ssid <= 0xFFFF;
+		     ssid += DIAG_MASK_SNAP_BKT_SZ) {
+			if (!snap->bkt[ssid >> DIAG_MASK_SNAP_BKT_SHIFT])
+				snap->bkt[ssid >> DIAG_MASK_SNAP_BKT_SHIFT] =
+					++nbkt;
+		}
+		ssid = last - 1;
+		if (last > item->ssid_first && ssid <= 0xFFFF &&
+		    !snap->bkt[ssid >> DIAG_MASK_SNAP_BKT_SHIFT])
+			snap->bkt[ssid >> DIAG_MASK_SNAP_BKT_SHIFT] = ++nbkt;
+	}
+
+	if (nbkt) {
+		snap->msg_rt = kcalloc(nbkt * DIAG_MASK_SNAP_BKT_SZ,
+				       sizeof(uint32_t), GFP_KERNEL);
+		if (!snap->msg_rt) {
+			err = -ENOMEM;
+			goto out;
+		}
+	}
+
+	for (i = 0, item = first; item && i < driver->msg_mask_tbl_count;
+	     i++, item++) {
+		mutex_lock(&item->lock);
+		last = item->ssid_first + min(item->range, item->range_tools);
+		for (ssid = item->ssid_first; item->ptr && ssid < last &&
+		     ssid <= 0xFFFF; ssid++) {
+			bkt = snap->bkt[ssid >> DIAG_MASK_SNAP_BKT_SHIFT];
+			if (!bkt)
+				continue;
+			snap->msg_rt[(bkt - 1) * DIAG_MASK_SNAP_BKT_SZ +
+				     (ssid & (DIAG_MASK_SNAP_BKT_SZ - 1))] =
+				item->ptr[ssid - item->ssid_first];
+		}
+		mutex_unlock(&item->lock);
+	}
+out:
+	mutex_unlock(&driver->msg_mask_lock);
+	mutex_unlock(&msg_mask.lock);
+	return err;
+}
+
+/*
+ * Rebuild the mask snapshot from the global masks and publish it. Called
+ * after every mask command so the per-packet check needs no mutex.
+ */
+static void diag_mask_snap_update(void)
+{
+	struct diag_mask_snapshot *snap, *old;
+
+	snap = kzalloc(sizeof(*snap), GFP_KERNEL);
+	if (!snap)
+		goto fail;
+
+	mutex_lock(&diag_mask_snap_mutex);
+	diag_mask_snap_log(snap);
+	if (diag_mask_snap_msg(snap)) {
+		mutex_unlock(&diag_mask_snap_mutex);
+		kfree(snap);
+		goto fail;
+	}
+	old = rcu_dereference_protected(diag_mask_snap,
+				lockdep_is_held(&diag_mask_snap_mutex));
+	rcu_assign_pointer(diag_mask_snap, snap);
+	mutex_unlock(&diag_mask_snap_mutex);
+
+	if (old)
+		call_rcu(&old->rcu, diag_mask_snap_free);
+	return;
+fail:
+	/* Better to let everything through than filter on stale masks */
+	mutex_lock(&diag_mask_snap_mutex);
+	old = rcu_dereference_protected(diag_mask_snap,
+				lockdep_is_held(&diag_mask_snap_mutex));
+	RCU_INIT_POINTER(diag_mask_snap, NULL);
+	mutex_unlock(&diag_mask_snap_mutex);
+	if (old)
+		call_rcu(&old->rcu, diag_mask_snap_free);
+}
+
+static bool diag_mask_snap_log_on(struct diag_mask_snapshot *snap,
+				  uint16_t log_code)
+{
+	uint8_t equip_id = LOG_GET_EQUIP_ID(log_code);
+	uint16_t item = LOG_GET_ITEM_NUM(log_code);
+
+	switch (snap->log_status) {
+	case DIAG_CTRL_MASK_ALL_DISABLED:
+		return false;
+	case DIAG_CTRL_MASK_VALID:
+		if (item >= snap->log_items[equip_id])
+			return false;
+		return snap->log[equip_id][item / 8] & (1 << (item % 8));
+	default:
+		return true;
+	}
+}
+
+static bool diag_mask_snap_msg_on(struct diag_mask_snapshot *snap,
+				  uint16_t ssid, uint32_t level)
+{
+	uint16_t bkt;
+
+	switch (snap->msg_status) {
+	case DIAG_CTRL_MASK_ALL_DISABLED:
+		return false;
+	case DIAG_CTRL_MASK_VALID:
+		bkt = snap->bkt[ssid >> DIAG_MASK_SNAP_BKT_SHIFT];
+		if (!bkt)
+			return false;
+		return snap->msg_rt[(bkt - 1) * DIAG_MASK_SNAP_BKT_SZ +
+				    (ssid & (DIAG_MASK_SNAP_BKT_SZ - 1))] &
+		       level;
+	default:
+		return true;
+	}
+}
+
+/*
+ * diag_apps_pkt_masked() - Check an apps packet against the global masks
+ * @buf: the packet as written by the apps client
+ * @len: length of the packet
+ * @pkt_type: DATA_TYPE_* of the packet
+ *
+ * Only single log packets and extended F3 messages are checked; anything
+ * else, and anything logged to a memory device session with masks of its
+ * own, is let through.
+ *
+ * Return: 1 if the packet is masked off and can be dropped, 0 otherwise.
+ */
+int diag_apps_pkt_masked(unsigned char *buf, int len, int pkt_type)
+{
+	struct diag_mask_snapshot *snap;
+	bool on = true;
+
+	if (!apps_mask_filter || !buf)
+		return 0;
+	if (driver->md_session_mask[DIAG_LOCAL_PROC] &
+	    MD_PERIPHERAL_MASK(APPS_DATA))
+		return 0;
+
+	rcu_read_lock();
+	snap = rcu_dereference(diag_mask_snap);
+	if (!snap)
+		goto out;
+
+	switch (pkt_type) {
+	case DATA_TYPE_LOG:
+		/* cmd (1), more (1), len (2), log len (2), log code (2) */
+		if (len < 8 || buf[0] != LOG_CMD_CODE ||
+		    *(uint16_t *)(buf + 2) != len - 4)
+			break;
+		on = diag_mask_snap_log_on(snap, *(uint16_t *)(buf + 6));
+		break;
+	case DATA_TYPE_F3:
+		/* header (4), timestamp (8), line (2), ssid (2), mask (4) */
+		if (len < 20 || buf[0] != DIAG_CMD_EXT_MSG)
+			break;
+		on = diag_mask_snap_msg_on(snap, *(uint16_t *)(buf + 14),
+					   *(uint32_t *)(buf + 16));
+		break;
+	default:
+		break;
+	}
+out:
+	rcu_read_unlock();
+
+	return on ? 0 : 1;
+}
+
 int diag_process_apps_masks(unsigned char *buf, int len, int pid)
 {
 	int size = 0, sub_cmd = 0;
+	bool update = true;
 	int (*hdlr)(unsigned char *src_buf, int src_len,
 		    unsigned char *dest_buf, int dest_len, int pid) = NULL;
 
@@ -2442,6 +2700,7 @@ int diag_process_apps_masks(unsigned char *buf, int len, int pid)
 			break;
 		case DIAG_CMD_OP_GET_LOG_RANGE:
 			hdlr = diag_cmd_get_log_range;
+			update = false;
 			break;
 		case DIAG_CMD_OP_SET_LOG_MASK:
 			hdlr = diag_cmd_set_log_mask;
@@ -2449,6 +2708,7 @@ int diag_process_apps_masks(unsigned char *buf, int len, int pid)
 			break;
 		case DIAG_CMD_OP_GET_LOG_MASK:
 			hdlr = diag_cmd_get_log_mask;
+			update = false;
 			break;
 		}
 	} else if (*buf == DIAG_CMD_MSG_CONFIG) {
@@ -2458,12 +2718,15 @@ int diag_process_apps_masks(unsigned char *buf, int len, int pid)
 		switch (sub_cmd) {
 		case DIAG_CMD_OP_GET_SSID_RANGE:
 			hdlr = diag_cmd_get_ssid_range;
+			update = false;
 			break;
 		case DIAG_CMD_OP_GET_BUILD_MASK:
 			hdlr = diag_cmd_get_build_mask;
+			update = false;
 			break;
 		case DIAG_CMD_OP_GET_MSG_MASK:
 			hdlr = diag_cmd_get_msg_mask;
+			update = false;
 			break;
 		case DIAG_CMD_OP_SET_MSG_MASK:
 			hdlr = diag_cmd_set_msg_mask;
@@ -2476,6 +2739,7 @@ int diag_process_apps_masks(unsigned char *buf, int len, int pid)
 		}
 	} else if (*buf == DIAG_CMD_GET_EVENT_MASK) {
 		hdlr = diag_cmd_get_event_mask;
+		update = false;
 	} else if (*buf == DIAG_CMD_SET_EVENT_MASK) {
 		hdlr = diag_cmd_update_event_mask;
 		driver->set_mask_cmd = 1;
@@ -2484,9 +2748,12 @@ int diag_process_apps_masks(unsigned char *buf, int len, int pid)
 		driver->set_mask_cmd = 1;
 	}
 
-	if (hdlr)
+	if (hdlr) {
 		size = hdlr(buf, len, driver->apps_rsp_buf,
 			    DIAG_MAX_RSP_SIZE, pid);
+		if (update)
+			diag_mask_snap_update();
+	}
 
 	return (size > 0) ? size : 0;
 }
@@ -2511,6 +2778,8 @@ int diag_masks_init(void)
 	if (err)
 		goto fail;
 
+	diag_mask_snap_update();
+
 	if (driver->buf_feature_mask_update == NULL) {
 		driver->buf_feature_mask_update = kzalloc(sizeof(
 					struct diag_ctrl_feature_mask) +
@@ -2529,6 +2798,18 @@ int diag_masks_init(void)
 
 void diag_masks_exit(void)
 {
+	struct diag_mask_snapshot *snap;
+
+	mutex_lock(&diag_mask_snap_mutex);
+	snap = rcu_dereference_protected(diag_mask_snap,
+				lockdep_is_held(&diag_mask_snap_mutex));
+	RCU_INIT_POINTER(diag_mask_snap, NULL);
+	mutex_unlock(&diag_mask_snap_mutex);
+	if (snap) {
+		synchronize_rcu();
+		diag_mask_snap_free(&snap->rcu);
+	}
+
 	diag_msg_mask_exit();
 	diag_build_time_mask_exit();
 	diag_log_mask_exit();
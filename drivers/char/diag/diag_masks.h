@@ -176,6 +176,7 @@ void diag_msg_mask_free(struct diag_mask_info *mask_info,
 	struct diag_md_session_t *session_info);
 void diag_event_mask_free(struct diag_mask_info *mask_info);
 int diag_process_apps_masks(unsigned char *buf, int len, int pid);
+int diag_apps_pkt_masked(unsigned char *buf, int len, int pkt_type);
 void diag_send_updates_peripheral(uint8_t peripheral);
 
 extern int diag_create_msg_mask_table_entry(struct diag_msg_mask_t *msg_mask,
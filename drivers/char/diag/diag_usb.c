@@ -23,6 +23,7 @@
 #include <linux/delay.h>
 #include <linux/kmemleak.h>
 #include <linux/list.h>
+#include <linux/math64.h>
 #ifdef CONFIG_DIAG_OVER_USB
 #include <linux/usb/usbdiag.h>
 #endif
@@ -34,6 +35,18 @@
 
 #define DIAG_USB_STRING_SZ	10
 #define DIAG_USB_MAX_SIZE	16384
+#define DIAG_USB_MAX_SEGS	8
+
+/*
+ * In zero-copy mode a buffer larger than the USB request size is queued
+ * as one scatter list: the requests for all of its segments are reserved
+ * up front and each of them points straight into the peripheral buffer.
+ * The buffer goes back to its peripheral channel only when the last
+ * segment completes, and it is either queued whole or dropped whole, so
+ * running out of requests never cuts a frame in half.
+ */
+static bool zero_copy;
+module_param(zero_copy, bool, 0644);
 
 struct diag_usb_info diag_usb[NUM_DIAG_USB_DEV] = {
 	{
@@ -162,8 +175,10 @@ static void diag_usb_buf_tbl_remove(struct diag_usb_info *usb_info,
 			 * Remove reference from the table if it is the
 			 * only instance of the buffer
 			 */
-			if (atomic_read(&entry->ref_count) == 0)
+			if (atomic_read(&entry->ref_count) == 0) {
 				list_del(&entry->track);
+				kfree(entry);
+			}
 			break;
 		}
 	}
@@ -358,6 +373,30 @@ static void usb_read_done_work_fn(struct work_struct *work)
 		ch->ops->read_done(req->buf, req->actual, ch->ctxt);
 }
 
+/* Called with write_lock held */
+static void diag_usb_update_rate(struct diag_usb_info *ch)
+{
+	unsigned long elapsed = jiffies - ch->rate_stamp;
+
+	if (elapsed < HZ)
+		return;
+
+	ch->tx_bps = div64_u64((ch->tx_bytes - ch->rate_tx_bytes) * HZ,
+			       elapsed);
+	ch->drop_ps = (ch->drop_cnt - ch->rate_drop_cnt) * HZ / elapsed;
+	ch->rate_tx_bytes = ch->tx_bytes;
+	ch->rate_drop_cnt = ch->drop_cnt;
+	ch->rate_stamp = jiffies;
+}
+
+/* Called with write_lock held */
+static void diag_usb_count_drop(struct diag_usb_info *ch, int len)
+{
+	ch->drop_cnt++;
+	ch->drop_bytes += len;
+	diag_usb_update_rate(ch);
+}
+
 static void diag_usb_write_done(struct diag_usb_info *ch,
 				struct diag_request *req)
 {
@@ -372,6 +411,13 @@ static void diag_usb_write_done(struct diag_usb_info *ch,
 
 	spin_lock_irqsave(&ch->write_lock, flags);
 	ch->write_cnt++;
+	if (req->status) {
+		diag_usb_count_drop(ch, req->length);
+	} else {
+		ch->tx_bytes += req->actual;
+		diag_usb_update_rate(ch);
+	}
+
 	entry = diag_usb_buf_tbl_get(ch, req->context);
 	if (!entry) {
 		pr_err_ratelimited("diag: In %s, unable to find entry %pK in the table\n",
@@ -494,6 +540,7 @@ static int diag_usb_write_ext(struct diag_usb_info *usb_info,
 			 */
 			pr_err_ratelimited("diag: In %s, cannot retrieve USB write ptrs for USB channel %s\n",
 					   __func__, usb_info->name);
+			diag_usb_count_drop(usb_info, bytes_remaining);
 			spin_unlock_irqrestore(&usb_info->write_lock, flags);
 			return -ENOMEM;
 		}
@@ -531,6 +578,7 @@ static int diag_usb_write_ext(struct diag_usb_info *usb_info,
 			diag_ws_on_copy_fail(DIAG_WS_MUX);
 			diag_usb_buf_tbl_remove(usb_info, buf);
 			diagmem_free(driver, req, usb_info->mempool);
+			diag_usb_count_drop(usb_info, bytes_remaining);
 			spin_unlock_irqrestore(&usb_info->write_lock, flags);
 			return err;
 		}
@@ -546,6 +594,98 @@ static int diag_usb_write_ext(struct diag_usb_info *usb_info,
 	return 0;
 }
 
+/*
+ * Zero-copy counterpart of diag_usb_write_ext(). Returns an error only if
+ * nothing was queued, in which case the caller still owns @buf. Once a
+ * segment is in flight @buf belongs to USB until the write done of the
+ * last queued segment, even if later segments could not be queued.
+ */
+static int diag_usb_write_sg(struct diag_usb_info *usb_info,
+			     unsigned char *buf, int len, int ctxt)
+{
+	struct diag_request *segs[DIAG_USB_MAX_SEGS];
+	struct diag_request *req = NULL;
+	int nsegs, queued, offset = 0;
+	int i, err = 0;
+	unsigned long flags;
+
+	nsegs = DIV_ROUND_UP(len, usb_info->max_size);
+
+	spin_lock_irqsave(&usb_info->write_lock, flags);
+	if (!usb_info->hdl || !atomic_read(&usb_info->connected) ||
+	    !atomic_read(&usb_info->diag_state)) {
+		pr_debug_ratelimited("diag: USB ch %s is not connected\n",
+				     usb_info->name);
+		spin_unlock_irqrestore(&usb_info->write_lock, flags);
+		return -ENODEV;
+	}
+
+	for (i = 0; i < nsegs; i++) {
+		segs[i] = diagmem_alloc(driver, sizeof(struct diag_request),
+					usb_info->mempool);
+		if (!segs[i]) {
+			pr_err_ratelimited("diag: In %s, cannot retrieve %d USB write ptrs for USB channel %s\n",
+					   __func__, nsegs, usb_info->name);
+			err = -ENOMEM;
+			goto fail_free;
+		}
+	}
+
+	for (i = 0; i < nsegs; i++) {
+		if (diag_usb_buf_tbl_add(usb_info, buf, len, ctxt)) {
+			err = -ENOMEM;
+			goto fail_unref;
+		}
+	}
+
+	for (queued = 0; queued < nsegs; queued++) {
+		req = segs[queued];
+		req->buf = buf + offset;
+		req->length = min(len - offset, usb_info->max_size);
+		req->context = (void *)buf;
+
+		diag_ws_on_read(DIAG_WS_MUX, len);
+		err = usb_diag_write(usb_info->hdl, req);
+		diag_ws_on_copy(DIAG_WS_MUX);
+		if (err) {
+			pr_err_ratelimited("diag: In %s, error writing segment %d/%d to usb channel %s, err: %d\n",
+					   __func__, queued, nsegs,
+					   usb_info->name, err);
+			diag_ws_on_copy_fail(DIAG_WS_MUX);
+			break;
+		}
+		offset += req->length;
+	}
+
+	if (queued < nsegs) {
+		diag_usb_count_drop(usb_info, len - offset);
+		for (i = queued; i < nsegs; i++) {
+			diag_usb_buf_tbl_remove(usb_info, buf);
+			diagmem_free(driver, segs[i], usb_info->mempool);
+		}
+		/* The queued segments return the buffer on completion */
+		if (queued)
+			err = 0;
+	} else {
+		usb_info->sg_write_cnt++;
+	}
+	spin_unlock_irqrestore(&usb_info->write_lock, flags);
+
+	return err;
+
+fail_unref:
+	while (i--)
+		diag_usb_buf_tbl_remove(usb_info, buf);
+	i = nsegs;
+fail_free:
+	while (i--)
+		diagmem_free(driver, segs[i], usb_info->mempool);
+	diag_usb_count_drop(usb_info, len);
+	spin_unlock_irqrestore(&usb_info->write_lock, flags);
+
+	return err;
+}
+
 int diag_usb_write(int id, unsigned char *buf, int len, int ctxt)
 {
 	int err = 0;
@@ -567,6 +707,9 @@ int diag_usb_write(int id, unsigned char *buf, int len, int ctxt)
 	if (len > usb_info->max_size) {
 		DIAG_LOG(DIAG_DEBUG_MUX, "len: %d, max_size: %d\n",
 			 len, usb_info->max_size);
+		if (zero_copy && DIV_ROUND_UP(len, usb_info->max_size) <=
+		    DIAG_USB_MAX_SEGS)
+			return diag_usb_write_sg(usb_info, buf, len, ctxt);
 		return diag_usb_write_ext(usb_info, buf, len, ctxt);
 	}
 
@@ -584,6 +727,7 @@ int diag_usb_write(int id, unsigned char *buf, int len, int ctxt)
 		pr_err_ratelimited("diag: In %s, cannot retrieve USB write ptrs for USB channel %s\n",
 				   __func__, usb_info->name);
 		diag_usb_buf_tbl_remove(usb_info, buf);
+		diag_usb_count_drop(usb_info, len);
 		spin_unlock_irqrestore(&usb_info->write_lock, flags);
 		return -ENOMEM;
 	}
@@ -606,6 +750,7 @@ int diag_usb_write(int id, unsigned char *buf, int len, int ctxt)
 					"ERR! unable to add buf %pK to table\n",
 			 buf);
 		diagmem_free(driver, req, usb_info->mempool);
+		diag_usb_count_drop(usb_info, len);
 		spin_unlock_irqrestore(&usb_info->write_lock, flags);
 		return -ENOMEM;
 	}
@@ -621,6 +766,7 @@ int diag_usb_write(int id, unsigned char *buf, int len, int ctxt)
 			 "ERR! unable to write t usb, err: %d\n", err);
 		diag_usb_buf_tbl_remove(usb_info, buf);
 		diagmem_free(driver, req, usb_info->mempool);
+		diag_usb_count_drop(usb_info, len);
 	}
 	spin_unlock_irqrestore(&usb_info->write_lock, flags);
 
@@ -64,6 +64,15 @@ struct diag_usb_info {
 	struct list_head buf_tbl;
 	unsigned long read_cnt;
 	unsigned long write_cnt;
+	unsigned long sg_write_cnt;
+	unsigned long drop_cnt;
+	unsigned long long drop_bytes;
+	unsigned long long tx_bytes;
+	unsigned long long rate_tx_bytes;
+	unsigned long rate_drop_cnt;
+	unsigned long rate_stamp;
+	unsigned long tx_bps;
+	unsigned long drop_ps;
 	spinlock_t lock;
 	spinlock_t write_lock;
 	spinlock_t event_lock;
@@ -3608,6 +3608,11 @@ static int diag_user_process_apps_data(const char __user *buf, int len,
 		return -EBADMSG;
 	}
 
+	if (diag_apps_pkt_masked(user_space_data, len, pkt_type)) {
+		diagmem_free(driver, user_space_data, mempool);
+		return 0;
+	}
+
 	if (driver->stm_state[APPS_DATA] &&
 	    (pkt_type >= DATA_TYPE_EVENT) && (pkt_type <= DATA_TYPE_LOG)) {
 		stm_size = stm_log_inv_ts(OST_ENTITY_DIAG, 0, user_space_data,
@@ -4504,6 +4509,7 @@ static int __init diagchar_init(void)
 			diag_update_md_client_work_fn);
 	diag_ws_init();
 	diag_stats_init();
+	diag_hdlc_init();
 	diag_debug_init();
 	diag_md_session_init();
 
@@ -20,6 +20,8 @@
 #include <linux/uaccess.h>
 #include <linux/ratelimit.h>
 #include <linux/crc-ccitt.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
 #include "diagchar_hdlc.h"
 #include "diagchar.h"
 
@@ -31,6 +33,79 @@ MODULE_LICENSE("GPL v2");
 #define CRC_16_L_STEP(xx_crc, xx_c) \
 	crc_ccitt_byte(xx_crc, xx_c)
 
+/*
+ * Slicing-by-8 tables for the CRC: entry [k][i] is the CRC of byte i
+ * followed by k zero bytes, so eight bytes are folded with eight
+ * independent lookups. Row 0 is crc_ccitt_table.
+ */
+static u16 diag_crc_tbl[8][256];
+
+/* Non-zero iff some byte of @v is zero */
+#define HDLC_HAS_ZERO(v) \
+	(((v) - REPEAT_BYTE(0x01)) & ~(v) & REPEAT_BYTE(0x80))
+#define HDLC_HAS_SPECIAL(v) \
+	(HDLC_HAS_ZERO((v) ^ REPEAT_BYTE(CONTROL_CHAR)) | \
+	 HDLC_HAS_ZERO((v) ^ REPEAT_BYTE(ESC_CHAR)))
+
+void diag_hdlc_init(void)
+{
+	unsigned int i, k;
+	u16 crc;
+
+	for (i = 0; i < 256; i++) {
+		crc = crc_ccitt_table[i];
+		diag_crc_tbl[0][i] = crc;
+		for (k = 1; k < 8; k++) {
+			crc = (crc >> 8) ^ crc_ccitt_table[crc & 0xff];
+			diag_crc_tbl[k][i] = crc;
+		}
+	}
+}
+
+static uint16_t diag_hdlc_crc(uint16_t crc, const uint8_t *p, size_t len)
+{
+	while (len >= 8) {
+		crc = diag_crc_tbl[7][(p[0] ^ crc) & 0xff] ^
+		      diag_crc_tbl[6][(p[1] ^ (crc >> 8)) & 0xff] ^
+		      diag_crc_tbl[5][p[2]] ^ diag_crc_tbl[4][p[3]] ^
+		      diag_crc_tbl[3][p[4]] ^ diag_crc_tbl[2][p[5]] ^
+		      diag_crc_tbl[1][p[6]] ^ diag_crc_tbl[0][p[7]];
+		p += 8;
+		len -= 8;
+	}
+
+	while (len--)
+		crc = CRC_16_L_STEP(crc, *p++);
+
+	return crc;
+}
+
+/*
+ * Length of the run at the start of @p, at most @len bytes long, that
+ * holds neither CONTROL_CHAR nor ESC_CHAR and can be copied as it is.
+ * Log payloads rarely contain either, so runs are long in practice.
+ */
+static size_t diag_hdlc_clean_run(const uint8_t *p, size_t len)
+{
+	size_t n = 0;
+
+	while (n < len && !IS_ALIGNED((unsigned long)(p + n),
+				      sizeof(unsigned long))) {
+		if (p[n] == CONTROL_CHAR || p[n] == ESC_CHAR)
+			return n;
+		n++;
+	}
+
+	while (n + sizeof(unsigned long) <= len &&
+	       !HDLC_HAS_SPECIAL(*(const unsigned long *)(p + n)))
+		n += sizeof(unsigned long);
+
+	while (n < len && p[n] != CONTROL_CHAR && p[n] != ESC_CHAR)
+		n++;
+
+	return n;
+}
+
 void diag_hdlc_encode(struct diag_send_desc_type *src_desc,
 		      struct diag_hdlc_dest_type *enc)
 {
@@ -42,6 +117,7 @@ void diag_hdlc_encode(struct diag_send_desc_type *src_desc,
 	unsigned char src_byte = 0;
 	enum diag_send_state_enum_type state;
 	unsigned int used = 0;
+	size_t run;
 
 	if (!src_desc || !enc)
 		return;
@@ -69,6 +145,16 @@ void diag_hdlc_encode(struct diag_send_desc_type *src_desc,
 		 * of 2 dest bytes for an escaped byte
 		 */
 		while (src <= src_last && dest <= dest_last) {
+			run = diag_hdlc_clean_run(src,
+					min(src_last - src, dest_last - dest) + 1);
+			if (run) {
+				crc = diag_hdlc_crc(crc, src, run);
+				memcpy(dest, src, run);
+				src += run;
+				dest += run;
+				used += run;
+				continue;
+			}
 
 			src_byte = *src++;
 			if ((src_byte == CONTROL_CHAR) ||
@@ -154,7 +240,7 @@ int diag_hdlc_decode(struct diag_hdlc_decode_type *hdlc)
 	uint8_t *src_ptr = NULL, *dest_ptr = NULL;
 	unsigned int src_length = 0, dest_length = 0;
 	unsigned int len = 0;
-	unsigned int i;
+	unsigned int i, run;
 	uint8_t src_byte;
 
 	int pkt_bnd = HDLC_INCOMPLETE;
@@ -175,6 +261,17 @@ int diag_hdlc_decode(struct diag_hdlc_decode_type *hdlc)
 		dest_length = hdlc->dest_size - hdlc->dest_idx;
 
 		for (i = 0; i < src_length && len < dest_length; i++) {
+			if (!hdlc->escaping) {
+				run = diag_hdlc_clean_run(&src_ptr[i],
+						min(src_length - i,
+						    dest_length - len));
+				memcpy(&dest_ptr[len], &src_ptr[i], run);
+				len += run;
+				i += run;
+				if (i == src_length || len == dest_length)
+					break;
+			}
+
 			src_byte = src_ptr[i];
 
 			if (hdlc->escaping) {
@@ -230,7 +327,7 @@ int crc_check(uint8_t *buf, uint16_t len)
 	 * Run CRC check for the original input. Skip the last 3 CRC
 	 * bytes
 	 */
-	crc = crc_ccitt(crc, buf, len-3);
+	crc = diag_hdlc_crc(crc, buf, len-3);
 	crc ^= CRC_16_L_SEED;
 
 	/* Check the computed CRC against the original CRC bytes. */
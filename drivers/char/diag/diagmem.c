@@ -19,6 +19,7 @@
 #include <linux/kmemleak.h>
 #include <linux/ratelimit.h>
 #include <linux/atomic.h>
+#include <linux/percpu.h>
 #include <linux/slab.h>
 #include <linux/of.h>
 #include <linux/kmemleak.h>
@@ -158,78 +159,160 @@ void diagmem_setsize(int pool_idx, int itemsize, int poolsize)
 		 diag_mempools[pool_idx].poolsize);
 }
 
+static struct diag_mempool_t *diagmem_get_pool(int pool_type)
+{
+	int i;
+
+	for (i = 0; i < NUM_MEMORY_POOLS; i++) {
+		if (diag_mempools[i].id == pool_type)
+			return &diag_mempools[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Take an item for this CPU from the shared mempool, and park up to
+ * DIAG_MEMPOOL_PCP_BATCH - 1 more in the per-CPU cache while the lock
+ * is held so the following allocations stay off the lock.
+ */
+static void *diagmem_refill(struct diag_mempool_t *mempool)
+{
+	struct diag_mempool_pcp_t *pcp;
+	unsigned long flags;
+	void *buf, *item;
+	int i;
+
+	spin_lock_irqsave(&mempool->lock, flags);
+	buf = mempool_alloc(mempool->pool, GFP_ATOMIC);
+	if (buf) {
+		kmemleak_not_leak(buf);
+		pcp = this_cpu_ptr(mempool->pcp);
+		for (i = 1; i < DIAG_MEMPOOL_PCP_BATCH &&
+		     pcp->nr < DIAG_MEMPOOL_PCP_DEPTH; i++) {
+			item = mempool_alloc(mempool->pool, GFP_ATOMIC);
+			if (!item)
+				break;
+			kmemleak_not_leak(item);
+			pcp->items[pcp->nr++] = item;
+		}
+	}
+	spin_unlock_irqrestore(&mempool->lock, flags);
+
+	return buf;
+}
+
 void *diagmem_alloc(struct diagchar_dev *driver, int size, int pool_type)
 {
 	void *buf = NULL;
-	int i = 0;
+	int count;
 	unsigned long flags;
 	struct diag_mempool_t *mempool = NULL;
+	struct diag_mempool_pcp_t *pcp;
 
 	if (!driver)
 		return NULL;
 
-	for (i = 0; i < NUM_MEMORY_POOLS; i++) {
-		mempool = &diag_mempools[i];
-		if (pool_type != mempool->id)
-			continue;
-		if (!mempool->pool) {
-			pr_err_ratelimited("diag: %s mempool is not initialized yet\n",
-					   mempool->name);
-			break;
-		}
-		if (size == 0 || size > mempool->itemsize) {
-			pr_err_ratelimited("diag: cannot alloc from mempool %s, invalid size: %d\n",
-					   mempool->name, size);
-			break;
-		}
-		spin_lock_irqsave(&mempool->lock, flags);
-		if (mempool->count < mempool->poolsize) {
-			atomic_add(1, (atomic_t *)&mempool->count);
-			buf = mempool_alloc(mempool->pool, GFP_ATOMIC);
-			kmemleak_not_leak(buf);
-		}
-		spin_unlock_irqrestore(&mempool->lock, flags);
-		if (!buf) {
-			pr_debug_ratelimited("diag: Unable to allocate buffer from memory pool %s, size: %d/%d count: %d/%d\n",
-					     mempool->name,
-					     size, mempool->itemsize,
-					     mempool->count,
-					     mempool->poolsize);
-		}
-		break;
+	mempool = diagmem_get_pool(pool_type);
+	if (!mempool)
+		return NULL;
+
+	if (!mempool->pool) {
+		pr_err_ratelimited("diag: %s mempool is not initialized yet\n",
+				   mempool->name);
+		return NULL;
+	}
+	if (size == 0 || size > mempool->itemsize) {
+		pr_err_ratelimited("diag: cannot alloc from mempool %s, invalid size: %d\n",
+				   mempool->name, size);
+		return NULL;
 	}
 
-	return buf;
+	/* The cap on outstanding items is kept without the pool lock */
+	count = atomic_inc_return((atomic_t *)&mempool->count);
+	if (count > mempool->poolsize) {
+		atomic_dec((atomic_t *)&mempool->count);
+		goto fail;
+	}
+	if (count > READ_ONCE(mempool->hwm))
+		WRITE_ONCE(mempool->hwm, count);
+
+	local_irq_save(flags);
+	pcp = this_cpu_ptr(mempool->pcp);
+	if (pcp->nr) {
+		buf = pcp->items[--pcp->nr];
+		mempool->pcp_hits++;
+	}
+	local_irq_restore(flags);
+
+	if (!buf)
+		buf = diagmem_refill(mempool);
+	if (buf)
+		return buf;
+
+	atomic_dec((atomic_t *)&mempool->count);
+fail:
+	mempool->fail_cnt++;
+	pr_debug_ratelimited("diag: Unable to allocate buffer from memory pool %s, size: %d/%d count: %d/%d\n",
+			     mempool->name,
+			     size, mempool->itemsize,
+			     mempool->count,
+			     mempool->poolsize);
+	return NULL;
 }
 
 void diagmem_free(struct diagchar_dev *driver, void *buf, int pool_type)
 {
-	int i = 0;
+	int i;
 	unsigned long flags;
 	struct diag_mempool_t *mempool = NULL;
+	struct diag_mempool_pcp_t *pcp;
 
 	if (!driver || !buf)
 		return;
 
-	for (i = 0; i < NUM_MEMORY_POOLS; i++) {
-		mempool = &diag_mempools[i];
-		if (pool_type != mempool->id)
-			continue;
-		if (!mempool->pool) {
-			pr_err_ratelimited("diag: %s mempool is not initialized yet\n",
-					   mempool->name);
-			break;
-		}
-		spin_lock_irqsave(&mempool->lock, flags);
-		if (mempool->count > 0 && buf) {
-			mempool_free(buf, mempool->pool);
-			atomic_add(-1, (atomic_t *)&mempool->count);
-		} else {
-			pr_err_ratelimited("diag: Attempting to free items from %s mempool which is already empty\n",
-					   mempool->name);
-		}
-		spin_unlock_irqrestore(&mempool->lock, flags);
-		break;
+	mempool = diagmem_get_pool(pool_type);
+	if (!mempool)
+		return;
+
+	if (!mempool->pool) {
+		pr_err_ratelimited("diag: %s mempool is not initialized yet\n",
+				   mempool->name);
+		return;
+	}
+
+	if (!atomic_add_unless((atomic_t *)&mempool->count, -1, 0)) {
+		pr_err_ratelimited("diag: Attempting to free items from %s mempool which is already empty\n",
+				   mempool->name);
+		return;
+	}
+
+	local_irq_save(flags);
+	pcp = this_cpu_ptr(mempool->pcp);
+	if (pcp->nr < DIAG_MEMPOOL_PCP_DEPTH) {
+		pcp->items[pcp->nr++] = buf;
+		local_irq_restore(flags);
+		return;
+	}
+
+	/* Cache is full, hand this item and a batch back to the pool */
+	spin_lock(&mempool->lock);
+	mempool_free(buf, mempool->pool);
+	for (i = 1; i < DIAG_MEMPOOL_PCP_BATCH; i++)
+		mempool_free(pcp->items[--pcp->nr], mempool->pool);
+	spin_unlock(&mempool->lock);
+	local_irq_restore(flags);
+}
+
+static void diagmem_drain_pcp(struct diag_mempool_t *mempool)
+{
+	struct diag_mempool_pcp_t *pcp;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		pcp = per_cpu_ptr(mempool->pcp, cpu);
+		while (pcp->nr)
+			mempool_free(pcp->items[--pcp->nr], mempool->pool);
 	}
 }
 
@@ -258,12 +341,22 @@ void diagmem_init(struct diagchar_dev *driver, int index)
 		return;
 	}
 
+	mempool->pcp = alloc_percpu(struct diag_mempool_pcp_t);
+	if (!mempool->pcp) {
+		pr_err("diag: cannot allocate %s mempool cache\n",
+		       mempool->name);
+		return;
+	}
+
 	mempool->pool = mempool_create_kmalloc_pool(mempool->poolsize,
 						    mempool->itemsize);
-	if (!mempool->pool)
+	if (!mempool->pool) {
 		pr_err("diag: cannot allocate %s mempool\n", mempool->name);
-	else
+		free_percpu(mempool->pcp);
+		mempool->pcp = NULL;
+	} else {
 		kmemleak_not_leak(mempool->pool);
+	}
 
 	spin_lock_init(&mempool->lock);
 }
@@ -284,8 +377,11 @@ void diagmem_exit(struct diagchar_dev *driver, int index)
 	mempool = &diag_mempools[index];
 	spin_lock_irqsave(&mempool->lock, flags);
 	if (mempool->count == 0 && mempool->pool != NULL) {
+		diagmem_drain_pcp(mempool);
 		mempool_destroy(mempool->pool);
 		mempool->pool = NULL;
+		free_percpu(mempool->pcp);
+		mempool->pcp = NULL;
 	} else {
 		pr_err("diag: Unable to destroy %s pool, count: %d\n",
 		       mempool->name, mempool->count);
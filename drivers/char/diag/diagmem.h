@@ -42,6 +42,15 @@
 #define DIAG_MEMPOOL_NAME_SZ		24
 #define DIAG_MEMPOOL_GET_NAME(x)	(diag_mempools[x].name)
 
+/* Per-CPU front end: items cached per CPU and moved per refill/flush */
+#define DIAG_MEMPOOL_PCP_DEPTH		4
+#define DIAG_MEMPOOL_PCP_BATCH		2
+
+struct diag_mempool_pcp_t {
+	void *items[DIAG_MEMPOOL_PCP_DEPTH];
+	int nr;
+};
+
 struct diag_mempool_t {
 	int id;
 	char name[DIAG_MEMPOOL_NAME_SZ];
@@ -50,6 +59,10 @@ struct diag_mempool_t {
 	unsigned int poolsize;
 	int count;
 	spinlock_t lock;
+	struct diag_mempool_pcp_t __percpu *pcp;
+	int hwm;
+	unsigned int fail_cnt;
+	unsigned int pcp_hits;
 } __packed;
 
 extern struct diag_mempool_t diag_mempools[NUM_MEMORY_POOLS];
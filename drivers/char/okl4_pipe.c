@@ -13,6 +13,12 @@
  * Clients using this driver must have vclient names of the form
  * "pipe%d", where %d is the pipe number, which must be
  * unique and less than MAX_PIPES.
+ *
+ * A pipe may also have a shared memory ring per direction, named by the
+ * "okl,ring-tx" and "okl,ring-rx" phandles, with "okl,ring-interrupt-line"
+ * and the third interrupt as doorbells to and from the other side. Data
+ * then goes straight between user buffers and the rings and only the
+ * doorbells go through the microvisor, when the other side sleeps.
  */
 
 /* #define DEBUG 1 */
@@ -36,6 +42,10 @@
 #include <linux/sched.h>
 #include <linux/wait.h>
 #include <linux/of.h>
+#include <linux/of_address.h>
+#include <linux/io.h>
+#include <linux/log2.h>
+#include <linux/sizes.h>
 #include <asm/uaccess.h>
 #include <asm-generic/okl4_virq.h>
 
@@ -61,6 +71,45 @@
 
 #define MAX_PIPES 8
 
+#define OKL4_PIPE_RING_MAGIC	0x52504b4fU	/* "OKPR" */
+
+/* Doorbell payload flags */
+#define OKL4_PIPE_RING_DATA	1UL	/* head has been advanced */
+#define OKL4_PIPE_RING_SPACE	2UL	/* tail has been advanced */
+
+/*
+ * Header of a ring, shared with the other side. head and tail run freely,
+ * the data size is a power of two. Each half is written by one side only.
+ */
+struct okl4_pipe_ring {
+	/* producer */
+	u32 prod_magic;
+	u32 head;
+	u32 prod_wait;
+	/* consumer */
+	u32 cons_magic __aligned(64);
+	u32 tail;
+	u32 cons_wait;
+	char data[] __aligned(64);
+};
+
+enum okl4_pipe_tx_mode {
+	OKL4_PIPE_TX_UNDECIDED,
+	OKL4_PIPE_TX_MSG,
+	OKL4_PIPE_TX_RING,
+};
+
+/* Cumulative since probe, hypercalls are the ones of read and write */
+struct okl4_pipe_stats {
+	u64 tx_bytes;
+	u64 rx_bytes;
+	u64 tx_ring_bytes;
+	u64 rx_ring_bytes;
+	u64 hypercalls;
+	u64 doorbells_sent;
+	u64 doorbells_recv;
+};
+
 #ifdef CONFIG_OKL4_INTERLEAVED_PRIORITIES
 extern int vcpu_prio_normal;
 #endif
@@ -97,6 +146,16 @@ struct okl4_pipe {
 
 	char *rx_buf;
 	size_t rx_buf_count;
+
+	struct okl4_pipe_ring *tx_ring;
+	struct okl4_pipe_ring *rx_ring;
+	u32 tx_ring_size;
+	u32 rx_ring_size;
+	okl4_kcap_t ring_virqline;
+	int ring_irq;
+	enum okl4_pipe_tx_mode tx_mode;
+
+	struct okl4_pipe_stats stats;
 };
 static struct okl4_pipe pipes[MAX_PIPES];
 
@@ -152,6 +211,187 @@ okl4_pipe_rx_irq(int irq, void *dev)
 	return IRQ_HANDLED;
 }
 
+static irqreturn_t
+okl4_pipe_ring_irq(int irq, void *dev)
+{
+	struct okl4_pipe *pipe = dev;
+	unsigned long payload = okl4_get_virq_payload(irq);
+
+	spin_lock(&pipe->pipe_lock);
+	pipe->stats.doorbells_recv++;
+	if (payload & OKL4_PIPE_RING_DATA)
+		pipe->rx_maybe_avail = true;
+	if (payload & OKL4_PIPE_RING_SPACE)
+		pipe->tx_maybe_avail = true;
+	spin_unlock(&pipe->pipe_lock);
+
+	if (payload & OKL4_PIPE_RING_DATA)
+		wake_up_interruptible(&pipe->rx_wait_q);
+	if (payload & OKL4_PIPE_RING_SPACE)
+		wake_up_interruptible(&pipe->tx_wait_q);
+	wake_up_interruptible(&pipe->poll_wait_q);
+
+	return IRQ_HANDLED;
+}
+
+static void
+okl4_pipe_ring_doorbell(struct okl4_pipe *pipe, unsigned long flag)
+{
+	_okl4_sys_vinterrupt_raise(pipe->ring_virqline, flag);
+	pipe->stats.hypercalls++;
+	pipe->stats.doorbells_sent++;
+}
+
+/* The other side writes to the rx ring rather than sending messages */
+static bool
+okl4_pipe_rx_ring(struct okl4_pipe *pipe)
+{
+	return pipe->rx_ring &&
+		READ_ONCE(pipe->rx_ring->prod_magic) == OKL4_PIPE_RING_MAGIC;
+}
+
+/*
+ * Ask for a doorbell on the next head update. Returns true if data came
+ * in meanwhile, as the producer may have looked at cons_wait before it
+ * was set.
+ */
+static bool
+okl4_pipe_ring_rx_arm(struct okl4_pipe *pipe)
+{
+	struct okl4_pipe_ring *ring = pipe->rx_ring;
+
+	if (!ring)
+		return false;
+
+	WRITE_ONCE(ring->cons_wait, 1);
+	mb();
+	return okl4_pipe_rx_ring(pipe) &&
+		READ_ONCE(ring->head) != READ_ONCE(ring->tail);
+}
+
+/* Same for the tail, true if the tx ring has room */
+static bool
+okl4_pipe_ring_tx_arm(struct okl4_pipe *pipe)
+{
+	struct okl4_pipe_ring *ring = pipe->tx_ring;
+
+	WRITE_ONCE(ring->prod_wait, 1);
+	mb();
+	return ring->head - READ_ONCE(ring->tail) < pipe->tx_ring_size;
+}
+
+/* Called with pipe_mutex held, returns 0 if the ring is empty */
+static ssize_t
+okl4_pipe_ring_read(struct okl4_pipe *pipe, char __user *buf, size_t count)
+{
+	struct okl4_pipe_ring *ring = pipe->rx_ring;
+	u32 size = pipe->rx_ring_size;
+	u32 tail = ring->tail;
+	u32 avail, off, chunk;
+
+	avail = READ_ONCE(ring->head) - tail;
+	if (!avail) {
+		spin_lock_irq(&pipe->pipe_lock);
+		pipe->rx_maybe_avail = false;
+		spin_unlock_irq(&pipe->pipe_lock);
+
+		if (!okl4_pipe_ring_rx_arm(pipe))
+			return 0;
+		avail = READ_ONCE(ring->head) - tail;
+	}
+	WRITE_ONCE(ring->cons_wait, 0);
+
+	if (avail > size)
+		return -EPROTO;
+
+	/* This matches the wmb() before the head update */
+	rmb();
+
+	count = min_t(size_t, count, avail);
+	off = tail & (size - 1);
+	chunk = min_t(size_t, count, size - off);
+	if (copy_to_user(buf, &ring->data[off], chunk) ||
+			copy_to_user(buf + chunk, ring->data, count - chunk))
+		return -EFAULT;
+
+	/* The copy is done before the producer may reuse the space */
+	mb();
+	WRITE_ONCE(ring->tail, tail + count);
+	mb();
+	if (READ_ONCE(ring->prod_wait))
+		okl4_pipe_ring_doorbell(pipe, OKL4_PIPE_RING_SPACE);
+
+	pipe->stats.rx_bytes += count;
+	pipe->stats.rx_ring_bytes += count;
+	return count;
+}
+
+/* Called with pipe_mutex held, returns 0 if the ring is full */
+static ssize_t
+okl4_pipe_ring_write(struct okl4_pipe *pipe, const char __user *buf,
+		size_t count)
+{
+	struct okl4_pipe_ring *ring = pipe->tx_ring;
+	u32 size = pipe->tx_ring_size;
+	u32 head = ring->head;
+	u32 space, off, chunk;
+
+	space = size - (head - READ_ONCE(ring->tail));
+	if (!space) {
+		spin_lock_irq(&pipe->pipe_lock);
+		pipe->tx_maybe_avail = false;
+		spin_unlock_irq(&pipe->pipe_lock);
+
+		if (!okl4_pipe_ring_tx_arm(pipe))
+			return 0;
+		space = size - (head - READ_ONCE(ring->tail));
+	}
+	WRITE_ONCE(ring->prod_wait, 0);
+
+	if (space > size)
+		return -EPROTO;
+
+	/* This matches the mb() before the tail update */
+	mb();
+
+	count = min_t(size_t, count, space);
+	off = head & (size - 1);
+	chunk = min_t(size_t, count, size - off);
+	if (copy_from_user(&ring->data[off], buf, chunk) ||
+			copy_from_user(ring->data, buf + chunk, count - chunk))
+		return -EFAULT;
+
+	/* The other side sees the copy before the head update */
+	wmb();
+	WRITE_ONCE(ring->head, head + count);
+	mb();
+	if (READ_ONCE(ring->cons_wait))
+		okl4_pipe_ring_doorbell(pipe, OKL4_PIPE_RING_DATA);
+
+	pipe->stats.tx_bytes += count;
+	pipe->stats.tx_ring_bytes += count;
+	return count;
+}
+
+/*
+ * Called until the first data of a connection is sent. The reader says
+ * it takes the ring by setting cons_magic before its end of the pipe
+ * becomes ready; a reader without ring support never does and the
+ * connection keeps sending messages.
+ */
+static void
+okl4_pipe_tx_negotiate(struct okl4_pipe *pipe)
+{
+	struct okl4_pipe_ring *ring = pipe->tx_ring;
+
+	if (!ring || READ_ONCE(ring->cons_magic) != OKL4_PIPE_RING_MAGIC)
+		return;
+
+	WRITE_ONCE(ring->prod_magic, OKL4_PIPE_RING_MAGIC);
+	mb();
+	pipe->tx_mode = OKL4_PIPE_TX_RING;
+}
+
 static ssize_t
 okl4_pipe_read(struct file *filp, char __user *buf, size_t count,
 		loff_t *f_pos)
@@ -179,6 +419,17 @@ okl4_pipe_read(struct file *filp, char __user *buf, size_t count,
 	if (mutex_lock_interruptible(&pipe->pipe_mutex))
 		return -ERESTARTSYS;
 
+	if (okl4_pipe_rx_ring(pipe)) {
+		ssize_t ret = okl4_pipe_ring_read(pipe, buf, count);
+
+		mutex_unlock(&pipe->pipe_mutex);
+		if (ret)
+			return ret;
+		if (filp->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		goto again;
+	}
+
 	/* Receive buffered data first */
 	if (pipe->rx_buf_count) {
 		recv = min(pipe->rx_buf_count, count);
@@ -219,10 +470,14 @@ okl4_pipe_read(struct file *filp, char __user *buf, size_t count,
 				pipe->max_msg_size + sizeof(uint32_t),
 				(void *)buffer);
 		ret = recv_return.error;
+		pipe->stats.hypercalls++;
 
 		if (ret == OKL4_ERROR_PIPE_NOT_READY ||
 				ret == OKL4_ERROR_PIPE_EMPTY) {
 			pipe->rx_maybe_avail = false;
+			/* The writer may have moved to the ring meanwhile */
+			if (okl4_pipe_ring_rx_arm(pipe))
+				pipe->rx_maybe_avail = true;
 			if (!recv) {
 				if (!(filp->f_flags & O_NONBLOCK)) {
 					spin_unlock_irq(&pipe->pipe_lock);
@@ -251,6 +506,7 @@ okl4_pipe_read(struct file *filp, char __user *buf, size_t count,
 				recv = -EPROTO;
 			goto out;
 		}
+		pipe->stats.rx_bytes += size;
 
 		/* Save extra received data */
 		if (size > count) {
@@ -307,6 +563,20 @@ okl4_pipe_write(struct file *filp, const char __user *buf, size_t count,
 	if (mutex_lock_interruptible(&pipe->pipe_mutex))
 		return -ERESTARTSYS;
 
+	if (pipe->tx_mode == OKL4_PIPE_TX_UNDECIDED)
+		okl4_pipe_tx_negotiate(pipe);
+
+	if (pipe->tx_mode == OKL4_PIPE_TX_RING) {
+		ssize_t ret = okl4_pipe_ring_write(pipe, buf, count);
+
+		mutex_unlock(&pipe->pipe_mutex);
+		if (ret)
+			return ret;
+		if (filp->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		goto again;
+	}
+
 	buffer = kmalloc(pipe->max_msg_size + sizeof(uint32_t), GFP_KERNEL);
 
 	if (!buffer) {
@@ -331,6 +601,7 @@ okl4_pipe_write(struct file *filp, const char __user *buf, size_t count,
 		spin_lock_irq(&pipe->pipe_lock);
 		ret = _okl4_sys_pipe_send(pipe->pipe_tx_kcap, pipe_size,
 				(void *)buffer);
+		pipe->stats.hypercalls++;
 		if (ret == OKL4_ERROR_PIPE_NOT_READY ||
 				ret == OKL4_ERROR_PIPE_FULL) {
 			pipe->tx_maybe_avail = false;
@@ -356,6 +627,10 @@ okl4_pipe_write(struct file *filp, const char __user *buf, size_t count,
 		}
 		spin_unlock_irq(&pipe->pipe_lock);
 
+		/* The reader got a message, the connection stays on them */
+		pipe->tx_mode = OKL4_PIPE_TX_MSG;
+		pipe->stats.tx_bytes += size;
+
 		count -= size;
 		buf += size;
 		sent += size;
@@ -379,6 +654,11 @@ okl4_pipe_poll(struct file *filp, struct poll_table_struct *poll_table)
 
 	spin_lock_irq(&pipe->pipe_lock);
 
+	if (okl4_pipe_ring_rx_arm(pipe))
+		pipe->rx_maybe_avail = true;
+	if (pipe->tx_mode == OKL4_PIPE_TX_RING && okl4_pipe_ring_tx_arm(pipe))
+		pipe->tx_maybe_avail = true;
+
 	if (pipe->rx_maybe_avail)
 		ret |= POLLIN | POLLRDNORM;
 	if (pipe->tx_maybe_avail)
@@ -411,6 +691,20 @@ okl4_pipe_open(struct inode *inode, struct file *filp)
 		pipe->reset = false;
 		pipe->tx_maybe_avail = true;
 		pipe->rx_maybe_avail = true;
+		pipe->tx_mode = OKL4_PIPE_TX_UNDECIDED;
+
+		/*
+		 * Drop what a previous writer left in the rx ring and offer
+		 * it to the other side before our end becomes ready.
+		 */
+		if (pipe->rx_ring) {
+			WRITE_ONCE(pipe->rx_ring->tail,
+					READ_ONCE(pipe->rx_ring->head));
+			WRITE_ONCE(pipe->rx_ring->cons_wait, 0);
+			WRITE_ONCE(pipe->rx_ring->cons_magic,
+					OKL4_PIPE_RING_MAGIC);
+			mb();
+		}
 
 		okl4_pipe_control(pipe->pipe_tx_kcap,
 				OKL4_PIPE_CONTROL_OP_SET_TX_READY);
@@ -429,6 +723,12 @@ okl4_pipe_close(struct inode *inode, struct file *filp)
 
 	pipe->ref_count--;
 	if (!pipe->ref_count) {
+		if (pipe->rx_ring)
+			WRITE_ONCE(pipe->rx_ring->cons_magic, 0);
+		if (pipe->tx_ring)
+			WRITE_ONCE(pipe->tx_ring->prod_magic, 0);
+		mb();
+
 		okl4_pipe_control(pipe->pipe_rx_kcap,
 				OKL4_PIPE_CONTROL_OP_RESET);
 		okl4_pipe_control(pipe->pipe_tx_kcap,
@@ -452,6 +752,132 @@ struct file_operations okl4_pipe_fops = {
 	.poll =		okl4_pipe_poll,
 };
 
+static ssize_t
+stats_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct okl4_pipe *pipe = dev_get_drvdata(dev);
+	static const char * const tx_modes[] = {
+		[OKL4_PIPE_TX_UNDECIDED] = "none",
+		[OKL4_PIPE_TX_MSG] = "msg",
+		[OKL4_PIPE_TX_RING] = "ring",
+	};
+
+	return scnprintf(buf, PAGE_SIZE,
+			"tx_mode %s\nrx_mode %s\ntx_bytes %llu\nrx_bytes %llu\n"
+			"tx_ring_bytes %llu\nrx_ring_bytes %llu\n"
+			"hypercalls %llu\ndoorbells_sent %llu\n"
+			"doorbells_recv %llu\n",
+			tx_modes[pipe->tx_mode],
+			okl4_pipe_rx_ring(pipe) ? "ring" : "msg",
+			pipe->stats.tx_bytes, pipe->stats.rx_bytes,
+			pipe->stats.tx_ring_bytes, pipe->stats.rx_ring_bytes,
+			pipe->stats.hypercalls, pipe->stats.doorbells_sent,
+			pipe->stats.doorbells_recv);
+}
+static DEVICE_ATTR_RO(stats);
+
+static struct attribute *okl4_pipe_attrs[] = {
+	&dev_attr_stats.attr,
+	NULL,
+};
+ATTRIBUTE_GROUPS(okl4_pipe);
+
+static int
+okl4_pipe_ring_map(struct platform_device *pdev, const char *prop,
+		struct okl4_pipe_ring **ring, u32 *size)
+{
+	struct device_node *np;
+	struct resource res;
+	resource_size_t len;
+	void *base;
+	int err;
+
+	np = of_parse_phandle(pdev->dev.of_node, prop, 0);
+	if (!np)
+		return -ENOENT;
+	err = of_address_to_resource(np, 0, &res);
+	of_node_put(np);
+	if (err)
+		return err;
+
+	len = resource_size(&res);
+	if (len < sizeof(**ring) + PAGE_SIZE)
+		return -EINVAL;
+
+	if (!devm_request_mem_region(&pdev->dev, res.start, len,
+				dev_name(&pdev->dev)))
+		return -EBUSY;
+
+	base = devm_memremap(&pdev->dev, res.start, len, MEMREMAP_WB);
+	if (IS_ERR(base))
+		return PTR_ERR(base);
+
+	*ring = base;
+	*size = rounddown_pow_of_two(min_t(resource_size_t,
+				len - sizeof(**ring), SZ_1G));
+	return 0;
+}
+
+/* Pipes without "okl,ring-tx" send messages only */
+static int
+okl4_pipe_ring_probe(struct platform_device *pdev, struct okl4_pipe *pipe)
+{
+	struct device_node *np;
+	struct resource *irq;
+	u32 virqline;
+	int err;
+
+	pipe->tx_ring = NULL;
+	pipe->rx_ring = NULL;
+	if (!of_find_property(pdev->dev.of_node, "okl,ring-tx", NULL))
+		return 0;
+
+	np = of_parse_phandle(pdev->dev.of_node, "okl,ring-interrupt-line", 0);
+	if (!np) {
+		dev_err(&pdev->dev, "no ring interrupt line?\n");
+		return -ENODEV;
+	}
+	err = of_property_read_u32(np, "reg", &virqline);
+	of_node_put(np);
+	if (err) {
+		dev_err(&pdev->dev, "no ring interrupt line cap?\n");
+		return -ENODEV;
+	}
+
+	irq = platform_get_resource(pdev, IORESOURCE_IRQ, 2);
+	if (!irq) {
+		dev_err(&pdev->dev, "no ring irq resource?\n");
+		return -ENODEV;
+	}
+
+	err = okl4_pipe_ring_map(pdev, "okl,ring-tx", &pipe->tx_ring,
+			&pipe->tx_ring_size);
+	if (!err)
+		err = okl4_pipe_ring_map(pdev, "okl,ring-rx", &pipe->rx_ring,
+				&pipe->rx_ring_size);
+	if (err) {
+		dev_err(&pdev->dev, "cannot map rings: %d\n", err);
+		goto fail_ring;
+	}
+
+	pipe->ring_virqline = virqline;
+	pipe->ring_irq = irq->start;
+	err = devm_request_irq(&pdev->dev, pipe->ring_irq,
+			okl4_pipe_ring_irq, 0, dev_name(&pdev->dev), pipe);
+	if (err) {
+		dev_err(&pdev->dev, "cannot register ring irq %d: %d\n",
+				(int)pipe->ring_irq, (int)err);
+		goto fail_ring;
+	}
+
+	return 0;
+
+fail_ring:
+	pipe->tx_ring = NULL;
+	pipe->rx_ring = NULL;
+	return err;
+}
+
 static int __devinit
 okl4_pipe_probe(struct platform_device *pdev)
 {
@@ -547,6 +973,10 @@ okl4_pipe_probe(struct platform_device *pdev)
 		goto fail_request_tx_irq;
 	}
 
+	err = okl4_pipe_ring_probe(pdev, pipe);
+	if (err)
+		goto fail_ring_probe;
+
 	dev_num = MKDEV(okl4_pipe_major, pipe_id);
 
 	cdev_init(&pipe->cdev, &okl4_pipe_fops);
@@ -557,8 +987,8 @@ okl4_pipe_probe(struct platform_device *pdev)
 		goto fail_cdev_add;
 	}
 
-	device = device_create(okl4_pipe_class, NULL, dev_num, NULL,
-			DEVICE_NAME "%d", pipe_id);
+	device = device_create_with_groups(okl4_pipe_class, NULL, dev_num,
+			pipe, okl4_pipe_groups, DEVICE_NAME "%d", pipe_id);
 	if (IS_ERR(device)) {
 		err = PTR_ERR(device);
 		dev_err(&pdev->dev, "cannot create device: %d\n", (int)err);
@@ -570,6 +1000,9 @@ okl4_pipe_probe(struct platform_device *pdev)
 fail_device_create:
 	cdev_del(&pipe->cdev);
 fail_cdev_add:
+	if (pipe->tx_ring)
+		devm_free_irq(&pdev->dev, pipe->ring_irq, pipe);
+fail_ring_probe:
 	devm_free_irq(&pdev->dev, pipe->tx_irq, pipe);
 fail_request_tx_irq:
 	devm_free_irq(&pdev->dev, pipe->rx_irq, pipe);
@@ -597,6 +1030,8 @@ okl4_pipe_remove(struct platform_device *pdev)
 
 	cdev_del(&pipe->cdev);
 
+	if (pipe->tx_ring)
+		devm_free_irq(&pdev->dev, pipe->ring_irq, pipe);
 	devm_free_irq(&pdev->dev, pipe->tx_irq, pipe);
 	devm_free_irq(&pdev->dev, pipe->rx_irq, pipe);
 
@@ -34,6 +34,7 @@
 #include <linux/uaccess.h>
 #include <linux/sched.h>
 #include <soc/qcom/scm.h>
+#include <soc/qcom/msm-cpufreq.h>
 #include <dt-bindings/clock/qcom,cpu-osm.h>
 
 #include "common.h"
@@ -728,6 +729,21 @@ static int clk_osm_set_rate(struct clk_hw *hw, unsigned long rate,
 	return 0;
 }
 
+/*
+ * Rate change for the msm cpufreq fast path. Setting a rate is a register
+ * write and at most a couple of udelays, so it is safe from scheduler
+ * context. The rate is looked up here rather than by the clock framework.
+ */
+static int clk_osm_fast_set_rate(void *data, unsigned long rate)
+{
+	struct clk_osm *cpuclk = data;
+	struct clk_rate_request req = { .rate = rate };
+
+	clk_osm_determine_rate(&cpuclk->hw, &req);
+
+	return clk_osm_set_rate(&cpuclk->hw, req.rate, 0);
+}
+
 static int clk_osm_acd_init(struct clk_osm *c);
 
 static int clk_osm_enable(struct clk_hw *hw)
@@ -833,12 +849,14 @@ static struct clk_init_data osm_clks_init[] = {
 		.name = "pwrcl_clk",
 		.parent_names = (const char *[]){ "cxo_a" },
 		.num_parents = 1,
+		.flags = CLK_GET_RATE_NOCACHE,
 		.ops = &clk_ops_cpu_osm_660,
 	},
 	[1] = {
 		.name = "perfcl_clk",
 		.parent_names = (const char *[]){ "cxo_a" },
 		.num_parents = 1,
+		.flags = CLK_GET_RATE_NOCACHE,
 		.ops = &clk_ops_cpu_osm_660,
 	},
 };
@@ -3417,6 +3435,15 @@ static int clk_cpu_osm_driver_probe(struct platform_device *pdev)
 	populate_debugfs_dir(&pwrcl_clk);
 	populate_debugfs_dir(&perfcl_clk);
 
+	for_each_possible_cpu(cpu) {
+		struct clk *c = logical_cpu_to_clk(cpu);
+
+		if (c)
+			msm_cpufreq_register_fast_switch(cpu,
+				clk_osm_fast_set_rate,
+				to_clk_osm(__clk_get_hw(c)));
+	}
+
 	of_platform_populate(pdev->dev.of_node, NULL, NULL, &pdev->dev);
 
 	register_cpu_cycle_counter_cb(&cb);
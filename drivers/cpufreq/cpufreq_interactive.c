@@ -26,6 +26,7 @@
 #include <linux/rwsem.h>
 #include <linux/sched/cpufreq.h>
 #include <linux/sched/rt.h>
+#include <linux/sched/stat.h>
 #include <linux/sched/task.h>
 #include <linux/tick.h>
 #include <linux/time.h>
@@ -99,6 +100,13 @@ struct interactive_tunables {
 	unsigned long timer_slack_delay;
 	unsigned long timer_slack;
 	bool io_is_busy;
+
+	/*
+	 * Take the load from the scheduler (WALT) instead of idle time, and
+	 * evaluate only from its utilization callbacks: no slack timer and
+	 * no sampling at idle exit, migrations are acted upon at once.
+	 */
+	bool use_sched_load;
 };
 
 /* Separate instance required for each 'struct cpufreq_policy' */
@@ -172,7 +180,7 @@ static bool timer_slack_required(struct interactive_cpu *icpu)
 	struct interactive_policy *ipolicy = icpu->ipolicy;
 	struct interactive_tunables *tunables = ipolicy->tunables;
 
-	if (tunables->timer_slack < 0)
+	if (tunables->timer_slack < 0 || tunables->use_sched_load)
 		return false;
 
 	if (icpu->target_freq > ipolicy->policy->min)
@@ -370,6 +378,15 @@ static void eval_target_freq(struct interactive_cpu *icpu)
 	int cpu_load;
 	int cpu = smp_processor_id();
 
+	if (tunables->use_sched_load) {
+		/* busy percentage of the capacity at the highest frequency */
+		now = ktime_to_us(ktime_get());
+		loadadjfreq = sched_get_cpu_util(cpu) *
+			      policy->cpuinfo.max_freq;
+		spin_lock_irqsave(&icpu->target_freq_lock, flags);
+		goto load_done;
+	}
+
 	spin_lock_irqsave(&icpu->load_lock, flags);
 	now = update_load(icpu, smp_processor_id());
 	delta_time = (unsigned int)(now - icpu->cputime_speedadj_timestamp);
@@ -382,6 +399,7 @@ static void eval_target_freq(struct interactive_cpu *icpu)
 	spin_lock_irqsave(&icpu->target_freq_lock, flags);
 	do_div(cputime_speedadj, delta_time);
 	loadadjfreq = (unsigned int)cputime_speedadj * 100;
+load_done:
 	cpu_load = loadadjfreq / policy->cur;
 	tunables->boosted = tunables->boost ||
 			    now < tunables->boostpulse_endtime;
@@ -481,7 +499,7 @@ static void cpufreq_interactive_idle_end(void)
 	if (!down_read_trylock(&icpu->enable_sem))
 		return;
 
-	if (icpu->ipolicy) {
+	if (icpu->ipolicy && !icpu->ipolicy->tunables->use_sched_load) {
 		/*
 		 * We haven't sampled load for more than sampling_rate time, do
 		 * it right now.
@@ -497,6 +515,9 @@ static void cpufreq_interactive_get_policy_info(struct cpufreq_policy *policy,
 						unsigned int *pmax_freq,
 						u64 *phvt, u64 *pfvt)
 {
+	struct interactive_policy *ipolicy = policy->governor_data;
+	struct interactive_tunables *tunables = ipolicy->tunables;
+	unsigned long stale = usecs_to_jiffies(tunables->sampling_rate);
 	struct interactive_cpu *icpu;
 	u64 hvt = ~0ULL, fvt = 0;
 	unsigned int max_freq = 0, i;
@@ -504,6 +525,14 @@ static void cpufreq_interactive_get_policy_info(struct cpufreq_policy *policy,
 	for_each_cpu(i, policy->cpus) {
 		icpu = &per_cpu(interactive_cpu, i);
 
+		/*
+		 * Without the slack timer an idle CPU is never re-evaluated,
+		 * leave its last target out once it missed a sample.
+		 */
+		if (tunables->use_sched_load &&
+		    time_after(jiffies, icpu->next_sample_jiffies + stale))
+			continue;
+
 		fvt = max(fvt, icpu->loc_floor_val_time);
 		if (icpu->target_freq > max_freq) {
 			max_freq = icpu->target_freq;
@@ -973,6 +1002,22 @@ static ssize_t store_io_is_busy(struct gov_attr_set *attr_set, const char *buf,
 	return count;
 }
 
+static ssize_t store_use_sched_load(struct gov_attr_set *attr_set,
+				    const char *buf, size_t count)
+{
+	struct interactive_tunables *tunables = to_tunables(attr_set);
+	unsigned long val;
+	int ret;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	tunables->use_sched_load = val;
+
+	return count;
+}
+
 show_one(hispeed_freq, "%u");
 show_one(go_hispeed_load, "%lu");
 show_one(min_sample_time, "%lu");
@@ -980,6 +1025,7 @@ show_one(timer_slack, "%lu");
 show_one(boost, "%u");
 show_one(boostpulse_duration, "%u");
 show_one(io_is_busy, "%u");
+show_one(use_sched_load, "%u");
 
 gov_attr_rw(target_loads);
 gov_attr_rw(above_hispeed_delay);
@@ -992,6 +1038,7 @@ gov_attr_rw(boost);
 gov_attr_wo(boostpulse);
 gov_attr_rw(boostpulse_duration);
 gov_attr_rw(io_is_busy);
+gov_attr_rw(use_sched_load);
 
 static struct attribute *interactive_attributes[] = {
 	&target_loads.attr,
@@ -1005,6 +1052,7 @@ static struct attribute *interactive_attributes[] = {
 	&boostpulse.attr,
 	&boostpulse_duration.attr,
 	&io_is_busy.attr,
+	&use_sched_load.attr,
 	NULL
 };
 
@@ -1064,7 +1112,9 @@ static void update_util_handler(struct update_util_data *data, u64 time,
 		return;
 
 	delta_ns = time - icpu->last_sample_time;
-	if ((s64)delta_ns < tunables->sampling_rate * NSEC_PER_USEC)
+	if ((s64)delta_ns < tunables->sampling_rate * NSEC_PER_USEC &&
+	    !(tunables->use_sched_load &&
+	      (flags & SCHED_CPUFREQ_INTERCLUSTER_MIG)))
 		return;
 
 	icpu->last_sample_time = time;
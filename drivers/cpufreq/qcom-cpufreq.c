@@ -29,6 +29,8 @@
 #include <linux/of.h>
 #include <linux/of_device.h>
 #include <linux/cpu_cooling.h>
+#include <linux/ktime.h>
+#include <soc/qcom/msm-cpufreq.h>
 #include <trace/events/power.h>
 
 static DEFINE_MUTEX(l2bw_lock);
@@ -48,12 +50,77 @@ static DEFINE_PER_CPU(struct cpufreq_suspend_t, suspend_data);
 static DEFINE_PER_CPU(int, cached_resolve_idx);
 static DEFINE_PER_CPU(unsigned int, cached_resolve_freq);
 
+/* Takes effect for policies initialized after it is changed */
+static bool fast_switch = true;
+module_param(fast_switch, bool, 0644);
+
+struct cpufreq_fast_switch_t {
+	msm_cpufreq_fast_set_rate_t set_rate;
+	void *data;
+};
+
+static DEFINE_PER_CPU(struct cpufreq_fast_switch_t, fast_switch_data);
+
+enum {
+	UPDATE_SLOW,
+	UPDATE_FAST,
+	UPDATE_TYPES,
+};
+
+/* Time spent applying a frequency, kept on the policy's first cpu */
+struct cpufreq_update_stats_t {
+	u64 count;
+	u64 total_ns;
+	u64 max_ns;
+};
+
+static DEFINE_PER_CPU(struct cpufreq_update_stats_t,
+		      update_stats[UPDATE_TYPES]);
+
+static void account_update(struct cpufreq_policy *policy, int type,
+			   u64 delta)
+{
+	int first_cpu = cpumask_first(policy->related_cpus);
+	struct cpufreq_update_stats_t *stats =
+		&per_cpu(update_stats, first_cpu)[type];
+
+	stats->count++;
+	stats->total_ns += delta;
+	if (delta > stats->max_ns)
+		stats->max_ns = delta;
+}
+
+/**
+ * msm_cpufreq_register_fast_switch - set the non-sleeping rate hook of a cpu
+ * @cpu: the cpu whose clock @set_rate changes
+ * @set_rate: called with the new rate in Hz from scheduler context
+ * @data: passed back to @set_rate
+ *
+ * Must be called before the cpu's policy is initialized, which built-in
+ * clock providers probing at arch_initcall time are. Later registrations
+ * only take effect once the policy is initialized again.
+ */
+int msm_cpufreq_register_fast_switch(int cpu,
+				     msm_cpufreq_fast_set_rate_t set_rate,
+				     void *data)
+{
+	if (cpu < 0 || cpu >= nr_cpu_ids || !set_rate)
+		return -EINVAL;
+
+	per_cpu(fast_switch_data, cpu).data = data;
+	per_cpu(fast_switch_data, cpu).set_rate = set_rate;
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(msm_cpufreq_register_fast_switch);
+
 static int set_cpu_freq(struct cpufreq_policy *policy, unsigned int new_freq,
 			unsigned int index)
 {
 	int ret = 0;
 	struct cpufreq_freqs freqs;
 	unsigned long rate;
+	u64 start;
 
 	freqs.old = policy->cur;
 	freqs.new = new_freq;
@@ -62,11 +129,20 @@ static int set_cpu_freq(struct cpufreq_policy *policy, unsigned int new_freq,
 	trace_cpu_frequency_switch_start(freqs.old, freqs.new, policy->cpu);
 	cpufreq_freq_transition_begin(policy, &freqs);
 
+	/*
+	 * The fast path changes the rate behind the clock framework's back,
+	 * resync its cached rate so that it does not skip this change.
+	 */
+	if (policy->fast_switch_possible)
+		clk_get_rate(cpu_clk[policy->cpu]);
+
+	start = ktime_get_ns();
 	rate = new_freq * 1000;
 	rate = clk_round_rate(cpu_clk[policy->cpu], rate);
 	ret = clk_set_rate(cpu_clk[policy->cpu], rate);
 	cpufreq_freq_transition_end(policy, &freqs, ret);
 	if (!ret) {
+		account_update(policy, UPDATE_SLOW, ktime_get_ns() - start);
 		arch_set_freq_scale(policy->related_cpus, new_freq,
 				    policy->cpuinfo.max_freq);
 		trace_cpu_frequency_switch_end(policy->cpu);
@@ -114,6 +190,45 @@ static int msm_cpufreq_target(struct cpufreq_policy *policy,
 	return ret;
 }
 
+/*
+ * Called by schedutil from scheduler context when the cpu clock has a
+ * fast_switch_data hook. Everything else goes through msm_cpufreq_target().
+ */
+static unsigned int msm_cpufreq_fast_switch(struct cpufreq_policy *policy,
+					    unsigned int target_freq)
+{
+	struct cpufreq_fast_switch_t *fs =
+			&per_cpu(fast_switch_data, policy->cpu);
+	int first_cpu = cpumask_first(policy->related_cpus);
+	unsigned int freq;
+	u64 start;
+	int index;
+
+	if (READ_ONCE(per_cpu(suspend_data, policy->cpu).device_suspended))
+		return 0;
+
+	if (per_cpu(cached_resolve_freq, first_cpu) == target_freq)
+		index = per_cpu(cached_resolve_idx, first_cpu);
+	else
+		index = cpufreq_frequency_table_target(policy, target_freq,
+						       CPUFREQ_RELATION_L);
+	freq = policy->freq_table[index].frequency;
+	if (freq == policy->cur)
+		return freq;
+
+	trace_cpu_frequency_switch_start(policy->cur, freq, policy->cpu);
+	start = ktime_get_ns();
+	if (fs->set_rate(fs->data, freq * 1000UL))
+		return 0;
+	account_update(policy, UPDATE_FAST, ktime_get_ns() - start);
+
+	arch_set_freq_scale(policy->related_cpus, freq,
+			    policy->cpuinfo.max_freq);
+	trace_cpu_frequency_switch_end(policy->cpu);
+
+	return freq;
+}
+
 static unsigned int msm_cpufreq_resolve_freq(struct cpufreq_policy *policy,
 					     unsigned int target_freq)
 {
@@ -185,6 +300,13 @@ static int msm_cpufreq_init(struct cpufreq_policy *policy)
 	policy->cur = table[index].frequency;
 	policy->dvfs_possible_from_any_cpu = true;
 
+	/*
+	 * All cpus of the policy share the clock, so they share the hook.
+	 * Without one schedutil keeps using its kthread and ->target.
+	 */
+	policy->fast_switch_possible = fast_switch &&
+			per_cpu(fast_switch_data, policy->cpu).set_rate;
+
 	return 0;
 }
 
@@ -304,8 +426,34 @@ static struct notifier_block msm_cpufreq_pm_notifier = {
 	.notifier_call = msm_cpufreq_pm_event,
 };
 
+static ssize_t show_update_latency(struct cpufreq_policy *policy, char *buf)
+{
+	static const char * const names[UPDATE_TYPES] = {
+		[UPDATE_SLOW] = "slow",
+		[UPDATE_FAST] = "fast",
+	};
+	int first_cpu = cpumask_first(policy->related_cpus);
+	struct cpufreq_update_stats_t *stats;
+	ssize_t len = 0;
+	int type;
+
+	for (type = 0; type < UPDATE_TYPES; type++) {
+		stats = &per_cpu(update_stats, first_cpu)[type];
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				 "%s: count=%llu avg_ns=%llu max_ns=%llu\n",
+				 names[type], stats->count,
+				 stats->count ?
+				 div64_u64(stats->total_ns, stats->count) : 0,
+				 stats->max_ns);
+	}
+
+	return len;
+}
+cpufreq_freq_attr_ro(update_latency);
+
 static struct freq_attr *msm_freq_attr[] = {
 	&cpufreq_freq_attr_scaling_available_freqs,
+	&update_latency,
 	NULL,
 };
 
@@ -360,6 +508,7 @@ static struct cpufreq_driver msm_cpufreq_driver = {
 	.init		= msm_cpufreq_init,
 	.verify		= msm_cpufreq_verify,
 	.target		= msm_cpufreq_target,
+	.fast_switch	= msm_cpufreq_fast_switch,
 	.resolve_freq	= msm_cpufreq_resolve_freq,
 	.get		= msm_cpufreq_get_freq,
 	.name		= "msm",
@@ -274,6 +274,51 @@ static int create_cpu_lvl_nodes(struct lpm_cluster *p, struct kobject *parent)
 	return ret;
 }
 
+#ifdef CONFIG_MSM_IDLE_PERIODIC_PREDICT
+static ssize_t periodic_prediction_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	struct lpm_cluster *p = container_of(attr, struct lpm_cluster,
+						periodic_attr);
+
+	return snprintf(buf, PAGE_SIZE, "%d\n",
+			READ_ONCE(p->periodic_prediction));
+}
+
+static ssize_t periodic_prediction_store(struct kobject *kobj,
+		struct kobj_attribute *attr, const char *buf, size_t len)
+{
+	struct lpm_cluster *p = container_of(attr, struct lpm_cluster,
+						periodic_attr);
+	bool enable;
+	int ret;
+
+	ret = kstrtobool(buf, &enable);
+	if (ret)
+		return ret;
+
+	WRITE_ONCE(p->periodic_prediction, enable);
+	return len;
+}
+
+static int create_periodic_node(struct lpm_cluster *p, struct kobject *kobj)
+{
+	sysfs_attr_init(&p->periodic_attr.attr);
+	p->periodic_attr.attr.name = "periodic_prediction";
+	p->periodic_attr.attr.mode = 0644;
+	p->periodic_attr.show = periodic_prediction_show;
+	p->periodic_attr.store = periodic_prediction_store;
+
+	return sysfs_create_file(kobj, &p->periodic_attr.attr);
+}
+#else
+static inline int create_periodic_node(struct lpm_cluster *p,
+		struct kobject *kobj)
+{
+	return 0;
+}
+#endif
+
 int create_cluster_lvl_nodes(struct lpm_cluster *p, struct kobject *kobj)
 {
 	int ret = 0;
@@ -308,6 +353,10 @@ int create_cluster_lvl_nodes(struct lpm_cluster *p, struct kobject *kobj)
 		ret = create_cpu_lvl_nodes(p, cluster_kobj);
 		if (ret)
 			return ret;
+
+		ret = create_periodic_node(p, cluster_kobj);
+		if (ret)
+			return ret;
 	}
 
 	return ret;
@@ -372,6 +421,9 @@ static int parse_cluster_params(struct device_node *node,
 			c->tmr_add = DEFAULT_TIMER_ADD;
 	}
 
+	key = "qcom,periodic-prediction";
+	c->periodic_prediction = of_property_read_bool(node, key);
+
 	/* Set default_level to 0 as default */
 	c->default_level = 0;
 
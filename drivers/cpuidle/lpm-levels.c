@@ -90,6 +90,8 @@ struct ipi_history {
 static DEFINE_PER_CPU(struct lpm_history, hist);
 static DEFINE_PER_CPU(struct ipi_history, cpu_ipi_history);
 static DEFINE_PER_CPU(struct lpm_cpu*, cpu_lpm);
+/* Index + 1 of the level the cpu is in, 0 while it is running */
+static DEFINE_PER_CPU(int, lpm_cur_level);
 static bool suspend_in_progress;
 static struct hrtimer lpm_hrtimer;
 static DEFINE_PER_CPU(struct hrtimer, histtimer);
@@ -637,10 +639,12 @@ static int cpu_power_select(struct cpuidle_device *dev,
 	uint32_t lvl_latency_us = 0;
 	uint64_t predicted = 0;
 	uint32_t htime = 0, idx_restrict_time = 0, ipi_predicted = 0;
+	uint32_t periodic_predicted = 0;
 	uint32_t next_wakeup_us = (uint32_t)sleep_us;
 	uint32_t min_residency, max_residency;
 	struct power_params *pwr_params;
 
+	lpm_periodic_select(cpu, sleep_us);
 	if (lpm_disallowed(sleep_us, dev->cpu, cpu))
 		goto done_select;
 
@@ -675,9 +679,19 @@ static int cpu_power_select(struct cpuidle_device *dev,
 			 * call prediction.
 			 */
 			if (next_wakeup_us > max_residency) {
-				predicted = lpm_cpuidle_predict(dev, cpu,
-					&idx_restrict, &idx_restrict_time,
-					&ipi_predicted);
+				predicted = lpm_periodic_predict(cpu,
+						next_wakeup_us);
+				if (predicted) {
+					periodic_predicted = 1;
+					per_cpu(hist, dev->cpu).stime =
+						ktime_to_us(ktime_get())
+						+ predicted;
+				} else {
+					predicted = lpm_cpuidle_predict(dev,
+						cpu, &idx_restrict,
+						&idx_restrict_time,
+						&ipi_predicted);
+				}
 				if (predicted && (predicted < min_residency))
 					predicted = min_residency;
 			} else
@@ -727,10 +741,12 @@ static int cpu_power_select(struct cpuidle_device *dev,
 	}
 
 done_select:
+	lpm_wakeup_select(dev->cpu, best_level, sleep_us, predicted);
 	trace_cpu_power_select(best_level, sleep_us, latency_us, next_event_us);
 
-	trace_cpu_pred_select(idx_restrict_time ? 2 : (ipi_predicted ?
-				3 : (predicted ? 1 : 0)), predicted, htime);
+	trace_cpu_pred_select(periodic_predicted ? 4 : (idx_restrict_time ?
+				2 : (ipi_predicted ? 3 : (predicted ? 1 : 0))),
+				predicted, htime);
 
 	return best_level;
 }
@@ -1348,6 +1364,36 @@ static bool psci_enter_sleep(struct lpm_cpu *cpu, int idx, bool from_idle)
 	return success;
 }
 
+/**
+ * lpm_cpu_exit_latency - exit latency of the mode a cpu currently sleeps in
+ * @cpu: the cpu
+ *
+ * Includes the cluster levels the cpu's clusters have collapsed into, which
+ * the cpuidle state alone does not show. Read without locks, so it may be
+ * one transition out of date. Returns 0 for a running cpu.
+ */
+unsigned int lpm_cpu_exit_latency(int cpu)
+{
+	struct lpm_cpu *lpm_cpu = per_cpu(cpu_lpm, cpu);
+	int idx = READ_ONCE(per_cpu(lpm_cur_level, cpu)) - 1;
+	struct lpm_cluster *cluster;
+	unsigned int latency;
+
+	if (!lpm_cpu || idx < 0 || idx >= lpm_cpu->nlevels)
+		return 0;
+
+	latency = lpm_cpu->levels[idx].pwr.exit_latency;
+	for (cluster = lpm_cpu->parent; cluster; cluster = cluster->parent) {
+		int level = READ_ONCE(cluster->last_level);
+
+		if (level == cluster->default_level)
+			break;
+		latency += cluster->levels[level].pwr.exit_latency;
+	}
+
+	return latency;
+}
+
 static int lpm_cpuidle_select(struct cpuidle_driver *drv,
 		struct cpuidle_device *dev, bool *stop_tick)
 {
@@ -1407,6 +1453,15 @@ static void update_history(struct cpuidle_device *dev, int idx)
 		history->hptr = 0;
 }
 
+/*
+ * Idle forced through play_idle(), e.g. by thermal idle injection. Its
+ * length is set by the caller, so it says nothing about future wakeups.
+ */
+static inline bool lpm_idle_injected(void)
+{
+	return (current->flags & PF_IDLE) && !is_idle_task(current);
+}
+
 static int lpm_cpuidle_enter(struct cpuidle_device *dev,
 		struct cpuidle_driver *drv, int idx)
 {
@@ -1416,6 +1471,7 @@ static int lpm_cpuidle_enter(struct cpuidle_device *dev,
 	ktime_t start = ktime_get();
 	uint64_t start_time = ktime_to_ns(start), end_time;
 
+	WRITE_ONCE(per_cpu(lpm_cur_level, dev->cpu), idx + 1);
 	cpu_prepare(cpu, idx, true);
 	cluster_prepare(cpu->parent, cpumask, idx, true, start_time);
 
@@ -1435,8 +1491,13 @@ static int lpm_cpuidle_enter(struct cpuidle_device *dev,
 
 	cluster_unprepare(cpu->parent, cpumask, idx, true, end_time, success);
 	cpu_unprepare(cpu, idx, true);
+	WRITE_ONCE(per_cpu(lpm_cur_level, dev->cpu), 0);
 	dev->last_residency = ktime_us_delta(ktime_get(), start);
-	update_history(dev, idx);
+	if (!lpm_idle_injected()) {
+		update_history(dev, idx);
+		lpm_wakeup_exit(cpu, idx, dev->last_residency, success);
+		lpm_periodic_exit(cpu, success);
+	}
 	trace_cpu_idle_exit(idx, success);
 	if (lpm_prediction && cpu->lpm_prediction) {
 		histtimer_cancel();
@@ -111,6 +111,8 @@ struct lpm_cluster {
 	int last_level;
 	uint32_t tmr_add;
 	bool lpm_prediction;
+	bool periodic_prediction;
+	struct kobj_attribute periodic_attr;
 	struct list_head cpu;
 	spinlock_t sync_lock;
 	struct cpumask child_cpus;
@@ -136,6 +138,43 @@ uint32_t *get_per_cpu_max_residency(int cpu);
 uint32_t *get_per_cpu_min_residency(int cpu);
 extern struct lpm_cluster *lpm_root_node;
 
+#ifdef CONFIG_MSM_IDLE_WAKEUP_STATS
+void lpm_wakeup_select(unsigned int cpu, int idx, s64 sleep_us,
+		uint64_t predicted_us);
+void lpm_wakeup_exit(struct lpm_cpu *cpu, int idx, uint32_t residency_us,
+		bool success);
+#else
+static inline void lpm_wakeup_select(unsigned int cpu, int idx,
+		s64 sleep_us, uint64_t predicted_us)
+{
+}
+
+static inline void lpm_wakeup_exit(struct lpm_cpu *cpu, int idx,
+		uint32_t residency_us, bool success)
+{
+}
+#endif
+
+#ifdef CONFIG_MSM_IDLE_PERIODIC_PREDICT
+void lpm_periodic_select(struct lpm_cpu *cpu, s64 sleep_us);
+uint32_t lpm_periodic_predict(struct lpm_cpu *cpu, uint32_t next_wakeup_us);
+void lpm_periodic_exit(struct lpm_cpu *cpu, bool success);
+#else
+static inline void lpm_periodic_select(struct lpm_cpu *cpu, s64 sleep_us)
+{
+}
+
+static inline uint32_t lpm_periodic_predict(struct lpm_cpu *cpu,
+		uint32_t next_wakeup_us)
+{
+	return 0;
+}
+
+static inline void lpm_periodic_exit(struct lpm_cpu *cpu, bool success)
+{
+}
+#endif
+
 #if defined(CONFIG_SMP)
 extern DEFINE_PER_CPU(bool, pending_ipi);
 static inline bool is_IPI_pending(const struct cpumask *mask)
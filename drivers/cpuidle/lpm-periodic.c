@@ -0,0 +1,281 @@
+/* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#define pr_fmt(fmt) "%s: " fmt, KBUILD_MODNAME
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include "lpm-levels.h"
+
+/*
+ * Periodic wakeup prediction.
+ *
+ * Display vsync, audio periods and sensor batches wake a cpu through an
+ * interrupt at a fixed rate that the next timer knows nothing about. The
+ * interval between consecutive idle exits that came before the expected
+ * timer is kept per cpu, and when nearly all recent intervals are a small
+ * multiple of the shortest one, that is taken as the period. Missed
+ * periods, while the cpu was busy, are then still matched.
+ *
+ * Every such wakeup that lands on the pattern raises the confidence in it
+ * and every miss lowers it twice as fast. The pattern is only used for
+ * idle selection above LPM_PERIODIC_CONF_MIN, and the less confident it
+ * is, the earlier the next wakeup is expected, so mispredictions err
+ * towards shallower levels.
+ */
+
+#define LPM_PERIODIC_SAMPLES	8
+#define LPM_PERIODIC_MAX_MULT	4
+#define LPM_PERIODIC_MIN_TOL_US	100
+#define LPM_PERIODIC_CONF_MIN	4
+#define LPM_PERIODIC_CONF_MAX	8
+
+struct lpm_periodic_cpu {
+	uint32_t interval[LPM_PERIODIC_SAMPLES];
+	unsigned int ptr;
+	unsigned int nsamp;
+	uint64_t last_wake_us;
+	/* Expected timer wakeup and predicted wakeup of this idle entry */
+	uint64_t timer_us;
+	uint64_t predicted_us;
+	uint32_t period_us;
+	uint32_t tol_us;
+	int confidence;
+	/* Accuracy of the predictions that were used */
+	uint32_t predictions;
+	uint32_t hits;
+	uint32_t early;
+	uint32_t late;
+};
+
+static DEFINE_PER_CPU(struct lpm_periodic_cpu, lpm_periodic);
+
+static bool lpm_periodic_enabled(struct lpm_cpu *cpu)
+{
+	return cpu->parent && READ_ONCE(cpu->parent->periodic_prediction);
+}
+
+static void lpm_periodic_update(struct lpm_periodic_cpu *pc)
+{
+	uint32_t base = U32_MAX, tol;
+	unsigned int i, k, matched = 0, mult = 0;
+	uint64_t sum = 0;
+
+	pc->period_us = 0;
+	if (pc->nsamp < LPM_PERIODIC_SAMPLES) {
+		pc->confidence = 0;
+		return;
+	}
+
+	for (i = 0; i < LPM_PERIODIC_SAMPLES; i++)
+		base = min(base, pc->interval[i]);
+	if (!base)
+		goto broken;
+
+	tol = max_t(uint32_t, base / 16, LPM_PERIODIC_MIN_TOL_US);
+	for (i = 0; i < LPM_PERIODIC_SAMPLES; i++) {
+		uint32_t val = pc->interval[i];
+
+		k = DIV_ROUND_CLOSEST(val, base);
+		if (k > LPM_PERIODIC_MAX_MULT)
+			continue;
+		if (abs((int64_t)val - (int64_t)k * base) > tol)
+			continue;
+		matched++;
+		mult += k;
+		sum += val;
+	}
+
+	if (matched < LPM_PERIODIC_SAMPLES - 2)
+		goto broken;
+
+	pc->period_us = div_u64(sum, mult);
+	pc->tol_us = tol;
+	return;
+
+broken:
+	pc->confidence = 0;
+}
+
+/* Whether a wakeup @delta us after the last one falls on the pattern */
+static bool lpm_periodic_match(struct lpm_periodic_cpu *pc, uint64_t delta)
+{
+	uint64_t k, err;
+
+	k = div64_u64(delta + pc->period_us / 2, pc->period_us);
+	if (!k || k > LPM_PERIODIC_MAX_MULT)
+		return false;
+
+	err = abs((int64_t)delta - (int64_t)(k * pc->period_us));
+	return err <= pc->tol_us;
+}
+
+void lpm_periodic_select(struct lpm_cpu *cpu, s64 sleep_us)
+{
+	struct lpm_periodic_cpu *pc = this_cpu_ptr(&lpm_periodic);
+
+	pc->predicted_us = 0;
+	if (!lpm_periodic_enabled(cpu))
+		return;
+
+	pc->timer_us = ktime_to_us(ktime_get()) + max_t(s64, sleep_us, 0);
+}
+
+uint32_t lpm_periodic_predict(struct lpm_cpu *cpu, uint32_t next_wakeup_us)
+{
+	struct lpm_periodic_cpu *pc = this_cpu_ptr(&lpm_periodic);
+	uint64_t now, next, margin, k;
+	uint32_t predicted;
+
+	if (!lpm_periodic_enabled(cpu) || !pc->period_us ||
+			pc->confidence < LPM_PERIODIC_CONF_MIN)
+		return 0;
+
+	now = ktime_to_us(ktime_get());
+	if (now < pc->last_wake_us)
+		return 0;
+
+	k = div64_u64(now - pc->last_wake_us, pc->period_us) + 1;
+	if (k > LPM_PERIODIC_MAX_MULT)
+		return 0;
+
+	next = pc->last_wake_us + k * pc->period_us;
+	margin = pc->tol_us + (pc->period_us / 8) *
+		(LPM_PERIODIC_CONF_MAX - pc->confidence) /
+		LPM_PERIODIC_CONF_MAX;
+	predicted = next > now + margin ? next - margin - now : 1;
+
+	/* The timer wakes the cpu first, nothing to add to that */
+	if (predicted >= next_wakeup_us)
+		return 0;
+
+	pc->predicted_us = next;
+	pc->predictions++;
+
+	return predicted;
+}
+
+void lpm_periodic_exit(struct lpm_cpu *cpu, bool success)
+{
+	struct lpm_periodic_cpu *pc = this_cpu_ptr(&lpm_periodic);
+	uint64_t predicted = pc->predicted_us;
+	uint64_t now;
+
+	pc->predicted_us = 0;
+	if (!success || !lpm_periodic_enabled(cpu))
+		return;
+
+	now = ktime_to_us(ktime_get());
+
+	if (predicted) {
+		if (now + pc->tol_us < predicted) {
+			pc->early++;
+		} else if (now > predicted + pc->tol_us) {
+			/*
+			 * Woken by the history timer or the real timer, the
+			 * expected interrupt never came. Leave last_wake_us
+			 * so the next one is still matched as a multiple.
+			 */
+			pc->late++;
+			pc->confidence = max(pc->confidence - 2, 0);
+			return;
+		} else {
+			pc->hits++;
+		}
+	}
+
+	/* Woken by the timer the idle selection already knew about */
+	if (now + LPM_PERIODIC_MIN_TOL_US >= pc->timer_us)
+		return;
+
+	if (pc->last_wake_us) {
+		uint64_t delta = now - pc->last_wake_us;
+
+		if (pc->period_us) {
+			if (lpm_periodic_match(pc, delta))
+				pc->confidence = min(pc->confidence + 1,
+						LPM_PERIODIC_CONF_MAX);
+			else
+				pc->confidence = max(pc->confidence - 2, 0);
+		}
+
+		pc->interval[pc->ptr] = min_t(uint64_t, delta, U32_MAX);
+		pc->ptr = (pc->ptr + 1) % LPM_PERIODIC_SAMPLES;
+		if (pc->nsamp < LPM_PERIODIC_SAMPLES)
+			pc->nsamp++;
+		lpm_periodic_update(pc);
+	}
+	pc->last_wake_us = now;
+}
+
+/* Read without stopping the cpus, so a line may mix old and new values */
+static int lpm_periodic_show(struct seq_file *m, void *v)
+{
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct lpm_periodic_cpu *pc = &per_cpu(lpm_periodic, cpu);
+
+		seq_printf(m, "cpu%u: period %u tol %u conf %d pred %u hit %u early %u late %u\n",
+				cpu, pc->period_us, pc->tol_us, pc->confidence,
+				pc->predictions, pc->hits, pc->early,
+				pc->late);
+	}
+
+	return 0;
+}
+
+static int lpm_periodic_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lpm_periodic_show, inode->i_private);
+}
+
+static void lpm_periodic_reset_cpu(void *info)
+{
+	struct lpm_periodic_cpu *pc = this_cpu_ptr(&lpm_periodic);
+
+	pc->predictions = pc->hits = pc->early = pc->late = 0;
+}
+
+static ssize_t lpm_periodic_write(struct file *file, const char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	on_each_cpu(lpm_periodic_reset_cpu, NULL, 1);
+
+	return count;
+}
+
+static const struct file_operations lpm_periodic_fops = {
+	.owner = THIS_MODULE,
+	.open = lpm_periodic_open,
+	.read = seq_read,
+	.write = lpm_periodic_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init lpm_periodic_init(void)
+{
+	if (!debugfs_create_file("lpm_periodic", 0600, NULL, NULL,
+				&lpm_periodic_fops))
+		pr_err("Unable to create debugfs stats file\n");
+
+	return 0;
+}
+late_initcall(lpm_periodic_init);
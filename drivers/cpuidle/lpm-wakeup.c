@@ -0,0 +1,394 @@
+/* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#define pr_fmt(fmt) "%s: " fmt, KBUILD_MODNAME
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/interrupt.h>
+#include <linux/hrtimer.h>
+#include <linux/sched/clock.h>
+#include <trace/events/irq.h>
+#include <trace/events/ipi.h>
+#include <trace/events/timer.h>
+#include "lpm-levels.h"
+
+/*
+ * Wakeup source attribution for idle exits.
+ *
+ * lpm_wakeup_exit() is called with irqs still disabled on the way out of
+ * idle and logs the exit in a per-cpu ring, leaving the record pending.
+ * Once irqs are enabled the interrupt that woke the cpu is handled first,
+ * and the irq, IPI and hrtimer probes below fill in the cause of the
+ * pending record. A record that is still pending at the next idle
+ * selection had no interrupt handled in between and is left as unknown.
+ */
+
+#define LPM_WAKEUP_RING		64
+#define LPM_WAKEUP_NAME_LEN	16
+
+enum lpm_wakeup_cause {
+	LPM_WAKE_ABORT,
+	LPM_WAKE_UNKNOWN,
+	LPM_WAKE_IRQ,
+	LPM_WAKE_TIMER,
+	LPM_WAKE_IPI,
+	LPM_WAKE_NR,
+};
+
+static const char * const lpm_wakeup_cause_names[LPM_WAKE_NR] = {
+	[LPM_WAKE_ABORT]	= "abort",
+	[LPM_WAKE_UNKNOWN]	= "unknown",
+	[LPM_WAKE_IRQ]		= "irq",
+	[LPM_WAKE_TIMER]	= "timer",
+	[LPM_WAKE_IPI]		= "ipi",
+};
+
+struct lpm_wakeup_rec {
+	uint64_t time;
+	uint32_t sleep_us;
+	uint32_t predicted_us;
+	uint32_t residency_us;
+	int idx;
+	enum lpm_wakeup_cause cause;
+	int irq;
+	const char *ipi;
+	void *timer_fn;
+	char name[LPM_WAKEUP_NAME_LEN];
+};
+
+struct lpm_wakeup_level {
+	uint32_t exits;
+	uint32_t too_deep;
+	uint32_t too_shallow;
+};
+
+struct lpm_wakeup_cpu {
+	struct lpm_wakeup_rec ring[LPM_WAKEUP_RING];
+	unsigned int head;
+	struct lpm_wakeup_rec *pending;
+	bool in_irq;
+	uint32_t sleep_us;
+	uint32_t predicted_us;
+	uint32_t causes[LPM_WAKE_NR];
+	struct lpm_wakeup_level levels[NR_LPM_LEVELS];
+};
+
+static DEFINE_PER_CPU(struct lpm_wakeup_cpu, lpm_wakeup);
+static DEFINE_MUTEX(lpm_wakeup_lock);
+static bool lpm_wakeup_enabled;
+
+static void lpm_wakeup_resolve(struct lpm_wakeup_cpu *wc,
+		enum lpm_wakeup_cause cause)
+{
+	wc->pending->cause = cause;
+	wc->causes[cause]++;
+	wc->pending = NULL;
+}
+
+void lpm_wakeup_select(unsigned int cpu, int idx, s64 sleep_us,
+		uint64_t predicted_us)
+{
+	struct lpm_wakeup_cpu *wc = &per_cpu(lpm_wakeup, cpu);
+
+	if (!READ_ONCE(lpm_wakeup_enabled))
+		return;
+
+	if (wc->pending)
+		lpm_wakeup_resolve(wc, LPM_WAKE_UNKNOWN);
+
+	wc->sleep_us = clamp_t(s64, sleep_us, 0, U32_MAX);
+	wc->predicted_us = min_t(uint64_t, predicted_us, U32_MAX);
+}
+
+void lpm_wakeup_exit(struct lpm_cpu *cpu, int idx, uint32_t residency_us,
+		bool success)
+{
+	struct lpm_wakeup_cpu *wc = this_cpu_ptr(&lpm_wakeup);
+	struct power_params *pwr = &cpu->levels[idx].pwr;
+	struct lpm_wakeup_level *lvl = &wc->levels[idx];
+	struct lpm_wakeup_rec *rec;
+
+	if (!READ_ONCE(lpm_wakeup_enabled))
+		return;
+
+	rec = &wc->ring[wc->head++ % LPM_WAKEUP_RING];
+	memset(rec, 0, sizeof(*rec));
+	rec->time = sched_clock();
+	rec->idx = idx;
+	rec->sleep_us = wc->sleep_us;
+	rec->predicted_us = wc->predicted_us;
+	rec->residency_us = residency_us;
+
+	if (!success) {
+		rec->cause = LPM_WAKE_ABORT;
+		wc->causes[LPM_WAKE_ABORT]++;
+		return;
+	}
+
+	lvl->exits++;
+	if (residency_us < pwr->min_residency)
+		lvl->too_deep++;
+	else if (idx < cpu->nlevels - 1 && residency_us > pwr->max_residency)
+		lvl->too_shallow++;
+
+	wc->in_irq = false;
+	wc->pending = rec;
+}
+
+static void lpm_wakeup_irq_entry(void *ignore, int irq,
+		struct irqaction *action)
+{
+	struct lpm_wakeup_cpu *wc = this_cpu_ptr(&lpm_wakeup);
+
+	if (!wc->pending || wc->in_irq)
+		return;
+
+	wc->pending->irq = irq;
+	if (action->name)
+		strlcpy(wc->pending->name, action->name,
+				sizeof(wc->pending->name));
+	wc->in_irq = true;
+}
+
+static void lpm_wakeup_irq_exit(void *ignore, int irq,
+		struct irqaction *action, int ret)
+{
+	struct lpm_wakeup_cpu *wc = this_cpu_ptr(&lpm_wakeup);
+
+	if (!wc->pending || !wc->in_irq)
+		return;
+
+	wc->in_irq = false;
+	lpm_wakeup_resolve(wc, wc->pending->timer_fn ?
+			LPM_WAKE_TIMER : LPM_WAKE_IRQ);
+}
+
+static void lpm_wakeup_hrtimer_entry(void *ignore, struct hrtimer *hrtimer,
+		ktime_t *now)
+{
+	struct lpm_wakeup_cpu *wc = this_cpu_ptr(&lpm_wakeup);
+
+	/* Only the first timer that expired in the waking interrupt */
+	if (wc->pending && wc->in_irq && !wc->pending->timer_fn)
+		wc->pending->timer_fn = hrtimer->function;
+}
+
+static void lpm_wakeup_ipi_entry(void *ignore, const char *reason)
+{
+	struct lpm_wakeup_cpu *wc = this_cpu_ptr(&lpm_wakeup);
+
+	if (!wc->pending || wc->in_irq)
+		return;
+
+	wc->pending->ipi = reason;
+	lpm_wakeup_resolve(wc, LPM_WAKE_IPI);
+}
+
+static int lpm_wakeup_register(void)
+{
+	int ret;
+
+	ret = register_trace_irq_handler_entry(lpm_wakeup_irq_entry, NULL);
+	if (ret)
+		return ret;
+
+	ret = register_trace_irq_handler_exit(lpm_wakeup_irq_exit, NULL);
+	if (ret)
+		goto fail_irq_entry;
+
+	ret = register_trace_hrtimer_expire_entry(lpm_wakeup_hrtimer_entry,
+			NULL);
+	if (ret)
+		goto fail_irq_exit;
+
+	ret = register_trace_ipi_entry(lpm_wakeup_ipi_entry, NULL);
+	if (ret)
+		goto fail_hrtimer;
+
+	return 0;
+
+fail_hrtimer:
+	unregister_trace_hrtimer_expire_entry(lpm_wakeup_hrtimer_entry, NULL);
+fail_irq_exit:
+	unregister_trace_irq_handler_exit(lpm_wakeup_irq_exit, NULL);
+fail_irq_entry:
+	unregister_trace_irq_handler_entry(lpm_wakeup_irq_entry, NULL);
+	return ret;
+}
+
+static void lpm_wakeup_unregister(void)
+{
+	unregister_trace_ipi_entry(lpm_wakeup_ipi_entry, NULL);
+	unregister_trace_hrtimer_expire_entry(lpm_wakeup_hrtimer_entry, NULL);
+	unregister_trace_irq_handler_exit(lpm_wakeup_irq_exit, NULL);
+	unregister_trace_irq_handler_entry(lpm_wakeup_irq_entry, NULL);
+	tracepoint_synchronize_unregister();
+}
+
+static void lpm_wakeup_reset_cpu(void *info)
+{
+	struct lpm_wakeup_cpu *wc = this_cpu_ptr(&lpm_wakeup);
+
+	memset(wc, 0, sizeof(*wc));
+}
+
+static int lpm_wakeup_enable_set(const char *val,
+		const struct kernel_param *kp)
+{
+	bool enable;
+	int ret;
+
+	ret = strtobool(val, &enable);
+	if (ret)
+		return ret;
+
+	mutex_lock(&lpm_wakeup_lock);
+	if (enable == lpm_wakeup_enabled)
+		goto out;
+
+	if (enable) {
+		ret = lpm_wakeup_register();
+		if (ret)
+			goto out;
+		/* Start from clean state, nothing can be pending yet */
+		on_each_cpu(lpm_wakeup_reset_cpu, NULL, 1);
+		WRITE_ONCE(lpm_wakeup_enabled, true);
+	} else {
+		WRITE_ONCE(lpm_wakeup_enabled, false);
+		lpm_wakeup_unregister();
+	}
+out:
+	mutex_unlock(&lpm_wakeup_lock);
+	return ret;
+}
+
+static const struct kernel_param_ops lpm_wakeup_enable_ops = {
+	.set = lpm_wakeup_enable_set,
+	.get = param_get_bool,
+};
+module_param_cb(enable, &lpm_wakeup_enable_ops, &lpm_wakeup_enabled, 0644);
+
+static void lpm_wakeup_print_rec(struct seq_file *m,
+		struct lpm_wakeup_rec *rec)
+{
+	seq_printf(m, "  %llu.%06llu lvl %d res %u sleep %u pred %u %s",
+			rec->time / NSEC_PER_SEC,
+			(rec->time % NSEC_PER_SEC) / NSEC_PER_USEC,
+			rec->idx, rec->residency_us, rec->sleep_us,
+			rec->predicted_us, lpm_wakeup_cause_names[rec->cause]);
+
+	switch (rec->cause) {
+	case LPM_WAKE_TIMER:
+		seq_printf(m, " %ps irq %d %s", rec->timer_fn, rec->irq,
+				rec->name);
+		break;
+	case LPM_WAKE_IRQ:
+		seq_printf(m, " %d %s", rec->irq, rec->name);
+		break;
+	case LPM_WAKE_IPI:
+		seq_printf(m, " %s", rec->ipi);
+		break;
+	default:
+		break;
+	}
+	seq_putc(m, '\n');
+}
+
+/*
+ * The per-cpu data is read without stopping the cpus that write it, so a
+ * record being written at the same time may show up half updated.
+ */
+static int lpm_wakeup_show(struct seq_file *m, void *v)
+{
+	unsigned int cpu, i, n;
+	int c;
+
+	for_each_possible_cpu(cpu) {
+		struct lpm_wakeup_cpu *wc = &per_cpu(lpm_wakeup, cpu);
+		unsigned int head = READ_ONCE(wc->head);
+
+		seq_printf(m, "cpu%u:", cpu);
+		for (c = 0; c < LPM_WAKE_NR; c++)
+			seq_printf(m, " %s %u", lpm_wakeup_cause_names[c],
+					wc->causes[c]);
+		seq_putc(m, '\n');
+
+		for (i = 0; i < NR_LPM_LEVELS; i++) {
+			struct lpm_wakeup_level *lvl = &wc->levels[i];
+
+			if (!lvl->exits)
+				continue;
+			seq_printf(m, "  lvl %u exits %u too_deep %u too_shallow %u\n",
+					i, lvl->exits, lvl->too_deep,
+					lvl->too_shallow);
+		}
+
+		n = min_t(unsigned int, head, LPM_WAKEUP_RING);
+		for (i = head - n; i != head; i++)
+			lpm_wakeup_print_rec(m, &wc->ring[i % LPM_WAKEUP_RING]);
+	}
+
+	return 0;
+}
+
+static int lpm_wakeup_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lpm_wakeup_show, inode->i_private);
+}
+
+static ssize_t lpm_wakeup_write(struct file *file, const char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	mutex_lock(&lpm_wakeup_lock);
+	on_each_cpu(lpm_wakeup_reset_cpu, NULL, 1);
+	mutex_unlock(&lpm_wakeup_lock);
+
+	return count;
+}
+
+static const struct file_operations lpm_wakeup_fops = {
+	.owner = THIS_MODULE,
+	.open = lpm_wakeup_open,
+	.read = seq_read,
+	.write = lpm_wakeup_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init lpm_wakeup_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("lpm_wakeup", NULL);
+	if (IS_ERR_OR_NULL(dir)) {
+		pr_err("Unable to create debugfs directory\n");
+		return -ENODEV;
+	}
+
+	if (!debugfs_create_file("stats", 0600, dir, NULL, &lpm_wakeup_fops)) {
+		pr_err("Unable to create debugfs stats file\n");
+		debugfs_remove_recursive(dir);
+		return -ENODEV;
+	}
+
+	return 0;
+}
+late_initcall(lpm_wakeup_init);
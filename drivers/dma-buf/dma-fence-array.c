@@ -19,8 +19,12 @@
 
 #include <linux/export.h>
 #include <linux/slab.h>
+#include <linux/sort.h>
 #include <linux/dma-fence-array.h>
 
+/* Fences dma_fence_array_merge() sorts without allocating */
+#define DMA_FENCE_MERGE_STACK 16
+
 static const char *dma_fence_array_get_driver_name(struct dma_fence *fence)
 {
 	return "dma_fence_array";
@@ -95,7 +99,8 @@ static void dma_fence_array_release(struct dma_fence *fence)
 	for (i = 0; i < array->num_fences; ++i)
 		dma_fence_put(array->fences[i]);
 
-	kfree(array->fences);
+	if (array->fences != array->inline_fences)
+		kfree(array->fences);
 	dma_fence_free(fence);
 }
 
@@ -155,6 +160,156 @@ struct dma_fence_array *dma_fence_array_create(int num_fences,
 }
 EXPORT_SYMBOL(dma_fence_array_create);
 
+/* Number of fences in @fence once nested arrays are flattened */
+static unsigned long dma_fence_array_count(struct dma_fence *fence)
+{
+	struct dma_fence_array *array = to_dma_fence_array(fence);
+	unsigned long count = 0;
+	unsigned i;
+
+	if (!array)
+		return 1;
+
+	for (i = 0; i < array->num_fences; i++)
+		count += dma_fence_array_count(array->fences[i]);
+
+	return count;
+}
+
+static void dma_fence_array_flatten(struct dma_fence *fence,
+				    struct dma_fence **out, int *count,
+				    struct dma_fence **signaled)
+{
+	struct dma_fence_array *array = to_dma_fence_array(fence);
+	unsigned i;
+
+	if (array) {
+		for (i = 0; i < array->num_fences; i++)
+			dma_fence_array_flatten(array->fences[i], out, count,
+						signaled);
+		return;
+	}
+
+	if (dma_fence_is_signaled(fence)) {
+		if (!*signaled)
+			*signaled = fence;
+		return;
+	}
+
+	out[(*count)++] = fence;
+}
+
+static int dma_fence_cmp_context(const void *a, const void *b)
+{
+	const struct dma_fence *fa = *(struct dma_fence * const *)a;
+	const struct dma_fence *fb = *(struct dma_fence * const *)b;
+
+	if (fa->context < fb->context)
+		return -1;
+	return fa->context > fb->context;
+}
+
+/**
+ * dma_fence_array_merge - Merge fences into a single, flat fence
+ * @num_fences:		[in]	number of fences in @fences
+ * @fences:		[in]	fences to merge, arrays among them
+ * @context:		[in]	fence context of a new array
+ * @seqno:		[in]	sequence number of a new array
+ *
+ * Nested arrays are flattened, fences already signaled are dropped and
+ * of several fences of one context only the latest is kept. What is left
+ * is returned as is when it is a single fence, otherwise as a new array
+ * sorted by context, signaling when all of its fences signal. When all
+ * fences have signaled, one of them is returned. Up to
+ * DMA_FENCE_ARRAY_INLINE_FENCES fences need no allocation besides the
+ * array itself.
+ *
+ * The caller keeps its references to @fences. Returns a new reference or
+ * NULL in case of error.
+ */
+struct dma_fence *dma_fence_array_merge(int num_fences,
+					struct dma_fence **fences,
+					u64 context, unsigned seqno)
+{
+	struct dma_fence *stack[DMA_FENCE_MERGE_STACK];
+	struct dma_fence **merged = stack, **out;
+	struct dma_fence *signaled = NULL;
+	struct dma_fence_array *array;
+	unsigned long total = 0;
+	int i, count = 0, kept;
+
+	for (i = 0; i < num_fences; i++)
+		total += dma_fence_array_count(fences[i]);
+	if (total > INT_MAX)
+		return NULL;
+
+	if (total > ARRAY_SIZE(stack)) {
+		merged = kmalloc_array(total, sizeof(*merged), GFP_KERNEL);
+		if (!merged)
+			return NULL;
+	}
+
+	for (i = 0; i < num_fences; i++)
+		dma_fence_array_flatten(fences[i], merged, &count, &signaled);
+
+	if (!count) {
+		/* an empty array has signaled as well */
+		if (!signaled)
+			signaled = fences[0];
+		if (merged != stack)
+			kfree(merged);
+		return dma_fence_get(signaled);
+	}
+
+	sort(merged, count, sizeof(*merged), dma_fence_cmp_context, NULL);
+	for (i = 1, kept = 0; i < count; i++) {
+		if (merged[i]->context != merged[kept]->context)
+			merged[++kept] = merged[i];
+		else if (dma_fence_is_later(merged[i], merged[kept]))
+			merged[kept] = merged[i];
+	}
+	count = kept + 1;
+
+	if (count == 1) {
+		signaled = dma_fence_get(merged[0]);
+		if (merged != stack)
+			kfree(merged);
+		return signaled;
+	}
+
+	if (count <= DMA_FENCE_ARRAY_INLINE_FENCES) {
+		out = NULL;
+	} else if (merged != stack) {
+		out = merged;
+	} else {
+		out = kmemdup(merged, count * sizeof(*merged), GFP_KERNEL);
+		if (!out)
+			return NULL;
+	}
+
+	array = dma_fence_array_create(count, out, context, seqno, false);
+	if (!array) {
+		if (merged != stack)
+			kfree(merged);
+		else
+			kfree(out);
+		return NULL;
+	}
+
+	if (!out) {
+		memcpy(array->inline_fences, merged, count * sizeof(*merged));
+		array->fences = array->inline_fences;
+		if (merged != stack)
+			kfree(merged);
+	}
+
+	for (i = 0; i < count; i++)
+		dma_fence_get(array->fences[i]);
+
+	return &array->base;
+}
+EXPORT_SYMBOL(dma_fence_array_merge);
+
 /**
  * dma_fence_match_context - Check if all fences are from the given context
  * @fence:		[in]	fence or fence array
@@ -13,6 +13,8 @@
 #define pr_fmt(fmt)	"[drm-shd:%s:%d] " fmt, __func__, __LINE__
 
 #include <linux/debugfs.h>
+#include <linux/hrtimer.h>
+#include <linux/moduleparam.h>
 #include <uapi/drm/sde_drm.h>
 
 #include "sde_encoder_phys.h"
@@ -44,6 +46,7 @@
  * @hw_ctl:	HW CTL blocks created by this shared encoder
  * @num_mixers:	Number of LM blocks
  * @num_ctls:	Number of CTL blocks
+ * @display:	Shared display of this encoder, set at mode_set
  */
 struct sde_encoder_phys_shd {
 	struct sde_encoder_phys base;
@@ -51,11 +54,133 @@ struct sde_encoder_phys_shd {
 	struct sde_hw_ctl *hw_ctl[CRTC_DUAL_MIXERS];
 	u32 num_mixers;
 	u32 num_ctls;
+	struct shd_display *display;
 };
 
 #define to_sde_encoder_phys_shd(x) \
 	container_of(x, struct sde_encoder_phys_shd, base)
 
+/*
+ * Combined flush: each partition commits on its own, so two partitions
+ * updating in the same frame flush the base twice and one of them can
+ * slip to the next vsync. With combined_flush set, a partition's flush
+ * is held back until every partition of the base that started a kickoff
+ * is ready as well, or SHD_FLUSH_WAIT_US passed, and all of them are
+ * then programmed and triggered together. Each partition still checks
+ * its own flush mask at vblank, so its fences are signalled separately.
+ */
+static bool combined_flush;
+module_param(combined_flush, bool, 0644);
+
+#define SHD_FLUSH_WAIT_US	2000
+
+static struct shd_flush_group *_sde_encoder_phys_shd_group(
+		struct sde_encoder_phys_shd *shd_enc)
+{
+	struct shd_display *display = shd_enc->display;
+
+	if (!display || display->flush_idx < 0)
+		return NULL;
+
+	return &display->base->flush_group;
+}
+
+/* Called with group->lock held */
+static void _sde_encoder_phys_shd_group_kick(struct shd_flush_group *group)
+{
+	struct sde_shd_flush_req req[SHD_MAX_PARTITIONS];
+	struct sde_encoder_phys_shd *shd_enc;
+	struct sde_encoder_phys *phys_enc;
+	unsigned long ready = group->ready;
+	int i, num = 0;
+
+	for_each_set_bit(i, &ready, SHD_MAX_PARTITIONS) {
+		phys_enc = group->phys[i];
+		if (!phys_enc || !phys_enc->hw_ctl)
+			continue;
+
+		shd_enc = to_sde_encoder_phys_shd(phys_enc);
+		req[num].ctl = phys_enc->hw_ctl;
+		req[num].lm = shd_enc->hw_lm;
+		req[num].lm_num = shd_enc->num_mixers;
+		num++;
+	}
+
+	if (num)
+		sde_shd_hw_flush_multi(req, num);
+
+	SDE_EVT32(group->armed, group->ready, num);
+
+	group->armed &= ~group->ready;
+	group->ready = 0;
+}
+
+static enum hrtimer_restart _sde_encoder_phys_shd_group_timeout(
+		struct hrtimer *timer)
+{
+	struct shd_flush_group *group =
+		container_of(timer, struct shd_flush_group, timer);
+	unsigned long lock_flags;
+
+	spin_lock_irqsave(&group->lock, lock_flags);
+	if (group->ready)
+		_sde_encoder_phys_shd_group_kick(group);
+	/* the partitions that are late flush on their own */
+	group->armed = 0;
+	spin_unlock_irqrestore(&group->lock, lock_flags);
+
+	return HRTIMER_NORESTART;
+}
+
+void shd_flush_group_init(struct shd_flush_group *group)
+{
+	spin_lock_init(&group->lock);
+	hrtimer_init(&group->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	group->timer.function = _sde_encoder_phys_shd_group_timeout;
+}
+
+static bool _sde_encoder_phys_shd_flush_held(
+		struct sde_encoder_phys_shd *shd_enc)
+{
+	struct shd_flush_group *group = _sde_encoder_phys_shd_group(shd_enc);
+
+	return group &&
+		(READ_ONCE(group->ready) & BIT(shd_enc->display->flush_idx));
+}
+
+static void _sde_encoder_phys_shd_group_join(
+		struct sde_encoder_phys_shd *shd_enc)
+{
+	struct shd_flush_group *group = _sde_encoder_phys_shd_group(shd_enc);
+	unsigned long lock_flags;
+
+	if (!group)
+		return;
+
+	spin_lock_irqsave(&group->lock, lock_flags);
+	group->phys[shd_enc->display->flush_idx] = &shd_enc->base;
+	spin_unlock_irqrestore(&group->lock, lock_flags);
+}
+
+static void _sde_encoder_phys_shd_group_leave(
+		struct sde_encoder_phys_shd *shd_enc)
+{
+	struct shd_flush_group *group = _sde_encoder_phys_shd_group(shd_enc);
+	unsigned long lock_flags;
+	u32 bit;
+
+	if (!group)
+		return;
+
+	bit = BIT(shd_enc->display->flush_idx);
+
+	spin_lock_irqsave(&group->lock, lock_flags);
+	group->phys[shd_enc->display->flush_idx] = NULL;
+	group->armed &= ~bit;
+	group->ready &= ~bit;
+	spin_unlock_irqrestore(&group->lock, lock_flags);
+}
+
 static inline
 bool sde_encoder_phys_shd_is_master(struct sde_encoder_phys *phys_enc)
 {
@@ -95,6 +220,10 @@ static void sde_encoder_phys_shd_vblank_irq(void *arg, int irq_idx)
 
 	shd_ctl = container_of(hw_ctl, struct sde_shd_hw_ctl, base);
 
+	/* flush held back for the other partitions, not programmed yet */
+	if (_sde_encoder_phys_shd_flush_held(to_sde_encoder_phys_shd(phys_enc)))
+		goto not_flushed;
+
 	if (flush_register)
 		SDE_DEBUG("%d irq flush=0x%x mask=0x%x\n",
 			DRMID(phys_enc->parent),
@@ -297,6 +426,8 @@ static void sde_encoder_phys_shd_mode_set(
 	if (_sde_encoder_phys_shd_rm_reserve(phys_enc, display))
 		return;
 
+	to_sde_encoder_phys_shd(phys_enc)->display = display;
+
 	rm = &phys_enc->sde_kms->rm;
 
 	sde_rm_init_hw_iter(&iter, DRMID(phys_enc->parent), SDE_HW_BLK_CTL);
@@ -330,6 +461,8 @@ static void sde_encoder_phys_shd_mode_set(
 	}
 
 	_sde_encoder_phys_shd_setup_irq_hw_idx(phys_enc);
+
+	_sde_encoder_phys_shd_group_join(to_sde_encoder_phys_shd(phys_enc));
 }
 
 static int _sde_encoder_phys_shd_wait_for_vblank(
@@ -390,11 +523,24 @@ int sde_encoder_phys_shd_wait_for_vblank_no_notify(
 	return _sde_encoder_phys_shd_wait_for_vblank(phys_enc, false);
 }
 
-static inline
-int sde_encoder_phys_shd_prepare_for_kickoff(
+static int sde_encoder_phys_shd_prepare_for_kickoff(
 		struct sde_encoder_phys *phys_enc,
 		struct sde_encoder_kickoff_params *params)
 {
+	struct sde_encoder_phys_shd *shd_enc;
+	struct shd_flush_group *group;
+	unsigned long lock_flags;
+
+	shd_enc = to_sde_encoder_phys_shd(phys_enc);
+	group = _sde_encoder_phys_shd_group(shd_enc);
+	if (!group || !READ_ONCE(combined_flush))
+		return 0;
+
+	/* the other partitions wait for this one's flush now */
+	spin_lock_irqsave(&group->lock, lock_flags);
+	group->armed |= BIT(shd_enc->display->flush_idx);
+	spin_unlock_irqrestore(&group->lock, lock_flags);
+
 	return 0;
 }
 
@@ -414,16 +560,34 @@ void sde_encoder_phys_shd_handle_post_kickoff(
 	}
 }
 
-static inline
-void sde_encoder_phys_shd_trigger_flush(
+static void sde_encoder_phys_shd_trigger_flush(
 	struct sde_encoder_phys *phys_enc)
 {
 	struct sde_encoder_phys_shd *shd_enc;
+	struct shd_flush_group *group;
+	unsigned long lock_flags;
 
 	shd_enc = container_of(phys_enc, struct sde_encoder_phys_shd, base);
 
-	sde_shd_hw_flush(phys_enc->hw_ctl,
-			shd_enc->hw_lm, shd_enc->num_mixers);
+	group = _sde_encoder_phys_shd_group(shd_enc);
+	if (!group || !READ_ONCE(combined_flush)) {
+		sde_shd_hw_flush(phys_enc->hw_ctl,
+				shd_enc->hw_lm, shd_enc->num_mixers);
+		return;
+	}
+
+	spin_lock_irqsave(&group->lock, lock_flags);
+	group->ready |= BIT(shd_enc->display->flush_idx);
+	if (!(group->armed & ~group->ready)) {
+		/* a running timer finds nothing left to flush */
+		hrtimer_try_to_cancel(&group->timer);
+		_sde_encoder_phys_shd_group_kick(group);
+	} else if (!hrtimer_active(&group->timer)) {
+		hrtimer_start(&group->timer,
+				ns_to_ktime(SHD_FLUSH_WAIT_US * NSEC_PER_USEC),
+				HRTIMER_MODE_REL);
+	}
+	spin_unlock_irqrestore(&group->lock, lock_flags);
 }
 
 static int sde_encoder_phys_shd_control_vblank_irq(
@@ -577,6 +741,8 @@ static void sde_encoder_phys_shd_disable(struct sde_encoder_phys *phys_enc)
 next:
 	phys_enc->enable_state = SDE_ENC_DISABLED;
 
+	_sde_encoder_phys_shd_group_leave(to_sde_encoder_phys_shd(phys_enc));
+
 	_sde_encoder_phys_shd_rm_release(phys_enc, display);
 
 	SDE_EVT32(DRMID(phys_enc->parent),
@@ -1314,6 +1314,7 @@ static int sde_shd_probe(struct platform_device *pdev)
 
 	INIT_LIST_HEAD(&base->disp_list);
 	base->of_node = shd_dev->base_of;
+	shd_flush_group_init(&base->flush_group);
 
 	ret = shd_parse_base(base);
 	if (ret) {
@@ -1334,6 +1335,10 @@ static int sde_shd_probe(struct platform_device *pdev)
 next:
 	shd_dev->base = base;
 	shd_dev->drm_dev = ddev;
+	if (base->num_partitions < SHD_MAX_PARTITIONS)
+		shd_dev->flush_idx = base->num_partitions++;
+	else
+		shd_dev->flush_idx = -EINVAL;
 
 	mutex_lock(&ddev->mode_config.mutex);
 	ret = shd_drm_obj_init(shd_dev);
@@ -34,6 +34,24 @@ struct shd_stage_range {
 	u32 size;
 };
 
+#define SHD_MAX_PARTITIONS	8
+
+/**
+ * struct shd_flush_group - combined flush of the partitions of one base
+ * @lock:	protects the masks and @phys
+ * @armed:	partitions with a kickoff in progress, by flush_idx
+ * @ready:	partitions whose flush is held back for the others
+ * @phys:	phys encoder of each enabled partition
+ * @timer:	flushes the ready ones when a partition lags behind
+ */
+struct shd_flush_group {
+	spinlock_t lock;
+	u32 armed;
+	u32 ready;
+	struct sde_encoder_phys *phys[SHD_MAX_PARTITIONS];
+	struct hrtimer timer;
+};
+
 struct shd_display_base {
 	struct drm_display_mode mode;
 	struct drm_crtc       *crtc;
@@ -47,6 +65,9 @@ struct shd_display_base {
 	int intf_idx;
 	int connector_type;
 	bool mst_port;
+
+	struct shd_flush_group flush_group;
+	int num_partitions;
 };
 
 struct shd_display {
@@ -66,6 +87,9 @@ struct shd_display {
 	struct platform_device *pdev;
 	struct list_head head;
 	struct drm_crtc *crtc;
+
+	/* bit in the base flush group, -EINVAL if out of slots */
+	int flush_idx;
 };
 
 /* drm internal header */
@@ -76,6 +100,8 @@ void drm_minor_release(struct drm_minor *minor);
 void *sde_encoder_phys_shd_init(enum sde_intf_type type,
 			u32 controller_id, void *phys_init_params);
 
+void shd_flush_group_init(struct shd_flush_group *group);
+
 /* helper for seamless plane handoff */
 u32 shd_get_shared_crtc_mask(struct drm_crtc *crtc);
 void shd_skip_shared_plane_update(struct drm_plane *plane,
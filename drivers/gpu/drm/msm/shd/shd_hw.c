@@ -390,32 +390,51 @@ static void _sde_shd_flush_hw_lm(struct sde_hw_mixer *ctx)
 	}
 }
 
-void sde_shd_hw_flush(struct sde_hw_ctl *ctl_ctx,
-	struct sde_hw_mixer *lm_ctx[CRTC_DUAL_MIXERS], int lm_num)
+/*
+ * Program and trigger the flush of every request in one critical
+ * section, so partitions flushed together land in the same vsync.
+ */
+void sde_shd_hw_flush_multi(struct sde_shd_flush_req *req, int num)
 {
-	struct sde_hw_blk_reg_map *c;
 	unsigned long lock_flags;
-	int i;
-
-	c = &ctl_ctx->hw;
+	int i, j;
 
 	spin_lock_irqsave(&hw_ctl_lock, lock_flags);
 
-	SDE_REG_WRITE(c, CTL_FLUSH_MASK, CTL_MIXER_FLUSH_MASK);
+	for (i = 0; i < num; i++)
+		SDE_REG_WRITE(&req[i].ctl->hw, CTL_FLUSH_MASK,
+				CTL_MIXER_FLUSH_MASK);
 
-	_sde_shd_flush_hw_ctl(ctl_ctx);
+	for (i = 0; i < num; i++) {
+		_sde_shd_flush_hw_ctl(req[i].ctl);
 
-	for (i = 0; i < lm_num; i++)
-		_sde_shd_flush_hw_lm(lm_ctx[i]);
+		for (j = 0; j < req[i].lm_num; j++)
+			_sde_shd_flush_hw_lm(req[i].lm[j]);
+	}
 
-	if (ctl_ctx->ops.trigger_flush)
-		ctl_ctx->ops.trigger_flush(ctl_ctx);
+	for (i = 0; i < num; i++) {
+		if (req[i].ctl->ops.trigger_flush)
+			req[i].ctl->ops.trigger_flush(req[i].ctl);
+	}
 
-	SDE_REG_WRITE(c, CTL_FLUSH_MASK, 0);
+	for (i = 0; i < num; i++)
+		SDE_REG_WRITE(&req[i].ctl->hw, CTL_FLUSH_MASK, 0);
 
 	spin_unlock_irqrestore(&hw_ctl_lock, lock_flags);
 }
 
+void sde_shd_hw_flush(struct sde_hw_ctl *ctl_ctx,
+	struct sde_hw_mixer *lm_ctx[CRTC_DUAL_MIXERS], int lm_num)
+{
+	struct sde_shd_flush_req req = {
+		.ctl = ctl_ctx,
+		.lm = lm_ctx,
+		.lm_num = lm_num,
+	};
+
+	sde_shd_hw_flush_multi(&req, 1);
+}
+
 void sde_shd_hw_ctl_init_op(struct sde_hw_ctl *ctx)
 {
 	ctx->ops.clear_all_blendstages =
@@ -59,9 +59,17 @@ struct sde_shd_hw_mixer {
 	struct sde_shd_mixer_cfg cfg[SDE_STAGE_MAX];
 };
 
+struct sde_shd_flush_req {
+	struct sde_hw_ctl *ctl;
+	struct sde_hw_mixer **lm;
+	int lm_num;
+};
+
 void sde_shd_hw_flush(struct sde_hw_ctl *ctl_ctx,
 	struct sde_hw_mixer *lm_ctx[CRTC_DUAL_MIXERS], int lm_num);
 
+void sde_shd_hw_flush_multi(struct sde_shd_flush_req *req, int num);
+
 void sde_shd_hw_ctl_init_op(struct sde_hw_ctl *ctx);
 
 void sde_shd_hw_lm_init_op(struct sde_hw_mixer *ctx);
@@ -108,6 +108,7 @@ static struct adreno_device device_3d0 = {
 	.active_list_lock = __SPIN_LOCK_UNLOCKED(device_3d0.active_list_lock),
 	.gpu_llc_slice_enable = true,
 	.gpuhtw_llc_slice_enable = true,
+	.pt_tlbi_elide = true,
 	.preempt = {
 		.preempt_level = 1,
 		.skipsaverestore = 1,
@@ -2842,6 +2843,31 @@ static int adreno_setproperty(struct kgsl_device_private *dev_priv,
 			kgsl_context_put(context);
 		}
 		break;
+	case KGSL_PROP_CONTEXT_SCHED: {
+			struct kgsl_context_sched sched;
+			struct kgsl_context *context;
+
+			if (sizebytes != sizeof(sched))
+				break;
+
+			if (copy_from_user(&sched, value, sizeof(sched))) {
+				status = -EFAULT;
+				break;
+			}
+
+			context = kgsl_context_get_owner(dev_priv,
+							sched.context_id);
+
+			if (context == NULL)
+				break;
+
+			status = adreno_dispatcher_set_sched(
+					ADRENO_CONTEXT(context), sched.weight,
+					sched.deadline_us);
+
+			kgsl_context_put(context);
+		}
+		break;
 	default:
 		break;
 	}
@@ -299,7 +299,17 @@ enum adreno_preempt_states {
  * skipsaverestore: To skip saverestore during L1 preemption (for 6XX)
  * usesgmem: enable GMEM save/restore across preemption (for 6XX)
  * count: Track the number of preemptions triggered
+ * trigger_time: Time the pending preemption was triggered (for 6XX)
+ * latency: Histogram of preemption latencies per (from, to) ringbuffer pair,
+ * bucket n counts latencies under 2^n usecs (for 6XX)
+ * timeouts: Number of preemptions that timed out (for 6XX)
+ * slack_us: Hold off preempting busy ringbuffers until the waiting
+ * submission has less than this much time left to its deadline, 0 to
+ * preempt as soon as possible (for 6XX)
+ * slack_timer: Retries a preemption that was held off (for 6XX)
  */
+#define ADRENO_PREEMPT_LAT_BUCKETS 16
+
 struct adreno_preemption {
 	atomic_t state;
 	struct kgsl_memdesc scratch;
@@ -310,6 +320,12 @@ struct adreno_preemption {
 	bool skipsaverestore;
 	bool usesgmem;
 	unsigned int count;
+	ktime_t trigger_time;
+	unsigned int latency[KGSL_PRIORITY_MAX_RB_LEVELS]
+		[KGSL_PRIORITY_MAX_RB_LEVELS][ADRENO_PREEMPT_LAT_BUCKETS];
+	unsigned int timeouts;
+	unsigned int slack_us;
+	struct timer_list slack_timer;
 };
 
 
@@ -509,6 +525,10 @@ enum gpu_coresight_sources {
  * @lm_threshold_count: register value for counter for lm threshold breakin
  * @lm_threshold_cross: number of current peaks exceeding threshold
  * @ifpc_count: Number of times the GPU went into IFPC
+ * @pt_tlbi_elide: Skip the TLBIALL when switching to an ASID tagged
+ * pagetable whose entries are known valid
+ * @pt_switch_full: Pagetable switches that invalidated the TLB
+ * @pt_switch_elided: Pagetable switches that skipped the TLB invalidate
  * @speed_bin: Indicate which power level set to use
  * @csdev: Pointer to a coresight device (if applicable)
  * @gpmu_throttle_counters - counteers for number of throttled clocks
@@ -586,6 +606,9 @@ struct adreno_device {
 	uint32_t lm_threshold_count;
 	uint32_t lm_threshold_cross;
 	uint32_t ifpc_count;
+	bool pt_tlbi_elide;
+	unsigned int pt_switch_full;
+	unsigned int pt_switch_elided;
 
 	unsigned int speed_bin;
 	unsigned int quirks;
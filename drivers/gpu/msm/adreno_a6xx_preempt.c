@@ -110,6 +110,19 @@ static inline bool adreno_move_preempt_state(struct adreno_device *adreno_dev,
 	return (atomic_cmpxchg(&adreno_dev->preempt.state, old, new) == old);
 }
 
+static void _a6xx_preemption_latency(struct adreno_device *adreno_dev)
+{
+	struct adreno_preemption *preempt = &adreno_dev->preempt;
+	s64 us = ktime_us_delta(ktime_get(), preempt->trigger_time);
+	unsigned int bucket = us > 0 ? fls64(us) : 0;
+
+	if (bucket >= ADRENO_PREEMPT_LAT_BUCKETS)
+		bucket = ADRENO_PREEMPT_LAT_BUCKETS - 1;
+
+	preempt->latency[adreno_dev->cur_rb->id][adreno_dev->next_rb->id]
+		[bucket]++;
+}
+
 static void _a6xx_preemption_done(struct adreno_device *adreno_dev)
 {
 	struct kgsl_device *device = KGSL_DEVICE(adreno_dev);
@@ -142,6 +155,7 @@ static void _a6xx_preemption_done(struct adreno_device *adreno_dev)
 	}
 
 	adreno_dev->preempt.count++;
+	_a6xx_preemption_latency(adreno_dev);
 
 	del_timer_sync(&adreno_dev->preempt.timer);
 
@@ -227,10 +241,55 @@ static void _a6xx_preemption_timer(unsigned long data)
 		ADRENO_PREEMPT_TRIGGERED, ADRENO_PREEMPT_FAULTED))
 		return;
 
+	adreno_dev->preempt.timeouts++;
+
 	/* Schedule the worker to take care of the details */
 	queue_work(system_unbound_wq, &adreno_dev->preempt.work);
 }
 
+static void _a6xx_preemption_slack_timer(unsigned long data)
+{
+	struct adreno_device *adreno_dev = (struct adreno_device *) data;
+
+	adreno_dispatcher_schedule(KGSL_DEVICE(adreno_dev));
+}
+
+/*
+ * Decide whether switching to @next can wait. Preempting a busy
+ * ringbuffer costs its throughput, so with a slack set it is only done
+ * once the command waiting on @next is about to run out of time. Commands
+ * without a deadline are always switched to right away.
+ */
+static bool _a6xx_preemption_hold_off(struct adreno_device *adreno_dev,
+		struct adreno_ringbuffer *next)
+{
+	struct adreno_preemption *preempt = &adreno_dev->preempt;
+	struct adreno_ringbuffer *cur = adreno_dev->cur_rb;
+	u64 deadline = READ_ONCE(next->preempt_deadline);
+	unsigned long flags;
+	bool empty;
+	s64 slack;
+
+	if (!preempt->slack_us || !deadline)
+		return false;
+
+	spin_lock_irqsave(&cur->preempt_lock, flags);
+	empty = adreno_rb_empty(cur);
+	spin_unlock_irqrestore(&cur->preempt_lock, flags);
+
+	/* Switching away from an idle ringbuffer costs nothing */
+	if (empty)
+		return false;
+
+	slack = (s64)deadline - ktime_get_ns() -
+		(s64)preempt->slack_us * NSEC_PER_USEC;
+	if (slack <= 0)
+		return false;
+
+	mod_timer(&preempt->slack_timer, jiffies + nsecs_to_jiffies(slack));
+	return true;
+}
+
 /* Find the highest priority active ringbuffer */
 static struct adreno_ringbuffer *a6xx_next_ringbuffer(
 		struct adreno_device *adreno_dev)
@@ -280,7 +339,8 @@ void a6xx_preemption_trigger(struct adreno_device *adreno_dev)
 	 * Nothing to do if every ringbuffer is empty or if the current
 	 * ringbuffer is the only active one
 	 */
-	if (next == NULL || next == adreno_dev->cur_rb) {
+	if (next == NULL || next == adreno_dev->cur_rb ||
+			_a6xx_preemption_hold_off(adreno_dev, next)) {
 		/*
 		 * Update any critical things that might have been skipped while
 		 * we were looking for a new ringbuffer
@@ -411,6 +471,8 @@ void a6xx_preemption_trigger(struct adreno_device *adreno_dev)
 	trace_adreno_preempt_trigger(adreno_dev->cur_rb, adreno_dev->next_rb,
 		cntl);
 
+	preempt->trigger_time = ktime_get();
+
 	/* Trigger the preemption */
 	if (adreno_gmu_fenced_write(adreno_dev, ADRENO_REG_CP_PREEMPT, cntl,
 				FENCE_STATUS_WRITEDROPPED1_MASK)) {
@@ -458,6 +520,7 @@ void a6xx_preemption_callback(struct adreno_device *adreno_dev, int bit)
 	}
 
 	adreno_dev->preempt.count++;
+	_a6xx_preemption_latency(adreno_dev);
 
 	/*
 	 * We can now safely clear the preemption keepalive bit, allowing
@@ -751,6 +814,7 @@ void a6xx_preemption_close(struct adreno_device *adreno_dev)
 	if (!test_bit(ADRENO_DEVICE_PREEMPTION, &adreno_dev->priv))
 		return;
 
+	del_timer_sync(&adreno_dev->preempt.slack_timer);
 	_preemption_close(adreno_dev);
 }
 
@@ -773,6 +837,9 @@ int a6xx_preemption_init(struct adreno_device *adreno_dev)
 	setup_timer(&preempt->timer, _a6xx_preemption_timer,
 		(unsigned long) adreno_dev);
 
+	setup_timer(&preempt->slack_timer, _a6xx_preemption_slack_timer,
+		(unsigned long) adreno_dev);
+
 	/*
 	 * Allocate a scratch buffer to keep the below table:
 	 * Offset: What
@@ -300,6 +300,12 @@ static int ctx_print(struct seq_file *s, void *unused)
 		   queued, consumed, retired,
 		   drawctxt->internal_timestamp);
 
+	seq_printf(s, "sched: weight: %u vruntime: %llu deadline frames: %u misses: %u\n",
+		   drawctxt->sched_weight, drawctxt->sched_vruntime,
+		   drawctxt->deadline_frames, drawctxt->deadline_misses);
+	seq_printf(s, "gpu time: %llu us\n",
+		   div_u64(drawctxt->gpu_time_ns, NSEC_PER_USEC));
+
 	seq_puts(s, "drawqueue:\n");
 
 	spin_lock(&drawctxt->lock);
@@ -367,6 +373,42 @@ adreno_context_debugfs_init(struct adreno_device *adreno_dev,
 				(void *)(unsigned long)ctx->base.id, &ctx_fops);
 }
 
+static int preempt_latency_print(struct seq_file *s, void *unused)
+{
+	struct adreno_device *adreno_dev = s->private;
+	struct adreno_preemption *preempt = &adreno_dev->preempt;
+	unsigned int from, to, i;
+
+	seq_printf(s, "timeouts: %u\n", preempt->timeouts);
+
+	for (from = 0; from < adreno_dev->num_ringbuffers; from++) {
+		for (to = 0; to < adreno_dev->num_ringbuffers; to++) {
+			if (from == to)
+				continue;
+
+			seq_printf(s, "rb%u->rb%u:", from, to);
+			for (i = 0; i < ADRENO_PREEMPT_LAT_BUCKETS; i++)
+				seq_printf(s, " %u",
+					preempt->latency[from][to][i]);
+			seq_puts(s, "\n");
+		}
+	}
+
+	return 0;
+}
+
+static int preempt_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, preempt_latency_print, inode->i_private);
+}
+
+static const struct file_operations preempt_latency_fops = {
+	.open = preempt_latency_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 void adreno_debugfs_init(struct adreno_device *adreno_dev)
 {
 	struct kgsl_device *device = KGSL_DEVICE(adreno_dev);
@@ -389,4 +431,8 @@ void adreno_debugfs_init(struct adreno_device *adreno_dev)
 	if (adreno_is_a5xx(adreno_dev))
 		debugfs_create_file("isdb", 0644, device->d_debugfs,
 			device, &_isdb_fops);
+
+	if (adreno_is_a6xx(adreno_dev))
+		debugfs_create_file("preempt_latency", 0444,
+			device->d_debugfs, adreno_dev, &preempt_latency_fops);
 }
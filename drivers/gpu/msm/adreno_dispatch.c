@@ -62,6 +62,18 @@ unsigned int adreno_drawobj_timeout = 2000;
 /* Interval for reading and comparing fault detection registers */
 static unsigned int _fault_timer_interval = 200;
 
+/*
+ * Deadline scheduling. When enabled, contexts of the same priority are
+ * dispatched earliest deadline first, unless the context with the earliest
+ * deadline is ahead of the least served one by more than the slack (in
+ * microseconds of weighted GPU time), in which case the least served one goes.
+ */
+static unsigned int _dispatcher_sched_edf;
+static unsigned int _dispatcher_sched_slack_us = 8000;
+
+/* Write the wptr once per context burst instead of once per drawobj */
+static unsigned int _dispatcher_batch_submit = 1;
+
 #define DRAWQUEUE_RB(_drawqueue) \
 	((struct adreno_ringbuffer *) \
 		container_of((_drawqueue),\
@@ -350,6 +362,28 @@ static inline void _pop_drawobj(struct adreno_context *drawctxt)
 	drawctxt->queued--;
 }
 
+/*
+ * Publish the deadline of the next command the context will dispatch for
+ * the scheduler to look at. Must be called with drawctxt->lock held.
+ */
+static void _update_context_deadline(struct adreno_context *drawctxt)
+{
+	unsigned int i;
+	u64 deadline = 0;
+
+	for (i = drawctxt->drawqueue_head; i != drawctxt->drawqueue_tail;
+			i = DRAWQUEUE_NEXT(i, ADRENO_CONTEXT_DRAWQUEUE_SIZE)) {
+		struct kgsl_drawobj *drawobj = drawctxt->drawqueue[i];
+
+		if (drawobj && drawobj->type == CMDOBJ_TYPE) {
+			deadline = drawobj->deadline;
+			break;
+		}
+	}
+
+	WRITE_ONCE(drawctxt->sched_deadline, deadline);
+}
+
 static void _retire_sparseobj(struct kgsl_drawobj_sparse *sparseobj,
 				struct adreno_context *drawctxt)
 {
@@ -489,6 +523,7 @@ static inline int adreno_dispatcher_requeue_cmdobj(
 
 	/* Reset the command queue head to reflect the newly requeued change */
 	drawctxt->drawqueue_head = prev;
+	_update_context_deadline(drawctxt);
 	spin_unlock(&drawctxt->lock);
 	return 0;
 }
@@ -514,6 +549,11 @@ static void  dispatcher_queue_context(struct adreno_device *adreno_dev,
 	if (plist_node_empty(&drawctxt->pending)) {
 		/* Get a reference to the context while it sits on the list */
 		if (_kgsl_context_get(&drawctxt->base)) {
+			/* Don't let time spent idle turn into a credit */
+			if (drawctxt->sched_vruntime < dispatcher->min_vruntime)
+				drawctxt->sched_vruntime =
+					dispatcher->min_vruntime;
+
 			trace_dispatch_queue_context(drawctxt);
 			plist_add(&drawctxt->pending, &dispatcher->pending);
 		}
@@ -571,6 +611,7 @@ static int sendcmd(struct adreno_device *adreno_dev,
 			ADRENO_DRAWOBJ_PROFILE_COUNT;
 	}
 
+	cmdobj->submit_ns = ktime_get_ns();
 	ret = adreno_ringbuffer_submitcmd(adreno_dev, cmdobj, NULL);
 
 	/*
@@ -638,9 +679,12 @@ static int sendcmd(struct adreno_device *adreno_dev,
 	 * it here avoids the possibilty of some race conditions with preempt
 	 */
 
-	if (dispatch_q->inflight == 1)
+	if (dispatch_q->inflight == 1) {
 		dispatch_q->expires = jiffies +
 			msecs_to_jiffies(adreno_drawobj_timeout);
+		WRITE_ONCE(ADRENO_DRAWOBJ_RB(drawobj)->preempt_deadline,
+			drawobj->deadline);
+	}
 
 	mutex_unlock(&device->mutex);
 
@@ -756,6 +800,7 @@ static int dispatcher_context_sendcmds(struct adreno_device *adreno_dev,
 	int ret = 0;
 	int inflight = _drawqueue_inflight(dispatch_q);
 	unsigned int timestamp;
+	bool batch;
 
 	if (drawctxt->base.flags & KGSL_CONTEXT_SPARSE)
 		return _process_drawqueue_sparse(drawctxt);
@@ -767,6 +812,11 @@ static int dispatcher_context_sendcmds(struct adreno_device *adreno_dev,
 		return -EBUSY;
 	}
 
+	batch = _dispatcher_batch_submit && _context_drawobj_burst > 1 &&
+		drawctxt->queued > 1;
+	if (batch)
+		adreno_ringbuffer_batch_begin(drawctxt->rb);
+
 	/*
 	 * Each context can send a specific number of drawobjs per cycle
 	 */
@@ -795,6 +845,7 @@ static int dispatcher_context_sendcmds(struct adreno_device *adreno_dev,
 			break;
 		}
 		_pop_drawobj(drawctxt);
+		_update_context_deadline(drawctxt);
 		spin_unlock(&drawctxt->lock);
 
 		timestamp = drawobj->timestamp;
@@ -829,6 +880,9 @@ static int dispatcher_context_sendcmds(struct adreno_device *adreno_dev,
 		count++;
 	}
 
+	if (batch)
+		adreno_ringbuffer_batch_end(drawctxt->rb);
+
 	/*
 	 * Wake up any snoozing threads if we have consumed any real commands
 	 * or marker commands and we have room in the context queue.
@@ -844,6 +898,100 @@ static int dispatcher_context_sendcmds(struct adreno_device *adreno_dev,
 	return ret;
 }
 
+/*
+ * Pick the context to service among those sharing the highest pending
+ * priority. Must be called with the plist_lock held.
+ */
+static struct adreno_context *_dispatcher_sched_pick(
+		struct adreno_dispatcher *dispatcher)
+{
+	struct adreno_context *first, *drawctxt, *edf = NULL, *fair;
+	u64 slack = (u64)_dispatcher_sched_slack_us * NSEC_PER_USEC;
+	u64 edf_deadline = 0;
+
+	first = plist_first_entry(&dispatcher->pending,
+		struct adreno_context, pending);
+	fair = first;
+
+	plist_for_each_entry(drawctxt, &dispatcher->pending, pending) {
+		u64 deadline;
+
+		if (drawctxt->pending.prio != first->pending.prio)
+			break;
+
+		if (drawctxt->sched_vruntime < fair->sched_vruntime)
+			fair = drawctxt;
+
+		deadline = READ_ONCE(drawctxt->sched_deadline);
+		if (deadline && (!edf || deadline < edf_deadline)) {
+			edf = drawctxt;
+			edf_deadline = deadline;
+		}
+	}
+
+	if (fair->sched_vruntime > dispatcher->min_vruntime)
+		dispatcher->min_vruntime = fair->sched_vruntime;
+
+	if (edf && edf->sched_vruntime <= fair->sched_vruntime + slack)
+		return edf;
+
+	return fair;
+}
+
+/*
+ * Charge the GPU time of a retired command to its context and process and
+ * account for its deadline. Time that overlaps the previous command on the
+ * same ringbuffer was already charged to that one. If the command was
+ * profiled, the always-on counter ticks around it are used instead.
+ */
+static void _dispatcher_sched_retire(struct adreno_context *drawctxt,
+		struct adreno_dispatcher_drawqueue *drawqueue,
+		struct kgsl_drawobj_cmd *cmdobj, u64 start_ticks, u64 end_ticks)
+{
+	struct kgsl_drawobj *drawobj = DRAWOBJ(cmdobj);
+	u64 now = ktime_get_ns();
+	u64 start = max(cmdobj->submit_ns, drawqueue->retire_ns);
+	u64 busy = 0;
+
+	if (end_ticks > start_ticks)
+		busy = div_u64((end_ticks - start_ticks) * NSEC_PER_SEC,
+			KGSL_XO_CLK_FREQ);
+	else if (now > start)
+		busy = now - start;
+	drawqueue->retire_ns = now;
+
+	drawctxt->sched_vruntime += div_u64(busy * ADRENO_CONTEXT_SCHED_WEIGHT,
+		drawctxt->sched_weight);
+	drawctxt->gpu_time_ns += busy;
+	atomic64_add(busy, &drawctxt->base.proc_priv->gpu_time_ns);
+
+	if (drawobj->deadline) {
+		drawctxt->deadline_frames++;
+		if (now > drawobj->deadline)
+			drawctxt->deadline_misses++;
+	}
+}
+
+/**
+ * adreno_dispatcher_set_sched() - Set the scheduling hints of a context
+ * @drawctxt: Pointer to the adreno draw context
+ * @weight: Share of the GPU relative to contexts of the same priority
+ * @deadline_us: Default frame deadline in microseconds, 0 for none
+ */
+int adreno_dispatcher_set_sched(struct adreno_context *drawctxt,
+		unsigned int weight, unsigned int deadline_us)
+{
+	if (!weight || weight > ADRENO_CONTEXT_SCHED_WEIGHT_MAX)
+		return -EINVAL;
+
+	spin_lock(&drawctxt->lock);
+	drawctxt->sched_weight = weight;
+	drawctxt->sched_deadline_us = deadline_us;
+	spin_unlock(&drawctxt->lock);
+
+	return 0;
+}
+
 /**
  * _adreno_dispatcher_issuecmds() - Issue commmands from pending contexts
  * @adreno_dev: Pointer to the adreno device struct
@@ -883,8 +1031,11 @@ static void _adreno_dispatcher_issuecmds(struct adreno_device *adreno_dev)
 		}
 
 		/* Get the next entry on the list */
-		drawctxt = plist_first_entry(&dispatcher->pending,
-			struct adreno_context, pending);
+		if (_dispatcher_sched_edf)
+			drawctxt = _dispatcher_sched_pick(dispatcher);
+		else
+			drawctxt = plist_first_entry(&dispatcher->pending,
+				struct adreno_context, pending);
 
 		plist_del(&drawctxt->pending, &dispatcher->pending);
 
@@ -1312,7 +1463,12 @@ static int _queue_cmdobj(struct adreno_device *adreno_dev,
 	_set_ft_policy(adreno_dev, drawctxt, cmdobj);
 	_cmdobj_set_flags(drawctxt, cmdobj);
 
+	if (!drawobj->deadline && drawctxt->sched_deadline_us)
+		drawobj->deadline = ktime_get_ns() +
+			(u64)drawctxt->sched_deadline_us * NSEC_PER_USEC;
+
 	_queue_drawobj(drawctxt, drawobj);
+	_update_context_deadline(drawctxt);
 
 	return 0;
 }
@@ -2321,6 +2477,13 @@ static void retire_cmdobj(struct adreno_device *adreno_dev,
 	if (test_bit(CMDOBJ_PROFILE, &cmdobj->priv))
 		cmdobj_profile_ticks(adreno_dev, cmdobj, &start, &end);
 
+	_dispatcher_sched_retire(drawctxt,
+		ADRENO_DRAWOBJ_DISPATCH_DRAWQUEUE(drawobj), cmdobj, start, end);
+
+	if (drawobj->flags & KGSL_DRAWOBJ_END_OF_FRAME)
+		kgsl_pwrscale_frame_end(KGSL_DEVICE(adreno_dev),
+			drawobj->deadline);
+
 	/*
 	 * For A3xx we still get the rptr from the CP_RB_RPTR instead of
 	 * rptr scratch out address. At this point GPU clocks turned off.
@@ -2693,6 +2856,14 @@ struct dispatcher_attribute {
 		.value = &(_value), \
 	}
 
+#define DISPATCHER_BOOL_ATTR(_name, _mode, _value) \
+	struct dispatcher_attribute dispatcher_attr_##_name =  { \
+		.attr = { .name = __stringify(_name), .mode = _mode }, \
+		.show = _show_uint, \
+		.store = _store_bool, \
+		.value = &(_value), \
+	}
+
 #define to_dispatcher_attr(_a) \
 	container_of((_a), struct dispatcher_attribute, attr)
 #define to_dispatcher(k) container_of(k, struct adreno_dispatcher, kobj)
@@ -2715,6 +2886,21 @@ static ssize_t _store_uint(struct adreno_dispatcher *dispatcher,
 	return size;
 }
 
+static ssize_t _store_bool(struct adreno_dispatcher *dispatcher,
+		struct dispatcher_attribute *attr,
+		const char *buf, size_t size)
+{
+	bool val;
+	int ret;
+
+	ret = kstrtobool(buf, &val);
+	if (ret)
+		return ret;
+
+	*((unsigned int *) attr->value) = val;
+	return size;
+}
+
 static ssize_t _show_uint(struct adreno_dispatcher *dispatcher,
 		struct dispatcher_attribute *attr,
 		char *buf)
@@ -2747,6 +2933,10 @@ static DISPATCHER_UINT_ATTR(fault_throttle_time, 0644, 0,
 	_fault_throttle_time);
 static DISPATCHER_UINT_ATTR(fault_throttle_burst, 0644, 0,
 	_fault_throttle_burst);
+static DISPATCHER_BOOL_ATTR(sched_edf, 0644, _dispatcher_sched_edf);
+static DISPATCHER_BOOL_ATTR(batch_submit, 0644, _dispatcher_batch_submit);
+static DISPATCHER_UINT_ATTR(sched_slack_us, 0644, 0,
+	_dispatcher_sched_slack_us);
 
 static struct attribute *dispatcher_attrs[] = {
 	&dispatcher_attr_inflight.attr,
@@ -2758,6 +2948,9 @@ static struct attribute *dispatcher_attrs[] = {
 	&dispatcher_attr_fault_detect_interval.attr,
 	&dispatcher_attr_fault_throttle_time.attr,
 	&dispatcher_attr_fault_throttle_burst.attr,
+	&dispatcher_attr_sched_edf.attr,
+	&dispatcher_attr_sched_slack_us.attr,
+	&dispatcher_attr_batch_submit.attr,
 	NULL,
 };
 
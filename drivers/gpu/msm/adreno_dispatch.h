@@ -34,6 +34,7 @@ extern unsigned int adreno_drawobj_timeout;
  * @tail: Queues tail pointer
  * @active_context_count: Number of active contexts seen in this rb drawqueue
  * @expires: The jiffies value at which this drawqueue has run too long
+ * @retire_ns: Time (ktime ns) the last command on this q retired
  */
 struct adreno_dispatcher_drawqueue {
 	struct kgsl_drawobj_cmd *cmd_q[ADRENO_DISPATCH_DRAWQUEUE_SIZE];
@@ -42,6 +43,7 @@ struct adreno_dispatcher_drawqueue {
 	unsigned int tail;
 	int active_context_count;
 	unsigned long expires;
+	u64 retire_ns;
 };
 
 /**
@@ -56,6 +58,7 @@ struct adreno_dispatcher_drawqueue {
  * @work: work_struct to put the dispatcher in a work queue
  * @kobj: kobject for the dispatcher directory in the device sysfs node
  * @idle_gate: Gate to wait on for dispatcher to idle
+ * @min_vruntime: Floor of the context vruntimes, for contexts that went idle
  */
 struct adreno_dispatcher {
 	struct mutex mutex;
@@ -69,6 +72,7 @@ struct adreno_dispatcher {
 	struct kthread_work work;
 	struct kobject kobj;
 	struct completion idle_gate;
+	u64 min_vruntime;
 };
 
 enum adreno_dispatcher_flags {
@@ -86,6 +90,9 @@ void adreno_dispatcher_irq_fault(struct adreno_device *adreno_dev);
 void adreno_dispatcher_stop(struct adreno_device *adreno_dev);
 void adreno_dispatcher_stop_fault_timer(struct kgsl_device *device);
 
+int adreno_dispatcher_set_sched(struct adreno_context *drawctxt,
+		unsigned int weight, unsigned int deadline_us);
+
 int adreno_dispatcher_queue_cmds(struct kgsl_device_private *dev_priv,
 		struct kgsl_context *context, struct kgsl_drawobj *drawobj[],
 		uint32_t count, uint32_t *timestamp);
@@ -382,6 +382,7 @@ adreno_drawctxt_create(struct kgsl_device_private *dev_priv,
 
 	/* Set the context priority */
 	_set_context_priority(drawctxt);
+	drawctxt->sched_weight = ADRENO_CONTEXT_SCHED_WEIGHT;
 	/* set the context ringbuffer */
 	drawctxt->rb = adreno_ctx_get_rb(adreno_dev, drawctxt);
 
@@ -48,6 +48,13 @@ struct kgsl_context;
  * @submitted_timestamp: The last timestamp that was submitted for this context
  * @active_node: Linkage for nodes in active_list
  * @active_time: Time when this context last seen
+ * @sched_weight: Share of the GPU relative to same priority contexts
+ * @sched_deadline_us: Default frame deadline for commands without a hint
+ * @sched_vruntime: Weighted GPU time consumed, for fair dispatch
+ * @sched_deadline: Deadline of the next command to dispatch, 0 if none
+ * @deadline_frames: Number of retired commands that carried a deadline
+ * @deadline_misses: Number of those that retired after their deadline
+ * @gpu_time_ns: GPU time consumed by the commands of this context
  */
 struct adreno_context {
 	struct kgsl_context base;
@@ -75,8 +82,20 @@ struct adreno_context {
 
 	struct list_head active_node;
 	unsigned long active_time;
+
+	unsigned int sched_weight;
+	unsigned int sched_deadline_us;
+	u64 sched_vruntime;
+	u64 sched_deadline;
+	unsigned int deadline_frames;
+	unsigned int deadline_misses;
+	u64 gpu_time_ns;
 };
 
+/* Default and maximum scheduling weight for a context */
+#define ADRENO_CONTEXT_SCHED_WEIGHT	1024
+#define ADRENO_CONTEXT_SCHED_WEIGHT_MAX	(ADRENO_CONTEXT_SCHED_WEIGHT * 64)
+
 /* Flag definitions for flag field in adreno_context */
 
 /**
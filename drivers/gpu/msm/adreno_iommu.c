@@ -432,7 +432,8 @@ static unsigned int _adreno_iommu_pt_update_pid_to_mem(
 
 static unsigned int _adreno_iommu_set_pt_v1(struct adreno_ringbuffer *rb,
 					unsigned int *cmds_orig,
-					u64 ttbr0, u32 contextidr, u32 ptname)
+					u64 ttbr0, u32 contextidr, u32 ptname,
+					bool tlbi)
 {
 	struct adreno_device *adreno_dev = ADRENO_RB_DEVICE(rb);
 	unsigned int *cmds = cmds_orig;
@@ -467,7 +468,8 @@ static unsigned int _adreno_iommu_set_pt_v1(struct adreno_ringbuffer *rb,
 	if (adreno_is_a3xx(adreno_dev))
 		cmds += _iommu_unlock(adreno_dev, cmds);
 
-	cmds += _tlbiall(adreno_dev, cmds);
+	if (tlbi)
+		cmds += _tlbiall(adreno_dev, cmds);
 
 	/* unlock or wait for me to finish the TLBI */
 	if (!adreno_is_a3xx(adreno_dev))
@@ -486,7 +488,7 @@ static unsigned int _adreno_iommu_set_pt_v1(struct adreno_ringbuffer *rb,
 
 static unsigned int _adreno_iommu_set_pt_v2_a3xx(struct kgsl_device *device,
 					unsigned int *cmds_orig,
-					u64 ttbr0, u32 contextidr)
+					u64 ttbr0, u32 contextidr, bool tlbi)
 {
 	struct adreno_device *adreno_dev = ADRENO_DEVICE(device);
 	unsigned int *cmds = cmds_orig;
@@ -503,7 +505,8 @@ static unsigned int _adreno_iommu_set_pt_v2_a3xx(struct kgsl_device *device,
 
 	cmds += _vbif_unlock(adreno_dev, cmds);
 
-	cmds += _tlbiall(adreno_dev, cmds);
+	if (tlbi)
+		cmds += _tlbiall(adreno_dev, cmds);
 
 	/* wait for me to finish the TLBI */
 	cmds += cp_wait_for_me(adreno_dev, cmds);
@@ -515,7 +518,7 @@ static unsigned int _adreno_iommu_set_pt_v2_a3xx(struct kgsl_device *device,
 
 static unsigned int _adreno_iommu_set_pt_v2_a4xx(struct kgsl_device *device,
 					unsigned int *cmds_orig,
-					u64 ttbr0, u32 contextidr)
+					u64 ttbr0, u32 contextidr, bool tlbi)
 {
 	struct adreno_device *adreno_dev = ADRENO_DEVICE(device);
 	unsigned int *cmds = cmds_orig;
@@ -532,7 +535,8 @@ static unsigned int _adreno_iommu_set_pt_v2_a4xx(struct kgsl_device *device,
 
 	cmds += _vbif_unlock(adreno_dev, cmds);
 
-	cmds += _tlbiall(adreno_dev, cmds);
+	if (tlbi)
+		cmds += _tlbiall(adreno_dev, cmds);
 
 	/* wait for me to finish the TLBI */
 	cmds += cp_wait_for_me(adreno_dev, cmds);
@@ -608,6 +612,30 @@ static unsigned int _adreno_iommu_set_pt_v2_a6xx(struct kgsl_device *device,
 	return cmds - cmds_orig;
 }
 
+/*
+ * _adreno_iommu_need_tlbi() - Check if switching to @pt must flush the TLB
+ *
+ * With an ASID in TTBR0 the TLB only hits on entries of the incoming
+ * pagetable, and unmaps already invalidate by ASID. So once a pagetable
+ * has been switched to with a full TLBIALL, later switches to it can skip
+ * the invalidate. Targets that need a TLB flush on map, or that don't tag
+ * the TLB, always invalidate.
+ */
+static bool _adreno_iommu_need_tlbi(struct adreno_device *adreno_dev,
+		struct kgsl_pagetable *pt, u64 ttbr0)
+{
+	struct kgsl_device *device = KGSL_DEVICE(adreno_dev);
+	bool tagged = pt->tlb_tagged;
+
+	if (!adreno_dev->pt_tlbi_elide || !KGSL_IOMMU_TTBR0_ASID(ttbr0) ||
+		MMU_FEATURE(&device->mmu, KGSL_MMU_FLUSH_TLB_ON_MAP))
+		tagged = false;
+
+	pt->tlb_tagged = true;
+
+	return !tagged;
+}
+
 /**
  * adreno_iommu_set_pt_generate_cmds() - Generate commands to change pagetable
  * @rb: The RB pointer in which these commaands are to be submitted
@@ -626,10 +654,21 @@ unsigned int adreno_iommu_set_pt_generate_cmds(
 	u64 ttbr0;
 	u32 contextidr;
 	unsigned int *cmds_orig = cmds;
+	bool tlbi = true;
 
 	ttbr0 = kgsl_mmu_pagetable_get_ttbr0(pt);
 	contextidr = kgsl_mmu_pagetable_get_contextidr(pt);
 
+	/* CP_SMMU_TABLE_UPDATE always flushes, only the older paths can skip */
+	if (iommu->version < 2 || adreno_is_a3xx(adreno_dev) ||
+		adreno_is_a4xx(adreno_dev))
+		tlbi = _adreno_iommu_need_tlbi(adreno_dev, pt, ttbr0);
+
+	if (tlbi)
+		adreno_dev->pt_switch_full++;
+	else
+		adreno_dev->pt_switch_elided++;
+
 	cmds += adreno_iommu_set_apriv(adreno_dev, cmds, 1);
 
 	cmds += _adreno_iommu_add_idle_indirect_cmds(adreno_dev, cmds,
@@ -645,16 +684,16 @@ unsigned int adreno_iommu_set_pt_generate_cmds(
 						ttbr0, contextidr, rb);
 		else if (adreno_is_a4xx(adreno_dev))
 			cmds += _adreno_iommu_set_pt_v2_a4xx(device, cmds,
-						ttbr0, contextidr);
+						ttbr0, contextidr, tlbi);
 		else if (adreno_is_a3xx(adreno_dev))
 			cmds += _adreno_iommu_set_pt_v2_a3xx(device, cmds,
-						ttbr0, contextidr);
+						ttbr0, contextidr, tlbi);
 		else
 			WARN_ONCE(1,
 			"GPU IOMMU set pagetable sequence not defined\n");
 	} else {
 		cmds += _adreno_iommu_set_pt_v1(rb, cmds, ttbr0, contextidr,
-						pt->name);
+						pt->name, tlbi);
 	}
 
 	/* invalidate all base pointers */
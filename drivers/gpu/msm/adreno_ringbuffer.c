@@ -206,6 +206,10 @@ void adreno_ringbuffer_submit(struct adreno_ringbuffer *rb,
 		adreno_profile_submit_time(time);
 	}
 
+	/* The batch owner writes the wptr once for the whole batch */
+	if (READ_ONCE(rb->batch_owner) == current)
+		return;
+
 	adreno_ringbuffer_wptr(adreno_dev, rb);
 }
 
@@ -215,9 +219,47 @@ int adreno_ringbuffer_submit_spin_nosync(struct adreno_ringbuffer *rb,
 	struct adreno_device *adreno_dev = ADRENO_RB_DEVICE(rb);
 
 	adreno_ringbuffer_submit(rb, time);
+
+	/* Can't wait for commands the hardware hasn't been told about */
+	if (READ_ONCE(rb->batch_owner) == current)
+		adreno_ringbuffer_wptr(adreno_dev, rb);
+
 	return adreno_spin_idle(adreno_dev, timeout);
 }
 
+/**
+ * adreno_ringbuffer_batch_begin() - Start batching submissions
+ * @rb: Pointer to the ringbuffer
+ *
+ * Until adreno_ringbuffer_batch_end() is called, commands that the current
+ * task adds to @rb are written to the ringbuffer as usual, with their own
+ * timestamps and profiling, but the wptr is only written to the hardware
+ * once at the end. Submissions from other tasks are not held back and
+ * flush the batched commands along with their own.
+ */
+void adreno_ringbuffer_batch_begin(struct adreno_ringbuffer *rb)
+{
+	WRITE_ONCE(rb->batch_owner, current);
+}
+
+/**
+ * adreno_ringbuffer_batch_end() - Stop batching and submit the batch
+ * @rb: Pointer to the ringbuffer
+ *
+ * Must be called without the device mutex held.
+ */
+void adreno_ringbuffer_batch_end(struct adreno_ringbuffer *rb)
+{
+	struct adreno_device *adreno_dev = ADRENO_RB_DEVICE(rb);
+	struct kgsl_device *device = KGSL_DEVICE(adreno_dev);
+
+	mutex_lock(&device->mutex);
+	WRITE_ONCE(rb->batch_owner, NULL);
+	if (rb->wptr != rb->_wptr)
+		adreno_ringbuffer_wptr(adreno_dev, rb);
+	mutex_unlock(&device->mutex);
+}
+
 /*
  * adreno_ringbuffer_submit_spin() - Submit the cmds and wait until GPU is idle
  * @rb: Pointer to ringbuffer
@@ -1241,6 +1283,7 @@ int adreno_ringbuffer_submitcmd(struct adreno_device *adreno_dev,
 	if (!ret) {
 		set_bit(KGSL_CONTEXT_PRIV_SUBMITTED, &context->priv);
 		cmdobj->global_ts = drawctxt->internal_timestamp;
+		kgsl_pwrscale_frame_start(device);
 	}
 
 done:
@@ -110,6 +110,10 @@ struct adreno_ringbuffer_pagetable_info {
  * @preempt_lock: Lock to protect the wptr pointer while it is being updated
  * @skip_inline_wptr: Used during preemption to make sure wptr is updated in
  * hardware
+ * @batch_owner: Task batching submissions, whose commands are not made
+ * visible to the hardware until it ends the batch
+ * @preempt_deadline: Deadline (ktime ns) of the command that made this
+ * ringbuffer busy, 0 if it has none
  */
 struct adreno_ringbuffer {
 	uint32_t flags;
@@ -133,6 +137,8 @@ struct adreno_ringbuffer {
 	int preempted_midway;
 	spinlock_t preempt_lock;
 	bool skip_inline_wptr;
+	struct task_struct *batch_owner;
+	u64 preempt_deadline;
 	/**
 	 * @profile_desc: global memory to construct IB1s to do user side
 	 * profiling
@@ -181,6 +187,10 @@ void adreno_ringbuffer_submit(struct adreno_ringbuffer *rb,
 int adreno_ringbuffer_submit_spin_nosync(struct adreno_ringbuffer *rb,
 		struct adreno_submit_time *time, unsigned int timeout);
 
+void adreno_ringbuffer_batch_begin(struct adreno_ringbuffer *rb);
+
+void adreno_ringbuffer_batch_end(struct adreno_ringbuffer *rb);
+
 int adreno_ringbuffer_submit_spin(struct adreno_ringbuffer *rb,
 		struct adreno_submit_time *time, unsigned int timeout);
 
@@ -314,6 +314,28 @@ static unsigned int _ifpc_count_show(struct adreno_device *adreno_dev)
 	return adreno_dev->ifpc_count;
 }
 
+static int _pt_tlbi_elide_store(struct adreno_device *adreno_dev,
+		unsigned int val)
+{
+	adreno_dev->pt_tlbi_elide = val ? true : false;
+	return 0;
+}
+
+static unsigned int _pt_tlbi_elide_show(struct adreno_device *adreno_dev)
+{
+	return adreno_dev->pt_tlbi_elide;
+}
+
+static unsigned int _pt_switch_full_show(struct adreno_device *adreno_dev)
+{
+	return adreno_dev->pt_switch_full;
+}
+
+static unsigned int _pt_switch_elided_show(struct adreno_device *adreno_dev)
+{
+	return adreno_dev->pt_switch_elided;
+}
+
 static unsigned int _preempt_count_show(struct adreno_device *adreno_dev)
 {
 	struct adreno_preemption *preempt = &adreno_dev->preempt;
@@ -321,6 +343,23 @@ static unsigned int _preempt_count_show(struct adreno_device *adreno_dev)
 	return preempt->count;
 }
 
+static unsigned int _preempt_timeouts_show(struct adreno_device *adreno_dev)
+{
+	return adreno_dev->preempt.timeouts;
+}
+
+static int _preempt_slack_us_store(struct adreno_device *adreno_dev,
+		unsigned int val)
+{
+	adreno_dev->preempt.slack_us = val;
+	return 0;
+}
+
+static unsigned int _preempt_slack_us_show(struct adreno_device *adreno_dev)
+{
+	return adreno_dev->preempt.slack_us;
+}
+
 static unsigned int acd_data_index;
 static DEFINE_SPINLOCK(acd_data_index_lock);
 
@@ -615,6 +654,8 @@ static ADRENO_SYSFS_U32(ft_policy);
 static ADRENO_SYSFS_U32(ft_pagefault_policy);
 static ADRENO_SYSFS_U32(preempt_level);
 static ADRENO_SYSFS_RO_U32(preempt_count);
+static ADRENO_SYSFS_RO_U32(preempt_timeouts);
+static ADRENO_SYSFS_U32(preempt_slack_us);
 static ADRENO_SYSFS_BOOL(usesgmem);
 static ADRENO_SYSFS_BOOL(skipsaverestore);
 static ADRENO_SYSFS_BOOL(ft_long_ib_detect);
@@ -631,6 +672,9 @@ static ADRENO_SYSFS_BOOL(hwcg);
 static ADRENO_SYSFS_BOOL(throttling);
 static ADRENO_SYSFS_BOOL(ifpc);
 static ADRENO_SYSFS_RO_U32(ifpc_count);
+static ADRENO_SYSFS_BOOL(pt_tlbi_elide);
+static ADRENO_SYSFS_RO_U32(pt_switch_full);
+static ADRENO_SYSFS_RO_U32(pt_switch_elided);
 static ADRENO_SYSFS_BOOL(acd);
 
 static ADRENO_SYSFS_U32(acd_data_index);
@@ -658,7 +702,12 @@ static const struct device_attribute *_attr_list[] = {
 	&adreno_attr_skipsaverestore.attr,
 	&adreno_attr_ifpc.attr,
 	&adreno_attr_ifpc_count.attr,
+	&adreno_attr_pt_tlbi_elide.attr,
+	&adreno_attr_pt_switch_full.attr,
+	&adreno_attr_pt_switch_elided.attr,
 	&adreno_attr_preempt_count.attr,
+	&adreno_attr_preempt_timeouts.attr,
+	&adreno_attr_preempt_slack_us.attr,
 	&adreno_attr_acd.attr,
 	&adreno_attr_acd_data_index.attr,
 	&adreno_attr_acd_version.attr,
@@ -46,6 +46,7 @@
 #include "kgsl_sync.h"
 #include "kgsl_compat.h"
 #include "kgsl_pool.h"
+#include "kgsl_reclaim.h"
 
 #undef MODULE_PARAM_PREFIX
 #define MODULE_PARAM_PREFIX "kgsl."
@@ -357,30 +358,9 @@ static void kgsl_destroy_ion(struct kgsl_dma_buf_meta *meta)
 }
 #endif
 
-void
-kgsl_mem_entry_destroy(struct kref *kref)
+static void kgsl_mem_entry_free(struct kgsl_mem_entry *entry)
 {
-	struct kgsl_mem_entry *entry = container_of(kref,
-						    struct kgsl_mem_entry,
-						    refcount);
-	unsigned int memtype;
-
-	if (entry == NULL)
-		return;
-
-	/* pull out the memtype before the flags get cleared */
-	memtype = kgsl_memdesc_usermem_type(&entry->memdesc);
-
-	if (!(entry->memdesc.flags & KGSL_MEMFLAGS_SPARSE_VIRT))
-		kgsl_process_sub_stats(entry->priv, memtype,
-			entry->memdesc.size);
-
-	/* Detach from process list */
-	kgsl_mem_entry_detach_process(entry);
-
-	if (memtype != KGSL_MEM_ENTRY_KERNEL)
-		atomic_long_sub(entry->memdesc.size,
-			&kgsl_driver.stats.mapped);
+	unsigned int memtype = kgsl_memdesc_usermem_type(&entry->memdesc);
 
 	/*
 	 * Ion takes care of freeing the sg_table for us so
@@ -419,6 +399,49 @@ kgsl_mem_entry_destroy(struct kref *kref)
 
 	kfree(entry);
 }
+
+void
+kgsl_mem_entry_destroy(struct kref *kref)
+{
+	struct kgsl_mem_entry *entry = container_of(kref,
+						    struct kgsl_mem_entry,
+						    refcount);
+	struct kgsl_process_private *private;
+	unsigned int memtype;
+	bool batched;
+
+	if (entry == NULL)
+		return;
+
+	/* pull out the memtype before the flags get cleared */
+	memtype = kgsl_memdesc_usermem_type(&entry->memdesc);
+
+	if (!(entry->memdesc.flags & KGSL_MEMFLAGS_SPARSE_VIRT))
+		kgsl_process_sub_stats(entry->priv, memtype,
+			entry->memdesc.size);
+
+	/*
+	 * The teardown of a process holds its own reference, so private
+	 * stays valid after the detach when the entry goes into the batch
+	 */
+	private = entry->priv;
+	batched = private && private->unmap_batch_owner == current;
+
+	/* Detach from process list */
+	kgsl_mem_entry_detach_process(entry);
+
+	if (memtype != KGSL_MEM_ENTRY_KERNEL)
+		atomic_long_sub(entry->memdesc.size,
+			&kgsl_driver.stats.mapped);
+
+	/* The pages may still be in the TLB until the batch is flushed */
+	if (batched) {
+		list_add_tail(&entry->batch_node, &private->unmap_batch);
+		return;
+	}
+
+	kgsl_mem_entry_free(entry);
+}
 EXPORT_SYMBOL(kgsl_mem_entry_destroy);
 
 /* Allocate a IOVA for memory objects that don't use SVM */
@@ -1048,6 +1071,8 @@ static struct kgsl_process_private *kgsl_process_private_new(
 	spin_lock_init(&private->mem_lock);
 	spin_lock_init(&private->syncsource_lock);
 	spin_lock_init(&private->ctxt_count_lock);
+	INIT_LIST_HEAD(&private->unmap_batch);
+	init_rwsem(&private->reclaim_sem);
 
 	idr_init(&private->mem_idr);
 	idr_init(&private->syncsource_idr);
@@ -1069,10 +1094,37 @@ static struct kgsl_process_private *kgsl_process_private_new(
 	return private;
 }
 
+/* Entries freed under one TLB invalidate when a process exits */
+#define KGSL_UNMAP_BATCH_MAX 256
+
+static void process_unmap_batch(struct kgsl_process_private *private,
+		bool start)
+{
+	struct kgsl_mem_entry *entry, *tmp;
+
+	if (start) {
+		kgsl_mmu_unmap_batch(private->pagetable, true);
+		private->unmap_batch_owner = current;
+		return;
+	}
+
+	private->unmap_batch_owner = NULL;
+	kgsl_mmu_unmap_batch(private->pagetable, false);
+
+	/* The TLB is clean now, the pages can go */
+	list_for_each_entry_safe(entry, tmp, &private->unmap_batch,
+			batch_node) {
+		list_del(&entry->batch_node);
+		kgsl_mem_entry_free(entry);
+	}
+}
+
 static void process_release_memory(struct kgsl_process_private *private)
 {
 	struct kgsl_mem_entry *entry;
-	int next = 0;
+	int next = 0, count = 0;
+
+	process_unmap_batch(private, true);
 
 	while (1) {
 		spin_lock(&private->mem_lock);
@@ -1095,7 +1147,17 @@ static void process_release_memory(struct kgsl_process_private *private)
 			spin_unlock(&private->mem_lock);
 		}
 		next = next + 1;
+
+		/* Don't hold other unmaps of the pagetable off for too long */
+		if (++count == KGSL_UNMAP_BATCH_MAX) {
+			process_unmap_batch(private, false);
+			cond_resched();
+			process_unmap_batch(private, true);
+			count = 0;
+		}
 	}
+
+	process_unmap_batch(private, false);
 }
 
 static void kgsl_process_private_close(struct kgsl_device_private *dev_priv,
@@ -1711,6 +1773,28 @@ static inline bool _check_context_is_sparse(struct kgsl_context *context,
 	return false;
 }
 
+/*
+ * Queue commands for the context, bringing back whatever was reclaimed
+ * from the process while it was in the background first
+ */
+static int kgsl_queue_cmds(struct kgsl_device_private *dev_priv,
+		struct kgsl_context *context, struct kgsl_drawobj *drawobj[],
+		uint32_t count, uint32_t *timestamp)
+{
+	struct kgsl_process_private *private = dev_priv->process_priv;
+	int ret;
+
+	ret = kgsl_reclaim_start(private);
+	if (ret)
+		return ret;
+
+	ret = dev_priv->device->ftbl->queue_cmds(dev_priv, context, drawobj,
+			count, timestamp);
+
+	kgsl_reclaim_end(private);
+
+	return ret;
+}
 
 long kgsl_ioctl_rb_issueibcmds(struct kgsl_device_private *dev_priv,
 				      unsigned int cmd, void *data)
@@ -1766,8 +1850,8 @@ long kgsl_ioctl_rb_issueibcmds(struct kgsl_device_private *dev_priv,
 	}
 
 	if (result == 0)
-		result = dev_priv->device->ftbl->queue_cmds(dev_priv, context,
-				&drawobj, 1, &param->timestamp);
+		result = kgsl_queue_cmds(dev_priv, context, &drawobj, 1,
+				&param->timestamp);
 
 	/*
 	 * -EPROTO is a "success" error - it just tells the user that the
@@ -1879,7 +1963,7 @@ long kgsl_ioctl_submit_commands(struct kgsl_device_private *dev_priv,
 				~(unsigned long)KGSL_DRAWOBJ_PROFILING;
 	}
 
-	result = device->ftbl->queue_cmds(dev_priv, context, drawobj,
+	result = kgsl_queue_cmds(dev_priv, context, drawobj,
 			i, &param->timestamp);
 
 done:
@@ -1969,7 +2053,7 @@ long kgsl_ioctl_gpu_command(struct kgsl_device_private *dev_priv,
 				~(unsigned long)KGSL_DRAWOBJ_PROFILING;
 	}
 
-	result = device->ftbl->queue_cmds(dev_priv, context, drawobj,
+	result = kgsl_queue_cmds(dev_priv, context, drawobj,
 				i, &param->timestamp);
 
 done:
@@ -4204,8 +4288,8 @@ long kgsl_ioctl_gpu_sparse_command(struct kgsl_device_private *dev_priv,
 			goto done;
 	}
 
-	result = dev_priv->device->ftbl->queue_cmds(dev_priv, context,
-					drawobj, i, &param->timestamp);
+	result = kgsl_queue_cmds(dev_priv, context, drawobj, i,
+					&param->timestamp);
 
 done:
 	/*
@@ -4763,14 +4847,21 @@ static int kgsl_mmap(struct file *file, struct vm_area_struct *vma)
 	if (vma_offset == (unsigned long) device->memstore.gpuaddr)
 		return kgsl_mmap_memstore(device, vma);
 
+	/* The pages must be back before they can be mapped */
+	ret = kgsl_reclaim_start(private);
+	if (ret)
+		return ret;
+
 	/*
 	 * The reference count on the entry that we get from
 	 * get_mmap_entry() will be held until kgsl_gpumem_vm_close().
 	 */
 	ret = get_mmap_entry(private, &entry, vma->vm_pgoff,
 				vma->vm_end - vma->vm_start);
-	if (ret)
+	if (ret) {
+		kgsl_reclaim_end(private);
 		return ret;
+	}
 
 	vma->vm_flags |= entry->memdesc.ops->vmflags;
 
@@ -4821,6 +4912,8 @@ static int kgsl_mmap(struct file *file, struct vm_area_struct *vma)
 		atomic64_add(entry->memdesc.size,
 				&entry->priv->gpumem_mapped);
 
+	kgsl_reclaim_end(private);
+
 	trace_kgsl_mem_mmap(entry, vma->vm_start);
 	return 0;
 }
@@ -5136,6 +5229,7 @@ static void kgsl_core_exit(void)
 	 * see if it is not NULL (and thus, has been populated).
 	 */
 	if (kgsl_driver.virtdev.class) {
+		kgsl_reclaim_close();
 		kgsl_sharedmem_uninit_sysfs();
 		device_unregister(&kgsl_driver.virtdev);
 	}
@@ -5214,6 +5308,8 @@ static int __init kgsl_core_init(void)
 
 	kgsl_sharedmem_init_sysfs();
 
+	kgsl_reclaim_init();
+
 	INIT_LIST_HEAD(&kgsl_driver.process_list);
 
 	INIT_LIST_HEAD(&kgsl_driver.pagetable_list);
@@ -151,6 +151,8 @@ struct kgsl_driver {
 		atomic_long_t mapped_max;
 		atomic_long_t page_free_pending;
 		atomic_long_t page_alloc_pending;
+		atomic_long_t large_page_alloc;
+		atomic_long_t large_page_fallback;
 	} stats;
 	unsigned int full_cache_threshold;
 	struct workqueue_struct *workqueue;
@@ -194,6 +196,8 @@ struct kgsl_memdesc_ops {
 #define KGSL_MEMDESC_UCODE BIT(9)
 /* For global buffers, randomly assign an address from the region */
 #define KGSL_MEMDESC_RANDOM BIT(10)
+/* The pages were copied to shmem_filp and handed back, see kgsl_reclaim.c */
+#define KGSL_MEMDESC_RECLAIMED BIT(11)
 
 /**
  * struct kgsl_memdesc - GPU memory object descriptor
@@ -213,6 +217,7 @@ struct kgsl_memdesc_ops {
  * @pages: An array of pointers to allocated pages
  * @page_count: Total number of pages allocated
  * @cur_bindings: Number of sparse pages actively bound
+ * @shmem_filp: Holds the contents while the pages are reclaimed
  */
 struct kgsl_memdesc {
 	struct kgsl_pagetable *pagetable;
@@ -231,6 +236,7 @@ struct kgsl_memdesc {
 	struct page **pages;
 	unsigned int page_count;
 	unsigned int cur_bindings;
+	struct file *shmem_filp;
 	/*
 	 * @lock: Spinlock to protect the gpuaddr from being accessed by
 	 * multiple entities trying to map the same SVM region at once
@@ -289,6 +295,8 @@ struct kgsl_mem_entry {
 	 * debugfs accounting
 	 */
 	atomic_t map_count;
+	/** @batch_node: Node in the process unmap_batch list */
+	struct list_head batch_node;
 };
 
 struct kgsl_device_private;
@@ -309,6 +317,8 @@ typedef void (*kgsl_event_func)(struct kgsl_device *, struct kgsl_event_group *,
  * @work: Work struct for dispatching the callback
  * @result: KGSL event result type to pass to the callback
  * group: The event group this event belongs to
+ * @fast: Callback doesn't sleep and is run directly when the event retires
+ * @signaled: Time the event was signaled, for the latency trace
  */
 struct kgsl_event {
 	struct kgsl_device *device;
@@ -321,6 +331,8 @@ struct kgsl_event {
 	struct work_struct work;
 	int result;
 	struct kgsl_event_group *group;
+	bool fast;
+	ktime_t signaled;
 };
 
 typedef int (*readtimestamp_func)(struct kgsl_device *, void *,
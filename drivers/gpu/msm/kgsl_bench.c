@@ -0,0 +1,600 @@
+/* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * Latency benchmark of the GPU memory paths, driven from debugfs:
+ *
+ *   echo ion > /sys/kernel/debug/kgsl/bench/target
+ *   echo 1048576 > /sys/kernel/debug/kgsl/bench/size
+ *   echo 1 > /sys/kernel/debug/kgsl/bench/run
+ *   cat /sys/kernel/debug/kgsl/bench/result
+ *
+ * Each of the "threads" kernel threads allocates, maps and frees
+ * "iterations" buffers and every step is timed on its own. The result
+ * lists the percentiles of each step and the throughput of the run.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/dma-buf.h>
+#include <linux/ion_kernel.h>
+#include <linux/kthread.h>
+#include <linux/msm_ion.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+
+#include "kgsl_device.h"
+#include "kgsl_debugfs.h"
+#include "kgsl_pool.h"
+#include "kgsl_sharedmem.h"
+
+#define BENCH_MAX_THREADS	16
+#define BENCH_MAX_SAMPLES	65536
+#define BENCH_MAX_SIZE		SZ_256M
+
+enum bench_target {
+	BENCH_KGSL,
+	BENCH_POOL,
+	BENCH_ION,
+	BENCH_TARGET_MAX,
+};
+
+static const char * const bench_target_names[] = {
+	[BENCH_KGSL] = "kgsl",
+	[BENCH_POOL] = "pool",
+	[BENCH_ION] = "ion",
+};
+
+enum bench_step {
+	BENCH_ALLOC,
+	BENCH_CPU_MAP,
+	BENCH_GPU_MAP,
+	BENCH_CACHE,
+	BENCH_FREE,
+	BENCH_STEP_MAX,
+};
+
+static const char * const bench_step_names[] = {
+	[BENCH_ALLOC] = "alloc",
+	[BENCH_CPU_MAP] = "cpu_map",
+	[BENCH_GPU_MAP] = "gpu_map",
+	[BENCH_CACHE] = "cache",
+	[BENCH_FREE] = "free",
+};
+
+struct bench_buf {
+	struct kgsl_memdesc memdesc;
+	struct page **pages;
+	unsigned int page_count;
+	struct dma_buf *dmabuf;
+	struct dma_buf_attachment *attach;
+	void *vaddr;
+	bool gpu_mapped;
+};
+
+static struct {
+	struct mutex lock;
+	struct kgsl_device *device;
+	/* knobs, copied to last at the start of a run */
+	u64 size;
+	u32 order;
+	u32 threads;
+	u32 iterations;
+	u32 ion_heap_mask;
+	u32 ion_flags;
+	bool cpu_map;
+	bool gpu_map;
+	bool cache;
+	enum bench_target target;
+	/* knobs and state of the last run */
+	struct {
+		enum bench_target target;
+		u64 size;
+		u32 order;
+		u32 threads;
+		u32 iterations;
+		u32 ion_heap_mask;
+		u32 ion_flags;
+		bool cpu_map;
+		bool gpu_map;
+		bool cache;
+		u64 wall_ns;
+		int error;
+	} last;
+	u64 *lat[BENCH_STEP_MAX];
+	atomic_t count[BENCH_STEP_MAX];
+	atomic_t running;
+	struct completion done;
+} bench = {
+	.lock = __MUTEX_INITIALIZER(bench.lock),
+	.size = SZ_1M,
+	.threads = 1,
+	.iterations = 100,
+	.ion_heap_mask = ION_HEAP(ION_SYSTEM_HEAP_ID),
+	.cpu_map = true,
+	.gpu_map = true,
+	.cache = true,
+};
+
+static int bench_alloc(struct bench_buf *buf)
+{
+	struct kgsl_device *device = bench.device;
+	int page_size, align, ret;
+	unsigned int count;
+
+	switch (bench.last.target) {
+	case BENCH_KGSL:
+		kgsl_memdesc_init(device, &buf->memdesc, 0);
+		return kgsl_sharedmem_page_alloc_user(&buf->memdesc,
+				bench.last.size);
+	case BENCH_POOL:
+		page_size = PAGE_SIZE << bench.last.order;
+		count = ALIGN(bench.last.size, page_size) >> PAGE_SHIFT;
+		buf->pages = vzalloc(count * sizeof(*buf->pages));
+		if (!buf->pages)
+			return -ENOMEM;
+
+		while (buf->page_count < count) {
+			ret = kgsl_pool_alloc_page(&page_size,
+					buf->pages + buf->page_count,
+					count - buf->page_count, &align);
+			/* the pool lowered page_size, try again with it */
+			if (ret == -EAGAIN)
+				continue;
+			if (ret <= 0)
+				return ret ? ret : -ENOMEM;
+			buf->page_count += ret;
+		}
+		return 0;
+	case BENCH_ION:
+		buf->dmabuf = ion_alloc(bench.last.size,
+				bench.last.ion_heap_mask, bench.last.ion_flags);
+		if (IS_ERR(buf->dmabuf)) {
+			ret = PTR_ERR(buf->dmabuf);
+			buf->dmabuf = NULL;
+			return ret;
+		}
+		kgsl_memdesc_init(device, &buf->memdesc,
+				KGSL_MEMFLAGS_USERMEM_ION);
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+static int bench_cpu_map(struct bench_buf *buf)
+{
+	switch (bench.last.target) {
+	case BENCH_KGSL:
+		if (!buf->memdesc.ops || !buf->memdesc.ops->map_kernel)
+			return -EOPNOTSUPP;
+		return buf->memdesc.ops->map_kernel(&buf->memdesc);
+	case BENCH_POOL:
+		buf->vaddr = vmap(buf->pages, buf->page_count, VM_MAP,
+				PAGE_KERNEL);
+		break;
+	case BENCH_ION:
+		buf->vaddr = dma_buf_vmap(buf->dmabuf);
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	return buf->vaddr ? 0 : -ENOMEM;
+}
+
+static int bench_gpu_map(struct bench_buf *buf)
+{
+	struct kgsl_device *device = bench.device;
+	struct kgsl_pagetable *pagetable = device->mmu.defaultpagetable;
+	struct kgsl_memdesc *memdesc = &buf->memdesc;
+	struct sg_table *sgt;
+	int ret;
+
+	if (!pagetable)
+		return -ENODEV;
+
+	if (bench.last.target == BENCH_ION) {
+		buf->attach = dma_buf_attach(buf->dmabuf, device->dev);
+		if (IS_ERR(buf->attach)) {
+			ret = PTR_ERR(buf->attach);
+			buf->attach = NULL;
+			return ret;
+		}
+
+		sgt = dma_buf_map_attachment(buf->attach, DMA_BIDIRECTIONAL);
+		if (IS_ERR_OR_NULL(sgt))
+			return sgt ? PTR_ERR(sgt) : -ENOMEM;
+
+		memdesc->sgt = sgt;
+		memdesc->size = PAGE_ALIGN(buf->dmabuf->size);
+	}
+
+	ret = kgsl_mmu_get_gpuaddr(pagetable, memdesc);
+	if (ret)
+		return ret;
+
+	ret = kgsl_mmu_map(pagetable, memdesc);
+	if (ret) {
+		kgsl_mmu_put_gpuaddr(memdesc);
+		return ret;
+	}
+
+	buf->gpu_mapped = true;
+	return 0;
+}
+
+static int bench_cache(struct bench_buf *buf)
+{
+	int ret;
+
+	if (bench.last.target == BENCH_KGSL)
+		return kgsl_cache_range_op(&buf->memdesc, 0,
+				buf->memdesc.size, KGSL_CACHE_OP_FLUSH);
+
+	ret = dma_buf_begin_cpu_access(buf->dmabuf, DMA_BIDIRECTIONAL);
+	if (ret)
+		return ret;
+
+	return dma_buf_end_cpu_access(buf->dmabuf, DMA_BIDIRECTIONAL);
+}
+
+/* Undo whatever the other steps got done, also after a failure */
+static void bench_free(struct bench_buf *buf)
+{
+	struct kgsl_memdesc *memdesc = &buf->memdesc;
+
+	switch (bench.last.target) {
+	case BENCH_KGSL:
+		/* unmaps the kernel and GPU mappings as well */
+		kgsl_sharedmem_free(memdesc);
+		break;
+	case BENCH_POOL:
+		if (buf->vaddr)
+			vunmap(buf->vaddr);
+		kgsl_pool_free_pages(buf->pages, buf->page_count);
+		vfree(buf->pages);
+		break;
+	case BENCH_ION:
+		if (buf->vaddr)
+			dma_buf_vunmap(buf->dmabuf, buf->vaddr);
+		if (buf->gpu_mapped)
+			kgsl_mmu_put_gpuaddr(memdesc);
+		if (memdesc->sgt)
+			dma_buf_unmap_attachment(buf->attach, memdesc->sgt,
+					DMA_BIDIRECTIONAL);
+		if (buf->attach)
+			dma_buf_detach(buf->dmabuf, buf->attach);
+		if (buf->dmabuf)
+			dma_buf_put(buf->dmabuf);
+		break;
+	default:
+		break;
+	}
+}
+
+static ktime_t bench_sample(enum bench_step step, ktime_t start)
+{
+	ktime_t now = ktime_get();
+	int i = atomic_inc_return(&bench.count[step]) - 1;
+
+	bench.lat[step][i] = ktime_to_ns(ktime_sub(now, start));
+	return now;
+}
+
+static int bench_one(void)
+{
+	struct bench_buf buf = { };
+	bool pool = bench.last.target == BENCH_POOL;
+	ktime_t t;
+	int ret;
+
+	t = ktime_get();
+	ret = bench_alloc(&buf);
+	if (ret)
+		goto out;
+	t = bench_sample(BENCH_ALLOC, t);
+
+	if (bench.last.cpu_map) {
+		ret = bench_cpu_map(&buf);
+		if (ret)
+			goto out;
+		t = bench_sample(BENCH_CPU_MAP, t);
+	}
+
+	/* pool pages are neither GPU mapped nor cache maintained here */
+	if (bench.last.gpu_map && !pool) {
+		ret = bench_gpu_map(&buf);
+		if (ret)
+			goto out;
+		t = bench_sample(BENCH_GPU_MAP, t);
+	}
+
+	if (bench.last.cache && !pool) {
+		ret = bench_cache(&buf);
+		if (ret)
+			goto out;
+		t = bench_sample(BENCH_CACHE, t);
+	}
+
+	bench_free(&buf);
+	bench_sample(BENCH_FREE, t);
+	return 0;
+out:
+	bench_free(&buf);
+	return ret;
+}
+
+static int bench_thread(void *data)
+{
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < bench.last.iterations; i++) {
+		ret = bench_one();
+		if (ret) {
+			bench.last.error = ret;
+			break;
+		}
+		cond_resched();
+	}
+
+	if (atomic_dec_and_test(&bench.running))
+		complete(&bench.done);
+	return 0;
+}
+
+static int bench_cmp(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void bench_free_samples(void)
+{
+	int i;
+
+	for (i = 0; i < BENCH_STEP_MAX; i++) {
+		vfree(bench.lat[i]);
+		bench.lat[i] = NULL;
+		atomic_set(&bench.count[i], 0);
+	}
+}
+
+static int bench_run(void)
+{
+	struct task_struct *task;
+	unsigned int i, samples;
+	ktime_t start;
+
+	if (!bench.threads || bench.threads > BENCH_MAX_THREADS ||
+		!bench.iterations || !bench.size ||
+		bench.size > BENCH_MAX_SIZE || bench.order > 8)
+		return -EINVAL;
+
+	samples = bench.threads * bench.iterations;
+	if (samples > BENCH_MAX_SAMPLES)
+		return -E2BIG;
+
+	bench.device = kgsl_get_device(KGSL_DEVICE_3D0);
+	if (!bench.device)
+		return -ENODEV;
+
+	bench_free_samples();
+	for (i = 0; i < BENCH_STEP_MAX; i++) {
+		bench.lat[i] = vmalloc(samples * sizeof(u64));
+		if (!bench.lat[i]) {
+			bench_free_samples();
+			return -ENOMEM;
+		}
+	}
+
+	bench.last.target = bench.target;
+	bench.last.size = PAGE_ALIGN(bench.size);
+	bench.last.order = bench.order;
+	bench.last.threads = bench.threads;
+	bench.last.iterations = bench.iterations;
+	bench.last.ion_heap_mask = bench.ion_heap_mask;
+	bench.last.ion_flags = bench.ion_flags;
+	bench.last.cpu_map = bench.cpu_map;
+	bench.last.gpu_map = bench.gpu_map;
+	bench.last.cache = bench.cache;
+	bench.last.error = 0;
+
+	init_completion(&bench.done);
+	atomic_set(&bench.running, bench.threads);
+
+	start = ktime_get();
+	for (i = 0; i < bench.threads; i++) {
+		task = kthread_run(bench_thread, NULL, "kgsl_bench/%u", i);
+		if (IS_ERR(task)) {
+			bench.last.error = PTR_ERR(task);
+			bench.last.threads = i;
+			/* account for the threads that never started */
+			if (atomic_sub_and_test(bench.threads - i,
+					&bench.running))
+				complete(&bench.done);
+			break;
+		}
+	}
+
+	wait_for_completion(&bench.done);
+	bench.last.wall_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	for (i = 0; i < BENCH_STEP_MAX; i++)
+		sort(bench.lat[i], atomic_read(&bench.count[i]), sizeof(u64),
+			bench_cmp, NULL);
+
+	return bench.last.error;
+}
+
+static u64 bench_pct(enum bench_step step, unsigned int pct)
+{
+	unsigned int count = atomic_read(&bench.count[step]);
+
+	return bench.lat[step][(count - 1) * pct / 100];
+}
+
+static int bench_result_show(struct seq_file *s, void *unused)
+{
+	unsigned int i, count;
+	u64 total, bytes;
+
+	mutex_lock(&bench.lock);
+
+	if (!bench.lat[BENCH_ALLOC]) {
+		seq_puts(s, "no run yet\n");
+		goto out;
+	}
+
+	seq_printf(s, "target %s size %llu threads %u iterations %u error %d\n",
+		bench_target_names[bench.last.target], bench.last.size,
+		bench.last.threads, bench.last.iterations, bench.last.error);
+	seq_printf(s, "%-8s %8s %10s %10s %10s %10s %10s\n", "step", "count",
+		"p50_us", "p90_us", "p99_us", "max_us", "MB/s");
+
+	for (i = 0; i < BENCH_STEP_MAX; i++) {
+		count = atomic_read(&bench.count[i]);
+		if (!count)
+			continue;
+
+		total = 0;
+		for (bytes = 0; bytes < count; bytes++)
+			total += bench.lat[i][bytes];
+
+		/* MB/s of one thread doing nothing but this step */
+		bytes = (u64)count * bench.last.size;
+		seq_printf(s, "%-8s %8u %10llu %10llu %10llu %10llu %10llu\n",
+			bench_step_names[i], count,
+			div_u64(bench_pct(i, 50), NSEC_PER_USEC),
+			div_u64(bench_pct(i, 90), NSEC_PER_USEC),
+			div_u64(bench_pct(i, 99), NSEC_PER_USEC),
+			div_u64(bench.lat[i][count - 1], NSEC_PER_USEC),
+			total ? div64_u64(bytes * NSEC_PER_SEC, total) >> 20 :
+				0);
+	}
+
+	/* whole buffers through every step, all threads together */
+	count = atomic_read(&bench.count[BENCH_FREE]);
+	bytes = (u64)count * bench.last.size;
+	total = max_t(u64, bench.last.wall_ns, 1);
+	seq_printf(s, "wall %llu us, %llu buffers/s, %llu MB/s\n",
+		div_u64(total, NSEC_PER_USEC),
+		div64_u64((u64)count * NSEC_PER_SEC, total),
+		div64_u64(bytes * NSEC_PER_SEC, total) >> 20);
+out:
+	mutex_unlock(&bench.lock);
+	return 0;
+}
+
+static int bench_result_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bench_result_show, NULL);
+}
+
+static const struct file_operations bench_result_fops = {
+	.open = bench_result_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static ssize_t bench_run_write(struct file *file, const char __user *ubuf,
+		size_t count, loff_t *ppos)
+{
+	int ret;
+
+	mutex_lock(&bench.lock);
+	ret = bench_run();
+	mutex_unlock(&bench.lock);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations bench_run_fops = {
+	.open = simple_open,
+	.write = bench_run_write,
+	.llseek = noop_llseek,
+};
+
+static int bench_target_show(struct seq_file *s, void *unused)
+{
+	int i;
+
+	for (i = 0; i < BENCH_TARGET_MAX; i++)
+		seq_printf(s, i == bench.target ? "[%s] " : "%s ",
+			bench_target_names[i]);
+	seq_putc(s, '\n');
+	return 0;
+}
+
+static int bench_target_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bench_target_show, NULL);
+}
+
+static ssize_t bench_target_write(struct file *file, const char __user *ubuf,
+		size_t count, loff_t *ppos)
+{
+	char buf[8];
+	int i;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	i = sysfs_match_string(bench_target_names, strim(buf));
+	if (i < 0)
+		return i;
+
+	mutex_lock(&bench.lock);
+	bench.target = i;
+	mutex_unlock(&bench.lock);
+
+	return count;
+}
+
+static const struct file_operations bench_target_fops = {
+	.open = bench_target_open,
+	.read = seq_read,
+	.write = bench_target_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+void kgsl_bench_init(struct dentry *root)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("bench", root);
+	if (IS_ERR_OR_NULL(dir))
+		return;
+
+	debugfs_create_file("target", 0644, dir, NULL, &bench_target_fops);
+	debugfs_create_u64("size", 0644, dir, &bench.size);
+	debugfs_create_u32("order", 0644, dir, &bench.order);
+	debugfs_create_u32("threads", 0644, dir, &bench.threads);
+	debugfs_create_u32("iterations", 0644, dir, &bench.iterations);
+	debugfs_create_x32("ion_heap_mask", 0644, dir, &bench.ion_heap_mask);
+	debugfs_create_x32("ion_flags", 0644, dir, &bench.ion_flags);
+	debugfs_create_bool("cpu_map", 0644, dir, &bench.cpu_map);
+	debugfs_create_bool("gpu_map", 0644, dir, &bench.gpu_map);
+	debugfs_create_bool("cache", 0644, dir, &bench.cache);
+	debugfs_create_file("run", 0200, dir, NULL, &bench_run_fops);
+	debugfs_create_file("result", 0444, dir, NULL, &bench_result_fops);
+}
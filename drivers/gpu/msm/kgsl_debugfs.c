@@ -455,6 +455,8 @@ void kgsl_core_debugfs_init(void)
 		&_strict_fops);
 
 	proc_d_debugfs = debugfs_create_dir("proc", kgsl_debugfs_dir);
+
+	kgsl_bench_init(kgsl_debugfs_dir);
 }
 
 void kgsl_core_debugfs_close(void)
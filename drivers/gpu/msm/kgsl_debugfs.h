@@ -32,6 +32,12 @@ static inline struct dentry *kgsl_get_debugfs_dir(void)
 }
 
 void kgsl_process_init_debugfs(struct kgsl_process_private *priv);
+
+#ifdef CONFIG_QCOM_KGSL_BENCHMARK
+void kgsl_bench_init(struct dentry *root);
+#else
+static inline void kgsl_bench_init(struct dentry *root) { }
+#endif
 #else
 static inline void kgsl_core_debugfs_init(void) { }
 static inline void kgsl_device_debugfs_init(struct kgsl_device *device) { }
@@ -314,6 +314,8 @@ struct kgsl_device {
 	bool snapshot_crashdumper;
 	/* Use HOST side register reads to get GPU snapshot*/
 	bool snapshot_legacy;
+	/* Hand finished snapshots to devcoredump */
+	bool snapshot_devcoredump;
 
 	struct kobject snapshot_kobj;
 
@@ -460,6 +462,12 @@ struct kgsl_context {
  * @fd_count: Counter for the number of FDs for this process
  * @ctxt_count: Count for the number of contexts for this process
  * @ctxt_count_lock: Spinlock to protect ctxt_count
+ * @unmap_batch: Entries unmapped in the current batch, freed once it's done
+ * @unmap_batch_owner: Task running the batch in process_release_memory
+ * @gpu_time_ns: GPU time consumed by the commands of this process
+ * @reclaim_sem: Held for read while the process uses its buffers, for write
+ * while they are reclaimed or restored
+ * @reclaimed: Bytes of memory currently reclaimed from this process
  */
 struct kgsl_process_private {
 	unsigned long priv;
@@ -482,14 +490,23 @@ struct kgsl_process_private {
 	int fd_count;
 	atomic_t ctxt_count;
 	spinlock_t ctxt_count_lock;
+	struct list_head unmap_batch;
+	struct task_struct *unmap_batch_owner;
+	atomic64_t gpu_time_ns;
+	struct rw_semaphore reclaim_sem;
+	atomic64_t reclaimed;
 };
 
 /**
  * enum kgsl_process_priv_flags - Private flags for kgsl_process_private
  * @KGSL_PROCESS_INIT: Set if the process structure has been set up
+ * @KGSL_PROCESS_BACKGROUND: Userspace put the process in the background
+ * @KGSL_PROCESS_RECLAIMED: Some buffers may have been reclaimed
  */
 enum kgsl_process_priv_flags {
 	KGSL_PROCESS_INIT = 0,
+	KGSL_PROCESS_BACKGROUND,
+	KGSL_PROCESS_RECLAIMED,
 };
 
 struct kgsl_device_private {
@@ -758,6 +775,9 @@ bool kgsl_event_pending(struct kgsl_device *device,
 		kgsl_event_func func, void *priv);
 int kgsl_add_event(struct kgsl_device *device, struct kgsl_event_group *group,
 		unsigned int timestamp, kgsl_event_func func, void *priv);
+int kgsl_add_fast_event(struct kgsl_device *device,
+		struct kgsl_event_group *group, unsigned int timestamp,
+		kgsl_event_func func, void *priv);
 void kgsl_process_event_group(struct kgsl_device *device,
 	struct kgsl_event_group *group);
 void kgsl_flush_event_group(struct kgsl_device *device,
@@ -1105,6 +1105,14 @@ int kgsl_drawobj_cmd_add_memlist(struct kgsl_device *device,
 		if (ret)
 			return ret;
 
+		if (obj.flags & KGSL_OBJLIST_DEADLINE) {
+			if (obj.size)
+				baseobj->deadline = ktime_get_ns() +
+					obj.size * NSEC_PER_USEC;
+			ptr += sizeof(obj);
+			continue;
+		}
+
 		if (!(obj.flags & KGSL_OBJLIST_MEMOBJ)) {
 			KGSL_DRV_ERR(device,
 				"invalid memobj ctxt %d flags %d id %d offset %lld addr %lld size %lld\n",
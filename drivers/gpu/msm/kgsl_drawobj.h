@@ -34,6 +34,7 @@
  * @timestamp: Timestamp assigned to the command
  * @flags: flags
  * @refcount: kref structure to maintain the reference count
+ * @deadline: Time (ktime ns) by which the frame should retire, 0 if none
  */
 struct kgsl_drawobj {
 	struct kgsl_device *device;
@@ -42,6 +43,7 @@ struct kgsl_drawobj {
 	uint32_t timestamp;
 	unsigned long flags;
 	struct kref refcount;
+	u64 deadline;
 };
 
 /**
@@ -66,6 +68,7 @@ struct kgsl_drawobj {
  * for easy access
  * @profile_index: Index to store the start/stop ticks in the kernel profiling
  * buffer
+ * @submit_ns: Time (ktime ns) the command was handed to the ringbuffer
 
  */
 struct kgsl_drawobj_cmd {
@@ -80,6 +83,7 @@ struct kgsl_drawobj_cmd {
 	struct kgsl_mem_entry *profiling_buf_entry;
 	uint64_t profiling_buffer_gpuaddr;
 	unsigned int profile_index;
+	u64 submit_ns;
 };
 
 /**
@@ -32,9 +32,25 @@ static inline void signal_event(struct kgsl_device *device,
 {
 	list_del(&event->node);
 	event->result = result;
+	event->signaled = ktime_get();
 	queue_work(device->events_wq, &event->work);
 }
 
+static void _kgsl_event_fire(struct kgsl_event *event)
+{
+	int id = KGSL_CONTEXT_ID(event->context);
+
+	trace_kgsl_fire_event(id, event->timestamp, event->result,
+		jiffies - event->created, event->func);
+	trace_kgsl_event_latency(id, event->timestamp, event->fast,
+		ktime_to_ns(ktime_sub(ktime_get(), event->signaled)));
+
+	event->func(event->device, event->group, event->priv, event->result);
+
+	kgsl_context_put(event->context);
+	kmem_cache_free(events_cache, event);
+}
+
 /**
  * _kgsl_event_worker() - Work handler for processing GPU event callbacks
  * @work: Pointer to the work_struct for the event
@@ -45,15 +61,8 @@ static inline void signal_event(struct kgsl_device *device,
 static void _kgsl_event_worker(struct work_struct *work)
 {
 	struct kgsl_event *event = container_of(work, struct kgsl_event, work);
-	int id = KGSL_CONTEXT_ID(event->context);
-
-	trace_kgsl_fire_event(id, event->timestamp, event->result,
-		jiffies - event->created, event->func);
-
-	event->func(event->device, event->group, event->priv, event->result);
 
-	kgsl_context_put(event->context);
-	kmem_cache_free(events_cache, event);
+	_kgsl_event_fire(event);
 }
 
 /* return true if the group needs to be processed */
@@ -79,6 +88,7 @@ static void _process_event_group(struct kgsl_device *device,
 	struct kgsl_event *event, *tmp;
 	unsigned int timestamp;
 	struct kgsl_context *context;
+	LIST_HEAD(fast);
 
 	if (group == NULL)
 		return;
@@ -103,9 +113,19 @@ static void _process_event_group(struct kgsl_device *device,
 		goto out;
 
 	list_for_each_entry_safe(event, tmp, &group->events, node) {
-		if (timestamp_cmp(event->timestamp, timestamp) <= 0)
-			signal_event(device, event, KGSL_EVENT_RETIRED);
-		else if (flush)
+		if (timestamp_cmp(event->timestamp, timestamp) <= 0) {
+			/*
+			 * Fast events skip the workqueue and are fired below
+			 * once the group lock is dropped
+			 */
+			if (event->fast) {
+				list_move_tail(&event->node, &fast);
+				event->result = KGSL_EVENT_RETIRED;
+				event->signaled = ktime_get();
+			} else
+				signal_event(device, event,
+					KGSL_EVENT_RETIRED);
+		} else if (flush)
 			signal_event(device, event, KGSL_EVENT_CANCELLED);
 
 	}
@@ -114,6 +134,10 @@ static void _process_event_group(struct kgsl_device *device,
 
 out:
 	spin_unlock(&group->lock);
+
+	list_for_each_entry_safe(event, tmp, &fast, node)
+		_kgsl_event_fire(event);
+
 	kgsl_context_put(context);
 }
 
@@ -236,16 +260,9 @@ bool kgsl_event_pending(struct kgsl_device *device,
 	spin_unlock(&group->lock);
 	return result;
 }
-/**
- * kgsl_add_event() - Add a new GPU event to a group
- * @device: Pointer to a KGSL device
- * @group: Pointer to the group to add the event to
- * @timestamp: Timestamp that the event will expire on
- * @func: Callback function for the event
- * @priv: Private data to send to the callback function
- */
-int kgsl_add_event(struct kgsl_device *device, struct kgsl_event_group *group,
-		unsigned int timestamp, kgsl_event_func func, void *priv)
+static int _kgsl_add_event(struct kgsl_device *device,
+		struct kgsl_event_group *group, unsigned int timestamp,
+		kgsl_event_func func, void *priv, bool fast)
 {
 	unsigned int queued;
 	struct kgsl_context *context = group->context;
@@ -285,6 +302,7 @@ int kgsl_add_event(struct kgsl_device *device, struct kgsl_event_group *group,
 	event->func = func;
 	event->created = jiffies;
 	event->group = group;
+	event->fast = fast;
 
 	INIT_WORK(&event->work, _kgsl_event_worker);
 
@@ -301,6 +319,7 @@ int kgsl_add_event(struct kgsl_device *device, struct kgsl_event_group *group,
 
 	if (timestamp_cmp(retired, timestamp) >= 0) {
 		event->result = KGSL_EVENT_RETIRED;
+		event->signaled = ktime_get();
 		queue_work(device->events_wq, &event->work);
 		spin_unlock(&group->lock);
 		return 0;
@@ -313,8 +332,43 @@ int kgsl_add_event(struct kgsl_device *device, struct kgsl_event_group *group,
 
 	return 0;
 }
+
+/**
+ * kgsl_add_event() - Add a new GPU event to a group
+ * @device: Pointer to a KGSL device
+ * @group: Pointer to the group to add the event to
+ * @timestamp: Timestamp that the event will expire on
+ * @func: Callback function for the event
+ * @priv: Private data to send to the callback function
+ */
+int kgsl_add_event(struct kgsl_device *device, struct kgsl_event_group *group,
+		unsigned int timestamp, kgsl_event_func func, void *priv)
+{
+	return _kgsl_add_event(device, group, timestamp, func, priv, false);
+}
 EXPORT_SYMBOL(kgsl_add_event);
 
+/**
+ * kgsl_add_fast_event() - Add a GPU event that is fired from the retire path
+ * @device: Pointer to a KGSL device
+ * @group: Pointer to the group to add the event to
+ * @timestamp: Timestamp that the event will expire on
+ * @func: Callback function for the event
+ * @priv: Private data to send to the callback function
+ *
+ * Like kgsl_add_event() but when the timestamp retires @func is called
+ * directly by whoever processes the group instead of from the events
+ * workqueue, which may be in atomic context. @func must not sleep.
+ * Cancelled events still go through the workqueue.
+ */
+int kgsl_add_fast_event(struct kgsl_device *device,
+		struct kgsl_event_group *group, unsigned int timestamp,
+		kgsl_event_func func, void *priv)
+{
+	return _kgsl_add_event(device, group, timestamp, func, priv, true);
+}
+EXPORT_SYMBOL(kgsl_add_fast_event);
+
 static DEFINE_RWLOCK(group_lock);
 static LIST_HEAD(group_list);
 
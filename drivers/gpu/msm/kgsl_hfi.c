@@ -48,7 +48,7 @@
 	 ((branch) & 0x1F))
 
 static void hfi_process_queue(struct gmu_device *gmu, uint32_t queue_idx,
-	struct pending_cmd *ret_cmd);
+	struct pending_cmd *ret_cmd, unsigned int count);
 
 /* Size in below functions are in unit of dwords */
 static int hfi_queue_read(struct gmu_device *gmu, uint32_t queue_idx,
@@ -112,7 +112,31 @@ static int hfi_queue_read(struct gmu_device *gmu, uint32_t queue_idx,
 	return result;
 }
 
-/* Size in below functions are in unit of dwords */
+static uint32_t hfi_queue_space(struct hfi_queue_header *hdr)
+{
+	return (hdr->write_index >= hdr->read_index) ?
+		(hdr->queue_size - (hdr->write_index - hdr->read_index)) :
+		(hdr->read_index - hdr->write_index);
+}
+
+/* Let the GMU know there are new messages in its command queues */
+static void hfi_doorbell(struct gmu_device *gmu)
+{
+	/*
+	 * Memory barrier to make sure packet and write index are written before
+	 * an interrupt is raised
+	 */
+	wmb();
+
+	/* Send interrupt to GMU to receive the message */
+	adreno_write_gmureg(ADRENO_DEVICE(gmu->hfi.kgsldev),
+		ADRENO_REG_GMU_HOST2GMU_INTR_SET, 0x1);
+}
+
+/*
+ * Size in below functions are in unit of dwords. The message is only
+ * queued, the caller rings the doorbell.
+ */
 static int hfi_queue_write(struct gmu_device *gmu, uint32_t queue_idx,
 		uint32_t *msg)
 {
@@ -140,9 +164,7 @@ static int hfi_queue_write(struct gmu_device *gmu, uint32_t queue_idx,
 
 	mutex_lock(&hfi->cmdq_mutex);
 
-	empty_space = (hdr->write_index >= hdr->read_index) ?
-			(hdr->queue_size - (hdr->write_index - hdr->read_index))
-			: (hdr->read_index - hdr->write_index);
+	empty_space = hfi_queue_space(hdr);
 
 	if (empty_space < size) {
 		dev_err(&gmu->pdev->dev,
@@ -171,16 +193,6 @@ static int hfi_queue_write(struct gmu_device *gmu, uint32_t queue_idx,
 
 	mutex_unlock(&hfi->cmdq_mutex);
 
-	/*
-	 * Memory barrier to make sure packet and write index are written before
-	 * an interrupt is raised
-	 */
-	wmb();
-
-	/* Send interrupt to GMU to receive the message */
-	adreno_write_gmureg(ADRENO_DEVICE(hfi->kgsldev),
-		ADRENO_REG_GMU_HOST2GMU_INTR_SET, 0x1);
-
 	return 0;
 }
 
@@ -252,12 +264,13 @@ void hfi_init(struct kgsl_hfi *hfi, struct gmu_memdesc *mem_addr,
 	(MSG_HDR_GET_SEQNUM(out_hdr) == MSG_HDR_GET_SEQNUM(in_hdr))
 
 static void receive_ack_cmd(struct gmu_device *gmu, void *rcvd,
-	struct pending_cmd *ret_cmd)
+	struct pending_cmd *ret_cmd, unsigned int count)
 {
 	uint32_t *ack = rcvd;
 	uint32_t hdr = ack[0];
 	uint32_t req_hdr = ack[1];
 	struct kgsl_hfi *hfi = &gmu->hfi;
+	unsigned int i;
 
 	if (ret_cmd == NULL)
 		return;
@@ -266,9 +279,12 @@ static void receive_ack_cmd(struct gmu_device *gmu, void *rcvd,
 		MSG_HDR_GET_SIZE(req_hdr),
 		MSG_HDR_GET_SEQNUM(req_hdr));
 
-	if (HDR_CMP_SEQNUM(ret_cmd->sent_hdr, req_hdr)) {
-		memcpy(&ret_cmd->results, ack, MSG_HDR_GET_SIZE(hdr) << 2);
-		return;
+	for (i = 0; i < count; i++) {
+		if (HDR_CMP_SEQNUM(ret_cmd[i].sent_hdr, req_hdr)) {
+			memcpy(&ret_cmd[i].results, ack,
+				MSG_HDR_GET_SIZE(hdr) << 2);
+			return;
+		}
 	}
 
 	/* Didn't find the sender, list the waiter */
@@ -305,6 +321,130 @@ static int poll_adreno_gmu_reg(struct adreno_device *adreno_dev,
 	return -ETIMEDOUT;
 }
 
+/*
+ * Ring the GMU once for every command queued in the batch and collect
+ * all of their acks. Returns the first error the batch has seen.
+ */
+static int hfi_batch_flush(struct gmu_device *gmu)
+{
+	struct kgsl_hfi *hfi = &gmu->hfi;
+	struct adreno_device *adreno_dev = ADRENO_DEVICE(hfi->kgsldev);
+	unsigned int i, acked = 0;
+	int rc = 0;
+
+	if (!hfi->batch_count)
+		return hfi->batch_ret;
+
+	hfi_doorbell(gmu);
+
+	while (acked < hfi->batch_count) {
+		rc = poll_adreno_gmu_reg(adreno_dev,
+			ADRENO_REG_GMU_GMU2HOST_INTR_INFO, HFI_IRQ_MSGQ_MASK,
+			HFI_IRQ_MSGQ_MASK, HFI_RSP_TIMEOUT);
+		if (rc) {
+			dev_err(&gmu->pdev->dev,
+				"Timed out waiting on %d of %d batched acks\n",
+				hfi->batch_count - acked, hfi->batch_count);
+			break;
+		}
+
+		/* Clear the interrupt */
+		adreno_write_gmureg(adreno_dev,
+			ADRENO_REG_GMU_GMU2HOST_INTR_CLR, HFI_IRQ_MSGQ_MASK);
+
+		hfi_process_queue(gmu, HFI_MSG_ID, hfi->batch,
+			hfi->batch_count);
+
+		/* An ack always carries a header, so results[0] is set */
+		for (acked = 0, i = 0; i < hfi->batch_count; i++)
+			if (hfi->batch[i].results[0])
+				acked++;
+	}
+
+	for (i = 0; i < hfi->batch_count; i++) {
+		struct pending_cmd *cmd = &hfi->batch[i];
+
+		if (!cmd->results[0] || !cmd->results[2])
+			continue;
+
+		dev_err(&gmu->pdev->dev,
+				"HFI ACK failure: Req 0x%8.8X Error 0x%X\n",
+				cmd->results[1], cmd->results[2]);
+		if (!rc)
+			rc = -EINVAL;
+	}
+
+	hfi->batch_count = 0;
+	if (!hfi->batch_ret)
+		hfi->batch_ret = rc;
+
+	return hfi->batch_ret;
+}
+
+static int hfi_batch_add(struct gmu_device *gmu, uint32_t queue_idx,
+		uint32_t *cmd)
+{
+	struct kgsl_hfi *hfi = &gmu->hfi;
+	struct hfi_queue_table *tbl = gmu->hfi_mem->hostptr;
+	struct pending_cmd *pending;
+	int rc;
+
+	/* Make room if the batch or the queue is full */
+	if (hfi->batch_count == HFI_BATCH_MAX ||
+		hfi_queue_space(&tbl->qhdr[queue_idx]) <
+			ALIGN(MSG_HDR_GET_SIZE(*cmd), SZ_4))
+		hfi_batch_flush(gmu);
+
+	pending = &hfi->batch[hfi->batch_count];
+	memset(pending, 0, sizeof(*pending));
+
+	*cmd = MSG_HDR_SET_SEQNUM(*cmd, atomic_inc_return(&hfi->seqnum));
+	pending->sent_hdr = cmd[0];
+
+	rc = hfi_queue_write(gmu, queue_idx, cmd);
+	if (rc) {
+		if (!hfi->batch_ret)
+			hfi->batch_ret = rc;
+		return rc;
+	}
+
+	hfi->batch_count++;
+	return 0;
+}
+
+/**
+ * hfi_batch_begin() - Start batching HFI requests
+ * @gmu: Pointer to the GMU device
+ *
+ * Until hfi_batch_end(), generic requests sent by this task are queued
+ * and the GMU is rung once for up to HFI_BATCH_MAX of them, instead of
+ * waiting for an ack after each one. Requests that return a value flush
+ * the batch first. Their acks are checked when the batch is flushed.
+ */
+void hfi_batch_begin(struct gmu_device *gmu)
+{
+	struct kgsl_hfi *hfi = &gmu->hfi;
+
+	hfi->batch_count = 0;
+	hfi->batch_ret = 0;
+	hfi->batch_owner = current;
+}
+
+/**
+ * hfi_batch_end() - Flush and stop batching HFI requests
+ * @gmu: Pointer to the GMU device
+ *
+ * Return: 0 if every request of the batch was acked without error
+ */
+int hfi_batch_end(struct gmu_device *gmu)
+{
+	struct kgsl_hfi *hfi = &gmu->hfi;
+	int rc = hfi_batch_flush(gmu);
+
+	hfi->batch_owner = NULL;
+	return rc;
+}
+
 static int hfi_send_cmd(struct gmu_device *gmu, uint32_t queue_idx,
 		void *data, struct pending_cmd *ret_cmd)
 {
@@ -314,9 +454,17 @@ static int hfi_send_cmd(struct gmu_device *gmu, uint32_t queue_idx,
 	unsigned int seqnum = atomic_inc_return(&hfi->seqnum);
 	struct adreno_device *adreno_dev = ADRENO_DEVICE(hfi->kgsldev);
 
+	/* Acks for a pending batch must not be mistaken for ours */
+	if (hfi->batch_count)
+		hfi_batch_flush(gmu);
+
 	*cmd = MSG_HDR_SET_SEQNUM(*cmd, seqnum);
-	if (ret_cmd == NULL)
-		return hfi_queue_write(gmu, queue_idx, cmd);
+	if (ret_cmd == NULL) {
+		rc = hfi_queue_write(gmu, queue_idx, cmd);
+		if (!rc)
+			hfi_doorbell(gmu);
+		return rc;
+	}
 
 	ret_cmd->sent_hdr = cmd[0];
 
@@ -324,6 +472,8 @@ static int hfi_send_cmd(struct gmu_device *gmu, uint32_t queue_idx,
 	if (rc)
 		return rc;
 
+	hfi_doorbell(gmu);
+
 	rc = poll_adreno_gmu_reg(adreno_dev, ADRENO_REG_GMU_GMU2HOST_INTR_INFO,
 		HFI_IRQ_MSGQ_MASK, HFI_IRQ_MSGQ_MASK, HFI_RSP_TIMEOUT);
 
@@ -338,7 +488,7 @@ static int hfi_send_cmd(struct gmu_device *gmu, uint32_t queue_idx,
 	adreno_write_gmureg(adreno_dev, ADRENO_REG_GMU_GMU2HOST_INTR_CLR,
 		HFI_IRQ_MSGQ_MASK);
 
-	hfi_process_queue(gmu, HFI_MSG_ID, ret_cmd);
+	hfi_process_queue(gmu, HFI_MSG_ID, ret_cmd, 1);
 
 	return rc;
 }
@@ -349,6 +499,9 @@ static int hfi_send_generic_req(struct gmu_device *gmu, uint32_t queue,
 	struct pending_cmd ret_cmd;
 	int rc;
 
+	if (gmu->hfi.batch_owner == current)
+		return hfi_batch_add(gmu, queue, cmd);
+
 	memset(&ret_cmd, 0, sizeof(ret_cmd));
 
 	rc = hfi_send_cmd(gmu, queue, cmd, &ret_cmd);
@@ -563,11 +716,11 @@ static void receive_debug_req(struct gmu_device *gmu, void *rcvd)
 }
 
 static void hfi_v1_receiver(struct gmu_device *gmu, uint32_t *rcvd,
-	struct pending_cmd *ret_cmd)
+	struct pending_cmd *ret_cmd, unsigned int count)
 {
 	/* V1 ACK Handler */
 	if (MSG_HDR_GET_TYPE(rcvd[0]) == HFI_V1_MSG_ACK) {
-		receive_ack_cmd(gmu, rcvd, ret_cmd);
+		receive_ack_cmd(gmu, rcvd, ret_cmd, count);
 		return;
 	}
 
@@ -588,20 +741,20 @@ static void hfi_v1_receiver(struct gmu_device *gmu, uint32_t *rcvd,
 }
 
 static void hfi_process_queue(struct gmu_device *gmu, uint32_t queue_idx,
-	struct pending_cmd *ret_cmd)
+	struct pending_cmd *ret_cmd, unsigned int count)
 {
 	uint32_t rcvd[MAX_RCVD_SIZE];
 
 	while (hfi_queue_read(gmu, queue_idx, rcvd, sizeof(rcvd)) > 0) {
 		/* Special case if we're v1 */
 		if (HFI_VER_MAJOR(&gmu->hfi) < 2) {
-			hfi_v1_receiver(gmu, rcvd, ret_cmd);
+			hfi_v1_receiver(gmu, rcvd, ret_cmd, count);
 			continue;
 		}
 
 		/* V2 ACK Handler */
 		if (MSG_HDR_GET_TYPE(rcvd[0]) == HFI_MSG_ACK) {
-			receive_ack_cmd(gmu, rcvd, ret_cmd);
+			receive_ack_cmd(gmu, rcvd, ret_cmd, count);
 			continue;
 		}
 
@@ -625,7 +778,7 @@ static void hfi_process_queue(struct gmu_device *gmu, uint32_t queue_idx,
 void hfi_receiver(unsigned long data)
 {
 	/* Process all asynchronous read (firmware to host) queues */
-	hfi_process_queue((struct gmu_device *) data, HFI_DBG_ID, NULL);
+	hfi_process_queue((struct gmu_device *) data, HFI_DBG_ID, NULL, 0);
 }
 
 static int hfi_verify_fw_version(struct kgsl_device *device,
@@ -684,41 +837,11 @@ static int hfi_send_acd_feature_ctrl(struct gmu_device *gmu,
 	return ret;
 }
 
-int hfi_start(struct kgsl_device *device,
-		struct gmu_device *gmu, uint32_t boot_state)
+static int hfi_send_boot_cmds(struct kgsl_device *device,
+		struct gmu_device *gmu)
 {
 	struct adreno_device *adreno_dev = ADRENO_DEVICE(device);
-	struct gmu_memdesc *mem_addr = gmu->hfi_mem;
-	struct hfi_queue_table *tbl = mem_addr->hostptr;
-	struct hfi_queue_header *hdr;
-	int result, i;
-
-	if (test_bit(GMU_HFI_ON, &device->gmu_core.flags))
-		return 0;
-
-	/* Force read_index to the write_index no matter what */
-	for (i = 0; i < HFI_QUEUE_MAX; i++) {
-		hdr = &tbl->qhdr[i];
-		if (hdr->status == HFI_QUEUE_STATUS_DISABLED)
-			continue;
-
-		if (hdr->read_index != hdr->write_index) {
-			dev_err(&gmu->pdev->dev,
-				"HFI Q[%d] Index Error: read:0x%X write:0x%X\n",
-				i, hdr->read_index, hdr->write_index);
-			hdr->read_index = hdr->write_index;
-		}
-	}
-
-	if (!adreno_is_a640(adreno_dev) && !adreno_is_a680(adreno_dev)) {
-		result = hfi_send_gmu_init(gmu, boot_state);
-		if (result)
-			return result;
-	}
-
-	result = hfi_verify_fw_version(device, gmu);
-	if (result)
-		return result;
+	int result;
 
 	if (HFI_VER_MAJOR(&gmu->hfi) < 2)
 		result = hfi_send_dcvstbl_v1(gmu);
@@ -762,6 +885,55 @@ int hfi_start(struct kgsl_device *device,
 				return result;
 		}
 	}
+
+	return 0;
+}
+
+int hfi_start(struct kgsl_device *device,
+		struct gmu_device *gmu, uint32_t boot_state)
+{
+	struct adreno_device *adreno_dev = ADRENO_DEVICE(device);
+	struct gmu_memdesc *mem_addr = gmu->hfi_mem;
+	struct hfi_queue_table *tbl = mem_addr->hostptr;
+	struct hfi_queue_header *hdr;
+	int result, ret, i;
+
+	if (test_bit(GMU_HFI_ON, &device->gmu_core.flags))
+		return 0;
+
+	/* Force read_index to the write_index no matter what */
+	for (i = 0; i < HFI_QUEUE_MAX; i++) {
+		hdr = &tbl->qhdr[i];
+		if (hdr->status == HFI_QUEUE_STATUS_DISABLED)
+			continue;
+
+		if (hdr->read_index != hdr->write_index) {
+			dev_err(&gmu->pdev->dev,
+				"HFI Q[%d] Index Error: read:0x%X write:0x%X\n",
+				i, hdr->read_index, hdr->write_index);
+			hdr->read_index = hdr->write_index;
+		}
+	}
+
+	if (!adreno_is_a640(adreno_dev) && !adreno_is_a680(adreno_dev)) {
+		result = hfi_send_gmu_init(gmu, boot_state);
+		if (result)
+			return result;
+	}
+
+	result = hfi_verify_fw_version(device, gmu);
+	if (result)
+		return result;
+
+	/* None of the boot messages need a reply, send them as one batch */
+	hfi_batch_begin(gmu);
+	result = hfi_send_boot_cmds(device, gmu);
+	ret = hfi_batch_end(gmu);
+	if (!result)
+		result = ret;
+	if (result)
+		return result;
+
 	set_bit(GMU_HFI_ON, &device->gmu_core.flags);
 	return 0;
 }
@@ -57,6 +57,7 @@ struct hfi_queue_table;
 #define HFI_DSP_PRI_0 20
 
 #define HFI_RSP_TIMEOUT 100 /* msec */
+#define HFI_BATCH_MAX 8 /* commands in flight per doorbell */
 #define HFI_H2F_CMD_IRQ_MASK BIT(0)
 
 #define HFI_IRQ_MSGQ_MASK		BIT(0)
@@ -620,6 +621,11 @@ struct pending_cmd {
  *	value of the counter is used as sequence number for HFI message
  * @bwtbl_cmd: HFI BW table buffer
  * @acd_tbl_cmd: HFI table for ACD data
+ * @batch_owner: Task batching HFI commands, whose generic requests are
+ *	queued without ringing the GMU until the batch is flushed
+ * @batch: Commands of the current batch waiting for their ack
+ * @batch_count: Number of commands in @batch
+ * @batch_ret: First error seen by the current batch
  */
 struct kgsl_hfi {
 	struct kgsl_device *kgsldev;
@@ -630,6 +636,10 @@ struct kgsl_hfi {
 	atomic_t seqnum;
 	struct hfi_bwtable_cmd bwtbl_cmd;
 	struct hfi_acd_table_cmd acd_tbl_cmd;
+	struct task_struct *batch_owner;
+	struct pending_cmd batch[HFI_BATCH_MAX];
+	unsigned int batch_count;
+	int batch_ret;
 };
 
 struct gmu_device;
@@ -639,6 +649,8 @@ irqreturn_t hfi_irq_handler(int irq, void *data);
 int hfi_start(struct kgsl_device *device, struct gmu_device *gmu,
 		uint32_t boot_state);
 void hfi_stop(struct gmu_device *gmu);
+void hfi_batch_begin(struct gmu_device *gmu);
+int hfi_batch_end(struct gmu_device *gmu);
 void hfi_receiver(unsigned long data);
 void hfi_init(struct kgsl_hfi *hfi, struct gmu_memdesc *mem_addr,
 		uint32_t queue_sz_bytes);
@@ -436,8 +436,12 @@ static int _iommu_unmap_sync_pc(struct kgsl_pagetable *pt,
 {
 	struct kgsl_iommu_pt *iommu_pt = pt->priv;
 	struct kgsl_iommu *iommu = _IOMMU_PRIV(pt->mmu);
+	bool batched = (iommu_pt->batch_owner == current);
 	size_t unmapped = 0;
 
+	if (!batched)
+		mutex_lock(&iommu_pt->unmap_lock);
+
 	_iommu_sync_mmu_pc(true);
 
 	/*
@@ -451,6 +455,9 @@ static int _iommu_unmap_sync_pc(struct kgsl_pagetable *pt,
 
 	_iommu_sync_mmu_pc(false);
 
+	if (!batched)
+		mutex_unlock(&iommu_pt->unmap_lock);
+
 	if (unmapped != size) {
 		KGSL_CORE_ERR("unmap err: 0x%016llx, 0x%llx, %zd\n",
 			addr, size, unmapped);
@@ -1175,6 +1182,7 @@ _alloc_pt(struct device *dev, struct kgsl_mmu *mmu, struct kgsl_pagetable *pt)
 	pt->priv = iommu_pt;
 	pt->fault_addr = ~0ULL;
 	iommu_pt->rbtree = RB_ROOT;
+	mutex_init(&iommu_pt->unmap_lock);
 
 	if (MMU_FEATURE(mmu, KGSL_MMU_64BIT))
 		setup_64bit_pagetable(mmu, pt, iommu_pt);
@@ -1785,6 +1793,34 @@ kgsl_iommu_unmap_offset(struct kgsl_pagetable *pt,
 	return _iommu_unmap_sync_pc(pt, addr + offset, size);
 }
 
+/*
+ * Unmaps from the domain skip their TLB invalidation while the batch is
+ * open and a single TLBIASID is issued when it is closed. Other threads'
+ * unmaps take unmap_lock, so nobody else frees pages behind a stale TLB.
+ * If the SMMU driver doesn't support deferring, every unmap keeps
+ * flushing as before.
+ */
+static void kgsl_iommu_unmap_batch(struct kgsl_pagetable *pt, bool start)
+{
+	struct kgsl_iommu_pt *iommu_pt = pt->priv;
+	int defer = start ? 1 : 0;
+
+	if (start) {
+		mutex_lock(&iommu_pt->unmap_lock);
+		iommu_pt->batch_owner = current;
+	} else {
+		iommu_pt->batch_owner = NULL;
+	}
+
+	_iommu_sync_mmu_pc(true);
+	iommu_domain_set_attr(iommu_pt->domain, DOMAIN_ATTR_DEFER_TLB_FLUSH,
+			&defer);
+	_iommu_sync_mmu_pc(false);
+
+	if (!start)
+		mutex_unlock(&iommu_pt->unmap_lock);
+}
+
 static int
 kgsl_iommu_unmap(struct kgsl_pagetable *pt, struct kgsl_memdesc *memdesc)
 {
@@ -2904,4 +2940,5 @@ static struct kgsl_mmu_pt_ops iommu_pt_ops = {
 	.mmu_map_offset = kgsl_iommu_map_offset,
 	.mmu_unmap_offset = kgsl_iommu_unmap_offset,
 	.mmu_sparse_dummy_map = kgsl_iommu_sparse_dummy_map,
+	.mmu_unmap_batch = kgsl_iommu_unmap_batch,
 };
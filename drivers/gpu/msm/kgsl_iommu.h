@@ -134,6 +134,9 @@ struct kgsl_iommu_context {
  * @pagefault_suppression_count: Total number of pagefaults
  *				 suppressed since boot.
  */
+/* ASID field of a TTBR0 value, 0 if the context bank is not ASID tagged */
+#define KGSL_IOMMU_TTBR0_ASID(_ttbr0) ((_ttbr0) >> 48)
+
 struct kgsl_iommu {
 	struct kgsl_iommu_context ctx[KGSL_IOMMU_CONTEXT_MAX];
 	void __iomem *regbase;
@@ -179,6 +182,10 @@ struct kgsl_iommu_pt {
 	uint64_t svm_end;
 	uint64_t compat_va_start;
 	uint64_t compat_va_end;
+
+	/* Serialises unmaps against a batch, see kgsl_iommu_unmap_batch */
+	struct mutex unmap_lock;
+	struct task_struct *batch_owner;
 };
 
 /*
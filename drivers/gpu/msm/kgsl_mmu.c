@@ -464,6 +464,23 @@ void kgsl_mmu_put_gpuaddr(struct kgsl_memdesc *memdesc)
 }
 EXPORT_SYMBOL(kgsl_mmu_put_gpuaddr);
 
+/**
+ * kgsl_mmu_unmap_batch() - Start or finish a batch of unmaps
+ * @pagetable: Pagetable the unmaps are made from
+ * @start: true to start the batch, false to finish it
+ *
+ * Unmaps from @pagetable by the calling thread between the two calls may
+ * share a single TLB invalidation, issued when the batch is finished.
+ * Until then the unmapped pages must stay allocated. Unmaps by other
+ * threads wait for the batch to finish.
+ */
+void kgsl_mmu_unmap_batch(struct kgsl_pagetable *pagetable, bool start)
+{
+	if (PT_OP_VALID(pagetable, mmu_unmap_batch))
+		pagetable->pt_ops->mmu_unmap_batch(pagetable, start);
+}
+EXPORT_SYMBOL(kgsl_mmu_unmap_batch);
+
 /**
  * kgsl_mmu_svm_range() - Return the range for SVM (if applicable)
  * @pagetable: Pagetable to query the range from
@@ -53,6 +53,8 @@ struct kgsl_pagetable {
 	uint64_t fault_addr;
 	void *priv;
 	struct kgsl_mmu *mmu;
+	/* Switched to with a full TLBIALL, TLB entries since carry its ASID */
+	bool tlb_tagged;
 };
 
 struct kgsl_mmu;
@@ -113,6 +115,7 @@ struct kgsl_mmu_pt_ops {
 	int (*mmu_sparse_dummy_map)(struct kgsl_pagetable *pt,
 			struct kgsl_memdesc *memdesc, uint64_t offset,
 			uint64_t size);
+	void (*mmu_unmap_batch)(struct kgsl_pagetable *pt, bool start);
 };
 
 /*
@@ -203,6 +206,7 @@ int kgsl_mmu_map(struct kgsl_pagetable *pagetable,
 int kgsl_mmu_unmap(struct kgsl_pagetable *pagetable,
 		    struct kgsl_memdesc *memdesc);
 void kgsl_mmu_put_gpuaddr(struct kgsl_memdesc *memdesc);
+void kgsl_mmu_unmap_batch(struct kgsl_pagetable *pagetable, bool start);
 unsigned int kgsl_virtaddr_to_physaddr(void *virtaddr);
 unsigned int kgsl_mmu_log_fault_addr(struct kgsl_mmu *mmu,
 		u64 ttbr0, uint64_t addr);
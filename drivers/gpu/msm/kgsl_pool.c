@@ -16,14 +16,25 @@
 #include <linux/slab.h>
 #include <linux/highmem.h>
 #include <linux/version.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/workqueue.h>
 
 #include "kgsl.h"
 #include "kgsl_device.h"
 #include "kgsl_pool.h"
+#include "kgsl_debugfs.h"
 
 #define KGSL_MAX_POOLS 4
 #define KGSL_MAX_POOL_ORDER 8
 #define KGSL_MAX_RESERVED_PAGES 4096
+#define KGSL_LARGE_PAGE_ORDER (ilog2(SZ_2M) - PAGE_SHIFT)
+
+/* Autotune window, and how long growing stays off after a shrink */
+#define KGSL_POOL_TUNE_PERIOD HZ
+#define KGSL_POOL_TUNE_BACKOFF (10 * HZ)
+/* Most entries added to one pool per window */
+#define KGSL_POOL_TUNE_GROW_BATCH 64
 
 /**
  * struct kgsl_page_pool - Structure to hold information for the pool
@@ -34,6 +45,12 @@
  * from system memory
  * @list_lock: Spinlock for page list in the pool
  * @page_list: List of pages held/reserved in this pool
+ * @target_pages: Number of entries autotune keeps in the pool
+ * @demand: Moving average of the entries requested per autotune window
+ * @window_allocs: Entries requested in the current autotune window
+ * @hits: Allocations served from the pool
+ * @misses: Allocations that found the pool empty
+ * @fallbacks: Allocations sent back to retry with a lower order
  */
 struct kgsl_page_pool {
 	unsigned int pool_order;
@@ -42,12 +59,31 @@ struct kgsl_page_pool {
 	bool allocation_allowed;
 	spinlock_t list_lock;
 	struct list_head page_list;
+	unsigned int target_pages;
+	unsigned int demand;
+	atomic_t window_allocs;
+	atomic_long_t hits;
+	atomic_long_t misses;
+	atomic_long_t fallbacks;
 };
 
 static struct kgsl_page_pool kgsl_pools[KGSL_MAX_POOLS];
 static int kgsl_num_pools;
 static int kgsl_pool_max_pages;
 
+/*
+ * Autotune: size each pool from the allocations it actually sees rather
+ * than from the reservation in DT alone. Every window the per-order
+ * request counts are folded into a moving average, which becomes the
+ * pool's target. Pools at target give freed pages back to the system,
+ * pools below it are grown in the background, and the reservation stays
+ * the floor. After the shrinker has run, growing is held off for a while.
+ */
+static bool kgsl_pool_autotune;
+static unsigned long kgsl_pool_last_shrink;
+static void kgsl_pool_tune_work(struct work_struct *work);
+static DECLARE_DELAYED_WORK(kgsl_pool_tune, kgsl_pool_tune_work);
+
 
 /* Returns KGSL pool corresponding to input page order*/
 static struct kgsl_page_pool *
@@ -298,6 +334,28 @@ static int kgsl_pool_get_retry_order(unsigned int order)
 	return 0;
 }
 
+/* Account an allocation request against the pool of its order */
+static void kgsl_pool_note_alloc(struct kgsl_page_pool *pool, bool hit)
+{
+	if (hit)
+		atomic_long_inc(&pool->hits);
+	else
+		atomic_long_inc(&pool->misses);
+
+	atomic_inc(&pool->window_allocs);
+	if (READ_ONCE(kgsl_pool_autotune) &&
+			!delayed_work_pending(&kgsl_pool_tune))
+		queue_delayed_work(system_unbound_wq, &kgsl_pool_tune,
+				KGSL_POOL_TUNE_PERIOD);
+}
+
+/* Autotune has a target for the pool and the pool has reached it */
+static bool kgsl_pool_at_target(struct kgsl_page_pool *pool)
+{
+	return READ_ONCE(kgsl_pool_autotune) &&
+		pool->page_count >= READ_ONCE(pool->target_pages);
+}
+
 /**
  * kgsl_pool_alloc_page() - Allocate a page of requested size
  * @page_size: Size of the page to be allocated
@@ -328,6 +386,9 @@ int kgsl_pool_alloc_page(int *page_size, struct page **pages,
 
 		page = alloc_pages(gfp_mask, order);
 		if (page == NULL) {
+			if (order == KGSL_LARGE_PAGE_ORDER)
+				atomic_long_inc(
+					&kgsl_driver.stats.large_page_fallback);
 			/* Retry with lower order pages */
 			if (order > 0) {
 				size = PAGE_SIZE << --order;
@@ -336,11 +397,23 @@ int kgsl_pool_alloc_page(int *page_size, struct page **pages,
 			} else
 				return -ENOMEM;
 		}
+		if (order == KGSL_LARGE_PAGE_ORDER)
+			atomic_long_inc(&kgsl_driver.stats.large_page_alloc);
 		goto done;
 	}
 
 	pool = _kgsl_get_pool_from_order(order);
 	if (pool == NULL) {
+		/* 2MB chunks are never pooled, take them straight from buddy */
+		if (order == KGSL_LARGE_PAGE_ORDER) {
+			page = alloc_pages(kgsl_gfp_mask(order), order);
+			if (page != NULL) {
+				atomic_long_inc(&kgsl_driver.stats.large_page_alloc);
+				goto done;
+			}
+			atomic_long_inc(&kgsl_driver.stats.large_page_fallback);
+		}
+
 		/* Retry with lower order pages */
 		if (order > 0) {
 			size = PAGE_SIZE << kgsl_pool_get_retry_order(order);
@@ -361,6 +434,7 @@ int kgsl_pool_alloc_page(int *page_size, struct page **pages,
 
 	pool_idx = kgsl_pool_idx_lookup(order);
 	page = _kgsl_pool_get_page(pool);
+	kgsl_pool_note_alloc(pool, page != NULL);
 
 	/* Allocate a new page if not allocated from pool */
 	if (page == NULL) {
@@ -368,6 +442,7 @@ int kgsl_pool_alloc_page(int *page_size, struct page **pages,
 
 		/* Only allocate non-reserved memory for certain pools */
 		if (!pool->allocation_allowed && pool_idx > 0) {
+			atomic_long_inc(&pool->fallbacks);
 			size = PAGE_SIZE <<
 					kgsl_pools[pool_idx-1].pool_order;
 			goto eagain;
@@ -378,6 +453,7 @@ int kgsl_pool_alloc_page(int *page_size, struct page **pages,
 		if (!page) {
 			if (pool_idx > 0) {
 				/* Retry with lower order pages */
+				atomic_long_inc(&pool->fallbacks);
 				size = PAGE_SIZE <<
 					kgsl_pools[pool_idx-1].pool_order;
 				goto eagain;
@@ -421,7 +497,7 @@ void kgsl_pool_free_page(struct page *page)
 	if (!kgsl_pool_max_pages ||
 			(kgsl_pool_size_total() < kgsl_pool_max_pages)) {
 		pool = _kgsl_get_pool_from_order(page_order);
-		if (pool != NULL) {
+		if (pool != NULL && !kgsl_pool_at_target(pool)) {
 			_kgsl_pool_add_page(pool, page);
 			return;
 		}
@@ -467,6 +543,125 @@ static void kgsl_pool_reserve_pages(void)
 	}
 }
 
+static void kgsl_pool_tune_work(struct work_struct *work)
+{
+	bool active = false;
+	int i;
+
+	for (i = 0; i < kgsl_num_pools; i++) {
+		struct kgsl_page_pool *pool = &kgsl_pools[i];
+		unsigned int order = pool->pool_order;
+		unsigned int allocs = atomic_xchg(&pool->window_allocs, 0);
+		unsigned int target;
+		int count, j;
+
+		pool->demand = (pool->demand * 3 + allocs) / 4;
+		if (allocs || pool->demand)
+			active = true;
+
+		target = clamp_t(unsigned int, pool->demand,
+				pool->reserved_pages, KGSL_MAX_RESERVED_PAGES);
+		WRITE_ONCE(pool->target_pages, target);
+
+		count = kgsl_pool_size(pool) >> order;
+		if (count > target) {
+			/* Like the shrinker, leave pools that can't allocate */
+			if (pool->allocation_allowed)
+				_kgsl_pool_shrink(pool, (count - target) << order);
+			continue;
+		}
+
+		if (time_before(jiffies, kgsl_pool_last_shrink +
+					KGSL_POOL_TUNE_BACKOFF))
+			continue;
+
+		for (j = count; j < target &&
+				j < count + KGSL_POOL_TUNE_GROW_BATCH; j++) {
+			gfp_t gfp_mask = (kgsl_gfp_mask(order) |
+					__GFP_NORETRY | __GFP_NOWARN) &
+					~__GFP_DIRECT_RECLAIM;
+			struct page *page;
+
+			if (kgsl_pool_max_pages &&
+				kgsl_pool_size_total() >= kgsl_pool_max_pages)
+				break;
+
+			page = alloc_pages(gfp_mask, order);
+			if (page == NULL)
+				break;
+			_kgsl_pool_add_page(pool, page);
+		}
+	}
+
+	if (active && READ_ONCE(kgsl_pool_autotune))
+		queue_delayed_work(system_unbound_wq, &kgsl_pool_tune,
+				KGSL_POOL_TUNE_PERIOD);
+}
+
+static int kgsl_pool_stats_show(struct seq_file *s, void *unused)
+{
+	int i;
+
+	seq_puts(s, "order pages reserved target demand hits misses fallbacks\n");
+	for (i = 0; i < kgsl_num_pools; i++) {
+		struct kgsl_page_pool *pool = &kgsl_pools[i];
+
+		seq_printf(s, "%5u %5d %8u %6u %6u %ld %ld %ld\n",
+			pool->pool_order, pool->page_count,
+			pool->reserved_pages, READ_ONCE(pool->target_pages),
+			pool->demand, atomic_long_read(&pool->hits),
+			atomic_long_read(&pool->misses),
+			atomic_long_read(&pool->fallbacks));
+	}
+
+	return 0;
+}
+
+static int kgsl_pool_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, kgsl_pool_stats_show, NULL);
+}
+
+static const struct file_operations kgsl_pool_stats_fops = {
+	.open = kgsl_pool_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int _autotune_set(void *data, u64 val)
+{
+	WRITE_ONCE(kgsl_pool_autotune, val ? true : false);
+	if (val)
+		mod_delayed_work(system_unbound_wq, &kgsl_pool_tune, 0);
+	return 0;
+}
+
+static int _autotune_get(void *data, u64 *val)
+{
+	*val = kgsl_pool_autotune;
+	return 0;
+}
+
+DEFINE_SIMPLE_ATTRIBUTE(_autotune_fops, _autotune_get, _autotune_set,
+			"%llu\n");
+
+static void kgsl_pool_debugfs_init(void)
+{
+	struct dentry *root = kgsl_get_debugfs_dir();
+	struct dentry *dir;
+
+	if (IS_ERR_OR_NULL(root))
+		return;
+
+	dir = debugfs_create_dir("pool", root);
+	if (IS_ERR_OR_NULL(dir))
+		return;
+
+	debugfs_create_file("stats", 0444, dir, NULL, &kgsl_pool_stats_fops);
+	debugfs_create_file("autotune", 0644, dir, NULL, &_autotune_fops);
+}
+
 /* Functions for the shrinker */
 
 static unsigned long
@@ -483,6 +678,7 @@ kgsl_pool_shrink_scan_objects(struct shrinker *shrinker,
 
 	/* Reduce pool size to target_pages */
 	ret = kgsl_pool_reduce(target_pages, false);
+	kgsl_pool_last_shrink = jiffies;
 
 	/* If we are unable to shrink more, stop trying */
 	return (ret == 0) ? SHRINK_STOP : ret;
@@ -520,6 +716,7 @@ static void kgsl_pool_config(unsigned int order, unsigned int reserved_pages,
 	kgsl_pools[kgsl_num_pools].pool_order = order;
 	kgsl_pools[kgsl_num_pools].reserved_pages = reserved_pages;
 	kgsl_pools[kgsl_num_pools].allocation_allowed = allocation_allowed;
+	kgsl_pools[kgsl_num_pools].target_pages = reserved_pages;
 	spin_lock_init(&kgsl_pools[kgsl_num_pools].list_lock);
 	INIT_LIST_HEAD(&kgsl_pools[kgsl_num_pools].page_list);
 	kgsl_num_pools++;
@@ -564,6 +761,8 @@ static void kgsl_of_get_mempools(struct device_node *parent)
 		/* Get Max pages limit for mempool */
 		of_property_read_u32(node, "qcom,mempool-max-pages",
 				&kgsl_pool_max_pages);
+		kgsl_pool_autotune = of_property_read_bool(node,
+				"qcom,mempool-autotune");
 		kgsl_of_parse_mempools(node);
 	}
 }
@@ -577,12 +776,21 @@ void kgsl_init_page_pools(struct platform_device *pdev)
 	/* Reserve the appropriate number of pages for each pool */
 	kgsl_pool_reserve_pages();
 
+	/* Let autotune grow the pools right away */
+	kgsl_pool_last_shrink = jiffies - KGSL_POOL_TUNE_BACKOFF;
+
 	/* Initialize shrinker */
 	register_shrinker(&kgsl_pool_shrinker);
+
+	kgsl_pool_debugfs_init();
 }
 
 void kgsl_exit_page_pools(void)
 {
+	/* Stop autotune before emptying the pools */
+	WRITE_ONCE(kgsl_pool_autotune, false);
+	cancel_delayed_work_sync(&kgsl_pool_tune);
+
 	/* Release all pages in pools, if any.*/
 	kgsl_pool_reduce(0, true);
 
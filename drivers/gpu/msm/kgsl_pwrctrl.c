@@ -1511,9 +1511,88 @@ static DEVICE_ATTR(max_clock_mhz, 0644, kgsl_pwrctrl_max_clock_mhz_show,
 static DEVICE_ATTR(clock_mhz, 0444, kgsl_pwrctrl_clock_mhz_show, NULL);
 static DEVICE_ATTR(freq_table_mhz, 0444,
 	kgsl_pwrctrl_freq_table_mhz_show, NULL);
+static ssize_t kgsl_pwrctrl_frame_pacing_period_us_store(struct device *dev,
+					struct device_attribute *attr,
+					const char *buf, size_t count)
+{
+	struct kgsl_device *device = kgsl_device_from_dev(dev);
+	unsigned int val = 0;
+	int ret;
+
+	if (device == NULL)
+		return 0;
+
+	ret = kgsl_sysfs_store(buf, &val);
+	if (ret)
+		return ret;
+
+	mutex_lock(&device->mutex);
+	device->pwrscale.pacing.period_us = val;
+	if (!val)
+		device->pwrscale.pacing.in_frame = false;
+	mutex_unlock(&device->mutex);
+
+	return count;
+}
+
+static ssize_t kgsl_pwrctrl_frame_pacing_period_us_show(struct device *dev,
+					struct device_attribute *attr,
+					char *buf)
+{
+	struct kgsl_device *device = kgsl_device_from_dev(dev);
+
+	if (device == NULL)
+		return 0;
+	return snprintf(buf, PAGE_SIZE, "%u\n",
+		device->pwrscale.pacing.period_us);
+}
+
+static ssize_t kgsl_pwrctrl_frame_pacing_headroom_store(struct device *dev,
+					struct device_attribute *attr,
+					const char *buf, size_t count)
+{
+	struct kgsl_device *device = kgsl_device_from_dev(dev);
+	unsigned int val = 0;
+	int ret;
+
+	if (device == NULL)
+		return 0;
+
+	ret = kgsl_sysfs_store(buf, &val);
+	if (ret)
+		return ret;
+
+	if (!val || val > 100)
+		return -EINVAL;
+
+	mutex_lock(&device->mutex);
+	device->pwrscale.pacing.headroom = val;
+	mutex_unlock(&device->mutex);
+
+	return count;
+}
+
+static ssize_t kgsl_pwrctrl_frame_pacing_headroom_show(struct device *dev,
+					struct device_attribute *attr,
+					char *buf)
+{
+	struct kgsl_device *device = kgsl_device_from_dev(dev);
+
+	if (device == NULL)
+		return 0;
+	return snprintf(buf, PAGE_SIZE, "%u\n",
+		device->pwrscale.pacing.headroom);
+}
+
 static DEVICE_ATTR(pwrscale, 0644,
 	kgsl_pwrctrl_pwrscale_show,
 	kgsl_pwrctrl_pwrscale_store);
+static DEVICE_ATTR(frame_pacing_period_us, 0644,
+	kgsl_pwrctrl_frame_pacing_period_us_show,
+	kgsl_pwrctrl_frame_pacing_period_us_store);
+static DEVICE_ATTR(frame_pacing_headroom, 0644,
+	kgsl_pwrctrl_frame_pacing_headroom_show,
+	kgsl_pwrctrl_frame_pacing_headroom_store);
 
 static const struct device_attribute *pwrctrl_attr_list[] = {
 	&dev_attr_gpuclk,
@@ -1541,6 +1620,8 @@ static const struct device_attribute *pwrctrl_attr_list[] = {
 	&dev_attr_freq_table_mhz,
 	&dev_attr_temp,
 	&dev_attr_pwrscale,
+	&dev_attr_frame_pacing_period_us,
+	&dev_attr_frame_pacing_headroom,
 	NULL
 };
 
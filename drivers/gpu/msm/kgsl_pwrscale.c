@@ -37,6 +37,8 @@ static struct kgsl_midframe_info {
 static void do_devfreq_suspend(struct work_struct *work);
 static void do_devfreq_resume(struct work_struct *work);
 static void do_devfreq_notify(struct work_struct *work);
+static void do_pacing_frame(struct work_struct *work);
+static void do_pacing_risk(struct work_struct *work);
 
 /*
  * These variables are used to keep the latest data
@@ -57,6 +59,10 @@ void kgsl_pwrscale_sleep(struct kgsl_device *device)
 		return;
 	device->pwrscale.on_time = 0;
 
+	/* Nothing is running, so there is no frame to pace */
+	device->pwrscale.pacing.in_frame = false;
+	hrtimer_try_to_cancel(&device->pwrscale.pacing.timer);
+
 	/* to call devfreq_suspend_device() from a kernel thread */
 	queue_work(device->pwrscale.devfreq_wq,
 		&device->pwrscale.devfreq_suspend_ws);
@@ -135,6 +141,11 @@ void kgsl_pwrscale_update_stats(struct kgsl_device *device)
 		device->pwrscale.accum_stats.ram_wait += stats.ram_wait;
 		pwrctrl->clock_times[pwrctrl->active_pwrlevel] +=
 				stats.busy_time;
+
+		if (psc->pacing.in_frame)
+			psc->pacing.busy_cycles += div_u64(stats.busy_time *
+				kgsl_pwrctrl_active_freq(pwrctrl),
+				USEC_PER_SEC);
 	}
 }
 EXPORT_SYMBOL(kgsl_pwrscale_update_stats);
@@ -218,6 +229,148 @@ static enum hrtimer_restart kgsl_pwrscale_midframe_timer(struct hrtimer *timer)
 	return HRTIMER_NORESTART;
 }
 
+/*
+ * Frame pacing DCVS. With a target frame period set, the GPU clock is
+ * chosen once per frame instead of per sample window. When a frame ends,
+ * the cycles it kept the GPU busy give the lowest power level at which
+ * the next frame fits in its budget, a headroom share of the period. If a
+ * frame is still running when its budget is spent it is at risk, and the
+ * clock goes straight to the highest allowed level. While frames keep
+ * coming, the devfreq governor's recommendations are ignored.
+ */
+static bool _pacing_active(struct kgsl_pwrscale *psc)
+{
+	struct kgsl_pwrscale_pacing *pacing = &psc->pacing;
+
+	if (!pacing->period_us)
+		return false;
+
+	/* Give the governor back control once frames stop */
+	return pacing->in_frame || ktime_us_delta(ktime_get(),
+		pacing->last_frame) < 4 * (s64)pacing->period_us;
+}
+
+/*
+ * kgsl_pwrscale_frame_start - note submission of frame work
+ * @device: The device
+ *
+ * Called for every command submission, the first one after the end of a
+ * frame starts the next frame. This function must be called with the
+ * device mutex locked.
+ */
+void kgsl_pwrscale_frame_start(struct kgsl_device *device)
+{
+	struct kgsl_pwrscale_pacing *pacing = &device->pwrscale.pacing;
+
+	if (!device->pwrscale.enabled || !pacing->period_us ||
+			pacing->in_frame)
+		return;
+
+	/* Leave busy time from before the frame to the sample window */
+	kgsl_pwrscale_update_stats(device);
+
+	pacing->in_frame = true;
+	pacing->frame_start = ktime_get();
+	pacing->budget_us = div_u64((u64)pacing->period_us *
+		pacing->headroom, 100);
+	pacing->busy_cycles = 0;
+
+	hrtimer_start(&pacing->timer, ns_to_ktime(pacing->budget_us *
+		NSEC_PER_USEC), HRTIMER_MODE_REL);
+}
+EXPORT_SYMBOL(kgsl_pwrscale_frame_start);
+
+/*
+ * kgsl_pwrscale_frame_end - note retirement of the end of a frame
+ * @device: The device
+ * @deadline: Deadline hint of the frame in ktime ns, 0 for none
+ *
+ * A deadline hint replaces the period based budget of the next frame.
+ * This function may be called without the device mutex.
+ */
+void kgsl_pwrscale_frame_end(struct kgsl_device *device, u64 deadline)
+{
+	struct kgsl_pwrscale_pacing *pacing = &device->pwrscale.pacing;
+
+	if (!device->pwrscale.enabled || !READ_ONCE(pacing->period_us))
+		return;
+
+	if (deadline) {
+		s64 budget = div_s64((s64)deadline -
+			ktime_to_ns(pacing->frame_start), NSEC_PER_USEC);
+
+		if (budget > 0)
+			WRITE_ONCE(pacing->budget_us, budget);
+	}
+
+	hrtimer_try_to_cancel(&pacing->timer);
+	queue_work(device->pwrscale.devfreq_wq, &pacing->frame_ws);
+}
+EXPORT_SYMBOL(kgsl_pwrscale_frame_end);
+
+static void do_pacing_frame(struct work_struct *work)
+{
+	struct kgsl_pwrscale *psc = container_of(work, struct kgsl_pwrscale,
+						pacing.frame_ws);
+	struct kgsl_device *device = container_of(psc, struct kgsl_device,
+						pwrscale);
+	struct kgsl_pwrscale_pacing *pacing = &psc->pacing;
+	struct kgsl_pwrctrl *pwr = &device->pwrctrl;
+	unsigned int level = pwr->max_pwrlevel;
+	u64 target;
+	int i;
+
+	mutex_lock(&device->mutex);
+
+	if (!pacing->in_frame || !pacing->budget_us)
+		goto out;
+
+	kgsl_pwrscale_update_stats(device);
+
+	pacing->in_frame = false;
+	pacing->last_frame = ktime_get();
+
+	target = div64_u64(pacing->busy_cycles * USEC_PER_SEC,
+		pacing->budget_us);
+
+	for (i = pwr->min_pwrlevel; i >= (int) pwr->max_pwrlevel; i--) {
+		if (pwr->pwrlevels[i].gpu_freq >= target) {
+			level = i;
+			break;
+		}
+	}
+
+	if (level != pwr->active_pwrlevel)
+		kgsl_pwrctrl_pwrlevel_change(device, level);
+out:
+	mutex_unlock(&device->mutex);
+}
+
+static void do_pacing_risk(struct work_struct *work)
+{
+	struct kgsl_pwrscale *psc = container_of(work, struct kgsl_pwrscale,
+						pacing.risk_ws);
+	struct kgsl_device *device = container_of(psc, struct kgsl_device,
+						pwrscale);
+	struct kgsl_pwrctrl *pwr = &device->pwrctrl;
+
+	mutex_lock(&device->mutex);
+	if (psc->pacing.in_frame && device->state == KGSL_STATE_ACTIVE &&
+			pwr->active_pwrlevel != pwr->max_pwrlevel)
+		kgsl_pwrctrl_pwrlevel_change(device, pwr->max_pwrlevel);
+	mutex_unlock(&device->mutex);
+}
+
+static enum hrtimer_restart kgsl_pwrscale_pacing_timer(struct hrtimer *timer)
+{
+	struct kgsl_pwrscale *psc = container_of(timer, struct kgsl_pwrscale,
+						pacing.timer);
+
+	queue_work(psc->devfreq_wq, &psc->pacing.risk_ws);
+
+	return HRTIMER_NORESTART;
+}
+
 /*
  * kgsl_pwrscale_disable - temporarily disable the governor
  * @device: The device
@@ -321,6 +474,11 @@ int kgsl_devfreq_target(struct device *dev, unsigned long *freq, u32 flags)
 		return 0;
 
 	pwr = &device->pwrctrl;
+	if (_pacing_active(&device->pwrscale)) {
+		*freq = kgsl_pwrctrl_active_freq(pwr);
+		return 0;
+	}
+
 	if (_check_maxfreq(flags)) {
 		/*
 		 * The GPU is about to get suspended,
@@ -789,6 +947,12 @@ int kgsl_pwrscale_init(struct device *dev, const char *governor)
 		INIT_WORK(&kgsl_midframe->timer_check_ws,
 				kgsl_pwrscale_midframe_timer_check);
 
+	INIT_WORK(&pwrscale->pacing.frame_ws, do_pacing_frame);
+	INIT_WORK(&pwrscale->pacing.risk_ws, do_pacing_risk);
+	hrtimer_init(&pwrscale->pacing.timer, CLOCK_MONOTONIC,
+			HRTIMER_MODE_REL);
+	pwrscale->pacing.timer.function = kgsl_pwrscale_pacing_timer;
+
 	pwrscale->next_governor_call = ktime_add_us(ktime_get(),
 			KGSL_GOVERNOR_CALL_INTERVAL);
 
@@ -832,6 +996,7 @@ void kgsl_pwrscale_close(struct kgsl_device *device)
 		devfreq_cooling_unregister(pwrscale->cooling_dev);
 
 	kgsl_pwrscale_midframe_timer_cancel(device);
+	hrtimer_cancel(&pwrscale->pacing.timer);
 	flush_workqueue(pwrscale->devfreq_wq);
 	destroy_workqueue(pwrscale->devfreq_wq);
 	devfreq_remove_device(device->pwrscale.devfreqptr);
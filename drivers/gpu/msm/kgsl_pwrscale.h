@@ -52,6 +52,35 @@ struct kgsl_pwr_history {
 	unsigned int size;
 };
 
+/* Default share of the frame period the GPU is planned to be busy, in % */
+#define KGSL_PACING_HEADROOM	75
+
+/**
+ * struct kgsl_pwrscale_pacing - Frame pacing DCVS state
+ * @period_us - Target frame period, 0 when frame pacing is disabled
+ * @headroom - Share of the period (in %) a frame is planned to take
+ * @in_frame - True between the first submission of a frame and its end
+ * @frame_start - Time of the first submission of the current frame
+ * @budget_us - GPU time budget of the current frame
+ * @busy_cycles - GPU cycles spent busy on the current frame
+ * @last_frame - Time the last frame ended
+ * @timer - Fires when the current frame is at risk of missing its budget
+ * @frame_ws - Picks the power level for the next frame
+ * @risk_ws - Ramps up the power level of a late frame
+ */
+struct kgsl_pwrscale_pacing {
+	unsigned int period_us;
+	unsigned int headroom;
+	bool in_frame;
+	ktime_t frame_start;
+	u64 budget_us;
+	u64 busy_cycles;
+	ktime_t last_frame;
+	struct hrtimer timer;
+	struct work_struct frame_ws;
+	struct work_struct risk_ws;
+};
+
 /**
  * struct kgsl_pwrscale - Power scaling settings for a KGSL device
  * @devfreqptr - Pointer to the devfreq device
@@ -78,6 +107,7 @@ struct kgsl_pwr_history {
  * ctxt aware power level jump
  * @ctxt_aware_target_pwrlevel - pwrlevel to jump on in case of ctxt aware
  * power level jump
+ * @pacing - Frame pacing DCVS state
  */
 struct kgsl_pwrscale {
 	struct devfreq *devfreqptr;
@@ -101,6 +131,7 @@ struct kgsl_pwrscale {
 	bool ctxt_aware_enable;
 	unsigned int ctxt_aware_target_pwrlevel;
 	unsigned int ctxt_aware_busy_penalty;
+	struct kgsl_pwrscale_pacing pacing;
 };
 
 int kgsl_pwrscale_init(struct device *dev, const char *governor);
@@ -115,6 +146,9 @@ void kgsl_pwrscale_wake(struct kgsl_device *device);
 void kgsl_pwrscale_midframe_timer_restart(struct kgsl_device *device);
 void kgsl_pwrscale_midframe_timer_cancel(struct kgsl_device *device);
 
+void kgsl_pwrscale_frame_start(struct kgsl_device *device);
+void kgsl_pwrscale_frame_end(struct kgsl_device *device, u64 deadline);
+
 void kgsl_pwrscale_enable(struct kgsl_device *device);
 void kgsl_pwrscale_disable(struct kgsl_device *device, bool turbo);
 
@@ -147,5 +181,6 @@ int kgsl_busmon_get_cur_freq(struct device *dev, unsigned long *freq);
 	.history[KGSL_PWREVENT_STATE].size = 20, \
 	.history[KGSL_PWREVENT_GPU_FREQ].size = 3, \
 	.history[KGSL_PWREVENT_BUS_FREQ].size = 5, \
+	.pacing.headroom = KGSL_PACING_HEADROOM, \
 	}
 #endif
@@ -0,0 +1,464 @@
+/* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/highmem.h>
+#include <linux/oom.h>
+#include <linux/sched/signal.h>
+#include <linux/shmem_fs.h>
+#include <linux/workqueue.h>
+
+#include "kgsl.h"
+#include "kgsl_device.h"
+#include "kgsl_pool.h"
+#include "kgsl_reclaim.h"
+#include "kgsl_sharedmem.h"
+
+/*
+ * Buffers of a process that is in the background and has no work on the
+ * GPU are copied into a shmem file, unmapped from the GPU and their pages
+ * handed back. The shmem pages sit on the LRU like any other anonymous
+ * memory and can be swapped out (to zram on most targets). Everything is
+ * brought back before the process submits again or maps a buffer.
+ *
+ * A process is reclaimed when userspace writes "background" to its
+ * /sys/class/kgsl/kgsl/proc/<pid>/state file, or, if reclaim_oom_adj is
+ * set, when its oom_score_adj is at or above that value.
+ */
+
+/* How often the oom_score_adj based reclaim looks for processes */
+#define KGSL_RECLAIM_PERIOD (10 * HZ)
+
+/* Anything above OOM_SCORE_ADJ_MAX disables the oom_score_adj trigger */
+static int kgsl_reclaim_oom_adj = OOM_SCORE_ADJ_MAX + 1;
+
+static void kgsl_reclaim_worker(struct work_struct *work);
+static DECLARE_DELAYED_WORK(kgsl_reclaim_work, kgsl_reclaim_worker);
+
+static bool kgsl_reclaim_entry_eligible(struct kgsl_mem_entry *entry)
+{
+	struct kgsl_memdesc *memdesc = &entry->memdesc;
+
+	if (kgsl_memdesc_usermem_type(memdesc) != KGSL_MEM_ENTRY_KERNEL)
+		return false;
+
+	if (memdesc->flags & (KGSL_MEMFLAGS_SECURE |
+			KGSL_MEMFLAGS_SPARSE_VIRT | KGSL_MEMFLAGS_SPARSE_PHYS))
+		return false;
+
+	if (memdesc->priv & (KGSL_MEMDESC_RECLAIMED | KGSL_MEMDESC_GLOBAL |
+			KGSL_MEMDESC_CONTIG | KGSL_MEMDESC_SECURE))
+		return false;
+
+	if (!(memdesc->priv & KGSL_MEMDESC_MAPPED) || !memdesc->pagetable)
+		return false;
+
+	/* Mapped to the CPU, either in userspace or in the kernel */
+	if (atomic_read(&entry->map_count) || memdesc->hostptr)
+		return false;
+
+	return memdesc->pages && memdesc->page_count && !memdesc->sgt &&
+		!memdesc->cur_bindings && !entry->pending_free;
+}
+
+/* Caller must hold the process reclaim_sem for write */
+static int kgsl_reclaim_entry(struct kgsl_process_private *process,
+		struct kgsl_mem_entry *entry)
+{
+	struct kgsl_memdesc *memdesc = &entry->memdesc;
+	struct file *filp;
+	unsigned int i;
+	int ret;
+
+	filp = shmem_file_setup("kgsl-reclaim", memdesc->size, VM_NORESERVE);
+	if (IS_ERR(filp))
+		return PTR_ERR(filp);
+
+	/* Make sure the copy sees what the GPU wrote and not a stale line */
+	kgsl_cache_range_op(memdesc, 0, memdesc->size, KGSL_CACHE_OP_FLUSH);
+
+	for (i = 0; i < memdesc->page_count; i++) {
+		struct page *page;
+
+		page = shmem_read_mapping_page(filp->f_mapping, i);
+		if (IS_ERR(page)) {
+			ret = PTR_ERR(page);
+			goto err;
+		}
+
+		copy_highpage(page, memdesc->pages[i]);
+		set_page_dirty(page);
+		put_page(page);
+	}
+
+	/* The GPU address stays reserved so the restore maps it back there */
+	ret = kgsl_mmu_unmap(memdesc->pagetable, memdesc);
+	if (ret)
+		goto err;
+
+	kgsl_pool_free_pages(memdesc->pages, memdesc->page_count);
+	memset(memdesc->pages, 0, memdesc->page_count * sizeof(struct page *));
+	memdesc->page_count = 0;
+
+	memdesc->shmem_filp = filp;
+	memdesc->priv |= KGSL_MEMDESC_RECLAIMED;
+
+	atomic_long_sub(memdesc->size, &kgsl_driver.stats.page_alloc);
+	atomic64_add(memdesc->size, &process->reclaimed);
+
+	return 0;
+err:
+	fput(filp);
+	return ret;
+}
+
+/* Caller must hold the process reclaim_sem for write */
+static int kgsl_reclaim_restore_entry(struct kgsl_process_private *process,
+		struct kgsl_mem_entry *entry)
+{
+	struct kgsl_memdesc *memdesc = &entry->memdesc;
+	unsigned int i, count = memdesc->size >> PAGE_SHIFT;
+	int ret;
+
+	for (i = 0; i < count; i++) {
+		int page_size = PAGE_SIZE;
+		unsigned int align = PAGE_SHIFT;
+		struct page *page;
+
+		ret = kgsl_pool_alloc_page(&page_size, memdesc->pages + i,
+				count - i, &align);
+		if (ret <= 0) {
+			ret = -ENOMEM;
+			goto err;
+		}
+
+		page = shmem_read_mapping_page(memdesc->shmem_filp->f_mapping,
+				i);
+		if (IS_ERR(page)) {
+			kgsl_pool_free_page(memdesc->pages[i]);
+			ret = PTR_ERR(page);
+			goto err;
+		}
+
+		copy_highpage(memdesc->pages[i], page);
+		put_page(page);
+	}
+
+	memdesc->page_count = count;
+	memdesc->priv &= ~KGSL_MEMDESC_RECLAIMED;
+
+	/* The GPU may not be coherent with what the copy left in the cache */
+	kgsl_cache_range_op(memdesc, 0, memdesc->size, KGSL_CACHE_OP_FLUSH);
+
+	ret = kgsl_mmu_map(memdesc->pagetable, memdesc);
+	if (ret) {
+		memdesc->page_count = 0;
+		memdesc->priv |= KGSL_MEMDESC_RECLAIMED;
+		goto err;
+	}
+
+	fput(memdesc->shmem_filp);
+	memdesc->shmem_filp = NULL;
+
+	KGSL_STATS_ADD(memdesc->size, &kgsl_driver.stats.page_alloc,
+		&kgsl_driver.stats.page_alloc_max);
+	atomic64_sub(memdesc->size, &process->reclaimed);
+
+	return 0;
+err:
+	kgsl_pool_free_pages(memdesc->pages, i);
+	memset(memdesc->pages, 0, count * sizeof(struct page *));
+	return ret;
+}
+
+/*
+ * Call func for each memory entry of the process and stop at the first
+ * error. The entry is referenced, and mem_lock dropped, around the call.
+ */
+static int kgsl_reclaim_for_each_entry(struct kgsl_process_private *process,
+		int (*func)(struct kgsl_process_private *,
+			struct kgsl_mem_entry *))
+{
+	struct kgsl_mem_entry *entry;
+	int id = 0, ret = 0;
+
+	spin_lock(&process->mem_lock);
+	for (entry = idr_get_next(&process->mem_idr, &id); entry;
+		id++, entry = idr_get_next(&process->mem_idr, &id)) {
+
+		if (kgsl_mem_entry_get(entry) == 0)
+			continue;
+		spin_unlock(&process->mem_lock);
+
+		ret = func(process, entry);
+
+		kgsl_mem_entry_put(entry);
+		spin_lock(&process->mem_lock);
+
+		if (ret)
+			break;
+	}
+	spin_unlock(&process->mem_lock);
+
+	return ret;
+}
+
+static int _reclaim_entry(struct kgsl_process_private *process,
+		struct kgsl_mem_entry *entry)
+{
+	if (!kgsl_reclaim_entry_eligible(entry))
+		return 0;
+
+	return kgsl_reclaim_entry(process, entry);
+}
+
+static int _restore_entry(struct kgsl_process_private *process,
+		struct kgsl_mem_entry *entry)
+{
+	if (!(entry->memdesc.priv & KGSL_MEMDESC_RECLAIMED))
+		return 0;
+
+	return kgsl_reclaim_restore_entry(process, entry);
+}
+
+/* Caller must hold the process reclaim_sem for write */
+static int kgsl_reclaim_restore(struct kgsl_process_private *process)
+{
+	int ret;
+
+	if (!test_bit(KGSL_PROCESS_RECLAIMED, &process->priv))
+		return 0;
+
+	ret = kgsl_reclaim_for_each_entry(process, _restore_entry);
+	if (!ret)
+		clear_bit(KGSL_PROCESS_RECLAIMED, &process->priv);
+
+	return ret;
+}
+
+/* True if every context of the process has retired all it queued */
+static bool kgsl_reclaim_process_idle(struct kgsl_process_private *process)
+{
+	struct kgsl_device *device = kgsl_get_device(KGSL_DEVICE_3D0);
+	struct kgsl_context *context;
+	unsigned int queued, retired;
+	bool idle = true;
+	int id;
+
+	if (device == NULL)
+		return false;
+
+	read_lock(&device->context_lock);
+	idr_for_each_entry(&device->context_idr, context, id) {
+		if (context->proc_priv != process)
+			continue;
+
+		kgsl_readtimestamp(device, context, KGSL_TIMESTAMP_QUEUED,
+			&queued);
+		kgsl_readtimestamp(device, context, KGSL_TIMESTAMP_RETIRED,
+			&retired);
+
+		if (timestamp_cmp(queued, retired) > 0) {
+			idle = false;
+			break;
+		}
+	}
+	read_unlock(&device->context_lock);
+
+	return idle;
+}
+
+/* Returns false if the process was busy and should be tried again later */
+static bool kgsl_reclaim_process(struct kgsl_process_private *process)
+{
+	bool idle;
+
+	down_write(&process->reclaim_sem);
+
+	idle = kgsl_reclaim_process_idle(process);
+	if (idle) {
+		/*
+		 * Set the flag first, entries reclaimed before an error
+		 * still have to be restored
+		 */
+		set_bit(KGSL_PROCESS_RECLAIMED, &process->priv);
+		kgsl_reclaim_for_each_entry(process, _reclaim_entry);
+	}
+
+	up_write(&process->reclaim_sem);
+
+	return idle;
+}
+
+static bool kgsl_reclaim_oom_adj_match(struct kgsl_process_private *process,
+		int threshold)
+{
+	struct task_struct *task;
+	bool ret = false;
+
+	if (threshold > OOM_SCORE_ADJ_MAX)
+		return false;
+
+	task = get_pid_task(process->pid, PIDTYPE_PID);
+	if (task) {
+		ret = task->signal->oom_score_adj >= threshold;
+		put_task_struct(task);
+	}
+
+	return ret;
+}
+
+static void kgsl_reclaim_worker(struct work_struct *work)
+{
+	struct kgsl_process_private *process;
+	int threshold = READ_ONCE(kgsl_reclaim_oom_adj);
+	bool requeue = threshold <= OOM_SCORE_ADJ_MAX;
+
+	mutex_lock(&kgsl_driver.process_mutex);
+	list_for_each_entry(process, &kgsl_driver.process_list, list) {
+		if (!test_bit(KGSL_PROCESS_BACKGROUND, &process->priv) &&
+			!kgsl_reclaim_oom_adj_match(process, threshold))
+			continue;
+
+		if (!kgsl_reclaim_process(process))
+			requeue = true;
+	}
+	mutex_unlock(&kgsl_driver.process_mutex);
+
+	if (requeue)
+		queue_delayed_work(kgsl_driver.mem_workqueue,
+			&kgsl_reclaim_work, KGSL_RECLAIM_PERIOD);
+}
+
+/**
+ * kgsl_reclaim_start() - Bring back the buffers of a process before use
+ * @process: Process that is about to submit or map memory
+ *
+ * Restore anything that was reclaimed from @process and keep it from being
+ * reclaimed again until kgsl_reclaim_end() is called. Return 0 on success
+ * or a negative error code if the buffers could not be restored.
+ */
+int kgsl_reclaim_start(struct kgsl_process_private *process)
+{
+	int ret;
+
+	down_read(&process->reclaim_sem);
+	if (!test_bit(KGSL_PROCESS_RECLAIMED, &process->priv))
+		return 0;
+
+	up_read(&process->reclaim_sem);
+
+	down_write(&process->reclaim_sem);
+	ret = kgsl_reclaim_restore(process);
+	downgrade_write(&process->reclaim_sem);
+
+	if (ret)
+		up_read(&process->reclaim_sem);
+
+	return ret;
+}
+
+/**
+ * kgsl_reclaim_end() - Allow the buffers of a process to be reclaimed again
+ * @process: Process passed to a successful kgsl_reclaim_start()
+ */
+void kgsl_reclaim_end(struct kgsl_process_private *process)
+{
+	up_read(&process->reclaim_sem);
+}
+
+ssize_t kgsl_reclaim_state_show(struct kgsl_process_private *process,
+		int type, char *buf)
+{
+	return scnprintf(buf, PAGE_SIZE, "%s\n",
+		test_bit(KGSL_PROCESS_BACKGROUND, &process->priv) ?
+			"background" : "foreground");
+}
+
+ssize_t kgsl_reclaim_state_store(struct kgsl_process_private *process,
+		int type, const char *buf, size_t count)
+{
+	int ret = 0;
+
+	if (sysfs_streq(buf, "background")) {
+		if (!test_and_set_bit(KGSL_PROCESS_BACKGROUND, &process->priv))
+			mod_delayed_work(kgsl_driver.mem_workqueue,
+				&kgsl_reclaim_work, 0);
+	} else if (sysfs_streq(buf, "foreground")) {
+		clear_bit(KGSL_PROCESS_BACKGROUND, &process->priv);
+
+		/* Don't make the first frame in the foreground wait for it */
+		down_write(&process->reclaim_sem);
+		ret = kgsl_reclaim_restore(process);
+		up_write(&process->reclaim_sem);
+	} else {
+		return -EINVAL;
+	}
+
+	return ret ? ret : count;
+}
+
+ssize_t kgsl_reclaim_size_show(struct kgsl_process_private *process,
+		int type, char *buf)
+{
+	return scnprintf(buf, PAGE_SIZE, "%llu\n",
+			(u64)atomic64_read(&process->reclaimed));
+}
+
+static ssize_t reclaim_oom_adj_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	int ret, val;
+
+	ret = kstrtoint(buf, 0, &val);
+	if (ret)
+		return ret;
+
+	if (val < OOM_SCORE_ADJ_MIN || val > OOM_SCORE_ADJ_MAX + 1)
+		return -EINVAL;
+
+	WRITE_ONCE(kgsl_reclaim_oom_adj, val);
+
+	if (val <= OOM_SCORE_ADJ_MAX)
+		mod_delayed_work(kgsl_driver.mem_workqueue,
+			&kgsl_reclaim_work, 0);
+
+	return count;
+}
+
+static ssize_t reclaim_oom_adj_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%d\n",
+		READ_ONCE(kgsl_reclaim_oom_adj));
+}
+
+static DEVICE_ATTR(reclaim_oom_adj, 0644, reclaim_oom_adj_show,
+		reclaim_oom_adj_store);
+
+static const struct device_attribute *reclaim_attr_list[] = {
+	&dev_attr_reclaim_oom_adj,
+	NULL
+};
+
+int kgsl_reclaim_init(void)
+{
+	return kgsl_create_device_sysfs_files(&kgsl_driver.virtdev,
+		reclaim_attr_list);
+}
+
+void kgsl_reclaim_close(void)
+{
+	cancel_delayed_work_sync(&kgsl_reclaim_work);
+	kgsl_remove_device_sysfs_files(&kgsl_driver.virtdev,
+		reclaim_attr_list);
+}
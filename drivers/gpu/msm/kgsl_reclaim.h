@@ -0,0 +1,48 @@
+/* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#ifndef __KGSL_RECLAIM_H
+#define __KGSL_RECLAIM_H
+
+struct kgsl_process_private;
+
+#ifdef CONFIG_QCOM_KGSL_PROCESS_RECLAIM
+int kgsl_reclaim_init(void);
+void kgsl_reclaim_close(void);
+int kgsl_reclaim_start(struct kgsl_process_private *process);
+void kgsl_reclaim_end(struct kgsl_process_private *process);
+ssize_t kgsl_reclaim_state_show(struct kgsl_process_private *process,
+		int type, char *buf);
+ssize_t kgsl_reclaim_state_store(struct kgsl_process_private *process,
+		int type, const char *buf, size_t count);
+ssize_t kgsl_reclaim_size_show(struct kgsl_process_private *process,
+		int type, char *buf);
+#else
+static inline int kgsl_reclaim_init(void)
+{
+	return 0;
+}
+
+static inline void kgsl_reclaim_close(void)
+{
+}
+
+static inline int kgsl_reclaim_start(struct kgsl_process_private *process)
+{
+	return 0;
+}
+
+static inline void kgsl_reclaim_end(struct kgsl_process_private *process)
+{
+}
+#endif
+#endif /* __KGSL_RECLAIM_H */
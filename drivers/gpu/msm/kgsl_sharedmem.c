@@ -17,6 +17,7 @@
 #include <linux/slab.h>
 #include <linux/kmemleak.h>
 #include <linux/highmem.h>
+#include <linux/file.h>
 #include <linux/scatterlist.h>
 #include <soc/qcom/scm.h>
 #include <soc/qcom/secure_buffer.h>
@@ -27,6 +28,7 @@
 #include "kgsl_device.h"
 #include "kgsl_log.h"
 #include "kgsl_mmu.h"
+#include "kgsl_reclaim.h"
 
 /*
  * The user can set this from debugfs to force failed memory allocations to
@@ -37,6 +39,14 @@
 
 static bool sharedmem_noretry_flag;
 
+/*
+ * Back allocations of 2MB and up with physically contiguous 2MB chunks
+ * where the buddy allocator has them, so the SMMU maps them with 2MB
+ * blocks instead of 4K PTEs and far fewer TLB entries. Chunks that
+ * can't be had without reclaim fall back to the smaller sizes.
+ */
+static bool sharedmem_large_pages_flag;
+
 static DEFINE_MUTEX(kernel_map_global_lock);
 
 struct cp2_mem_chunks {
@@ -60,6 +70,8 @@ struct kgsl_mem_entry_attribute {
 	int memtype;
 	ssize_t (*show)(struct kgsl_process_private *priv,
 		int type, char *buf);
+	ssize_t (*store)(struct kgsl_process_private *priv,
+		int type, const char *buf, size_t count);
 };
 
 #define to_mem_entry_attr(a) \
@@ -72,6 +84,14 @@ container_of(a, struct kgsl_mem_entry_attribute, attr)
 	.show = _show, \
 }
 
+#define __MEM_ENTRY_ATTR_RW(_type, _name, _show, _store) \
+{ \
+	.attr = { .name = __stringify(_name), .mode = 0644 }, \
+	.memtype = _type, \
+	.show = _show, \
+	.store = _store, \
+}
+
 /*
  * A structure to hold the attributes for a particular memory type.
  * For each memory type in each process we store the current and maximum
@@ -162,11 +182,24 @@ gpumem_unmapped_show(struct kgsl_process_private *priv, int type, char *buf)
 			gpumem_total - gpumem_mapped);
 }
 
+static ssize_t
+gpu_time_us_show(struct kgsl_process_private *priv, int type, char *buf)
+{
+	return scnprintf(buf, PAGE_SIZE, "%llu\n",
+		div_u64(atomic64_read(&priv->gpu_time_ns), NSEC_PER_USEC));
+}
+
 static struct kgsl_mem_entry_attribute debug_memstats[] = {
 	__MEM_ENTRY_ATTR(0, imported_mem, imported_mem_show),
 	__MEM_ENTRY_ATTR(0, gpumem_mapped, gpumem_mapped_show),
 	__MEM_ENTRY_ATTR(KGSL_MEM_ENTRY_KERNEL, gpumem_unmapped,
 				gpumem_unmapped_show),
+	__MEM_ENTRY_ATTR(0, gpu_time_us, gpu_time_us_show),
+#ifdef CONFIG_QCOM_KGSL_PROCESS_RECLAIM
+	__MEM_ENTRY_ATTR_RW(0, state, kgsl_reclaim_state_show,
+				kgsl_reclaim_state_store),
+	__MEM_ENTRY_ATTR(0, gpumem_reclaimed, kgsl_reclaim_size_show),
+#endif
 };
 
 /**
@@ -216,6 +249,22 @@ static ssize_t mem_entry_sysfs_show(struct kobject *kobj,
 	return ret;
 }
 
+static ssize_t mem_entry_sysfs_store(struct kobject *kobj,
+	struct attribute *attr, const char *buf, size_t count)
+{
+	struct kgsl_mem_entry_attribute *pattr = to_mem_entry_attr(attr);
+	struct kgsl_process_private *priv;
+
+	/* See mem_entry_sysfs_show() for why no more locking is needed */
+	priv = kobj ? container_of(kobj, struct kgsl_process_private, kobj) :
+			NULL;
+
+	if (priv && pattr->store)
+		return pattr->store(priv, pattr->memtype, buf, count);
+
+	return -EIO;
+}
+
 static void mem_entry_release(struct kobject *kobj)
 {
 	struct kgsl_process_private *priv;
@@ -227,6 +276,7 @@ static void mem_entry_release(struct kobject *kobj)
 
 static const struct sysfs_ops mem_entry_sysfs_ops = {
 	.show = mem_entry_sysfs_show,
+	.store = mem_entry_sysfs_store,
 };
 
 static struct kobj_type ktype_mem_entry = {
@@ -329,6 +379,10 @@ static ssize_t kgsl_drv_memstat_show(struct device *dev,
 		val = atomic_long_read(&kgsl_driver.stats.mapped);
 	else if (!strcmp(attr->attr.name, "mapped_max"))
 		val = atomic_long_read(&kgsl_driver.stats.mapped_max);
+	else if (!strcmp(attr->attr.name, "large_page_alloc"))
+		val = atomic_long_read(&kgsl_driver.stats.large_page_alloc);
+	else if (!strcmp(attr->attr.name, "large_page_fallback"))
+		val = atomic_long_read(&kgsl_driver.stats.large_page_fallback);
 
 	return snprintf(buf, PAGE_SIZE, "%llu\n", val);
 }
@@ -356,6 +410,28 @@ static ssize_t kgsl_drv_full_cache_threshold_show(struct device *dev,
 			kgsl_driver.full_cache_threshold);
 }
 
+static ssize_t kgsl_drv_large_pages_store(struct device *dev,
+					 struct device_attribute *attr,
+					 const char *buf, size_t count)
+{
+	int ret;
+	unsigned int val = 0;
+
+	ret = kgsl_sysfs_store(buf, &val);
+	if (ret)
+		return ret;
+
+	sharedmem_large_pages_flag = val ? true : false;
+	return count;
+}
+
+static ssize_t kgsl_drv_large_pages_show(struct device *dev,
+					struct device_attribute *attr,
+					char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%d\n", sharedmem_large_pages_flag);
+}
+
 static DEVICE_ATTR(vmalloc, 0444, kgsl_drv_memstat_show, NULL);
 static DEVICE_ATTR(vmalloc_max, 0444, kgsl_drv_memstat_show, NULL);
 static DEVICE_ATTR(page_alloc, 0444, kgsl_drv_memstat_show, NULL);
@@ -369,6 +445,10 @@ static DEVICE_ATTR(mapped_max, 0444, kgsl_drv_memstat_show, NULL);
 static DEVICE_ATTR(full_cache_threshold, 0644,
 		kgsl_drv_full_cache_threshold_show,
 		kgsl_drv_full_cache_threshold_store);
+static DEVICE_ATTR(large_pages, 0644, kgsl_drv_large_pages_show,
+		kgsl_drv_large_pages_store);
+static DEVICE_ATTR(large_page_alloc, 0444, kgsl_drv_memstat_show, NULL);
+static DEVICE_ATTR(large_page_fallback, 0444, kgsl_drv_memstat_show, NULL);
 
 static const struct device_attribute *drv_attr_list[] = {
 	&dev_attr_vmalloc,
@@ -382,6 +462,9 @@ static const struct device_attribute *drv_attr_list[] = {
 	&dev_attr_mapped,
 	&dev_attr_mapped_max,
 	&dev_attr_full_cache_threshold,
+	&dev_attr_large_pages,
+	&dev_attr_large_page_alloc,
+	&dev_attr_large_page_fallback,
 	NULL
 };
 
@@ -543,6 +626,13 @@ static void kgsl_page_alloc_free(struct kgsl_memdesc *memdesc)
 	/* we certainly do not expect the hostptr to still be mapped */
 	BUG_ON(memdesc->hostptr);
 
+	/* The pages went back when it was reclaimed, only the copy is left */
+	if (memdesc->priv & KGSL_MEMDESC_RECLAIMED) {
+		fput(memdesc->shmem_filp);
+		memdesc->shmem_filp = NULL;
+		return;
+	}
+
 	/* Secure buffers need to be unlocked before being freed */
 	if (memdesc->priv & KGSL_MEMDESC_TZ_LOCKED) {
 		int ret;
@@ -583,6 +673,9 @@ static int kgsl_page_alloc_map_kernel(struct kgsl_memdesc *memdesc)
 	if (memdesc->size > ULONG_MAX)
 		return -ENOMEM;
 
+	if (memdesc->priv & KGSL_MEMDESC_RECLAIMED)
+		return -EBUSY;
+
 	mutex_lock(&kernel_map_global_lock);
 	if ((!memdesc->hostptr) && (memdesc->pages != NULL)) {
 		pgprot_t page_prot = pgprot_writecombine(PAGE_KERNEL);
@@ -765,6 +858,10 @@ int kgsl_cache_range_op(struct kgsl_memdesc *memdesc, uint64_t offset,
 	if (offset + size > memdesc->size)
 		return -ERANGE;
 
+	/* Nothing is left in the CPU caches for reclaimed memory */
+	if (memdesc->priv & KGSL_MEMDESC_RECLAIMED)
+		return 0;
+
 	if (memdesc->hostptr) {
 		addr = memdesc->hostptr;
 		/* Make sure the offset + size do not overflow the address */
@@ -883,6 +980,17 @@ kgsl_sharedmem_page_alloc_user(struct kgsl_memdesc *memdesc,
 	if (align < ilog2(SZ_1M))
 		align = ilog2(SZ_1M);
 
+	/*
+	 * 2MB chunks only become 2MB SMMU blocks if the GPU address is
+	 * 2MB aligned as well, so that one is recorded in the memdesc.
+	 */
+	if (sharedmem_large_pages_flag && size >= SZ_2M &&
+			!(memdesc->flags & KGSL_MEMFLAGS_SECURE)) {
+		align = max_t(unsigned int, align, ilog2(SZ_2M));
+		if (kgsl_memdesc_get_align(memdesc) < ilog2(SZ_2M))
+			kgsl_memdesc_set_align(memdesc, ilog2(SZ_2M));
+	}
+
 	page_size = kgsl_get_page_size(size, align);
 
 	/*
@@ -1464,3 +1572,8 @@ bool kgsl_sharedmem_get_noretry(void)
 {
 	return sharedmem_noretry_flag;
 }
+
+bool kgsl_sharedmem_get_large_pages(void)
+{
+	return sharedmem_large_pages_flag;
+}
@@ -16,6 +16,9 @@
 #include <linux/utsname.h>
 #include <linux/sched.h>
 #include <linux/idr.h>
+#include <linux/vmalloc.h>
+#include <linux/devcoredump.h>
+#include <linux/lz4.h>
 
 #include "kgsl.h"
 #include "kgsl_log.h"
@@ -1015,6 +1018,27 @@ static ssize_t timestamp_show(struct kgsl_device *device, char *buf)
 	return snprintf(buf, PAGE_SIZE, "%lu\n", timestamp);
 }
 
+static ssize_t snapshot_devcoredump_show(struct kgsl_device *device,
+	char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%d\n", device->snapshot_devcoredump);
+}
+
+static ssize_t snapshot_devcoredump_store(struct kgsl_device *device,
+	const char *buf, size_t count)
+{
+	unsigned int val = 0;
+	int ret;
+
+	ret = kgsl_sysfs_store(buf, &val);
+
+	if (!ret && device)
+		device->snapshot_devcoredump =
+			IS_ENABLED(CONFIG_QCOM_KGSL_SNAPSHOT_COREDUMP) && val;
+
+	return (ssize_t) ret < 0 ? ret : count;
+}
+
 static ssize_t snapshot_legacy_show(struct kgsl_device *device, char *buf)
 {
 	return snprintf(buf, PAGE_SIZE, "%d\n", device->snapshot_legacy);
@@ -1057,6 +1081,8 @@ static SNAPSHOT_ATTR(snapshot_crashdumper, 0644, snapshot_crashdumper_show,
 	snapshot_crashdumper_store);
 static SNAPSHOT_ATTR(snapshot_legacy, 0644, snapshot_legacy_show,
 	snapshot_legacy_store);
+static SNAPSHOT_ATTR(devcoredump, 0644, snapshot_devcoredump_show,
+	snapshot_devcoredump_store);
 
 static ssize_t snapshot_sysfs_show(struct kobject *kobj,
 	struct attribute *attr, char *buf)
@@ -1139,6 +1165,8 @@ int kgsl_device_snapshot_init(struct kgsl_device *device)
 	device->force_panic = 0;
 	device->snapshot_crashdumper = 1;
 	device->snapshot_legacy = 0;
+	device->snapshot_devcoredump =
+		IS_ENABLED(CONFIG_QCOM_KGSL_SNAPSHOT_COREDUMP);
 
 	/*
 	 * Set this to false so that we only ever keep the first snapshot around
@@ -1181,6 +1209,11 @@ int kgsl_device_snapshot_init(struct kgsl_device *device)
 
 	ret  = sysfs_create_file(&device->snapshot_kobj,
 			&attr_snapshot_legacy.attr);
+	if (ret)
+		goto done;
+
+	ret  = sysfs_create_file(&device->snapshot_kobj,
+			&attr_devcoredump.attr);
 
 done:
 	return ret;
@@ -1276,6 +1309,83 @@ static size_t _mempool_add_object(struct kgsl_snapshot *snapshot, u8 *data,
 	return section->size;
 }
 
+#ifdef CONFIG_QCOM_KGSL_SNAPSHOT_COREDUMP
+static size_t _lz4_add_block(u8 *dst, size_t avail, const void *src,
+		size_t size, void *wrkmem)
+{
+	struct kgsl_snapshot_lz4_block *block =
+		(struct kgsl_snapshot_lz4_block *) dst;
+	int ret;
+
+	if (!size || avail < sizeof(*block))
+		return 0;
+
+	ret = LZ4_compress_default(src, dst + sizeof(*block), size,
+		avail - sizeof(*block), wrkmem);
+	if (ret <= 0)
+		return 0;
+
+	block->magic = SNAPSHOT_LZ4_MAGIC;
+	block->raw_size = size;
+	block->size = ret;
+
+	return sizeof(*block) + ret;
+}
+
+/*
+ * Compress the finished snapshot into a devcoredump, one block for the
+ * static region and one for the frozen GPU objects, then let go of the
+ * snapshot so the static region is free for the next fault. Returns
+ * false if the snapshot should stay in the sysfs node instead.
+ */
+static bool kgsl_snapshot_devcoredump(struct kgsl_device *device,
+		struct kgsl_snapshot *snapshot)
+{
+	struct kgsl_snapshot_section_header end = {
+		.magic = SNAPSHOT_SECTION_MAGIC,
+		.id = KGSL_SNAPSHOT_SECTION_END,
+		.size = sizeof(end),
+	};
+	size_t bound, len = 0;
+	void *wrkmem;
+	u8 *buf;
+
+	bound = 3 * sizeof(struct kgsl_snapshot_lz4_block) +
+		LZ4_compressBound(snapshot->size) +
+		LZ4_compressBound(snapshot->mempool_size) +
+		LZ4_compressBound(sizeof(end));
+
+	buf = vmalloc(bound);
+	wrkmem = vmalloc(LZ4_MEM_COMPRESS);
+	if (buf == NULL || wrkmem == NULL) {
+		vfree(buf);
+		vfree(wrkmem);
+		return false;
+	}
+
+	len += _lz4_add_block(buf + len, bound - len, snapshot->start,
+		snapshot->size, wrkmem);
+	len += _lz4_add_block(buf + len, bound - len, snapshot->mempool,
+		snapshot->mempool_size, wrkmem);
+	len += _lz4_add_block(buf + len, bound - len, &end, sizeof(end),
+		wrkmem);
+	vfree(wrkmem);
+
+	KGSL_DRV_ERR(device, "snapshot: %zu bytes compressed to devcoredump\n",
+		len);
+
+	/* devcoredump owns the buffer from here on */
+	dev_coredumpv(device->dev, buf, len, GFP_KERNEL);
+	return true;
+}
+#else
+static bool kgsl_snapshot_devcoredump(struct kgsl_device *device,
+		struct kgsl_snapshot *snapshot)
+{
+	return false;
+}
+#endif
+
 /**
  * kgsl_snapshot_save_frozen_objs() - Save the objects frozen in snapshot into
  * memory so that the data reported in these objects is correct when snapshot
@@ -1346,4 +1456,20 @@ static void kgsl_snapshot_save_frozen_objs(struct work_struct *work)
 gmu_only:
 	complete_all(&snapshot->dump_gate);
 	BUG_ON(device->force_panic);
+
+	if (device->snapshot_devcoredump &&
+		kgsl_snapshot_devcoredump(device, snapshot)) {
+		bool snapshot_free = false;
+
+		/* Leave it alone if a sysfs reader got to it first */
+		mutex_lock(&device->mutex);
+		if (device->snapshot == snapshot && !snapshot->sysfs_read) {
+			device->snapshot = NULL;
+			snapshot_free = true;
+		}
+		mutex_unlock(&device->mutex);
+
+		if (snapshot_free)
+			kgsl_free_snapshot(snapshot);
+	}
 }
@@ -280,6 +280,19 @@ struct kgsl_snapshot_gpu_object_v2 {
 	__u64 size;    /* Size of the object (in dwords) */
 } __packed;
 
+/*
+ * A devcoredump of a snapshot is a series of LZ4 compressed blocks, each
+ * one preceded by this header. Decompressed and concatenated they make up
+ * the same image as the snapshot sysfs node.
+ */
+#define SNAPSHOT_LZ4_MAGIC 0x504D4C5A
+
+struct kgsl_snapshot_lz4_block {
+	__u32 magic;    /* Magic identifier */
+	__u32 raw_size; /* Size of the block once decompressed */
+	__u32 size;     /* Size of the compressed data after this header */
+} __packed;
+
 void kgsl_snapshot_push_object(struct kgsl_process_private *process,
 	uint64_t gpuaddr, uint64_t dwords);
 #endif
@@ -107,7 +107,9 @@ struct kgsl_sync_fence_event_priv {
  * @priv: Private data for the callback
  * @result - Result of the event (retired or canceled)
  *
- * Signal a fence following the expiration of a timestamp
+ * Signal a fence following the expiration of a timestamp. Nothing in here
+ * sleeps, so this is registered as a fast event and runs straight from the
+ * retire path.
  */
 
 static void kgsl_sync_fence_event_cb(struct kgsl_device *device,
@@ -142,7 +144,7 @@ static int _add_fence_event(struct kgsl_device *device,
 	event->context = context;
 	event->timestamp = timestamp;
 
-	ret = kgsl_add_event(device, &context->events, timestamp,
+	ret = kgsl_add_fast_event(device, &context->events, timestamp,
 		kgsl_sync_fence_event_cb, event);
 
 	if (ret) {
@@ -916,6 +916,28 @@ TRACE_EVENT(kgsl_fire_event,
 			__entry->age, __entry->func)
 );
 
+TRACE_EVENT(kgsl_event_latency,
+		TP_PROTO(unsigned int id, unsigned int ts, bool fast,
+			s64 latency),
+		TP_ARGS(id, ts, fast, latency),
+		TP_STRUCT__entry(
+			__field(unsigned int, id)
+			__field(unsigned int, ts)
+			__field(bool, fast)
+			__field(s64, latency)
+		),
+		TP_fast_assign(
+			__entry->id = id;
+			__entry->ts = ts;
+			__entry->fast = fast;
+			__entry->latency = latency;
+		),
+		TP_printk(
+			"ctx=%u ts=%u fast=%d latency=%lldns",
+			__entry->id, __entry->ts, __entry->fast,
+			__entry->latency)
+);
+
 TRACE_EVENT(kgsl_active_count,
 
 	TP_PROTO(struct kgsl_device *device, unsigned long ip),
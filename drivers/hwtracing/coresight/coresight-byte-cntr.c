@@ -30,8 +30,20 @@ static void tmc_etr_read_bytes(struct byte_cntr *byte_cntr_data, loff_t *ppos,
 			       size_t bytes, size_t *len, char **bufp)
 {
 	struct etr_buf *etr_buf = tmcdrvdata->etr_buf;
+	int nr_blocks = tmcdrvdata->size / bytes;
+	int pending = atomic_read(&byte_cntr_data->irq_cnt);
 	size_t actual;
 
+	/*
+	 * More blocks signalled than the buffer holds: the ETR has wrapped
+	 * over data nobody read yet. Count the lost blocks and only wait
+	 * for what is still in the buffer.
+	 */
+	if (nr_blocks && pending > nr_blocks) {
+		atomic_sub(pending - nr_blocks, &byte_cntr_data->irq_cnt);
+		atomic_add(pending - nr_blocks, &byte_cntr_data->overrun);
+	}
+
 	if (*len >= bytes)
 		*len = bytes;
 	else if (((uint32_t)*ppos % bytes) + *len > bytes)
@@ -43,15 +55,24 @@ static void tmc_etr_read_bytes(struct byte_cntr *byte_cntr_data, loff_t *ppos,
 		atomic_dec(&byte_cntr_data->irq_cnt);
 }
 
+static void etr_update_pending(struct byte_cntr *byte_cntr_data)
+{
+	int pending = atomic_inc_return(&byte_cntr_data->irq_cnt);
+
+	/* how far the reader lags behind the ETR, in blocks */
+	if (pending > byte_cntr_data->max_pending)
+		byte_cntr_data->max_pending = pending;
+}
+
 static irqreturn_t etr_handler(int irq, void *data)
 {
 	struct byte_cntr *byte_cntr_data = data;
 
 	if (tmcdrvdata->out_mode == TMC_ETR_OUT_MODE_MEM) {
-		atomic_inc(&byte_cntr_data->irq_cnt);
+		etr_update_pending(byte_cntr_data);
 		wake_up(&byte_cntr_data->wq);
 	} else if (tmcdrvdata->out_mode == TMC_ETR_OUT_MODE_PCIE) {
-		atomic_inc(&byte_cntr_data->irq_cnt);
+		etr_update_pending(byte_cntr_data);
 		wake_up(&byte_cntr_data->pcie_wait_wq);
 	}
 
@@ -151,6 +172,8 @@ void tmc_etr_byte_cntr_start(struct byte_cntr *byte_cntr_data)
 	}
 
 	atomic_set(&byte_cntr_data->irq_cnt, 0);
+	atomic_set(&byte_cntr_data->overrun, 0);
+	byte_cntr_data->max_pending = 0;
 	byte_cntr_data->enable = true;
 	mutex_unlock(&byte_cntr_data->byte_cntr_lock);
 }
@@ -190,6 +213,9 @@ int etr_pcie_start(struct byte_cntr *byte_cntr_data)
 	mutex_lock(&byte_cntr_data->byte_cntr_lock);
 	coresight_csr_set_byte_cntr(byte_cntr_data->csr, PCIE_BLK_SIZE / 8);
 	atomic_set(&byte_cntr_data->irq_cnt, 0);
+	atomic_set(&byte_cntr_data->overrun, 0);
+	byte_cntr_data->max_pending = 0;
+	byte_cntr_data->pcie_write_err = 0;
 	mutex_unlock(&byte_cntr_data->byte_cntr_lock);
 
 	if (!byte_cntr_data->pcie_chan_opened)
@@ -434,6 +460,7 @@ static void etr_pcie_write_work_fn(struct work_struct *work)
 		if (bytes_to_write != PCIE_BLK_SIZE) {
 			dev_err(tmcdrvdata->dev, "Write error %d\n",
 							bytes_to_write);
+			byte_cntr_data->pcie_write_err++;
 
 			kfree(req);
 			req = NULL;
@@ -511,6 +538,7 @@ struct byte_cntr *byte_cntr_init(struct amba_device *adev,
 	byte_cntr_data->byte_cntr_irq = byte_cntr_irq;
 	byte_cntr_data->csr = drvdata->csr;
 	atomic_set(&byte_cntr_data->irq_cnt, 0);
+	atomic_set(&byte_cntr_data->overrun, 0);
 	init_waitqueue_head(&byte_cntr_data->wq);
 	mutex_init(&byte_cntr_data->byte_cntr_lock);
 
@@ -16,6 +16,9 @@ struct byte_cntr {
 	uint32_t		block_size;
 	int			byte_cntr_irq;
 	atomic_t		irq_cnt;
+	atomic_t		overrun;
+	uint32_t		max_pending;
+	uint32_t		pcie_write_err;
 	wait_queue_head_t	wq;
 	wait_queue_head_t	pcie_wait_wq;
 	struct mutex		byte_cntr_lock;
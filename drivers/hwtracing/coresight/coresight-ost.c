@@ -13,6 +13,7 @@
 #include <linux/device.h>
 #include <linux/bitmap.h>
 #include <linux/io.h>
+#include <linux/jump_label.h>
 #include "coresight-ost.h"
 #include <linux/sched/clock.h>
 #include <linux/coresight-stm.h>
@@ -33,6 +34,15 @@
 
 static struct stm_drvdata *stmdrvdata;
 
+/*
+ * The last channel of each cpu range is kept for stm_marker(), out of
+ * reach of stm_channel_alloc(). Zero when the ranges are too small.
+ */
+static uint32_t stm_marker_stride;
+
+DEFINE_STATIC_KEY_FALSE(stm_marker_key);
+EXPORT_SYMBOL(stm_marker_key);
+
 static uint32_t stm_channel_alloc(void)
 {
 	struct stm_drvdata *drvdata = stmdrvdata;
@@ -241,6 +251,70 @@ int stm_trace(uint32_t flags, uint8_t entity_id, uint8_t proto_id,
 }
 EXPORT_SYMBOL(stm_trace);
 
+/*
+ * __stm_marker - slow side of stm_marker(), with the static key on
+ * @id: marker id, see STM_MARKER_ID()
+ * @val: marker argument
+ *
+ * A marker is one marked, timestamped packet of 64 bits, id in the upper
+ * half and val in the lower one, on the marker channel of the cpu: the
+ * STM adds the timestamp and the channel tells the cpu, so there is no
+ * header and no channel to allocate. With a 32 bit STM the marker takes
+ * a marked packet for the id and a timestamped one for val.
+ *
+ * CONTEXT:
+ * Can be called from any context.
+ */
+void notrace __stm_marker(uint32_t id, uint32_t val)
+{
+	struct stm_drvdata *drvdata = stmdrvdata;
+	void __iomem *ch_addr;
+	unsigned long flags;
+	uint32_t ch;
+
+	if (unlikely(!(drvdata && drvdata->enable && drvdata->master_enable)))
+		return;
+
+	/* a single write is atomic to the channel, preemption is fine */
+	ch = stm_marker_stride * (raw_smp_processor_id() + 1) - 1;
+	ch_addr = (void __iomem *)stm_channel_addr(drvdata, ch);
+
+#ifdef CONFIG_64BIT
+	if (drvdata->write_bytes == 8) {
+		writeq_relaxed_no_log((uint64_t)id << 32 | val, ch_addr +
+			stm_channel_off(STM_PKT_TYPE_DATA, STM_FLAG_MARKED |
+					STM_FLAG_TIMESTAMPED));
+		return;
+	}
+#endif
+
+	local_irq_save(flags);
+	writel_relaxed_no_log(id, ch_addr +
+		stm_channel_off(STM_PKT_TYPE_DATA, STM_FLAG_MARKED));
+	writel_relaxed_no_log(val, ch_addr +
+		stm_channel_off(STM_PKT_TYPE_DATA, STM_FLAG_TIMESTAMPED));
+	local_irq_restore(flags);
+}
+EXPORT_SYMBOL(__stm_marker);
+
+bool stm_marker_enabled(void)
+{
+	return static_key_enabled(&stm_marker_key);
+}
+
+int stm_marker_enable(bool enable)
+{
+	if (!stm_marker_stride)
+		return -EOPNOTSUPP;
+
+	if (enable && !static_key_enabled(&stm_marker_key))
+		static_branch_enable(&stm_marker_key);
+	else if (!enable && static_key_enabled(&stm_marker_key))
+		static_branch_disable(&stm_marker_key);
+
+	return 0;
+}
+
 ssize_t stm_ost_packet(struct stm_data *stm_data,
 				  unsigned int size,
 				  const unsigned char *buf)
@@ -287,12 +361,24 @@ EXPORT_SYMBOL(stm_ost_packet);
 
 int stm_set_ost_params(struct stm_drvdata *drvdata, size_t bitmap_size)
 {
+	unsigned int cpu;
+
 	drvdata->chs.bitmap = devm_kzalloc(drvdata->dev, bitmap_size,
 					   GFP_KERNEL);
 	if (!drvdata->chs.bitmap)
 		return -ENOMEM;
 
 	bitmap_fill(drvdata->entities, OST_ENTITY_MAX);
+
+	stm_marker_stride = drvdata->numsp / num_present_cpus();
+	if (stm_marker_stride >= 2) {
+		for (cpu = 1; cpu <= num_present_cpus(); cpu++)
+			set_bit(stm_marker_stride * cpu - 1,
+				drvdata->chs.bitmap);
+	} else {
+		stm_marker_stride = 0;
+	}
+
 	stmdrvdata = drvdata;
 
 	return 0;
@@ -25,6 +25,9 @@ extern ssize_t stm_ost_packet(struct stm_data *stm_data,
 
 extern int stm_set_ost_params(struct stm_drvdata *drvdata,
 			      size_t bitmap_size);
+
+extern bool stm_marker_enabled(void);
+extern int stm_marker_enable(bool enable);
 #else
 static inline bool stm_ost_configured(void) { return 0; }
 
@@ -40,5 +43,8 @@ static inline int stm_set_ost_params(struct stm_drvdata *drvdata,
 {
 	return 0;
 }
+
+static inline bool stm_marker_enabled(void) { return false; }
+static inline int stm_marker_enable(bool enable) { return -EOPNOTSUPP; }
 #endif
 #endif
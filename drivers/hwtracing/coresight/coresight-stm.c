@@ -626,6 +626,30 @@ static ssize_t entities_store(struct device *dev,
 }
 static DEVICE_ATTR_RW(entities);
 
+static ssize_t markers_show(struct device *dev,
+			    struct device_attribute *attr, char *buf)
+{
+	return scnprintf(buf, PAGE_SIZE, "%d\n", stm_marker_enabled());
+}
+
+static ssize_t markers_store(struct device *dev,
+			     struct device_attribute *attr,
+			     const char *buf, size_t size)
+{
+	bool val;
+	int ret;
+
+	if (kstrtobool(buf, &val))
+		return -EINVAL;
+
+	ret = stm_marker_enable(val);
+	if (ret)
+		return ret;
+
+	return size;
+}
+static DEVICE_ATTR_RW(markers);
+
  #define coresight_stm_simple_func(name, offset)	\
 
 #define coresight_stm_reg(name, offset)	\
@@ -651,6 +675,7 @@ static struct attribute *coresight_stm_attrs[] = {
 	&dev_attr_port_select.attr,
 	&dev_attr_traceid.attr,
 	&dev_attr_entities.attr,
+	&dev_attr_markers.attr,
 	NULL,
 };
 
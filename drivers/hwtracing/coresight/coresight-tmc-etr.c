@@ -44,6 +44,7 @@ struct etr_flat_buf {
  * @etr_buf		- Actual buffer used by the ETR
  * @pid			- The PID this etr_perf_buffer belongs to.
  * @snaphost		- Perf session mode
+ * @direct		- The ETR writes straight into the perf ring buffer.
  * @head		- handle->head at the beginning of the session.
  * @nr_pages		- Number of pages in the ring buffer.
  * @pages		- Array of Pages in the ring buffer.
@@ -53,6 +54,7 @@ struct etr_perf_buffer {
 	struct etr_buf		*etr_buf;
 	pid_t			pid;
 	bool			snapshot;
+	bool			direct;
 	unsigned long		head;
 	int			nr_pages;
 	void			**pages;
@@ -131,9 +133,8 @@ struct etr_sg_table {
  * well replace the link entry of the previous page with the last entry.
  */
 static inline unsigned long __attribute_const__
-tmc_etr_sg_table_entries(int nr_pages)
+tmc_etr_sg_entries(unsigned long nr_sgpages)
 {
-	unsigned long nr_sgpages = nr_pages * ETR_SG_PAGES_PER_SYSPAGE;
 	unsigned long nr_sglinks = nr_sgpages / (ETR_SG_PTRS_PER_PAGE - 1);
 	/*
 	 * If we spill over to a new page for 1 entry, we could as well
@@ -145,6 +146,12 @@ tmc_etr_sg_table_entries(int nr_pages)
 	return nr_sgpages + nr_sglinks;
 }
 
+static inline unsigned long __attribute_const__
+tmc_etr_sg_table_entries(int nr_pages)
+{
+	return tmc_etr_sg_entries(nr_pages * ETR_SG_PAGES_PER_SYSPAGE);
+}
+
 /*
  * tmc_pages_get_offset:  Go through all the pages in the tmc_pages
  * and map the device address @addr to an offset within the virtual
@@ -485,23 +492,29 @@ static inline void tmc_etr_sg_table_dump(struct etr_sg_table *etr_table) {}
  * pages allocated. Each Data page has ETR_SG_PAGES_PER_SYSPAGE SG pages.
  * So does a Table page. So we keep track of indices of the tables
  * in each system page and move the pointers accordingly.
+ *
+ * The table maps @nr_sgpages SG pages of the data buffer, starting at
+ * SG page @first and wrapping around at the end of the buffer.
  */
 #define INC_IDX_ROUND(idx, size) ((idx) = ((idx) + 1) % (size))
-static void tmc_etr_sg_table_populate(struct etr_sg_table *etr_table)
+static void tmc_etr_sg_table_populate(struct etr_sg_table *etr_table,
+				      unsigned long first,
+				      unsigned long nr_sgpages)
 {
 	dma_addr_t paddr;
 	int i, type, nr_entries;
 	int tpidx = 0; /* index to the current system table_page */
 	int sgtidx = 0;	/* index to the sg_table within the current syspage */
 	int sgtentry = 0; /* the entry within the sg_table */
-	int dpidx = 0; /* index to the current system data_page */
-	int spidx = 0; /* index to the SG page within the current data page */
+	unsigned long sgpidx = first; /* index to the SG page in the buffer */
 	sgte_t *ptr; /* pointer to the table entry to fill */
 	struct tmc_sg_table *sg_table = etr_table->sg_table;
 	dma_addr_t *table_daddrs = sg_table->table_pages.daddrs;
 	dma_addr_t *data_daddrs = sg_table->data_pages.daddrs;
+	unsigned long total = sg_table->data_pages.nr_pages *
+			      ETR_SG_PAGES_PER_SYSPAGE;
 
-	nr_entries = tmc_etr_sg_table_entries(sg_table->data_pages.nr_pages);
+	nr_entries = tmc_etr_sg_entries(nr_sgpages);
 	/*
 	 * Use the contiguous virtual address of the table to update entries.
 	 */
@@ -533,9 +546,10 @@ static void tmc_etr_sg_table_populate(struct etr_sg_table *etr_table)
 			 * next sg_page in the data buffer.
 			 */
 			type = ETR_SG_ET_NORMAL;
-			paddr = data_daddrs[dpidx] + spidx * ETR_SG_PAGE_SIZE;
-			if (!INC_IDX_ROUND(spidx, ETR_SG_PAGES_PER_SYSPAGE))
-				dpidx++;
+			paddr = data_daddrs[sgpidx / ETR_SG_PAGES_PER_SYSPAGE] +
+				(sgpidx % ETR_SG_PAGES_PER_SYSPAGE) *
+				ETR_SG_PAGE_SIZE;
+			INC_IDX_ROUND(sgpidx, total);
 		}
 		*ptr++ = ETR_SG_ENTRY(paddr, type);
 		/*
@@ -549,7 +563,8 @@ static void tmc_etr_sg_table_populate(struct etr_sg_table *etr_table)
 	}
 
 	/* Set up the last entry, which is always a data pointer */
-	paddr = data_daddrs[dpidx] + spidx * ETR_SG_PAGE_SIZE;
+	paddr = data_daddrs[sgpidx / ETR_SG_PAGES_PER_SYSPAGE] +
+		(sgpidx % ETR_SG_PAGES_PER_SYSPAGE) * ETR_SG_PAGE_SIZE;
 	*ptr++ = ETR_SG_ENTRY(paddr, ETR_SG_ET_LAST);
 }
 
@@ -586,7 +601,8 @@ tmc_init_etr_sg_table(struct device *dev, int node,
 	etr_table->sg_table = sg_table;
 	/* TMC should use table base address for DBA */
 	etr_table->hwaddr = sg_table->table_daddr;
-	tmc_etr_sg_table_populate(etr_table);
+	tmc_etr_sg_table_populate(etr_table, 0,
+				  nr_dpages * ETR_SG_PAGES_PER_SYSPAGE);
 	/* Sync the table pages for the HW */
 	tmc_sg_table_sync_table(sg_table);
 	tmc_etr_sg_table_dump(etr_table);
@@ -965,7 +981,8 @@ static void __tmc_etr_enable_hw(struct tmc_drvdata *drvdata)
 	/* Wait for TMCSReady bit to be set */
 	tmc_wait_for_tmcready(drvdata);
 
-	writel_relaxed(etr_buf->size / 4, drvdata->base + TMC_RSZ);
+	writel_relaxed((etr_buf->win_size ? : etr_buf->size) / 4,
+		       drvdata->base + TMC_RSZ);
 	writel_relaxed(TMC_MODE_CIRCULAR_BUFFER, drvdata->base + TMC_MODE);
 
 	axictl = readl_relaxed(drvdata->base + TMC_AXICTL);
@@ -1823,6 +1840,7 @@ tmc_etr_setup_perf_buf(struct tmc_drvdata *drvdata, struct perf_event *event,
 		       int nr_pages, void **pages, bool snapshot)
 {
 	int node;
+	unsigned long size;
 	struct etr_buf *etr_buf;
 	struct etr_perf_buffer *etr_perf;
 
@@ -1832,6 +1850,25 @@ tmc_etr_setup_perf_buf(struct tmc_drvdata *drvdata, struct perf_event *event,
 	if (!etr_perf)
 		return ERR_PTR(-ENOMEM);
 
+	/*
+	 * A per-thread session owns the sink, so the ETR can trace straight
+	 * into the perf ring buffer through an SG table over its pages.
+	 * CPU wide sessions share one etr_buf between several ring buffers
+	 * and keep going through the intermediate buffer.
+	 */
+	if (event->cpu == -1 && !snapshot &&
+	    tmc_etr_has_cap(drvdata, TMC_ETR_SG)) {
+		size = (unsigned long)nr_pages << PAGE_SHIFT;
+		etr_buf = tmc_alloc_etr_buf(drvdata, size, 0, node, pages);
+		if (!IS_ERR(etr_buf)) {
+			if (etr_buf->mode == ETR_MODE_ETR_SG) {
+				etr_perf->direct = true;
+				goto done;
+			}
+			tmc_free_etr_buf(etr_buf);
+		}
+	}
+
 	etr_buf = get_perf_etr_buf(drvdata, event, nr_pages, pages, snapshot);
 	if (!IS_ERR(etr_buf))
 		goto done;
@@ -1959,11 +1996,94 @@ static void tmc_etr_sync_perf_buffer(struct etr_perf_buffer *etr_perf,
 	}
 }
 
+/*
+ * tmc_etr_set_perf_window: Point the SG table of a direct perf buffer at
+ * the free part of the ring buffer, so that the ETR never overwrites data
+ * userspace has not collected yet. The window starts on an SG page
+ * boundary, the bytes skipped to get there are not reported to perf.
+ */
+static int tmc_etr_set_perf_window(struct etr_perf_buffer *etr_perf,
+				   struct perf_output_handle *handle)
+{
+	struct etr_buf *etr_buf = etr_perf->etr_buf;
+	struct etr_sg_table *etr_table = etr_buf->private;
+	struct tmc_sg_table *sg_table = etr_table->sg_table;
+	struct tmc_pages *data = &sg_table->data_pages;
+	unsigned long head, pad, size;
+	int i, start, npages;
+
+	head = PERF_IDX2OFF(handle->head, etr_perf);
+	pad = ALIGN(head, ETR_SG_PAGE_SIZE) - head;
+	if (pad && perf_aux_output_skip(handle, pad))
+		return -ENOSPC;
+
+	head = PERF_IDX2OFF(handle->head, etr_perf);
+	size = min_t(unsigned long, handle->size, etr_buf->size);
+	size &= ~(ETR_SG_PAGE_SIZE - 1);
+	if (!size)
+		return -ENOSPC;
+
+	etr_perf->head = head;
+	etr_buf->win_size = size;
+	tmc_etr_sg_table_populate(etr_table, head >> ETR_SG_PAGE_SHIFT,
+				  size >> ETR_SG_PAGE_SHIFT);
+	tmc_sg_table_sync_table(sg_table);
+
+	/* Barrier packets may have been written to these pages by the CPU */
+	start = head >> PAGE_SHIFT;
+	npages = DIV_ROUND_UP((head & (PAGE_SIZE - 1)) + size, PAGE_SIZE);
+	for (i = start; i < start + npages; i++)
+		dma_sync_single_for_device(sg_table->dev,
+					   data->daddrs[i % data->nr_pages],
+					   PAGE_SIZE, DMA_FROM_DEVICE);
+	return 0;
+}
+
+/*
+ * tmc_etr_sync_perf_direct: Work out how much trace the ETR wrote into
+ * the window set up by tmc_etr_set_perf_window(). If it wrapped, only the
+ * newest part (from the window start up to the write pointer) is still in
+ * order and gets reported, with a barrier packet in front of it.
+ */
+static unsigned long tmc_etr_sync_perf_direct(struct tmc_drvdata *drvdata,
+					      struct etr_perf_buffer *etr_perf,
+					      bool *lost)
+{
+	struct etr_buf *etr_buf = etr_perf->etr_buf;
+	struct etr_sg_table *etr_table = etr_buf->private;
+	struct tmc_sg_table *table = etr_table->sg_table;
+	unsigned long start = etr_perf->head, size;
+	long w_offset;
+	u32 status;
+
+	status = readl_relaxed(drvdata->base + TMC_STS);
+	if (WARN_ON_ONCE(status & TMC_STS_MEMERR)) {
+		*lost = true;
+		return 0;
+	}
+
+	w_offset = tmc_sg_get_data_page_offset(table, tmc_read_rwp(drvdata));
+	if (w_offset < 0) {
+		dev_warn(table->dev, "Unable to map RWP to offset\n");
+		*lost = true;
+		return 0;
+	}
+
+	size = ((w_offset < start) ? etr_buf->size : 0) + w_offset - start;
+	*lost = status & TMC_STS_FULL;
+	if (*lost && !size)
+		size = etr_buf->win_size;
+
+	tmc_sg_table_sync_data_range(table, start, size);
+	if (*lost)
+		tmc_etr_buf_insert_barrier_packet(etr_buf, start);
+	return size;
+}
+
 /*
  * tmc_update_etr_buffer : Update the perf ring buffer with the
- * available trace data. We use software double buffering at the moment.
- *
- * TODO: Add support for reusing the perf ring buffer.
+ * available trace data. Unless the ETR traces straight into the perf
+ * ring buffer (etr_perf->direct), we use software double buffering.
  */
 static unsigned long
 tmc_update_etr_buffer(struct coresight_device *csdev,
@@ -1993,6 +2113,12 @@ tmc_update_etr_buffer(struct coresight_device *csdev,
 	CS_UNLOCK(drvdata->base);
 
 	tmc_flush_and_stop(drvdata);
+	if (etr_perf->direct) {
+		size = tmc_etr_sync_perf_direct(drvdata, etr_perf, &lost);
+		CS_LOCK(drvdata->base);
+		spin_unlock_irqrestore(&drvdata->spinlock, flags);
+		goto out;
+	}
 	tmc_sync_etr_buf(drvdata);
 
 	CS_LOCK(drvdata->base);
@@ -2090,6 +2216,12 @@ static int tmc_enable_etr_sink_perf(struct coresight_device *csdev, void *data)
 		goto unlock_out;
 	}
 
+	if (etr_perf->direct) {
+		rc = tmc_etr_set_perf_window(etr_perf, handle);
+		if (rc)
+			goto unlock_out;
+	}
+
 	rc = tmc_etr_enable_hw(drvdata, etr_perf->etr_buf);
 	if (!rc) {
 		/* Associate with monitored process. */
@@ -534,6 +534,26 @@ static ssize_t block_size_store(struct device *dev,
 }
 static DEVICE_ATTR_RW(block_size);
 
+static ssize_t byte_cntr_stats_show(struct device *dev,
+				    struct device_attribute *attr,
+				    char *buf)
+{
+	struct tmc_drvdata *drvdata = dev_get_drvdata(dev->parent);
+	struct byte_cntr *byte_cntr_data = drvdata->byte_cntr;
+
+	if (!byte_cntr_data)
+		return -EINVAL;
+
+	return scnprintf(buf, PAGE_SIZE,
+			 "pending: %d\nmax_pending: %u\noverrun: %d\n"
+			 "pcie_write_err: %u\n",
+			 atomic_read(&byte_cntr_data->irq_cnt),
+			 byte_cntr_data->max_pending,
+			 atomic_read(&byte_cntr_data->overrun),
+			 byte_cntr_data->pcie_write_err);
+}
+static DEVICE_ATTR_RO(byte_cntr_stats);
+
 static int tmc_iommu_init(struct tmc_drvdata *drvdata)
 {
 	struct device_node *node = drvdata->dev->of_node;
@@ -627,6 +647,7 @@ static struct attribute *coresight_tmc_etr_attrs[] = {
 	&dev_attr_trigger_cntr.attr,
 	&dev_attr_buffer_size.attr,
 	&dev_attr_block_size.attr,
+	&dev_attr_byte_cntr_stats.attr,
 	&dev_attr_out_mode.attr,
 	&dev_attr_available_out_modes.attr,
 	&dev_attr_pcie_path.attr,
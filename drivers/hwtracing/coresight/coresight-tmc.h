@@ -218,6 +218,8 @@ struct etr_buf_operations;
  * @hwaddr	: Address to be programmed in the TMC:DBA{LO,HI}
  * @offset	: Offset of the trace data in the buffer for consumption.
  * @len		: Available trace data @buf (may round up to the beginning).
+ * @win_size	: Size programmed in RSZ when the TMC may only write part
+ *		  of the buffer, 0 for the whole buffer.
  * @ops		: ETR buffer operations for the mode.
  * @private	: Backend specific information for the buf
  */
@@ -229,6 +231,7 @@ struct etr_buf {
 	dma_addr_t			hwaddr;
 	unsigned long			offset;
 	s64				len;
+	ssize_t				win_size;
 	const struct etr_buf_operations	*ops;
 	void				*private;
 };
@@ -14,6 +14,7 @@
 #define EVDEV_MINORS		32
 #define EVDEV_MIN_BUFFER_SIZE	64U
 #define EVDEV_BUF_PACKETS	8
+#define EVDEV_MAX_RING_SIZE	16384U
 
 #include <linux/poll.h>
 #include <linux/sched.h>
@@ -26,6 +27,7 @@
 #include <linux/major.h>
 #include <linux/device.h>
 #include <linux/cdev.h>
+#include <linux/overflow.h>
 #include "input-compat.h"
 
 enum evdev_clock_type {
@@ -59,6 +61,15 @@ struct evdev_client {
 	unsigned int clk_type;
 	bool revoked;
 	unsigned long *evmasks[EV_CNT];
+	/* overruns of buffer or ring, under buffer_lock */
+	unsigned int overruns;
+	/* mmap ring, used instead of buffer once set up */
+	struct input_mmap_ring *ring;
+	unsigned int ring_size;
+	unsigned int ring_head;
+	unsigned int ring_wpos;
+	unsigned int ring_seq;
+	bool ring_dropping;
 	unsigned int bufsize;
 	struct input_event buffer[];
 };
@@ -240,6 +251,7 @@ static void __pass_event(struct evdev_client *client,
 		 * EV_SYN/SYN_DROPPED plus the newest event in the queue.
 		 */
 		client->tail = (client->head - 2) & (client->bufsize - 1);
+		client->overruns++;
 
 		client->buffer[client->tail].time = event->time;
 		client->buffer[client->tail].type = EV_SYN;
@@ -255,6 +267,56 @@ static void __pass_event(struct evdev_client *client,
 	}
 }
 
+/*
+ * Events go to the ring at ring_wpos, and ring->head only moves past them
+ * at SYN_REPORT. The reader's tail is the only field of the shared page
+ * trusted, and only to tell how much room is left.
+ */
+static void evdev_ring_pass_event(struct evdev_client *client,
+				  const struct input_event *event)
+{
+	struct input_mmap_ring *ring = client->ring;
+
+	if (client->ring_dropping)
+		return;
+
+	if (client->ring_wpos - READ_ONCE(ring->tail) >= client->ring_size) {
+		/* drop the whole frame, up to and including its SYN_REPORT */
+		client->ring_wpos = client->ring_head;
+		client->ring_dropping = true;
+		client->overruns++;
+		WRITE_ONCE(ring->overruns, client->overruns);
+		return;
+	}
+
+	ring->events[client->ring_wpos & (client->ring_size - 1)] = *event;
+	client->ring_wpos++;
+
+	if (event->type == EV_SYN && event->code == SYN_REPORT) {
+		client->ring_head = client->ring_wpos;
+		WRITE_ONCE(ring->seq, ++client->ring_seq);
+		smp_store_release(&ring->head, client->ring_head);
+		kill_fasync(&client->fasync, SIGIO, POLL_IN);
+	}
+}
+
+static bool evdev_packet_empty(struct evdev_client *client)
+{
+	if (client->ring)
+		return client->ring_wpos == client->ring_head;
+
+	return client->packet_head == client->head;
+}
+
+static bool evdev_has_events(struct evdev_client *client)
+{
+	if (client->ring)
+		return READ_ONCE(client->ring_head) !=
+			READ_ONCE(client->ring->tail);
+
+	return client->packet_head != client->tail;
+}
+
 static void evdev_pass_values(struct evdev_client *client,
 			const struct input_value *vals, unsigned int count,
 			ktime_t *ev_time)
@@ -277,9 +339,11 @@ static void evdev_pass_values(struct evdev_client *client,
 			continue;
 
 		if (v->type == EV_SYN && v->code == SYN_REPORT) {
-			/* drop empty SYN_REPORT */
-			if (client->packet_head == client->head)
+			/* drop empty SYN_REPORT, ending a dropped frame */
+			if (evdev_packet_empty(client)) {
+				client->ring_dropping = false;
 				continue;
+			}
 
 			wakeup = true;
 		}
@@ -287,7 +351,10 @@ static void evdev_pass_values(struct evdev_client *client,
 		event.type = v->type;
 		event.code = v->code;
 		event.value = v->value;
-		__pass_event(client, &event);
+		if (client->ring)
+			evdev_ring_pass_event(client, &event);
+		else
+			__pass_event(client, &event);
 	}
 
 	spin_unlock(&client->buffer_lock);
@@ -467,6 +534,7 @@ static int evdev_release(struct inode *inode, struct file *file)
 	for (i = 0; i < EV_CNT; ++i)
 		kfree(client->evmasks[i]);
 
+	vfree(client->ring);
 	kvfree(client);
 
 	evdev_close_device(evdev);
@@ -585,6 +653,10 @@ static ssize_t evdev_read(struct file *file, char __user *buffer,
 	if (count != 0 && count < input_event_size())
 		return -EINVAL;
 
+	/* events are only in the ring once it is set up */
+	if (client->ring)
+		return -EINVAL;
+
 	for (;;) {
 		if (!evdev->exist || client->revoked)
 			return -ENODEV;
@@ -638,12 +710,54 @@ static unsigned int evdev_poll(struct file *file, poll_table *wait)
 	else
 		mask = POLLHUP | POLLERR;
 
-	if (client->packet_head != client->tail)
+	if (evdev_has_events(client))
 		mask |= POLLIN | POLLRDNORM;
 
 	return mask;
 }
 
+static int evdev_set_ring(struct evdev_client *client, unsigned int size)
+{
+	struct input_mmap_ring *ring;
+
+	/* the layout of struct input_event differs for compat callers */
+	if (input_event_size() != sizeof(struct input_event))
+		return -EINVAL;
+
+	if (size < EVDEV_MIN_BUFFER_SIZE || size > EVDEV_MAX_RING_SIZE ||
+	    !is_power_of_2(size))
+		return -EINVAL;
+
+	if (client->ring)
+		return -EBUSY;
+
+	ring = vmalloc_user(struct_size(ring, events, size));
+	if (!ring)
+		return -ENOMEM;
+	ring->size = size;
+
+	spin_lock_irq(&client->buffer_lock);
+	client->ring_size = size;
+	client->ring_head = client->ring_wpos = 0;
+	client->ring_seq = 0;
+	client->ring_dropping = false;
+	client->ring = ring;
+	spin_unlock_irq(&client->buffer_lock);
+
+	return 0;
+}
+
+static int evdev_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct evdev_client *client = file->private_data;
+	struct input_mmap_ring *ring = READ_ONCE(client->ring);
+
+	if (!ring)
+		return -EINVAL;
+
+	return remap_vmalloc_range(vma, ring, vma->vm_pgoff);
+}
+
 #ifdef CONFIG_COMPAT
 
 #define BITS_PER_LONG_COMPAT (sizeof(compat_long_t) * 8)
@@ -1145,6 +1259,15 @@ static long evdev_do_ioctl(struct file *file, unsigned int cmd,
 
 		return evdev_set_clk_type(client, i);
 
+	case EVIOCSRING:
+		if (copy_from_user(&i, p, sizeof(unsigned int)))
+			return -EFAULT;
+
+		return evdev_set_ring(client, i);
+
+	case EVIOCGOVERRUNS:
+		return put_user(READ_ONCE(client->overruns), ip);
+
 	case EVIOCGKEYCODE:
 		return evdev_handle_get_keycode(dev, p);
 
@@ -1314,6 +1437,7 @@ static const struct file_operations evdev_fops = {
 	.read		= evdev_read,
 	.write		= evdev_write,
 	.poll		= evdev_poll,
+	.mmap		= evdev_mmap,
 	.open		= evdev_open,
 	.release	= evdev_release,
 	.unlocked_ioctl	= evdev_ioctl,
@@ -39,16 +39,29 @@
 typedef int (*get_screen_angle_callback)(void);
 typedef int (*set_screen_angle_callback)(int angle);
 
+/* Screen rotations of 0, 90, 180 and 270 degrees */
+#define TP_GRIP_ORIENTATIONS       4
+#define TP_GRIP_RECTS              2
+
 /*
  * DATA STRUCTURES
  ****************************************************************************************
  */
+typedef struct lct_tp_grip_rect {
+	unsigned int x0, y0;
+	unsigned int x1, y1;
+} lct_tp_grip_rect_t;
+
 typedef struct lct_tp{
 	struct kobject *tp_device;
 	int screen_angle;
 	struct proc_dir_entry *proc_entry_tp_grip_area;
 	set_screen_angle_callback lct_grip_area_set_screen_angle_callback;
 	get_screen_angle_callback lct_grip_area_get_screen_angle_callback;
+	/* Rejected edges in panel coordinates, computed once per rotation */
+	lct_tp_grip_rect_t grip_rects[TP_GRIP_ORIENTATIONS][TP_GRIP_RECTS];
+	bool grip_rects_valid;
+	int orientation;
 }lct_tp_t;
 
 /*
@@ -115,9 +128,16 @@ void uninit_lct_tp_grip_area(void)
 }
 EXPORT_SYMBOL(uninit_lct_tp_grip_area);
 
-int set_tp_grip_area_angle(int screen_angle)
+static void lct_tp_grip_area_update_angle(int screen_angle)
 {
 	lct_tp_p->screen_angle = screen_angle;
+	WRITE_ONCE(lct_tp_p->orientation,
+		   ((screen_angle + 45) / 90) % TP_GRIP_ORIENTATIONS);
+}
+
+int set_tp_grip_area_angle(int screen_angle)
+{
+	lct_tp_grip_area_update_angle(screen_angle);
 	return 0;
 }
 EXPORT_SYMBOL(set_tp_grip_area_angle);
@@ -128,6 +148,58 @@ int get_tp_grip_area_angle(void)
 }
 EXPORT_SYMBOL(get_tp_grip_area_angle);
 
+/*
+ * Precompute the edges to reject for every rotation: the long sides of the
+ * panel are held in portrait and, after a turn, the short ones become the
+ * ones under the palms in landscape.
+ */
+int set_tp_grip_area_panel(unsigned int x_max, unsigned int y_max, unsigned int edge)
+{
+	int i;
+
+	if (IS_ERR_OR_NULL(lct_tp_p))
+		return -ENODEV;
+	if (edge == 0 || edge * 2 >= x_max || edge * 2 >= y_max)
+		return -EINVAL;
+
+	for (i = 0; i < TP_GRIP_ORIENTATIONS; i++) {
+		lct_tp_grip_rect_t *r = lct_tp_p->grip_rects[i];
+
+		if (i % 2 == 0) {
+			r[0] = (lct_tp_grip_rect_t){ 0, 0, edge, y_max };
+			r[1] = (lct_tp_grip_rect_t){ x_max - edge, 0, x_max, y_max };
+		} else {
+			r[0] = (lct_tp_grip_rect_t){ 0, 0, x_max, edge };
+			r[1] = (lct_tp_grip_rect_t){ 0, y_max - edge, x_max, y_max };
+		}
+	}
+	smp_wmb();
+	WRITE_ONCE(lct_tp_p->grip_rects_valid, true);
+	TP_LOGW("grip area %u x %u, edge %u\n", x_max, y_max, edge);
+
+	return 0;
+}
+EXPORT_SYMBOL(set_tp_grip_area_panel);
+
+/* Whether a touch at @x, @y falls on a gripped edge, called per report */
+bool lct_tp_grip_area_reject(unsigned int x, unsigned int y)
+{
+	const lct_tp_grip_rect_t *r;
+	int i;
+
+	if (IS_ERR_OR_NULL(lct_tp_p) || !READ_ONCE(lct_tp_p->grip_rects_valid))
+		return false;
+	smp_rmb();
+
+	r = lct_tp_p->grip_rects[READ_ONCE(lct_tp_p->orientation)];
+	for (i = 0; i < TP_GRIP_RECTS; i++)
+		if (x >= r[i].x0 && x < r[i].x1 && y >= r[i].y0 && y < r[i].y1)
+			return true;
+
+	return false;
+}
+EXPORT_SYMBOL(lct_tp_grip_area_reject);
+
 static int lct_proc_tp_grip_area_open (struct inode *node, struct file *file)
 {
 	return 0;
@@ -152,7 +224,7 @@ static ssize_t lct_proc_tp_grip_area_read(struct file *file, char __user *buf, s
 			TP_LOGE("get screen angle failed!\n");
 			goto out;
 		}
-		lct_tp_p->screen_angle = ret; 
+		lct_tp_grip_area_update_angle(ret);
 	}
 	cnt = sprintf(page, "%d\n", lct_tp_p->screen_angle);
 	cnt = simple_read_from_buffer(buf, size, ppos, page, cnt);
@@ -200,7 +272,7 @@ static ssize_t lct_proc_tp_grip_area_write(struct file *file, const char __user
 		TP_LOGE("Set screen angle failed! ret = %d\n", ret);
 		goto out;
 	}
-	lct_tp_p->screen_angle = angle;
+	lct_tp_grip_area_update_angle(angle);
 	ret = cnt;
 
 out:
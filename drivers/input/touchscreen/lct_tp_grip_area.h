@@ -8,6 +8,8 @@ extern int init_lct_tp_grip_area(set_screen_angle_callback set_fun, get_screen_a
 extern void uninit_lct_tp_grip_area(void);
 extern int set_tp_grip_area_angle(int screen_angle);
 extern int get_tp_grip_area_angle(void);
+extern int set_tp_grip_area_panel(unsigned int x_max, unsigned int y_max, unsigned int edge);
+extern bool lct_tp_grip_area_reject(unsigned int x, unsigned int y);
 
 #endif//__LCT_TP_GRIP_AREA_H__
 
@@ -20,6 +20,9 @@
 #include <linux/proc_fs.h>
 #include <linux/miscdevice.h>
 #include <asm/uaccess.h>
+#include <linux/interrupt.h>
+#include <linux/cpu_input_boost.h>
+#include <linux/devfreq_boost.h>
 
 /*
  * DEFINE CONFIGURATION
@@ -55,6 +58,18 @@ typedef struct lct_tp{
  */
 static lct_tp_t *lct_tp_p = NULL;
 
+/*
+ * Boost cpu and bus frequencies straight from the hard IRQ of the touch
+ * controller, before the threaded handler has read a single coordinate,
+ * rather than waiting for the input event or for userspace to ask.
+ */
+static unsigned int touch_boost_ms = 120;
+module_param(touch_boost_ms, uint, 0644);
+
+/* Request the touch IRQ with IRQF_PERF_CRITICAL, handled on a big core */
+static bool touch_irq_perf = true;
+module_param(touch_irq_perf, bool, 0644);
+
 /*
  * FUNCTION DEFINITIONS
  ****************************************************************************************
@@ -121,6 +136,38 @@ bool get_lct_tp_work_status(void)
 }
 EXPORT_SYMBOL(get_lct_tp_work_status);
 
+void lct_tp_touch_down(void)
+{
+	unsigned int ms = READ_ONCE(touch_boost_ms);
+
+	if (!ms)
+		return;
+
+	cpu_input_boost_kick_max(ms);
+	devfreq_boost_kick_max(DEVFREQ_MSM_CPUBW, ms);
+}
+EXPORT_SYMBOL(lct_tp_touch_down);
+
+/*
+ * Primary handler for request_threaded_irq(): every touch report starts
+ * with the controller pulling the line, so boost here and let the thread
+ * do the bus transfer.
+ */
+irqreturn_t lct_tp_touch_hardirq(int irq, void *dev_id)
+{
+	lct_tp_touch_down();
+	return IRQ_WAKE_THREAD;
+}
+EXPORT_SYMBOL(lct_tp_touch_hardirq);
+
+unsigned long lct_tp_irq_flags(unsigned long flags)
+{
+	if (touch_irq_perf)
+		flags |= IRQF_PERF_CRITICAL;
+	return flags;
+}
+EXPORT_SYMBOL(lct_tp_irq_flags);
+
 static int lct_creat_proc_tp_entry(void)
 {
 	lct_tp_p->proc_entry_tp = proc_create_data(TP_WORK_NAME, 0444, NULL, &lct_proc_tp_work_fops, NULL);
@@ -1,6 +1,8 @@
 #ifndef __LCT_TP_WORK_H__
 #define __LCT_TP_WORK_H__
 
+#include <linux/interrupt.h>
+
 typedef int (*tp_work_cb_t)(bool enable_tp);
 
 extern int init_lct_tp_work(tp_work_cb_t callback);
@@ -8,5 +10,10 @@ extern void uninit_lct_tp_work(void);
 extern void set_lct_tp_work_status(bool en);
 extern bool get_lct_tp_work_status(void);
 
+/* Touch-down boost and IRQ setup for the touch controller interrupt */
+extern void lct_tp_touch_down(void);
+extern irqreturn_t lct_tp_touch_hardirq(int irq, void *dev_id);
+extern unsigned long lct_tp_irq_flags(unsigned long flags);
+
 #endif //__LCT_TP_WORK_H__
 
@@ -3864,6 +3864,41 @@ static int arm_smmu_domain_set_attr(struct iommu_domain *domain,
 				1 << DOMAIN_ATTR_NO_CFRE;
 		ret = 0;
 		break;
+	case DOMAIN_ATTR_DEFER_TLB_FLUSH: {
+		struct io_pgtable *iop;
+		unsigned long flags;
+		bool flush;
+
+		/*
+		 * While set, unmaps skip their TLB invalidation and the one
+		 * invalidation is issued when it's cleared again. The caller
+		 * serialises all unmaps in the window against other users.
+		 */
+		if (!smmu_domain->pgtbl_ops || !smmu_domain->smmu ||
+				arm_smmu_is_slave_side_secure(smmu_domain)) {
+			ret = -ENODEV;
+			break;
+		}
+
+		iop = io_pgtable_ops_to_pgtable(smmu_domain->pgtbl_ops);
+		spin_lock_irqsave(&smmu_domain->cb_lock, flags);
+		iop->tlb_flush_deferred = !!*((int *)data);
+		flush = !iop->tlb_flush_deferred && iop->tlb_flush_pending;
+		spin_unlock_irqrestore(&smmu_domain->cb_lock, flags);
+
+		ret = 0;
+		if (!flush)
+			break;
+
+		ret = arm_smmu_domain_power_on(domain, smmu_domain->smmu);
+		if (ret)
+			break;
+		spin_lock_irqsave(&smmu_domain->cb_lock, flags);
+		io_pgtable_tlb_flush_gather(iop);
+		spin_unlock_irqrestore(&smmu_domain->cb_lock, flags);
+		arm_smmu_domain_power_off(domain, smmu_domain->smmu);
+		break;
+	}
 	case DOMAIN_ATTR_GEOMETRY: {
 		struct iommu_domain_geometry *geometry =
 				(struct iommu_domain_geometry *)data;
@@ -20,6 +20,11 @@
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 #include <linux/pci.h>
+#include <linux/percpu.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/log2.h>
+#include <linux/moduleparam.h>
 #include <trace/events/iommu.h>
 #include "io-pgtable.h"
 
@@ -31,6 +36,41 @@
 #define FAST_PAGE_SIZE (1UL << FAST_PAGE_SHIFT)
 #define FAST_PAGE_MASK (~(PAGE_SIZE - 1))
 
+/*
+ * Per-cpu caches of freed IOVAs of 4K to 32K, for streaming mappings.
+ * Each size has two magazines per cpu, as in the IOVA rcache. A freed
+ * IOVA keeps its bitmap bits and its stale TLB entry; it is tagged with
+ * the TLB flush count at the time and is only handed out again after a
+ * full TLB invalidate has completed since. When no cached IOVA is ready
+ * but a magazine has filled up, one invalidate makes the whole batch
+ * ready at once.
+ */
+#define FAST_IOVA_CACHE_ORDERS	4
+#define FAST_IOVA_MAG_SIZE	16
+
+struct fast_iova_mag {
+	unsigned int	n;
+	u64		tag;
+	dma_addr_t	iova[FAST_IOVA_MAG_SIZE];
+};
+
+struct fast_iova_class {
+	struct fast_iova_mag	*loaded;
+	struct fast_iova_mag	*prev;
+	struct fast_iova_mag	mags[2];
+};
+
+struct fast_iova_cache {
+	struct fast_iova_class	class[FAST_IOVA_CACHE_ORDERS];
+	unsigned long		hits;
+	unsigned long		misses;
+};
+
+static bool iova_cache = true;
+module_param(iova_cache, bool, 0444);
+
+static struct dentry *fast_smmu_debugfs_root;
+
 static pgprot_t __get_dma_pgprot(unsigned long attrs, pgprot_t prot,
 				 bool coherent)
 {
@@ -125,6 +165,21 @@ static bool __bit_covered_stale(unsigned long upcoming_stale,
 	return true;
 }
 
+/*
+ * Called with the mapping lock held. Cached IOVAs are tagged with
+ * tlb_flush_started after they were unmapped, so one tagged before the
+ * increment here is known to be invalidated once tlb_flush_done is
+ * larger than the tag.
+ */
+static void __fast_smmu_tlbiall(struct dma_fast_smmu_mapping *mapping)
+{
+	WRITE_ONCE(mapping->tlb_flush_started, mapping->tlb_flush_started + 1);
+	smp_mb();
+	iommu_tlbiall(mapping->domain);
+	smp_wmb();
+	WRITE_ONCE(mapping->tlb_flush_done, mapping->tlb_flush_started);
+}
+
 static dma_addr_t __fast_smmu_alloc_iova(struct dma_fast_smmu_mapping *mapping,
 					 unsigned long attrs,
 					 size_t size)
@@ -171,7 +226,8 @@ static dma_addr_t __fast_smmu_alloc_iova(struct dma_fast_smmu_mapping *mapping,
 				bit + nbits - 1)) {
 		bool skip_sync = (attrs & DMA_ATTR_SKIP_CPU_SYNC);
 
-		iommu_tlbiall(mapping->domain);
+		__fast_smmu_tlbiall(mapping);
+		mapping->stale_wrap_flushes++;
 		mapping->have_stale_tlbs = false;
 		av8l_fast_clear_stale_ptes(mapping->pgtbl_ops,
 				mapping->domain->geometry.aperture_start,
@@ -308,6 +364,135 @@ static void __fast_smmu_free_iova(struct dma_fast_smmu_mapping *mapping,
 	mapping->have_stale_tlbs = true;
 }
 
+/* Only exact power of two page counts, which are aligned to their size */
+static int fast_iova_cache_order(struct dma_fast_smmu_mapping *mapping,
+				 size_t size)
+{
+	unsigned long nbits = size >> FAST_PAGE_SHIFT;
+	int order;
+
+	if (!mapping->iova_cache || !is_power_of_2(nbits))
+		return -1;
+
+	order = ilog2(nbits);
+	return order < FAST_IOVA_CACHE_ORDERS ? order : -1;
+}
+
+static bool fast_iova_mag_ready(struct dma_fast_smmu_mapping *mapping,
+				struct fast_iova_mag *mag)
+{
+	return mag->n && READ_ONCE(mapping->tlb_flush_done) > mag->tag;
+}
+
+static dma_addr_t fast_iova_cache_alloc(struct dma_fast_smmu_mapping *mapping,
+					size_t size)
+{
+	struct fast_iova_cache *cache;
+	struct fast_iova_class *c;
+	dma_addr_t iova = DMA_ERROR_CODE;
+	unsigned long flags;
+	int order = fast_iova_cache_order(mapping, size);
+
+	if (order < 0)
+		return DMA_ERROR_CODE;
+
+	local_irq_save(flags);
+	cache = this_cpu_ptr(mapping->iova_cache);
+	c = &cache->class[order];
+
+	if (!fast_iova_mag_ready(mapping, c->loaded)) {
+		if (fast_iova_mag_ready(mapping, c->prev)) {
+			swap(c->loaded, c->prev);
+		} else if (c->loaded->n == FAST_IOVA_MAG_SIZE ||
+			   c->prev->n == FAST_IOVA_MAG_SIZE) {
+			spin_lock(&mapping->lock);
+			__fast_smmu_tlbiall(mapping);
+			mapping->cache_flushes++;
+			spin_unlock(&mapping->lock);
+			if (!c->loaded->n)
+				swap(c->loaded, c->prev);
+		} else {
+			goto out;
+		}
+	}
+
+	iova = c->loaded->iova[--c->loaded->n];
+	smp_rmb();
+	av8l_fast_clear_stale_ptes(mapping->pgtbl_ops,
+			mapping->domain->geometry.aperture_start,
+			iova, iova + size - 1, false);
+out:
+	if (iova != DMA_ERROR_CODE)
+		cache->hits++;
+	else
+		cache->misses++;
+	local_irq_restore(flags);
+	return iova;
+}
+
+/* Unmaps @iova and keeps it in this cpu's cache, false if it can't */
+static bool fast_iova_cache_free(struct dma_fast_smmu_mapping *mapping,
+				 dma_addr_t iova, size_t size)
+{
+	struct fast_iova_class *c;
+	struct fast_iova_mag *mag;
+	unsigned long flags;
+	int i, order = fast_iova_cache_order(mapping, size);
+
+	if (order < 0)
+		return false;
+
+	local_irq_save(flags);
+	c = &this_cpu_ptr(mapping->iova_cache)->class[order];
+
+	if (c->loaded->n == FAST_IOVA_MAG_SIZE) {
+		if (c->prev->n) {
+			/* Both full, the older one goes back to the bitmap */
+			mag = c->prev;
+			spin_lock(&mapping->lock);
+			for (i = 0; i < mag->n; i++)
+				__fast_smmu_free_iova(mapping, mag->iova[i],
+						      size);
+			spin_unlock(&mapping->lock);
+			mag->n = 0;
+		}
+		swap(c->loaded, c->prev);
+	}
+
+	av8l_fast_unmap_public(mapping->pgtbl_ops, iova, size);
+	smp_mb();
+	mag = c->loaded;
+	mag->tag = READ_ONCE(mapping->tlb_flush_started);
+	mag->iova[mag->n++] = iova;
+	local_irq_restore(flags);
+
+	return true;
+}
+
+static int fast_iova_cache_init(struct dma_fast_smmu_mapping *mapping)
+{
+	int cpu, i;
+
+	if (!iova_cache || mapping->min_iova_align)
+		return 0;
+
+	mapping->iova_cache = alloc_percpu(struct fast_iova_cache);
+	if (!mapping->iova_cache)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct fast_iova_cache *cache;
+
+		cache = per_cpu_ptr(mapping->iova_cache, cpu);
+		for (i = 0; i < FAST_IOVA_CACHE_ORDERS; i++) {
+			cache->class[i].loaded = &cache->class[i].mags[0];
+			cache->class[i].prev = &cache->class[i].mags[1];
+		}
+	}
+
+	return 0;
+}
+
 
 static void __fast_dma_page_cpu_to_dev(struct page *page, unsigned long off,
 				       size_t size, enum dma_data_direction dir)
@@ -364,6 +549,16 @@ static dma_addr_t fast_smmu_map_page(struct device *dev, struct page *page,
 		__fast_dma_page_cpu_to_dev(phys_to_page(phys_to_map),
 					   offset_from_phys_to_map, size, dir);
 
+	iova = fast_iova_cache_alloc(mapping, len);
+	if (iova != DMA_ERROR_CODE) {
+		if (unlikely(av8l_fast_map_public(mapping->pgtbl_ops, iova,
+						  phys_to_map, len, prot))) {
+			spin_lock_irqsave(&mapping->lock, flags);
+			goto fail_free_iova;
+		}
+		goto out;
+	}
+
 	spin_lock_irqsave(&mapping->lock, flags);
 
 	iova = __fast_smmu_alloc_iova(mapping, attrs, len);
@@ -376,7 +571,7 @@ static dma_addr_t fast_smmu_map_page(struct device *dev, struct page *page,
 		goto fail_free_iova;
 
 	spin_unlock_irqrestore(&mapping->lock, flags);
-
+out:
 	trace_map(mapping->domain, iova, phys_to_map, len, prot);
 	return iova + offset_from_phys_to_map;
 
@@ -408,10 +603,12 @@ static void fast_smmu_unmap_page(struct device *dev, dma_addr_t iova,
 						size, dir);
 	}
 
-	spin_lock_irqsave(&mapping->lock, flags);
-	av8l_fast_unmap_public(mapping->pgtbl_ops, iova, len);
-	__fast_smmu_free_iova(mapping, iova - offset, len);
-	spin_unlock_irqrestore(&mapping->lock, flags);
+	if (!fast_iova_cache_free(mapping, iova - offset, len)) {
+		spin_lock_irqsave(&mapping->lock, flags);
+		av8l_fast_unmap_public(mapping->pgtbl_ops, iova, len);
+		__fast_smmu_free_iova(mapping, iova - offset, len);
+		spin_unlock_irqrestore(&mapping->lock, flags);
+	}
 
 	trace_unmap(mapping->domain, iova - offset, len, len);
 }
@@ -881,6 +1078,58 @@ static void fast_smmu_reserve_pci_windows(struct device *dev,
 	spin_unlock_irqrestore(&mapping->lock, flags);
 }
 
+static int fast_smmu_stats_show(struct seq_file *s, void *unused)
+{
+	struct dma_fast_smmu_mapping *fast = s->private;
+	unsigned long hits = 0, misses = 0;
+	int cpu;
+
+	if (fast->iova_cache) {
+		for_each_possible_cpu(cpu) {
+			struct fast_iova_cache *cache;
+
+			cache = per_cpu_ptr(fast->iova_cache, cpu);
+			hits += READ_ONCE(cache->hits);
+			misses += READ_ONCE(cache->misses);
+		}
+	}
+
+	seq_printf(s, "stale_wrap_flushes: %lu\n", fast->stale_wrap_flushes);
+	seq_printf(s, "cache_flushes: %lu\n", fast->cache_flushes);
+	seq_printf(s, "cache_hits: %lu\n", hits);
+	seq_printf(s, "cache_misses: %lu\n", misses);
+	return 0;
+}
+
+static int fast_smmu_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, fast_smmu_stats_show, inode->i_private);
+}
+
+static const struct file_operations fast_smmu_stats_fops = {
+	.open = fast_smmu_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void fast_smmu_debugfs_init(struct device *dev,
+				   struct dma_fast_smmu_mapping *fast)
+{
+	if (!fast_smmu_debugfs_root) {
+		fast_smmu_debugfs_root = debugfs_create_dir("dma_fast_smmu",
+							    NULL);
+		if (IS_ERR_OR_NULL(fast_smmu_debugfs_root)) {
+			fast_smmu_debugfs_root = NULL;
+			return;
+		}
+	}
+
+	fast->debugfs = debugfs_create_file(dev_name(dev), 0400,
+					    fast_smmu_debugfs_root, fast,
+					    &fast_smmu_stats_fops);
+}
+
 static int fast_smmu_errata_init(struct dma_iommu_mapping *mapping)
 {
 	struct dma_fast_smmu_mapping *fast = mapping->fast;
@@ -934,6 +1183,9 @@ int fast_smmu_init_mapping(struct device *dev,
 	if (fast_smmu_errata_init(mapping))
 		goto release_mapping;
 
+	if (fast_iova_cache_init(mapping->fast))
+		dev_warn(dev, "No per-cpu IOVA cache\n");
+
 	fast_smmu_reserve_pci_windows(dev, mapping->fast);
 
 	domain->geometry.aperture_start = mapping->base;
@@ -950,10 +1202,13 @@ int fast_smmu_init_mapping(struct device *dev,
 	mapping->fast->notifier.notifier_call = fast_smmu_notify;
 	av8l_register_notify(&mapping->fast->notifier);
 
+	fast_smmu_debugfs_init(dev, mapping->fast);
+
 	mapping->ops = &fast_smmu_dma_ops;
 	return 0;
 
 release_mapping:
+	free_percpu(mapping->fast->iova_cache);
 	kfree(mapping->fast->bitmap);
 	kfree(mapping->fast);
 	return err;
@@ -970,6 +1225,8 @@ void fast_smmu_release_mapping(struct kref *kref)
 	struct dma_iommu_mapping *mapping =
 		container_of(kref, struct dma_iommu_mapping, kref);
 
+	debugfs_remove(mapping->fast->debugfs);
+	free_percpu(mapping->fast->iova_cache);
 	kvfree(mapping->fast->bitmap);
 	kfree(mapping->fast);
 	iommu_domain_free(mapping->domain);
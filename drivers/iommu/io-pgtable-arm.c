@@ -214,6 +214,9 @@ struct arm_lpae_io_pgtable {
 
 	void			*pgd;
 	void			*pgd_ttbr1;
+
+	/* set when an unmap freed a table, see arm_lpae_unmap() */
+	bool			tables_freed;
 };
 
 typedef u64 arm_lpae_iopte;
@@ -834,6 +837,7 @@ static int __arm_lpae_unmap(struct arm_lpae_io_pgtable *data,
 			/* Also flush any partial walks */
 			ptep = iopte_deref(pte, data);
 			__arm_lpae_free_pgtable(data, lvl + 1, ptep);
+			data->tables_freed = true;
 		}
 
 		return size;
@@ -867,6 +871,7 @@ static int __arm_lpae_unmap(struct arm_lpae_io_pgtable *data,
 			/* no valid mappings left under this table. free it. */
 			__arm_lpae_set_pte(ptep, 0, &iop->cfg);
 			__arm_lpae_free_pgtable(data, lvl + 1, table_base);
+			data->tables_freed = true;
 		}
 
 		return entries * entry_size;
@@ -891,6 +896,7 @@ static size_t arm_lpae_unmap(struct io_pgtable_ops *ops, unsigned long iova,
 	struct arm_lpae_io_pgtable *data = io_pgtable_ops_to_data(ops);
 	arm_lpae_iopte *ptep = data->pgd;
 	int lvl = ARM_LPAE_START_LVL(data);
+	unsigned long start = iova;
 
 	if (WARN_ON(iova >= (1ULL << data->iop.cfg.ias)))
 		return 0;
@@ -911,8 +917,21 @@ static size_t arm_lpae_unmap(struct io_pgtable_ops *ops, unsigned long iova,
 		unmapped += ret;
 		iova += ret;
 	}
-	if (unmapped)
-		io_pgtable_tlb_flush_all(&data->iop);
+
+	/*
+	 * The owner may batch the invalidation of plain leaf unmaps, but
+	 * freed tables can still be referenced from the walk caches and are
+	 * always flushed right away.
+	 */
+	if (unmapped) {
+		if (data->iop.tlb_flush_deferred && !data->tables_freed) {
+			io_pgtable_tlb_gather_add(&data->iop, start, unmapped);
+		} else {
+			io_pgtable_tlb_flush_all(&data->iop);
+			data->iop.tlb_flush_pending = false;
+		}
+	}
+	data->tables_freed = false;
 
 	return unmapped;
 }
@@ -220,14 +220,29 @@ void free_io_pgtable_ops(struct io_pgtable_ops *ops);
  *          any callback routines.
  * @cfg:    A copy of the page table configuration.
  * @ops:    The page table operations in use for this set of page tables.
+ * @tlb_flush_deferred: Unmaps leave the TLB invalidation to the owner, who
+ *          must make sure nothing else unmaps until it has flushed.
+ * @tlb_flush_pending: An unmap skipped its TLB invalidation.
+ * @tlb_gather_start: Start of the range of the skipped invalidations.
+ * @tlb_gather_end: End of that range, exclusive.
  */
 struct io_pgtable {
 	enum io_pgtable_fmt	fmt;
 	void			*cookie;
 	struct io_pgtable_cfg	cfg;
 	struct io_pgtable_ops	ops;
+	bool			tlb_flush_deferred;
+	bool			tlb_flush_pending;
+	unsigned long		tlb_gather_start;
+	unsigned long		tlb_gather_end;
 };
 
+/*
+ * Above this many invalidations by VA for a gathered range, invalidating
+ * the whole context is cheaper.
+ */
+#define IO_PGTABLE_GATHER_MAX_INV	64
+
 #define io_pgtable_ops_to_pgtable(x) container_of((x), struct io_pgtable, ops)
 
 static inline void io_pgtable_tlb_flush_all(struct io_pgtable *iop)
@@ -252,6 +267,43 @@ static inline void io_pgtable_tlb_sync(struct io_pgtable *iop)
 	iop->cfg.tlb->tlb_sync(iop->cookie);
 }
 
+/* Add a skipped leaf invalidation of [iova, iova + size) to the gather */
+static inline void io_pgtable_tlb_gather_add(struct io_pgtable *iop,
+		unsigned long iova, size_t size)
+{
+	if (!iop->tlb_flush_pending) {
+		iop->tlb_gather_start = iova;
+		iop->tlb_gather_end = iova + size;
+		iop->tlb_flush_pending = true;
+		return;
+	}
+
+	iop->tlb_gather_start = min(iop->tlb_gather_start, iova);
+	iop->tlb_gather_end = max(iop->tlb_gather_end, iova + size);
+}
+
+/*
+ * Issue the gathered invalidations with a single sync, by VA for a small
+ * range and for the whole context otherwise.
+ */
+static inline void io_pgtable_tlb_flush_gather(struct io_pgtable *iop)
+{
+	size_t granule = 1UL << __ffs(iop->cfg.pgsize_bitmap);
+	size_t size = iop->tlb_gather_end - iop->tlb_gather_start;
+
+	if (!iop->tlb_flush_pending)
+		return;
+
+	if (size && size / granule <= IO_PGTABLE_GATHER_MAX_INV) {
+		io_pgtable_tlb_add_flush(iop, iop->tlb_gather_start,
+				ALIGN(size, granule), granule, true);
+		io_pgtable_tlb_sync(iop);
+	} else {
+		io_pgtable_tlb_flush_all(iop);
+	}
+	iop->tlb_flush_pending = false;
+}
+
 /**
  * struct io_pgtable_init_fns - Alloc/free a set of page tables for a
  *                              particular format.
@@ -17,6 +17,10 @@
 #include <linux/rbtree.h>
 #include <linux/mutex.h>
 #include <linux/err.h>
+#include <linux/debugfs.h>
+#include <linux/moduleparam.h>
+#include <linux/seq_file.h>
+#include <linux/shrinker.h>
 #include <asm/barrier.h>
 
 #include <linux/msm_dma_iommu_mapping.h>
@@ -32,6 +36,8 @@
  * @ref - for reference counting this mapping
  * @attrs - dma mapping attributes
  * @buf_start_addr - address of start of buffer
+ * @lru - node in the warm mapping lru while @warm is set
+ * @warm - no users left, mapping kept for reuse. Protected by the meta lock.
  *
  * Represents a mapping of one dma_buf buffer to a particular device
  * and address range. There may exist other mappings of this buffer in
@@ -48,6 +54,8 @@ struct msm_iommu_map {
 	struct kref ref;
 	unsigned long attrs;
 	dma_addr_t buf_start_addr;
+	struct list_head lru;
+	bool warm;
 };
 
 struct msm_iommu_meta {
@@ -56,11 +64,34 @@ struct msm_iommu_meta {
 	struct kref ref;
 	struct mutex lock;
 	void *buffer;
+	bool late_ref;
 };
 
 static struct rb_root iommu_root;
 static DEFINE_MUTEX(msm_iommu_map_mutex);
 
+/*
+ * Mappings made with DMA_ATTR_NO_DELAYED_UNMAP are normally torn down as
+ * soon as their last user unmaps them, yet display, GPU and video map the
+ * same buffers again on the next frame. Instead they are parked, still
+ * mapped, on an lru of at most lru_max entries and handed back on the
+ * next map of the same buffer for the same device. Each parked mapping
+ * holds a meta reference. The oldest ones are unmapped in batches when
+ * the lru overflows or from the shrinker.
+ *
+ * Lock order is msm_iommu_map_mutex, meta->lock, msm_iommu_lru_lock. The
+ * evictor only trylocks meta->lock while holding the lru lock.
+ */
+static LIST_HEAD(msm_iommu_lru);
+static DEFINE_MUTEX(msm_iommu_lru_lock);
+static unsigned long msm_iommu_lru_count;
+static unsigned int lru_max = 64;
+module_param(lru_max, uint, 0644);
+
+static atomic_long_t msm_iommu_lru_hits;
+static atomic_long_t msm_iommu_lru_misses;
+static atomic_long_t msm_iommu_lru_evictions;
+
 static void msm_iommu_meta_add(struct msm_iommu_meta *meta)
 {
 	struct rb_root *root = &iommu_root;
@@ -164,6 +195,96 @@ static struct scatterlist *clone_sgl(struct scatterlist *sg, int nents)
 	return table.sgl;
 }
 
+static void msm_iommu_meta_destroy(struct kref *kref);
+
+static void msm_iommu_map_unmap(struct msm_iommu_map *map)
+{
+	struct sg_table table;
+
+	table.nents = table.orig_nents = map->nents;
+	table.sgl = map->sgl;
+
+	/* Skip an additional cache maintenance on the dma unmap path */
+	if (!(map->attrs & DMA_ATTR_SKIP_CPU_SYNC))
+		map->attrs |= DMA_ATTR_SKIP_CPU_SYNC;
+	dma_unmap_sg_attrs(map->dev, map->sgl, map->nents, map->dir,
+			map->attrs);
+	sg_free_table(&table);
+	kfree(map);
+}
+
+/*
+ * Take a warm mapping off the lru. Called with the meta lock held, the
+ * meta reference the lru held is left for the caller to drop.
+ */
+static void msm_iommu_lru_del(struct msm_iommu_map *map)
+{
+	mutex_lock(&msm_iommu_lru_lock);
+	list_del(&map->lru);
+	msm_iommu_lru_count--;
+	mutex_unlock(&msm_iommu_lru_lock);
+	map->warm = false;
+}
+
+/*
+ * Unmap up to @nr of the oldest warm mappings. They are collected under
+ * the locks and unmapped together afterwards. Returns the number freed.
+ */
+static unsigned long msm_iommu_lru_evict(unsigned long nr)
+{
+	struct msm_iommu_map *map, *tmp;
+	unsigned long freed = 0;
+	LIST_HEAD(batch);
+
+	mutex_lock(&msm_iommu_lru_lock);
+	list_for_each_entry_safe_reverse(map, tmp, &msm_iommu_lru, lru) {
+		if (freed >= nr)
+			break;
+		if (!mutex_trylock(&map->meta->lock))
+			continue;
+		list_del(&map->lru);
+		msm_iommu_lru_count--;
+		map->warm = false;
+		list_del(&map->lnode);
+		mutex_unlock(&map->meta->lock);
+		list_add_tail(&map->lnode, &batch);
+		freed++;
+	}
+	mutex_unlock(&msm_iommu_lru_lock);
+
+	list_for_each_entry_safe(map, tmp, &batch, lnode) {
+		struct msm_iommu_meta *meta = map->meta;
+
+		list_del(&map->lnode);
+		msm_iommu_map_unmap(map);
+		msm_iommu_meta_put(meta);
+	}
+	atomic_long_add(freed, &msm_iommu_lru_evictions);
+
+	return freed;
+}
+
+static unsigned long msm_iommu_lru_shrink_count(struct shrinker *shrinker,
+						struct shrink_control *sc)
+{
+	return READ_ONCE(msm_iommu_lru_count);
+}
+
+static unsigned long msm_iommu_lru_shrink_scan(struct shrinker *shrinker,
+					       struct shrink_control *sc)
+{
+	unsigned long freed;
+
+	freed = msm_iommu_lru_evict(sc->nr_to_scan);
+	return freed ? freed : SHRINK_STOP;
+}
+
+static struct shrinker msm_iommu_lru_shrinker = {
+	.count_objects = msm_iommu_lru_shrink_count,
+	.scan_objects = msm_iommu_lru_shrink_scan,
+	.seeks = DEFAULT_SEEKS,
+};
+
 static inline int __msm_dma_map_sg(struct device *dev, struct scatterlist *sg,
 				   int nents, enum dma_data_direction dir,
 				   struct dma_buf *dma_buf,
@@ -173,6 +294,7 @@ static inline int __msm_dma_map_sg(struct device *dev, struct scatterlist *sg,
 	struct msm_iommu_meta *iommu_meta = NULL;
 	int ret = 0;
 	bool extra_meta_ref_taken = false;
+	bool was_warm = false;
 	int late_unmap = !(attrs & DMA_ATTR_NO_DELAYED_UNMAP);
 
 	mutex_lock(&msm_iommu_map_mutex);
@@ -188,6 +310,7 @@ static inline int __msm_dma_map_sg(struct device *dev, struct scatterlist *sg,
 		}
 		if (late_unmap) {
 			kref_get(&iommu_meta->ref);
+			iommu_meta->late_ref = true;
 			extra_meta_ref_taken = true;
 		}
 	} else {
@@ -223,6 +346,8 @@ static inline int __msm_dma_map_sg(struct device *dev, struct scatterlist *sg,
 		iommu_map->dir = dir;
 		iommu_map->attrs = attrs;
 		iommu_map->buf_start_addr = sg_phys(sg);
+		iommu_map->warm = false;
+		atomic_long_inc(&msm_iommu_lru_misses);
 
 		kref_init(&iommu_map->ref);
 		if (late_unmap)
@@ -251,7 +376,14 @@ static inline int __msm_dma_map_sg(struct device *dev, struct scatterlist *sg,
 					break;
 			}
 
-			kref_get(&iommu_map->ref);
+			/* the lru's reference now belongs to this user */
+			if (iommu_map->warm) {
+				msm_iommu_lru_del(iommu_map);
+				atomic_long_inc(&msm_iommu_lru_hits);
+				was_warm = true;
+			} else {
+				kref_get(&iommu_map->ref);
+			}
 
 			if ((attrs & DMA_ATTR_SKIP_CPU_SYNC) == 0)
 				dma_sync_sg_for_device(dev, iommu_map->sgl,
@@ -281,14 +413,19 @@ static inline int __msm_dma_map_sg(struct device *dev, struct scatterlist *sg,
 		}
 	}
 	mutex_unlock(&iommu_meta->lock);
+	/* we still hold our own meta reference */
+	if (was_warm)
+		msm_iommu_meta_put(iommu_meta);
 	return ret;
 
 out_unlock:
 	mutex_unlock(&iommu_meta->lock);
 out:
 	if (!IS_ERR(iommu_meta)) {
-		if (extra_meta_ref_taken)
+		if (extra_meta_ref_taken) {
+			iommu_meta->late_ref = false;
 			msm_iommu_meta_put(iommu_meta);
+		}
 		msm_iommu_meta_put(iommu_meta);
 	}
 	return ret;
@@ -354,19 +491,29 @@ static void msm_iommu_map_release(struct kref *kref)
 {
 	struct msm_iommu_map *map = container_of(kref, struct msm_iommu_map,
 						ref);
-	struct sg_table table;
 
-	table.nents = table.orig_nents = map->nents;
-	table.sgl = map->sgl;
 	list_del(&map->lnode);
+	msm_iommu_map_unmap(map);
+}
 
-	/* Skip an additional cache maintenance on the dma unmap path */
-	if (!(map->attrs & DMA_ATTR_SKIP_CPU_SYNC))
-		map->attrs |= DMA_ATTR_SKIP_CPU_SYNC;
-	dma_unmap_sg_attrs(map->dev, map->sgl, map->nents, map->dir,
-			map->attrs);
-	sg_free_table(&table);
-	kfree(map);
+/*
+ * Drop a user's reference. The last one parks the mapping on the lru
+ * instead of unmapping it, keeping the caller's meta reference for the
+ * lru. Returns true if the meta reference was taken over.
+ */
+static bool msm_iommu_map_put(struct msm_iommu_map *map)
+{
+	if (lru_max && kref_read(&map->ref) == 1) {
+		map->warm = true;
+		mutex_lock(&msm_iommu_lru_lock);
+		list_add(&map->lru, &msm_iommu_lru);
+		msm_iommu_lru_count++;
+		mutex_unlock(&msm_iommu_lru_lock);
+		return true;
+	}
+
+	kref_put(&map->ref, msm_iommu_map_release);
+	return false;
 }
 
 void msm_dma_unmap_sg_attrs(struct device *dev, struct scatterlist *sgl,
@@ -375,6 +522,7 @@ void msm_dma_unmap_sg_attrs(struct device *dev, struct scatterlist *sgl,
 {
 	struct msm_iommu_map *iommu_map;
 	struct msm_iommu_meta *meta;
+	bool parked;
 
 	mutex_lock(&msm_iommu_map_mutex);
 	meta = msm_iommu_meta_lookup(dma_buf->priv);
@@ -404,10 +552,13 @@ void msm_dma_unmap_sg_attrs(struct device *dev, struct scatterlist *sgl,
 		dma_sync_sg_for_cpu(dev, iommu_map->sgl, iommu_map->nents, dir);
 
 	iommu_map->attrs = attrs;
-	kref_put(&iommu_map->ref, msm_iommu_map_release);
+	parked = msm_iommu_map_put(iommu_map);
 	mutex_unlock(&meta->lock);
 
-	msm_iommu_meta_put(meta);
+	if (!parked)
+		msm_iommu_meta_put(meta);
+	else if (READ_ONCE(msm_iommu_lru_count) > lru_max)
+		msm_iommu_lru_evict(READ_ONCE(msm_iommu_lru_count) - lru_max);
 
 out:
 	return;
@@ -427,18 +578,29 @@ int msm_dma_unmap_all_for_dev(struct device *dev)
 	while (meta_node) {
 		struct msm_iommu_map *iommu_map;
 		struct msm_iommu_map *iommu_map_next;
+		int nr_warm = 0;
 
 		meta = rb_entry(meta_node, struct msm_iommu_meta, node);
 		mutex_lock(&meta->lock);
 		list_for_each_entry_safe(iommu_map, iommu_map_next,
-						&meta->iommu_maps, lnode)
-			if (iommu_map->dev == dev)
-				if (!kref_put(&iommu_map->ref,
-						msm_iommu_map_release))
-					ret = -EINVAL;
+						&meta->iommu_maps, lnode) {
+			if (iommu_map->dev != dev)
+				continue;
+			if (iommu_map->warm) {
+				msm_iommu_lru_del(iommu_map);
+				nr_warm++;
+			}
+			if (!kref_put(&iommu_map->ref,
+					msm_iommu_map_release))
+				ret = -EINVAL;
+		}
 
 		mutex_unlock(&meta->lock);
 		meta_node = rb_next(meta_node);
+
+		/* drop the lru's meta references, may erase meta */
+		while (nr_warm--)
+			kref_put(&meta->ref, msm_iommu_meta_destroy);
 	}
 	mutex_unlock(&msm_iommu_map_mutex);
 
@@ -453,6 +615,8 @@ void msm_dma_buf_freed(void *buffer)
 	struct msm_iommu_map *iommu_map;
 	struct msm_iommu_map *iommu_map_next;
 	struct msm_iommu_meta *meta;
+	bool late_ref;
+	int nr_warm = 0;
 
 	mutex_lock(&msm_iommu_map_mutex);
 	meta = msm_iommu_meta_lookup(buffer);
@@ -466,8 +630,13 @@ void msm_dma_buf_freed(void *buffer)
 	mutex_lock(&meta->lock);
 
 	list_for_each_entry_safe(iommu_map, iommu_map_next, &meta->iommu_maps,
-				 lnode)
+				 lnode) {
+		if (iommu_map->warm) {
+			msm_iommu_lru_del(iommu_map);
+			nr_warm++;
+		}
 		kref_put(&iommu_map->ref, msm_iommu_map_release);
+	}
 
 	if (!list_empty(&meta->iommu_maps)) {
 		WARN(1, "%s: DMA buffer %p destroyed with outstanding iommu mappings\n",
@@ -475,7 +644,43 @@ void msm_dma_buf_freed(void *buffer)
 	}
 
 	INIT_LIST_HEAD(&meta->iommu_maps);
+	/* a buffer left with only warm mappings has no late unmap reference */
+	late_ref = meta->late_ref;
 	mutex_unlock(&meta->lock);
 
-	msm_iommu_meta_put(meta);
+	while (nr_warm--)
+		msm_iommu_meta_put(meta);
+	if (late_ref)
+		msm_iommu_meta_put(meta);
+}
+
+static int msm_iommu_lru_stats_show(struct seq_file *s, void *unused)
+{
+	seq_printf(s, "warm: %lu\n", READ_ONCE(msm_iommu_lru_count));
+	seq_printf(s, "hits: %ld\n", atomic_long_read(&msm_iommu_lru_hits));
+	seq_printf(s, "misses: %ld\n",
+		   atomic_long_read(&msm_iommu_lru_misses));
+	seq_printf(s, "evictions: %ld\n",
+		   atomic_long_read(&msm_iommu_lru_evictions));
+	return 0;
+}
+
+static int msm_iommu_lru_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_iommu_lru_stats_show, NULL);
+}
+
+static const struct file_operations msm_iommu_lru_stats_fops = {
+	.open = msm_iommu_lru_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init msm_dma_iommu_mapping_init(void)
+{
+	debugfs_create_file("msm_iommu_map_lru", 0444, NULL, NULL,
+			    &msm_iommu_lru_stats_fops);
+	return register_shrinker(&msm_iommu_lru_shrinker);
 }
+late_initcall(msm_dma_iommu_mapping_init);
@@ -9,11 +9,18 @@
 #include "dm-core.h"
 
 #include <linux/crc32.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 
 #define DM_MSG_PREFIX "bow"
 #define SECTOR_SIZE 512
 
+/*
+ * Writes queued while checkpointing are handled in batches of at most this
+ * many bios, whose backups are committed to the log together.
+ */
+#define BOW_WRITE_BATCH 32
+
 struct log_entry {
 	u64 source;
 	u64 dest;
@@ -79,6 +86,19 @@ enum state {
 	COMMITTED,
 };
 
+/* What writes cost while checkpointing, protected by ranges_lock */
+struct bow_stats {
+	u64 writes;		/* Writes seen in CHECKPOINT state */
+	u64 direct_writes;	/* Writes only to CHANGED ranges */
+	u64 batches;
+	u64 batch_ns;		/* Time spent preparing and committing */
+	u64 backups;
+	u64 backup_bytes;
+	u64 log_entries;
+	u64 log_extends;	/* Backups folded into the previous entry */
+	u64 log_commits;
+};
+
 struct bow_context {
 	struct dm_dev *dev;
 	u32 block_size;
@@ -93,6 +113,23 @@ struct bow_context {
 	struct log_sector *log_sector;
 	struct list_head trimmed_list;
 	bool forward_trims;
+	/* Range found last, tried first by find_first_overlapping_range */
+	struct bow_range *hint;
+
+	/* Writes waiting for bow_write_batch */
+	spinlock_t write_lock;
+	struct bio_list write_bios;
+	struct work_struct write_work;
+
+	/*
+	 * While batching, backups are left dirty in bufio and log entries
+	 * only added to log_sector until bow_log_commit writes both.
+	 */
+	bool batching;
+	bool log_dirty;
+	/* The last log entry may be extended by a following backup */
+	bool log_chainable;
+	struct bow_stats stats;
 };
 
 sector_t range_top(struct bow_range *br)
@@ -115,21 +152,33 @@ static sector_t bvec_top(struct bvec_iter *bi_iter)
  * Find the first range that overlaps with bi_iter
  * bi_iter is set to the size of the overlapping sub-range
  */
-static struct bow_range *find_first_overlapping_range(struct rb_root *ranges,
+static bool range_contains(struct bow_range *br, sector_t sector)
+{
+	return br->sector <= sector && sector < range_top(br);
+}
+
+static struct bow_range *find_first_overlapping_range(struct bow_context *bc,
 						      struct bvec_iter *bi_iter)
 {
-	struct rb_node *node = ranges->rb_node;
-	struct bow_range *br;
+	struct rb_node *node = bc->ranges.rb_node;
+	struct bow_range *br = bc->hint;
+
+	/* Writes are mostly sequential, so try the last range and the next */
+	if (br && br->type != TOP) {
+		if (range_contains(br, bi_iter->bi_sector))
+			goto found;
+		br = container_of(rb_next(&br->node), struct bow_range, node);
+		if (br->type != TOP && range_contains(br, bi_iter->bi_sector))
+			goto found;
+	}
 
 	while (node) {
 		br = container_of(node, struct bow_range, node);
 
-		if (br->sector <= bi_iter->bi_sector
-		    && bi_iter->bi_sector < range_top(br))
-			break;
-
 		if (bi_iter->bi_sector < br->sector)
 			node = node->rb_left;
+		else if (bi_iter->bi_sector < range_top(br))
+			break;
 		else
 			node = node->rb_right;
 	}
@@ -138,6 +187,9 @@ static struct bow_range *find_first_overlapping_range(struct rb_root *ranges,
 	if (!node)
 		return NULL;
 
+found:
+	bc->hint = br;
+
 	if (range_top(br) - bi_iter->bi_sector
 	    < bi_iter->bi_size >> SECTOR_SHIFT)
 		bi_iter->bi_size = (range_top(br) - bi_iter->bi_sector)
@@ -241,6 +293,8 @@ static void set_type(struct bow_context *bc, struct bow_range **br, int type)
 		if (type == TRIMMED)
 			list_del(&next->trimmed_list);
 		rb_erase(&next->node, &bc->ranges);
+		if (bc->hint == next)
+			bc->hint = NULL;
 		kfree(next);
 	}
 
@@ -248,6 +302,8 @@ static void set_type(struct bow_context *bc, struct bow_range **br, int type)
 		if (type == TRIMMED)
 			list_del(&(*br)->trimmed_list);
 		rb_erase(&(*br)->node, &bc->ranges);
+		if (bc->hint == *br)
+			bc->hint = NULL;
 		kfree(*br);
 	}
 
@@ -272,10 +328,16 @@ static sector_t sector_to_page(struct bow_context const *bc, sector_t sector)
 	return sector >> (bc->block_shift - SECTOR_SHIFT);
 }
 
+/*
+ * Copy source to dest and, unless checksum is NULL, compute the crc of the
+ * data seeded with the first source page, or continue the one in *checksum
+ * when chain is set.  While batching, the copy is written by bow_log_commit.
+ */
 static int copy_data(struct bow_context const *bc,
 		     struct bow_range *source, struct bow_range *dest,
-		     u32 *checksum)
+		     u32 *checksum, bool chain)
 {
+	unsigned int count = range_size(source) >> bc->block_shift;
 	int i;
 
 	if (range_size(source) != range_size(dest)) {
@@ -283,10 +345,15 @@ static int copy_data(struct bow_context const *bc,
 		return BLK_STS_IOERR;
 	}
 
-	if (checksum)
+	if (checksum && !chain)
 		*checksum = sector_to_page(bc, source->sector);
 
-	for (i = 0; i < range_size(source) >> bc->block_shift; ++i) {
+	/* Read the whole range at once rather than a block at a time */
+	if (count > 1)
+		dm_bufio_prefetch(bc->bufio, sector_to_page(bc, source->sector),
+				  count);
+
+	for (i = 0; i < count; ++i) {
 		struct dm_buffer *read_buffer, *write_buffer;
 		u8 *read, *write;
 		sector_t page = sector_to_page(bc, source->sector) + i;
@@ -317,7 +384,8 @@ static int copy_data(struct bow_context const *bc,
 		dm_bufio_release(read_buffer);
 	}
 
-	dm_bufio_write_dirty_buffers(bc->bufio);
+	if (!bc->batching)
+		dm_bufio_write_dirty_buffers(bc->bufio);
 	return BLK_STS_OK;
 }
 
@@ -326,6 +394,50 @@ static int copy_data(struct bow_context const *bc,
 static int add_log_entry(struct bow_context *bc, sector_t source, sector_t dest,
 			 unsigned int size, u32 checksum);
 
+static int write_log_sector(struct bow_context *bc)
+{
+	struct dm_buffer *sector_buffer;
+	u8 *sector;
+
+	sector = dm_bufio_new(bc->bufio, 0, &sector_buffer);
+	if (IS_ERR(sector)) {
+		DMERR("Cannot write boot sector");
+		return BLK_STS_NOSPC;
+	}
+
+	memcpy(sector, bc->log_sector, bc->block_size);
+	dm_bufio_mark_buffer_dirty(sector_buffer);
+	dm_bufio_release(sector_buffer);
+	dm_bufio_write_dirty_buffers(bc->bufio);
+	return BLK_STS_OK;
+}
+
+/*
+ * Write the backups of the current batch and then the log entries that
+ * point at them.  The first write must complete before the log sector is
+ * dirtied, or both could go out together and the log could land first.
+ */
+static int bow_log_commit(struct bow_context *bc)
+{
+	int ret;
+
+	if (!bc->log_dirty)
+		return BLK_STS_OK;
+
+	if (dm_bufio_write_dirty_buffers(bc->bufio)) {
+		DMERR("Cannot write backup data");
+		return BLK_STS_IOERR;
+	}
+
+	ret = write_log_sector(bc);
+	if (ret)
+		return ret;
+
+	bc->log_dirty = false;
+	bc->stats.log_commits++;
+	return BLK_STS_OK;
+}
+
 static int backup_log_sector(struct bow_context *bc)
 {
 	struct bow_range *first_br, *free_br;
@@ -359,12 +471,13 @@ static int backup_log_sector(struct bow_context *bc)
 		return BLK_STS_IOERR;
 	}
 
-	ret = copy_data(bc, first_br, free_br, &checksum);
+	ret = copy_data(bc, first_br, free_br, &checksum, false);
 	if (ret)
 		return ret;
 
 	bc->log_sector->count = 0;
 	bc->log_sector->sequence++;
+	bc->log_chainable = false;
 	ret = add_log_entry(bc, first_br->sector, free_br->sector,
 			    range_size(first_br), checksum);
 	if (ret)
@@ -377,23 +490,22 @@ static int backup_log_sector(struct bow_context *bc)
 static int add_log_entry(struct bow_context *bc, sector_t source, sector_t dest,
 			 unsigned int size, u32 checksum)
 {
-	struct dm_buffer *sector_buffer;
-	u8 *sector;
+	int ret;
 
 	if (sizeof(struct log_sector)
 	    + sizeof(struct log_entry) * (bc->log_sector->count + 1)
 		> bc->block_size) {
-		int ret = backup_log_sector(bc);
-
+		/*
+		 * The backup takes the log sector as it is on disk, so the
+		 * entries of this batch have to be there first
+		 */
+		ret = bow_log_commit(bc);
 		if (ret)
 			return ret;
-	}
 
-	sector = dm_bufio_new(bc->bufio, 0, &sector_buffer);
-	if (IS_ERR(sector)) {
-		DMERR("Cannot write boot sector");
-		dm_bufio_release(sector_buffer);
-		return BLK_STS_NOSPC;
+		ret = backup_log_sector(bc);
+		if (ret)
+			return ret;
 	}
 
 	bc->log_sector->entries[bc->log_sector->count].source = source;
@@ -401,12 +513,52 @@ static int add_log_entry(struct bow_context *bc, sector_t source, sector_t dest,
 	bc->log_sector->entries[bc->log_sector->count].size = size;
 	bc->log_sector->entries[bc->log_sector->count].checksum = checksum;
 	bc->log_sector->count++;
+	bc->log_chainable = false;
+	bc->stats.log_entries++;
 
-	memcpy(sector, bc->log_sector, bc->block_size);
-	dm_bufio_mark_buffer_dirty(sector_buffer);
-	dm_bufio_release(sector_buffer);
-	dm_bufio_write_dirty_buffers(bc->bufio);
-	return BLK_STS_OK;
+	if (bc->batching) {
+		bc->log_dirty = true;
+		return BLK_STS_OK;
+	}
+
+	return write_log_sector(bc);
+}
+
+/*
+ * Whether a backup of size bytes from source to dest continues the last
+ * log entry on both sides, so that it can be folded into that entry with
+ * the checksum carried on, instead of taking up another one.
+ */
+static bool log_entry_extends(struct bow_context *bc, sector_t source,
+			      sector_t dest, u64 size)
+{
+	struct log_entry *last;
+
+	if (!bc->log_chainable || !bc->log_sector->count)
+		return false;
+
+	last = &bc->log_sector->entries[bc->log_sector->count - 1];
+	return last->source + last->size / SECTOR_SIZE == source &&
+	       last->dest + last->size / SECTOR_SIZE == dest &&
+	       size <= U32_MAX - last->size;
+}
+
+static int extend_log_entry(struct bow_context *bc, unsigned int size,
+			    u32 checksum)
+{
+	struct log_entry *last =
+		&bc->log_sector->entries[bc->log_sector->count - 1];
+
+	last->size += size;
+	last->checksum = checksum;
+	bc->stats.log_extends++;
+
+	if (bc->batching) {
+		bc->log_dirty = true;
+		return BLK_STS_OK;
+	}
+
+	return write_log_sector(bc);
 }
 
 static int prepare_log(struct bow_context *bc)
@@ -450,7 +602,7 @@ static int prepare_log(struct bow_context *bc)
 	free_br->type = SECTOR0_CURRENT;
 
 	/* Copy data */
-	ret = copy_data(bc, first_br, free_br, NULL);
+	ret = copy_data(bc, first_br, free_br, NULL, false);
 	if (ret)
 		return ret;
 
@@ -467,7 +619,7 @@ static int prepare_log(struct bow_context *bc)
 		return ret;
 
 	/* Back up */
-	ret = copy_data(bc, first_br, free_br, &checksum);
+	ret = copy_data(bc, first_br, free_br, &checksum, false);
 	if (ret)
 		return ret;
 
@@ -498,7 +650,7 @@ static struct bow_range *find_sector0_current(struct bow_context *bc)
 
 	bi_iter.bi_sector = bc->log_sector->sector0;
 	bi_iter.bi_size = bc->block_size;
-	return find_first_overlapping_range(&bc->ranges, &bi_iter);
+	return find_first_overlapping_range(bc, &bi_iter);
 }
 
 /****** sysfs interface functions ******/
@@ -550,7 +702,7 @@ static ssize_t state_store(struct kobject *kobj, struct kobj_attribute *attr,
 			container_of(rb_first(&bc->ranges), struct bow_range,
 				     node);
 
-		ret = copy_data(bc, br, sector0_br, 0);
+		ret = copy_data(bc, br, sector0_br, NULL, false);
 		if (ret) {
 			DMERR("Failed to switch to committed state");
 			goto bad;
@@ -578,12 +730,40 @@ static ssize_t free_show(struct kobject *kobj, struct kobj_attribute *attr,
 	return scnprintf(buf, PAGE_SIZE, "%llu\n", trims_total);
 }
 
+static ssize_t stats_show(struct kobject *kobj, struct kobj_attribute *attr,
+			  char *buf)
+{
+	struct bow_context *bc = container_of(kobj, struct bow_context,
+					      kobj_holder.kobj);
+	struct bow_stats s;
+	u64 queued;
+
+	mutex_lock(&bc->ranges_lock);
+	s = bc->stats;
+	mutex_unlock(&bc->ranges_lock);
+
+	queued = s.writes - s.direct_writes;
+	return scnprintf(buf, PAGE_SIZE,
+			 "writes: %llu direct %llu batches %llu\n"
+			 "overhead_us: total %llu per queued write %llu\n"
+			 "backups: %llu bytes %llu\n"
+			 "log: entries %llu extends %llu commits %llu\n",
+			 s.writes, s.direct_writes, s.batches,
+			 div_u64(s.batch_ns, NSEC_PER_USEC),
+			 queued ? div64_u64(s.batch_ns,
+					    queued * NSEC_PER_USEC) : 0,
+			 s.backups, s.backup_bytes,
+			 s.log_entries, s.log_extends, s.log_commits);
+}
+
 static struct kobj_attribute attr_state = __ATTR_RW(state);
 static struct kobj_attribute attr_free = __ATTR_RO(free);
+static struct kobj_attribute attr_stats = __ATTR_RO(stats);
 
 static struct attribute *bow_attrs[] = {
 	&attr_state.attr,
 	&attr_free.attr,
+	&attr_stats.attr,
 	NULL
 };
 
@@ -688,6 +868,8 @@ static int dm_bow_ctr_optional(struct dm_target *ti, unsigned int argc,
 	return 0;
 }
 
+static void bow_write_batch(struct work_struct *work);
+
 static int dm_bow_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 {
 	struct bow_context *bc;
@@ -762,6 +944,9 @@ static int dm_bow_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	}
 
 	INIT_LIST_HEAD(&bc->trimmed_list);
+	spin_lock_init(&bc->write_lock);
+	bio_list_init(&bc->write_bios);
+	INIT_WORK(&bc->write_work, bow_write_batch);
 
 	br = kzalloc(sizeof(*br), GFP_KERNEL);
 	if (!br) {
@@ -812,6 +997,7 @@ static int prepare_unchanged_range(struct bow_context *bc, struct bow_range *br,
 	int ret;
 	int original_type;
 	sector_t sector0;
+	bool extend;
 
 	/* Find a free range */
 	backup_br = find_free_range(bc);
@@ -839,16 +1025,25 @@ static int prepare_unchanged_range(struct bow_context *bc, struct bow_range *br,
 	}
 
 
-	/* Copy data over */
-	ret = copy_data(bc, br, backup_br, record_checksum ? &checksum : NULL);
-	if (ret)
-		return ret;
-
 	/* Add an entry to the log */
 	log_source = br->sector;
 	log_dest = backup_br->sector;
 	log_size = range_size(br);
 
+	extend = record_checksum &&
+		 log_entry_extends(bc, log_source, log_dest, log_size);
+	if (extend)
+		checksum = bc->log_sector->entries[bc->log_sector->count - 1]
+			.checksum;
+
+	/* Copy data over */
+	ret = copy_data(bc, br, backup_br, record_checksum ? &checksum : NULL,
+			extend);
+	if (ret)
+		return ret;
+	bc->stats.backups++;
+	bc->stats.backup_bytes += log_size;
+
 	/*
 	 * Set the types. Note that since set_type also amalgamates ranges
 	 * we have to set both sectors to their final type before calling
@@ -868,15 +1063,29 @@ static int prepare_unchanged_range(struct bow_context *bc, struct bow_range *br,
 	 * Add the log entry after marking the backup sector, since adding a log
 	 * can cause another backup
 	 */
-	ret = add_log_entry(bc, log_source, log_dest, log_size, checksum);
+	if (extend)
+		ret = extend_log_entry(bc, log_size, checksum);
+	else
+		ret = add_log_entry(bc, log_source, log_dest, log_size,
+				    checksum);
 	if (ret) {
 		br->type = original_type;
 		return ret;
 	}
+	bc->log_chainable = record_checksum;
 
-	/* Now it is safe to mark this backup successful */
-	if (original_type == SECTOR0_CURRENT)
+	/*
+	 * Now it is safe to mark this backup successful.  Reads of sector 0
+	 * go straight to the new copy, so it has to be on disk first.
+	 */
+	if (original_type == SECTOR0_CURRENT) {
+		ret = bow_log_commit(bc);
+		if (ret) {
+			br->type = original_type;
+			return ret;
+		}
 		bc->log_sector->sector0 = sector0;
+	}
 
 	set_type(bc, &br, br->type);
 	return ret;
@@ -904,8 +1113,8 @@ static int prepare_changed_range(struct bow_context *bc, struct bow_range *br,
 static int prepare_one_range(struct bow_context *bc,
 			     struct bvec_iter *bi_iter)
 {
-	struct bow_range *br = find_first_overlapping_range(&bc->ranges,
-							    bi_iter);
+	struct bow_range *br = find_first_overlapping_range(bc, bi_iter);
+
 	switch (br->type) {
 	case CHANGED:
 		return prepare_changed_range(bc, br, bi_iter);
@@ -932,23 +1141,11 @@ static int prepare_one_range(struct bow_context *bc,
 	}
 }
 
-struct write_work {
-	struct work_struct work;
-	struct bow_context *bc;
-	struct bio *bio;
-};
-
-static void bow_write(struct work_struct *work)
+static int prepare_write(struct bow_context *bc, struct bio *bio)
 {
-	struct write_work *ww = container_of(work, struct write_work, work);
-	struct bow_context *bc = ww->bc;
-	struct bio *bio = ww->bio;
 	struct bvec_iter bi_iter = bio->bi_iter;
 	int ret = BLK_STS_OK;
 
-	kfree(ww);
-
-	mutex_lock(&bc->ranges_lock);
 	do {
 		ret = prepare_one_range(bc, &bi_iter);
 		bi_iter.bi_sector += bi_iter.bi_size / SECTOR_SIZE;
@@ -957,34 +1154,95 @@ static void bow_write(struct work_struct *work)
 			  * SECTOR_SIZE;
 	} while (!ret && bi_iter.bi_size);
 
-	mutex_unlock(&bc->ranges_lock);
+	return ret;
+}
 
-	if (!ret) {
-		bio_set_dev(bio, bc->dev->bdev);
-		submit_bio(bio);
-	} else {
-		DMERR("Write failure with error %d", -ret);
-		bio->bi_status = ret;
-		bio_endio(bio);
+/*
+ * Back up what the queued writes overwrite, a batch at a time, with one
+ * commit of the backups and the log for the whole batch, and only then let
+ * the writes go.  ranges_lock is held until the commit, so that dm_bow_map
+ * doesn't pass a write to a range that was only just marked CHANGED.
+ */
+static void bow_write_batch(struct work_struct *work)
+{
+	struct bow_context *bc = container_of(work, struct bow_context,
+					      write_work);
+	struct bio_list bios, ready;
+	struct bio *bio;
+	unsigned int n;
+	ktime_t start;
+	int ret;
+
+	for (;;) {
+		bio_list_init(&bios);
+		spin_lock_irq(&bc->write_lock);
+		for (n = 0; n < BOW_WRITE_BATCH; n++) {
+			bio = bio_list_pop(&bc->write_bios);
+			if (!bio)
+				break;
+			bio_list_add(&bios, bio);
+		}
+		spin_unlock_irq(&bc->write_lock);
+		if (!n)
+			break;
+
+		bio_list_init(&ready);
+		mutex_lock(&bc->ranges_lock);
+		start = ktime_get();
+		bc->batching = true;
+		while ((bio = bio_list_pop(&bios))) {
+			ret = prepare_write(bc, bio);
+			if (ret) {
+				DMERR("Write failure with error %d", -ret);
+				bio->bi_status = ret;
+				bio_endio(bio);
+				continue;
+			}
+			bio_list_add(&ready, bio);
+		}
+		ret = bow_log_commit(bc);
+		bc->batching = false;
+		bc->stats.batches++;
+		bc->stats.batch_ns += ktime_to_ns(ktime_sub(ktime_get(),
+							    start));
+		mutex_unlock(&bc->ranges_lock);
+
+		while ((bio = bio_list_pop(&ready))) {
+			if (ret) {
+				DMERR("Write failure with error %d", -ret);
+				bio->bi_status = ret;
+				bio_endio(bio);
+				continue;
+			}
+			bio_set_dev(bio, bc->dev->bdev);
+			submit_bio(bio);
+		}
 	}
 }
 
 static int queue_write(struct bow_context *bc, struct bio *bio)
 {
-	struct write_work *ww = kmalloc(sizeof(*ww), GFP_NOIO | __GFP_NORETRY
-					| __GFP_NOMEMALLOC | __GFP_NOWARN);
-	if (!ww) {
-		DMERR("Failed to allocate write_work");
-		return -ENOMEM;
-	}
+	unsigned long flags;
+
+	spin_lock_irqsave(&bc->write_lock, flags);
+	bio_list_add(&bc->write_bios, bio);
+	spin_unlock_irqrestore(&bc->write_lock, flags);
 
-	INIT_WORK(&ww->work, bow_write);
-	ww->bc = bc;
-	ww->bio = bio;
-	queue_work(bc->workqueue, &ww->work);
+	queue_work(bc->workqueue, &bc->write_work);
 	return DM_MAPIO_SUBMITTED;
 }
 
+/* Whether all of bio lies in a range that was already backed up */
+static bool write_is_changed(struct bow_context *bc, struct bio *bio)
+{
+	struct bvec_iter bi_iter = bio->bi_iter;
+	struct bow_range *br;
+
+	br = find_first_overlapping_range(bc, &bi_iter);
+	return br && br->type == CHANGED &&
+	       bi_iter.bi_size == bio->bi_iter.bi_size;
+}
+
 static int handle_sector0(struct bow_context *bc, struct bio *bio)
 {
 	int ret = DM_MAPIO_REMAPPED;
@@ -1025,7 +1283,7 @@ static int add_trim(struct bow_context *bc, struct bio *bio)
 		bio->bi_iter.bi_size);
 
 	do {
-		br = find_first_overlapping_range(&bc->ranges, &bi_iter);
+		br = find_first_overlapping_range(bc, &bi_iter);
 
 		switch (br->type) {
 		case UNCHANGED:
@@ -1064,7 +1322,7 @@ static int remove_trim(struct bow_context *bc, struct bio *bio)
 		bio->bi_iter.bi_size);
 
 	do {
-		br = find_first_overlapping_range(&bc->ranges, &bi_iter);
+		br = find_first_overlapping_range(bc, &bi_iter);
 
 		switch (br->type) {
 		case UNCHANGED:
@@ -1130,8 +1388,13 @@ static int dm_bow_map(struct dm_target *ti, struct bio *bio)
 			else
 				/* pass-through */;
 		} else if (state == CHECKPOINT) {
+			if (bio_data_dir(bio) == WRITE)
+				bc->stats.writes++;
 			if (bio->bi_iter.bi_sector == 0)
 				ret = handle_sector0(bc, bio);
+			else if (bio_data_dir(bio) == WRITE &&
+				 write_is_changed(bc, bio))
+				bc->stats.direct_writes++;
 			else if (bio_data_dir(bio) == WRITE)
 				ret = queue_write(bc, bio);
 			else
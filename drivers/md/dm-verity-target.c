@@ -12,6 +12,9 @@
  * hash device. Setting this greatly improves performance when data and hash
  * are on the same disk on different partitions on devices with poor random
  * access behavior.
+ *
+ * With "prefetch_readahead" set, the hash blocks for the next read-ahead
+ * window of the verity device are prefetched along with those of each bio.
  */
 
 #include "dm-verity.h"
@@ -19,6 +22,8 @@
 
 #include <linux/module.h>
 #include <linux/reboot.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #define DM_MSG_PREFIX			"verity"
 
@@ -40,6 +45,22 @@ static unsigned dm_verity_prefetch_cluster = DM_VERITY_DEFAULT_PREFETCH_SIZE;
 
 module_param_named(prefetch_cluster, dm_verity_prefetch_cluster, uint, S_IRUGO | S_IWUSR);
 
+/*
+ * Also prefetch the hash blocks of the next read-ahead window of the
+ * device, so that the following read-ahead doesn't wait for them.
+ */
+static bool dm_verity_prefetch_readahead = true;
+
+module_param_named(prefetch_readahead, dm_verity_prefetch_readahead, bool, S_IRUGO | S_IWUSR);
+
+static struct dentry *dm_verity_debugfs_root;
+
+#define verity_stat_inc(v, field, n)				\
+	do {							\
+		if ((v)->stats)					\
+			this_cpu_add((v)->stats->field, (n));	\
+	} while (0)
+
 struct dm_verity_prefetch_work {
 	struct work_struct work;
 	struct dm_verity *v;
@@ -343,6 +364,7 @@ static int verity_verify_level(struct dm_verity *v, struct dm_verity_io *io,
 				verity_io_real_digest(v, io));
 		if (unlikely(r < 0))
 			goto release_ret_r;
+		verity_stat_inc(v, hash_verified, 1);
 
 		if (likely(memcmp(verity_io_real_digest(v, io), want_digest,
 				  v->digest_size) == 0))
@@ -525,6 +547,7 @@ static int verity_verify_io(struct dm_verity_io *io)
 		if (v->validated_blocks &&
 		    likely(test_bit(cur_block, v->validated_blocks))) {
 			verity_bv_skip_block(v, io, &io->iter);
+			verity_stat_inc(v, data_skipped, 1);
 			continue;
 		}
 
@@ -544,6 +567,7 @@ static int verity_verify_io(struct dm_verity_io *io)
 			if (unlikely(r < 0))
 				return r;
 
+			verity_stat_inc(v, data_zero, 1);
 			continue;
 		}
 
@@ -560,6 +584,7 @@ static int verity_verify_io(struct dm_verity_io *io)
 					&res);
 		if (unlikely(r < 0))
 			return r;
+		verity_stat_inc(v, data_verified, 1);
 
 		if (likely(memcmp(verity_io_real_digest(v, io),
 				  verity_io_want_digest(v, io), v->digest_size) == 0)) {
@@ -659,12 +684,15 @@ static void verity_prefetch_io(struct work_struct *work)
 no_prefetch_cluster:
 		dm_bufio_prefetch(v->bufio, hash_block_start,
 				  hash_block_end - hash_block_start + 1);
+		verity_stat_inc(v, hash_prefetched,
+				hash_block_end - hash_block_start + 1);
 	}
 
 	kfree(pw);
 }
 
-static void verity_submit_prefetch(struct dm_verity *v, struct dm_verity_io *io)
+static void verity_submit_prefetch(struct dm_verity *v, struct dm_verity_io *io,
+				   unsigned ra_blocks)
 {
 	struct dm_verity_prefetch_work *pw;
 
@@ -678,6 +706,12 @@ static void verity_submit_prefetch(struct dm_verity *v, struct dm_verity_io *io)
 	pw->v = v;
 	pw->block = io->block;
 	pw->n_blocks = io->n_blocks;
+	if (ra_blocks) {
+		sector_t end = min_t(sector_t, v->data_blocks,
+				     io->block + io->n_blocks + ra_blocks);
+
+		pw->n_blocks = end - io->block;
+	}
 	queue_work(v->verify_wq, &pw->work);
 }
 
@@ -689,6 +723,11 @@ int verity_map(struct dm_target *ti, struct bio *bio)
 {
 	struct dm_verity *v = ti->private;
 	struct dm_verity_io *io;
+	unsigned ra_blocks = 0;
+
+	if (READ_ONCE(dm_verity_prefetch_readahead))
+		ra_blocks = (bio->bi_disk->queue->backing_dev_info->ra_pages <<
+			     PAGE_SHIFT) >> v->data_dev_block_bits;
 
 	bio_set_dev(bio, v->data_dev->bdev);
 	bio->bi_iter.bi_sector = verity_map_sector(v, bio->bi_iter.bi_sector);
@@ -720,7 +759,7 @@ int verity_map(struct dm_target *ti, struct bio *bio)
 
 	verity_fec_init_io(io);
 
-	verity_submit_prefetch(v, io);
+	verity_submit_prefetch(v, io, ra_blocks);
 
 	generic_make_request(bio);
 
@@ -833,10 +872,71 @@ void verity_io_hints(struct dm_target *ti, struct queue_limits *limits)
 }
 EXPORT_SYMBOL_GPL(verity_io_hints);
 
+static int verity_stats_show(struct seq_file *m, void *unused)
+{
+	struct dm_verity *v = m->private;
+	struct dm_verity_stats sum = {};
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct dm_verity_stats *s = per_cpu_ptr(v->stats, cpu);
+
+		sum.data_verified += READ_ONCE(s->data_verified);
+		sum.data_skipped += READ_ONCE(s->data_skipped);
+		sum.data_zero += READ_ONCE(s->data_zero);
+		sum.hash_verified += READ_ONCE(s->hash_verified);
+		sum.hash_prefetched += READ_ONCE(s->hash_prefetched);
+	}
+
+	seq_printf(m, "data_verified %llu\n", sum.data_verified);
+	seq_printf(m, "data_skipped %llu\n", sum.data_skipped);
+	seq_printf(m, "data_zero %llu\n", sum.data_zero);
+	seq_printf(m, "hash_verified %llu\n", sum.hash_verified);
+	seq_printf(m, "hash_prefetched %llu\n", sum.hash_prefetched);
+	if (v->validated_blocks)
+		seq_printf(m, "validated_blocks %d/%llu\n",
+			   bitmap_weight(v->validated_blocks, v->data_blocks),
+			   (unsigned long long)v->data_blocks);
+
+	return 0;
+}
+
+static int verity_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, verity_stats_show, inode->i_private);
+}
+
+static const struct file_operations verity_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= verity_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/*
+ * Named after the dm device. Should a table reload create a second target
+ * on the same device, the new one goes without a file until the old one
+ * is gone, which is fine for statistics.
+ */
+static void verity_create_debugfs(struct dm_verity *v)
+{
+	struct gendisk *disk = dm_disk(dm_table_get_md(v->ti->table));
+
+	if (!v->stats || IS_ERR_OR_NULL(dm_verity_debugfs_root))
+		return;
+
+	v->debugfs = debugfs_create_file(disk->disk_name, S_IRUSR,
+					 dm_verity_debugfs_root, v,
+					 &verity_stats_fops);
+}
+
 void verity_dtr(struct dm_target *ti)
 {
 	struct dm_verity *v = ti->private;
 
+	debugfs_remove(v->debugfs);
+
 	if (v->verify_wq)
 		destroy_workqueue(v->verify_wq);
 
@@ -844,6 +944,7 @@ void verity_dtr(struct dm_target *ti)
 		dm_bufio_client_destroy(v->bufio);
 
 	kvfree(v->validated_blocks);
+	free_percpu(v->stats);
 	kfree(v->salt);
 	kfree(v->root_digest);
 	kfree(v->zero_digest);
@@ -1234,6 +1335,10 @@ int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 	ti->per_io_data_size = roundup(ti->per_io_data_size,
 				       __alignof__(struct dm_verity_io));
 
+	/* Only statistics, so not being able to keep them is no error */
+	v->stats = alloc_percpu(struct dm_verity_stats);
+	verity_create_debugfs(v);
+
 	return 0;
 
 bad:
@@ -1261,15 +1366,20 @@ static int __init dm_verity_init(void)
 	int r;
 
 	r = dm_register_target(&verity_target);
-	if (r < 0)
+	if (r < 0) {
 		DMERR("register failed %d", r);
+		return r;
+	}
 
-	return r;
+	dm_verity_debugfs_root = debugfs_create_dir("dm-verity", NULL);
+
+	return 0;
 }
 
 static void __exit dm_verity_exit(void)
 {
 	dm_unregister_target(&verity_target);
+	debugfs_remove_recursive(dm_verity_debugfs_root);
 }
 
 module_init(dm_verity_init);
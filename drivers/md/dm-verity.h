@@ -31,6 +31,15 @@ enum verity_block_type {
 
 struct dm_verity_fec;
 
+/* Per-cpu counters, summed up in debugfs/dm-verity/<dm-N> */
+struct dm_verity_stats {
+	u64 data_verified;	/* data blocks hashed */
+	u64 data_skipped;	/* data blocks found in validated_blocks */
+	u64 data_zero;		/* zero blocks not hashed */
+	u64 hash_verified;	/* hash blocks hashed */
+	u64 hash_prefetched;	/* hash blocks passed to dm_bufio_prefetch */
+};
+
 struct dm_verity {
 	struct dm_dev *data_dev;
 	struct dm_dev *hash_dev;
@@ -64,6 +73,9 @@ struct dm_verity {
 
 	struct dm_verity_fec *fec;	/* forward error correction */
 	unsigned long *validated_blocks; /* bitset blocks validated */
+
+	struct dm_verity_stats __percpu *stats;
+	struct dentry *debugfs;
 };
 
 struct dm_verity_io {
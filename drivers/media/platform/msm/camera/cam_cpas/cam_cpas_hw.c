@@ -17,6 +17,8 @@
 #include <linux/pm_opp.h>
 #include <linux/slab.h>
 #include <linux/module.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "cam_cpas_hw.h"
 #include "cam_cpas_hw_intf.h"
@@ -25,6 +27,19 @@
 static uint cam_min_camnoc_ib_bw;
 module_param(cam_min_camnoc_ib_bw, uint, 0644);
 
+/*
+ * Per-frame votes lower than the applied ones are not sent right away. A
+ * decrease within cam_cpas_vote_hyst_pct percent of the applied bw is
+ * dropped, a larger one is held for cam_cpas_vote_window_ms and only the
+ * last aggregate of that window is voted. Increases, start and stop are
+ * always applied at once. A window of 0 applies every vote as before.
+ */
+static uint cam_cpas_vote_window_ms = 100;
+module_param(cam_cpas_vote_window_ms, uint, 0644);
+
+static uint cam_cpas_vote_hyst_pct = 10;
+module_param(cam_cpas_vote_hyst_pct, uint, 0644);
+
 int cam_cpas_util_reg_update(struct cam_hw_info *cpas_hw,
 	enum cam_cpas_reg_base reg_base, struct cam_cpas_reg *reg_info)
 {
@@ -609,11 +624,117 @@ static int cam_cpas_util_set_camnoc_axi_clk_rate(
 	return rc;
 }
 
+/* Called with axi_port->lock held */
+static int cam_cpas_util_vote_axi_port(struct cam_hw_info *cpas_hw,
+	struct cam_cpas_axi_port *axi_port, uint64_t mnoc_bw_ab,
+	uint64_t mnoc_bw, uint64_t camnoc_bw)
+{
+	struct cam_cpas_private_soc *soc_private =
+		(struct cam_cpas_private_soc *) cpas_hw->soc_info.soc_private;
+	int rc;
+
+	axi_port->consolidated_axi_vote.compressed_bw = mnoc_bw;
+	axi_port->consolidated_axi_vote.uncompressed_bw = camnoc_bw;
+
+	CAM_DBG(CAM_CPAS,
+		"axi[(%d, %d),(%d, %d)] : camnoc_bw[%llu], mnoc_bw[ab: %llu, ib: %llu]",
+		axi_port->mnoc_bus.src, axi_port->mnoc_bus.dst,
+		axi_port->camnoc_bus.src, axi_port->camnoc_bus.dst,
+		camnoc_bw, mnoc_bw_ab, mnoc_bw);
+
+	axi_port->applied_valid = false;
+
+	if (axi_port->ib_bw_voting_needed)
+		rc = cam_cpas_util_vote_bus_client_bw(&axi_port->mnoc_bus,
+			mnoc_bw_ab, mnoc_bw, false);
+	else
+		rc = cam_cpas_util_vote_bus_client_bw(&axi_port->mnoc_bus,
+			mnoc_bw, 0, false);
+
+	if (rc) {
+		CAM_ERR(CAM_CPAS,
+			"Failed in mnoc vote ab[%llu] ib[%llu] rc=%d",
+			mnoc_bw_ab, mnoc_bw, rc);
+		return rc;
+	}
+
+	if (soc_private->axi_camnoc_based) {
+		rc = cam_cpas_util_vote_bus_client_bw(&axi_port->camnoc_bus,
+			0, camnoc_bw, true);
+		if (rc) {
+			CAM_ERR(CAM_CPAS,
+				"Failed camnoc vote ab[%llu] ib[%llu] rc=%d",
+				(uint64_t)0, camnoc_bw, rc);
+			return rc;
+		}
+	}
+
+	axi_port->applied_valid = true;
+	axi_port->applied_mnoc_ab = mnoc_bw_ab;
+	axi_port->applied_mnoc_ib = mnoc_bw;
+	axi_port->applied_camnoc_ib = camnoc_bw;
+	axi_port->num_applied++;
+
+	return 0;
+}
+
+static bool cam_cpas_util_within_hyst(uint64_t applied, uint64_t req)
+{
+	return (applied - req) * 100 <=
+		applied * READ_ONCE(cam_cpas_vote_hyst_pct);
+}
+
+/*
+ * Called with axi_port->lock held. Returns true if the vote was dropped
+ * or left to the vote work instead of being applied now.
+ */
+static bool cam_cpas_util_coalesce_axi_vote(struct cam_cpas *cpas_core,
+	struct cam_cpas_axi_port *axi_port, uint64_t mnoc_bw_ab,
+	uint64_t mnoc_bw, uint64_t camnoc_bw)
+{
+	uint32_t window_ms = READ_ONCE(cam_cpas_vote_window_ms);
+
+	if (!window_ms || !axi_port->applied_valid)
+		return false;
+
+	if ((mnoc_bw_ab > axi_port->applied_mnoc_ab) ||
+		(mnoc_bw > axi_port->applied_mnoc_ib) ||
+		(camnoc_bw > axi_port->applied_camnoc_ib))
+		return false;
+
+	if (cam_cpas_util_within_hyst(axi_port->applied_mnoc_ab,
+		mnoc_bw_ab) &&
+		cam_cpas_util_within_hyst(axi_port->applied_mnoc_ib,
+		mnoc_bw) &&
+		cam_cpas_util_within_hyst(axi_port->applied_camnoc_ib,
+		camnoc_bw)) {
+		/* Close enough to what is applied, nothing left to lower */
+		axi_port->vote_pending = false;
+		axi_port->num_skipped++;
+		return true;
+	}
+
+	axi_port->pending_mnoc_ab = mnoc_bw_ab;
+	axi_port->pending_mnoc_ib = mnoc_bw;
+	axi_port->pending_camnoc_ib = camnoc_bw;
+	axi_port->num_deferred++;
+
+	/* The window opens at the first decrease, later ones don't extend it */
+	if (!axi_port->vote_pending) {
+		axi_port->vote_pending = true;
+		queue_delayed_work(cpas_core->work_queue,
+			&cpas_core->vote_work, msecs_to_jiffies(window_ms));
+	}
+
+	return true;
+}
+
 static int cam_cpas_util_apply_client_axi_vote(
 	struct cam_hw_info *cpas_hw,
 	struct cam_cpas_client *cpas_client,
-	struct cam_axi_vote *axi_vote)
+	struct cam_axi_vote *axi_vote, bool coalesce)
 {
+	struct cam_cpas *cpas_core = (struct cam_cpas *) cpas_hw->core_info;
 	struct cam_cpas_private_soc *soc_private =
 		(struct cam_cpas_private_soc *) cpas_hw->soc_info.soc_private;
 	struct cam_cpas_client *curr_client;
@@ -667,39 +788,15 @@ static int cam_cpas_util_apply_client_axi_vote(
 	if ((!soc_private->axi_camnoc_based) && (mnoc_bw_ab < camnoc_bw))
 		mnoc_bw_ab = mnoc_bw;
 
-	axi_port->consolidated_axi_vote.compressed_bw = mnoc_bw;
-	axi_port->consolidated_axi_vote.uncompressed_bw = camnoc_bw;
-
-	CAM_DBG(CAM_CPAS,
-		"axi[(%d, %d),(%d, %d)] : camnoc_bw[%llu], mnoc_bw[ab: %llu, ib: %llu]",
-		axi_port->mnoc_bus.src, axi_port->mnoc_bus.dst,
-		axi_port->camnoc_bus.src, axi_port->camnoc_bus.dst,
-		camnoc_bw, mnoc_bw_ab, mnoc_bw);
-
-	if (axi_port->ib_bw_voting_needed)
-		rc = cam_cpas_util_vote_bus_client_bw(&axi_port->mnoc_bus,
-			mnoc_bw_ab, mnoc_bw, false);
-	else
-		rc = cam_cpas_util_vote_bus_client_bw(&axi_port->mnoc_bus,
-			mnoc_bw, 0, false);
-
-	if (rc) {
-		CAM_ERR(CAM_CPAS,
-			"Failed in mnoc vote ab[%llu] ib[%llu] rc=%d",
-			mnoc_bw_ab, mnoc_bw, rc);
+	if (coalesce && cam_cpas_util_coalesce_axi_vote(cpas_core, axi_port,
+		mnoc_bw_ab, mnoc_bw, camnoc_bw))
 		goto unlock_axi_port;
-	}
 
-	if (soc_private->axi_camnoc_based) {
-		rc = cam_cpas_util_vote_bus_client_bw(&axi_port->camnoc_bus,
-			0, camnoc_bw, true);
-		if (rc) {
-			CAM_ERR(CAM_CPAS,
-				"Failed camnoc vote ab[%llu] ib[%llu] rc=%d",
-				(uint64_t)0, camnoc_bw, rc);
-			goto unlock_axi_port;
-		}
-	}
+	axi_port->vote_pending = false;
+	rc = cam_cpas_util_vote_axi_port(cpas_hw, axi_port, mnoc_bw_ab,
+		mnoc_bw, camnoc_bw);
+	if (rc)
+		goto unlock_axi_port;
 
 	mutex_unlock(&axi_port->lock);
 
@@ -763,7 +860,7 @@ static int cam_cpas_hw_update_axi_vote(struct cam_hw_info *cpas_hw,
 		axi_vote.compressed_bw_ab, axi_vote.uncompressed_bw);
 
 	rc = cam_cpas_util_apply_client_axi_vote(cpas_hw,
-		cpas_core->cpas_client[client_indx], &axi_vote);
+		cpas_core->cpas_client[client_indx], &axi_vote, true);
 
 unlock_client:
 	mutex_unlock(&cpas_core->client_mutex[client_indx]);
@@ -812,7 +909,7 @@ static int cam_cpas_util_get_ahb_level(struct cam_hw_info *cpas_hw,
 
 static int cam_cpas_util_apply_client_ahb_vote(struct cam_hw_info *cpas_hw,
 	struct cam_cpas_client *cpas_client, struct cam_ahb_vote *ahb_vote,
-	enum cam_vote_level *applied_level)
+	enum cam_vote_level *applied_level, bool coalesce)
 {
 	struct cam_cpas *cpas_core = (struct cam_cpas *) cpas_hw->core_info;
 	struct cam_cpas_bus_client *ahb_bus_client = &cpas_core->ahb_bus_client;
@@ -856,6 +953,19 @@ static int cam_cpas_util_apply_client_ahb_vote(struct cam_hw_info *cpas_hw,
 
 	CAM_DBG(CAM_CPAS, "Required highest_level[%d]", highest_level);
 
+	if (coalesce && READ_ONCE(cam_cpas_vote_window_ms) &&
+		(highest_level < ahb_bus_client->curr_vote_level)) {
+		if (!cpas_core->ahb_vote_pending) {
+			cpas_core->ahb_vote_pending = true;
+			queue_delayed_work(cpas_core->work_queue,
+				&cpas_core->vote_work,
+				msecs_to_jiffies(cam_cpas_vote_window_ms));
+		}
+		cpas_core->ahb_num_deferred++;
+		goto unlock_bus_client;
+	}
+
+	cpas_core->ahb_vote_pending = false;
 	rc = cam_cpas_util_vote_bus_client_level(ahb_bus_client,
 		highest_level);
 	if (rc) {
@@ -872,6 +982,7 @@ static int cam_cpas_util_apply_client_ahb_vote(struct cam_hw_info *cpas_hw,
 		goto unlock_bus_client;
 	}
 
+	cpas_core->ahb_num_applied++;
 	if (applied_level)
 		*applied_level = highest_level;
 
@@ -926,7 +1037,7 @@ static int cam_cpas_hw_update_ahb_vote(struct cam_hw_info *cpas_hw,
 		cpas_core->cpas_client[client_indx]->ahb_level);
 
 	rc = cam_cpas_util_apply_client_ahb_vote(cpas_hw,
-		cpas_core->cpas_client[client_indx], &ahb_vote, NULL);
+		cpas_core->cpas_client[client_indx], &ahb_vote, NULL, true);
 
 unlock_client:
 	mutex_unlock(&cpas_core->client_mutex[client_indx]);
@@ -934,6 +1045,137 @@ static int cam_cpas_hw_update_ahb_vote(struct cam_hw_info *cpas_hw,
 	return rc;
 }
 
+/* Called with ahb_bus_client->lock held */
+static void cam_cpas_util_apply_pending_ahb_vote(struct cam_hw_info *cpas_hw)
+{
+	struct cam_cpas *cpas_core = (struct cam_cpas *) cpas_hw->core_info;
+	struct cam_cpas_bus_client *ahb_bus_client = &cpas_core->ahb_bus_client;
+	enum cam_vote_level highest_level = CAM_SUSPEND_VOTE;
+	int i, rc;
+
+	cpas_core->ahb_vote_pending = false;
+
+	for (i = 0; i < cpas_core->num_clients; i++) {
+		if (cpas_core->cpas_client[i] && (highest_level <
+			cpas_core->cpas_client[i]->ahb_level))
+			highest_level = cpas_core->cpas_client[i]->ahb_level;
+	}
+
+	if (highest_level == ahb_bus_client->curr_vote_level)
+		return;
+
+	rc = cam_cpas_util_vote_bus_client_level(ahb_bus_client,
+		highest_level);
+	if (rc) {
+		CAM_ERR(CAM_CPAS, "Failed in ahb vote, level=%d, rc=%d",
+			highest_level, rc);
+		return;
+	}
+
+	rc = cam_soc_util_set_clk_rate_level(&cpas_hw->soc_info, highest_level);
+	if (rc) {
+		CAM_ERR(CAM_CPAS,
+			"Failed in scaling clock rate level %d for AHB",
+			highest_level);
+		return;
+	}
+
+	cpas_core->ahb_num_applied++;
+}
+
+static void cam_cpas_util_vote_work(struct work_struct *work)
+{
+	struct cam_cpas *cpas_core = container_of(to_delayed_work(work),
+		struct cam_cpas, vote_work);
+	struct cam_hw_info *cpas_hw = cpas_core->hw_info;
+	struct cam_cpas_axi_port *curr_port;
+	bool axi_applied = false;
+	int rc;
+
+	mutex_lock(&cpas_hw->hw_mutex);
+
+	list_for_each_entry(curr_port, &cpas_core->axi_ports_list_head,
+		sibling_port) {
+		mutex_lock(&curr_port->lock);
+		if (curr_port->vote_pending) {
+			curr_port->vote_pending = false;
+			rc = cam_cpas_util_vote_axi_port(cpas_hw, curr_port,
+				curr_port->pending_mnoc_ab,
+				curr_port->pending_mnoc_ib,
+				curr_port->pending_camnoc_ib);
+			if (!rc)
+				axi_applied = true;
+		}
+		mutex_unlock(&curr_port->lock);
+	}
+
+	if (axi_applied) {
+		rc = cam_cpas_util_set_camnoc_axi_clk_rate(cpas_hw);
+		if (rc)
+			CAM_ERR(CAM_CPAS,
+				"Failed in setting axi clk rate rc=%d", rc);
+	}
+
+	mutex_lock(&cpas_core->ahb_bus_client.lock);
+	if (cpas_core->ahb_vote_pending)
+		cam_cpas_util_apply_pending_ahb_vote(cpas_hw);
+	mutex_unlock(&cpas_core->ahb_bus_client.lock);
+
+	mutex_unlock(&cpas_hw->hw_mutex);
+}
+
+/* Read without taking the port locks, a line may mix old and new values */
+static int cam_cpas_vote_stats_show(struct seq_file *m, void *v)
+{
+	struct cam_cpas *cpas_core = m->private;
+	struct cam_cpas_axi_port *curr_port;
+
+	list_for_each_entry(curr_port, &cpas_core->axi_ports_list_head,
+		sibling_port) {
+		seq_printf(m, "%s: applied %llu skipped %llu deferred %llu\n",
+			curr_port->axi_port_name, curr_port->num_applied,
+			curr_port->num_skipped, curr_port->num_deferred);
+		seq_printf(m, "  mnoc ab %llu ib %llu camnoc ib %llu%s\n",
+			curr_port->applied_mnoc_ab, curr_port->applied_mnoc_ib,
+			curr_port->applied_camnoc_ib,
+			curr_port->vote_pending ? " (pending)" : "");
+	}
+
+	seq_printf(m, "ahb: applied %llu deferred %llu level %u%s\n",
+		cpas_core->ahb_num_applied, cpas_core->ahb_num_deferred,
+		cpas_core->ahb_bus_client.curr_vote_level,
+		cpas_core->ahb_vote_pending ? " (pending)" : "");
+
+	return 0;
+}
+
+static int cam_cpas_vote_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cam_cpas_vote_stats_show, inode->i_private);
+}
+
+static const struct file_operations cam_cpas_vote_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = cam_cpas_vote_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void cam_cpas_util_create_debugfs(struct cam_cpas *cpas_core)
+{
+	cpas_core->dentry = debugfs_create_dir("camera_cpas", NULL);
+	if (IS_ERR_OR_NULL(cpas_core->dentry)) {
+		CAM_WARN(CAM_CPAS, "failed to create debugfs dir");
+		cpas_core->dentry = NULL;
+		return;
+	}
+
+	if (!debugfs_create_file("vote_stats", 0444, cpas_core->dentry,
+		cpas_core, &cam_cpas_vote_stats_fops))
+		CAM_WARN(CAM_CPAS, "failed to create vote_stats");
+}
+
 static int cam_cpas_hw_start(void *hw_priv, void *start_args,
 	uint32_t arg_size)
 {
@@ -1010,7 +1252,7 @@ static int cam_cpas_hw_start(void *hw_priv, void *start_args,
 		cpas_client->data.cell_index,
 		ahb_vote->type, ahb_vote->vote.level, cpas_client->ahb_level);
 	rc = cam_cpas_util_apply_client_ahb_vote(cpas_hw, cpas_client,
-		ahb_vote, &applied_level);
+		ahb_vote, &applied_level, false);
 	if (rc)
 		goto done;
 
@@ -1020,7 +1262,7 @@ static int cam_cpas_hw_start(void *hw_priv, void *start_args,
 		cpas_client->data.cell_index, axi_vote->compressed_bw,
 		axi_vote->compressed_bw_ab, axi_vote->uncompressed_bw);
 	rc = cam_cpas_util_apply_client_axi_vote(cpas_hw,
-		cpas_client, axi_vote);
+		cpas_client, axi_vote, false);
 	if (rc)
 		goto done;
 
@@ -1165,7 +1407,7 @@ static int cam_cpas_hw_stop(void *hw_priv, void *stop_args,
 	ahb_vote.type = CAM_VOTE_ABSOLUTE;
 	ahb_vote.vote.level = CAM_SUSPEND_VOTE;
 	rc = cam_cpas_util_apply_client_ahb_vote(cpas_hw, cpas_client,
-		&ahb_vote, NULL);
+		&ahb_vote, NULL, false);
 	if (rc) {
 		CAM_ERR(CAM_CPAS, "ahb vote failed for %s rc %d",
 			cpas_client->data.identifier, rc);
@@ -1176,7 +1418,7 @@ static int cam_cpas_hw_stop(void *hw_priv, void *stop_args,
 	axi_vote.compressed_bw = 0;
 	axi_vote.compressed_bw_ab = 0;
 	rc = cam_cpas_util_apply_client_axi_vote(cpas_hw,
-		cpas_client, &axi_vote);
+		cpas_client, &axi_vote, false);
 	if (rc)
 		CAM_ERR(CAM_CPAS, "axi vote failed for %s rc %d",
 			cpas_client->data.identifier, rc);
@@ -1580,6 +1822,7 @@ int cam_cpas_hw_probe(struct platform_device *pdev,
 
 	cpas_hw_intf->hw_priv = cpas_hw;
 	cpas_hw->core_info = cpas_core;
+	cpas_core->hw_info = cpas_hw;
 
 	cpas_hw->hw_state = CAM_HW_STATE_POWER_DOWN;
 	cpas_hw->soc_info.pdev = pdev;
@@ -1608,6 +1851,7 @@ int cam_cpas_hw_probe(struct platform_device *pdev,
 		rc = -ENOMEM;
 		goto release_mem;
 	}
+	INIT_DELAYED_WORK(&cpas_core->vote_work, cam_cpas_util_vote_work);
 
 	internal_ops = &cpas_core->internal_ops;
 	rc = cam_cpas_util_get_internal_ops(pdev, cpas_hw_intf, internal_ops);
@@ -1689,6 +1933,8 @@ int cam_cpas_hw_probe(struct platform_device *pdev,
 	if (rc)
 		goto axi_cleanup;
 
+	cam_cpas_util_create_debugfs(cpas_core);
+
 	*hw_intf = cpas_hw_intf;
 	return 0;
 
@@ -1734,6 +1980,8 @@ int cam_cpas_hw_remove(struct cam_hw_intf *cpas_hw_intf)
 		return -EINVAL;
 	}
 
+	debugfs_remove_recursive(cpas_core->dentry);
+	cancel_delayed_work_sync(&cpas_core->vote_work);
 	cam_cpas_util_axi_cleanup(cpas_core, &cpas_hw->soc_info);
 	cam_cpas_util_unregister_bus_client(&cpas_core->ahb_bus_client);
 	cam_cpas_util_client_cleanup(cpas_hw);
@@ -13,6 +13,8 @@
 #ifndef _CAM_CPAS_HW_H_
 #define _CAM_CPAS_HW_H_
 
+#include <linux/workqueue.h>
+
 #include "cam_cpas_api.h"
 #include "cam_cpas_hw_intf.h"
 #include "cam_common_util.h"
@@ -154,6 +156,17 @@ struct cam_cpas_bus_client {
  * @axi_port_mnoc_node: Node representing mnoc in this AXI Port
  * @axi_port_camnoc_node: Node representing camnoc in this AXI Port
  * @consolidated_axi_vote: Consolidated axi bw values for this AXI port
+ * @applied_valid: Whether applied_* hold the last vote sent to the bus
+ * @applied_mnoc_ab: Last mnoc ab bw voted on this port
+ * @applied_mnoc_ib: Last mnoc ib bw voted on this port
+ * @applied_camnoc_ib: Last camnoc ib bw voted on this port
+ * @vote_pending: A lower vote is waiting for the coalescing window
+ * @pending_mnoc_ab: mnoc ab bw of the pending vote
+ * @pending_mnoc_ib: mnoc ib bw of the pending vote
+ * @pending_camnoc_ib: camnoc ib bw of the pending vote
+ * @num_applied: Number of votes sent to the bus
+ * @num_skipped: Number of decreases dropped by the hysteresis
+ * @num_deferred: Number of decreases folded into a pending vote
  */
 struct cam_cpas_axi_port {
 	struct list_head sibling_port;
@@ -167,6 +180,17 @@ struct cam_cpas_axi_port {
 	struct device_node *axi_port_mnoc_node;
 	struct device_node *axi_port_camnoc_node;
 	struct cam_axi_vote consolidated_axi_vote;
+	bool applied_valid;
+	uint64_t applied_mnoc_ab;
+	uint64_t applied_mnoc_ib;
+	uint64_t applied_camnoc_ib;
+	bool vote_pending;
+	uint64_t pending_mnoc_ab;
+	uint64_t pending_mnoc_ib;
+	uint64_t pending_camnoc_ib;
+	uint64_t num_applied;
+	uint64_t num_skipped;
+	uint64_t num_deferred;
 };
 
 /**
@@ -183,6 +207,12 @@ struct cam_cpas_axi_port {
  * @axi_ports_list_head: Head pointing to list of AXI ports
  * @internal_ops: CPAS HW internal ops
  * @work_queue: Work queue handle
+ * @hw_info: CPAS hw info this core belongs to
+ * @vote_work: Delayed work applying coalesced vote decreases
+ * @ahb_vote_pending: A lower AHB level is waiting for the vote window
+ * @ahb_num_applied: Number of AHB levels sent to the bus
+ * @ahb_num_deferred: Number of AHB decreases folded into a pending vote
+ * @dentry: Debugfs directory of CPAS
  *
  */
 struct cam_cpas {
@@ -199,6 +229,12 @@ struct cam_cpas {
 	struct workqueue_struct *work_queue;
 	atomic_t irq_count;
 	wait_queue_head_t irq_count_wq;
+	struct cam_hw_info *hw_info;
+	struct delayed_work vote_work;
+	bool ahb_vote_pending;
+	uint64_t ahb_num_applied;
+	uint64_t ahb_num_deferred;
+	struct dentry *dentry;
 };
 
 int cam_camsstop_get_internal_ops(struct cam_cpas_internal_ops *internal_ops);
@@ -54,6 +54,28 @@ struct hfi_mem_info {
 	void __iomem *icp_base;
 };
 
+/**
+ * struct hfi_latency_stats
+ * @batches: doorbells raised to firmware
+ * @cmds: commands written, in any batch
+ * @drains: passes over the message queue that read something
+ * @msgs: messages read by those passes
+ * @max_drain: most messages read by a single pass
+ * @acks: responses matched to an outstanding doorbell
+ * @total_lat_us: sum of doorbell to response latency
+ * @max_lat_us: worst doorbell to response latency
+ */
+struct hfi_latency_stats {
+	uint64_t batches;
+	uint64_t cmds;
+	uint64_t drains;
+	uint64_t msgs;
+	uint32_t max_drain;
+	uint64_t acks;
+	uint64_t total_lat_us;
+	uint64_t max_lat_us;
+};
+
 /**
  * hfi_write_cmd() - function for hfi write
  * @cmd_ptr: pointer to command data for hfi write
@@ -62,6 +84,18 @@ struct hfi_mem_info {
  */
 int hfi_write_cmd(void *cmd_ptr);
 
+/**
+ * hfi_write_cmd_batch() - write several commands with one interrupt
+ * @cmd_ptrs: array of pointers to command data
+ * @num_cmds: number of commands in the array
+ *
+ * Either all commands are queued and the firmware is interrupted once,
+ * or nothing is queued.
+ *
+ * Returns success(zero)/failure(non zero)
+ */
+int hfi_write_cmd_batch(void **cmd_ptrs, uint32_t num_cmds);
+
 /**
  * hfi_read_message() - function for hfi read
  * @pmsg: buffer to place read message for hfi queue
@@ -73,6 +107,30 @@ int hfi_write_cmd(void *cmd_ptr);
  */
 int hfi_read_message(uint32_t *pmsg, uint8_t q_id, uint32_t *words_read);
 
+/**
+ * hfi_drain_messages() - read every whole message that fits a buffer
+ * @pmsg: buffer the messages are placed in, back to back
+ * @max_words: size of the buffer in words
+ * @q_id: queue id
+ * @words_read: total number of words placed in the buffer
+ * @num_msgs: number of messages placed in the buffer
+ *
+ * Unlike hfi_read_message(), the queue is walked packet by packet, so a
+ * burst larger than the buffer is left queued for the next call instead
+ * of being dropped.
+ *
+ * Returns success(zero)/failure(non zero), -EIO if the queue is empty
+ */
+int hfi_drain_messages(uint32_t *pmsg, uint32_t max_words, uint8_t q_id,
+	uint32_t *words_read, uint32_t *num_msgs);
+
+/**
+ * hfi_get_latency_stats() - copy the submission and response statistics
+ * @stats: filled with the statistics since boot or the last reset
+ * @reset: clear the statistics after copying them
+ */
+void hfi_get_latency_stats(struct hfi_latency_stats *stats, bool reset);
+
 /**
  * hfi_init() - function initialize hfi after firmware download
  * @event_driven_mode: event mode
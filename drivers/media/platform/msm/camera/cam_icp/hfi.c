@@ -18,6 +18,9 @@
 #include <linux/timer.h>
 #include <media/cam_icp.h>
 #include <linux/iopoll.h>
+#include <linux/module.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <soc/qcom/socinfo.h>
 
 #include "cam_io_util.h"
@@ -50,6 +53,11 @@ unsigned int g_icp_mmu_hdl;
 static DEFINE_MUTEX(hfi_cmd_q_mutex);
 static DEFINE_MUTEX(hfi_msg_q_mutex);
 
+static DEFINE_SPINLOCK(hfi_stats_lock);
+static struct hfi_latency_stats hfi_stats;
+/* First doorbell, in us, that no response has been read for yet */
+static uint64_t hfi_submit_ts;
+
 void cam_hfi_queue_dump(void)
 {
 	struct hfi_qtbl *qtbl;
@@ -99,17 +107,38 @@ void cam_hfi_queue_dump(void)
 
 int hfi_write_cmd(void *cmd_ptr)
 {
-	uint32_t size_in_words, empty_space, new_write_idx, read_idx, temp;
+	return hfi_write_cmd_batch(&cmd_ptr, 1);
+}
+
+int hfi_write_cmd_batch(void **cmd_ptrs, uint32_t num_cmds)
+{
+	uint32_t size_in_words, empty_space, write_idx, read_idx, temp;
+	uint32_t total_words = 0;
 	uint32_t *write_q, *write_ptr;
 	struct hfi_qtbl *q_tbl;
 	struct hfi_q_hdr *q;
+	uint32_t i;
 	int rc = 0;
 
-	if (!cmd_ptr) {
+	if (!cmd_ptrs || !num_cmds) {
 		CAM_ERR(CAM_HFI, "command is null");
 		return -EINVAL;
 	}
 
+	for (i = 0; i < num_cmds; i++) {
+		if (!cmd_ptrs[i]) {
+			CAM_ERR(CAM_HFI, "command %u is null", i);
+			return -EINVAL;
+		}
+
+		size_in_words = (*(uint32_t *)cmd_ptrs[i]) >> BYTE_WORD_SHIFT;
+		if (!size_in_words) {
+			CAM_DBG(CAM_HFI, "failed");
+			return -EINVAL;
+		}
+		total_words += size_in_words;
+	}
+
 	mutex_lock(&hfi_cmd_q_mutex);
 	if (!g_hfi) {
 		CAM_ERR(CAM_HFI, "HFI interface not setup");
@@ -130,36 +159,33 @@ int hfi_write_cmd(void *cmd_ptr)
 
 	write_q = (uint32_t *)g_hfi->map.cmd_q.kva;
 
-	size_in_words = (*(uint32_t *)cmd_ptr) >> BYTE_WORD_SHIFT;
-	if (!size_in_words) {
-		CAM_DBG(CAM_HFI, "failed");
-		rc = -EINVAL;
-		goto err;
-	}
-
 	read_idx = q->qhdr_read_idx;
 	empty_space = (q->qhdr_write_idx >= read_idx) ?
 		(q->qhdr_q_size - (q->qhdr_write_idx - read_idx)) :
 		(read_idx - q->qhdr_write_idx);
-	if (empty_space <= size_in_words) {
+	if (empty_space <= total_words) {
 		CAM_ERR(CAM_HFI, "failed: empty space %u, size_in_words %u",
-			empty_space, size_in_words);
+			empty_space, total_words);
 		rc = -EIO;
 		goto err;
 	}
 
-	new_write_idx = q->qhdr_write_idx + size_in_words;
-	write_ptr = (uint32_t *)(write_q + q->qhdr_write_idx);
-
-	if (new_write_idx < q->qhdr_q_size) {
-		memcpy(write_ptr, (uint8_t *)cmd_ptr,
-			size_in_words << BYTE_WORD_SHIFT);
-	} else {
-		new_write_idx -= q->qhdr_q_size;
-		temp = (size_in_words - new_write_idx) << BYTE_WORD_SHIFT;
-		memcpy(write_ptr, (uint8_t *)cmd_ptr, temp);
-		memcpy(write_q, (uint8_t *)cmd_ptr + temp,
-			new_write_idx << BYTE_WORD_SHIFT);
+	write_idx = q->qhdr_write_idx;
+	for (i = 0; i < num_cmds; i++) {
+		size_in_words = (*(uint32_t *)cmd_ptrs[i]) >> BYTE_WORD_SHIFT;
+		write_ptr = (uint32_t *)(write_q + write_idx);
+		write_idx += size_in_words;
+
+		if (write_idx < q->qhdr_q_size) {
+			memcpy(write_ptr, (uint8_t *)cmd_ptrs[i],
+				size_in_words << BYTE_WORD_SHIFT);
+		} else {
+			write_idx -= q->qhdr_q_size;
+			temp = (size_in_words - write_idx) << BYTE_WORD_SHIFT;
+			memcpy(write_ptr, (uint8_t *)cmd_ptrs[i], temp);
+			memcpy(write_q, (uint8_t *)cmd_ptrs[i] + temp,
+				write_idx << BYTE_WORD_SHIFT);
+		}
 	}
 
 	/*
@@ -168,7 +194,7 @@ int hfi_write_cmd(void *cmd_ptr)
 	 */
 	wmb();
 
-	q->qhdr_write_idx = new_write_idx;
+	q->qhdr_write_idx = write_idx;
 
 	/*
 	 * Before raising interrupt make sure command data is ready for
@@ -177,11 +203,110 @@ int hfi_write_cmd(void *cmd_ptr)
 	wmb();
 	cam_io_w_mb((uint32_t)INTR_ENABLE,
 		g_hfi->csr_base + HFI_REG_A5_CSR_HOST2ICPINT);
+
+	spin_lock(&hfi_stats_lock);
+	hfi_stats.batches++;
+	hfi_stats.cmds += num_cmds;
+	if (!hfi_submit_ts)
+		hfi_submit_ts = ktime_to_us(ktime_get());
+	spin_unlock(&hfi_stats_lock);
 err:
 	mutex_unlock(&hfi_cmd_q_mutex);
 	return rc;
 }
 
+static void hfi_account_drain(uint8_t q_id, uint32_t num_msgs)
+{
+	uint64_t lat_us;
+
+	if (q_id != Q_MSG || !num_msgs)
+		return;
+
+	/*
+	 * Responses are not matched to commands, so this is the time from
+	 * the oldest doorbell not yet followed by a response to the next
+	 * pass that finds one.
+	 */
+	spin_lock(&hfi_stats_lock);
+	hfi_stats.drains++;
+	hfi_stats.msgs += num_msgs;
+	hfi_stats.max_drain = max(hfi_stats.max_drain, num_msgs);
+	if (hfi_submit_ts) {
+		lat_us = ktime_to_us(ktime_get()) - hfi_submit_ts;
+		hfi_submit_ts = 0;
+		hfi_stats.acks++;
+		hfi_stats.total_lat_us += lat_us;
+		hfi_stats.max_lat_us = max(hfi_stats.max_lat_us, lat_us);
+	}
+	spin_unlock(&hfi_stats_lock);
+}
+
+void hfi_get_latency_stats(struct hfi_latency_stats *stats, bool reset)
+{
+	spin_lock(&hfi_stats_lock);
+	*stats = hfi_stats;
+	if (reset)
+		memset(&hfi_stats, 0, sizeof(hfi_stats));
+	spin_unlock(&hfi_stats_lock);
+}
+
+static int hfi_latency_show(struct seq_file *m, void *data)
+{
+	struct hfi_latency_stats stats;
+
+	hfi_get_latency_stats(&stats, false);
+	seq_printf(m, "batches: %llu cmds: %llu\n", stats.batches, stats.cmds);
+	seq_printf(m, "drains: %llu msgs: %llu max_drain: %u\n",
+		stats.drains, stats.msgs, stats.max_drain);
+	seq_printf(m, "acks: %llu avg_lat_us: %llu max_lat_us: %llu\n",
+		stats.acks,
+		stats.acks ? div64_u64(stats.total_lat_us, stats.acks) : 0,
+		stats.max_lat_us);
+
+	return 0;
+}
+
+static int hfi_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, hfi_latency_show, inode->i_private);
+}
+
+static ssize_t hfi_latency_write(struct file *file, const char __user *buf,
+	size_t count, loff_t *ppos)
+{
+	struct hfi_latency_stats stats;
+
+	hfi_get_latency_stats(&stats, true);
+	return count;
+}
+
+static const struct file_operations hfi_latency_fops = {
+	.owner = THIS_MODULE,
+	.open = hfi_latency_open,
+	.read = seq_read,
+	.write = hfi_latency_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init hfi_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("camera_hfi", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return 0;
+
+	if (!debugfs_create_file("latency", 0644, dir, NULL,
+		&hfi_latency_fops)) {
+		CAM_ERR(CAM_HFI, "failed to create latency entry");
+		debugfs_remove_recursive(dir);
+	}
+
+	return 0;
+}
+late_initcall(hfi_debugfs_init);
+
 int hfi_read_message(uint32_t *pmsg, uint8_t q_id,
 	uint32_t *words_read)
 {
@@ -277,6 +402,117 @@ int hfi_read_message(uint32_t *pmsg, uint8_t q_id,
 	 * queue parameters are updated after read
 	 */
 	wmb();
+	hfi_account_drain(q_id, 1);
+err:
+	mutex_unlock(&hfi_msg_q_mutex);
+	return rc;
+}
+
+int hfi_drain_messages(uint32_t *pmsg, uint32_t max_words, uint8_t q_id,
+	uint32_t *words_read, uint32_t *num_msgs)
+{
+	struct hfi_qtbl *q_tbl_ptr;
+	struct hfi_q_hdr *q;
+	uint32_t read_idx, write_idx, q_words, avail, size_in_words, temp;
+	uint32_t size_upper_bound, words = 0, msgs = 0;
+	uint32_t *read_q;
+	int rc = 0;
+
+	if (!pmsg || !words_read || !num_msgs) {
+		CAM_ERR(CAM_HFI, "Invalid msg");
+		return -EINVAL;
+	}
+
+	if (q_id > Q_DBG) {
+		CAM_ERR(CAM_HFI, "Inavlid q :%u", q_id);
+		return -EINVAL;
+	}
+
+	mutex_lock(&hfi_msg_q_mutex);
+	if (!g_hfi) {
+		CAM_ERR(CAM_HFI, "hfi not set up yet");
+		rc = -ENODEV;
+		goto err;
+	}
+
+	if ((g_hfi->hfi_state != HFI_READY) ||
+		!g_hfi->msg_q_state) {
+		CAM_ERR(CAM_HFI, "hfi state: %u, msg q state: %u",
+			g_hfi->hfi_state, g_hfi->msg_q_state);
+		rc = -ENODEV;
+		goto err;
+	}
+
+	q_tbl_ptr = (struct hfi_qtbl *)g_hfi->map.qtbl.kva;
+	q = &q_tbl_ptr->q_hdr[q_id];
+
+	if (q_id == Q_MSG) {
+		read_q = (uint32_t *)g_hfi->map.msg_q.kva;
+		q_words = ICP_MSG_Q_SIZE_IN_BYTES >> BYTE_WORD_SHIFT;
+		size_upper_bound = ICP_HFI_MAX_PKT_SIZE_MSGQ_IN_WORDS;
+	} else {
+		read_q = (uint32_t *)g_hfi->map.dbg_q.kva;
+		q_words = ICP_DBG_Q_SIZE_IN_BYTES >> BYTE_WORD_SHIFT;
+		size_upper_bound = ICP_HFI_MAX_PKT_SIZE_IN_WORDS;
+	}
+
+	read_idx = q->qhdr_read_idx;
+	write_idx = q->qhdr_write_idx;
+
+	while (read_idx != write_idx) {
+		avail = (write_idx > read_idx) ? (write_idx - read_idx) :
+			(q_words - (read_idx - write_idx));
+		size_in_words = read_q[read_idx] >> BYTE_WORD_SHIFT;
+
+		if (!size_in_words || size_in_words > size_upper_bound ||
+			size_in_words > avail) {
+			CAM_ERR(CAM_HFI,
+				"invalid HFI message packet size - 0x%08x",
+				size_in_words << BYTE_WORD_SHIFT);
+			read_idx = write_idx;
+			if (!msgs)
+				rc = -EIO;
+			break;
+		}
+
+		/* Leave the rest queued for the next call */
+		if (words + size_in_words > max_words) {
+			if (!msgs)
+				rc = -ENOSPC;
+			break;
+		}
+
+		if (read_idx + size_in_words < q->qhdr_q_size) {
+			memcpy(pmsg + words, read_q + read_idx,
+				size_in_words << BYTE_WORD_SHIFT);
+			read_idx += size_in_words;
+		} else {
+			temp = q->qhdr_q_size - read_idx;
+			memcpy(pmsg + words, read_q + read_idx,
+				temp << BYTE_WORD_SHIFT);
+			memcpy(pmsg + words + temp, read_q,
+				(size_in_words - temp) << BYTE_WORD_SHIFT);
+			read_idx = size_in_words - temp;
+		}
+
+		words += size_in_words;
+		msgs++;
+	}
+
+	if (!msgs && !rc) {
+		CAM_DBG(CAM_HFI, "Q not ready, state:%u, r idx:%u, w idx:%u",
+			g_hfi->hfi_state, read_idx, write_idx);
+		rc = -EIO;
+	}
+
+	q->qhdr_read_idx = read_idx;
+	*words_read = words;
+	*num_msgs = msgs;
+	/* Memory Barrier to make sure message
+	 * queue parameters are updated after read
+	 */
+	wmb();
+	hfi_account_drain(q_id, msgs);
 err:
 	mutex_unlock(&hfi_msg_q_mutex);
 	return rc;
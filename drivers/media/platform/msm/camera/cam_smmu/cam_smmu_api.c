@@ -25,6 +25,8 @@
 #include <soc/qcom/secure_buffer.h>
 #include <uapi/media/cam_req_mgr.h>
 #include <linux/debugfs.h>
+#include <linux/hashtable.h>
+#include <linux/seq_file.h>
 #include "cam_smmu_api.h"
 #include "cam_debug_util.h"
 
@@ -37,6 +39,7 @@
 #define COOKIE_MASK ((1<<COOKIE_SIZE)-1)
 #define HANDLE_INIT (-1)
 #define CAM_SMMU_CB_MAX 5
+#define CAM_SMMU_HASH_BITS 6
 
 #define GET_SMMU_HDL(x, y) (((x) << COOKIE_SIZE) | ((y) & COOKIE_MASK))
 #define GET_SMMU_TABLE_IDX(x) (((x) >> COOKIE_SIZE) & COOKIE_MASK)
@@ -44,6 +47,14 @@
 static int g_num_pf_handled = 4;
 module_param(g_num_pf_handled, int, 0644);
 
+/*
+ * Number of unmapped buffers per context bank that stay mapped, so a
+ * buffer pool cycling through the same buffers is not mapped again on
+ * every frame. 0 unmaps right away.
+ */
+static int g_warm_cache_size = 16;
+module_param(g_warm_cache_size, int, 0644);
+
 struct firmware_alloc_info {
 	struct device *fw_dev;
 	void *fw_kva;
@@ -130,6 +141,16 @@ struct cam_context_bank_info {
 
 	struct list_head smmu_buf_list;
 	struct list_head smmu_buf_kernel_list;
+	/* Non-secure user mappings by fd, kernel mappings by dma_buf */
+	DECLARE_HASHTABLE(fd_hash, CAM_SMMU_HASH_BITS);
+	DECLARE_HASHTABLE(buf_hash, CAM_SMMU_HASH_BITS);
+	/* Unmapped buffers kept mapped, most recently used first */
+	struct list_head warm_list;
+	DECLARE_HASHTABLE(warm_hash, CAM_SMMU_HASH_BITS);
+	int warm_count;
+	uint64_t warm_hits;
+	uint64_t warm_misses;
+	uint64_t warm_evictions;
 	struct mutex lock;
 	int handle;
 	enum cam_smmu_ops_param state;
@@ -168,6 +189,7 @@ struct cam_dma_buff_info {
 	int ref_count;
 	dma_addr_t paddr;
 	struct list_head list;
+	struct hlist_node hnode;
 	int ion_fd;
 	size_t len;
 	size_t phys_len;
@@ -242,6 +264,8 @@ static int cam_smmu_alloc_scratch_buffer_add_to_list(int idx,
 static int cam_smmu_unmap_buf_and_remove_from_list(
 	struct cam_dma_buff_info *mapping_info, int idx);
 
+static void cam_smmu_warm_trim(int idx, int limit);
+
 static int cam_smmu_free_scratch_buffer_remove_from_list(
 	struct cam_dma_buff_info *mapping_info,
 	int idx);
@@ -318,6 +342,13 @@ static int cam_smmu_create_debugfs_entry(void)
 		goto err;
 	}
 
+	if (!debugfs_create_file("cam_smmu_warm_stats", 0444, smmu_dentry,
+		NULL, &cam_smmu_warm_stats_fops)) {
+		CAM_ERR(CAM_SMMU, "failed to create cam_smmu_warm_stats entry");
+		rc = -ENOMEM;
+		goto err;
+	}
+
 	return rc;
 err:
 	debugfs_remove_recursive(smmu_dentry);
@@ -367,6 +398,39 @@ static void cam_smmu_print_table(void)
 	}
 }
 
+static int cam_smmu_warm_stats_show(struct seq_file *m, void *data)
+{
+	struct cam_context_bank_info *cb;
+	int i;
+
+	for (i = 0; i < iommu_cb_set.cb_num; i++) {
+		cb = &iommu_cb_set.cb_info[i];
+		if (cb->is_secure)
+			continue;
+
+		mutex_lock(&cb->lock);
+		seq_printf(m, "%s: hits %llu misses %llu evictions %llu warm %d\n",
+			cb->name, cb->warm_hits, cb->warm_misses,
+			cb->warm_evictions, cb->warm_count);
+		mutex_unlock(&cb->lock);
+	}
+
+	return 0;
+}
+
+static int cam_smmu_warm_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cam_smmu_warm_stats_show, inode->i_private);
+}
+
+static const struct file_operations cam_smmu_warm_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = cam_smmu_warm_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static uint32_t cam_smmu_find_closest_mapping(int idx, void *vaddr)
 {
 	struct cam_dma_buff_info *mapping, *closest_mapping =  NULL;
@@ -633,6 +697,11 @@ void cam_smmu_reset_iommu_table(enum cam_smmu_init_dir ops)
 		iommu_cb_set.cb_info[i].handle = HANDLE_INIT;
 		INIT_LIST_HEAD(&iommu_cb_set.cb_info[i].smmu_buf_list);
 		INIT_LIST_HEAD(&iommu_cb_set.cb_info[i].smmu_buf_kernel_list);
+		hash_init(iommu_cb_set.cb_info[i].fd_hash);
+		hash_init(iommu_cb_set.cb_info[i].buf_hash);
+		INIT_LIST_HEAD(&iommu_cb_set.cb_info[i].warm_list);
+		hash_init(iommu_cb_set.cb_info[i].warm_hash);
+		iommu_cb_set.cb_info[i].warm_count = 0;
 		iommu_cb_set.cb_info[i].state = CAM_SMMU_DETACH;
 		iommu_cb_set.cb_info[i].dev = NULL;
 		iommu_cb_set.cb_info[i].cb_count = 0;
@@ -869,9 +938,8 @@ static struct cam_dma_buff_info *cam_smmu_find_mapping_by_ion_index(int idx,
 		return NULL;
 	}
 
-	list_for_each_entry(mapping,
-			&iommu_cb_set.cb_info[idx].smmu_buf_list,
-			list) {
+	hash_for_each_possible(iommu_cb_set.cb_info[idx].fd_hash, mapping,
+			hnode, ion_fd) {
 		if (mapping->ion_fd == ion_fd) {
 			CAM_DBG(CAM_SMMU, "find ion_fd %d", ion_fd);
 			return mapping;
@@ -893,9 +961,8 @@ static struct cam_dma_buff_info *cam_smmu_find_mapping_by_dma_buf(int idx,
 		return NULL;
 	}
 
-	list_for_each_entry(mapping,
-			&iommu_cb_set.cb_info[idx].smmu_buf_kernel_list,
-			list) {
+	hash_for_each_possible(iommu_cb_set.cb_info[idx].buf_hash, mapping,
+			hnode, (unsigned long)buf) {
 		if (mapping->buf == buf) {
 			CAM_DBG(CAM_SMMU, "find dma_buf %pK", buf);
 			return mapping;
@@ -1027,6 +1094,7 @@ static int cam_smmu_detach_device(int idx)
 	if (iommu_cb_set.cb_info[idx].state == CAM_SMMU_DETACH) {
 		rc = -EALREADY;
 	} else if (iommu_cb_set.cb_info[idx].state == CAM_SMMU_ATTACH) {
+		cam_smmu_warm_trim(idx, 0);
 		arm_iommu_detach_device(cb->dev);
 		iommu_cb_set.cb_info[idx].state = CAM_SMMU_DETACH;
 	}
@@ -1837,6 +1905,84 @@ static int cam_smmu_map_buffer_validate(struct dma_buf *buf,
 }
 
 
+/*
+ * Takes a mapping of @buf back from the warm list, if one with the same
+ * direction and region was kept there. A kernel mapping has no fd, so
+ * user and kernel mappings are never handed to each other.
+ */
+static struct cam_dma_buff_info *cam_smmu_warm_take(int idx,
+	struct dma_buf *buf, enum dma_data_direction dma_dir,
+	enum cam_smmu_region_id region_id, bool is_kernel)
+{
+	struct cam_context_bank_info *cb = &iommu_cb_set.cb_info[idx];
+	struct cam_dma_buff_info *mapping;
+
+	if (!cb->warm_count)
+		goto miss;
+
+	hash_for_each_possible(cb->warm_hash, mapping, hnode,
+			(unsigned long)buf) {
+		if (mapping->buf != buf || mapping->dir != dma_dir ||
+			mapping->region_id != region_id ||
+			(mapping->ion_fd == -1) != is_kernel)
+			continue;
+
+		hash_del(&mapping->hnode);
+		list_del_init(&mapping->list);
+		cb->warm_count--;
+		cb->warm_hits++;
+		return mapping;
+	}
+
+miss:
+	if (g_warm_cache_size > 0)
+		cb->warm_misses++;
+	return NULL;
+}
+
+/*
+ * Called instead of unmapping a buffer the client is done with. The
+ * mapping keeps its dma_buf reference and iova until it falls off the
+ * end of the warm list or the context bank is detached or destroyed.
+ */
+static int cam_smmu_warm_put(struct cam_dma_buff_info *mapping_info,
+	int idx)
+{
+	struct cam_context_bank_info *cb = &iommu_cb_set.cb_info[idx];
+
+	if (g_warm_cache_size <= 0 || !mapping_info->buf)
+		return cam_smmu_unmap_buf_and_remove_from_list(mapping_info,
+			idx);
+
+	hash_del(&mapping_info->hnode);
+	list_move(&mapping_info->list, &cb->warm_list);
+	hash_add(cb->warm_hash, &mapping_info->hnode,
+		(unsigned long)mapping_info->buf);
+	cb->warm_count++;
+
+	cam_smmu_warm_trim(idx, g_warm_cache_size);
+	return 0;
+}
+
+static void cam_smmu_warm_trim(int idx, int limit)
+{
+	struct cam_context_bank_info *cb = &iommu_cb_set.cb_info[idx];
+	struct cam_dma_buff_info *mapping;
+
+	while (cb->warm_count > max(limit, 0)) {
+		mapping = list_last_entry(&cb->warm_list,
+			struct cam_dma_buff_info, list);
+		cb->warm_count--;
+		cb->warm_evictions++;
+		if (cam_smmu_unmap_buf_and_remove_from_list(mapping, idx)) {
+			/* Drop it from the warm list anyway */
+			hash_del(&mapping->hnode);
+			list_del_init(&mapping->list);
+			kfree(mapping);
+		}
+	}
+}
+
 static int cam_smmu_map_buffer_and_add_to_list(int idx, int ion_fd,
 	 enum dma_data_direction dma_dir, dma_addr_t *paddr_ptr,
 	 size_t *len_ptr, enum cam_smmu_region_id region_id)
@@ -1848,6 +1994,18 @@ static int cam_smmu_map_buffer_and_add_to_list(int idx, int ion_fd,
 	/* returns the dma_buf structure related to an fd */
 	buf = dma_buf_get(ion_fd);
 
+	if (!IS_ERR_OR_NULL(buf)) {
+		mapping_info = cam_smmu_warm_take(idx, buf, dma_dir,
+			region_id, false);
+		if (mapping_info) {
+			/* The warm mapping still holds its own reference */
+			dma_buf_put(buf);
+			*paddr_ptr = mapping_info->paddr;
+			*len_ptr = mapping_info->len;
+			goto add_list;
+		}
+	}
+
 	rc = cam_smmu_map_buffer_validate(buf, idx, dma_dir, paddr_ptr, len_ptr,
 		region_id, &mapping_info);
 
@@ -1856,10 +2014,13 @@ static int cam_smmu_map_buffer_and_add_to_list(int idx, int ion_fd,
 		return rc;
 	}
 
+add_list:
 	mapping_info->ion_fd = ion_fd;
 	/* add to the list */
 	list_add(&mapping_info->list,
 		&iommu_cb_set.cb_info[idx].smmu_buf_list);
+	hash_add(iommu_cb_set.cb_info[idx].fd_hash, &mapping_info->hnode,
+		ion_fd);
 
 	return 0;
 }
@@ -1872,6 +2033,15 @@ static int cam_smmu_map_kernel_buffer_and_add_to_list(int idx,
 	int rc = -1;
 	struct cam_dma_buff_info *mapping_info = NULL;
 
+	mapping_info = cam_smmu_warm_take(idx, buf, dma_dir, region_id, true);
+	if (mapping_info) {
+		/* The reference passed in is not needed for a warm mapping */
+		dma_buf_put(buf);
+		*paddr_ptr = mapping_info->paddr;
+		*len_ptr = mapping_info->len;
+		goto add_list;
+	}
+
 	rc = cam_smmu_map_buffer_validate(buf, idx, dma_dir, paddr_ptr, len_ptr,
 		region_id, &mapping_info);
 
@@ -1882,9 +2052,12 @@ static int cam_smmu_map_kernel_buffer_and_add_to_list(int idx,
 
 	mapping_info->ion_fd = -1;
 
+add_list:
 	/* add to the list */
 	list_add(&mapping_info->list,
 		&iommu_cb_set.cb_info[idx].smmu_buf_kernel_list);
+	hash_add(iommu_cb_set.cb_info[idx].buf_hash, &mapping_info->hnode,
+		(unsigned long)buf);
 
 	return 0;
 }
@@ -1947,6 +2120,7 @@ static int cam_smmu_unmap_buf_and_remove_from_list(
 	mapping_info->buf = NULL;
 
 	list_del_init(&mapping_info->list);
+	hash_del(&mapping_info->hnode);
 
 	/* free one buffer */
 	kfree(mapping_info);
@@ -1958,8 +2132,8 @@ static enum cam_smmu_buf_state cam_smmu_check_fd_in_list(int idx,
 {
 	struct cam_dma_buff_info *mapping;
 
-	list_for_each_entry(mapping,
-		&iommu_cb_set.cb_info[idx].smmu_buf_list, list) {
+	hash_for_each_possible(iommu_cb_set.cb_info[idx].fd_hash, mapping,
+		hnode, ion_fd) {
 		if (mapping->ion_fd == ion_fd) {
 			*paddr_ptr = mapping->paddr;
 			*len_ptr = mapping->len;
@@ -1975,8 +2149,8 @@ static enum cam_smmu_buf_state cam_smmu_check_dma_buf_in_list(int idx,
 {
 	struct cam_dma_buff_info *mapping;
 
-	list_for_each_entry(mapping,
-		&iommu_cb_set.cb_info[idx].smmu_buf_kernel_list, list) {
+	hash_for_each_possible(iommu_cb_set.cb_info[idx].buf_hash, mapping,
+		hnode, (unsigned long)buf) {
 		if (mapping->buf == buf) {
 			*paddr_ptr = mapping->paddr;
 			*len_ptr = mapping->len;
@@ -2991,7 +3165,7 @@ int cam_smmu_unmap_user_iova(int handle,
 
 	/* Unmapping one buffer from device */
 	CAM_DBG(CAM_SMMU, "SMMU: removing buffer idx = %d", idx);
-	rc = cam_smmu_unmap_buf_and_remove_from_list(mapping_info, idx);
+	rc = cam_smmu_warm_put(mapping_info, idx);
 	if (rc < 0)
 		CAM_ERR(CAM_SMMU, "Error: unmap or remove list fail");
 
@@ -3043,7 +3217,7 @@ int cam_smmu_unmap_kernel_iova(int handle,
 
 	/* Unmapping one buffer from device */
 	CAM_DBG(CAM_SMMU, "SMMU: removing buffer idx = %d", idx);
-	rc = cam_smmu_unmap_buf_and_remove_from_list(mapping_info, idx);
+	rc = cam_smmu_warm_put(mapping_info, idx);
 	if (rc < 0)
 		CAM_ERR(CAM_SMMU, "Error: unmap or remove list fail");
 
@@ -3124,6 +3298,8 @@ int cam_smmu_destroy_handle(int handle)
 		return -EINVAL;
 	}
 
+	cam_smmu_warm_trim(idx, 0);
+
 	if (!list_empty_careful(&iommu_cb_set.cb_info[idx].smmu_buf_list)) {
 		CAM_ERR(CAM_SMMU, "UMD %s buffer list is not clean",
 			iommu_cb_set.cb_info[idx].name);
@@ -16,6 +16,8 @@
 #include <linux/module.h>
 #include <linux/platform_device.h>
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/vmalloc.h>
 #include "cam_sync_util.h"
 #include "cam_debug_util.h"
 #include "cam_common_util.h"
@@ -47,22 +49,17 @@ int cam_sync_create(int32_t *sync_obj, const char *name)
 {
 	int rc;
 	long idx;
-	bool bit;
 
-	do {
-		idx = find_first_zero_bit(sync_dev->bitmap, CAM_SYNC_MAX_OBJS);
-		if (idx >= CAM_SYNC_MAX_OBJS) {
-			CAM_ERR(CAM_SYNC,
-				"Error: Unable to Create Sync Idx = %d Reached Max!!",
-				idx);
-			sync_dev->err_cnt++;
-			if (sync_dev->err_cnt == 1)
-				cam_sync_print_fence_table();
-			return -ENOMEM;
-		}
-		CAM_DBG(CAM_SYNC, "Index location available at idx: %ld", idx);
-		bit = test_and_set_bit(idx, sync_dev->bitmap);
-	} while (bit);
+	rc = cam_sync_util_find_and_set_empty_row(sync_dev, &idx);
+	if (rc) {
+		CAM_ERR(CAM_SYNC,
+			"Error: Unable to Create Sync Idx, Reached Max!!");
+		sync_dev->err_cnt++;
+		if (sync_dev->err_cnt == 1)
+			cam_sync_print_fence_table();
+		return -ENOMEM;
+	}
+	CAM_DBG(CAM_SYNC, "Index location available at idx: %ld", idx);
 
 	spin_lock_bh(&sync_dev->row_spinlocks[idx]);
 	rc = cam_sync_init_row(sync_dev->sync_table, idx, name,
@@ -70,8 +67,8 @@ int cam_sync_create(int32_t *sync_obj, const char *name)
 	if (rc) {
 		CAM_ERR(CAM_SYNC, "Error: Unable to init row at idx = %ld",
 			idx);
-		clear_bit(idx, sync_dev->bitmap);
 		spin_unlock_bh(&sync_dev->row_spinlocks[idx]);
+		cam_sync_util_release_row(sync_dev, idx);
 		return -EINVAL;
 	}
 
@@ -82,11 +79,12 @@ int cam_sync_create(int32_t *sync_obj, const char *name)
 	return rc;
 }
 
-int cam_sync_register_callback(sync_callback cb_func,
-	void *userdata, int32_t sync_obj)
+int cam_sync_register_callback_flags(sync_callback cb_func,
+	void *userdata, int32_t sync_obj, uint32_t flags)
 {
 	struct sync_callback_info *sync_cb;
 	struct sync_table_row *row = NULL;
+	struct list_head cb_list;
 	int status = 0;
 
 	if (sync_obj >= CAM_SYNC_MAX_OBJS || sync_obj <= 0 || !cb_func)
@@ -124,14 +122,21 @@ int cam_sync_register_callback(sync_callback cb_func,
 			sync_cb->callback_func = cb_func;
 			sync_cb->cb_data = userdata;
 			sync_cb->sync_obj = sync_obj;
-			INIT_WORK(&sync_cb->cb_dispatch_work,
-				cam_sync_util_cb_dispatch);
+			sync_cb->flags = flags;
 			sync_cb->status = row->state;
-			CAM_DBG(CAM_SYNC, "Enqueue callback for sync object:%d",
-				sync_cb->sync_obj);
-			queue_work(sync_dev->work_queue,
-				&sync_cb->cb_dispatch_work);
+			sync_cb->signal_time = ktime_get();
 			spin_unlock_bh(&sync_dev->row_spinlocks[sync_obj]);
+
+			INIT_LIST_HEAD(&cb_list);
+			list_add_tail(&sync_cb->list, &cb_list);
+			if (flags & CAM_SYNC_CB_ATOMIC_SAFE) {
+				cam_sync_util_run_cbs(&cb_list, true);
+			} else {
+				CAM_DBG(CAM_SYNC,
+					"Enqueue callback for sync object:%d",
+					sync_obj);
+				cam_sync_util_queue_cbs(&cb_list);
+			}
 		}
 
 		return 0;
@@ -140,13 +145,20 @@ int cam_sync_register_callback(sync_callback cb_func,
 	sync_cb->callback_func = cb_func;
 	sync_cb->cb_data = userdata;
 	sync_cb->sync_obj = sync_obj;
-	INIT_WORK(&sync_cb->cb_dispatch_work, cam_sync_util_cb_dispatch);
+	sync_cb->flags = flags;
 	list_add_tail(&sync_cb->list, &row->callback_list);
 	spin_unlock_bh(&sync_dev->row_spinlocks[sync_obj]);
 
 	return 0;
 }
 
+int cam_sync_register_callback(sync_callback cb_func,
+	void *userdata, int32_t sync_obj)
+{
+	return cam_sync_register_callback_flags(cb_func, userdata,
+		sync_obj, 0);
+}
+
 int cam_sync_deregister_callback(sync_callback cb_func,
 	void *userdata, int32_t sync_obj)
 {
@@ -189,6 +201,7 @@ int cam_sync_signal(int32_t sync_obj, uint32_t status)
 	struct sync_table_row *parent_row = NULL;
 	struct sync_parent_info *parent_info, *temp_parent_info;
 	struct list_head parents_list;
+	struct list_head inline_list;
 	int rc = 0;
 
 	if (sync_obj >= CAM_SYNC_MAX_OBJS || sync_obj <= 0) {
@@ -237,13 +250,17 @@ int cam_sync_signal(int32_t sync_obj, uint32_t status)
 	}
 
 	row->state = status;
-	cam_sync_util_dispatch_signaled_cb(sync_obj, status);
+	INIT_LIST_HEAD(&inline_list);
+	cam_sync_util_dispatch_signaled_cb(sync_obj, status, &inline_list);
 
 	/* copy parent list to local and release child lock */
 	INIT_LIST_HEAD(&parents_list);
 	list_splice_init(&row->parents_list, &parents_list);
 	spin_unlock_bh(&sync_dev->row_spinlocks[sync_obj]);
 
+	/* Atomic safe callbacks run here, without any row lock held */
+	cam_sync_util_run_cbs(&inline_list, true);
+
 	if (list_empty(&parents_list))
 		return 0;
 
@@ -267,19 +284,22 @@ int cam_sync_signal(int32_t sync_obj, uint32_t status)
 				parent_row->state);
 			spin_unlock_bh(
 				&sync_dev->row_spinlocks[parent_info->sync_id]);
-			kfree(parent_info);
+			cam_sync_util_free_parent(row, parent_info);
 			continue;
 		}
 
 		if (!parent_row->remaining)
 			cam_sync_util_dispatch_signaled_cb(
-				parent_info->sync_id, parent_row->state);
+				parent_info->sync_id, parent_row->state,
+				&inline_list);
 
 		spin_unlock_bh(&sync_dev->row_spinlocks[parent_info->sync_id]);
 		list_del_init(&parent_info->list);
-		kfree(parent_info);
+		cam_sync_util_free_parent(row, parent_info);
 	}
 
+	cam_sync_util_run_cbs(&inline_list, true);
+
 	return 0;
 }
 
@@ -287,7 +307,6 @@ int cam_sync_merge(int32_t *sync_obj, uint32_t num_objs, int32_t *merged_obj)
 {
 	int rc;
 	long idx = 0;
-	bool bit;
 	int i = 0;
 
 	if (!sync_obj || !merged_obj) {
@@ -314,12 +333,8 @@ int cam_sync_merge(int32_t *sync_obj, uint32_t num_objs, int32_t *merged_obj)
 			return rc;
 		}
 	}
-	do {
-		idx = find_first_zero_bit(sync_dev->bitmap, CAM_SYNC_MAX_OBJS);
-		if (idx >= CAM_SYNC_MAX_OBJS)
-			return -ENOMEM;
-		bit = test_and_set_bit(idx, sync_dev->bitmap);
-	} while (bit);
+	if (cam_sync_util_find_and_set_empty_row(sync_dev, &idx))
+		return -ENOMEM;
 
 	spin_lock_bh(&sync_dev->row_spinlocks[idx]);
 	rc = cam_sync_init_group_object(sync_dev->sync_table,
@@ -328,8 +343,8 @@ int cam_sync_merge(int32_t *sync_obj, uint32_t num_objs, int32_t *merged_obj)
 	if (rc < 0) {
 		CAM_ERR(CAM_SYNC, "Error: Unable to init row at idx = %ld",
 			idx);
-		clear_bit(idx, sync_dev->bitmap);
 		spin_unlock_bh(&sync_dev->row_spinlocks[idx]);
+		cam_sync_util_release_row(sync_dev, idx);
 		return -EINVAL;
 	}
 	CAM_DBG(CAM_SYNC, "Init row at idx:%ld to merge objects", idx);
@@ -998,6 +1013,152 @@ static void cam_sync_init_entity(struct sync_device *sync_dev)
 }
 #endif
 
+static int cam_sync_cb_latency_show(struct seq_file *m, void *data)
+{
+	struct sync_cb_stats stats;
+	uint64_t cnt;
+
+	spin_lock_bh(&sync_dev->dispatch_lock);
+	stats = sync_dev->cb_stats;
+	spin_unlock_bh(&sync_dev->dispatch_lock);
+
+	cnt = stats.dispatched + stats.inline_cnt;
+	seq_printf(m, "dispatched: %llu\n", stats.dispatched);
+	seq_printf(m, "inline: %llu\n", stats.inline_cnt);
+	seq_printf(m, "batches: %llu\n", stats.batches);
+	seq_printf(m, "max_batch: %u\n", stats.max_batch);
+	seq_printf(m, "avg_lat_us: %llu\n",
+		cnt ? div64_u64(stats.total_lat_us, cnt) : 0);
+	seq_printf(m, "max_lat_us: %llu\n", stats.max_lat_us);
+
+	return 0;
+}
+
+static int cam_sync_cb_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cam_sync_cb_latency_show, inode->i_private);
+}
+
+static ssize_t cam_sync_cb_latency_write(struct file *file,
+	const char __user *buf, size_t count, loff_t *ppos)
+{
+	spin_lock_bh(&sync_dev->dispatch_lock);
+	memset(&sync_dev->cb_stats, 0, sizeof(sync_dev->cb_stats));
+	spin_unlock_bh(&sync_dev->dispatch_lock);
+
+	return count;
+}
+
+static const struct file_operations cam_sync_cb_latency_fops = {
+	.owner = THIS_MODULE,
+	.open = cam_sync_cb_latency_open,
+	.read = seq_read,
+	.write = cam_sync_cb_latency_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/*
+ * Runs the given number of cycles of creating two fences, merging them,
+ * signaling both and destroying all three, timing each phase.
+ */
+static int cam_sync_stress_run(uint32_t iterations)
+{
+	struct sync_stress_result res = { .iterations = iterations };
+	int32_t objs[2], merged;
+	ktime_t t0, t1, t2, t3;
+	uint32_t i;
+	int rc = 0;
+
+	mutex_lock(&sync_dev->table_lock);
+	for (i = 0; i < iterations; i++) {
+		t0 = ktime_get();
+		rc = cam_sync_create(&objs[0], "stress");
+		if (rc)
+			break;
+		rc = cam_sync_create(&objs[1], "stress");
+		if (rc) {
+			cam_sync_destroy(objs[0]);
+			break;
+		}
+		rc = cam_sync_merge(objs, 2, &merged);
+		if (rc) {
+			cam_sync_destroy(objs[0]);
+			cam_sync_destroy(objs[1]);
+			break;
+		}
+
+		t1 = ktime_get();
+		cam_sync_signal(objs[0], CAM_SYNC_STATE_SIGNALED_SUCCESS);
+		cam_sync_signal(objs[1], CAM_SYNC_STATE_SIGNALED_SUCCESS);
+
+		t2 = ktime_get();
+		cam_sync_destroy(merged);
+		cam_sync_destroy(objs[0]);
+		cam_sync_destroy(objs[1]);
+		t3 = ktime_get();
+
+		res.create_ns += ktime_to_ns(ktime_sub(t1, t0));
+		res.signal_ns += ktime_to_ns(ktime_sub(t2, t1));
+		res.destroy_ns += ktime_to_ns(ktime_sub(t3, t2));
+		res.done++;
+		cond_resched();
+	}
+	sync_dev->stress = res;
+	mutex_unlock(&sync_dev->table_lock);
+
+	return rc;
+}
+
+static int cam_sync_stress_show(struct seq_file *m, void *data)
+{
+	struct sync_stress_result *res = &sync_dev->stress;
+	uint64_t total = res->create_ns + res->signal_ns + res->destroy_ns;
+	uint64_t rate = 0;
+
+	if (total)
+		rate = div64_u64((uint64_t)res->done * NSEC_PER_SEC, total);
+
+	seq_printf(m, "cycles: %u/%u\n", res->done, res->iterations);
+	seq_printf(m, "create_merge_ns: %llu\n", res->create_ns);
+	seq_printf(m, "signal_ns: %llu\n", res->signal_ns);
+	seq_printf(m, "destroy_ns: %llu\n", res->destroy_ns);
+	seq_printf(m, "cycles_per_sec: %llu\n", rate);
+
+	return 0;
+}
+
+static int cam_sync_stress_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cam_sync_stress_show, inode->i_private);
+}
+
+static ssize_t cam_sync_stress_write(struct file *file,
+	const char __user *buf, size_t count, loff_t *ppos)
+{
+	uint32_t iterations;
+	int rc;
+
+	rc = kstrtou32_from_user(buf, count, 0, &iterations);
+	if (rc)
+		return rc;
+
+	rc = cam_sync_stress_run(iterations);
+	if (rc)
+		return rc;
+
+	return count;
+}
+
+static const struct file_operations cam_sync_stress_fops = {
+	.owner = THIS_MODULE,
+	.open = cam_sync_stress_open,
+	.read = seq_read,
+	.write = cam_sync_stress_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int cam_sync_create_debugfs(void)
 {
 	sync_dev->dentry = debugfs_create_dir("camera_sync", NULL);
@@ -1015,6 +1176,18 @@ static int cam_sync_create_debugfs(void)
 		return -ENOMEM;
 	}
 
+	if (!debugfs_create_file("cb_latency", 0644, sync_dev->dentry,
+		NULL, &cam_sync_cb_latency_fops)) {
+		CAM_ERR(CAM_SYNC, "failed to create cb_latency entry");
+		return -ENOMEM;
+	}
+
+	if (!debugfs_create_file("stress", 0600, sync_dev->dentry,
+		NULL, &cam_sync_stress_fops)) {
+		CAM_ERR(CAM_SYNC, "failed to create stress entry");
+		return -ENOMEM;
+	}
+
 	return 0;
 }
 
@@ -1023,13 +1196,24 @@ static int cam_sync_probe(struct platform_device *pdev)
 	int rc;
 	int idx;
 
-	sync_dev = kzalloc(sizeof(*sync_dev), GFP_KERNEL);
+	/* The inline links make the table too big for a kmalloc */
+	sync_dev = vzalloc(sizeof(*sync_dev));
 	if (!sync_dev)
 		return -ENOMEM;
 
+	sync_dev->slot_cache = alloc_percpu(struct sync_slot_cache);
+	if (!sync_dev->slot_cache) {
+		vfree(sync_dev);
+		return -ENOMEM;
+	}
+	cam_sync_util_init_slot_cache(sync_dev);
+
 	sync_dev->err_cnt = 0;
 	mutex_init(&sync_dev->table_lock);
 	spin_lock_init(&sync_dev->cam_sync_eventq_lock);
+	INIT_LIST_HEAD(&sync_dev->dispatch_list);
+	spin_lock_init(&sync_dev->dispatch_lock);
+	INIT_WORK(&sync_dev->dispatch_work, cam_sync_util_cb_dispatch);
 
 	for (idx = 0; idx < CAM_SYNC_MAX_OBJS; idx++)
 		spin_lock_init(&sync_dev->row_spinlocks[idx]);
@@ -1097,7 +1281,8 @@ static int cam_sync_probe(struct platform_device *pdev)
 	video_device_release(sync_dev->vdev);
 vdev_fail:
 	mutex_destroy(&sync_dev->table_lock);
-	kfree(sync_dev);
+	free_percpu(sync_dev->slot_cache);
+	vfree(sync_dev);
 	return rc;
 }
 
@@ -1108,7 +1293,8 @@ static int cam_sync_remove(struct platform_device *pdev)
 	video_device_release(sync_dev->vdev);
 	debugfs_remove_recursive(sync_dev->dentry);
 	sync_dev->dentry = NULL;
-	kfree(sync_dev);
+	free_percpu(sync_dev->slot_cache);
+	vfree(sync_dev);
 	sync_dev = NULL;
 
 	return 0;
@@ -1148,7 +1334,7 @@ static void __exit cam_sync_exit(void)
 		spin_lock_init(&sync_dev->row_spinlocks[idx]);
 	platform_driver_unregister(&cam_sync_driver);
 	platform_device_unregister(&cam_sync_device);
-	kfree(sync_dev);
+	vfree(sync_dev);
 }
 
 module_init(cam_sync_init);
@@ -22,6 +22,13 @@
 #define SYNC_DEBUG_NAME_LEN 63
 typedef void (*sync_callback)(int32_t sync_obj, int status, void *data);
 
+/*
+ * The callback neither sleeps nor takes locks that are held around a
+ * cam_sync_signal() call, so it can be run in the signaling context
+ * instead of being bounced to the sync work queue.
+ */
+#define CAM_SYNC_CB_ATOMIC_SAFE BIT(0)
+
 /* Kernel APIs */
 
 /**
@@ -57,6 +64,21 @@ int cam_sync_create(int32_t *sync_obj, const char *name);
 int cam_sync_register_callback(sync_callback cb_func,
 	void *userdata, int32_t sync_obj);
 
+/**
+ * @brief: Registers a callback with a sync object, with flags
+ *
+ * @param cb_func:  Pointer to callback to be registered
+ * @param userdata: Opaque pointer which will be passed back with callback.
+ * @param sync_obj: int referencing the sync object.
+ * @param flags:    CAM_SYNC_CB_* flags describing the callback
+ *
+ * @return Status of operation. Zero in case of success.
+ * -EINVAL will be returned if userdata is invalid.
+ * -ENOMEM will be returned if cb_func is invalid.
+ */
+int cam_sync_register_callback_flags(sync_callback cb_func,
+	void *userdata, int32_t sync_obj, uint32_t flags);
+
 /**
  * @brief: De-registers a callback with a sync object
  *
@@ -40,6 +40,12 @@
 #define CAM_SYNC_NAME                   "cam_sync"
 #define CAM_SYNC_WORKQUEUE_NAME         "HIPRIO_SYNC_WORK_QUEUE"
 
+/* Children and parent links of a row that need no allocation */
+#define CAM_SYNC_INLINE_CHILDREN        4
+#define CAM_SYNC_INLINE_PARENTS         2
+/* Recently freed rows remembered per cpu for the next create */
+#define CAM_SYNC_SLOT_CACHE_SIZE        16
+
 #define CAM_SYNC_TYPE_INDV              0
 #define CAM_SYNC_TYPE_GROUP             1
 
@@ -100,7 +106,8 @@ struct sync_child_info {
  * @cb_data          : Callback data, registered by client driver
  * @status........   : Status with which callback will be invoked in client
  * @sync_obj         : Sync id of the object for which callback is registered
- * @cb_dispatch_work : Work representing the call dispatch
+ * @flags            : CAM_SYNC_CB_* flags given at registration
+ * @signal_time      : Time the object was signaled, for latency accounting
  * @list             : List member used to append this node to a linked list
  */
 struct sync_callback_info {
@@ -108,10 +115,30 @@ struct sync_callback_info {
 	void *cb_data;
 	int status;
 	int32_t sync_obj;
-	struct work_struct cb_dispatch_work;
+	uint32_t flags;
+	ktime_t signal_time;
 	struct list_head list;
 };
 
+/**
+ * struct sync_cb_stats - Signal to callback latency of kernel callbacks
+ *
+ * @dispatched   : Callbacks run from the work queue
+ * @inline_cnt   : Callbacks run directly in the signaling context
+ * @batches      : Runs of the dispatch work
+ * @max_batch    : Most callbacks run by a single pass of the dispatch work
+ * @total_lat_us : Sum of signal to callback latency
+ * @max_lat_us   : Worst signal to callback latency
+ */
+struct sync_cb_stats {
+	uint64_t dispatched;
+	uint64_t inline_cnt;
+	uint64_t batches;
+	uint32_t max_batch;
+	uint64_t total_lat_us;
+	uint64_t max_lat_us;
+};
+
 /**
  * struct sync_user_payload - Single node of information about a user space
  * payload registered from user space
@@ -140,6 +167,10 @@ struct sync_user_payload {
  * @callback_list     : Linked list of kernel callbacks registered
  * @user_payload_list : LInked list of user space payloads registered
  * @ref_cnt           : ref count of the number of usage of the fence.
+ * @inline_children   : Child nodes used before allocating, for small groups
+ * @inline_parents    : Parent nodes used before allocating
+ * @inline_used       : Bits 0..CAM_SYNC_INLINE_CHILDREN - 1 mark the inline
+ *                      children in use, the following bits the parents
  */
 struct sync_table_row {
 	char name[CAM_SYNC_OBJ_NAME_LEN];
@@ -155,6 +186,39 @@ struct sync_table_row {
 	struct list_head callback_list;
 	struct list_head user_payload_list;
 	atomic_t ref_cnt;
+	struct sync_child_info inline_children[CAM_SYNC_INLINE_CHILDREN];
+	struct sync_parent_info inline_parents[CAM_SYNC_INLINE_PARENTS];
+	unsigned long inline_used;
+};
+
+/**
+ * struct sync_slot_cache - Per cpu cache of free sync table rows
+ *
+ * @slots  : Rows freed on this cpu, only hints as the bitmap decides
+ * @cnt    : Number of valid entries in slots
+ * @cursor : Where this cpu continues its bitmap scan
+ */
+struct sync_slot_cache {
+	int32_t slots[CAM_SYNC_SLOT_CACHE_SIZE];
+	uint32_t cnt;
+	long cursor;
+};
+
+/**
+ * struct sync_stress_result - Outcome of the last debugfs stress run
+ *
+ * @iterations : Create, signal and destroy cycles requested
+ * @done       : Cycles that completed
+ * @create_ns  : Time spent creating (and merging) objects
+ * @signal_ns  : Time spent signaling objects
+ * @destroy_ns : Time spent destroying objects
+ */
+struct sync_stress_result {
+	uint32_t iterations;
+	uint32_t done;
+	uint64_t create_ns;
+	uint64_t signal_ns;
+	uint64_t destroy_ns;
 };
 
 /**
@@ -182,6 +246,12 @@ struct cam_signalable_info {
  * @open_cnt        : Count of file open calls made on the sync driver
  * @dentry          : Debugfs entry
  * @work_queue      : Work queue used for dispatching kernel callbacks
+ * @dispatch_list   : Signaled kernel callbacks waiting for dispatch_work
+ * @dispatch_lock   : Lock protecting dispatch_list and cb_stats
+ * @dispatch_work   : Work that runs every callback on dispatch_list
+ * @cb_stats        : Kernel callback latency statistics
+ * @slot_cache      : Per cpu free row cache used by create and merge
+ * @stress          : Result of the last stress run from debugfs
  * @cam_sync_eventq : Event queue used to dispatch user payloads to user space
  * @bitmap          : Bitmap representation of all sync objects
  * @err_cnt         : Error counter to dump fence table
@@ -195,6 +265,12 @@ struct sync_device {
 	int open_cnt;
 	struct dentry *dentry;
 	struct workqueue_struct *work_queue;
+	struct list_head dispatch_list;
+	spinlock_t dispatch_lock;
+	struct work_struct dispatch_work;
+	struct sync_cb_stats cb_stats;
+	struct sync_slot_cache __percpu *slot_cache;
+	struct sync_stress_result stress;
 	struct v4l2_fh *cam_sync_eventq;
 	spinlock_t cam_sync_eventq_lock;
 	DECLARE_BITMAP(bitmap, CAM_SYNC_MAX_OBJS);
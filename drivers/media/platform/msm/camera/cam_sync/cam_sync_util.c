@@ -12,23 +12,129 @@
 
 #include "cam_sync_util.h"
 
+void cam_sync_util_init_slot_cache(struct sync_device *sync_dev)
+{
+	struct sync_slot_cache *cache;
+	int cpu;
+
+	/* Start each cpu in its own part of the table */
+	for_each_possible_cpu(cpu) {
+		cache = per_cpu_ptr(sync_dev->slot_cache, cpu);
+		cache->cnt = 0;
+		cache->cursor = 1 + (CAM_SYNC_MAX_OBJS - 1) * cpu / nr_cpu_ids;
+	}
+}
+
+static long cam_sync_util_scan_row(struct sync_device *sync_dev,
+	long start)
+{
+	long idx;
+
+	for (idx = find_next_zero_bit(sync_dev->bitmap,
+			CAM_SYNC_MAX_OBJS, start);
+		idx < CAM_SYNC_MAX_OBJS;
+		idx = find_next_zero_bit(sync_dev->bitmap,
+			CAM_SYNC_MAX_OBJS, idx + 1)) {
+		if (!test_and_set_bit(idx, sync_dev->bitmap))
+			return idx;
+	}
+
+	return -1;
+}
+
 int cam_sync_util_find_and_set_empty_row(struct sync_device *sync_dev,
 	long *idx)
 {
-	int rc = 0;
+	struct sync_slot_cache *cache;
+	long found = -1;
+
+	/*
+	 * The bitmap stays the only owner of a row. Cached slots and the
+	 * cursor are hints, taken with test_and_set_bit like any other
+	 * free bit, so no lock is needed between cpus.
+	 */
+	local_bh_disable();
+	cache = this_cpu_ptr(sync_dev->slot_cache);
+	while (cache->cnt) {
+		found = cache->slots[--cache->cnt];
+		if (!test_and_set_bit(found, sync_dev->bitmap))
+			goto done;
+	}
+
+	found = cam_sync_util_scan_row(sync_dev, cache->cursor);
+	if (found < 0)
+		found = cam_sync_util_scan_row(sync_dev, 1);
+	if (found < 0) {
+		local_bh_enable();
+		return -ENOMEM;
+	}
+
+	cache->cursor = found + 1 < CAM_SYNC_MAX_OBJS ? found + 1 : 1;
+done:
+	local_bh_enable();
+	*idx = found;
+
+	return 0;
+}
+
+void cam_sync_util_release_row(struct sync_device *sync_dev, long idx)
+{
+	struct sync_slot_cache *cache;
+
+	clear_bit(idx, sync_dev->bitmap);
+
+	local_bh_disable();
+	cache = this_cpu_ptr(sync_dev->slot_cache);
+	if (cache->cnt < CAM_SYNC_SLOT_CACHE_SIZE)
+		cache->slots[cache->cnt++] = idx;
+	local_bh_enable();
+}
+
+static struct sync_child_info *cam_sync_util_alloc_child(
+	struct sync_table_row *row)
+{
+	int i;
 
-	mutex_lock(&sync_dev->table_lock);
+	for (i = 0; i < CAM_SYNC_INLINE_CHILDREN; i++)
+		if (!test_and_set_bit(i, &row->inline_used))
+			return &row->inline_children[i];
 
-	*idx = find_first_zero_bit(sync_dev->bitmap, CAM_SYNC_MAX_OBJS);
+	return kzalloc(sizeof(struct sync_child_info), GFP_ATOMIC);
+}
 
-	if (*idx < CAM_SYNC_MAX_OBJS)
-		set_bit(*idx, sync_dev->bitmap);
+static void cam_sync_util_free_child(struct sync_table_row *row,
+	struct sync_child_info *child_info)
+{
+	ptrdiff_t i = child_info - row->inline_children;
+
+	if (i >= 0 && i < CAM_SYNC_INLINE_CHILDREN)
+		clear_bit(i, &row->inline_used);
 	else
-		rc = -1;
+		kfree(child_info);
+}
+
+static struct sync_parent_info *cam_sync_util_alloc_parent(
+	struct sync_table_row *row)
+{
+	int i;
 
-	mutex_unlock(&sync_dev->table_lock);
+	for (i = 0; i < CAM_SYNC_INLINE_PARENTS; i++)
+		if (!test_and_set_bit(CAM_SYNC_INLINE_CHILDREN + i,
+			&row->inline_used))
+			return &row->inline_parents[i];
 
-	return rc;
+	return kzalloc(sizeof(struct sync_parent_info), GFP_ATOMIC);
+}
+
+void cam_sync_util_free_parent(struct sync_table_row *row,
+	struct sync_parent_info *parent_info)
+{
+	ptrdiff_t i = parent_info - row->inline_parents;
+
+	if (i >= 0 && i < CAM_SYNC_INLINE_PARENTS)
+		clear_bit(CAM_SYNC_INLINE_CHILDREN + i, &row->inline_used);
+	else
+		kfree(parent_info);
 }
 
 int cam_sync_init_row(struct sync_table_row *table,
@@ -108,7 +214,7 @@ int cam_sync_init_group_object(struct sync_table_row *table,
 		row->remaining++;
 
 		/* Add child info */
-		child_info = kzalloc(sizeof(*child_info), GFP_ATOMIC);
+		child_info = cam_sync_util_alloc_child(row);
 		if (!child_info) {
 			spin_unlock_bh(&sync_dev->row_spinlocks[sync_objs[i]]);
 			rc = -ENOMEM;
@@ -118,7 +224,7 @@ int cam_sync_init_group_object(struct sync_table_row *table,
 		list_add_tail(&child_info->list, &row->children_list);
 
 		/* Add parent info */
-		parent_info = kzalloc(sizeof(*parent_info), GFP_ATOMIC);
+		parent_info = cam_sync_util_alloc_parent(child_row);
 		if (!parent_info) {
 			spin_unlock_bh(&sync_dev->row_spinlocks[sync_objs[i]]);
 			rc = -ENOMEM;
@@ -220,7 +326,7 @@ int cam_sync_deinit_object(struct sync_table_row *table, uint32_t idx)
 			list_del_init(&child_info->list);
 			spin_unlock_bh(&sync_dev->row_spinlocks[
 				child_info->sync_id]);
-			kfree(child_info);
+			cam_sync_util_free_child(row, child_info);
 			continue;
 		}
 
@@ -234,7 +340,7 @@ int cam_sync_deinit_object(struct sync_table_row *table, uint32_t idx)
 
 		list_del_init(&child_info->list);
 		spin_unlock_bh(&sync_dev->row_spinlocks[child_info->sync_id]);
-		kfree(child_info);
+		cam_sync_util_free_child(row, child_info);
 	}
 
 	/* Cleanup the parent to child link */
@@ -249,7 +355,7 @@ int cam_sync_deinit_object(struct sync_table_row *table, uint32_t idx)
 			list_del_init(&parent_info->list);
 			spin_unlock_bh(&sync_dev->row_spinlocks[
 				parent_info->sync_id]);
-			kfree(parent_info);
+			cam_sync_util_free_parent(row, parent_info);
 			continue;
 		}
 
@@ -263,7 +369,7 @@ int cam_sync_deinit_object(struct sync_table_row *table, uint32_t idx)
 
 		list_del_init(&parent_info->list);
 		spin_unlock_bh(&sync_dev->row_spinlocks[parent_info->sync_id]);
-		kfree(parent_info);
+		cam_sync_util_free_parent(row, parent_info);
 	}
 
 	spin_lock_bh(&sync_dev->row_spinlocks[idx]);
@@ -280,7 +386,7 @@ int cam_sync_deinit_object(struct sync_table_row *table, uint32_t idx)
 	}
 
 	memset(row, 0, sizeof(*row));
-	clear_bit(idx, sync_dev->bitmap);
+	cam_sync_util_release_row(sync_dev, idx);
 	INIT_LIST_HEAD(&row->callback_list);
 	INIT_LIST_HEAD(&row->parents_list);
 	INIT_LIST_HEAD(&row->children_list);
@@ -291,22 +397,89 @@ int cam_sync_deinit_object(struct sync_table_row *table, uint32_t idx)
 	return 0;
 }
 
-void cam_sync_util_cb_dispatch(struct work_struct *cb_dispatch_work)
+void cam_sync_util_run_cbs(struct list_head *list, bool is_inline)
 {
-	struct sync_callback_info *cb_info = container_of(cb_dispatch_work,
-		struct sync_callback_info,
-		cb_dispatch_work);
+	struct sync_callback_info *cb_info, *temp;
+	struct sync_cb_stats *stats = &sync_dev->cb_stats;
+	uint64_t lat_us, total_us = 0, max_us = 0;
+	uint32_t cnt = 0;
 
-	cb_info->callback_func(cb_info->sync_obj,
-		cb_info->status,
-		cb_info->cb_data);
+	list_for_each_entry_safe(cb_info, temp, list, list) {
+		list_del_init(&cb_info->list);
 
-	kfree(cb_info);
+		lat_us = ktime_us_delta(ktime_get(), cb_info->signal_time);
+		total_us += lat_us;
+		max_us = max(max_us, lat_us);
+		cnt++;
+
+		cb_info->callback_func(cb_info->sync_obj,
+			cb_info->status,
+			cb_info->cb_data);
+
+		kfree(cb_info);
+	}
+
+	if (!cnt)
+		return;
+
+	spin_lock_bh(&sync_dev->dispatch_lock);
+	if (is_inline)
+		stats->inline_cnt += cnt;
+	else
+		stats->dispatched += cnt;
+	stats->total_lat_us += total_us;
+	stats->max_lat_us = max(stats->max_lat_us, max_us);
+	spin_unlock_bh(&sync_dev->dispatch_lock);
+}
+
+void cam_sync_util_queue_cbs(struct list_head *list)
+{
+	if (list_empty(list))
+		return;
+
+	spin_lock_bh(&sync_dev->dispatch_lock);
+	list_splice_tail_init(list, &sync_dev->dispatch_list);
+	spin_unlock_bh(&sync_dev->dispatch_lock);
+
+	queue_work(sync_dev->work_queue, &sync_dev->dispatch_work);
+}
+
+void cam_sync_util_cb_dispatch(struct work_struct *work)
+{
+	struct list_head batch;
+	struct sync_callback_info *cb_info;
+	uint32_t cnt;
+
+	INIT_LIST_HEAD(&batch);
+
+	/*
+	 * Callbacks signaled while this runs are picked up by the next pass
+	 * instead of costing another work item each.
+	 */
+	for (;;) {
+		spin_lock_bh(&sync_dev->dispatch_lock);
+		if (list_empty(&sync_dev->dispatch_list)) {
+			spin_unlock_bh(&sync_dev->dispatch_lock);
+			break;
+		}
+		list_splice_init(&sync_dev->dispatch_list, &batch);
+		cnt = 0;
+		list_for_each_entry(cb_info, &batch, list)
+			cnt++;
+		sync_dev->cb_stats.batches++;
+		sync_dev->cb_stats.max_batch =
+			max(sync_dev->cb_stats.max_batch, cnt);
+		spin_unlock_bh(&sync_dev->dispatch_lock);
+
+		cam_sync_util_run_cbs(&batch, false);
+	}
 }
 
 void cam_sync_util_dispatch_signaled_cb(int32_t sync_obj,
-	uint32_t status)
+	uint32_t status, struct list_head *inline_list)
 {
+	struct list_head            dispatch;
+	ktime_t                     now = ktime_get();
 	struct sync_callback_info  *sync_cb;
 	struct sync_user_payload   *payload_info;
 	struct sync_callback_info  *temp_sync_cb;
@@ -321,13 +494,17 @@ void cam_sync_util_dispatch_signaled_cb(int32_t sync_obj,
 	}
 
 	/* Dispatch kernel callbacks if any were registered earlier */
+	INIT_LIST_HEAD(&dispatch);
 	list_for_each_entry_safe(sync_cb,
 		temp_sync_cb, &signalable_row->callback_list, list) {
 		sync_cb->status = status;
-		list_del_init(&sync_cb->list);
-		queue_work(sync_dev->work_queue,
-			&sync_cb->cb_dispatch_work);
+		sync_cb->signal_time = now;
+		if (sync_cb->flags & CAM_SYNC_CB_ATOMIC_SAFE)
+			list_move_tail(&sync_cb->list, inline_list);
+		else
+			list_move_tail(&sync_cb->list, &dispatch);
 	}
+	cam_sync_util_queue_cbs(&dispatch);
 
 	/* Dispatch user payloads if any were registered earlier */
 	list_for_each_entry_safe(payload_info, temp_payload_info,
@@ -425,7 +602,7 @@ void cam_sync_util_cleanup_children_list(struct sync_table_row *row,
 
 		curr_sync_obj = child_info->sync_id;
 		list_del_init(&child_info->list);
-		kfree(child_info);
+		cam_sync_util_free_child(row, child_info);
 
 		if ((list_clean_type == SYNC_LIST_CLEAN_ONE) &&
 			(curr_sync_obj == sync_obj))
@@ -448,7 +625,7 @@ void cam_sync_util_cleanup_parents_list(struct sync_table_row *row,
 
 		curr_sync_obj = parent_info->sync_id;
 		list_del_init(&parent_info->list);
-		kfree(parent_info);
+		cam_sync_util_free_parent(row, parent_info);
 
 		if ((list_clean_type == SYNC_LIST_CLEAN_ONE) &&
 			(curr_sync_obj == sync_obj))
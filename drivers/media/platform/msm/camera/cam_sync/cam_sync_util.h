@@ -33,6 +33,38 @@ extern struct sync_device *sync_dev;
 int cam_sync_util_find_and_set_empty_row(struct sync_device *sync_dev,
 	long *idx);
 
+/**
+ * @brief: Function to release a row taken by
+ *         cam_sync_util_find_and_set_empty_row, caching it for the next
+ *         allocation on this cpu
+ *
+ * @param sync_dev : Pointer to the sync device instance
+ * @param idx      : Index of the row in the bit array
+ *
+ * @return None
+ */
+void cam_sync_util_release_row(struct sync_device *sync_dev, long idx);
+
+/**
+ * @brief: Function to set up the per cpu free row caches
+ *
+ * @param sync_dev : Pointer to the sync device instance
+ *
+ * @return None
+ */
+void cam_sync_util_init_slot_cache(struct sync_device *sync_dev);
+
+/**
+ * @brief: Function to free a parent node of a row, inline or allocated
+ *
+ * @param row         : Row holding the node in its parents list
+ * @param parent_info : Node to free, already unlinked
+ *
+ * @return None
+ */
+void cam_sync_util_free_parent(struct sync_table_row *row,
+	struct sync_parent_info *parent_info);
+
 /**
  * @brief: Function to initialize an empty row in the sync table. This should be
  *         called only for individual sync objects.
@@ -77,25 +109,50 @@ int cam_sync_init_group_object(struct sync_table_row *table,
 int cam_sync_deinit_object(struct sync_table_row *table, uint32_t idx);
 
 /**
- * @brief: Function to dispatch a kernel callback for a sync callback
+ * @brief: Work function running every kernel callback queued on the
+ *         dispatch list, until the list stays empty
+ *
+ * @param work : Pointer to the dispatch work of the sync device
+ *
+ * @return None
+ */
+void cam_sync_util_cb_dispatch(struct work_struct *work);
+
+/**
+ * @brief: Function to queue signaled kernel callbacks to the dispatch work
+ *
+ * @list : List of sync_callback_info, emptied by the call
+ *
+ * @return None
+ */
+void cam_sync_util_queue_cbs(struct list_head *list);
+
+/**
+ * @brief: Function to run and free a list of signaled kernel callbacks
+ *         in the calling context. Must not be called with a row lock held.
  *
- * @param cb_dispatch_work : Pointer to the work_struct that needs to be
- *                           dispatched
+ * @list   : List of sync_callback_info, emptied by the call
+ * @is_inline : True if called from the signaling context
  *
  * @return None
  */
-void cam_sync_util_cb_dispatch(struct work_struct *cb_dispatch_work);
+void cam_sync_util_run_cbs(struct list_head *list, bool is_inline);
 
 /**
  * @brief: Function to dispatch callbacks for a signaled sync object
  *
- * @sync_obj : Sync object that is signaled
- * @status   : Status of the signaled object
+ * Callbacks registered with CAM_SYNC_CB_ATOMIC_SAFE are moved to
+ * @inline_list, for the caller to run them once the row lock is dropped.
+ * All others are handed to the dispatch work in one go.
+ *
+ * @sync_obj    : Sync object that is signaled
+ * @status      : Status of the signaled object
+ * @inline_list : List collecting the callbacks to run inline
  *
  * @return None
  */
 void cam_sync_util_dispatch_signaled_cb(int32_t sync_obj,
-	uint32_t status);
+	uint32_t status, struct list_head *inline_list);
 
 /**
  * @brief: Function to send V4L event to user space
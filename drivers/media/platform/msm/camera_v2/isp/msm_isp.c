@@ -51,7 +51,7 @@ static const struct of_device_id msm_vfe_dt_match[] = {
 
 MODULE_DEVICE_TABLE(of, msm_vfe_dt_match);
 
-#define MAX_OVERFLOW_COUNTERS  29
+#define MAX_OVERFLOW_COUNTERS  33
 #define OVERFLOW_LENGTH 1024
 #define OVERFLOW_BUFFER_LENGTH 64
 static char stat_line[OVERFLOW_LENGTH];
@@ -89,6 +89,10 @@ static char *stats_str[MAX_OVERFLOW_COUNTERS] = {
 	"ISP_last_overflow.ib",
 	"ISP_VFE_CLK_RATE",
 	"ISP_CPP_CLK_RATE",
+	"ISP_tasklet_cnt",
+	"ISP_tasklet_total_us",
+	"ISP_tasklet_max_us",
+	"ISP_irq_latency_max_us",
 };
 
 #define MAX_DEPTH_BW_REQ_HISTORY 25
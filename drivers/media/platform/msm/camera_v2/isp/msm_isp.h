@@ -609,6 +609,9 @@ struct msm_vfe_stats_shared_data {
 	uint8_t num_active_stream;
 	atomic_t stats_comp_mask[MAX_NUM_STATS_COMP_MASK];
 	uint16_t stream_handle_cnt;
+	/* per frame stats event, under common_dev_data_lock */
+	struct msm_isp_event_data batch_event;
+	uint32_t batch_mask;
 };
 
 struct msm_vfe_tasklet_queue_cmd {
@@ -618,6 +621,7 @@ struct msm_vfe_tasklet_queue_cmd {
 	uint32_t vfe_pingpong_status;
 	uint32_t dualvfeInterruptstatus;
 	struct msm_isp_timestamp ts;
+	ktime_t irq_time;
 	uint8_t cmd_used;
 	struct vfe_device *vfe_dev;
 };
@@ -678,6 +682,12 @@ struct msm_isp_statistics {
 
 	int64_t vfe_clk_rate;
 	int64_t cpp_clk_rate;
+
+	/* IRQ to tasklet and tasklet handling time */
+	int64_t tasklet_cnt;
+	int64_t tasklet_total_us;
+	int64_t tasklet_max_us;
+	int64_t irq_latency_max_us;
 };
 
 struct msm_isp_bw_req_info {
@@ -11,12 +11,17 @@
  */
 #include <linux/io.h>
 #include <linux/atomic.h>
+#include <linux/module.h>
 #include <media/v4l2-subdev.h>
 #include <media/msmb_isp.h>
 #include "msm_isp_util.h"
 #include "msm_isp_axi_util.h"
 #include "msm_isp_stats_util.h"
 
+static bool stats_batch;
+module_param(stats_batch, bool, 0644);
+MODULE_PARM_DESC(stats_batch, "One composite stats event per frame");
+
 static inline void msm_isp_stats_cfg_wm_scratch(struct vfe_device *vfe_dev,
 				struct msm_vfe_stats_stream *stream_info,
 				uint32_t pingpong_status)
@@ -265,6 +270,74 @@ static int32_t msm_isp_stats_buf_divert(struct vfe_device *vfe_dev,
 	return rc;
 }
 
+/* stats types streaming on @vfe_dev, as event stats_mask bits */
+static uint32_t msm_isp_stats_active_mask(struct vfe_device *vfe_dev)
+{
+	struct msm_vfe_stats_stream *stream_info;
+	uint32_t mask = 0;
+	int i;
+
+	for (i = 0; i < vfe_dev->hw_info->stats_hw_info->num_stats_type; i++) {
+		stream_info = msm_isp_get_stats_stream_common_data(vfe_dev, i);
+		if (stream_info->state == STATS_ACTIVE)
+			mask |= 1 << stream_info->stats_type;
+	}
+	return mask;
+}
+
+/*
+ * Fold the stats of @buf_event into one ISP_EVENT_COMP_STATS_NOTIFY for
+ * the frame. It goes out once every active stats type is in, or when the
+ * stats of the next frame start and the frame missed some.
+ */
+static void msm_isp_stats_batch(struct vfe_device *vfe_dev,
+	struct msm_isp_event_data *buf_event)
+{
+	struct msm_vfe_stats_shared_data *stats_data = &vfe_dev->stats_data;
+	struct msm_isp_stats_event *stats_event = &buf_event->u.stats;
+	struct msm_isp_event_data prev, cur;
+	uint32_t active = msm_isp_stats_active_mask(vfe_dev);
+	bool send_prev = false, send_cur = false;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&vfe_dev->common_data->common_dev_data_lock, flags);
+	if (stats_data->batch_mask &&
+		stats_data->batch_event.frame_id != buf_event->frame_id) {
+		prev = stats_data->batch_event;
+		stats_data->batch_mask = 0;
+		send_prev = true;
+	}
+
+	if (!stats_data->batch_mask) {
+		stats_data->batch_event = *buf_event;
+	} else {
+		for (i = 0; i < MSM_ISP_STATS_MAX; i++)
+			if (stats_event->stats_mask & (1 << i))
+				stats_data->batch_event.u.stats
+					.stats_buf_idxs[i] =
+					stats_event->stats_buf_idxs[i];
+		if (stats_event->stats_mask & (1 << MSM_ISP_STATS_BF))
+			stats_data->batch_event.u.stats.pd_stats_idx =
+				stats_event->pd_stats_idx;
+	}
+	stats_data->batch_mask |= stats_event->stats_mask;
+	stats_data->batch_event.u.stats.stats_mask = stats_data->batch_mask;
+
+	if ((stats_data->batch_mask & active) == active) {
+		cur = stats_data->batch_event;
+		stats_data->batch_mask = 0;
+		send_cur = true;
+	}
+	spin_unlock_irqrestore(&vfe_dev->common_data->common_dev_data_lock,
+		flags);
+
+	if (send_prev)
+		msm_isp_send_event(vfe_dev, ISP_EVENT_COMP_STATS_NOTIFY, &prev);
+	if (send_cur)
+		msm_isp_send_event(vfe_dev, ISP_EVENT_COMP_STATS_NOTIFY, &cur);
+}
+
 static int32_t msm_isp_stats_configure(struct vfe_device *vfe_dev,
 	uint32_t stats_irq_mask, struct msm_isp_timestamp *ts,
 	uint32_t pingpong_status, bool is_composite)
@@ -308,8 +381,11 @@ static int32_t msm_isp_stats_configure(struct vfe_device *vfe_dev,
 			__func__, vfe_dev->pdev->id, buf_event.frame_id,
 			comp_stats_type_mask);
 		stats_event->stats_mask = comp_stats_type_mask;
-		msm_isp_send_event(vfe_dev,
-			ISP_EVENT_COMP_STATS_NOTIFY, &buf_event);
+		if (stats_batch)
+			msm_isp_stats_batch(vfe_dev, &buf_event);
+		else
+			msm_isp_send_event(vfe_dev,
+				ISP_EVENT_COMP_STATS_NOTIFY, &buf_event);
 		comp_stats_type_mask = 0;
 	}
 	return result;
@@ -351,10 +427,10 @@ void msm_isp_process_stats_irq(struct vfe_device *vfe_dev,
 			&vfe_dev->stats_data.stats_comp_mask[j]);
 	}
 
-	/* Process non-composite irq */
+	/* Process non-composite irq, folded in the frame event if batched */
 	if (stats_irq_mask) {
 		rc = msm_isp_stats_configure(vfe_dev, stats_irq_mask, ts,
-			pingpong_status, comp_flag);
+			pingpong_status, comp_flag || stats_batch);
 	}
 
 	/* Process composite irq */
@@ -1072,6 +1148,21 @@ static void __msm_isp_stop_stats_streams(
 		spin_unlock_irqrestore(&stream_info->lock, flags);
 	}
 
+	/* the buffers of a pending frame event were flushed above */
+	for (i = 0; i < num_streams; i++) {
+		stream_info = streams[i];
+		for (k = 0; k < stream_info->num_isp; k++) {
+			vfe_dev = stream_info->vfe_dev[k];
+			spin_lock_irqsave(
+				&vfe_dev->common_data->common_dev_data_lock,
+				flags);
+			vfe_dev->stats_data.batch_mask = 0;
+			spin_unlock_irqrestore(
+				&vfe_dev->common_data->common_dev_data_lock,
+				flags);
+		}
+	}
+
 	if (msm_isp_stats_wait_for_streams(streams, num_streams, 0)) {
 		for (i = 0; i < num_streams; i++) {
 			stream_info = streams[i];
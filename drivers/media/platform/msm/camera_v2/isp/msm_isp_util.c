@@ -2177,6 +2177,7 @@ static void msm_isp_enqueue_tasklet_cmd(struct vfe_device *vfe_dev,
 	queue_cmd->vfe_pingpong_status = ping_pong_status;
 	queue_cmd->dualvfeInterruptstatus = dual_irq_status;
 	msm_isp_get_timestamp(&queue_cmd->ts, vfe_dev);
+	queue_cmd->irq_time = ktime_get();
 	queue_cmd->cmd_used = 1;
 	queue_cmd->vfe_dev = vfe_dev;
 
@@ -2271,6 +2272,21 @@ irqreturn_t msm_isp_process_irq(int irq_num, void *data)
 	return IRQ_HANDLED;
 }
 
+static void msm_isp_update_tasklet_stats(struct vfe_device *vfe_dev,
+	ktime_t irq_time, ktime_t start)
+{
+	struct msm_isp_statistics *stats = vfe_dev->stats;
+	int64_t us = ktime_us_delta(ktime_get(), start);
+
+	stats->tasklet_cnt++;
+	stats->tasklet_total_us += us;
+	if (us > stats->tasklet_max_us)
+		stats->tasklet_max_us = us;
+	us = ktime_us_delta(start, irq_time);
+	if (us > stats->irq_latency_max_us)
+		stats->irq_latency_max_us = us;
+}
+
 void msm_isp_do_tasklet(unsigned long data)
 {
 	unsigned long flags;
@@ -2280,6 +2296,7 @@ void msm_isp_do_tasklet(unsigned long data)
 	struct msm_vfe_tasklet_queue_cmd *queue_cmd;
 	struct msm_isp_timestamp ts;
 	uint32_t irq_status0, irq_status1, pingpong_status, dual_irq_status;
+	ktime_t irq_time, start;
 
 	while (1) {
 		spin_lock_irqsave(&tasklet->tasklet_lock, flags);
@@ -2299,7 +2316,9 @@ void msm_isp_do_tasklet(unsigned long data)
 		dual_irq_status = queue_cmd->dualvfeInterruptstatus;
 
 		ts = queue_cmd->ts;
+		irq_time = queue_cmd->irq_time;
 		spin_unlock_irqrestore(&tasklet->tasklet_lock, flags);
+		start = ktime_get();
 		if (vfe_dev->vfe_open_cnt == 0) {
 			pr_err("%s: VFE%d open cnt = %d, irq %x/%x\n",
 			__func__, vfe_dev->pdev->id, vfe_dev->vfe_open_cnt,
@@ -2352,6 +2371,7 @@ void msm_isp_do_tasklet(unsigned long data)
 			irq_ops->process_epoch_irq(vfe_dev,
 				irq_status0, irq_status1, &ts);
 		}
+		msm_isp_update_tasklet_stats(vfe_dev, irq_time, start);
 	}
 }
 
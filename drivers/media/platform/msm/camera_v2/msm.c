@@ -614,6 +614,7 @@ static inline int __msm_destroy_session_streams(void *d1, void *d2)
 	pr_err("%s: Error: Destroyed list is not empty\n", __func__);
 	spin_lock_irqsave(&stream->stream_lock, flags);
 	INIT_LIST_HEAD(&stream->queued_list);
+	memset(stream->queued_bufs, 0, sizeof(stream->queued_bufs));
 	spin_unlock_irqrestore(&stream->stream_lock, flags);
 	return 0;
 }
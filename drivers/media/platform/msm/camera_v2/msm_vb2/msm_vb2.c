@@ -49,6 +49,20 @@ static int msm_vb2_queue_setup(struct vb2_queue *q,
 	return rc;
 }
 
+/* O(1) queued_list membership of @vb, called under stream_lock */
+static struct msm_vb2_buffer *msm_vb2_find_queued(struct msm_stream *stream,
+	struct vb2_v4l2_buffer *vb)
+{
+	struct msm_vb2_buffer *msm_vb2;
+
+	if (vb->vb2_buf.index >= VB2_MAX_FRAME)
+		return NULL;
+	msm_vb2 = stream->queued_bufs[vb->vb2_buf.index];
+	if (!msm_vb2 || &msm_vb2->vb2_v4l2_buf != vb)
+		return NULL;
+	return msm_vb2;
+}
+
 static int msm_vb2_buf_init(struct vb2_buffer *vb)
 {
 	struct msm_stream *stream;
@@ -104,6 +118,7 @@ static void msm_vb2_buf_queue(struct vb2_buffer *vb)
 
 	spin_lock_irqsave(&stream->stream_lock, flags);
 	list_add_tail(&msm_vb2->list, &stream->queued_list);
+	stream->queued_bufs[vb->index] = msm_vb2;
 	spin_unlock_irqrestore(&stream->stream_lock, flags);
 	read_unlock_irqrestore(&session->stream_rwlock, rl_flags);
 }
@@ -114,7 +129,6 @@ static void msm_vb2_buf_finish(struct vb2_buffer *vb)
 	struct msm_stream *stream;
 	struct msm_session *session;
 	unsigned long flags, rl_flags;
-	struct msm_vb2_buffer *msm_vb2_entry, *temp;
 	struct vb2_v4l2_buffer *vbuf = to_vb2_v4l2_buffer(vb);
 
 	msm_vb2 = container_of(vbuf, struct msm_vb2_buffer, vb2_v4l2_buf);
@@ -137,12 +151,9 @@ static void msm_vb2_buf_finish(struct vb2_buffer *vb)
 	}
 
 	spin_lock_irqsave(&stream->stream_lock, flags);
-	list_for_each_entry_safe(msm_vb2_entry, temp, &(stream->queued_list),
-		list) {
-		if (msm_vb2_entry == msm_vb2) {
-			list_del_init(&msm_vb2_entry->list);
-			break;
-		}
+	if (msm_vb2_find_queued(stream, vbuf)) {
+		stream->queued_bufs[vb->index] = NULL;
+		list_del_init(&msm_vb2->list);
 	}
 	spin_unlock_irqrestore(&stream->stream_lock, flags);
 	read_unlock_irqrestore(&session->stream_rwlock, rl_flags);
@@ -333,17 +344,12 @@ static struct vb2_v4l2_buffer *msm_vb2_get_buf_by_idx(int session_id,
 		goto end;
 	}
 
-	list_for_each_entry(msm_vb2, &(stream->queued_list), list) {
-		vb2_v4l2_buf = &(msm_vb2->vb2_v4l2_buf);
-		if ((vb2_v4l2_buf->vb2_buf.index != index) || msm_vb2->in_freeq
-			|| vb2_v4l2_buf->vb2_buf.state != VB2_BUF_STATE_ACTIVE)
-			continue;
-
+	msm_vb2 = index < VB2_MAX_FRAME ? stream->queued_bufs[index] : NULL;
+	if (msm_vb2 && !msm_vb2->in_freeq &&
+		msm_vb2->vb2_v4l2_buf.vb2_buf.state == VB2_BUF_STATE_ACTIVE) {
 		msm_vb2->in_freeq = 1;
-		goto end;
+		vb2_v4l2_buf = &(msm_vb2->vb2_v4l2_buf);
 	}
-	msm_vb2 = NULL;
-	vb2_v4l2_buf = NULL;
 end:
 	spin_unlock_irqrestore(&stream->stream_lock, flags);
 	read_unlock_irqrestore(&session->stream_rwlock, rl_flags);
@@ -356,7 +362,6 @@ static int msm_vb2_put_buf(struct vb2_v4l2_buffer *vb, int session_id,
 	struct msm_stream *stream;
 	struct msm_session *session;
 	struct msm_vb2_buffer *msm_vb2;
-	struct vb2_v4l2_buffer *vb2_v4l2_buf = NULL;
 	int rc = 0;
 	unsigned long flags, rl_flags;
 
@@ -374,12 +379,8 @@ static int msm_vb2_put_buf(struct vb2_v4l2_buffer *vb, int session_id,
 
 	spin_lock_irqsave(&stream->stream_lock, flags);
 	if (vb) {
-		list_for_each_entry(msm_vb2, &(stream->queued_list), list) {
-			vb2_v4l2_buf = &(msm_vb2->vb2_v4l2_buf);
-			if (vb2_v4l2_buf == vb)
-				break;
-		}
-		if (vb2_v4l2_buf != vb) {
+		msm_vb2 = msm_vb2_find_queued(stream, vb);
+		if (!msm_vb2) {
 			pr_err("VB buffer is INVALID vb=%pK, ses_id=%d, str_id=%d\n",
 					vb, session_id, stream_id);
 			spin_unlock_irqrestore(&stream->stream_lock, flags);
@@ -387,9 +388,6 @@ static int msm_vb2_put_buf(struct vb2_v4l2_buffer *vb, int session_id,
 				rl_flags);
 			return -EINVAL;
 		}
-		msm_vb2 =
-			container_of(vb2_v4l2_buf, struct msm_vb2_buffer,
-				vb2_v4l2_buf);
 		if (msm_vb2->in_freeq) {
 			msm_vb2->in_freeq = 0;
 			rc = 0;
@@ -430,12 +428,8 @@ static int msm_vb2_buf_done(struct vb2_v4l2_buffer *vb, int session_id,
 
 	spin_lock_irqsave(&stream->stream_lock, flags);
 	if (vb) {
-		list_for_each_entry(msm_vb2, &(stream->queued_list), list) {
-			vb2_v4l2_buf = &(msm_vb2->vb2_v4l2_buf);
-			if (vb2_v4l2_buf == vb)
-				break;
-		}
-		if (vb2_v4l2_buf != vb) {
+		msm_vb2 = msm_vb2_find_queued(stream, vb);
+		if (!msm_vb2) {
 			pr_err("VB buffer is INVALID ses_id=%d, str_id=%d, vb=%pK\n",
 				    session_id, stream_id, vb);
 			spin_unlock_irqrestore(&stream->stream_lock, flags);
@@ -443,9 +437,7 @@ static int msm_vb2_buf_done(struct vb2_v4l2_buffer *vb, int session_id,
 				rl_flags);
 			return -EINVAL;
 		}
-		msm_vb2 =
-			container_of(vb2_v4l2_buf, struct msm_vb2_buffer,
-				vb2_v4l2_buf);
+		vb2_v4l2_buf = vb;
 		/* put buf before buf done */
 		if (msm_vb2->in_freeq) {
 			vb2_v4l2_buf->sequence = sequence;
@@ -494,12 +486,8 @@ static int msm_vb2_buf_error(struct vb2_v4l2_buffer *vb, int session_id,
 
 	spin_lock_irqsave(&stream->stream_lock, flags);
 	if (vb) {
-		list_for_each_entry(msm_vb2, &(stream->queued_list), list) {
-			vb2_v4l2_buf = &(msm_vb2->vb2_v4l2_buf);
-			if (vb2_v4l2_buf == vb)
-				break;
-		}
-		if (vb2_v4l2_buf != vb) {
+		msm_vb2 = msm_vb2_find_queued(stream, vb);
+		if (!msm_vb2) {
 			pr_err("VB buffer is INVALID ses_id=%d, str_id=%d, vb=%pK\n",
 				    session_id, stream_id, vb);
 			spin_unlock_irqrestore(&stream->stream_lock, flags);
@@ -507,9 +495,7 @@ static int msm_vb2_buf_error(struct vb2_v4l2_buffer *vb, int session_id,
 				rl_flags);
 			return -EINVAL;
 		}
-		msm_vb2 =
-			container_of(vb2_v4l2_buf, struct msm_vb2_buffer,
-				vb2_v4l2_buf);
+		vb2_v4l2_buf = vb;
 		/* put buf before buf done */
 		if (msm_vb2->in_freeq) {
 			vb2_v4l2_buf->sequence = sequence;
@@ -561,12 +547,10 @@ long msm_vb2_return_buf_by_idx(int session_id, unsigned int stream_id,
 		goto end;
 	}
 
-	list_for_each_entry(msm_vb2, &(stream->queued_list), list) {
+	msm_vb2 = index < VB2_MAX_FRAME ? stream->queued_bufs[index] : NULL;
+	if (msm_vb2 && msm_vb2->vb2_v4l2_buf.vb2_buf.state ==
+		VB2_BUF_STATE_ACTIVE) {
 		vb2_v4l2_buf = &(msm_vb2->vb2_v4l2_buf);
-		if ((vb2_v4l2_buf->vb2_buf.index != index)
-			|| vb2_v4l2_buf->vb2_buf.state != VB2_BUF_STATE_ACTIVE)
-			continue;
-
 		if (!msm_vb2->in_freeq) {
 			vb2_buffer_done(&vb2_v4l2_buf->vb2_buf,
 				VB2_BUF_STATE_ERROR);
@@ -574,7 +558,6 @@ long msm_vb2_return_buf_by_idx(int session_id, unsigned int stream_id,
 		} else {
 			rc = -EINVAL;
 		}
-		break;
 	}
 
 end:
@@ -60,6 +60,8 @@ struct msm_stream {
 	struct vb2_queue *vb2_q;
 	spinlock_t stream_lock;
 	struct list_head queued_list;
+	/* buffers of queued_list by vb2 index, for the IRQ path lookups */
+	struct msm_vb2_buffer *queued_bufs[VB2_MAX_FRAME];
 };
 
 struct vb2_ops *msm_vb2_get_q_ops(void);
@@ -85,6 +85,7 @@ struct npu_ion_buf {
 	uint32_t size;
 	void *phys_addr;
 	void *buf;
+	bool cached;
 	struct list_head list;
 };
 
@@ -264,6 +265,8 @@ struct npu_client {
 	struct mutex list_lock;
 	struct list_head evt_list;
 	struct list_head mapped_buffer_list;
+	/* bumped on every unmap, invalidates verified patch tables */
+	uint32_t map_gen;
 };
 
 /* -------------------------------------------------------------------------
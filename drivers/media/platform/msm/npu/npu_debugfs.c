@@ -17,6 +17,7 @@
  * -------------------------------------------------------------------------
  */
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "npu_hw.h"
 #include "npu_hw_access.h"
@@ -46,6 +47,7 @@ static ssize_t npu_debug_log_read(struct file *file,
 		char __user *user_buf, size_t count, loff_t *ppos);
 static ssize_t npu_debug_ctrl_write(struct file *file,
 		const char __user *user_buf, size_t count, loff_t *ppos);
+static int npu_debug_exec_stats_open(struct inode *inode, struct file *file);
 
 /* -------------------------------------------------------------------------
  * Variables
@@ -80,6 +82,13 @@ static const struct file_operations npu_ctrl_fops = {
 	.write = npu_debug_ctrl_write,
 };
 
+static const struct file_operations npu_exec_stats_fops = {
+	.open = npu_debug_exec_stats_open,
+	.release = single_release,
+	.read = seq_read,
+	.llseek = seq_lseek,
+};
+
 /* -------------------------------------------------------------------------
  * Function Implementations
  * -------------------------------------------------------------------------
@@ -97,6 +106,17 @@ static int npu_debug_release(struct inode *inode, struct file *file)
 	return 0;
 }
 
+static int npu_debug_exec_stats_show(struct seq_file *s, void *unused)
+{
+	npu_host_exec_stats_show(s->private, s);
+	return 0;
+}
+
+static int npu_debug_exec_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, npu_debug_exec_stats_show, inode->i_private);
+}
+
 static int npu_debug_reg_open(struct inode *inode, struct file *file)
 {
 	struct npu_debugfs_reg_ctx *reg_ctx;
@@ -435,6 +455,18 @@ int npu_debugfs_init(struct npu_device *npu_dev)
 		goto err;
 	}
 
+	if (!debugfs_create_u32("max_exec_inflight", 0644,
+		debugfs->root, &(host_ctx->max_exec_inflight))) {
+		pr_err("debugfs_create_u32 fail for max_exec_inflight\n");
+		goto err;
+	}
+
+	if (!debugfs_create_file("exec_stats", 0444, debugfs->root,
+		npu_dev, &npu_exec_stats_fops)) {
+		pr_err("debugfs_create_file exec_stats fail\n");
+		goto err;
+	}
+
 	debugfs->log_num_bytes_buffered = 0;
 	debugfs->log_read_index = 0;
 	debugfs->log_write_index = 0;
@@ -1246,6 +1246,7 @@ static int npu_close(struct inode *inode, struct file *file)
 		kevent = list_first_entry(&client->evt_list,
 			struct npu_kevent, list);
 		list_del(&kevent->list);
+		kfree((void *)kevent->reserved[2]);
 		kfree(kevent);
 	}
 
@@ -1614,6 +1615,7 @@ static int npu_receive_event(struct npu_client *client,
 			pr_err("fail to copy to user\n");
 			ret = -EFAULT;
 		}
+		kfree((void *)kevt->reserved[2]);
 		kfree(kevt);
 	}
 	mutex_unlock(&client->list_lock);
@@ -20,6 +20,7 @@
 #include <soc/qcom/subsystem_restart.h>
 #include <linux/device.h>
 #include <linux/platform_device.h>
+#include <linux/ion.h>
 
 #include "npu_hw_access.h"
 #include "npu_common.h"
@@ -294,6 +295,7 @@ static void npu_free_npu_ion_buffer(struct npu_client
 		if (npu_ion_buf->fd == buf_hdl) {
 			list_del(&npu_ion_buf->list);
 			kfree(npu_ion_buf);
+			client->map_gen++;
 			break;
 		}
 	}
@@ -307,6 +309,7 @@ int npu_mem_map(struct npu_client *client, int buf_hdl, uint32_t size,
 	struct npu_device *npu_dev = client->npu_dev;
 	struct npu_ion_buf *ion_buf = NULL;
 	struct npu_smmu_ctx *smmu_ctx = &npu_dev->smmu_ctx;
+	unsigned long ion_flags = 0;
 
 	if (buf_hdl == 0)
 		return -EINVAL;
@@ -338,6 +341,17 @@ int npu_mem_map(struct npu_client *client, int buf_hdl, uint32_t size,
 
 	ion_buf->attachment->dma_map_attrs = DMA_ATTR_IOMMU_USE_UPSTREAM_HINT;
 
+	/*
+	 * Uncached buffers have nothing in the cpu caches, so skip the clean
+	 * over the whole buffer at map time and the invalidate later on.
+	 * Assume cached if the flags can't be read.
+	 */
+	if (dma_buf_get_flags(ion_buf->dma_buf, &ion_flags))
+		ion_flags = ION_FLAG_CACHED;
+	ion_buf->cached = !!(ion_flags & ION_FLAG_CACHED);
+	if (!ion_buf->cached)
+		ion_buf->attachment->dma_map_attrs |= DMA_ATTR_SKIP_CPU_SYNC;
+
 	ion_buf->table = dma_buf_map_attachment(ion_buf->attachment,
 			DMA_BIDIRECTIONAL);
 	if (IS_ERR(ion_buf->table)) {
@@ -350,8 +364,8 @@ int npu_mem_map(struct npu_client *client, int buf_hdl, uint32_t size,
 	ion_buf->iova = ion_buf->table->sgl->dma_address;
 	ion_buf->size = ion_buf->dma_buf->size;
 	*addr = ion_buf->iova;
-	pr_debug("mapped mem addr:0x%llx size:0x%x\n", ion_buf->iova,
-		ion_buf->size);
+	pr_debug("mapped mem addr:0x%llx size:0x%x cached:%d\n", ion_buf->iova,
+		ion_buf->size, ion_buf->cached);
 map_end:
 	if (ret)
 		npu_mem_unmap(client, buf_hdl, 0);
@@ -367,7 +381,7 @@ void npu_mem_invalidate(struct npu_client *client, int buf_hdl)
 
 	if (!ion_buf)
 		pr_err("%s cant find ion buf\n", __func__);
-	else
+	else if (ion_buf->cached)
 		dma_sync_sg_for_cpu(&(npu_dev->pdev->dev), ion_buf->table->sgl,
 			ion_buf->table->nents, DMA_BIDIRECTIONAL);
 }
@@ -54,6 +54,7 @@ static void free_network(struct npu_host_ctx *ctx, struct npu_client *client,
 	int64_t id);
 static int network_get(struct npu_network *network);
 static int network_put(struct npu_network *network);
+static void npu_free_exec_cmds(struct npu_network *network);
 static void app_msg_proc(struct npu_host_ctx *host_ctx, uint32_t *msg);
 static void log_msg_proc(struct npu_device *npu_dev, uint32_t *msg);
 static void host_session_msg_hdlr(struct npu_device *npu_dev);
@@ -61,6 +62,9 @@ static void host_session_log_hdlr(struct npu_device *npu_dev);
 static int host_error_hdlr(struct npu_device *npu_dev, bool force);
 static int npu_send_network_cmd(struct npu_device *npu_dev,
 	struct npu_network *network, void *cmd_ptr, bool async);
+static int npu_send_exec_cmd_async(struct npu_device *npu_dev,
+	struct npu_network *network, void *cmd_ptr, uint32_t stats_buf_size,
+	void __user *stats_buf_u);
 static int npu_send_misc_cmd(struct npu_device *npu_dev, uint32_t q_idx,
 	void *cmd_ptr);
 static int npu_queue_event(struct npu_client *client, struct npu_kevent *evt);
@@ -305,6 +309,7 @@ int npu_host_init(struct npu_device *npu_dev)
 	mutex_init(&host_ctx->lock);
 	atomic_set(&host_ctx->ipc_trans_id, 1);
 	host_ctx->npu_dev = npu_dev;
+	host_ctx->max_exec_inflight = NPU_MAX_EXEC_INFLIGHT;
 
 	host_ctx->wq = npu_create_wq(host_ctx, "npu_wq");
 	if (!host_ctx->wq)
@@ -373,6 +378,16 @@ static int host_error_hdlr(struct npu_device *npu_dev, bool force)
 	mutex_lock(&host_ctx->lock);
 	for (i = 0; i < MAX_LOADED_NETWORK; i++) {
 		network = &host_ctx->networks[i];
+		if (network->is_valid && network->exec_inflight &&
+			network->fw_error) {
+			pr_debug("%d async cmds in flight, queue ssr event\n",
+				network->exec_inflight);
+			npu_free_exec_cmds(network);
+			kevt.evt.type = MSM_NPU_EVENT_TYPE_SSR;
+			kevt.evt.u.ssr.network_hdl = network->network_hdl;
+			if (npu_queue_event(network->client, &kevt))
+				pr_err("queue npu event failed\n");
+		}
 		if (network->is_valid && network->cmd_pending &&
 			network->fw_error) {
 			if (network->cmd_async) {
@@ -611,6 +626,7 @@ static struct npu_network *alloc_network(struct npu_host_ctx *ctx,
 	memset(network, 0, sizeof(struct npu_network));
 	network->id = i + 1;
 	init_completion(&network->cmd_done);
+	INIT_LIST_HEAD(&network->exec_cmd_list);
 	network->is_valid = true;
 	network->client = client;
 	network->stats_buf = kzalloc(NPU_MAX_STATS_BUF_SIZE,
@@ -679,6 +695,122 @@ static struct npu_network *get_network_by_id(struct npu_host_ctx *ctx,
 	return network;
 }
 
+static struct npu_exec_cmd *npu_alloc_exec_cmd(uint32_t stats_buf_size)
+{
+	struct npu_exec_cmd *cmd = kzalloc(sizeof(*cmd), GFP_KERNEL);
+
+	if (!cmd)
+		return NULL;
+
+	INIT_LIST_HEAD(&cmd->list);
+	if (stats_buf_size) {
+		stats_buf_size = min_t(uint32_t, stats_buf_size,
+			NPU_MAX_STATS_BUF_SIZE);
+		cmd->stats_buf = kzalloc(stats_buf_size, GFP_KERNEL);
+		if (!cmd->stats_buf) {
+			kfree(cmd);
+			return NULL;
+		}
+		cmd->stats_buf_size = stats_buf_size;
+	}
+
+	return cmd;
+}
+
+static void npu_free_exec_cmd(struct npu_exec_cmd *cmd)
+{
+	kfree(cmd->stats_buf);
+	kfree(cmd);
+}
+
+static struct npu_exec_cmd *npu_dequeue_exec_cmd(struct npu_network *network,
+	uint32_t trans_id)
+{
+	struct npu_exec_cmd *cmd;
+
+	list_for_each_entry(cmd, &network->exec_cmd_list, list) {
+		if (cmd->trans_id == trans_id) {
+			list_del(&cmd->list);
+			network->exec_inflight--;
+			return cmd;
+		}
+	}
+
+	return NULL;
+}
+
+static void npu_exec_cmd_done(struct npu_network *network,
+	struct npu_exec_cmd *cmd)
+{
+	uint64_t lat_us = ktime_us_delta(ktime_get(), cmd->submit_time);
+
+	network->exec_done_cnt++;
+	network->exec_total_us += lat_us;
+	network->exec_last_us = lat_us;
+	if (lat_us > network->exec_max_us)
+		network->exec_max_us = lat_us;
+
+	pr_debug("network %lld trans_id %d done in %llu us, %d in flight\n",
+		network->id, cmd->trans_id, lat_us, network->exec_inflight);
+}
+
+static void npu_free_exec_cmds(struct npu_network *network)
+{
+	struct npu_exec_cmd *cmd, *tmp;
+
+	list_for_each_entry_safe(cmd, tmp, &network->exec_cmd_list, list) {
+		list_del(&cmd->list);
+		npu_free_exec_cmd(cmd);
+	}
+	network->exec_inflight = 0;
+}
+
+/*
+ * Streaming clients patch the same IO buffers into every execute. Once a
+ * patch table has been verified against the mapped buffers it is kept,
+ * and a later identical table skips the verification until the client
+ * unmaps something.
+ */
+static bool npu_patch_cache_valid(struct npu_client *client,
+	struct npu_network *network,
+	struct msm_npu_patch_buf_info *patch_buf_info, uint32_t num)
+{
+	int i;
+
+	if (!num || !network->patch_cache ||
+		(network->patch_cache_num != num) ||
+		(network->patch_cache_gen != READ_ONCE(client->map_gen)))
+		return false;
+
+	for (i = 0; i < num; i++) {
+		if ((network->patch_cache[i].buf_id !=
+			patch_buf_info[i].buf_id) ||
+			(network->patch_cache[i].buf_phys_addr !=
+			patch_buf_info[i].buf_phys_addr))
+			return false;
+	}
+
+	return true;
+}
+
+static void npu_patch_cache_update(struct npu_client *client,
+	struct npu_network *network,
+	struct msm_npu_patch_buf_info *patch_buf_info, uint32_t num)
+{
+	kfree(network->patch_cache);
+	network->patch_cache = NULL;
+	network->patch_cache_num = 0;
+	if (!num)
+		return;
+
+	network->patch_cache = kmemdup(patch_buf_info,
+		num * sizeof(*patch_buf_info), GFP_KERNEL);
+	if (network->patch_cache) {
+		network->patch_cache_num = num;
+		network->patch_cache_gen = READ_ONCE(client->map_gen);
+	}
+}
+
 static void free_network(struct npu_host_ctx *ctx, struct npu_client *client,
 	int64_t id)
 {
@@ -690,6 +822,8 @@ static void free_network(struct npu_host_ctx *ctx, struct npu_client *client,
 	if (network) {
 		network_put(network);
 		if (atomic_read(&network->ref_cnt) == 0) {
+			npu_free_exec_cmds(network);
+			kfree(network->patch_cache);
 			kfree(network->stats_buf);
 			memset(network, 0, sizeof(struct npu_network));
 			ctx->network_num--;
@@ -727,6 +861,7 @@ static void app_msg_proc(struct npu_host_ctx *host_ctx, uint32_t *msg)
 {
 	uint32_t msg_id;
 	struct npu_network *network = NULL;
+	struct npu_exec_cmd *cmd;
 	struct npu_kevent kevt;
 	struct npu_device *npu_dev = host_ctx->npu_dev;
 
@@ -758,6 +893,22 @@ static void app_msg_proc(struct npu_host_ctx *host_ctx, uint32_t *msg)
 			break;
 		}
 
+		cmd = npu_dequeue_exec_cmd(network,
+			exe_rsp_pkt->header.trans_id);
+		if (cmd) {
+			npu_exec_cmd_done(network, cmd);
+			kevt.evt.type = MSM_NPU_EVENT_TYPE_EXEC_DONE;
+			kevt.evt.u.exec_done.network_hdl =
+				exe_rsp_pkt->network_hdl;
+			kevt.evt.u.exec_done.exec_result =
+				exe_rsp_pkt->header.status;
+			if (npu_queue_event(network->client, &kevt))
+				pr_err("queue npu event failed\n");
+			npu_free_exec_cmd(cmd);
+			network_put(network);
+			break;
+		}
+
 		if (network->trans_id != exe_rsp_pkt->header.trans_id) {
 			pr_err("execute_pkt trans_id is not match %d:%d\n",
 				network->trans_id,
@@ -803,6 +954,36 @@ static void app_msg_proc(struct npu_host_ctx *host_ctx, uint32_t *msg)
 			break;
 		}
 
+		cmd = npu_dequeue_exec_cmd(network,
+			exe_rsp_pkt->header.trans_id);
+		if (cmd) {
+			npu_exec_cmd_done(network, cmd);
+			stats_size = exe_rsp_pkt->header.size -
+				sizeof(*exe_rsp_pkt);
+			stats_size = min(stats_size, cmd->stats_buf_size);
+			if (stats_size)
+				memcpy(cmd->stats_buf, exe_rsp_pkt->stats_data,
+					stats_size);
+
+			kevt.evt.type = MSM_NPU_EVENT_TYPE_EXEC_V2_DONE;
+			kevt.evt.u.exec_v2_done.network_hdl =
+				exe_rsp_pkt->network_hdl;
+			kevt.evt.u.exec_v2_done.exec_result =
+				exe_rsp_pkt->header.status;
+			kevt.evt.u.exec_v2_done.stats_buf_size = stats_size;
+			kevt.reserved[0] = (uint64_t)cmd->stats_buf;
+			kevt.reserved[1] = (uint64_t)cmd->stats_buf_u;
+			/* the event frees the stats buffer once delivered */
+			kevt.reserved[2] = (uint64_t)cmd->stats_buf;
+			if (npu_queue_event(network->client, &kevt))
+				pr_err("queue npu event failed\n");
+			else
+				cmd->stats_buf = NULL;
+			npu_free_exec_cmd(cmd);
+			network_put(network);
+			break;
+		}
+
 		if (network->trans_id != exe_rsp_pkt->header.trans_id) {
 			pr_err("execute_pkt_v2 trans_id is not match %d:%d\n",
 				network->trans_id,
@@ -1140,7 +1321,7 @@ static int npu_send_network_cmd(struct npu_device *npu_dev,
 		(host_ctx->fw_state == FW_DISABLED)) {
 		pr_err("fw is in error state or disabled, can't send network cmd\n");
 		ret = -EIO;
-	} else if (network->cmd_pending) {
+	} else if (network->cmd_pending || network->exec_inflight) {
 		pr_err("Another cmd is pending\n");
 		ret = -EBUSY;
 	} else {
@@ -1160,6 +1341,55 @@ static int npu_send_network_cmd(struct npu_device *npu_dev,
 	return ret;
 }
 
+/*
+ * Async executes don't hold the network, up to max_exec_inflight of them
+ * are queued to fw and matched to their completion by trans_id.
+ */
+static int npu_send_exec_cmd_async(struct npu_device *npu_dev,
+	struct npu_network *network, void *cmd_ptr, uint32_t stats_buf_size,
+	void __user *stats_buf_u)
+{
+	struct npu_host_ctx *host_ctx = &npu_dev->host_ctx;
+	uint32_t max_inflight = max_t(uint32_t, host_ctx->max_exec_inflight, 1);
+	struct npu_exec_cmd *cmd;
+	int ret;
+
+	if (network->fw_error || host_ctx->fw_error ||
+		(host_ctx->fw_state == FW_DISABLED)) {
+		pr_err("fw is in error state or disabled, can't send network cmd\n");
+		return -EIO;
+	} else if (network->cmd_pending) {
+		pr_err("Another cmd is pending\n");
+		return -EBUSY;
+	} else if (network->exec_inflight >= max_inflight) {
+		pr_debug("network %lld has %d cmds in flight\n",
+			network->id, network->exec_inflight);
+		return -EBUSY;
+	}
+
+	cmd = npu_alloc_exec_cmd(stats_buf_size);
+	if (!cmd)
+		return -ENOMEM;
+
+	cmd->stats_buf_u = stats_buf_u;
+	cmd->trans_id = ((struct ipc_cmd_header_pkt *)cmd_ptr)->trans_id;
+	cmd->submit_time = ktime_get();
+	pr_debug("Send async cmd %d network id %lld trans_id %d\n",
+		((struct ipc_cmd_header_pkt *)cmd_ptr)->cmd_type,
+		network->id, cmd->trans_id);
+
+	ret = npu_host_ipc_send_cmd(npu_dev, IPC_QUEUE_APPS_EXEC, cmd_ptr);
+	if (ret) {
+		npu_free_exec_cmd(cmd);
+		return ret;
+	}
+
+	list_add_tail(&cmd->list, &network->exec_cmd_list);
+	network->exec_inflight++;
+
+	return 0;
+}
+
 static int npu_send_misc_cmd(struct npu_device *npu_dev, uint32_t q_idx,
 	void *cmd_ptr)
 {
@@ -1841,20 +2071,25 @@ int32_t npu_host_exec_network(struct npu_client *client,
 	exec_packet.header.flags = 0xF;
 	exec_packet.network_hdl = network->network_hdl;
 
+	if (async_ioctl) {
+		ret = npu_send_exec_cmd_async(npu_dev, network, &exec_packet,
+			0, NULL);
+		if (ret)
+			pr_err("NPU_IPC_CMD_EXECUTE sent failed: %d\n", ret);
+		else
+			pr_debug("Async ioctl, return now\n");
+		goto exec_done;
+	}
+
 	/* Send it on the high priority queue */
 	reinit_completion(&network->cmd_done);
-	ret = npu_send_network_cmd(npu_dev, network, &exec_packet, async_ioctl);
+	ret = npu_send_network_cmd(npu_dev, network, &exec_packet, false);
 
 	if (ret) {
 		pr_err("NPU_IPC_CMD_EXECUTE sent failed: %d\n", ret);
 		goto exec_done;
 	}
 
-	if (async_ioctl) {
-		pr_debug("Async ioctl, return now\n");
-		goto exec_done;
-	}
-
 	mutex_unlock(&host_ctx->lock);
 
 	ret = wait_for_completion_interruptible_timeout(
@@ -1914,6 +2149,7 @@ int32_t npu_host_exec_network_v2(struct npu_client *client,
 	struct npu_host_ctx *host_ctx = &npu_dev->host_ctx;
 	uint32_t num_patch_params, pkt_size;
 	bool async_ioctl = !!exec_ioctl->async;
+	bool patch_verified;
 	int i;
 
 	mutex_lock(&host_ctx->lock);
@@ -1951,6 +2187,8 @@ int32_t npu_host_exec_network_v2(struct npu_client *client,
 		goto exec_v2_done;
 	}
 
+	patch_verified = npu_patch_cache_valid(client, network,
+		patch_buf_info, num_patch_params);
 	for (i = 0; i < num_patch_params; i++) {
 		exec_packet->patch_params[i].id = patch_buf_info[i].buf_id;
 		pr_debug("%d: patch_id: %x\n", i,
@@ -1961,7 +2199,7 @@ int32_t npu_host_exec_network_v2(struct npu_client *client,
 			exec_packet->patch_params[i].value);
 
 		/* verify mapped physical address */
-		if (!npu_mem_verify_addr(client,
+		if (!patch_verified && !npu_mem_verify_addr(client,
 			patch_buf_info[i].buf_phys_addr)) {
 			pr_err("Invalid patch value\n");
 			ret = -EINVAL;
@@ -1969,6 +2207,12 @@ int32_t npu_host_exec_network_v2(struct npu_client *client,
 		}
 	}
 
+	if (patch_verified)
+		network->patch_cache_hits++;
+	else
+		npu_patch_cache_update(client, network, patch_buf_info,
+			num_patch_params);
+
 	exec_packet->header.cmd_type = NPU_IPC_CMD_EXECUTE_V2;
 	exec_packet->header.size = pkt_size;
 	exec_packet->header.trans_id =
@@ -1978,26 +2222,32 @@ int32_t npu_host_exec_network_v2(struct npu_client *client,
 	exec_packet->network_hdl = network->network_hdl;
 	exec_packet->num_patch_params = num_patch_params;
 
-	network->stats_buf_u = (void __user *)exec_ioctl->stats_buf_addr;
-	network->stats_buf_size = exec_ioctl->stats_buf_size;
-
 	pr_debug("Execute_v2 flags %x stats_buf_size %d\n",
 		exec_packet->header.flags, exec_ioctl->stats_buf_size);
 
+	if (async_ioctl) {
+		ret = npu_send_exec_cmd_async(npu_dev, network, exec_packet,
+			exec_ioctl->stats_buf_size,
+			(void __user *)exec_ioctl->stats_buf_addr);
+		if (ret)
+			pr_err("NPU_IPC_CMD_EXECUTE_V2 sent failed: %d\n", ret);
+		else
+			pr_debug("Async ioctl, return now\n");
+		goto free_exec_packet;
+	}
+
+	network->stats_buf_u = (void __user *)exec_ioctl->stats_buf_addr;
+	network->stats_buf_size = exec_ioctl->stats_buf_size;
+
 	/* Send it on the high priority queue */
 	reinit_completion(&network->cmd_done);
-	ret = npu_send_network_cmd(npu_dev, network, exec_packet, async_ioctl);
+	ret = npu_send_network_cmd(npu_dev, network, exec_packet, false);
 
 	if (ret) {
 		pr_err("NPU_IPC_CMD_EXECUTE_V2 sent failed: %d\n", ret);
 		goto free_exec_packet;
 	}
 
-	if (async_ioctl) {
-		pr_debug("Async ioctl, return now\n");
-		goto free_exec_packet;
-	}
-
 	mutex_unlock(&host_ctx->lock);
 
 	ret = wait_for_completion_interruptible_timeout(
@@ -2103,6 +2353,33 @@ int32_t npu_host_loopback_test(struct npu_device *npu_dev)
 	return ret;
 }
 
+void npu_host_exec_stats_show(struct npu_device *npu_dev, struct seq_file *s)
+{
+	struct npu_host_ctx *host_ctx = &npu_dev->host_ctx;
+	struct npu_network *network;
+	uint64_t avg_us;
+	int i;
+
+	mutex_lock(&host_ctx->lock);
+	for (i = 0; i < MAX_LOADED_NETWORK; i++) {
+		network = &host_ctx->networks[i];
+		if (!network->is_valid)
+			continue;
+
+		avg_us = network->exec_done_cnt ?
+			div64_u64(network->exec_total_us,
+			network->exec_done_cnt) : 0;
+		seq_printf(s, "network %lld hdl %x: inflight %u done %llu\n",
+			network->id, network->network_hdl,
+			network->exec_inflight, network->exec_done_cnt);
+		seq_printf(s, "  latency us: avg %llu max %llu last %llu\n",
+			avg_us, network->exec_max_us, network->exec_last_us);
+		seq_printf(s, "  patch table reused %llu\n",
+			network->patch_cache_hits);
+	}
+	mutex_unlock(&host_ctx->lock);
+}
+
 void npu_host_cleanup_networks(struct npu_client *client)
 {
 	int i;
@@ -18,6 +18,8 @@
  * -------------------------------------------------------------------------
  */
 #include <linux/spinlock.h>
+#include <linux/ktime.h>
+#include <linux/seq_file.h>
 #include "npu_hw_access.h"
 #include "npu_common.h"
 
@@ -32,6 +34,8 @@
 #define FIRMWARE_VERSION 0x00001000
 #define MAX_LOADED_NETWORK 32
 #define NPU_IPC_BUF_LENGTH 512
+/* Default number of async executes a network can have in flight */
+#define NPU_MAX_EXEC_INFLIGHT 4
 
 #define FW_DBG_MODE_PAUSE        (1 << 0)
 #define FW_DBG_MODE_INC_TIMEOUT  (1 << 1)
@@ -41,6 +45,16 @@
  * Data Structures
  * -------------------------------------------------------------------------
  */
+/* An async execute sent to fw and not yet completed */
+struct npu_exec_cmd {
+	struct list_head list;
+	uint32_t trans_id;
+	ktime_t submit_time;
+	void *stats_buf;
+	void __user *stats_buf_u;
+	uint32_t stats_buf_size;
+};
+
 struct npu_network {
 	uint64_t id;
 	int buf_hdl;
@@ -65,6 +79,21 @@ struct npu_network {
 	int cmd_ret_status;
 	struct completion cmd_done;
 	struct npu_client *client;
+
+	/* async executes in flight, oldest first */
+	struct list_head exec_cmd_list;
+	uint32_t exec_inflight;
+	/* latency of completed async executes, in us */
+	uint64_t exec_done_cnt;
+	uint64_t exec_total_us;
+	uint64_t exec_max_us;
+	uint64_t exec_last_us;
+
+	/* last v2 patch table that passed address verification */
+	struct msm_npu_patch_buf_info *patch_cache;
+	uint32_t patch_cache_num;
+	uint32_t patch_cache_gen;
+	uint64_t patch_cache_hits;
 };
 
 enum fw_state {
@@ -94,6 +123,7 @@ struct npu_host_ctx {
 	uint32_t fw_dbg_mode;
 	uint32_t exec_flags_override;
 	uint32_t fw_unload_delay_ms;
+	uint32_t max_exec_inflight;
 	atomic_t ipc_trans_id;
 	atomic_t network_execute_cnt;
 	int cmd_ret_status;
@@ -149,5 +179,6 @@ int32_t npu_host_set_perf_mode(struct npu_client *client, uint32_t network_hdl,
 	uint32_t perf_mode);
 int32_t npu_host_get_perf_mode(struct npu_client *client, uint32_t network_hdl);
 void npu_dump_debug_timeout_stats(struct npu_device *npu_dev);
+void npu_host_exec_stats_show(struct npu_device *npu_dev, struct seq_file *s);
 
 #endif /* _NPU_MGR_H */
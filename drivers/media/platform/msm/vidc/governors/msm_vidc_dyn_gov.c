@@ -10,13 +10,16 @@
  * GNU General Public License for more details.
  */
 
+#include <linux/debugfs.h>
 #include <linux/module.h>
+#include <linux/spinlock.h>
 #include "governor.h"
 #include "fixedpoint.h"
 #include "msm_vidc_internal.h"
 #include "msm_vidc_debug.h"
 #include "vidc_hfi_api.h"
 #define COMPRESSION_RATIO_MAX 5
+#define VOTE_CACHE_SIZE 16
 
 static bool debug;
 module_param(debug, bool, 0644);
@@ -26,11 +29,33 @@ enum governor_mode {
 	GOVERNOR_LLCC,
 };
 
+/*
+ * The bandwidth of a session only depends on its vote data, which stays
+ * the same between the devfreq polls until the session is reconfigured.
+ * A changed configuration simply does not match any entry any more.
+ */
+struct vote_cache_entry {
+	struct vidc_bus_vote_data data;
+	unsigned long ab_kbps;
+	bool valid;
+};
+
+struct vote_cache {
+	spinlock_t lock;
+	struct vote_cache_entry entry[VOTE_CACHE_SIZE];
+	unsigned int next;
+	u64 hits;
+	u64 misses;
+};
+
 struct governor {
 	enum governor_mode mode;
 	struct devfreq_governor devfreq_gov;
+	struct vote_cache cache;
 };
 
+static struct dentry *vote_cache_debugfs;
+
 /*
  * Minimum dimensions that the governor is willing to calculate
  * bandwidth for.  This means that anything bandwidth(0, 0) ==
@@ -914,6 +939,44 @@ static unsigned long __calculate(struct vidc_bus_vote_data *d,
 }
 
 
+static unsigned long __calculate_cached(struct governor *gov,
+		struct vidc_bus_vote_data *d)
+{
+	struct vote_cache *cache = &gov->cache;
+	struct vote_cache_entry *e;
+	unsigned long ab_kbps;
+	int i;
+
+	/* the dumps come from the calculation itself */
+	if (debug)
+		return __calculate(d, gov->mode);
+
+	spin_lock(&cache->lock);
+	for (i = 0; i < VOTE_CACHE_SIZE; i++) {
+		e = &cache->entry[i];
+		if (e->valid && !memcmp(&e->data, d, sizeof(*d))) {
+			ab_kbps = e->ab_kbps;
+			cache->hits++;
+			spin_unlock(&cache->lock);
+			return ab_kbps;
+		}
+	}
+	cache->misses++;
+	spin_unlock(&cache->lock);
+
+	ab_kbps = __calculate(d, gov->mode);
+
+	spin_lock(&cache->lock);
+	e = &cache->entry[cache->next];
+	cache->next = (cache->next + 1) % VOTE_CACHE_SIZE;
+	e->data = *d;
+	e->ab_kbps = ab_kbps;
+	e->valid = true;
+	spin_unlock(&cache->lock);
+
+	return ab_kbps;
+}
+
 static int __get_target_freq(struct devfreq *dev, unsigned long *freq)
 {
 	unsigned long ab_kbps = 0, c = 0;
@@ -940,7 +1003,7 @@ static int __get_target_freq(struct devfreq *dev, unsigned long *freq)
 	}
 
 	for (c = 0; c < vidc_data->data_count; ++c)
-		ab_kbps += __calculate(&vidc_data->data[c], gov->mode);
+		ab_kbps += __calculate_cached(gov, &vidc_data->data[c]);
 
 exit:
 	*freq = clamp(ab_kbps, dev->min_freq, dev->max_freq ?: UINT_MAX);
@@ -989,11 +1052,22 @@ static struct governor governors[] = {
 static int __init msm_vidc_bw_gov_init(void)
 {
 	int c = 0, rc = 0;
+	struct dentry *dir;
+
+	vote_cache_debugfs = debugfs_create_dir("msm_vidc_bus_gov", NULL);
 
 	for (c = 0; c < ARRAY_SIZE(governors); ++c) {
 		dprintk(VIDC_DBG, "Adding governor %s\n",
 				governors[c].devfreq_gov.name);
 
+		spin_lock_init(&governors[c].cache.lock);
+		dir = debugfs_create_dir(governors[c].devfreq_gov.name,
+				vote_cache_debugfs);
+		debugfs_create_u64("cache_hits", 0444, dir,
+				&governors[c].cache.hits);
+		debugfs_create_u64("cache_misses", 0444, dir,
+				&governors[c].cache.misses);
+
 		rc = devfreq_add_governor(&governors[c].devfreq_gov);
 		if (rc) {
 			dprintk(VIDC_ERR, "Error adding governor %s: %d\n",
@@ -1015,6 +1089,7 @@ static void __exit msm_vidc_bw_gov_exit(void)
 				governors[c].devfreq_gov.name);
 		devfreq_remove_governor(&governors[c].devfreq_gov);
 	}
+	debugfs_remove_recursive(vote_cache_debugfs);
 }
 module_exit(msm_vidc_bw_gov_exit);
 MODULE_LICENSE("GPL v2");
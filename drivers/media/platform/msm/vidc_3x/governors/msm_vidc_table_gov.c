@@ -21,7 +21,7 @@
 #include "../msm_vidc_internal.h"
 #include "../venus_hfi.h"
 #include "../vidc_hfi_api.h"
-
+#include "msm_vidc_table_gov.h"
 
 enum bus_profile {
 	VIDC_BUS_PROFILE_NORMAL			= BIT(0),
@@ -44,6 +44,8 @@ struct msm_vidc_bus_table_gov {
 	struct devfreq_governor devfreq_gov;
 };
 
+static struct msm_vidc_bus_table_gov *table_gov;
+
 static int __get_bus_freq(struct msm_vidc_bus_table_gov *gov,
 		struct vidc_bus_vote_data *data,
 		enum bus_profile profile)
@@ -83,6 +85,46 @@ static int __get_bus_freq(struct msm_vidc_bus_table_gov *gov,
 	return freq;
 }
 
+static int __get_session_freq(struct msm_vidc_bus_table_gov *gov,
+		struct vidc_bus_vote_data *data, enum bus_profile *profile)
+{
+	int freq = 0;
+
+	*profile = VIDC_BUS_PROFILE_NORMAL;
+	if (data->color_formats[0] == HAL_COLOR_FORMAT_NV12_TP10_UBWC ||
+		data->color_formats[0] == HAL_COLOR_FORMAT_NV12_UBWC)
+		*profile = VIDC_BUS_PROFILE_UBWC;
+
+	freq = __get_bus_freq(gov, data, *profile);
+
+	/* chose frequency from normal profile
+	 * if specific profile frequency was not found.
+	 */
+	if (!freq)
+		freq = __get_bus_freq(gov, data, VIDC_BUS_PROFILE_NORMAL);
+
+	return freq;
+}
+
+/**
+ * msm_vidc_table_session_kbps: - DDR bandwidth of a single session, as
+ * the table governor would vote it.
+ *
+ * @data: bus vote data of the session
+ *
+ * Return: the bandwidth in KBps, 0 if the governor is not probed or the
+ * session has no entry in the bus tables.
+ */
+unsigned long msm_vidc_table_session_kbps(struct vidc_bus_vote_data *data)
+{
+	enum bus_profile profile = 0;
+
+	if (!table_gov || !data)
+		return 0;
+
+	return __get_session_freq(table_gov, data, &profile);
+}
+EXPORT_SYMBOL(msm_vidc_table_session_kbps);
 
 static int msm_vidc_table_get_target_freq(struct devfreq *dev,
 		unsigned long *frequency)
@@ -122,19 +164,7 @@ static int msm_vidc_table_get_target_freq(struct devfreq *dev,
 			goto exit;
 		}
 
-		profile = VIDC_BUS_PROFILE_NORMAL;
-		if (data->color_formats[0] == HAL_COLOR_FORMAT_NV12_TP10_UBWC ||
-			data->color_formats[0] == HAL_COLOR_FORMAT_NV12_UBWC)
-			profile = VIDC_BUS_PROFILE_UBWC;
-
-		freq = __get_bus_freq(gov, data, profile);
-
-		/* chose frequency from normal profile
-		 * if specific profile frequency was not found.
-		 */
-		if (!freq)
-			freq = __get_bus_freq(gov, data,
-				VIDC_BUS_PROFILE_NORMAL);
+		freq = __get_session_freq(gov, data, &profile);
 
 		*frequency += (unsigned long)freq;
 
@@ -321,6 +351,8 @@ static int msm_vidc_bus_table_probe(struct platform_device *pdev)
 	rc = devfreq_add_governor(&gov->devfreq_gov);
 	if (rc)
 		dprintk(VIDC_ERR, "%s: add governor failed\n", __func__);
+	else
+		table_gov = gov;
 
 	return rc;
 }
@@ -340,6 +372,7 @@ static int msm_vidc_bus_table_remove(struct platform_device *pdev)
 	if (rc)
 		dprintk(VIDC_WARN, "%s: free bus table failed\n", __func__);
 
+	table_gov = NULL;
 	rc = devfreq_remove_governor(&gov->devfreq_gov);
 
 	return rc;
@@ -0,0 +1,21 @@
+/*
+ * Copyright (c) 2018 The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __MSM_VIDC_TABLE_GOV_H__
+#define __MSM_VIDC_TABLE_GOV_H__
+
+struct vidc_bus_vote_data;
+
+unsigned long msm_vidc_table_session_kbps(struct vidc_bus_vote_data *data);
+
+#endif /* __MSM_VIDC_TABLE_GOV_H__ */
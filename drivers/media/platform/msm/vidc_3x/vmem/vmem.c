@@ -21,9 +21,11 @@
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/msm-bus.h>
+#include <linux/mutex.h>
 #include <linux/of.h>
 #include <linux/platform_device.h>
 #include <linux/regulator/consumer.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/workqueue.h>
 #include "vmem.h"
@@ -119,10 +121,24 @@ struct vmem {
 	} bus;
 	atomic_t alloc_count;
 	struct dentry *debugfs_root;
+	struct mutex client_lock;
+	struct list_head clients;
+	struct vmem_client *holder;
+	struct work_struct arbitrate_work;
+	unsigned int switches;
 };
 
 static struct vmem *vmem;
 
+/*
+ * A client only takes VMEM over from the current holder, at the same
+ * priority, when it saves this much more DDR bandwidth (in percent).  Keeps
+ * two similar sessions from handing VMEM back and forth.
+ */
+static unsigned int switch_margin = 25;
+module_param(switch_margin, uint, 0644);
+MODULE_PARM_DESC(switch_margin, "Extra DDR bandwidth (%) needed to take VMEM over");
+
 static inline u32 __readl(void * __iomem addr)
 {
 	u32 value = 0;
@@ -384,6 +400,203 @@ void vmem_free(phys_addr_t to_free)
 	__disable_interrupts(vmem);
 	__power_off(vmem);
 	atomic_dec(&vmem->alloc_count);
+
+	/* A client may be waiting for it */
+	schedule_work(&vmem->arbitrate_work);
+}
+
+static bool __client_better(struct vmem_client *a, struct vmem_client *b,
+		unsigned int margin)
+{
+	if (a->priority != b->priority)
+		return a->priority > b->priority;
+
+	return (u64)a->ddr_kbps * 100 > (u64)b->ddr_kbps * (100 + margin);
+}
+
+static void __client_drop(struct vmem *v, struct vmem_client *client)
+{
+	vmem_free(client->addr);
+	client->held_ms += jiffies_to_msecs(jiffies - client->held_since);
+	client->addr = 0;
+	client->releasing = false;
+	v->holder = NULL;
+}
+
+/*
+ * Hands VMEM to the best client.  A holder is never interrupted: it is
+ * asked to release VMEM and gives it up at its next frame boundary through
+ * vmem_client_yield(), which runs this again for the new owner.
+ */
+static void __arbitrate(struct work_struct *work)
+{
+	struct vmem *v = container_of(work, struct vmem, arbitrate_work);
+	struct vmem_client *c = NULL, *best = NULL;
+	struct vmem_client *grant = NULL, *release = NULL;
+	phys_addr_t addr = 0;
+
+	mutex_lock(&v->client_lock);
+	list_for_each_entry(c, &v->clients, list) {
+		if (!best || __client_better(c, best, 0))
+			best = c;
+	}
+
+	if (!best || best == v->holder)
+		goto unlock;
+
+	if (v->holder) {
+		if (!v->holder->releasing && v->holder->release &&
+			__client_better(best, v->holder, switch_margin)) {
+			release = v->holder;
+			release->releasing = true;
+			release->preemptions++;
+		}
+		goto unlock;
+	}
+
+	/* Still held by a plain vmem_allocate() user */
+	if (atomic_read(&v->alloc_count))
+		goto unlock;
+
+	if (vmem_allocate(resource_size(v->mem.resource), &addr))
+		goto unlock;
+
+	best->addr = addr;
+	best->held_since = jiffies;
+	best->grants++;
+	v->holder = best;
+	v->switches++;
+	grant = best;
+unlock:
+	mutex_unlock(&v->client_lock);
+
+	if (release)
+		release->release(release);
+	if (grant && grant->grant)
+		grant->grant(grant, addr);
+}
+
+/**
+ * vmem_client_register: - Adds a client competing for VMEM.  The client's
+ * grant callback runs once VMEM is handed to it, which may be right away.
+ *
+ * @client: the client, its name, priority, ddr_kbps and callbacks set
+ *
+ * Return: 0 on success, -ENOTSUPP if the platform doesn't support VMEM.
+ */
+int vmem_client_register(struct vmem_client *client)
+{
+	if (!vmem)
+		return -ENOTSUPP;
+	if (!client)
+		return -EINVAL;
+
+	client->addr = 0;
+	client->releasing = false;
+
+	mutex_lock(&vmem->client_lock);
+	list_add_tail(&client->list, &vmem->clients);
+	mutex_unlock(&vmem->client_lock);
+
+	schedule_work(&vmem->arbitrate_work);
+	return 0;
+}
+EXPORT_SYMBOL(vmem_client_register);
+
+/**
+ * vmem_client_unregister: - Removes a client, freeing VMEM if it holds it.
+ * The client must have stopped using VMEM; no callback runs after this.
+ *
+ * @client: a client added with vmem_client_register()
+ */
+void vmem_client_unregister(struct vmem_client *client)
+{
+	if (!vmem || !client)
+		return;
+
+	mutex_lock(&vmem->client_lock);
+	if (vmem->holder == client)
+		__client_drop(vmem, client);
+	list_del(&client->list);
+	mutex_unlock(&vmem->client_lock);
+
+	flush_work(&vmem->arbitrate_work);
+	schedule_work(&vmem->arbitrate_work);
+}
+EXPORT_SYMBOL(vmem_client_unregister);
+
+/**
+ * vmem_client_update: - Updates the DDR bandwidth a client saves by holding
+ * VMEM, e.g. after a resolution or frame rate change of its session.
+ *
+ * @client: a client added with vmem_client_register()
+ * @ddr_kbps: the new bandwidth, in KBps
+ */
+void vmem_client_update(struct vmem_client *client, unsigned long ddr_kbps)
+{
+	if (!vmem || !client)
+		return;
+
+	mutex_lock(&vmem->client_lock);
+	client->ddr_kbps = ddr_kbps;
+	mutex_unlock(&vmem->client_lock);
+
+	schedule_work(&vmem->arbitrate_work);
+}
+EXPORT_SYMBOL(vmem_client_update);
+
+/**
+ * vmem_client_yield: - Gives VMEM up, at a frame boundary of the client,
+ * after its release callback ran.  A no-op if the client doesn't hold VMEM.
+ *
+ * @client: a client added with vmem_client_register()
+ */
+void vmem_client_yield(struct vmem_client *client)
+{
+	if (!vmem || !client)
+		return;
+
+	mutex_lock(&vmem->client_lock);
+	if (vmem->holder == client)
+		__client_drop(vmem, client);
+	mutex_unlock(&vmem->client_lock);
+
+	schedule_work(&vmem->arbitrate_work);
+}
+EXPORT_SYMBOL(vmem_client_yield);
+
+void vmem_dump_clients(struct seq_file *s)
+{
+	struct vmem_client *c = NULL, *holder = NULL;
+	unsigned long saved = 0, missed = 0;
+	u64 held_ms = 0;
+
+	if (!vmem)
+		return;
+
+	seq_printf(s, "%-16s %8s %10s %6s %7s %8s %10s\n", "client", "priority",
+			"ddr_kbps", "grants", "preempt", "holding", "held_ms");
+
+	mutex_lock(&vmem->client_lock);
+	holder = vmem->holder;
+	list_for_each_entry(c, &vmem->clients, list) {
+		held_ms = c->held_ms;
+		if (c == holder) {
+			held_ms += jiffies_to_msecs(jiffies - c->held_since);
+			saved = c->ddr_kbps;
+		} else {
+			missed += c->ddr_kbps;
+		}
+
+		seq_printf(s, "%-16s %8u %10lu %6u %7u %8s %10llu\n", c->name,
+				c->priority, c->ddr_kbps, c->grants,
+				c->preemptions, c == holder ? "yes" : "no",
+				held_ms);
+	}
+
+	seq_printf(s, "switches %u, ddr saved %lu KBps, ddr not served %lu KBps\n",
+			vmem->switches, saved, missed);
+	mutex_unlock(&vmem->client_lock);
 }
 
 struct vmem_interrupt_cookie {
@@ -642,6 +855,10 @@ static int vmem_probe(struct platform_device *pdev)
 
 	__disable_interrupts(v);
 
+	mutex_init(&v->client_lock);
+	INIT_LIST_HEAD(&v->clients);
+	INIT_WORK(&v->arbitrate_work, __arbitrate);
+
 	/* Everything good so far, set up the global context and debug hooks */
 	pr_info("Up and running with %d banks of memory from %pR\n",
 			v->num_banks, &v->mem.resource);
@@ -660,7 +877,9 @@ static int vmem_remove(struct platform_device *pdev)
 	struct vmem *v = platform_get_drvdata(pdev);
 
 	WARN_ON(v != vmem);
+	WARN_ON(!list_empty(&v->clients));
 
+	cancel_work_sync(&v->arbitrate_work);
 	__uninit_resources(v, pdev);
 	vmem_debugfs_deinit(v->debugfs_root);
 	vmem = NULL;
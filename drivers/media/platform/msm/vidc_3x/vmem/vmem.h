@@ -14,11 +14,50 @@
 #ifndef __VMEM_H__
 #define __VMEM_H__
 
+#include <linux/list.h>
+#include <linux/types.h>
+
+/**
+ * struct vmem_client: - A session competing for VMEM.
+ *
+ * VMEM goes to the registered client with the highest @priority and, among
+ * those, the one whose @ddr_kbps (the DDR bandwidth VMEM takes off the bus
+ * while it holds it, usually msm_vidc_table_session_kbps()) is the largest.
+ * Neither callback may call back into the vmem_client_* API directly.
+ *
+ * @name: shown in debugfs
+ * @priority: higher wins, regardless of bandwidth
+ * @ddr_kbps: DDR bandwidth saved by holding VMEM, see vmem_client_update()
+ * @grant: VMEM at @addr now belongs to the client
+ * @release: the client should stop using VMEM at its next frame boundary
+ * and then call vmem_client_yield()
+ */
+struct vmem_client {
+	const char *name;
+	unsigned int priority;
+	unsigned long ddr_kbps;
+	void (*grant)(struct vmem_client *client, phys_addr_t addr);
+	void (*release)(struct vmem_client *client);
+
+	/* Private to vmem */
+	struct list_head list;
+	phys_addr_t addr;
+	bool releasing;
+	unsigned long held_since;
+	u64 held_ms;
+	unsigned int grants, preemptions;
+};
+
 #ifdef CONFIG_MSM_VIDC_VMEM
 
 int vmem_allocate(size_t size, phys_addr_t *addr);
 void vmem_free(phys_addr_t to_free);
 
+int vmem_client_register(struct vmem_client *client);
+void vmem_client_unregister(struct vmem_client *client);
+void vmem_client_update(struct vmem_client *client, unsigned long ddr_kbps);
+void vmem_client_yield(struct vmem_client *client);
+
 #else
 
 static inline int vmem_allocate(size_t size, phys_addr_t *addr)
@@ -30,6 +69,24 @@ static inline void vmem_free(phys_addr_t to_free)
 {
 }
 
+static inline int vmem_client_register(struct vmem_client *client)
+{
+	return -ENODEV;
+}
+
+static inline void vmem_client_unregister(struct vmem_client *client)
+{
+}
+
+static inline void vmem_client_update(struct vmem_client *client,
+		unsigned long ddr_kbps)
+{
+}
+
+static inline void vmem_client_yield(struct vmem_client *client)
+{
+}
+
 #endif
 
 #endif /* __VMEM_H__ */
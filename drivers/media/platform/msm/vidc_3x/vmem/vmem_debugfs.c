@@ -14,7 +14,9 @@
 #include <linux/debugfs.h>
 #include <linux/fs.h>
 #include <linux/platform_device.h>
+#include <linux/seq_file.h>
 #include "vmem.h"
+#include "vmem_debugfs.h"
 
 struct vmem_debugfs_cookie {
 	phys_addr_t addr;
@@ -51,6 +53,24 @@ static int __vmem_alloc_set(void *priv, u64 val)
 DEFINE_SIMPLE_ATTRIBUTE(fops_vmem_alloc, __vmem_alloc_get,
 		__vmem_alloc_set, "%llu");
 
+static int __vmem_clients_show(struct seq_file *s, void *unused)
+{
+	vmem_dump_clients(s);
+	return 0;
+}
+
+static int __vmem_clients_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, __vmem_clients_show, inode->i_private);
+}
+
+static const struct file_operations fops_vmem_clients = {
+	.open = __vmem_clients_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 struct dentry *vmem_debugfs_init(struct platform_device *pdev)
 {
 	struct vmem_debugfs_cookie *alloc_cookie = NULL;
@@ -70,6 +90,8 @@ struct dentry *vmem_debugfs_init(struct platform_device *pdev)
 
 	debugfs_create_file("alloc", 0600, debugfs_root,
 			alloc_cookie, &fops_vmem_alloc);
+	debugfs_create_file("clients", 0400, debugfs_root,
+			NULL, &fops_vmem_clients);
 
 exit:
 	return debugfs_root;
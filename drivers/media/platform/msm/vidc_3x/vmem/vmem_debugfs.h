@@ -15,8 +15,10 @@
 #define __VMEM_DEBUGFS_H__
 
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 struct dentry *vmem_debugfs_init(struct platform_device *pdev);
 void vmem_debugfs_deinit(struct dentry *debugfs_root);
+void vmem_dump_clients(struct seq_file *s);
 
 #endif /* __VMEM_DEBUGFS_H__ */
@@ -22,13 +22,18 @@
 #include <linux/kernel.h>
 #include <linux/list.h>
 #include <linux/mm.h>
+#include <linux/percpu.h>
 #include <linux/proc_fs.h>
 #include <linux/profile.h>
+#include <linux/rculist.h>
 #include <linux/rtmutex.h>
 #include <linux/sched/cputime.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
+#include <linux/u64_stats_sync.h>
 #include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <uapi/linux/uid_sys_stats.h>
 
 
 #define UID_HASH_BITS	10
@@ -65,15 +70,28 @@ struct task_entry {
 	struct hlist_node hash;
 };
 
-struct uid_entry {
-	uid_t uid;
+/*
+ * What the exited tasks of a uid left, added on the cpu they exited on
+ * without uid_lock and summed up by the readers
+ */
+struct uid_dead_stats {
 	u64 utime;
 	u64 stime;
+	struct io_stats io;
+	struct u64_stats_sync syncp;
+};
+
+struct uid_entry {
+	uid_t uid;
 	u64 active_utime;
 	u64 active_stime;
 	int state;
 	struct io_stats io[UID_STATE_SIZE];
+	/* dead task io already folded into io[UID_STATE_DEAD_TASKS] */
+	struct io_stats dead_io_folded;
+	struct uid_dead_stats __percpu *dead;
 	struct hlist_node hash;
+	struct rcu_head rcu;
 #ifdef CONFIG_UID_SYS_STATS_DEBUG
 	DECLARE_HASHTABLE(task_entries, UID_HASH_BITS);
 #endif
@@ -120,6 +138,75 @@ static void compute_io_bucket_stats(struct io_stats *io_bucket,
 	memset(io_dead, 0, sizeof(struct io_stats));
 }
 
+static void add_io_stats(struct io_stats *dst, struct io_stats *src)
+{
+	dst->read_bytes += src->read_bytes;
+	dst->write_bytes += src->write_bytes;
+	dst->rchar += src->rchar;
+	dst->wchar += src->wchar;
+	dst->fsync += src->fsync;
+}
+
+static void sum_uid_dead_stats(struct uid_entry *uid_entry,
+		struct uid_dead_stats *sum)
+{
+	struct uid_dead_stats *dead, tmp;
+	unsigned int start;
+	int cpu;
+
+	memset(sum, 0, sizeof(*sum));
+	for_each_possible_cpu(cpu) {
+		dead = per_cpu_ptr(uid_entry->dead, cpu);
+		do {
+			start = u64_stats_fetch_begin(&dead->syncp);
+			tmp.utime = dead->utime;
+			tmp.stime = dead->stime;
+			tmp.io = dead->io;
+		} while (u64_stats_fetch_retry(&dead->syncp, start));
+
+		sum->utime += tmp.utime;
+		sum->stime += tmp.stime;
+		add_io_stats(&sum->io, &tmp.io);
+	}
+}
+
+/* Called from the exit notifier, under rcu_read_lock() or uid_lock */
+static void add_uid_dead_stats(struct uid_entry *uid_entry,
+		struct task_struct *task)
+{
+	struct uid_dead_stats *dead;
+	u64 utime, stime;
+
+	task_cputime_adjusted(task, &utime, &stime);
+
+	dead = get_cpu_ptr(uid_entry->dead);
+	u64_stats_update_begin(&dead->syncp);
+	dead->utime += utime;
+	dead->stime += stime;
+	dead->io.read_bytes += task->ioac.read_bytes;
+	dead->io.write_bytes += compute_write_bytes(task);
+	dead->io.rchar += task->ioac.rchar;
+	dead->io.wchar += task->ioac.wchar;
+	dead->io.fsync += task->ioac.syscfs;
+	u64_stats_update_end(&dead->syncp);
+	put_cpu_ptr(uid_entry->dead);
+}
+
+/* Move the io of the tasks exited since the last call to the dead slot */
+static void fold_uid_dead_io(struct uid_entry *uid_entry,
+		struct uid_dead_stats *sum)
+{
+	struct io_stats *io_dead = &uid_entry->io[UID_STATE_DEAD_TASKS];
+	struct io_stats *folded = &uid_entry->dead_io_folded;
+
+	io_dead->read_bytes += sum->io.read_bytes - folded->read_bytes;
+	io_dead->write_bytes += sum->io.write_bytes - folded->write_bytes;
+	io_dead->rchar += sum->io.rchar - folded->rchar;
+	io_dead->wchar += sum->io.wchar - folded->wchar;
+	io_dead->fsync += sum->io.fsync - folded->fsync;
+	*folded = sum->io;
+}
+
 #ifdef CONFIG_UID_SYS_STATS_DEBUG
 static void get_full_task_comm(struct task_entry *task_entry,
 		struct task_struct *task)
@@ -299,10 +386,11 @@ static void show_io_uid_tasks(struct seq_file *m,
 		struct uid_entry *uid_entry) {}
 #endif
 
+/* Called under uid_lock or rcu_read_lock() */
 static struct uid_entry *find_uid_entry(uid_t uid)
 {
 	struct uid_entry *uid_entry;
-	hash_for_each_possible(hash_table, uid_entry, hash, uid) {
+	hash_for_each_possible_rcu(hash_table, uid_entry, hash, uid) {
 		if (uid_entry->uid == uid)
 			return uid_entry;
 	}
@@ -312,6 +400,7 @@ static struct uid_entry *find_uid_entry(uid_t uid)
 static struct uid_entry *find_or_register_uid(uid_t uid)
 {
 	struct uid_entry *uid_entry;
+	int cpu;
 
 	uid_entry = find_uid_entry(uid);
 	if (uid_entry)
@@ -321,20 +410,37 @@ static struct uid_entry *find_or_register_uid(uid_t uid)
 	if (!uid_entry)
 		return NULL;
 
+	uid_entry->dead = alloc_percpu_gfp(struct uid_dead_stats, GFP_ATOMIC);
+	if (!uid_entry->dead) {
+		kfree(uid_entry);
+		return NULL;
+	}
+	for_each_possible_cpu(cpu)
+		u64_stats_init(&per_cpu_ptr(uid_entry->dead, cpu)->syncp);
+
 	uid_entry->uid = uid;
 #ifdef CONFIG_UID_SYS_STATS_DEBUG
 	hash_init(uid_entry->task_entries);
 #endif
-	hash_add(hash_table, &uid_entry->hash, uid);
+	hash_add_rcu(hash_table, &uid_entry->hash, uid);
 
 	return uid_entry;
 }
 
+static void free_uid_entry_rcu(struct rcu_head *rcu)
+{
+	struct uid_entry *uid_entry = container_of(rcu, struct uid_entry, rcu);
+
+	free_percpu(uid_entry->dead);
+	kfree(uid_entry);
+}
+
 static int uid_cputime_show(struct seq_file *m, void *v)
 {
 	struct uid_entry *uid_entry = NULL;
 	struct task_struct *task, *temp;
 	struct user_namespace *user_ns = current_user_ns();
+	struct uid_dead_stats dead;
 	u64 utime;
 	u64 stime;
 	unsigned long bkt;
@@ -369,10 +475,11 @@ static int uid_cputime_show(struct seq_file *m, void *v)
 	rcu_read_unlock();
 
 	hash_for_each(hash_table, bkt, uid_entry, hash) {
-		u64 total_utime = uid_entry->utime +
-							uid_entry->active_utime;
-		u64 total_stime = uid_entry->stime +
-							uid_entry->active_stime;
+		u64 total_utime, total_stime;
+
+		sum_uid_dead_stats(uid_entry, &dead);
+		total_utime = dead.utime + uid_entry->active_utime;
+		total_stime = dead.stime + uid_entry->active_stime;
 		seq_printf(m, "%d: %llu %llu\n", uid_entry->uid,
 //2019.11.27 longcheer xiaoxiongfeng edit for "cpu statiscs time"
                            ktime_to_us(total_utime), ktime_to_us(total_stime));
@@ -436,8 +543,8 @@ static ssize_t uid_remove_write(struct file *file,
 							hash, (uid_t)uid_start) {
 			if (uid_start == uid_entry->uid) {
 				remove_uid_tasks(uid_entry);
-				hash_del(&uid_entry->hash);
-				kfree(uid_entry);
+				hash_del_rcu(&uid_entry->hash);
+				call_rcu(&uid_entry->rcu, free_uid_entry_rcu);
 			}
 		}
 	}
@@ -459,7 +566,7 @@ static void add_uid_io_stats(struct uid_entry *uid_entry,
 	struct io_stats *io_slot = &uid_entry->io[slot];
 
 	/* avoid double accounting of dying threads */
-	if (slot != UID_STATE_DEAD_TASKS && (task->flags & PF_EXITING))
+	if (task->flags & PF_EXITING)
 		return;
 
 	io_slot->read_bytes += task->ioac.read_bytes;
@@ -471,11 +578,26 @@ static void add_uid_io_stats(struct uid_entry *uid_entry,
 	add_uid_tasks_io_stats(uid_entry, task, slot);
 }
 
-static void update_io_stats_all_locked(void)
+static void compute_uid_io_stats(struct uid_entry *uid_entry)
+{
+	struct uid_dead_stats dead;
+
+	sum_uid_dead_stats(uid_entry, &dead);
+	fold_uid_dead_io(uid_entry, &dead);
+	compute_io_bucket_stats(&uid_entry->io[uid_entry->state],
+				&uid_entry->io[UID_STATE_TOTAL_CURR],
+				&uid_entry->io[UID_STATE_TOTAL_LAST],
+				&uid_entry->io[UID_STATE_DEAD_TASKS]);
+	compute_io_uid_tasks(uid_entry);
+}
+
+/* Walk the tasks once for their io and, if @cputime, their cpu time */
+static void update_stats_all_locked(bool cputime)
 {
 	struct uid_entry *uid_entry = NULL;
 	struct task_struct *task, *temp;
 	struct user_namespace *user_ns = current_user_ns();
+	u64 utime, stime;
 	unsigned long bkt;
 	uid_t uid;
 
@@ -483,6 +605,8 @@ static void update_io_stats_all_locked(void)
 		memset(&uid_entry->io[UID_STATE_TOTAL_CURR], 0,
 			sizeof(struct io_stats));
 		set_io_uid_tasks_zero(uid_entry);
+		uid_entry->active_stime = 0;
+		uid_entry->active_utime = 0;
 	}
 
 	rcu_read_lock();
@@ -493,16 +617,16 @@ static void update_io_stats_all_locked(void)
 		if (!uid_entry)
 			continue;
 		add_uid_io_stats(uid_entry, task, UID_STATE_TOTAL_CURR);
+		if (cputime && !(task->flags & PF_EXITING)) {
+			task_cputime_adjusted(task, &utime, &stime);
+			uid_entry->active_utime += utime;
+			uid_entry->active_stime += stime;
+		}
 	} while_each_thread(temp, task);
 	rcu_read_unlock();
 
-	hash_for_each(hash_table, bkt, uid_entry, hash) {
-		compute_io_bucket_stats(&uid_entry->io[uid_entry->state],
-					&uid_entry->io[UID_STATE_TOTAL_CURR],
-					&uid_entry->io[UID_STATE_TOTAL_LAST],
-					&uid_entry->io[UID_STATE_DEAD_TASKS]);
-		compute_io_uid_tasks(uid_entry);
-	}
+	hash_for_each(hash_table, bkt, uid_entry, hash)
+		compute_uid_io_stats(uid_entry);
 }
 
 static void update_io_stats_uid_locked(struct uid_entry *uid_entry)
@@ -522,11 +646,7 @@ static void update_io_stats_uid_locked(struct uid_entry *uid_entry)
 	} while_each_thread(temp, task);
 	rcu_read_unlock();
 
-	compute_io_bucket_stats(&uid_entry->io[uid_entry->state],
-				&uid_entry->io[UID_STATE_TOTAL_CURR],
-				&uid_entry->io[UID_STATE_TOTAL_LAST],
-				&uid_entry->io[UID_STATE_DEAD_TASKS]);
-	compute_io_uid_tasks(uid_entry);
+	compute_uid_io_stats(uid_entry);
 }
 
 
@@ -537,7 +657,7 @@ static int uid_io_show(struct seq_file *m, void *v)
 
 	rt_mutex_lock(&uid_lock);
 
-	update_io_stats_all_locked();
+	update_stats_all_locked(false);
 
 	hash_for_each(hash_table, bkt, uid_entry, hash) {
 		seq_printf(m, "%d %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu\n",
@@ -572,6 +692,88 @@ static const struct file_operations uid_io_fops = {
 	.release	= single_release,
 };
 
+static void fill_uid_stats_io(struct uid_stats_io *dst, struct io_stats *src)
+{
+	dst->rchar = src->rchar;
+	dst->wchar = src->wchar;
+	dst->read_bytes = src->read_bytes;
+	dst->write_bytes = src->write_bytes;
+	dst->fsync = src->fsync;
+}
+
+/*
+ * /proc/uid_stats: the counters of show_uid_stat and uid_io/stats for all
+ * uids in a single binary read, from a single walk of the tasks
+ */
+static int uid_stats_open(struct inode *inode, struct file *file)
+{
+	struct uid_stats_header *hdr;
+	struct uid_stats_record *rec;
+	struct uid_entry *uid_entry;
+	struct uid_dead_stats dead;
+	unsigned long bkt;
+	u32 nr = 0;
+
+	rt_mutex_lock(&uid_lock);
+
+	update_stats_all_locked(true);
+
+	hash_for_each(hash_table, bkt, uid_entry, hash)
+		nr++;
+
+	hdr = vzalloc(sizeof(*hdr) + nr * sizeof(*rec));
+	if (!hdr) {
+		rt_mutex_unlock(&uid_lock);
+		return -ENOMEM;
+	}
+	hdr->version = UID_STATS_VERSION;
+	hdr->record_size = sizeof(*rec);
+	hdr->nr_records = nr;
+
+	rec = (struct uid_stats_record *)(hdr + 1);
+	hash_for_each(hash_table, bkt, uid_entry, hash) {
+		sum_uid_dead_stats(uid_entry, &dead);
+		rec->uid = uid_entry->uid;
+		rec->state = uid_entry->state;
+		rec->utime_us = ktime_to_us(dead.utime +
+					    uid_entry->active_utime);
+		rec->stime_us = ktime_to_us(dead.stime +
+					    uid_entry->active_stime);
+		fill_uid_stats_io(&rec->io[UID_STATE_FOREGROUND],
+				  &uid_entry->io[UID_STATE_FOREGROUND]);
+		fill_uid_stats_io(&rec->io[UID_STATE_BACKGROUND],
+				  &uid_entry->io[UID_STATE_BACKGROUND]);
+		rec++;
+	}
+
+	rt_mutex_unlock(&uid_lock);
+
+	file->private_data = hdr;
+	return 0;
+}
+
+static ssize_t uid_stats_read(struct file *file, char __user *buf,
+			size_t count, loff_t *ppos)
+{
+	struct uid_stats_header *hdr = file->private_data;
+
+	return simple_read_from_buffer(buf, count, ppos, hdr, sizeof(*hdr) +
+				       hdr->nr_records * hdr->record_size);
+}
+
+static int uid_stats_release(struct inode *inode, struct file *file)
+{
+	vfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations uid_stats_fops = {
+	.open		= uid_stats_open,
+	.read		= uid_stats_read,
+	.llseek		= default_llseek,
+	.release	= uid_stats_release,
+};
+
 static int uid_procstat_open(struct inode *inode, struct file *file)
 {
 	return single_open(file, NULL, NULL);
@@ -633,25 +835,37 @@ static int process_notifier(struct notifier_block *self,
 {
 	struct task_struct *task = v;
 	struct uid_entry *uid_entry;
-	u64 utime, stime;
 	uid_t uid;
 
 	if (!task)
 		return NOTIFY_OK;
 
-	rt_mutex_lock(&uid_lock);
 	uid = from_kuid_munged(current_user_ns(), task_uid(task));
+
+	/*
+	 * Known uids are accounted per cpu without uid_lock, which the
+	 * readers hold for a whole walk of the tasks. The per task entries
+	 * of CONFIG_UID_SYS_STATS_DEBUG still need it.
+	 */
+	if (!IS_ENABLED(CONFIG_UID_SYS_STATS_DEBUG)) {
+		rcu_read_lock();
+		uid_entry = find_uid_entry(uid);
+		if (uid_entry)
+			add_uid_dead_stats(uid_entry, task);
+		rcu_read_unlock();
+		if (uid_entry)
+			return NOTIFY_OK;
+	}
+
+	rt_mutex_lock(&uid_lock);
 	uid_entry = find_or_register_uid(uid);
 	if (!uid_entry) {
 		pr_err("%s: failed to find uid %d\n", __func__, uid);
 		goto exit;
 	}
 
-	task_cputime_adjusted(task, &utime, &stime);
-	uid_entry->utime += utime;
-	uid_entry->stime += stime;
-
-	add_uid_io_stats(uid_entry, task, UID_STATE_DEAD_TASKS);
+	add_uid_dead_stats(uid_entry, task);
+	add_uid_tasks_io_stats(uid_entry, task, UID_STATE_DEAD_TASKS);
 
 exit:
 	rt_mutex_unlock(&uid_lock);
@@ -698,6 +912,8 @@ static int __init proc_uid_sys_stats_init(void)
 	proc_create_data("set", 0222, proc_parent,
 		&uid_procstat_fops, NULL);
 
+	proc_create("uid_stats", 0444, NULL, &uid_stats_fops);
+
 	profile_event_register(PROFILE_TASK_EXIT, &process_notifier_block);
 
 	return 0;
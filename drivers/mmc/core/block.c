@@ -2639,6 +2639,22 @@ static struct mmc_cmdq_req *mmc_blk_cmdq_rw_prep(
 	return &mqrq->cmdq_req;
 }
 
+/*
+ * Sync writes and flushes are what fsync() waits for, a deep queue is
+ * what a burst leaves behind: both ask the clock scaling for a boost.
+ */
+static void mmc_blk_clk_scaling_boost(struct mmc_queue *mq,
+				      struct request *req)
+{
+	struct request_queue *q = mq->queue;
+	bool sync = req_op(req) == REQ_OP_FLUSH ||
+		(req->cmd_flags & (REQ_SYNC | REQ_FUA | REQ_PREFLUSH));
+
+	mmc_clk_scaling_boost(mq->card->host, sync,
+			      READ_ONCE(q->nr_rqs[BLK_RW_SYNC]) +
+			      READ_ONCE(q->nr_rqs[BLK_RW_ASYNC]));
+}
+
 static void mmc_blk_cmdq_requeue_rw_rq(struct mmc_queue *mq,
 				struct request *req)
 {
@@ -2674,6 +2690,7 @@ static int mmc_blk_cmdq_issue_rw_rq(struct mmc_queue *mq, struct request *req)
 	active_mqrq = req_to_mmc_queue_req(req);
 
 	mc_rq = mmc_blk_cmdq_rw_prep(active_mqrq, mq);
+	mc_rq->mrq.io_start = ktime_get();
 
 	if (card->quirks & MMC_QUIRK_CMDQ_EMPTY_BEFORE_DCMD) {
 		unsigned int sectors = blk_rq_sectors(req);
@@ -2699,6 +2716,7 @@ static int mmc_blk_cmdq_issue_rw_rq(struct mmc_queue *mq, struct request *req)
 
 	if (!ret && (host->clk_scaling.state == MMC_LOAD_LOW)) {
 
+		mmc_cmdq_commit(host);
 		mmc_cmdq_up_rwsem(host);
 		ret = wait_event_interruptible_timeout(ctx->queue_empty_wq,
 			(!ctx->active_reqs &&
@@ -3146,8 +3164,11 @@ void mmc_blk_cmdq_complete_rq(struct request *rq)
 	else
 		BUG_ON(!test_and_clear_bit(cmdq_req->tag,
 					 &ctx_info->data_active_reqs));
-	if (!is_dcmd)
+	if (!is_dcmd) {
 		mmc_cmdq_post_req(host, cmdq_req->tag, err);
+		if (!err)
+			mmc_clk_scaling_account_req(host, mrq->io_start);
+	}
 	if (cmdq_req->cmdq_req_flags & DCMD) {
 		clear_bit(CMDQ_STATE_DCMD_ACTIVE, &ctx_info->curr_state);
 		blk_end_request_all(rq, blk_err);
@@ -3498,6 +3519,7 @@ static int  mmc_cmdq_wait_for_small_sector_read(struct mmc_card *card,
 
 	if ((card->quirks & MMC_QUIRK_CMDQ_EMPTY_BEFORE_DCMD) &&
 		ctx->active_small_sector_read_reqs) {
+		mmc_cmdq_commit(host);
 		mmc_cmdq_up_rwsem(host);
 		ret = wait_event_interruptible(ctx->queue_empty_wq,
 					      !ctx->active_reqs);
@@ -3591,6 +3613,7 @@ static int mmc_blk_cmdq_issue_rq(struct mmc_queue *mq, struct request *req)
 	}
 
 	if (req) {
+		mmc_blk_clk_scaling_boost(mq, req);
 		switch (req_op(req)) {
 		case REQ_OP_DISCARD:
 			ret = mmc_cmdq_wait_for_small_sector_read(card, req);
@@ -3688,6 +3711,7 @@ void mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 	}
 
 	if (req) {
+		mmc_blk_clk_scaling_boost(mq, req);
 		switch (req_op(req)) {
 		case REQ_OP_DRV_IN:
 		case REQ_OP_DRV_OUT:
@@ -153,6 +153,124 @@ int mmc_cmdq_down_rwsem(struct mmc_host *host, struct request *rq)
 }
 EXPORT_SYMBOL(mmc_cmdq_down_rwsem);
 
+/* Index of the highest frequency of the table not above @freq */
+static int mmc_clk_scaling_freq_idx(struct mmc_devfeq_clk_scaling *clk_scaling,
+	unsigned long freq)
+{
+	int i;
+
+	for (i = clk_scaling->freq_table_sz - 1; i > 0; i--)
+		if (clk_scaling->freq_table[i] <= freq)
+			break;
+
+	return i;
+}
+
+/* Account the time at the current frequency, clk_scaling->lock held */
+static void mmc_clk_scaling_update_time(
+	struct mmc_devfeq_clk_scaling *clk_scaling)
+{
+	ktime_t now = ktime_get();
+
+	clk_scaling->stats[clk_scaling->curr_idx].time_us +=
+		ktime_us_delta(now, clk_scaling->freq_stamp);
+	clk_scaling->freq_stamp = now;
+}
+
+static void mmc_clk_scaling_set_freq(struct mmc_host *host,
+	unsigned long freq)
+{
+	struct mmc_devfeq_clk_scaling *clk_scaling = &host->clk_scaling;
+
+	if (!clk_scaling->stats) {
+		clk_scaling->curr_freq = freq;
+		return;
+	}
+
+	spin_lock_bh(&clk_scaling->lock);
+	if (clk_scaling->stats) {
+		mmc_clk_scaling_update_time(clk_scaling);
+		clk_scaling->curr_idx = mmc_clk_scaling_freq_idx(clk_scaling,
+			freq);
+	}
+	clk_scaling->curr_freq = freq;
+	spin_unlock_bh(&clk_scaling->lock);
+}
+
+/**
+ * mmc_clk_scaling_account_req() - account the latency of a data request
+ * @host: pointer to mmc host structure
+ * @start: time the request was issued
+ *
+ * The latency is accounted to the current frequency.
+ */
+void mmc_clk_scaling_account_req(struct mmc_host *host, ktime_t start)
+{
+	struct mmc_devfeq_clk_scaling *clk_scaling = &host->clk_scaling;
+	struct mmc_clk_scaling_stats *stats;
+	u64 lat_us;
+
+	if (!clk_scaling->enable || !clk_scaling->stats)
+		return;
+
+	lat_us = ktime_us_delta(ktime_get(), start);
+
+	spin_lock_bh(&clk_scaling->lock);
+	if (clk_scaling->stats) {
+		stats = &clk_scaling->stats[clk_scaling->curr_idx];
+		stats->reqs++;
+		stats->lat_us += lat_us;
+		if (lat_us > stats->max_lat_us)
+			stats->max_lat_us = lat_us;
+	}
+	spin_unlock_bh(&clk_scaling->lock);
+}
+EXPORT_SYMBOL(mmc_clk_scaling_account_req);
+
+/**
+ * mmc_clk_scaling_boost() - scale up at once for a latency bound request
+ * @host: pointer to mmc host structure
+ * @sync: the request is synchronous (REQ_SYNC, REQ_FUA, flush)
+ * @depth: requests queued on the device, this one included
+ *
+ * devfreq only notices a burst of sync writes once a polling interval with
+ * enough busy time has gone, by which time an fsync() is often over. In
+ * boost mode such requests, or a deep queue, ask for the highest frequency
+ * before they are issued, and devfreq does not scale down until no such
+ * request came for boost_hold_ms.
+ */
+void mmc_clk_scaling_boost(struct mmc_host *host, bool sync,
+	unsigned int depth)
+{
+	struct mmc_devfeq_clk_scaling *clk_scaling = &host->clk_scaling;
+	unsigned long max_freq;
+
+	if (!clk_scaling->enable || !clk_scaling->boost)
+		return;
+
+	if (!sync && depth < clk_scaling->boost_depth)
+		return;
+
+	spin_lock_bh(&clk_scaling->lock);
+	/* the frequency table goes away with the statistics */
+	if (!clk_scaling->stats)
+		goto out;
+
+	clk_scaling->last_boost = ktime_get();
+	max_freq = clk_scaling->freq_table[clk_scaling->freq_table_sz - 1];
+	if (clk_scaling->curr_freq < max_freq &&
+		!clk_scaling->skip_clk_scale_freq_update &&
+		!clk_scaling->is_suspended) {
+		clk_scaling->need_freq_change = true;
+		clk_scaling->target_freq = max_freq;
+		clk_scaling->state = MMC_LOAD_HIGH;
+		clk_scaling->boost_count++;
+	}
+out:
+	spin_unlock_bh(&clk_scaling->lock);
+}
+EXPORT_SYMBOL(mmc_clk_scaling_boost);
+
 static void mmc_clk_scaling_start_busy(struct mmc_host *host, bool lock_needed)
 {
 	struct mmc_devfeq_clk_scaling *clk_scaling = &host->clk_scaling;
@@ -367,6 +485,7 @@ int mmc_cmdq_halt_on_empty_queue(struct mmc_host *host)
 {
 	int err = 0;
 
+	mmc_cmdq_commit(host);
 	err = wait_event_interruptible_timeout(host->cmdq_ctx.queue_empty_wq,
 			(!host->cmdq_ctx.active_reqs),
 			msecs_to_jiffies(MMC_CMDQ_WAIT_EVENT_TIMEOUT_MS));
@@ -459,7 +578,7 @@ int mmc_clk_update_freq(struct mmc_host *host,
 			state, freq);
 	err = host->bus_ops->change_bus_speed(host, &freq);
 	if (!err)
-		host->clk_scaling.curr_freq = freq;
+		mmc_clk_scaling_set_freq(host, freq);
 	else
 		pr_err("%s: %s: failed (%d) at freq=%lu\n",
 			mmc_hostname(host), __func__, err, freq);
@@ -521,6 +640,15 @@ static int mmc_devfreq_set_target(struct device *dev,
 		goto out;
 	}
 
+	/* hysteresis of the boost mode: hold the frequency after a burst */
+	if (clk_scaling->boost && *freq < clk_scaling->curr_freq &&
+		ktime_before(ktime_get(), ktime_add_ms(clk_scaling->last_boost,
+			clk_scaling->boost_hold_ms))) {
+		*freq = clk_scaling->curr_freq;
+		spin_unlock_bh(&clk_scaling->lock);
+		goto out;
+	}
+
 	clk_scaling->need_freq_change = true;
 	clk_scaling->target_freq = *freq;
 	clk_scaling->state = *freq < clk_scaling->curr_freq ?
@@ -759,6 +887,14 @@ int mmc_init_clk_scaling(struct mmc_host *host)
 		return err;
 	}
 
+	host->clk_scaling.stats = kcalloc(host->clk_scaling.freq_table_sz,
+		sizeof(*host->clk_scaling.stats), GFP_KERNEL);
+	if (!host->clk_scaling.stats)
+		return -ENOMEM;
+	host->clk_scaling.curr_idx = mmc_clk_scaling_freq_idx(
+		&host->clk_scaling, host->clk_scaling.curr_freq);
+	host->clk_scaling.freq_stamp = ktime_get();
+
 	pr_debug("%s: adding devfreq with: upthreshold=%u downthreshold=%u polling=%u\n",
 		mmc_hostname(host),
 		host->clk_scaling.ondemand_gov_data.upthreshold,
@@ -774,6 +910,8 @@ int mmc_init_clk_scaling(struct mmc_host *host)
 	if (IS_ERR(devfreq)) {
 		pr_err("%s: unable to register with devfreq\n",
 			mmc_hostname(host));
+		kfree(host->clk_scaling.stats);
+		host->clk_scaling.stats = NULL;
 		return PTR_ERR(devfreq);
 	}
 
@@ -832,6 +970,11 @@ int mmc_suspend_clk_scaling(struct mmc_host *host)
 
 	host->clk_scaling.total_busy_time_us = 0;
 
+	/* time in suspend is not time at a frequency */
+	spin_lock_bh(&host->clk_scaling.lock);
+	mmc_clk_scaling_update_time(&host->clk_scaling);
+	spin_unlock_bh(&host->clk_scaling.lock);
+
 	pr_debug("%s: devfreq was removed\n", mmc_hostname(host));
 
 	return 0;
@@ -883,6 +1026,12 @@ int mmc_resume_clk_scaling(struct mmc_host *host)
 		host->clk_scaling.curr_freq = devfreq_min_clk;
 	host->clk_scaling.target_freq = host->clk_scaling.curr_freq;
 
+	spin_lock_bh(&host->clk_scaling.lock);
+	host->clk_scaling.curr_idx = mmc_clk_scaling_freq_idx(
+		&host->clk_scaling, host->clk_scaling.curr_freq);
+	host->clk_scaling.freq_stamp = ktime_get();
+	spin_unlock_bh(&host->clk_scaling.lock);
+
 	err = devfreq_resume_device(host->clk_scaling.devfreq);
 	if (err) {
 		pr_err("%s: %s: failed to resume devfreq (%d)\n",
@@ -940,6 +1089,11 @@ int mmc_exit_clk_scaling(struct mmc_host *host)
 	host->clk_scaling.devfreq = NULL;
 	atomic_set(&host->clk_scaling.devfreq_abort, 1);
 
+	spin_lock_bh(&host->clk_scaling.lock);
+	kfree(host->clk_scaling.stats);
+	host->clk_scaling.stats = NULL;
+	spin_unlock_bh(&host->clk_scaling.lock);
+
 	kfree(host->clk_scaling.freq_table);
 	host->clk_scaling.freq_table = NULL;
 
@@ -986,6 +1140,11 @@ void mmc_request_done(struct mmc_host *host, struct mmc_request *mrq)
 	if (host->clk_scaling.is_busy_started)
 		mmc_clk_scaling_stop_busy(host, true);
 
+	/* command queue requests are accounted by their completion */
+	if (mmc_is_data_request(mrq) && !err &&
+		!(host->card && mmc_card_cmdq(host->card)))
+		mmc_clk_scaling_account_req(host, mrq->io_start);
+
 	/* Flag re-tuning needed on CRC errors */
 	if ((cmd->opcode != MMC_SEND_TUNING_BLOCK &&
 	    cmd->opcode != MMC_SEND_TUNING_BLOCK_HS200) &&
@@ -1233,6 +1392,7 @@ static int mmc_start_request(struct mmc_host *host, struct mmc_request *mrq)
 	if (mmc_is_data_request(mrq)) {
 		mmc_deferred_scaling(host);
 		mmc_clk_scaling_start_busy(host, true);
+		mrq->io_start = ktime_get();
 	}
 
 	__mmc_start_request(host, mrq);
@@ -1724,6 +1884,21 @@ void mmc_cmdq_post_req(struct mmc_host *host, int tag, int err)
 }
 EXPORT_SYMBOL(mmc_cmdq_post_req);
 
+/**
+ *	mmc_cmdq_commit - ring the doorbell for queued tasks
+ *	@host: host instance
+ *
+ *	Tasks issued while cmdq_ctx.defer_dbr is set are only written to
+ *	their slots. This hands all of them to the CQE at once and must
+ *	be called before waiting on them to complete.
+ */
+void mmc_cmdq_commit(struct mmc_host *host)
+{
+	if (host->cmdq_ops->commit)
+		host->cmdq_ops->commit(host);
+}
+EXPORT_SYMBOL(mmc_cmdq_commit);
+
 /**
  *	mmc_cmdq_halt - halt/un-halt the command queue engine
  *	@host: host instance
@@ -1745,6 +1920,9 @@ int mmc_cmdq_halt(struct mmc_host *host, bool halt)
 		return 0;
 	}
 
+	if (halt)
+		mmc_cmdq_commit(host);
+
 	if ((halt && mmc_host_halt(host)) ||
 			(!halt && !mmc_host_halt(host))) {
 		pr_debug("%s: %s: CQE is already %s\n", mmc_hostname(host),
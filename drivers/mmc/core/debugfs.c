@@ -16,6 +16,7 @@
 #include <linux/stat.h>
 #include <linux/fault-inject.h>
 #include <linux/uaccess.h>
+#include <linux/math64.h>
 
 #include <linux/mmc/card.h>
 #include <linux/mmc/host.h>
@@ -456,6 +457,56 @@ static const struct file_operations mmc_err_stats_fops = {
 	.write	= mmc_err_stats_write,
 };
 
+static int mmc_cmdq_slot_stats_show(struct seq_file *file, void *data)
+{
+	struct mmc_host *host = (struct mmc_host *)file->private;
+	struct mmc_cmdq_slot_stats *stats;
+	int i;
+
+	seq_puts(file, "slot\tcount\tavg_us\tmax_us\tbatched\n");
+	for (i = 0; i < MMC_CMDQ_STATS_SLOTS; i++) {
+		stats = &host->cmdq_slot_stats[i];
+		if (!stats->count)
+			continue;
+		seq_printf(file, "%d\t%llu\t%llu\t%llu\t%llu\n", i,
+			   stats->count,
+			   div64_u64(stats->total_us, stats->count),
+			   stats->max_us, stats->batched);
+	}
+	return 0;
+}
+
+static int mmc_cmdq_slot_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_cmdq_slot_stats_show, inode->i_private);
+}
+
+static ssize_t mmc_cmdq_slot_stats_write(struct file *filp,
+		const char __user *ubuf, size_t cnt, loff_t *ppos)
+{
+	struct mmc_host *host = filp->f_mapping->host->i_private;
+	int i;
+
+	if (!host)
+		return -EINVAL;
+
+	/* Keep the start of tasks in flight, their completion still counts */
+	for (i = 0; i < MMC_CMDQ_STATS_SLOTS; i++) {
+		host->cmdq_slot_stats[i].count = 0;
+		host->cmdq_slot_stats[i].total_us = 0;
+		host->cmdq_slot_stats[i].max_us = 0;
+		host->cmdq_slot_stats[i].batched = 0;
+	}
+
+	return cnt;
+}
+
+static const struct file_operations mmc_cmdq_slot_stats_fops = {
+	.open	= mmc_cmdq_slot_stats_open,
+	.read	= seq_read,
+	.write	= mmc_cmdq_slot_stats_write,
+};
+
 void mmc_add_host_debugfs(struct mmc_host *host)
 {
 	struct dentry *root;
@@ -496,6 +547,14 @@ void mmc_add_host_debugfs(struct mmc_host *host)
 		&host->cmdq_thist_enabled))
 		goto err_node;
 
+	if (!debugfs_create_u32("cmdq_max_batch", 0600, root,
+		&host->cmdq_ctx.max_batch))
+		goto err_node;
+
+	if (!debugfs_create_file("cmdq_slot_stats", 0600, root, host,
+		&mmc_cmdq_slot_stats_fops))
+		goto err_node;
+
 	if (!debugfs_create_bool("crash_on_err",
 		0600, root,
 		&host->crash_on_err))
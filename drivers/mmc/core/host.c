@@ -39,6 +39,8 @@
 #define MMC_DEVFRQ_DEFAULT_UP_THRESHOLD 35
 #define MMC_DEVFRQ_DEFAULT_DOWN_THRESHOLD 5
 #define MMC_DEVFRQ_DEFAULT_POLLING_MSEC 100
+#define MMC_DEVFRQ_DEFAULT_BOOST_HOLD_MSEC 200
+#define MMC_DEVFRQ_DEFAULT_BOOST_DEPTH 4
 
 static DEFINE_IDA(mmc_host_ida);
 
@@ -879,6 +881,125 @@ static ssize_t store_polling(struct device *dev,
 	return count;
 }
 
+static ssize_t show_boost(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct mmc_host *host = cls_dev_to_mmc_host(dev);
+
+	if (!host)
+		return -EINVAL;
+
+	return snprintf(buf, PAGE_SIZE, "%d\n", host->clk_scaling.boost);
+}
+
+static ssize_t store_boost(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct mmc_host *host = cls_dev_to_mmc_host(dev);
+	bool value;
+
+	if (!host || kstrtobool(buf, &value))
+		return -EINVAL;
+
+	host->clk_scaling.boost = value;
+
+	pr_debug("%s: clkscale_boost set to %d\n",
+			mmc_hostname(host), value);
+	return count;
+}
+
+static ssize_t show_boost_hold(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct mmc_host *host = cls_dev_to_mmc_host(dev);
+
+	if (!host)
+		return -EINVAL;
+
+	return snprintf(buf, PAGE_SIZE, "%u milliseconds\n",
+			host->clk_scaling.boost_hold_ms);
+}
+
+static ssize_t store_boost_hold(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct mmc_host *host = cls_dev_to_mmc_host(dev);
+	unsigned int value;
+
+	if (!host || kstrtouint(buf, 0, &value))
+		return -EINVAL;
+
+	host->clk_scaling.boost_hold_ms = value;
+
+	pr_debug("%s: clkscale_boost_hold_ms set to %u\n",
+			mmc_hostname(host), value);
+	return count;
+}
+
+static ssize_t show_boost_depth(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct mmc_host *host = cls_dev_to_mmc_host(dev);
+
+	if (!host)
+		return -EINVAL;
+
+	return snprintf(buf, PAGE_SIZE, "%u\n", host->clk_scaling.boost_depth);
+}
+
+static ssize_t store_boost_depth(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct mmc_host *host = cls_dev_to_mmc_host(dev);
+	unsigned int value;
+
+	if (!host || kstrtouint(buf, 0, &value) || !value)
+		return -EINVAL;
+
+	host->clk_scaling.boost_depth = value;
+
+	pr_debug("%s: clkscale_boost_depth set to %u\n",
+			mmc_hostname(host), value);
+	return count;
+}
+
+/* Time, requests and request latency at each frequency */
+static ssize_t show_stats(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct mmc_host *host = cls_dev_to_mmc_host(dev);
+	struct mmc_devfeq_clk_scaling *clk_scaling;
+	struct mmc_clk_scaling_stats *stats;
+	ssize_t len;
+	int i;
+
+	if (!host)
+		return -EINVAL;
+
+	clk_scaling = &host->clk_scaling;
+	if (!clk_scaling->stats)
+		return -ENODEV;
+
+	len = snprintf(buf, PAGE_SIZE, "%10s %14s %10s %10s %10s\n", "freq",
+			"time_us", "reqs", "avg_lat_us", "max_lat_us");
+
+	spin_lock_bh(&clk_scaling->lock);
+	for (i = 0; clk_scaling->stats && i < clk_scaling->freq_table_sz;
+			i++) {
+		stats = &clk_scaling->stats[i];
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+			"%10u %14llu %10llu %10llu %10llu\n",
+			clk_scaling->freq_table[i], stats->time_us, stats->reqs,
+			stats->reqs ? div64_u64(stats->lat_us, stats->reqs) : 0,
+			stats->max_lat_us);
+	}
+	len += scnprintf(buf + len, PAGE_SIZE - len, "boosts: %lu\n",
+			clk_scaling->boost_count);
+	spin_unlock_bh(&clk_scaling->lock);
+
+	return len;
+}
+
 DEVICE_ATTR(enable, 0644,
 		show_enable, store_enable);
 DEVICE_ATTR(polling_interval, 0644,
@@ -887,12 +1008,24 @@ DEVICE_ATTR(up_threshold, 0644,
 		show_up_threshold, store_up_threshold);
 DEVICE_ATTR(down_threshold, 0644,
 		show_down_threshold, store_down_threshold);
+DEVICE_ATTR(boost, 0644,
+		show_boost, store_boost);
+DEVICE_ATTR(boost_hold_ms, 0644,
+		show_boost_hold, store_boost_hold);
+DEVICE_ATTR(boost_depth, 0644,
+		show_boost_depth, store_boost_depth);
+DEVICE_ATTR(stats, 0444,
+		show_stats, NULL);
 
 static struct attribute *clk_scaling_attrs[] = {
 	&dev_attr_enable.attr,
 	&dev_attr_up_threshold.attr,
 	&dev_attr_down_threshold.attr,
 	&dev_attr_polling_interval.attr,
+	&dev_attr_boost.attr,
+	&dev_attr_boost_hold_ms.attr,
+	&dev_attr_boost_depth.attr,
+	&dev_attr_stats.attr,
 	NULL,
 };
 
@@ -988,6 +1121,8 @@ int mmc_add_host(struct mmc_host *host)
 	host->clk_scaling.downthreshold = MMC_DEVFRQ_DEFAULT_DOWN_THRESHOLD;
 	host->clk_scaling.polling_delay_ms = MMC_DEVFRQ_DEFAULT_POLLING_MSEC;
 	host->clk_scaling.skip_clk_scale_freq_update = false;
+	host->clk_scaling.boost_hold_ms = MMC_DEVFRQ_DEFAULT_BOOST_HOLD_MSEC;
+	host->clk_scaling.boost_depth = MMC_DEVFRQ_DEFAULT_BOOST_DEPTH;
 
 #ifdef CONFIG_DEBUG_FS
 	mmc_add_host_debugfs(host);
@@ -71,14 +71,13 @@ static bool mmc_check_blk_queue_start_tag(struct request_queue *q,
 	return !!ret;
 }
 
-static inline void mmc_cmdq_ready_wait(struct mmc_host *host,
-					struct mmc_queue *mq)
+static bool mmc_cmdq_ready(struct mmc_host *host, struct mmc_queue *mq)
 {
 	struct mmc_cmdq_context_info *ctx = &host->cmdq_ctx;
 	struct request_queue *q = mq->queue;
 
 	/*
-	 * Wait until all of the following conditions are true:
+	 * Ready when all of the following conditions are true:
 	 * 1. There is a request pending in the block layer queue
 	 *    to be processed.
 	 * 2. If the peeked request is flush/discard then there shouldn't
@@ -89,8 +88,7 @@ static inline void mmc_cmdq_ready_wait(struct mmc_host *host,
 	 * 6. free tag available to process the new request.
 	 *    (This must be the last condtion to check)
 	 */
-	wait_event(ctx->wait, kthread_should_stop()
-		|| (mmc_peek_request(mq) &&
+	return mmc_peek_request(mq) &&
 		!(((req_op(mq->cmdq_req_peeked) == REQ_OP_FLUSH) ||
 		   (req_op(mq->cmdq_req_peeked) == REQ_OP_DISCARD) ||
 		   (req_op(mq->cmdq_req_peeked) == REQ_OP_SECURE_ERASE))
@@ -101,7 +99,27 @@ static inline void mmc_cmdq_ready_wait(struct mmc_host *host,
 			!mmc_card_suspended(host->card))
 		&& !test_bit(CMDQ_STATE_ERR, &ctx->curr_state)
 		&& !atomic_read(&host->rpmb_req_pending)
-		&& !mmc_check_blk_queue_start_tag(q, mq->cmdq_req_peeked)));
+		&& !mmc_check_blk_queue_start_tag(q, mq->cmdq_req_peeked);
+}
+
+static inline void mmc_cmdq_ready_wait(struct mmc_host *host,
+					struct mmc_queue *mq)
+{
+	wait_event(host->cmdq_ctx.wait, kthread_should_stop()
+		   || mmc_cmdq_ready(host, mq));
+}
+
+/*
+ * Reads and writes found ready back to back are queued into their slots
+ * and handed to the CQE with a single doorbell write once the queue has
+ * nothing more to give, or max_batch of them are pending. Anything else
+ * may wait on the queue to drain or go out as a direct command, so the
+ * pending ones are committed ahead of it.
+ */
+static bool mmc_cmdq_can_batch(struct mmc_host *host, struct request *req)
+{
+	return host->cmdq_ctx.max_batch > 1 &&
+		(req_op(req) == REQ_OP_READ || req_op(req) == REQ_OP_WRITE);
 }
 
 static void mmc_cmdq_softirq_done(struct request *rq)
@@ -136,6 +154,8 @@ static int mmc_cmdq_thread(void *d)
 	struct mmc_card *card = mq->card;
 
 	struct mmc_host *host = card->host;
+	struct mmc_cmdq_context_info *ctx = &host->cmdq_ctx;
+	unsigned int batched = 0;
 
 	struct sched_param scheduler_params = {0};
 	scheduler_params.sched_priority = 1;
@@ -147,18 +167,37 @@ static int mmc_cmdq_thread(void *d)
 
 	while (1) {
 		int ret = 0;
-
-		mmc_cmdq_ready_wait(host, mq);
-		if (kthread_should_stop())
+		bool batch;
+
+		if (!batched || batched >= ctx->max_batch ||
+		    !mmc_cmdq_ready(host, mq)) {
+			if (batched)
+				mmc_cmdq_commit(host);
+			batched = 0;
+			mmc_cmdq_ready_wait(host, mq);
+		}
+		if (kthread_should_stop()) {
+			mmc_cmdq_commit(host);
 			break;
+		}
+
+		batch = mmc_cmdq_can_batch(host, mq->cmdq_req_peeked);
+		if (!batch && batched) {
+			mmc_cmdq_commit(host);
+			batched = 0;
+		}
 
 		ret = mmc_cmdq_down_rwsem(host, mq->cmdq_req_peeked);
 		if (ret) {
 			mmc_cmdq_up_rwsem(host);
 			continue;
 		}
+		WRITE_ONCE(ctx->defer_dbr, batch);
 		ret = mq->cmdq_issue_fn(mq, mq->cmdq_req_peeked);
+		WRITE_ONCE(ctx->defer_dbr, false);
 		mmc_cmdq_up_rwsem(host);
+		if (batch)
+			batched++;
 
 		/*
 		 * Don't requeue if issue_fn fails.
@@ -248,6 +287,7 @@ int mmc_cmdq_init(struct mmc_queue *mq, struct mmc_card *card)
 	init_waitqueue_head(&card->host->cmdq_ctx.queue_empty_wq);
 	init_waitqueue_head(&card->host->cmdq_ctx.wait);
 	init_rwsem(&card->host->cmdq_ctx.err_rwsem);
+	card->host->cmdq_ctx.max_batch = MMC_CMDQ_DEF_MAX_BATCH;
 
 	ret = blk_queue_init_tags(mq->queue, q_depth, NULL, BLK_TAG_ALLOC_FIFO);
 	if (ret) {
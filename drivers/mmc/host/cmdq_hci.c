@@ -512,6 +512,56 @@ static void cmdq_disable(struct mmc_host *mmc, bool soft)
 	cmdq_runtime_pm_put(cq_host);
 }
 
+static void cmdq_slot_stats_start(struct mmc_host *mmc, unsigned long tags)
+{
+	ktime_t now = ktime_get();
+	bool batched = tags & (tags - 1);
+	int tag;
+
+	for_each_set_bit(tag, &tags, MMC_CMDQ_STATS_SLOTS) {
+		mmc->cmdq_slot_stats[tag].start = now;
+		if (batched)
+			mmc->cmdq_slot_stats[tag].batched++;
+	}
+}
+
+static void cmdq_slot_stats_end(struct mmc_host *mmc, unsigned int tag)
+{
+	struct mmc_cmdq_slot_stats *stats = &mmc->cmdq_slot_stats[tag];
+	u64 us;
+
+	if (!stats->start)
+		return;
+
+	us = ktime_us_delta(ktime_get(), stats->start);
+	stats->start = 0;
+	stats->count++;
+	stats->total_us += us;
+	if (us > stats->max_us)
+		stats->max_us = us;
+}
+
+static void cmdq_commit(struct mmc_host *mmc)
+{
+	struct cmdq_host *cq_host = (struct cmdq_host *)mmc_cmdq_private(mmc);
+	unsigned long tags = xchg(&cq_host->pending_dbr, 0);
+
+	if (!tags)
+		return;
+
+	/* Ensure the task descriptor list is flushed before ringing doorbell */
+	wmb();
+	if (cmdq_readl(cq_host, CQTDBR) & tags) {
+		cmdq_dumpregs(cq_host);
+		BUG_ON(1);
+	}
+	MMC_TRACE(mmc, "%s: tags: 0x%lx\n", __func__, tags);
+	cmdq_slot_stats_start(mmc, tags);
+	cmdq_writel(cq_host, tags, CQTDBR);
+	/* Commit the doorbell write immediately */
+	wmb();
+}
+
 static void cmdq_reset(struct mmc_host *mmc, bool soft)
 {
 	struct cmdq_host *cq_host = (struct cmdq_host *)mmc_cmdq_private(mmc);
@@ -528,6 +578,8 @@ static void cmdq_reset(struct mmc_host *mmc, bool soft)
 	rca = cmdq_readl(cq_host, CQSSC2);
 
 	cmdq_disable(mmc, true);
+	/* Queued tasks go with the rest, the error handler requeues them */
+	cq_host->pending_dbr = 0;
 
 	cmdq_crypto_reset(cq_host);
 
@@ -833,6 +885,12 @@ static int cmdq_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	/* PM QoS */
 	sdhci_msm_pm_qos_irq_vote(host);
 	cmdq_pm_qos_vote(host, mrq);
+
+	if (READ_ONCE(mmc->cmdq_ctx.defer_dbr)) {
+		MMC_TRACE(mmc, "%s: tag: %d queued\n", __func__, tag);
+		set_bit(tag, &cq_host->pending_dbr);
+		return err;
+	}
 ring_doorbell:
 	/* Ensure the task descriptor list is flushed before ringing doorbell */
 	wmb();
@@ -841,6 +899,7 @@ static int cmdq_request(struct mmc_host *mmc, struct mmc_request *mrq)
 		BUG_ON(1);
 	}
 	MMC_TRACE(mmc, "%s: tag: %d\n", __func__, tag);
+	cmdq_slot_stats_start(mmc, 1UL << tag);
 	cmdq_writel(cq_host, 1 << tag, CQTDBR);
 	/* Commit the doorbell write immediately */
 	wmb();
@@ -868,6 +927,7 @@ static void cmdq_finish_data(struct mmc_host *mmc, unsigned int tag)
 		mrq->cmd->resp[0] = cmdq_readl(cq_host, CQCRDCT);
 
 	cmdq_complete_crypto_desc(cq_host, mrq, NULL);
+	cmdq_slot_stats_end(mmc, tag);
 
 	if (mrq->cmdq_req->cmdq_req_flags & DCMD)
 		cmdq_writel(cq_host,
@@ -1358,6 +1418,7 @@ static const struct mmc_cmdq_host_ops cmdq_host_ops = {
 	.post_req = cmdq_post_req,
 	.halt = cmdq_halt,
 	.reset	= cmdq_reset,
+	.commit = cmdq_commit,
 	.dumpstate = cmdq_dumpstate,
 	.cqe_crypto_update_queue = cqhci_crypto_update_queue,
 };
@@ -300,6 +300,8 @@ struct cmdq_host {
 
 	struct completion halt_comp;
 	struct mmc_request **mrq_slot;
+	/* tasks queued to their slots, waiting for the doorbell */
+	unsigned long pending_dbr;
 	void *private;
 	const struct cmdq_host_crypto_variant_ops *crypto_vops;
 #ifdef CONFIG_MMC_CQ_HCI_CRYPTO
@@ -4083,6 +4083,10 @@ void ipa3_q6_pre_shutdown_cleanup(void)
 		 */
 		BUG();
 	}
+	/* SRAM no longer matches what the last commits wrote */
+	mutex_lock(&ipa3_ctx->lock);
+	ipa3_fltrt_shadow_reset_all();
+	mutex_unlock(&ipa3_ctx->lock);
 	if (ipa3_q6_set_ex_path_to_apps()) {
 		IPAERR("Failed to redirect exceptions to APPS\n");
 		/*
@@ -5134,6 +5138,7 @@ static const struct file_operations ipa3_drv_fops = {
 #ifdef CONFIG_COMPAT
 	.compat_ioctl = compat_ipa3_ioctl,
 #endif
+	.mmap = ipa_hw_stats_mmap,
 };
 
 static int ipa3_get_clks(struct device *dev)
@@ -6992,6 +6997,9 @@ static int ipa3_pre_init(const struct ipa3_plat_drv_res *resource_p,
 	ipa3_ctx->wan_rx_ring_size = resource_p->wan_rx_ring_size;
 	ipa3_ctx->lan_rx_ring_size = resource_p->lan_rx_ring_size;
 	ipa3_ctx->ipa_wan_skb_page = resource_p->ipa_wan_skb_page;
+	ipa3_ctx->wan_rx_spread_cpus = resource_p->wan_rx_spread_cpus;
+	ipa3_ctx->wan_rx_spread_budget = NAPI_WEIGHT;
+	ipa3_ctx->pm_predict_window_ms = resource_p->pm_predict_window_ms;
 	ipa3_ctx->stats.page_recycle_stats[0].total_replenished = 0;
 	ipa3_ctx->stats.page_recycle_stats[0].tmp_alloc = 0;
 	ipa3_ctx->stats.page_recycle_stats[1].total_replenished = 0;
@@ -7676,6 +7684,8 @@ static int get_ipa_dts_configuration(struct platform_device *pdev,
 	ipa_drv_res->modem_cfg_emb_pipe_flt = false;
 	ipa_drv_res->ipa_wdi2 = false;
 	ipa_drv_res->ipa_wan_skb_page = false;
+	ipa_drv_res->wan_rx_spread_cpus = 0;
+	ipa_drv_res->pm_predict_window_ms = 0;
 	ipa_drv_res->ipa_wdi2_over_gsi = false;
 	ipa_drv_res->ipa_wdi3_over_gsi = false;
 	ipa_drv_res->use_xbl_boot = false;
@@ -7814,6 +7824,19 @@ static int get_ipa_dts_configuration(struct platform_device *pdev,
 			ipa_drv_res->ipa_wan_skb_page
 			? "True" : "False");
 
+	/* CPUs the WAN RX packets are spread over, none by default */
+	of_property_read_u32(pdev->dev.of_node, "qcom,wan-rx-spread-cpus",
+			&ipa_drv_res->wan_rx_spread_cpus);
+	IPADBG(": WAN RX spread cpus = 0x%x\n",
+			ipa_drv_res->wan_rx_spread_cpus);
+
+	/* how recent a burst must be to predict the clock vote, 0 is off */
+	of_property_read_u32(pdev->dev.of_node,
+			"qcom,ipa-pm-predict-window-ms",
+			&ipa_drv_res->pm_predict_window_ms);
+	IPADBG(": PM predict window = %u ms\n",
+			ipa_drv_res->pm_predict_window_ms);
+
 	ipa_drv_res->ipa_fltrt_not_hashable =
 			of_property_read_bool(pdev->dev.of_node,
 			"qcom,ipa-fltrt-not-hashable");
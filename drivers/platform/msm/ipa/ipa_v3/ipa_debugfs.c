@@ -1221,23 +1221,51 @@ static ssize_t ipa3_read_odlstats(struct file *file, char __user *ubuf,
 static ssize_t ipa3_read_page_recycle_stats(struct file *file,
 		char __user *ubuf, size_t count, loff_t *ppos)
 {
+	static const char * const name[] = { "COAL", "DEF " };
+	struct ipa3_page_recycle_stats *stats;
+	u64 hits, pct;
 	int nbytes;
 	int cnt = 0;
+	int i;
 
-	nbytes = scnprintf(dbg_buff, IPA_MAX_MSG_LEN,
-			"COAL : Total number of packets replenished =%llu\n"
-			"COAL : Number of tmp alloc packets  =%llu\n"
-			"DEF  : Total number of packets replenished =%llu\n"
-			"DEF  : Number of tmp alloc packets  =%llu\n",
-			ipa3_ctx->stats.page_recycle_stats[0].total_replenished,
-			ipa3_ctx->stats.page_recycle_stats[0].tmp_alloc,
-			ipa3_ctx->stats.page_recycle_stats[1].total_replenished,
-			ipa3_ctx->stats.page_recycle_stats[1].tmp_alloc);
+	for (i = 0; i < ARRAY_SIZE(name); i++) {
+		stats = &ipa3_ctx->stats.page_recycle_stats[i];
+		hits = stats->local_hit + stats->remote_hit;
+		pct = stats->total_replenished ?
+			div64_u64(hits * 100, stats->total_replenished) : 0;
+		nbytes = scnprintf(dbg_buff + cnt, IPA_MAX_MSG_LEN - cnt,
+			"%s : Total number of packets replenished =%llu\n"
+			"%s : Number of tmp alloc packets  =%llu\n"
+			"%s : Recycled on local CPU =%llu\n"
+			"%s : Recycled from other CPU =%llu\n"
+			"%s : Recycle hit rate =%llu%%\n"
+			"%s : Replenish starved =%llu\n",
+			name[i], stats->total_replenished,
+			name[i], stats->tmp_alloc,
+			name[i], stats->local_hit,
+			name[i], stats->remote_hit,
+			name[i], pct,
+			name[i], stats->starved);
+		cnt += nbytes;
+	}
 
+	nbytes = scnprintf(dbg_buff + cnt, IPA_MAX_MSG_LEN - cnt,
+		"Fast replenish starved =%u\n",
+		ipa3_ctx->stats.fast_repl_starved);
 	cnt += nbytes;
 
 	return simple_read_from_buffer(ubuf, count, ppos, dbg_buff, cnt);
 }
+static ssize_t ipa3_read_wan_rx_spread(struct file *file,
+		char __user *ubuf, size_t count, loff_t *ppos)
+{
+	int cnt;
+
+	cnt = ipa3_rx_spread_stats(dbg_buff, IPA_MAX_MSG_LEN);
+
+	return simple_read_from_buffer(ubuf, count, ppos, dbg_buff, cnt);
+}
+
 static ssize_t ipa3_read_wstats(struct file *file, char __user *ubuf,
 		size_t count, loff_t *ppos)
 {
@@ -2852,6 +2880,10 @@ static const struct ipa3_debugfs_file debugfs_files[] = {
 		"wstats", IPA_READ_ONLY_MODE, NULL, {
 			.read = ipa3_read_wstats,
 		}
+	}, {
+		"wan_rx_spread", IPA_READ_ONLY_MODE, NULL, {
+			.read = ipa3_read_wan_rx_spread,
+		}
 	}, {
 		"odlstats", IPA_READ_ONLY_MODE, NULL, {
 			.read = ipa3_read_odlstats,
@@ -3005,6 +3037,27 @@ void ipa3_debugfs_post_init(void)
 		goto fail;
 	}
 
+	file = debugfs_create_u32("wan_rx_spread_budget", IPA_READ_WRITE_MODE,
+		dent, &ipa3_ctx->wan_rx_spread_budget);
+	if (!file) {
+		IPAERR("could not create wan_rx_spread_budget file\n");
+		goto fail;
+	}
+
+	file = debugfs_create_u32("pm_predict_window_ms", IPA_READ_WRITE_MODE,
+		dent, &ipa3_ctx->pm_predict_window_ms);
+	if (!file) {
+		IPAERR("could not create pm_predict_window_ms file\n");
+		goto fail;
+	}
+
+	file = debugfs_create_u32("fltrt_full_commit", IPA_READ_WRITE_MODE,
+		dent, &ipa3_ctx->fltrt_full_commit);
+	if (!file) {
+		IPAERR("could not create fltrt_full_commit file\n");
+		goto fail;
+	}
+
 	file = debugfs_create_u32("clock_scaling_bw_threshold_nominal_mbps",
 		IPA_READ_WRITE_MODE, dent,
 		&ipa3_ctx->ctrl->clock_scaling_bw_threshold_nominal);
@@ -15,11 +15,15 @@
 #include <linux/export.h>
 #include <linux/delay.h>
 #include <linux/kernel.h>
+#include <linux/kernel_stat.h>
 #include <linux/msm_ipa.h>
 #include <linux/mutex.h>
 #include <linux/ipa.h>
 #include "linux/msm_gsi.h"
 #include <linux/dmapool.h>
+#include <linux/semaphore.h>
+#include <linux/sort.h>
+#include <linux/vmalloc.h>
 #include "ipa_i.h"
 
 #define IPA_DMA_POLLING_MIN_SLEEP_RX 1010
@@ -1226,6 +1230,266 @@ const struct file_operations ipa3_ipadma_stats_ops = {
 	.write = ipa3_dma_debugfs_reset_statistics,
 };
 
+#define IPADMA_BENCH_MAX_PKTS 262144
+#define IPADMA_BENCH_MAX_INFLIGHT 1024
+
+/**
+ * struct ipa3_dma_bench_cfg - parameters of a loopback benchmark run
+ * @size: bytes per packet
+ * @count: packets per run
+ * @rate: packets per second to offer, 0 for as fast as the pipes go
+ * @inflight: packets queued to GSI at most at once
+ */
+struct ipa3_dma_bench_cfg {
+	u32 size;
+	u32 count;
+	u32 rate;
+	u32 inflight;
+};
+
+/**
+ * struct ipa3_dma_bench - loopback benchmark over the async memcpy pipes
+ * @cfg: parameters set from debugfs
+ * @run: parameters of the current or last run, copied from @cfg
+ * @slots: free slots of the src/dst rings
+ * @sent: submit time of the packet in each slot
+ * @lat: latency of each packet, in completion order
+ * @done: completed packets of the current run
+ * @stuck: a run timed out with packets queued, its buffers stay
+ *
+ * Packet n uses slot n % inflight of both rings. The async pipes
+ * complete in order, so a slot is free again once the semaphore is.
+ */
+struct ipa3_dma_bench {
+	struct ipa3_dma_bench_cfg cfg;
+	struct ipa3_dma_bench_cfg run;
+	struct mutex lock;
+	struct semaphore slots;
+	struct ipa_mem_buffer src;
+	struct ipa_mem_buffer dst;
+	u64 *sent;
+	u64 *lat;
+	atomic_t done;
+	/* results of the last run */
+	u32 last_count;
+	u64 elapsed_ns;
+	u64 cpu_ns;
+	int error;
+	bool stuck;
+};
+
+static struct ipa3_dma_bench ipa3_dma_bench = {
+	.cfg = {
+		.size = 1500,
+		.count = 10000,
+		.inflight = 64,
+	},
+	.lock = __MUTEX_INITIALIZER(ipa3_dma_bench.lock),
+};
+
+/* busy time of all cpus, the rx path does not run in our context */
+static u64 ipa3_dma_bench_cpu_ns(void)
+{
+	u64 sum = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		u64 *stat = kcpustat_cpu(cpu).cpustat;
+
+		sum += stat[CPUTIME_USER] + stat[CPUTIME_NICE] +
+			stat[CPUTIME_SYSTEM] + stat[CPUTIME_IRQ] +
+			stat[CPUTIME_SOFTIRQ];
+	}
+	return sum;
+}
+
+static void ipa3_dma_bench_cb(void *user1)
+{
+	struct ipa3_dma_bench *b = user1;
+	u32 n = atomic_inc_return(&b->done) - 1;
+
+	b->lat[n] = ktime_get_ns() - b->sent[n % b->run.inflight];
+	up(&b->slots);
+}
+
+static void ipa3_dma_bench_pace(struct ipa3_dma_bench *b, u64 start, u32 n)
+{
+	u64 due, now;
+
+	if (!b->run.rate)
+		return;
+
+	due = start + div_u64((u64)n * NSEC_PER_SEC, b->run.rate);
+	now = ktime_get_ns();
+	if (due > now + 20 * NSEC_PER_USEC)
+		usleep_range(div_u64(due - now, NSEC_PER_USEC),
+			div_u64(due - now, NSEC_PER_USEC) + 10);
+	while (ktime_get_ns() < due)
+		cpu_relax();
+}
+
+static int ipa3_dma_bench_cmp(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int ipa3_dma_bench_run(struct ipa3_dma_bench *b)
+{
+	size_t ring_sz;
+	u64 start, cpu, off;
+	u32 n, slot;
+	int res;
+
+	if (b->stuck)
+		return -EBUSY;
+
+	b->run = b->cfg;
+	b->last_count = 0;
+	if (!b->run.size || b->run.size > IPA_DMA_MAX_PKT_SZ || !b->run.count ||
+		b->run.count > IPADMA_BENCH_MAX_PKTS || !b->run.inflight ||
+		b->run.inflight > IPADMA_BENCH_MAX_INFLIGHT)
+		return -EINVAL;
+
+	ring_sz = (size_t)b->run.size * b->run.inflight;
+	b->src.base = dma_alloc_coherent(ipa3_ctx->pdev, ring_sz,
+		&b->src.phys_base, GFP_KERNEL);
+	if (!b->src.base)
+		return -ENOMEM;
+	b->dst.base = dma_alloc_coherent(ipa3_ctx->pdev, ring_sz,
+		&b->dst.phys_base, GFP_KERNEL);
+	if (!b->dst.base) {
+		res = -ENOMEM;
+		goto fail_dst;
+	}
+	memset(b->src.base, 0xa5, ring_sz);
+
+	b->sent = kcalloc(b->run.inflight, sizeof(*b->sent), GFP_KERNEL);
+	vfree(b->lat);
+	b->lat = vzalloc(b->run.count * sizeof(*b->lat));
+	if (!b->sent || !b->lat) {
+		res = -ENOMEM;
+		goto fail_samples;
+	}
+
+	res = ipa3_dma_enable();
+	if (res)
+		goto fail_samples;
+
+	sema_init(&b->slots, b->run.inflight);
+	atomic_set(&b->done, 0);
+
+	cpu = ipa3_dma_bench_cpu_ns();
+	start = ktime_get_ns();
+	for (n = 0; n < b->run.count; n++) {
+		ipa3_dma_bench_pace(b, start, n);
+		if (down_timeout(&b->slots, HZ)) {
+			res = -ETIMEDOUT;
+			break;
+		}
+
+		slot = n % b->run.inflight;
+		b->sent[slot] = ktime_get_ns();
+		off = (u64)slot * b->run.size;
+		res = ipa3_dma_async_memcpy(b->dst.phys_base + off,
+			b->src.phys_base + off, b->run.size,
+			ipa3_dma_bench_cb, b);
+		if (res) {
+			up(&b->slots);
+			break;
+		}
+	}
+
+	/* wait for what was queued, then the rings and samples are ours */
+	for (slot = 0; slot < b->run.inflight; slot++) {
+		if (down_timeout(&b->slots, HZ)) {
+			IPADMA_ERR("bench: packets lost, leaking the rings\n");
+			b->stuck = true;
+			b->error = -ETIMEDOUT;
+			return -ETIMEDOUT;
+		}
+	}
+	b->elapsed_ns = ktime_get_ns() - start;
+	b->cpu_ns = ipa3_dma_bench_cpu_ns() - cpu;
+	b->last_count = atomic_read(&b->done);
+
+	ipa3_dma_disable();
+	sort(b->lat, b->last_count, sizeof(*b->lat), ipa3_dma_bench_cmp, NULL);
+
+fail_samples:
+	b->error = res;
+	kfree(b->sent);
+	b->sent = NULL;
+	dma_free_coherent(ipa3_ctx->pdev, ring_sz, b->dst.base,
+		b->dst.phys_base);
+fail_dst:
+	dma_free_coherent(ipa3_ctx->pdev, ring_sz, b->src.base,
+		b->src.phys_base);
+	return res;
+}
+
+static u64 ipa3_dma_bench_pct(struct ipa3_dma_bench *b, u32 pct)
+{
+	return div_u64(b->lat[(b->last_count - 1) * pct / 100], NSEC_PER_USEC);
+}
+
+static ssize_t ipa3_dma_bench_read(struct file *file, char __user *ubuf,
+				 size_t count, loff_t *ppos)
+{
+	struct ipa3_dma_bench *b = &ipa3_dma_bench;
+	u64 elapsed, bits;
+	int nbytes = 0;
+
+	mutex_lock(&b->lock);
+	if (!b->last_count) {
+		nbytes = scnprintf(dbg_buff, IPADMA_MAX_MSG_LEN,
+			"no packets, error %d\n", b->error);
+		goto completed;
+	}
+
+	elapsed = max_t(u64, b->elapsed_ns, 1);
+	bits = (u64)b->last_count * b->run.size * 8;
+	nbytes += scnprintf(&dbg_buff[nbytes], IPADMA_MAX_MSG_LEN - nbytes,
+		"packets: %u of %u bytes, error %d\n", b->last_count,
+		b->run.size, b->error);
+	nbytes += scnprintf(&dbg_buff[nbytes], IPADMA_MAX_MSG_LEN - nbytes,
+		"elapsed: %llu us\npps: %llu\nMbps: %llu\n",
+		div_u64(elapsed, NSEC_PER_USEC),
+		div64_u64((u64)b->last_count * NSEC_PER_SEC, elapsed),
+		div64_u64(bits * (NSEC_PER_SEC / 1000000), elapsed));
+	nbytes += scnprintf(&dbg_buff[nbytes], IPADMA_MAX_MSG_LEN - nbytes,
+		"cpu: %llu ns/packet\n", div_u64(b->cpu_ns, b->last_count));
+	nbytes += scnprintf(&dbg_buff[nbytes], IPADMA_MAX_MSG_LEN - nbytes,
+		"latency us: p50 %llu p90 %llu p99 %llu max %llu\n",
+		ipa3_dma_bench_pct(b, 50), ipa3_dma_bench_pct(b, 90),
+		ipa3_dma_bench_pct(b, 99), ipa3_dma_bench_pct(b, 100));
+
+completed:
+	mutex_unlock(&b->lock);
+	return simple_read_from_buffer(ubuf, count, ppos, dbg_buff, nbytes);
+}
+
+static ssize_t ipa3_dma_bench_write(struct file *file,
+					const char __user *ubuf,
+					size_t count,
+					loff_t *ppos)
+{
+	struct ipa3_dma_bench *b = &ipa3_dma_bench;
+	int res;
+
+	mutex_lock(&b->lock);
+	res = ipa3_dma_bench_run(b);
+	mutex_unlock(&b->lock);
+
+	return res ? res : count;
+}
+
+static const struct file_operations ipa3_ipadma_bench_ops = {
+	.read = ipa3_dma_bench_read,
+	.write = ipa3_dma_bench_write,
+};
+
 static void ipa3_dma_debugfs_init(void)
 {
 	const mode_t read_write_mode = 0666;
@@ -1243,6 +1507,19 @@ static void ipa3_dma_debugfs_init(void)
 		IPADMA_ERR("fail to create file stats\n");
 		goto fail;
 	}
+
+	/* echo 1 > bench runs it, cat bench shows the last run */
+	debugfs_create_u32("bench_size", 0644, dent, &ipa3_dma_bench.cfg.size);
+	debugfs_create_u32("bench_count", 0644, dent,
+		&ipa3_dma_bench.cfg.count);
+	debugfs_create_u32("bench_rate", 0644, dent, &ipa3_dma_bench.cfg.rate);
+	debugfs_create_u32("bench_inflight", 0644, dent,
+		&ipa3_dma_bench.cfg.inflight);
+	if (IS_ERR_OR_NULL(debugfs_create_file("bench", 0644, dent, 0,
+		&ipa3_ipadma_bench_ops))) {
+		IPADMA_ERR("fail to create file bench\n");
+		goto fail;
+	}
 	return;
 fail:
 	debugfs_remove_recursive(dent);
@@ -16,6 +16,10 @@
 #include <linux/list.h>
 #include <linux/netdevice.h>
 #include <linux/msm_gsi.h>
+#include <linux/jhash.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include <net/ip.h>
 #include <net/sock.h>
 #include "ipa_i.h"
 #include "ipa_trace.h"
@@ -92,6 +96,12 @@
 
 #define IPA_QMAP_ID_BYTE 0
 
+#define IPA_RX_SPREAD_MAX 8
+#define IPA_RX_SPREAD_QLEN 4096
+
+/* busy pages at the head of a recycle ring skipped per lookup */
+#define IPA_PAGE_RECYCLE_SCAN 4
+
 static struct sk_buff *ipa3_get_skb_ipa_rx(unsigned int len, gfp_t flags);
 static void ipa3_replenish_wlan_rx_cache(struct ipa3_sys_context *sys);
 static void ipa3_replenish_rx_cache(struct ipa3_sys_context *sys);
@@ -102,6 +112,8 @@ static void ipa3_wq_page_repl(struct work_struct *work);
 static void ipa3_replenish_rx_page_recycle(struct ipa3_sys_context *sys);
 static struct ipa3_rx_pkt_wrapper *ipa3_alloc_rx_pkt_page(gfp_t flag,
 	bool is_tmp_alloc);
+static int ipa3_page_recycle_pcpu_alloc(struct ipa3_sys_context *sys);
+static void ipa3_page_recycle_pcpu_free(struct ipa3_sys_context *sys);
 static void ipa3_wq_handle_rx(struct work_struct *work);
 static void ipa3_wq_rx_common(struct ipa3_sys_context *sys,
 	struct gsi_chan_xfer_notify *notify);
@@ -138,6 +150,8 @@ static unsigned long tag_to_pointer_wa(uint64_t tag);
 static uint64_t pointer_to_tag_wa(struct ipa3_tx_pkt_wrapper *tx_pkt);
 
 static u32 ipa_adjust_ra_buff_base_sz(u32 aggr_byte_limit);
+static void ipa3_rx_spread_init(struct ipa3_sys_context *sys);
+static void ipa3_rx_spread_destroy(struct ipa3_sys_context *sys);
 
 static void ipa3_wq_write_done_common(struct ipa3_sys_context *sys,
 				struct ipa3_tx_pkt_wrapper *tx_pkt)
@@ -1099,6 +1113,14 @@ int ipa3_setup_sys_pipe(struct ipa_sys_connect_params *sys_in, u32 *clnt_hdl)
 	ep->client_notify = sys_in->notify;
 	ep->sys->napi_obj = sys_in->napi_obj;
 	ep->priv = sys_in->priv;
+	if (ep->client == IPA_CLIENT_APPS_WAN_CONS && ep->sys->napi_obj &&
+		ipa3_ctx->wan_rx_spread_cpus && !ep->sys->rx_spread)
+		ipa3_rx_spread_init(ep->sys);
+	ep->sys->rx_list_en = sys_in->rx_list && sys_in->napi_obj;
+	if (ep->sys->rx_list_en) {
+		__skb_queue_head_init(&ep->sys->rx_list.skbs);
+		ep->sys->rx_list.napi = sys_in->napi_obj;
+	}
 	ep->keep_ipa_awake = sys_in->keep_ipa_awake;
 	atomic_set(&ep->avail_fifo_desc,
 		((sys_in->desc_fifo_sz / IPA_FIFO_ELEMENT_SIZE) - 1));
@@ -1175,6 +1197,12 @@ int ipa3_setup_sys_pipe(struct ipa_sys_connect_params *sys_in, u32 *clnt_hdl)
 				sizeof(void *), GFP_KERNEL);
 		atomic_set(&ep->sys->page_recycle_repl->head_idx, 0);
 		atomic_set(&ep->sys->page_recycle_repl->tail_idx, 0);
+		result = ipa3_page_recycle_pcpu_alloc(ep->sys);
+		if (result) {
+			IPAERR("failed to alloc recycle rings for client %d\n",
+				sys_in->client);
+			goto fail_page_recycle_repl;
+		}
 		ep->sys->repl = kzalloc(sizeof(*ep->sys->repl), GFP_KERNEL);
 		if (!ep->sys->repl) {
 			IPAERR("failed to alloc repl for client %d\n",
@@ -1266,6 +1294,7 @@ int ipa3_setup_sys_pipe(struct ipa_sys_connect_params *sys_in, u32 *clnt_hdl)
 	kfree(ep->sys->repl);
 fail_page_recycle_repl:
 	if (ep->sys->page_recycle_repl) {
+		ipa3_page_recycle_pcpu_free(ep->sys);
 		ep->sys->page_recycle_repl->capacity = 0;
 		kfree(ep->sys->page_recycle_repl);
 	}
@@ -1346,6 +1375,12 @@ int ipa3_teardown_sys_pipe(u32 clnt_hdl)
 		} while (atomic_read(&ep->sys->curr_polling_state));
 	}
 
+	if (ep->sys->rx_spread)
+		ipa3_rx_spread_destroy(ep->sys);
+
+	if (ep->sys->rx_list_en)
+		__skb_queue_purge(&ep->sys->rx_list.skbs);
+
 	if (IPA_CLIENT_IS_CONS(ep->client))
 		cancel_delayed_work_sync(&ep->sys->replenish_rx_work);
 	flush_workqueue(ep->sys->wq);
@@ -1908,6 +1943,131 @@ static struct ipa3_rx_pkt_wrapper *ipa3_alloc_rx_pkt_page(
 	return NULL;
 }
 
+/*
+ * Pages of the recycle cache are never freed while the pipe is up. Once
+ * a completion has handed a page to the stack its wrapper goes on the
+ * ring of the CPU the completion ran on, which is the CPU of the pipe's
+ * NAPI poll and so the one replenishing next. A page can be posted
+ * again once the stack let go of it, i.e. its refcount is back at the
+ * one reference the cache holds.
+ */
+static int ipa3_page_recycle_pcpu_alloc(struct ipa3_sys_context *sys)
+{
+	struct ipa3_page_recycle_ring *ring;
+	int cpu;
+
+	sys->page_recycle_pcpu = alloc_percpu(struct ipa3_page_recycle_ring);
+	if (!sys->page_recycle_pcpu)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		ring = per_cpu_ptr(sys->page_recycle_pcpu, cpu);
+		spin_lock_init(&ring->lock);
+		/* every wrapper is on one ring at most, so none can overflow */
+		ring->cache = kcalloc(sys->page_recycle_repl->capacity,
+			sizeof(void *), GFP_KERNEL);
+		if (!ring->cache) {
+			ipa3_page_recycle_pcpu_free(sys);
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+static void ipa3_page_recycle_pcpu_free(struct ipa3_sys_context *sys)
+{
+	int cpu;
+
+	if (!sys->page_recycle_pcpu)
+		return;
+
+	/* the wrappers themselves are owned by page_recycle_repl */
+	for_each_possible_cpu(cpu)
+		kfree(per_cpu_ptr(sys->page_recycle_pcpu, cpu)->cache);
+	free_percpu(sys->page_recycle_pcpu);
+	sys->page_recycle_pcpu = NULL;
+}
+
+static void ipa3_page_recycle_put(struct ipa3_sys_context *sys,
+	struct ipa3_rx_pkt_wrapper *rx_pkt)
+{
+	struct ipa3_page_recycle_ring *ring;
+	u32 capacity = sys->page_recycle_repl->capacity;
+
+	ring = get_cpu_ptr(sys->page_recycle_pcpu);
+	spin_lock_bh(&ring->lock);
+	if (!WARN_ON_ONCE(ring->cnt == capacity)) {
+		ring->cache[(ring->head + ring->cnt) % capacity] = rx_pkt;
+		ring->cnt++;
+	}
+	spin_unlock_bh(&ring->lock);
+	put_cpu_ptr(sys->page_recycle_pcpu);
+}
+
+/* called with bottom halves disabled */
+static struct ipa3_rx_pkt_wrapper *ipa3_page_recycle_take(
+	struct ipa3_page_recycle_ring *ring, u32 capacity)
+{
+	struct ipa3_rx_pkt_wrapper *rx_pkt;
+	u32 i;
+
+	spin_lock(&ring->lock);
+	for (i = 0; i < IPA_PAGE_RECYCLE_SCAN && i < ring->cnt; i++) {
+		rx_pkt = ring->cache[ring->head];
+		ring->head = (ring->head + 1) % capacity;
+		if (page_ref_count(rx_pkt->page_data.page) == 1) {
+			ring->cnt--;
+			spin_unlock(&ring->lock);
+			return rx_pkt;
+		}
+		/* still held by the stack, give it more time at the back */
+		ring->cache[(ring->head + ring->cnt - 1) % capacity] = rx_pkt;
+	}
+	spin_unlock(&ring->lock);
+
+	return NULL;
+}
+
+static struct ipa3_rx_pkt_wrapper *ipa3_page_recycle_get(
+	struct ipa3_sys_context *sys, u32 stats_i)
+{
+	struct ipa3_rx_pkt_wrapper *rx_pkt;
+	u32 capacity = sys->page_recycle_repl->capacity;
+	int this_cpu = smp_processor_id();
+	int cpu;
+
+	rx_pkt = ipa3_page_recycle_take(
+		per_cpu_ptr(sys->page_recycle_pcpu, this_cpu), capacity);
+	if (rx_pkt) {
+		ipa3_ctx->stats.page_recycle_stats[stats_i].local_hit++;
+		return rx_pkt;
+	}
+
+	/* the NAPI poll may have moved, pick up what is left elsewhere */
+	for_each_possible_cpu(cpu) {
+		if (cpu == this_cpu)
+			continue;
+		rx_pkt = ipa3_page_recycle_take(
+			per_cpu_ptr(sys->page_recycle_pcpu, cpu), capacity);
+		if (rx_pkt) {
+			ipa3_ctx->stats.page_recycle_stats[stats_i].remote_hit++;
+			return rx_pkt;
+		}
+	}
+
+	return NULL;
+}
+
+static void ipa3_recycle_rx_page_wrapper(struct ipa3_rx_pkt_wrapper *rx_pkt)
+{
+	/* a temporary page now belongs to the skb, only the wrapper goes */
+	if (rx_pkt->page_data.is_tmp_alloc)
+		kmem_cache_free(ipa3_ctx->rx_pkt_wrapper_cache, rx_pkt);
+	else
+		ipa3_page_recycle_put(rx_pkt->sys, rx_pkt);
+}
+
 static void ipa3_replenish_rx_page_cache(struct ipa3_sys_context *sys)
 {
 	struct ipa3_rx_pkt_wrapper *rx_pkt;
@@ -1922,6 +2082,7 @@ static void ipa3_replenish_rx_page_cache(struct ipa3_sys_context *sys)
 		}
 		rx_pkt->sys = sys;
 		sys->page_recycle_repl->cache[curr] = rx_pkt;
+		ipa3_page_recycle_put(sys, rx_pkt);
 	}
 
 	return;
@@ -1996,10 +2157,9 @@ static void ipa3_replenish_rx_page_recycle(struct ipa3_sys_context *sys)
 	int ret;
 	int rx_len_cached = 0;
 	struct gsi_xfer_elem gsi_xfer_elem_array[IPA_REPL_XFER_MAX];
-	u32 curr;
 	u32 curr_wq;
 	int idx = 0;
-	struct page *cur_page;
+	bool recycle = true;
 	u32 stats_i = 0;
 
 	/* start replenish only when buffers go lower than the threshold */
@@ -2009,24 +2169,24 @@ static void ipa3_replenish_rx_page_recycle(struct ipa3_sys_context *sys)
 
 	spin_lock_bh(&sys->spinlock);
 	rx_len_cached = sys->len;
-	curr = atomic_read(&sys->page_recycle_repl->head_idx);
 	curr_wq = atomic_read(&sys->repl->head_idx);
 
 	while (rx_len_cached < sys->rx_pool_sz) {
-		cur_page = sys->page_recycle_repl->cache[curr]->page_data.page;
+		rx_pkt = recycle ? ipa3_page_recycle_get(sys, stats_i) : NULL;
 		/* Found an idle page that can be used */
-		if (page_ref_count(cur_page) == 1) {
-			page_ref_inc(cur_page);
-			rx_pkt = sys->page_recycle_repl->cache[curr];
-			curr = (++curr == sys->page_recycle_repl->capacity) ?
-								0 : curr;
+		if (rx_pkt) {
+			page_ref_inc(rx_pkt->page_data.page);
 		} else {
 			/*
-			 * Could not find idle page at curr index.
-			 * Allocate a new one.
+			 * No idle page left, don't look again this round.
+			 * Use one allocated by the replenish work instead.
 			 */
-			if (curr_wq == atomic_read(&sys->repl->tail_idx))
+			recycle = false;
+			if (curr_wq == atomic_read(&sys->repl->tail_idx)) {
+				ipa3_ctx->stats.page_recycle_stats[
+					stats_i].starved++;
 				break;
+			}
 			ipa3_ctx->stats.page_recycle_stats[stats_i].tmp_alloc++;
 			rx_pkt = sys->repl->cache[curr_wq];
 			curr_wq = (++curr_wq == sys->repl->capacity) ?
@@ -2069,7 +2229,6 @@ static void ipa3_replenish_rx_page_recycle(struct ipa3_sys_context *sys)
 		/* ensure write is done before setting head index */
 		mb();
 		atomic_set(&sys->repl->head_idx, curr_wq);
-		atomic_set(&sys->page_recycle_repl->head_idx, curr);
 		sys->len = rx_len_cached;
 	} else {
 		/* we don't expect this will happen */
@@ -2476,8 +2635,11 @@ static void ipa3_fast_replenish_rx_cache(struct ipa3_sys_context *sys)
 	curr = atomic_read(&sys->repl->head_idx);
 
 	while (rx_len_cached < sys->rx_pool_sz) {
-		if (curr == atomic_read(&sys->repl->tail_idx))
+		if (curr == atomic_read(&sys->repl->tail_idx)) {
+			/* the replenish work did not keep up */
+			IPA_STATS_INC_CNT(ipa3_ctx->stats.fast_repl_starved);
 			break;
+		}
 		rx_pkt = sys->repl->cache[curr];
 		gsi_xfer_elem_array[idx].addr = rx_pkt->data.dma_addr;
 		gsi_xfer_elem_array[idx].len = sys->rx_buff_sz;
@@ -2670,6 +2832,7 @@ static void ipa3_cleanup_rx(struct ipa3_sys_context *sys)
 					rx_pkt);
 			}
 		}
+		ipa3_page_recycle_pcpu_free(sys);
 		kfree(sys->page_recycle_repl->cache);
 		kfree(sys->page_recycle_repl);
 	}
@@ -2992,6 +3155,266 @@ static struct sk_buff *ipa3_join_prev_skb(struct sk_buff *prev_skb,
 	return skb2;
 }
 
+/*
+ * WAN RX spreading: with qcom,wan-rx-spread-cpus set, the packets parsed
+ * out of the WAN pipe are not handed to the client from the pipe's NAPI
+ * poll but queued to one of several NAPI instances, one per CPU in the
+ * mask. The instance is picked by a hash of the IP flow so that a flow
+ * always lands on the same CPU and stays in order.
+ */
+struct ipa3_rx_spread {
+	struct napi_struct napi;
+	struct sk_buff_head queue;
+	call_single_data_t csd;
+	struct ipa3_sys_context *sys;
+	int cpu;
+	u64 pkts;
+	u64 polls;
+	u64 budget_exhausted;
+	u64 drops;
+};
+
+struct ipa3_rx_spread_ctx {
+	struct net_device napi_dev;
+	unsigned int num;
+	struct ipa3_rx_spread inst[IPA_RX_SPREAD_MAX];
+};
+
+/* skb->data points at the QMAP header in front of the IP packet */
+static u32 ipa3_rx_spread_hash(struct sk_buff *skb)
+{
+	unsigned int off = IPA_QMAP_HEADER_LENGTH;
+	u32 hash, ports = 0;
+	u8 proto;
+
+	if (skb_headlen(skb) < off + sizeof(struct iphdr))
+		return 0;
+
+	switch (skb->data[off] >> 4) {
+	case 4: {
+		struct iphdr *iph = (struct iphdr *)(skb->data + off);
+
+		proto = iph->protocol;
+		hash = jhash_3words((__force u32)iph->saddr,
+			(__force u32)iph->daddr, proto, 0);
+		/* keep all fragments of a packet together */
+		if (ip_is_fragment(iph))
+			return hash;
+		off += iph->ihl * 4;
+		break;
+	}
+	case 6: {
+		struct ipv6hdr *ip6h = (struct ipv6hdr *)(skb->data + off);
+
+		if (skb_headlen(skb) < off + sizeof(*ip6h))
+			return 0;
+		proto = ip6h->nexthdr;
+		/* saddr and daddr are adjacent, 8 words in total */
+		hash = jhash2((u32 *)&ip6h->saddr, 8, proto);
+		off += sizeof(*ip6h);
+		break;
+	}
+	default:
+		return 0;
+	}
+
+	if ((proto == IPPROTO_TCP || proto == IPPROTO_UDP) &&
+		skb_headlen(skb) >= off + sizeof(ports))
+		ports = *(u32 *)(skb->data + off);
+
+	return jhash_1word(ports, hash);
+}
+
+static int ipa3_rx_spread_poll(struct napi_struct *napi, int budget)
+{
+	struct ipa3_rx_spread *rs =
+		container_of(napi, struct ipa3_rx_spread, napi);
+	struct ipa3_ep_context *ep = rs->sys->ep;
+	struct ipa_rx_list list;
+	struct sk_buff *skb;
+	int done = 0;
+
+	__skb_queue_head_init(&list.skbs);
+	list.napi = napi;
+
+	rs->polls++;
+	while (done < budget && (skb = skb_dequeue(&rs->queue))) {
+		if (rs->sys->rx_list_en)
+			__skb_queue_tail(&list.skbs, skb);
+		else
+			ep->client_notify(ep->priv, IPA_RECEIVE,
+				(unsigned long)skb);
+		done++;
+	}
+	rs->pkts += done;
+
+	if (!skb_queue_empty(&list.skbs))
+		ep->client_notify(ep->priv, IPA_RECEIVE_LIST,
+			(unsigned long)&list);
+
+	if (done == budget) {
+		rs->budget_exhausted++;
+		return done;
+	}
+
+	napi_complete_done(napi, done);
+	/* a packet queued while we were completing found us still scheduled */
+	if (!skb_queue_empty(&rs->queue))
+		napi_schedule(napi);
+
+	return done;
+}
+
+static void ipa3_rx_spread_kick(void *info)
+{
+	struct ipa3_rx_spread *rs = info;
+
+	__napi_schedule(&rs->napi);
+}
+
+static void ipa3_rx_spread_queue(struct ipa3_sys_context *sys,
+		struct sk_buff *skb)
+{
+	struct ipa3_rx_spread_ctx *ctx = sys->rx_spread;
+	struct ipa3_rx_spread *rs;
+
+	rs = &ctx->inst[reciprocal_scale(ipa3_rx_spread_hash(skb), ctx->num)];
+	if (skb_queue_len(&rs->queue) >= IPA_RX_SPREAD_QLEN) {
+		rs->drops++;
+		dev_kfree_skb_any(skb);
+		return;
+	}
+
+	skb_queue_tail(&rs->queue, skb);
+
+	/* only the first packet after the poll went idle has to kick it */
+	if (!napi_schedule_prep(&rs->napi))
+		return;
+
+	if (rs->cpu == smp_processor_id() ||
+		smp_call_function_single_async(rs->cpu, &rs->csd))
+		__napi_schedule(&rs->napi);
+}
+
+static void ipa3_rx_spread_init(struct ipa3_sys_context *sys)
+{
+	struct ipa3_rx_spread_ctx *ctx;
+	u32 budget = clamp_t(u32, ipa3_ctx->wan_rx_spread_budget, 1,
+		NAPI_POLL_WEIGHT);
+	int cpu;
+
+	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx) {
+		IPAERR("failed to alloc WAN RX spread ctx\n");
+		return;
+	}
+
+	init_dummy_netdev(&ctx->napi_dev);
+
+	for_each_possible_cpu(cpu) {
+		struct ipa3_rx_spread *rs = &ctx->inst[ctx->num];
+
+		if (!(ipa3_ctx->wan_rx_spread_cpus & BIT(cpu)))
+			continue;
+
+		rs->sys = sys;
+		rs->cpu = cpu;
+		rs->csd.func = ipa3_rx_spread_kick;
+		rs->csd.info = rs;
+		skb_queue_head_init(&rs->queue);
+		netif_napi_add(&ctx->napi_dev, &rs->napi, ipa3_rx_spread_poll,
+			budget);
+		napi_enable(&rs->napi);
+
+		if (++ctx->num == IPA_RX_SPREAD_MAX)
+			break;
+	}
+
+	if (!ctx->num) {
+		IPAERR("no usable CPU in WAN RX spread mask 0x%x\n",
+			ipa3_ctx->wan_rx_spread_cpus);
+		kfree(ctx);
+		return;
+	}
+
+	IPADBG("spreading WAN RX over %u NAPI instances\n", ctx->num);
+	sys->rx_spread = ctx;
+}
+
+/* The pipe must not be polled anymore */
+static void ipa3_rx_spread_destroy(struct ipa3_sys_context *sys)
+{
+	struct ipa3_rx_spread_ctx *ctx = sys->rx_spread;
+	unsigned int i;
+
+	for (i = 0; i < ctx->num; i++) {
+		napi_disable(&ctx->inst[i].napi);
+		netif_napi_del(&ctx->inst[i].napi);
+		skb_queue_purge(&ctx->inst[i].queue);
+	}
+
+	sys->rx_spread = NULL;
+	kfree(ctx);
+}
+
+int ipa3_rx_spread_stats(char *buf, int size)
+{
+	struct ipa3_rx_spread_ctx *ctx = NULL;
+	int ep_idx, cnt = 0;
+	unsigned int i;
+
+	ep_idx = ipa3_get_ep_mapping(IPA_CLIENT_APPS_WAN_CONS);
+	if (ep_idx != IPA_EP_NOT_ALLOCATED && ipa3_ctx->ep[ep_idx].sys)
+		ctx = ipa3_ctx->ep[ep_idx].sys->rx_spread;
+
+	if (!ctx)
+		return scnprintf(buf, size, "WAN RX spreading is off\n");
+
+	for (i = 0; i < ctx->num; i++) {
+		struct ipa3_rx_spread *rs = &ctx->inst[i];
+
+		cnt += scnprintf(buf + cnt, size - cnt,
+			"napi %u: cpu=%d budget=%d pkts=%llu polls=%llu budget_exhausted=%llu drops=%llu queued=%u\n",
+			i, rs->cpu, rs->napi.weight, rs->pkts, rs->polls,
+			rs->budget_exhausted, rs->drops,
+			skb_queue_len(&rs->queue));
+	}
+
+	return cnt;
+}
+
+/*
+ * In NAPI mode a client that asked for it gets the packets of a whole poll
+ * at once, see ipa3_rx_list_flush()
+ */
+static void ipa3_wan_rx_deliver_one(struct ipa3_sys_context *sys,
+		struct sk_buff *skb)
+{
+	if (sys->rx_list_en)
+		__skb_queue_tail(&sys->rx_list.skbs, skb);
+	else
+		sys->ep->client_notify(sys->ep->priv, IPA_RECEIVE,
+			(unsigned long)(skb));
+}
+
+static void ipa3_wan_rx_deliver(struct ipa3_sys_context *sys,
+		struct sk_buff *skb)
+{
+	if (sys->rx_spread)
+		ipa3_rx_spread_queue(sys, skb);
+	else
+		ipa3_wan_rx_deliver_one(sys, skb);
+}
+
+static void ipa3_rx_list_flush(struct ipa3_sys_context *sys)
+{
+	if (!sys->rx_list_en || skb_queue_empty(&sys->rx_list.skbs))
+		return;
+
+	sys->ep->client_notify(sys->ep->priv, IPA_RECEIVE_LIST,
+		(unsigned long)&sys->rx_list);
+}
+
 static void ipa3_wan_rx_handle_splt_pyld(struct sk_buff *skb,
 		struct ipa3_sys_context *sys)
 {
@@ -3008,9 +3431,7 @@ static void ipa3_wan_rx_handle_splt_pyld(struct sk_buff *skb,
 				skb_pull(skb2, ipahal_pkt_status_get_size());
 				skb2->truesize = skb2->len +
 					sizeof(struct sk_buff);
-				sys->ep->client_notify(sys->ep->priv,
-					IPA_RECEIVE,
-					(unsigned long)(skb2));
+				ipa3_wan_rx_deliver(sys, skb2);
 			}
 		}
 		skb_pull(skb, sys->len_rem);
@@ -3051,8 +3472,7 @@ static int ipa3_wan_rx_pyld_hdlr(struct sk_buff *skb,
 	}
 
 	if (ipa3_ctx->ipa_client_apps_wan_cons_agg_gro) {
-		sys->ep->client_notify(sys->ep->priv,
-			IPA_RECEIVE, (unsigned long)(skb));
+		ipa3_wan_rx_deliver_one(sys, skb);
 		return rc;
 	}
 	if (sys->repl_hdlr == ipa3_replenish_rx_cache_recycle) {
@@ -3172,8 +3592,7 @@ static int ipa3_wan_rx_pyld_hdlr(struct sk_buff *skb,
 					sizeof(struct sk_buff) +
 					(ALIGN(frame_len, 32) *
 					 unused / used_align);
-				sys->ep->client_notify(sys->ep->priv,
-					IPA_RECEIVE, (unsigned long)(skb2));
+				ipa3_wan_rx_deliver(sys, skb2);
 				skb_pull(skb, frame_len);
 			}
 		} else {
@@ -3780,7 +4199,7 @@ static int ipa3_assign_policy(struct ipa_sys_connect_params *in,
 							ipa3_wq_page_repl);
 					sys->pyld_hdlr = ipa3_wan_rx_pyld_hdlr;
 					sys->free_rx_wrapper =
-						NULL;
+					ipa3_recycle_rx_page_wrapper;
 					sys->repl_hdlr =
 						ipa3_replenish_rx_page_recycle;
 					sys->rx_pool_sz =
@@ -4946,6 +5365,7 @@ int ipa3_rx_poll(u32 clnt_hdl, int weight)
 		}
 	}
 	cnt += weight - remain_aggr_weight * IPA_WAN_AGGR_PKT_CNT;
+	ipa3_rx_list_flush(ep->sys);
 	/* call repl_hdlr before napi_reschedule / napi_complete */
 	ep->sys->repl_hdlr(ep->sys);
 
@@ -11,6 +11,7 @@
  */
 
 #include "ipa_i.h"
+#include "ipa_trace.h"
 #include "ipahal/ipahal.h"
 #include "ipahal/ipahal_fltrt.h"
 
@@ -486,10 +487,10 @@ int __ipa_commit_flt_v3(enum ipa_ip_type ip)
 {
 	struct ipahal_fltrt_alloc_imgs_params alloc_params;
 	int rc = 0;
-	struct ipa3_desc *desc;
+	struct ipa3_desc *desc = NULL;
 	struct ipahal_imm_cmd_register_write reg_write_cmd = {0};
 	struct ipahal_imm_cmd_dma_shared_mem mem_cmd = {0};
-	struct ipahal_imm_cmd_pyld **cmd_pyld;
+	struct ipahal_imm_cmd_pyld **cmd_pyld = NULL;
 	int num_cmd = 0;
 	int i;
 	int hdr_idx;
@@ -502,6 +503,11 @@ int __ipa_commit_flt_v3(enum ipa_ip_type ip)
 	struct ipa3_flt_tbl *tbl;
 	u16 entries;
 	struct ipahal_imm_cmd_register_write reg_write_coal_close;
+	struct ipa3_fltrt_shadow *shadow = ipa3_ctx->flt_shadow[ip];
+	u32 ofst[IPA_FLTRT_IMG_MAX] = { 0 };
+	u32 len[IPA_FLTRT_IMG_MAX] = { 0 };
+	u32 img_bytes = 0, dma_bytes = 0;
+	u32 hdr_ofst, hdr_len;
 
 	tbl_hdr_width = ipahal_get_hw_tbl_hdr_width();
 	memset(&alloc_params, 0, sizeof(alloc_params));
@@ -578,6 +584,45 @@ int __ipa_commit_flt_v3(enum ipa_ip_type ip)
 		goto fail_size_valid;
 	}
 
+	/*
+	 * Only what changed since the last commit is written to SRAM. The
+	 * headers are diffed per pipe below, here only to learn whether
+	 * anything hashable changed at all.
+	 */
+	len[IPA_FLTRT_IMG_NHASH_HDR] = ipa3_fltrt_img_diff(
+		&shadow[IPA_FLTRT_IMG_NHASH_HDR], &alloc_params.nhash_hdr,
+		0, alloc_params.nhash_hdr.size, &ofst[IPA_FLTRT_IMG_NHASH_HDR]);
+	if (!ipa3_ctx->ipa_fltrt_not_hashable)
+		len[IPA_FLTRT_IMG_HASH_HDR] = ipa3_fltrt_img_diff(
+			&shadow[IPA_FLTRT_IMG_HASH_HDR],
+			&alloc_params.hash_hdr, 0, alloc_params.hash_hdr.size,
+			&ofst[IPA_FLTRT_IMG_HASH_HDR]);
+	if (lcl_nhash) {
+		img_bytes += alloc_params.nhash_bdy.size;
+		len[IPA_FLTRT_IMG_NHASH_BDY] = ipa3_fltrt_img_diff(
+			&shadow[IPA_FLTRT_IMG_NHASH_BDY],
+			&alloc_params.nhash_bdy, 0, alloc_params.nhash_bdy.size,
+			&ofst[IPA_FLTRT_IMG_NHASH_BDY]);
+		dma_bytes += len[IPA_FLTRT_IMG_NHASH_BDY];
+	}
+	if (lcl_hash) {
+		img_bytes += alloc_params.hash_bdy.size;
+		len[IPA_FLTRT_IMG_HASH_BDY] = ipa3_fltrt_img_diff(
+			&shadow[IPA_FLTRT_IMG_HASH_BDY],
+			&alloc_params.hash_bdy, 0, alloc_params.hash_bdy.size,
+			&ofst[IPA_FLTRT_IMG_HASH_BDY]);
+		dma_bytes += len[IPA_FLTRT_IMG_HASH_BDY];
+	}
+
+	if (!len[IPA_FLTRT_IMG_NHASH_HDR] && !len[IPA_FLTRT_IMG_HASH_HDR] &&
+		!dma_bytes) {
+		IPADBG_LOW("flt tbls unchanged, nothing to commit. IP %d\n",
+			ip);
+		trace_ipa3_fltrt_commit(false, ip, alloc_params.nhash_hdr.size +
+			alloc_params.hash_hdr.size + img_bytes, 0, 0);
+		goto reap;
+	}
+
 	/* +4: 2 for bodies (hashable and non-hashable), 1 for flushing and 1
 	 * for closing the colaescing frame
 	 */
@@ -614,7 +659,8 @@ int __ipa_commit_flt_v3(enum ipa_ip_type ip)
 	 * SRAM memory not allocated to hash tables. Sending
 	 * command to hash tables(filer/routing) operation not supported.
 	 */
-	if (!ipa3_ctx->ipa_fltrt_not_hashable) {
+	if (!ipa3_ctx->ipa_fltrt_not_hashable &&
+		(len[IPA_FLTRT_IMG_HASH_HDR] || len[IPA_FLTRT_IMG_HASH_BDY])) {
 		/* flushing ipa internal hashable flt rules cache */
 		memset(&flush, 0, sizeof(flush));
 		if (ip == IPA_IP_v4)
@@ -663,30 +709,48 @@ int __ipa_commit_flt_v3(enum ipa_ip_type ip)
 		IPADBG_LOW("Prepare imm cmd for hdr at index %d for pipe %d\n",
 			hdr_idx, i);
 
-		mem_cmd.is_read = false;
-		mem_cmd.skip_pipeline_clear = false;
-		mem_cmd.pipeline_clear_options = IPAHAL_HPS_CLEAR;
-		mem_cmd.size = tbl_hdr_width;
-		mem_cmd.system_addr = alloc_params.nhash_hdr.phys_base +
-			hdr_idx * tbl_hdr_width;
-		mem_cmd.local_addr = lcl_nhash_hdr +
-			hdr_idx * tbl_hdr_width;
-		cmd_pyld[num_cmd] = ipahal_construct_imm_cmd(
-			IPA_IMM_CMD_DMA_SHARED_MEM, &mem_cmd, false);
-		if (!cmd_pyld[num_cmd]) {
-			IPAERR("fail construct dma_shared_mem cmd: IP = %d\n",
-				ip);
-			rc = -ENOMEM;
-			goto fail_imm_cmd_construct;
+		img_bytes += tbl_hdr_width;
+		hdr_len = ipa3_fltrt_img_diff(&shadow[IPA_FLTRT_IMG_NHASH_HDR],
+			&alloc_params.nhash_hdr, hdr_idx * tbl_hdr_width,
+			tbl_hdr_width, &hdr_ofst);
+		if (hdr_len) {
+			mem_cmd.is_read = false;
+			mem_cmd.skip_pipeline_clear = false;
+			mem_cmd.pipeline_clear_options = IPAHAL_HPS_CLEAR;
+			mem_cmd.size = tbl_hdr_width;
+			mem_cmd.system_addr = alloc_params.nhash_hdr.phys_base +
+				hdr_idx * tbl_hdr_width;
+			mem_cmd.local_addr = lcl_nhash_hdr +
+				hdr_idx * tbl_hdr_width;
+			cmd_pyld[num_cmd] = ipahal_construct_imm_cmd(
+				IPA_IMM_CMD_DMA_SHARED_MEM, &mem_cmd, false);
+			if (!cmd_pyld[num_cmd]) {
+				IPAERR(
+				"fail construct dma_shared_mem cmd: IP = %d\n",
+					ip);
+				rc = -ENOMEM;
+				goto fail_imm_cmd_construct;
+			}
+			ipa3_init_imm_cmd_desc(&desc[num_cmd],
+				cmd_pyld[num_cmd]);
+			++num_cmd;
+			dma_bytes += tbl_hdr_width;
 		}
-		ipa3_init_imm_cmd_desc(&desc[num_cmd], cmd_pyld[num_cmd]);
-		++num_cmd;
 
 		/*
 		 * SRAM memory not allocated to hash tables. Sending command
 		 * to hash tables(filer/routing) operation not supported.
 		 */
 		if (!ipa3_ctx->ipa_fltrt_not_hashable) {
+			img_bytes += tbl_hdr_width;
+			hdr_len = ipa3_fltrt_img_diff(
+				&shadow[IPA_FLTRT_IMG_HASH_HDR],
+				&alloc_params.hash_hdr,
+				hdr_idx * tbl_hdr_width, tbl_hdr_width,
+				&hdr_ofst);
+		}
+		if (!ipa3_ctx->ipa_fltrt_not_hashable && hdr_len) {
+			dma_bytes += tbl_hdr_width;
 			mem_cmd.is_read = false;
 			mem_cmd.skip_pipeline_clear = false;
 			mem_cmd.pipeline_clear_options = IPAHAL_HPS_CLEAR;
@@ -712,7 +776,7 @@ int __ipa_commit_flt_v3(enum ipa_ip_type ip)
 		++hdr_idx;
 	}
 
-	if (lcl_nhash) {
+	if (len[IPA_FLTRT_IMG_NHASH_BDY]) {
 		if (num_cmd >= entries) {
 			IPAERR("number of commands is out of range: IP = %d\n",
 				ip);
@@ -723,9 +787,11 @@ int __ipa_commit_flt_v3(enum ipa_ip_type ip)
 		mem_cmd.is_read = false;
 		mem_cmd.skip_pipeline_clear = false;
 		mem_cmd.pipeline_clear_options = IPAHAL_HPS_CLEAR;
-		mem_cmd.size = alloc_params.nhash_bdy.size;
-		mem_cmd.system_addr = alloc_params.nhash_bdy.phys_base;
-		mem_cmd.local_addr = lcl_nhash_bdy;
+		mem_cmd.size = len[IPA_FLTRT_IMG_NHASH_BDY];
+		mem_cmd.system_addr = alloc_params.nhash_bdy.phys_base +
+			ofst[IPA_FLTRT_IMG_NHASH_BDY];
+		mem_cmd.local_addr = lcl_nhash_bdy +
+			ofst[IPA_FLTRT_IMG_NHASH_BDY];
 		cmd_pyld[num_cmd] = ipahal_construct_imm_cmd(
 			IPA_IMM_CMD_DMA_SHARED_MEM, &mem_cmd, false);
 		if (!cmd_pyld[num_cmd]) {
@@ -737,7 +803,7 @@ int __ipa_commit_flt_v3(enum ipa_ip_type ip)
 		ipa3_init_imm_cmd_desc(&desc[num_cmd], cmd_pyld[num_cmd]);
 		++num_cmd;
 	}
-	if (lcl_hash) {
+	if (len[IPA_FLTRT_IMG_HASH_BDY]) {
 		if (num_cmd >= entries) {
 			IPAERR("number of commands is out of range: IP = %d\n",
 				ip);
@@ -748,9 +814,11 @@ int __ipa_commit_flt_v3(enum ipa_ip_type ip)
 		mem_cmd.is_read = false;
 		mem_cmd.skip_pipeline_clear = false;
 		mem_cmd.pipeline_clear_options = IPAHAL_HPS_CLEAR;
-		mem_cmd.size = alloc_params.hash_bdy.size;
-		mem_cmd.system_addr = alloc_params.hash_bdy.phys_base;
-		mem_cmd.local_addr = lcl_hash_bdy;
+		mem_cmd.size = len[IPA_FLTRT_IMG_HASH_BDY];
+		mem_cmd.system_addr = alloc_params.hash_bdy.phys_base +
+			ofst[IPA_FLTRT_IMG_HASH_BDY];
+		mem_cmd.local_addr = lcl_hash_bdy +
+			ofst[IPA_FLTRT_IMG_HASH_BDY];
 		cmd_pyld[num_cmd] = ipahal_construct_imm_cmd(
 			IPA_IMM_CMD_DMA_SHARED_MEM, &mem_cmd, false);
 		if (!cmd_pyld[num_cmd]) {
@@ -765,10 +833,26 @@ int __ipa_commit_flt_v3(enum ipa_ip_type ip)
 
 	if (ipa3_send_cmd(num_cmd, desc)) {
 		IPAERR("fail to send immediate command\n");
+		/* SRAM may be partially written */
+		ipa3_fltrt_shadow_reset(shadow, IPA_FLTRT_IMG_MAX);
 		rc = -EFAULT;
 		goto fail_imm_cmd_construct;
 	}
 
+	trace_ipa3_fltrt_commit(false, ip, img_bytes, dma_bytes, num_cmd);
+
+	ipa3_fltrt_shadow_save(&shadow[IPA_FLTRT_IMG_NHASH_HDR],
+		&alloc_params.nhash_hdr);
+	if (!ipa3_ctx->ipa_fltrt_not_hashable)
+		ipa3_fltrt_shadow_save(&shadow[IPA_FLTRT_IMG_HASH_HDR],
+			&alloc_params.hash_hdr);
+	if (lcl_nhash)
+		ipa3_fltrt_shadow_save(&shadow[IPA_FLTRT_IMG_NHASH_BDY],
+			&alloc_params.nhash_bdy);
+	if (lcl_hash)
+		ipa3_fltrt_shadow_save(&shadow[IPA_FLTRT_IMG_HASH_BDY],
+			&alloc_params.hash_bdy);
+
 	IPADBG_LOW("Hashable HEAD\n");
 	IPA_DUMP_BUFF(alloc_params.hash_hdr.base,
 		alloc_params.hash_hdr.phys_base, alloc_params.hash_hdr.size);
@@ -791,6 +875,7 @@ int __ipa_commit_flt_v3(enum ipa_ip_type ip)
 			alloc_params.nhash_bdy.size);
 	}
 
+reap:
 	__ipa_reap_sys_flt_tbls(ip, IPA_RULE_HASHABLE);
 	__ipa_reap_sys_flt_tbls(ip, IPA_RULE_NON_HASHABLE);
 
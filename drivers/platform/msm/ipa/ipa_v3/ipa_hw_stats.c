@@ -13,6 +13,8 @@
 #include <linux/debugfs.h>
 #include <linux/kernel.h>
 #include <linux/delay.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
 #include "ipa_i.h"
 #include "ipahal/ipahal.h"
 #include "ipahal/ipahal_hw_stats.h"
@@ -22,6 +24,10 @@
 		ipa3_get_ep_mapping(client) < IPA_STATS_MAX_PIPE_BIT) ? \
 		(1 << ipa3_get_ep_mapping(client)) : 0)
 
+#define IPA_HW_STATS_SHM_PERIOD_MS_DEFAULT 1000
+
+static void ipa_hw_stats_shm_work(struct work_struct *work);
+
 int ipa_hw_stats_init(void)
 {
 	int ret = 0, ep_index;
@@ -33,6 +39,11 @@ int ipa_hw_stats_init(void)
 	/* initialize stats here */
 	ipa3_ctx->hw_stats.enabled = true;
 
+	mutex_init(&ipa3_ctx->hw_stats.shm.lock);
+	ipa3_ctx->hw_stats.shm.period_ms = IPA_HW_STATS_SHM_PERIOD_MS_DEFAULT;
+	INIT_DELAYED_WORK(&ipa3_ctx->hw_stats.shm.work,
+		ipa_hw_stats_shm_work);
+
 	teth_stats_init = kzalloc(sizeof(*teth_stats_init), GFP_KERNEL);
 	if (!teth_stats_init) {
 		IPAERR("mem allocated failed!\n");
@@ -315,6 +326,190 @@ int ipa_init_quota_stats(u32 pipe_bitmask)
 	return ret;
 }
 
+/*
+ * Stats a data usage daemon polls are published in a read-only mapping of
+ * the ipa device, which is refreshed every period_ms while it is mapped.
+ * Readers retry while the sequence number is odd or changed under them,
+ * so a query costs no syscall, no copy and no lock on the reader's side.
+ */
+static void ipa_hw_stats_shm_fill_teth(struct ipa_hw_stats_shm *shm)
+{
+	struct ipahal_stats_init_tethering *init =
+		&ipa3_ctx->hw_stats.teth.init;
+	struct ipa_quota_stats *sum;
+	struct ipa_hw_stats_shm_teth *teth;
+	int i, j, prod_idx, cons_idx;
+	u32 n = 0;
+
+	for (i = 0; i < IPA_CLIENT_MAX; i++) {
+		prod_idx = ipa3_get_ep_mapping(i);
+		if (!IPA_CLIENT_IS_PROD(i) || prod_idx == -1 ||
+			prod_idx >= IPA3_MAX_NUM_PIPES ||
+			!(init->prod_bitmask & (1 << prod_idx)))
+			continue;
+
+		for (j = 0; j < IPA_CLIENT_MAX; j++) {
+			cons_idx = ipa3_get_ep_mapping(j);
+			if (!IPA_CLIENT_IS_CONS(j) || cons_idx == -1 ||
+				cons_idx >= IPA3_MAX_NUM_PIPES ||
+				!(init->cons_bitmask[prod_idx] &
+				(1 << cons_idx)))
+				continue;
+
+			if (n == IPA_HW_STATS_SHM_MAX_TETH)
+				goto out;
+
+			sum = &ipa3_ctx->hw_stats.teth.prod_stats_sum[i].client[j];
+			teth = &shm->teth[n++];
+			teth->prod = i;
+			teth->cons = j;
+			teth->stats.num_ipv4_bytes = sum->num_ipv4_bytes;
+			teth->stats.num_ipv6_bytes = sum->num_ipv6_bytes;
+			teth->stats.num_ipv4_pkts = sum->num_ipv4_pkts;
+			teth->stats.num_ipv6_pkts = sum->num_ipv6_pkts;
+		}
+	}
+out:
+	shm->num_teth = n;
+}
+
+static void ipa_hw_stats_shm_update(struct ipa_hw_stats_shm *shm)
+{
+	struct ipa_quota_stats *quota;
+	struct ipa_drop_stats *drop;
+	struct ipa_ioc_flt_rt_query query = { 0 };
+	struct ipa_flt_rt_stats *flt_rt = NULL;
+	int i;
+
+	IPA_ACTIVE_CLIENTS_INC_SIMPLE();
+	ipa_get_quota_stats(NULL);
+	ipa_get_drop_stats(NULL);
+	ipa_get_teth_stats();
+	if (ipa3_ctx->ipa_hw_type >= IPA_HW_v4_5) {
+		flt_rt = kcalloc(IPA_MAX_FLT_RT_CNT_INDEX, sizeof(*flt_rt),
+			GFP_KERNEL);
+		if (flt_rt) {
+			query.start_id = 1;
+			query.end_id = IPA_MAX_FLT_RT_CNT_INDEX;
+			query.stats_size = sizeof(*flt_rt);
+			query.stats = (uintptr_t)flt_rt;
+			if (ipa_get_flt_rt_stats(&query)) {
+				kfree(flt_rt);
+				flt_rt = NULL;
+			}
+		}
+	}
+	IPA_ACTIVE_CLIENTS_DEC_SIMPLE();
+
+	WRITE_ONCE(shm->seq, shm->seq + 1);
+	smp_wmb();
+
+	for (i = 0; i < IPA_CLIENT_MAX; i++) {
+		quota = &ipa3_ctx->hw_stats.quota.stats.client[i];
+		drop = &ipa3_ctx->hw_stats.drop.stats.client[i];
+		shm->pipe[i].num_ipv4_bytes = quota->num_ipv4_bytes;
+		shm->pipe[i].num_ipv6_bytes = quota->num_ipv6_bytes;
+		shm->pipe[i].num_ipv4_pkts = quota->num_ipv4_pkts;
+		shm->pipe[i].num_ipv6_pkts = quota->num_ipv6_pkts;
+		shm->pipe[i].drop_packet_cnt = drop->drop_packet_cnt;
+		shm->pipe[i].drop_byte_cnt = drop->drop_byte_cnt;
+	}
+	shm->num_pipes = IPA_CLIENT_MAX;
+
+	ipa_hw_stats_shm_fill_teth(shm);
+
+	if (flt_rt) {
+		memcpy(shm->flt_rt, flt_rt, sizeof(shm->flt_rt));
+		shm->num_flt_rt = IPA_MAX_FLT_RT_CNT_INDEX;
+	}
+
+	shm->period_ms = ipa3_ctx->hw_stats.shm.period_ms;
+	shm->update_time_ns = ktime_get_boot_ns();
+
+	smp_wmb();
+	WRITE_ONCE(shm->seq, shm->seq + 1);
+
+	kfree(flt_rt);
+}
+
+static void ipa_hw_stats_shm_work(struct work_struct *work)
+{
+	struct ipa_hw_stats_shm_ctx *ctx = &ipa3_ctx->hw_stats.shm;
+
+	mutex_lock(&ctx->lock);
+	if (ctx->map_cnt) {
+		ipa_hw_stats_shm_update(ctx->shm);
+		queue_delayed_work(system_power_efficient_wq, &ctx->work,
+			msecs_to_jiffies(max_t(u32, ctx->period_ms, 100)));
+	}
+	mutex_unlock(&ctx->lock);
+}
+
+static void ipa_hw_stats_shm_vm_open(struct vm_area_struct *vma)
+{
+	struct ipa_hw_stats_shm_ctx *ctx = &ipa3_ctx->hw_stats.shm;
+
+	mutex_lock(&ctx->lock);
+	ctx->map_cnt++;
+	mutex_unlock(&ctx->lock);
+}
+
+static void ipa_hw_stats_shm_vm_close(struct vm_area_struct *vma)
+{
+	struct ipa_hw_stats_shm_ctx *ctx = &ipa3_ctx->hw_stats.shm;
+
+	mutex_lock(&ctx->lock);
+	/* the work stops itself once the last mapping is gone */
+	ctx->map_cnt--;
+	mutex_unlock(&ctx->lock);
+}
+
+static const struct vm_operations_struct ipa_hw_stats_shm_vm_ops = {
+	.open = ipa_hw_stats_shm_vm_open,
+	.close = ipa_hw_stats_shm_vm_close,
+};
+
+int ipa_hw_stats_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct ipa_hw_stats_shm_ctx *ctx = &ipa3_ctx->hw_stats.shm;
+	unsigned long size = vma->vm_end - vma->vm_start;
+	int ret;
+
+	if (!ipa3_ctx->hw_stats.enabled)
+		return -ENODEV;
+
+	if (vma->vm_pgoff ||
+		size > PAGE_ALIGN(sizeof(struct ipa_hw_stats_shm)))
+		return -EINVAL;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	mutex_lock(&ctx->lock);
+	if (!ctx->shm) {
+		ctx->shm = vmalloc_user(sizeof(struct ipa_hw_stats_shm));
+		if (!ctx->shm) {
+			ret = -ENOMEM;
+			goto unlock;
+		}
+		ctx->shm->version = IPA_HW_STATS_SHM_VERSION;
+	}
+
+	ret = remap_vmalloc_range(vma, ctx->shm, 0);
+	if (ret) {
+		IPAERR("failed to map hw stats %d\n", ret);
+		goto unlock;
+	}
+
+	vma->vm_ops = &ipa_hw_stats_shm_vm_ops;
+	if (!ctx->map_cnt++)
+		queue_delayed_work(system_power_efficient_wq, &ctx->work, 0);
+unlock:
+	mutex_unlock(&ctx->lock);
+	return ret;
+}
+
 int ipa_get_quota_stats(struct ipa_quota_stats_all *out)
 {
 	int i;
@@ -2201,6 +2396,13 @@ int ipa_debugfs_init_stats(struct dentry *parent)
 		goto fail;
 	}
 
+	file = debugfs_create_u32("shm_period_ms", read_write_mode, dent,
+		&ipa3_ctx->hw_stats.shm.period_ms);
+	if (IS_ERR_OR_NULL(file)) {
+		IPAERR("fail to create file %s\n", "shm_period_ms");
+		goto fail;
+	}
+
 	return 0;
 fail:
 	debugfs_remove_recursive(dent);
@@ -829,6 +829,29 @@ struct ipa3_rt_entry {
 	bool ipacm_installed;
 };
 
+/**
+ * enum ipa3_fltrt_img - table images written to SRAM on commit
+ */
+enum ipa3_fltrt_img {
+	IPA_FLTRT_IMG_HASH_HDR,
+	IPA_FLTRT_IMG_NHASH_HDR,
+	IPA_FLTRT_IMG_HASH_BDY,
+	IPA_FLTRT_IMG_NHASH_BDY,
+	IPA_FLTRT_IMG_MAX,
+};
+
+/**
+ * struct ipa3_fltrt_shadow - copy of a table image last written to SRAM
+ * @buf: the image, NULL when the SRAM content is not known
+ * @size: size of @buf
+ *
+ * Used on commit to DMA only the part of an image that changed.
+ */
+struct ipa3_fltrt_shadow {
+	u8 *buf;
+	u32 size;
+};
+
 /**
  * struct ipa3_rt_tbl_set - collection of routing tables
  * @head_rt_tbl_list: collection of routing tables
@@ -1003,6 +1026,8 @@ enum uc_state {
 	IPA_PC_RESTORE_CONTEXT_STATUS_SUCCESS,
 };
 
+struct ipa3_rx_spread_ctx;
+
 struct ipa3_repl_ctx {
 	struct ipa3_rx_pkt_wrapper **cache;
 	atomic_t head_idx;
@@ -1011,6 +1036,20 @@ struct ipa3_repl_ctx {
 	atomic_t pending;
 };
 
+/**
+ * struct ipa3_page_recycle_ring - per-CPU ring of recycle page wrappers
+ * @lock: protects the ring, other CPUs take from it when theirs is empty
+ * @cache: wrappers completed on this CPU, their pages may still be in use
+ * @head: index of the oldest wrapper
+ * @cnt: number of wrappers in the ring
+ */
+struct ipa3_page_recycle_ring {
+	spinlock_t lock;
+	struct ipa3_rx_pkt_wrapper **cache;
+	u32 head;
+	u32 cnt;
+};
+
 /**
  * struct ipa3_sys_context - IPA GPI pipes context
  * @head_desc_list: header descriptors list
@@ -1019,6 +1058,9 @@ struct ipa3_repl_ctx {
  * @ep: IPA EP context
  * @xmit_eot_cnt: count of pending eot for tasklet to process
  * @tasklet: tasklet for eot write_done handle (tx_complete)
+ * @rx_spread: NAPI instances WAN RX is spread over, NULL if not spreading
+ * @rx_list: packets of the current NAPI poll not yet handed to the client
+ * @rx_list_en: the client takes received packets in batches
  *
  * IPA context specific to the GPI pipes a.k.a LAN IN/OUT and WAN
  */
@@ -1047,6 +1089,7 @@ struct ipa3_sys_context {
 	void (*repl_hdlr)(struct ipa3_sys_context *sys);
 	struct ipa3_repl_ctx *repl;
 	struct ipa3_repl_ctx *page_recycle_repl;
+	struct ipa3_page_recycle_ring __percpu *page_recycle_pcpu;
 	u32 pkt_sent;
 	struct napi_struct *napi_obj;
 	struct list_head pending_pkts[GSI_VEID_MAX];
@@ -1054,6 +1097,8 @@ struct ipa3_sys_context {
 	struct tasklet_struct tasklet;
 	bool skip_eot;
 	u32 eob_drop_cnt;
+	struct ipa_rx_list rx_list;
+	bool rx_list_en;
 
 	/* ordering is important - mutable fields go above */
 	struct ipa3_ep_context *ep;
@@ -1067,6 +1112,7 @@ struct ipa3_sys_context {
 	u32 pm_hdl;
 	unsigned int napi_sch_cnt;
 	unsigned int napi_comp_cnt;
+	struct ipa3_rx_spread_ctx *rx_spread;
 	/* ordering is important - other immutable fields go below */
 };
 
@@ -1372,6 +1418,9 @@ enum ipa3_config_this_ep {
 struct ipa3_page_recycle_stats {
 	u64 total_replenished;
 	u64 tmp_alloc;
+	u64 local_hit;
+	u64 remote_hit;
+	u64 starved;
 };
 struct ipa3_stats {
 	u32 tx_sw_pkts;
@@ -1388,6 +1437,7 @@ struct ipa3_stats {
 	u32 wan_aggr_close;
 	u32 wan_rx_empty;
 	u32 wan_repl_rx_empty;
+	u32 fast_repl_starved;
 	u32 lan_rx_empty;
 	u32 lan_repl_rx_empty;
 	u32 flow_enable;
@@ -1689,12 +1739,21 @@ struct ipa_hw_stats_drop {
 	struct ipa_drop_stats_all stats;
 };
 
+struct ipa_hw_stats_shm_ctx {
+	struct mutex lock;
+	struct ipa_hw_stats_shm *shm;
+	int map_cnt;
+	u32 period_ms;
+	struct delayed_work work;
+};
+
 struct ipa_hw_stats {
 	bool enabled;
 	struct ipa_hw_stats_quota quota;
 	struct ipa_hw_stats_teth teth;
 	struct ipa_hw_stats_flt_rt flt_rt;
 	struct ipa_hw_stats_drop drop;
+	struct ipa_hw_stats_shm_ctx shm;
 };
 
 struct ipa_cne_evt {
@@ -1771,6 +1830,9 @@ struct ipa3_app_clock_vote {
  * @hdr_proc_ctx_tbl: IPA processing context table
  * @rt_tbl_set: list of routing tables each of which is a list of rules
  * @reap_rt_tbl_set: list of sys mem routing tables waiting to be reaped
+ * @flt_shadow: filter table images last written to SRAM
+ * @rt_shadow: routing table images last written to SRAM
+ * @fltrt_full_commit: debug knob, DMA whole tables on every commit
  * @flt_rule_cache: filter rule cache
  * @rt_rule_cache: routing rule cache
  * @hdr_cache: header cache
@@ -1866,6 +1928,9 @@ struct ipa3_context {
 	struct ipa3_hdr_proc_ctx_tbl hdr_proc_ctx_tbl;
 	struct ipa3_rt_tbl_set rt_tbl_set[IPA_IP_MAX];
 	struct ipa3_rt_tbl_set reap_rt_tbl_set[IPA_IP_MAX];
+	struct ipa3_fltrt_shadow flt_shadow[IPA_IP_MAX][IPA_FLTRT_IMG_MAX];
+	struct ipa3_fltrt_shadow rt_shadow[IPA_IP_MAX][IPA_FLTRT_IMG_MAX];
+	u32 fltrt_full_commit;
 	struct kmem_cache *flt_rule_cache;
 	struct kmem_cache *rt_rule_cache;
 	struct kmem_cache *hdr_cache;
@@ -1948,6 +2013,9 @@ struct ipa3_context {
 	spinlock_t idr_lock;
 	u32 enable_clock_scaling;
 	u32 enable_napi_chain;
+	u32 wan_rx_spread_cpus;
+	u32 wan_rx_spread_budget;
+	u32 pm_predict_window_ms;
 	u32 curr_ipa_clk_rate;
 	bool q6_proxy_clk_vote_valid;
 	struct mutex q6_proxy_clk_vote_mutex;
@@ -2082,6 +2150,8 @@ struct ipa3_plat_drv_res {
 	bool ipa_mhi_proxy;
 	bool ipa_wan_skb_page;
 	bool manual_fw_load;
+	u32 wan_rx_spread_cpus;
+	u32 pm_predict_window_ms;
 };
 
 /**
@@ -2920,6 +2990,12 @@ int _ipa_init_flt6_v3(void);
 
 int __ipa_commit_flt_v3(enum ipa_ip_type ip);
 int __ipa_commit_rt_v3(enum ipa_ip_type ip);
+u32 ipa3_fltrt_img_diff(struct ipa3_fltrt_shadow *sh,
+	struct ipa_mem_buffer *img, u32 base, u32 len, u32 *ofst);
+void ipa3_fltrt_shadow_save(struct ipa3_fltrt_shadow *sh,
+	struct ipa_mem_buffer *img);
+void ipa3_fltrt_shadow_reset(struct ipa3_fltrt_shadow *sh, int num);
+void ipa3_fltrt_shadow_reset_all(void);
 
 int __ipa_commit_hdr_v3_0(void);
 void ipa3_skb_recycle(struct sk_buff *skb);
@@ -3030,6 +3106,8 @@ struct ipa_teth_stats_endpoints {
 
 int ipa_hw_stats_init(void);
 
+int ipa_hw_stats_mmap(struct file *filp, struct vm_area_struct *vma);
+
 int ipa_init_flt_rt_stats(void);
 
 int ipa_debugfs_init_stats(struct dentry *parent);
@@ -3112,6 +3190,7 @@ int ipa3_register_ipa_ready_cb(void (*ipa_ready_cb)(void *), void *user_data);
 const char *ipa_hw_error_str(enum ipa3_hw_errors err_type);
 int ipa_gsi_ch20_wa(void);
 int ipa3_rx_poll(u32 clnt_hdl, int budget);
+int ipa3_rx_spread_stats(char *buf, int size);
 int ipa3_smmu_map_peer_reg(phys_addr_t phys_addr, bool map,
 	enum ipa_smmu_cb_type cb_type);
 int ipa3_smmu_map_peer_buff(u64 iova, u32 size, bool map, struct sg_table *sgt,
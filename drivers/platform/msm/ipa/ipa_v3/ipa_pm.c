@@ -10,6 +10,7 @@
  * GNU General Public License for more details.
  */
 
+#include <linux/average.h>
 #include <linux/debugfs.h>
 #include "ipa_pm.h"
 #include "ipa_i.h"
@@ -51,6 +52,9 @@
 #error max client greater than 32 all bitmask types should be changed
 #endif
 
+/* history of the peak throughput of a client's bursts, weight 1/4 */
+DECLARE_EWMA(ipa_pm_tput, 4, 4)
+
 /*
  * struct ipa_pm_exception_list - holds information about an exception
  * @pending: number of clients in exception that have not yet been adctivated
@@ -142,6 +146,10 @@ enum ipa_pm_state {
  * @deactivate work: delayed work for deferred_deactivate function
  * @complete: generic wait-for-completion handler
  * @wlock: wake source to prevent AP suspend
+ * @peak_tput: highest aggregated tput seen during the current activation
+ * @tput_hist: EWMA of the peak tput of past activations
+ * @predict_tput: tput pre-voted for the current activation
+ * @last_active: jiffies at the end of the last activation
  */
 struct ipa_pm_client {
 	char name[IPA_PM_MAX_EX_CL];
@@ -157,6 +165,10 @@ struct ipa_pm_client {
 	struct delayed_work deactivate_work;
 	struct completion complete;
 	struct wakeup_source wlock;
+	int peak_tput;
+	struct ewma_ipa_pm_tput tput_hist;
+	int predict_tput;
+	unsigned long last_active;
 };
 
 /*
@@ -281,6 +293,77 @@ static int calculate_throughput(void)
 	return aggregated_tput;
 }
 
+/*
+ * Predictive voting: a client activated again within pm_predict_window_ms
+ * of its last activation is expected to need about what its recent
+ * bursts needed, so the EWMA of their peak throughput is voted as soon as
+ * it activates instead of the clock ramping up as throughput gets raised.
+ * A higher peak replaces the history at once while lower ones only pull
+ * it down by a quarter each, so the prediction decays over a few bursts.
+ * Both are called with clk_scaling.lock held.
+ */
+static void predict_client_start(struct ipa_pm_client *client)
+{
+	u32 window = READ_ONCE(ipa3_ctx->pm_predict_window_ms);
+
+	client->peak_tput = 0;
+	client->predict_tput = 0;
+	if (!window)
+		return;
+
+	if (!client->last_active || time_after(jiffies,
+		client->last_active + msecs_to_jiffies(window))) {
+		/* too long ago to tell anything about this burst */
+		ewma_ipa_pm_tput_init(&client->tput_hist);
+		return;
+	}
+
+	client->predict_tput = ewma_ipa_pm_tput_read(&client->tput_hist);
+}
+
+static void predict_client_end(struct ipa_pm_client *client)
+{
+	client->predict_tput = 0;
+	if (!READ_ONCE(ipa3_ctx->pm_predict_window_ms))
+		return;
+
+	if ((unsigned long)client->peak_tput >
+		ewma_ipa_pm_tput_read(&client->tput_hist))
+		ewma_ipa_pm_tput_init(&client->tput_hist);
+	ewma_ipa_pm_tput_add(&client->tput_hist, client->peak_tput);
+	client->last_active = jiffies;
+}
+
+/**
+ * predict_throughput() - account @tput to the active clients and return the
+ * throughput to vote for, which is at least what the clients predicted
+ * @tput: the aggregated throughput
+ *
+ * Returns: throughput to base the clock vote on
+ */
+static int predict_throughput(int tput)
+{
+	struct ipa_pm_client *client;
+	int i, predict = 0;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ipa_pm_ctx->clk_scaling.lock, flags);
+	for (i = 0; i < IPA_PM_MAX_CLIENTS; i++) {
+		client = ipa_pm_ctx->clients[i];
+		if (!client || !(ipa_pm_ctx->clk_scaling.active_client_bitmask
+			& (1 << i)))
+			continue;
+		client->peak_tput = max(client->peak_tput, tput);
+		predict = max(predict, client->predict_tput);
+	}
+	spin_unlock_irqrestore(&ipa_pm_ctx->clk_scaling.lock, flags);
+
+	if (predict > tput)
+		IPA_PM_DBG_LOW("Predicted throughput: %d\n", predict);
+
+	return max(tput, predict);
+}
+
 /**
  * deactivate_client() - turn off the bit in the active client bitmask based on
  * the handle passed in
@@ -291,6 +374,9 @@ static void deactivate_client(u32 hdl)
 	unsigned long flags;
 
 	spin_lock_irqsave(&ipa_pm_ctx->clk_scaling.lock, flags);
+	if (ipa_pm_ctx->clk_scaling.active_client_bitmask & (1 << hdl) &&
+		ipa_pm_ctx->clients[hdl])
+		predict_client_end(ipa_pm_ctx->clients[hdl]);
 	ipa_pm_ctx->clk_scaling.active_client_bitmask &= ~(1 << hdl);
 	spin_unlock_irqrestore(&ipa_pm_ctx->clk_scaling.lock, flags);
 	IPA_PM_DBG_LOW("active bitmask: %x\n",
@@ -307,6 +393,9 @@ static void activate_client(u32 hdl)
 	unsigned long flags;
 
 	spin_lock_irqsave(&ipa_pm_ctx->clk_scaling.lock, flags);
+	if (!(ipa_pm_ctx->clk_scaling.active_client_bitmask & (1 << hdl)) &&
+		ipa_pm_ctx->clients[hdl])
+		predict_client_start(ipa_pm_ctx->clients[hdl]);
 	ipa_pm_ctx->clk_scaling.active_client_bitmask |= (1 << hdl);
 	spin_unlock_irqrestore(&ipa_pm_ctx->clk_scaling.lock, flags);
 	IPA_PM_DBG_LOW("active bitmask: %x\n",
@@ -365,6 +454,7 @@ static int do_clk_scaling(void)
 	IPA_PM_DBG_LOW("clock scaling started\n");
 	tput = calculate_throughput();
 	ipa_pm_ctx->aggregated_tput = tput;
+	tput = predict_throughput(tput);
 	set_current_threshold();
 
 	mutex_unlock(&ipa_pm_ctx->client_mutex);
@@ -1360,6 +1450,15 @@ int ipa_pm_stat(char *buf, int size)
 			ipa_pm_group_to_str[client->group], tput);
 		cnt += result;
 
+		if (ipa3_ctx->pm_predict_window_ms) {
+			result = scnprintf(buf + cnt, size - cnt,
+				"Predicted: %d History: %lu Peak: %d ",
+				client->predict_tput,
+				ewma_ipa_pm_tput_read(&client->tput_hist),
+				client->peak_tput);
+			cnt += result;
+		}
+
 		for (j = 0; j < IPA3_MAX_NUM_PIPES; j++) {
 			if (ipa_pm_ctx->clients_by_pipe[j] == client) {
 				result = scnprintf(buf + cnt, size - cnt,
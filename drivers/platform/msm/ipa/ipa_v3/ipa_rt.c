@@ -13,6 +13,7 @@
 #include <linux/bitops.h>
 #include <linux/idr.h>
 #include "ipa_i.h"
+#include "ipa_trace.h"
 #include "ipahal/ipahal.h"
 #include "ipahal/ipahal_fltrt.h"
 
@@ -460,6 +461,109 @@ static bool ipa_rt_valid_lcl_tbl_size(enum ipa_ip_type ipt,
 	return false;
 }
 
+/**
+ * ipa3_fltrt_img_diff() - find the part of a table image that differs from
+ *  what was last written to SRAM
+ * @sh: shadow of the SRAM content
+ * @img: the new image
+ * @base: start of the region of @img to look at
+ * @len: length of the region
+ * @ofst: [out] start of the changed span
+ *
+ * The span is widened to whole table header widths. Without a shadow the
+ * whole region counts as changed, as does anything past the shadow's end.
+ *
+ * Return: length of the changed span, 0 if the region is unchanged
+ */
+u32 ipa3_fltrt_img_diff(struct ipa3_fltrt_shadow *sh,
+	struct ipa_mem_buffer *img, u32 base, u32 len, u32 *ofst)
+{
+	u32 width = ipahal_get_hw_tbl_hdr_width();
+	u32 end = base + len;
+	u32 cmp_end = base;
+	u8 *buf = img->base;
+	u32 first, last;
+
+	if (!len)
+		return 0;
+
+	if (sh->buf && !ipa3_ctx->fltrt_full_commit)
+		cmp_end = min(end, sh->size);
+
+	for (first = base; first < cmp_end; first++)
+		if (buf[first] != sh->buf[first])
+			break;
+	if (first == end)
+		return 0;
+
+	last = end - 1;
+	if (last < cmp_end)
+		while (buf[last] == sh->buf[last])
+			last--;
+
+	first = rounddown(first, width);
+	last = min(roundup(last + 1, width), end);
+	*ofst = max(first, base);
+
+	return last - *ofst;
+}
+
+/**
+ * ipa3_fltrt_shadow_save() - remember an image that was written to SRAM
+ * @sh: shadow to update
+ * @img: the image
+ *
+ * On allocation failure the shadow is dropped and the next commit writes
+ * the whole image.
+ */
+void ipa3_fltrt_shadow_save(struct ipa3_fltrt_shadow *sh,
+	struct ipa_mem_buffer *img)
+{
+	if (!img->size) {
+		ipa3_fltrt_shadow_reset(sh, 1);
+		return;
+	}
+
+	if (sh->size != img->size) {
+		kfree(sh->buf);
+		sh->buf = kmalloc(img->size, GFP_KERNEL);
+		sh->size = sh->buf ? img->size : 0;
+		if (!sh->buf)
+			return;
+	}
+
+	memcpy(sh->buf, img->base, img->size);
+}
+
+void ipa3_fltrt_shadow_reset(struct ipa3_fltrt_shadow *sh, int num)
+{
+	int i;
+
+	for (i = 0; i < num; i++) {
+		kfree(sh[i].buf);
+		sh[i].buf = NULL;
+		sh[i].size = 0;
+	}
+}
+
+/**
+ * ipa3_fltrt_shadow_reset_all() - forget what is in SRAM
+ *
+ * For when the tables in SRAM may have been rewritten behind the driver's
+ * back. The next commit of each table writes the whole image.
+ */
+void ipa3_fltrt_shadow_reset_all(void)
+{
+	int ip;
+
+	for (ip = 0; ip < IPA_IP_MAX; ip++) {
+		ipa3_fltrt_shadow_reset(ipa3_ctx->flt_shadow[ip],
+			IPA_FLTRT_IMG_MAX);
+		ipa3_fltrt_shadow_reset(ipa3_ctx->rt_shadow[ip],
+			IPA_FLTRT_IMG_MAX);
+	}
+}
+
 /**
  * __ipa_commit_rt_v3() - commit rt tables to the hw
  * commit the headers and the bodies if are local with internal cache flushing
@@ -488,6 +592,10 @@ int __ipa_commit_rt_v3(enum ipa_ip_type ip)
 	struct ipa3_rt_tbl *tbl;
 	u32 tbl_hdr_width;
 	struct ipahal_imm_cmd_register_write reg_write_coal_close;
+	struct ipa3_fltrt_shadow *shadow = ipa3_ctx->rt_shadow[ip];
+	u32 ofst[IPA_FLTRT_IMG_MAX] = { 0 };
+	u32 len[IPA_FLTRT_IMG_MAX] = { 0 };
+	u32 img_bytes, dma_bytes;
 
 	tbl_hdr_width = ipahal_get_hw_tbl_hdr_width();
 	memset(desc, 0, sizeof(desc));
@@ -578,6 +686,44 @@ int __ipa_commit_rt_v3(enum ipa_ip_type ip)
 		goto fail_size_valid;
 	}
 
+	/* Only what changed since the last commit is written to SRAM */
+	img_bytes = alloc_params.nhash_hdr.size;
+	len[IPA_FLTRT_IMG_NHASH_HDR] = ipa3_fltrt_img_diff(
+		&shadow[IPA_FLTRT_IMG_NHASH_HDR], &alloc_params.nhash_hdr,
+		0, alloc_params.nhash_hdr.size, &ofst[IPA_FLTRT_IMG_NHASH_HDR]);
+	if (!ipa3_ctx->ipa_fltrt_not_hashable) {
+		img_bytes += alloc_params.hash_hdr.size;
+		len[IPA_FLTRT_IMG_HASH_HDR] = ipa3_fltrt_img_diff(
+			&shadow[IPA_FLTRT_IMG_HASH_HDR],
+			&alloc_params.hash_hdr, 0, alloc_params.hash_hdr.size,
+			&ofst[IPA_FLTRT_IMG_HASH_HDR]);
+	}
+	if (lcl_nhash) {
+		img_bytes += alloc_params.nhash_bdy.size;
+		len[IPA_FLTRT_IMG_NHASH_BDY] = ipa3_fltrt_img_diff(
+			&shadow[IPA_FLTRT_IMG_NHASH_BDY],
+			&alloc_params.nhash_bdy, 0, alloc_params.nhash_bdy.size,
+			&ofst[IPA_FLTRT_IMG_NHASH_BDY]);
+	}
+	if (lcl_hash) {
+		img_bytes += alloc_params.hash_bdy.size;
+		len[IPA_FLTRT_IMG_HASH_BDY] = ipa3_fltrt_img_diff(
+			&shadow[IPA_FLTRT_IMG_HASH_BDY],
+			&alloc_params.hash_bdy, 0, alloc_params.hash_bdy.size,
+			&ofst[IPA_FLTRT_IMG_HASH_BDY]);
+	}
+
+	dma_bytes = 0;
+	for (i = 0; i < IPA_FLTRT_IMG_MAX; i++)
+		dma_bytes += len[i];
+
+	if (!dma_bytes) {
+		IPADBG_LOW("rt tbls unchanged, nothing to commit. IP %d\n",
+			ip);
+		trace_ipa3_fltrt_commit(true, ip, img_bytes, 0, 0);
+		goto reap;
+	}
+
 	/* IC to close the coal frame before HPS Clear if coal is enabled */
 	if (ipa3_get_ep_mapping(IPA_CLIENT_APPS_WAN_COAL_CONS) != -1) {
 		i = ipa3_get_ep_mapping(IPA_CLIENT_APPS_WAN_COAL_CONS);
@@ -603,7 +749,8 @@ int __ipa_commit_rt_v3(enum ipa_ip_type ip)
 	 * SRAM memory not allocated to hash tables. Sending
 	 * command to hash tables(filer/routing) operation not supported.
 	 */
-	if (!ipa3_ctx->ipa_fltrt_not_hashable) {
+	if (!ipa3_ctx->ipa_fltrt_not_hashable &&
+		(len[IPA_FLTRT_IMG_HASH_HDR] || len[IPA_FLTRT_IMG_HASH_BDY])) {
 		/* flushing ipa internal hashable rt rules cache */
 		memset(&flush, 0, sizeof(flush));
 		if (ip == IPA_IP_v4)
@@ -629,32 +776,39 @@ int __ipa_commit_rt_v3(enum ipa_ip_type ip)
 		num_cmd++;
 	}
 
-	mem_cmd.is_read = false;
-	mem_cmd.skip_pipeline_clear = false;
-	mem_cmd.pipeline_clear_options = IPAHAL_HPS_CLEAR;
-	mem_cmd.size = alloc_params.nhash_hdr.size;
-	mem_cmd.system_addr = alloc_params.nhash_hdr.phys_base;
-	mem_cmd.local_addr = lcl_nhash_hdr;
-	cmd_pyld[num_cmd] = ipahal_construct_imm_cmd(
-		IPA_IMM_CMD_DMA_SHARED_MEM, &mem_cmd, false);
-	if (!cmd_pyld[num_cmd]) {
-		IPAERR("fail construct dma_shared_mem imm cmd. IP %d\n", ip);
-		goto fail_imm_cmd_construct;
+	if (len[IPA_FLTRT_IMG_NHASH_HDR]) {
+		mem_cmd.is_read = false;
+		mem_cmd.skip_pipeline_clear = false;
+		mem_cmd.pipeline_clear_options = IPAHAL_HPS_CLEAR;
+		mem_cmd.size = len[IPA_FLTRT_IMG_NHASH_HDR];
+		mem_cmd.system_addr = alloc_params.nhash_hdr.phys_base +
+			ofst[IPA_FLTRT_IMG_NHASH_HDR];
+		mem_cmd.local_addr = lcl_nhash_hdr +
+			ofst[IPA_FLTRT_IMG_NHASH_HDR];
+		cmd_pyld[num_cmd] = ipahal_construct_imm_cmd(
+			IPA_IMM_CMD_DMA_SHARED_MEM, &mem_cmd, false);
+		if (!cmd_pyld[num_cmd]) {
+			IPAERR(
+			"fail construct dma_shared_mem imm cmd. IP %d\n", ip);
+			goto fail_imm_cmd_construct;
+		}
+		ipa3_init_imm_cmd_desc(&desc[num_cmd], cmd_pyld[num_cmd]);
+		num_cmd++;
 	}
-	ipa3_init_imm_cmd_desc(&desc[num_cmd], cmd_pyld[num_cmd]);
-	num_cmd++;
 
 	/*
 	 * SRAM memory not allocated to hash tables. Sending
 	 * command to hash tables(filer/routing) operation not supported.
 	 */
-	if (!ipa3_ctx->ipa_fltrt_not_hashable) {
+	if (len[IPA_FLTRT_IMG_HASH_HDR]) {
 		mem_cmd.is_read = false;
 		mem_cmd.skip_pipeline_clear = false;
 		mem_cmd.pipeline_clear_options = IPAHAL_HPS_CLEAR;
-		mem_cmd.size = alloc_params.hash_hdr.size;
-		mem_cmd.system_addr = alloc_params.hash_hdr.phys_base;
-		mem_cmd.local_addr = lcl_hash_hdr;
+		mem_cmd.size = len[IPA_FLTRT_IMG_HASH_HDR];
+		mem_cmd.system_addr = alloc_params.hash_hdr.phys_base +
+			ofst[IPA_FLTRT_IMG_HASH_HDR];
+		mem_cmd.local_addr = lcl_hash_hdr +
+			ofst[IPA_FLTRT_IMG_HASH_HDR];
 		cmd_pyld[num_cmd] = ipahal_construct_imm_cmd(
 				IPA_IMM_CMD_DMA_SHARED_MEM, &mem_cmd, false);
 		if (!cmd_pyld[num_cmd]) {
@@ -666,7 +820,7 @@ int __ipa_commit_rt_v3(enum ipa_ip_type ip)
 		num_cmd++;
 	}
 
-	if (lcl_nhash) {
+	if (len[IPA_FLTRT_IMG_NHASH_BDY]) {
 		if (num_cmd >= IPA_RT_MAX_NUM_OF_COMMIT_TABLES_CMD_DESC) {
 			IPAERR("number of commands is out of range: IP = %d\n",
 				ip);
@@ -677,9 +831,11 @@ int __ipa_commit_rt_v3(enum ipa_ip_type ip)
 		mem_cmd.is_read = false;
 		mem_cmd.skip_pipeline_clear = false;
 		mem_cmd.pipeline_clear_options = IPAHAL_HPS_CLEAR;
-		mem_cmd.size = alloc_params.nhash_bdy.size;
-		mem_cmd.system_addr = alloc_params.nhash_bdy.phys_base;
-		mem_cmd.local_addr = lcl_nhash_bdy;
+		mem_cmd.size = len[IPA_FLTRT_IMG_NHASH_BDY];
+		mem_cmd.system_addr = alloc_params.nhash_bdy.phys_base +
+			ofst[IPA_FLTRT_IMG_NHASH_BDY];
+		mem_cmd.local_addr = lcl_nhash_bdy +
+			ofst[IPA_FLTRT_IMG_NHASH_BDY];
 		cmd_pyld[num_cmd] = ipahal_construct_imm_cmd(
 			IPA_IMM_CMD_DMA_SHARED_MEM, &mem_cmd, false);
 		if (!cmd_pyld[num_cmd]) {
@@ -690,7 +846,7 @@ int __ipa_commit_rt_v3(enum ipa_ip_type ip)
 		ipa3_init_imm_cmd_desc(&desc[num_cmd], cmd_pyld[num_cmd]);
 		num_cmd++;
 	}
-	if (lcl_hash) {
+	if (len[IPA_FLTRT_IMG_HASH_BDY]) {
 		if (num_cmd >= IPA_RT_MAX_NUM_OF_COMMIT_TABLES_CMD_DESC) {
 			IPAERR("number of commands is out of range: IP = %d\n",
 				ip);
@@ -701,9 +857,11 @@ int __ipa_commit_rt_v3(enum ipa_ip_type ip)
 		mem_cmd.is_read = false;
 		mem_cmd.skip_pipeline_clear = false;
 		mem_cmd.pipeline_clear_options = IPAHAL_HPS_CLEAR;
-		mem_cmd.size = alloc_params.hash_bdy.size;
-		mem_cmd.system_addr = alloc_params.hash_bdy.phys_base;
-		mem_cmd.local_addr = lcl_hash_bdy;
+		mem_cmd.size = len[IPA_FLTRT_IMG_HASH_BDY];
+		mem_cmd.system_addr = alloc_params.hash_bdy.phys_base +
+			ofst[IPA_FLTRT_IMG_HASH_BDY];
+		mem_cmd.local_addr = lcl_hash_bdy +
+			ofst[IPA_FLTRT_IMG_HASH_BDY];
 		cmd_pyld[num_cmd] = ipahal_construct_imm_cmd(
 			IPA_IMM_CMD_DMA_SHARED_MEM, &mem_cmd, false);
 		if (!cmd_pyld[num_cmd]) {
@@ -717,10 +875,26 @@ int __ipa_commit_rt_v3(enum ipa_ip_type ip)
 
 	if (ipa3_send_cmd(num_cmd, desc)) {
 		IPAERR_RL("fail to send immediate command\n");
+		/* SRAM may be partially written */
+		ipa3_fltrt_shadow_reset(shadow, IPA_FLTRT_IMG_MAX);
 		rc = -EFAULT;
 		goto fail_imm_cmd_construct;
 	}
 
+	trace_ipa3_fltrt_commit(true, ip, img_bytes, dma_bytes, num_cmd);
+
+	ipa3_fltrt_shadow_save(&shadow[IPA_FLTRT_IMG_NHASH_HDR],
+		&alloc_params.nhash_hdr);
+	if (!ipa3_ctx->ipa_fltrt_not_hashable)
+		ipa3_fltrt_shadow_save(&shadow[IPA_FLTRT_IMG_HASH_HDR],
+			&alloc_params.hash_hdr);
+	if (lcl_nhash)
+		ipa3_fltrt_shadow_save(&shadow[IPA_FLTRT_IMG_NHASH_BDY],
+			&alloc_params.nhash_bdy);
+	if (lcl_hash)
+		ipa3_fltrt_shadow_save(&shadow[IPA_FLTRT_IMG_HASH_BDY],
+			&alloc_params.hash_bdy);
+
 	IPADBG_LOW("Hashable HEAD\n");
 	IPA_DUMP_BUFF(alloc_params.hash_hdr.base,
 		alloc_params.hash_hdr.phys_base, alloc_params.hash_hdr.size);
@@ -743,6 +917,7 @@ int __ipa_commit_rt_v3(enum ipa_ip_type ip)
 			alloc_params.nhash_bdy.size);
 	}
 
+reap:
 	__ipa_reap_sys_rt_tbls(ip);
 
 fail_imm_cmd_construct:
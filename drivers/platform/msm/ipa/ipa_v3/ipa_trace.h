@@ -163,6 +163,34 @@ TRACE_EVENT(
 	TP_printk("each_poll_aggr_pkt_num=%d", __entry->poll_num)
 );
 
+TRACE_EVENT(
+	ipa3_fltrt_commit,
+
+	TP_PROTO(bool rt, int ip, u32 img_bytes, u32 dma_bytes, int num_cmd),
+
+	TP_ARGS(rt, ip, img_bytes, dma_bytes, num_cmd),
+
+	TP_STRUCT__entry(
+		__field(bool,	rt)
+		__field(int,	ip)
+		__field(u32,	img_bytes)
+		__field(u32,	dma_bytes)
+		__field(int,	num_cmd)
+	),
+
+	TP_fast_assign(
+		__entry->rt = rt;
+		__entry->ip = ip;
+		__entry->img_bytes = img_bytes;
+		__entry->dma_bytes = dma_bytes;
+		__entry->num_cmd = num_cmd;
+	),
+
+	TP_printk("%s ip=%d img_bytes=%u dma_bytes=%u num_cmd=%d",
+		__entry->rt ? "rt" : "flt", __entry->ip, __entry->img_bytes,
+		__entry->dma_bytes, __entry->num_cmd)
+);
+
 TRACE_EVENT(
 	ipa3_rx_poll_cnt,
 
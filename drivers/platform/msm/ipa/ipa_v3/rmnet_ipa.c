@@ -23,6 +23,7 @@
 #include <linux/module.h>
 #include <linux/netdevice.h>
 #include <linux/of_device.h>
+#include <linux/sched/clock.h>
 #include <linux/string.h>
 #include <linux/skbuff.h>
 #include <linux/version.h>
@@ -45,6 +46,9 @@
 #define OUTSTANDING_HIGH_CTL_DEFAULT (OUTSTANDING_HIGH_DEFAULT + 32)
 #define OUTSTANDING_LOW_DEFAULT 128
 
+/* upper bound on TX queues, there is one per CPU up to this */
+#define WWAN_MAX_TX_QUEUES 8
+
 static unsigned int outstanding_high = OUTSTANDING_HIGH_DEFAULT;
 module_param(outstanding_high, uint, 0644);
 MODULE_PARM_DESC(outstanding_high, "Outstanding high");
@@ -57,6 +61,28 @@ static unsigned int outstanding_low = OUTSTANDING_LOW_DEFAULT;
 module_param(outstanding_low, uint, 0644);
 MODULE_PARM_DESC(outstanding_low, "Outstanding low");
 
+/*
+ * Paced TCP skbs carry their earliest departure time in skb->tstamp, in
+ * the tcp_clock_ns() time base. Each TX queue holds them back on a time
+ * wheel of WWAN_EDT_SLOTS slots of edt_slot_us each, in place of the
+ * fq qdisc and a pacing hrtimer per socket.
+ */
+#define WWAN_EDT_SLOTS 64
+/* farther in the future it is not a departure time we set */
+#define WWAN_EDT_MAX_NS NSEC_PER_SEC
+
+static bool edt_pacing = true;
+module_param(edt_pacing, bool, 0444);
+MODULE_PARM_DESC(edt_pacing, "Honour TCP departure times on TX");
+
+static unsigned int edt_slot_us = 100;
+module_param(edt_slot_us, uint, 0444);
+MODULE_PARM_DESC(edt_slot_us, "TX time wheel granularity in usec");
+
+static unsigned int edt_limit = 1024;
+module_param(edt_limit, uint, 0644);
+MODULE_PARM_DESC(edt_limit, "Max skbs held back per TX queue");
+
 #define WWAN_METADATA_SHFT 24
 #define WWAN_METADATA_MASK 0xFF000000
 #define WWAN_DATA_LEN 9216
@@ -124,18 +150,35 @@ struct ipa3_rmnet_plat_drv_res {
  * @ch_id: channel id
  * @lock: spinlock for mutual exclusion
  * @device_status: holds device status
+ * @txq: per TX queue counters, updated under the queue's xmit lock
  *
  * WWAN private - holds all relevant info about WWAN driver
  */
+struct ipa3_edt_wheel {
+	struct tasklet_hrtimer timer;
+	struct sk_buff_head slot[WWAN_EDT_SLOTS];
+	spinlock_t lock;
+	u64 base_ns;
+	u64 next_ns;
+	u64 slot_ns;
+	unsigned int head;
+	unsigned int qlen;
+};
+
 struct ipa3_wwan_private {
 	struct net_device *net;
 	struct net_device_stats stats;
+	struct {
+		u64 packets;
+		u64 bytes;
+	} txq[WWAN_MAX_TX_QUEUES];
 	atomic_t outstanding_pkts;
 	uint32_t ch_id;
 	spinlock_t lock;
 	struct completion resource_granted_completion;
 	enum ipa3_wwan_device_status device_status;
 	struct napi_struct napi;
+	struct ipa3_edt_wheel edt[WWAN_MAX_TX_QUEUES];
 };
 
 struct rmnet_ipa3_context {
@@ -750,6 +793,7 @@ static int ipa3_wwan_add_ul_flt_rule_to_ipa(void)
 	struct ipa_ioc_add_flt_rule *param;
 	struct ipa_flt_rule_add flt_rule_entry;
 	struct ipa_fltr_installed_notif_req_msg_v01 *req;
+	bool dirty[IPA_IP_MAX] = { false };
 
 	pyld_sz = sizeof(struct ipa_ioc_add_flt_rule) +
 	   sizeof(struct ipa_flt_rule_add);
@@ -765,7 +809,8 @@ static int ipa3_wwan_add_ul_flt_rule_to_ipa(void)
 		return -ENOMEM;
 	}
 
-	param->commit = 1;
+	/* rules are committed once per IP family after the loop */
+	param->commit = 0;
 	param->ep = IPA_CLIENT_APPS_WAN_PROD;
 	param->global = false;
 	param->num_rules = (uint8_t)1;
@@ -774,6 +819,8 @@ static int ipa3_wwan_add_ul_flt_rule_to_ipa(void)
 
 	for (i = 0; i < rmnet_ipa3_ctx->num_q6_rules; i++) {
 		param->ip = ipa3_qmi_ctx->q6_ul_filter_rule[i].ip;
+		if (param->ip < IPA_IP_MAX)
+			dirty[param->ip] = true;
 		memset(&flt_rule_entry, 0, sizeof(struct ipa_flt_rule_add));
 		flt_rule_entry.at_rear = true;
 		flt_rule_entry.rule.action =
@@ -805,6 +852,14 @@ static int ipa3_wwan_add_ul_flt_rule_to_ipa(void)
 		}
 	}
 
+	for (i = 0; i < IPA_IP_MAX; i++) {
+		if (dirty[i] && ipa3_commit_flt(i)) {
+			retval = -EFAULT;
+			IPAWANERR("commit A7 UL filter rules failed ip %d\n",
+				i);
+		}
+	}
+
 	/* send ipa_fltr_installed_notif_req_msg_v01 to Q6*/
 	req->source_pipe_index =
 		ipa3_get_ep_mapping(IPA_CLIENT_APPS_WAN_PROD);
@@ -838,6 +893,7 @@ static int ipa3_wwan_del_ul_flt_rule_to_ipa(void)
 	int i, retval = 0;
 	struct ipa_ioc_del_flt_rule *param;
 	struct ipa_flt_rule_del flt_rule_entry;
+	bool dirty[IPA_IP_MAX] = { false };
 
 	pyld_sz = sizeof(struct ipa_ioc_del_flt_rule) +
 	   sizeof(struct ipa_flt_rule_del);
@@ -846,11 +902,14 @@ static int ipa3_wwan_del_ul_flt_rule_to_ipa(void)
 		return -ENOMEM;
 
 
-	param->commit = 1;
+	/* rules are committed once per IP family after the loop */
+	param->commit = 0;
 	param->num_hdls = (uint8_t) 1;
 
 	for (i = 0; i < rmnet_ipa3_ctx->old_num_q6_rules; i++) {
 		param->ip = ipa3_qmi_ctx->q6_ul_filter_rule[i].ip;
+		if (param->ip < IPA_IP_MAX)
+			dirty[param->ip] = true;
 		memset(&flt_rule_entry, 0, sizeof(struct ipa_flt_rule_del));
 		flt_rule_entry.hdl = ipa3_qmi_ctx->q6_ul_filter_rule_hdl[i];
 		/* debug rt-hdl*/
@@ -859,11 +918,24 @@ static int ipa3_wwan_del_ul_flt_rule_to_ipa(void)
 			sizeof(struct ipa_flt_rule_del));
 		if (ipa3_del_flt_rule((struct ipa_ioc_del_flt_rule *)param)) {
 			IPAWANERR("del A7 UL filter rule(%d) failed\n", i);
-			kfree(param);
-			return -EFAULT;
+			retval = -EFAULT;
+			break;
+		}
+	}
+
+	for (i = 0; i < IPA_IP_MAX; i++) {
+		if (dirty[i] && ipa3_commit_flt(i)) {
+			IPAWANERR("commit A7 UL filter rules failed ip %d\n",
+				i);
+			retval = -EFAULT;
 		}
 	}
 
+	if (retval) {
+		kfree(param);
+		return retval;
+	}
+
 	/* set UL filter-rule add-indication */
 	rmnet_ipa3_ctx->a7_ul_flt_set = false;
 	rmnet_ipa3_ctx->old_num_q6_rules = 0;
@@ -1163,7 +1235,7 @@ static int ipa3_wwan_open(struct net_device *dev)
 	IPAWANDBG("[%s] wwan_open()\n", dev->name);
 	rc = __ipa_wwan_open(dev);
 	if (rc == 0)
-		netif_start_queue(dev);
+		netif_tx_start_all_queues(dev);
 	return rc;
 }
 
@@ -1209,7 +1281,8 @@ static int ipa3_wwan_stop(struct net_device *dev)
 	__ipa_wwan_close(dev);
 	if (ipa3_rmnet_res.ipa_napi_enable)
 		napi_disable(&(wwan_ptr->napi));
-	netif_stop_queue(dev);
+	netif_tx_stop_all_queues(dev);
+	ipa3_edt_purge(wwan_ptr);
 	return 0;
 }
 
@@ -1223,6 +1296,184 @@ static int ipa3_wwan_change_mtu(struct net_device *dev, int new_mtu)
 	return 0;
 }
 
+/*
+ * All queues feed the one APPS_WAN_PROD pipe, they only keep the senders
+ * from contending on a single qdisc and xmit lock. Packets an rmnet_data
+ * device already put on a bearer queue (DFC) stay on a queue of their
+ * own here, the rest follow XPS which defaults to the sending CPU.
+ */
+static u16 ipa3_wwan_select_queue(struct net_device *dev, struct sk_buff *skb,
+	void *accel_priv, select_queue_fallback_t fallback)
+{
+	u16 txq = skb_get_queue_mapping(skb);
+
+	if (txq)
+		return txq % dev->real_num_tx_queues;
+
+	return fallback(dev, skb);
+}
+
+static void ipa3_wwan_get_stats64(struct net_device *dev,
+	struct rtnl_link_stats64 *stats)
+{
+	struct ipa3_wwan_private *wwan_ptr = netdev_priv(dev);
+	unsigned int i;
+
+	netdev_stats_to_stats64(stats, &dev->stats);
+	for (i = 0; i < dev->real_num_tx_queues; i++) {
+		stats->tx_packets += READ_ONCE(wwan_ptr->txq[i].packets);
+		stats->tx_bytes += READ_ONCE(wwan_ptr->txq[i].bytes);
+	}
+}
+
+/* Give every TX queue the CPUs it is the queue of, unless already set */
+static void ipa3_wwan_set_xps(struct net_device *dev)
+{
+	cpumask_var_t mask;
+	unsigned int i;
+	int cpu;
+
+	if (dev->real_num_tx_queues == 1)
+		return;
+
+	if (!zalloc_cpumask_var(&mask, GFP_KERNEL))
+		return;
+
+	for (i = 0; i < dev->real_num_tx_queues; i++) {
+		cpumask_clear(mask);
+		for_each_possible_cpu(cpu)
+			if (cpu % dev->real_num_tx_queues == i)
+				cpumask_set_cpu(cpu, mask);
+		if (netif_set_xps_queue(dev, mask, i))
+			IPAWANERR("failed to set XPS for queue %u\n", i);
+	}
+	free_cpumask_var(mask);
+}
+
+/* Re-arm for the first slot holding skbs, under wheel->lock */
+static void ipa3_edt_arm(struct ipa3_edt_wheel *wheel, u64 now)
+{
+	unsigned int i;
+	u64 expiry;
+
+	for (i = 0; i < WWAN_EDT_SLOTS; i++)
+		if (!skb_queue_empty(&wheel->slot[(wheel->head + i) %
+						  WWAN_EDT_SLOTS]))
+			break;
+	if (i == WWAN_EDT_SLOTS)
+		return;
+
+	expiry = wheel->base_ns + i * wheel->slot_ns;
+	if (wheel->next_ns && wheel->next_ns <= expiry)
+		return;
+
+	wheel->next_ns = expiry;
+	tasklet_hrtimer_start(&wheel->timer,
+			      ns_to_ktime(expiry > now ? expiry - now : 0),
+			      HRTIMER_MODE_REL);
+}
+
+/*
+ * Hold back a paced skb on its queue wheel. Returns false when it is
+ * due already or cannot be held, the caller sends it at once then.
+ */
+static bool ipa3_edt_defer(struct ipa3_edt_wheel *wheel, struct sk_buff *skb)
+{
+	u64 now = local_clock();
+	u64 edt = skb->tstamp;
+	unsigned long flags;
+	unsigned int idx;
+
+	if (edt < now + wheel->slot_ns || edt > now + WWAN_EDT_MAX_NS)
+		return false;
+
+	spin_lock_irqsave(&wheel->lock, flags);
+	if (wheel->qlen >= edt_limit) {
+		spin_unlock_irqrestore(&wheel->lock, flags);
+		return false;
+	}
+
+	if (!wheel->qlen) {
+		wheel->base_ns = now;
+		wheel->head = 0;
+	}
+	idx = min_t(u64, div64_u64(edt - wheel->base_ns, wheel->slot_ns),
+		    WWAN_EDT_SLOTS - 1);
+	__skb_queue_tail(&wheel->slot[(wheel->head + idx) % WWAN_EDT_SLOTS],
+			 skb);
+	wheel->qlen++;
+	ipa3_edt_arm(wheel, now);
+	spin_unlock_irqrestore(&wheel->lock, flags);
+
+	return true;
+}
+
+static enum hrtimer_restart ipa3_edt_timer_fn(struct hrtimer *timer)
+{
+	struct ipa3_edt_wheel *wheel = container_of(timer,
+		struct ipa3_edt_wheel, timer.timer);
+	struct sk_buff_head due;
+	struct sk_buff *skb;
+	unsigned long flags;
+	u64 now = local_clock();
+
+	__skb_queue_head_init(&due);
+
+	spin_lock_irqsave(&wheel->lock, flags);
+	wheel->next_ns = 0;
+	while (wheel->qlen && wheel->base_ns <= now) {
+		wheel->qlen -= skb_queue_len(&wheel->slot[wheel->head]);
+		skb_queue_splice_tail_init(&wheel->slot[wheel->head], &due);
+		wheel->head = (wheel->head + 1) % WWAN_EDT_SLOTS;
+		wheel->base_ns += wheel->slot_ns;
+	}
+	if (wheel->qlen)
+		ipa3_edt_arm(wheel, now);
+	spin_unlock_irqrestore(&wheel->lock, flags);
+
+	/* back through the qdisc, which handles a stopped queue */
+	while ((skb = __skb_dequeue(&due))) {
+		skb->tstamp = 0;
+		dev_queue_xmit(skb);
+	}
+
+	return HRTIMER_NORESTART;
+}
+
+static void ipa3_edt_init(struct ipa3_wwan_private *wwan_ptr)
+{
+	struct ipa3_edt_wheel *wheel;
+	int q, i;
+
+	for (q = 0; q < WWAN_MAX_TX_QUEUES; q++) {
+		wheel = &wwan_ptr->edt[q];
+		spin_lock_init(&wheel->lock);
+		for (i = 0; i < WWAN_EDT_SLOTS; i++)
+			__skb_queue_head_init(&wheel->slot[i]);
+		wheel->slot_ns = (u64)max(edt_slot_us, 1U) * NSEC_PER_USEC;
+		tasklet_hrtimer_init(&wheel->timer, ipa3_edt_timer_fn,
+				     CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	}
+}
+
+static void ipa3_edt_purge(struct ipa3_wwan_private *wwan_ptr)
+{
+	struct ipa3_edt_wheel *wheel;
+	unsigned long flags;
+	int q, i;
+
+	for (q = 0; q < WWAN_MAX_TX_QUEUES; q++) {
+		wheel = &wwan_ptr->edt[q];
+		tasklet_hrtimer_cancel(&wheel->timer);
+		spin_lock_irqsave(&wheel->lock, flags);
+		for (i = 0; i < WWAN_EDT_SLOTS; i++)
+			__skb_queue_purge(&wheel->slot[i]);
+		wheel->qlen = 0;
+		wheel->next_ns = 0;
+		spin_unlock_irqrestore(&wheel->lock, flags);
+	}
+}
+
 /**
  * ipa3_wwan_xmit() - Transmits an skb.
  *
@@ -1240,6 +1491,9 @@ static int ipa3_wwan_xmit(struct sk_buff *skb, struct net_device *dev)
 	int ret = 0;
 	bool qmap_check;
 	struct ipa3_wwan_private *wwan_ptr = netdev_priv(dev);
+	u16 qidx = skb_get_queue_mapping(skb);
+	struct netdev_queue *txq = netdev_get_tx_queue(dev, qidx);
+	unsigned int len = skb->len;
 	unsigned long flags;
 
 	if (rmnet_ipa3_ctx->ipa_config_is_apq) {
@@ -1259,6 +1513,10 @@ static int ipa3_wwan_xmit(struct sk_buff *skb, struct net_device *dev)
 		return NETDEV_TX_OK;
 	}
 
+	if (skb->tstamp && skb->sk && (dev->priv_flags & IFF_TX_EDT) &&
+	    ipa3_edt_defer(&wwan_ptr->edt[qidx], skb))
+		return NETDEV_TX_OK;
+
 	qmap_check = RMNET_MAP_GET_CD_BIT(skb);
 	spin_lock_irqsave(&wwan_ptr->lock, flags);
 	/* There can be a race between enabling the wake queue and
@@ -1266,11 +1524,11 @@ static int ipa3_wwan_xmit(struct sk_buff *skb, struct net_device *dev)
 	 * return from here itself.
 	 */
 	if (atomic_read(&rmnet_ipa3_ctx->ap_suspend)) {
-		netif_stop_queue(dev);
+		netif_tx_stop_queue(txq);
 		spin_unlock_irqrestore(&wwan_ptr->lock, flags);
 		return NETDEV_TX_BUSY;
 	}
-	if (netif_queue_stopped(dev)) {
+	if (netif_tx_queue_stopped(txq)) {
 		if (rmnet_ipa3_ctx->no_qmap_config) {
 			spin_unlock_irqrestore(&wwan_ptr->lock, flags);
 			return NETDEV_TX_BUSY;
@@ -1290,16 +1548,19 @@ static int ipa3_wwan_xmit(struct sk_buff *skb, struct net_device *dev)
 		}
 	}
 
-	/* checking High WM hit */
+	/*
+	 * checking High WM hit, the watermarks are shared by all queues as
+	 * they all wait on the same pipe but only this queue is stopped
+	 */
 	if (atomic_read(&wwan_ptr->outstanding_pkts) >=
 					outstanding_high) {
 		if (!qmap_check) {
 			IPAWANDBG_LOW("pending(%d)/(%d)- stop(%d)\n",
 				atomic_read(&wwan_ptr->outstanding_pkts),
 				outstanding_high,
-				netif_queue_stopped(dev));
+				netif_tx_queue_stopped(txq));
 			IPAWANDBG_LOW("qmap_chk(%d)\n", qmap_check);
-			netif_stop_queue(dev);
+			netif_tx_stop_queue(txq);
 			spin_unlock_irqrestore(&wwan_ptr->lock, flags);
 			return NETDEV_TX_BUSY;
 		}
@@ -1316,7 +1577,7 @@ static int ipa3_wwan_xmit(struct sk_buff *skb, struct net_device *dev)
 			IPA_RM_RESOURCE_WWAN_0_PROD);
 	}
 	if (ret == -EINPROGRESS) {
-		netif_stop_queue(dev);
+		netif_tx_stop_queue(txq);
 		spin_unlock_irqrestore(&wwan_ptr->lock, flags);
 		return NETDEV_TX_BUSY;
 	}
@@ -1355,8 +1616,9 @@ static int ipa3_wwan_xmit(struct sk_buff *skb, struct net_device *dev)
 		goto out;
 	}
 
-	dev->stats.tx_packets++;
-	dev->stats.tx_bytes += skb->len;
+	/* the skb may already be completed and freed */
+	wwan_ptr->txq[qidx].packets++;
+	wwan_ptr->txq[qidx].bytes += len;
 	ret = NETDEV_TX_OK;
 out:
 	if (atomic_read(&wwan_ptr->outstanding_pkts) == 0) {
@@ -1397,6 +1659,9 @@ static void apps_ipa_tx_complete_notify(void *priv,
 	struct sk_buff *skb = (struct sk_buff *)data;
 	struct net_device *dev = (struct net_device *)priv;
 	struct ipa3_wwan_private *wwan_ptr;
+	struct netdev_queue *txq;
+	unsigned long flags;
+	unsigned int i;
 
 	if (dev != IPA_NETDEV()) {
 		IPAWANDBG("Received pre-SSR packet completion\n");
@@ -1412,14 +1677,22 @@ static void apps_ipa_tx_complete_notify(void *priv,
 	}
 
 	wwan_ptr = netdev_priv(dev);
+	/*
+	 * Queues are stopped under wwan_ptr->lock, taking it here rather
+	 * than one queue's xmit lock serializes against all of them.
+	 */
+	spin_lock_irqsave(&wwan_ptr->lock, flags);
 	atomic_dec(&wwan_ptr->outstanding_pkts);
-	__netif_tx_lock_bh(netdev_get_tx_queue(dev, 0));
 	if (!atomic_read(&rmnet_ipa3_ctx->is_ssr) &&
-		netif_queue_stopped(wwan_ptr->net) &&
 		atomic_read(&wwan_ptr->outstanding_pkts) < outstanding_low) {
-		IPAWANDBG_LOW("Outstanding low (%d) - waking up queue\n",
-				outstanding_low);
-		netif_wake_queue(wwan_ptr->net);
+		for (i = 0; i < dev->real_num_tx_queues; i++) {
+			txq = netdev_get_tx_queue(dev, i);
+			if (!netif_tx_queue_stopped(txq))
+				continue;
+			IPAWANDBG_LOW("Outstanding low (%d) - waking queue %u\n",
+				outstanding_low, i);
+			netif_tx_wake_queue(txq);
+		}
 	}
 
 	if (atomic_read(&wwan_ptr->outstanding_pkts) == 0) {
@@ -1431,10 +1704,62 @@ static void apps_ipa_tx_complete_notify(void *priv,
 			IPA_RM_RESOURCE_WWAN_0_PROD);
 		}
 	}
-	__netif_tx_unlock_bh(netdev_get_tx_queue(dev, 0));
+	spin_unlock_irqrestore(&wwan_ptr->lock, flags);
 	dev_kfree_skb_any(skb);
 }
 
+/*
+ * Pass a poll's worth of packets to the stack, updating the statistics
+ * once for the batch. Plain IP frames, as sent without QMAP, go through
+ * GRO on the NAPI context they came from; QMAP frames are deaggregated
+ * (and GROed) further up by rmnet.
+ */
+static void apps_ipa_packet_receive_list(struct net_device *dev,
+		struct ipa_rx_list *list)
+{
+	unsigned long packets = 0, bytes = 0, dropped = 0;
+	struct sk_buff *skb;
+
+	trace_rmnet_ipa_netif_rcv_skb3(dev->stats.rx_packets);
+
+	while ((skb = __skb_dequeue(&list->skbs)) != NULL) {
+		packets++;
+		bytes += skb->len;
+		skb->dev = IPA_NETDEV();
+
+		if (!rmnet_ipa3_ctx->no_qmap_config) {
+			skb->protocol = htons(ETH_P_MAP);
+		} else if (list->napi && skb->len) {
+			switch (skb->data[0] & 0xF0) {
+			case 0x40:
+				skb->protocol = htons(ETH_P_IP);
+				break;
+			case 0x60:
+				skb->protocol = htons(ETH_P_IPV6);
+				break;
+			}
+
+			if (skb->protocol) {
+				if (napi_gro_receive(list->napi, skb) ==
+						GRO_DROP)
+					dropped++;
+				continue;
+			}
+		}
+
+		if (netif_receive_skb(skb))
+			dropped++;
+	}
+
+	if (dropped)
+		pr_err_ratelimited(DEV_NAME " %s:%d fail on netif_receive_skb\n",
+						   __func__, __LINE__);
+
+	dev->stats.rx_dropped += dropped;
+	dev->stats.rx_packets += packets;
+	dev->stats.rx_bytes += bytes;
+}
+
 /**
  * apps_ipa_packet_receive_notify() - Rx notify
  *
@@ -1481,6 +1806,9 @@ static void apps_ipa_packet_receive_notify(void *priv,
 		}
 		dev->stats.rx_packets++;
 		dev->stats.rx_bytes += packet_len;
+	} else if (evt == IPA_RECEIVE_LIST) {
+		apps_ipa_packet_receive_list(dev,
+			(struct ipa_rx_list *)data);
 	} else {
 		IPAWANERR("Invalid evt %d received in wan_ipa_receive\n", evt);
 	}
@@ -1619,8 +1947,10 @@ static int handle3_ingress_format(struct net_device *dev,
 	ipa_wan_ep_cfg->notify = apps_ipa_packet_receive_notify;
 	ipa_wan_ep_cfg->priv = dev;
 
-	if (ipa3_rmnet_res.ipa_napi_enable)
+	if (ipa3_rmnet_res.ipa_napi_enable) {
 		ipa_wan_ep_cfg->napi_obj = &(rmnet_ipa3_ctx->wwan_priv->napi);
+		ipa_wan_ep_cfg->rx_list = true;
+	}
 	ipa_wan_ep_cfg->desc_fifo_sz =
 		ipa3_rmnet_res.wan_rx_desc_size * IPA_FIFO_ELEMENT_SIZE;
 
@@ -2150,6 +2480,8 @@ static const struct net_device_ops ipa3_wwan_ops_ip = {
 	.ndo_open = ipa3_wwan_open,
 	.ndo_stop = ipa3_wwan_stop,
 	.ndo_start_xmit = ipa3_wwan_xmit,
+	.ndo_select_queue = ipa3_wwan_select_queue,
+	.ndo_get_stats64 = ipa3_wwan_get_stats64,
 	.ndo_tx_timeout = ipa3_wwan_tx_timeout,
 	.ndo_do_ioctl = ipa3_wwan_ioctl,
 	.ndo_change_mtu = ipa3_wwan_change_mtu,
@@ -2180,6 +2512,8 @@ static void ipa3_wwan_setup(struct net_device *dev)
 	dev->needed_headroom = HEADROOM_FOR_QMAP;
 	dev->needed_tailroom = TAILROOM;
 	dev->watchdog_timeo = 1000;
+	if (edt_pacing)
+		dev->priv_flags |= IFF_TX_EDT;
 }
 
 /* IPA_RM related functions start*/
@@ -2453,10 +2787,10 @@ void ipa3_q6_deinitialize_rm(void)
 static void ipa3_wake_tx_queue(struct work_struct *work)
 {
 	if (IPA_NETDEV()) {
-		__netif_tx_lock_bh(netdev_get_tx_queue(IPA_NETDEV(), 0));
+		netif_tx_lock_bh(IPA_NETDEV());
 		IPAWANDBG("Waking up the workqueue.\n");
-		netif_wake_queue(IPA_NETDEV());
-		__netif_tx_unlock_bh(netdev_get_tx_queue(IPA_NETDEV(), 0));
+		netif_tx_wake_all_queues(IPA_NETDEV());
+		netif_tx_unlock_bh(IPA_NETDEV());
 	}
 }
 
@@ -2797,10 +3131,12 @@ static int ipa3_wwan_probe(struct platform_device *pdev)
 	}
 
 	/* initialize wan-driver netdev */
-	dev = alloc_netdev(sizeof(struct ipa3_wwan_private),
+	dev = alloc_netdev_mqs(sizeof(struct ipa3_wwan_private),
 			   IPA_WWAN_DEV_NAME,
 			   NET_NAME_UNKNOWN,
-			   ipa3_wwan_setup);
+			   ipa3_wwan_setup,
+			   min_t(unsigned int, num_possible_cpus(),
+				 WWAN_MAX_TX_QUEUES), 1);
 	if (!dev) {
 		IPAWANERR("no memory for netdev\n");
 		ret = -ENOMEM;
@@ -2815,6 +3151,7 @@ static int ipa3_wwan_probe(struct platform_device *pdev)
 	spin_lock_init(&rmnet_ipa3_ctx->wwan_priv->lock);
 	init_completion(
 		&rmnet_ipa3_ctx->wwan_priv->resource_granted_completion);
+	ipa3_edt_init(rmnet_ipa3_ctx->wwan_priv);
 
 	if (!atomic_read(&rmnet_ipa3_ctx->is_ssr)) {
 		/* IPA_RM configuration starts */
@@ -2851,6 +3188,7 @@ static int ipa3_wwan_probe(struct platform_device *pdev)
 			0, ret);
 		goto set_perf_err;
 	}
+	ipa3_wwan_set_xps(dev);
 
 	IPAWANDBG("IPA-WWAN devices (%s) initialization ok :>>>>\n", dev->name);
 	if (ret) {
@@ -3010,7 +3348,7 @@ static int rmnet_ipa_ap_suspend(struct device *dev)
 	}
 
 	/* Make sure that there is no Tx operation ongoing */
-	netif_stop_queue(netdev);
+	netif_tx_stop_all_queues(netdev);
 	/* Stoppig Watch dog timer when pipe was in suspend state */
 	if (del_timer(&netdev->watchdog_timer))
 		dev_put(netdev);
@@ -3045,7 +3383,7 @@ static int rmnet_ipa_ap_resume(struct device *dev)
 	/* Clear the suspend in progress flag. */
 	atomic_set(&rmnet_ipa3_ctx->ap_suspend, 0);
 	if (netdev) {
-		netif_wake_queue(netdev);
+		netif_tx_wake_all_queues(netdev);
 		/* Starting Watch dog timer, pipe was changes to resume state */
 		if (netif_running(netdev) && netdev->watchdog_timeo <= 0)
 			__netdev_watchdog_up(netdev);
@@ -3132,7 +3470,7 @@ static int ipa3_lcl_mdm_ssr_notifier_cb(struct notifier_block *this,
 		atomic_set(&rmnet_ipa3_ctx->is_ssr, 1);
 		ipa3_q6_pre_shutdown_cleanup();
 		if (IPA_NETDEV())
-			netif_stop_queue(IPA_NETDEV());
+			netif_tx_stop_all_queues(IPA_NETDEV());
 		ipa3_qmi_stop_workqueues();
 		ipa3_wan_ioctl_stop_qmi_messages();
 		ipa_stop_polling_stats();
@@ -12,6 +12,8 @@
 
 #include <linux/module.h>
 #include <linux/kernel.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/of.h>
 #include <linux/err.h>
 #include <linux/init.h>
@@ -78,6 +80,14 @@ enum mhi_msg_level mhi_msg_lvl = MHI_MSG_ERROR;
 enum mhi_msg_level mhi_ipc_msg_lvl = MHI_MSG_VERBOSE;
 void *mhi_ipc_log;
 
+/*
+ * Transfer completion MSIs of an event ring raised within this many us go
+ * out as one, 0 sends each of them right away.
+ */
+static uint mhi_msi_coalesce_us;
+static struct dentry *mhi_debugfs;
+static ktime_t mhi_stats_last;
+
 static struct mhi_dev *mhi_ctx;
 static void mhi_hwc_cb(void *priv, enum ipa_mhi_event_type event,
 	unsigned long data);
@@ -88,6 +98,7 @@ static int mhi_deinit(struct mhi_dev *mhi);
 static void mhi_dev_resume_init_with_link_up(struct ep_pcie_notify *notify);
 static int mhi_dev_pcie_notify_event;
 static void mhi_dev_transfer_completion_cb(void *mreq);
+static int mhi_dev_event_msi(struct mhi_dev_ring *ring, u32 msivec);
 static int mhi_dev_alloc_evt_buf_evt_req(struct mhi_dev *mhi,
 		struct mhi_dev_channel *ch, struct mhi_dev_ring *evt_ring);
 static struct mhi_dev_uevent_info channel_state_info[MHI_MAX_CHANNELS];
@@ -270,7 +281,9 @@ static void mhi_dev_event_rd_offset_completion_cb(void *req)
 	wmb();
 	ctx = (union mhi_dev_ring_ctx *)&mhi->ev_ctx_cache[ereq->event_ring];
 	if (mhi_ctx->use_ipa) {
-		rc = ep_pcie_trigger_msi(mhi_ctx->phandle, ctx->ev.msivec);
+		rc = mhi_dev_event_msi(
+			&mhi->ring[mhi->ev_ring_start + ereq->event_ring],
+			ctx->ev.msivec);
 		if (rc)
 			pr_err("%s: error sending in msi\n", __func__);
 	}
@@ -342,6 +355,73 @@ static int mhi_trigger_msi_edma(struct mhi_dev_ring *ring, u32 idx)
 	return 0;
 }
 
+static int mhi_dev_trigger_ev_msi(struct mhi_dev_ring *ring, u32 msivec)
+{
+	ring->msi_sent++;
+
+	if (mhi_ctx->use_edma)
+		return mhi_trigger_msi_edma(ring, msivec);
+
+	return ep_pcie_trigger_msi(mhi_ctx->phandle, msivec);
+}
+
+static enum hrtimer_restart mhi_dev_msi_timer_fn(struct hrtimer *timer)
+{
+	struct mhi_dev_ring *ring = container_of(timer,
+				struct mhi_dev_ring, msi_timer);
+
+	atomic_set(&ring->msi_pending, 0);
+	if (mhi_dev_trigger_ev_msi(ring, ring->msi_vec))
+		pr_err("%s: error sending in msi\n", __func__);
+
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * mhi_dev_event_msi() - Raises the MSI of an event ring once its rp is
+ * updated in host memory. Within mhi_msi_coalesce_us of the first one,
+ * further flushes ride on the same MSI: the host reads the ring up to the
+ * rp it finds when it gets to the MSI anyway.
+ */
+static int mhi_dev_event_msi(struct mhi_dev_ring *ring, u32 msivec)
+{
+	if (!mhi_msi_coalesce_us)
+		return mhi_dev_trigger_ev_msi(ring, msivec);
+
+	if (atomic_xchg(&ring->msi_pending, 1)) {
+		ring->msi_coalesced++;
+		return 0;
+	}
+
+	ring->msi_vec = msivec;
+	hrtimer_start(&ring->msi_timer,
+		ns_to_ktime((u64)mhi_msi_coalesce_us * NSEC_PER_USEC),
+		HRTIMER_MODE_REL);
+
+	return 0;
+}
+
+/* Stops the coalescing timers, sending the held back MSIs if @send */
+static void mhi_dev_flush_event_msi(struct mhi_dev *mhi, bool send)
+{
+	struct mhi_dev_ring *ring;
+	int i;
+
+	if (!mhi->ring)
+		return;
+
+	for (i = mhi->ev_ring_start;
+		i < mhi->ev_ring_start + mhi->cfg.event_rings; i++) {
+		ring = &mhi->ring[i];
+		if (!ring->msi_timer.function)
+			continue;
+
+		if (hrtimer_cancel(&ring->msi_timer) && send)
+			mhi_dev_msi_timer_fn(&ring->msi_timer);
+		atomic_set(&ring->msi_pending, 0);
+	}
+}
+
 static int mhi_dev_send_multiple_tr_events(struct mhi_dev *mhi, int evnt_ring,
 		struct event_req *ereq, uint32_t evt_len)
 {
@@ -429,10 +509,11 @@ static int mhi_dev_send_multiple_tr_events(struct mhi_dev *mhi, int evnt_ring,
 	ereq->client_cb = mhi_dev_event_rd_offset_completion_cb;
 	ereq->event_ring = evnt_ring;
 	mhi_ctx->write_to_host(mhi, &transfer_addr, ereq, MHI_DEV_DMA_ASYNC);
+	ring->evt_flushed += ereq->num_events;
 	mutex_unlock(&ring->event_lock);
 
 	if (mhi_ctx->use_edma) {
-		rc = mhi_trigger_msi_edma(ring, ctx->ev.msivec);
+		rc = mhi_dev_event_msi(ring, ctx->ev.msivec);
 		if (rc)
 			pr_err("%s: error sending in msi\n", __func__);
 	}
@@ -522,6 +603,9 @@ static int mhi_dev_queue_transfer_completion(struct mhi_req *mreq, bool *flush)
 		return -EBUSY;
 	}
 
+	ch->xfer_pkts++;
+	ch->xfer_bytes += mreq->transfer_len;
+
 	if (mreq->el->tre.ieot) {
 		compl_ev = ch->tr_events + ch->evt_buf_rp;
 		compl_ev->evt_tr_comp.chid = ch->ch_id;
@@ -2090,6 +2174,7 @@ static int mhi_dev_abort(struct mhi_dev *mhi)
 
 	flush_workqueue(mhi->ring_init_wq);
 	flush_workqueue(mhi->pending_ring_wq);
+	mhi_dev_flush_event_msi(mhi, false);
 
 	/* Clean up initialized channels */
 	rc = mhi_deinit(mhi);
@@ -2487,6 +2572,9 @@ int mhi_dev_suspend(struct mhi_dev *mhi)
 	mutex_lock(&mhi_ctx->mhi_write_test);
 	atomic_set(&mhi->is_suspended, 1);
 
+	/* the host has to see every completion before it goes to sleep */
+	mhi_dev_flush_event_msi(mhi, true);
+
 	for (ch_id = 0; ch_id < mhi->cfg.channels; ch_id++) {
 		if (mhi->ch_ctx_cache[ch_id].ch_state !=
 						MHI_DEV_CH_STATE_RUNNING)
@@ -2573,8 +2661,12 @@ static int mhi_dev_ring_init(struct mhi_dev *dev)
 
 	/* Initialize Event ring */
 	for (i = dev->ev_ring_start; i < (dev->cfg.event_rings
-					+ dev->ev_ring_start); i++)
+					+ dev->ev_ring_start); i++) {
 		mhi_ring_init(&dev->ring[i], RING_TYPE_ER, i);
+		hrtimer_init(&dev->ring[i].msi_timer, CLOCK_MONOTONIC,
+				HRTIMER_MODE_REL);
+		dev->ring[i].msi_timer.function = mhi_dev_msi_timer_fn;
+	}
 
 	/* Initialize CH */
 	for (i = dev->ch_ring_start; i < (dev->cfg.channels
@@ -3975,6 +4067,79 @@ static int mhi_edma_init(struct device *dev)
 	return 0;
 }
 
+static int mhi_dev_stats_show(struct seq_file *s, void *unused)
+{
+	struct mhi_dev *mhi = s->private;
+	struct mhi_dev_channel *ch;
+	struct mhi_dev_ring *ring;
+	ktime_t now = ktime_get();
+	u64 ms, kbps;
+	int i;
+
+	/* throughput is over the time since the previous read */
+	ms = ktime_ms_delta(now, mhi_stats_last) ? : 1;
+	mhi_stats_last = now;
+
+	if (!mhi->ch || !mhi->ring)
+		return 0;
+
+	seq_printf(s, "%-4s %12s %16s %10s\n", "ch", "transfers", "bytes",
+		"kbps");
+	for (i = 0; i < mhi->cfg.channels; i++) {
+		ch = &mhi->ch[i];
+		if (!ch->xfer_pkts)
+			continue;
+
+		kbps = div64_u64((ch->xfer_bytes - ch->xfer_bytes_last) * 8,
+				ms);
+		ch->xfer_bytes_last = ch->xfer_bytes;
+		seq_printf(s, "%-4d %12llu %16llu %10llu\n", i, ch->xfer_pkts,
+			ch->xfer_bytes, kbps);
+	}
+
+	seq_printf(s, "\n%-4s %12s %12s %12s\n", "er", "events", "msi",
+		"coalesced");
+	for (i = 0; i < mhi->cfg.event_rings; i++) {
+		ring = &mhi->ring[mhi->ev_ring_start + i];
+		if (!ring->evt_flushed && !ring->msi_sent)
+			continue;
+
+		seq_printf(s, "%-4d %12llu %12llu %12llu\n", i,
+			ring->evt_flushed, ring->msi_sent,
+			ring->msi_coalesced);
+	}
+
+	return 0;
+}
+
+static int mhi_dev_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mhi_dev_stats_show, inode->i_private);
+}
+
+static const struct file_operations mhi_dev_stats_fops = {
+	.open = mhi_dev_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void mhi_dev_debugfs_init(struct mhi_dev *mhi)
+{
+	mhi_debugfs = debugfs_create_dir("mhi_dev", NULL);
+	if (IS_ERR_OR_NULL(mhi_debugfs)) {
+		mhi_debugfs = NULL;
+		return;
+	}
+
+	if (!debugfs_create_file("stats", 0400, mhi_debugfs, mhi,
+				&mhi_dev_stats_fops)) {
+		debugfs_remove_recursive(mhi_debugfs);
+		mhi_debugfs = NULL;
+	}
+	mhi_stats_last = ktime_get();
+}
+
 static int mhi_dev_probe(struct platform_device *pdev)
 {
 	int rc = 0;
@@ -4001,6 +4166,7 @@ static int mhi_dev_probe(struct platform_device *pdev)
 
 		mhi_uci_init();
 		mhi_update_state_info(MHI_STATE_CONFIGURED);
+		mhi_dev_debugfs_init(mhi_ctx);
 	}
 
 	if (mhi_ctx->use_edma) {
@@ -4067,6 +4233,8 @@ static int mhi_dev_probe(struct platform_device *pdev)
 
 static int mhi_dev_remove(struct platform_device *pdev)
 {
+	debugfs_remove_recursive(mhi_debugfs);
+	mhi_debugfs = NULL;
 	platform_set_drvdata(pdev, NULL);
 
 	return 0;
@@ -4088,9 +4256,11 @@ static struct platform_driver mhi_dev_driver = {
 
 module_param(mhi_msg_lvl, uint, 0644);
 module_param(mhi_ipc_msg_lvl, uint, 0644);
+module_param(mhi_msi_coalesce_us, uint, 0644);
 
 MODULE_PARM_DESC(mhi_msg_lvl, "mhi msg lvl");
 MODULE_PARM_DESC(mhi_ipc_msg_lvl, "mhi ipc msg lvl");
+MODULE_PARM_DESC(mhi_msi_coalesce_us, "mhi completion msi coalescing window (us)");
 
 static int __init mhi_dev_init(void)
 {
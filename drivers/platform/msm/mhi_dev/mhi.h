@@ -13,6 +13,7 @@
 #ifndef __MHI_H
 #define __MHI_H
 
+#include <linux/hrtimer.h>
 #include <linux/msm_ep_pcie.h>
 #include <linux/ipc_logging.h>
 #include <linux/msm_mhi_dev.h>
@@ -404,6 +405,13 @@ struct mhi_dev_ring {
 	/* ring_ctx_shadow -> tracking ring_ctx in the host */
 	union mhi_dev_ring_ctx			*ring_ctx_shadow;
 	struct msi_buf_cb_data		msi_buf;
+	/* event rings: completion MSI held back by mhi_msi_coalesce_us */
+	struct hrtimer				msi_timer;
+	atomic_t				msi_pending;
+	u32					msi_vec;
+	u64					evt_flushed;
+	u64					msi_sent;
+	u64					msi_coalesced;
 	void (*ring_cb)(struct mhi_dev *dev,
 			union mhi_dev_ring_element_type *el,
 			void *ctx);
@@ -488,6 +496,10 @@ struct mhi_dev_channel {
 	uint32_t			td_size;
 	uint32_t			pend_wr_count;
 	bool				skip_td;
+	/* completed transfers, for debugfs */
+	u64				xfer_pkts;
+	u64				xfer_bytes;
+	u64				xfer_bytes_last;
 };
 
 /* Structure device for mhi dev */
@@ -105,6 +105,9 @@ struct mhi_dev_net_client {
 	atomic_t  tx_enabled;
 	struct net_device *dev;
 	struct sk_buff_head tx_buffers;
+	/* completed reads, handed to the stack by napi */
+	struct sk_buff_head rx_queue;
+	struct napi_struct napi;
 	struct list_head rx_buffers;
 	struct list_head wr_req_buffers;
 	struct mhi_dev_net_ctxt *net_ctxt;
@@ -196,6 +199,7 @@ static void mhi_dev_net_process_queue_packets(struct work_struct *work)
 			return;
 		}
 		client->dev->stats.tx_packets++;
+		client->dev->stats.tx_bytes += xfer_data;
 
 		/* Check if free buffers are available*/
 		if (mhi_dev_channel_isempty(client->in_handle)) {
@@ -261,13 +265,41 @@ static void mhi_dev_net_read_completion_cb(void *req)
 
 	skb_put(skb, mreq->transfer_len);
 	net_handle->dev->stats.rx_packets++;
+	net_handle->dev->stats.rx_bytes += mreq->transfer_len;
 	skb->dev = net_handle->dev;
-	netif_rx(skb);
+	/* one napi run brings all the reads of a doorbell up to the stack */
+	if (netif_running(net_handle->dev)) {
+		skb_queue_tail(&net_handle->rx_queue, skb);
+		napi_schedule(&net_handle->napi);
+	} else {
+		kfree_skb(skb);
+	}
 	spin_lock_irqsave(&net_handle->rd_lock, flags);
 	list_add_tail(&mreq->list, &net_handle->rx_buffers);
 	spin_unlock_irqrestore(&net_handle->rd_lock, flags);
 }
 
+static int mhi_dev_net_poll(struct napi_struct *napi, int budget)
+{
+	struct mhi_dev_net_client *client =
+		container_of(napi, struct mhi_dev_net_client, napi);
+	struct sk_buff *skb;
+	int work_done = 0;
+
+	while (work_done < budget) {
+		skb = skb_dequeue(&client->rx_queue);
+		if (!skb)
+			break;
+		netif_receive_skb(skb);
+		work_done++;
+	}
+
+	if (work_done < budget)
+		napi_complete_done(napi, work_done);
+
+	return work_done;
+}
+
 static ssize_t mhi_dev_net_client_read(struct mhi_dev_net_client *mhi_handle)
 {
 	int bytes_avail = 0;
@@ -395,6 +427,7 @@ static int mhi_dev_net_open(struct net_device *dev)
 			"mhi_net_dev interface is up for IN %d OUT %d\n",
 			mhi_dev_net_ptr->out_chan,
 			mhi_dev_net_ptr->in_chan);
+	napi_enable(&mhi_dev_net_ptr->napi);
 	netif_start_queue(dev);
 	return 0;
 }
@@ -423,7 +456,12 @@ static netdev_tx_t mhi_dev_net_xmit(struct sk_buff *skb, struct net_device *dev)
 
 static int mhi_dev_net_stop(struct net_device *dev)
 {
+	struct mhi_dev_net_client *mhi_dev_net_ptr =
+			*(struct mhi_dev_net_client **)netdev_priv(dev);
+
 	netif_stop_queue(dev);
+	napi_disable(&mhi_dev_net_ptr->napi);
+	skb_queue_purge(&mhi_dev_net_ptr->rx_queue);
 	mhi_dev_net_log(MHI_VERBOSE, "mhi_dev_net interface is down\n");
 	return 0;
 }
@@ -478,6 +516,7 @@ static int mhi_dev_net_enable_iface(struct mhi_dev_net_client *mhi_dev_net_ptr)
 
 	/* Initialize skb list head to queue the packets for mhi dev client */
 	skb_queue_head_init(&(mhi_dev_net_ptr->tx_buffers));
+	skb_queue_head_init(&mhi_dev_net_ptr->rx_queue);
 
 	mhi_dev_net_log(MHI_INFO,
 			"mhi_dev_net interface registration\n");
@@ -500,6 +539,8 @@ static int mhi_dev_net_enable_iface(struct mhi_dev_net_client *mhi_dev_net_ptr)
 	mhi_dev_net_ctxt = netdev_priv(netdev);
 	mhi_dev_net_ptr->dev = netdev;
 	*mhi_dev_net_ctxt = mhi_dev_net_ptr;
+	netif_napi_add(netdev, &mhi_dev_net_ptr->napi, mhi_dev_net_poll,
+			NAPI_POLL_WEIGHT);
 	ret = register_netdev(mhi_dev_net_ptr->dev);
 	if (ret) {
 		pr_err("Failed to register mhi_dev_net device\n");
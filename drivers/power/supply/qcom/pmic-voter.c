@@ -53,6 +53,9 @@ struct votable {
 						int effective_result,
 						const char *effective_client);
 	char			*client_strs[NUM_MAX_CLIENTS];
+	/* string last passed by each client, matched before any strcmp */
+	const char		*client_keys[NUM_MAX_CLIENTS];
+	u32			enabled_mask;
 	bool			voted_on;
 	struct dentry		*root;
 	struct dentry		*status_ent;
@@ -79,13 +82,7 @@ struct votable {
 static void vote_set_any(struct votable *votable, int client_id,
 				int *eff_res, int *eff_id)
 {
-	int i;
-
-	*eff_res = 0;
-
-	for (i = 0; i < votable->num_clients && votable->client_strs[i]; i++)
-		*eff_res |= votable->votes[i].enabled;
-
+	*eff_res = !!votable->enabled_mask;
 	*eff_id = client_id;
 }
 
@@ -151,14 +148,85 @@ static void vote_max(struct votable *votable, int client_id,
 		*eff_res = -EINVAL;
 }
 
+/*
+ * Whether a vote of @val by @id beats @cur_val by @cur_id. Ties go to the
+ * lower client id, the one a full vote_min() or vote_max() scan picks.
+ */
+static bool vote_beats(int type, int val, int id, int cur_val, int cur_id)
+{
+	if (val != cur_val)
+		return type == VOTE_MIN ? val < cur_val : val > cur_val;
+
+	return id < cur_id;
+}
+
+/**
+ * vote_min_max_update() -
+ * @votable:	votable object
+ * @client_id:	client number of the latest voter
+ * @eff_res:	same as for vote_min() and vote_max()
+ * @eff_id:	same as for vote_min() and vote_max()
+ *
+ * Only the vote of @client_id changed since the last election, so the
+ * previous winner either stays or is beaten by @client_id. All votes are
+ * scanned again only when the winner itself withdrew or got worse.
+ *
+ * Context:
+ *	Must be called with the votable->lock held
+ */
+static void vote_min_max_update(struct votable *votable, int client_id,
+				int *eff_res, int *eff_id)
+{
+	struct client_vote *v = &votable->votes[client_id];
+	int cur_id = votable->effective_client_id;
+	int cur_res = votable->effective_result;
+
+	if (!votable->voted_on)
+		goto rescan;
+
+	if (cur_id == client_id) {
+		if (!v->enabled || (v->value != cur_res &&
+		    !vote_beats(votable->type, v->value, client_id,
+				cur_res, cur_id)))
+			goto rescan;
+		*eff_res = v->value;
+		*eff_id = client_id;
+		return;
+	}
+
+	if (v->enabled && (cur_id < 0 ||
+	    vote_beats(votable->type, v->value, client_id, cur_res, cur_id))) {
+		*eff_res = v->value;
+		*eff_id = client_id;
+		return;
+	}
+
+	*eff_res = cur_res;
+	*eff_id = cur_id;
+	return;
+
+rescan:
+	if (votable->type == VOTE_MIN)
+		vote_min(votable, client_id, eff_res, eff_id);
+	else
+		vote_max(votable, client_id, eff_res, eff_id);
+}
+
 static int get_client_id(struct votable *votable, const char *client_str)
 {
 	int i;
 
+	/* clients pass their string literal, so compare pointers first */
+	for (i = 0; i < votable->num_clients && votable->client_strs[i]; i++)
+		if (votable->client_keys[i] == client_str)
+			return i;
+
 	for (i = 0; i < votable->num_clients; i++) {
 		if (votable->client_strs[i]
-		 && (strcmp(votable->client_strs[i], client_str) == 0))
+		 && (strcmp(votable->client_strs[i], client_str) == 0)) {
+			votable->client_keys[i] = client_str;
 			return i;
+		}
 	}
 
 	/* new client */
@@ -168,6 +236,7 @@ static int get_client_id(struct votable *votable, const char *client_str)
 				= kstrdup(client_str, GFP_KERNEL);
 			if (!votable->client_strs[i])
 				return -ENOMEM;
+			votable->client_keys[i] = client_str;
 			return i;
 		}
 	}
@@ -182,6 +251,29 @@ static char *get_client_str(struct votable *votable, int client_id)
 	return votable->client_strs[client_id];
 }
 
+/**
+ * get_client_handle() -
+ *		Resolve a client once, for use with vote_handle().
+ * @votable:	the votable object
+ * @client_str: the voting client
+ *
+ * Returns:
+ *	A handle valid for the life of the votable, or a negative errno.
+ */
+int get_client_handle(struct votable *votable, const char *client_str)
+{
+	int client_id;
+
+	if (!votable || !client_str)
+		return -EINVAL;
+
+	lock_votable(votable);
+	client_id = get_client_id(votable, client_str);
+	unlock_votable(votable);
+
+	return client_id;
+}
+
 void lock_votable(struct votable *votable)
 {
 	mutex_lock(&votable->vote_lock);
@@ -396,48 +488,15 @@ const char *get_effective_client(struct votable *votable)
 	return client_str;
 }
 
-/**
- * vote() -
- *
- * @votable:	the votable object
- * @client_str: the voting client
- * @enabled:	This provides a means for the client to exclude himself from
- *		election. This clients val (the next argument) will be
- *		considered only when he has enabled his participation.
- *		Note that this takes a differnt meaning for SET_ANY type, as
- *		there is no concept of abstaining from participation.
- *		Enabled is treated as the boolean value the client is voting.
- * @val:	The vote value. This is ignored for SET_ANY votable types.
- *		For MIN, MAX votable types this value is used as the
- *		clients vote value when the enabled is true, this value is
- *		ignored if enabled is false.
- *
- * The callback is called only when there is a change in the election results or
- * if it is the first time someone is voting.
- *
- * Returns:
- *	The return from the callback when present and needs to be called
- *	or zero.
- */
-int vote(struct votable *votable, const char *client_str, bool enabled, int val)
+static int vote_locked(struct votable *votable, int client_id, bool enabled,
+		       int val)
 {
+	const char *client_str = votable->client_strs[client_id];
 	int effective_id = -EINVAL;
 	int effective_result;
-	int client_id;
 	int rc = 0;
 	bool similar_vote = false;
 
-	if (!votable || !client_str)
-		return -EINVAL;
-
-	lock_votable(votable);
-
-	client_id = get_client_id(votable, client_str);
-	if (client_id < 0) {
-		rc = client_id;
-		goto out;
-	}
-
 	/*
 	 * for SET_ANY the val is to be ignored, set it
 	 * to enabled so that the election still works based on
@@ -458,12 +517,16 @@ int vote(struct votable *votable, const char *client_str, bool enabled, int val)
 
 	votable->votes[client_id].enabled = enabled;
 	votable->votes[client_id].value = val;
+	if (enabled)
+		votable->enabled_mask |= BIT(client_id);
+	else
+		votable->enabled_mask &= ~BIT(client_id);
 
 	if (similar_vote && votable->voted_on) {
 		pr_debug("%s: %s,%d Ignoring similar vote %s of val=%d\n",
 			votable->name,
 			client_str, client_id, enabled ? "on" : "off", val);
-		goto out;
+		return 0;
 	}
 
 	pr_debug("%s: %s,%d voting %s of val=%d\n",
@@ -471,10 +534,9 @@ int vote(struct votable *votable, const char *client_str, bool enabled, int val)
 		client_str, client_id, enabled ? "on" : "off", val);
 	switch (votable->type) {
 	case VOTE_MIN:
-		vote_min(votable, client_id, &effective_result, &effective_id);
-		break;
 	case VOTE_MAX:
-		vote_max(votable, client_id, &effective_result, &effective_id);
+		vote_min_max_update(votable, client_id,
+				&effective_result, &effective_id);
 		break;
 	case VOTE_SET_ANY:
 		vote_set_any(votable, client_id,
@@ -504,8 +566,70 @@ int vote(struct votable *votable, const char *client_str, bool enabled, int val)
 	}
 
 	votable->voted_on = true;
-out:
+	return rc;
+}
+
+/**
+ * vote() -
+ *
+ * @votable:	the votable object
+ * @client_str: the voting client
+ * @enabled:	This provides a means for the client to exclude himself from
+ *		election. This clients val (the next argument) will be
+ *		considered only when he has enabled his participation.
+ *		Note that this takes a differnt meaning for SET_ANY type, as
+ *		there is no concept of abstaining from participation.
+ *		Enabled is treated as the boolean value the client is voting.
+ * @val:	The vote value. This is ignored for SET_ANY votable types.
+ *		For MIN, MAX votable types this value is used as the
+ *		clients vote value when the enabled is true, this value is
+ *		ignored if enabled is false.
+ *
+ * The callback is called only when there is a change in the election results or
+ * if it is the first time someone is voting.
+ *
+ * Returns:
+ *	The return from the callback when present and needs to be called
+ *	or zero.
+ */
+int vote(struct votable *votable, const char *client_str, bool enabled, int val)
+{
+	int client_id;
+	int rc;
+
+	if (!votable || !client_str)
+		return -EINVAL;
+
+	lock_votable(votable);
+	client_id = get_client_id(votable, client_str);
+	if (client_id < 0)
+		rc = client_id;
+	else
+		rc = vote_locked(votable, client_id, enabled, val);
+	unlock_votable(votable);
+
+	return rc;
+}
+
+/**
+ * vote_handle() -
+ *		vote() for a client resolved with get_client_handle(), without
+ *		looking up its name.
+ */
+int vote_handle(struct votable *votable, int handle, bool enabled, int val)
+{
+	int rc;
+
+	if (!votable || handle < 0 || handle >= votable->num_clients)
+		return -EINVAL;
+
+	lock_votable(votable);
+	if (!votable->client_strs[handle])
+		rc = -EINVAL;
+	else
+		rc = vote_locked(votable, handle, enabled, val);
 	unlock_votable(votable);
+
 	return rc;
 }
 
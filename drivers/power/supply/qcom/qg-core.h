@@ -149,6 +149,8 @@ struct qpnp_qg {
 	int			charge_type;
 	int			chg_iterm_ma;
 	int			next_wakeup_ms;
+	ktime_t			last_scale_time;
+	bool			soc_batched;
 	int			esr_actual;
 	int			esr_nominal;
 	int			soh;
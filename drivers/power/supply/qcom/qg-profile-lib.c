@@ -26,6 +26,70 @@ int qg_linear_interpolate(int y0, int x0, int y1, int x1, int x)
 	return y0 + ((y1 - y0) * (x - x0) / (x1 - x0));
 }
 
+/*
+ * First column with x <= col_entries * scale, for x within the columns.
+ * Searched from where the previous lookup ended, as temperature and SOC
+ * move by little between updates. The hints may race between callers,
+ * they only decide where the search starts.
+ */
+static int qg_lut_col(struct profile_table_data *lut, int x, int scale)
+{
+	int i = clamp(READ_ONCE(lut->col_hint), 0, lut->cols - 1);
+
+	while (i > 0 && x <= lut->col_entries[i - 1] * scale)
+		i--;
+	while (i < lut->cols - 1 && x > lut->col_entries[i] * scale)
+		i++;
+
+	WRITE_ONCE(lut->col_hint, i);
+	return i;
+}
+
+/* First row with soc >= row_entries (descending), for soc within the rows */
+static int qg_lut_row(struct profile_table_data *lut, int soc)
+{
+	int i = clamp(READ_ONCE(lut->row_hint), 0, lut->rows - 1);
+
+	while (i > 0 && soc >= lut->row_entries[i - 1])
+		i--;
+	while (i < lut->rows - 1 && soc < lut->row_entries[i])
+		i++;
+
+	WRITE_ONCE(lut->row_hint, i);
+	return i;
+}
+
+/* Whether the entry after row r of the column already reached ocv */
+static bool qg_lut_ocv_past(struct profile_table_data *lut, int col, int r,
+				int ocv, bool desc)
+{
+	int next = lut->data[r + 1][col];
+
+	return desc ? next <= ocv : next >= ocv;
+}
+
+/*
+ * First row i of a monotonic column with ocv between data[i] and
+ * data[i + 1], or -EINVAL if ocv is outside the column.
+ */
+static int qg_lut_ocv_row(struct profile_table_data *lut, int col, int ocv)
+{
+	int rows = lut->rows;
+	int i = clamp(READ_ONCE(lut->row_hint), 0, rows - 2);
+	bool desc = lut->data[0][col] >= lut->data[rows - 1][col];
+
+	if (!is_between(lut->data[0][col], lut->data[rows - 1][col], ocv))
+		return -EINVAL;
+
+	while (i > 0 && qg_lut_ocv_past(lut, col, i - 1, ocv, desc))
+		i--;
+	while (i < rows - 2 && !qg_lut_ocv_past(lut, col, i, ocv, desc))
+		i++;
+
+	WRITE_ONCE(lut->row_hint, i);
+	return i;
+}
+
 int qg_interpolate_single_row_lut(struct profile_table_data *lut,
 						int x, int scale)
 {
@@ -44,10 +108,7 @@ int qg_interpolate_single_row_lut(struct profile_table_data *lut,
 		return lut->data[0][cols-1];
 	}
 
-	for (i = 0; i < cols; i++) {
-		if (x <= lut->col_entries[i] * scale)
-			break;
-	}
+	i = qg_lut_col(lut, x, scale);
 
 	if (x == lut->col_entries[i] * scale) {
 		result = lut->data[0][i];
@@ -69,6 +130,7 @@ int qg_interpolate_soc(struct profile_table_data *lut,
 	int i, j, soc_high, soc_low, soc;
 	int rows = lut->rows;
 	int cols = lut->cols;
+	int row_high, row_low;
 
 	if (batt_temp < lut->col_entries[0] * DEGC_SCALE) {
 		pr_debug("batt_temp %d < known temp range\n", batt_temp);
@@ -80,9 +142,7 @@ int qg_interpolate_soc(struct profile_table_data *lut,
 		batt_temp = lut->col_entries[cols - 1] * DEGC_SCALE;
 	}
 
-	for (j = 0; j < cols; j++)
-		if (batt_temp <= lut->col_entries[j] * DEGC_SCALE)
-			break;
+	j = qg_lut_col(lut, batt_temp, DEGC_SCALE);
 
 	if (batt_temp == lut->col_entries[j] * DEGC_SCALE) {
 		/* found an exact match for temp in the table */
@@ -90,18 +150,19 @@ int qg_interpolate_soc(struct profile_table_data *lut,
 			return lut->row_entries[0];
 		if (ocv <= lut->data[rows - 1][j])
 			return lut->row_entries[rows - 1];
-		for (i = 0; i < rows; i++) {
-			if (ocv >= lut->data[i][j]) {
-				if (ocv == lut->data[i][j])
-					return lut->row_entries[i];
-				soc = qg_linear_interpolate(
-					lut->row_entries[i],
-					lut->data[i][j],
-					lut->row_entries[i - 1],
-					lut->data[i - 1][j],
-					ocv);
-				return soc;
-			}
+		/* ocv lies in (data[i + 1][j], data[i][j]] */
+		i = qg_lut_ocv_row(lut, j, ocv);
+		if (i >= 0) {
+			i++;
+			if (ocv == lut->data[i][j])
+				return lut->row_entries[i];
+			soc = qg_linear_interpolate(
+				lut->row_entries[i],
+				lut->data[i][j],
+				lut->row_entries[i - 1],
+				lut->data[i - 1][j],
+				ocv);
+			return soc;
 		}
 	}
 
@@ -112,36 +173,36 @@ int qg_interpolate_soc(struct profile_table_data *lut,
 		return lut->row_entries[rows - 1];
 
 	soc_low = soc_high = 0;
-	for (i = 0; i < rows-1; i++) {
-		if (soc_high == 0 && is_between(lut->data[i][j],
-				lut->data[i+1][j], ocv)) {
-			soc_high = qg_linear_interpolate(
-				lut->row_entries[i],
-				lut->data[i][j],
-				lut->row_entries[i + 1],
-				lut->data[i+1][j],
-				ocv);
-		}
+	row_high = qg_lut_ocv_row(lut, j, ocv);
+	if (row_high >= 0) {
+		i = row_high;
+		soc_high = qg_linear_interpolate(
+			lut->row_entries[i],
+			lut->data[i][j],
+			lut->row_entries[i + 1],
+			lut->data[i+1][j],
+			ocv);
+	}
 
-		if (soc_low == 0 && is_between(lut->data[i][j-1],
-				lut->data[i+1][j-1], ocv)) {
-			soc_low = qg_linear_interpolate(
-				lut->row_entries[i],
-				lut->data[i][j-1],
-				lut->row_entries[i + 1],
-				lut->data[i+1][j-1],
-				ocv);
-		}
+	row_low = qg_lut_ocv_row(lut, j - 1, ocv);
+	if (row_low >= 0) {
+		i = row_low;
+		soc_low = qg_linear_interpolate(
+			lut->row_entries[i],
+			lut->data[i][j-1],
+			lut->row_entries[i + 1],
+			lut->data[i+1][j-1],
+			ocv);
+	}
 
-		if (soc_high && soc_low) {
-			soc = qg_linear_interpolate(
-				soc_low,
-				lut->col_entries[j-1] * DEGC_SCALE,
-				soc_high,
-				lut->col_entries[j] * DEGC_SCALE,
-				batt_temp);
-			return soc;
-		}
+	if (soc_high && soc_low) {
+		soc = qg_linear_interpolate(
+			soc_low,
+			lut->col_entries[j-1] * DEGC_SCALE,
+			soc_high,
+			lut->col_entries[j] * DEGC_SCALE,
+			batt_temp);
+		return soc;
 	}
 
 	if (soc_high)
@@ -175,18 +236,9 @@ int qg_interpolate_var(struct profile_table_data *lut,
 		row1 = rows - 1;
 		row2 = rows - 1;
 	} else {
-		for (i = 0; i < rows; i++) {
-			if (soc == lut->row_entries[i]) {
-				row1 = i;
-				row2 = i;
-				break;
-			}
-			if (soc > lut->row_entries[i]) {
-				row1 = i - 1;
-				row2 = i;
-				break;
-			}
-		}
+		i = qg_lut_row(lut, soc);
+		row1 = soc == lut->row_entries[i] ? i : i - 1;
+		row2 = i;
 	}
 
 	if (batt_temp < lut->col_entries[0] * DEGC_SCALE)
@@ -194,9 +246,7 @@ int qg_interpolate_var(struct profile_table_data *lut,
 	if (batt_temp > lut->col_entries[cols - 1] * DEGC_SCALE)
 		batt_temp = lut->col_entries[cols - 1] * DEGC_SCALE;
 
-	for (i = 0; i < cols; i++)
-		if (batt_temp <= lut->col_entries[i] * DEGC_SCALE)
-			break;
+	i = qg_lut_col(lut, batt_temp, DEGC_SCALE);
 
 	if (batt_temp == lut->col_entries[i] * DEGC_SCALE) {
 		var = qg_linear_interpolate(
@@ -253,13 +303,9 @@ int qg_interpolate_slope(struct profile_table_data *lut,
 		row1 = rows - 2;
 		row2 = rows - 1;
 	} else {
-		for (i = 0; i < rows; i++) {
-			if (soc >= lut->row_entries[i]) {
-				row1 = i - 1;
-				row2 = i;
-				break;
-			}
-		}
+		i = qg_lut_row(lut, soc);
+		row1 = i - 1;
+		row2 = i;
 	}
 
 	if (batt_temp < lut->col_entries[0] * DEGC_SCALE)
@@ -267,10 +313,7 @@ int qg_interpolate_slope(struct profile_table_data *lut,
 	if (batt_temp > lut->col_entries[cols - 1] * DEGC_SCALE)
 		batt_temp = lut->col_entries[cols - 1] * DEGC_SCALE;
 
-	for (i = 0; i < cols; i++) {
-		if (batt_temp <= lut->col_entries[i] * DEGC_SCALE)
-			break;
-	}
+	i = qg_lut_col(lut, batt_temp, DEGC_SCALE);
 
 	if (batt_temp == lut->col_entries[i] * DEGC_SCALE) {
 		slope = (lut->data[row1][i] - lut->data[row2][i]);
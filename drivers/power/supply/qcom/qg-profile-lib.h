@@ -20,6 +20,9 @@ struct profile_table_data {
 	int		*row_entries;
 	int		*col_entries;
 	int		**data;
+	/* where the last lookup ended, the next one usually ends close by */
+	int		col_hint;
+	int		row_hint;
 };
 
 int qg_linear_interpolate(int y0, int x0, int y1, int x1, int x);
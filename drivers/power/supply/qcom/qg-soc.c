@@ -52,6 +52,16 @@ module_param_named(
 	maint_soc_update_ms, qg_maint_soc_update_ms, int, 0600
 );
 
+/*
+ * While suspended, the SOC scaling alarm is pushed out to at least this
+ * interval and the steps it skipped are applied at once, so a slow SOC
+ * change does not wake the system every next_wakeup_ms. 0 disables it.
+ */
+static int qg_sleep_soc_interval_ms = 120000;
+module_param_named(
+	sleep_soc_interval_ms, qg_sleep_soc_interval_ms, int, 0600
+);
+
 /* FVSS scaling only based on VBAT */
 static int qg_fvss_vbat_scaling = 1;
 module_param_named(
@@ -416,20 +426,29 @@ static bool maint_soc_timeout(struct qpnp_qg *chip)
 	return false;
 }
 
-static void update_msoc(struct qpnp_qg *chip)
+/* Apply @steps scaling steps, more than one after a batched sleep */
+static void update_msoc(struct qpnp_qg *chip, int steps)
 {
 	int rc = 0, sdam_soc, batt_temp = 0;
+	int delta = chip->dt.delta_soc * steps;
 	bool input_present = is_input_present(chip);
 
 	if (chip->catch_up_soc > chip->msoc) {
 		/* SOC increased */
-		if (input_present) /* Increment if input is present */
-			chip->msoc += chip->dt.delta_soc;
+		if (input_present) { /* Increment if input is present */
+			chip->msoc += delta;
+			if (steps > 1)
+				chip->msoc = min(chip->msoc,
+						chip->catch_up_soc);
+		}
 	} else if (chip->catch_up_soc < chip->msoc) {
 		/* SOC dropped */
-		chip->msoc -= chip->dt.delta_soc;
+		chip->msoc -= delta;
+		if (steps > 1)
+			chip->msoc = max(chip->msoc, chip->catch_up_soc);
 	}
 	chip->msoc = CAP(0, 100, chip->msoc);
+	chip->last_scale_time = ktime_get_boottime();
 
 	if (chip->maint_soc > 0 && chip->msoc < chip->maint_soc
 				&& maint_soc_timeout(chip)) {
@@ -489,15 +508,26 @@ static void scale_soc_work(struct work_struct *work)
 {
 	struct qpnp_qg *chip = container_of(work,
 			struct qpnp_qg, scale_soc_work);
+	int steps = 1;
+	s64 elapsed_ms;
 
 	mutex_lock(&chip->soc_lock);
 
+	if (chip->soc_batched) {
+		chip->soc_batched = false;
+		elapsed_ms = ktime_ms_delta(ktime_get_boottime(),
+					chip->last_scale_time);
+		if (chip->next_wakeup_ms > 0)
+			steps = max_t(s64, div_s64(elapsed_ms,
+					chip->next_wakeup_ms), 1);
+	}
+
 	if (!is_scaling_required(chip)) {
 		scale_soc_stop(chip);
 		goto done;
 	}
 
-	update_msoc(chip);
+	update_msoc(chip, steps);
 
 	if (is_scaling_required(chip)) {
 		alarm_start_relative(&chip->alarm_timer,
@@ -508,9 +538,9 @@ static void scale_soc_work(struct work_struct *work)
 	}
 
 	qg_dbg(chip, QG_DEBUG_SOC,
-		"SOC scale: Work msoc=%d catch_up_soc=%d delta_soc=%d next_wakeup=%d sec\n",
+		"SOC scale: Work msoc=%d catch_up_soc=%d delta_soc=%d steps=%d next_wakeup=%d sec\n",
 			chip->msoc, chip->catch_up_soc, chip->dt.delta_soc,
-			chip->next_wakeup_ms / 1000);
+			steps, chip->next_wakeup_ms / 1000);
 
 done_psy:
 	power_supply_changed(chip->qg_psy);
@@ -558,7 +588,7 @@ int qg_scale_soc(struct qpnp_qg *chip, bool force_soc)
 		goto done;
 	}
 
-	update_msoc(chip);
+	update_msoc(chip, 1);
 
 	if (is_scaling_required(chip)) {
 		get_next_update_time(chip);
@@ -595,6 +625,40 @@ int qg_soc_init(struct qpnp_qg *chip)
 	return 0;
 }
 
+/*
+ * Push a pending scaling alarm out to qg_sleep_soc_interval_ms. If the
+ * alarm callback is already running it is left alone.
+ */
+void qg_soc_suspend(struct qpnp_qg *chip)
+{
+	int interval = READ_ONCE(qg_sleep_soc_interval_ms);
+
+	mutex_lock(&chip->soc_lock);
+	if (interval > 0 && chip->next_wakeup_ms > 0 &&
+			chip->next_wakeup_ms < interval &&
+			alarm_try_to_cancel(&chip->alarm_timer) == 1) {
+		alarm_start_relative(&chip->alarm_timer,
+				ms_to_ktime(interval));
+		chip->soc_batched = true;
+		qg_dbg(chip, QG_DEBUG_SOC,
+			"SOC scale: batched next_wakeup=%d sec in sleep\n",
+			interval / 1000);
+	}
+	mutex_unlock(&chip->soc_lock);
+}
+
+/* Catch up on the steps skipped in sleep, without waiting for the alarm */
+void qg_soc_resume(struct qpnp_qg *chip)
+{
+	mutex_lock(&chip->soc_lock);
+	if (chip->soc_batched &&
+			alarm_try_to_cancel(&chip->alarm_timer) == 1) {
+		pm_stay_awake(chip->dev);
+		schedule_work(&chip->scale_soc_work);
+	}
+	mutex_unlock(&chip->soc_lock);
+}
+
 void qg_soc_exit(struct qpnp_qg *chip)
 {
 	alarm_cancel(&chip->alarm_timer);
@@ -4444,6 +4444,8 @@ static int qpnp_qg_suspend(struct device *dev)
 	vote(chip->good_ocv_irq_disable_votable,
 			QG_INIT_STATE_IRQ_DISABLE, true, 0);
 
+	qg_soc_suspend(chip);
+
 	return 0;
 }
 
@@ -4459,6 +4461,8 @@ static int qpnp_qg_resume(struct device *dev)
 	vote(chip->good_ocv_irq_disable_votable,
 			QG_INIT_STATE_IRQ_DISABLE, false, 0);
 
+	qg_soc_resume(chip);
+
 	return 0;
 }
 
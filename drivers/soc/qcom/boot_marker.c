@@ -26,6 +26,10 @@
 #include <linux/types.h>
 #include <linux/spinlock.h>
 #include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/device.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
 #include <asm/arch_timer.h>
 #include <soc/qcom/boot_stats.h>
 
@@ -34,6 +38,10 @@
 #define MSM_ARCH_TIMER_FREQ     19200000
 #define BOOTKPI_BUF_SIZE (2 * PAGE_SIZE)
 
+#define BOOT_TIMING_MAX		512
+#define BOOT_TIMING_NAME_LEN	48
+#define BOOT_TIMING_LINE_LEN	80
+
 struct boot_marker {
 	char marker_name[BOOT_MARKER_MAX_LEN];
 	unsigned long long int timer_value;
@@ -44,6 +52,34 @@ struct boot_marker {
 static struct dentry *dent_bkpi, *dent_bkpi_status, *dent_mpm_timer;
 static struct boot_marker boot_marker_list;
 
+enum boot_timing_type {
+	BOOT_TIMING_INITCALL,
+	BOOT_TIMING_PROBE,
+};
+
+struct boot_timing {
+	u64 start_ns;
+	u32 dur_us;
+	s16 ret;
+	u8 type;
+	char name[BOOT_TIMING_NAME_LEN];
+};
+
+/*
+ * Initcalls and driver probes taking at least timing_min_us are kept in
+ * a fixed size table, read back from /sys/kernel/boot_stats/timings.
+ * Deferred probes are counted no matter how long they took.
+ */
+static struct boot_timing *boot_timings;
+static unsigned int boot_timing_cnt, boot_timing_dropped;
+static unsigned int boot_timing_defer_cnt;
+static u64 boot_timing_defer_ns;
+static DEFINE_MUTEX(boot_timing_lock);
+static struct kobject *boot_stats_kobj;
+
+static unsigned int boot_timing_min_us = 100;
+module_param_named(timing_min_us, boot_timing_min_us, uint, 0644);
+
 /*
  * Caller is expected to hold the list spinlock.
  */
@@ -207,6 +243,105 @@ void measure_wake_up_time(void)
 }
 EXPORT_SYMBOL(measure_wake_up_time);
 
+static struct boot_timing *boot_timing_get(enum boot_timing_type type,
+		u64 start_ns, u64 dur_ns, int ret)
+{
+	struct boot_timing *t;
+
+	if (dur_ns < (u64)READ_ONCE(boot_timing_min_us) * NSEC_PER_USEC)
+		return NULL;
+
+	if (!boot_timings) {
+		boot_timings = kcalloc(BOOT_TIMING_MAX, sizeof(*boot_timings),
+				GFP_KERNEL);
+		if (!boot_timings)
+			return NULL;
+	}
+
+	if (boot_timing_cnt == BOOT_TIMING_MAX) {
+		boot_timing_dropped++;
+		return NULL;
+	}
+
+	t = &boot_timings[boot_timing_cnt++];
+	t->start_ns = start_ns;
+	t->dur_us = min_t(u64, div_u64(dur_ns, NSEC_PER_USEC), U32_MAX);
+	t->ret = clamp_t(int, ret, S16_MIN, S16_MAX);
+	t->type = type;
+	return t;
+}
+
+void boot_timing_initcall(void *fn, u64 start_ns, int ret)
+{
+	u64 dur_ns = ktime_get_ns() - start_ns;
+	struct boot_timing *t;
+
+	mutex_lock(&boot_timing_lock);
+	t = boot_timing_get(BOOT_TIMING_INITCALL, start_ns, dur_ns, ret);
+	if (t)
+		snprintf(t->name, sizeof(t->name), "%pf", fn);
+	mutex_unlock(&boot_timing_lock);
+}
+
+void boot_timing_probe(struct device *dev, struct device_driver *drv,
+		u64 start_ns, int ret)
+{
+	u64 dur_ns = ktime_get_ns() - start_ns;
+	struct boot_timing *t;
+
+	mutex_lock(&boot_timing_lock);
+	if (ret == -EPROBE_DEFER) {
+		boot_timing_defer_cnt++;
+		boot_timing_defer_ns += dur_ns;
+	}
+	t = boot_timing_get(BOOT_TIMING_PROBE, start_ns, dur_ns, ret);
+	if (t)
+		snprintf(t->name, sizeof(t->name), "%s/%s", drv->name,
+				dev_name(dev));
+	mutex_unlock(&boot_timing_lock);
+}
+
+static ssize_t boot_timings_read(struct file *filp, struct kobject *kobj,
+		struct bin_attribute *attr, char *buf, loff_t off, size_t count)
+{
+	size_t size = (BOOT_TIMING_MAX + 3) * BOOT_TIMING_LINE_LEN;
+	struct boot_timing *t;
+	char *text;
+	int i, len;
+	ssize_t rc;
+
+	text = kvmalloc(size, GFP_KERNEL);
+	if (!text)
+		return -ENOMEM;
+
+	len = scnprintf(text, size, "# type     start_us   dur_us  ret name\n");
+	mutex_lock(&boot_timing_lock);
+	for (i = 0; i < boot_timing_cnt; i++) {
+		t = &boot_timings[i];
+		len += scnprintf(text + len, size - len,
+				"%-8s %10llu %8u %4d %s\n",
+				t->type == BOOT_TIMING_PROBE ?
+				"probe" : "initcall",
+				div_u64(t->start_ns, NSEC_PER_USEC),
+				t->dur_us, t->ret, t->name);
+	}
+	len += scnprintf(text + len, size - len,
+			"# deferred probes: %u (%llu us), dropped: %u\n",
+			boot_timing_defer_cnt,
+			div_u64(boot_timing_defer_ns, NSEC_PER_USEC),
+			boot_timing_dropped);
+	mutex_unlock(&boot_timing_lock);
+
+	rc = memory_read_from_buffer(buf, count, &off, text, len);
+	kvfree(text);
+	return rc;
+}
+
+static struct bin_attribute boot_timings_attr = {
+	.attr = { .name = "timings", .mode = 0444 },
+	.read = boot_timings_read,
+};
+
 static ssize_t bootkpi_reader(struct file *fp, char __user *user_buffer,
 		size_t count, loff_t *position)
 {
@@ -334,6 +469,12 @@ static int __init init_bootkpi(void)
 
 	debugfs_create_dir("bootloader_log", dent_bkpi);
 
+	boot_stats_kobj = kobject_create_and_add("boot_stats", kernel_kobj);
+	if (!boot_stats_kobj)
+		pr_err("boot_marker: Could not create boot_stats kobject\n");
+	else if (sysfs_create_bin_file(boot_stats_kobj, &boot_timings_attr))
+		pr_err("boot_marker: Could not create 'timings' sysfs file\n");
+
 	INIT_LIST_HEAD(&boot_marker_list.list);
 	spin_lock_init(&boot_marker_list.slock);
 	set_bootloader_stats(false);
@@ -344,6 +485,7 @@ subsys_initcall(init_bootkpi);
 static void __exit exit_bootkpi(void)
 {
 	debugfs_remove_recursive(dent_bkpi);
+	kobject_put(boot_stats_kobj);
 	boot_marker_cleanup();
 	boot_stats_exit();
 }
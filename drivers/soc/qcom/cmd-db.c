@@ -22,6 +22,7 @@
 #include <linux/debugfs.h>
 #include <linux/fs.h>
 #include <linux/seq_file.h>
+#include <linux/hashtable.h>
 #include <soc/qcom/cmd-db.h>
 
 #define RESOURCE_ID_LEN 8
@@ -31,6 +32,7 @@
 #define SLAVE_ID_MASK 0x7
 #define SLAVE_ID_SHIFT 16
 #define CMD_DB_STANDALONE_MASK BIT(0)
+#define CMD_DB_HASH_BITS 8
 
 struct entry_header {
 	uint64_t res_id;
@@ -77,9 +79,23 @@ enum cmd_db_query_type {
 	CMD_DB_QUERY_MAX = 0x7ffffff,
 };
 
+/*
+ * Index over the entries of all slaves, by resource id and by address,
+ * built once at probe so that lookups do not walk the whole DB.
+ */
+struct cmd_db_node {
+	struct hlist_node id_node;
+	struct hlist_node addr_node;
+	struct entry_header *ent;
+	int slv_idx;
+};
+
 static void __iomem *start_addr;
 static struct cmd_db_header *cmd_db_header;
 static int cmd_db_status = -EPROBE_DEFER;
+static bool cmd_db_hashed;
+static DEFINE_HASHTABLE(cmd_db_id_hash, CMD_DB_HASH_BITS);
+static DEFINE_HASHTABLE(cmd_db_addr_hash, CMD_DB_HASH_BITS);
 
 static u64 cmd_db_get_u64_id(const char *id)
 {
@@ -93,6 +109,64 @@ static u64 cmd_db_get_u64_id(const char *id)
 	return rsc_id;
 }
 
+static struct cmd_db_node *cmd_db_find_node(u64 query, bool use_addr)
+{
+	struct cmd_db_node *node;
+
+	if (use_addr) {
+		hash_for_each_possible(cmd_db_addr_hash, node, addr_node,
+				(u32)query)
+			if (node->ent->addr == (u32)query)
+				return node;
+	} else {
+		hash_for_each_possible(cmd_db_id_hash, node, id_node, query)
+			if (node->ent->res_id == query)
+				return node;
+	}
+
+	return NULL;
+}
+
+/* The first entry for a given id or address wins, as in the linear scan */
+static int cmd_db_build_index(struct device *dev)
+{
+	struct rsc_hdr *rsc_hdr = &cmd_db_header->header[0];
+	struct cmd_db_node *nodes;
+	struct entry_header *ent;
+	int i, j, total = 0, n = 0;
+
+	for (i = 0; i < MAX_SLV_ID && rsc_hdr[i].slv_id; i++)
+		total += rsc_hdr[i].cnt;
+	if (!total)
+		return 0;
+
+	nodes = devm_kcalloc(dev, total, sizeof(*nodes), GFP_KERNEL);
+	if (!nodes)
+		return -ENOMEM;
+
+	for (i = 0; i < MAX_SLV_ID && rsc_hdr[i].slv_id; i++) {
+		ent = (struct entry_header *)(start_addr
+				+ sizeof(*cmd_db_header)
+				+ rsc_hdr[i].header_offset);
+
+		for (j = 0; j < rsc_hdr[i].cnt; j++, ent++) {
+			struct cmd_db_node *node = &nodes[n++];
+
+			node->ent = ent;
+			node->slv_idx = i;
+			if (!cmd_db_find_node(ent->res_id, false))
+				hash_add(cmd_db_id_hash, &node->id_node,
+						ent->res_id);
+			if (!cmd_db_find_node(ent->addr, true))
+				hash_add(cmd_db_addr_hash, &node->addr_node,
+						ent->addr);
+		}
+	}
+
+	cmd_db_hashed = true;
+	return 0;
+}
+
 static int cmd_db_get_header(u64 query, struct entry_header *eh,
 		struct rsc_hdr *rh, bool use_addr)
 {
@@ -105,6 +179,17 @@ static int cmd_db_get_header(u64 query, struct entry_header *eh,
 	if (!eh || !rh)
 		return -EINVAL;
 
+	if (cmd_db_hashed) {
+		struct cmd_db_node *node = cmd_db_find_node(query, use_addr);
+
+		if (!node)
+			return -ENODEV;
+
+		memcpy(eh, node->ent, sizeof(*eh));
+		memcpy(rh, &cmd_db_header->header[node->slv_idx], sizeof(*rh));
+		return 0;
+	}
+
 	rsc_hdr = &cmd_db_header->header[0];
 
 	for (i = 0; i < MAX_SLV_ID ; i++, rsc_hdr++) {
@@ -384,6 +469,11 @@ static int cmd_db_dev_probe(struct platform_device *pdev)
 		cmd_db_status = -EINVAL;
 		goto failed;
 	}
+
+	/* Lookups fall back to scanning the DB without the index */
+	if (cmd_db_build_index(&pdev->dev))
+		pr_warn("Command DB index not built, using linear lookup.\n");
+
 	cmd_db_status = 0;
 	of_platform_populate(pdev->dev.of_node, NULL, NULL, &pdev->dev);
 
@@ -14,6 +14,7 @@
  */
 
 #include <linux/crypto-qti-common.h>
+#include <linux/ktime.h>
 #include "crypto-qti-ice-regs.h"
 #include "crypto-qti-platform.h"
 
@@ -254,6 +255,31 @@ static void ice_dump_test_bus(struct crypto_vops_qti_entry *ice_entry)
 }
 
 
+static void ice_key_stat(u64 *cnt, u64 *total_ns, u64 *max_ns,
+			 ktime_t start)
+{
+	u64 delta = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	(*cnt)++;
+	*total_ns += delta;
+	if (delta > *max_ns)
+		*max_ns = delta;
+}
+
+static void ice_dump_key_stats(struct crypto_vops_qti_entry *ice_entry)
+{
+	struct crypto_qti_key_stats *s = &ice_entry->key_stats;
+
+	pr_err("%s: ICE key program: %llu err %llu total %llu us max %llu us\n",
+		ice_entry->ice_dev_type, s->program_cnt, s->program_err,
+		div_u64(s->program_ns, NSEC_PER_USEC),
+		div_u64(s->program_max_ns, NSEC_PER_USEC));
+	pr_err("%s: ICE key invalidate: %llu err %llu total %llu us max %llu us\n",
+		ice_entry->ice_dev_type, s->invalidate_cnt, s->invalidate_err,
+		div_u64(s->invalidate_ns, NSEC_PER_USEC),
+		div_u64(s->invalidate_max_ns, NSEC_PER_USEC));
+}
+
 int crypto_qti_debug(void *priv_data)
 {
 	struct crypto_vops_qti_entry *ice_entry;
@@ -389,10 +415,49 @@ int crypto_qti_debug(void *priv_data)
 		ice_readl(ice_entry, ICE_REGS_STREAM2_COUNTERS9_LSB));
 
 	ice_dump_test_bus(ice_entry);
+	ice_dump_key_stats(ice_entry);
 
 	return 0;
 }
 
+/*
+ * Every key goes through an SCM call into TZ, which is what makes a keyslot
+ * miss expensive, so count and time them.
+ */
+static int ice_program_key(struct crypto_vops_qti_entry *ice_entry,
+			   const struct blk_crypto_key *key, unsigned int slot,
+			   u8 data_unit_mask, int capid)
+{
+	struct crypto_qti_key_stats *s = &ice_entry->key_stats;
+	ktime_t start = ktime_get();
+	int err;
+
+	err = crypto_qti_program_key(ice_entry, key, slot,
+				data_unit_mask, capid);
+	ice_key_stat(&s->program_cnt, &s->program_ns, &s->program_max_ns,
+		     start);
+	if (err)
+		s->program_err++;
+
+	return err;
+}
+
+static int ice_invalidate_key(struct crypto_vops_qti_entry *ice_entry,
+			      unsigned int slot)
+{
+	struct crypto_qti_key_stats *s = &ice_entry->key_stats;
+	ktime_t start = ktime_get();
+	int err;
+
+	err = crypto_qti_invalidate_key(ice_entry, slot);
+	ice_key_stat(&s->invalidate_cnt, &s->invalidate_ns,
+		     &s->invalidate_max_ns, start);
+	if (err)
+		s->invalidate_err++;
+
+	return err;
+}
+
 int crypto_qti_keyslot_program(void *priv_data,
 			       const struct blk_crypto_key *key,
 			       unsigned int slot,
@@ -407,11 +472,10 @@ int crypto_qti_keyslot_program(void *priv_data,
 		return -EINVAL;
 	}
 
-	err = crypto_qti_program_key(ice_entry, key, slot,
-				data_unit_mask, capid);
+	err = ice_program_key(ice_entry, key, slot, data_unit_mask, capid);
 	if (err) {
 		pr_err("%s: program key failed with error %d\n", __func__, err);
-		err = crypto_qti_invalidate_key(ice_entry, slot);
+		err = ice_invalidate_key(ice_entry, slot);
 		if (err) {
 			pr_err("%s: invalidate key failed with error %d\n",
 				__func__, err);
@@ -433,7 +497,7 @@ int crypto_qti_keyslot_evict(void *priv_data, unsigned int slot)
 		return -EINVAL;
 	}
 
-	err = crypto_qti_invalidate_key(ice_entry, slot);
+	err = ice_invalidate_key(ice_entry, slot);
 	if (err) {
 		pr_err("%s: invalidate key failed with error %d\n",
 			__func__, err);
@@ -964,25 +964,28 @@ static int dfc_all_bearer_flow_ctl(struct net_device *dev,
 static u32 dfc_adjust_grant(struct rmnet_bearer_map *bearer,
 			    struct dfc_flow_status_info_type_v01 *fc_info)
 {
-	u32 grant;
+	u32 grant, old, in_flight;
 
 	if (!fc_info->rx_bytes_valid)
 		return fc_info->num_bytes;
 
-	if (bearer->bytes_in_flight > fc_info->rx_bytes)
-		bearer->bytes_in_flight -= fc_info->rx_bytes;
-	else
-		bearer->bytes_in_flight = 0;
+	/* TX adds to bytes_in_flight without holding qos_lock */
+	do {
+		old = atomic_read(&bearer->bytes_in_flight);
+		in_flight = old > fc_info->rx_bytes ?
+			    old - fc_info->rx_bytes : 0;
+	} while (atomic_cmpxchg(&bearer->bytes_in_flight,
+				old, in_flight) != old);
 
 	/* Adjusted grant = grant - bytes_in_flight */
-	if (fc_info->num_bytes > bearer->bytes_in_flight)
-		grant = fc_info->num_bytes - bearer->bytes_in_flight;
+	if (fc_info->num_bytes > in_flight)
+		grant = fc_info->num_bytes - in_flight;
 	else
 		grant = 0;
 
 	trace_dfc_adjust_grant(fc_info->mux_id, fc_info->bearer_id,
 			       fc_info->num_bytes, fc_info->rx_bytes,
-			       bearer->bytes_in_flight, grant);
+			       in_flight, grant);
 	return grant;
 }
 
@@ -1027,7 +1030,7 @@ static int dfc_update_fc_map(struct net_device *dev, struct qos_info *qos,
 			adjusted_grant = dfc_adjust_grant(itm, fc_info);
 		} else {
 			adjusted_grant = fc_info->num_bytes;
-			itm->bytes_in_flight = 0;
+			atomic_set(&itm->bytes_in_flight, 0);
 		}
 
 		if ((itm->grant_size == 0 && adjusted_grant > 0) ||
@@ -1157,7 +1160,7 @@ static void dfc_update_tx_link_status(struct net_device *dev,
 	if (itm->grant_size && !tx_status) {
 		itm->grant_size = 0;
 		itm->tcp_bidir = false;
-		itm->bytes_in_flight = 0;
+		atomic_set(&itm->bytes_in_flight, 0);
 		qmi_rmnet_watchdog_remove(itm);
 		dfc_bearer_flow_ctl(dev, itm, qos);
 	} else if (itm->grant_size == 0 && tx_status && !itm->rat_switch) {
@@ -1491,50 +1494,69 @@ void dfc_qmi_burst_check(struct net_device *dev, struct qos_info *qos,
 {
 	struct rmnet_bearer_map *bearer = NULL;
 	struct rmnet_flow_map *itm;
-	u32 start_grant;
+	u32 start_grant, grant, thresh;
+	bool cross_thresh;
 
-	spin_lock_bh(&qos->qos_lock);
+	rcu_read_lock();
 
 	if (dfc_mode == DFC_MODE_MQ_NUM) {
 		/* Mark is mq num */
 		if (likely(mark < MAX_MQ_NUM))
-			bearer = qos->mq[mark].bearer;
+			bearer = READ_ONCE(qos->mq[mark].bearer);
 	} else {
 		/* Mark is flow_id */
 		itm = qmi_rmnet_get_flow_map(qos, mark, ip_type);
 		if (likely(itm))
-			bearer = itm->bearer;
+			bearer = READ_ONCE(itm->bearer);
 	}
 
 	if (unlikely(!bearer))
 		goto out;
 
 	trace_dfc_flow_check(dev->name, bearer->bearer_id,
-			     len, mark, bearer->grant_size);
+			     len, mark, READ_ONCE(bearer->grant_size));
 
-	bearer->bytes_in_flight += len;
+	atomic_add(len, &bearer->bytes_in_flight);
 
-	if (!bearer->grant_size)
+	/*
+	 * Consume grant without qos_lock. Indications store a new grant
+	 * under the lock, which simply makes the cmpxchg retry on it.
+	 */
+	do {
+		start_grant = READ_ONCE(bearer->grant_size);
+		if (!start_grant)
+			goto out;
+
+		grant = len >= start_grant ? 0 : start_grant - len;
+	} while (cmpxchg(&bearer->grant_size, start_grant, grant) !=
+		 start_grant);
+
+	thresh = READ_ONCE(bearer->grant_thresh);
+	cross_thresh = start_grant > thresh && grant <= thresh;
+
+	/* Only the threshold ack and the flow off need the shared lock */
+	if (likely(!cross_thresh && grant))
 		goto out;
 
-	start_grant = bearer->grant_size;
-	if (len >= bearer->grant_size)
-		bearer->grant_size = 0;
-	else
-		bearer->grant_size -= len;
+	spin_lock_bh(&qos->qos_lock);
+
+	/* The bearer may have been removed since the lookup */
+	if (unlikely(!bearer->flow_ref))
+		goto unlock;
 
-	if (start_grant > bearer->grant_thresh &&
-	    bearer->grant_size <= bearer->grant_thresh) {
+	if (cross_thresh)
 		dfc_send_ack(dev, bearer->bearer_id,
 			     bearer->seq, qos->mux_id,
 			     DFC_ACK_TYPE_THRESHOLD);
-	}
 
+	/* Recheck, an indication may have granted more meanwhile */
 	if (!bearer->grant_size)
 		dfc_bearer_flow_ctl(dev, bearer, qos);
 
-out:
+unlock:
 	spin_unlock_bh(&qos->qos_lock);
+out:
+	rcu_read_unlock();
 }
 
 void dfc_qmi_query_flow(void *dfc_data)
@@ -20,6 +20,9 @@
 #include <linux/rpmsg.h>
 #include <linux/cdev.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
 #include <linux/poll.h>
 #include <linux/idr.h>
 #include <linux/of.h>
@@ -88,6 +91,38 @@ do { \
 #define GLINK_PKT_IOCTL_QUEUE_RX_INTENT \
 	_IOW(GLINK_PKT_IOCTL_MAGIC, 0, unsigned int)
 
+/*
+ * RX ring, set up by mmap()ing the device with one header page followed
+ * by a power of two data area. Once mapped, every packet is copied once
+ * into the ring instead of being queued for read(). Each record is a u32
+ * length followed by the payload, padded to 8 bytes. A record that does
+ * not fit before the end of the area is preceded by GLINK_PKT_RING_PAD,
+ * telling the reader to continue at offset 0. Packets that do not fit
+ * are dropped and counted.
+ *
+ * The offsets are free running, the kernel advances @head and the reader
+ * @tail. The poll queue is only woken when a packet lands in a ring the
+ * reader had drained, so a burst costs a single wakeup.
+ */
+struct glink_pkt_ring_hdr {
+	__u32 head;
+	__u32 tail;
+	__u32 size;
+	__u32 dropped;
+};
+
+#define GLINK_PKT_RING_PAD	0xffffffff
+#define GLINK_PKT_RING_MAX	(1 << 20)
+
+struct glink_pkt_ring {
+	void *vaddr;
+	unsigned long len;
+	struct glink_pkt_ring_hdr *hdr;
+	void *data;
+	u32 size;
+	u32 head;
+};
+
 #define MODULE_NAME "glink_pkt"
 static dev_t glink_pkt_major;
 static struct class *glink_pkt_class;
@@ -108,6 +143,7 @@ static DEFINE_IDA(glink_pkt_minor_ida);
  * @queue:	incoming message queue
  * @readq:	wait object for incoming queue
  * @sig_change:	flag to indicate serial signal change
+ * @ring:	mmap()ed RX ring replacing @queue, protected by @queue_lock
  * @dev_name:	/dev/@dev_name for glink_pkt device
  * @ch_name:	glink channel to match to
  * @edge:	glink edge to match to
@@ -127,6 +163,7 @@ struct glink_pkt_device {
 	struct sk_buff_head queue;
 	wait_queue_head_t readq;
 	int sig_change;
+	struct glink_pkt_ring *ring;
 
 	const char *dev_name;
 	const char *ch_name;
@@ -191,25 +228,82 @@ static int glink_pkt_rpdev_probe(struct rpmsg_device *rpdev)
 	return 0;
 }
 
+static bool glink_pkt_ring_empty(struct glink_pkt_ring *ring)
+{
+	return ring->head == READ_ONCE(ring->hdr->tail);
+}
+
+/*
+ * Called with queue_lock held. Returns true if the reader has to be
+ * woken up, that is the ring was empty before this packet.
+ */
+static bool glink_pkt_ring_put(struct glink_pkt_ring *ring, const void *buf,
+			       int len)
+{
+	u32 tail = READ_ONCE(ring->hdr->tail);
+	u32 used = ring->head - tail;
+	u32 off = ring->head & (ring->size - 1);
+	u32 rec = ALIGN(sizeof(u32) + len, 8);
+	u32 pad = 0;
+
+	if (off + rec > ring->size)
+		pad = ring->size - off;
+
+	/* A tail beyond head can only come from a confused reader */
+	if (used > ring->size || used + pad + rec > ring->size) {
+		ring->hdr->dropped++;
+		return false;
+	}
+
+	if (pad) {
+		*(u32 *)(ring->data + off) = GLINK_PKT_RING_PAD;
+		ring->head += pad;
+		off = 0;
+	}
+	*(u32 *)(ring->data + off) = len;
+	memcpy(ring->data + off + sizeof(u32), buf, len);
+	ring->head += rec;
+
+	/* Publish the record before the new head */
+	smp_wmb();
+	WRITE_ONCE(ring->hdr->head, ring->head);
+
+	return used == 0;
+}
+
 static int glink_pkt_rpdev_cb(struct rpmsg_device *rpdev, void *buf, int len,
 			      void *priv, u32 addr)
 {
 	struct glink_pkt_device *gpdev = dev_get_drvdata(&rpdev->dev);
+	struct sk_buff *skb = NULL;
 	unsigned long flags;
-	struct sk_buff *skb;
+	bool wake = true;
 
-	skb = alloc_skb(len, GFP_ATOMIC);
-	if (!skb)
-		return -ENOMEM;
+	spin_lock_irqsave(&gpdev->queue_lock, flags);
+	if (!gpdev->ring) {
+		spin_unlock_irqrestore(&gpdev->queue_lock, flags);
 
-	skb_put_data(skb, buf, len);
+		skb = alloc_skb(len, GFP_ATOMIC);
+		if (!skb)
+			return -ENOMEM;
 
-	spin_lock_irqsave(&gpdev->queue_lock, flags);
-	skb_queue_tail(&gpdev->queue, skb);
+		skb_put_data(skb, buf, len);
+		spin_lock_irqsave(&gpdev->queue_lock, flags);
+	}
+
+	/* The ring may have been set up while the skb was allocated */
+	if (gpdev->ring) {
+		wake = glink_pkt_ring_put(gpdev->ring, buf, len);
+	} else {
+		skb_queue_tail(&gpdev->queue, skb);
+		skb = NULL;
+	}
 	spin_unlock_irqrestore(&gpdev->queue_lock, flags);
+	kfree_skb(skb);
 
 	/* wake up any blocking processes, waiting for new data */
-	wake_up_interruptible(&gpdev->readq);
+	if (wake)
+		wake_up_interruptible(&gpdev->readq);
 
 	return 0;
 }
@@ -300,6 +394,7 @@ int glink_pkt_open(struct inode *inode, struct file *file)
 int glink_pkt_release(struct inode *inode, struct file *file)
 {
 	struct glink_pkt_device *gpdev = cdev_to_gpdev(inode->i_cdev);
+	struct glink_pkt_ring *ring = NULL;
 	struct device *dev = &gpdev->dev;
 	struct sk_buff *skb;
 	unsigned long flags;
@@ -319,8 +414,16 @@ int glink_pkt_release(struct inode *inode, struct file *file)
 		}
 		wake_up_interruptible(&gpdev->readq);
 		gpdev->sig_change = false;
+
+		/* Mappings hold the file, none of them is left by now */
+		ring = gpdev->ring;
+		gpdev->ring = NULL;
 		spin_unlock_irqrestore(&gpdev->queue_lock, flags);
 	}
+	if (ring) {
+		vfree(ring->vaddr);
+		kfree(ring);
+	}
 
 	put_device(dev);
 
@@ -360,6 +463,11 @@ ssize_t glink_pkt_read(struct file *file, char __user *buf,
 		       gpdev->ch_name, current->comm,
 		       task_pid_nr(current), refcount_read(&gpdev->refcount));
 
+	if (READ_ONCE(gpdev->ring)) {
+		GLINK_PKT_ERR("%s packets go to the RX ring\n", gpdev->ch_name);
+		return -EBUSY;
+	}
+
 	spin_lock_irqsave(&gpdev->queue_lock, flags);
 	/* Wait for data in the queue */
 	if (skb_queue_empty(&gpdev->queue)) {
@@ -487,8 +595,12 @@ static unsigned int glink_pkt_poll(struct file *file, poll_table *wait)
 	}
 
 	spin_lock_irqsave(&gpdev->queue_lock, flags);
-	if (!skb_queue_empty(&gpdev->queue))
+	if (gpdev->ring) {
+		if (!glink_pkt_ring_empty(gpdev->ring))
+			mask |= POLLIN | POLLRDNORM;
+	} else if (!skb_queue_empty(&gpdev->queue)) {
 		mask |= POLLIN | POLLRDNORM;
+	}
 
 	if (gpdev->sig_change)
 		mask |= POLLPRI;
@@ -605,6 +717,87 @@ static long glink_pkt_ioctl(struct file *file, unsigned int cmd,
 	return ret;
 }
 
+static struct glink_pkt_ring *glink_pkt_ring_alloc(unsigned long len)
+{
+	struct glink_pkt_ring *ring;
+
+	ring = kzalloc(sizeof(*ring), GFP_KERNEL);
+	if (!ring)
+		return NULL;
+
+	ring->vaddr = vmalloc_user(len);
+	if (!ring->vaddr) {
+		kfree(ring);
+		return NULL;
+	}
+	ring->len = len;
+	ring->hdr = ring->vaddr;
+	ring->data = ring->vaddr + PAGE_SIZE;
+	ring->size = len - PAGE_SIZE;
+	ring->hdr->size = ring->size;
+
+	return ring;
+}
+
+/**
+ * glink_pkt_mmap() - mmap() syscall for the glink_pkt device
+ * file:	Pointer to the file structure.
+ * vma:		Pointer to the user mapping.
+ *
+ * This function maps the RX ring of the device, creating it on the first
+ * call. Packets already queued for read() are moved into the new ring.
+ */
+static int glink_pkt_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct glink_pkt_device *gpdev = file->private_data;
+	unsigned long len = vma->vm_end - vma->vm_start;
+	struct glink_pkt_ring *ring;
+	struct sk_buff *skb;
+	unsigned long flags;
+	int ret;
+
+	if (!gpdev || refcount_read(&gpdev->refcount) == 1) {
+		GLINK_PKT_ERR("invalid device handle\n");
+		return -EINVAL;
+	}
+
+	if (vma->vm_pgoff || len <= PAGE_SIZE ||
+	    !is_power_of_2(len - PAGE_SIZE) ||
+	    len - PAGE_SIZE > GLINK_PKT_RING_MAX)
+		return -EINVAL;
+
+	mutex_lock(&gpdev->lock);
+	ring = gpdev->ring;
+	if (ring && ring->len != len) {
+		ret = -EBUSY;
+		goto unlock;
+	}
+
+	if (!ring) {
+		ring = glink_pkt_ring_alloc(len);
+		if (!ring) {
+			ret = -ENOMEM;
+			goto unlock;
+		}
+
+		spin_lock_irqsave(&gpdev->queue_lock, flags);
+		while ((skb = skb_dequeue(&gpdev->queue))) {
+			glink_pkt_ring_put(ring, skb->data, skb->len);
+			kfree_skb(skb);
+		}
+		gpdev->ring = ring;
+		spin_unlock_irqrestore(&gpdev->queue_lock, flags);
+		GLINK_PKT_INFO("%s RX ring of %u bytes\n", gpdev->ch_name,
+			       ring->size);
+	}
+
+	ret = remap_vmalloc_range(vma, ring->vaddr, 0);
+unlock:
+	mutex_unlock(&gpdev->lock);
+
+	return ret;
+}
+
 static const struct file_operations glink_pkt_fops = {
 	.owner = THIS_MODULE,
 	.open = glink_pkt_open,
@@ -612,6 +805,7 @@ static const struct file_operations glink_pkt_fops = {
 	.read = glink_pkt_read,
 	.write = glink_pkt_write,
 	.poll = glink_pkt_poll,
+	.mmap = glink_pkt_mmap,
 	.unlocked_ioctl = glink_pkt_ioctl,
 	.compat_ioctl = glink_pkt_ioctl,
 };
@@ -430,34 +430,19 @@ static int db_queue_wait_freewords(struct doorbell_queue *dbq,
 	return -ETIMEDOUT;
 }
 
-static int db_send_msg(struct hgsl_priv  *priv,
-			struct db_msg_id *db_msg_id,
-			struct db_msg_request *msg_req,
-			struct db_msg_response *msg_resp)
+/* Copies a message to the queue, the GMU sees it on the next doorbell */
+static void db_queue_write(struct doorbell_queue *dbq,
+			struct db_msg_request *msg_req)
 {
 	uint32_t msg_size_align;
-	int ret;
 	uint8_t *src, *dst;
 	uint32_t move_dwords, resid_move_dwords;
 	uint32_t queue_size_dword;
-	struct qcom_hgsl *hgsl;
-	struct doorbell_queue *dbq;
 	uint32_t wptr;
 
-	hgsl = priv->dev;
-	dbq = &hgsl->dbq[priv->dbq_idx];
-
-	mutex_lock(&hgsl->lock);
 	queue_size_dword = dbq->data.dwords;
 	msg_size_align = ALIGN(msg_req->msg_dwords, 4);
 
-	ret = db_queue_wait_freewords(dbq, msg_size_align);
-	if (ret < 0) {
-		dev_err(hgsl->dev,
-			"Timed out waiting for queue to free up\n");
-		goto quit;
-	}
-
 	wptr = dbq_get_qindex(dbq->vbase, DBQ_WRITE_INDEX_IN_DWORD);
 	move_dwords = msg_req->msg_dwords;
 	if ((msg_req->msg_dwords + wptr) >= queue_size_dword) {
@@ -472,6 +457,11 @@ static int db_send_msg(struct hgsl_priv  *priv,
 	src = msg_req->ptr_data;
 	memcpy(dst, src, (move_dwords << 2));
 
+	/*
+	 * the GMU may still be draining an earlier doorbell, the message
+	 * has to be in memory before it can see the index move
+	 */
+	wmb();
 	wptr = (wptr + msg_size_align) % queue_size_dword;
 	dbq_set_qindex((uint32_t *)dbq->vbase,
 				DBQ_WRITE_INDEX_IN_DWORD,
@@ -481,6 +471,11 @@ static int db_send_msg(struct hgsl_priv  *priv,
 				((struct hgsl_db_cmds *)src)->ctx_id,
 				HGSL_DBQ_METADATA_TIMESTAMP_IN_DWORD,
 				((struct hgsl_db_cmds *)src)->timestamp);
+}
+
+static void db_ring(struct hgsl_priv *priv)
+{
+	struct qcom_hgsl *hgsl = priv->dev;
 
 	/* confirm write to memory done before ring door bell. */
 	wmb();
@@ -491,24 +486,71 @@ static int db_send_msg(struct hgsl_priv  *priv,
 	else
 		/* trigger GMU interrupt */
 		gmu_ring_local_db(hgsl, priv->dbq_idx);
+}
+
+/*
+ * Writes @count messages to the queue and rings the doorbell once for all
+ * of them, or each time the queue has to drain to take the next one.
+ * Returns the number of messages sent if any, the error otherwise.
+ */
+static int db_send_msgs(struct hgsl_priv *priv,
+			struct db_msg_request *msg_req, int count)
+{
+	struct qcom_hgsl *hgsl = priv->dev;
+	struct doorbell_queue *dbq = &hgsl->dbq[priv->dbq_idx];
+	uint32_t msg_size_align;
+	int pending = 0;
+	int ret = 0;
+	int i;
+
+	mutex_lock(&hgsl->lock);
+	for (i = 0; i < count; i++) {
+		msg_size_align = ALIGN(msg_req[i].msg_dwords, 4);
+
+		if (pending && db_queue_freedwords(dbq) < msg_size_align) {
+			db_ring(priv);
+			pending = 0;
+		}
+
+		ret = db_queue_wait_freewords(dbq, msg_size_align);
+		if (ret < 0) {
+			dev_err(hgsl->dev,
+				"Timed out waiting for queue to free up\n");
+			break;
+		}
 
-quit:
+		db_queue_write(dbq, &msg_req[i]);
+		pending++;
+	}
+
+	if (pending)
+		db_ring(priv);
 	mutex_unlock(&hgsl->lock);
-	return ret;
+
+	return i ? i : ret;
 }
 
-static int hgsl_db_issue_cmd(struct hgsl_priv  *priv,
+static int db_send_msg(struct hgsl_priv  *priv,
+			struct db_msg_id *db_msg_id,
+			struct db_msg_request *msg_req,
+			struct db_msg_response *msg_resp)
+{
+	int ret = db_send_msgs(priv, msg_req, 1);
+
+	return ret < 0 ? ret : 0;
+}
+
+/* Builds the issue message of a command in @req, to be freed by the caller */
+static int hgsl_db_build_cmd(struct hgsl_priv  *priv,
 			uint32_t ctx_id, uint32_t num_ibs,
 			uint32_t gmu_cmd_flags,
 			uint32_t timestamp,
-			struct hgsl_fw_ib_desc ib_descs[])
+			struct hgsl_fw_ib_desc ib_descs[],
+			struct db_msg_request *req)
 {
-	int ret;
 	uint32_t msg_dwords;
 	uint32_t msg_buf_sz;
 	struct hgsl_db_cmds *cmds;
-	struct db_msg_request req;
-	struct db_msg_response resp;
 	struct db_msg_id db_msg_id;
 	struct doorbell_queue *dbq;
 	struct qcom_hgsl  *hgsl = priv->dev;
@@ -541,15 +583,34 @@ static int hgsl_db_issue_cmd(struct hgsl_priv  *priv,
 	cmds->timestamp = timestamp;
 	memcpy(cmds->ib_descs, ib_descs, sizeof(ib_descs[0]) * num_ibs);
 
-	req.msg_has_response = 0;
-	req.msg_has_ret_packet = 0;
-	req.ignore_ret_packet = 1;
-	req.msg_dwords = msg_dwords;
-	req.ptr_data = cmds;
+	req->msg_has_response = 0;
+	req->msg_has_ret_packet = 0;
+	req->ignore_ret_packet = 1;
+	req->msg_dwords = msg_dwords;
+	req->ptr_data = cmds;
+
+	return 0;
+}
+
+static int hgsl_db_issue_cmd(struct hgsl_priv  *priv,
+			uint32_t ctx_id, uint32_t num_ibs,
+			uint32_t gmu_cmd_flags,
+			uint32_t timestamp,
+			struct hgsl_fw_ib_desc ib_descs[])
+{
+	int ret;
+	struct db_msg_request req;
+	struct db_msg_response resp;
+	struct db_msg_id db_msg_id;
+
+	ret = hgsl_db_build_cmd(priv, ctx_id, num_ibs, gmu_cmd_flags,
+				timestamp, ib_descs, &req);
+	if (ret)
+		return ret;
 
 	ret = db_send_msg(priv, &db_msg_id, &req, &resp);
 
-	kfree(cmds);
+	kfree(req.ptr_data);
 	return ret;
 }
 
@@ -646,6 +707,118 @@ static int hgsl_cmdstream_db_issueib(struct file *filep,
 	return ret;
 }
 
+/* Reads the IBs of a command from userspace, in the firmware layout */
+static int hgsl_get_fw_ibs(struct hgsl_fhi_issud_cmds *info,
+			struct hgsl_fw_ib_desc **fw_ibs)
+{
+	struct hgsl_ibdesc *ibs;
+	struct hgsl_fw_ib_desc *list;
+	int idx;
+
+	if (info->num_ibs == 0 ||
+			info->num_ibs > U32_MAX / sizeof(ibs[0]))
+		return -EINVAL;
+
+	ibs = kmalloc_array(info->num_ibs, sizeof(ibs[0]), GFP_KERNEL);
+	list = kmalloc_array(info->num_ibs, sizeof(list[0]), GFP_KERNEL);
+	if (ibs == NULL || list == NULL) {
+		kfree(ibs);
+		kfree(list);
+		return -ENOMEM;
+	}
+
+	if (copy_from_user(ibs, USRPTR(info->ibs),
+			sizeof(ibs[0]) * info->num_ibs)) {
+		kfree(ibs);
+		kfree(list);
+		return -EFAULT;
+	}
+
+	for (idx = 0; idx < info->num_ibs; ++idx) {
+		list[idx].addr = ibs[idx].gpuaddr;
+		list[idx].sz = ibs[idx].sizedwords << 2;
+	}
+
+	kfree(ibs);
+	*fw_ibs = list;
+	return 0;
+}
+
+static int hgsl_cmdstream_db_issueib_batch(struct file *filep,
+				       unsigned long arg)
+{
+	struct hgsl_priv *priv = filep->private_data;
+	struct qcom_hgsl *hgsl = priv->dev;
+	struct hgsl_fhi_issue_batch batch;
+	struct hgsl_fhi_issud_cmds *cmds = NULL;
+	struct hgsl_fw_ib_desc *fw_ib_list;
+	struct db_msg_request *reqs = NULL;
+	uint32_t gmu_flags = CMDBATCH_NOTIFY;
+	int built = 0;
+	int idx;
+	int ret;
+
+	if (copy_from_user(&batch, USRPTR(arg), sizeof(batch)))
+		return -EFAULT;
+
+	if (!hgsl_ctx_dbq_ready(priv)) {
+		dev_err(hgsl->dev, "Doorbell invalid\n");
+		return -EINVAL;
+	}
+
+	if (batch.num_cmds == 0 || batch.num_cmds > HGSL_ISSUE_BATCH_MAX)
+		return -EINVAL;
+
+	cmds = kmalloc_array(batch.num_cmds, sizeof(*cmds), GFP_KERNEL);
+	reqs = kcalloc(batch.num_cmds, sizeof(*reqs), GFP_KERNEL);
+	if (cmds == NULL || reqs == NULL) {
+		ret = -ENOMEM;
+		goto exit;
+	}
+
+	if (copy_from_user(cmds, USRPTR(batch.cmds),
+			sizeof(*cmds) * batch.num_cmds)) {
+		ret = -EFAULT;
+		goto exit;
+	}
+
+	for (idx = 0; idx < batch.num_cmds; idx++) {
+		ret = hgsl_get_fw_ibs(&cmds[idx], &fw_ib_list);
+		if (ret)
+			goto exit;
+
+		ret = hgsl_db_build_cmd(priv, cmds[idx].context_id,
+					cmds[idx].num_ibs, gmu_flags,
+					cmds[idx].timestamp, fw_ib_list,
+					&reqs[idx]);
+		kfree(fw_ib_list);
+		if (ret)
+			goto exit;
+		built++;
+	}
+
+	ret = db_send_msgs(priv, reqs, built);
+	if (ret < 0)
+		goto exit;
+
+	batch.num_issued = ret;
+	ret = 0;
+	if (copy_to_user(USRPTR(arg), &batch, sizeof(batch)))
+		ret = -EFAULT;
+
+exit:
+	if (ret)
+		dev_err(hgsl->dev, "batch of %d cmds failed at %d, ret %d\n",
+			batch.num_cmds, built, ret);
+
+	for (idx = 0; idx < built; idx++)
+		kfree(reqs[idx].ptr_data);
+	kfree(reqs);
+	kfree(cmds);
+
+	return ret;
+}
+
 static int hgsl_dbq_get_state(struct file *filep,
 				 unsigned long arg)
 {
@@ -1254,6 +1427,9 @@ static long hgsl_ioctl(struct file *filep, unsigned int cmd, unsigned long arg)
 	case HGSL_IOCTL_ISSUE_CMDS:
 		ret = hgsl_cmdstream_db_issueib(filep, arg);
 		break;
+	case HGSL_IOCTL_ISSUE_CMDS_BATCH:
+		ret = hgsl_cmdstream_db_issueib_batch(filep, arg);
+		break;
 	case HGSL_IOCTL_DBQ_GETSTATE:
 		ret = hgsl_dbq_get_state(filep, arg);
 		break;
@@ -1282,6 +1458,44 @@ static long hgsl_ioctl(struct file *filep, unsigned int cmd, unsigned long arg)
 	return ret;
 }
 
+static int hgsl_mmap(struct file *filep, struct vm_area_struct *vma)
+{
+	struct hgsl_priv *priv = filep->private_data;
+	struct qcom_hgsl *hgsl = priv->dev;
+	unsigned long context_id = vma->vm_pgoff;
+	struct hgsl_context *ctxt = NULL;
+	int ret;
+
+	if (!is_global_db(hgsl->tcsr_idx) || hgsl->contexts == NULL)
+		return -ENODEV;
+
+	if (context_id >= HGSL_CONTEXT_NUM)
+		return -EINVAL;
+
+	/* the timestamps are for the GPU to write */
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	read_lock(&hgsl->ctxt_lock);
+	if (hgsl->contexts[context_id] != NULL &&
+			hgsl->contexts[context_id]->pid == priv->pid) {
+		ctxt = hgsl->contexts[context_id];
+		kref_get(&ctxt->kref);
+	}
+	read_unlock(&hgsl->ctxt_lock);
+
+	if (ctxt == NULL)
+		return -EINVAL;
+
+	/* the mapping holds its own reference to the buffer */
+	vma->vm_pgoff = 0;
+	ret = dma_buf_mmap(ctxt->shadow_dma, vma, 0);
+
+	kref_put(&ctxt->kref, _destroy_context);
+	return ret;
+}
+
 static long hgsl_compat_ioctl(struct file *filep, unsigned int cmd,
 	unsigned long arg)
 {
@@ -1293,6 +1507,7 @@ static const struct file_operations hgsl_fops = {
 	.open = hgsl_open,
 	.release = hgsl_release,
 	.read = hgsl_read,
+	.mmap = hgsl_mmap,
 	.unlocked_ioctl = hgsl_ioctl,
 	.compat_ioctl = hgsl_compat_ioctl
 };
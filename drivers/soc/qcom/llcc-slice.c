@@ -62,6 +62,8 @@
  * @slice_data: pointer to llcc slice config data
  * @sz: Size of the config data table
  * @llcc_slice_map: Bit map to track the active slice ids
+ * @llcc_slice_parked: Bit map of active slice ids powered down by
+ *		       llcc_slice_park() until their next use
  */
 struct llcc_drv_data {
 	struct regmap *llcc_map;
@@ -72,6 +74,7 @@ struct llcc_drv_data {
 	u32 b_off;
 	u32 no_banks;
 	unsigned long *llcc_slice_map;
+	unsigned long *llcc_slice_parked;
 	bool cap_based_alloc_and_pwr_collapse;
 };
 
@@ -198,6 +201,26 @@ static int llcc_update_act_ctrl(struct llcc_drv_data *drv, u32 sid,
 	return -ETIMEDOUT;
 }
 
+static int llcc_hw_activate(struct llcc_drv_data *drv, u32 sid)
+{
+	u32 act_ctrl_val;
+
+	act_ctrl_val = ACT_CTRL_OPCODE_ACTIVATE << ACT_CTRL_OPCODE_SHIFT;
+	act_ctrl_val |= ACT_CTRL_ACT_TRIG;
+
+	return llcc_update_act_ctrl(drv, sid, act_ctrl_val, DEACTIVATE);
+}
+
+static int llcc_hw_deactivate(struct llcc_drv_data *drv, u32 sid)
+{
+	u32 act_ctrl_val;
+
+	act_ctrl_val = ACT_CTRL_OPCODE_DEACTIVATE << ACT_CTRL_OPCODE_SHIFT;
+	act_ctrl_val |= ACT_CTRL_ACT_TRIG;
+
+	return llcc_update_act_ctrl(drv, sid, act_ctrl_val, ACTIVATE);
+}
+
 /**
  * llcc_slice_activate - Activate the llcc slice
  * @desc: Pointer to llcc slice descriptor
@@ -208,7 +231,6 @@ static int llcc_update_act_ctrl(struct llcc_drv_data *drv, u32 sid,
 int llcc_slice_activate(struct llcc_slice_desc *desc)
 {
 	int rc = -EINVAL;
-	u32 act_ctrl_val;
 	struct llcc_drv_data *drv;
 
 	if (desc == NULL) {
@@ -223,17 +245,16 @@ int llcc_slice_activate(struct llcc_slice_desc *desc)
 	}
 
 	mutex_lock(&drv->slice_mutex);
-	if (test_bit(desc->llcc_slice_id, drv->llcc_slice_map)) {
+	if (test_bit(desc->llcc_slice_id, drv->llcc_slice_map) &&
+	    !test_bit(desc->llcc_slice_id, drv->llcc_slice_parked)) {
 		mutex_unlock(&drv->slice_mutex);
 		return 0;
 	}
 
-	act_ctrl_val = ACT_CTRL_OPCODE_ACTIVATE << ACT_CTRL_OPCODE_SHIFT;
-	act_ctrl_val |= ACT_CTRL_ACT_TRIG;
-
-	rc = llcc_update_act_ctrl(drv, desc->llcc_slice_id, act_ctrl_val,
-				  DEACTIVATE);
+	/* An explicit activate is a use, it wakes up a parked slice too */
+	rc = llcc_hw_activate(drv, desc->llcc_slice_id);
 
+	__clear_bit(desc->llcc_slice_id, drv->llcc_slice_parked);
 	__set_bit(desc->llcc_slice_id, drv->llcc_slice_map);
 	mutex_unlock(&drv->slice_mutex);
 
@@ -250,7 +271,6 @@ EXPORT_SYMBOL(llcc_slice_activate);
  */
 int llcc_slice_deactivate(struct llcc_slice_desc *desc)
 {
-	u32 act_ctrl_val;
 	int rc = -EINVAL;
 	struct llcc_drv_data *drv;
 
@@ -270,11 +290,12 @@ int llcc_slice_deactivate(struct llcc_slice_desc *desc)
 		mutex_unlock(&drv->slice_mutex);
 		return 0;
 	}
-	act_ctrl_val = ACT_CTRL_OPCODE_DEACTIVATE << ACT_CTRL_OPCODE_SHIFT;
-	act_ctrl_val |= ACT_CTRL_ACT_TRIG;
 
-	rc = llcc_update_act_ctrl(drv, desc->llcc_slice_id, act_ctrl_val,
-				  ACTIVATE);
+	/* A parked slice is powered down already */
+	if (!__test_and_clear_bit(desc->llcc_slice_id, drv->llcc_slice_parked))
+		rc = llcc_hw_deactivate(drv, desc->llcc_slice_id);
+	else
+		rc = 0;
 
 	__clear_bit(desc->llcc_slice_id, drv->llcc_slice_map);
 	mutex_unlock(&drv->slice_mutex);
@@ -283,6 +304,82 @@ int llcc_slice_deactivate(struct llcc_slice_desc *desc)
 }
 EXPORT_SYMBOL(llcc_slice_deactivate);
 
+/**
+ * llcc_slice_is_active - check whether the client has the slice activated
+ * @desc: Pointer to llcc slice descriptor
+ *
+ * True is returned for an activated slice, parked or not.
+ */
+bool llcc_slice_is_active(struct llcc_slice_desc *desc)
+{
+	struct llcc_drv_data *drv;
+
+	if (!desc)
+		return false;
+
+	drv = dev_get_drvdata(desc->dev);
+	if (!drv)
+		return false;
+
+	return test_bit(desc->llcc_slice_id, drv->llcc_slice_map);
+}
+EXPORT_SYMBOL(llcc_slice_is_active);
+
+/**
+ * llcc_slice_park - power an idle slice down behind its client's back
+ * @desc: Pointer to llcc slice descriptor
+ * @park: true to deactivate the slice, false to activate it again
+ *
+ * The slice stays activated as far as its client is concerned: a later
+ * llcc_slice_activate() or llcc_slice_park(desc, false) powers it up
+ * again, llcc_slice_deactivate() just forgets that it was parked.
+ *
+ * A value zero will be returned on success, -ENOENT if the client has
+ * not activated the slice and another negative errno in error cases
+ */
+int llcc_slice_park(struct llcc_slice_desc *desc, bool park)
+{
+	int rc = -EINVAL;
+	struct llcc_drv_data *drv;
+	u32 sid;
+
+	if (desc == NULL) {
+		pr_err("Input descriptor supplied is invalid\n");
+		return rc;
+	}
+
+	drv = dev_get_drvdata(desc->dev);
+	if (!drv) {
+		pr_err("Invalid device pointer in the desc\n");
+		return rc;
+	}
+
+	sid = desc->llcc_slice_id;
+	mutex_lock(&drv->slice_mutex);
+	if (!test_bit(sid, drv->llcc_slice_map)) {
+		rc = -ENOENT;
+		goto out;
+	}
+
+	rc = 0;
+	if (park == test_bit(sid, drv->llcc_slice_parked))
+		goto out;
+
+	if (park) {
+		rc = llcc_hw_deactivate(drv, sid);
+		if (!rc)
+			__set_bit(sid, drv->llcc_slice_parked);
+	} else {
+		rc = llcc_hw_activate(drv, sid);
+		__clear_bit(sid, drv->llcc_slice_parked);
+	}
+out:
+	mutex_unlock(&drv->slice_mutex);
+
+	return rc;
+}
+EXPORT_SYMBOL(llcc_slice_park);
+
 /**
  * llcc_get_slice_id - return the slice id
  * @desc: Pointer to llcc slice descriptor
@@ -315,6 +412,78 @@ size_t llcc_get_slice_size(struct llcc_slice_desc *desc)
 }
 EXPORT_SYMBOL(llcc_get_slice_size);
 
+static u32 llcc_attr1_val(struct llcc_drv_data *drv,
+			  const struct llcc_slice_config *cfg, u32 max_cap)
+{
+	u32 attr1_val;
+	u32 max_cap_cacheline;
+
+	attr1_val = cfg->cache_mode;
+	attr1_val |= (cfg->probe_target_ways << ATTR1_PROBE_TARGET_WAYS_SHIFT);
+	attr1_val |= (cfg->fixed_size << ATTR1_FIXED_SIZE_SHIFT);
+	attr1_val |= (cfg->priority << ATTR1_PRIORITY_SHIFT);
+
+	max_cap_cacheline = MAX_CAP_TO_BYTES(max_cap);
+
+	/* LLCC instances can vary for each target.
+	 * The SW writes to broadcast register which gets propagated
+	 * to each llcc instace (llcc0,.. llccN).
+	 * Since the size of the memory is divided equally amongst the
+	 * llcc instances, we need to configure the max cap accordingly.
+	 */
+	max_cap_cacheline = (max_cap_cacheline / drv->no_banks);
+	max_cap_cacheline >>= CACHE_LINE_SIZE_SHIFT;
+	attr1_val |= (max_cap_cacheline << ATTR1_MAX_CAP_SHIFT);
+
+	return attr1_val;
+}
+
+/**
+ * llcc_slice_resize - change the capacity of the llcc slice
+ * @desc: Pointer to llcc slice descriptor
+ * @size: New capacity of the slice in KB
+ *
+ * Only the max_cap of the SCT entry changes, the ways stay as they are.
+ * The new capacity is reported by llcc_get_slice_size() of @desc.
+ *
+ * A value zero will be returned on success and a negative errno will
+ * be returned in error cases
+ */
+int llcc_slice_resize(struct llcc_slice_desc *desc, size_t size)
+{
+	const struct llcc_slice_config *cfg;
+	struct llcc_drv_data *drv;
+	u32 i;
+
+	if (desc == NULL || !size) {
+		pr_err("Input descriptor supplied is invalid\n");
+		return -EINVAL;
+	}
+
+	drv = dev_get_drvdata(desc->dev);
+	if (!drv) {
+		pr_err("Invalid device pointer in the desc\n");
+		return -EINVAL;
+	}
+
+	for (i = 0; i < drv->llcc_config_data_sz; i++)
+		if (drv->slice_data[i].slice_id == desc->llcc_slice_id)
+			break;
+	if (i == drv->llcc_config_data_sz)
+		return -ENODEV;
+	cfg = &drv->slice_data[i];
+
+	mutex_lock(&drv->slice_mutex);
+	regmap_write(drv->llcc_map,
+		     drv->b_off + LLCC_TRP_ATTR1_CFGn(desc->llcc_slice_id),
+		     llcc_attr1_val(drv, cfg, size));
+	desc->llcc_slice_size = size;
+	mutex_unlock(&drv->slice_mutex);
+
+	return 0;
+}
+EXPORT_SYMBOL(llcc_slice_resize);
+
 static void qcom_llcc_cfg_program(struct platform_device *pdev)
 {
 	int i;
@@ -324,7 +493,6 @@ static void qcom_llcc_cfg_program(struct platform_device *pdev)
 	u32 attr0_val;
 	u32 cad_off;
 	u32 pcb_off;
-	u32 max_cap_cacheline;
 	u32 sz;
 	u32 pcb = 0;
 	u32 cad = 0;
@@ -342,24 +510,8 @@ static void qcom_llcc_cfg_program(struct platform_device *pdev)
 		attr1_cfg = b_off + LLCC_TRP_ATTR1_CFGn(llcc_table[i].slice_id);
 		attr0_cfg = b_off + LLCC_TRP_ATTR0_CFGn(llcc_table[i].slice_id);
 
-		attr1_val = llcc_table[i].cache_mode;
-		attr1_val |= (llcc_table[i].probe_target_ways <<
-				ATTR1_PROBE_TARGET_WAYS_SHIFT);
-		attr1_val |= (llcc_table[i].fixed_size <<
-				ATTR1_FIXED_SIZE_SHIFT);
-		attr1_val |= (llcc_table[i].priority << ATTR1_PRIORITY_SHIFT);
-
-		max_cap_cacheline = MAX_CAP_TO_BYTES(llcc_table[i].max_cap);
-
-		/* LLCC instances can vary for each target.
-		 * The SW writes to broadcast register which gets propagated
-		 * to each llcc instace (llcc0,.. llccN).
-		 * Since the size of the memory is divided equally amongst the
-		 * llcc instances, we need to configure the max cap accordingly.
-		 */
-		max_cap_cacheline = (max_cap_cacheline / drv->no_banks);
-		max_cap_cacheline >>= CACHE_LINE_SIZE_SHIFT;
-		attr1_val |= (max_cap_cacheline << ATTR1_MAX_CAP_SHIFT);
+		attr1_val = llcc_attr1_val(drv, &llcc_table[i],
+					   llcc_table[i].max_cap);
 
 		attr0_val = llcc_table[i].res_ways & ATTR0_RES_WAYS_MASK;
 		attr0_val |= llcc_table[i].bonus_ways << ATR0_BONUS_WAYS_SHIFT;
@@ -444,6 +596,15 @@ int qcom_llcc_probe(struct platform_device *pdev,
 		return PTR_ERR(drv_data->llcc_slice_map);
 	}
 
+	drv_data->llcc_slice_parked = kcalloc(
+				   BITS_TO_LONGS(drv_data->max_slices),
+				   sizeof(unsigned long), GFP_KERNEL);
+	if (!drv_data->llcc_slice_parked) {
+		kfree(drv_data->llcc_slice_map);
+		devm_kfree(&pdev->dev, drv_data);
+		return -ENOMEM;
+	}
+
 	bitmap_zero(drv_data->llcc_slice_map, drv_data->max_slices);
 	drv_data->slice_data = llcc_cfg;
 	drv_data->llcc_config_data_sz = sz;
@@ -463,6 +624,7 @@ int qcom_llcc_remove(struct platform_device *pdev)
 	drv_data = platform_get_drvdata(pdev);
 
 	mutex_destroy(&drv_data->slice_mutex);
+	kfree(drv_data->llcc_slice_parked);
 	kfree(drv_data->llcc_slice_map);
 	devm_kfree(&pdev->dev, drv_data);
 	platform_set_drvdata(pdev, NULL);
@@ -23,6 +23,10 @@
 #include <linux/soc/qcom/llcc-qcom.h>
 #include <linux/module.h>
 #include <linux/clk.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
 #include "llcc_events.h"
 #include "llcc_perfmon.h"
 
@@ -32,6 +36,47 @@
 #define NUM_CHANNELS			16
 #define MAX_STRING_SIZE			20
 #define DELIM_CHAR			" "
+#define LLCC_POLICY_SLICES_MAX		8
+#define LLCC_POLICY_CNT_ACCESS		0
+#define LLCC_POLICY_CNT_HIT		1
+#define LLCC_POLICY_CNT_DEACTIVE	2
+
+static unsigned int policy_period_ms = 100;
+module_param(policy_period_ms, uint, 0644);
+MODULE_PARM_DESC(policy_period_ms, "slice policy sample period");
+
+static unsigned int policy_idle_access = 1024;
+module_param(policy_idle_access, uint, 0644);
+MODULE_PARM_DESC(policy_idle_access,
+		 "accesses per sample below which a slice is idle");
+
+static unsigned int policy_idle_samples = 3;
+module_param(policy_idle_samples, uint, 0644);
+MODULE_PARM_DESC(policy_idle_samples, "idle samples before parking a slice");
+
+static unsigned int policy_grow_pct = 40;
+module_param(policy_grow_pct, uint, 0644);
+MODULE_PARM_DESC(policy_grow_pct, "hit rate below which a slice grows");
+
+static unsigned int policy_shrink_pct = 90;
+module_param(policy_shrink_pct, uint, 0644);
+MODULE_PARM_DESC(policy_shrink_pct, "hit rate above which a slice shrinks");
+
+static unsigned int policy_hold_samples = 3;
+module_param(policy_hold_samples, uint, 0644);
+MODULE_PARM_DESC(policy_hold_samples, "samples over policy_shrink_pct before a shrink");
+
+static unsigned int policy_step_pct = 25;
+module_param(policy_step_pct, uint, 0644);
+MODULE_PARM_DESC(policy_step_pct, "resize step, percent of the table size");
+
+static unsigned int policy_min_pct = 25;
+module_param(policy_min_pct, uint, 0644);
+MODULE_PARM_DESC(policy_min_pct, "smallest slice, percent of the table size");
+
+static unsigned int policy_max_pct = 150;
+module_param(policy_max_pct, uint, 0644);
+MODULE_PARM_DESC(policy_max_pct, "largest slice, percent of the table size");
 
 /**
  * struct llcc_perfmon_counter_map	- llcc perfmon counter map info
@@ -45,6 +90,46 @@ struct llcc_perfmon_counter_map {
 	unsigned long long counter_dump;
 };
 
+/**
+ * struct llcc_policy_slice	- slice managed by the usage policy
+ * @name:		cache-slice-names entry of the slice
+ * @desc:		slice descriptor, its size follows the resizes
+ * @table_size:		size of the slice in the SoC table, in KB
+ * @parked:		slice powered down by the policy
+ * @idle:		consecutive idle samples
+ * @hold:		consecutive samples asking for a smaller slice
+ * @hit_pct:		hit rate of the last sample
+ * @accesses:		accesses seen in the samples of the slice
+ * @hits:		hits seen in the samples of the slice
+ * @parks:		times the slice was parked
+ * @unparks:		times a parked slice was activated again
+ * @grows:		times the slice grew
+ * @shrinks:		times the slice shrank
+ * @active_ns:		time spent activated
+ * @parked_ns:		time spent parked
+ * @off_ns:		time spent deactivated by its client
+ * @stamp:		start of the residency not accounted yet
+ */
+struct llcc_policy_slice {
+	const char *name;
+	struct llcc_slice_desc *desc;
+	size_t table_size;
+	bool parked;
+	unsigned int idle;
+	unsigned int hold;
+	unsigned int hit_pct;
+	u64 accesses;
+	u64 hits;
+	unsigned long parks;
+	unsigned long unparks;
+	unsigned long grows;
+	unsigned long shrinks;
+	u64 active_ns;
+	u64 parked_ns;
+	u64 off_ns;
+	ktime_t stamp;
+};
+
 struct llcc_perfmon_private;
 /**
  * struct event_port_ops		- event port operation
@@ -79,6 +164,13 @@ struct event_port_ops {
  * @clk:		clock node to enable qdss
  * @num_mc:		number of MCS
  * @version:		Version information of llcc block
+ * @dev:		perfmon device
+ * @policy_lock:	serializes starting and stopping the slice policy
+ * @policy_enabled:	slice policy owns the counters
+ * @policy_slices:	slices named in cache-slice-names of the device
+ * @policy_num_slices:	number of @policy_slices
+ * @policy_next:	slice the counters are filtered on
+ * @policy_work:	periodic sample of the slice policy
  */
 struct llcc_perfmon_private {
 	struct regmap *llcc_map;
@@ -97,6 +189,13 @@ struct llcc_perfmon_private {
 	struct clk *clock;
 	unsigned int num_mc;
 	unsigned int version;
+	struct device *dev;
+	struct mutex policy_lock;
+	bool policy_enabled;
+	struct llcc_policy_slice *policy_slices;
+	unsigned int policy_num_slices;
+	unsigned int policy_next;
+	struct delayed_work policy_work;
 };
 
 static inline void llcc_bcast_write(struct llcc_perfmon_private *llcc_priv,
@@ -271,6 +370,12 @@ static ssize_t perfmon_configure_store(struct device *dev,
 	char *token, *delim = DELIM_CHAR;
 
 	mutex_lock(&llcc_priv->mutex);
+	if (llcc_priv->policy_enabled) {
+		pr_err("Counters used by the slice policy\n");
+		mutex_unlock(&llcc_priv->mutex);
+		return -EBUSY;
+	}
+
 	if (llcc_priv->configured_counters) {
 		pr_err("Counters configured already, remove & try again\n");
 		mutex_unlock(&llcc_priv->mutex);
@@ -448,6 +553,11 @@ static ssize_t perfmon_filter_config_store(struct device *dev,
 	}
 
 	mutex_lock(&llcc_priv->mutex);
+	if (llcc_priv->policy_enabled) {
+		pr_err("filter configuration failed, used by the slice policy\n");
+		mutex_unlock(&llcc_priv->mutex);
+		return -EBUSY;
+	}
 
 	token = strsep((char **)&buf, delim);
 	if (token != NULL)
@@ -569,6 +679,12 @@ static ssize_t perfmon_start_store(struct device *dev,
 		return -EINVAL;
 
 	mutex_lock(&llcc_priv->mutex);
+	if (llcc_priv->policy_enabled) {
+		pr_err("perfmon used by the slice policy\n");
+		mutex_unlock(&llcc_priv->mutex);
+		return -EBUSY;
+	}
+
 	if (start) {
 		if (!llcc_priv->configured_counters) {
 			pr_err("start failed. perfmon not configured\n");
@@ -1220,6 +1336,396 @@ static struct event_port_ops pmgr_port_ops = {
 	.event_config	= pmgr_event_config,
 };
 
+static u64 llcc_policy_counter(struct llcc_perfmon_private *llcc_priv,
+		unsigned int n)
+{
+	unsigned int j;
+	uint32_t val;
+	u64 total = 0;
+
+	for (j = 0; j < llcc_priv->num_banks; j++) {
+		regmap_read(llcc_priv->llcc_map, llcc_priv->bank_off[j] +
+				LLCC_COUNTER_n_VALUE(n), &val);
+		total += val;
+	}
+
+	return total;
+}
+
+/* Charge the time since the last call to the state the slice is in */
+static void llcc_policy_account(struct llcc_policy_slice *slice, ktime_t now)
+{
+	u64 delta = ktime_to_ns(ktime_sub(now, slice->stamp));
+
+	if (!llcc_slice_is_active(slice->desc)) {
+		/* the client deactivated it, that unparks it too */
+		slice->parked = false;
+		slice->off_ns += delta;
+	} else if (slice->parked) {
+		slice->parked_ns += delta;
+	} else {
+		slice->active_ns += delta;
+	}
+	slice->stamp = now;
+}
+
+/*
+ * Parking and growing act on the first sample that asks for it, shrinking
+ * only after policy_hold_samples of them and parking after
+ * policy_idle_samples: a client coming back finds its slice quickly, one
+ * going quiet for a frame keeps it.
+ */
+static void llcc_policy_eval(struct llcc_policy_slice *slice, u64 access,
+		u64 hit, u64 deactive)
+{
+	struct llcc_slice_desc *desc = slice->desc;
+	size_t size, step, limit;
+
+	slice->accesses += access;
+	slice->hits += hit;
+
+	if (!llcc_slice_is_active(desc)) {
+		slice->idle = slice->hold = 0;
+		return;
+	}
+
+	if (slice->parked) {
+		if (deactive >= policy_idle_access &&
+		    !llcc_slice_park(desc, false)) {
+			slice->parked = false;
+			slice->unparks++;
+		}
+		return;
+	}
+
+	slice->hit_pct = access ? div64_u64(hit * 100, access) : 0;
+	if (access < policy_idle_access) {
+		slice->hold = 0;
+		if (++slice->idle >= policy_idle_samples &&
+		    !llcc_slice_park(desc, true)) {
+			slice->idle = 0;
+			slice->parked = true;
+			slice->parks++;
+		}
+		return;
+	}
+	slice->idle = 0;
+
+	size = llcc_get_slice_size(desc);
+	step = max_t(size_t, slice->table_size * policy_step_pct / 100, 1);
+	if (slice->hit_pct < policy_grow_pct) {
+		slice->hold = 0;
+		limit = slice->table_size * policy_max_pct / 100;
+		if (size < limit &&
+		    !llcc_slice_resize(desc, min(size + step, limit)))
+			slice->grows++;
+	} else if (slice->hit_pct > policy_shrink_pct) {
+		if (++slice->hold < policy_hold_samples)
+			return;
+		slice->hold = 0;
+		limit = max_t(size_t, slice->table_size * policy_min_pct / 100,
+				1);
+		if (size <= limit)
+			return;
+		size = max(size > step ? size - step : 0, limit);
+		if (!llcc_slice_resize(desc, size))
+			slice->shrinks++;
+	} else {
+		slice->hold = 0;
+	}
+}
+
+static void llcc_policy_work(struct work_struct *work)
+{
+	struct llcc_perfmon_private *llcc_priv = container_of(work,
+			struct llcc_perfmon_private, policy_work.work);
+	struct llcc_policy_slice *slice;
+	u64 access, hit, deactive;
+	ktime_t now;
+	unsigned int i;
+
+	mutex_lock(&llcc_priv->mutex);
+	if (!llcc_priv->policy_enabled)
+		goto out_unlock;
+
+	/* counters clear on dump, the next slice starts from zero */
+	llcc_bcast_write(llcc_priv, PERFMON_DUMP, MONITOR_DUMP);
+	access = llcc_policy_counter(llcc_priv, LLCC_POLICY_CNT_ACCESS);
+	hit = llcc_policy_counter(llcc_priv, LLCC_POLICY_CNT_HIT);
+	deactive = llcc_policy_counter(llcc_priv, LLCC_POLICY_CNT_DEACTIVE);
+
+	now = ktime_get();
+	for (i = 0; i < llcc_priv->policy_num_slices; i++)
+		llcc_policy_account(&llcc_priv->policy_slices[i], now);
+
+	slice = &llcc_priv->policy_slices[llcc_priv->policy_next];
+	llcc_policy_eval(slice, access, hit, deactive);
+
+	/* one SCID filter, the slices take turns */
+	if (llcc_priv->policy_num_slices > 1) {
+		llcc_priv->policy_next = (llcc_priv->policy_next + 1) %
+			llcc_priv->policy_num_slices;
+		slice = &llcc_priv->policy_slices[llcc_priv->policy_next];
+		trp_event_filter_config(llcc_priv, SCID,
+				llcc_get_slice_id(slice->desc), true);
+	}
+
+	queue_delayed_work(system_freezable_wq, &llcc_priv->policy_work,
+			msecs_to_jiffies(max(policy_period_ms, 1U)));
+out_unlock:
+	mutex_unlock(&llcc_priv->mutex);
+}
+
+/* Slices are looked up on first use, the llcc device probes on its own */
+static int llcc_policy_get_slices(struct llcc_perfmon_private *llcc_priv)
+{
+	struct device_node *np = llcc_priv->dev->of_node;
+	struct llcc_policy_slice *slices;
+	struct llcc_slice_desc *desc;
+	const char *name;
+	int i, count, ret;
+
+	if (llcc_priv->policy_num_slices)
+		return 0;
+
+	count = of_property_count_strings(np, "cache-slice-names");
+	if (count <= 0)
+		return -ENODEV;
+	count = min(count, LLCC_POLICY_SLICES_MAX);
+
+	slices = kcalloc(count, sizeof(*slices), GFP_KERNEL);
+	if (!slices)
+		return -ENOMEM;
+
+	for (i = 0; i < count; i++) {
+		ret = of_property_read_string_index(np, "cache-slice-names", i,
+				&name);
+		if (ret)
+			goto err_put;
+
+		desc = llcc_slice_getd(llcc_priv->dev, name);
+		if (IS_ERR_OR_NULL(desc)) {
+			ret = desc ? PTR_ERR(desc) : -ENODEV;
+			goto err_put;
+		}
+
+		slices[i].name = name;
+		slices[i].desc = desc;
+		slices[i].table_size = llcc_get_slice_size(desc);
+	}
+
+	llcc_priv->policy_slices = slices;
+	llcc_priv->policy_num_slices = count;
+	return 0;
+
+err_put:
+	pr_err("cannot get slice %d for the policy: %d\n", i, ret);
+	while (i--)
+		llcc_slice_putd(slices[i].desc);
+	kfree(slices);
+	return ret;
+}
+
+static void llcc_policy_put_slices(struct llcc_perfmon_private *llcc_priv)
+{
+	unsigned int i;
+
+	for (i = 0; i < llcc_priv->policy_num_slices; i++)
+		llcc_slice_putd(llcc_priv->policy_slices[i].desc);
+	kfree(llcc_priv->policy_slices);
+	llcc_priv->policy_slices = NULL;
+	llcc_priv->policy_num_slices = 0;
+}
+
+static int llcc_policy_start(struct llcc_perfmon_private *llcc_priv)
+{
+	struct llcc_policy_slice *slice;
+	uint32_t mask;
+	ktime_t now;
+	unsigned int i;
+	int ret = 0;
+
+	mutex_lock(&llcc_priv->policy_lock);
+	mutex_lock(&llcc_priv->mutex);
+	if (llcc_priv->policy_enabled)
+		goto out_unlock;
+
+	if (llcc_priv->configured_counters || llcc_priv->filtered_ports) {
+		pr_err("perfmon in use, remove events and filters first\n");
+		ret = -EBUSY;
+		goto out_unlock;
+	}
+
+	ret = llcc_policy_get_slices(llcc_priv);
+	if (ret)
+		goto out_unlock;
+
+	ret = clk_prepare_enable(llcc_priv->clock);
+	if (ret)
+		goto out_unlock;
+
+	now = ktime_get();
+	for (i = 0; i < llcc_priv->policy_num_slices; i++) {
+		slice = &llcc_priv->policy_slices[i];
+		slice->parked = false;
+		slice->idle = slice->hold = 0;
+		slice->stamp = now;
+	}
+
+	llcc_priv->policy_next = 0;
+	llcc_priv->filtered_ports |= 1 << EVENT_PORT_TRP;
+	trp_event_filter_config(llcc_priv, SCID,
+			llcc_get_slice_id(llcc_priv->policy_slices[0].desc),
+			true);
+	trp_event_config(llcc_priv, TRP_ANY_ACCESS, LLCC_POLICY_CNT_ACCESS,
+			true);
+	trp_event_config(llcc_priv, TRP_ANY_HIT, LLCC_POLICY_CNT_HIT, true);
+	trp_event_config(llcc_priv, TRP_RD_DEACTIVE_SUBCACHE,
+			LLCC_POLICY_CNT_DEACTIVE, true);
+
+	mask = PERFMON_MODE_MONITOR_MODE_MASK | PERFMON_MODE_MONITOR_EN_MASK;
+	llcc_bcast_modify(llcc_priv, PERFMON_MODE, MANUAL_MODE | MONITOR_EN,
+			mask);
+
+	llcc_priv->policy_enabled = true;
+	queue_delayed_work(system_freezable_wq, &llcc_priv->policy_work,
+			msecs_to_jiffies(max(policy_period_ms, 1U)));
+out_unlock:
+	mutex_unlock(&llcc_priv->mutex);
+	mutex_unlock(&llcc_priv->policy_lock);
+	return ret;
+}
+
+/* Hand every slice back to its client the way the SoC table has it */
+static void llcc_policy_stop(struct llcc_perfmon_private *llcc_priv)
+{
+	struct llcc_policy_slice *slice;
+	uint32_t mask;
+	ktime_t now;
+	unsigned int i;
+
+	mutex_lock(&llcc_priv->policy_lock);
+	mutex_lock(&llcc_priv->mutex);
+	if (!llcc_priv->policy_enabled) {
+		mutex_unlock(&llcc_priv->mutex);
+		goto out_unlock;
+	}
+	llcc_priv->policy_enabled = false;
+	mutex_unlock(&llcc_priv->mutex);
+
+	cancel_delayed_work_sync(&llcc_priv->policy_work);
+
+	mutex_lock(&llcc_priv->mutex);
+	now = ktime_get();
+	for (i = 0; i < llcc_priv->policy_num_slices; i++) {
+		slice = &llcc_priv->policy_slices[i];
+		llcc_policy_account(slice, now);
+		if (slice->parked)
+			llcc_slice_park(slice->desc, false);
+		slice->parked = false;
+		if (llcc_get_slice_size(slice->desc) != slice->table_size)
+			llcc_slice_resize(slice->desc, slice->table_size);
+	}
+
+	trp_event_config(llcc_priv, TRP_ANY_ACCESS, LLCC_POLICY_CNT_ACCESS,
+			false);
+	trp_event_config(llcc_priv, TRP_ANY_HIT, LLCC_POLICY_CNT_HIT, false);
+	trp_event_config(llcc_priv, TRP_RD_DEACTIVE_SUBCACHE,
+			LLCC_POLICY_CNT_DEACTIVE, false);
+	trp_event_filter_config(llcc_priv, SCID, 0, false);
+	llcc_priv->filtered_ports &= ~(1 << EVENT_PORT_TRP);
+
+	mask = PERFMON_MODE_MONITOR_MODE_MASK | PERFMON_MODE_MONITOR_EN_MASK;
+	llcc_bcast_modify(llcc_priv, PERFMON_MODE, 0, mask);
+	clk_disable_unprepare(llcc_priv->clock);
+	mutex_unlock(&llcc_priv->mutex);
+out_unlock:
+	mutex_unlock(&llcc_priv->policy_lock);
+}
+
+static ssize_t policy_enable_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct llcc_perfmon_private *llcc_priv = dev_get_drvdata(dev);
+
+	return snprintf(buf, PAGE_SIZE, "%d\n", llcc_priv->policy_enabled);
+}
+
+static ssize_t policy_enable_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct llcc_perfmon_private *llcc_priv = dev_get_drvdata(dev);
+	bool enable;
+	int ret = 0;
+
+	if (kstrtobool(buf, &enable))
+		return -EINVAL;
+
+	if (enable)
+		ret = llcc_policy_start(llcc_priv);
+	else
+		llcc_policy_stop(llcc_priv);
+
+	return ret ? ret : count;
+}
+
+static ssize_t policy_stats_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct llcc_perfmon_private *llcc_priv = dev_get_drvdata(dev);
+	struct llcc_policy_slice *slice;
+	const char *state;
+	ssize_t cnt;
+	unsigned int i;
+
+	mutex_lock(&llcc_priv->mutex);
+	cnt = scnprintf(buf, PAGE_SIZE,
+			"%-10s %4s %6s %8s %8s %4s %12s %12s %6s %6s %6s %6s %10s %10s %10s\n",
+			"slice", "scid", "state", "size_kb", "table_kb", "hit%",
+			"accesses", "hits", "parks", "wakes", "grows",
+			"shrnks", "active_ms", "parked_ms", "off_ms");
+
+	for (i = 0; i < llcc_priv->policy_num_slices; i++) {
+		slice = &llcc_priv->policy_slices[i];
+		if (llcc_priv->policy_enabled)
+			llcc_policy_account(slice, ktime_get());
+
+		if (!llcc_slice_is_active(slice->desc))
+			state = "off";
+		else if (slice->parked)
+			state = "parked";
+		else
+			state = "active";
+
+		cnt += scnprintf(buf + cnt, PAGE_SIZE - cnt,
+				"%-10s %4d %6s %8zu %8zu %4u %12llu %12llu %6lu %6lu %6lu %6lu %10llu %10llu %10llu\n",
+				slice->name, llcc_get_slice_id(slice->desc),
+				state, llcc_get_slice_size(slice->desc),
+				slice->table_size, slice->hit_pct,
+				slice->accesses, slice->hits, slice->parks,
+				slice->unparks, slice->grows, slice->shrinks,
+				div_u64(slice->active_ns, NSEC_PER_MSEC),
+				div_u64(slice->parked_ns, NSEC_PER_MSEC),
+				div_u64(slice->off_ns, NSEC_PER_MSEC));
+	}
+	mutex_unlock(&llcc_priv->mutex);
+
+	return cnt;
+}
+
+static DEVICE_ATTR_RW(policy_enable);
+static DEVICE_ATTR_RO(policy_stats);
+
+static struct attribute *llcc_policy_attrs[] = {
+	&dev_attr_policy_enable.attr,
+	&dev_attr_policy_stats.attr,
+	NULL,
+};
+
+static struct attribute_group llcc_policy_group = {
+	.attrs	= llcc_policy_attrs,
+};
+
 static void llcc_register_event_port(struct llcc_perfmon_private *llcc_priv,
 		struct event_port_ops *ops, unsigned int event_port_num)
 {
@@ -1294,11 +1800,21 @@ static int llcc_perfmon_probe(struct platform_device *pdev)
 		return result;
 	}
 
+	result = sysfs_create_group(&pdev->dev.kobj, &llcc_policy_group);
+	if (result) {
+		pr_err("Unable to create policy sysfs group\n");
+		sysfs_remove_group(&pdev->dev.kobj, &llcc_perfmon_group);
+		return result;
+	}
+
 	if (llcc_priv->num_mc > 1)
 		pr_info("%d memory controllers connected with LLCC\n",
 				llcc_priv->num_mc);
 
 	mutex_init(&llcc_priv->mutex);
+	mutex_init(&llcc_priv->policy_lock);
+	INIT_DELAYED_WORK(&llcc_priv->policy_work, llcc_policy_work);
+	llcc_priv->dev = &pdev->dev;
 	platform_set_drvdata(pdev, llcc_priv);
 	llcc_register_event_port(llcc_priv, &feac_port_ops, EVENT_PORT_FEAC);
 	llcc_register_event_port(llcc_priv, &ferc_port_ops, EVENT_PORT_FERC);
@@ -1321,6 +1837,10 @@ static int llcc_perfmon_remove(struct platform_device *pdev)
 	while (hrtimer_active(&llcc_priv->hrtimer))
 		hrtimer_cancel(&llcc_priv->hrtimer);
 
+	sysfs_remove_group(&pdev->dev.kobj, &llcc_policy_group);
+	llcc_policy_stop(llcc_priv);
+	llcc_policy_put_slices(llcc_priv);
+	mutex_destroy(&llcc_priv->policy_lock);
 	mutex_destroy(&llcc_priv->mutex);
 	sysfs_remove_group(&pdev->dev.kobj, &llcc_perfmon_group);
 	platform_set_drvdata(pdev, NULL);
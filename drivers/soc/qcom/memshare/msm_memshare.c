@@ -18,6 +18,8 @@
 #include <linux/of_device.h>
 #include <linux/platform_device.h>
 #include <linux/notifier.h>
+#include <linux/ktime.h>
+#include <linux/shrinker.h>
 #include <linux/soc/qcom/qmi.h>
 #include <soc/qcom/subsystem_restart.h>
 #include <soc/qcom/subsystem_notif.h>
@@ -40,12 +42,22 @@ static bool ramdump_event;
 static void *memshare_ramdump_dev[MAX_CLIENTS];
 static struct device *memshare_dev[MAX_CLIENTS];
 
+/*
+ * Allocate the regions of non guaranteed modem clients while the modem
+ * boots, before it asks for them, and keep the regions it frees for its
+ * next request. Both are given back to the system under memory pressure.
+ */
+static bool prealloc;
+module_param(prealloc, bool, 0644);
+
 /* Memshare Driver Structure */
 struct memshare_driver {
 	struct device *dev;
 	struct mutex mem_share;
 	struct mutex mem_free;
 	struct work_struct memshare_init_work;
+	struct work_struct prealloc_work;
+	struct shrinker shrinker;
 };
 
 struct memshare_child {
@@ -298,6 +310,141 @@ static int mem_share_do_ramdump(void)
 	return 0;
 }
 
+static uint32_t memshare_block_size(struct mem_blocks *blk, uint32_t bytes)
+{
+	if (blk->guard_band && bytes > 0)
+		return bytes + MEMSHARE_GUARD_BYTES;
+	return bytes;
+}
+
+static void memshare_free_spare(int id)
+{
+	struct mem_blocks *blk = &memblock[id];
+
+	if (!blk->spare_virtual_addr)
+		return;
+
+	dma_free_attrs(memsh_drv->dev, blk->spare_size,
+		blk->spare_virtual_addr, blk->spare_phy_addr, attrs);
+	blk->spare_virtual_addr = NULL;
+	blk->spare_phy_addr = 0;
+	blk->spare_size = 0;
+}
+
+/* Hands out the spare region of the client if it fits the request */
+static int memshare_get_block(int id, uint32_t size)
+{
+	struct mem_blocks *blk = &memblock[id];
+
+	if (blk->spare_virtual_addr) {
+		if (blk->spare_size == size) {
+			blk->virtual_addr = blk->spare_virtual_addr;
+			blk->phy_addr = blk->spare_phy_addr;
+			blk->spare_virtual_addr = NULL;
+			blk->spare_phy_addr = 0;
+			blk->spare_size = 0;
+			return 0;
+		}
+		memshare_free_spare(id);
+	}
+
+	return memshare_alloc(memsh_drv->dev, size, blk);
+}
+
+/*
+ * Frees the region of a client the modem let go, or keeps it as the spare
+ * for the next request. @reuse is false if the region may still be
+ * assigned to the modem.
+ */
+static void memshare_put_block(int id, uint32_t size, bool reuse)
+{
+	struct mem_blocks *blk = &memblock[id];
+
+	if (prealloc && reuse && !blk->spare_virtual_addr) {
+		blk->spare_virtual_addr = blk->virtual_addr;
+		blk->spare_phy_addr = blk->phy_addr;
+		blk->spare_size = size;
+		return;
+	}
+
+	dma_free_attrs(memsh_drv->dev, size, blk->virtual_addr,
+		blk->phy_addr, attrs);
+}
+
+static void memshare_prealloc_worker(struct work_struct *work)
+{
+	struct mem_blocks tmp;
+	struct mem_blocks *blk;
+	uint32_t size;
+	ktime_t start;
+	int i;
+
+	mutex_lock(&memsh_drv->mem_share);
+	for (i = 0; i < num_clients; i++) {
+		blk = &memblock[i];
+		if (blk->guarantee || blk->allotted ||
+				blk->spare_virtual_addr ||
+				blk->peripheral != DHMS_MEM_PROC_MPSS_V01)
+			continue;
+
+		size = memshare_block_size(blk,
+				blk->last_request ?: blk->init_size);
+		if (!size)
+			continue;
+
+		start = ktime_get();
+		memset(&tmp, 0, sizeof(tmp));
+		if (memshare_alloc(memsh_drv->dev, size, &tmp)) {
+			dev_warn(memsh_child->dev,
+				"memshare: unable to prepare %u bytes for client id: %d\n",
+				size, blk->client_id);
+			continue;
+		}
+		blk->spare_virtual_addr = tmp.virtual_addr;
+		blk->spare_phy_addr = tmp.phy_addr;
+		blk->spare_size = size;
+		dev_info(memsh_child->dev,
+			"memshare: prepared %u bytes for client id: %d in %lld us\n",
+			size, blk->client_id,
+			ktime_us_delta(ktime_get(), start));
+	}
+	mutex_unlock(&memsh_drv->mem_share);
+}
+
+static unsigned long memshare_shrink_count(struct shrinker *shrinker,
+					   struct shrink_control *sc)
+{
+	unsigned long pages = 0;
+	int i;
+
+	for (i = 0; i < num_clients; i++)
+		if (READ_ONCE(memblock[i].spare_virtual_addr))
+			pages += memblock[i].spare_size >> PAGE_SHIFT;
+
+	return pages;
+}
+
+static unsigned long memshare_shrink_scan(struct shrinker *shrinker,
+					  struct shrink_control *sc)
+{
+	unsigned long freed = 0;
+	int i;
+
+	/* the allocations of memshare itself may be what reclaims */
+	if (!mutex_trylock(&memsh_drv->mem_share))
+		return SHRINK_STOP;
+
+	for (i = 0; i < num_clients && freed < sc->nr_to_scan; i++) {
+		if (!memblock[i].spare_virtual_addr)
+			continue;
+		freed += memblock[i].spare_size >> PAGE_SHIFT;
+		memshare_free_spare(i);
+	}
+	mutex_unlock(&memsh_drv->mem_share);
+
+	return freed;
+}
+
 static int modem_notifier_cb(struct notifier_block *this, unsigned long code,
 					void *_cmd)
 {
@@ -306,6 +453,7 @@ static int modem_notifier_cb(struct notifier_block *this, unsigned long code,
 	int dest_vmids[1] = {VMID_HLOS};
 	int dest_perms[1] = {PERM_READ|PERM_WRITE|PERM_EXEC};
 	struct notif_data *notifdata = NULL;
+	bool reuse;
 
 	mutex_lock(&memsh_drv->mem_share);
 
@@ -322,6 +470,10 @@ static int modem_notifier_cb(struct notifier_block *this, unsigned long code,
 		break;
 
 	case SUBSYS_BEFORE_POWERUP:
+		if (prealloc)
+			queue_work(system_unbound_wq,
+				   &memsh_drv->prealloc_work);
+
 		if (_cmd) {
 			notifdata = (struct notif_data *) _cmd;
 		} else {
@@ -382,6 +534,7 @@ static int modem_notifier_cb(struct notifier_block *this, unsigned long code,
 						memblock[i].hyp_mapping = 0;
 					}
 				}
+				reuse = !memblock[i].hyp_mapping;
 				if (memblock[i].guard_band) {
 				/*
 				 *	Check if the client required guard band
@@ -390,10 +543,7 @@ static int modem_notifier_cb(struct notifier_block *this, unsigned long code,
 				 */
 					size += MEMSHARE_GUARD_BYTES;
 				}
-				dma_free_attrs(memsh_drv->dev,
-					size, memblock[i].virtual_addr,
-					memblock[i].phy_addr,
-					attrs);
+				memshare_put_block(i, size, reuse);
 				free_client(i);
 			}
 		}
@@ -446,6 +596,8 @@ static void handle_alloc_generic_req(struct qmi_handle *handle,
 	int rc, resp = 0;
 	int client_id;
 	uint32_t size = 0;
+	bool spare;
+	ktime_t start;
 
 	mutex_lock(&memsh_drv->mem_share);
 	alloc_req = (struct mem_alloc_generic_req_msg_v01 *)decoded_msg;
@@ -474,12 +626,18 @@ static void handle_alloc_generic_req(struct qmi_handle *handle,
 	}
 
 	if (!memblock[client_id].allotted) {
-		if (memblock[client_id].guard_band && alloc_req->num_bytes > 0)
-			size = alloc_req->num_bytes + MEMSHARE_GUARD_BYTES;
-		else
-			size = alloc_req->num_bytes;
-		rc = memshare_alloc(memsh_drv->dev, size,
-					&memblock[client_id]);
+		size = memshare_block_size(&memblock[client_id],
+					   alloc_req->num_bytes);
+		memblock[client_id].last_request = alloc_req->num_bytes;
+		spare = memblock[client_id].spare_virtual_addr &&
+			memblock[client_id].spare_size == size;
+		start = ktime_get();
+		rc = memshare_get_block(client_id, size);
+		dev_info(memsh_child->dev,
+			"memshare_alloc: client id: %d, %u bytes %s in %lld us\n",
+			alloc_req->client_id, size,
+			spare ? "reused" : "allocated",
+			ktime_us_delta(ktime_get(), start));
 		if (rc) {
 			dev_err(memsh_child->dev,
 				"memshare_alloc: unable to allocate memory of size: %d for requested client\n",
@@ -536,6 +694,7 @@ static void handle_free_generic_req(struct qmi_handle *handle,
 	struct mem_free_generic_resp_msg_v01 free_resp;
 	int rc, flag = 0, ret = 0, size = 0;
 	uint32_t client_id;
+	ktime_t start;
 	u32 source_vmlist[1] = {VMID_MSS_MSA};
 	int dest_vmids[1] = {VMID_HLOS};
 	int dest_perms[1] = {PERM_READ|PERM_WRITE|PERM_EXEC};
@@ -558,6 +717,7 @@ static void handle_free_generic_req(struct qmi_handle *handle,
 		dev_dbg(memsh_child->dev,
 			"memshare_free: hypervisor unmapping for client_id:%d - size: %d\n",
 			client_id, memblock[client_id].size);
+		start = ktime_get();
 		ret = hyp_assign_phys(memblock[client_id].phy_addr,
 				memblock[client_id].size, source_vmlist, 1,
 				dest_vmids, dest_perms, 1);
@@ -579,11 +739,15 @@ static void handle_free_generic_req(struct qmi_handle *handle,
 		 */
 			size += MEMSHARE_GUARD_BYTES;
 		}
-		dma_free_attrs(memsh_drv->dev, size,
-			memblock[client_id].virtual_addr,
-			memblock[client_id].phy_addr,
-			attrs);
+		/* the spare belongs to the allocation side */
+		mutex_lock(&memsh_drv->mem_share);
+		memshare_put_block(client_id, size, !ret);
+		mutex_unlock(&memsh_drv->mem_share);
 		free_client(client_id);
+		dev_info(memsh_child->dev,
+			"memshare_free: client id: %d, %d bytes released in %lld us\n",
+			free_req->client_id, size,
+			ktime_us_delta(ktime_get(), start));
 	} else {
 		dev_err(memsh_child->dev,
 			"memshare_free: cannot free the memory for a guaranteed client (client_id: %d)\n",
@@ -885,6 +1049,7 @@ static int memshare_probe(struct platform_device *pdev)
 	mutex_init(&drv->mem_share);
 
 	INIT_WORK(&drv->memshare_init_work, memshare_init_worker);
+	INIT_WORK(&drv->prealloc_work, memshare_prealloc_worker);
 	schedule_work(&drv->memshare_init_work);
 
 	drv->dev = &pdev->dev;
@@ -902,6 +1067,15 @@ static int memshare_probe(struct platform_device *pdev)
 		return rc;
 	}
 
+	drv->shrinker.count_objects = memshare_shrink_count;
+	drv->shrinker.scan_objects = memshare_shrink_scan;
+	drv->shrinker.seeks = DEFAULT_SEEKS;
+	rc = register_shrinker(&drv->shrinker);
+	if (rc)
+		dev_warn(&pdev->dev,
+			"memshare: spare regions won't be reclaimed, rc: %d\n",
+			rc);
+
 	subsys_notif_register_notifier("modem", &nb);
 	dev_dbg(memsh_child->dev, "memshare: Memshare inited\n");
 
@@ -913,6 +1087,8 @@ static int memshare_remove(struct platform_device *pdev)
 	if (!memsh_drv)
 		return 0;
 
+	unregister_shrinker(&memsh_drv->shrinker);
+	cancel_work_sync(&memsh_drv->prealloc_work);
 	flush_workqueue(mem_share_svc_workqueue);
 	qmi_handle_release(mem_share_svc_handle);
 	kfree(mem_share_svc_handle);
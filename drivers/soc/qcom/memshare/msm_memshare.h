@@ -62,6 +62,12 @@ struct mem_blocks {
 	uint8_t hyp_mapping;
 	/* Status flag which checks if ramdump file is created*/
 	int file_created;
+	/* Size of the last request, the guess for the next one */
+	uint32_t last_request;
+	/* Region ready for the next request, not handed out yet */
+	void *spare_virtual_addr;
+	phys_addr_t spare_phy_addr;
+	uint32_t spare_size;
 
 };
 
@@ -26,6 +26,13 @@
 #include <linux/input.h>
 #include <linux/kthread.h>
 #include <linux/sched/core_ctl.h>
+#include <linux/miscdevice.h>
+#include <linux/fs.h>
+#include <linux/idr.h>
+#include <linux/uaccess.h>
+#include <linux/workqueue.h>
+#include <linux/topology.h>
+#include <uapi/linux/msm_performance.h>
 
 /*
  * Sched will provide the data for every 20ms window,
@@ -38,6 +45,9 @@
 struct cpu_status {
 	unsigned int min;
 	unsigned int max;
+	/* Combined limits of the held perf locks */
+	unsigned int lock_min;
+	unsigned int lock_max;
 };
 static DEFINE_PER_CPU(struct cpu_status, cpu_stats);
 
@@ -252,13 +262,257 @@ static struct kobject *notify_kobj;
 
 /*******************************sysfs ends************************************/
 
+/****************************perf lock start**********************************/
+/*
+ * A perf lock applies a whole set of resources with one ioctl instead of
+ * a sysfs write per knob. Held locks are combined and each cpufreq policy
+ * whose limits change is updated once per acquire or release.
+ */
+struct perf_lock {
+	struct msm_perf_lock req;
+	int id;
+	struct file *owner;
+	struct list_head node;
+	struct delayed_work expire_work;
+};
+
+/* Highest sched_boost type, RESTRAINED_BOOST */
+#define PERF_LOCK_MAX_BOOST	3
+
+static DEFINE_MUTEX(perf_lock_mutex);
+static DEFINE_IDR(perf_lock_idr);
+static LIST_HEAD(perf_locks);
+
+static int perf_lock_cluster(int cpu)
+{
+	return clamp_t(int, topology_physical_package_id(cpu), 0,
+		       MSM_PERF_MAX_CLUSTERS - 1);
+}
+
+/* Called with perf_lock_mutex held */
+static void perf_locks_apply(void)
+{
+	unsigned int freq_min[MSM_PERF_MAX_CLUSTERS] = { 0 };
+	unsigned int freq_max[MSM_PERF_MAX_CLUSTERS];
+	unsigned int min_cpus[MAX_CLUSTERS] = { 0 };
+	struct cpu_status *cpu_st;
+	struct perf_lock *lock;
+	cpumask_t update_mask;
+	int i, cpu;
+
+	BUILD_BUG_ON(MSM_PERF_MAX_CLUSTERS > MAX_CLUSTERS);
+
+	for (i = 0; i < MSM_PERF_MAX_CLUSTERS; i++)
+		freq_max[i] = UINT_MAX;
+
+	list_for_each_entry(lock, &perf_locks, node) {
+		for (i = 0; i < MSM_PERF_MAX_CLUSTERS; i++) {
+			freq_min[i] = max(freq_min[i], lock->req.freq_min[i]);
+			if (lock->req.freq_max[i])
+				freq_max[i] = min(freq_max[i],
+						  lock->req.freq_max[i]);
+			min_cpus[i] = max(min_cpus[i], lock->req.min_cpus[i]);
+		}
+	}
+
+	cpumask_clear(&update_mask);
+	for_each_present_cpu(cpu) {
+		cpu_st = &per_cpu(cpu_stats, cpu);
+		i = perf_lock_cluster(cpu);
+		if (cpu_st->lock_min == freq_min[i] &&
+		    cpu_st->lock_max == freq_max[i])
+			continue;
+
+		cpu_st->lock_min = freq_min[i];
+		cpu_st->lock_max = freq_max[i];
+		cpumask_set_cpu(cpu, &update_mask);
+	}
+
+	get_online_cpus();
+	for_each_cpu(cpu, &update_mask) {
+		struct cpufreq_policy policy;
+
+		if (!cpu_online(cpu) || cpufreq_get_policy(&policy, cpu))
+			continue;
+
+		cpufreq_update_policy(cpu);
+		cpumask_andnot(&update_mask, &update_mask,
+			       policy.related_cpus);
+	}
+	put_online_cpus();
+
+	core_ctl_set_min_cpus_floor(CORE_CTL_MIN_CPUS_PERFLOCK, min_cpus);
+}
+
+/* Called with perf_lock_mutex held, the caller frees the lock */
+static void perf_lock_remove(struct perf_lock *lock)
+{
+	idr_remove(&perf_lock_idr, lock->id);
+	list_del(&lock->node);
+	if (lock->req.sched_boost)
+		sched_set_boost(-(int)lock->req.sched_boost);
+	perf_locks_apply();
+}
+
+static void perf_lock_expire(struct work_struct *work)
+{
+	struct perf_lock *lock = container_of(to_delayed_work(work),
+					      struct perf_lock, expire_work);
+	bool removed = false;
+
+	mutex_lock(&perf_lock_mutex);
+	/* A racing release or close may have removed it already */
+	if (idr_find(&perf_lock_idr, lock->id) == lock) {
+		perf_lock_remove(lock);
+		removed = true;
+	}
+	mutex_unlock(&perf_lock_mutex);
+
+	if (removed)
+		kfree(lock);
+}
+
+static int perf_lock_acquire(struct file *file, void __user *arg)
+{
+	struct perf_lock *lock;
+	int ret;
+
+	lock = kzalloc(sizeof(*lock), GFP_KERNEL);
+	if (!lock)
+		return -ENOMEM;
+
+	if (copy_from_user(&lock->req, arg, sizeof(lock->req))) {
+		ret = -EFAULT;
+		goto err_free;
+	}
+
+	if (lock->req.sched_boost > PERF_LOCK_MAX_BOOST) {
+		ret = -EINVAL;
+		goto err_free;
+	}
+
+	lock->owner = file;
+	INIT_DELAYED_WORK(&lock->expire_work, perf_lock_expire);
+
+	mutex_lock(&perf_lock_mutex);
+	if (lock->req.sched_boost) {
+		ret = sched_set_boost(lock->req.sched_boost);
+		if (ret)
+			goto err_unlock;
+	}
+
+	ret = idr_alloc(&perf_lock_idr, lock, 1, 0, GFP_KERNEL);
+	if (ret < 0)
+		goto err_unboost;
+	lock->id = lock->req.handle = ret;
+
+	list_add(&lock->node, &perf_locks);
+	perf_locks_apply();
+
+	if (lock->req.timeout_ms)
+		schedule_delayed_work(&lock->expire_work,
+				      msecs_to_jiffies(lock->req.timeout_ms));
+	mutex_unlock(&perf_lock_mutex);
+
+	/* The lock is held either way, the handle is just not known */
+	if (copy_to_user(arg, &lock->req, sizeof(lock->req)))
+		return -EFAULT;
+
+	return 0;
+
+err_unboost:
+	if (lock->req.sched_boost)
+		sched_set_boost(-(int)lock->req.sched_boost);
+err_unlock:
+	mutex_unlock(&perf_lock_mutex);
+err_free:
+	kfree(lock);
+	return ret;
+}
+
+static int perf_lock_release(struct file *file, int id)
+{
+	struct perf_lock *lock;
+
+	mutex_lock(&perf_lock_mutex);
+	lock = idr_find(&perf_lock_idr, id);
+	if (!lock || lock->owner != file) {
+		mutex_unlock(&perf_lock_mutex);
+		return -EINVAL;
+	}
+	perf_lock_remove(lock);
+	mutex_unlock(&perf_lock_mutex);
+
+	cancel_delayed_work_sync(&lock->expire_work);
+	kfree(lock);
+	return 0;
+}
+
+static long perf_lock_ioctl(struct file *file, unsigned int cmd,
+			    unsigned long arg)
+{
+	int id;
+
+	switch (cmd) {
+	case MSM_PERF_IOC_ACQUIRE:
+		return perf_lock_acquire(file, (void __user *)arg);
+	case MSM_PERF_IOC_RELEASE:
+		if (get_user(id, (int __user *)arg))
+			return -EFAULT;
+		return perf_lock_release(file, id);
+	default:
+		return -ENOTTY;
+	}
+}
+
+static int perf_lock_file_release(struct inode *inode, struct file *file)
+{
+	struct perf_lock *lock, *tmp;
+	LIST_HEAD(closed);
+
+	mutex_lock(&perf_lock_mutex);
+	list_for_each_entry_safe(lock, tmp, &perf_locks, node) {
+		if (lock->owner != file)
+			continue;
+		idr_remove(&perf_lock_idr, lock->id);
+		list_move(&lock->node, &closed);
+		if (lock->req.sched_boost)
+			sched_set_boost(-(int)lock->req.sched_boost);
+	}
+	if (!list_empty(&closed))
+		perf_locks_apply();
+	mutex_unlock(&perf_lock_mutex);
+
+	list_for_each_entry_safe(lock, tmp, &closed, node) {
+		cancel_delayed_work_sync(&lock->expire_work);
+		kfree(lock);
+	}
+
+	return 0;
+}
+
+static const struct file_operations perf_lock_fops = {
+	.owner		= THIS_MODULE,
+	.unlocked_ioctl	= perf_lock_ioctl,
+	.compat_ioctl	= perf_lock_ioctl,
+	.release	= perf_lock_file_release,
+};
+
+static struct miscdevice perf_lock_misc = {
+	.minor	= MISC_DYNAMIC_MINOR,
+	.name	= "msm_perf",
+	.fops	= &perf_lock_fops,
+};
+/*****************************perf lock ends**********************************/
+
 static int perf_adjust_notify(struct notifier_block *nb, unsigned long val,
 							void *data)
 {
 	struct cpufreq_policy *policy = data;
 	unsigned int cpu = policy->cpu;
 	struct cpu_status *cpu_st = &per_cpu(cpu_stats, cpu);
-	unsigned int min = cpu_st->min, max = cpu_st->max;
+	unsigned int min = max(cpu_st->min, cpu_st->lock_min);
+	unsigned int max = min(cpu_st->max, cpu_st->lock_max);
 
 
 	if (val != CPUFREQ_ADJUST)
@@ -455,8 +709,10 @@ static int __init msm_performance_init(void)
 
 	cpufreq_register_notifier(&perf_cpufreq_nb, CPUFREQ_POLICY_NOTIFIER);
 
-	for_each_present_cpu(cpu)
+	for_each_present_cpu(cpu) {
 		per_cpu(cpu_stats, cpu).max = UINT_MAX;
+		per_cpu(cpu_stats, cpu).lock_max = UINT_MAX;
+	}
 
 	rc = cpuhp_setup_state_nocalls(CPUHP_AP_ONLINE,
 		"msm_performance_cpu_hotplug",
@@ -466,6 +722,11 @@ static int __init msm_performance_init(void)
 	init_events_group();
 	init_notify_group();
 
+	rc = misc_register(&perf_lock_misc);
+	if (rc)
+		pr_err("msm_perf: failed to register perf lock device: %d\n",
+		       rc);
+
 	return 0;
 }
 late_initcall(msm_performance_init);
@@ -107,6 +107,22 @@ static void __iomem *map_prop(const char *propname)
 static int proxy_timeout_ms = -1;
 module_param(proxy_timeout_ms, int, 0644);
 
+/**
+ * overlap_sequential - Read the blobs of images that need them verified in
+ * order on the parallel workers as well, and verify each one as soon as it
+ * and all blobs before it are in memory
+ */
+static bool overlap_sequential;
+module_param(overlap_sequential, bool, 0644);
+
+/**
+ * cache_fw - Comma separated firmware names, e.g. "adsp,cdsp", whose blobs
+ * stay in memory after the first boot so that a restart does not read them
+ * from the filesystem again. Only worth it for images small enough to keep.
+ */
+static char *cache_fw;
+module_param(cache_fw, charp, 0444);
+
 static bool disable_timeouts;
 
 static struct workqueue_struct *pil_wq;
@@ -179,6 +195,18 @@ struct pil_priv {
 	int id;
 	int unvoted_flag;
 	size_t region_size;
+	struct list_head fw_cache;
+	struct mutex fw_cache_lock;
+	char fw_cache_name[30];
+};
+
+/* Key of the metadata in the firmware cache, blobs use their number */
+#define PIL_FW_CACHE_MDT	-1
+
+struct pil_fw_blob {
+	struct list_head list;
+	int num;
+	const struct firmware *fw;
 };
 
 #ifdef CONFIG_QCOM_MINIDUMP
@@ -373,6 +401,8 @@ static int pil_do_minidump(struct pil_desc *desc, void *ramdump_dev)
 	int ret;
 	struct aux_minidump_info *aux_minidump_data = NULL;
 	unsigned int next_offset;
+	struct md_ss_toc *toc;
+	size_t toc_size;
 
 	if (!ramdump_dev)
 		return -ENODEV;
@@ -400,7 +430,8 @@ static int pil_do_minidump(struct pil_desc *desc, void *ramdump_dev)
 	}
 
 	total_segs = ss_mdump_seg_cnt_ss + total_aux_segs;
-	ramdump_segs = kcalloc(total_segs,
+	/* and one for the table of contents */
+	ramdump_segs = kcalloc(total_segs + 1,
 			       sizeof(*ramdump_segs), GFP_KERNEL);
 	if (!ramdump_segs) {
 		ret = -ENOMEM;
@@ -422,14 +453,32 @@ static int pil_do_minidump(struct pil_desc *desc, void *ramdump_dev)
 					      &ss_valid_seg_cnt,
 					      desc->num_aux_minidump_ids);
 
+	/*
+	 * The table of contents and region descriptors go along as a section
+	 * of their own, for the tools to tell what the regions hold.
+	 */
+	toc_size = sizeof(*toc) +
+		   ss_mdump_seg_cnt_ss * sizeof(struct md_ss_region);
+	toc = desc->minidump_as_elf32 ? NULL : kmalloc(toc_size, GFP_KERNEL);
+	if (toc) {
+		memcpy(toc, desc->minidump_ss, sizeof(*toc));
+		memcpy_fromio(toc + 1, region_info_ss,
+			      toc_size - sizeof(*toc));
+		ramdump_segs[ss_valid_seg_cnt].name = "md_ss_toc";
+		ramdump_segs[ss_valid_seg_cnt].v_address = toc;
+		ramdump_segs[ss_valid_seg_cnt].size = toc_size;
+	}
+
 	if (desc->minidump_as_elf32)
 		ret = do_elf_ramdump(ramdump_dev, ramdump_segs,
 				     ss_valid_seg_cnt);
 	else
-		ret = do_minidump(ramdump_dev, ramdump_segs, ss_valid_seg_cnt);
+		ret = do_minidump(ramdump_dev, ramdump_segs,
+				  ss_valid_seg_cnt + !!toc);
 	if (ret)
 		pil_err(desc, "%s: Minidump collection failed for subsys %s rc:%d\n",
 			__func__, desc->name, ret);
+	kfree(toc);
 
 	if (desc->subsys_vmid > 0)
 		ret = pil_assign_mem_to_subsys(desc, priv->region_start,
@@ -934,6 +983,19 @@ static int pil_cmp_seg(void *priv, struct list_head *a, struct list_head *b)
 	return ret;
 }
 
+/* Boot KPI marker for each stage, the modem ones keep their old names */
+static void pil_place_marker(struct pil_desc *desc, const char *stage)
+{
+	char buf[MAX_LEN];
+
+	if (!boot_marker_enabled())
+		return;
+
+	snprintf(buf, sizeof(buf), "M - %s %s",
+		 strcmp(desc->name, "modem") ? desc->name : "Modem", stage);
+	place_marker(buf);
+}
+
 static int pil_init_mmap(struct pil_desc *desc, const struct pil_mdt *mdt)
 {
 	struct pil_priv *priv = desc->priv;
@@ -945,8 +1007,7 @@ static int pil_init_mmap(struct pil_desc *desc, const struct pil_mdt *mdt)
 	if (ret)
 		return ret;
 
-	if (!strcmp(desc->name, "modem"))
-		place_marker("M - Modem Image Start Loading");
+	pil_place_marker(desc, "Image Start Loading");
 
 	pil_info(desc, "loading from %pa to %pa\n", &priv->region_start,
 							&priv->region_end);
@@ -1040,13 +1101,100 @@ static void unmap_fw_mem(void *vaddr, size_t size, void *data)
 	dma_unremap(info->dev, vaddr, size);
 }
 
-static int pil_load_seg(struct pil_desc *desc, struct pil_seg *seg)
+static bool pil_fw_cache_enabled(struct pil_desc *desc)
+{
+	size_t len = strlen(desc->fw_name);
+	const char *p = cache_fw;
+
+	while (p && *p) {
+		if (!strncmp(p, desc->fw_name, len) &&
+		    (p[len] == ',' || !p[len]))
+			return true;
+		p = strchr(p, ',');
+		if (p)
+			p++;
+	}
+	return false;
+}
+
+static const struct firmware *pil_fw_cache_get(struct pil_desc *desc, int num)
+{
+	struct pil_priv *priv = desc->priv;
+	const struct firmware *fw = NULL;
+	struct pil_fw_blob *blob;
+
+	mutex_lock(&priv->fw_cache_lock);
+	list_for_each_entry(blob, &priv->fw_cache, list) {
+		if (blob->num == num) {
+			fw = blob->fw;
+			break;
+		}
+	}
+	mutex_unlock(&priv->fw_cache_lock);
+
+	return fw;
+}
+
+/* Returns true if the cache holds on to @fw, which is not to be released */
+static bool pil_fw_cache_keep(struct pil_desc *desc, int num,
+			      const struct firmware *fw)
+{
+	struct pil_priv *priv = desc->priv;
+	struct pil_fw_blob *blob;
+	bool kept = false;
+
+	if (!pil_fw_cache_enabled(desc))
+		return false;
+
+	mutex_lock(&priv->fw_cache_lock);
+	list_for_each_entry(blob, &priv->fw_cache, list) {
+		if (blob->num == num) {
+			kept = blob->fw == fw;
+			goto out;
+		}
+	}
+
+	blob = kzalloc(sizeof(*blob), GFP_KERNEL);
+	if (blob) {
+		blob->num = num;
+		blob->fw = fw;
+		list_add_tail(&blob->list, &priv->fw_cache);
+		kept = true;
+	}
+out:
+	mutex_unlock(&priv->fw_cache_lock);
+
+	return kept;
+}
+
+static void pil_fw_cache_flush(struct pil_priv *priv)
+{
+	struct pil_fw_blob *blob, *tmp;
+
+	mutex_lock(&priv->fw_cache_lock);
+	list_for_each_entry_safe(blob, tmp, &priv->fw_cache, list) {
+		list_del(&blob->list);
+		release_firmware(blob->fw);
+		kfree(blob);
+	}
+	mutex_unlock(&priv->fw_cache_lock);
+}
+
+static void pil_fw_release(struct pil_desc *desc, int num,
+			   const struct firmware *fw)
+{
+	if (!pil_fw_cache_keep(desc, num, fw))
+		release_firmware(fw);
+}
+
+static int pil_read_seg(struct pil_desc *desc, struct pil_seg *seg)
 {
 	int ret = 0, count;
 	phys_addr_t paddr;
 	char fw_name[30];
 	int num = seg->num;
 	const struct firmware *fw = NULL;
+	bool cached = pil_fw_cache_enabled(desc);
 	void __iomem *firmware_buf;
 	struct pil_map_fw_info map_fw_info = {
 		.attrs = desc->attrs,
@@ -1066,8 +1214,17 @@ static int pil_load_seg(struct pil_desc *desc, struct pil_seg *seg)
 			return -ENOMEM;
 		}
 
-		ret = request_firmware_into_buf(&fw, fw_name, desc->dev,
+		/* a cached blob is copied in, the others are read in place */
+		fw = cached ? pil_fw_cache_get(desc, num) : NULL;
+		if (fw)
+			ret = 0;
+		else if (cached)
+			ret = request_firmware(&fw, fw_name, desc->dev);
+		else
+			ret = request_firmware_into_buf(&fw, fw_name, desc->dev,
 						firmware_buf, seg->filesz);
+		if (!ret && cached && fw->size == seg->filesz)
+			memcpy_toio(firmware_buf, fw->data, fw->size);
 		desc->unmap_fw_mem(firmware_buf, seg->filesz, map_data);
 
 		if (ret) {
@@ -1079,11 +1236,11 @@ static int pil_load_seg(struct pil_desc *desc, struct pil_seg *seg)
 		if (fw->size != seg->filesz) {
 			pil_err(desc, "Blob size %u doesn't match %lu\n",
 					ret, seg->filesz);
-			release_firmware(fw);
+			pil_fw_release(desc, num, fw);
 			return -EPERM;
 		}
 
-		release_firmware(fw);
+		pil_fw_release(desc, num, fw);
 	}
 
 	/* Zero out trailing memory */
@@ -1107,16 +1264,34 @@ static int pil_load_seg(struct pil_desc *desc, struct pil_seg *seg)
 		paddr += size;
 	}
 
+	return ret;
+}
+
+static int pil_verify_seg(struct pil_desc *desc, struct pil_seg *seg)
+{
+	int ret = 0;
+
 	if (desc->ops->verify_blob) {
 		ret = desc->ops->verify_blob(desc, seg->paddr, seg->sz);
 		if (ret)
 			pil_err(desc, "Blob%u failed verification(rc:%d)\n",
-								num, ret);
+								seg->num, ret);
 	}
 
 	return ret;
 }
 
+static int pil_load_seg(struct pil_desc *desc, struct pil_seg *seg)
+{
+	int ret;
+
+	ret = pil_read_seg(desc, seg);
+	if (ret)
+		return ret;
+
+	return pil_verify_seg(desc, seg);
+}
+
 static int pil_parse_devicetree(struct pil_desc *desc)
 {
 	struct device_node *ofnode = desc->dev->of_node;
@@ -1172,6 +1347,7 @@ struct pil_seg_data {
 	struct pil_desc *desc;
 	struct pil_seg *seg;
 	struct work_struct load_seg_work;
+	bool ordered;
 	int retval;
 };
 
@@ -1183,10 +1359,18 @@ static void pil_load_seg_work_fn(struct work_struct *work)
 	struct pil_desc *desc = pil_seg_data->desc;
 	struct pil_seg *seg = pil_seg_data->seg;
 
-	pil_seg_data->retval = pil_load_seg(desc, seg);
+	if (pil_seg_data->ordered)
+		pil_seg_data->retval = pil_read_seg(desc, seg);
+	else
+		pil_seg_data->retval = pil_load_seg(desc, seg);
 }
 
-static int pil_load_segs(struct pil_desc *desc)
+/*
+ * With @ordered set the workers only read the blobs, which are verified
+ * here in order as they complete, so the blobs after one that is being
+ * verified are already read in the meantime.
+ */
+static int pil_load_segs(struct pil_desc *desc, bool ordered)
 {
 	int ret = 0;
 	int seg_id = 0;
@@ -1211,6 +1395,7 @@ static int pil_load_segs(struct pil_desc *desc)
 	list_for_each_entry(seg, &desc->priv->segs, list) {
 		pil_seg_data[seg_id].desc = desc;
 		pil_seg_data[seg_id].seg = seg;
+		pil_seg_data[seg_id].ordered = ordered;
 
 		INIT_WORK(&pil_seg_data[seg_id].load_seg_work,
 				pil_load_seg_work_fn);
@@ -1226,6 +1411,11 @@ static int pil_load_segs(struct pil_desc *desc)
 	list_for_each_entry(seg, &desc->priv->segs, list) {
 		flush_work(&pil_seg_data[seg_id].load_seg_work);
 
+		/* Blobs after a failed one are never verified */
+		if (ordered && !pil_seg_data[seg_id].retval &&
+		    bitmap_empty(err_map, priv->num_segs))
+			pil_seg_data[seg_id].retval = pil_verify_seg(desc, seg);
+
 		/* Don't exit if one of the thread fails. Wait for others to
 		 * complete. Bitmap the return codes we get from the threads.
 		 */
@@ -1281,8 +1471,18 @@ int pil_boot(struct pil_desc *desc)
 	pil_release_mmap(desc);
 
 	down_read(&pil_pm_rwsem);
+
+	/* the cache is only good for the image it was filled from */
+	if (strcmp(priv->fw_cache_name, desc->fw_name)) {
+		pil_fw_cache_flush(priv);
+		strlcpy(priv->fw_cache_name, desc->fw_name,
+			sizeof(priv->fw_cache_name));
+	}
+
 	snprintf(fw_name, sizeof(fw_name), "%s.mdt", desc->fw_name);
-	ret = request_firmware(&fw, fw_name, desc->dev);
+	fw = pil_fw_cache_enabled(desc) ?
+		pil_fw_cache_get(desc, PIL_FW_CACHE_MDT) : NULL;
+	ret = fw ? 0 : request_firmware(&fw, fw_name, desc->dev);
 	if (ret) {
 		pil_err(desc, "Failed to locate %s(rc:%d)\n", fw_name, ret);
 		goto out;
@@ -1375,8 +1575,8 @@ int pil_boot(struct pil_desc *desc)
 	 * Fallback to serial loading of blobs if the
 	 * workqueue creatation failed during module init.
 	 */
-	if (pil_wq && !(desc->sequential_loading)) {
-		ret = pil_load_segs(desc);
+	if (pil_wq && (!desc->sequential_loading || overlap_sequential)) {
+		ret = pil_load_segs(desc, desc->sequential_loading);
 		if (ret)
 			goto err_deinit_image;
 	} else {
@@ -1401,6 +1601,7 @@ int pil_boot(struct pil_desc *desc)
 	}
 
 	pil_log("before_auth_reset", desc);
+	pil_place_marker(desc, "Image Start Auth");
 	ret = desc->ops->auth_and_reset(desc);
 	if (ret) {
 		pil_err(desc, "Failed to bring out of reset(rc:%d)\n", ret);
@@ -1408,8 +1609,7 @@ int pil_boot(struct pil_desc *desc)
 	}
 	pil_log("reset_done", desc);
 
-	if (!strcmp(desc->name, "modem"))
-		place_marker("M - Modem out of reset");
+	pil_place_marker(desc, "out of reset");
 
 	pil_info(desc, "Brought out of reset\n");
 	desc->modem_ssr = false;
@@ -1427,10 +1627,12 @@ int pil_boot(struct pil_desc *desc)
 		disable_irq(desc->proxy_unvote_irq);
 	pil_proxy_unvote(desc, ret);
 release_fw:
-	release_firmware(fw);
+	pil_fw_release(desc, PIL_FW_CACHE_MDT, fw);
 out:
 	up_read(&pil_pm_rwsem);
 	if (ret) {
+		/* do not keep blobs that may be what failed the boot */
+		pil_fw_cache_flush(priv);
 		if (priv->region) {
 			if (desc->subsys_vmid > 0 && !mem_protect &&
 					hyp_assign) {
@@ -1644,6 +1846,8 @@ int pil_desc_init(struct pil_desc *desc)
 	wakeup_source_init(&priv->ws, priv->wname);
 	INIT_DELAYED_WORK(&priv->proxy, pil_proxy_unvote_work);
 	INIT_LIST_HEAD(&priv->segs);
+	INIT_LIST_HEAD(&priv->fw_cache);
+	mutex_init(&priv->fw_cache_lock);
 
 	/* Make sure mapping functions are set. */
 	if (!desc->map_fw_mem)
@@ -1679,6 +1883,7 @@ void pil_desc_release(struct pil_desc *desc)
 	struct pil_priv *priv = desc->priv;
 
 	if (priv) {
+		pil_fw_cache_flush(priv);
 		ida_simple_remove(&pil_ida, priv->id);
 		flush_delayed_work(&priv->proxy);
 		wakeup_source_trash(&priv->ws);
@@ -20,6 +20,8 @@
 #include <linux/errno.h>
 #include <linux/io.h>
 #include <linux/string.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
 #include <linux/soc/qcom/qmi.h>
 
 #define QMI_ENCDEC_ENCODE_TLV(type, length, p_dst) do { \
@@ -75,6 +77,149 @@ static int qmi_encode(struct qmi_elem_info *ei_array, void *out_buf,
 static int qmi_decode(struct qmi_elem_info *ei_array, void *out_c_struct,
 		      const void *in_buf, u32 in_buf_len, int dec_level);
 
+#ifdef CONFIG_QCOM_QMI_ENCDEC_PLAN
+/**
+ * struct qmi_encdec_plan - precompiled description of an element array
+ * @flat_size: Wire size of the array if it is a single fixed-size run laid
+ *             out exactly like the C structure, 0 otherwise.
+ * @partial: The array is too long for @tlv_idx to cover every element.
+ * @tlv_idx: Index + 1 of the first element of each TLV type, 0 if absent.
+ */
+struct qmi_encdec_plan {
+	u32 flat_size;
+	bool partial;
+	u8 tlv_idx[U8_MAX + 1];
+};
+
+static bool qmi_encdec_plan_enabled = true;
+module_param_named(plan, qmi_encdec_plan_enabled, bool, 0644);
+MODULE_PARM_DESC(plan, "Use compiled encode/decode plans");
+
+static u32 qmi_plan_flat_size(struct qmi_elem_info *ei_array);
+
+static u32 qmi_plan_elem_flat_size(struct qmi_elem_info *ei)
+{
+	u32 n, size;
+
+	if (ei->is_array == NO_ARRAY)
+		n = 1;
+	else if (ei->is_array == STATIC_ARRAY)
+		n = ei->elem_len;
+	else
+		return 0;
+
+	switch (ei->data_type) {
+	case QMI_UNSIGNED_1_BYTE:
+	case QMI_UNSIGNED_2_BYTE:
+	case QMI_UNSIGNED_4_BYTE:
+	case QMI_UNSIGNED_8_BYTE:
+	case QMI_SIGNED_2_BYTE_ENUM:
+	case QMI_SIGNED_4_BYTE_ENUM:
+		return n * ei->elem_size;
+
+	case QMI_STRUCT:
+		size = qmi_plan_flat_size(ei->ei_array);
+		/* Array members must follow each other without padding */
+		if (!size || (n > 1 && size != ei->elem_size))
+			return 0;
+		return n * size;
+
+	default:
+		return 0;
+	}
+}
+
+/*
+ * A nested structure is flat if all its elements have a fixed size and
+ * each one sits at the offset it has on the wire. Optional elements,
+ * variable length arrays and strings all break that.
+ */
+static u32 qmi_plan_flat_size(struct qmi_elem_info *ei_array)
+{
+	struct qmi_elem_info *temp_ei;
+	u32 size = 0, rc;
+
+	if (!ei_array)
+		return 0;
+
+	for (temp_ei = ei_array; temp_ei->data_type != QMI_EOTI; temp_ei++) {
+		if (temp_ei->offset != size)
+			return 0;
+
+		rc = qmi_plan_elem_flat_size(temp_ei);
+		if (!rc)
+			return 0;
+		size += rc;
+	}
+
+	return size;
+}
+
+/**
+ * qmi_get_plan() - Get the plan of an element array, compiling it if needed
+ * @ei_array: Struct info array the plan describes.
+ *
+ * Returns the plan or NULL if plans are disabled or could not be allocated,
+ * in which case the caller falls back to interpreting @ei_array.
+ */
+static struct qmi_encdec_plan *qmi_get_plan(struct qmi_elem_info *ei_array)
+{
+	struct qmi_encdec_plan *plan;
+	struct qmi_elem_info *temp_ei;
+	u32 i;
+
+	if (!READ_ONCE(qmi_encdec_plan_enabled) || !ei_array)
+		return NULL;
+
+	plan = READ_ONCE(ei_array->plan);
+	if (likely(plan))
+		return plan;
+
+	plan = kzalloc(sizeof(*plan), GFP_ATOMIC | __GFP_NOWARN);
+	if (!plan)
+		return NULL;
+
+	plan->flat_size = qmi_plan_flat_size(ei_array);
+	for (i = 0, temp_ei = ei_array; temp_ei->data_type != QMI_EOTI;
+	     i++, temp_ei++) {
+		if (i >= U8_MAX) {
+			plan->partial = true;
+			break;
+		}
+		if (!plan->tlv_idx[temp_ei->tlv_type])
+			plan->tlv_idx[temp_ei->tlv_type] = i + 1;
+	}
+
+	/* Plans are never freed, whoever publishes first wins */
+	if (cmpxchg(&ei_array->plan, NULL, plan)) {
+		kfree(plan);
+		plan = READ_ONCE(ei_array->plan);
+	}
+
+	return plan;
+}
+
+static inline bool qmi_plan_in_use(void)
+{
+	return READ_ONCE(qmi_encdec_plan_enabled);
+}
+#else
+struct qmi_encdec_plan {
+	u32 flat_size;
+};
+
+static inline struct qmi_encdec_plan *
+qmi_get_plan(struct qmi_elem_info *ei_array)
+{
+	return NULL;
+}
+
+static inline bool qmi_plan_in_use(void)
+{
+	return false;
+}
+#endif
+
 /**
  * skip_to_next_elem() - Skip to next element in the structure to be encoded
  * @ei_array: Struct info describing the element to be skipped.
@@ -178,6 +323,12 @@ static int qmi_encode_basic_elem(void *buf_dst, const void *buf_src,
 {
 	u32 i, rc = 0;
 
+	/* Elements are contiguous on both sides, copy the run at once */
+	if (qmi_plan_in_use()) {
+		memcpy(buf_dst, buf_src, elem_len * elem_size);
+		return elem_len * elem_size;
+	}
+
 	for (i = 0; i < elem_len; i++) {
 		QMI_ENCDEC_ENCODE_N_BYTES(buf_dst, buf_src, elem_size);
 		rc += elem_size;
@@ -211,6 +362,26 @@ static int qmi_encode_struct_elem(struct qmi_elem_info *ei_array,
 {
 	int i, rc, encoded_bytes = 0;
 	struct qmi_elem_info *temp_ei = ei_array;
+	struct qmi_encdec_plan *plan;
+	u32 flat;
+
+	/*
+	 * Same bound as the element by element path, which keeps room
+	 * for a TLV header even inside nested structures.
+	 */
+	plan = qmi_get_plan(temp_ei->ei_array);
+	flat = plan ? plan->flat_size : 0;
+	if (flat && flat * elem_len + TLV_LEN_SIZE + TLV_TYPE_SIZE <=
+		    out_buf_len) {
+		if (elem_len == 1 || flat == temp_ei->elem_size) {
+			memcpy(buf_dst, buf_src, flat * elem_len);
+		} else {
+			for (i = 0; i < elem_len; i++)
+				memcpy(buf_dst + i * flat,
+				       buf_src + i * temp_ei->elem_size, flat);
+		}
+		return flat * elem_len;
+	}
 
 	for (i = 0; i < elem_len; i++) {
 		rc = qmi_encode(temp_ei->ei_array, buf_dst, buf_src,
@@ -449,6 +620,11 @@ static int qmi_decode_basic_elem(void *buf_dst, const void *buf_src,
 {
 	u32 i, rc = 0;
 
+	if (qmi_plan_in_use()) {
+		memcpy(buf_dst, buf_src, elem_len * elem_size);
+		return elem_len * elem_size;
+	}
+
 	for (i = 0; i < elem_len; i++) {
 		QMI_ENCDEC_DECODE_N_BYTES(buf_dst, buf_src, elem_size);
 		rc += elem_size;
@@ -483,6 +659,23 @@ static int qmi_decode_struct_elem(struct qmi_elem_info *ei_array,
 {
 	int i, rc, decoded_bytes = 0;
 	struct qmi_elem_info *temp_ei = ei_array;
+	struct qmi_encdec_plan *plan;
+	u32 flat;
+
+	plan = qmi_get_plan(temp_ei->ei_array);
+	flat = plan ? plan->flat_size : 0;
+	if (flat && flat * elem_len <= tlv_len) {
+		if (elem_len == 1 || flat == temp_ei->elem_size) {
+			memcpy(buf_dst, buf_src, flat * elem_len);
+		} else {
+			for (i = 0; i < elem_len; i++)
+				memcpy(buf_dst + i * temp_ei->elem_size,
+				       buf_src + i * flat, flat);
+		}
+		i = elem_len;
+		decoded_bytes = flat * elem_len;
+		goto check;
+	}
 
 	for (i = 0; i < elem_len && decoded_bytes < tlv_len; i++) {
 		rc = qmi_decode(temp_ei->ei_array, buf_dst, buf_src,
@@ -494,6 +687,7 @@ static int qmi_decode_struct_elem(struct qmi_elem_info *ei_array,
 		decoded_bytes += rc;
 	}
 
+check:
 	if ((dec_level <= 2 && decoded_bytes != tlv_len) ||
 	    (dec_level > 2 && (i < elem_len || decoded_bytes > tlv_len))) {
 		pr_err("%s: Fault in decoding: dl(%d), db(%d), tl(%d), i(%d), el(%d)\n",
@@ -585,6 +779,24 @@ static struct qmi_elem_info *find_ei(struct qmi_elem_info *ei_array,
 	return NULL;
 }
 
+static struct qmi_elem_info *qmi_plan_find_ei(struct qmi_elem_info *ei_array,
+					      struct qmi_encdec_plan *plan,
+					      u32 type)
+{
+#ifdef CONFIG_QCOM_QMI_ENCDEC_PLAN
+	u8 idx;
+
+	if (plan) {
+		idx = plan->tlv_idx[(u8)type];
+		if (idx)
+			return ei_array + idx - 1;
+		if (!plan->partial)
+			return NULL;
+	}
+#endif
+	return find_ei(ei_array, type);
+}
+
 /**
  * qmi_decode() - Core Decode Function
  * @ei_array: Struct info array describing the structure to be decoded.
@@ -602,6 +814,7 @@ static int qmi_decode(struct qmi_elem_info *ei_array, void *out_c_struct,
 		      int dec_level)
 {
 	struct qmi_elem_info *temp_ei = ei_array;
+	struct qmi_encdec_plan *plan = NULL;
 	u8 opt_flag_value = 1;
 	u32 data_len_value = 0, data_len_sz = 0;
 	u8 *buf_dst = out_c_struct;
@@ -612,6 +825,9 @@ static int qmi_decode(struct qmi_elem_info *ei_array, void *out_c_struct,
 	const void *buf_src = in_buf;
 	int rc;
 
+	if (dec_level == 1)
+		plan = qmi_get_plan(ei_array);
+
 	while (decoded_bytes < in_buf_len) {
 		if (dec_level >= 2 && temp_ei->data_type == QMI_EOTI)
 			return decoded_bytes;
@@ -622,7 +838,7 @@ static int qmi_decode(struct qmi_elem_info *ei_array, void *out_c_struct,
 					      &tlv_len, tlv_pointer);
 			buf_src += (TLV_TYPE_SIZE + TLV_LEN_SIZE);
 			decoded_bytes += (TLV_TYPE_SIZE + TLV_LEN_SIZE);
-			temp_ei = find_ei(ei_array, tlv_type);
+			temp_ei = qmi_plan_find_ei(ei_array, plan, tlv_type);
 			if (!temp_ei && tlv_type < OPTIONAL_TLV_TYPE_START) {
 				pr_err("%s: Inval element info\n", __func__);
 				return -EINVAL;
@@ -822,5 +1038,222 @@ struct qmi_elem_info qmi_response_type_v01_ei[] = {
 };
 EXPORT_SYMBOL(qmi_response_type_v01_ei);
 
+#if defined(CONFIG_QCOM_QMI_ENCDEC_PLAN) && defined(CONFIG_DEBUG_FS)
+/*
+ * Benchmark of the plan against the interpreter, shaped like a DFC flow
+ * status indication: a response TLV, a variable array of flat structs
+ * and an optional scalar. Reading qmi_encdec/bench runs it.
+ */
+#define QMI_BENCH_FLOWS 32
+#define QMI_BENCH_ITERS 10000
+#define QMI_BENCH_MAX_LEN 1024
+
+struct qmi_bench_flow {
+	u8 mux_id;
+	u8 bearer_id;
+	u16 seq_num;
+	u32 num_bytes;
+	u32 rx_bytes;
+	u32 flow_status;
+};
+
+struct qmi_bench_msg {
+	struct qmi_response_type_v01 resp;
+	u8 flow_valid;
+	u32 flow_len;
+	struct qmi_bench_flow flow[QMI_BENCH_FLOWS];
+	u8 seq_valid;
+	u32 seq;
+};
+
+static struct qmi_elem_info qmi_bench_flow_ei[] = {
+	{
+		.data_type	= QMI_UNSIGNED_1_BYTE,
+		.elem_len	= 1,
+		.elem_size	= sizeof(u8),
+		.offset		= offsetof(struct qmi_bench_flow, mux_id),
+	},
+	{
+		.data_type	= QMI_UNSIGNED_1_BYTE,
+		.elem_len	= 1,
+		.elem_size	= sizeof(u8),
+		.offset		= offsetof(struct qmi_bench_flow, bearer_id),
+	},
+	{
+		.data_type	= QMI_UNSIGNED_2_BYTE,
+		.elem_len	= 1,
+		.elem_size	= sizeof(u16),
+		.offset		= offsetof(struct qmi_bench_flow, seq_num),
+	},
+	{
+		.data_type	= QMI_UNSIGNED_4_BYTE,
+		.elem_len	= 1,
+		.elem_size	= sizeof(u32),
+		.offset		= offsetof(struct qmi_bench_flow, num_bytes),
+	},
+	{
+		.data_type	= QMI_UNSIGNED_4_BYTE,
+		.elem_len	= 1,
+		.elem_size	= sizeof(u32),
+		.offset		= offsetof(struct qmi_bench_flow, rx_bytes),
+	},
+	{
+		.data_type	= QMI_UNSIGNED_4_BYTE,
+		.elem_len	= 1,
+		.elem_size	= sizeof(u32),
+		.offset		= offsetof(struct qmi_bench_flow, flow_status),
+	},
+	{
+		.data_type	= QMI_EOTI,
+	},
+};
+
+static struct qmi_elem_info qmi_bench_msg_ei[] = {
+	{
+		.data_type	= QMI_STRUCT,
+		.elem_len	= 1,
+		.elem_size	= sizeof(struct qmi_response_type_v01),
+		.tlv_type	= 0x02,
+		.offset		= offsetof(struct qmi_bench_msg, resp),
+		.ei_array	= qmi_response_type_v01_ei,
+	},
+	{
+		.data_type	= QMI_OPT_FLAG,
+		.elem_len	= 1,
+		.elem_size	= sizeof(u8),
+		.tlv_type	= 0x10,
+		.offset		= offsetof(struct qmi_bench_msg, flow_valid),
+	},
+	{
+		.data_type	= QMI_DATA_LEN,
+		.elem_len	= 1,
+		.elem_size	= sizeof(u8),
+		.tlv_type	= 0x10,
+		.offset		= offsetof(struct qmi_bench_msg, flow_len),
+	},
+	{
+		.data_type	= QMI_STRUCT,
+		.elem_len	= QMI_BENCH_FLOWS,
+		.elem_size	= sizeof(struct qmi_bench_flow),
+		.is_array	= VAR_LEN_ARRAY,
+		.tlv_type	= 0x10,
+		.offset		= offsetof(struct qmi_bench_msg, flow),
+		.ei_array	= qmi_bench_flow_ei,
+	},
+	{
+		.data_type	= QMI_OPT_FLAG,
+		.elem_len	= 1,
+		.elem_size	= sizeof(u8),
+		.tlv_type	= 0x11,
+		.offset		= offsetof(struct qmi_bench_msg, seq_valid),
+	},
+	{
+		.data_type	= QMI_UNSIGNED_4_BYTE,
+		.elem_len	= 1,
+		.elem_size	= sizeof(u32),
+		.tlv_type	= 0x11,
+		.offset		= offsetof(struct qmi_bench_msg, seq),
+	},
+	{
+		.data_type	= QMI_EOTI,
+	},
+};
+
+static int qmi_bench_run(struct qmi_bench_msg *in, struct qmi_bench_msg *out,
+			 void *buf, bool use_plan, u64 *enc_ns, u64 *dec_ns)
+{
+	u64 start;
+	int i, len = 0, rc;
+
+	WRITE_ONCE(qmi_encdec_plan_enabled, use_plan);
+
+	start = ktime_get_ns();
+	for (i = 0; i < QMI_BENCH_ITERS; i++) {
+		len = qmi_encode(qmi_bench_msg_ei, buf, in,
+				 QMI_BENCH_MAX_LEN, 1);
+		if (len < 0)
+			return len;
+	}
+	*enc_ns = div_u64(ktime_get_ns() - start, QMI_BENCH_ITERS);
+
+	start = ktime_get_ns();
+	for (i = 0; i < QMI_BENCH_ITERS; i++) {
+		memset(out, 0, sizeof(*out));
+		rc = qmi_decode(qmi_bench_msg_ei, out, buf, len, 1);
+		if (rc < 0)
+			return rc;
+	}
+	*dec_ns = div_u64(ktime_get_ns() - start, QMI_BENCH_ITERS);
+
+	return memcmp(in, out, sizeof(*in)) ? -EBADMSG : 0;
+}
+
+static ssize_t qmi_bench_read(struct file *file, char __user *ubuf,
+			      size_t count, loff_t *ppos)
+{
+	struct qmi_bench_msg *in, *out;
+	u64 enc[2] = { 0 }, dec[2] = { 0 };
+	bool saved = READ_ONCE(qmi_encdec_plan_enabled);
+	char str[160];
+	void *buf;
+	int i, rc[2] = { -ENOMEM, -ENOMEM }, len;
+
+	if (*ppos)
+		return 0;
+
+	in = kzalloc(sizeof(*in), GFP_KERNEL);
+	out = kzalloc(sizeof(*out), GFP_KERNEL);
+	buf = kzalloc(QMI_BENCH_MAX_LEN, GFP_KERNEL);
+	if (!in || !out || !buf)
+		goto out;
+
+	in->flow_valid = 1;
+	in->flow_len = QMI_BENCH_FLOWS;
+	for (i = 0; i < QMI_BENCH_FLOWS; i++) {
+		in->flow[i].mux_id = 1;
+		in->flow[i].bearer_id = i;
+		in->flow[i].seq_num = i * 7;
+		in->flow[i].num_bytes = 0x10000 + i;
+		in->flow[i].rx_bytes = 0x20000 + i;
+		in->flow[i].flow_status = i & 1;
+	}
+	in->seq_valid = 1;
+	in->seq = 0x1234;
+
+	rc[0] = qmi_bench_run(in, out, buf, false, &enc[0], &dec[0]);
+	rc[1] = qmi_bench_run(in, out, buf, true, &enc[1], &dec[1]);
+	WRITE_ONCE(qmi_encdec_plan_enabled, saved);
+
+out:
+	kfree(buf);
+	kfree(out);
+	kfree(in);
+
+	len = scnprintf(str, sizeof(str),
+			"interp: encode %llu ns decode %llu ns rc %d\n"
+			"plan:   encode %llu ns decode %llu ns rc %d\n",
+			enc[0], dec[0], rc[0], enc[1], dec[1], rc[1]);
+
+	return simple_read_from_buffer(ubuf, count, ppos, str, len);
+}
+
+static const struct file_operations qmi_bench_fops = {
+	.read = qmi_bench_read,
+};
+
+static int __init qmi_encdec_bench_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("qmi_encdec", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return 0;
+
+	debugfs_create_file("bench", 0400, dir, NULL, &qmi_bench_fops);
+	return 0;
+}
+late_initcall(qmi_encdec_bench_init);
+#endif
+
 MODULE_DESCRIPTION("QMI encoder/decoder helper");
 MODULE_LICENSE("GPL v2");
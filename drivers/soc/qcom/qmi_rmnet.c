@@ -150,13 +150,13 @@ qmi_rmnet_clean_flow_list(struct qos_info *qos)
 	ASSERT_RTNL();
 
 	list_for_each_entry_safe(itm, fl_tmp, &qos->flow_head, list) {
-		list_del(&itm->list);
-		kfree(itm);
+		list_del_rcu(&itm->list);
+		kfree_rcu(itm, rcu);
 	}
 
 	list_for_each_entry_safe(bearer, br_tmp, &qos->bearer_head, list) {
-		list_del(&bearer->list);
-		kfree(bearer);
+		list_del_rcu(&bearer->list);
+		kfree_rcu(bearer, rcu);
 	}
 
 	memset(qos->mq, 0, sizeof(qos->mq));
@@ -170,7 +170,7 @@ qmi_rmnet_get_flow_map(struct qos_info *qos, u32 flow_id, int ip_type)
 	if (!qos)
 		return NULL;
 
-	list_for_each_entry(itm, &qos->flow_head, list) {
+	list_for_each_entry_rcu(itm, &qos->flow_head, list) {
 		if ((itm->flow_id == flow_id) && (itm->ip_type == ip_type))
 			return itm;
 	}
@@ -185,7 +185,7 @@ qmi_rmnet_get_bearer_map(struct qos_info *qos, uint8_t bearer_id)
 	if (!qos)
 		return NULL;
 
-	list_for_each_entry(itm, &qos->bearer_head, list) {
+	list_for_each_entry_rcu(itm, &qos->bearer_head, list) {
 		if (itm->bearer_id == bearer_id)
 			return itm;
 	}
@@ -258,7 +258,7 @@ static void qmi_rmnet_watchdog_fn(struct timer_list *t)
 	 * the bearer if disabled.
 	 */
 	bearer->watchdog_expire_cnt++;
-	bearer->bytes_in_flight = 0;
+	atomic_set(&bearer->bytes_in_flight, 0);
 	if (!bearer->grant_size) {
 		bearer->grant_size = DEFAULT_GRANT;
 		bearer->grant_thresh = qmi_rmnet_grant_per(bearer->grant_size);
@@ -315,7 +315,7 @@ static void qmi_rmnet_bearer_clean(struct qos_info *qos)
 	if (qos->removed_bearer) {
 		qos->removed_bearer->watchdog_quit = true;
 		del_timer_sync(&qos->removed_bearer->watchdog);
-		kfree(qos->removed_bearer);
+		kfree_rcu(qos->removed_bearer, rcu);
 		qos->removed_bearer = NULL;
 	}
 }
@@ -341,7 +341,7 @@ static struct rmnet_bearer_map *__qmi_rmnet_bearer_get(
 		bearer->ack_mq_idx = INVALID_MQ;
 		bearer->qos = qos_info;
 		timer_setup(&bearer->watchdog, qmi_rmnet_watchdog_fn, 0);
-		list_add(&bearer->list, &qos_info->bearer_head);
+		list_add_rcu(&bearer->list, &qos_info->bearer_head);
 	}
 
 	return bearer;
@@ -361,7 +361,7 @@ static void __qmi_rmnet_bearer_put(struct net_device *dev,
 			if (mq->bearer != bearer)
 				continue;
 
-			mq->bearer = NULL;
+			WRITE_ONCE(mq->bearer, NULL);
 			if (reset) {
 				qmi_rmnet_reset_txq(dev, i);
 				qmi_rmnet_flow_control(dev, i, 1);
@@ -375,7 +375,7 @@ static void __qmi_rmnet_bearer_put(struct net_device *dev,
 		}
 
 		/* Remove from bearer map */
-		list_del(&bearer->list);
+		list_del_rcu(&bearer->list);
 		qos_info->removed_bearer = bearer;
 	}
 }
@@ -393,7 +393,7 @@ static void __qmi_rmnet_update_mq(struct net_device *dev,
 
 	mq = &qos_info->mq[itm->mq_idx];
 	if (!mq->bearer) {
-		mq->bearer = bearer;
+		rcu_assign_pointer(mq->bearer, bearer);
 
 		if (dfc_mode == DFC_MODE_SA) {
 			bearer->mq_idx = itm->mq_idx;
@@ -428,7 +428,7 @@ static int __qmi_rmnet_rebind_flow(struct net_device *dev,
 		return -ENOMEM;
 
 	qmi_rmnet_update_flow_map(itm, new_map);
-	itm->bearer = bearer;
+	rcu_assign_pointer(itm->bearer, bearer);
 
 	__qmi_rmnet_update_mq(dev, qos_info, bearer, itm);
 
@@ -492,7 +492,7 @@ static int qmi_rmnet_add_flow(struct net_device *dev, struct tcmsg *tcm,
 	}
 
 	qmi_rmnet_update_flow_map(itm, &new_map);
-	list_add(&itm->list, &qos_info->flow_head);
+	list_add_rcu(&itm->list, &qos_info->flow_head);
 
 	/* Create or update bearer map */
 	bearer = __qmi_rmnet_bearer_get(qos_info, new_map.bearer_id);
@@ -501,7 +501,7 @@ static int qmi_rmnet_add_flow(struct net_device *dev, struct tcmsg *tcm,
 		goto done;
 	}
 
-	itm->bearer = bearer;
+	rcu_assign_pointer(itm->bearer, bearer);
 
 	__qmi_rmnet_update_mq(dev, qos_info, bearer, itm);
 
@@ -545,8 +545,8 @@ qmi_rmnet_del_flow(struct net_device *dev, struct tcmsg *tcm,
 		__qmi_rmnet_bearer_put(dev, qos_info, itm->bearer, true);
 
 		/* Remove from flow map */
-		list_del(&itm->list);
-		kfree(itm);
+		list_del_rcu(&itm->list);
+		kfree_rcu(itm, rcu);
 	}
 
 	if (list_empty(&qos_info->flow_head))
@@ -833,7 +833,7 @@ void qmi_rmnet_enable_all_flows(struct net_device *dev)
 	list_for_each_entry(bearer, &qos->bearer_head, list) {
 		bearer->seq = 0;
 		bearer->ack_req = 0;
-		bearer->bytes_in_flight = 0;
+		atomic_set(&bearer->bytes_in_flight, 0);
 		bearer->tcp_bidir = false;
 		bearer->rat_switch = false;
 
@@ -934,6 +934,7 @@ static inline bool qmi_rmnet_is_tcp_ack(struct sk_buff *skb)
 
 static int qmi_rmnet_get_queue_sa(struct qos_info *qos, struct sk_buff *skb)
 {
+	struct rmnet_bearer_map *bearer;
 	struct rmnet_flow_map *itm;
 	int ip_type;
 	int txq = DEFAULT_MQ_NUM;
@@ -948,20 +949,21 @@ static int qmi_rmnet_get_queue_sa(struct qos_info *qos, struct sk_buff *skb)
 
 	ip_type = (skb->protocol == htons(ETH_P_IPV6)) ? AF_INET6 : AF_INET;
 
-	spin_lock_bh(&qos->qos_lock);
+	rcu_read_lock();
 
 	itm = qmi_rmnet_get_flow_map(qos, skb->mark, ip_type);
 	if (unlikely(!itm))
 		goto done;
 
 	/* Put the packet in the assigned mq except TCP ack */
-	if (likely(itm->bearer) && qmi_rmnet_is_tcp_ack(skb))
-		txq = itm->bearer->ack_mq_idx;
+	bearer = READ_ONCE(itm->bearer);
+	if (likely(bearer) && qmi_rmnet_is_tcp_ack(skb))
+		txq = bearer->ack_mq_idx;
 	else
 		txq = itm->mq_idx;
 
 done:
-	spin_unlock_bh(&qos->qos_lock);
+	rcu_read_unlock();
 	return txq;
 }
 
@@ -993,7 +995,7 @@ int qmi_rmnet_get_queue(struct net_device *dev, struct sk_buff *skb)
 	ip_type = (skb->protocol == htons(ETH_P_IPV6)) ? AF_INET6 : AF_INET;
 
 	/* Dedicated flows */
-	spin_lock_bh(&qos->qos_lock);
+	rcu_read_lock();
 
 	itm = qmi_rmnet_get_flow_map(qos, mark, ip_type);
 	if (unlikely(!itm))
@@ -1002,7 +1004,7 @@ int qmi_rmnet_get_queue(struct net_device *dev, struct sk_buff *skb)
 	txq = itm->mq_idx;
 
 done:
-	spin_unlock_bh(&qos->qos_lock);
+	rcu_read_unlock();
 	return txq;
 }
 EXPORT_SYMBOL(qmi_rmnet_get_queue);
@@ -1080,6 +1082,142 @@ struct rmnet_powersave_work {
 	u64 old_tx_pkts;
 };
 
+/*
+ * Adaptive powersave. Instead of a fixed one second idle check, the
+ * gap between traffic bursts is learned and used to pick the idle time
+ * after which powersave is entered, to stay out of powersave when
+ * bursts come more often than rmnet_ps_enter_budget_ms, and to leave
+ * powersave rmnet_ps_exit_budget_ms ahead of the predicted next burst.
+ */
+static bool rmnet_ps_adaptive __read_mostly;
+module_param(rmnet_ps_adaptive, bool, 0644);
+MODULE_PARM_DESC(rmnet_ps_adaptive, "Learn burst gaps to drive powersave");
+
+static unsigned int rmnet_ps_enter_budget_ms __read_mostly = 100;
+module_param(rmnet_ps_enter_budget_ms, uint, 0644);
+MODULE_PARM_DESC(rmnet_ps_enter_budget_ms,
+		 "Shortest burst gap worth entering powersave for, in ms");
+
+static unsigned int rmnet_ps_exit_budget_ms __read_mostly = 20;
+module_param(rmnet_ps_exit_budget_ms, uint, 0644);
+MODULE_PARM_DESC(rmnet_ps_exit_budget_ms,
+		 "Time to leave powersave ahead of the next burst, in ms");
+
+/* Activity closer together than this belongs to the same burst */
+#define PS_BURST_GAP_MS 10
+#define PS_GAP_WEIGHT 3
+
+static struct {
+	u32 enter;
+	u32 exit;
+	u32 predicted_exit;
+	u32 skipped;
+	ktime_t state_ts;
+	u64 active_ms;
+	u64 ps_ms;
+} rmnet_ps_stats;
+
+static void qmi_rmnet_ps_account(bool ps_enabled)
+{
+	ktime_t now = ktime_get_boottime();
+	u64 delta = ktime_ms_delta(now, rmnet_ps_stats.state_ts);
+
+	if (ps_enabled)
+		rmnet_ps_stats.ps_ms += delta;
+	else
+		rmnet_ps_stats.active_ms += delta;
+	rmnet_ps_stats.state_ts = now;
+}
+
+static int qmi_rmnet_ps_stats_get(char *buf, const struct kernel_param *kp)
+{
+	u64 active_ms = rmnet_ps_stats.active_ms;
+	u64 ps_ms = rmnet_ps_stats.ps_ms;
+	struct qmi_info *qmi = NULL;
+	u32 gap_ms = 0;
+	u64 cur_ms;
+
+	if (rmnet_work_inited && rmnet_work)
+		qmi = rmnet_get_qmi_pt(rmnet_work->port);
+
+	/* Include the time spent in the current state */
+	if (qmi) {
+		cur_ms = ktime_ms_delta(ktime_get_boottime(),
+					rmnet_ps_stats.state_ts);
+		if (qmi->ps_enabled)
+			ps_ms += cur_ms;
+		else
+			active_ms += cur_ms;
+		gap_ms = qmi->ps_gap_ms;
+	}
+
+	return scnprintf(buf, PAGE_SIZE,
+			 "enter:%u exit:%u predicted_exit:%u skipped:%u "
+			 "active_ms:%llu ps_ms:%llu gap_ms:%u\n",
+			 rmnet_ps_stats.enter, rmnet_ps_stats.exit,
+			 rmnet_ps_stats.predicted_exit, rmnet_ps_stats.skipped,
+			 active_ms, ps_ms, gap_ms);
+}
+
+static const struct kernel_param_ops qmi_rmnet_ps_stats_ops = {
+	.get	= qmi_rmnet_ps_stats_get,
+};
+
+module_param_cb(rmnet_ps_stats, &qmi_rmnet_ps_stats_ops, NULL, 0444);
+MODULE_PARM_DESC(rmnet_ps_stats, "Powersave transitions and residency");
+
+static void qmi_rmnet_ps_learn(struct qmi_info *qmi)
+{
+	unsigned long now = jiffies;
+	unsigned long last = READ_ONCE(qmi->ps_last_act);
+	u32 gap, avg;
+
+	if (now == last)
+		return;
+
+	WRITE_ONCE(qmi->ps_last_act, now);
+	gap = jiffies_to_msecs(now - last);
+	if (!last || gap < PS_BURST_GAP_MS)
+		return;
+
+	avg = READ_ONCE(qmi->ps_gap_ms);
+	if (avg)
+		gap = (avg * PS_GAP_WEIGHT + gap) / (PS_GAP_WEIGHT + 1);
+	WRITE_ONCE(qmi->ps_gap_ms, gap);
+}
+
+/* Idle time after which powersave is entered */
+static ktime_t qmi_rmnet_ps_interval(struct qmi_info *qmi)
+{
+	u32 ms;
+
+	if (!rmnet_ps_adaptive || !qmi->ps_gap_ms)
+		return PS_INTERVAL_KT;
+
+	ms = clamp_t(u32, qmi->ps_gap_ms / 2,
+		     max_t(u32, rmnet_ps_enter_budget_ms, PS_BURST_GAP_MS),
+		     ktime_to_ms(PS_INTERVAL_KT));
+	return ms_to_ktime(ms);
+}
+
+/* Arm an exit ahead of the predicted end of the current gap */
+static void qmi_rmnet_ps_predict_exit(struct qmi_info *qmi,
+				      struct rmnet_powersave_work *real_work)
+{
+	u32 idle_ms, wake_ms;
+
+	if (!rmnet_ps_adaptive || !qmi->ps_gap_ms)
+		return;
+
+	idle_ms = jiffies_to_msecs(jiffies - READ_ONCE(qmi->ps_last_act));
+	if (qmi->ps_gap_ms <= idle_ms + rmnet_ps_exit_budget_ms)
+		return;
+
+	wake_ms = qmi->ps_gap_ms - idle_ms - rmnet_ps_exit_budget_ms;
+	qmi->ps_predicted_exit = true;
+	alarm_start_relative(&real_work->atimer, ms_to_ktime(wake_ms));
+}
+
 void qmi_rmnet_ps_on_notify(void *port)
 {
 	struct qmi_rmnet_ps_ind *tmp;
@@ -1197,7 +1335,15 @@ static void qmi_rmnet_check_stats(struct work_struct *work)
 		if (qmi_rmnet_set_powersave_mode(real_work->port, 0) < 0)
 			goto end;
 
+		qmi_rmnet_ps_account(true);
 		qmi->ps_enabled = false;
+		rmnet_ps_stats.exit++;
+		if (qmi->ps_predicted_exit) {
+			qmi->ps_predicted_exit = false;
+			rmnet_ps_stats.predicted_exit++;
+			/* Woken by the alarm, not by traffic */
+			set_bit(PS_WORK_ACTIVE_BIT, &qmi->ps_work_active);
+		}
 
 		/* Do a query when coming out of powersave */
 		qmi_rmnet_query_flows(qmi);
@@ -1227,11 +1373,20 @@ static void qmi_rmnet_check_stats(struct work_struct *work)
 			goto end;
 		}
 
+		/* Bursts come too often for powersave to pay off */
+		if (rmnet_ps_adaptive && qmi->ps_gap_ms &&
+		    qmi->ps_gap_ms < rmnet_ps_enter_budget_ms) {
+			rmnet_ps_stats.skipped++;
+			goto end;
+		}
+
 		/* Deregister to suppress QMI DFC and DL marker */
 		if (qmi_rmnet_set_powersave_mode(real_work->port, 1) < 0)
 			goto end;
 
+		qmi_rmnet_ps_account(false);
 		qmi->ps_enabled = true;
+		rmnet_ps_stats.enter++;
 
 		/* Ignore grant after going into powersave */
 		qmi->ps_ignore_grant = true;
@@ -1245,6 +1400,10 @@ static void qmi_rmnet_check_stats(struct work_struct *work)
 		if (rmnet_get_powersave_notif(real_work->port))
 			qmi_rmnet_ps_on_notify(real_work->port);
 
+		rcu_read_lock();
+		if (!rmnet_work_quit)
+			qmi_rmnet_ps_predict_exit(qmi, real_work);
+		rcu_read_unlock();
 		return;
 	}
 end:
@@ -1252,7 +1411,7 @@ static void qmi_rmnet_check_stats(struct work_struct *work)
 	if (!rmnet_work_quit) {
 		if (use_alarm_timer)
 			alarm_start_relative(&real_work->atimer,
-					     PS_INTERVAL_KT);
+					     qmi_rmnet_ps_interval(qmi));
 		else
 			queue_delayed_work(rmnet_ps_wq, &real_work->work,
 					   PS_INTERVAL);
@@ -1296,6 +1455,7 @@ void qmi_rmnet_work_init(void *port)
 	rmnet_work->port = port;
 	rmnet_get_packets(rmnet_work->port, &rmnet_work->old_rx_pkts,
 			  &rmnet_work->old_tx_pkts);
+	rmnet_ps_stats.state_ts = ktime_get_boottime();
 
 	rmnet_work_quit = false;
 	qmi_rmnet_work_set_active(rmnet_work->port, 1);
@@ -1312,6 +1472,8 @@ void qmi_rmnet_work_maybe_restart(void *port)
 	if (unlikely(!qmi || !rmnet_work_inited))
 		return;
 
+	qmi_rmnet_ps_learn(qmi);
+
 	if (!test_and_set_bit(PS_WORK_ACTIVE_BIT, &qmi->ps_work_active))
 		qmi_rmnet_work_restart(port);
 }
@@ -36,8 +36,15 @@ extern int dfc_qmap;
 
 struct qos_info;
 
+/*
+ * Bearer and flow maps are added and removed under qos_lock and freed
+ * after an RCU grace period, so the TX path can look them up and
+ * consume grant under rcu_read_lock only. grant_size is only stored
+ * under qos_lock and is decremented on TX with cmpxchg.
+ */
 struct rmnet_bearer_map {
 	struct list_head list;
+	struct rcu_head rcu;
 	u8 bearer_id;
 	int flow_ref;
 	u32 grant_size;
@@ -46,7 +53,7 @@ struct rmnet_bearer_map {
 	u8  ack_req;
 	u32 last_grant;
 	u16 last_seq;
-	u32 bytes_in_flight;
+	atomic_t bytes_in_flight;
 	u32 last_adjusted_grant;
 	bool tcp_bidir;
 	bool rat_switch;
@@ -64,6 +71,7 @@ struct rmnet_bearer_map {
 
 struct rmnet_flow_map {
 	struct list_head list;
+	struct rcu_head rcu;
 	u8 bearer_id;
 	u32 flow_id;
 	int ip_type;
@@ -105,6 +113,10 @@ struct qmi_info {
 	bool ps_enabled;
 	bool dl_msg_active;
 	bool ps_ignore_grant;
+	/* Adaptive powersave: learned gap between traffic bursts */
+	unsigned long ps_last_act;
+	u32 ps_gap_ms;
+	bool ps_predicted_exit;
 };
 
 enum data_ep_type_enum_v01 {
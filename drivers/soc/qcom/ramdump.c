@@ -25,9 +25,12 @@
 #include <linux/wait.h>
 #include <linux/cdev.h>
 #include <linux/atomic.h>
+#include <linux/crypto.h>
+#include <linux/vmalloc.h>
 #include <soc/qcom/ramdump.h>
 #include <linux/dma-mapping.h>
 #include <linux/of.h>
+#include <uapi/linux/msm_ramdump.h>
 
 
 #define RAMDUMP_NUM_DEVICES	256
@@ -41,11 +44,29 @@ static bool ramdump_devnode_inited;
 #define RAMDUMP_WAIT_MSECS	120000
 #define MAX_STRTBL_SIZE 512
 #define MAX_NAME_LENGTH 16
+#define RAMDUMP_CHUNK_SIZE	SZ_64K
 
+/* Send the dumps that start from now on as lz4 chunks */
+static bool compress;
+module_param(compress, bool, 0644);
+
+/*
+ * @compress: the current dump goes out as chunks
+ * @raw_pos: offset in the dump of the next chunk
+ * @frame: the chunk being read, @frame_off of its @frame_len bytes are read
+ */
 struct consumer_entry {
 	bool data_ready;
 	struct ramdump_device *rd_dev;
 	struct list_head list;
+	bool compress;
+	struct crypto_comp *tfm;
+	loff_t raw_pos;
+	u8 *raw;
+	u8 *frame;
+	size_t frame_len;
+	size_t frame_off;
+	u64 sent;
 };
 
 struct ramdump_device {
@@ -90,6 +111,26 @@ static int ramdump_open(struct inode *inode, struct file *filep)
 	return 0;
 }
 
+static void ramdump_entry_start(struct consumer_entry *entry)
+{
+	entry->data_ready = true;
+	entry->compress = compress;
+	entry->raw_pos = 0;
+	entry->frame_len = entry->frame_off = 0;
+	entry->sent = 0;
+}
+
+static void ramdump_free_chunk(struct consumer_entry *entry)
+{
+	if (entry->tfm)
+		crypto_free_comp(entry->tfm);
+	entry->tfm = NULL;
+	vfree(entry->raw);
+	entry->raw = NULL;
+	vfree(entry->frame);
+	entry->frame = NULL;
+}
+
 static void reset_ramdump_entry(struct consumer_entry *entry)
 {
 	struct ramdump_device *rd_dev = entry->rd_dev;
@@ -118,6 +159,7 @@ static int ramdump_release(struct inode *inode, struct file *filep)
 	list_del(&entry->list);
 	mutex_unlock(&rd_dev->consumer_lock);
 	entry->rd_dev = NULL;
+	ramdump_free_chunk(entry);
 	kfree(entry);
 	return 0;
 }
@@ -156,16 +198,178 @@ static unsigned long offset_translate(loff_t user_offset,
 
 #define MAX_IOREMAP_SIZE SZ_1M
 
+/* Copies @size bytes of the dump at @addr, or at @vaddr if mapped, to @dst */
+static int ramdump_copy_seg(struct ramdump_device *rd_dev, unsigned long addr,
+			    void *vaddr, unsigned char *dst, size_t size)
+{
+	void *device_mem, *origdevice_mem;
+	unsigned long bytes_before, bytes_after;
+	size_t alignsize = size;
+
+	rd_dev->attrs = 0;
+	rd_dev->attrs |= DMA_ATTR_SKIP_ZEROING;
+	device_mem = vaddr ?: dma_remap(rd_dev->dev->parent, NULL, addr,
+						size, rd_dev->attrs);
+	origdevice_mem = device_mem;
+
+	if (device_mem == NULL) {
+		pr_err("Ramdump(%s): Unable to ioremap: addr %lx, size %zd\n",
+			rd_dev->name, addr, size);
+		return -ENOMEM;
+	}
+
+	if ((unsigned long)device_mem & 0x7) {
+		bytes_before = 8 - ((unsigned long)device_mem & 0x7);
+		memcpy_fromio(dst, device_mem, bytes_before);
+		device_mem += bytes_before;
+		dst += bytes_before;
+		alignsize -= bytes_before;
+	}
+
+	if (alignsize & 0x7) {
+		bytes_after = alignsize & 0x7;
+		memcpy(dst, device_mem, alignsize - bytes_after);
+		device_mem += alignsize - bytes_after;
+		dst += (alignsize - bytes_after);
+		alignsize = bytes_after;
+		memcpy_fromio(dst, device_mem, alignsize);
+	} else
+		memcpy(dst, device_mem, alignsize);
+
+	if (!vaddr)
+		dma_unremap(rd_dev->dev->parent, origdevice_mem, size);
+
+	return 0;
+}
+
+static int ramdump_alloc_chunk(struct consumer_entry *entry)
+{
+	entry->raw = vmalloc(RAMDUMP_CHUNK_SIZE);
+	entry->frame = vmalloc(sizeof(struct ramdump_chunk_hdr) +
+			       RAMDUMP_CHUNK_SIZE);
+	if (!entry->raw || !entry->frame) {
+		ramdump_free_chunk(entry);
+		return -ENOMEM;
+	}
+
+	entry->tfm = crypto_alloc_comp("lz4", 0, 0);
+	if (IS_ERR(entry->tfm)) {
+		pr_warn_once("Ramdump: no lz4, chunks are sent raw\n");
+		entry->tfm = NULL;
+	}
+
+	return 0;
+}
+
+/* Returns 1 once the next chunk is in @entry->frame, 0 at the end */
+static int ramdump_fill_chunk(struct consumer_entry *entry)
+{
+	struct ramdump_device *rd_dev = entry->rd_dev;
+	struct ramdump_chunk_hdr *hdr;
+	unsigned long addr, data_left;
+	unsigned int dlen;
+	size_t len = 0, n;
+	void *vaddr;
+	loff_t pos;
+	int ret;
+
+	if (!entry->raw) {
+		ret = ramdump_alloc_chunk(entry);
+		if (ret)
+			return ret;
+	}
+
+	while (len < RAMDUMP_CHUNK_SIZE) {
+		pos = entry->raw_pos + len;
+		if (pos < rd_dev->elfcore_size) {
+			n = min_t(size_t, rd_dev->elfcore_size - pos,
+				  RAMDUMP_CHUNK_SIZE - len);
+			memcpy(entry->raw + len, rd_dev->elfcore_buf + pos, n);
+		} else {
+			addr = offset_translate(pos - rd_dev->elfcore_size,
+						rd_dev, &data_left, &vaddr);
+			if (!data_left)
+				break;
+			n = min_t(size_t, data_left, RAMDUMP_CHUNK_SIZE - len);
+			ret = ramdump_copy_seg(rd_dev, addr, vaddr,
+					       entry->raw + len, n);
+			if (ret)
+				return ret;
+		}
+		len += n;
+	}
+
+	if (!len)
+		return 0;
+
+	/* a chunk lz4 can't shrink goes out as it is */
+	hdr = (struct ramdump_chunk_hdr *)entry->frame;
+	hdr->flags = 0;
+	dlen = len - 1;
+	if (!entry->tfm || crypto_comp_compress(entry->tfm, entry->raw, len,
+						(u8 *)(hdr + 1), &dlen)) {
+		memcpy(hdr + 1, entry->raw, len);
+		dlen = len;
+		hdr->flags = RAMDUMP_CHUNK_RAW;
+	}
+	hdr->magic = RAMDUMP_CHUNK_MAGIC;
+	hdr->offset = entry->raw_pos;
+	hdr->raw_len = len;
+	hdr->len = dlen;
+
+	entry->raw_pos += len;
+	entry->frame_len = sizeof(*hdr) + dlen;
+	entry->frame_off = 0;
+	return 1;
+}
+
+static ssize_t ramdump_read_chunk(struct consumer_entry *entry,
+				  char __user *buf, size_t count)
+{
+	struct ramdump_device *rd_dev = entry->rd_dev;
+	size_t copy_size;
+	int ret;
+
+	if (entry->frame_off == entry->frame_len) {
+		ret = ramdump_fill_chunk(entry);
+		if (ret <= 0) {
+			if (ret) {
+				rd_dev->ramdump_status = -1;
+			} else {
+				pr_debug("Ramdump(%s): Ramdump complete. %lld bytes sent as %llu.",
+					rd_dev->name, entry->raw_pos,
+					entry->sent);
+				rd_dev->ramdump_status = 0;
+			}
+			reset_ramdump_entry(entry);
+			return ret;
+		}
+	}
+
+	copy_size = min(count, entry->frame_len - entry->frame_off);
+	if (copy_to_user(buf, entry->frame + entry->frame_off, copy_size)) {
+		pr_err("Ramdump(%s): Couldn't copy all data to user.",
+			rd_dev->name);
+		rd_dev->ramdump_status = -1;
+		reset_ramdump_entry(entry);
+		return -EFAULT;
+	}
+	entry->frame_off += copy_size;
+	entry->sent += copy_size;
+
+	return copy_size;
+}
+
 static ssize_t ramdump_read(struct file *filep, char __user *buf, size_t count,
 			loff_t *pos)
 {
 	struct consumer_entry *entry = filep->private_data;
 	struct ramdump_device *rd_dev = entry->rd_dev;
-	void *device_mem = NULL, *origdevice_mem = NULL, *vaddr = NULL;
-	unsigned long data_left = 0, bytes_before, bytes_after;
+	void *vaddr = NULL;
+	unsigned long data_left = 0;
 	unsigned long addr = 0;
-	size_t copy_size = 0, alignsize;
-	unsigned char *alignbuf = NULL, *finalbuf = NULL;
+	size_t copy_size = 0;
+	unsigned char *finalbuf = NULL;
 	int ret = 0;
 	loff_t orig_pos = *pos;
 
@@ -176,6 +380,9 @@ static ssize_t ramdump_read(struct file *filep, char __user *buf, size_t count,
 	if (ret)
 		return ret;
 
+	if (entry->compress)
+		return ramdump_read_chunk(entry, buf, count);
+
 	if (*pos < rd_dev->elfcore_size) {
 		copy_size = rd_dev->elfcore_size - *pos;
 		copy_size = min(copy_size, count);
@@ -206,48 +413,19 @@ static ssize_t ramdump_read(struct file *filep, char __user *buf, size_t count,
 	copy_size = min_t(size_t, count, (size_t)MAX_IOREMAP_SIZE);
 	copy_size = min_t(unsigned long, (unsigned long)copy_size, data_left);
 
-	rd_dev->attrs = 0;
-	rd_dev->attrs |= DMA_ATTR_SKIP_ZEROING;
-	device_mem = vaddr ?: dma_remap(rd_dev->dev->parent, NULL, addr,
-						copy_size, rd_dev->attrs);
-	origdevice_mem = device_mem;
-
-	if (device_mem == NULL) {
-		pr_err("Ramdump(%s): Unable to ioremap: addr %lx, size %zd\n",
-			rd_dev->name, addr, copy_size);
+	finalbuf = kzalloc(copy_size, GFP_KERNEL);
+	if (!finalbuf) {
 		rd_dev->ramdump_status = -1;
 		ret = -ENOMEM;
 		goto ramdump_done;
 	}
 
-	alignbuf = kzalloc(copy_size, GFP_KERNEL);
-	if (!alignbuf) {
+	ret = ramdump_copy_seg(rd_dev, addr, vaddr, finalbuf, copy_size);
+	if (ret) {
 		rd_dev->ramdump_status = -1;
-		ret = -ENOMEM;
 		goto ramdump_done;
 	}
 
-	finalbuf = alignbuf;
-	alignsize = copy_size;
-
-	if ((unsigned long)device_mem & 0x7) {
-		bytes_before = 8 - ((unsigned long)device_mem & 0x7);
-		memcpy_fromio(alignbuf, device_mem, bytes_before);
-		device_mem += bytes_before;
-		alignbuf += bytes_before;
-		alignsize -= bytes_before;
-	}
-
-	if (alignsize & 0x7) {
-		bytes_after = alignsize & 0x7;
-		memcpy(alignbuf, device_mem, alignsize - bytes_after);
-		device_mem += alignsize - bytes_after;
-		alignbuf += (alignsize - bytes_after);
-		alignsize = bytes_after;
-		memcpy_fromio(alignbuf, device_mem, alignsize);
-	} else
-		memcpy(alignbuf, device_mem, alignsize);
-
 	if (copy_to_user(buf, finalbuf, copy_size)) {
 		pr_err("Ramdump(%s): Couldn't copy all data to user.",
 			rd_dev->name);
@@ -257,8 +435,6 @@ static ssize_t ramdump_read(struct file *filep, char __user *buf, size_t count,
 	}
 
 	kfree(finalbuf);
-	if (!vaddr && origdevice_mem)
-		dma_unremap(rd_dev->dev->parent, origdevice_mem, copy_size);
 
 	*pos += copy_size;
 
@@ -268,9 +444,6 @@ static ssize_t ramdump_read(struct file *filep, char __user *buf, size_t count,
 	return *pos - orig_pos;
 
 ramdump_done:
-	if (!vaddr && origdevice_mem)
-		dma_unremap(rd_dev->dev->parent, origdevice_mem, copy_size);
-
 	kfree(finalbuf);
 	*pos = 0;
 	reset_ramdump_entry(entry);
@@ -485,7 +658,7 @@ static int _do_ramdump(void *handle, struct ramdump_segment *segments,
 	}
 
 	list_for_each_entry(entry, &rd_dev->consumer_list, list)
-		entry->data_ready = true;
+		ramdump_entry_start(entry);
 	rd_dev->ramdump_status = -1;
 
 	reinit_completion(&rd_dev->ramdump_complete);
@@ -614,7 +787,7 @@ static int _do_minidump(void *handle, struct ramdump_segment *segments,
 	ehdr->e_shnum = nsegments + 2;
 
 	list_for_each_entry(entry, &rd_dev->consumer_list, list)
-		entry->data_ready = true;
+		ramdump_entry_start(entry);
 	rd_dev->ramdump_status = -1;
 
 	reinit_completion(&rd_dev->ramdump_complete);
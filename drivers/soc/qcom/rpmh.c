@@ -12,6 +12,7 @@
  */
 
 #include <linux/atomic.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/interrupt.h>
 #include <linux/kernel.h>
@@ -20,6 +21,8 @@
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/platform_device.h>
+#include <linux/sched/clock.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/types.h>
@@ -33,6 +36,11 @@
 #define RPMH_MAX_FAST_RES		32
 #define RPMH_MAX_REQ_IN_BATCH		10
 #define RPMH_TIMEOUT			msecs_to_jiffies(20000)
+/*
+ * An active request repeating the values last sent for all of its
+ * addresses within this window is completed without being sent.
+ */
+#define RPMH_ACTIVE_DEDUP_NS		(10 * NSEC_PER_MSEC)
 
 #define DEFINE_RPMH_MSG_ONSTACK(rc, s, q, c, name)	\
 	struct rpmh_msg name = {			\
@@ -56,6 +64,13 @@ struct rpmh_req {
 	u32 addr;
 	u32 sleep_val;
 	u32 wake_val;
+	/* Last active value sent, valid until the next system sleep */
+	u32 active_val;
+	u64 active_ts;
+	bool active_valid;
+	/* Changed since the last flush, and present in the sleep/wake TCS */
+	bool dirty;
+	bool in_tcs;
 	struct list_head list;
 };
 
@@ -76,9 +91,18 @@ struct rpmh_mbox {
 	struct rpmh_msg *msg_pool;
 	DECLARE_BITMAP(fast_req, RPMH_MAX_FAST_RES);
 	bool dirty;
+	/* The TCS has to be invalidated and rewritten from scratch */
+	bool flush_all;
 	bool in_solver_mode;
 	/* Cache sleep and wake requests sent as passthru */
 	struct rpmh_msg *passthru_cache[2 * RPMH_MAX_REQ_IN_BATCH];
+	/* Statistics */
+	u64 active_sent;
+	u64 active_skipped;
+	u64 flush_full;
+	u64 flush_partial;
+	u64 flush_sent;
+	u64 flush_skipped;
 };
 
 struct rpmh_client {
@@ -257,20 +281,24 @@ static struct rpmh_req *cache_rpm_request(struct rpmh_client *rc,
 	switch (state) {
 	case RPMH_ACTIVE_ONLY_STATE:
 	case RPMH_AWAKE_STATE:
-		if (req->sleep_val != UINT_MAX) {
+		if (req->sleep_val != UINT_MAX &&
+		    req->wake_val != cmd->data) {
 			req->wake_val = cmd->data;
+			req->dirty = true;
 			rpm->dirty = true;
 		}
 		break;
 	case RPMH_WAKE_ONLY_STATE:
 		if (req->wake_val != cmd->data) {
 			req->wake_val = cmd->data;
+			req->dirty = true;
 			rpm->dirty = true;
 		}
 		break;
 	case RPMH_SLEEP_STATE:
 		if (req->sleep_val != cmd->data) {
 			req->sleep_val = cmd->data;
+			req->dirty = true;
 			rpm->dirty = true;
 		}
 		break;
@@ -300,6 +328,71 @@ static int check_ctrlr_state(struct rpmh_client *rc, enum rpmh_state state)
 	return ret;
 }
 
+/*
+ * Whether every command of an active request repeats the value last sent
+ * for its address, recently enough that nothing else can have changed
+ * it. Reads and requests for uncached addresses are always sent.
+ */
+static bool rpmh_active_is_dup(struct rpmh_client *rc,
+			struct tcs_mbox_msg *msg)
+{
+	struct rpmh_mbox *rpm = rc->rpmh;
+	struct rpmh_req *req;
+	unsigned long flags;
+	u64 now = sched_clock();
+	bool dup = !msg->is_read;
+	int i;
+
+	spin_lock_irqsave(&rpm->lock, flags);
+	for (i = 0; dup && i < msg->num_payload; i++) {
+		req = __find_req(rc, msg->payload[i].addr);
+		dup = req && req->active_valid &&
+			req->active_val == msg->payload[i].data &&
+			now - req->active_ts < RPMH_ACTIVE_DEDUP_NS;
+	}
+	if (dup)
+		rpm->active_skipped++;
+	spin_unlock_irqrestore(&rpm->lock, flags);
+
+	return dup;
+}
+
+/*
+ * Record the values of an active request about to be sent. This has to
+ * come before the send, the message may be completed and reused by the
+ * time mbox_send_message() returns. A failed send is undone with
+ * @sent false.
+ */
+static void rpmh_active_update(struct rpmh_client *rc,
+			struct tcs_mbox_msg *msg, bool sent)
+{
+	struct rpmh_mbox *rpm = rc->rpmh;
+	struct rpmh_req *req;
+	unsigned long flags;
+	u64 now = sched_clock();
+	int i;
+
+	spin_lock_irqsave(&rpm->lock, flags);
+	if (sent)
+		rpm->active_sent++;
+	else
+		rpm->active_sent--;
+	for (i = 0; !msg->is_read && i < msg->num_payload; i++) {
+		req = __find_req(rc, msg->payload[i].addr);
+		if (!req)
+			continue;
+		req->active_val = msg->payload[i].data;
+		req->active_ts = now;
+		req->active_valid = sent;
+	}
+	/* The controller reuses and invalidates the wake TCS for these */
+	if (msg->state == RPMH_AWAKE_STATE) {
+		rpm->flush_all = true;
+		rpm->dirty = true;
+	}
+	spin_unlock_irqrestore(&rpm->lock, flags);
+}
+
 /**
  * __rpmh_write: Cache and send the RPMH request
  *
@@ -329,9 +422,16 @@ int __rpmh_write(struct rpmh_client *rc, enum rpmh_state state,
 
 	/* Send to mailbox only if active or awake */
 	if (state == RPMH_ACTIVE_ONLY_STATE || state == RPMH_AWAKE_STATE) {
+		if (rpmh_active_is_dup(rc, &rpm_msg->msg)) {
+			rpmh_tx_done(&rc->client, &rpm_msg->msg, 0);
+			return 0;
+		}
+		rpmh_active_update(rc, &rpm_msg->msg, true);
 		ret = mbox_send_message(rc->chan, &rpm_msg->msg);
 		if (ret > 0)
 			ret = 0;
+		if (ret)
+			rpmh_active_update(rc, &rpm_msg->msg, false);
 	} else {
 		/* Clean up our call by spoofing tx_done */
 		rpmh_tx_done(&rc->client, &rpm_msg->msg, ret);
@@ -552,6 +652,9 @@ static int cache_passthru(struct rpmh_client *rc, struct rpmh_msg **rpm_msg,
 
 	for (i = 0; i < count; i++)
 		rpm->passthru_cache[index + i] = rpm_msg[i];
+	/* Passthru sets are only written by a full flush */
+	rpm->flush_all = true;
+	rpm->dirty = true;
 fail:
 	spin_unlock_irqrestore(&rpm->lock, flags);
 
@@ -681,9 +784,15 @@ int rpmh_write_batch(struct rpmh_client *rc, enum rpmh_state state,
 		for (i = 0; i < count; i++) {
 			rpm_msg[i]->completion = &compl;
 			rpm_msg[i]->wait_count = &wait_count;
+			if (rpmh_active_is_dup(rc, &rpm_msg[i]->msg)) {
+				rpmh_tx_done(&rc->client, &rpm_msg[i]->msg, 0);
+				continue;
+			}
 			/* Bypass caching and write to mailbox directly */
+			rpmh_active_update(rc, &rpm_msg[i]->msg, true);
 			ret = mbox_send_message(rc->chan, &rpm_msg[i]->msg);
 			if (ret < 0) {
+				rpmh_active_update(rc, &rpm_msg[i]->msg, false);
 				pr_err("Error(%d) sending RPM message addr=0x%x\n",
 					ret, rpm_msg[i]->msg.payload[0].addr);
 				break;
@@ -802,6 +911,7 @@ int rpmh_invalidate(struct rpmh_client *rc)
 
 	spin_lock_irqsave(&rpm->lock, flags);
 	rpm->dirty = true;
+	rpm->flush_all = true;
 	spin_unlock_irqrestore(&rpm->lock, flags);
 
 	return mbox_send_controller_data(rc->chan, &rpm_msg.msg);
@@ -903,6 +1013,13 @@ int send_single(struct rpmh_client *rc, enum rpmh_state state, u32 addr,
  * This function is generally called from the sleep code from the last CPU
  * that is powering down the entire system.
  *
+ * The controller overwrites a sleep/wake command for an address already
+ * in the TCS in place, so as long as nothing has to be removed from the
+ * TCS only the requests changed since the last flush are written. The
+ * TCS is invalidated and rewritten after rpmh_invalidate(), new passthru
+ * sets, awake requests (which reuse the wake TCS), or a request that is
+ * in the TCS but no longer valid.
+ *
  * Returns -EBUSY if the controller is busy, probably waiting on a response
  * to a RPMH request sent earlier.
  */
@@ -913,6 +1030,7 @@ int rpmh_flush(struct rpmh_client *rc)
 	struct rpmh_mbox *rpm = rc->rpmh;
 	int ret;
 	unsigned long flags;
+	bool full;
 
 	if (IS_ERR_OR_NULL(rc))
 		return -EINVAL;
@@ -923,34 +1041,56 @@ int rpmh_flush(struct rpmh_client *rc)
 	if (!mbox_controller_is_idle(rc->chan))
 		return -EBUSY;
 
+	/*
+	 * Nobody else should be calling this function other than sleep,
+	 * hence we can run without locks. Across system sleep the active
+	 * values last sent may not hold.
+	 */
+	list_for_each_entry(p, &rc->rpmh->resources, list)
+		p->active_valid = false;
+
 	spin_lock_irqsave(&rpm->lock, flags);
 	if (!rpm->dirty) {
 		pr_debug("Skipping flush, TCS has latest data.\n");
 		spin_unlock_irqrestore(&rpm->lock, flags);
 		return 0;
 	}
+	full = rpm->flush_all;
 	spin_unlock_irqrestore(&rpm->lock, flags);
 
-	/* Invalidate sleep and wake TCS */
-	rpm_msg.msg.invalidate = true;
-	rpm_msg.msg.is_complete = false;
-	ret = mbox_send_controller_data(rc->chan, &rpm_msg.msg);
-	if (ret)
-		return ret;
+	/* A request can only be taken out of the TCS by rewriting it all */
+	list_for_each_entry(p, &rc->rpmh->resources, list) {
+		if (p->dirty && p->in_tcs && !is_req_valid(p))
+			full = true;
+	}
 
-	/* First flush the cached passthru's */
-	ret = flush_passthru(rc);
-	if (ret)
-		return ret;
+	if (full) {
+		/* Invalidate sleep and wake TCS */
+		rpm_msg.msg.invalidate = true;
+		rpm_msg.msg.is_complete = false;
+		ret = mbox_send_controller_data(rc->chan, &rpm_msg.msg);
+		if (ret)
+			return ret;
+
+		list_for_each_entry(p, &rc->rpmh->resources, list)
+			p->in_tcs = false;
+
+		/* First flush the cached passthru's */
+		ret = flush_passthru(rc);
+		if (ret)
+			return ret;
+	}
 
-	/*
-	 * Nobody else should be calling this function other than sleep,
-	 * hence we can run without locks.
-	 */
 	list_for_each_entry(p, &rc->rpmh->resources, list) {
+		if (!full && !p->dirty) {
+			if (p->in_tcs)
+				rpm->flush_skipped++;
+			continue;
+		}
 		if (!is_req_valid(p)) {
 			pr_debug("%s: skipping RPMH req: a:0x%x s:0x%x w:0x%x",
 				__func__, p->addr, p->sleep_val, p->wake_val);
+			p->dirty = false;
 			continue;
 		}
 		ret = send_single(rc, RPMH_SLEEP_STATE, p->addr, p->sleep_val);
@@ -960,10 +1100,18 @@ int rpmh_flush(struct rpmh_client *rc)
 						p->wake_val);
 		if (ret)
 			return ret;
+		p->in_tcs = true;
+		p->dirty = false;
+		rpm->flush_sent++;
 	}
 
 	spin_lock_irqsave(&rpm->lock, flags);
 	rpm->dirty = false;
+	rpm->flush_all = false;
+	if (full)
+		rpm->flush_full++;
+	else
+		rpm->flush_partial++;
 	spin_unlock_irqrestore(&rpm->lock, flags);
 
 	return 0;
@@ -1139,3 +1287,50 @@ void rpmh_release(struct rpmh_client *rc)
 	kfree(rc);
 }
 EXPORT_SYMBOL(rpmh_release);
+
+#ifdef CONFIG_DEBUG_FS
+static int rpmh_stats_show(struct seq_file *s, void *unused)
+{
+	struct rpmh_mbox *rpm;
+	unsigned long flags;
+	int i;
+
+	for (i = 0; i < RPMH_MAX_MBOXES; i++) {
+		rpm = &mbox_ctrlr[i];
+		if (!rpm->mbox_dn)
+			continue;
+
+		spin_lock_irqsave(&rpm->lock, flags);
+		seq_printf(s, "%s:\n", rpm->mbox_dn->full_name);
+		seq_printf(s, "  active sent %llu skipped %llu\n",
+			   rpm->active_sent, rpm->active_skipped);
+		seq_printf(s, "  flush full %llu partial %llu\n",
+			   rpm->flush_full, rpm->flush_partial);
+		seq_printf(s, "  flush requests sent %llu skipped %llu\n",
+			   rpm->flush_sent, rpm->flush_skipped);
+		spin_unlock_irqrestore(&rpm->lock, flags);
+	}
+
+	return 0;
+}
+
+static int rpmh_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, rpmh_stats_show, inode->i_private);
+}
+
+static const struct file_operations rpmh_stats_fops = {
+	.open = rpmh_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init rpmh_debugfs_init(void)
+{
+	debugfs_create_file("rpmh_stats", 0444, NULL, NULL,
+			    &rpmh_stats_fops);
+	return 0;
+}
+late_initcall(rpmh_debugfs_init);
+#endif
@@ -21,6 +21,10 @@
 #include <linux/slab.h>
 #include <linux/dma-mapping.h>
 #include <linux/cma.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/sched/clock.h>
+#include <linux/workqueue.h>
 #include <soc/qcom/scm.h>
 #include <soc/qcom/secure_buffer.h>
 
@@ -59,6 +63,32 @@ struct dest_vm_and_perm_info {
 #define BATCH_MAX_SIZE SZ_2M
 #define BATCH_MAX_SECTIONS 32
 
+/* Assign SCM call latency by batch size, bucket i for up to 4K << i */
+#define BATCH_STAT_BUCKETS 10
+
+struct batch_stat {
+	u64 count;
+	u64 total_ns;
+	u64 max_ns;
+};
+
+/* Protected by secure_buffer_mutex */
+static struct batch_stat batch_stats[BATCH_STAT_BUCKETS];
+
+static void batch_stat_record(u64 size, u64 ns)
+{
+	struct batch_stat *st;
+	unsigned int i = 0;
+
+	while (i < BATCH_STAT_BUCKETS - 1 && size > (SZ_4K << i))
+		i++;
+
+	st = &batch_stats[i];
+	st->count++;
+	st->total_ns += ns;
+	st->max_ns = max(st->max_ns, ns);
+}
+
 static int secure_buffer_change_chunk(u32 chunks,
 				u32 nchunks,
 				u32 chunk_size,
@@ -214,7 +244,8 @@ populate_dest_info(int *dest_vmids, int nelements, int *dest_perms,
 /* Must hold secure_buffer_mutex while allocated buffer is in use */
 static unsigned int get_batches_from_sgl(struct mem_prot_info *sg_table_copy,
 					 struct scatterlist *sgl,
-					 struct scatterlist **next_sgl)
+					 struct scatterlist **next_sgl,
+					 u64 *size)
 {
 	u64 batch_size = 0;
 	unsigned int i = 0;
@@ -231,6 +262,7 @@ static unsigned int get_batches_from_sgl(struct mem_prot_info *sg_table_copy,
 		 curr_sgl->length + batch_size < BATCH_MAX_SIZE);
 
 	*next_sgl = curr_sgl;
+	*size = batch_size;
 	return i;
 }
 
@@ -241,6 +273,7 @@ static int batched_hyp_assign(struct sg_table *table, struct scm_desc *desc)
 	unsigned int batches_processed;
 	struct scatterlist *curr_sgl = table->sgl;
 	struct scatterlist *next_sgl;
+	u64 batch_size, start_ns;
 	int ret = 0;
 	struct mem_prot_info *sg_table_copy = kcalloc(BATCH_MAX_SECTIONS,
 						      sizeof(*sg_table_copy),
@@ -251,7 +284,8 @@ static int batched_hyp_assign(struct sg_table *table, struct scm_desc *desc)
 
 	while (batch_start < table->nents) {
 		batches_processed = get_batches_from_sgl(sg_table_copy,
-							 curr_sgl, &next_sgl);
+							 curr_sgl, &next_sgl,
+							 &batch_size);
 		curr_sgl = next_sgl;
 		entries_size = batches_processed * sizeof(*sg_table_copy);
 		dmac_flush_range(sg_table_copy,
@@ -259,8 +293,10 @@ static int batched_hyp_assign(struct sg_table *table, struct scm_desc *desc)
 		desc->args[0] = virt_to_phys(sg_table_copy);
 		desc->args[1] = entries_size;
 
+		start_ns = sched_clock();
 		ret = scm_call2(SCM_SIP_FNID(SCM_SVC_MP,
 				MEM_PROT_ASSIGN_ID), desc);
+		batch_stat_record(batch_size, sched_clock() - start_ns);
 		if (ret) {
 			pr_info("%s: Failed to assign memory protection, ret = %d\n",
 				__func__, ret);
@@ -372,6 +408,79 @@ int try_hyp_assign_table(struct sg_table *table,
 				  dest_vmids, dest_perms, dest_nelems, true);
 }
 
+static void hyp_assign_async_work(struct work_struct *work)
+{
+	struct hyp_assign_async *req = container_of(work,
+					struct hyp_assign_async, work);
+
+	req->ret = __hyp_assign_table(req->table, req->source_vm_list,
+				      req->source_nelems, req->dest_vmids,
+				      req->dest_perms, req->dest_nelems,
+				      false);
+	complete(&req->done);
+}
+
+/**
+ * hyp_assign_table_async() - queue hyp_assign_table() to a worker
+ * @req: caller owned request, valid until hyp_assign_wait() returns
+ *
+ * The other arguments are those of hyp_assign_table(). The VM lists are
+ * copied, @table must stay untouched until hyp_assign_wait(), which has
+ * to be called whenever this returns 0.
+ */
+int hyp_assign_table_async(struct hyp_assign_async *req,
+			struct sg_table *table,
+			u32 *source_vm_list, int source_nelems,
+			int *dest_vmids, int *dest_perms,
+			int dest_nelems)
+{
+	if (!req || !table || !source_vm_list || !source_nelems ||
+	    !dest_vmids || !dest_perms || !dest_nelems)
+		return -EINVAL;
+
+	req->source_vm_list = kmemdup(source_vm_list,
+			sizeof(*source_vm_list) * source_nelems, GFP_KERNEL);
+	req->dest_vmids = kmemdup(dest_vmids,
+			sizeof(*dest_vmids) * dest_nelems, GFP_KERNEL);
+	req->dest_perms = kmemdup(dest_perms,
+			sizeof(*dest_perms) * dest_nelems, GFP_KERNEL);
+	if (!req->source_vm_list || !req->dest_vmids || !req->dest_perms) {
+		kfree(req->source_vm_list);
+		kfree(req->dest_vmids);
+		kfree(req->dest_perms);
+		return -ENOMEM;
+	}
+
+	req->table = table;
+	req->source_nelems = source_nelems;
+	req->dest_nelems = dest_nelems;
+	req->ret = 0;
+	init_completion(&req->done);
+	INIT_WORK(&req->work, hyp_assign_async_work);
+	queue_work(system_unbound_wq, &req->work);
+
+	return 0;
+}
+EXPORT_SYMBOL(hyp_assign_table_async);
+
+/**
+ * hyp_assign_wait() - wait for a request of hyp_assign_table_async()
+ * @req: the request
+ *
+ * Returns what hyp_assign_table() would have returned.
+ */
+int hyp_assign_wait(struct hyp_assign_async *req)
+{
+	wait_for_completion(&req->done);
+
+	kfree(req->source_vm_list);
+	kfree(req->dest_vmids);
+	kfree(req->dest_perms);
+
+	return req->ret;
+}
+EXPORT_SYMBOL(hyp_assign_wait);
+
 int hyp_assign_phys(phys_addr_t addr, u64 size, u32 *source_vm_list,
 			int source_nelems, int *dest_vmids,
 			int *dest_perms, int dest_nelems)
@@ -484,3 +593,46 @@ bool msm_secure_v2_is_supported(void)
 	return (scm_get_feat_version(FEATURE_ID_CP) >=
 			MAKE_CP_VERSION(1, 1, 0));
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int batch_stats_show(struct seq_file *s, void *unused)
+{
+	int i;
+
+	seq_puts(s, "batch_size(<=) count avg_us max_us\n");
+
+	mutex_lock(&secure_buffer_mutex);
+	for (i = 0; i < BATCH_STAT_BUCKETS; i++) {
+		struct batch_stat *st = &batch_stats[i];
+
+		if (!st->count)
+			continue;
+		seq_printf(s, "%uK %llu %llu %llu\n", 4 << i, st->count,
+			   div64_u64(st->total_ns, st->count * NSEC_PER_USEC),
+			   div64_u64(st->max_ns, NSEC_PER_USEC));
+	}
+	mutex_unlock(&secure_buffer_mutex);
+
+	return 0;
+}
+
+static int batch_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, batch_stats_show, NULL);
+}
+
+static const struct file_operations batch_stats_fops = {
+	.open = batch_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init secure_buffer_debugfs_init(void)
+{
+	debugfs_create_file("hyp_assign_stats", 0400, NULL, NULL,
+			    &batch_stats_fops);
+	return 0;
+}
+late_initcall(secure_buffer_debugfs_init);
+#endif
@@ -12,7 +12,9 @@
  * GNU General Public License for more details.
  */
 
+#include <linux/debugfs.h>
 #include <linux/interrupt.h>
+#include <linux/irq_work.h>
 #include <linux/list.h>
 #include <linux/io.h>
 #include <linux/of.h>
@@ -23,6 +25,7 @@
 #include <linux/module.h>
 #include <linux/platform_device.h>
 #include <linux/regmap.h>
+#include <linux/seq_file.h>
 #include <linux/soc/qcom/smem.h>
 #include <linux/soc/qcom/smem_state.h>
 #include <linux/spinlock.h>
@@ -101,6 +104,11 @@ struct smp2p_smem_item {
  * @irq_falling:bitmap to mark irq bits for falling detection
  * @state:	smem state handle
  * @lock:	spinlock to protect read-modify-write of the value
+ * @changes:	inbound: interrupts that found the value changed
+ *		outbound: updates that changed the value
+ * @edges:	inbound: edges handed to the irq domain
+ * @skipped:	inbound: interrupts that did not read the value, as no bit
+ *		of it is watched
  */
 struct smp2p_entry {
 	struct list_head node;
@@ -119,6 +127,10 @@ struct smp2p_entry {
 	struct qcom_smem_state *state;
 
 	spinlock_t lock;
+
+	u64 changes;
+	u64 edges;
+	u64 skipped;
 };
 
 #define SMP2P_INBOUND	0
@@ -139,6 +151,11 @@ struct smp2p_entry {
  * @mbox_chan:	apcs ipc mailbox channel handle
  * @inbound:	list of inbound entries
  * @outbound:	list of outbound entries
+ * @kick_work:	sends the kick of coalesced outbound updates
+ * @kick_pending: a kick is queued on @kick_work
+ * @kicks:	outbound ipc interrupts sent
+ * @kicks_coalesced: outbound updates that rode on an already queued kick
+ * @debugfs:	per entry statistics
  */
 struct qcom_smp2p {
 	struct device *dev;
@@ -168,8 +185,26 @@ struct qcom_smp2p {
 
 	struct list_head inbound;
 	struct list_head outbound;
+
+	struct irq_work kick_work;
+	atomic_t kick_pending;
+	u64 kicks;
+	u64 kicks_coalesced;
+
+	struct dentry *debugfs;
 };
 
+/*
+ * Outbound updates queue the kick rather than sending it, so that all the
+ * updates done from one atomic context reach the remote side with a single
+ * interrupt.
+ */
+static bool coalesce_kicks = true;
+module_param(coalesce_kicks, bool, 0644);
+MODULE_PARM_DESC(coalesce_kicks, "Merge outbound kicks of back to back updates");
+
+static struct dentry *smp2p_debugfs;
+
 static void *ilc;
 #define SMP2P_LOG_PAGE_CNT 2
 #define SMP2P_INFO(x, ...)	\
@@ -189,6 +224,32 @@ static void qcom_smp2p_kick(struct qcom_smp2p *smp2p)
 	} else {
 		regmap_write(smp2p->ipc_regmap, smp2p->ipc_offset, BIT(smp2p->ipc_bit));
 	}
+	smp2p->kicks++;
+}
+
+static void qcom_smp2p_kick_work(struct irq_work *work)
+{
+	struct qcom_smp2p *smp2p = container_of(work, struct qcom_smp2p,
+						kick_work);
+
+	/* Updates from here on need a kick of their own */
+	atomic_set(&smp2p->kick_pending, 0);
+	qcom_smp2p_kick(smp2p);
+}
+
+static void qcom_smp2p_queue_kick(struct qcom_smp2p *smp2p)
+{
+	if (!coalesce_kicks) {
+		qcom_smp2p_kick(smp2p);
+		return;
+	}
+
+	if (atomic_xchg(&smp2p->kick_pending, 1)) {
+		smp2p->kicks_coalesced++;
+		return;
+	}
+
+	irq_work_queue(&smp2p->kick_work);
 }
 
 static bool qcom_smp2p_check_ssr(struct qcom_smp2p *smp2p)
@@ -246,7 +307,7 @@ static void qcom_smp2p_notify_in(struct qcom_smp2p *smp2p)
 {
 	struct smp2p_smem_item *in = smp2p->in;
 	struct smp2p_entry *entry;
-	unsigned long status;
+	unsigned long status, watched, fire;
 	int irq_pin;
 	char buf[SMP2P_MAX_ENTRY_NAME];
 	u32 val;
@@ -270,6 +331,17 @@ static void qcom_smp2p_notify_in(struct qcom_smp2p *smp2p)
 		if (!entry->value)
 			continue;
 
+		/*
+		 * Nobody listens to any bit of the entry, no edge could fire.
+		 * smp2p_set_irq_type() catches last_value up when that changes.
+		 */
+		watched = *entry->irq_rising | *entry->irq_falling |
+			  *entry->irq_pending;
+		if (!watched) {
+			entry->skipped++;
+			continue;
+		}
+
 		val = readl(entry->value);
 
 		status = val ^ entry->last_value;
@@ -280,20 +352,23 @@ static void qcom_smp2p_notify_in(struct qcom_smp2p *smp2p)
 		if (!status)
 			continue;
 
+		entry->changes++;
 		SMP2P_INFO("%d: %s: status:%0lx val:%0x\n",
 			   smp2p->remote_pid, entry->name, status, val);
 
-		for_each_set_bit(i, &status, 32) {
-			if ((val & BIT(i) && test_bit(i, entry->irq_rising)) ||
-			    (!(val & BIT(i)) && test_bit(i, entry->irq_falling))) {
-				irq_pin = irq_find_mapping(entry->domain, i);
-				handle_nested_irq(irq_pin);
+		/* Only the bits with an edge of the type they asked for */
+		fire = status & ((val & *entry->irq_rising) |
+				 (~val & *entry->irq_falling));
 
-				if (test_bit(i, entry->irq_enabled))
-					clear_bit(i, entry->irq_pending);
-				else
-					set_bit(i, entry->irq_pending);
-			}
+		for_each_set_bit(i, &fire, 32) {
+			irq_pin = irq_find_mapping(entry->domain, i);
+			handle_nested_irq(irq_pin);
+			entry->edges++;
+
+			if (test_bit(i, entry->irq_enabled))
+				clear_bit(i, entry->irq_pending);
+			else
+				set_bit(i, entry->irq_pending);
 		}
 	}
 }
@@ -378,6 +453,10 @@ static int smp2p_set_irq_type(struct irq_data *irqd, unsigned int type)
 	if (!(type & IRQ_TYPE_EDGE_BOTH))
 		return -EINVAL;
 
+	/* The value was not followed while no bit was watched */
+	if (entry->value && !(*entry->irq_rising | *entry->irq_falling))
+		entry->last_value = readl(entry->value);
+
 	if (type & IRQ_TYPE_EDGE_RISING)
 		set_bit(irq, entry->irq_rising);
 	else
@@ -444,10 +523,12 @@ static int smp2p_update_bits(void *data, u32 mask, u32 value)
 	val &= ~mask;
 	val |= value;
 	writel(val, entry->value);
+	if (val != orig)
+		entry->changes++;
 	spin_unlock_irqrestore(&entry->lock, flags);
 
 	if (val != orig)
-		qcom_smp2p_kick(entry->smp2p);
+		qcom_smp2p_queue_kick(entry->smp2p);
 
 	return 0;
 }
@@ -524,6 +605,52 @@ static int qcom_smp2p_alloc_outbound_item(struct qcom_smp2p *smp2p)
 	return 0;
 }
 
+static int smp2p_stats_show(struct seq_file *s, void *unused)
+{
+	struct qcom_smp2p *smp2p = s->private;
+	struct smp2p_entry *entry;
+
+	seq_printf(s, "kicks: %llu coalesced: %llu\n", smp2p->kicks,
+		   smp2p->kicks_coalesced);
+	seq_printf(s, "%-4s%-16s %-10s %12s %12s %12s\n", "dir", "entry",
+		   "value", "changes", "edges", "skipped");
+
+	list_for_each_entry(entry, &smp2p->inbound, node)
+		seq_printf(s, "in  %-16s 0x%08x %12llu %12llu %12llu\n",
+			   entry->name, entry->last_value, entry->changes,
+			   entry->edges, entry->skipped);
+
+	list_for_each_entry(entry, &smp2p->outbound, node)
+		seq_printf(s, "out %-16s 0x%08x %12llu\n", entry->name,
+			   readl(entry->value), entry->changes);
+
+	return 0;
+}
+
+static int smp2p_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, smp2p_stats_show, inode->i_private);
+}
+
+static const struct file_operations smp2p_stats_fops = {
+	.open = smp2p_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void smp2p_debugfs_init(struct qcom_smp2p *smp2p)
+{
+	if (!smp2p_debugfs)
+		smp2p_debugfs = debugfs_create_dir("smp2p", NULL);
+	if (IS_ERR_OR_NULL(smp2p_debugfs))
+		return;
+
+	smp2p->debugfs = debugfs_create_file(dev_name(smp2p->dev), 0400,
+					     smp2p_debugfs, smp2p,
+					     &smp2p_stats_fops);
+}
+
 static int smp2p_parse_ipc(struct qcom_smp2p *smp2p)
 {
 	struct device_node *syscon;
@@ -620,6 +747,7 @@ static int qcom_smp2p_probe(struct platform_device *pdev)
 	smp2p->dev = &pdev->dev;
 	INIT_LIST_HEAD(&smp2p->inbound);
 	INIT_LIST_HEAD(&smp2p->outbound);
+	init_irq_work(&smp2p->kick_work, qcom_smp2p_kick_work);
 
 	platform_set_drvdata(pdev, smp2p);
 
@@ -683,6 +811,7 @@ static int qcom_smp2p_probe(struct platform_device *pdev)
 		goto unwind_interfaces;
 	}
 	enable_irq_wake(smp2p->irq);
+	smp2p_debugfs_init(smp2p);
 
 	return 0;
 
@@ -706,6 +835,9 @@ static int qcom_smp2p_remove(struct platform_device *pdev)
 	struct qcom_smp2p *smp2p = platform_get_drvdata(pdev);
 	struct smp2p_entry *entry;
 
+	debugfs_remove(smp2p->debugfs);
+	irq_work_sync(&smp2p->kick_work);
+
 	list_for_each_entry(entry, &smp2p->inbound, node)
 		irq_domain_remove(entry->domain);
 
@@ -774,6 +906,7 @@ static int qcom_smp2p_freeze(struct device *dev)
 	struct smp2p_entry *next_entry;
 
 	disable_irq_wake(smp2p->irq);
+	irq_work_sync(&smp2p->kick_work);
 	/* Walk through the out bound list and release state and entry */
 	list_for_each_entry_safe(entry, next_entry, &smp2p->outbound, node) {
 		qcom_smem_state_unregister(entry->state);
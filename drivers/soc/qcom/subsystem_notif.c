@@ -43,11 +43,27 @@ struct subsys_early_notif_info {
 	void *data[NUM_EARLY_NOTIFS];
 };
 
+/**
+ * A notifier registered with subsys_notif_register_independent_notifier()
+ * does not depend on the other notifiers of the subsystem, so in fast SSR it
+ * runs on its own worker, next to the notifier chain and to the other
+ * independent notifiers.
+ */
+struct subsys_indep_notif {
+	struct notifier_block *nb;
+	struct work_struct work;
+	unsigned long notif_type;
+	void *data;
+	struct list_head list;
+};
+
 struct subsys_notif_info {
 	char name[50];
 	struct srcu_notifier_head subsys_notif_rcvr_list;
 	struct subsys_early_notif_info early_notif_info;
 	struct list_head list;
+	struct list_head indep_list;
+	struct mutex indep_lock;
 };
 
 static LIST_HEAD(subsystem_list);
@@ -99,6 +115,47 @@ void *subsys_notif_register_notifier(
 }
 EXPORT_SYMBOL(subsys_notif_register_notifier);
 
+static void subsys_indep_notif_work(struct work_struct *work)
+{
+	struct subsys_indep_notif *indep = container_of(work,
+					struct subsys_indep_notif, work);
+
+	indep->nb->notifier_call(indep->nb, indep->notif_type, indep->data);
+}
+
+/**
+ * subsys_notif_register_independent_notifier() - Register a notifier that
+ * does not rely on any other notifier of the subsystem having run, or not.
+ * Its return value is ignored. Unregister it with
+ * subsys_notif_unregister_notifier().
+ */
+void *subsys_notif_register_independent_notifier(
+			const char *subsys_name, struct notifier_block *nb)
+{
+	struct subsys_notif_info *subsys = _notif_find_subsys(subsys_name);
+	struct subsys_indep_notif *indep;
+
+	if (!subsys) {
+		subsys = subsys_notif_add_subsys(subsys_name);
+		if (IS_ERR_OR_NULL(subsys))
+			return ERR_PTR(-EINVAL);
+	}
+
+	indep = kzalloc(sizeof(*indep), GFP_KERNEL);
+	if (!indep)
+		return ERR_PTR(-ENOMEM);
+
+	indep->nb = nb;
+	INIT_WORK(&indep->work, subsys_indep_notif_work);
+
+	mutex_lock(&subsys->indep_lock);
+	list_add_tail(&indep->list, &subsys->indep_list);
+	mutex_unlock(&subsys->indep_lock);
+
+	return subsys;
+}
+EXPORT_SYMBOL(subsys_notif_register_independent_notifier);
+
 int subsys_notif_unregister_notifier(void *subsys_handle,
 				struct notifier_block *nb)
 {
@@ -106,9 +163,22 @@ int subsys_notif_unregister_notifier(void *subsys_handle,
 	struct subsys_notif_info *subsys =
 			(struct subsys_notif_info *)subsys_handle;
 
+	struct subsys_indep_notif *indep;
+
 	if (!subsys)
 		return -EINVAL;
 
+	mutex_lock(&subsys->indep_lock);
+	list_for_each_entry(indep, &subsys->indep_list, list) {
+		if (indep->nb == nb) {
+			list_del(&indep->list);
+			mutex_unlock(&subsys->indep_lock);
+			kfree(indep);
+			return 0;
+		}
+	}
+	mutex_unlock(&subsys->indep_lock);
+
 	ret = srcu_notifier_chain_unregister(
 		&subsys->subsys_notif_rcvr_list, nb);
 
@@ -246,6 +316,8 @@ void *subsys_notif_add_subsys(const char *subsys_name)
 						    subsys_early_notif_info));
 	spin_lock_init(&subsys->early_notif_info.cb_lock);
 	INIT_LIST_HEAD(&subsys->list);
+	INIT_LIST_HEAD(&subsys->indep_list);
+	mutex_init(&subsys->indep_lock);
 
 	mutex_lock(&notif_lock);
 	list_add_tail(&subsys->list, &subsystem_list);
@@ -262,11 +334,19 @@ void *subsys_notif_add_subsys(const char *subsys_name)
 }
 EXPORT_SYMBOL(subsys_notif_add_subsys);
 
-int subsys_notif_queue_notification(void *subsys_handle,
+/**
+ * subsys_notif_queue_notification_parallel() - Send a notification to all
+ * the notifiers of a subsystem. With @parallel set the independent notifiers
+ * run on workers while the notifier chain runs, otherwise all of them run
+ * here one after the other. Either way they are all done on return.
+ */
+int subsys_notif_queue_notification_parallel(void *subsys_handle,
 					enum subsys_notif_type notif_type,
-					void *data)
+					void *data, bool parallel)
 {
 	struct subsys_notif_info *subsys = subsys_handle;
+	struct subsys_indep_notif *indep;
+	int ret;
 
 	if (!subsys)
 		return -EINVAL;
@@ -274,8 +354,36 @@ int subsys_notif_queue_notification(void *subsys_handle,
 	if (notif_type < 0 || notif_type >= SUBSYS_NOTIF_TYPE_COUNT)
 		return -EINVAL;
 
-	return srcu_notifier_call_chain(&subsys->subsys_notif_rcvr_list,
+	mutex_lock(&subsys->indep_lock);
+	if (parallel) {
+		list_for_each_entry(indep, &subsys->indep_list, list) {
+			indep->notif_type = notif_type;
+			indep->data = data;
+			queue_work(system_unbound_wq, &indep->work);
+		}
+	}
+
+	ret = srcu_notifier_call_chain(&subsys->subsys_notif_rcvr_list,
 				       notif_type, data);
+
+	list_for_each_entry(indep, &subsys->indep_list, list) {
+		if (parallel)
+			flush_work(&indep->work);
+		else
+			indep->nb->notifier_call(indep->nb, notif_type, data);
+	}
+	mutex_unlock(&subsys->indep_lock);
+
+	return ret;
+}
+EXPORT_SYMBOL(subsys_notif_queue_notification_parallel);
+
+int subsys_notif_queue_notification(void *subsys_handle,
+					enum subsys_notif_type notif_type,
+					void *data)
+{
+	return subsys_notif_queue_notification_parallel(subsys_handle,
+						notif_type, data, false);
 }
 EXPORT_SYMBOL(subsys_notif_queue_notification);
 
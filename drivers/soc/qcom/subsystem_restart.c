@@ -51,6 +51,13 @@ module_param(disable_restart_work, uint, 0644);
 static int enable_debug;
 module_param(enable_debug, int, 0644);
 
+/*
+ * Run the notifiers registered as independent of the notification order
+ * in parallel to the rest of the chain during a restart.
+ */
+static bool fast_ssr;
+module_param(fast_ssr, bool, 0644);
+
 /* The maximum shutdown timeout is the product of MAX_LOOPS and DELAY_MS. */
 #define SHUTDOWN_ACK_MAX_LOOPS	100
 #define SHUTDOWN_ACK_DELAY_MS	100
@@ -158,6 +165,31 @@ struct subsys_soc_restart_order {
 	struct list_head list;
 };
 
+enum ssr_phase {
+	SSR_PHASE_BEFORE_SHUTDOWN,
+	SSR_PHASE_SHUTDOWN,
+	SSR_PHASE_AFTER_SHUTDOWN,
+	SSR_PHASE_RAMDUMP_NOTIF,
+	SSR_PHASE_RAMDUMP,
+	SSR_PHASE_FREE_MEMORY,
+	SSR_PHASE_BEFORE_POWERUP,
+	SSR_PHASE_POWERUP,
+	SSR_PHASE_AFTER_POWERUP,
+	SSR_PHASE_MAX,
+};
+
+static const char * const ssr_phase_names[] = {
+	[SSR_PHASE_BEFORE_SHUTDOWN]	= "before_shutdown",
+	[SSR_PHASE_SHUTDOWN]		= "shutdown",
+	[SSR_PHASE_AFTER_SHUTDOWN]	= "after_shutdown",
+	[SSR_PHASE_RAMDUMP_NOTIF]	= "ramdump_notif",
+	[SSR_PHASE_RAMDUMP]		= "ramdump",
+	[SSR_PHASE_FREE_MEMORY]		= "free_memory",
+	[SSR_PHASE_BEFORE_POWERUP]	= "before_powerup",
+	[SSR_PHASE_POWERUP]		= "powerup",
+	[SSR_PHASE_AFTER_POWERUP]	= "after_powerup",
+};
+
 struct restart_log {
 	struct timeval time;
 	struct subsys_device *dev;
@@ -184,6 +216,10 @@ struct restart_log {
  * @err_ready: completion variable to record error ready from subsystem
  * @crashed: indicates if subsystem has crashed
  * @notif_state: current state of subsystem in terms of subsys notifications
+ * @boot_work: context for the parallel boot of this device
+ * @boot_ref: the parallel boot holds a reference for the first client
+ * @phase_ms: duration of each phase of the last restart sequence
+ * @restart_ms: duration of the last restart sequence
  */
 struct subsys_device {
 	struct subsys_desc *desc;
@@ -210,6 +246,10 @@ struct subsys_device {
 	enum crash_status crashed;
 	int notif_state;
 	struct list_head list;
+	struct work_struct boot_work;
+	bool boot_ref;
+	u32 phase_ms[SSR_PHASE_MAX];
+	u32 restart_ms;
 };
 
 static struct subsys_device *to_subsys(struct device *d)
@@ -317,6 +357,22 @@ static ssize_t firmware_name_store(struct device *dev,
 }
 static DEVICE_ATTR_RW(firmware_name);
 
+static ssize_t ssr_timing_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct subsys_device *subsys = to_subsys(dev);
+	ssize_t len = 0;
+	int i;
+
+	for (i = 0; i < SSR_PHASE_MAX; i++)
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%s: %u ms\n",
+				 ssr_phase_names[i], subsys->phase_ms[i]);
+	len += scnprintf(buf + len, PAGE_SIZE - len, "total: %u ms\n",
+			 subsys->restart_ms);
+	return len;
+}
+static DEVICE_ATTR_RO(ssr_timing);
+
 static ssize_t system_debug_show(struct device *dev,
 				struct device_attribute *attr, char *buf)
 {
@@ -393,6 +449,7 @@ static struct attribute *subsys_attrs[] = {
 	&dev_attr_restart_level.attr,
 	&dev_attr_firmware_name.attr,
 	&dev_attr_system_debug.attr,
+	&dev_attr_ssr_timing.attr,
 	NULL,
 };
 
@@ -413,6 +470,7 @@ static int enable_mini_ramdumps;
 module_param(enable_mini_ramdumps, int, 0644);
 
 struct workqueue_struct *ssr_wq;
+static struct workqueue_struct *subsys_boot_wq;
 static struct class *char_class;
 
 static LIST_HEAD(restart_log_list);
@@ -680,8 +738,8 @@ static void notify_each_subsys_device(struct subsys_device **list,
 
 		trace_pil_notif("before_send_notif", notif, dev->desc->fw_name);
 		setup_timeout(dev->desc, NULL, SUBSYS_TO_HLOS);
-		subsys_notif_queue_notification(dev->notify, notif,
-								&notif_data);
+		subsys_notif_queue_notification_parallel(dev->notify, notif,
+							 &notif_data, fast_ssr);
 		cancel_timeout(dev->desc);
 		trace_pil_notif("after_send_notif", notif, dev->desc->fw_name);
 		subsys_notif_uevent(dev->desc, notif);
@@ -968,7 +1026,8 @@ int wait_for_shutdown_ack(struct subsys_desc *desc)
 }
 EXPORT_SYMBOL(wait_for_shutdown_ack);
 
-void *__subsystem_get(const char *name, const char *fw_name)
+static void *subsys_get_ref(const char *name, const char *fw_name,
+		bool boot)
 {
 	struct subsys_device *subsys;
 	struct subsys_device *subsys_d;
@@ -995,6 +1054,20 @@ void *__subsystem_get(const char *name, const char *fw_name)
 
 	track = subsys_get_track(subsys);
 	mutex_lock(&track->lock);
+	if (subsys->boot_ref && !boot) {
+		/* Hand the reference of the parallel boot over to the caller */
+		subsys->boot_ref = false;
+		mutex_unlock(&track->lock);
+		subsystem_put(subsys_d);
+		module_put(subsys->owner);
+		put_device(&subsys->dev);
+		return retval;
+	}
+	if (subsys->count && boot) {
+		/* Already brought up by a client, nothing left to do */
+		retval = NULL;
+		goto err_start;
+	}
 	if (!subsys->count) {
 		if (fw_name) {
 			pr_info("Changing subsys fw_name to %s\n", fw_name);
@@ -1008,6 +1081,8 @@ void *__subsystem_get(const char *name, const char *fw_name)
 		}
 	}
 	subsys->count++;
+	if (boot)
+		subsys->boot_ref = true;
 	mutex_unlock(&track->lock);
 	return retval;
 err_start:
@@ -1020,6 +1095,11 @@ void *__subsystem_get(const char *name, const char *fw_name)
 	return retval;
 }
 
+void *__subsystem_get(const char *name, const char *fw_name)
+{
+	return subsys_get_ref(name, fw_name, false);
+}
+
 /**
  * subsytem_get() - Boot a subsystem
  * @name: pointer to a string containing the name of the subsystem to boot
@@ -1051,6 +1131,72 @@ void *subsystem_get_with_fwname(const char *name, const char *fw_name)
 }
 EXPORT_SYMBOL(subsystem_get_with_fwname);
 
+/*
+ * Parallel boot: writing a comma separated list of subsystem names to
+ * the parallel_boot parameter, once their firmware can be read, boots
+ * them all at the same time on subsys_boot_wq instead of one after
+ * another as their clients come up. Dependencies are still booted
+ * first by each load and subsystems sharing a restart order still
+ * serialize on its lock. The reference taken here is handed over to
+ * the first subsystem_get() of the subsystem, which then finds it
+ * already up.
+ */
+static void subsys_boot_work_fn(struct work_struct *work)
+{
+	struct subsys_device *subsys = container_of(work, struct subsys_device,
+						    boot_work);
+	const char *name = subsys->desc->name;
+	ktime_t start = ktime_get();
+	void *retval;
+
+	retval = subsys_get_ref(name, NULL, true);
+	if (IS_ERR(retval))
+		pr_err("[%s]: parallel boot failed: %ld\n", name,
+			PTR_ERR(retval));
+	else if (retval)
+		pr_info("[%s]: parallel boot done in %lld ms\n", name,
+			ktime_ms_delta(ktime_get(), start));
+
+	put_device(&subsys->dev);
+}
+
+static int subsys_parallel_boot_set(const char *val,
+				    const struct kernel_param *kp)
+{
+	struct subsys_device *subsys;
+	char *buf, *cur, *name;
+
+	if (!subsys_boot_wq)
+		return -ENODEV;
+
+	buf = kstrdup(val, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	cur = buf;
+	while ((name = strsep(&cur, ",")) != NULL) {
+		name = strim(name);
+		if (!*name)
+			continue;
+
+		subsys = find_subsys_device(name);
+		if (!subsys) {
+			pr_err("parallel boot: no subsystem %s\n", name);
+			continue;
+		}
+		if (!queue_work(subsys_boot_wq, &subsys->boot_work))
+			put_device(&subsys->dev);
+	}
+
+	kfree(buf);
+	return 0;
+}
+
+static const struct kernel_param_ops subsys_parallel_boot_ops = {
+	.set = subsys_parallel_boot_set,
+};
+module_param_cb(parallel_boot, &subsys_parallel_boot_ops, NULL, 0200);
+
 /**
  * subsystem_put() - Shutdown a subsystem
  * @peripheral_handle: pointer from a previous call to subsystem_get()
@@ -1091,6 +1237,15 @@ void subsystem_put(void *subsystem)
 }
 EXPORT_SYMBOL(subsystem_put);
 
+static ktime_t ssr_phase_done(struct subsys_device *dev, enum ssr_phase phase,
+			      ktime_t start)
+{
+	ktime_t now = ktime_get();
+
+	dev->phase_ms[phase] = ktime_ms_delta(now, start);
+	return now;
+}
+
 static void subsystem_restart_wq_func(struct work_struct *work)
 {
 	struct subsys_device *dev = container_of(work,
@@ -1101,6 +1256,7 @@ static void subsystem_restart_wq_func(struct work_struct *work)
 	struct subsys_tracking *track;
 	unsigned int count;
 	unsigned long flags;
+	ktime_t start, t;
 	int ret;
 
 	/*
@@ -1148,14 +1304,20 @@ static void subsystem_restart_wq_func(struct work_struct *work)
 
 	pr_debug("[%s:%d]: Starting restart sequence for %s\n",
 			current->comm, current->pid, desc->name);
+	memset(dev->phase_ms, 0, sizeof(dev->phase_ms));
+	start = t = ktime_get();
 	notify_each_subsys_device(list, count, SUBSYS_BEFORE_SHUTDOWN, NULL);
+	t = ssr_phase_done(dev, SSR_PHASE_BEFORE_SHUTDOWN, t);
 	ret = for_each_subsys_device(list, count, NULL, subsystem_shutdown);
 	if (ret)
 		goto err;
+	t = ssr_phase_done(dev, SSR_PHASE_SHUTDOWN, t);
 	notify_each_subsys_device(list, count, SUBSYS_AFTER_SHUTDOWN, NULL);
+	t = ssr_phase_done(dev, SSR_PHASE_AFTER_SHUTDOWN, t);
 
 	notify_each_subsys_device(list, count, SUBSYS_RAMDUMP_NOTIFICATION,
 									NULL);
+	t = ssr_phase_done(dev, SSR_PHASE_RAMDUMP_NOTIF, t);
 
 	spin_lock_irqsave(&track->s_lock, flags);
 	track->p_state = SUBSYS_RESTARTING;
@@ -1163,17 +1325,24 @@ static void subsystem_restart_wq_func(struct work_struct *work)
 
 	/* Collect ram dumps for all subsystems in order here */
 	for_each_subsys_device(list, count, NULL, subsystem_ramdump);
+	t = ssr_phase_done(dev, SSR_PHASE_RAMDUMP, t);
 
 	for_each_subsys_device(list, count, NULL, subsystem_free_memory);
+	t = ssr_phase_done(dev, SSR_PHASE_FREE_MEMORY, t);
 
 	notify_each_subsys_device(list, count, SUBSYS_BEFORE_POWERUP, NULL);
+	t = ssr_phase_done(dev, SSR_PHASE_BEFORE_POWERUP, t);
 	ret = for_each_subsys_device(list, count, NULL, subsystem_powerup);
 	if (ret)
 		goto err;
+	t = ssr_phase_done(dev, SSR_PHASE_POWERUP, t);
 	notify_each_subsys_device(list, count, SUBSYS_AFTER_POWERUP, NULL);
+	t = ssr_phase_done(dev, SSR_PHASE_AFTER_POWERUP, t);
+	dev->restart_ms = ktime_ms_delta(t, start);
 
-	pr_info("[%s:%d]: Restart sequence for %s completed.\n",
-			current->comm, current->pid, desc->name);
+	pr_info("[%s:%d]: Restart sequence for %s completed in %u ms.\n",
+			current->comm, current->pid, desc->name,
+			dev->restart_ms);
 
 err:
 	/* Reset subsys count */
@@ -1839,6 +2008,7 @@ struct subsys_device *subsys_register(struct subsys_desc *desc)
 	wakeup_source_init(&subsys->ssr_wlock, subsys->wlname);
 	INIT_WORK(&subsys->work, subsystem_restart_wq_func);
 	INIT_WORK(&subsys->device_restart_work, device_restart_work_hdlr);
+	INIT_WORK(&subsys->boot_work, subsys_boot_work_fn);
 	spin_lock_init(&subsys->track.s_lock);
 	init_subsys_timer(desc);
 
@@ -1985,6 +2155,11 @@ static int __init subsys_restart_init(void)
 		WQ_UNBOUND | WQ_HIGHPRI | WQ_CPU_INTENSIVE, 0);
 	BUG_ON(!ssr_wq);
 
+	subsys_boot_wq = alloc_workqueue("subsys_boot_wq",
+		WQ_UNBOUND | WQ_HIGHPRI, 0);
+	if (!subsys_boot_wq)
+		pr_warn("Parallel subsystem boot not available\n");
+
 	ret = bus_register(&subsys_bus_type);
 	if (ret)
 		goto err_bus;
@@ -2008,6 +2183,8 @@ static int __init subsys_restart_init(void)
 err_class:
 	bus_unregister(&subsys_bus_type);
 err_bus:
+	if (subsys_boot_wq)
+		destroy_workqueue(subsys_boot_wq);
 	destroy_workqueue(ssr_wq);
 	return ret;
 }
@@ -79,6 +79,13 @@
 /* if low watermark of zones have reached, defer the refill in this window */
 #define ION_POOL_REFILL_DEFER_WINDOW_MS	10
 
+/*
+ * Idle top-up of the pools: how often it is attempted, and how long it
+ * backs off after the zones hit their watermarks or the pool was shrunk.
+ */
+#define ION_POOL_IDLE_REFILL_PERIOD_MS		2000
+#define ION_POOL_IDLE_REFILL_DEFER_WINDOW_MS	5000
+
 /**
  * struct ion_platform_heap - defines a heap in the given platform
  * @type:	type of the heap from ion_heap_type enum
@@ -453,6 +460,8 @@ struct ion_heap *ion_secure_carveout_heap_create(
  * @list:		plist node for list of pools
  * @cached:		it's cached pool or not
  * @heap:		ion heap associated to this pool
+ * @pcp:		per-cpu caches in front of the lists, may be NULL
+ * @pcp_count:		number of items held in the per-cpu caches
  *
  * Allows you to keep a pool of pre allocated pages to use from your heap.
  * Keeping a pool of pages that is ready for dma, ie any cached mapping have
@@ -473,11 +482,33 @@ struct ion_page_pool {
 	unsigned int order;
 	struct plist_node list;
 	struct device *dev;
+	struct ion_page_pool_pcp __percpu *pcp;
+	atomic_t pcp_count;
+};
+
+#define ION_POOL_PCP_SIZE	16
+#define ION_POOL_PCP_BATCH	(ION_POOL_PCP_SIZE / 2)
+
+/**
+ * struct ion_page_pool_pcp - per-cpu cache of lowmem pool items
+ * @lock:		protects the cache, only contended while draining
+ * @count:		number of items in @pages
+ * @pages:		the cached items
+ * @hits:		allocations served from this cache
+ * @misses:		allocations that found it empty
+ */
+struct ion_page_pool_pcp {
+	spinlock_t lock;
+	int count;
+	struct page *pages[ION_POOL_PCP_SIZE];
+	unsigned long hits;
+	unsigned long misses;
 };
 
 struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order,
 					   bool cached);
 void ion_page_pool_refill(struct ion_page_pool *pool);
+void ion_page_pool_refill_idle(struct ion_page_pool *pool);
 void ion_page_pool_destroy(struct ion_page_pool *pool);
 struct page *ion_page_pool_alloc(struct ion_page_pool *a, bool *from_pool);
 void ion_page_pool_free(struct ion_page_pool *pool, struct page *page);
@@ -487,6 +518,8 @@ struct page *ion_page_pool_alloc_pool_only(struct ion_page_pool *a);
 void ion_page_pool_free_immediate(struct ion_page_pool *pool,
 				  struct page *page);
 int ion_page_pool_total(struct ion_page_pool *pool, bool high);
+void ion_page_pool_pcp_stats(struct ion_page_pool *pool, unsigned long *hits,
+			     unsigned long *misses);
 size_t ion_system_heap_secure_page_pool_total(struct ion_heap *heap, int vmid);
 
 #ifdef CONFIG_ION_SYSTEM_HEAP
@@ -15,6 +15,7 @@
  */
 
 #include <linux/list.h>
+#include <linux/percpu.h>
 #include <linux/slab.h>
 #include <linux/swap.h>
 #include <linux/sched/signal.h>
@@ -76,9 +77,25 @@ static void ion_page_pool_free_pages(struct ion_page_pool *pool,
 	__free_pages(page, pool->order);
 }
 
-static void ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
+/*
+ * Items held in the per-cpu caches are accounted exactly like the ones on
+ * the lists, so moving them between the two doesn't touch the counters.
+ */
+static void ion_page_pool_account(struct ion_page_pool *pool,
+				  struct page *page, int sign)
+{
+	if (sign > 0)
+		atomic_inc(&pool->count);
+	else
+		atomic_dec(&pool->count);
+	nr_total_pages += sign * (1 << pool->order);
+	mod_node_page_state(page_pgdat(page), NR_KERNEL_MISC_RECLAIMABLE,
+						sign * (1 << pool->order));
+}
+
+static void __ion_page_pool_list_add(struct ion_page_pool *pool,
+				     struct page *page)
 {
-	mutex_lock(&pool->mutex);
 	if (PageHighMem(page)) {
 		list_add_tail(&page->lru, &pool->high_items);
 		pool->high_count++;
@@ -86,18 +103,161 @@ static void ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
 		list_add_tail(&page->lru, &pool->low_items);
 		pool->low_count++;
 	}
+}
 
-	atomic_inc(&pool->count);
-	nr_total_pages += 1 << pool->order;
-	mod_node_page_state(page_pgdat(page), NR_KERNEL_MISC_RECLAIMABLE,
-							1 << pool->order);
+static void ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
+{
+	mutex_lock(&pool->mutex);
+	__ion_page_pool_list_add(pool, page);
+	ion_page_pool_account(pool, page, 1);
 	mutex_unlock(&pool->mutex);
 }
 
-void ion_page_pool_refill(struct ion_page_pool *pool)
+/*
+ * Per-cpu caches. Allocations and frees of lowmem items go through a small
+ * per-cpu array first and only take pool->mutex to move a batch of
+ * ION_POOL_PCP_BATCH items to or from the lists. The per-cpu lock is only
+ * ever contended by the shrinker draining the caches.
+ */
+static void ion_page_pool_pcp_return(struct ion_page_pool *pool,
+				     struct page **pages, int nr)
+{
+	int i;
+
+	if (!nr)
+		return;
+
+	mutex_lock(&pool->mutex);
+	for (i = 0; i < nr; i++)
+		__ion_page_pool_list_add(pool, pages[i]);
+	atomic_sub(nr, &pool->pcp_count);
+	mutex_unlock(&pool->mutex);
+}
+
+static bool ion_page_pool_pcp_put(struct ion_page_pool *pool,
+				  struct page *page)
+{
+	struct page *batch[ION_POOL_PCP_BATCH];
+	struct ion_page_pool_pcp *pcp;
+	int nr = 0;
+
+	if (!pool->pcp || PageHighMem(page))
+		return false;
+
+	pcp = raw_cpu_ptr(pool->pcp);
+	spin_lock(&pcp->lock);
+	if (pcp->count == ION_POOL_PCP_SIZE) {
+		nr = ION_POOL_PCP_BATCH;
+		pcp->count -= nr;
+		memcpy(batch, &pcp->pages[pcp->count], sizeof(batch));
+	}
+	pcp->pages[pcp->count++] = page;
+	spin_unlock(&pcp->lock);
+
+	atomic_inc(&pool->pcp_count);
+	ion_page_pool_account(pool, page, 1);
+	ion_page_pool_pcp_return(pool, batch, nr);
+
+	return true;
+}
+
+static struct page *ion_page_pool_pcp_get(struct ion_page_pool *pool)
+{
+	struct page *batch[ION_POOL_PCP_BATCH];
+	struct ion_page_pool_pcp *pcp;
+	struct page *page = NULL;
+	int nr = 0;
+
+	if (!pool->pcp)
+		return NULL;
+
+	pcp = raw_cpu_ptr(pool->pcp);
+	spin_lock(&pcp->lock);
+	if (pcp->count) {
+		page = pcp->pages[--pcp->count];
+		pcp->hits++;
+	} else {
+		pcp->misses++;
+	}
+	spin_unlock(&pcp->lock);
+
+	if (page)
+		goto out;
+
+	/* refill from the lists, handing the first item to the caller */
+	if (!mutex_trylock(&pool->mutex))
+		return NULL;
+	while (nr < ION_POOL_PCP_BATCH && pool->low_count) {
+		batch[nr] = list_first_entry(&pool->low_items, struct page,
+					     lru);
+		list_del(&batch[nr]->lru);
+		pool->low_count--;
+		nr++;
+	}
+	atomic_add(nr, &pool->pcp_count);
+	mutex_unlock(&pool->mutex);
+
+	if (!nr)
+		return NULL;
+
+	page = batch[--nr];
+	spin_lock(&pcp->lock);
+	while (nr && pcp->count < ION_POOL_PCP_SIZE)
+		pcp->pages[pcp->count++] = batch[--nr];
+	spin_unlock(&pcp->lock);
+	/* raced with frees on this cpu, put the rest back */
+	ion_page_pool_pcp_return(pool, batch, nr);
+out:
+	atomic_dec(&pool->pcp_count);
+	ion_page_pool_account(pool, page, -1);
+	return page;
+}
+
+/* Move every per-cpu cached item back to the lists */
+static void ion_page_pool_pcp_drain(struct ion_page_pool *pool)
+{
+	struct page *batch[ION_POOL_PCP_SIZE];
+	int cpu;
+
+	if (!pool->pcp || !atomic_read(&pool->pcp_count))
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct ion_page_pool_pcp *pcp = per_cpu_ptr(pool->pcp, cpu);
+		int nr;
+
+		spin_lock(&pcp->lock);
+		nr = pcp->count;
+		memcpy(batch, pcp->pages, nr * sizeof(batch[0]));
+		pcp->count = 0;
+		spin_unlock(&pcp->lock);
+
+		ion_page_pool_pcp_return(pool, batch, nr);
+	}
+}
+
+void ion_page_pool_pcp_stats(struct ion_page_pool *pool, unsigned long *hits,
+			     unsigned long *misses)
+{
+	int cpu;
+
+	*hits = 0;
+	*misses = 0;
+	if (!pool->pcp)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct ion_page_pool_pcp *pcp = per_cpu_ptr(pool->pcp, cpu);
+
+		*hits += READ_ONCE(pcp->hits);
+		*misses += READ_ONCE(pcp->misses);
+	}
+}
+
+static void __ion_page_pool_refill(struct ion_page_pool *pool,
+				   gfp_t gfp_refill)
 {
 	struct page *page;
-	gfp_t gfp_refill = (pool->gfp_mask | __GFP_RECLAIM) & ~__GFP_NORETRY;
 	struct device *dev = pool->dev;
 
 	/* skip refilling order 0 pools */
@@ -113,9 +273,34 @@ void ion_page_pool_refill(struct ion_page_pool *pool)
 						  PAGE_SIZE << pool->order,
 						  DMA_BIDIRECTIONAL);
 		ion_page_pool_add(pool, page);
+		cond_resched();
 	}
 }
 
+void ion_page_pool_refill(struct ion_page_pool *pool)
+{
+	__ion_page_pool_refill(pool,
+			(pool->gfp_mask | __GFP_RECLAIM) & ~__GFP_NORETRY);
+}
+
+/*
+ * Top the pool up to its fillmark ahead of demand, with zeroed pages
+ * taken only from free memory. Nothing is done while the zones are, or
+ * recently were, short of memory, so this never competes with reclaim.
+ */
+void ion_page_pool_refill_idle(struct ion_page_pool *pool)
+{
+	s64 delta;
+
+	delta = ktime_ms_delta(ktime_get(), pool->last_low_watermark_ktime);
+	if (delta < ION_POOL_IDLE_REFILL_DEFER_WINDOW_MS)
+		return;
+
+	__ion_page_pool_refill(pool, (pool->gfp_mask | __GFP_ZERO |
+				      __GFP_NORETRY | __GFP_NOWARN) &
+				     ~__GFP_RECLAIM);
+}
+
 static struct page *ion_page_pool_remove(struct ion_page_pool *pool, bool high)
 {
 	struct page *page;
@@ -130,11 +315,8 @@ static struct page *ion_page_pool_remove(struct ion_page_pool *pool, bool high)
 		pool->low_count--;
 	}
 
-	atomic_dec(&pool->count);
 	list_del(&page->lru);
-	nr_total_pages -= 1 << pool->order;
-	mod_node_page_state(page_pgdat(page), NR_KERNEL_MISC_RECLAIMABLE,
-							-(1 << pool->order));
+	ion_page_pool_account(pool, page, -1);
 	return page;
 }
 
@@ -147,7 +329,10 @@ struct page *ion_page_pool_alloc(struct ion_page_pool *pool, bool *from_pool)
 	if (fatal_signal_pending(current))
 		return ERR_PTR(-EINTR);
 
-	if (*from_pool && mutex_trylock(&pool->mutex)) {
+	if (*from_pool)
+		page = ion_page_pool_pcp_get(pool);
+
+	if (*from_pool && !page && mutex_trylock(&pool->mutex)) {
 		if (pool->high_count)
 			page = ion_page_pool_remove(pool, true);
 		else if (pool->low_count)
@@ -174,7 +359,8 @@ struct page *ion_page_pool_alloc_pool_only(struct ion_page_pool *pool)
 	if (!pool)
 		return ERR_PTR(-EINVAL);
 
-	if (mutex_trylock(&pool->mutex)) {
+	page = ion_page_pool_pcp_get(pool);
+	if (!page && mutex_trylock(&pool->mutex)) {
 		if (pool->high_count)
 			page = ion_page_pool_remove(pool, true);
 		else if (pool->low_count)
@@ -189,7 +375,8 @@ struct page *ion_page_pool_alloc_pool_only(struct ion_page_pool *pool)
 
 void ion_page_pool_free(struct ion_page_pool *pool, struct page *page)
 {
-	ion_page_pool_add(pool, page);
+	if (!ion_page_pool_pcp_put(pool, page))
+		ion_page_pool_add(pool, page);
 }
 
 void ion_page_pool_free_immediate(struct ion_page_pool *pool, struct page *page)
@@ -199,7 +386,7 @@ void ion_page_pool_free_immediate(struct ion_page_pool *pool, struct page *page)
 
 int ion_page_pool_total(struct ion_page_pool *pool, bool high)
 {
-	int count = pool->low_count;
+	int count = pool->low_count + atomic_read(&pool->pcp_count);
 
 	if (high)
 		count += pool->high_count;
@@ -231,6 +418,10 @@ int ion_page_pool_shrink(struct ion_page_pool *pool, gfp_t gfp_mask,
 	if (nr_to_scan == 0)
 		return ion_page_pool_total(pool, high);
 
+	ion_page_pool_pcp_drain(pool);
+	/* keep the idle refill from undoing the shrinker's work */
+	pool->last_low_watermark_ktime = ktime_get();
+
 	while (freed < nr_to_scan) {
 		struct page *page;
 
@@ -255,6 +446,7 @@ struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order,
 					   bool cached)
 {
 	struct ion_page_pool *pool = kzalloc(sizeof(*pool), GFP_KERNEL);
+	int cpu;
 
 	if (!pool)
 		return NULL;
@@ -267,10 +459,18 @@ struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order,
 	if (cached)
 		pool->cached = true;
 
+	/* the pool still works without the per-cpu caches */
+	pool->pcp = alloc_percpu(struct ion_page_pool_pcp);
+	if (pool->pcp)
+		for_each_possible_cpu(cpu)
+			spin_lock_init(&per_cpu_ptr(pool->pcp, cpu)->lock);
+
 	return pool;
 }
 
 void ion_page_pool_destroy(struct ion_page_pool *pool)
 {
+	ion_page_pool_pcp_drain(pool);
+	free_percpu(pool->pcp);
 	kfree(pool);
 }
@@ -546,6 +546,7 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 	unsigned long uncached_total = 0;
 	unsigned long cached_total = 0;
 	unsigned long secure_total = 0;
+	unsigned long hits, misses;
 	struct ion_page_pool *pool;
 	int i, j;
 
@@ -562,12 +563,19 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 				   pool->low_count, pool->order,
 				   (1 << pool->order) * PAGE_SIZE *
 					pool->low_count);
+			ion_page_pool_pcp_stats(pool, &hits, &misses);
+			seq_printf(s,
+				   "%d order %u pages in uncached pool cpu caches, %lu hits %lu misses\n",
+				   atomic_read(&pool->pcp_count), pool->order,
+				   hits, misses);
 		}
 
 		uncached_total += (1 << pool->order) * PAGE_SIZE *
 			pool->high_count;
 		uncached_total += (1 << pool->order) * PAGE_SIZE *
 			pool->low_count;
+		uncached_total += (1 << pool->order) * PAGE_SIZE *
+			atomic_read(&pool->pcp_count);
 	}
 
 	for (i = 0; i < NUM_ORDERS; i++) {
@@ -583,12 +591,19 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 				   pool->low_count, pool->order,
 				   (1 << pool->order) * PAGE_SIZE *
 					pool->low_count);
+			ion_page_pool_pcp_stats(pool, &hits, &misses);
+			seq_printf(s,
+				   "%d order %u pages in cached pool cpu caches, %lu hits %lu misses\n",
+				   atomic_read(&pool->pcp_count), pool->order,
+				   hits, misses);
 		}
 
 		cached_total += (1 << pool->order) * PAGE_SIZE *
 			pool->high_count;
 		cached_total += (1 << pool->order) * PAGE_SIZE *
 			pool->low_count;
+		cached_total += (1 << pool->order) * PAGE_SIZE *
+			atomic_read(&pool->pcp_count);
 	}
 
 	for (i = 0; i < NUM_ORDERS; i++) {
@@ -700,6 +715,48 @@ static int ion_sys_heap_worker(void *data)
 	return 0;
 }
 
+/*
+ * Keeps the non-secure pools filled while the system is otherwise idle,
+ * so allocations find zeroed pages instead of zeroing on their own path.
+ * Runs as SCHED_IDLE and only ever takes free pages.
+ */
+static int ion_sys_heap_idle_worker(void *data)
+{
+	struct ion_system_heap *heap = data;
+	int i;
+
+	while (!kthread_should_stop()) {
+		schedule_timeout_interruptible(
+			msecs_to_jiffies(ION_POOL_IDLE_REFILL_PERIOD_MS));
+
+		for (i = 0; i < NUM_ORDERS; i++) {
+			if (kthread_should_stop())
+				break;
+			ion_page_pool_refill_idle(heap->uncached_pools[i]);
+			ion_page_pool_refill_idle(heap->cached_pools[i]);
+		}
+	}
+
+	return 0;
+}
+
+static struct task_struct *ion_create_idle_kworker(struct ion_system_heap *heap)
+{
+	struct sched_param param = { .sched_priority = 0 };
+	struct task_struct *thread;
+
+	thread = kthread_run(ion_sys_heap_idle_worker, heap,
+			     "ion-pool-idle-worker");
+	if (IS_ERR(thread)) {
+		pr_err("%s: failed to create idle worker thread: %ld\n",
+		       __func__, PTR_ERR(thread));
+		return thread;
+	}
+	sched_setscheduler(thread, SCHED_IDLE, &param);
+
+	return thread;
+}
+
 static struct task_struct *ion_create_kworker(struct ion_page_pool **pools,
 					      bool cached)
 {
@@ -775,6 +832,10 @@ struct ion_heap *ion_system_heap_create(struct ion_platform_heap *data)
 			ret = PTR_ERR(heap->kworker[ION_KTHREAD_CACHED]);
 			goto destroy_pools;
 		}
+		/* the on-demand workers still cover the pools without it */
+		heap->kworker[ION_KTHREAD_IDLE] = ion_create_idle_kworker(heap);
+		if (IS_ERR(heap->kworker[ION_KTHREAD_IDLE]))
+			heap->kworker[ION_KTHREAD_IDLE] = NULL;
 	}
 
 	mutex_init(&heap->split_page_mutex);
@@ -33,6 +33,7 @@ static const unsigned int orders[] = {0};
 enum ion_kthread_type {
 	ION_KTHREAD_UNCACHED,
 	ION_KTHREAD_CACHED,
+	ION_KTHREAD_IDLE,
 	ION_MAX_NUM_KTHREADS
 };
 
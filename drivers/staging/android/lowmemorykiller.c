@@ -51,6 +51,7 @@
 #include <linux/vmpressure.h>
 #include <linux/freezer.h>
 #include <linux/memory.h>
+#include <linux/ktime.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/almk.h>
@@ -454,6 +455,202 @@ static int get_minfree_scalefactor(gfp_t gfp_mask)
 	return max_t(int, 1, mult_frac(100, nr_usable, totalram_pages));
 }
 
+/*
+ * With lmk_cache set, the zone-derived adjustments of tune_lmk_param()
+ * and the minfree scale factor are kept per gfp class and recomputed
+ * only when NR_FREE_PAGES has moved by lmk_cache_refresh_pages or the
+ * entry is older than a second. The candidates found by the last full
+ * process scan are remembered as well, so the next scans can pick a
+ * victim among them without walking every task. Both caches are only
+ * used under scan_mutex.
+ */
+static int lmk_cache;
+module_param_named(lmk_cache, lmk_cache, int, 0644);
+
+static int lmk_cache_refresh_pages = 256;
+module_param_named(lmk_cache_refresh_pages, lmk_cache_refresh_pages, int,
+		   0644);
+
+struct lmk_tune_cache {
+	unsigned long stamp;
+	long nr_free;
+	int free_delta;
+	int file_delta;
+	int scale_percent;
+	bool valid;
+};
+
+static struct lmk_tune_cache lmk_tune_cache[MAX_NR_ZONES][2][2];
+
+#define LMK_NR_CANDIDATES	8
+/* remembered candidates are only trusted for this long */
+#define LMK_CANDIDATE_TTL	(HZ / 2)
+
+struct lmk_candidate {
+	struct task_struct *tsk;
+	struct pid *pid;
+	int tasksize;
+	short adj;
+};
+
+static struct lmk_candidate lmk_candidates[LMK_NR_CANDIDATES];
+static int lmk_nr_candidates;
+static unsigned long lmk_candidates_stamp;
+
+static void lmk_tune_cache_invalidate(void)
+{
+	memset(lmk_tune_cache, 0, sizeof(lmk_tune_cache));
+}
+
+static void lmk_tune_cached(int *other_free, int *other_file,
+			    int *scale_percent, struct shrink_control *sc)
+{
+	struct lmk_tune_cache *c;
+	long nr_free = global_zone_page_state(NR_FREE_PAGES);
+	int free_delta = 0, file_delta = 0;
+
+	c = &lmk_tune_cache[gfp_zone(sc->gfp_mask)]
+			   [can_use_cma_pages(sc->gfp_mask)]
+			   [current_is_kswapd()];
+
+	if (!c->valid || time_after(jiffies, c->stamp + HZ) ||
+	    abs(nr_free - c->nr_free) >= lmk_cache_refresh_pages) {
+		/* tune_lmk_param only subtracts, so cache what it takes off */
+		tune_lmk_param(&free_delta, &file_delta, sc);
+		c->free_delta = free_delta;
+		c->file_delta = file_delta;
+		c->scale_percent = get_minfree_scalefactor(sc->gfp_mask);
+		c->nr_free = nr_free;
+		c->stamp = jiffies;
+		c->valid = true;
+	}
+
+	*other_free += c->free_delta;
+	*other_file += c->file_delta;
+	*scale_percent = c->scale_percent;
+}
+
+static void lmk_candidates_release(void)
+{
+	int i;
+
+	for (i = 0; i < lmk_nr_candidates; i++)
+		put_pid(lmk_candidates[i].pid);
+	lmk_nr_candidates = 0;
+}
+
+/* Keep @top sorted by adj, then size, best first. */
+static int lmk_candidate_note(struct lmk_candidate *top, int nr,
+			      struct task_struct *tsk, short adj, int tasksize)
+{
+	int i;
+
+	for (i = nr; i > 0; i--) {
+		if (top[i - 1].adj > adj ||
+		    (top[i - 1].adj == adj && top[i - 1].tasksize >= tasksize))
+			break;
+		if (i < LMK_NR_CANDIDATES)
+			top[i] = top[i - 1];
+	}
+
+	if (i >= LMK_NR_CANDIDATES)
+		return nr;
+
+	top[i].tsk = tsk;
+	top[i].adj = adj;
+	top[i].tasksize = tasksize;
+
+	return min(nr + 1, LMK_NR_CANDIDATES);
+}
+
+/* Called under rcu_read_lock, the tasks in @top are still valid. */
+static void lmk_candidates_save(struct lmk_candidate *top, int nr,
+				struct task_struct *selected)
+{
+	int i;
+
+	lmk_candidates_release();
+	for (i = 0; i < nr; i++) {
+		if (top[i].tsk == selected)
+			continue;
+		lmk_candidates[lmk_nr_candidates].pid =
+					get_pid(task_pid(top[i].tsk));
+		lmk_candidates[lmk_nr_candidates].adj = top[i].adj;
+		lmk_nr_candidates++;
+	}
+	lmk_candidates_stamp = jiffies;
+}
+
+/*
+ * Pick a victim among the remembered candidates, re-reading their adj
+ * and rss. Called under rcu_read_lock. Returns NULL if none qualifies,
+ * in which case the caller falls back to a full scan.
+ */
+static struct task_struct *lmk_candidates_select(short min_score_adj,
+						 int *selected_tasksize,
+						 short *selected_oom_score_adj)
+{
+	struct task_struct *selected = NULL;
+	int i, idx = -1;
+
+	if (!lmk_nr_candidates ||
+	    time_after(jiffies, lmk_candidates_stamp + LMK_CANDIDATE_TTL)) {
+		lmk_candidates_release();
+		return NULL;
+	}
+
+	for (i = 0; i < lmk_nr_candidates; i++) {
+		struct task_struct *tsk, *p;
+		short oom_score_adj;
+		int tasksize;
+
+		tsk = pid_task(lmk_candidates[i].pid, PIDTYPE_PID);
+		if (!tsk || test_task_flag(tsk, TIF_MM_RELEASED) ||
+		    test_task_lmk_waiting(tsk))
+			continue;
+
+		p = find_lock_task_mm(tsk);
+		if (!p)
+			continue;
+
+		if (test_bit(MMF_OOM_VICTIM, &p->mm->flags)) {
+			task_unlock(p);
+			continue;
+		}
+
+		oom_score_adj = p->signal->oom_score_adj;
+		if (oom_score_adj < min_score_adj) {
+			task_unlock(p);
+			continue;
+		}
+		tasksize = get_mm_rss(p->mm);
+		task_unlock(p);
+		if (tasksize <= 0)
+			continue;
+		if (selected) {
+			if (oom_score_adj < *selected_oom_score_adj)
+				continue;
+			if (oom_score_adj == *selected_oom_score_adj &&
+			    tasksize <= *selected_tasksize)
+				continue;
+		}
+		selected = p;
+		idx = i;
+		*selected_tasksize = tasksize;
+		*selected_oom_score_adj = oom_score_adj;
+	}
+
+	if (selected) {
+		put_pid(lmk_candidates[idx].pid);
+		lmk_candidates[idx] = lmk_candidates[--lmk_nr_candidates];
+		lowmem_print(3, "select cached '%s' (%d), adj %hd, size %d\n",
+			     selected->comm, selected->pid,
+			     *selected_oom_score_adj, *selected_tasksize);
+	}
+
+	return selected;
+}
+
 static void mark_lmk_victim(struct task_struct *tsk)
 {
 	struct mm_struct *mm = tsk->mm;
@@ -481,6 +678,12 @@ static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 	int other_free;
 	int other_file;
 	bool lock_required = true;
+	bool use_cache;
+	bool from_cache = false;
+	struct lmk_candidate top[LMK_NR_CANDIDATES];
+	int nr_top = 0;
+	int nr_scanned = 0;
+	u64 t_start, t_tuned, t_selected;
 
 	other_free = global_zone_page_state(NR_FREE_PAGES) - totalreserve_pages;
 
@@ -501,9 +704,14 @@ static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 	if (likely(lock_required) && !mutex_trylock(&scan_mutex))
 		return 0;
 
-	tune_lmk_param(&other_free, &other_file, sc);
-
-	scale_percent = get_minfree_scalefactor(sc->gfp_mask);
+	t_start = ktime_get_ns();
+	use_cache = lmk_cache && lock_required;
+	if (use_cache) {
+		lmk_tune_cached(&other_free, &other_file, &scale_percent, sc);
+	} else {
+		tune_lmk_param(&other_free, &other_file, sc);
+		scale_percent = get_minfree_scalefactor(sc->gfp_mask);
+	}
 	if (lowmem_adj_size < array_size)
 		array_size = lowmem_adj_size;
 	if (lowmem_minfree_size < array_size)
@@ -532,12 +740,24 @@ static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 	}
 
 	selected_oom_score_adj = min_score_adj;
+	t_tuned = ktime_get_ns();
 
 	rcu_read_lock();
+	if (use_cache && time_after(jiffies, lowmem_deathpending_timeout)) {
+		selected = lmk_candidates_select(min_score_adj,
+						 &selected_tasksize,
+						 &selected_oom_score_adj);
+		from_cache = selected != NULL;
+	}
+	if (from_cache)
+		goto kill;
+
 	for_each_process(tsk) {
 		struct task_struct *p;
 		short oom_score_adj;
 
+		nr_scanned++;
+
 		if (tsk->flags & PF_KTHREAD)
 			continue;
 
@@ -587,6 +807,9 @@ static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 		task_unlock(p);
 		if (tasksize <= 0)
 			continue;
+		if (use_cache)
+			nr_top = lmk_candidate_note(top, nr_top, p,
+						    oom_score_adj, tasksize);
 		if (selected) {
 			if (oom_score_adj < selected_oom_score_adj)
 				continue;
@@ -600,6 +823,12 @@ static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 		lowmem_print(3, "select '%s' (%d), adj %hd, size %d, to kill\n",
 			     p->comm, p->pid, oom_score_adj, tasksize);
 	}
+	if (use_cache)
+		lmk_candidates_save(top, nr_top, selected);
+kill:
+	t_selected = ktime_get_ns();
+	trace_lowmemory_scan(t_tuned - t_start, t_selected - t_tuned,
+			     nr_scanned, from_cache);
 	if (selected) {
 		long cache_size = other_file * (long)(PAGE_SIZE / 1024);
 		long cache_limit = minfree * (long)(PAGE_SIZE / 1024);
@@ -628,6 +857,8 @@ static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 			}
 		}
 		task_unlock(selected);
+		trace_lowmemory_kill_time(selected,
+					  ktime_get_ns() - t_selected);
 		trace_lowmemory_kill(selected, cache_size, cache_limit, free);
 		lowmem_print(1, "Killing '%s' (%d) (tgid %d), adj %hd,\n"
 			"to free %ldkB on behalf of '%s' (%d) because\n"
@@ -692,6 +923,13 @@ static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 static int lmk_hotplug_callback(struct notifier_block *self,
 				unsigned long action, void *arg)
 {
+	/* zone sizes change, recompute the cached thresholds */
+	if (action == MEM_ONLINE || action == MEM_OFFLINE) {
+		mutex_lock(&scan_mutex);
+		lmk_tune_cache_invalidate();
+		mutex_unlock(&scan_mutex);
+	}
+
 	switch (action) {
 	case MEM_GOING_OFFLINE:
 		if (enable_adaptive_lmk == ADAPTIVE_LMK_ENABLED)
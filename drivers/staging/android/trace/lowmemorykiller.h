@@ -34,6 +34,48 @@ TRACE_EVENT(lowmemory_kill,
 		__entry->pagecache_limit, __entry->free)
 );
 
+TRACE_EVENT(lowmemory_scan,
+	TP_PROTO(u64 tune_ns, u64 scan_ns, int nr_scanned, bool cached),
+
+	TP_ARGS(tune_ns, scan_ns, nr_scanned, cached),
+
+	TP_STRUCT__entry(
+			__field(u64, tune_ns)
+			__field(u64, scan_ns)
+			__field(int, nr_scanned)
+			__field(bool, cached)
+	),
+
+	TP_fast_assign(
+			__entry->tune_ns = tune_ns;
+			__entry->scan_ns = scan_ns;
+			__entry->nr_scanned = nr_scanned;
+			__entry->cached = cached;
+	),
+
+	TP_printk("tune %lluns, scan %lluns, scanned %d, cached %d",
+		__entry->tune_ns, __entry->scan_ns, __entry->nr_scanned,
+		__entry->cached)
+);
+
+TRACE_EVENT(lowmemory_kill_time,
+	TP_PROTO(struct task_struct *killed_task, u64 kill_ns),
+
+	TP_ARGS(killed_task, kill_ns),
+
+	TP_STRUCT__entry(
+			__field(pid_t, pid)
+			__field(u64, kill_ns)
+	),
+
+	TP_fast_assign(
+			__entry->pid = killed_task->pid;
+			__entry->kill_ns = kill_ns;
+	),
+
+	TP_printk("pid %d, kill %lluns", __entry->pid, __entry->kill_ns)
+);
+
 
 #endif /* if !defined(_TRACE_LOWMEMORYKILLER_H) || defined(TRACE_HEADER_MULTI_READ) */
 
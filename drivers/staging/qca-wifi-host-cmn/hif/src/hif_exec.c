@@ -30,6 +30,7 @@
 	(((n) + 1) >> (s))
 
 static struct hif_exec_context *hif_exec_tasklet_create(void);
+static void hif_exec_mod_print_stats(struct HIF_CE_state *hif_state);
 
 #ifdef WLAN_FEATURE_DP_EVENT_HISTORY
 struct hif_event_history hif_event_desc_history[HIF_NUM_INT_CONTEXTS];
@@ -341,6 +342,7 @@ void hif_print_napi_stats(struct hif_opaque_softc *hif_ctx)
 	}
 
 	hif_print_napi_latency_stats(hif_state);
+	hif_exec_mod_print_stats(hif_state);
 }
 
 qdf_export_symbol(hif_print_napi_stats);
@@ -393,6 +395,7 @@ void hif_print_napi_stats(struct hif_opaque_softc *hif_ctx)
 	}
 
 	hif_print_napi_latency_stats(hif_state);
+	hif_exec_mod_print_stats(hif_state);
 }
 qdf_export_symbol(hif_print_napi_stats);
 #endif /* WLAN_FEATURE_RX_SOFTIRQ_TIME_LIMIT */
@@ -492,6 +495,155 @@ void hif_latency_profile_start(struct hif_exec_context *hif_ext_group)
 #endif
 
 #ifdef FEATURE_NAPI
+/*
+ * Adaptive moderation of NAPI exec groups
+ *
+ * Each group keeps a moving average of the work found per poll. Polls run
+ * with an internal budget of about twice that average, so a group that
+ * suddenly sees a burst hands the CPU back to NAPI, and thus to the other
+ * groups, between rounds instead of draining everything at once.
+ *
+ * When a poll finishes under budget the IRQ is not re-enabled right away.
+ * The group is parked on an hrtimer instead, for hif_exec_mod_min_us at low
+ * rates up to hif_exec_mod_max_us as the average approaches the budget,
+ * and polled again from there. Only a poll that finds nothing, or too many
+ * deferrals in a row, re-enables the IRQ. That bounds the added latency by
+ * the timer while trading most interrupts at moderate rates for polls.
+ * hif_exec_mod_max_us = 0 restores the per-poll IRQ re-enable.
+ */
+#define HIF_EXEC_MOD_MIN_BUDGET 8
+#define HIF_EXEC_MOD_MAX_DEFERS 16
+
+static uint32_t hif_exec_mod_min_us = 20;
+qdf_declare_param(hif_exec_mod_min_us, uint);
+
+static uint32_t hif_exec_mod_max_us = 100;
+qdf_declare_param(hif_exec_mod_max_us, uint);
+
+static enum hrtimer_restart hif_exec_mod_timer_fn(struct hrtimer *timer)
+{
+	struct hif_napi_exec_context *n_ctx =
+		qdf_container_of(timer, struct hif_napi_exec_context,
+				 mod.timer);
+
+	/* an IRQ that fired meanwhile has already rescheduled the group */
+	if (qdf_atomic_test_and_clear_bit(HIF_EXEC_MOD_DEFERRED,
+					  &n_ctx->mod.flags)) {
+		n_ctx->mod.timer_polls++;
+		napi_schedule(&n_ctx->napi);
+	}
+
+	return HRTIMER_NORESTART;
+}
+
+/**
+ * hif_exec_mod_budget() - internal budget for the next poll of a group
+ * @n_ctx: napi exec context
+ * @normalized_budget: internal budget granted by NAPI
+ *
+ * Return: budget to pass to the group handler
+ */
+static int hif_exec_mod_budget(struct hif_napi_exec_context *n_ctx,
+			       int normalized_budget)
+{
+	struct hif_exec_moderation *mod = &n_ctx->mod;
+	int budget;
+
+	if (!READ_ONCE(hif_exec_mod_max_us))
+		return normalized_budget;
+
+	budget = max_t(int, (mod->ewma_work >> 3) * 2,
+		       HIF_EXEC_MOD_MIN_BUDGET);
+	if (budget >= normalized_budget)
+		return normalized_budget;
+
+	mod->budget_clips++;
+	return budget;
+}
+
+/**
+ * hif_exec_mod_defer() - try to park a group that finished under budget
+ * @n_ctx: napi exec context
+ * @work_done: work done by the poll that just finished
+ * @budget: budget of that poll
+ *
+ * Must be called after napi_complete(). The group keeps its IRQ disabled
+ * and stays accounted in active_grp_tasklet_cnt while parked.
+ *
+ * Return: true if the timer was armed, false if the IRQ should be enabled
+ */
+static bool hif_exec_mod_defer(struct hif_napi_exec_context *n_ctx,
+			       int work_done, int budget)
+{
+	struct hif_exec_moderation *mod = &n_ctx->mod;
+	uint32_t min_us = READ_ONCE(hif_exec_mod_min_us);
+	uint32_t max_us = READ_ONCE(hif_exec_mod_max_us);
+	uint32_t avg = mod->ewma_work >> 3;
+	uint32_t delay_us;
+
+	if (!max_us || !work_done || mod->defers >= HIF_EXEC_MOD_MAX_DEFERS) {
+		mod->defers = 0;
+		return false;
+	}
+
+	if (min_us > max_us)
+		min_us = max_us;
+	avg = min_t(uint32_t, avg, budget);
+	delay_us = min_us + (max_us - min_us) * avg / budget;
+
+	mod->defers++;
+	qdf_atomic_set_bit(HIF_EXEC_MOD_DEFERRED, &mod->flags);
+	hrtimer_start(&mod->timer, ns_to_ktime((u64)delay_us * NSEC_PER_USEC),
+		      HRTIMER_MODE_REL_PINNED);
+
+	return true;
+}
+
+/**
+ * hif_exec_mod_irq() - account an IRQ of a napi exec group
+ * @ctx: the exec context that took the interrupt
+ *
+ * Return: true if the group was parked and its active count is handed over
+ */
+static bool hif_exec_mod_irq(struct hif_exec_context *ctx)
+{
+	struct hif_napi_exec_context *n_ctx;
+
+	if (ctx->type != HIF_EXEC_NAPI_TYPE)
+		return false;
+
+	n_ctx = hif_exec_get_napi(ctx);
+	if (!qdf_atomic_test_and_clear_bit(HIF_EXEC_MOD_DEFERRED,
+					   &n_ctx->mod.flags))
+		return false;
+
+	n_ctx->mod.irq_steals++;
+	return true;
+}
+
+static void hif_exec_mod_print_stats(struct HIF_CE_state *hif_state)
+{
+	struct hif_exec_context *hif_ext_group;
+	struct hif_exec_moderation *mod;
+	int i;
+
+	QDF_TRACE(QDF_MODULE_ID_HIF, QDF_TRACE_LEVEL_ERROR,
+		  "NAPI[#] |avg    |budget |t-polls|irq-en |clips  |steals");
+
+	for (i = 0; i < hif_state->hif_num_extgroup; i++) {
+		hif_ext_group = hif_state->hif_ext_group[i];
+		if (!hif_ext_group || hif_ext_group->type != HIF_EXEC_NAPI_TYPE)
+			continue;
+
+		mod = &hif_exec_get_napi(hif_ext_group)->mod;
+		QDF_TRACE(QDF_MODULE_ID_HIF, QDF_TRACE_LEVEL_ERROR,
+			  "NAPI[%d]: %7u %7u %7u %7u %7u %7u",
+			  i, mod->ewma_work >> 3, mod->budget,
+			  mod->timer_polls, mod->irq_enables,
+			  mod->budget_clips, mod->irq_steals);
+	}
+}
+
 /**
  * hif_exec_poll() - napi poll
  * napi: napi struct
@@ -510,6 +662,9 @@ static int hif_exec_poll(struct napi_struct *napi, int budget)
 	int actual_dones;
 	int shift = hif_ext_group->scale_bin_shift;
 	int cpu = smp_processor_id();
+	unsigned long long start_ns = sched_clock();
+	struct hif_exec_moderation *mod = &napi_exec_ctx->mod;
+	int budget_used;
 
 	hif_record_event(hif_ext_group->hif, hif_ext_group->grp_id,
 			 0, 0, 0, HIF_EVENT_BH_SCHED);
@@ -522,15 +677,23 @@ static int hif_exec_poll(struct napi_struct *napi, int budget)
 
 	hif_latency_profile_measure(hif_ext_group);
 
+	budget_used = hif_exec_mod_budget(napi_exec_ctx, normalized_budget);
+	mod->budget = budget_used;
+
 	work_done = hif_ext_group->handler(hif_ext_group->context,
-					   normalized_budget);
+					   budget_used);
 
 	actual_dones = work_done;
+	mod->ewma_work += actual_dones - (mod->ewma_work >> 3);
 
-	if (!hif_ext_group->force_break && work_done < normalized_budget) {
+	if (!hif_ext_group->force_break && work_done < budget_used) {
 		napi_complete(napi);
-		qdf_atomic_dec(&scn->active_grp_tasklet_cnt);
-		hif_ext_group->irq_enable(hif_ext_group);
+		if (!hif_exec_mod_defer(napi_exec_ctx, actual_dones,
+					budget_used)) {
+			qdf_atomic_dec(&scn->active_grp_tasklet_cnt);
+			hif_ext_group->irq_enable(hif_ext_group);
+			mod->irq_enables++;
+		}
 		hif_ext_group->stats[cpu].napi_completes++;
 	} else {
 		/* if the ext_group supports time based yield, claim full work
@@ -546,6 +709,8 @@ static int hif_exec_poll(struct napi_struct *napi, int budget)
 		work_done = INTERNAL_BUDGET_TO_NAPI_BUDGET(work_done, shift);
 
 	hif_exec_fill_poll_time_histogram(hif_ext_group);
+	hif_exec_load_sample(hif_ext_group, start_ns,
+			     actual_dones >= normalized_budget);
 
 	return work_done;
 }
@@ -572,7 +737,10 @@ static void hif_exec_napi_kill(struct hif_exec_context *ctx)
 	int irq_ind;
 
 	if (ctx->inited) {
+		hrtimer_cancel(&n_ctx->mod.timer);
 		napi_disable(&n_ctx->napi);
+		hrtimer_cancel(&n_ctx->mod.timer);
+		qdf_atomic_clear_bit(HIF_EXEC_MOD_DEFERRED, &n_ctx->mod.flags);
 		ctx->inited = 0;
 	}
 
@@ -607,6 +775,8 @@ static struct hif_exec_context *hif_exec_napi_create(uint32_t scale)
 	qdf_net_if_create_dummy_if((struct qdf_net_if *)&ctx->netdev);
 	netif_napi_add(&(ctx->netdev), &(ctx->napi), hif_exec_poll,
 		       QCA_NAPI_BUDGET);
+	hrtimer_init(&ctx->mod.timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	ctx->mod.timer.function = hif_exec_mod_timer_fn;
 	napi_enable(&ctx->napi);
 
 	return &ctx->exec_ctx;
@@ -617,6 +787,15 @@ static struct hif_exec_context *hif_exec_napi_create(uint32_t scale)
 	HIF_WARN("%s: FEATURE_NAPI not defined, making tasklet", __func__);
 	return hif_exec_tasklet_create();
 }
+
+static inline bool hif_exec_mod_irq(struct hif_exec_context *ctx)
+{
+	return false;
+}
+
+static void hif_exec_mod_print_stats(struct HIF_CE_state *hif_state)
+{
+}
 #endif
 
 
@@ -800,7 +979,9 @@ irqreturn_t hif_ext_group_interrupt_handler(int irq, void *context)
 		 * in reality APSS didn't really suspend.
 		 */
 		hif_check_and_trigger_ut_resume(scn);
-		qdf_atomic_inc(&scn->active_grp_tasklet_cnt);
+		/* a parked group is still accounted as active */
+		if (!hif_exec_mod_irq(hif_ext_group))
+			qdf_atomic_inc(&scn->active_grp_tasklet_cnt);
 
 		hif_ext_group->sched_ops->schedule(hif_ext_group);
 	}
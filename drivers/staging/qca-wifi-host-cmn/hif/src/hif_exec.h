@@ -76,6 +76,9 @@ struct hif_execution_ops {
  * @force_break: flag to indicate if HIF execution context was forced to return
  *		 to HIF. This means there is more work to be done. Hence do not
  *		 call napi_complete.
+ * @load_poll_ns: time spent polling in the current load window
+ * @load_polls: polls in the current load window
+ * @load_full_polls: polls in the current load window that used up the budget
  */
 struct hif_exec_context {
 	struct hif_execution_ops *sched_ops;
@@ -108,6 +111,9 @@ struct hif_exec_context {
 	enum hif_exec_type type;
 	unsigned long long poll_start_time;
 	bool force_break;
+	unsigned long long load_poll_ns;
+	uint32_t load_polls;
+	uint32_t load_full_polls;
 #ifdef HIF_CPU_PERF_AFFINE_MASK
 	/* Stores the affinity hint mask for each WLAN IRQ */
 	qdf_cpu_mask new_cpu_mask[HIF_MAX_GRP_IRQ];
@@ -124,16 +130,44 @@ struct hif_tasklet_exec_context {
 	struct tasklet_struct tasklet;
 };
 
+/**
+ * struct hif_exec_moderation - adaptive budget and IRQ moderation state
+ * @timer: re-polls the group instead of re-enabling its IRQ
+ * @flags: HIF_EXEC_MOD_DEFERRED while the group is parked on @timer
+ * @ewma_work: moving average of work done per poll, scaled by 8
+ * @budget: internal budget used for the next poll
+ * @defers: consecutive polls that armed @timer
+ * @timer_polls: polls scheduled by @timer
+ * @irq_enables: polls that ended by re-enabling the IRQ
+ * @budget_clips: polls that ran with less than the NAPI budget
+ * @irq_steals: IRQs that fired while the group was parked on @timer
+ */
+struct hif_exec_moderation {
+	struct hrtimer timer;
+	unsigned long flags;
+	uint32_t ewma_work;
+	uint32_t budget;
+	uint32_t defers;
+	uint32_t timer_polls;
+	uint32_t irq_enables;
+	uint32_t budget_clips;
+	uint32_t irq_steals;
+};
+
+#define HIF_EXEC_MOD_DEFERRED 0
+
 /**
  * struct hif_napi_exec_context - exec_context for NAPI
  * @exec_ctx: inherited data type
  * @netdev: dummy net device associated with the napi context
  * @napi: napi structure used in scheduling
+ * @mod: adaptive budget and IRQ moderation state
  */
 struct hif_napi_exec_context {
 	struct hif_exec_context exec_ctx;
 	struct net_device    netdev; /* dummy net_dev */
 	struct napi_struct   napi;
+	struct hif_exec_moderation mod;
 };
 
 static inline struct hif_napi_exec_context*
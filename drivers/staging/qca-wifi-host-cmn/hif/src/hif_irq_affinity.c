@@ -33,10 +33,14 @@
 #include <linux/interrupt.h>
 #include <linux/irq.h>
 #include <linux/pm.h>
+#include <linux/moduleparam.h>
+#include <linux/sched/clock.h>
+#include <linux/sched/stat.h>
 #include <hif_napi.h>
 #include <hif_irq_affinity.h>
 #include <hif_exec.h>
 #include <hif_main.h>
+#include "qdf_module.h"
 
 #if defined(FEATURE_NAPI_DEBUG) && defined(HIF_IRQ_AFFINITY)
 /*
@@ -421,6 +425,290 @@ int hif_exec_cpu_migrate(struct qca_napi_data *napid, int cpu, int action)
 	return rc;
 }
 
+#ifdef HIF_IRQ_AFFINITY
+/*
+ * Load-aware placement
+ *
+ * In high throughput mode the contexts are dispersed over the big cluster
+ * by count only. On top of that, every HNC_LOAD_WINDOW_MS the contexts are
+ * re-placed from what was measured in the last window: the share of the
+ * window each context spent polling, whether its polls kept using up the
+ * budget, and the WALT busy % of each CPU less what our contexts used.
+ *
+ * - a hot context is moved off a CPU that is busy with something else,
+ *   typically the foreground app's UI or render thread
+ * - when several contexts on one CPU are at budget, all but one are spread
+ *   over the other big cores
+ *
+ * A move must land on a CPU that ends up less loaded than the source by
+ * more than HNC_LOAD_MARGIN_PCT, so that contexts do not bounce.
+ */
+#define HNC_LOAD_HOT_PCT	20
+#define HNC_LOAD_CONTENDED_PCT	50
+#define HNC_LOAD_MARGIN_PCT	10
+
+static bool hif_napi_load_aware = true;
+qdf_declare_param(hif_napi_load_aware, bool);
+
+static struct {
+	uint32_t rebalances;
+	uint32_t migrations;
+	uint32_t contended;
+	uint32_t spread;
+	uint32_t no_dest;
+} hnc_load_stats;
+
+static int hnc_load_stats_get(char *buf, const struct kernel_param *kp)
+{
+	return scnprintf(buf, PAGE_SIZE,
+			 "rebalances=%u migrations=%u contended=%u spread=%u no_dest=%u\n",
+			 hnc_load_stats.rebalances, hnc_load_stats.migrations,
+			 hnc_load_stats.contended, hnc_load_stats.spread,
+			 hnc_load_stats.no_dest);
+}
+
+static const struct kernel_param_ops hnc_load_stats_ops = {
+	.get = hnc_load_stats_get,
+};
+module_param_cb(hif_napi_place_stats, &hnc_load_stats_ops, NULL, 0444);
+
+struct hnc_cpu_load {
+	uint32_t own;
+	uint32_t other;
+	uint32_t at_budget;
+};
+
+/* only touched under napid->lock */
+static struct hnc_cpu_load hnc_cpu_load[NR_CPUS];
+
+static unsigned long long hnc_exec_window_start;
+static unsigned long hnc_exec_window_end;
+
+/**
+ * hnc_load_aware() - whether load-aware placement is in charge
+ * @napid: pointer to NAPI block
+ *
+ * Only in high throughput mode, where the IRQs are blacklisted and the
+ * placement is ours.
+ *
+ * Return: true if contexts should be re-placed by load
+ */
+bool hnc_load_aware(struct qca_napi_data *napid)
+{
+	return hif_napi_load_aware && napid->napi_mode == QCA_NAPI_TPUT_HI;
+}
+
+uint32_t hnc_load_pct(unsigned long long busy_ns,
+		      unsigned long long window_ns)
+{
+	if (!window_ns || busy_ns >= window_ns)
+		return window_ns ? 100 : 0;
+
+	return (uint32_t)div64_u64(busy_ns * 100, window_ns);
+}
+
+void hnc_load_stats_print(void)
+{
+	qdf_debug("NAPI placement: rebalances=%u migrations=%u contended=%u spread=%u no_dest=%u",
+		  hnc_load_stats.rebalances, hnc_load_stats.migrations,
+		  hnc_load_stats.contended, hnc_load_stats.spread,
+		  hnc_load_stats.no_dest);
+}
+
+/**
+ * hnc_load_dest_cpu() - finds a less loaded big core for a context
+ * @napid: pointer to NAPI block
+ * @src: CPU the context is on
+ * @pct: load of the context
+ * @spread: the context is being spread, avoid cores with at-budget contexts
+ *
+ * Return: >=0 : index in the cpu topology table
+ *          < 0 : no CPU is enough of an improvement
+ */
+static int hnc_load_dest_cpu(struct qca_napi_data *napid, int src,
+			     uint32_t pct, bool spread)
+{
+	struct hnc_cpu_load *cl = hnc_cpu_load;
+	uint32_t limit, score;
+	int i, dest = -1;
+
+	limit = cl[src].own + cl[src].other;
+	if (limit <= HNC_LOAD_MARGIN_PCT)
+		return -1;
+	limit -= HNC_LOAD_MARGIN_PCT;
+
+	for (i = napid->bigcl_head; i >= 0;
+	     i = napid->napi_cpu[i].cluster_nxt) {
+		if (i == src || napid->napi_cpu[i].state != QCA_NAPI_CPU_UP)
+			continue;
+		if (napid->user_cpu_affin_mask &&
+		    !((1 << i) & napid->user_cpu_affin_mask))
+			continue;
+		if (cl[i].other >= HNC_LOAD_CONTENDED_PCT)
+			continue;
+		if (spread && cl[i].at_budget)
+			continue;
+
+		score = cl[i].own + cl[i].other + pct;
+		if (score < limit) {
+			limit = score;
+			dest = i;
+		}
+	}
+
+	return dest;
+}
+
+/**
+ * hnc_load_balance() - re-place contexts by their measured load
+ * @napid: pointer to NAPI block
+ * @smp: load of each context in the last window
+ * @num: number of entries in @smp
+ * @migrate: moves a context to a CPU
+ *
+ * Note that this function is called with napid->lock acquired already.
+ *
+ * Return: None
+ */
+void hnc_load_balance(struct qca_napi_data *napid,
+		      struct hnc_load_sample *smp, int num,
+		      hnc_migrate_fn migrate)
+{
+	struct hnc_cpu_load *cl = hnc_cpu_load;
+	unsigned int busy;
+	int i, cpu, dest;
+	bool spread;
+
+	hnc_load_stats.rebalances++;
+
+	memset(cl, 0, sizeof(hnc_cpu_load));
+	for (i = 0; i < num; i++) {
+		cl[smp[i].cpu].own += smp[i].pct;
+		if (smp[i].at_budget)
+			cl[smp[i].cpu].at_budget++;
+	}
+	for_each_online_cpu(cpu) {
+		busy = sched_get_cpu_util(cpu);
+		cl[cpu].other = busy > cl[cpu].own ? busy - cl[cpu].own : 0;
+	}
+
+	for (i = 0; i < num; i++) {
+		cpu = smp[i].cpu;
+		if (smp[i].pct < HNC_LOAD_HOT_PCT)
+			continue;
+
+		if (cl[cpu].other >= HNC_LOAD_CONTENDED_PCT)
+			spread = false;
+		else if (smp[i].at_budget && cl[cpu].at_budget > 1)
+			spread = true;
+		else
+			continue;
+
+		dest = hnc_load_dest_cpu(napid, cpu, smp[i].pct, spread);
+		if (dest < 0) {
+			hnc_load_stats.no_dest++;
+			continue;
+		}
+
+		NAPI_DEBUG("%s: moving ctx %d cpu %d -> %d (%u%%, %s)",
+			   __func__, smp[i].id, cpu, dest, smp[i].pct,
+			   spread ? "spread" : "contended");
+		if (migrate(napid, smp[i].id, dest))
+			continue;
+
+		cl[cpu].own -= smp[i].pct;
+		cl[dest].own += smp[i].pct;
+		if (smp[i].at_budget) {
+			cl[cpu].at_budget--;
+			cl[dest].at_budget++;
+		}
+		smp[i].cpu = dest;
+
+		hnc_load_stats.migrations++;
+		if (spread)
+			hnc_load_stats.spread++;
+		else
+			hnc_load_stats.contended++;
+	}
+}
+
+static int hncm_exec_load_migrate(struct qca_napi_data *napid, int id,
+				  int didx)
+{
+	return hncm_exec_migrate_to(napid, id, didx);
+}
+
+/**
+ * hif_exec_load_balance() - close the load window of the exec contexts
+ * @napid: pointer to NAPI block
+ *
+ * Return: None
+ */
+static void hif_exec_load_balance(struct qca_napi_data *napid)
+{
+	struct hnc_load_sample smp[HIF_MAX_GROUP];
+	struct hif_exec_context *ctx;
+	unsigned long long now, window;
+	int i, num = 0;
+
+	qdf_spin_lock_bh(&napid->lock);
+	/* another CPU may have closed the window meanwhile */
+	if (!time_after(jiffies, hnc_exec_window_end))
+		goto out;
+
+	now = sched_clock();
+	window = now - hnc_exec_window_start;
+	hnc_exec_window_start = now;
+	hnc_exec_window_end = jiffies + msecs_to_jiffies(HNC_LOAD_WINDOW_MS);
+
+	for (i = 0; i < HIF_MAX_GROUP; i++) {
+		if (!(napid->exec_map & (0x01 << i)))
+			continue;
+
+		ctx = hif_exec_get_ctx(&napid->hif_softc->osc, i);
+		if (!ctx)
+			continue;
+
+		if (ctx->cpu < NR_CPUS) {
+			smp[num].id = i;
+			smp[num].cpu = ctx->cpu;
+			smp[num].pct = hnc_load_pct(ctx->load_poll_ns, window);
+			smp[num].at_budget = ctx->load_polls &&
+				ctx->load_full_polls * 2 >= ctx->load_polls;
+			num++;
+		}
+		ctx->load_poll_ns = 0;
+		ctx->load_polls = 0;
+		ctx->load_full_polls = 0;
+	}
+
+	/* a stale window (idle, or the first one) says nothing */
+	if (window > 2ULL * HNC_LOAD_WINDOW_MS * NSEC_PER_MSEC)
+		goto out;
+
+	hnc_load_balance(napid, smp, num, hncm_exec_load_migrate);
+out:
+	qdf_spin_unlock_bh(&napid->lock);
+}
+
+void hif_exec_load_sample(struct hif_exec_context *ctx,
+			  unsigned long long start_ns, bool full)
+{
+	struct qca_napi_data *napid = &HIF_GET_SOFTC(ctx->hif)->napi_data;
+
+	ctx->load_poll_ns += sched_clock() - start_ns;
+	ctx->load_polls++;
+	if (full)
+		ctx->load_full_polls++;
+
+	if (!hnc_load_aware(napid) ||
+	    !time_after(jiffies, READ_ONCE(hnc_exec_window_end)))
+		return;
+
+	hif_exec_load_balance(napid);
+}
+#endif /* HIF_IRQ_AFFINITY */
+
 
 /**
  * hif_exec_bl_irq() - calls irq_modify_status to enable/disable blacklisting
@@ -36,11 +36,51 @@ int hif_exec_cpu_migrate(struct qca_napi_data *napid, int cpu, int action);
 int hif_exec_cpu_blacklist(struct qca_napi_data *napid,
 			   enum qca_blacklist_op op);
 
+struct hif_exec_context;
+
+/**
+ * struct hnc_load_sample - load of one NAPI/exec context in a window
+ * @id: CE id or exec group id of the context
+ * @cpu: CPU the context is currently placed on
+ * @pct: share of the window spent polling, in percent
+ * @at_budget: most polls in the window used up the budget
+ */
+struct hnc_load_sample {
+	int id;
+	int cpu;
+	uint32_t pct;
+	bool at_budget;
+};
+
+typedef int (*hnc_migrate_fn)(struct qca_napi_data *napid, int id, int didx);
+
 #ifdef HIF_IRQ_AFFINITY
 int hif_exec_event(struct hif_opaque_softc     *hif,
 		   enum  qca_napi_event event,
 		   void                *data);
 
+/* load-aware placement, see hif_irq_affinity.c */
+#define HNC_LOAD_WINDOW_MS 100
+
+bool hnc_load_aware(struct qca_napi_data *napid);
+uint32_t hnc_load_pct(unsigned long long busy_ns,
+		      unsigned long long window_ns);
+void hnc_load_balance(struct qca_napi_data *napid,
+		      struct hnc_load_sample *smp, int num,
+		      hnc_migrate_fn migrate);
+void hnc_load_stats_print(void);
+
+/**
+ * hif_exec_load_sample() - account one poll of an exec context
+ * @ctx: the exec context
+ * @start_ns: sched_clock() at the start of the poll
+ * @full: the poll used up its budget
+ *
+ * Return: None
+ */
+void hif_exec_load_sample(struct hif_exec_context *ctx,
+			  unsigned long long start_ns, bool full);
+
 
 /* hif_irq_affinity_remove() - remove affinity before freeing the irq
  * @os_irq: irq number to remove affinity from
@@ -54,6 +94,20 @@ static inline void hif_irq_affinity_remove(int os_irq)
 {
 }
 
+static inline bool hnc_load_aware(struct qca_napi_data *napid)
+{
+	return false;
+}
+
+static inline void hnc_load_stats_print(void)
+{
+}
+
+static inline void hif_exec_load_sample(struct hif_exec_context *ctx,
+					unsigned long long start_ns, bool full)
+{
+}
+
 static inline int hif_exec_event(struct hif_opaque_softc     *hif,
 		   enum  qca_napi_event event,
 		   void                *data)
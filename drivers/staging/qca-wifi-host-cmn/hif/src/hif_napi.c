@@ -56,6 +56,17 @@ enum napi_decision_vector {
 };
 #define ENABLE_NAPI_MASK (HIF_NAPI_INITED | HIF_NAPI_CONF_UP)
 
+#ifdef HIF_IRQ_AFFINITY
+static void hif_napi_load_sample(struct qca_napi_data *napid, int ce_id,
+				 unsigned long long start_ns, bool full);
+#else
+static inline void hif_napi_load_sample(struct qca_napi_data *napid,
+					int ce_id, unsigned long long start_ns,
+					bool full)
+{
+}
+#endif
+
 #ifdef RECEIVE_OFFLOAD
 /**
  * hif_rxthread_napi_poll() - dummy napi poll for rx_thread NAPI
@@ -426,6 +437,9 @@ void *hif_napi_get_lro_info(struct hif_opaque_softc *hif_hdl, int napi_id)
 	struct qca_napi_info *napii;
 
 	napid = &(scn->napi_data);
+	if (NAPI_ID2PIPE(napi_id) < 0 || NAPI_ID2PIPE(napi_id) >= CE_COUNT_MAX)
+		return 0;
+
 	napii = napid->napis[NAPI_ID2PIPE(napi_id)];
 
 	if (napii)
@@ -900,6 +914,7 @@ int hif_napi_poll(struct hif_opaque_softc *hif_ctx,
 	struct hif_softc      *hif = HIF_GET_SOFTC(hif_ctx);
 	struct qca_napi_info *napi_info;
 	struct CE_state *ce_state = NULL;
+	unsigned long long start_ns = sched_clock();
 
 	if (unlikely(!hif)) {
 		HIF_ERROR("%s: hif context is NULL", __func__);
@@ -993,6 +1008,9 @@ int hif_napi_poll(struct hif_opaque_softc *hif_ctx,
 	hif_record_ce_desc_event(hif, NAPI_ID2PIPE(napi_info->id),
 				 NAPI_POLL_EXIT, NULL, NULL, normalized, 0);
 
+	hif_napi_load_sample(&hif->napi_data, NAPI_ID2PIPE(napi_info->id),
+			     start_ns, normalized >= budget);
+
 	NAPI_DEBUG("%s <--[normalized=%d]", __func__, normalized);
 	return normalized;
 out:
@@ -1104,6 +1122,7 @@ void hif_napi_stats(struct qca_napi_data *napid)
 			  cpu[i].max_freq, cpu[i].napis,
 			  cpu[i].cluster_nxt);
 	}
+	hnc_load_stats_print();
 }
 
 #ifdef FEATURE_NAPI_DEBUG
@@ -1643,6 +1662,93 @@ int hif_napi_cpu_migrate(struct qca_napi_data *napid, int cpu, int action)
 	return rc;
 }
 
+/*
+ * Load-aware placement of the CE NAPIs, see hnc_load_balance(). The
+ * per-CE accounting lives here as qca_napi_info is shared with hosts
+ * that do no such placement.
+ */
+static struct {
+	unsigned long long poll_ns;
+	uint32_t polls;
+	uint32_t full_polls;
+} hnc_ce_load[CE_COUNT_MAX];
+
+static unsigned long long hnc_ce_window_start;
+static unsigned long hnc_ce_window_end;
+
+static int hncm_load_migrate(struct qca_napi_data *napid, int id, int didx)
+{
+	return hncm_migrate_to(napid, id, didx);
+}
+
+/**
+ * hif_napi_load_balance() - close the load window of the CE NAPIs
+ * @napid: pointer to NAPI block
+ *
+ * Return: None
+ */
+static void hif_napi_load_balance(struct qca_napi_data *napid)
+{
+	struct hnc_load_sample smp[CE_COUNT_MAX];
+	unsigned long long now, window;
+	int i, num = 0;
+
+	qdf_spin_lock_bh(&napid->lock);
+	/* another CPU may have closed the window meanwhile */
+	if (!time_after(jiffies, hnc_ce_window_end))
+		goto out;
+
+	now = sched_clock();
+	window = now - hnc_ce_window_start;
+	hnc_ce_window_start = now;
+	hnc_ce_window_end = jiffies + msecs_to_jiffies(HNC_LOAD_WINDOW_MS);
+
+	for (i = 0; i < CE_COUNT_MAX; i++) {
+		if (!(napid->ce_map & (0x01 << i)) || !napid->napis[i])
+			continue;
+
+		if (napid->napis[i]->cpu < NR_CPUS) {
+			smp[num].id = i;
+			smp[num].cpu = napid->napis[i]->cpu;
+			smp[num].pct = hnc_load_pct(hnc_ce_load[i].poll_ns,
+						    window);
+			smp[num].at_budget = hnc_ce_load[i].polls &&
+				hnc_ce_load[i].full_polls * 2 >=
+				hnc_ce_load[i].polls;
+			num++;
+		}
+		hnc_ce_load[i].poll_ns = 0;
+		hnc_ce_load[i].polls = 0;
+		hnc_ce_load[i].full_polls = 0;
+	}
+
+	/* a stale window (idle, or the first one) says nothing */
+	if (window > 2ULL * HNC_LOAD_WINDOW_MS * NSEC_PER_MSEC)
+		goto out;
+
+	hnc_load_balance(napid, smp, num, hncm_load_migrate);
+out:
+	qdf_spin_unlock_bh(&napid->lock);
+}
+
+static void hif_napi_load_sample(struct qca_napi_data *napid, int ce_id,
+				 unsigned long long start_ns, bool full)
+{
+	if (ce_id < 0 || ce_id >= CE_COUNT_MAX)
+		return;
+
+	hnc_ce_load[ce_id].poll_ns += sched_clock() - start_ns;
+	hnc_ce_load[ce_id].polls++;
+	if (full)
+		hnc_ce_load[ce_id].full_polls++;
+
+	if (!hnc_load_aware(napid) ||
+	    !time_after(jiffies, READ_ONCE(hnc_ce_window_end)))
+		return;
+
+	hif_napi_load_balance(napid);
+}
+
 
 /**
  * hif_napi_bl_irq() - calls irq_modify_status to enable/disable blacklisting
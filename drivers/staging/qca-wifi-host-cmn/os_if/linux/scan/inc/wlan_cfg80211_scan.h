@@ -33,6 +33,7 @@
 #include <qdf_types.h>
 #include <wlan_scan_ucfg_api.h>
 #include <wlan_mgmt_txrx_utils_api.h>
+#include <linux/hashtable.h>
 
 /* Max number of scans allowed from userspace */
 #define WLAN_MAX_SCAN_COUNT 8
@@ -75,6 +76,10 @@ typedef struct {
 	u16 seq_ctrl;
 } __attribute__ ((packed)) qcom_ie_age;
 
+/* Buckets (log2) and size of the index of BSSes informed to cfg80211 */
+#define OSIF_SCAN_BSS_IDX_BITS 7
+#define OSIF_SCAN_BSS_IDX_MAX 1024
+
 /**
  * struct osif_scan_pdev - OS scan private strcutre
  * scan_req_q: Scan request queue
@@ -82,6 +87,12 @@ typedef struct {
  * req_id: Scan request Id
  * runtime_pm_lock: Runtime suspend lock
  * scan_wake_lock: Scan wake lock
+ * bss_idx: BSSes informed to cfg80211, hashed on BSSID
+ * bss_idx_lock: Protect bss_idx
+ * bss_idx_cnt: Number of entries in bss_idx
+ * bss_idx_full: Frames not indexed since the last prune as bss_idx was full
+ * bss_informed: Frames informed to cfg80211
+ * bss_skipped: Frames found unchanged and not informed again
  */
 struct osif_scan_pdev{
 	qdf_list_t scan_req_q;
@@ -89,6 +100,12 @@ struct osif_scan_pdev{
 	wlan_scan_requester req_id;
 	qdf_runtime_lock_t runtime_pm_lock;
 	qdf_wake_lock_t scan_wake_lock;
+	DECLARE_HASHTABLE(bss_idx, OSIF_SCAN_BSS_IDX_BITS);
+	qdf_spinlock_t bss_idx_lock;
+	uint32_t bss_idx_cnt;
+	uint32_t bss_idx_full;
+	uint32_t bss_informed;
+	uint32_t bss_skipped;
 };
 
 /*
@@ -280,6 +297,35 @@ wlan_cfg80211_inform_bss_frame_data(struct wiphy *wiphy,
 void wlan_cfg80211_inform_bss_frame(struct wlan_objmgr_pdev *pdev,
 	struct scan_cache_entry *scan_params);
 
+/**
+ * typedef wlan_cfg80211_bss_changed_cb - callback for a changed BSS
+ * @arg: argument passed to wlan_cfg80211_scan_bss_changed()
+ * @bssid: BSSID of the changed entry
+ * @freq: channel frequency of the changed entry
+ *
+ * Called with the BSS index lock held, so it must not sleep.
+ */
+typedef void (*wlan_cfg80211_bss_changed_cb)(void *arg,
+					     struct qdf_mac_addr *bssid,
+					     uint32_t freq);
+
+/**
+ * wlan_cfg80211_scan_bss_changed() - find BSSes changed since a point in time
+ * @pdev: Pointer to pdev
+ * @since: time stamp, in qdf_get_time_of_the_day_ms() units
+ * @cb: called for every BSS whose IEs or RSSI changed since @since, or NULL
+ * @arg: argument to @cb
+ *
+ * Walks the BSSID index of what was informed to cfg80211, so the scan DB
+ * does not have to be copied to find out what a scan brought in.
+ *
+ * Return: number of changed BSSes
+ */
+uint32_t wlan_cfg80211_scan_bss_changed(struct wlan_objmgr_pdev *pdev,
+					qdf_time_t since,
+					wlan_cfg80211_bss_changed_cb cb,
+					void *arg);
+
 /**
  * __wlan_cfg80211_unlink_bss_list() - flush bss from the kernel cache
  * @wiphy: wiphy
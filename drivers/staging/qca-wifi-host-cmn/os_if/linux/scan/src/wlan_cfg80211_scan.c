@@ -35,6 +35,7 @@
 #include <wlan_cfg80211_scan.h>
 #include <qdf_mem.h>
 #include <wlan_utility.h>
+#include <linux/jhash.h>
 #include "cfg_ucfg_api.h"
 #ifdef WLAN_POLICY_MGR_ENABLE
 #include <wlan_policy_mgr_api.h>
@@ -648,6 +649,301 @@ wlan_copy_bssid_scan_request(struct scan_start_request *scan_req,
 }
 #endif
 
+/*
+ * BSS index
+ *
+ * Every beacon and probe response that reaches the scan DB is informed to
+ * cfg80211, which copies the frame, parses its IEs and updates its own BSS
+ * tree under a global lock. In dense environments an AP is heard many times
+ * per scan with the same content. The index below, hashed on BSSID, keeps a
+ * signature of what was last informed for each BSS so that repeats are
+ * dropped. An entry is refreshed at least once per generation, which moves
+ * on with every scan started and every BSS unlinked from cfg80211, and at
+ * least every OSIF_SCAN_BSS_HOLD_MS. The index also records when each BSS
+ * was last seen and last changed, which answers scan completion and
+ * wlan_cfg80211_scan_bss_changed() without copying the scan DB.
+ */
+#define OSIF_SCAN_BSS_HOLD_MS 5000
+/* Entries not heard for this long are pruned at scan completion */
+#define OSIF_SCAN_BSS_AGE_MS 60000
+/* RSSI change, in dB, that is always reported to cfg80211 */
+#define OSIF_SCAN_BSS_RSSI_DELTA 5
+
+/**
+ * struct osif_scan_bss - entry of the BSS index
+ * @node: hash bucket linkage
+ * @bssid: BSSID
+ * @freq: channel frequency
+ * @probe_resp: entry tracks probe responses rather than beacons
+ * @informed: the last frame seen was informed to cfg80211
+ * @gen: index generation at the last inform
+ * @sig: hash over the capability and IEs that are stable across frames
+ * @rssi: RSSI at the last inform
+ * @informed_ts: time of the last inform
+ * @seen_ts: time the BSS was last heard
+ * @changed_ts: time the signature or RSSI last changed
+ */
+struct osif_scan_bss {
+	struct hlist_node node;
+	struct qdf_mac_addr bssid;
+	uint32_t freq;
+	bool probe_resp;
+	bool informed;
+	uint32_t gen;
+	uint32_t sig;
+	int32_t rssi;
+	qdf_time_t informed_ts;
+	qdf_time_t seen_ts;
+	qdf_time_t changed_ts;
+};
+
+/* The age IE has to be refreshed on every frame */
+#ifdef WLAN_ENABLE_AGEIE_ON_SCAN_RESULTS
+static bool osif_scan_bss_dedup;
+#else
+static bool osif_scan_bss_dedup = true;
+#endif
+qdf_declare_param(osif_scan_bss_dedup, bool);
+
+static qdf_atomic_t osif_scan_bss_gen;
+
+static void wlan_cfg80211_bss_idx_new_gen(void)
+{
+	qdf_atomic_inc(&osif_scan_bss_gen);
+}
+
+static void wlan_cfg80211_bss_idx_init(struct osif_scan_pdev *scan_priv)
+{
+	hash_init(scan_priv->bss_idx);
+	qdf_spinlock_create(&scan_priv->bss_idx_lock);
+}
+
+static void wlan_cfg80211_bss_idx_deinit(struct osif_scan_pdev *scan_priv)
+{
+	struct osif_scan_bss *entry;
+	struct hlist_node *tmp;
+	int bkt;
+
+	qdf_spin_lock_bh(&scan_priv->bss_idx_lock);
+	hash_for_each_safe(scan_priv->bss_idx, bkt, tmp, entry, node) {
+		hash_del(&entry->node);
+		qdf_mem_free(entry);
+	}
+	scan_priv->bss_idx_cnt = 0;
+	qdf_spin_unlock_bh(&scan_priv->bss_idx_lock);
+	qdf_spinlock_destroy(&scan_priv->bss_idx_lock);
+}
+
+static uint32_t wlan_cfg80211_bss_key(const uint8_t *bssid, uint32_t freq)
+{
+	return jhash(bssid, QDF_MAC_ADDR_SIZE, freq);
+}
+
+/* TIM and BSS load change between otherwise identical frames */
+static uint32_t wlan_cfg80211_bss_sig(struct ieee80211_mgmt *mgmt,
+				      uint32_t len)
+{
+	uint32_t off = offsetof(struct ieee80211_mgmt, u.beacon.variable);
+	const uint8_t *ie;
+	uint32_t sig;
+
+	if (len < off)
+		return 0;
+
+	sig = jhash(&mgmt->u.beacon.capab_info,
+		    sizeof(mgmt->u.beacon.capab_info), 0);
+	ie = mgmt->u.beacon.variable;
+	len -= off;
+	while (len >= 2 && ie[1] + 2 <= len) {
+		if (ie[0] != WLAN_EID_TIM && ie[0] != WLAN_EID_QBSS_LOAD)
+			sig = jhash(ie, ie[1] + 2, sig);
+		len -= ie[1] + 2;
+		ie += ie[1] + 2;
+	}
+
+	return sig;
+}
+
+static struct osif_scan_bss *
+wlan_cfg80211_bss_idx_find(struct osif_scan_pdev *scan_priv,
+			   const uint8_t *bssid, uint32_t freq,
+			   bool probe_resp)
+{
+	struct osif_scan_bss *entry;
+
+	hash_for_each_possible(scan_priv->bss_idx, entry, node,
+			       wlan_cfg80211_bss_key(bssid, freq)) {
+		if (entry->freq == freq && entry->probe_resp == probe_resp &&
+		    !qdf_mem_cmp(entry->bssid.bytes, bssid,
+				 QDF_MAC_ADDR_SIZE))
+			return entry;
+	}
+
+	return NULL;
+}
+
+/**
+ * wlan_cfg80211_bss_idx_update() - account a frame about to be informed
+ * @scan_priv: scan private data of the pdev
+ * @scan_params: scan entry built from the frame
+ *
+ * Return: true if cfg80211 already holds the same content and the inform
+ * can be skipped
+ */
+static bool wlan_cfg80211_bss_idx_update(struct osif_scan_pdev *scan_priv,
+					 struct scan_cache_entry *scan_params)
+{
+	struct ieee80211_mgmt *mgmt;
+	struct osif_scan_bss *entry;
+	uint32_t freq = scan_params->channel.chan_freq;
+	uint32_t gen = qdf_atomic_read(&osif_scan_bss_gen);
+	qdf_time_t now = qdf_get_time_of_the_day_ms();
+	bool probe_resp, skip = false;
+	uint32_t sig;
+
+	mgmt = (struct ieee80211_mgmt *)util_scan_entry_frame_ptr(scan_params);
+	probe_resp = ieee80211_is_probe_resp(mgmt->frame_control);
+	sig = wlan_cfg80211_bss_sig(mgmt,
+				    util_scan_entry_frame_len(scan_params));
+
+	qdf_spin_lock_bh(&scan_priv->bss_idx_lock);
+	entry = wlan_cfg80211_bss_idx_find(scan_priv, mgmt->bssid, freq,
+					   probe_resp);
+	if (!entry) {
+		if (scan_priv->bss_idx_cnt >= OSIF_SCAN_BSS_IDX_MAX) {
+			scan_priv->bss_idx_full++;
+			goto inform;
+		}
+
+		entry = qdf_mem_malloc_atomic(sizeof(*entry));
+		if (!entry)
+			goto inform;
+
+		qdf_mem_copy(entry->bssid.bytes, mgmt->bssid,
+			     QDF_MAC_ADDR_SIZE);
+		entry->freq = freq;
+		entry->probe_resp = probe_resp;
+		entry->changed_ts = now;
+		hash_add(scan_priv->bss_idx, &entry->node,
+			 wlan_cfg80211_bss_key(mgmt->bssid, freq));
+		scan_priv->bss_idx_cnt++;
+	} else if (entry->sig != sig ||
+		   abs(entry->rssi - scan_params->rssi_raw) >=
+		   OSIF_SCAN_BSS_RSSI_DELTA) {
+		entry->changed_ts = now;
+	} else if (osif_scan_bss_dedup && entry->informed &&
+		   entry->gen == gen &&
+		   now - entry->informed_ts < OSIF_SCAN_BSS_HOLD_MS) {
+		skip = true;
+	}
+
+	entry->seen_ts = now;
+	if (!skip) {
+		entry->sig = sig;
+		entry->rssi = scan_params->rssi_raw;
+		entry->gen = gen;
+		entry->informed = true;
+		entry->informed_ts = now;
+	}
+
+inform:
+	if (skip)
+		scan_priv->bss_skipped++;
+	else
+		scan_priv->bss_informed++;
+	qdf_spin_unlock_bh(&scan_priv->bss_idx_lock);
+
+	return skip;
+}
+
+/* cfg80211 did not take the frame, do not skip the next one */
+static void wlan_cfg80211_bss_idx_failed(struct osif_scan_pdev *scan_priv,
+					 struct scan_cache_entry *scan_params)
+{
+	struct ieee80211_mgmt *mgmt;
+	struct osif_scan_bss *entry;
+
+	mgmt = (struct ieee80211_mgmt *)util_scan_entry_frame_ptr(scan_params);
+
+	qdf_spin_lock_bh(&scan_priv->bss_idx_lock);
+	entry = wlan_cfg80211_bss_idx_find(scan_priv, mgmt->bssid,
+			scan_params->channel.chan_freq,
+			ieee80211_is_probe_resp(mgmt->frame_control));
+	if (entry)
+		entry->informed = false;
+	qdf_spin_unlock_bh(&scan_priv->bss_idx_lock);
+}
+
+/**
+ * wlan_cfg80211_bss_idx_walk() - count index entries, prune stale ones
+ * @scan_priv: scan private data of the pdev
+ * @since: count BSSes seen, or changed if @changed, at or after this time
+ * @changed: count changed rather than seen BSSes
+ * @cb: called for every counted BSS, may be NULL
+ * @arg: argument to @cb
+ *
+ * A BSS tracked for both beacons and probe responses is counted once.
+ *
+ * Return: number of matching BSSes
+ */
+static uint32_t wlan_cfg80211_bss_idx_walk(struct osif_scan_pdev *scan_priv,
+					   qdf_time_t since, bool changed,
+					   wlan_cfg80211_bss_changed_cb cb,
+					   void *arg)
+{
+	struct osif_scan_bss *entry, *twin;
+	struct hlist_node *tmp;
+	qdf_time_t now = qdf_get_time_of_the_day_ms();
+	uint32_t count = 0;
+	int bkt;
+
+	qdf_spin_lock_bh(&scan_priv->bss_idx_lock);
+	hash_for_each_safe(scan_priv->bss_idx, bkt, tmp, entry, node) {
+		if (now - entry->seen_ts > OSIF_SCAN_BSS_AGE_MS) {
+			hash_del(&entry->node);
+			qdf_mem_free(entry);
+			scan_priv->bss_idx_cnt--;
+			continue;
+		}
+
+		if ((changed ? entry->changed_ts : entry->seen_ts) < since)
+			continue;
+
+		if (entry->probe_resp) {
+			twin = wlan_cfg80211_bss_idx_find(scan_priv,
+							  entry->bssid.bytes,
+							  entry->freq, false);
+			if (twin && (changed ? twin->changed_ts :
+				     twin->seen_ts) >= since)
+				continue;
+		}
+
+		count++;
+		if (cb)
+			cb(arg, &entry->bssid, entry->freq);
+	}
+	scan_priv->bss_idx_full = 0;
+	qdf_spin_unlock_bh(&scan_priv->bss_idx_lock);
+
+	return count;
+}
+
+uint32_t wlan_cfg80211_scan_bss_changed(struct wlan_objmgr_pdev *pdev,
+					qdf_time_t since,
+					wlan_cfg80211_bss_changed_cb cb,
+					void *arg)
+{
+	struct pdev_osif_priv *osif_priv = wlan_pdev_get_ospriv(pdev);
+
+	if (!osif_priv || !osif_priv->osif_scan)
+		return 0;
+
+	return wlan_cfg80211_bss_idx_walk(osif_priv->osif_scan, since, true,
+					  cb, arg);
+}
+
+qdf_export_symbol(wlan_cfg80211_scan_bss_changed);
+
 /**
  * wlan_schedule_scan_start_request() - Schedule scan start request
  * @pdev: pointer to pdev object
@@ -690,6 +986,7 @@ wlan_schedule_scan_start_request(struct wlan_objmgr_pdev *pdev,
 	if (qdf_list_size(&osif_scan->scan_req_q) < WLAN_MAX_SCAN_COUNT) {
 		status = ucfg_scan_start(scan_start_req);
 		if (QDF_IS_STATUS_SUCCESS(status)) {
+			wlan_cfg80211_bss_idx_new_gen();
 			qdf_list_insert_back(&osif_scan->scan_req_q,
 					     &scan_req->node);
 		} else {
@@ -974,6 +1271,8 @@ static
 uint32_t wlan_scan_get_bss_count_for_scan(struct wlan_objmgr_pdev *pdev,
 					  qdf_time_t scan_start_ts)
 {
+	struct pdev_osif_priv *osif_priv = wlan_pdev_get_ospriv(pdev);
+	struct osif_scan_pdev *scan_priv = osif_priv->osif_scan;
 	struct scan_filter *filter;
 	qdf_list_t *list = NULL;
 	uint32_t count = 0;
@@ -981,6 +1280,11 @@ uint32_t wlan_scan_get_bss_count_for_scan(struct wlan_objmgr_pdev *pdev,
 	if (!scan_start_ts)
 		return count;
 
+	/* The index is complete unless it overflowed during the scan */
+	if (!scan_priv->bss_idx_full)
+		return wlan_cfg80211_bss_idx_walk(scan_priv, scan_start_ts,
+						  false, NULL, NULL);
+
 	filter = qdf_mem_malloc(sizeof(*filter));
 	if (!filter)
 		return count;
@@ -1024,6 +1328,7 @@ static void wlan_cfg80211_scan_done_callback(
 	QDF_STATUS status;
 	qdf_time_t scan_start_timestamp = 0;
 	uint32_t unique_bss_count = 0;
+	uint32_t changed_bss_count = 0;
 
 	if (!event) {
 		osif_nofl_err("Invalid scan event received");
@@ -1076,13 +1381,24 @@ static void wlan_cfg80211_scan_done_callback(
 
 	wlan_objmgr_vdev_release_ref(vdev, WLAN_OSIF_ID);
 
+	wlan_cfg80211_bss_idx_new_gen();
 	unique_bss_count = wlan_scan_get_bss_count_for_scan(pdev,
 							  scan_start_timestamp);
-	osif_nofl_info("vdev %d, scan id %d type %s(%d) reason %s(%d) scan found %d bss",
+	if (scan_start_timestamp)
+		changed_bss_count =
+			wlan_cfg80211_scan_bss_changed(pdev,
+						       scan_start_timestamp,
+						       NULL, NULL);
+	osif_nofl_info("vdev %d, scan id %d type %s(%d) reason %s(%d) scan found %d bss, %d changed",
 		       event->vdev_id, scan_id,
 		       util_scan_get_ev_type_name(event->type), event->type,
 		       util_scan_get_ev_reason_name(event->reason),
-		       event->reason, unique_bss_count);
+		       event->reason, unique_bss_count, changed_bss_count);
+	osif_priv = wlan_pdev_get_ospriv(pdev);
+	osif_debug("bss index %u entries, %u informed, %u skipped",
+		   osif_priv->osif_scan->bss_idx_cnt,
+		   osif_priv->osif_scan->bss_informed,
+		   osif_priv->osif_scan->bss_skipped);
 allow_suspend:
 	osif_priv = wlan_pdev_get_ospriv(pdev);
 	qdf_mutex_acquire(&osif_priv->osif_scan->scan_req_q_lock);
@@ -1162,6 +1478,7 @@ QDF_STATUS wlan_cfg80211_scan_priv_init(struct wlan_objmgr_pdev *pdev)
 	qdf_list_create(&scan_priv->scan_req_q, WLAN_MAX_SCAN_COUNT);
 	qdf_mutex_create(&scan_priv->scan_req_q_lock);
 	qdf_wake_lock_create(&scan_priv->scan_wake_lock, "scan_wake_lock");
+	wlan_cfg80211_bss_idx_init(scan_priv);
 
 	return QDF_STATUS_SUCCESS;
 }
@@ -1177,6 +1494,7 @@ QDF_STATUS wlan_cfg80211_scan_priv_deinit(struct wlan_objmgr_pdev *pdev)
 
 	wlan_cfg80211_cleanup_scan_queue(pdev, NULL);
 	scan_priv = osif_priv->osif_scan;
+	wlan_cfg80211_bss_idx_deinit(scan_priv);
 	qdf_wake_lock_destroy(&scan_priv->scan_wake_lock);
 	qdf_mutex_destroy(&scan_priv->scan_req_q_lock);
 	qdf_list_destroy(&scan_priv->scan_req_q);
@@ -1975,6 +2293,10 @@ void wlan_cfg80211_inform_bss_frame(struct wlan_objmgr_pdev *pdev,
 
 	wiphy = pdev_ospriv->wiphy;
 
+	if (pdev_ospriv->osif_scan &&
+	    wlan_cfg80211_bss_idx_update(pdev_ospriv->osif_scan, scan_params))
+		return;
+
 	bss_data.frame_len = wlan_get_frame_len(scan_params);
 	bss_data.mgmt = qdf_mem_malloc_atomic(bss_data.frame_len);
 	if (!bss_data.mgmt) {
@@ -2020,11 +2342,14 @@ void wlan_cfg80211_inform_bss_frame(struct wlan_objmgr_pdev *pdev,
 		     WLAN_MGMT_TXRX_HOST_MAX_ANTENNA);
 
 	bss = wlan_cfg80211_inform_bss_frame_data(wiphy, &bss_data);
-	if (!bss)
+	if (!bss) {
 		osif_err("failed to inform bss "QDF_MAC_ADDR_FMT" seq %d",
 			 QDF_MAC_ADDR_REF(bss_data.mgmt->bssid),
 			 scan_params->seq_num);
-	else
+		if (pdev_ospriv->osif_scan)
+			wlan_cfg80211_bss_idx_failed(pdev_ospriv->osif_scan,
+						     scan_params);
+	} else
 		wlan_cfg80211_put_bss(wiphy, bss);
 
 	qdf_mem_free(bss_data.mgmt);
@@ -2060,6 +2385,9 @@ void __wlan_cfg80211_unlink_bss_list(struct wiphy *wiphy, uint8_t *bssid,
 {
 	struct cfg80211_bss *bss = NULL;
 
+	/* whatever the index holds may no longer be known to cfg80211 */
+	wlan_cfg80211_bss_idx_new_gen();
+
 	bss = wlan_cfg80211_get_bss(wiphy, NULL, bssid,
 				    ssid, ssid_len);
 	if (!bss) {
@@ -35,11 +35,15 @@
  * qdf_lro_desc_entry - defines the LRO descriptor
  * element stored in the list
  * @lro_node: node of the list
+ * @lru_node: node of the LRU list, while the descriptor is in use
  * @lro_desc: the LRO descriptor contained in this list entry
+ * @last_used: ticks at the last packet of the flow
  */
 struct qdf_lro_desc_entry {
 	struct list_head lro_node;
+	struct list_head lru_node;
 	struct net_lro_desc *lro_desc;
+	unsigned long last_used;
 };
 
 /**
@@ -65,44 +69,80 @@ struct qdf_lro_desc_table {
  * qdf_lro_desc_info - structure containing the LRO descriptor
  * information
  * @lro_hash_table: hash table used for a quick desc. look-up
- * @lro_hash_lock: lock to protect access to the hash table
+ * @lro_hash_mask: number of hash table entries - 1
  * @lro_desc_pool: Free pool of LRO descriptors
+ * @lro_lru_list: descriptors in use, least recently used first
  */
 struct qdf_lro_desc_info {
 	struct qdf_lro_desc_table *lro_hash_table;
+	uint32_t lro_hash_mask;
 	struct qdf_lro_desc_pool lro_desc_pool;
+	struct list_head lro_lru_list;
+};
+
+/**
+ * qdf_lro_stats - LRO statistics
+ * @pkts: packets given to LRO
+ * @delivered: packets delivered up the stack, aggregated or not
+ * @new_flows: descriptors allocated for new flows
+ * @evicted: flows flushed to make room for a new one
+ * @timed_out: flows flushed for being idle
+ * @no_desc: packets not aggregated for lack of a descriptor
+ */
+struct qdf_lro_stats {
+	uint64_t pkts;
+	uint64_t delivered;
+	uint32_t new_flows;
+	uint32_t evicted;
+	uint32_t timed_out;
+	uint32_t no_desc;
 };
 
 /**
  * qdf_lro_info_s - LRO information
  * @lro_mgr: LRO manager
  * @lro_desc_info: LRO descriptor information
- * @lro_mgr_arr_access_lock: Lock to access LRO manager array.
  * @lro_stats: LRO statistics
  */
 struct qdf_lro_s {
 	struct net_lro_mgr *lro_mgr;
 	struct qdf_lro_desc_info lro_desc_info;
+	struct qdf_lro_stats lro_stats;
 };
 
 typedef struct qdf_lro_s *__qdf_lro_ctx_t;
 
-/* LRO_DESC_TABLE_SZ must be a power of 2 */
-#define QDF_LRO_DESC_TABLE_SZ 16
-#define QDF_LRO_DESC_TABLE_SZ_MASK (QDF_LRO_DESC_TABLE_SZ - 1)
-#define QDF_LRO_DESC_POOL_SZ 10
+/*
+ * Flows tracked per LRO context by default, and the bounds of the
+ * qdf_lro_max_flows parameter. The hash table has twice as many entries,
+ * rounded up to a power of 2.
+ */
+#define QDF_LRO_DESC_POOL_SZ 32
+#define QDF_LRO_DESC_POOL_MIN 4
+#define QDF_LRO_DESC_POOL_MAX 128
 
-#define QDF_LRO_DESC_TABLE_SZ 16
-#define QDF_LRO_DESC_TABLE_SZ_MASK (QDF_LRO_DESC_TABLE_SZ - 1)
-#define QDF_LRO_DESC_POOL_SZ 10
+/* a flow that saw no packet for this long is flushed */
+#define QDF_LRO_FLUSH_TIMEOUT_MS 4
 
 #define QDF_LRO_MAX_AGGR_SIZE 100
 
+/**
+ * qdf_lro_display_stats() - print the statistics of an LRO context
+ * @lro_ctx: LRO context
+ *
+ * Return: none
+ */
+void qdf_lro_display_stats(__qdf_lro_ctx_t lro_ctx);
+
 #else
 
 struct qdf_lro_s {};
 
 typedef struct qdf_lro_s *__qdf_lro_ctx_t;
 
+static inline void qdf_lro_display_stats(__qdf_lro_ctx_t lro_ctx)
+{
+}
+
 #endif /* FEATURE_LRO */
 #endif /*_I_QDF_NET_BUF_H */
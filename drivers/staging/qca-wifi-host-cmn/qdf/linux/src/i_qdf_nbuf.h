@@ -169,6 +169,9 @@ typedef union {
  * @tx.dev.priv_cb_m.mgmt_desc_id: mgmt descriptor for tx completion cb
  * @tx.dev.priv_cb_m.dma_option.bi_map: flag to do bi-direction dma map
  * @tx.dev.priv_cb_m.dma_option.reserved: reserved bits for future use
+ * @tx.dev.priv_cb_m.xmit.more: the stack has more frames queued behind
+ *			this one, ring/doorbell update may be deferred
+ * @tx.dev.priv_cb_m.xmit.reserved: reserved bits for future use
  * @tx.dev.priv_cb_m.reserved: reserved
  *
  * @tx.ftype: mcast2ucast, TSO, SG, MESH
@@ -300,7 +303,11 @@ struct qdf_nbuf_cb {
 						uint8_t bi_map:1,
 							reserved:7;
 					} dma_option;
-					uint8_t reserved[3];
+					struct {
+						uint8_t more:1,
+							reserved:7;
+					} xmit;
+					uint8_t reserved[2];
 				} priv_cb_m;
 			} dev;
 			uint8_t ftype;
@@ -827,8 +834,6 @@ uint8_t __qdf_nbuf_data_get_ipv6_proto(uint8_t *data);
 int __qdf_nbuf_count_get(void);
 void __qdf_nbuf_count_inc(struct sk_buff *skb);
 void __qdf_nbuf_count_dec(struct sk_buff *skb);
-void __qdf_nbuf_mod_init(void);
-void __qdf_nbuf_mod_exit(void);
 
 #else
 
@@ -846,18 +851,11 @@ static inline void __qdf_nbuf_count_dec(struct sk_buff *skb)
 {
 	return;
 }
-
-static inline void __qdf_nbuf_mod_init(void)
-{
-	return;
-}
-
-static inline void __qdf_nbuf_mod_exit(void)
-{
-	return;
-}
 #endif
 
+void __qdf_nbuf_mod_init(void);
+void __qdf_nbuf_mod_exit(void);
+
 /**
  * __qdf_to_status() - OS to QDF status conversion
  * @error : OS error
@@ -22,12 +22,19 @@
  */
 
 #include <qdf_lro.h>
+#include <qdf_module.h>
+#include <qdf_time.h>
 #include <qdf_trace.h>
 #include <qdf_types.h>
 
 #include <linux/list.h>
+#include <linux/log2.h>
 #include <net/tcp.h>
 
+/* flows tracked per LRO context, takes effect for new contexts */
+static uint32_t qdf_lro_max_flows = QDF_LRO_DESC_POOL_SZ;
+qdf_declare_param(qdf_lro_max_flows, uint);
+
 /**
  * qdf_lro_desc_pool_init() - Initialize the free pool of LRO
  * descriptors
@@ -45,9 +52,10 @@ static void qdf_lro_desc_pool_init(struct qdf_lro_desc_pool *lro_desc_pool,
 
 	INIT_LIST_HEAD(&lro_desc_pool->lro_free_list_head);
 
-	for (i = 0; i < QDF_LRO_DESC_POOL_SZ; i++) {
+	for (i = 0; i < lro_mgr->max_desc; i++) {
 		lro_desc_pool->lro_desc_array[i].lro_desc =
 			 &lro_mgr->lro_arr[i];
+		INIT_LIST_HEAD(&lro_desc_pool->lro_desc_array[i].lru_node);
 		list_add_tail(&lro_desc_pool->lro_desc_array[i].lro_node,
 			 &lro_desc_pool->lro_free_list_head);
 	}
@@ -71,12 +79,13 @@ static void qdf_lro_desc_info_init(struct qdf_lro_s *qdf_info)
 		 qdf_info->lro_mgr);
 
 	/* Initialize the hash table of LRO desc.*/
-	for (i = 0; i < QDF_LRO_DESC_TABLE_SZ; i++) {
+	for (i = 0; i <= qdf_info->lro_desc_info.lro_hash_mask; i++) {
 		/* initialize the flows in the hash table */
 		INIT_LIST_HEAD(&qdf_info->lro_desc_info.
 			 lro_hash_table[i].lro_desc_list);
 	}
 
+	INIT_LIST_HEAD(&qdf_info->lro_desc_info.lro_lru_list);
 }
 
 /**
@@ -116,6 +125,11 @@ qdf_lro_ctx_t qdf_lro_init(void)
 	size_t lro_info_sz, lro_mgr_sz, desc_arr_sz, desc_pool_sz;
 	size_t hash_table_sz;
 	uint8_t *lro_mem_ptr;
+	uint32_t flows, table_sz;
+
+	flows = clamp_t(uint32_t, qdf_lro_max_flows, QDF_LRO_DESC_POOL_MIN,
+			QDF_LRO_DESC_POOL_MAX);
+	table_sz = roundup_pow_of_two(flows * 2);
 
 	/*
 	* Allocate all the LRO data structures at once and then carve
@@ -124,11 +138,11 @@ qdf_lro_ctx_t qdf_lro_init(void)
 	lro_info_sz = sizeof(struct qdf_lro_s);
 	lro_mgr_sz = sizeof(struct net_lro_mgr);
 	desc_arr_sz =
-		 (QDF_LRO_DESC_POOL_SZ * sizeof(struct net_lro_desc));
+		 (flows * sizeof(struct net_lro_desc));
 	desc_pool_sz =
-		 (QDF_LRO_DESC_POOL_SZ * sizeof(struct qdf_lro_desc_entry));
+		 (flows * sizeof(struct qdf_lro_desc_entry));
 	hash_table_sz =
-		 (sizeof(struct qdf_lro_desc_table) * QDF_LRO_DESC_TABLE_SZ);
+		 (sizeof(struct qdf_lro_desc_table) * table_sz);
 
 	lro_mem_ptr = qdf_mem_malloc(lro_info_sz + lro_mgr_sz + desc_arr_sz +
 					desc_pool_sz + hash_table_sz);
@@ -154,6 +168,8 @@ qdf_lro_ctx_t qdf_lro_init(void)
 	/* hash table to store the LRO descriptors */
 	lro_ctx->lro_desc_info.lro_hash_table =
 		 (struct qdf_lro_desc_table *)lro_mem_ptr;
+	lro_ctx->lro_desc_info.lro_hash_mask = table_sz - 1;
+	lro_ctx->lro_mgr->max_desc = flows;
 
 	/* Initialize the LRO descriptors */
 	qdf_lro_desc_info_init(lro_ctx);
@@ -165,7 +181,6 @@ qdf_lro_ctx_t qdf_lro_init(void)
 	lro_ctx->lro_mgr->max_aggr = QDF_LRO_MAX_AGGR_SIZE;
 	lro_ctx->lro_mgr->get_skb_header = qdf_lro_get_skb_header;
 	lro_ctx->lro_mgr->ip_summed = CHECKSUM_UNNECESSARY;
-	lro_ctx->lro_mgr->max_desc = QDF_LRO_DESC_POOL_SZ;
 
 	return lro_ctx;
 }
@@ -210,6 +225,49 @@ static inline bool qdf_lro_tcp_flow_match(struct net_lro_desc *lro_desc,
 
 }
 
+/**
+ * qdf_lro_desc_flush() - deliver a flow and free its descriptor
+ * @lro_ctx: LRO context
+ * @desc: LRO descriptor
+ *
+ * Return: none
+ */
+static void qdf_lro_desc_flush(struct qdf_lro_s *lro_ctx,
+	 struct net_lro_desc *desc)
+{
+	bool active = desc->active;
+
+	qdf_lro_desc_free(lro_ctx, desc);
+	if (active)
+		lro_flush_desc(lro_ctx->lro_mgr, desc);
+}
+
+/**
+ * qdf_lro_flush_idle() - flush the flows that went idle
+ * @lro_ctx: LRO context
+ *
+ * The LRU list is in order of last use, so this stops at the first flow
+ * that is recent enough.
+ *
+ * Return: none
+ */
+static void qdf_lro_flush_idle(struct qdf_lro_s *lro_ctx)
+{
+	struct qdf_lro_desc_entry *entry, *tmp;
+	unsigned long now = qdf_system_ticks();
+	unsigned long timeout =
+		 qdf_system_msecs_to_ticks(QDF_LRO_FLUSH_TIMEOUT_MS);
+
+	list_for_each_entry_safe(entry, tmp,
+		 &lro_ctx->lro_desc_info.lro_lru_list, lru_node) {
+		if (!qdf_system_time_after(now, entry->last_used + timeout))
+			break;
+
+		qdf_lro_desc_flush(lro_ctx, entry->lro_desc);
+		lro_ctx->lro_stats.timed_out++;
+	}
+}
+
 /**
  * qdf_lro_desc_find() - LRO descriptor look-up function
  *
@@ -222,7 +280,9 @@ static inline bool qdf_lro_tcp_flow_match(struct net_lro_desc *lro_desc,
  *
  * Look-up the LRO descriptor in the hash table based on the
  * flow ID toeplitz. If the flow is not found, allocates a new
- * LRO descriptor and places it in the hash table
+ * LRO descriptor and places it in the hash table. When all the
+ * descriptors are in use, the least recently used flow is
+ * flushed to make room.
  *
  * Return: 0 - success, < 0 - failure
  */
@@ -232,46 +292,47 @@ static int qdf_lro_desc_find(struct qdf_lro_s *lro_ctx,
 {
 	uint32_t i;
 	struct qdf_lro_desc_table *lro_hash_table;
-	struct list_head *ptr;
 	struct qdf_lro_desc_entry *entry;
 	struct qdf_lro_desc_pool *free_pool;
 	struct qdf_lro_desc_info *desc_info = &lro_ctx->lro_desc_info;
 
 	*lro_desc = NULL;
-	i = flow_hash & QDF_LRO_DESC_TABLE_SZ_MASK;
+	i = flow_hash & desc_info->lro_hash_mask;
 
 	lro_hash_table = &desc_info->lro_hash_table[i];
 
-	if (unlikely(!lro_hash_table)) {
-		QDF_TRACE(QDF_MODULE_ID_QDF, QDF_TRACE_LEVEL_ERROR,
-			 "Invalid hash entry");
-		QDF_ASSERT(0);
-		return -EINVAL;
-	}
-
 	/* Check if this flow exists in the descriptor list */
-	list_for_each(ptr, &lro_hash_table->lro_desc_list) {
-		struct net_lro_desc *tmp_lro_desc = NULL;
-
-		entry = list_entry(ptr, struct qdf_lro_desc_entry, lro_node);
-		tmp_lro_desc = entry->lro_desc;
-			if (qdf_lro_tcp_flow_match(entry->lro_desc, iph, tcph)) {
-				*lro_desc = entry->lro_desc;
-				return 0;
-			}
+	list_for_each_entry(entry, &lro_hash_table->lro_desc_list, lro_node) {
+		if (entry->lro_desc->active &&
+		    qdf_lro_tcp_flow_match(entry->lro_desc, iph, tcph)) {
+			entry->last_used = qdf_system_ticks();
+			list_move_tail(&entry->lru_node,
+				 &desc_info->lro_lru_list);
+			*lro_desc = entry->lro_desc;
+			return 0;
+		}
 	}
 
 	/* no existing flow found, a new LRO desc needs to be allocated */
+	qdf_lro_flush_idle(lro_ctx);
+
 	free_pool = &lro_ctx->lro_desc_info.lro_desc_pool;
-	entry = list_first_entry_or_null(
-		 &free_pool->lro_free_list_head,
-		 struct qdf_lro_desc_entry, lro_node);
-	if (unlikely(!entry)) {
-		QDF_TRACE(QDF_MODULE_ID_QDF, QDF_TRACE_LEVEL_ERROR,
-			 "Could not allocate LRO desc!");
-		return -ENOMEM;
+	if (list_empty(&free_pool->lro_free_list_head)) {
+		entry = list_first_entry_or_null(&desc_info->lro_lru_list,
+			 struct qdf_lro_desc_entry, lru_node);
+		if (unlikely(!entry)) {
+			QDF_TRACE(QDF_MODULE_ID_QDF, QDF_TRACE_LEVEL_ERROR,
+				 "Could not allocate LRO desc!");
+			lro_ctx->lro_stats.no_desc++;
+			return -ENOMEM;
+		}
+
+		qdf_lro_desc_flush(lro_ctx, entry->lro_desc);
+		lro_ctx->lro_stats.evicted++;
 	}
 
+	entry = list_first_entry(&free_pool->lro_free_list_head,
+		 struct qdf_lro_desc_entry, lro_node);
 	list_del_init(&entry->lro_node);
 
 	if (unlikely(!entry->lro_desc)) {
@@ -288,6 +349,9 @@ static int qdf_lro_desc_find(struct qdf_lro_s *lro_ctx,
 	 */
 	list_add_tail(&entry->lro_node,
 		 &lro_hash_table->lro_desc_list);
+	list_add_tail(&entry->lru_node, &desc_info->lro_lru_list);
+	entry->last_used = qdf_system_ticks();
+	lro_ctx->lro_stats.new_flows++;
 
 	*lro_desc = entry->lro_desc;
 	return 0;
@@ -344,6 +408,8 @@ bool qdf_lro_get_info(qdf_lro_ctx_t lro_ctx, qdf_nbuf_t nbuf,
 		return false;
 	}
 
+	lro_ctx->lro_stats.pkts++;
+
 	/* if this is not the first skb, check the timestamp option */
 	if (lro_desc->tcp_rcv_tsval) {
 		if (tcph->doff == 8) {
@@ -403,7 +469,7 @@ void qdf_lro_desc_free(qdf_lro_ctx_t lro_ctx,
 	arr_base = lro_mgr->lro_arr;
 	i = desc - arr_base;
 
-	if (unlikely(i >= QDF_LRO_DESC_POOL_SZ)) {
+	if (unlikely(i < 0 || i >= lro_mgr->max_desc)) {
 		QDF_TRACE(QDF_MODULE_ID_QDF, QDF_TRACE_LEVEL_ERROR,
 			 "invalid index %d", i);
 		return;
@@ -412,7 +478,12 @@ void qdf_lro_desc_free(qdf_lro_ctx_t lro_ctx,
 	desc_info =  &lro_ctx->lro_desc_info;
 	entry = &desc_info->lro_desc_pool.lro_desc_array[i];
 
+	/* one skb, aggregated or not, goes up for each flow freed */
+	if (!list_empty(&entry->lru_node))
+		lro_ctx->lro_stats.delivered++;
+
 	list_del_init(&entry->lro_node);
+	list_del_init(&entry->lru_node);
 
 	list_add_tail(&entry->lro_node, &desc_info->
 		 lro_desc_pool.lro_free_list_head);
@@ -429,38 +500,33 @@ void qdf_lro_desc_free(qdf_lro_ctx_t lro_ctx,
  */
 void qdf_lro_flush(qdf_lro_ctx_t lro_ctx)
 {
-	struct net_lro_mgr *lro_mgr = lro_ctx->lro_mgr;
-	int i;
+	struct qdf_lro_desc_entry *entry, *tmp;
 
-	for (i = 0; i < lro_mgr->max_desc; i++) {
-		if (lro_mgr->lro_arr[i].active) {
-			qdf_lro_desc_free(lro_ctx, &lro_mgr->lro_arr[i]);
-			lro_flush_desc(lro_mgr, &lro_mgr->lro_arr[i]);
-		}
-	}
+	list_for_each_entry_safe(entry, tmp,
+		 &lro_ctx->lro_desc_info.lro_lru_list, lru_node)
+		qdf_lro_desc_flush(lro_ctx, entry->lro_desc);
 }
 /**
  * qdf_lro_get_desc() - LRO descriptor look-up function
+ * @lro_ctx: LRO context
  * @iph: IP header
  * @tcph: TCP header
- * @lro_arr: Array of LRO decriptors
- * @lro_mgr: LRO manager
  *
- * Looks-up the LRO descriptor for a given flow
+ * Looks-up the LRO descriptor for a given flow among the ones in use
  *
  * Return: LRO descriptor
  */
-static struct net_lro_desc *qdf_lro_get_desc(struct net_lro_mgr *lro_mgr,
-	 struct net_lro_desc *lro_arr,
+static struct net_lro_desc *qdf_lro_get_desc(struct qdf_lro_s *lro_ctx,
 	 struct iphdr *iph,
 	 struct tcphdr *tcph)
 {
-	int i;
+	struct qdf_lro_desc_entry *entry;
 
-	for (i = 0; i < lro_mgr->max_desc; i++) {
-		if (lro_arr[i].active)
-			if (qdf_lro_tcp_flow_match(&lro_arr[i], iph, tcph))
-				return &lro_arr[i];
+	list_for_each_entry(entry, &lro_ctx->lro_desc_info.lro_lru_list,
+		 lru_node) {
+		if (entry->lro_desc->active &&
+		    qdf_lro_tcp_flow_match(entry->lro_desc, iph, tcph))
+			return entry->lro_desc;
 	}
 
 	return NULL;
@@ -480,15 +546,35 @@ void qdf_lro_flush_pkt(qdf_lro_ctx_t lro_ctx,
 	 struct qdf_lro_info *info)
 {
 	struct net_lro_desc *lro_desc;
-	struct net_lro_mgr *lro_mgr = lro_ctx->lro_mgr;
 	struct iphdr *iph = (struct iphdr *) info->iph;
 	struct tcphdr *tcph = (struct tcphdr *) info->tcph;
 
-	lro_desc = qdf_lro_get_desc(lro_mgr, lro_mgr->lro_arr, iph, tcph);
+	lro_desc = qdf_lro_get_desc(lro_ctx, iph, tcph);
 
-	if (lro_desc) {
-		/* statistics */
-		qdf_lro_desc_free(lro_ctx, lro_desc);
-		lro_flush_desc(lro_mgr, lro_desc);
+	if (lro_desc)
+		qdf_lro_desc_flush(lro_ctx, lro_desc);
+}
+
+void qdf_lro_display_stats(qdf_lro_ctx_t lro_ctx)
+{
+	struct qdf_lro_stats *stats;
+	uint64_t ratio = 0;
+	uint32_t frac = 0;
+
+	if (unlikely(!lro_ctx))
+		return;
+
+	/* packets per delivered skb, in hundredths */
+	stats = &lro_ctx->lro_stats;
+	if (stats->delivered) {
+		ratio = div64_u64(stats->pkts * 100, stats->delivered);
+		frac = do_div(ratio, 100);
 	}
+
+	QDF_TRACE(QDF_MODULE_ID_QDF, QDF_TRACE_LEVEL_ERROR,
+		 "LRO %pK: pkts %llu delivered %llu ratio %llu.%02u flows %u (max %u) evicted %u timed out %u no desc %u",
+		 lro_ctx, stats->pkts, stats->delivered,
+		 ratio, frac, stats->new_flows,
+		 lro_ctx->lro_mgr->max_desc, stats->evicted,
+		 stats->timed_out, stats->no_desc);
 }
@@ -34,6 +34,8 @@
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
 #include <linux/string.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
 
 #if IS_ENABLED(CONFIG_WCNSS_MEM_PRE_ALLOC)
 #include <net/cnss_prealloc.h>
@@ -285,6 +287,154 @@ u_int8_t prealloc_disabled = 1;
 qdf_declare_param(prealloc_disabled, byte);
 qdf_export_symbol(prealloc_disabled);
 
+/*
+ * Size-class caches
+ *
+ * Most qdf_mem_malloc() traffic is small objects of a handful of fixed sizes:
+ * descriptors, messages, timer contexts. Those requests are served from a
+ * slab cache per size class, created in qdf_mem_init(), instead of the
+ * kmalloc caches shared with the rest of the kernel. Their churn is then
+ * kept out of the generic slabs and can be watched per class in
+ * qdf/mem/caches. Frees find the owning cache through the slab page, so
+ * callers keep using qdf_mem_free().
+ */
+#if defined(CONFIG_SLUB) || defined(CONFIG_SLAB)
+/**
+ * struct qdf_mem_cache - a size-class cache
+ * @name: slab cache name
+ * @size: largest request served by this class
+ * @cache: the slab cache, NULL if not created
+ * @allocs: objects allocated from @cache
+ * @frees: objects returned to @cache
+ * @fails: requests for which @cache failed to allocate
+ */
+struct qdf_mem_cache {
+	const char *name;
+	size_t size;
+	struct kmem_cache *cache;
+	qdf_atomic_t allocs;
+	qdf_atomic_t frees;
+	qdf_atomic_t fails;
+};
+
+static struct qdf_mem_cache qdf_mem_caches[] = {
+	{ .name = "qdf_mem_64", .size = 64 },
+	{ .name = "qdf_mem_128", .size = 128 },
+	{ .name = "qdf_mem_256", .size = 256 },
+	{ .name = "qdf_mem_512", .size = 512 },
+	{ .name = "qdf_mem_1024", .size = 1024 },
+};
+
+static bool mem_cache_disabled;
+qdf_declare_param(mem_cache_disabled, bool);
+
+static void *qdf_mem_cache_alloc(size_t size, gfp_t flags)
+{
+	struct qdf_mem_cache *c;
+	void *ptr;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(qdf_mem_caches); i++) {
+		c = &qdf_mem_caches[i];
+		if (size > c->size)
+			continue;
+
+		if (!c->cache)
+			return NULL;
+
+		ptr = kmem_cache_zalloc(c->cache, flags);
+		if (!ptr) {
+			qdf_atomic_inc(&c->fails);
+			return NULL;
+		}
+
+		qdf_atomic_inc(&c->allocs);
+		return ptr;
+	}
+
+	return NULL;
+}
+
+/**
+ * qdf_mem_cache_free() - return @ptr to its size-class cache
+ * @ptr: memory to free
+ *
+ * Return: true if @ptr came from a size-class cache and has been freed
+ */
+static bool qdf_mem_cache_free(void *ptr)
+{
+	struct page *page = virt_to_head_page(ptr);
+	struct qdf_mem_cache *c;
+	int i;
+
+	if (!PageSlab(page))
+		return false;
+
+	for (i = 0; i < ARRAY_SIZE(qdf_mem_caches); i++) {
+		c = &qdf_mem_caches[i];
+		if (c->cache && page->slab_cache == c->cache) {
+			kmem_cache_free(c->cache, ptr);
+			qdf_atomic_inc(&c->frees);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void qdf_mem_cache_init(void)
+{
+	struct qdf_mem_cache *c;
+	int i;
+
+	if (mem_cache_disabled)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(qdf_mem_caches); i++) {
+		c = &qdf_mem_caches[i];
+		qdf_atomic_init(&c->allocs);
+		qdf_atomic_init(&c->frees);
+		qdf_atomic_init(&c->fails);
+		c->cache = kmem_cache_create(c->name, c->size, 0,
+					     SLAB_HWCACHE_ALIGN, NULL);
+		if (!c->cache)
+			qdf_err("Failed to create %s cache", c->name);
+	}
+}
+
+static void qdf_mem_cache_exit(void)
+{
+	struct qdf_mem_cache *c;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(qdf_mem_caches); i++) {
+		c = &qdf_mem_caches[i];
+		if (!c->cache)
+			continue;
+
+		if (qdf_atomic_read(&c->allocs) != qdf_atomic_read(&c->frees))
+			qdf_err("%s: %d objects still in use", c->name,
+				qdf_atomic_read(&c->allocs) -
+				qdf_atomic_read(&c->frees));
+		kmem_cache_destroy(c->cache);
+		c->cache = NULL;
+	}
+}
+#else
+static inline void *qdf_mem_cache_alloc(size_t size, gfp_t flags)
+{
+	return NULL;
+}
+
+static inline bool qdf_mem_cache_free(void *ptr)
+{
+	return false;
+}
+
+static inline void qdf_mem_cache_init(void) {}
+static inline void qdf_mem_cache_exit(void) {}
+#endif /* CONFIG_SLUB || CONFIG_SLAB */
+
 #if defined WLAN_DEBUGFS
 
 /* Debugfs root directory for qdf_mem */
@@ -794,6 +944,50 @@ static QDF_STATUS qdf_mem_debug_debugfs_exit(void)
 #endif /* MEMORY_DEBUG */
 
 
+#if defined(CONFIG_SLUB) || defined(CONFIG_SLAB)
+static int qdf_mem_caches_show(struct seq_file *seq, void *v)
+{
+	struct qdf_mem_cache *c;
+	int allocs, frees, i;
+
+	seq_puts(seq, "cache         size     allocs      frees     in-use   fails\n");
+	for (i = 0; i < ARRAY_SIZE(qdf_mem_caches); i++) {
+		c = &qdf_mem_caches[i];
+		if (!c->cache)
+			continue;
+
+		allocs = qdf_atomic_read(&c->allocs);
+		frees = qdf_atomic_read(&c->frees);
+		seq_printf(seq, "%-12s %5zu %10u %10u %10d %7u\n", c->name,
+			   c->size, allocs, frees, allocs - frees,
+			   qdf_atomic_read(&c->fails));
+	}
+
+	return 0;
+}
+
+static int qdf_mem_caches_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, qdf_mem_caches_show, NULL);
+}
+
+static const struct file_operations fops_qdf_mem_caches = {
+	.owner = THIS_MODULE,
+	.open = qdf_mem_caches_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void qdf_mem_caches_debugfs_init(void)
+{
+	debugfs_create_file("caches", S_IRUSR, qdf_mem_debugfs_root, NULL,
+			    &fops_qdf_mem_caches);
+}
+#else
+static inline void qdf_mem_caches_debugfs_init(void) {}
+#endif /* CONFIG_SLUB || CONFIG_SLAB */
+
 static void qdf_mem_debugfs_exit(void)
 {
 	debugfs_remove_recursive(qdf_mem_debugfs_root);
@@ -828,6 +1022,8 @@ static QDF_STATUS qdf_mem_debugfs_init(void)
 				qdf_mem_debugfs_root,
 				&qdf_mem_stat.skb);
 
+	qdf_mem_caches_debugfs_init();
+
 	return QDF_STATUS_SUCCESS;
 }
 
@@ -1483,7 +1679,9 @@ void *qdf_mem_malloc_atomic_fl(size_t size, const char *func, uint32_t line)
 	if (ptr)
 		return ptr;
 
-	ptr = kzalloc(size, GFP_ATOMIC);
+	ptr = qdf_mem_cache_alloc(size, GFP_ATOMIC);
+	if (!ptr)
+		ptr = kzalloc(size, GFP_ATOMIC);
 	if (!ptr) {
 		qdf_nofl_warn("Failed to malloc %zuB @ %s:%d",
 			      size, func, line);
@@ -1681,6 +1879,9 @@ void __qdf_mem_free(void *ptr)
 
 	qdf_mem_kmalloc_dec(ksize(ptr));
 
+	if (qdf_mem_cache_free(ptr))
+		return;
+
 	kfree(ptr);
 }
 
@@ -1700,7 +1901,9 @@ void *__qdf_mem_malloc(size_t size, const char *func, uint32_t line)
 	if (ptr)
 		return ptr;
 
-	ptr = kzalloc(size, qdf_mem_malloc_flags());
+	ptr = qdf_mem_cache_alloc(size, qdf_mem_malloc_flags());
+	if (!ptr)
+		ptr = kzalloc(size, qdf_mem_malloc_flags());
 	if (!ptr)
 		return NULL;
 
@@ -2280,6 +2483,7 @@ qdf_export_symbol(qdf_mem_dma_sync_single_for_cpu);
 
 void qdf_mem_init(void)
 {
+	qdf_mem_cache_init();
 	qdf_mem_debug_init();
 	qdf_net_buf_debug_init();
 	qdf_mem_debugfs_init();
@@ -2293,6 +2497,7 @@ void qdf_mem_exit(void)
 	qdf_mem_debugfs_exit();
 	qdf_net_buf_debug_exit();
 	qdf_mem_debug_exit();
+	qdf_mem_cache_exit();
 }
 qdf_export_symbol(qdf_mem_exit);
 
@@ -437,6 +437,210 @@ void __qdf_nbuf_count_dec(__qdf_nbuf_t nbuf)
 qdf_export_symbol(__qdf_nbuf_count_dec);
 #endif
 
+/*
+ * RX buffer recycling: a buffer freed through __qdf_nbuf_free() that is
+ * still private and linear is reset and parked on a per-CPU list instead
+ * of going back to the allocator, and __qdf_nbuf_alloc() takes it from
+ * there first. RX replenish runs in the NAPI context of its pipe, so the
+ * CPU list stands in for the pipe. qdf_nbuf_recycle_depth is the number
+ * of buffers kept per CPU and should match the RX ring depth; 0, the
+ * default, disables recycling and frees whatever the lists hold.
+ */
+#define QDF_NBUF_RECYCLE_MAX_SIZE (SKB_WITH_OVERHEAD(PAGE_SIZE) - NET_SKB_PAD)
+
+/**
+ * struct qdf_nbuf_recycle_pool - per-CPU list of buffers for reuse
+ * @list: parked buffers, its lock protects the whole pool
+ * @buf_size: largest allocation served from the pool, in bytes
+ * @hit: allocations served from the pool
+ * @miss: allocations the pool could not serve
+ * @recycled: freed buffers parked for reuse
+ * @full: freed buffers dropped because the pool was full
+ */
+struct qdf_nbuf_recycle_pool {
+	struct sk_buff_head list;
+	uint32_t buf_size;
+	uint64_t hit;
+	uint64_t miss;
+	uint64_t recycled;
+	uint64_t full;
+};
+
+static DEFINE_PER_CPU(struct qdf_nbuf_recycle_pool, qdf_nbuf_recycle_pool);
+static uint32_t qdf_nbuf_recycle_depth;
+static bool qdf_nbuf_recycle_inited;
+
+static void __qdf_nbuf_recycle_drain(void)
+{
+	int cpu;
+
+	if (!qdf_nbuf_recycle_inited)
+		return;
+
+	for_each_possible_cpu(cpu)
+		skb_queue_purge(&per_cpu(qdf_nbuf_recycle_pool, cpu).list);
+}
+
+static int qdf_nbuf_recycle_depth_set(const char *val,
+				      const struct kernel_param *kp)
+{
+	uint32_t depth;
+	int cpu;
+	int ret;
+
+	ret = kstrtou32(val, 0, &depth);
+	if (ret)
+		return ret;
+
+	if (!qdf_nbuf_recycle_inited) {
+		for_each_possible_cpu(cpu)
+			skb_queue_head_init(&per_cpu(qdf_nbuf_recycle_pool,
+						     cpu).list);
+		/* lists are ready before anyone sees a non-zero depth */
+		smp_wmb();
+		qdf_nbuf_recycle_inited = true;
+	}
+
+	WRITE_ONCE(qdf_nbuf_recycle_depth, depth);
+	if (!depth)
+		__qdf_nbuf_recycle_drain();
+
+	return 0;
+}
+
+static const struct kernel_param_ops qdf_nbuf_recycle_depth_ops = {
+	.set = qdf_nbuf_recycle_depth_set,
+	.get = param_get_uint,
+};
+
+module_param_cb(qdf_nbuf_recycle_depth, &qdf_nbuf_recycle_depth_ops,
+		&qdf_nbuf_recycle_depth, 0600);
+
+static int qdf_nbuf_recycle_stats_get(char *buf, const struct kernel_param *kp)
+{
+	struct qdf_nbuf_recycle_pool *pool;
+	uint64_t hit = 0, miss = 0, recycled = 0, full = 0;
+	uint32_t parked = 0;
+	int cpu;
+
+	if (!qdf_nbuf_recycle_inited)
+		return scnprintf(buf, PAGE_SIZE, "disabled\n");
+
+	for_each_possible_cpu(cpu) {
+		pool = &per_cpu(qdf_nbuf_recycle_pool, cpu);
+		hit += pool->hit;
+		miss += pool->miss;
+		recycled += pool->recycled;
+		full += pool->full;
+		parked += skb_queue_len(&pool->list);
+	}
+
+	return scnprintf(buf, PAGE_SIZE,
+			 "hit %llu miss %llu recycled %llu full %llu parked %u\n",
+			 hit, miss, recycled, full, parked);
+}
+
+static const struct kernel_param_ops qdf_nbuf_recycle_stats_ops = {
+	.get = qdf_nbuf_recycle_stats_get,
+};
+
+module_param_cb(qdf_nbuf_recycle_stats, &qdf_nbuf_recycle_stats_ops,
+		NULL, 0444);
+
+/**
+ * __qdf_nbuf_recycle_get() - take a parked buffer for an allocation
+ * @size: bytes needed past NET_SKB_PAD, alignment slack included
+ *
+ * Return: a buffer laid out like a fresh one, or NULL
+ */
+static struct sk_buff *__qdf_nbuf_recycle_get(size_t size)
+{
+	struct qdf_nbuf_recycle_pool *pool;
+	struct sk_buff *skb, *stale = NULL;
+	unsigned long flags;
+
+	if (!READ_ONCE(qdf_nbuf_recycle_depth) ||
+	    size > QDF_NBUF_RECYCLE_MAX_SIZE)
+		return NULL;
+
+	pool = raw_cpu_ptr(&qdf_nbuf_recycle_pool);
+	spin_lock_irqsave(&pool->list.lock, flags);
+	if (size > pool->buf_size)
+		pool->buf_size = size;
+
+	skb = __skb_dequeue(&pool->list);
+	if (skb && skb_end_offset(skb) < size + NET_SKB_PAD) {
+		stale = skb;
+		skb = NULL;
+	}
+
+	if (skb)
+		pool->hit++;
+	else
+		pool->miss++;
+	spin_unlock_irqrestore(&pool->list.lock, flags);
+
+	if (stale)
+		dev_kfree_skb_any(stale);
+
+	return skb;
+}
+
+/**
+ * __qdf_nbuf_recycle_put() - park a freed buffer for reuse
+ * @skb: buffer being freed, with no other users left
+ *
+ * Return: true if the pool took the buffer
+ */
+static bool __qdf_nbuf_recycle_put(struct sk_buff *skb)
+{
+	struct qdf_nbuf_recycle_pool *pool;
+	struct skb_shared_info *shinfo = skb_shinfo(skb);
+	unsigned long flags;
+	bool head_frag;
+	bool parked = false;
+
+	if (!READ_ONCE(qdf_nbuf_recycle_depth))
+		return false;
+
+	if (skb_is_nonlinear(skb) || skb_shared(skb) || skb_cloned(skb) ||
+	    skb->fclone != SKB_FCLONE_UNAVAILABLE || skb->pfmemalloc ||
+	    skb->destructor || skb->sk || skb_dst(skb) ||
+	    (shinfo->tx_flags & SKBTX_DEV_ZEROCOPY))
+		return false;
+
+	pool = raw_cpu_ptr(&qdf_nbuf_recycle_pool);
+	spin_lock_irqsave(&pool->list.lock, flags);
+	if (!pool->buf_size ||
+	    skb_end_offset(skb) < pool->buf_size + NET_SKB_PAD) {
+		spin_unlock_irqrestore(&pool->list.lock, flags);
+		return false;
+	}
+
+	if (skb_queue_len(&pool->list) < READ_ONCE(qdf_nbuf_recycle_depth)) {
+		/* same layout __alloc_skb() leaves behind */
+		nf_reset(skb);
+		head_frag = skb->head_frag;
+		memset(shinfo, 0, offsetof(struct skb_shared_info, dataref));
+		atomic_set(&shinfo->dataref, 1);
+		memset(skb, 0, offsetof(struct sk_buff, tail));
+		skb->head_frag = head_frag;
+		skb->mac_header = (typeof(skb->mac_header))~0U;
+		skb->transport_header = (typeof(skb->transport_header))~0U;
+		skb->data = skb->head + NET_SKB_PAD;
+		skb_reset_tail_pointer(skb);
+
+		__skb_queue_tail(&pool->list, skb);
+		pool->recycled++;
+		parked = true;
+	} else {
+		pool->full++;
+	}
+	spin_unlock_irqrestore(&pool->list.lock, flags);
+
+	return parked;
+}
+
 #if defined(CONFIG_WIFI_EMULATION_WIFI_3_0) && defined(BUILD_X86) && \
 	!defined(QCA_WIFI_QCN9000)
 struct sk_buff *__qdf_nbuf_alloc(qdf_device_t osdev, size_t size, int reserve,
@@ -536,6 +740,10 @@ struct sk_buff *__qdf_nbuf_alloc(qdf_device_t osdev, size_t size, int reserve,
 #endif
 	}
 
+	skb = __qdf_nbuf_recycle_get(size);
+	if (skb)
+		goto skb_alloc;
+
 	skb = __netdev_alloc_skb(NULL, size, flags);
 
 	if (skb)
@@ -600,7 +808,7 @@ void __qdf_nbuf_free(struct sk_buff *skb)
 	qdf_nbuf_count_dec(skb);
 	if (nbuf_free_cb)
 		nbuf_free_cb(skb);
-	else
+	else if (!__qdf_nbuf_recycle_put(skb))
 		dev_kfree_skb_any(skb);
 }
 
@@ -4633,7 +4841,6 @@ qdf_export_symbol(qdf_nbuf_init_fast);
 #endif /* WLAN_FEATURE_FASTPATH */
 
 
-#ifdef QDF_NBUF_GLOBAL_COUNT
 /**
  * __qdf_nbuf_mod_init() - Intialization routine for qdf_nuf
  *
@@ -4641,8 +4848,10 @@ qdf_export_symbol(qdf_nbuf_init_fast);
  */
 void __qdf_nbuf_mod_init(void)
 {
+#ifdef QDF_NBUF_GLOBAL_COUNT
 	qdf_atomic_init(&nbuf_count);
 	qdf_debugfs_create_atomic(NBUF_DEBUGFS_NAME, S_IRUSR, NULL, &nbuf_count);
+#endif
 }
 
 /**
@@ -4652,5 +4861,6 @@ void __qdf_nbuf_mod_init(void)
  */
 void __qdf_nbuf_mod_exit(void)
 {
+	WRITE_ONCE(qdf_nbuf_recycle_depth, 0);
+	__qdf_nbuf_recycle_drain();
 }
-#endif
@@ -123,6 +123,15 @@ bool qdf_periodic_work_start(struct qdf_periodic_work *pwork, uint32_t msec)
 	return schedule_delayed_work(&pwork->dwork, msecs_to_jiffies(msec));
 }
 
+bool qdf_periodic_work_kick(struct qdf_periodic_work *pwork)
+{
+	/* stopped works stay stopped */
+	if (!pwork->msec)
+		return false;
+
+	return mod_delayed_work(system_wq, &pwork->dwork, 0);
+}
+
 bool qdf_periodic_work_stop_async(struct qdf_periodic_work *pwork)
 {
 	bool pending = pwork->msec != 0;
@@ -25,6 +25,7 @@
 #include <linux/vmalloc.h>
 #include <wlan_logging_sock_svc.h>
 #include <linux/kthread.h>
+#include <linux/moduleparam.h>
 #include <qdf_time.h>
 #include <qdf_trace.h>
 #include <qdf_mc_timer.h>
@@ -96,6 +97,7 @@
 #define HOST_LOG_DRIVER_MSG        0x001
 #define HOST_LOG_PER_PKT_STATS     0x002
 #define HOST_LOG_FW_FLUSH_COMPLETE 0x003
+#define HOST_LOG_FLUSH_NOW         0x004
 #define DIAG_TYPE_LOGS                 1
 #define PTT_MSG_DIAG_CMDS_TYPE    0x5050
 
@@ -138,6 +140,28 @@ struct pkt_stats_msg {
 	struct sk_buff *skb;
 };
 
+/*
+ * Filled log buffers are coalesced into netlink messages of up to
+ * wlan_log_batch_kb. With CNSS_GENL every message is copied into a cld80211
+ * event which is limited to a little under 8KB, so cap the batch below that;
+ * the legacy socket is only bound by the 16 bit tAniHdr length.
+ */
+#ifdef CNSS_GENL
+#define WLAN_LOG_BATCH_MAX_LEN     (6 * 1024)
+#define WLAN_LOG_BATCH_DEF_KB      6
+#else
+#define WLAN_LOG_BATCH_MAX_LEN     (60 * 1024)
+#define WLAN_LOG_BATCH_DEF_KB      16
+#endif
+/* Bounds for the time the thread waits for a batch to fill up */
+#define WLAN_LOG_BATCH_MIN_MS      10
+#define WLAN_LOG_BATCH_MAX_MS      100
+
+static unsigned int wlan_log_batch_kb = WLAN_LOG_BATCH_DEF_KB;
+module_param(wlan_log_batch_kb, uint, 0644);
+MODULE_PARM_DESC(wlan_log_batch_kb,
+		 "Host log netlink batch size in KB, 0 disables batching");
+
 #define MAX_FLUSH_TIMER_PERIOD_VALUE 3600000 /* maximum of 1 hour (in ms) */
 struct wlan_logging {
 	/* Log Fatal and ERROR to console */
@@ -161,6 +185,18 @@ struct wlan_logging {
 	bool exit;
 	/* Holds number of dropped logs */
 	unsigned int drop_count;
+	/* Number of nodes on filled_list */
+	unsigned int filled_cnt;
+	/* Producer wakeups skipped while a batch was filling up */
+	unsigned int deferred_cnt;
+	/* Netlink messages and log buffers sent by the thread */
+	unsigned int batch_cnt;
+	unsigned int batch_nodes;
+	/* Current batch wait, adapted to the observed log rate */
+	unsigned int batch_ms;
+	unsigned long batch_start;
+	/* Message reused between batches when netlink has released it */
+	struct sk_buff *batch_skb;
 	/* current logbuf to which the log will be filled to */
 	struct log_msg *pcur_node;
 	/* Event flag used for wakeup and post indication*/
@@ -228,6 +264,7 @@ static int wlan_queue_logmsg_for_app(void)
 		gwlan_logging.pcur_node->filled_length;
 	list_add_tail(&gwlan_logging.pcur_node->node,
 		      &gwlan_logging.filled_list);
+	gwlan_logging.filled_cnt++;
 
 	if (!list_empty(&gwlan_logging.free_list)) {
 		/* Get buffer from free list */
@@ -243,6 +280,7 @@ static int wlan_queue_logmsg_for_app(void)
 			(struct log_msg *)(gwlan_logging.filled_list.next);
 		++gwlan_logging.drop_count;
 		list_del_init(gwlan_logging.filled_list.next);
+		gwlan_logging.filled_cnt--;
 		ret = 1;
 	}
 
@@ -251,6 +289,39 @@ static int wlan_queue_logmsg_for_app(void)
 	return ret;
 }
 
+static uint32_t wlan_logging_batch_len(void)
+{
+	uint32_t len = READ_ONCE(wlan_log_batch_kb) * 1024;
+
+	return clamp_t(uint32_t, len, MAX_LOGMSG_LENGTH,
+		       WLAN_LOG_BATCH_MAX_LEN);
+}
+
+/* Filled buffers worth waking the thread for before the batch timeout */
+static uint32_t wlan_logging_wake_thresh(void)
+{
+	uint32_t thresh = wlan_logging_batch_len() / MAX_LOGMSG_LENGTH;
+
+	thresh = min_t(uint32_t, thresh, gwlan_logging.num_buf / 4);
+
+	return max_t(uint32_t, thresh, 1);
+}
+
+static int wlan_logging_stats_get(char *buf, const struct kernel_param *kp)
+{
+	return scnprintf(buf, PAGE_SIZE,
+			 "batches %u buffers %u deferred %u dropped %u batch_ms %u\n",
+			 gwlan_logging.batch_cnt, gwlan_logging.batch_nodes,
+			 gwlan_logging.deferred_cnt, gwlan_logging.drop_count,
+			 gwlan_logging.batch_ms);
+}
+
+static const struct kernel_param_ops wlan_logging_stats_ops = {
+	.get = wlan_logging_stats_get,
+};
+
+module_param_cb(wlan_log_stats, &wlan_logging_stats_ops, NULL, 0444);
+
 static const char *current_process_name(void)
 {
 	if (in_irq())
@@ -370,6 +441,7 @@ int wlan_log_to_user(QDF_TRACE_LEVEL log_level, char *to_be_sent, int length)
 	bool wake_up_thread = false;
 	unsigned long flags;
 	uint64_t ts;
+	uint32_t filled_cnt = 0;
 
 	/* Add the current time stamp */
 	ts = qdf_get_log_timestamp();
@@ -398,6 +470,7 @@ int wlan_log_to_user(QDF_TRACE_LEVEL log_level, char *to_be_sent, int length)
 			sizeof(tAniNlHdr))) < total_log_len) {
 		wake_up_thread = true;
 		wlan_queue_logmsg_for_app();
+		filled_cnt = gwlan_logging.filled_cnt;
 		pfilled_length = &gwlan_logging.pcur_node->filled_length;
 	}
 
@@ -427,10 +500,17 @@ int wlan_log_to_user(QDF_TRACE_LEVEL log_level, char *to_be_sent, int length)
 
 	spin_unlock_irqrestore(&gwlan_logging.spin_lock, flags);
 
-	/* Wakeup logger thread */
+	/*
+	 * Wakeup logger thread for the first buffer of a batch, it then waits
+	 * for the batch to fill up. Further buffers only wake it once enough
+	 * of them are pending to make up a full message.
+	 */
 	if (wake_up_thread) {
 		set_bit(HOST_LOG_DRIVER_MSG, &gwlan_logging.eventFlag);
-		wake_up_interruptible(&gwlan_logging.wait_queue);
+		if (filled_cnt == 1 || filled_cnt >= wlan_logging_wake_thresh())
+			wake_up_interruptible(&gwlan_logging.wait_queue);
+		else
+			gwlan_logging.deferred_cnt++;
 	}
 
 	if (gwlan_logging.log_to_console)
@@ -628,6 +708,92 @@ int pktlog_send_per_pkt_stats_to_user(void)
 }
 #endif
 
+/*
+ * Only the logging thread uses the batch skb. It holds a reference of its
+ * own across the broadcast, so once netlink is done with the message the
+ * buffer can be refilled instead of allocating a new one per batch.
+ */
+static struct sk_buff *wlan_logging_get_batch_skb(uint32_t size)
+{
+	struct sk_buff *skb = gwlan_logging.batch_skb;
+
+	if (skb && (skb_shared(skb) || skb_cloned(skb))) {
+		dev_kfree_skb(skb);
+		skb = NULL;
+	}
+
+	if (skb) {
+		skb_trim(skb, 0);
+		if (skb_tailroom(skb) < size) {
+			dev_kfree_skb(skb);
+			skb = NULL;
+		}
+	}
+
+	if (!skb)
+		skb = dev_alloc_skb(size);
+
+	gwlan_logging.batch_skb = skb;
+	if (!skb)
+		return NULL;
+
+	return skb_get(skb);
+}
+
+static void wlan_logging_free_batch_skb(void)
+{
+	if (gwlan_logging.batch_skb)
+		dev_kfree_skb(gwlan_logging.batch_skb);
+	gwlan_logging.batch_skb = NULL;
+}
+
+/*
+ * Derive the next batch wait from the time it took to collect @bytes, so
+ * that a batch covers about wlan_log_batch_kb worth of logs at the current
+ * rate.
+ */
+static void wlan_logging_adapt_batch(uint32_t bytes)
+{
+	unsigned long now = jiffies;
+	uint64_t ms;
+
+	ms = jiffies_to_msecs(now - gwlan_logging.batch_start);
+	gwlan_logging.batch_start = now;
+	if (!bytes)
+		return;
+
+	ms = div_u64(ms * wlan_logging_batch_len(), bytes);
+	gwlan_logging.batch_ms = clamp_t(uint64_t, ms, WLAN_LOG_BATCH_MIN_MS,
+					 WLAN_LOG_BATCH_MAX_MS);
+}
+
+/*
+ * Give a batch that has just started the time to fill up, unless a flush
+ * was asked for or batching is disabled.
+ */
+static void wlan_logging_batch_wait(void)
+{
+	uint32_t thresh;
+
+	if (wlan_logging_batch_len() <= MAX_LOGMSG_LENGTH)
+		return;
+
+	thresh = wlan_logging_wake_thresh();
+	wait_event_interruptible_timeout(gwlan_logging.wait_queue,
+		gwlan_logging.filled_cnt >= thresh ||
+		test_bit(HOST_LOG_FLUSH_NOW, &gwlan_logging.eventFlag) ||
+		test_bit(HOST_LOG_FW_FLUSH_COMPLETE,
+			 &gwlan_logging.eventFlag) ||
+		gwlan_logging.exit,
+		msecs_to_jiffies(gwlan_logging.batch_ms));
+}
+
+/*
+ * Consecutive filled buffers of the same radio are sent as one netlink
+ * message carrying a single tAniHdr whose length covers all of them; the
+ * CNSS_GENL path forwards only the first nlmsg of an skb, so stacking
+ * several nlmsgs would lose logs.
+ */
 static int send_filled_buffers_to_user(void)
 {
 	int ret = -1;
@@ -640,15 +806,20 @@ static int send_filled_buffers_to_user(void)
 	static int nlmsg_seq;
 	unsigned long flags;
 	static int rate_limit;
+	uint32_t batch_len = wlan_logging_batch_len();
+	uint32_t log_len, sent = 0;
+
+	tot_msg_len = NLMSG_SPACE(batch_len + sizeof(wnl->radio) +
+				  sizeof(tAniHdr));
 
 	while (!list_empty(&gwlan_logging.filled_list)
 	       && !gwlan_logging.exit) {
 
-		skb = dev_alloc_skb(MAX_LOGMSG_LENGTH);
+		skb = wlan_logging_get_batch_skb(tot_msg_len);
 		if (!skb) {
 			if (!rate_limit) {
 				qdf_nofl_err("%s: dev_alloc_skb() failed for msg size[%d] drop count = %u",
-					     __func__, MAX_LOGMSG_LENGTH,
+					     __func__, tot_msg_len,
 					     gwlan_logging.drop_count);
 			}
 			rate_limit = 1;
@@ -657,43 +828,60 @@ static int send_filled_buffers_to_user(void)
 		}
 		rate_limit = 0;
 
-		spin_lock_irqsave(&gwlan_logging.spin_lock, flags);
-
-		plog_msg = (struct log_msg *)
-			   (gwlan_logging.filled_list.next);
-		list_del_init(gwlan_logging.filled_list.next);
-		spin_unlock_irqrestore(&gwlan_logging.spin_lock, flags);
 		/* 4 extra bytes for the radio idx */
-		payload_len = plog_msg->filled_length +
-			      sizeof(wnl->radio) + sizeof(tAniHdr);
-
-		tot_msg_len = NLMSG_SPACE(payload_len);
-		nlh = nlmsg_put(skb, 0, nlmsg_seq++,
-				ANI_NL_MSG_LOG, payload_len, NLM_F_REQUEST);
+		nlh = nlmsg_put(skb, 0, nlmsg_seq++, ANI_NL_MSG_LOG,
+				sizeof(wnl->radio) + sizeof(tAniHdr),
+				NLM_F_REQUEST);
 		if (!nlh) {
-			spin_lock_irqsave(&gwlan_logging.spin_lock, flags);
-			list_add_tail(&plog_msg->node,
-				      &gwlan_logging.free_list);
-			spin_unlock_irqrestore(&gwlan_logging.spin_lock, flags);
-			qdf_nofl_err("%s: drop_count = %u", __func__,
-				     ++gwlan_logging.drop_count);
 			qdf_nofl_err("%s: nlmsg_put() failed for msg size[%d]",
 				     __func__, tot_msg_len);
 			dev_kfree_skb(skb);
 			skb = NULL;
 			ret = -EINVAL;
-			continue;
+			break;
 		}
-
 		wnl = (tAniNlHdr *) nlh;
-		wnl->radio = plog_msg->radio;
-		memcpy(&wnl->wmsg, plog_msg->logbuf,
-		       plog_msg->filled_length + sizeof(tAniHdr));
+		log_len = 0;
 
 		spin_lock_irqsave(&gwlan_logging.spin_lock, flags);
-		list_add_tail(&plog_msg->node, &gwlan_logging.free_list);
+		while (!list_empty(&gwlan_logging.filled_list)) {
+			plog_msg = (struct log_msg *)
+				   (gwlan_logging.filled_list.next);
+			if (log_len &&
+			    (plog_msg->radio != wnl->radio ||
+			     log_len + plog_msg->filled_length > batch_len))
+				break;
+
+			list_del_init(gwlan_logging.filled_list.next);
+			gwlan_logging.filled_cnt--;
+			spin_unlock_irqrestore(&gwlan_logging.spin_lock, flags);
+
+			wnl->radio = plog_msg->radio;
+			memcpy(skb_put(skb, plog_msg->filled_length),
+			       plog_msg->logbuf + sizeof(tAniHdr),
+			       plog_msg->filled_length);
+			log_len += plog_msg->filled_length;
+			gwlan_logging.batch_nodes++;
+
+			spin_lock_irqsave(&gwlan_logging.spin_lock, flags);
+			list_add_tail(&plog_msg->node,
+				      &gwlan_logging.free_list);
+		}
 		spin_unlock_irqrestore(&gwlan_logging.spin_lock, flags);
 
+		/* the producer recycled the pending buffers meanwhile */
+		if (!log_len) {
+			dev_kfree_skb(skb);
+			break;
+		}
+
+		payload_len = log_len + sizeof(wnl->radio) + sizeof(tAniHdr);
+		nlh->nlmsg_len = NLMSG_LENGTH(payload_len);
+		wnl->wmsg.type = ANI_NL_MSG_LOG_TYPE;
+		wnl->wmsg.length = log_len;
+		sent += log_len;
+		gwlan_logging.batch_cnt++;
+
 		ret = nl_srv_bcast_host_logs(skb);
 		/* print every 64th drop count */
 		if (ret < 0 && (!(gwlan_logging.drop_count % 0x40))) {
@@ -702,6 +890,8 @@ static int send_filled_buffers_to_user(void)
 		}
 	}
 
+	wlan_logging_adapt_batch(sent);
+
 	return ret;
 }
 
@@ -815,8 +1005,15 @@ static int wlan_logging_thread(void *Arg)
 			break;
 
 
+		if (test_bit(HOST_LOG_DRIVER_MSG, &gwlan_logging.eventFlag))
+			wlan_logging_batch_wait();
+
+		if (gwlan_logging.exit)
+			break;
+
 		if (test_and_clear_bit(HOST_LOG_DRIVER_MSG,
 					&gwlan_logging.eventFlag)) {
+			clear_bit(HOST_LOG_FLUSH_NOW, &gwlan_logging.eventFlag);
 			ret = send_filled_buffers_to_user();
 			if (-ENOMEM == ret)
 				msleep(200);
@@ -857,6 +1054,8 @@ static int wlan_logging_thread(void *Arg)
 				wlan_queue_logmsg_for_app();
 				spin_unlock_irqrestore(&gwlan_logging.spin_lock,
 					flags);
+				set_bit(HOST_LOG_FLUSH_NOW,
+						&gwlan_logging.eventFlag);
 				set_bit(HOST_LOG_DRIVER_MSG,
 						&gwlan_logging.eventFlag);
 				set_bit(HOST_LOG_PER_PKT_STATS,
@@ -948,6 +1147,9 @@ int wlan_logging_sock_init_svc(void)
 	spin_lock_irqsave(&gwlan_logging.spin_lock, irq_flag);
 	INIT_LIST_HEAD(&gwlan_logging.free_list);
 	INIT_LIST_HEAD(&gwlan_logging.filled_list);
+	gwlan_logging.filled_cnt = 0;
+	gwlan_logging.batch_ms = WLAN_LOG_BATCH_MIN_MS;
+	gwlan_logging.batch_start = jiffies;
 
 	for (i = 0; i < gwlan_logging.num_buf; i++) {
 		list_add(&gplog_msg[i].node, &gwlan_logging.free_list);
@@ -1003,6 +1205,7 @@ int wlan_logging_sock_init_svc(void)
 	clear_bit(HOST_LOG_DRIVER_MSG, &gwlan_logging.eventFlag);
 	clear_bit(HOST_LOG_PER_PKT_STATS, &gwlan_logging.eventFlag);
 	clear_bit(HOST_LOG_FW_FLUSH_COMPLETE, &gwlan_logging.eventFlag);
+	clear_bit(HOST_LOG_FLUSH_NOW, &gwlan_logging.eventFlag);
 	init_completion(&gwlan_logging.shutdown_comp);
 	gwlan_logging.thread = kthread_create(wlan_logging_thread, NULL,
 					      "wlan_logging_thread");
@@ -1065,8 +1268,10 @@ int wlan_logging_sock_deinit_svc(void)
 	clear_bit(HOST_LOG_DRIVER_MSG, &gwlan_logging.eventFlag);
 	clear_bit(HOST_LOG_PER_PKT_STATS, &gwlan_logging.eventFlag);
 	clear_bit(HOST_LOG_FW_FLUSH_COMPLETE, &gwlan_logging.eventFlag);
+	clear_bit(HOST_LOG_FLUSH_NOW, &gwlan_logging.eventFlag);
 	wake_up_interruptible(&gwlan_logging.wait_queue);
 	wait_for_completion(&gwlan_logging.shutdown_comp);
+	wlan_logging_free_batch_skb();
 
 	spin_lock_irqsave(&gwlan_logging.spin_lock, irq_flag);
 	gwlan_logging.pcur_node = NULL;
@@ -1144,6 +1349,7 @@ void wlan_flush_host_logs_for_fatal(void)
 	spin_lock_irqsave(&gwlan_logging.spin_lock, flags);
 	wlan_queue_logmsg_for_app();
 	spin_unlock_irqrestore(&gwlan_logging.spin_lock, flags);
+	set_bit(HOST_LOG_FLUSH_NOW, &gwlan_logging.eventFlag);
 	set_bit(HOST_LOG_DRIVER_MSG, &gwlan_logging.eventFlag);
 	wake_up_interruptible(&gwlan_logging.wait_queue);
 }
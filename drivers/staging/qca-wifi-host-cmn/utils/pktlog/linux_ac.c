@@ -82,6 +82,185 @@ static struct file_operations pktlog_fops = {
 	read : pktlog_read,
 };
 
+/*
+ * Per-CPU pktlog rings. A WDI callback runs with BH disabled between
+ * pktlog_ring_begin() and pktlog_ring_end(), so each ring has a single
+ * producer and needs no lock; the records it reserves are published to
+ * the reader in one go when the callback is done. Userspace consumes
+ * the rings through mmap() (see struct ath_pktlog_ring_hdr). A record
+ * that does not fit is counted in dropped and written to a scratch
+ * buffer instead, since callers always copy into what they get back.
+ */
+#define PKTLOG_RING_MIN_KB	16
+#define PKTLOG_RING_SINK_SIZE	2048
+
+static uint32_t pktlog_ring_kb;
+module_param(pktlog_ring_kb, uint, 0444);
+MODULE_PARM_DESC(pktlog_ring_kb,
+		 "Per-CPU mmap-able pktlog ring size in KB, 0 to disable");
+
+struct pktlog_ring {
+	struct ath_pktlog_ring_hdr *hdr;
+	char *data;
+	char *sink;
+	uint32_t mask;
+	uint64_t res_head;
+	bool active;
+};
+
+static struct pktlog_ring __percpu *pktlog_rings;
+static struct proc_dir_entry *pktlog_ring_pde;
+
+bool pktlog_ring_begin(void)
+{
+	if (!pktlog_rings || in_irq() || irqs_disabled())
+		return false;
+
+	local_bh_disable();
+	this_cpu_ptr(pktlog_rings)->active = true;
+
+	return true;
+}
+
+void pktlog_ring_end(void)
+{
+	struct pktlog_ring *ring = this_cpu_ptr(pktlog_rings);
+
+	/* payloads land before the reader can see the new head */
+	smp_wmb();
+	WRITE_ONCE(ring->hdr->head, ring->res_head);
+	ring->active = false;
+	local_bh_enable();
+}
+
+char *pktlog_ring_getbuf(struct ath_pktlog_hdr *pl_hdr, size_t log_size)
+{
+	struct pktlog_ring *ring;
+	struct ath_pktlog_ring_rec *rec;
+	uint32_t size, off, room, need;
+	uint64_t head, used;
+
+	if (!pktlog_rings)
+		return NULL;
+
+	ring = this_cpu_ptr(pktlog_rings);
+	if (!ring->active)
+		return NULL;
+
+	size = ring->mask + 1;
+	need = ALIGN(sizeof(*rec) + sizeof(*pl_hdr) + log_size, 8);
+	if (need > PKTLOG_RING_SINK_SIZE)
+		return NULL;
+
+	head = ring->res_head;
+	off = head & ring->mask;
+	room = size - off;
+	used = head - READ_ONCE(ring->hdr->tail);
+	if (used + need + (room < need ? room : 0) > size) {
+		ring->hdr->dropped++;
+		return ring->sink;
+	}
+
+	if (room < need) {
+		rec = (struct ath_pktlog_ring_rec *)(ring->data + off);
+		rec->len = 0;
+		head += room;
+		off = 0;
+	}
+
+	rec = (struct ath_pktlog_ring_rec *)(ring->data + off);
+	rec->len = need;
+	rec->reserved = 0;
+	qdf_mem_copy(rec + 1, pl_hdr, sizeof(*pl_hdr));
+	ring->res_head = head + need;
+
+	return (char *)(rec + 1) + sizeof(*pl_hdr);
+}
+
+static int pktlog_ring_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	unsigned long cpu = vma->vm_pgoff;
+	struct pktlog_ring *ring;
+
+	if (!pktlog_rings || cpu >= nr_cpu_ids || !cpu_possible(cpu))
+		return -EINVAL;
+
+	ring = per_cpu_ptr(pktlog_rings, cpu);
+	if (vma->vm_end - vma->vm_start > PAGE_SIZE + ring->mask + 1)
+		return -EINVAL;
+
+	return remap_vmalloc_range(vma, ring->hdr, 0);
+}
+
+static const struct file_operations pktlog_ring_fops = {
+	.mmap = pktlog_ring_mmap,
+};
+
+static void pktlog_ring_free(void)
+{
+	struct pktlog_ring *ring;
+	int cpu;
+
+	if (!pktlog_rings)
+		return;
+
+	if (pktlog_ring_pde)
+		remove_proc_entry(PKTLOG_PROC_RING, g_pktlog_pde);
+	pktlog_ring_pde = NULL;
+
+	for_each_possible_cpu(cpu) {
+		ring = per_cpu_ptr(pktlog_rings, cpu);
+		vfree(ring->hdr);
+		kfree(ring->sink);
+	}
+	free_percpu(pktlog_rings);
+	pktlog_rings = NULL;
+}
+
+/* Rings are optional, pktlog keeps working on the legacy buffer */
+static void pktlog_ring_alloc(void)
+{
+	struct pktlog_ring __percpu *rings;
+	struct pktlog_ring *ring;
+	uint32_t size;
+	int cpu;
+
+	if (!pktlog_ring_kb)
+		return;
+
+	size = roundup_pow_of_two(max_t(uint32_t, pktlog_ring_kb,
+					PKTLOG_RING_MIN_KB)) * 1024;
+	rings = alloc_percpu(struct pktlog_ring);
+	if (!rings)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		ring = per_cpu_ptr(rings, cpu);
+		ring->hdr = vmalloc_user(PAGE_SIZE + size);
+		ring->sink = kmalloc(PKTLOG_RING_SINK_SIZE, GFP_KERNEL);
+		if (!ring->hdr || !ring->sink)
+			goto fail;
+
+		ring->data = (char *)ring->hdr + PAGE_SIZE;
+		ring->mask = size - 1;
+		ring->hdr->magic = PKTLOG_RING_MAGIC;
+		ring->hdr->size = size;
+	}
+
+	pktlog_rings = rings;
+	pktlog_ring_pde = proc_create(PKTLOG_PROC_RING, 0600, g_pktlog_pde,
+				      &pktlog_ring_fops);
+	if (!pktlog_ring_pde)
+		goto fail;
+
+	return;
+
+fail:
+	qdf_nofl_info(PKTLOG_TAG "%s: ring setup failed", __func__);
+	pktlog_rings = rings;
+	pktlog_ring_free();
+}
+
 void pktlog_disable_adapter_logging(struct hif_opaque_softc *scn)
 {
 	struct pktlog_dev_t *pl_dev = get_pktlog_handle();
@@ -457,6 +636,8 @@ static int pktlog_attach(struct hif_opaque_softc *scn)
 
 	pl_info_lnx->proc_entry = proc_entry;
 
+	pktlog_ring_alloc();
+
 	if (pktlog_sysctl_register(scn)) {
 		qdf_nofl_info(PKTLOG_TAG "%s: sysctl register failed for %s",
 			      __func__, proc_name);
@@ -466,6 +647,7 @@ static int pktlog_attach(struct hif_opaque_softc *scn)
 	return 0;
 
 attach_fail2:
+	pktlog_ring_free();
 	remove_proc_entry(proc_name, g_pktlog_pde);
 
 attach_fail1:
@@ -512,6 +694,7 @@ static void pktlog_detach(struct hif_opaque_softc *scn)
 		return;
 	}
 	mutex_lock(&pl_info->pktlog_mutex);
+	pktlog_ring_free();
 	remove_proc_entry(WLANDEV_BASENAME, g_pktlog_pde);
 	pktlog_sysctl_unregister(pl_dev);
 
@@ -281,8 +281,8 @@ wdi_pktlog_subscribe(uint8_t pdev_id, int32_t log_state)
 }
 #endif
 
-void pktlog_callback(void *pdev, enum WDI_EVENT event, void *log_data,
-		u_int16_t peer_id, uint32_t status)
+static void __pktlog_callback(void *pdev, enum WDI_EVENT event,
+			      void *log_data)
 {
 	switch (event) {
 	case WDI_EVENT_OFFLOAD_ALL:
@@ -364,9 +364,18 @@ void pktlog_callback(void *pdev, enum WDI_EVENT event, void *log_data,
 	}
 }
 
-void
-lit_pktlog_callback(void *context, enum WDI_EVENT event, void *log_data,
-			u_int16_t peer_id, uint32_t status)
+void pktlog_callback(void *pdev, enum WDI_EVENT event, void *log_data,
+		u_int16_t peer_id, uint32_t status)
+{
+	bool ring = pktlog_ring_begin();
+
+	__pktlog_callback(pdev, event, log_data);
+	if (ring)
+		pktlog_ring_end();
+}
+
+static void __lit_pktlog_callback(void *context, enum WDI_EVENT event,
+				  void *log_data)
 {
 	switch (event) {
 	case WDI_EVENT_RX_DESC:
@@ -400,6 +409,17 @@ lit_pktlog_callback(void *context, enum WDI_EVENT event, void *log_data,
 	}
 }
 
+void
+lit_pktlog_callback(void *context, enum WDI_EVENT event, void *log_data,
+			u_int16_t peer_id, uint32_t status)
+{
+	bool ring = pktlog_ring_begin();
+
+	__lit_pktlog_callback(context, event, log_data);
+	if (ring)
+		pktlog_ring_end();
+}
+
 #ifdef PKTLOG_LEGACY
 A_STATUS
 wdi_pktlog_unsubscribe(uint8_t pdev_id, uint32_t log_state)
@@ -167,6 +167,11 @@ char *pktlog_getbuf(struct pktlog_dev_t *pl_dev,
 {
 	struct ath_pktlog_arg plarg = { 0, };
 	uint8_t flags = 0;
+	char *buf;
+
+	buf = pktlog_ring_getbuf(pl_hdr, log_size);
+	if (buf)
+		return buf;
 
 	plarg.pl_info = pl_info;
 #ifdef HELIUMPLUS
@@ -27,6 +27,7 @@
 #include <qdf_lro.h>
 #include <wlan_hdd_lro.h>
 #include <wlan_hdd_napi.h>
+#include <ce_api.h>
 #include <wma_api.h>
 
 #include <linux/inet_lro.h>
@@ -121,7 +122,21 @@ QDF_STATUS hdd_lro_rx(struct hdd_adapter *adapter, struct sk_buff *skb)
  */
 void hdd_lro_display_stats(struct hdd_context *hdd_ctx)
 {
-	hdd_debug("LRO stats is broken, will fix it");
+	struct hif_opaque_softc *hif_hdl =
+		(struct hif_opaque_softc *)cds_get_context(QDF_MODULE_ID_HIF);
+	qdf_lro_ctx_t ctx;
+	int i;
+
+	if (!hif_hdl || !hif_napi_enabled(hif_hdl, -1)) {
+		hdd_debug("LRO stats are only kept per NAPI");
+		return;
+	}
+
+	for (i = 0; i < CE_COUNT_MAX; i++) {
+		ctx = hif_napi_get_lro_info(hif_hdl, NAPI_PIPE2ID(i));
+		if (ctx)
+			qdf_lro_display_stats(ctx);
+	}
 }
 
 QDF_STATUS
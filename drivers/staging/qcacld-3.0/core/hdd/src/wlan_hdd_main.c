@@ -9106,6 +9106,207 @@ static inline void hdd_pm_qos_update_request(struct hdd_context *hdd_ctx,
 }
 #endif
 
+/*
+ * Fast ramp: the periodic sample lags the start of a burst by up to a
+ * whole bus_bw_compute_interval, so NAPI poll also counts the frames it
+ * handles over a tenth of that interval. When the count points at a
+ * HIGH level rate the bus bandwidth work is run right away and votes on
+ * the rate seen so far. Lowering the vote is left to the periodic work,
+ * one level at a time and only after bus_bw_decay_periods lower samples
+ * in a row.
+ */
+#define HDD_BUS_BW_RAMP_WINDOW_DIV	10
+
+static bool bus_bw_fast_ramp;
+module_param(bus_bw_fast_ramp, bool, 0644);
+MODULE_PARM_DESC(bus_bw_fast_ramp,
+		 "Raise the bus bandwidth vote on NAPI packet rate spikes");
+
+static uint32_t bus_bw_decay_periods = 3;
+module_param(bus_bw_decay_periods, uint, 0644);
+MODULE_PARM_DESC(bus_bw_decay_periods,
+		 "Lower samples needed before the bus bandwidth vote drops");
+
+/**
+ * struct hdd_bus_bw_ramp - fast ramp state and vote latency stats
+ * @win_pkts: frames polled in the current window
+ * @win_start: start of the current window, in ticks
+ * @pending: bit 0 is set from spike detection until the next vote
+ * @req_us: time the pending spike was detected
+ * @last_run_us: time of the last bus bandwidth sample
+ * @decay_cnt: consecutive samples below the current vote
+ * @ramps: spikes that raised the vote
+ * @lat_last_us: spike to vote latency of the last ramp
+ * @lat_max_us: worst spike to vote latency
+ * @lat_total_us: sum of spike to vote latencies
+ * @held: samples where lowering the vote was deferred
+ */
+struct hdd_bus_bw_ramp {
+	qdf_atomic_t win_pkts;
+	unsigned long win_start;
+	unsigned long pending;
+	uint64_t req_us;
+	uint64_t last_run_us;
+	uint32_t decay_cnt;
+	uint32_t ramps;
+	uint64_t lat_last_us;
+	uint64_t lat_max_us;
+	uint64_t lat_total_us;
+	uint32_t held;
+};
+
+static struct hdd_bus_bw_ramp hdd_bus_bw_ramp;
+
+/**
+ * hdd_bus_bw_napi_sample() - look for a packet rate spike in NAPI poll
+ * @hdd_ctx: handle to hdd context
+ * @work_done: frames handled by this poll
+ *
+ * Called from softirq context, so it only counts and, on a spike, kicks
+ * the bus bandwidth work.
+ *
+ * Return: None
+ */
+void hdd_bus_bw_napi_sample(struct hdd_context *hdd_ctx, int work_done)
+{
+	struct hdd_bus_bw_ramp *ramp = &hdd_bus_bw_ramp;
+	uint32_t interval = hdd_ctx->config->bus_bw_compute_interval;
+	unsigned long now = qdf_system_ticks();
+	unsigned long win;
+	uint64_t pkts;
+
+	if (!bus_bw_fast_ramp || work_done <= 0)
+		return;
+
+	if (hdd_ctx->cur_vote_level >= PLD_BUS_WIDTH_HIGH ||
+	    qdf_atomic_test_bit(0, &ramp->pending))
+		return;
+
+	win = qdf_system_msecs_to_ticks(interval / HDD_BUS_BW_RAMP_WINDOW_DIV);
+	if (qdf_system_time_after(now, ramp->win_start + (win ? win : 1))) {
+		ramp->win_start = now;
+		qdf_atomic_set(&ramp->win_pkts, 0);
+	}
+
+	qdf_atomic_add(work_done, &ramp->win_pkts);
+	pkts = (uint64_t)qdf_atomic_read(&ramp->win_pkts);
+	if (pkts * HDD_BUS_BW_RAMP_WINDOW_DIV <=
+	    hdd_ctx->config->bus_bw_high_threshold)
+		return;
+
+	if (qdf_atomic_test_and_set_bit(0, &ramp->pending))
+		return;
+
+	ramp->req_us = qdf_get_monotonic_boottime();
+	qdf_atomic_set(&ramp->win_pkts, 0);
+	qdf_periodic_work_kick(&hdd_ctx->bus_bw_work);
+}
+
+/**
+ * hdd_bus_bw_ramp_scale() - turn a short sample into a per-interval count
+ * @hdd_ctx: handle to hdd context
+ * @tx_packets: transmit packet count, scaled in place
+ * @rx_packets: receive packet count, scaled in place
+ *
+ * A sample taken early because of a spike covers less than an interval;
+ * scale it so the usual thresholds apply to it.
+ *
+ * Return: None
+ */
+static void hdd_bus_bw_ramp_scale(struct hdd_context *hdd_ctx,
+				  uint64_t *tx_packets, uint64_t *rx_packets)
+{
+	struct hdd_bus_bw_ramp *ramp = &hdd_bus_bw_ramp;
+	uint64_t interval_us = hdd_ctx->config->bus_bw_compute_interval *
+			       (uint64_t)USEC_PER_MSEC;
+	uint64_t now = qdf_get_monotonic_boottime();
+	uint64_t elapsed = now - ramp->last_run_us;
+
+	ramp->last_run_us = now;
+	if (!qdf_atomic_test_bit(0, &ramp->pending))
+		return;
+
+	if (!elapsed || elapsed >= interval_us)
+		return;
+
+	*tx_packets = qdf_do_div(*tx_packets * interval_us, (uint32_t)elapsed);
+	*rx_packets = qdf_do_div(*rx_packets * interval_us, (uint32_t)elapsed);
+}
+
+/**
+ * hdd_bus_bw_ramp_decay() - apply the asymmetric vote decay
+ * @hdd_ctx: handle to hdd context
+ * @next_vote_level: level picked from this sample
+ *
+ * Return: the level to vote for
+ */
+static enum pld_bus_width_type
+hdd_bus_bw_ramp_decay(struct hdd_context *hdd_ctx,
+		      enum pld_bus_width_type next_vote_level)
+{
+	struct hdd_bus_bw_ramp *ramp = &hdd_bus_bw_ramp;
+	enum pld_bus_width_type cur = hdd_ctx->cur_vote_level;
+
+	if (!bus_bw_fast_ramp || next_vote_level >= cur) {
+		ramp->decay_cnt = 0;
+		return next_vote_level;
+	}
+
+	if (++ramp->decay_cnt < bus_bw_decay_periods) {
+		ramp->held++;
+		return cur;
+	}
+
+	ramp->decay_cnt = 0;
+	return cur - 1 > next_vote_level ? cur - 1 : next_vote_level;
+}
+
+/**
+ * hdd_bus_bw_ramp_voted() - account a vote made for a pending spike
+ * @vote_level_change: true if this sample changed the vote
+ *
+ * Return: None
+ */
+static void hdd_bus_bw_ramp_voted(bool vote_level_change)
+{
+	struct hdd_bus_bw_ramp *ramp = &hdd_bus_bw_ramp;
+	uint64_t lat;
+
+	if (!qdf_atomic_test_bit(0, &ramp->pending))
+		return;
+
+	if (vote_level_change) {
+		lat = qdf_get_monotonic_boottime() - ramp->req_us;
+		ramp->ramps++;
+		ramp->lat_last_us = lat;
+		ramp->lat_total_us += lat;
+		if (lat > ramp->lat_max_us)
+			ramp->lat_max_us = lat;
+	}
+
+	qdf_atomic_clear_bit(0, &ramp->pending);
+}
+
+static int bus_bw_ramp_stats_get(char *buffer, const struct kernel_param *kp)
+{
+	struct hdd_bus_bw_ramp *ramp = &hdd_bus_bw_ramp;
+	uint64_t avg = 0;
+
+	if (ramp->ramps)
+		avg = qdf_do_div(ramp->lat_total_us, ramp->ramps);
+
+	return scnprintf(buffer, PAGE_SIZE,
+			 "ramps %u lat_us last %llu avg %llu max %llu held %u",
+			 ramp->ramps, ramp->lat_last_us, avg,
+			 ramp->lat_max_us, ramp->held);
+}
+
+static const struct kernel_param_ops bus_bw_ramp_stats_ops = {
+	.get = bus_bw_ramp_stats_get,
+};
+
+module_param_cb(bus_bw_ramp_stats, &bus_bw_ramp_stats_ops, NULL, 0444);
+
 /**
  * hdd_pld_request_bus_bandwidth() - Function to control bus bandwidth
  * @hdd_ctx - handle to hdd context
@@ -9158,6 +9359,8 @@ static void hdd_pld_request_bus_bandwidth(struct hdd_context *hdd_ctx,
 	else
 		next_vote_level = PLD_BUS_WIDTH_IDLE;
 
+	next_vote_level = hdd_bus_bw_ramp_decay(hdd_ctx, next_vote_level);
+
 	dptrace_high_tput_req =
 			next_vote_level > PLD_BUS_WIDTH_IDLE ? true : false;
 
@@ -9251,6 +9454,8 @@ static void hdd_pld_request_bus_bandwidth(struct hdd_context *hdd_ctx,
 						  0, 0);
 	}
 
+	hdd_bus_bw_ramp_voted(vote_level_change);
+
 	qdf_dp_trace_apply_tput_policy(dptrace_high_tput_req);
 
 	/*
@@ -9593,6 +9798,7 @@ static void __hdd_bus_bw_work_handler(struct hdd_context *hdd_ctx)
 		con_sap_adapter->stats.rx_packets += ipa_rx_packets;
 	}
 
+	hdd_bus_bw_ramp_scale(hdd_ctx, &tx_packets, &rx_packets);
 	hdd_pld_request_bus_bandwidth(hdd_ctx, tx_packets, rx_packets);
 
 	return;
@@ -14756,6 +14962,9 @@ static void __hdd_bus_bw_compute_timer_stop(struct hdd_context *hdd_ctx)
 		pld_request_bus_bandwidth(hdd_ctx->parent_dev,
 					  PLD_BUS_WIDTH_NONE);
 	}
+
+	hdd_bus_bw_ramp.decay_cnt = 0;
+	qdf_atomic_clear_bit(0, &hdd_bus_bw_ramp.pending);
 }
 
 void hdd_bus_bw_compute_timer_stop(struct hdd_context *hdd_ctx)
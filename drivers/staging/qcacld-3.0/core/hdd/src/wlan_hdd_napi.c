@@ -456,7 +456,15 @@ int hdd_napi_serialize(int is_on)
  */
 int hdd_napi_poll(struct napi_struct *napi, int budget)
 {
-	return hif_napi_poll(cds_get_context(QDF_MODULE_ID_HIF), napi, budget);
+	struct hdd_context *hdd_ctx = cds_get_context(QDF_MODULE_ID_HDD);
+	int work_done;
+
+	work_done = hif_napi_poll(cds_get_context(QDF_MODULE_ID_HIF), napi,
+				  budget);
+	if (likely(hdd_ctx))
+		hdd_bus_bw_napi_sample(hdd_ctx, work_done);
+
+	return work_done;
 }
 
 /**
@@ -1152,6 +1152,11 @@ static void __hdd_hard_start_xmit(struct sk_buff *skb,
 	hdd_event_eapol_log(skb, QDF_TX);
 	QDF_NBUF_CB_TX_PACKET_TRACK(skb) = QDF_NBUF_TX_PKT_DATA_TRACK;
 	QDF_NBUF_UPDATE_TX_PKT_COUNT(skb, QDF_NBUF_TX_PKT_HDD);
+	/*
+	 * Let the data path know more frames follow so that the CE write
+	 * index update can be left to the last frame of the burst.
+	 */
+	QDF_NBUF_CB_TX_XMIT_MORE(skb) = skb->xmit_more;
 
 	qdf_dp_trace_set_track(skb, QDF_TX);
 
@@ -282,6 +282,31 @@ struct ath_pktlog_buf {
 	char log_data[0];
 };
 
+/*
+ * Per-CPU pktlog rings, enabled with the pktlog_ring_kb module parameter.
+ * Each ring is mmap()ed read-write from the PKTLOG_PROC_RING entry, the
+ * ring of CPU n at page offset n. The first page holds a struct
+ * ath_pktlog_ring_hdr, the ring data follows it. Records start on an
+ * 8 byte boundary with a struct ath_pktlog_ring_rec followed by an
+ * ath_pktlog_hdr and its payload; a rec of length 0 means the rest of
+ * the lap is unused. The driver only writes head, the reader owns tail.
+ */
+#define PKTLOG_PROC_RING "ring"
+#define PKTLOG_RING_MAGIC 0x706c7267
+
+struct ath_pktlog_ring_hdr {
+	uint32_t magic;         /* PKTLOG_RING_MAGIC */
+	uint32_t size;          /* ring data bytes, a power of two */
+	uint64_t head;          /* bytes produced, free running */
+	uint64_t tail;          /* bytes consumed, free running */
+	uint64_t dropped;       /* records lost to a full ring */
+};
+
+struct ath_pktlog_ring_rec {
+	uint32_t len;           /* bytes including this header */
+	uint32_t reserved;
+};
+
 #define PKTLOG_MOV_RD_IDX(_rd_offset, _log_buf, _log_size)  \
 	do { \
 		if ((_rd_offset + sizeof(struct ath_pktlog_hdr) + \
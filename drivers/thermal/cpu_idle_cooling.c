@@ -0,0 +1,264 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * cpu_idle_cooling.c - cooling a cluster by injecting idle time
+ *
+ * Capping the frequency slows down every instruction, while the heat a
+ * cluster makes follows its average power. Running at full speed and
+ * idling a share of the time takes the same heat out and keeps the
+ * latency of short bursts.
+ *
+ * Every cluster whose cpu nodes have a "thermal-idle" child gets a
+ * cooling device, which thermal zones can map next to or instead of the
+ * cpufreq one:
+ *
+ *	thermal-idle {
+ *		#cooling-cells = <2>;
+ *		duration-us = <10000>;
+ *	};
+ *
+ * The cooling state is the share of idle time, in CPU_IDLE_COOLING_STEP
+ * percent steps. Once per period a timer wakes a SCHED_FIFO thread on
+ * each online cpu of the cluster and they play_idle() for the idle
+ * duration together, so the last one in takes the whole cluster down to
+ * its low power mode through lpm-levels.
+ */
+
+#define pr_fmt(fmt) "cpu_idle_cooling: " fmt
+
+#include <linux/cpu.h>
+#include <linux/cpumask.h>
+#include <linux/hrtimer.h>
+#include <linux/of.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/smpboot.h>
+#include <linux/thermal.h>
+#include <linux/topology.h>
+#include <uapi/linux/sched/types.h>
+
+#define CPU_IDLE_COOLING_STEP		5
+#define CPU_IDLE_COOLING_MAX_STATE	10
+#define CPU_IDLE_COOLING_DURATION_US	10000
+
+/**
+ * struct cpu_idle_cooling_device - idle injection of one cluster
+ * @cdev:	thermal cooling device
+ * @timer:	starts an idle period, re-armed every idle_ms + run_ms
+ * @cpus:	cpus of the cluster
+ * @idle_ms:	length of each injected idle period
+ * @run_ms:	running time between two idle periods
+ * @state:	current cooling state, 0 when not injecting
+ */
+struct cpu_idle_cooling_device {
+	struct thermal_cooling_device *cdev;
+	struct hrtimer timer;
+	struct cpumask cpus;
+	unsigned int idle_ms;
+	unsigned int run_ms;
+	unsigned long state;
+};
+
+struct cpu_idle_inject_thread {
+	struct task_struct *tsk;
+	int should_run;
+};
+
+static DEFINE_PER_CPU(struct cpu_idle_inject_thread, cpu_idle_inject_thread);
+static DEFINE_PER_CPU(struct cpu_idle_cooling_device *, cpu_idle_cooling_dev);
+static DEFINE_MUTEX(cpu_idle_cooling_lock);
+
+static enum hrtimer_restart cpu_idle_cooling_timer_fn(struct hrtimer *timer)
+{
+	struct cpu_idle_cooling_device *idev =
+		container_of(timer, struct cpu_idle_cooling_device, timer);
+	struct cpu_idle_inject_thread *iit;
+	unsigned int cpu, period_ms;
+
+	for_each_cpu_and(cpu, &idev->cpus, cpu_online_mask) {
+		iit = per_cpu_ptr(&cpu_idle_inject_thread, cpu);
+		WRITE_ONCE(iit->should_run, 1);
+		wake_up_process(iit->tsk);
+	}
+
+	period_ms = READ_ONCE(idev->idle_ms) + READ_ONCE(idev->run_ms);
+	hrtimer_forward_now(timer, ms_to_ktime(period_ms));
+
+	return HRTIMER_RESTART;
+}
+
+static int cpu_idle_inject_should_run(unsigned int cpu)
+{
+	return READ_ONCE(per_cpu(cpu_idle_inject_thread, cpu).should_run);
+}
+
+static void cpu_idle_inject_fn(unsigned int cpu)
+{
+	struct cpu_idle_cooling_device *idev;
+
+	idev = per_cpu(cpu_idle_cooling_dev, cpu);
+
+	WRITE_ONCE(per_cpu(cpu_idle_inject_thread, cpu).should_run, 0);
+	if (idev)
+		play_idle(READ_ONCE(idev->idle_ms));
+}
+
+static void cpu_idle_inject_setup(unsigned int cpu)
+{
+	struct sched_param param = { .sched_priority = MAX_USER_RT_PRIO / 2 };
+
+	sched_setscheduler(current, SCHED_FIFO, &param);
+}
+
+static struct smp_hotplug_thread cpu_idle_inject_threads = {
+	.store			= &cpu_idle_inject_thread.tsk,
+	.thread_should_run	= cpu_idle_inject_should_run,
+	.thread_fn		= cpu_idle_inject_fn,
+	.thread_comm		= "idle_inject/%u",
+	.setup			= cpu_idle_inject_setup,
+};
+
+static int cpu_idle_cooling_get_max_state(struct thermal_cooling_device *cdev,
+					  unsigned long *state)
+{
+	*state = CPU_IDLE_COOLING_MAX_STATE;
+	return 0;
+}
+
+static int cpu_idle_cooling_get_cur_state(struct thermal_cooling_device *cdev,
+					  unsigned long *state)
+{
+	struct cpu_idle_cooling_device *idev = cdev->devdata;
+
+	*state = READ_ONCE(idev->state);
+	return 0;
+}
+
+static int cpu_idle_cooling_set_cur_state(struct thermal_cooling_device *cdev,
+					  unsigned long state)
+{
+	struct cpu_idle_cooling_device *idev = cdev->devdata;
+	unsigned int ratio, cpu;
+
+	if (state > CPU_IDLE_COOLING_MAX_STATE)
+		return -EINVAL;
+
+	mutex_lock(&cpu_idle_cooling_lock);
+	if (state == idev->state)
+		goto unlock;
+
+	if (!state) {
+		/* a thread already in play_idle() finishes its period */
+		hrtimer_cancel(&idev->timer);
+		for_each_cpu(cpu, &idev->cpus)
+			WRITE_ONCE(per_cpu(cpu_idle_inject_thread,
+					   cpu).should_run, 0);
+	} else {
+		ratio = state * CPU_IDLE_COOLING_STEP;
+		WRITE_ONCE(idev->run_ms, DIV_ROUND_UP(idev->idle_ms *
+						      (100 - ratio), ratio));
+		if (!idev->state)
+			hrtimer_start(&idev->timer, ms_to_ktime(idev->run_ms),
+				      HRTIMER_MODE_REL);
+	}
+	WRITE_ONCE(idev->state, state);
+unlock:
+	mutex_unlock(&cpu_idle_cooling_lock);
+
+	return 0;
+}
+
+static const struct thermal_cooling_device_ops cpu_idle_cooling_ops = {
+	.get_max_state = cpu_idle_cooling_get_max_state,
+	.get_cur_state = cpu_idle_cooling_get_cur_state,
+	.set_cur_state = cpu_idle_cooling_set_cur_state,
+};
+
+static int __init cpu_idle_cooling_register(struct device_node *np,
+					    const struct cpumask *cpus)
+{
+	struct cpu_idle_cooling_device *idev;
+	struct thermal_cooling_device *cdev;
+	char name[THERMAL_NAME_LENGTH];
+	u32 duration_us = CPU_IDLE_COOLING_DURATION_US;
+	unsigned int cpu;
+
+	idev = kzalloc(sizeof(*idev), GFP_KERNEL);
+	if (!idev)
+		return -ENOMEM;
+
+	of_property_read_u32(np, "duration-us", &duration_us);
+	/* play_idle() takes whole milliseconds */
+	idev->idle_ms = max_t(u32, DIV_ROUND_CLOSEST(duration_us,
+						     USEC_PER_MSEC), 1);
+	cpumask_copy(&idev->cpus, cpus);
+	hrtimer_init(&idev->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	idev->timer.function = cpu_idle_cooling_timer_fn;
+
+	snprintf(name, sizeof(name), "thermal-idle-%u", cpumask_first(cpus));
+	cdev = thermal_of_cooling_device_register(np, name, idev,
+						  &cpu_idle_cooling_ops);
+	if (IS_ERR(cdev)) {
+		kfree(idev);
+		return PTR_ERR(cdev);
+	}
+	idev->cdev = cdev;
+
+	for_each_cpu(cpu, cpus)
+		per_cpu(cpu_idle_cooling_dev, cpu) = idev;
+
+	pr_info("%s: cpus %*pbl, idle %u ms\n", name, cpumask_pr_args(cpus),
+		idev->idle_ms);
+
+	return 0;
+}
+
+static int __init cpu_idle_cooling_init(void)
+{
+	struct device_node *cpu_np, *np;
+	struct cpumask done, cluster;
+	bool threads = false;
+	unsigned int cpu;
+	int ret;
+
+	cpumask_clear(&done);
+	for_each_possible_cpu(cpu) {
+		if (cpumask_test_cpu(cpu, &done))
+			continue;
+
+		cpumask_and(&cluster, topology_core_cpumask(cpu),
+			    cpu_possible_mask);
+		cpumask_set_cpu(cpu, &cluster);
+		cpumask_or(&done, &done, &cluster);
+
+		cpu_np = of_get_cpu_node(cpu, NULL);
+		if (!cpu_np)
+			continue;
+		np = of_get_child_by_name(cpu_np, "thermal-idle");
+		of_node_put(cpu_np);
+		if (!np)
+			continue;
+
+		if (!threads) {
+			ret = smpboot_register_percpu_thread(
+					&cpu_idle_inject_threads);
+			if (ret) {
+				pr_err("Failed to create idle threads: %d\n",
+				       ret);
+				of_node_put(np);
+				return ret;
+			}
+			threads = true;
+		}
+
+		/* the cooling device keeps the reference to np */
+		ret = cpu_idle_cooling_register(np, &cluster);
+		if (ret) {
+			pr_err("Failed to register cpu%u cluster: %d\n",
+			       cpu, ret);
+			of_node_put(np);
+		}
+	}
+
+	return 0;
+}
+late_initcall(cpu_idle_cooling_init);
@@ -236,25 +236,36 @@ static int tsens_tm_remove(struct platform_device *pdev)
 	return 0;
 }
 
+/*
+ * Read every sensor of the controller first and only then hand the
+ * readings to the zones, so all zones see the same instant and none of
+ * them reads its sensor a second time through get_temp.
+ */
 static void tsens_therm_fwk_notify(struct work_struct *work)
 {
-	int i, rc, temp;
+	int i, rc;
+	int temp[TSENS_MAX_SENSORS];
+	DECLARE_BITMAP(valid, TSENS_MAX_SENSORS);
 	struct tsens_device *tmdev =
 		container_of(work, struct tsens_device, therm_fwk_notify);
 
 	TSENS_DBG(tmdev, "Controller %pK\n", &tmdev->phys_addr_tm);
+	bitmap_zero(valid, TSENS_MAX_SENSORS);
 	for (i = 0; i < TSENS_MAX_SENSORS; i++) {
-		if (tmdev->ops->sensor_en(tmdev, i)) {
-			rc = tsens_get_temp(&tmdev->sensor[i], &temp);
-			if (rc) {
-				pr_err("%s: Error:%d reading temp sensor:%d\n",
-					__func__, rc, i);
-				continue;
-			}
-			TSENS_DBG(tmdev, "Calling trip_temp for sensor %d\n",
-					i);
-			of_thermal_handle_trip(tmdev->sensor[i].tzd);
+		if (!tmdev->ops->sensor_en(tmdev, i))
+			continue;
+		rc = tsens_get_temp(&tmdev->sensor[i], &temp[i]);
+		if (rc) {
+			pr_err("%s: Error:%d reading temp sensor:%d\n",
+				__func__, rc, i);
+			continue;
 		}
+		set_bit(i, valid);
+	}
+
+	for_each_set_bit(i, valid, TSENS_MAX_SENSORS) {
+		TSENS_DBG(tmdev, "Calling trip_temp for sensor %d\n", i);
+		of_thermal_handle_trip_temp(tmdev->sensor[i].tzd, temp[i]);
 	}
 }
 
@@ -23,10 +23,42 @@
  */
 
 #include <linux/thermal.h>
+#include <linux/module.h>
+#include <linux/slab.h>
 #include <trace/events/thermal.h>
 
 #include "thermal_core.h"
 
+/*
+ * step_wise_predict steps the same way, but decides on where the zone
+ * temperature is heading predict_ms from now, going by its averaged
+ * slope, rather than on where it is. Mitigation starts before the trip
+ * is crossed and is only released once the projection is below the
+ * hysteresis too, instead of overshooting the trip and then releasing
+ * and hitting it again.
+ *
+ * The slope needs samples: while the projection is within
+ * STEP_PREDICT_ARM_MC of a trip the zone counts as passive, so it is
+ * polled every passive_delay ms, interrupt driven zones included.
+ */
+static unsigned int predict_ms = 2000;
+module_param(predict_ms, uint, 0644);
+
+#define STEP_PREDICT_MIN_SAMPLE_MS	10
+#define STEP_PREDICT_MAX_GAP_MS		10000
+#define STEP_PREDICT_STABLE_SLOPE	100	/* mC/s */
+#define STEP_PREDICT_ARM_MC		5000
+
+struct step_predict {
+	ktime_t last_time;
+	int last_temp;
+	int slope;		/* mC/s, averaged over ~4 samples */
+	int predicted;
+	unsigned long armed;	/* trips the projection is close to */
+};
+
+static struct thermal_governor thermal_gov_step_wise_predict;
+
 /*
  * If the temperature is higher than a trip point,
  *    a. if the trend is THERMAL_TREND_RAISING, use higher cooling
@@ -125,14 +157,76 @@ static void update_passive_instance(struct thermal_zone_device *tz,
 		tz->passive += value;
 }
 
-static void thermal_zone_trip_update(struct thermal_zone_device *tz, int trip)
+/* Called with tz->lock held, once per new temperature of the zone */
+static void step_predict_sample(struct thermal_zone_device *tz,
+				struct step_predict *sp)
+{
+	ktime_t now = ktime_get();
+	int temp = tz->temperature;
+	s64 elapsed;
+	int slope;
+
+	if (temp == THERMAL_TEMP_INVALID || temp == THERMAL_TEMP_INVALID_LOW)
+		return;
+
+	elapsed = ktime_ms_delta(now, sp->last_time);
+	if (sp->last_time && elapsed < STEP_PREDICT_MIN_SAMPLE_MS)
+		return;
+
+	if (!sp->last_time || elapsed > STEP_PREDICT_MAX_GAP_MS) {
+		sp->slope = 0;
+	} else {
+		slope = div64_s64((s64)(temp - sp->last_temp) * MSEC_PER_SEC,
+				  elapsed);
+		sp->slope += (slope - sp->slope) / 4;
+	}
+
+	sp->last_time = now;
+	sp->last_temp = temp;
+	sp->predicted = temp + (int)div_s64((s64)sp->slope *
+					    READ_ONCE(predict_ms),
+					    MSEC_PER_SEC);
+}
+
+static enum thermal_trend step_predict_trend(struct step_predict *sp)
+{
+	if (sp->slope > STEP_PREDICT_STABLE_SLOPE)
+		return THERMAL_TREND_RAISING;
+	if (sp->slope < -STEP_PREDICT_STABLE_SLOPE)
+		return THERMAL_TREND_DROPPING;
+	return THERMAL_TREND_STABLE;
+}
+
+/* Keep the zone polled while the projection is close to @trip */
+static void step_predict_arm(struct thermal_zone_device *tz,
+			     struct step_predict *sp, int trip, int trip_temp)
+{
+	bool was_armed = sp->armed;
+
+	if (trip < 0 || trip >= BITS_PER_LONG)
+		return;
+
+	if (sp->predicted >= trip_temp - STEP_PREDICT_ARM_MC)
+		__set_bit(trip, &sp->armed);
+	else
+		__clear_bit(trip, &sp->armed);
+
+	if (!was_armed && sp->armed)
+		tz->passive++;
+	else if (was_armed && !sp->armed)
+		tz->passive--;
+}
+
+static void thermal_zone_trip_update(struct thermal_zone_device *tz, int trip,
+				     bool predict)
 {
 	int trip_temp, hyst_temp;
 	enum thermal_trip_type trip_type;
-	enum thermal_trend trend;
+	enum thermal_trend trend, inst_trend;
 	struct thermal_instance *instance;
+	struct step_predict *sp = NULL;
 	bool throttle = false;
-	int old_target;
+	int old_target, temp;
 
 	if (trip == THERMAL_TRIPS_NONE) {
 		hyst_temp = trip_temp = tz->forced_passive;
@@ -155,6 +249,17 @@ static void thermal_zone_trip_update(struct thermal_zone_device *tz, int trip)
 
 	mutex_lock(&tz->lock);
 
+	temp = tz->temperature;
+	/* the zone may just have been switched to another governor */
+	if (predict && tz->governor == &thermal_gov_step_wise_predict)
+		sp = tz->governor_data;
+	if (sp) {
+		step_predict_sample(tz, sp);
+		step_predict_arm(tz, sp, trip, trip_temp);
+		trend = step_predict_trend(sp);
+		temp = max(temp, sp->predicted);
+	}
+
 	list_for_each_entry(instance, &tz->thermal_instances, tz_node) {
 		if (instance->trip != trip)
 			continue;
@@ -167,14 +272,20 @@ static void thermal_zone_trip_update(struct thermal_zone_device *tz, int trip)
 		 * limit if the temperature is above the hysteresis
 		 * temperature.
 		 */
-		if (tz->temperature >= trip_temp ||
-			(tz->temperature > hyst_temp &&
+		if (temp >= trip_temp ||
+			(temp > hyst_temp &&
 			 old_target != THERMAL_NO_TARGET))
 			throttle = true;
 		else
 			throttle = false;
 
-		instance->target = get_target_state(instance, trend, throttle);
+		/* a steady zone below the hysteresis still gets released */
+		inst_trend = trend;
+		if (sp && !throttle && trend == THERMAL_TREND_STABLE)
+			inst_trend = THERMAL_TREND_DROPPING;
+
+		instance->target = get_target_state(instance, inst_trend,
+						    throttle);
 		dev_dbg(&instance->cdev->device, "old_target=%d, target=%d\n",
 					old_target, (int)instance->target);
 
@@ -223,14 +334,15 @@ static void thermal_zone_trip_update(struct thermal_zone_device *tz, int trip)
  * step. If the zone is 'cooling down' it brings back the performance of
  * the devices by one step.
  */
-static int step_wise_throttle(struct thermal_zone_device *tz, int trip)
+static int __step_wise_throttle(struct thermal_zone_device *tz, int trip,
+				bool predict)
 {
 	struct thermal_instance *instance;
 
-	thermal_zone_trip_update(tz, trip);
+	thermal_zone_trip_update(tz, trip, predict);
 
 	if (tz->forced_passive)
-		thermal_zone_trip_update(tz, THERMAL_TRIPS_NONE);
+		thermal_zone_trip_update(tz, THERMAL_TRIPS_NONE, predict);
 
 	mutex_lock(&tz->lock);
 
@@ -242,17 +354,70 @@ static int step_wise_throttle(struct thermal_zone_device *tz, int trip)
 	return 0;
 }
 
+static int step_wise_throttle(struct thermal_zone_device *tz, int trip)
+{
+	return __step_wise_throttle(tz, trip, false);
+}
+
+static int step_wise_predict_throttle(struct thermal_zone_device *tz,
+				      int trip)
+{
+	return __step_wise_throttle(tz, trip, true);
+}
+
+static int step_wise_predict_bind(struct thermal_zone_device *tz)
+{
+	struct step_predict *sp;
+
+	sp = kzalloc(sizeof(*sp), GFP_KERNEL);
+	if (!sp)
+		return -ENOMEM;
+
+	tz->governor_data = sp;
+	return 0;
+}
+
+/* Called with tz->lock held */
+static void step_wise_predict_unbind(struct thermal_zone_device *tz)
+{
+	struct step_predict *sp = tz->governor_data;
+
+	if (sp->armed)
+		tz->passive--;
+
+	kfree(sp);
+	tz->governor_data = NULL;
+}
+
 static struct thermal_governor thermal_gov_step_wise = {
 	.name		= "step_wise",
 	.throttle	= step_wise_throttle,
 };
 
+static struct thermal_governor thermal_gov_step_wise_predict = {
+	.name		= "step_wise_predict",
+	.bind_to_tz	= step_wise_predict_bind,
+	.unbind_from_tz	= step_wise_predict_unbind,
+	.throttle	= step_wise_predict_throttle,
+};
+
 int thermal_gov_step_wise_register(void)
 {
-	return thermal_register_governor(&thermal_gov_step_wise);
+	int ret;
+
+	ret = thermal_register_governor(&thermal_gov_step_wise);
+	if (ret)
+		return ret;
+
+	ret = thermal_register_governor(&thermal_gov_step_wise_predict);
+	if (ret)
+		thermal_unregister_governor(&thermal_gov_step_wise);
+
+	return ret;
 }
 
 void thermal_gov_step_wise_unregister(void)
 {
+	thermal_unregister_governor(&thermal_gov_step_wise_predict);
 	thermal_unregister_governor(&thermal_gov_step_wise);
 }
@@ -29,6 +29,7 @@
 
 #include <linux/usb/composite.h>
 #include <linux/usb/functionfs.h>
+#include <linux/usb/functionfs_batch.h>
 
 #include <linux/aio.h>
 #include <linux/mmu_context.h>
@@ -192,6 +193,9 @@ struct ffs_epfile {
 	struct ffs_buffer		*read_buffer;
 #define READ_BUFFER_DROP ((struct ffs_buffer *)ERR_PTR(-ESHUTDOWN))
 
+	/* Set up by FUNCTIONFS_BATCH_SETUP, freed when that file closes */
+	struct ffs_batch		*batch;	/* P: epfile->mutex */
+
 	char				name[5];
 
 	unsigned char			in;	/* P: ffs->eps_lock */
@@ -206,6 +210,37 @@ struct ffs_buffer {
 	char storage[];
 };
 
+/*  ffs_batch structure ******************************************************/
+
+#define FFS_BATCH_MAX_BUFS	64
+#define FFS_BATCH_MAX_BUF_SIZE	(1 << 20)
+
+struct ffs_batch_buf {
+	struct ffs_batch *batch;
+	struct usb_request *req;
+	void *data;
+	unsigned int index;
+	bool busy;			/* P: batch->lock */
+	struct list_head done;		/* P: batch->lock */
+};
+
+struct ffs_batch {
+	struct ffs_data *ffs;
+	struct file *file;
+	struct ffs_ep *ep;
+	struct usb_ep *usb_ep;
+	size_t buf_size;
+	unsigned int nr_bufs;
+
+	spinlock_t lock;
+	wait_queue_head_t wait;
+	struct list_head done;		/* P: lock */
+	unsigned int nr_done;		/* P: lock */
+	unsigned int inflight;		/* P: lock */
+
+	struct ffs_batch_buf bufs[];
+};
+
 /*  ffs_io_data structure ***************************************************/
 
 struct ffs_io_data {
@@ -1182,6 +1217,327 @@ static ssize_t ffs_epfile_read_iter(struct kiocb *kiocb, struct iov_iter *to)
 	return res;
 }
 
+/* Batched transfers ********************************************************/
+
+static void ffs_epfile_batch_complete(struct usb_ep *_ep,
+				      struct usb_request *req)
+{
+	struct ffs_batch_buf *buf = req->context;
+	struct ffs_batch *batch = buf->batch;
+	unsigned long flags;
+
+	ENTER();
+
+	spin_lock_irqsave(&batch->lock, flags);
+	list_add_tail(&buf->done, &batch->done);
+	batch->nr_done++;
+	batch->inflight--;
+	spin_unlock_irqrestore(&batch->lock, flags);
+
+	wake_up(&batch->wait);
+	if (batch->ffs->ffs_eventfd)
+		eventfd_signal(batch->ffs->ffs_eventfd, 1);
+}
+
+static void ffs_epfile_batch_free(struct ffs_epfile *epfile)
+{
+	struct ffs_batch *batch = epfile->batch;
+	struct ffs_batch_buf *buf;
+	unsigned int i;
+
+	/*
+	 * The completion may run from usb_ep_dequeue(), so batch->lock is not
+	 * held here. A disabled endpoint already gave them all back.
+	 */
+	spin_lock_irq(&epfile->ffs->eps_lock);
+	for (i = 0; i < batch->nr_bufs; i++) {
+		buf = &batch->bufs[i];
+		if (buf->busy && epfile->ep)
+			usb_ep_dequeue(batch->usb_ep, buf->req);
+	}
+	spin_unlock_irq(&epfile->ffs->eps_lock);
+
+	wait_event(batch->wait, !READ_ONCE(batch->inflight));
+
+	for (i = 0; i < batch->nr_bufs; i++) {
+		buf = &batch->bufs[i];
+		if (buf->req)
+			usb_ep_free_request(batch->usb_ep, buf->req);
+		/* pages still mapped by user space are freed on munmap() */
+		if (buf->data)
+			free_pages_exact(buf->data, batch->buf_size);
+	}
+	kfree(batch);
+	epfile->batch = NULL;
+}
+
+static int ffs_epfile_batch_setup(struct file *file,
+				  struct ffs_epfile *epfile, struct ffs_ep *ep,
+				  struct usb_ffs_batch_setup __user *arg)
+{
+	struct usb_ffs_batch_setup setup;
+	struct ffs_batch_buf *buf;
+	struct ffs_batch *batch;
+	unsigned int i;
+	int ret;
+
+	if (copy_from_user(&setup, arg, sizeof(setup)))
+		return -EFAULT;
+	if (!setup.nr_bufs || setup.nr_bufs > FFS_BATCH_MAX_BUFS ||
+	    !setup.buf_size || setup.buf_size > FFS_BATCH_MAX_BUF_SIZE ||
+	    !PAGE_ALIGNED(setup.buf_size))
+		return -EINVAL;
+
+	batch = kzalloc(sizeof(*batch) + setup.nr_bufs * sizeof(*buf),
+			GFP_KERNEL);
+	if (unlikely(!batch))
+		return -ENOMEM;
+
+	batch->ffs = epfile->ffs;
+	batch->file = file;
+	batch->ep = ep;
+	batch->usb_ep = ep->ep;
+	batch->buf_size = setup.buf_size;
+	batch->nr_bufs = setup.nr_bufs;
+	spin_lock_init(&batch->lock);
+	init_waitqueue_head(&batch->wait);
+	INIT_LIST_HEAD(&batch->done);
+
+	ret = ffs_mutex_lock(&epfile->mutex, file->f_flags & O_NONBLOCK);
+	if (unlikely(ret))
+		goto error;
+
+	ret = -EBUSY;
+	if (epfile->batch)
+		goto error_mutex;
+	epfile->batch = batch;
+
+	ret = -ENOMEM;
+	for (i = 0; i < batch->nr_bufs; i++) {
+		buf = &batch->bufs[i];
+		buf->batch = batch;
+		buf->index = i;
+		INIT_LIST_HEAD(&buf->done);
+
+		/* split into single pages which mmap() can insert */
+		buf->data = alloc_pages_exact(batch->buf_size,
+					      GFP_KERNEL | __GFP_ZERO);
+		if (unlikely(!buf->data))
+			goto error_free;
+
+		buf->req = usb_ep_alloc_request(batch->usb_ep, GFP_KERNEL);
+		if (unlikely(!buf->req))
+			goto error_free;
+		buf->req->buf = buf->data;
+		buf->req->context = buf;
+		buf->req->complete = ffs_epfile_batch_complete;
+	}
+
+	mutex_unlock(&epfile->mutex);
+	return 0;
+
+error_free:
+	ffs_epfile_batch_free(epfile);
+	batch = NULL;
+error_mutex:
+	mutex_unlock(&epfile->mutex);
+error:
+	kfree(batch);
+	return ret;
+}
+
+static struct ffs_batch *ffs_epfile_get_batch(struct file *file,
+					      struct ffs_epfile *epfile)
+{
+	/* only the file which set it up may use it, and it never changes */
+	struct ffs_batch *batch = READ_ONCE(epfile->batch);
+
+	return batch && batch->file == file ? batch : NULL;
+}
+
+static int ffs_epfile_batch_submit(struct file *file,
+				   struct ffs_epfile *epfile,
+				   struct usb_ffs_batch_submit __user *arg)
+{
+	struct ffs_batch *batch = ffs_epfile_get_batch(file, epfile);
+	struct usb_ffs_batch_submit submit;
+	struct usb_ffs_batch_io *ios;
+	struct ffs_batch_buf *buf;
+	struct usb_request *req;
+	unsigned int i;
+	int ret = 0;
+
+	if (!batch)
+		return -EINVAL;
+	if (copy_from_user(&submit, arg, sizeof(submit)))
+		return -EFAULT;
+	if (!submit.nr || submit.nr > batch->nr_bufs)
+		return -EINVAL;
+
+	ios = memdup_user(u64_to_user_ptr(submit.ios),
+			  submit.nr * sizeof(*ios));
+	if (IS_ERR(ios))
+		return PTR_ERR(ios);
+
+	spin_lock_irq(&epfile->ffs->eps_lock);
+	/* In the meantime, endpoint got disabled or changed. */
+	if (epfile->ep != batch->ep || batch->ep->ep != batch->usb_ep) {
+		ret = -ESHUTDOWN;
+		goto done;
+	}
+
+	for (i = 0; i < submit.nr; i++) {
+		if (ios[i].index >= batch->nr_bufs ||
+		    ios[i].length > batch->buf_size) {
+			ret = -EINVAL;
+			break;
+		}
+		buf = &batch->bufs[ios[i].index];
+
+		spin_lock(&batch->lock);
+		if (buf->busy) {
+			spin_unlock(&batch->lock);
+			ret = -EBUSY;
+			break;
+		}
+		buf->busy = true;
+		batch->inflight++;
+		spin_unlock(&batch->lock);
+
+		req = buf->req;
+		req->length = ios[i].length;
+		/*
+		 * Controller may require buffer size to be aligned to
+		 * maxpacketsize of an out endpoint, buf_size always is.
+		 */
+		if (!epfile->in)
+			req->length = usb_ep_align_maybe(epfile->ffs->gadget,
+							  batch->usb_ep,
+							  req->length);
+
+		ret = usb_ep_queue(batch->usb_ep, req, GFP_ATOMIC);
+		if (unlikely(ret)) {
+			spin_lock(&batch->lock);
+			buf->busy = false;
+			batch->inflight--;
+			spin_unlock(&batch->lock);
+			break;
+		}
+	}
+	if (i)
+		ret = i;
+done:
+	spin_unlock_irq(&epfile->ffs->eps_lock);
+	kfree(ios);
+
+	return ret;
+}
+
+static int ffs_epfile_batch_reap(struct file *file, struct ffs_epfile *epfile,
+				 struct usb_ffs_batch_reap __user *arg)
+{
+	struct ffs_batch *batch = ffs_epfile_get_batch(file, epfile);
+	struct usb_ffs_batch_event *events;
+	struct usb_ffs_batch_reap reap;
+	struct ffs_batch_buf *buf;
+	unsigned int n = 0;
+	int ret;
+
+	if (!batch)
+		return -EINVAL;
+	if (copy_from_user(&reap, arg, sizeof(reap)))
+		return -EFAULT;
+	if (!reap.nr)
+		return -EINVAL;
+	reap.nr = min(reap.nr, batch->nr_bufs);
+	reap.min_nr = clamp(reap.min_nr, 1U, reap.nr);
+
+	events = kmalloc_array(reap.nr, sizeof(*events), GFP_KERNEL);
+	if (unlikely(!events))
+		return -ENOMEM;
+
+	if (file->f_flags & O_NONBLOCK) {
+		ret = -EAGAIN;
+		if (!READ_ONCE(batch->nr_done))
+			goto out;
+	} else {
+		/* or whatever there is once nothing is in flight */
+		ret = wait_event_interruptible(batch->wait,
+				READ_ONCE(batch->nr_done) >= reap.min_nr ||
+				!READ_ONCE(batch->inflight));
+		if (ret)
+			goto out;
+	}
+
+	spin_lock_irq(&batch->lock);
+	while (n < reap.nr && !list_empty(&batch->done)) {
+		buf = list_first_entry(&batch->done, struct ffs_batch_buf,
+				       done);
+		list_del_init(&buf->done);
+		batch->nr_done--;
+		buf->busy = false;
+
+		events[n].index = buf->index;
+		events[n].status = buf->req->status ? buf->req->status :
+						      buf->req->actual;
+		n++;
+	}
+	spin_unlock_irq(&batch->lock);
+
+	ret = n;
+	if (copy_to_user(u64_to_user_ptr(reap.events), events,
+			 n * sizeof(*events)))
+		ret = -EFAULT;
+out:
+	kfree(events);
+	return ret;
+}
+
+static int ffs_epfile_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct ffs_epfile *epfile = file->private_data;
+	struct ffs_batch *batch = ffs_epfile_get_batch(file, epfile);
+	unsigned long addr, off = vma->vm_pgoff << PAGE_SHIFT;
+	size_t size = vma->vm_end - vma->vm_start;
+	int ret;
+
+	ENTER();
+
+	if (!batch)
+		return -EINVAL;
+	if (off > batch->nr_bufs * batch->buf_size ||
+	    size > batch->nr_bufs * batch->buf_size - off)
+		return -EINVAL;
+
+	vma->vm_flags |= VM_DONTEXPAND | VM_DONTDUMP;
+
+	for (addr = vma->vm_start; addr < vma->vm_end; addr += PAGE_SIZE) {
+		unsigned int i = off / batch->buf_size;
+
+		ret = vm_insert_page(vma, addr, virt_to_page(
+				batch->bufs[i].data + off % batch->buf_size));
+		if (unlikely(ret))
+			return ret;
+		off += PAGE_SIZE;
+	}
+
+	return 0;
+}
+
+static unsigned int ffs_epfile_poll(struct file *file, poll_table *wait)
+{
+	struct ffs_epfile *epfile = file->private_data;
+	struct ffs_batch *batch = ffs_epfile_get_batch(file, epfile);
+
+	/* plain reads and writes block, as before there was a poll */
+	if (!batch)
+		return DEFAULT_POLLMASK;
+
+	poll_wait(file, &batch->wait, wait);
+
+	return READ_ONCE(batch->nr_done) ? POLLIN | POLLRDNORM : 0;
+}
+
 static int
 ffs_epfile_release(struct inode *inode, struct file *file)
 {
@@ -1189,6 +1545,12 @@ ffs_epfile_release(struct inode *inode, struct file *file)
 
 	ENTER();
 
+	if (ffs_epfile_get_batch(file, epfile)) {
+		mutex_lock(&epfile->mutex);
+		ffs_epfile_batch_free(epfile);
+		mutex_unlock(&epfile->mutex);
+	}
+
 	__ffs_epfile_read_buffer_free(epfile);
 	ffs_data_closed(epfile->ffs);
 
@@ -1219,6 +1581,18 @@ static long ffs_epfile_ioctl(struct file *file, unsigned code,
 			return -EINTR;
 	}
 
+	switch (code) {
+	case FUNCTIONFS_BATCH_SETUP:
+		return ffs_epfile_batch_setup(file, epfile, ep,
+					      (void __user *)value);
+	case FUNCTIONFS_BATCH_SUBMIT:
+		return ffs_epfile_batch_submit(file, epfile,
+					       (void __user *)value);
+	case FUNCTIONFS_BATCH_REAP:
+		return ffs_epfile_batch_reap(file, epfile,
+					     (void __user *)value);
+	}
+
 	spin_lock_irq(&epfile->ffs->eps_lock);
 
 	/* In the meantime, endpoint got disabled or changed. */
@@ -1283,6 +1657,8 @@ static const struct file_operations ffs_epfile_operations = {
 	.read_iter =	ffs_epfile_read_iter,
 	.release =	ffs_epfile_release,
 	.unlocked_ioctl =	ffs_epfile_ioctl,
+	.mmap =		ffs_epfile_mmap,
+	.poll =		ffs_epfile_poll,
 };
 
 
@@ -25,6 +25,8 @@
 #include <linux/wait.h>
 #include <linux/err.h>
 #include <linux/interrupt.h>
+#include <linux/pagemap.h>
+#include <linux/scatterlist.h>
 
 #include <linux/seq_file.h>
 #include <linux/debugfs.h>
@@ -73,6 +75,10 @@
 /* number of tx and rx requests to allocate */
 #define MTP_TX_REQ_MAX 8
 #define RX_REQ_MAX 2
+/* page cache backed tx: requests and pages per request */
+#define MTP_TX_SG_REQ_MAX 16
+#define MTP_TX_SG_PAGES 64
+#define MTP_TX_SG_MIN_LEN (16 * PAGE_SIZE)
 #define INTR_REQ_MAX 5
 
 /* ID for Microsoft MTP OS String */
@@ -100,8 +106,41 @@ module_param(mtp_tx_req_len, uint, 0644);
 unsigned int mtp_tx_reqs = MTP_TX_REQ_MAX;
 module_param(mtp_tx_reqs, uint, 0644);
 
+/*
+ * Send files by handing their page cache pages to sg capable controllers
+ * instead of copying them into the tx buffers. The request size starts at
+ * MTP_TX_SG_MIN_LEN and doubles, up to mtp_tx_sg_max_len, each time the
+ * controller runs out of queued requests.
+ */
+static bool mtp_tx_zero_copy = true;
+module_param(mtp_tx_zero_copy, bool, 0644);
+
+static unsigned int mtp_tx_sg_max_len = MTP_TX_SG_PAGES * PAGE_SIZE;
+module_param(mtp_tx_sg_max_len, uint, 0644);
+
 static const char mtp_shortname[] = DRIVER_NAME "_usb";
 
+/* one file transfer, plus running totals over all of them */
+struct mtp_xfer_stats {
+	u64 bytes;
+	u64 zero_copy_bytes;
+	unsigned int time_us;
+	/* waiting for the host to take or send data */
+	unsigned int wait_us;
+	/* the controller had no request queued */
+	unsigned int stalls;
+	unsigned int max_req_len;
+	u64 total_bytes;
+	u64 total_us;
+};
+
+/* context of a page cache backed tx request */
+struct mtp_tx_sg {
+	struct scatterlist sg[MTP_TX_SG_PAGES + 1];
+	struct page *pages[MTP_TX_SG_PAGES];
+	unsigned int nr_pages;
+};
+
 struct mtp_dev {
 	struct usb_function function;
 	struct usb_composite_dev *cdev;
@@ -119,6 +158,9 @@ struct mtp_dev {
 	atomic_t ioctl_excl;
 
 	struct list_head tx_idle;
+	struct list_head tx_sg_idle;
+	/* tx_sg_idle requests owned by the controller */
+	atomic_t tx_sg_queued;
 	struct list_head intr_idle;
 
 	wait_queue_head_t read_wq;
@@ -147,6 +189,8 @@ struct mtp_dev {
 	} perf[MAX_ITERATION];
 	unsigned int dbg_read_index;
 	unsigned int dbg_write_index;
+	struct mtp_xfer_stats tx_stats;
+	struct mtp_xfer_stats rx_stats;
 	struct mutex  read_mutex;
 };
 
@@ -422,6 +466,44 @@ static void mtp_request_free(struct usb_request *req, struct usb_ep *ep)
 	}
 }
 
+static struct usb_request *mtp_tx_sg_request_new(struct usb_ep *ep)
+{
+	struct usb_request *req;
+	struct mtp_tx_sg *tx;
+
+	/* the buffer only carries the data header */
+	req = mtp_request_new(ep, sizeof(struct mtp_data_header));
+	if (!req)
+		return NULL;
+
+	tx = kzalloc(sizeof(*tx), GFP_KERNEL);
+	if (!tx) {
+		mtp_request_free(req, ep);
+		return NULL;
+	}
+	req->context = tx;
+	req->sg = tx->sg;
+
+	return req;
+}
+
+static void mtp_tx_sg_request_free(struct usb_request *req, struct usb_ep *ep)
+{
+	if (req) {
+		kfree(req->context);
+		mtp_request_free(req, ep);
+	}
+}
+
+/* drop the page cache pages a tx request was sending */
+static void mtp_tx_sg_release(struct usb_request *req)
+{
+	struct mtp_tx_sg *tx = req->context;
+
+	while (tx->nr_pages)
+		put_page(tx->pages[--tx->nr_pages]);
+}
+
 static inline int mtp_lock(atomic_t *excl)
 {
 	if (atomic_inc_return(excl) == 1) {
@@ -478,6 +560,20 @@ static void mtp_complete_in(struct usb_ep *ep, struct usb_request *req)
 	wake_up(&dev->write_wq);
 }
 
+static void mtp_complete_in_sg(struct usb_ep *ep, struct usb_request *req)
+{
+	struct mtp_dev *dev = _mtp_dev;
+
+	if (req->status != 0 && dev->state != STATE_OFFLINE)
+		dev->state = STATE_ERROR;
+
+	mtp_tx_sg_release(req);
+	atomic_dec(&dev->tx_sg_queued);
+	mtp_req_put(dev, &dev->tx_sg_idle, req);
+
+	wake_up(&dev->write_wq);
+}
+
 static void mtp_complete_out(struct usb_ep *ep, struct usb_request *req)
 {
 	struct mtp_dev *dev = _mtp_dev;
@@ -558,6 +654,15 @@ static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
 		mtp_req_put(dev, &dev->tx_idle, req);
 	}
 
+	/* optional, files are copied through tx_idle without them */
+	for (i = 0; cdev->gadget->sg_supported && i < MTP_TX_SG_REQ_MAX; i++) {
+		req = mtp_tx_sg_request_new(dev->ep_in);
+		if (!req)
+			break;
+		req->complete = mtp_complete_in_sg;
+		mtp_req_put(dev, &dev->tx_sg_idle, req);
+	}
+
 	/*
 	 * The RX buffer should be aligned to EP max packet for
 	 * some controllers.  At bind time, we don't know the
@@ -802,11 +907,212 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 	return r;
 }
 
+static void mtp_xfer_stats_start(struct mtp_xfer_stats *st)
+{
+	st->bytes = 0;
+	st->zero_copy_bytes = 0;
+	st->wait_us = 0;
+	st->stalls = 0;
+	st->max_req_len = 0;
+}
+
+static void mtp_xfer_stats_end(struct mtp_xfer_stats *st, ktime_t start)
+{
+	st->time_us = ktime_us_delta(ktime_get(), start);
+	st->total_bytes += st->bytes;
+	st->total_us += st->time_us;
+}
+
+static bool mtp_tx_can_splice(struct mtp_dev *dev, struct file *filp)
+{
+	struct inode *inode = file_inode(filp);
+
+	if (!mtp_tx_zero_copy || list_empty(&dev->tx_sg_idle))
+		return false;
+
+	return S_ISREG(inode->i_mode) && !IS_DAX(inode) &&
+		filp->f_mapping->a_ops->readpage;
+}
+
+/*
+ * Describe @len bytes at @pos of @filp in the sg list of @req, starting at
+ * entry @nents, with a reference on each page cache page. Returns the number
+ * of bytes described, less than @len at the end of the file, or an errno
+ * with no page held.
+ */
+static ssize_t mtp_tx_sg_fill(struct usb_request *req, struct file *filp,
+			      loff_t pos, size_t len, int nents)
+{
+	struct address_space *mapping = filp->f_mapping;
+	struct mtp_tx_sg *tx = req->context;
+	loff_t isize = i_size_read(mapping->host);
+	pgoff_t index, last;
+	unsigned int off, bytes;
+	struct page *page;
+	size_t done = 0;
+
+	if (pos >= isize)
+		return 0;
+	len = min_t(loff_t, len, isize - pos);
+	index = pos >> PAGE_SHIFT;
+	last = (pos + len - 1) >> PAGE_SHIFT;
+
+	while (done < len) {
+		page = find_get_page(mapping, index);
+		if (!page)
+			page_cache_sync_readahead(mapping, &filp->f_ra, filp,
+						  index, last - index + 1);
+		else if (PageReadahead(page))
+			page_cache_async_readahead(mapping, &filp->f_ra, filp,
+						   page, index,
+						   last - index + 1);
+		if (!page || !PageUptodate(page)) {
+			if (page)
+				put_page(page);
+			page = read_mapping_page(mapping, index, filp);
+			if (IS_ERR(page)) {
+				mtp_tx_sg_release(req);
+				return PTR_ERR(page);
+			}
+		}
+
+		off = (pos + done) & ~PAGE_MASK;
+		bytes = min_t(size_t, PAGE_SIZE - off, len - done);
+		tx->pages[tx->nr_pages++] = page;
+		sg_set_page(&req->sg[nents++], page, bytes, off);
+		done += bytes;
+		index++;
+	}
+
+	return done;
+}
+
+/* send the page cache pages of a file without copying them */
+static int mtp_send_file_sg(struct mtp_dev *dev, struct file *filp,
+			    loff_t offset, int64_t count, int hdr_size,
+			    int sendZLP)
+{
+	struct mtp_xfer_stats *st = &dev->tx_stats;
+	struct usb_request *req = NULL;
+	struct mtp_data_header *header;
+	struct mtp_tx_sg *tx;
+	size_t len, max_len, want;
+	ssize_t xfer;
+	ktime_t start_time;
+	bool first = true;
+	int nents, ret;
+	int r = 0;
+
+	max_len = clamp_t(size_t, rounddown(mtp_tx_sg_max_len, PAGE_SIZE),
+			  MTP_TX_SG_MIN_LEN, MTP_TX_SG_PAGES * PAGE_SIZE);
+	len = MTP_TX_SG_MIN_LEN;
+
+	while (count > 0 || sendZLP) {
+		/* so we exit after sending ZLP */
+		if (count == 0)
+			sendZLP = 0;
+
+		/* get an idle tx request to use */
+		start_time = ktime_get();
+		ret = wait_event_interruptible(dev->write_wq,
+			(req = mtp_req_get(dev, &dev->tx_sg_idle))
+			|| dev->state != STATE_BUSY);
+		st->wait_us += ktime_us_delta(ktime_get(), start_time);
+		if (dev->state == STATE_CANCELED) {
+			r = -ECANCELED;
+			break;
+		}
+		if (!req) {
+			mtp_log("request NULL ret:%d state:%d\n",
+				ret, dev->state);
+			r = ret;
+			break;
+		}
+
+		tx = req->context;
+		sg_init_table(req->sg, MTP_TX_SG_PAGES + 1);
+		nents = 0;
+		if (hdr_size) {
+			/* prepend MTP data header */
+			header = req->buf;
+			header->length = (count > MTP_MAX_FILE_SIZE) ?
+				MTP_MAX_FILE_SIZE : __cpu_to_le32(count);
+			header->type = __cpu_to_le16(2); /* data packet */
+			header->command = __cpu_to_le16(dev->xfer_command);
+			header->transaction_id =
+					__cpu_to_le32(dev->xfer_transaction_id);
+			sg_set_buf(&req->sg[nents++], header, hdr_size);
+		}
+
+		want = min_t(int64_t, count, len);
+		xfer = 0;
+		if (want > hdr_size) {
+			xfer = mtp_tx_sg_fill(req, filp, offset,
+					      want - hdr_size, nents);
+			if (xfer < 0) {
+				r = xfer;
+				break;
+			}
+			nents += tx->nr_pages;
+		}
+		if (nents)
+			sg_mark_end(&req->sg[nents - 1]);
+		req->num_sgs = nents;
+		req->length = xfer + hdr_size;
+		offset += xfer;
+		hdr_size = 0;
+
+		/* the previous requests all completed while we were reading */
+		if (!first && !atomic_read(&dev->tx_sg_queued)) {
+			st->stalls++;
+			len = min(len * 2, max_len);
+		}
+		first = false;
+
+		atomic_inc(&dev->tx_sg_queued);
+		ret = usb_ep_queue(dev->ep_in, req, GFP_KERNEL);
+		if (ret < 0) {
+			mtp_log("xfer error %d\n", ret);
+			atomic_dec(&dev->tx_sg_queued);
+			mtp_tx_sg_release(req);
+			if (dev->state != STATE_OFFLINE)
+				dev->state = STATE_ERROR;
+			r = -EIO;
+			break;
+		}
+
+		st->bytes += req->length;
+		st->zero_copy_bytes += xfer;
+		st->max_req_len = max(st->max_req_len, req->length);
+		if (req->length < want) {
+			/* end of file, the short packet ends the transfer */
+			count = 0;
+			sendZLP = req->length &&
+				!(req->length & (dev->ep_in->maxpacket - 1));
+		} else {
+			count -= req->length;
+		}
+
+		/* zero this so we don't try to free it on error exit */
+		req = NULL;
+	}
+
+	if (req)
+		mtp_req_put(dev, &dev->tx_sg_idle, req);
+
+	/* the file pages are ours until the controller is done with them */
+	wait_event_interruptible(dev->write_wq,
+		!atomic_read(&dev->tx_sg_queued) || dev->state != STATE_BUSY);
+
+	return r;
+}
+
 /* read from a local file and write to USB */
 static void send_file_work(struct work_struct *data)
 {
 	struct mtp_dev *dev = container_of(data, struct mtp_dev,
 						send_file_work);
+	struct mtp_xfer_stats *st = &dev->tx_stats;
 	struct usb_request *req = 0;
 	struct mtp_data_header *header;
 	struct file *filp;
@@ -815,7 +1121,7 @@ static void send_file_work(struct work_struct *data)
 	int xfer, ret, hdr_size;
 	int r = 0;
 	int sendZLP = 0;
-	ktime_t start_time;
+	ktime_t start_time, xfer_start;
 
 	/* read our parameters */
 	smp_rmb();
@@ -838,6 +1144,14 @@ static void send_file_work(struct work_struct *data)
 	if ((count & (dev->ep_in->maxpacket - 1)) == 0)
 		sendZLP = 1;
 
+	mtp_xfer_stats_start(st);
+	xfer_start = ktime_get();
+	if (mtp_tx_can_splice(dev, filp)) {
+		r = mtp_send_file_sg(dev, filp, offset, count, hdr_size,
+				     sendZLP);
+		goto done;
+	}
+
 	while (count > 0 || sendZLP) {
 		/* so we exit after sending ZLP */
 		if (count == 0)
@@ -845,9 +1159,11 @@ static void send_file_work(struct work_struct *data)
 
 		/* get an idle tx request to use */
 		req = 0;
+		start_time = ktime_get();
 		ret = wait_event_interruptible(dev->write_wq,
 			(req = mtp_req_get(dev, &dev->tx_idle))
 			|| dev->state != STATE_BUSY);
+		st->wait_us += ktime_us_delta(ktime_get(), start_time);
 		if (dev->state == STATE_CANCELED) {
 			r = -ECANCELED;
 			break;
@@ -903,6 +1219,8 @@ static void send_file_work(struct work_struct *data)
 			break;
 		}
 
+		st->bytes += xfer;
+		st->max_req_len = max_t(unsigned int, st->max_req_len, xfer);
 		count -= xfer;
 
 		/* zero this so we don't try to free it on error exit */
@@ -912,6 +1230,8 @@ static void send_file_work(struct work_struct *data)
 	if (req)
 		mtp_req_put(dev, &dev->tx_idle, req);
 
+done:
+	mtp_xfer_stats_end(st, xfer_start);
 	mtp_log("returning %d state:%d\n", r, dev->state);
 	/* write the result */
 	dev->xfer_result = r;
@@ -923,13 +1243,14 @@ static void receive_file_work(struct work_struct *data)
 {
 	struct mtp_dev *dev = container_of(data, struct mtp_dev,
 						receive_file_work);
+	struct mtp_xfer_stats *st = &dev->rx_stats;
 	struct usb_request *read_req = NULL, *write_req = NULL;
 	struct file *filp;
 	loff_t offset;
 	int64_t count;
 	int ret, cur_buf = 0;
 	int r = 0;
-	ktime_t start_time;
+	ktime_t start_time, xfer_start;
 
 	/* read our parameters */
 	smp_rmb();
@@ -942,6 +1263,8 @@ static void receive_file_work(struct work_struct *data)
 		mtp_log("- count(%lld) not multiple of mtu(%d)\n",
 						count, dev->ep_out->maxpacket);
 	mutex_lock(&dev->read_mutex);
+	mtp_xfer_stats_start(st);
+	xfer_start = ktime_get();
 	if (dev->state == STATE_OFFLINE) {
 		r = -EIO;
 		goto fail;
@@ -984,13 +1307,20 @@ static void receive_file_work(struct work_struct *data)
 			dev->perf[dev->dbg_write_index].vfs_wbytes = ret;
 			dev->dbg_write_index =
 				(dev->dbg_write_index + 1) % MAX_ITERATION;
+			st->bytes += ret;
 			write_req = NULL;
 		}
 
 		if (read_req) {
+			/* it completed while we were writing the file */
+			if (dev->rx_done && st->bytes)
+				st->stalls++;
+
 			/* wait for our last read to complete */
+			start_time = ktime_get();
 			ret = wait_event_interruptible(dev->read_wq,
 				dev->rx_done || dev->state != STATE_BUSY);
+			st->wait_us += ktime_us_delta(ktime_get(), start_time);
 			if (dev->state == STATE_CANCELED
 					|| dev->state == STATE_OFFLINE) {
 				if (dev->state == STATE_OFFLINE)
@@ -1024,11 +1354,14 @@ static void receive_file_work(struct work_struct *data)
 				count = 0;
 			}
 
+			st->max_req_len = max(st->max_req_len,
+					      read_req->actual);
 			write_req = read_req;
 			read_req = NULL;
 		}
 	}
 fail:
+	mtp_xfer_stats_end(st, xfer_start);
 	mutex_unlock(&dev->read_mutex);
 	mtp_log("returning %d\n", r);
 	/* write the result */
@@ -1483,6 +1816,8 @@ mtp_function_unbind(struct usb_configuration *c, struct usb_function *f)
 	mutex_lock(&dev->read_mutex);
 	while ((req = mtp_req_get(dev, &dev->tx_idle)))
 		mtp_request_free(req, dev->ep_in);
+	while ((req = mtp_req_get(dev, &dev->tx_sg_idle)))
+		mtp_tx_sg_request_free(req, dev->ep_in);
 	for (i = 0; i < RX_REQ_MAX; i++)
 		mtp_request_free(dev->rx_req[i], dev->ep_out);
 	while ((req = mtp_req_get(dev, &dev->intr_idle)))
@@ -1560,6 +1895,20 @@ static void mtp_function_disable(struct usb_function *f)
 	mtp_log("%s disabled\n", dev->function.name);
 }
 
+/* throughput in KB/s */
+static void debug_mtp_xfer_stats(struct seq_file *s, const char *name,
+				 struct mtp_xfer_stats *st)
+{
+	seq_printf(s, "%s: bytes:%llu zero copy:%llu time:%u rate:%llu\n",
+		   name, st->bytes, st->zero_copy_bytes, st->time_us,
+		   st->time_us ? div_u64(st->bytes * 1000, st->time_us) : 0);
+	seq_printf(s, "%s: wait:%u stalls:%u max request:%u\n",
+		   name, st->wait_us, st->stalls, st->max_req_len);
+	seq_printf(s, "%s: total bytes:%llu rate:%llu\n", name,
+		   st->total_bytes, st->total_us ?
+		   div64_u64(st->total_bytes * 1000, st->total_us) : 0);
+}
+
 static int debug_mtp_read_stats(struct seq_file *s, void *unused)
 {
 	struct mtp_dev *dev = _mtp_dev;
@@ -1610,6 +1959,12 @@ static int debug_mtp_read_stats(struct seq_file *s, void *unused)
 
 	seq_printf(s, "vfs_read(time in usec) min:%d\t max:%d\t avg:%d\n",
 				min, max, (iteration ? (sum / iteration) : 0));
+
+	seq_puts(s, "\n=======================\n");
+	seq_puts(s, "MTP Transfer Stats:\n");
+	seq_puts(s, "\n=======================\n");
+	debug_mtp_xfer_stats(s, "send", &dev->tx_stats);
+	debug_mtp_xfer_stats(s, "receive", &dev->rx_stats);
 	spin_unlock_irqrestore(&dev->lock, flags);
 	return 0;
 }
@@ -1633,6 +1988,8 @@ static ssize_t debug_mtp_reset_stats(struct file *file, const char __user *buf,
 
 	spin_lock_irqsave(&dev->lock, flags);
 	memset(&dev->perf[0], 0, MAX_ITERATION * sizeof(dev->perf[0]));
+	memset(&dev->tx_stats, 0, sizeof(dev->tx_stats));
+	memset(&dev->rx_stats, 0, sizeof(dev->rx_stats));
 	dev->dbg_read_index = 0;
 	dev->dbg_write_index = 0;
 	spin_unlock_irqrestore(&dev->lock, flags);
@@ -1693,6 +2050,8 @@ static int __mtp_setup(struct mtp_instance *fi_mtp)
 	atomic_set(&dev->open_excl, 0);
 	atomic_set(&dev->ioctl_excl, 0);
 	INIT_LIST_HEAD(&dev->tx_idle);
+	INIT_LIST_HEAD(&dev->tx_sg_idle);
+	atomic_set(&dev->tx_sg_queued, 0);
 	INIT_LIST_HEAD(&dev->intr_idle);
 
 	dev->wq = create_singlethread_workqueue("f_mtp");
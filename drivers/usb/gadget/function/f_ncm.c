@@ -80,6 +80,7 @@ struct f_ncm {
 	bool				timer_force_tx;
 	struct tasklet_struct		tx_tasklet;
 	struct hrtimer			task_timer;
+	u32				tx_timeout_ns;
 
 	bool				timer_stopping;
 };
@@ -122,8 +123,13 @@ static inline unsigned ncm_bitrate(struct usb_gadget *g)
  */
 #define TX_MAX_NUM_DPE		32
 
-/* Delay for the transmit to wait before sending an unfilled NTB frame. */
+/*
+ * Delay for the transmit to wait before sending an unfilled NTB frame.
+ * It halves down to TX_TIMEOUT_MIN_NSECS while the timer only finds a few
+ * datagrams to send, and doubles back each time a burst fills an NTB.
+ */
 #define TX_TIMEOUT_NSECS	300000
+#define TX_TIMEOUT_MIN_NSECS	50000
 
 #define FORMATS_SUPPORTED	(USB_CDC_NCM_NTB16_SUPPORTED |	\
 				 USB_CDC_NCM_NTB32_SUPPORTED)
@@ -1068,6 +1074,8 @@ static struct sk_buff *ncm_wrap_ntb(struct gether *port,
 			skb2 = package_for_tx(ncm);
 			if (!skb2)
 				goto err;
+			ncm->tx_timeout_ns = min_t(u32, ncm->tx_timeout_ns * 2,
+						   TX_TIMEOUT_NSECS);
 		}
 
 		if (!ncm->skb_tx_data) {
@@ -1110,11 +1118,15 @@ static struct sk_buff *ncm_wrap_ntb(struct gether *port,
 			ncm->ndp_dgram_count = 1;
 
 			/* Note: we skip opts->next_ndp_index */
-		}
 
-		/* Delay the timer. */
-		hrtimer_start(&ncm->task_timer, TX_TIMEOUT_NSECS,
-			      HRTIMER_MODE_REL);
+			/*
+			 * Armed once per NTB, not pushed back by each
+			 * datagram, so a steady stream cannot hold the first
+			 * one back for more than the timeout.
+			 */
+			hrtimer_start(&ncm->task_timer, ncm->tx_timeout_ns,
+				      HRTIMER_MODE_REL);
+		}
 
 		/* Add the datagram position entries */
 		ntb_ndp = skb_put_zero(ncm->skb_tx_ndp, dgram_idx_len);
@@ -1136,6 +1148,11 @@ static struct sk_buff *ncm_wrap_ntb(struct gether *port,
 		skb = NULL;
 
 	} else if (ncm->skb_tx_data && ncm->timer_force_tx) {
+		/* sparse traffic, holding frames back only adds latency */
+		if (ncm->ndp_dgram_count <= TX_MAX_NUM_DPE / 4)
+			ncm->tx_timeout_ns = max_t(u32, ncm->tx_timeout_ns / 2,
+						   TX_TIMEOUT_MIN_NSECS);
+
 		/* If the tx was requested because of a timeout then send */
 		skb2 = package_for_tx(ncm);
 		if (!skb2)
@@ -1579,6 +1596,7 @@ static int ncm_bind(struct usb_configuration *c, struct usb_function *f)
 	tasklet_init(&ncm->tx_tasklet, ncm_tx_tasklet, (unsigned long) ncm);
 	hrtimer_init(&ncm->task_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
 	ncm->task_timer.function = ncm_tx_timeout;
+	ncm->tx_timeout_ns = TX_TIMEOUT_NSECS;
 
 	DBG(cdev, "CDC Network: %s speed IN/%s OUT/%s NOTIFY/%s\n",
 			gadget_is_superspeed(c->cdev->gadget) ? "super" :
@@ -258,6 +258,8 @@ static void qdss_write_complete(struct usb_ep *ep,
 
 	spin_lock_irqsave(&qdss->lock, flags);
 	list_add_tail(&req->list, list_pool);
+	if (state == USB_QDSS_DATA_WRITE_DONE && qdss->data_in_flight)
+		qdss->data_in_flight--;
 	if (req->length != 0) {
 		d_req->actual = req->actual;
 		d_req->status = req->status;
@@ -923,15 +925,23 @@ int usb_qdss_write(struct usb_qdss_ch *ch, struct qdss_request *d_req)
 		return -EIO;
 	}
 
+	/*
+	 * Every request is in flight: the host does not keep up with the
+	 * trace source. Count it, the caller holds on to its buffer.
+	 */
 	if (list_empty(&qdss->data_write_pool)) {
-		pr_err("error: usb_qdss_data_write list is empty\n");
+		qdss->data_backpressure++;
 		spin_unlock_irqrestore(&qdss->lock, flags);
+		pr_err_ratelimited("error: usb_qdss_data_write list is empty\n");
 		return -EAGAIN;
 	}
 
 	req = list_first_entry(&qdss->data_write_pool, struct usb_request,
 		list);
 	list_del(&req->list);
+	qdss->data_in_flight++;
+	if (qdss->data_in_flight > qdss->data_max_in_flight)
+		qdss->data_max_in_flight = qdss->data_in_flight;
 	spin_unlock_irqrestore(&qdss->lock, flags);
 
 	req->buf = d_req->buf;
@@ -940,11 +950,18 @@ int usb_qdss_write(struct usb_qdss_ch *ch, struct qdss_request *d_req)
 	if (usb_ep_queue(qdss->port.data, req, GFP_ATOMIC)) {
 		spin_lock_irqsave(&qdss->lock, flags);
 		list_add_tail(&req->list, &qdss->data_write_pool);
+		qdss->data_in_flight--;
+		qdss->data_queue_err++;
 		spin_unlock_irqrestore(&qdss->lock, flags);
 		pr_err("qdss usb_ep_queue failed\n");
 		return -EIO;
 	}
 
+	spin_lock_irqsave(&qdss->lock, flags);
+	qdss->data_writes++;
+	qdss->data_bytes += d_req->length;
+	spin_unlock_irqrestore(&qdss->lock, flags);
+
 	return 0;
 }
 EXPORT_SYMBOL(usb_qdss_write);
@@ -1115,8 +1132,29 @@ static ssize_t qdss_enable_debug_inface_store(struct config_item *item,
 }
 
 CONFIGFS_ATTR(qdss_, enable_debug_inface);
+
+static ssize_t qdss_stats_show(struct config_item *item, char *page)
+{
+	struct f_qdss *qdss = to_f_qdss_opts(item)->usb_qdss;
+	unsigned long flags;
+	ssize_t ret;
+
+	spin_lock_irqsave(&qdss->lock, flags);
+	ret = scnprintf(page, PAGE_SIZE,
+			"writes: %lu\nbytes: %lu\nbackpressure: %lu\n"
+			"queue_err: %lu\nin_flight: %u\nmax_in_flight: %u\n",
+			qdss->data_writes, qdss->data_bytes,
+			qdss->data_backpressure, qdss->data_queue_err,
+			qdss->data_in_flight, qdss->data_max_in_flight);
+	spin_unlock_irqrestore(&qdss->lock, flags);
+
+	return ret;
+}
+
+CONFIGFS_ATTR_RO(qdss_, stats);
 static struct configfs_attribute *qdss_attrs[] = {
 	&qdss_attr_enable_debug_inface,
+	&qdss_attr_stats,
 	NULL,
 };
 
@@ -62,6 +62,12 @@ struct f_qdss {
 
 	/* for mdm channel SW path */
 	struct list_head data_write_pool;
+	unsigned long data_writes;
+	unsigned long data_bytes;
+	unsigned long data_backpressure;
+	unsigned long data_queue_err;
+	unsigned int data_in_flight;
+	unsigned int data_max_in_flight;
 
 	struct work_struct connect_w;
 	struct work_struct disconnect_w;
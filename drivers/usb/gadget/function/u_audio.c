@@ -23,6 +23,7 @@
 
 #include <linux/module.h>
 #include <sound/core.h>
+#include <sound/info.h>
 #include <sound/pcm.h>
 #include <sound/pcm_params.h>
 
@@ -31,10 +32,28 @@
 #define BUFF_SIZE_MAX	(PAGE_SIZE * 16)
 #define PRD_SIZE_MAX	PAGE_SIZE
 #define MIN_PERIODS	4
+#define MIN_INFLIGHT	2
+
+/*
+ * Low latency playback: IN requests point into the ALSA ring instead of
+ * being copied to, hw_ptr moves when a request completes, and only about
+ * one period worth of requests stays queued.
+ */
+static bool low_latency;
+module_param(low_latency, bool, 0644);
+MODULE_PARM_DESC(low_latency, "Zero-copy playback, in-flight sized to period");
+
+static unsigned int irq_batch = 1;
+module_param(irq_batch, uint, 0644);
+MODULE_PARM_DESC(irq_batch, "Isochronous requests per completion interrupt");
 
 struct uac_req {
 	struct uac_rtd_params *pp; /* parent param */
 	struct usb_request *req;
+	void *bounce;		/* own slot of rbuf */
+	unsigned int ring_bytes; /* of the ALSA ring it carries */
+	unsigned int gen;
+	bool idle;		/* parked, not queued */
 };
 
 /* Runtime data params for one stream */
@@ -53,6 +72,17 @@ struct uac_rtd_params {
 	struct uac_req *ureq;
 
 	spinlock_t lock;
+
+	/* low latency playback */
+	bool zero_copy;
+	ssize_t q_ptr;		/* ring offset of next queued request */
+	unsigned int gen;	/* bumped on every trigger */
+	unsigned long zc_pkts;
+	unsigned long bounce_pkts;
+
+	unsigned int queued;
+	unsigned int target;	/* requests to keep queued */
+	unsigned int irq_seq;
 };
 
 struct snd_uac_chip {
@@ -85,6 +115,102 @@ static const struct snd_pcm_hardware uac_pcm_hardware = {
 	.periods_min = MIN_PERIODS,
 };
 
+/* Queue a request, or park it when more are in flight than the target */
+static void u_audio_iso_queue(struct uac_rtd_params *prm, struct usb_ep *ep,
+			      struct uac_req *ur)
+{
+	struct snd_uac_chip *uac = prm->uac;
+	unsigned int batch, i;
+	unsigned long flags;
+	struct uac_req *top;
+	bool park;
+
+	spin_lock_irqsave(&prm->lock, flags);
+	park = prm->queued > prm->target;
+	if (park) {
+		ur->idle = true;
+		prm->queued--;
+	} else {
+		/* at least one interrupt per batch of those queued */
+		batch = clamp(irq_batch, 1U, max(prm->target / 2, 1U));
+		ur->req->no_interrupt = ++prm->irq_seq % batch != 0;
+	}
+	spin_unlock_irqrestore(&prm->lock, flags);
+
+	if (!park && usb_ep_queue(ep, ur->req, GFP_ATOMIC))
+		dev_err(uac->card->dev, "%d Error!\n", __LINE__);
+
+	/* the target grew, send silence until they carry data */
+	for (i = 0; i < uac->audio_dev->params.req_number; i++) {
+		top = &prm->ureq[i];
+		spin_lock_irqsave(&prm->lock, flags);
+		if (prm->queued >= prm->target) {
+			spin_unlock_irqrestore(&prm->lock, flags);
+			break;
+		}
+		if (!top->idle || !top->req) {
+			spin_unlock_irqrestore(&prm->lock, flags);
+			continue;
+		}
+		top->idle = false;
+		top->ring_bytes = 0;
+		top->req->buf = top->bounce;
+		memset(top->bounce, 0, top->req->length);
+		prm->queued++;
+		spin_unlock_irqrestore(&prm->lock, flags);
+
+		if (usb_ep_queue(ep, top->req, GFP_ATOMIC))
+			dev_err(uac->card->dev, "%d Error!\n", __LINE__);
+	}
+}
+
+/*
+ * Playback straight from the ALSA ring: the data of @req is gone from the
+ * ring now, and it takes the next chunk after the ones still in flight.
+ * Only a chunk across the end of the ring is copied, to the bounce slot.
+ */
+static void u_audio_zc_complete(struct uac_rtd_params *prm,
+				struct snd_pcm_substream *substream,
+				struct usb_request *req)
+{
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct uac_req *ur = req->context;
+	unsigned int done, pending, period;
+	unsigned long flags;
+	ssize_t hw_ptr, q_ptr;
+
+	spin_lock_irqsave(&prm->lock, flags);
+	done = ur->gen == prm->gen ? ur->ring_bytes : 0;
+	prm->hw_ptr = (prm->hw_ptr + done) % runtime->dma_bytes;
+	hw_ptr = prm->hw_ptr;
+	q_ptr = prm->q_ptr;
+	prm->q_ptr = (q_ptr + req->length) % runtime->dma_bytes;
+	ur->ring_bytes = req->length;
+	ur->gen = prm->gen;
+	spin_unlock_irqrestore(&prm->lock, flags);
+
+	pending = runtime->dma_bytes - q_ptr;
+	if (likely(pending >= req->length)) {
+		req->buf = runtime->dma_area + q_ptr;
+		prm->zc_pkts++;
+	} else {
+		req->buf = ur->bounce;
+		memcpy(req->buf, runtime->dma_area + q_ptr, pending);
+		memcpy(req->buf + pending, runtime->dma_area,
+		       req->length - pending);
+		prm->bounce_pkts++;
+	}
+
+	/* frames handed to the controller and not sent yet */
+	runtime->delay = bytes_to_frames(runtime,
+		(q_ptr + req->length - hw_ptr + runtime->dma_bytes) %
+		runtime->dma_bytes);
+
+	period = snd_pcm_lib_period_bytes(substream);
+	if (done && (hw_ptr % period) < done)
+		snd_pcm_period_elapsed(substream);
+}
+
 static void u_audio_iso_complete(struct usb_ep *ep, struct usb_request *req)
 {
 	unsigned pending;
@@ -118,14 +244,14 @@ static void u_audio_iso_complete(struct usb_ep *ep, struct usb_request *req)
 
 	/* Do nothing if ALSA isn't active */
 	if (!substream)
-		goto exit;
+		goto silence;
 
 	snd_pcm_stream_lock_irqsave(substream, flags2);
 
 	runtime = substream->runtime;
 	if (!runtime || !snd_pcm_running(substream)) {
 		snd_pcm_stream_unlock_irqrestore(substream, flags2);
-		goto exit;
+		goto silence;
 	}
 
 	spin_lock_irqsave(&prm->lock, flags);
@@ -158,6 +284,12 @@ static void u_audio_iso_complete(struct usb_ep *ep, struct usb_request *req)
 
 	spin_unlock_irqrestore(&prm->lock, flags);
 
+	if (prm->zero_copy) {
+		u_audio_zc_complete(prm, substream, req);
+		snd_pcm_stream_unlock_irqrestore(substream, flags2);
+		goto exit;
+	}
+
 	/* Pack USB load in ALSA ring buffer */
 	pending = runtime->dma_bytes - hw_ptr;
 
@@ -190,10 +322,16 @@ static void u_audio_iso_complete(struct usb_ep *ep, struct usb_request *req)
 
 	if ((hw_ptr % snd_pcm_lib_period_bytes(substream)) < req->actual)
 		snd_pcm_period_elapsed(substream);
+	goto exit;
 
+silence:
+	/* do not send from a ring that may be gone */
+	if (prm->zero_copy) {
+		req->buf = ur->bounce;
+		ur->ring_bytes = 0;
+	}
 exit:
-	if (usb_ep_queue(ep, req, GFP_ATOMIC))
-		dev_err(uac->card->dev, "%d Error!\n", __LINE__);
+	u_audio_iso_queue(prm, ep, ur);
 }
 
 static int uac_pcm_trigger(struct snd_pcm_substream *substream, int cmd)
@@ -202,6 +340,7 @@ static int uac_pcm_trigger(struct snd_pcm_substream *substream, int cmd)
 	struct uac_rtd_params *prm;
 	struct g_audio *audio_dev;
 	struct uac_params *params;
+	unsigned int period;
 	unsigned long flags;
 	int err = 0;
 
@@ -217,11 +356,21 @@ static int uac_pcm_trigger(struct snd_pcm_substream *substream, int cmd)
 
 	/* Reset */
 	prm->hw_ptr = 0;
+	prm->q_ptr = 0;
+	prm->gen++;
+	substream->runtime->delay = 0;
 
 	switch (cmd) {
 	case SNDRV_PCM_TRIGGER_START:
 	case SNDRV_PCM_TRIGGER_RESUME:
 		prm->ss = substream;
+		/* about one period in flight, the latency the app asked for */
+		if (prm->zero_copy) {
+			period = snd_pcm_lib_period_bytes(substream);
+			period = DIV_ROUND_UP(period, max(uac->p_pktsize, 1U));
+			prm->target = clamp_t(unsigned int, period,
+					      MIN_INFLIGHT, params->req_number);
+		}
 		break;
 	case SNDRV_PCM_TRIGGER_STOP:
 	case SNDRV_PCM_TRIGGER_SUSPEND:
@@ -348,6 +497,41 @@ static const struct snd_pcm_ops uac_pcm_ops = {
 	.prepare = uac_pcm_null,
 };
 
+static void uac_proc_read(struct snd_info_entry *entry,
+			  struct snd_info_buffer *buffer)
+{
+	struct snd_uac_chip *uac = entry->private_data;
+	struct uac_rtd_params *prm = &uac->p_prm;
+	unsigned int queued, target, batch;
+	u64 inflight_us = 0;
+
+	if (uac->audio_dev->params.p_chmask && prm->ep_enabled) {
+		queued = READ_ONCE(prm->queued);
+		target = READ_ONCE(prm->target);
+		batch = clamp(irq_batch, 1U, max(target / 2, 1U));
+		/* one packet per service interval */
+		if (uac->p_interval)
+			inflight_us = div_u64((u64)queued * USEC_PER_SEC,
+					      uac->p_interval);
+
+		snd_iprintf(buffer, "playback:\n");
+		snd_iprintf(buffer, "  zero_copy: %d\n", prm->zero_copy);
+		snd_iprintf(buffer, "  queued: %u target: %u irq_batch: %u\n",
+			    queued, target, batch);
+		snd_iprintf(buffer, "  in_flight_us: %llu\n", inflight_us);
+		snd_iprintf(buffer, "  zero_copy_pkts: %lu bounce_pkts: %lu\n",
+			    prm->zc_pkts, prm->bounce_pkts);
+	}
+
+	prm = &uac->c_prm;
+	if (uac->audio_dev->params.c_chmask && prm->ep_enabled) {
+		snd_iprintf(buffer, "capture:\n");
+		snd_iprintf(buffer, "  queued: %u irq_batch: %u\n",
+			    READ_ONCE(prm->queued),
+			    clamp(irq_batch, 1U, max(prm->target / 2, 1U)));
+	}
+}
+
 static inline void free_ep(struct uac_rtd_params *prm, struct usb_ep *ep)
 {
 	struct snd_uac_chip *uac = prm->uac;
@@ -401,6 +585,12 @@ int u_audio_start_capture(struct g_audio *audio_dev)
 
 	req_len = prm->max_psize;
 
+	/* variable sized OUT packets cannot land in the ring in place */
+	prm->zero_copy = false;
+	prm->target = params->req_number;
+	prm->queued = 0;
+	prm->irq_seq = 0;
+
 	prm->ep_enabled = true;
 	usb_ep_enable(ep);
 
@@ -420,6 +610,9 @@ int u_audio_start_capture(struct g_audio *audio_dev)
 			req->buf = prm->rbuf + i * prm->max_psize;
 		}
 
+		prm->ureq[i].bounce = prm->rbuf + i * prm->max_psize;
+		prm->ureq[i].idle = false;
+		prm->queued++;
 		if (usb_ep_queue(ep, prm->ureq[i].req, GFP_ATOMIC))
 			dev_err(dev, "%s:%d Error!\n", __func__, __LINE__);
 	}
@@ -479,6 +672,14 @@ int u_audio_start_playback(struct g_audio *audio_dev)
 	req_len = uac->p_pktsize;
 	uac->p_residue = 0;
 
+	/* all requests queued until the first trigger sizes the target */
+	prm->zero_copy = low_latency;
+	prm->target = params->req_number;
+	prm->queued = 0;
+	prm->irq_seq = 0;
+	prm->zc_pkts = 0;
+	prm->bounce_pkts = 0;
+
 	prm->ep_enabled = true;
 	usb_ep_enable(ep);
 
@@ -498,6 +699,10 @@ int u_audio_start_playback(struct g_audio *audio_dev)
 			req->buf = prm->rbuf + i * prm->max_psize;
 		}
 
+		prm->ureq[i].bounce = prm->rbuf + i * prm->max_psize;
+		prm->ureq[i].ring_bytes = 0;
+		prm->ureq[i].idle = false;
+		prm->queued++;
 		if (usb_ep_queue(ep, prm->ureq[i].req, GFP_ATOMIC))
 			dev_err(dev, "%s:%d Error!\n", __func__, __LINE__);
 	}
@@ -520,6 +725,7 @@ int g_audio_setup(struct g_audio *g_audio, const char *pcm_name,
 	struct snd_uac_chip *uac;
 	struct snd_card *card;
 	struct snd_pcm *pcm;
+	struct snd_info_entry *entry;
 	struct uac_params *params;
 	int p_chmask, c_chmask;
 	int err;
@@ -612,6 +818,9 @@ int g_audio_setup(struct g_audio *g_audio, const char *pcm_name,
 	snd_pcm_lib_preallocate_pages_for_all(pcm, SNDRV_DMA_TYPE_CONTINUOUS,
 		snd_dma_continuous_data(GFP_KERNEL), 0, BUFF_SIZE_MAX);
 
+	if (!snd_card_proc_new(card, "latency", &entry))
+		snd_info_set_text_ops(entry, uac, uac_proc_read);
+
 	err = snd_card_register(card);
 
 	if (!err)
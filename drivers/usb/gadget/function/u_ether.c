@@ -95,6 +95,7 @@ struct eth_dev {
 
 	struct work_struct	work;
 	struct work_struct	rx_work;
+	struct napi_struct	napi;
 
 	unsigned long		todo;
 	unsigned long		flags;
@@ -409,7 +410,7 @@ static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 	}
 
 	if (queue)
-		queue_work(uether_wq, &dev->rx_work);
+		napi_schedule(&dev->napi);
 }
 
 static int prealloc(struct list_head *list, struct usb_ep *ep, unsigned n)
@@ -544,19 +545,21 @@ static __be16 ether_ip_type_trans(struct sk_buff *skb,
 	return protocol;
 }
 
-static void process_rx_w(struct work_struct *work)
+/*
+ * Hand the frames rx_complete() unwrapped to the stack through GRO, so
+ * the TCP segments of one host burst reach it merged. Refilling the OUT
+ * queue may sleep and is left to rx_work.
+ */
+static int eth_rx_poll(struct napi_struct *napi, int budget)
 {
-	struct eth_dev	*dev = container_of(work, struct eth_dev, rx_work);
+	struct eth_dev	*dev = container_of(napi, struct eth_dev, napi);
+	struct pcpu_sw_netstats *tstats;
 	struct sk_buff	*skb;
-	int		status = 0;
+	int		work_done = 0;
 
-	if (!dev->port_usb)
-		return;
-
-	while ((skb = skb_dequeue(&dev->rx_frames))) {
-		if (status < 0
-				|| ETH_HLEN > skb->len
-				|| skb->len > ETH_FRAME_LEN) {
+	while (work_done < budget &&
+			(skb = skb_dequeue(&dev->rx_frames))) {
+		if (ETH_HLEN > skb->len || skb->len > ETH_FRAME_LEN) {
 			dev->net->stats.rx_errors++;
 			dev->net->stats.rx_length_errors++;
 			DBG(dev, "rx length %d\n", skb->len);
@@ -569,12 +572,36 @@ static void process_rx_w(struct work_struct *work)
 		else
 			skb->protocol = eth_type_trans(skb, dev->net);
 
-		dev->net->stats.rx_packets++;
-		dev->net->stats.rx_bytes += skb->len;
+		tstats = this_cpu_ptr(dev->net->tstats);
+		u64_stats_update_begin(&tstats->syncp);
+		tstats->rx_packets++;
+		tstats->rx_bytes += skb->len;
+		u64_stats_update_end(&tstats->syncp);
 
-		status = netif_rx_ni(skb);
+		napi_gro_receive(napi, skb);
+		work_done++;
 	}
 
+	if (work_done < budget) {
+		napi_complete_done(napi, work_done);
+		/* raced with an rx_complete() that found us scheduled */
+		if (!skb_queue_empty(&dev->rx_frames))
+			napi_schedule(napi);
+	}
+
+	if (netif_running(dev->net) && !list_empty(&dev->rx_reqs))
+		queue_work(uether_wq, &dev->rx_work);
+
+	return work_done;
+}
+
+static void process_rx_w(struct work_struct *work)
+{
+	struct eth_dev	*dev = container_of(work, struct eth_dev, rx_work);
+
+	if (!dev->port_usb)
+		return;
+
 	if (netif_running(dev->net))
 		rx_fill(dev, GFP_KERNEL);
 }
@@ -597,8 +624,10 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 	struct sk_buff	*skb;
 	struct eth_dev	*dev = ep->driver_data;
 	struct net_device *net = dev->net;
+	struct pcpu_sw_netstats *tstats;
 	struct usb_request *new_req;
 	struct usb_ep *in;
+	unsigned int bytes = 0;
 	int length;
 	int retval;
 
@@ -618,13 +647,16 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 		break;
 	case 0:
 		if (!req->zero)
-			dev->net->stats.tx_bytes += req->actual-1;
+			bytes = req->actual - 1;
 		else
-			dev->net->stats.tx_bytes += req->actual;
-
-
+			bytes = req->actual;
 	}
-	dev->net->stats.tx_packets++;
+
+	tstats = this_cpu_ptr(net->tstats);
+	u64_stats_update_begin(&tstats->syncp);
+	tstats->tx_packets++;
+	tstats->tx_bytes += bytes;
+	u64_stats_update_end(&tstats->syncp);
 
 	spin_lock(&dev->req_lock);
 
@@ -1043,6 +1075,7 @@ static int eth_open(struct net_device *net)
 	struct gether	*link;
 
 	DBG(dev, "%s\n", __func__);
+	napi_enable(&dev->napi);
 	if (netif_carrier_ok(dev->net))
 		eth_start(dev, GFP_KERNEL);
 
@@ -1062,9 +1095,9 @@ static int eth_stop(struct net_device *net)
 
 	VDBG(dev, "%s\n", __func__);
 	netif_stop_queue(net);
+	napi_disable(&dev->napi);
 
-	DBG(dev, "stop stats: rx/tx %ld/%ld, errs %ld/%ld\n",
-		dev->net->stats.rx_packets, dev->net->stats.tx_packets,
+	DBG(dev, "stop stats: errs %ld/%ld\n",
 		dev->net->stats.rx_errors, dev->net->stats.tx_errors
 		);
 
@@ -1144,12 +1177,57 @@ static int get_ether_addr_str(u8 dev_addr[ETH_ALEN], char *str, int len)
 	return 18;
 }
 
+static int eth_init(struct net_device *net)
+{
+	net->tstats = netdev_alloc_pcpu_stats(struct pcpu_sw_netstats);
+	if (!net->tstats)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static void eth_uninit(struct net_device *net)
+{
+	free_percpu(net->tstats);
+}
+
+/* packet counters are per cpu, errors are rare enough for net->stats */
+static void eth_get_stats64(struct net_device *net,
+			    struct rtnl_link_stats64 *stats)
+{
+	const struct pcpu_sw_netstats *tstats;
+	u64 rx_packets, rx_bytes, tx_packets, tx_bytes;
+	unsigned int start;
+	int cpu;
+
+	netdev_stats_to_stats64(stats, &net->stats);
+
+	for_each_possible_cpu(cpu) {
+		tstats = per_cpu_ptr(net->tstats, cpu);
+		do {
+			start = u64_stats_fetch_begin_irq(&tstats->syncp);
+			rx_packets = tstats->rx_packets;
+			rx_bytes = tstats->rx_bytes;
+			tx_packets = tstats->tx_packets;
+			tx_bytes = tstats->tx_bytes;
+		} while (u64_stats_fetch_retry_irq(&tstats->syncp, start));
+
+		stats->rx_packets += rx_packets;
+		stats->rx_bytes += rx_bytes;
+		stats->tx_packets += tx_packets;
+		stats->tx_bytes += tx_bytes;
+	}
+}
+
 static int ether_ioctl(struct net_device *, struct ifreq *, int);
 
 static const struct net_device_ops eth_netdev_ops = {
+	.ndo_init		= eth_init,
+	.ndo_uninit		= eth_uninit,
 	.ndo_open		= eth_open,
 	.ndo_stop		= eth_stop,
 	.ndo_start_xmit		= eth_start_xmit,
+	.ndo_get_stats64	= eth_get_stats64,
 	.ndo_do_ioctl		= ether_ioctl,
 	.ndo_change_mtu		= ueth_change_mtu,
 	.ndo_set_mac_address 	= eth_mac_addr,
@@ -1157,9 +1235,12 @@ static const struct net_device_ops eth_netdev_ops = {
 };
 
 static const struct net_device_ops eth_netdev_ops_ip = {
+	.ndo_init		= eth_init,
+	.ndo_uninit		= eth_uninit,
 	.ndo_open		= eth_open,
 	.ndo_stop		= eth_stop,
 	.ndo_start_xmit		= eth_start_xmit,
+	.ndo_get_stats64	= eth_get_stats64,
 	.ndo_do_ioctl		= ether_ioctl,
 	.ndo_change_mtu		= ueth_change_mtu_ip,
 	.ndo_set_mac_address	= NULL,
@@ -1349,6 +1430,7 @@ struct eth_dev *gether_setup_name(struct usb_gadget *g,
 	spin_lock_init(&dev->req_lock);
 	INIT_WORK(&dev->work, eth_work);
 	INIT_WORK(&dev->rx_work, process_rx_w);
+	netif_napi_add(net, &dev->napi, eth_rx_poll, NAPI_POLL_WEIGHT);
 	INIT_LIST_HEAD(&dev->tx_reqs);
 	INIT_LIST_HEAD(&dev->rx_reqs);
 
@@ -1417,6 +1499,7 @@ struct net_device *gether_setup_name_default(const char *netname)
 	spin_lock_init(&dev->req_lock);
 	INIT_WORK(&dev->work, eth_work);
 	INIT_WORK(&dev->rx_work, process_rx_w);
+	netif_napi_add(net, &dev->napi, eth_rx_poll, NAPI_POLL_WEIGHT);
 	INIT_LIST_HEAD(&dev->tx_reqs);
 	INIT_LIST_HEAD(&dev->rx_reqs);
 
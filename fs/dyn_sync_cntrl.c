@@ -14,17 +14,64 @@
 #include <linux/notifier.h>
 #include <linux/reboot.h>
 #include <linux/writeback.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/slab.h>
+#include <linux/hashtable.h>
+#include <linux/workqueue.h>
 #include <linux/dyn_sync_cntrl.h>
 #include <linux/state_notifier.h>
 
 // fsync_mutex protects dyn_fsync_active during suspend / late resume transitions
 static DEFINE_MUTEX(fsync_mutex);
 
+// defer_mutex protects the table of deferred fsyncs and dyn_fsync_next
+static DEFINE_MUTEX(defer_mutex);
+
 
 // Declarations
 
 bool suspend_active = false;
 bool dyn_fsync_active = DYN_FSYNC_ACTIVE_DEFAULT;
+bool dyn_fsync_defer = DYN_FSYNC_DEFER_DEFAULT;
+
+static unsigned int dyn_fsync_window_ms = DYN_FSYNC_WINDOW_MS_DEFAULT;
+static unsigned int dyn_fsync_max_dirty_ms = DYN_FSYNC_MAX_DIRTY_MS_DEFAULT;
+
+/*
+ * Deferred fsync
+ *
+ * Instead of dropping fsync calls, an fsync or fdatasync on a file is
+ * answered right away and the flush is issued once no further call on
+ * the same inode arrived for window_ms. Calls within the window are
+ * coalesced into that one flush, which is a full fsync if any of them
+ * asked for one. No flush is pushed out further than max_dirty_ms after
+ * the first call it covers, and all of them are issued before suspend,
+ * reboot and when deferring is turned off, so at most max_dirty_ms of
+ * acknowledged data is at risk on a crash.
+ */
+struct dyn_fsync_entry
+{
+	struct hlist_node node;
+	struct inode *inode;
+	struct file *file;
+	unsigned long first;
+	unsigned long deadline;
+	int datasync;
+};
+
+static DEFINE_HASHTABLE(dyn_fsync_table, 6);
+static unsigned int dyn_fsync_pending;
+static unsigned long dyn_fsync_next;
+
+static atomic_long_t dyn_fsync_deferred = ATOMIC_LONG_INIT(0);
+static atomic_long_t dyn_fsync_coalesced = ATOMIC_LONG_INIT(0);
+static atomic_long_t dyn_fsync_issued = ATOMIC_LONG_INIT(0);
+static atomic_long_t dyn_fsync_bypassed = ATOMIC_LONG_INIT(0);
+static atomic_long_t dyn_fsync_errors = ATOMIC_LONG_INIT(0);
+
+static void dyn_fsync_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(dyn_fsync_work, dyn_fsync_work_fn);
 
 static struct notifier_block notifier;
 
@@ -39,6 +86,140 @@ static void dyn_fsync_force_flush(void)
 }
 
 
+// Must be called with defer_mutex held
+static void dyn_fsync_arm(unsigned long deadline)
+{
+	unsigned long now = jiffies;
+
+	if (delayed_work_pending(&dyn_fsync_work) &&
+	    !time_before(deadline, dyn_fsync_next))
+		return;
+
+	dyn_fsync_next = deadline;
+	mod_delayed_work(system_wq, &dyn_fsync_work,
+		time_after(deadline, now) ? deadline - now : 0);
+}
+
+
+bool dyn_fsync_queue(struct file *file, int datasync)
+{
+	struct inode *inode = file_inode(file);
+	struct dyn_fsync_entry *e;
+	unsigned long now = jiffies, window, limit, deadline;
+
+	window = msecs_to_jiffies(READ_ONCE(dyn_fsync_window_ms));
+	limit = msecs_to_jiffies(READ_ONCE(dyn_fsync_max_dirty_ms));
+
+	mutex_lock(&defer_mutex);
+
+	hash_for_each_possible(dyn_fsync_table, e, node, (unsigned long)inode)
+	{
+		if (e->inode != inode)
+			continue;
+
+		// slide the window, but never past the dirty time bound
+		deadline = now + window;
+		if (time_after(deadline, e->first + limit))
+			deadline = e->first + limit;
+		e->deadline = deadline;
+		e->datasync &= datasync;
+		atomic_long_inc(&dyn_fsync_coalesced);
+		dyn_fsync_arm(deadline);
+		mutex_unlock(&defer_mutex);
+		return true;
+	}
+
+	if (dyn_fsync_pending >= DYN_FSYNC_MAX_PENDING)
+		goto bypass;
+
+	e = kmalloc(sizeof(*e), GFP_KERNEL);
+	if (!e)
+		goto bypass;
+
+	e->inode = inode;
+	e->file = get_file(file);
+	e->first = now;
+	e->deadline = now + min(window, limit);
+	e->datasync = datasync;
+	hash_add(dyn_fsync_table, &e->node, (unsigned long)inode);
+	dyn_fsync_pending++;
+	atomic_long_inc(&dyn_fsync_deferred);
+	dyn_fsync_arm(e->deadline);
+
+	mutex_unlock(&defer_mutex);
+	return true;
+
+bypass:
+	mutex_unlock(&defer_mutex);
+	atomic_long_inc(&dyn_fsync_bypassed);
+	return false;
+}
+
+
+// Issue the flushes that are due, or all of them
+static void dyn_fsync_run(bool all)
+{
+	struct dyn_fsync_entry *e;
+	struct hlist_node *tmp;
+	HLIST_HEAD(due);
+	unsigned long now = jiffies, next = 0;
+	bool rearm = false;
+	int bkt, ret;
+
+	mutex_lock(&defer_mutex);
+
+	hash_for_each_safe(dyn_fsync_table, bkt, tmp, e, node)
+	{
+		if (all || !time_before(now, e->deadline))
+		{
+			hash_del(&e->node);
+			hlist_add_head(&e->node, &due);
+			dyn_fsync_pending--;
+		}
+		else if (!rearm || time_before(e->deadline, next))
+		{
+			next = e->deadline;
+			rearm = true;
+		}
+	}
+
+	if (rearm)
+		dyn_fsync_arm(next);
+
+	mutex_unlock(&defer_mutex);
+
+	hlist_for_each_entry_safe(e, tmp, &due, node)
+	{
+		hlist_del(&e->node);
+
+		ret = vfs_fsync(e->file, e->datasync);
+		atomic_long_inc(&dyn_fsync_issued);
+		if (ret)
+		{
+			atomic_long_inc(&dyn_fsync_errors);
+			pr_warn_ratelimited("dynamic fsync: deferred flush of inode %lu failed: %d\n",
+				e->inode->i_ino, ret);
+		}
+
+		fput(e->file);
+		kfree(e);
+	}
+}
+
+
+static void dyn_fsync_work_fn(struct work_struct *work)
+{
+	dyn_fsync_run(false);
+}
+
+
+static void dyn_fsync_flush_deferred(void)
+{
+	cancel_delayed_work_sync(&dyn_fsync_work);
+	dyn_fsync_run(true);
+}
+
+
 static ssize_t dyn_fsync_active_show(struct kobject *kobj,
 		struct kobj_attribute *attr, char *buf)
 {
@@ -57,6 +238,13 @@ static ssize_t dyn_fsync_active_store(struct kobject *kobj,
 		{
 			pr_info("%s: dynamic fsync enabled\n", __FUNCTION__);
 			dyn_fsync_active = true;
+
+			// skipping replaces deferring, issue what is pending
+			if (dyn_fsync_defer)
+			{
+				dyn_fsync_defer = false;
+				dyn_fsync_flush_deferred();
+			}
 		}
 		else if (data == 0) 
 		{
@@ -76,6 +264,97 @@ static ssize_t dyn_fsync_active_store(struct kobject *kobj,
 }
 
 
+static ssize_t dyn_fsync_defer_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", (dyn_fsync_defer ? 1 : 0));
+}
+
+
+static ssize_t dyn_fsync_defer_store(struct kobject *kobj,
+		struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	bool data;
+
+	if (strtobool(buf, &data))
+		return -EINVAL;
+
+	mutex_lock(&fsync_mutex);
+
+	if (data)
+	{
+		pr_info("%s: deferred fsync enabled\n", __FUNCTION__);
+		dyn_fsync_active = false;
+		dyn_fsync_defer = true;
+	}
+	else if (dyn_fsync_defer)
+	{
+		pr_info("%s: deferred fsync disabled\n", __FUNCTION__);
+		dyn_fsync_defer = false;
+		dyn_fsync_flush_deferred();
+	}
+
+	mutex_unlock(&fsync_mutex);
+
+	return count;
+}
+
+
+static ssize_t dyn_fsync_window_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", dyn_fsync_window_ms);
+}
+
+
+static ssize_t dyn_fsync_window_store(struct kobject *kobj,
+		struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	unsigned int data;
+
+	if (kstrtouint(buf, 10, &data) || !data)
+		return -EINVAL;
+
+	dyn_fsync_window_ms = data;
+
+	return count;
+}
+
+
+static ssize_t dyn_fsync_max_dirty_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", dyn_fsync_max_dirty_ms);
+}
+
+
+static ssize_t dyn_fsync_max_dirty_store(struct kobject *kobj,
+		struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	unsigned int data;
+
+	if (kstrtouint(buf, 10, &data) || !data)
+		return -EINVAL;
+
+	dyn_fsync_max_dirty_ms = data;
+
+	return count;
+}
+
+
+static ssize_t dyn_fsync_stats_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "deferred: %ld\ncoalesced: %ld\nissued: %ld\nbypassed: %ld\nerrors: %ld\npending: %u\n",
+		atomic_long_read(&dyn_fsync_deferred),
+		atomic_long_read(&dyn_fsync_coalesced),
+		atomic_long_read(&dyn_fsync_issued),
+		atomic_long_read(&dyn_fsync_bypassed),
+		atomic_long_read(&dyn_fsync_errors),
+		READ_ONCE(dyn_fsync_pending));
+}
+
+
 static ssize_t dyn_fsync_version_show(struct kobject *kobj,
 		struct kobj_attribute *attr, char *buf)
 {
@@ -112,6 +391,8 @@ static int dyn_fsync_notify_sys(struct notifier_block *this, unsigned long code,
 		// system shutdown or reboot, disable dynamic fsync and force flush
 		suspend_active = false;
 		dyn_fsync_active = false;
+		dyn_fsync_defer = false;
+		dyn_fsync_flush_deferred();
 		dyn_fsync_force_flush();
 		pr_warn("dynamic fsync: reboot - force flush!\n");
 	}
@@ -139,6 +420,10 @@ static int state_notifier_callback(struct notifier_block *this,
 		case STATE_NOTIFIER_SUSPEND:
 			mutex_lock(&fsync_mutex);
 			suspend_active = true;
+
+			if (dyn_fsync_defer)
+				dyn_fsync_flush_deferred();
+
 			mutex_unlock(&fsync_mutex);
 			break;
 			
@@ -161,6 +446,24 @@ static struct kobj_attribute dyn_fsync_active_attribute =
 		dyn_fsync_active_show,
 		dyn_fsync_active_store);
 
+static struct kobj_attribute dyn_fsync_defer_attribute = 
+	__ATTR(Dyn_fsync_defer, 0664,
+		dyn_fsync_defer_show,
+		dyn_fsync_defer_store);
+
+static struct kobj_attribute dyn_fsync_window_attribute = 
+	__ATTR(Dyn_fsync_window_ms, 0664,
+		dyn_fsync_window_show,
+		dyn_fsync_window_store);
+
+static struct kobj_attribute dyn_fsync_max_dirty_attribute = 
+	__ATTR(Dyn_fsync_max_dirty_ms, 0664,
+		dyn_fsync_max_dirty_show,
+		dyn_fsync_max_dirty_store);
+
+static struct kobj_attribute dyn_fsync_stats_attribute = 
+	__ATTR(Dyn_fsync_stats, 0444, dyn_fsync_stats_show, NULL);
+
 static struct kobj_attribute dyn_fsync_version_attribute = 
 	__ATTR(Dyn_fsync_version, 0444, dyn_fsync_version_show, NULL);
 
@@ -170,6 +473,10 @@ static struct kobj_attribute dyn_fsync_suspend_attribute =
 static struct attribute *dyn_fsync_active_attrs[] =
 {
 	&dyn_fsync_active_attribute.attr,
+	&dyn_fsync_defer_attribute.attr,
+	&dyn_fsync_window_attribute.attr,
+	&dyn_fsync_max_dirty_attribute.attr,
+	&dyn_fsync_stats_attribute.attr,
 	&dyn_fsync_version_attribute.attr,
 	&dyn_fsync_suspend_attribute.attr,
 	NULL,
@@ -250,6 +557,9 @@ static void dyn_fsync_exit(void)
 		kobject_put(dyn_fsync_kobj);
 	
 	state_unregister_client(&notifier);
+
+	dyn_fsync_defer = false;
+	dyn_fsync_flush_deferred();
 		
 	pr_info("%s dynamic fsync unregistration complete\n", __FUNCTION__);
 }
@@ -43,6 +43,10 @@
 #include <linux/seq_file.h>
 #include <linux/compat.h>
 #include <linux/rculist.h>
+#include <linux/debugfs.h>
+#include <linux/jump_label.h>
+#include <linux/percpu.h>
+#include <linux/sched/clock.h>
 #include <net/busy_poll.h>
 
 /*
@@ -110,6 +114,9 @@
 
 #define EP_ITEM_COST (sizeof(struct epitem) + sizeof(struct eppoll_entry))
 
+/* Ready events copied to userspace with one copy_to_user() */
+#define EP_SEND_BATCH 16
+
 struct epoll_filefd {
 	struct file *file;
 	int fd;
@@ -268,6 +275,42 @@ struct ep_send_events_data {
 /* Maximum number of epoll watched descriptors, per user */
 static long max_user_watches __read_mostly;
 
+/*
+ * Do not wake another waiter after a transfer only because level
+ * triggered items went back to the ready list: the waiter that got them
+ * comes back for them. Events that arrived meanwhile still wake one.
+ */
+static int epoll_wake_one __read_mostly;
+
+/* Counters of /sys/kernel/debug/epoll_stats, off until enabled there */
+struct ep_stats {
+	u64 callbacks;
+	u64 unlocked;		/* callbacks that did not take ep->lock */
+	u64 callback_lock_ns;	/* ep->lock hold time of callbacks */
+	u64 scan_lock_ns;	/* ep->lock hold time of ready list splices */
+	u64 events;		/* events delivered to userspace */
+};
+
+static DEFINE_PER_CPU(struct ep_stats, ep_stats);
+static DEFINE_STATIC_KEY_FALSE(ep_stats_key);
+
+#define ep_stat_add(field, val)						\
+do {									\
+	if (static_branch_unlikely(&ep_stats_key))			\
+		this_cpu_add(ep_stats.field, val);			\
+} while (0)
+
+static inline u64 ep_stat_clock(void)
+{
+	return static_branch_unlikely(&ep_stats_key) ? local_clock() : 0;
+}
+
+#define ep_stat_held(field, start)					\
+do {									\
+	if (start)							\
+		ep_stat_add(field, local_clock() - (start));		\
+} while (0)
+
 /*
  * This mutex is used to serialize ep_free() and eventpoll_release_file().
  */
@@ -313,6 +356,13 @@ struct ctl_table epoll_table[] = {
 		.extra1		= &zero,
 		.extra2		= &long_max,
 	},
+	{
+		.procname	= "wake_one",
+		.data		= &epoll_wake_one,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec,
+	},
 	{ }
 };
 #endif /* CONFIG_SYSCTL */
@@ -683,6 +733,8 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 	int error, pwake = 0;
 	unsigned long flags;
 	struct epitem *epi, *nepi;
+	bool more = false;
+	u64 start;
 	LIST_HEAD(txlist);
 
 	/*
@@ -702,8 +754,10 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 	 * in a lockless way.
 	 */
 	spin_lock_irqsave(&ep->lock, flags);
+	start = ep_stat_clock();
 	list_splice_init(&ep->rdllist, &txlist);
 	ep->ovflist = NULL;
+	ep_stat_held(scan_lock_ns, start);
 	spin_unlock_irqrestore(&ep->lock, flags);
 
 	/*
@@ -712,6 +766,7 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 	error = (*sproc)(ep, &txlist, priv);
 
 	spin_lock_irqsave(&ep->lock, flags);
+	start = ep_stat_clock();
 	/*
 	 * During the time we spent inside the "sproc" callback, some
 	 * other events might have been queued by the poll callback.
@@ -719,6 +774,7 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 	 */
 	for (nepi = ep->ovflist; (epi = nepi) != NULL;
 	     nepi = epi->next, epi->next = EP_UNACTIVE_PTR) {
+		more = true;
 		/*
 		 * We need to check if the item is already in the list.
 		 * During the "sproc" callback execution time, items are
@@ -740,6 +796,8 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 	/*
 	 * Quickly re-inject items left on "txlist".
 	 */
+	if (!list_empty(&txlist))
+		more = true;
 	list_splice(&txlist, &ep->rdllist);
 	__pm_relax(ep->ws);
 
@@ -748,11 +806,13 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 		 * Wake up (if active) both the eventpoll wait list and
 		 * the ->poll() wait list (delayed after we release the lock).
 		 */
-		if (waitqueue_active(&ep->wq))
+		if (waitqueue_active(&ep->wq) &&
+		    (more || !READ_ONCE(epoll_wake_one)))
 			wake_up_locked(&ep->wq);
 		if (waitqueue_active(&ep->poll_wait))
 			pwake++;
 	}
+	ep_stat_held(scan_lock_ns, start);
 	spin_unlock_irqrestore(&ep->lock, flags);
 
 	if (!ep_locked)
@@ -1130,6 +1190,25 @@ struct file *get_epoll_tfile_raw_ptr(struct file *file, int tfd,
  * mechanism. It is called by the stored file descriptors when they
  * have events to report.
  */
+/*
+ * An item already on the ready list needs nothing from the callback but
+ * a wakeup, and nobody needs one while no task sleeps on the set: a task
+ * about to sleep checks the ready list under ep->lock. Such callbacks,
+ * the bulk of them on a busy set, can leave ep->lock alone.
+ */
+static inline bool ep_poll_callback_unlocked(struct eventpoll *ep,
+					     struct epitem *epi, void *key)
+{
+	if ((unsigned long)key & POLLFREE)
+		return false;
+
+	/* Order the event of the waker before the reads of the ready state */
+	smp_mb();
+	return ep_is_linked(&epi->rdllink) &&
+	       READ_ONCE(ep->ovflist) == EP_UNACTIVE_PTR &&
+	       !waitqueue_active(&ep->wq) && !waitqueue_active(&ep->poll_wait);
+}
+
 static int ep_poll_callback(wait_queue_entry_t *wait, unsigned mode, int sync, void *key)
 {
 	int pwake = 0;
@@ -1137,8 +1216,16 @@ static int ep_poll_callback(wait_queue_entry_t *wait, unsigned mode, int sync, v
 	struct epitem *epi = ep_item_from_wait(wait);
 	struct eventpoll *ep = epi->ep;
 	int ewake = 0;
+	u64 start;
+
+	ep_stat_add(callbacks, 1);
+	if (ep_poll_callback_unlocked(ep, epi, key)) {
+		ep_stat_add(unlocked, 1);
+		goto out;
+	}
 
 	spin_lock_irqsave(&ep->lock, flags);
+	start = ep_stat_clock();
 
 	ep_set_busy_poll_napi_id(epi);
 
@@ -1215,12 +1302,14 @@ static int ep_poll_callback(wait_queue_entry_t *wait, unsigned mode, int sync, v
 		pwake++;
 
 out_unlock:
+	ep_stat_held(callback_lock_ns, start);
 	spin_unlock_irqrestore(&ep->lock, flags);
 
 	/* We have to call this outside the lock */
 	if (pwake)
 		ep_poll_safewake(&ep->poll_wait);
 
+out:
 	if (!(epi->event.events & EPOLLEXCLUSIVE))
 		ewake = 1;
 
@@ -1633,6 +1722,61 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi, struct epoll_even
 	return 0;
 }
 
+/* Ready events waiting for ep_send_batch() */
+struct ep_send_batch {
+	struct epoll_event events[EP_SEND_BATCH];
+	struct epitem *items[EP_SEND_BATCH];
+	int nr;
+};
+
+/*
+ * Copy the events of @batch to @uevent, then requeue the level triggered
+ * items and disable the one-shot ones. If the copy faults, the items go
+ * back to the head of @head, in order, as if they were never taken off.
+ */
+static int ep_send_batch(struct eventpoll *ep, struct list_head *head,
+			 struct ep_send_batch *batch,
+			 struct epoll_event __user *uevent)
+{
+	struct epitem *epi;
+	int i, nr = batch->nr;
+
+	batch->nr = 0;
+	if (__copy_to_user(uevent, batch->events,
+			   nr * sizeof(*batch->events))) {
+		for (i = nr - 1; i >= 0; i--) {
+			epi = batch->items[i];
+			list_add(&epi->rdllink, head);
+			ep_pm_stay_awake(epi);
+		}
+		return -EFAULT;
+	}
+
+	for (i = 0; i < nr; i++) {
+		epi = batch->items[i];
+		if (epi->event.events & EPOLLONESHOT)
+			epi->event.events &= EP_PRIVATE_BITS;
+		else if (!(epi->event.events & EPOLLET)) {
+			/*
+			 * If this file has been added with Level
+			 * Trigger mode, we need to insert back inside
+			 * the ready list, so that the next call to
+			 * epoll_wait() will check again the events
+			 * availability. At this point, no one can insert
+			 * into ep->rdllist besides us. The epoll_ctl()
+			 * callers are locked out by
+			 * ep_scan_ready_list() holding "mtx" and the
+			 * poll callback will queue them in ep->ovflist.
+			 */
+			list_add_tail(&epi->rdllink, &ep->rdllist);
+			ep_pm_stay_awake(epi);
+		}
+	}
+	ep_stat_add(events, nr);
+
+	return 0;
+}
+
 static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 			       void *priv)
 {
@@ -1642,9 +1786,11 @@ static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 	struct epitem *epi;
 	struct epoll_event __user *uevent;
 	struct wakeup_source *ws;
+	struct ep_send_batch batch;
 	poll_table pt;
 
 	init_poll_funcptr(&pt, NULL);
+	batch.nr = 0;
 
 	/*
 	 * We can loop without lock because we are passed a task private list.
@@ -1652,7 +1798,7 @@ static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 	 * holding "mtx" during this call.
 	 */
 	for (eventcnt = 0, uevent = esed->events;
-	     !list_empty(head) && eventcnt < esed->maxevents;) {
+	     !list_empty(head) && eventcnt + batch.nr < esed->maxevents;) {
 		epi = list_first_entry(head, struct epitem, rdllink);
 
 		/*
@@ -1681,33 +1827,27 @@ static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 		 * is holding "mtx", so no operations coming from userspace
 		 * can change the item.
 		 */
-		if (revents) {
-			if (__put_user(revents, &uevent->events) ||
-			    __put_user(epi->event.data, &uevent->data)) {
-				list_add(&epi->rdllink, head);
-				ep_pm_stay_awake(epi);
-				return eventcnt ? eventcnt : -EFAULT;
-			}
-			eventcnt++;
-			uevent++;
-			if (epi->event.events & EPOLLONESHOT)
-				epi->event.events &= EP_PRIVATE_BITS;
-			else if (!(epi->event.events & EPOLLET)) {
-				/*
-				 * If this file has been added with Level
-				 * Trigger mode, we need to insert back inside
-				 * the ready list, so that the next call to
-				 * epoll_wait() will check again the events
-				 * availability. At this point, no one can insert
-				 * into ep->rdllist besides us. The epoll_ctl()
-				 * callers are locked out by
-				 * ep_scan_ready_list() holding "mtx" and the
-				 * poll callback will queue them in ep->ovflist.
-				 */
-				list_add_tail(&epi->rdllink, &ep->rdllist);
-				ep_pm_stay_awake(epi);
-			}
-		}
+		if (!revents)
+			continue;
+
+		batch.events[batch.nr].events = revents;
+		batch.events[batch.nr].data = epi->event.data;
+		batch.items[batch.nr++] = epi;
+		if (batch.nr < EP_SEND_BATCH)
+			continue;
+
+		if (ep_send_batch(ep, head, &batch, uevent))
+			return eventcnt ? eventcnt : -EFAULT;
+		eventcnt += EP_SEND_BATCH;
+		uevent += EP_SEND_BATCH;
+	}
+
+	if (batch.nr) {
+		int nr = batch.nr;
+
+		if (ep_send_batch(ep, head, &batch, uevent))
+			return eventcnt ? eventcnt : -EFAULT;
+		eventcnt += nr;
 	}
 
 	return eventcnt;
@@ -2291,6 +2431,77 @@ COMPAT_SYSCALL_DEFINE6(epoll_pwait, int, epfd,
 }
 #endif
 
+#ifdef CONFIG_DEBUG_FS
+static int ep_stats_show(struct seq_file *m, void *v)
+{
+	struct ep_stats sum = { }, *s;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		s = per_cpu_ptr(&ep_stats, cpu);
+		sum.callbacks += READ_ONCE(s->callbacks);
+		sum.unlocked += READ_ONCE(s->unlocked);
+		sum.callback_lock_ns += READ_ONCE(s->callback_lock_ns);
+		sum.scan_lock_ns += READ_ONCE(s->scan_lock_ns);
+		sum.events += READ_ONCE(s->events);
+	}
+
+	seq_printf(m, "enabled: %d\n", static_key_enabled(&ep_stats_key));
+	seq_printf(m, "callbacks: %llu\n", sum.callbacks);
+	seq_printf(m, "unlocked_callbacks: %llu\n", sum.unlocked);
+	seq_printf(m, "callback_lock_ns: %llu\n", sum.callback_lock_ns);
+	seq_printf(m, "scan_lock_ns: %llu\n", sum.scan_lock_ns);
+	seq_printf(m, "events: %llu\n", sum.events);
+	return 0;
+}
+
+static int ep_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ep_stats_show, NULL);
+}
+
+/* 1 resets and enables the counters, 0 disables them */
+static ssize_t ep_stats_write(struct file *file, const char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	bool enable;
+	int cpu, ret;
+
+	ret = kstrtobool_from_user(buf, count, &enable);
+	if (ret)
+		return ret;
+
+	if (!enable) {
+		if (static_key_enabled(&ep_stats_key))
+			static_branch_disable(&ep_stats_key);
+		return count;
+	}
+
+	if (static_key_enabled(&ep_stats_key))
+		static_branch_disable(&ep_stats_key);
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(&ep_stats, cpu), 0, sizeof(struct ep_stats));
+	static_branch_enable(&ep_stats_key);
+
+	return count;
+}
+
+static const struct file_operations ep_stats_fops = {
+	.open		= ep_stats_open,
+	.read		= seq_read,
+	.write		= ep_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void __init ep_stats_init(void)
+{
+	debugfs_create_file("epoll_stats", 0644, NULL, NULL, &ep_stats_fops);
+}
+#else
+static inline void ep_stats_init(void) { }
+#endif
+
 static int __init eventpoll_init(void)
 {
 	struct sysinfo si;
@@ -2329,6 +2540,8 @@ static int __init eventpoll_init(void)
 	pwq_cache = kmem_cache_create("eventpoll_pwq",
 			sizeof(struct eppoll_entry), 0, SLAB_PANIC, NULL);
 
+	ep_stats_init();
+
 	return 0;
 }
 fs_initcall(eventpoll_init);
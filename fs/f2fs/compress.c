@@ -8,11 +8,13 @@
 #include <linux/fs.h>
 #include <linux/f2fs_fs.h>
 #include <linux/writeback.h>
+#include <linux/pagemap.h>
 #include <linux/backing-dev.h>
 #include <linux/lzo.h>
 #include <linux/lz4.h>
 #include <linux/zstd.h>
 #include <linux/moduleparam.h>
+#include <linux/workqueue.h>
 
 #include "f2fs.h"
 #include "node.h"
@@ -488,17 +490,29 @@ module_param(num_compress_pages, uint, 0444);
 MODULE_PARM_DESC(num_compress_pages,
 		"Number of intermediate compress pages to preallocate");
 
+/* runs the compression of clusters queued by writeback, see compress_job */
+static struct workqueue_struct *f2fs_compress_wq;
+
 int f2fs_init_compress_mempool(void)
 {
 	compress_page_pool = mempool_create_page_pool(num_compress_pages, 0);
 	if (!compress_page_pool)
 		return -ENOMEM;
 
+	f2fs_compress_wq = alloc_workqueue("f2fs_compress",
+				WQ_UNBOUND | WQ_MEM_RECLAIM | WQ_HIGHPRI,
+				num_possible_cpus());
+	if (!f2fs_compress_wq) {
+		mempool_destroy(compress_page_pool);
+		return -ENOMEM;
+	}
+
 	return 0;
 }
 
 void f2fs_destroy_compress_mempool(void)
 {
+	destroy_workqueue(f2fs_compress_wq);
 	mempool_destroy(compress_page_pool);
 }
 
@@ -523,6 +537,31 @@ static void f2fs_compress_free_page(struct page *page)
 	mempool_free(page, compress_page_pool);
 }
 
+static void f2fs_update_compress_stat(struct compress_ctx *cc, u64 start,
+							bool saved)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(cc->inode);
+	struct f2fs_compr_stat *stat =
+		&sbi->compr_stat[F2FS_I(cc->inode)->i_compress_algorithm];
+	u64 delta = ktime_get_ns() - start;
+
+	spin_lock(&sbi->compr_stat_lock);
+	stat->clusters++;
+	stat->rbytes += cc->rlen;
+	/* a cluster that does not shrink enough is written raw */
+	stat->cbytes += saved ? cc->clen + COMPRESS_HEADER_SIZE : cc->rlen;
+	stat->ns += delta;
+	spin_unlock(&sbi->compr_stat_lock);
+}
+
+void f2fs_init_compress_info(struct f2fs_sb_info *sbi)
+{
+	sbi->compress_workers = 0;
+	sbi->compress_fill_cluster = 1;
+	spin_lock_init(&sbi->compr_stat_lock);
+	memset(sbi->compr_stat, 0, sizeof(sbi->compr_stat));
+}
+
 static int f2fs_compress_pages(struct compress_ctx *cc)
 {
 	struct f2fs_sb_info *sbi = F2FS_I_SB(cc->inode);
@@ -530,6 +569,7 @@ static int f2fs_compress_pages(struct compress_ctx *cc)
 	const struct f2fs_compress_ops *cops =
 				f2fs_cops[fi->i_compress_algorithm];
 	unsigned int max_len, nr_cpages;
+	u64 start;
 	int i, ret;
 
 	trace_f2fs_compress_pages_start(cc->inode, cc->cluster_idx,
@@ -571,6 +611,7 @@ static int f2fs_compress_pages(struct compress_ctx *cc)
 		goto out_vunmap_rbuf;
 	}
 
+	start = ktime_get_ns();
 	ret = cops->compress_pages(cc);
 	if (ret)
 		goto out_vunmap_cbuf;
@@ -578,9 +619,11 @@ static int f2fs_compress_pages(struct compress_ctx *cc)
 	max_len = PAGE_SIZE * (cc->cluster_size - 1) - COMPRESS_HEADER_SIZE;
 
 	if (cc->clen > max_len) {
+		f2fs_update_compress_stat(cc, start, false);
 		ret = -EAGAIN;
 		goto out_vunmap_cbuf;
 	}
+	f2fs_update_compress_stat(cc, start, true);
 
 	cc->cbuf->clen = cpu_to_le32(cc->clen);
 
@@ -630,6 +673,65 @@ static int f2fs_compress_pages(struct compress_ctx *cc)
 	return ret;
 }
 
+/*
+ * A read that covers the whole cluster decompresses straight into its page
+ * cache pages. For a partial one, the rest of the cluster is decompressed
+ * as well, so rather than into temporary pages that are thrown away, it
+ * goes into new page cache pages where none are cached yet. The next read
+ * of a neighbouring page then finds it uptodate instead of reading and
+ * decompressing the cluster again, and the page cache LRU bounds how many
+ * such clusters are kept. Pages that are cached already, possibly dirty,
+ * are left alone.
+ */
+static struct page *f2fs_grab_fill_page(struct inode *inode, pgoff_t index)
+{
+	struct address_space *mapping = inode->i_mapping;
+	gfp_t gfp = readahead_gfp_mask(mapping);
+	struct page *page;
+
+	if (index >= DIV_ROUND_UP(i_size_read(inode), PAGE_SIZE))
+		return NULL;
+
+	page = find_get_page(mapping, index);
+	if (page) {
+		put_page(page);
+		return NULL;
+	}
+
+	page = __page_cache_alloc(gfp);
+	if (!page)
+		return NULL;
+
+	/* comes back locked, like the pages of the read itself */
+	if (add_to_page_cache_lru(page, mapping, index, gfp)) {
+		put_page(page);
+		return NULL;
+	}
+	return page;
+}
+
+static void f2fs_end_fill_pages(struct decompress_io_ctx *dic, bool err)
+{
+	int i;
+
+	if (!dic->nr_fpages)
+		return;
+
+	for (i = 0; i < dic->cluster_size; i++) {
+		struct page *page = dic->fpages[i];
+
+		if (!page)
+			continue;
+		if (err)
+			ClearPageUptodate(page);
+		else
+			SetPageUptodate(page);
+		unlock_page(page);
+		put_page(page);
+	}
+	dic->nr_fpages = 0;
+}
+
 void f2fs_decompress_pages(struct bio *bio, struct page *page, bool verity)
 {
 	struct decompress_io_ctx *dic =
@@ -695,9 +797,11 @@ void f2fs_decompress_pages(struct bio *bio, struct page *page, bool verity)
 out_free_dic:
 	if (verity)
 		refcount_set(&dic->ref, dic->nr_cpages);
-	if (!verity)
+	if (!verity) {
 		f2fs_decompress_end_io(dic->rpages, dic->cluster_size,
 								ret, false);
+		f2fs_end_fill_pages(dic, ret);
+	}
 
 	trace_f2fs_decompress_pages_end(dic->inode, dic->cluster_idx,
 							dic->clen, ret);
@@ -1307,7 +1411,11 @@ static int f2fs_write_raw_pages(struct compress_ctx *cc,
 	return err;
 }
 
-int f2fs_write_multi_pages(struct compress_ctx *cc,
+/*
+ * Write out a cluster once f2fs_compress_pages() returned @err for it,
+ * falling back to raw pages if it did not compress.
+ */
+static int f2fs_write_cluster(struct compress_ctx *cc, int err,
 					int *submitted,
 					struct writeback_control *wbc,
 					enum iostat_type io_type)
@@ -1315,25 +1423,20 @@ int f2fs_write_multi_pages(struct compress_ctx *cc,
 	struct f2fs_inode_info *fi = F2FS_I(cc->inode);
 	const struct f2fs_compress_ops *cops =
 			f2fs_cops[fi->i_compress_algorithm];
-	int err;
 
 	*submitted = 0;
-	if (cluster_may_compress(cc)) {
-		err = f2fs_compress_pages(cc);
-		if (err == -EAGAIN) {
-			goto write;
-		} else if (err) {
-			f2fs_put_rpages_wbc(cc, wbc, true, 1);
-			goto destroy_out;
-		}
-
-		err = f2fs_write_compressed_pages(cc, submitted,
-							wbc, io_type);
-		cops->destroy_compress_ctx(cc);
-		if (!err)
-			return 0;
-		f2fs_bug_on(F2FS_I_SB(cc->inode), err != -EAGAIN);
+	if (err == -EAGAIN) {
+		goto write;
+	} else if (err) {
+		f2fs_put_rpages_wbc(cc, wbc, true, 1);
+		goto destroy_out;
 	}
+
+	err = f2fs_write_compressed_pages(cc, submitted, wbc, io_type);
+	cops->destroy_compress_ctx(cc);
+	if (!err)
+		return 0;
+	f2fs_bug_on(F2FS_I_SB(cc->inode), err != -EAGAIN);
 write:
 	f2fs_bug_on(F2FS_I_SB(cc->inode), *submitted);
 
@@ -1344,6 +1447,120 @@ int f2fs_write_multi_pages(struct compress_ctx *cc,
 	return err;
 }
 
+/*
+ * With compress_workers set, writeback hands each full cluster to
+ * f2fs_compress_wq and moves on to the next one, keeping up to that many
+ * clusters in flight. The clusters are still written, and so get their
+ * blocks allocated, one by one in file order by the writeback thread: the
+ * oldest one is waited for when the batch is full, all of them before any
+ * raw cluster is written and at the end of the writeback pass. The raw
+ * pages stay locked until their cluster is written, as they are inline.
+ */
+struct compress_job {
+	struct work_struct work;
+	struct completion done;
+	struct compress_ctx cc;
+	int err;
+};
+
+static void f2fs_compress_work(struct work_struct *work)
+{
+	struct compress_job *job = container_of(work, struct compress_job,
+						work);
+
+	job->err = f2fs_compress_pages(&job->cc);
+	complete(&job->done);
+}
+
+static int f2fs_write_oldest_job(struct compress_batch *batch,
+					int *submitted,
+					struct writeback_control *wbc,
+					enum iostat_type io_type)
+{
+	struct compress_job *job = batch->jobs[batch->head];
+	int _submitted, err;
+
+	wait_for_completion(&job->done);
+	batch->jobs[batch->head] = NULL;
+	batch->head = (batch->head + 1) % F2FS_MAX_COMPRESS_JOBS;
+	batch->nr--;
+
+	err = f2fs_write_cluster(&job->cc, job->err, &_submitted,
+							wbc, io_type);
+	*submitted += _submitted;
+	kfree(job);
+	return err;
+}
+
+/* Write all clusters in flight, adding up their pages in @submitted */
+int f2fs_flush_compress_batch(struct compress_batch *batch,
+					int *submitted,
+					struct writeback_control *wbc,
+					enum iostat_type io_type)
+{
+	int err, ret = 0;
+
+	while (batch->nr) {
+		err = f2fs_write_oldest_job(batch, submitted, wbc, io_type);
+		if (err && !ret)
+			ret = err;
+	}
+	return ret;
+}
+
+/* Queue @cc on @job, writing the oldest cluster first if the batch is full */
+static int f2fs_queue_compress(struct compress_ctx *cc,
+					struct compress_job *job,
+					int *submitted,
+					struct writeback_control *wbc,
+					enum iostat_type io_type)
+{
+	struct compress_batch *batch = cc->batch;
+	int err = 0;
+
+	if (batch->nr >= batch->max)
+		err = f2fs_write_oldest_job(batch, submitted, wbc, io_type);
+
+	INIT_WORK(&job->work, f2fs_compress_work);
+	init_completion(&job->done);
+	job->cc = *cc;
+	job->cc.batch = NULL;
+	batch->jobs[(batch->head + batch->nr) % F2FS_MAX_COMPRESS_JOBS] = job;
+	batch->nr++;
+	queue_work(f2fs_compress_wq, &job->work);
+
+	/* the pages belong to the job now */
+	cc->rpages = NULL;
+	f2fs_destroy_compress_ctx(cc);
+	return err;
+}
+
+int f2fs_write_multi_pages(struct compress_ctx *cc,
+					int *submitted,
+					struct writeback_control *wbc,
+					enum iostat_type io_type)
+{
+	struct compress_batch *batch = cc->batch;
+	struct compress_job *job = NULL;
+	bool compress = cluster_may_compress(cc);
+	int _submitted, ret = 0, err;
+
+	*submitted = 0;
+	if (compress && batch && batch->max)
+		job = kmalloc(sizeof(*job), GFP_NOFS);
+	if (job)
+		return f2fs_queue_compress(cc, job, submitted, wbc, io_type);
+
+	/* keep block allocation in file order */
+	if (batch && batch->nr)
+		ret = f2fs_flush_compress_batch(batch, submitted, wbc, io_type);
+
+	err = compress ? f2fs_compress_pages(cc) : -EAGAIN;
+	err = f2fs_write_cluster(cc, err, &_submitted, wbc, io_type);
+	*submitted += _submitted;
+	return err ? err : ret;
+}
+
 struct decompress_io_ctx *f2fs_alloc_dic(struct compress_ctx *cc)
 {
 	struct f2fs_sb_info *sbi = F2FS_I_SB(cc->inode);
@@ -1397,12 +1614,29 @@ struct decompress_io_ctx *f2fs_alloc_dic(struct compress_ctx *cc)
 	if (!dic->tpages)
 		goto out_free;
 
+	/* verity checks the pages of the read only, see f2fs_verify_bio() */
+	if (cc->nr_rpages < cc->cluster_size &&
+			READ_ONCE(sbi->compress_fill_cluster) &&
+			!fsverity_active(cc->inode))
+		dic->fpages = f2fs_kzalloc(sbi, sizeof(struct page *) *
+					dic->cluster_size, GFP_NOFS);
+
 	for (i = 0; i < dic->cluster_size; i++) {
 		if (cc->rpages[i]) {
 			dic->tpages[i] = cc->rpages[i];
 			continue;
 		}
 
+		if (dic->fpages) {
+			dic->fpages[i] = f2fs_grab_fill_page(cc->inode,
+							start_idx + i);
+			if (dic->fpages[i]) {
+				dic->tpages[i] = dic->fpages[i];
+				dic->nr_fpages++;
+				continue;
+			}
+		}
+
 		dic->tpages[i] = f2fs_compress_alloc_page();
 		if (!dic->tpages[i])
 			goto out_free;
@@ -1419,16 +1653,22 @@ void f2fs_free_dic(struct decompress_io_ctx *dic)
 {
 	int i;
 
+	/* not decompressed, let a later read try again */
+	f2fs_end_fill_pages(dic, true);
+
 	if (dic->tpages) {
 		for (i = 0; i < dic->cluster_size; i++) {
 			if (dic->rpages[i])
 				continue;
+			if (dic->fpages && dic->fpages[i])
+				continue;
 			if (!dic->tpages[i])
 				continue;
 			f2fs_compress_free_page(dic->tpages[i]);
 		}
 		kfree(dic->tpages);
 	}
+	kfree(dic->fpages);
 
 	if (dic->cpages) {
 		for (i = 0; i < dic->nr_cpages; i++) {
@@ -2943,6 +2943,9 @@ static int f2fs_write_cache_pages(struct address_space *mapping,
 	sector_t last_block;
 #ifdef CONFIG_F2FS_FS_COMPRESSION
 	struct inode *inode = mapping->host;
+	struct compress_batch batch = {
+		.max = sbi->compress_workers,
+	};
 	struct compress_ctx cc = {
 		.inode = inode,
 		.log_cluster_size = F2FS_I(inode)->i_log_cluster_size,
@@ -2955,6 +2958,7 @@ static int f2fs_write_cache_pages(struct address_space *mapping,
 		.cbuf = NULL,
 		.rlen = PAGE_SIZE * F2FS_I(inode)->i_cluster_size,
 		.private = NULL,
+		.batch = &batch,
 	};
 #endif
 	int nr_pages;
@@ -3148,6 +3152,21 @@ static int f2fs_write_cache_pages(struct address_space *mapping,
 			retry = 0;
 		}
 	}
+	/* and the clusters still being compressed */
+	if (batch.nr) {
+		int err;
+
+		submitted = 0;
+		err = f2fs_flush_compress_batch(&batch, &submitted,
+							wbc, io_type);
+		nwritten += submitted;
+		wbc->nr_to_write -= submitted;
+		if (err) {
+			ret = err;
+			done = 1;
+			retry = 0;
+		}
+	}
 #endif
 	if (retry) {
 		index = 0;
@@ -81,6 +81,11 @@ static void update_general_status(struct f2fs_sb_info *sbi)
 	si->ext_tree = atomic_read(&sbi->total_ext_tree);
 	si->zombie_tree = atomic_read(&sbi->total_zombie_tree);
 	si->ext_node = atomic_read(&sbi->total_ext_node);
+	for (i = 0; i < NR_EXT_CLASS; i++) {
+		si->ext_class_lookup[i] =
+			atomic64_read(&sbi->ext_class_lookup[i]);
+		si->ext_class_hit[i] = atomic64_read(&sbi->ext_class_hit[i]);
+	}
 	si->ndirty_node = get_pages(sbi, F2FS_DIRTY_NODES);
 	si->ndirty_dent = get_pages(sbi, F2FS_DIRTY_DENTS);
 	si->ndirty_meta = get_pages(sbi, F2FS_DIRTY_META);
@@ -396,6 +401,16 @@ static int stat_show(struct seq_file *s, void *v)
 				si->hit_total, si->total_ext);
 		seq_printf(s, "  - Inner Struct Count: tree: %d(%d), node: %d\n",
 				si->ext_tree, si->zombie_tree, si->ext_node);
+		seq_printf(s, "  - Class Hit: hot: %llu/%llu, cold: %llu/%llu, "
+				"large: %llu/%llu, other: %llu/%llu\n",
+				si->ext_class_hit[EXT_CLASS_HOT],
+				si->ext_class_lookup[EXT_CLASS_HOT],
+				si->ext_class_hit[EXT_CLASS_COLD],
+				si->ext_class_lookup[EXT_CLASS_COLD],
+				si->ext_class_hit[EXT_CLASS_LARGE],
+				si->ext_class_lookup[EXT_CLASS_LARGE],
+				si->ext_class_hit[EXT_CLASS_OTHER],
+				si->ext_class_lookup[EXT_CLASS_OTHER]);
 		seq_puts(s, "\nBalancing F2FS Async:\n");
 		seq_printf(s, "  - DIO (R: %4d, W: %4d)\n",
 			   si->nr_dio_read, si->nr_dio_write);
@@ -508,6 +523,10 @@ int f2fs_build_stats(struct f2fs_sb_info *sbi)
 	atomic64_set(&sbi->read_hit_rbtree, 0);
 	atomic64_set(&sbi->read_hit_largest, 0);
 	atomic64_set(&sbi->read_hit_cached, 0);
+	for (i = 0; i < NR_EXT_CLASS; i++) {
+		atomic64_set(&sbi->ext_class_lookup[i], 0);
+		atomic64_set(&sbi->ext_class_hit[i], 0);
+	}
 
 	atomic_set(&sbi->inline_xattr, 0);
 	atomic_set(&sbi->inline_inode, 0);
@@ -199,6 +199,24 @@ bool f2fs_check_rb_tree_consistence(struct f2fs_sb_info *sbi,
 static struct kmem_cache *extent_tree_slab;
 static struct kmem_cache *extent_node_slab;
 
+static inline bool __is_large_extent_file(struct inode *inode)
+{
+	unsigned int large = F2FS_I_SB(inode)->extent_large_blocks;
+
+	return large && (i_size_read(inode) >> PAGE_SHIFT) >= large;
+}
+
+static inline int __extent_class(struct inode *inode)
+{
+	if (file_is_hot(inode))
+		return EXT_CLASS_HOT;
+	if (file_is_cold(inode))
+		return EXT_CLASS_COLD;
+	if (__is_large_extent_file(inode))
+		return EXT_CLASS_LARGE;
+	return EXT_CLASS_OTHER;
+}
+
 static struct extent_node *__attach_extent_node(struct f2fs_sb_info *sbi,
 				struct extent_tree *et, struct extent_info *ei,
 				struct rb_node *parent, struct rb_node **p,
@@ -272,6 +290,7 @@ static struct extent_tree *__grab_extent_tree(struct inode *inode)
 	} else {
 		atomic_dec(&sbi->total_zombie_tree);
 		list_del_init(&et->list);
+		et->large = false;
 	}
 	mutex_unlock(&sbi->extent_tree_lock);
 
@@ -415,6 +434,7 @@ static bool f2fs_lookup_extent_tree(struct inode *inode, pgoff_t pgofs,
 	ret = true;
 out:
 	stat_inc_total_hit(sbi);
+	stat_inc_ext_class(sbi, __extent_class(inode), ret);
 	read_unlock(&et->lock);
 
 	trace_f2fs_lookup_extent_tree_end(inode, pgofs, ei);
@@ -626,6 +646,12 @@ static void f2fs_update_extent_tree_range(struct inode *inode,
 
 	if (updated)
 		f2fs_mark_inode_dirty_sync(inode, true);
+
+	if (sbi->max_extent_nodes &&
+		atomic_read(&sbi->total_ext_node) > sbi->max_extent_nodes)
+		f2fs_shrink_extent_tree(sbi,
+			atomic_read(&sbi->total_ext_node) -
+					sbi->max_extent_nodes);
 }
 
 unsigned int f2fs_shrink_extent_tree(struct f2fs_sb_info *sbi, int nr_shrink)
@@ -646,6 +672,14 @@ unsigned int f2fs_shrink_extent_tree(struct f2fs_sb_info *sbi, int nr_shrink)
 
 	/* 1. remove unreferenced extent tree */
 	list_for_each_entry_safe(et, next, &sbi->zombie_list, list) {
+		/*
+		 * A large file keeps its tree, whose nodes are shrunk in LRU
+		 * order by step 2, so that it does not have to map all of
+		 * itself again from node pages when it is opened again.
+		 */
+		if (et->large && atomic_read(&et->node_cnt))
+			continue;
+
 		if (atomic_read(&et->node_cnt)) {
 			write_lock(&et->lock);
 			node_cnt += __free_extent_tree(sbi, et);
@@ -754,6 +788,7 @@ void f2fs_destroy_extent_tree(struct inode *inode)
 	if (inode->i_nlink && !is_bad_inode(inode) &&
 					atomic_read(&et->node_cnt)) {
 		mutex_lock(&sbi->extent_tree_lock);
+		et->large = __is_large_extent_file(inode);
 		list_add_tail(&et->list, &sbi->zombie_list);
 		atomic_inc(&sbi->total_zombie_tree);
 		mutex_unlock(&sbi->extent_tree_lock);
@@ -823,6 +858,8 @@ void f2fs_init_extent_cache_info(struct f2fs_sb_info *sbi)
 	INIT_LIST_HEAD(&sbi->zombie_list);
 	atomic_set(&sbi->total_zombie_tree, 0);
 	atomic_set(&sbi->total_ext_node, 0);
+	sbi->max_extent_nodes = 0;
+	sbi->extent_large_blocks = DEF_EXTENT_LARGE_BLOCKS;
 }
 
 int __init f2fs_create_extent_cache(void)
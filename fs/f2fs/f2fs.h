@@ -621,6 +621,18 @@ enum {
 /* number of extent info in extent cache we try to shrink */
 #define EXTENT_CACHE_SHRINK_NUMBER	128
 
+/* files this large lose their cached extents node by node, not at once */
+#define DEF_EXTENT_LARGE_BLOCKS		2048	/* 8MB */
+
+/* inode classes the extent cache hit ratio is accounted for */
+enum extent_class {
+	EXT_CLASS_HOT,		/* hot extension */
+	EXT_CLASS_COLD,		/* cold extension, apk, media, ... */
+	EXT_CLASS_LARGE,	/* at least extent_large_blocks */
+	EXT_CLASS_OTHER,
+	NR_EXT_CLASS
+};
+
 struct rb_entry {
 	struct rb_node rb_node;		/* rb node located in rb-tree */
 	unsigned int ofs;		/* start offset of the entry */
@@ -649,6 +661,7 @@ struct extent_tree {
 	rwlock_t lock;			/* protect extent info rb-tree */
 	atomic_t node_cnt;		/* # of extent node in rb-tree*/
 	bool largest_updated;		/* largest extent updated */
+	bool large;			/* a zombie of a large file */
 };
 
 /*
@@ -1358,6 +1371,26 @@ struct compress_ctx {
 	size_t clen;			/* valid data length in cbuf */
 	void *private;			/* payload buffer for specified compression algorithm */
 	void *private2;			/* extra payload buffer */
+	struct compress_batch *batch;	/* clusters in flight, NULL if compressed inline */
+};
+
+/* clusters being compressed in parallel by one writeback pass */
+#define F2FS_MAX_COMPRESS_JOBS		8
+
+struct compress_job;
+struct compress_batch {
+	struct compress_job *jobs[F2FS_MAX_COMPRESS_JOBS];
+	unsigned int head;		/* oldest cluster in flight */
+	unsigned int nr;		/* # of clusters in flight */
+	unsigned int max;		/* max # of clusters in flight */
+};
+
+/* compression throughput per algorithm */
+struct f2fs_compr_stat {
+	unsigned long long clusters;	/* # of compressed clusters */
+	unsigned long long rbytes;	/* raw bytes in */
+	unsigned long long cbytes;	/* bytes written out */
+	unsigned long long ns;		/* time spent compressing */
 };
 
 /* compress context for write IO path */
@@ -1381,6 +1414,8 @@ struct decompress_io_ctx {
 	struct page **cpages;		/* pages store compressed data in cluster */
 	unsigned int nr_cpages;		/* total page number in cpages */
 	struct page **tpages;		/* temp pages to pad holes in cluster */
+	struct page **fpages;		/* page cache pages filling holes */
+	unsigned int nr_fpages;		/* # of fpages still locked */
 	void *rbuf;			/* virtual mapped address on rpages */
 	struct compress_data *cbuf;	/* virtual mapped address on cpages */
 	size_t rlen;			/* valid data length in rbuf */
@@ -1460,6 +1495,8 @@ struct f2fs_sb_info {
 	struct list_head zombie_list;		/* extent zombie tree list */
 	atomic_t total_zombie_tree;		/* extent zombie tree count */
 	atomic_t total_ext_node;		/* extent info count */
+	unsigned int max_extent_nodes;		/* extent info budget */
+	unsigned int extent_large_blocks;	/* large file threshold */
 
 	/* basic filesystem units */
 	unsigned int log_sectors_per_block;	/* log2 sectors per block */
@@ -1515,6 +1552,13 @@ struct f2fs_sb_info {
 	unsigned int gc_mode;			/* current GC state */
 	unsigned int next_victim_seg[2];	/* next segment in victim section */
 	unsigned int rapid_gc;			/* is rapid GC running */
+	unsigned int gc_fg_hold_ms;		/* no bggc after foreground use */
+	unsigned int gc_bdev_idle_ms;		/* disk idle time before bggc */
+	/* background GC policy statistics */
+	unsigned int gc_bg_runs;		/* bggc rounds that found a victim */
+	unsigned int gc_fg_deferred;		/* deferred for foreground use */
+	unsigned int gc_busy_deferred;		/* deferred for disk activity */
+	unsigned int gc_rapid_runs;		/* rapid GC activations */
 	/* for skip statistic */
 	unsigned int atomic_files;              /* # of opened atomic file */
 	unsigned long long skipped_atomic_files[2];	/* FG_GC and BG_GC */
@@ -1543,6 +1587,9 @@ struct f2fs_sb_info {
 	atomic64_t read_hit_rbtree;		/* # of hit rbtree extent node */
 	atomic64_t read_hit_largest;		/* # of hit largest extent node */
 	atomic64_t read_hit_cached;		/* # of hit cached extent node */
+	/* # of lookup and hit extent cache per extent_class */
+	atomic64_t ext_class_lookup[NR_EXT_CLASS];
+	atomic64_t ext_class_hit[NR_EXT_CLASS];
 	atomic_t inline_xattr;			/* # of inline_xattr inodes */
 	atomic_t inline_inode;			/* # of inline_data inodes */
 	atomic_t inline_dir;			/* # of inline_dentry inodes */
@@ -1569,6 +1616,14 @@ struct f2fs_sb_info {
 	unsigned int data_io_flag;
 	unsigned int node_io_flag;
 
+#ifdef CONFIG_F2FS_FS_COMPRESSION
+	/* For parallel compression in writeback */
+	unsigned int compress_workers;	/* clusters in flight, 0: inline */
+	unsigned int compress_fill_cluster;	/* cache whole clusters on read */
+	spinlock_t compr_stat_lock;
+	struct f2fs_compr_stat compr_stat[COMPRESS_MAX];
+#endif
+
 	/* For sysfs suppport */
 	struct kobject s_kobj;
 	struct completion s_kobj_unregister;
@@ -3518,6 +3573,8 @@ struct f2fs_stat_info {
 	int main_area_segs, main_area_sections, main_area_zones;
 	unsigned long long hit_largest, hit_cached, hit_rbtree;
 	unsigned long long hit_total, total_ext;
+	unsigned long long ext_class_lookup[NR_EXT_CLASS];
+	unsigned long long ext_class_hit[NR_EXT_CLASS];
 	int ext_tree, zombie_tree, ext_node;
 	int ndirty_node, ndirty_dent, ndirty_meta, ndirty_imeta;
 	int ndirty_data, ndirty_qdata;
@@ -3576,6 +3633,12 @@ static inline struct f2fs_stat_info *F2FS_STAT(struct f2fs_sb_info *sbi)
 #define stat_inc_rbtree_node_hit(sbi)	(atomic64_inc(&(sbi)->read_hit_rbtree))
 #define stat_inc_largest_node_hit(sbi)	(atomic64_inc(&(sbi)->read_hit_largest))
 #define stat_inc_cached_node_hit(sbi)	(atomic64_inc(&(sbi)->read_hit_cached))
+#define stat_inc_ext_class(sbi, class, hit)				\
+	do {								\
+		atomic64_inc(&(sbi)->ext_class_lookup[class]);		\
+		if (hit)						\
+			atomic64_inc(&(sbi)->ext_class_hit[class]);	\
+	} while (0)
 #define stat_inc_inline_xattr(inode)					\
 	do {								\
 		if (f2fs_has_inline_xattr(inode))			\
@@ -3705,6 +3768,7 @@ void f2fs_update_sit_info(struct f2fs_sb_info *sbi);
 #define stat_inc_rbtree_node_hit(sbi)			do { } while (0)
 #define stat_inc_largest_node_hit(sbi)			do { } while (0)
 #define stat_inc_cached_node_hit(sbi)			do { } while (0)
+#define stat_inc_ext_class(sbi, class, hit)		do { } while (0)
 #define stat_inc_inline_xattr(inode)			do { } while (0)
 #define stat_dec_inline_xattr(inode)			do { } while (0)
 #define stat_inc_inline_inode(inode)			do { } while (0)
@@ -3880,6 +3944,10 @@ int f2fs_write_multi_pages(struct compress_ctx *cc,
 						int *submitted,
 						struct writeback_control *wbc,
 						enum iostat_type io_type);
+int f2fs_flush_compress_batch(struct compress_batch *batch,
+						int *submitted,
+						struct writeback_control *wbc,
+						enum iostat_type io_type);
 int f2fs_is_compressed_cluster(struct inode *inode, pgoff_t index);
 int f2fs_read_multi_pages(struct compress_ctx *cc, struct bio **bio_ret,
 				unsigned nr_pages, sector_t *last_block_in_bio,
@@ -3907,6 +3975,7 @@ static inline struct page *f2fs_compress_control_page(struct page *page)
 }
 static inline int f2fs_init_compress_mempool(void) { return 0; }
 static inline void f2fs_destroy_compress_mempool(void) { }
+static inline void f2fs_init_compress_info(struct f2fs_sb_info *sbi) { }
 #endif
 
 static inline void set_compress_context(struct inode *inode)
@@ -17,6 +17,8 @@
 #include <linux/pm_wakeup.h>
 #include <linux/msm_drm_notify.h>
 #include <linux/power_supply.h>
+#include <linux/genhd.h>
+#include <linux/state_notifier.h>
 
 #include "f2fs.h"
 #include "node.h"
@@ -26,6 +28,8 @@
 
 #define TRIGGER_RAPID_GC (!screen_on && power_supply_is_system_supplied())
 static bool screen_on = true;
+/* Last time the user was seen in front of the device */
+static unsigned long gc_fg_stamp = INITIAL_JIFFIES;
 static LIST_HEAD(gc_sbi_list);
 static DEFINE_MUTEX(gc_wakelock_mutex);
 static DEFINE_MUTEX(gc_sbi_mutex);
@@ -51,6 +55,50 @@ static inline void rapid_gc_set_wakelock(void)
 	mutex_unlock(&gc_wakelock_mutex);
 }
 
+/*
+ * Background GC right after a resume, an unblank or a boost would compete
+ * with the app the user is launching, so hold it off for gc_fg_hold_ms.
+ */
+static bool f2fs_gc_fg_active(struct f2fs_sb_info *sbi)
+{
+	unsigned int hold_ms = sbi->gc_fg_hold_ms;
+
+	if (!hold_ms || !screen_on)
+		return false;
+
+	return time_before(jiffies, READ_ONCE(gc_fg_stamp) +
+				msecs_to_jiffies(hold_ms));
+}
+
+static unsigned long f2fs_bdev_ios(struct hd_struct *part)
+{
+	return part_stat_read(part, ios[READ]) +
+			part_stat_read(part, ios[WRITE]);
+}
+
+/*
+ * is_idle() only sees the I/O of this filesystem, so also wait
+ * gc_bdev_idle_ms and check that no request to the whole disk completed
+ * meanwhile, which covers app code paged in from the other partitions.
+ */
+static bool f2fs_bdev_idle(struct f2fs_sb_info *sbi)
+{
+	struct f2fs_gc_kthread *gc_th = sbi->gc_thread;
+	struct hd_struct *part = &sbi->sb->s_bdev->bd_disk->part0;
+	unsigned int idle_ms = sbi->gc_bdev_idle_ms;
+	unsigned long ios;
+
+	if (!idle_ms)
+		return true;
+
+	ios = f2fs_bdev_ios(part);
+	wait_event_interruptible_timeout(gc_th->gc_wait_queue_head,
+			kthread_should_stop() || freezing(current),
+			msecs_to_jiffies(idle_ms));
+
+	return ios == f2fs_bdev_ios(part);
+}
+
 static int gc_thread_func(void *data)
 {
 	struct f2fs_sb_info *sbi = data;
@@ -98,6 +146,22 @@ static int gc_thread_func(void *data)
 			continue;
 		}
 
+		if (!sbi->rapid_gc) {
+			if (f2fs_gc_fg_active(sbi)) {
+				wait_ms = gc_th->max_sleep_time;
+				sbi->gc_fg_deferred++;
+				stat_other_skip_bggc_count(sbi);
+				continue;
+			}
+
+			if (!f2fs_bdev_idle(sbi)) {
+				increase_sleep_time(gc_th, &wait_ms);
+				sbi->gc_busy_deferred++;
+				stat_io_skip_bggc_count(sbi);
+				continue;
+			}
+		}
+
 		if (time_to_inject(sbi, FAULT_CHECKPOINT)) {
 			f2fs_show_injection_info(sbi, FAULT_CHECKPOINT);
 			f2fs_stop_checkpoint(sbi, false);
@@ -150,7 +214,10 @@ static int gc_thread_func(void *data)
 		sync_mode = F2FS_OPTION(sbi).bggc_mode == BGGC_MODE_SYNC;
 
 		/* if return value is not zero, no victim was selected */
-		if (f2fs_gc(sbi, sbi->rapid_gc || sync_mode, true, NULL_SEGNO)) {
+		if (!f2fs_gc(sbi, sbi->rapid_gc || sync_mode, true,
+							NULL_SEGNO)) {
+			sbi->gc_bg_runs++;
+		} else {
 			wait_ms = gc_th->no_gc_sleep_time;
 			sbi->rapid_gc = false;
 			rapid_gc_set_wakelock();
@@ -242,7 +309,9 @@ static void f2fs_start_rapid_gc(void)
 		if (invalid_blocks >
 		    ((long)((sbi->user_block_count - written_block_count(sbi)) *
 			RAPID_GC_LIMIT_INVALID_BLOCK) / 100)) {
-			f2fs_start_gc_thread(sbi);
+			if (f2fs_start_gc_thread(sbi))
+				continue;
+			sbi->gc_rapid_runs++;
 			sbi->gc_thread->gc_wake = 1;
 			wake_up_interruptible_all(&sbi->gc_thread->gc_wait_queue_head);
 			wake_up_discard_thread(sbi, true);
@@ -324,6 +393,7 @@ static int msm_drm_notifier_callback(struct notifier_block *self,
 	case MSM_DRM_BLANK_UNBLANK:
 		if (screen_on)
 			goto out;
+		WRITE_ONCE(gc_fg_stamp, jiffies);
 		screen_on = true;
 		queue_work(system_power_efficient_wq, &rapid_gc_fb_worker);
 		break;
@@ -337,15 +407,50 @@ static struct notifier_block fb_notifier_block = {
 	.notifier_call = msm_drm_notifier_callback,
 };
 
+#ifdef CONFIG_STATE_NOTIFIER
+static int gc_state_notifier_callback(struct notifier_block *self,
+				unsigned long event, void *data)
+{
+	switch (event) {
+	case STATE_NOTIFIER_ACTIVE:
+	case STATE_NOTIFIER_BOOST:
+		WRITE_ONCE(gc_fg_stamp, jiffies);
+		if (screen_on)
+			break;
+		screen_on = true;
+		queue_work(system_power_efficient_wq, &rapid_gc_fb_worker);
+		break;
+	case STATE_NOTIFIER_SUSPEND:
+		if (!screen_on)
+			break;
+		screen_on = false;
+		queue_work(system_power_efficient_wq, &rapid_gc_fb_worker);
+		break;
+	}
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block gc_state_notifier_block = {
+	.notifier_call = gc_state_notifier_callback,
+};
+#endif
+
 void __init f2fs_init_rapid_gc(void)
 {
 	INIT_WORK(&rapid_gc_fb_worker, rapid_gc_fb_work);
 	wakeup_source_init(&gc_wakelock, "f2fs_rapid_gc_wakelock");
 	msm_drm_register_client(&fb_notifier_block);
+#ifdef CONFIG_STATE_NOTIFIER
+	state_register_client(&gc_state_notifier_block);
+#endif
 }
 
 void __exit f2fs_destroy_rapid_gc(void)
 {
+#ifdef CONFIG_STATE_NOTIFIER
+	state_unregister_client(&gc_state_notifier_block);
+#endif
 	msm_drm_unregister_client(&fb_notifier_block);
 	wakeup_source_trash(&gc_wakelock);
 }
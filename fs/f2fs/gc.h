@@ -14,6 +14,8 @@
 #define DEF_GC_THREAD_MIN_SLEEP_TIME	30000	/* milliseconds */
 #define DEF_GC_THREAD_MAX_SLEEP_TIME	60000
 #define DEF_GC_THREAD_NOGC_SLEEP_TIME	1800000	/* wait 30 min */
+#define DEF_GC_FG_HOLD_TIME		10000	/* ms after foreground activity */
+#define DEF_GC_BDEV_IDLE_TIME		1000	/* ms of block device silence */
 #define LIMIT_INVALID_BLOCK	40 /* percentage over total user space */
 #define LIMIT_FREE_BLOCK	40 /* percentage over invalid + free space */
 
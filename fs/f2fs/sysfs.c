@@ -97,6 +97,34 @@ static ssize_t lifetime_write_kbytes_show(struct f2fs_attr *a,
 			BD_PART_WRITTEN(sbi)));
 }
 
+#ifdef CONFIG_F2FS_FS_COMPRESSION
+static ssize_t compress_stat_show(struct f2fs_attr *a,
+		struct f2fs_sb_info *sbi, char *buf)
+{
+	static const char * const names[COMPRESS_MAX] = {
+		[COMPRESS_LZO] = "lzo",
+		[COMPRESS_LZ4] = "lz4",
+		[COMPRESS_ZSTD] = "zstd",
+	};
+	struct f2fs_compr_stat stat[COMPRESS_MAX];
+	int len = 0, i;
+
+	spin_lock(&sbi->compr_stat_lock);
+	memcpy(stat, sbi->compr_stat, sizeof(stat));
+	spin_unlock(&sbi->compr_stat_lock);
+
+	for (i = 0; i < COMPRESS_MAX; i++)
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+			"%s: clusters %llu in_kb %llu out_kb %llu ms %llu MBps %llu\n",
+			names[i], stat[i].clusters, stat[i].rbytes >> 10,
+			stat[i].cbytes >> 10,
+			div_u64(stat[i].ns, NSEC_PER_MSEC),
+			stat[i].ns ? div64_u64(stat[i].rbytes * NSEC_PER_USEC,
+						stat[i].ns) : 0);
+	return len;
+}
+#endif
+
 static ssize_t features_show(struct f2fs_attr *a,
 		struct f2fs_sb_info *sbi, char *buf)
 {
@@ -365,6 +393,20 @@ static ssize_t __sbi_store(struct f2fs_attr *a,
 		return count;
 	}
 
+#ifdef CONFIG_F2FS_FS_COMPRESSION
+	if (!strcmp(a->attr.name, "compress_workers")) {
+		if (t > F2FS_MAX_COMPRESS_JOBS)
+			return -EINVAL;
+		WRITE_ONCE(sbi->compress_workers, (unsigned int)t);
+		return count;
+	}
+
+	if (!strcmp(a->attr.name, "compress_fill_cluster")) {
+		WRITE_ONCE(sbi->compress_fill_cluster, !!t);
+		return count;
+	}
+#endif
+
 	if (!strcmp(a->attr.name, "iostat_period_ms")) {
 		if (t < MIN_IOSTAT_PERIOD_MS || t > MAX_IOSTAT_PERIOD_MS)
 			return -EINVAL;
@@ -515,6 +557,15 @@ F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, iostat_enable, iostat_enable);
 F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, iostat_period_ms, iostat_period_ms);
 F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, readdir_ra, readdir_ra);
 F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, gc_pin_file_thresh, gc_pin_file_threshold);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, gc_fg_hold_ms, gc_fg_hold_ms);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, gc_bdev_idle_ms, gc_bdev_idle_ms);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, max_extent_nodes, max_extent_nodes);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, extent_large_blocks,
+					extent_large_blocks);
+F2FS_STAT_ATTR(F2FS_SBI, f2fs_sb_info, gc_bg_runs, gc_bg_runs);
+F2FS_STAT_ATTR(F2FS_SBI, f2fs_sb_info, gc_fg_deferred, gc_fg_deferred);
+F2FS_STAT_ATTR(F2FS_SBI, f2fs_sb_info, gc_busy_deferred, gc_busy_deferred);
+F2FS_STAT_ATTR(F2FS_SBI, f2fs_sb_info, gc_rapid_runs, gc_rapid_runs);
 F2FS_RW_ATTR(F2FS_SBI, f2fs_super_block, extension_list, extension_list);
 #ifdef CONFIG_F2FS_FAULT_INJECTION
 F2FS_RW_ATTR(FAULT_INFO_RATE, f2fs_fault_info, inject_rate, inject_rate);
@@ -522,6 +573,12 @@ F2FS_RW_ATTR(FAULT_INFO_TYPE, f2fs_fault_info, inject_type, inject_type);
 #endif
 F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, data_io_flag, data_io_flag);
 F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, node_io_flag, node_io_flag);
+#ifdef CONFIG_F2FS_FS_COMPRESSION
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, compress_workers, compress_workers);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, compress_fill_cluster,
+					compress_fill_cluster);
+F2FS_GENERAL_RO_ATTR(compress_stat);
+#endif
 F2FS_GENERAL_RO_ATTR(dirty_segments);
 F2FS_GENERAL_RO_ATTR(free_segments);
 F2FS_GENERAL_RO_ATTR(lifetime_write_kbytes);
@@ -591,6 +648,14 @@ static struct attribute *f2fs_attrs[] = {
 	ATTR_LIST(iostat_period_ms),
 	ATTR_LIST(readdir_ra),
 	ATTR_LIST(gc_pin_file_thresh),
+	ATTR_LIST(gc_fg_hold_ms),
+	ATTR_LIST(gc_bdev_idle_ms),
+	ATTR_LIST(max_extent_nodes),
+	ATTR_LIST(extent_large_blocks),
+	ATTR_LIST(gc_bg_runs),
+	ATTR_LIST(gc_fg_deferred),
+	ATTR_LIST(gc_busy_deferred),
+	ATTR_LIST(gc_rapid_runs),
 	ATTR_LIST(extension_list),
 #ifdef CONFIG_F2FS_FAULT_INJECTION
 	ATTR_LIST(inject_rate),
@@ -598,6 +663,11 @@ static struct attribute *f2fs_attrs[] = {
 #endif
 	ATTR_LIST(data_io_flag),
 	ATTR_LIST(node_io_flag),
+#ifdef CONFIG_F2FS_FS_COMPRESSION
+	ATTR_LIST(compress_workers),
+	ATTR_LIST(compress_fill_cluster),
+	ATTR_LIST(compress_stat),
+#endif
 	ATTR_LIST(dirty_segments),
 	ATTR_LIST(free_segments),
 	ATTR_LIST(unusable),
@@ -2279,6 +2279,17 @@ static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
 				fput(old);
 			}
 		}
+	} else if (cmd == FUSE_DEV_IOC_PASSTHROUGH_OPEN) {
+		u32 lower_fd;
+
+		err = -EFAULT;
+		if (!get_user(lower_fd, (__u32 __user *) arg)) {
+			struct fuse_dev *fud = fuse_get_dev(file);
+
+			err = -EINVAL;
+			if (fud)
+				err = fuse_passthrough_open(fud, lower_fd);
+		}
 	}
 	return err;
 }
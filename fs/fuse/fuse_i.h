@@ -18,6 +18,7 @@
 #include <linux/mm.h>
 #include <linux/backing-dev.h>
 #include <linux/mutex.h>
+#include <linux/idr.h>
 #include <linux/rwsem.h>
 #include <linux/rbtree.h>
 #include <linux/poll.h>
@@ -122,6 +123,12 @@ enum {
 
 struct fuse_conn;
 
+/** Lower file and credentials of a passthrough file */
+struct fuse_passthrough {
+	struct file *filp;
+	struct cred *cred;
+};
+
 /** FUSE specific file data */
 struct fuse_file {
 	/** Fuse connection for this file */
@@ -156,6 +163,9 @@ struct fuse_file {
 
 	/** Has flock been performed on this file? */
 	bool flock:1;
+
+	/** Lower file serving read/write and mmap, if any */
+	struct fuse_passthrough passthrough;
 };
 
 /** One input argument of a request */
@@ -634,6 +644,9 @@ struct fuse_conn {
 	/** Does the filesystem support posix acls? */
 	unsigned posix_acl:1;
 
+	/** Can opened files be passed through to a lower file? */
+	unsigned passthrough:1;
+
 	/** Check permissions based on the file mode or not? */
 	unsigned default_permissions:1;
 
@@ -643,6 +656,12 @@ struct fuse_conn {
 	/** The number of requests waiting for completion */
 	atomic_t num_waiting;
 
+	/** Passthrough files opened by the daemon, waiting for an open reply */
+	struct idr passthrough_req;
+
+	/** Protects passthrough_req */
+	spinlock_t passthrough_req_lock;
+
 	/** Negotiated minor version */
 	unsigned minor;
 
@@ -997,4 +1016,14 @@ struct posix_acl;
 struct posix_acl *fuse_get_acl(struct inode *inode, int type);
 int fuse_set_acl(struct inode *inode, struct posix_acl *acl, int type);
 
+/* passthrough.c */
+int fuse_passthrough_open(struct fuse_dev *fud, u32 lower_fd);
+int fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_file *ff,
+			   struct fuse_open_out *openarg);
+void fuse_passthrough_release(struct fuse_passthrough *passthrough);
+void fuse_passthrough_free_all(struct fuse_conn *fc);
+ssize_t fuse_passthrough_read_iter(struct kiocb *iocb, struct iov_iter *to);
+ssize_t fuse_passthrough_write_iter(struct kiocb *iocb, struct iov_iter *from);
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+
 #endif /* _FS_FUSE_I_H */
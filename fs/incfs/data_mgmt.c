@@ -174,8 +174,17 @@ struct data_file *incfs_open_data_file(struct mount_info *mi, struct file *bf)
 		df->df_data_block_count = get_blocks_count_for_size(size);
 
 	md_records = incfs_scan_metadata_chain(df);
-	if (md_records < 0)
+	if (md_records < 0) {
 		error = md_records;
+		goto out;
+	}
+
+	if (df->df_header_flags & INCFS_FILE_COMPLETE)
+		df->df_fully_loaded = true;
+	else if (df->df_data_block_count > 0)
+		df->df_present_map = kvzalloc(
+			BITS_TO_LONGS(df->df_data_block_count) * sizeof(long),
+			GFP_NOFS);
 
 out:
 	if (error) {
@@ -196,6 +205,7 @@ void incfs_free_data_file(struct data_file *df)
 		return;
 
 	incfs_free_mtree(df->df_hash_tree);
+	kvfree(df->df_present_map);
 	for (i = 0; i < ARRAY_SIZE(df->df_segments); i++)
 		data_file_segment_destroy(&df->df_segments[i]);
 	incfs_free_bfc(df->df_backing_file_context);
@@ -387,12 +397,17 @@ static void log_block_read(struct mount_info *mi, incfs_uuid_t *id,
 	schedule_delayed_work(&log->ml_wakeup_work, msecs_to_jiffies(16));
 }
 
+/*
+ * Verifies @count consecutive data blocks starting at @block_index. All of
+ * them have to be covered by the same lowest level hash block, so the tree
+ * is only walked once and the leaf digests are all taken from there.
+ */
 static int validate_hash_tree(struct file *bf, struct file *f, int block_index,
-			      struct mem_range data, u8 *buf)
+			      struct mem_range *data, int count, u8 *buf)
 {
 	struct data_file *df = get_incfs_data_file(f);
-	u8 stored_digest[INCFS_MAX_HASH_SIZE] = {};
-	u8 calculated_digest[INCFS_MAX_HASH_SIZE] = {};
+	u8 stored_digest[INCFS_MAX_HASH_SIZE * INCFS_VERIFY_BATCH] = {};
+	u8 calculated_digest[INCFS_MAX_HASH_SIZE * INCFS_VERIFY_BATCH] = {};
 	struct mtree *tree = NULL;
 	struct incfs_df_signature *sig = NULL;
 	int digest_size;
@@ -402,6 +417,7 @@ static int validate_hash_tree(struct file *bf, struct file *f, int block_index,
 	loff_t hash_block_offset[INCFS_MAX_MTREE_LEVELS];
 	size_t hash_offset_in_block[INCFS_MAX_MTREE_LEVELS];
 	int hash_per_block;
+	int i;
 	pgoff_t file_pages;
 
 	tree = df->df_hash_tree;
@@ -411,6 +427,10 @@ static int validate_hash_tree(struct file *bf, struct file *f, int block_index,
 
 	digest_size = tree->alg->digest_size;
 	hash_per_block = INCFS_DATA_FILE_BLOCK_SIZE / digest_size;
+	if (count <= 0 || count > INCFS_VERIFY_BATCH ||
+	    block_index % hash_per_block + count > hash_per_block)
+		return -EINVAL;
+
 	for (lvl = 0; lvl < tree->depth; lvl++) {
 		loff_t lvl_off = tree->hash_level_suboffset[lvl];
 
@@ -436,7 +456,7 @@ static int validate_hash_tree(struct file *bf, struct file *f, int block_index,
 			u8 *addr = kmap_atomic(page);
 
 			memcpy(stored_digest, addr + hash_offset_in_block[lvl],
-			       digest_size);
+			       (lvl ? 1 : count) * digest_size);
 			kunmap_atomic(addr);
 			put_page(page);
 			continue;
@@ -475,7 +495,7 @@ static int validate_hash_tree(struct file *bf, struct file *f, int block_index,
 		}
 
 		memcpy(stored_digest, buf + hash_offset_in_block[lvl],
-		       digest_size);
+		       (lvl ? 1 : count) * digest_size);
 
 		page = grab_cache_page(f->f_inode->i_mapping, hash_page);
 		if (page) {
@@ -489,14 +509,18 @@ static int validate_hash_tree(struct file *bf, struct file *f, int block_index,
 		}
 	}
 
-	res = incfs_calc_digest(tree->alg, data,
-				range(calculated_digest, digest_size));
+	res = incfs_calc_digests(tree->alg, data, count,
+				 range(calculated_digest, count * digest_size));
 	if (res)
 		return res;
 
-	if (memcmp(stored_digest, calculated_digest, digest_size)) {
-		pr_debug("incfs: Leaf hash mismatch blk:%d\n", block_index);
-		return -EBADMSG;
+	for (i = 0; i < count; i++) {
+		if (memcmp(stored_digest + i * digest_size,
+			   calculated_digest + i * digest_size, digest_size)) {
+			pr_debug("incfs: Leaf hash mismatch blk:%d\n",
+				 block_index + i);
+			return -EBADMSG;
+		}
 	}
 
 	return 0;
@@ -516,6 +540,27 @@ static bool is_data_block_present(struct data_file_block *block)
 	       (block->db_stored_size != 0);
 }
 
+static void mark_block_present(struct data_file *df, int index)
+{
+	if (!df->df_present_map || index >= df->df_data_block_count)
+		return;
+
+	if (test_and_set_bit(index, df->df_present_map))
+		return;
+
+	if (atomic_inc_return(&df->df_present_count) ==
+	    df->df_data_block_count)
+		WRITE_ONCE(df->df_fully_loaded, true);
+}
+
+static bool is_block_known_present(struct data_file *df, int index)
+{
+	if (READ_ONCE(df->df_fully_loaded))
+		return true;
+
+	return df->df_present_map && test_bit(index, df->df_present_map);
+}
+
 static void convert_data_file_block(struct incfs_blockmap_entry *bme,
 				    struct data_file_block *res_block)
 {
@@ -681,6 +726,8 @@ int incfs_get_filled_blocks(struct data_file *df,
 		}
 
 		convert_data_file_block(bme + i, &dfb);
+		if (is_data_block_present(&dfb))
+			mark_block_present(df, arg->index_out);
 
 		if (is_data_block_present(&dfb) == in_range)
 			continue;
@@ -716,6 +763,8 @@ int incfs_get_filled_blocks(struct data_file *df,
 	    *size_out == sizeof(struct incfs_filled_range)) {
 		int result =
 			update_file_header_flags(df, 0, INCFS_FILE_COMPLETE);
+
+		WRITE_ONCE(df->df_fully_loaded, true);
 		/* Log failure only, since it's just a failed optimization */
 		pr_debug("Marked file full with result %d", result);
 	}
@@ -734,6 +783,42 @@ static void set_read_done(struct pending_read *read)
 	atomic_set_release(&read->done, 1);
 }
 
+/*
+ * Counts the missing blocks from @block_index on, up to the read_window
+ * mount option. The blockmap entries of the other segments are read
+ * without their mutex, which is good enough for a hint.
+ */
+static int get_missing_block_count(struct data_file *df, int block_index)
+{
+	struct mount_info *mi = df->df_mount_info;
+	struct incfs_blockmap_entry *bme = NULL;
+	struct data_file_block block = {};
+	int window;
+	int read;
+	int i;
+
+	window = min_t(int, mi->mi_options.read_window,
+		       df->df_data_block_count - block_index);
+	if (window <= 1)
+		return 1;
+
+	bme = kcalloc(window, sizeof(*bme), GFP_NOFS);
+	if (!bme)
+		return 1;
+
+	read = incfs_read_blockmap_entries(df->df_backing_file_context, bme,
+					   block_index, window,
+					   df->df_blockmap_off);
+	for (i = 1; i < read; i++) {
+		convert_data_file_block(&bme[i], &block);
+		if (is_data_block_present(&block))
+			break;
+	}
+
+	kfree(bme);
+	return i;
+}
+
 /*
  * Notifies a given data file about pending read from a given block.
  * Returns a new pending read entry.
@@ -754,6 +839,7 @@ static struct pending_read *add_pending_read(struct data_file *df,
 
 	result->file_id = df->df_id;
 	result->block_index = block_index;
+	result->block_count = get_missing_block_count(df, block_index);
 	result->timestamp_us = ktime_to_us(ktime_get());
 
 	mutex_lock(&mi->mi_pending_reads_mutex);
@@ -829,6 +915,18 @@ static int wait_for_data_block(struct data_file *df, int block_index,
 	if (df->df_blockmap_off <= 0)
 		return -ENODATA;
 
+	/*
+	 * A block that is present stays where it is, so its blockmap entry
+	 * can be read without holding the segment lock.
+	 */
+	if (is_block_known_present(df, block_index)) {
+		error = get_data_file_block(df, block_index, &block);
+		if (!error && is_data_block_present(&block)) {
+			*res_block = block;
+			return 0;
+		}
+	}
+
 	segment = get_file_segment(df, block_index);
 	error = mutex_lock_interruptible(&segment->blockmap_mutex);
 	if (error)
@@ -836,6 +934,8 @@ static int wait_for_data_block(struct data_file *df, int block_index,
 
 	/* Look up the given block */
 	error = get_data_file_block(df, block_index, &block);
+	if (!error && is_data_block_present(&block))
+		mark_block_present(df, block_index);
 
 	/* If it's not found, create a pending read */
 	if (!error && !is_data_block_present(&block) && timeout_ms != 0)
@@ -894,9 +994,10 @@ static int wait_for_data_block(struct data_file *df, int block_index,
 	 */
 	error = get_data_file_block(df, block_index, &block);
 	if (!error) {
-		if (is_data_block_present(&block))
+		if (is_data_block_present(&block)) {
 			*res_block = block;
-		else {
+			mark_block_present(df, block_index);
+		} else {
 			/*
 			 * Somehow wait finished successfully bug block still
 			 * can't be found. It's not normal.
@@ -910,27 +1011,19 @@ static int wait_for_data_block(struct data_file *df, int block_index,
 	return error;
 }
 
-ssize_t incfs_read_data_file_block(struct mem_range dst, struct file *f,
-				   int index, int timeout_ms,
-				   struct mem_range tmp)
+/* Reads a data block into @dst without checking it against the hash tree */
+static ssize_t read_data_block(struct mem_range dst, struct data_file *df,
+			       int index, int timeout_ms, struct mem_range tmp)
 {
 	loff_t pos;
 	ssize_t result;
 	size_t bytes_to_read;
-	struct mount_info *mi = NULL;
-	struct file *bf = NULL;
+	struct file *bf = df->df_backing_file_context->bc_file;
 	struct data_file_block block = {};
-	struct data_file *df = get_incfs_data_file(f);
 
-	if (!dst.data || !df)
+	if (!dst.data)
 		return -EFAULT;
 
-	if (tmp.len < 2 * INCFS_DATA_FILE_BLOCK_SIZE)
-		return -ERANGE;
-
-	mi = df->df_mount_info;
-	bf = df->df_backing_file_context->bc_file;
-
 	result = wait_for_data_block(df, index, timeout_ms, &block);
 	if (result < 0)
 		goto out;
@@ -962,20 +1055,85 @@ ssize_t incfs_read_data_file_block(struct mem_range dst, struct file *f,
 		}
 	}
 
-	if (result > 0) {
-		int err = validate_hash_tree(bf, f, index, dst, tmp.data);
+out:
+	return result;
+}
 
-		if (err < 0)
-			result = err;
-	}
+ssize_t incfs_read_data_file_block(struct mem_range dst, struct file *f,
+				   int index, int timeout_ms,
+				   struct mem_range tmp)
+{
+	ssize_t result;
+	int error;
 
-	if (result >= 0)
-		log_block_read(mi, &df->df_id, index);
+	error = incfs_read_data_file_blocks(&dst, &result, 1, f, index,
+					    timeout_ms, tmp);
+	if (error < 0)
+		return error;
 
-out:
 	return result;
 }
 
+/*
+ * Reads up to @count consecutive data blocks from @index on, with @res
+ * receiving the size of each, and verifies them as one batch. The batch
+ * is cut short at the first block that can't be read and at the end of
+ * the lowest level hash block, so the returned number of blocks read may
+ * be below @count. An error is returned only if the first one failed.
+ */
+int incfs_read_data_file_blocks(struct mem_range *dst, ssize_t *res,
+				int count, struct file *f, int index,
+				int timeout_ms, struct mem_range tmp)
+{
+	struct mem_range data[INCFS_VERIFY_BATCH];
+	struct data_file *df = get_incfs_data_file(f);
+	struct mount_info *mi = NULL;
+	struct file *bf = NULL;
+	int error;
+	int i;
+
+	if (!dst || !res || !df)
+		return -EFAULT;
+
+	if (count <= 0)
+		return -EINVAL;
+
+	if (tmp.len < 2 * INCFS_DATA_FILE_BLOCK_SIZE)
+		return -ERANGE;
+
+	mi = df->df_mount_info;
+	bf = df->df_backing_file_context->bc_file;
+
+	count = min(count, INCFS_VERIFY_BATCH);
+	if (df->df_hash_tree) {
+		int hash_per_block = INCFS_DATA_FILE_BLOCK_SIZE /
+				     df->df_hash_tree->alg->digest_size;
+
+		count = min(count, hash_per_block - index % hash_per_block);
+	}
+
+	for (i = 0; i < count; i++) {
+		res[i] = read_data_block(dst[i], df, index + i, timeout_ms,
+					 tmp);
+		if (res[i] < 0)
+			break;
+		data[i] = range(dst[i].data, res[i]);
+	}
+
+	if (i == 0)
+		return res[0];
+
+	error = validate_hash_tree(bf, f, index, data, i, tmp.data);
+	if (error < 0)
+		return error;
+
+	count = i;
+	for (i = 0; i < count; i++)
+		log_block_read(mi, &df->df_id, index + i);
+
+	return count;
+}
+
 int incfs_process_new_data_block(struct data_file *df,
 				 struct incfs_fill_block *block, u8 *data)
 {
@@ -1020,8 +1178,10 @@ int incfs_process_new_data_block(struct data_file *df,
 			df->df_blockmap_off, flags);
 		mutex_unlock(&bfc->bc_mutex);
 	}
-	if (!error)
+	if (!error) {
+		mark_block_present(df, block->block_index);
 		notify_pending_reads(mi, segment, block->block_index);
+	}
 
 unlock:
 	mutex_unlock(&segment->blockmap_mutex);
@@ -1301,6 +1461,7 @@ bool incfs_fresh_pending_reads_exist(struct mount_info *mi, int last_number)
 
 int incfs_collect_pending_reads(struct mount_info *mi, int sn_lowerbound,
 				struct incfs_pending_read_info *reads,
+				struct incfs_pending_read_info2 *reads2,
 				int reads_size)
 {
 	int reported_reads = 0;
@@ -1322,11 +1483,23 @@ int incfs_collect_pending_reads(struct mount_info *mi, int sn_lowerbound,
 		if (entry->serial_number <= sn_lowerbound)
 			continue;
 
-		reads[reported_reads].file_id = entry->file_id;
-		reads[reported_reads].block_index = entry->block_index;
-		reads[reported_reads].serial_number = entry->serial_number;
-		reads[reported_reads].timestamp_us = entry->timestamp_us;
-		/* reads[reported_reads].kind = INCFS_READ_KIND_PENDING; */
+		if (reads) {
+			reads[reported_reads].file_id = entry->file_id;
+			reads[reported_reads].block_index = entry->block_index;
+			reads[reported_reads].serial_number =
+				entry->serial_number;
+			reads[reported_reads].timestamp_us =
+				entry->timestamp_us;
+		} else {
+			reads2[reported_reads] =
+				(struct incfs_pending_read_info2){
+				.file_id = entry->file_id,
+				.timestamp_us = entry->timestamp_us,
+				.block_index = entry->block_index,
+				.serial_number = entry->serial_number,
+				.block_count = entry->block_count,
+			};
+		}
 
 		reported_reads++;
 		if (reported_reads >= reads_size)
@@ -20,6 +20,12 @@
 
 #define SEGMENTS_PER_FILE 3
 
+/* Most blocks verified against the hash tree in one go */
+#define INCFS_VERIFY_BATCH 8
+
+/* Upper bound of the read_window mount option */
+#define INCFS_MAX_READ_WINDOW 256
+
 enum LOG_RECORD_TYPE {
 	FULL,
 	SAME_FILE,
@@ -99,6 +105,7 @@ struct mount_options {
 	unsigned int readahead_pages;
 	unsigned int read_log_pages;
 	unsigned int read_log_wakeup_count;
+	unsigned int read_window;
 	bool no_backing_file_cache;
 	bool no_backing_file_readahead;
 };
@@ -170,6 +177,8 @@ struct pending_read {
 
 	int block_index;
 
+	int block_count;
+
 	int serial_number;
 
 	struct list_head mi_reads_list;
@@ -232,6 +241,20 @@ struct data_file {
 	/* Total number of blocks, data + hash */
 	int df_total_block_count;
 
+	/*
+	 * Data blocks known to be present, so that reads of them can skip
+	 * the segment lock and pending read handling. Set bits are never
+	 * cleared, as blocks can't go away once written. NULL if it couldn't
+	 * be allocated, or if the file was complete when opened.
+	 */
+	unsigned long *df_present_map;
+
+	/* Number of bits set in df_present_map */
+	atomic_t df_present_count;
+
+	/* All data blocks are present */
+	bool df_fully_loaded;
+
 	struct file_attr n_attr;
 
 	struct mtree *df_hash_tree;
@@ -280,6 +303,10 @@ ssize_t incfs_read_data_file_block(struct mem_range dst, struct file *f,
 				   int index, int timeout_ms,
 				   struct mem_range tmp);
 
+int incfs_read_data_file_blocks(struct mem_range *dst, ssize_t *res,
+				int count, struct file *f, int index,
+				int timeout_ms, struct mem_range tmp);
+
 int incfs_get_filled_blocks(struct data_file *df,
 			    struct incfs_get_filled_blocks_args *arg);
 
@@ -300,6 +327,7 @@ bool incfs_fresh_pending_reads_exist(struct mount_info *mi, int last_number);
  */
 int incfs_collect_pending_reads(struct mount_info *mi, int sn_lowerbound,
 				struct incfs_pending_read_info *reads,
+				struct incfs_pending_read_info2 *reads2,
 				int reads_size);
 
 int incfs_collect_logged_reads(struct mount_info *mi,
@@ -206,30 +206,64 @@ void incfs_free_mtree(struct mtree *tree)
 
 int incfs_calc_digest(struct incfs_hash_alg *alg, struct mem_range data,
 			struct mem_range digest)
+{
+	return incfs_calc_digests(alg, &data, 1, digest);
+}
+
+/*
+ * Hashes @count blocks into consecutive digests of @digests, sharing one
+ * descriptor and one padding buffer for short blocks between them.
+ */
+int incfs_calc_digests(struct incfs_hash_alg *alg, struct mem_range *data,
+			int count, struct mem_range digests)
 {
 	SHASH_DESC_ON_STACK(desc, alg->shash);
+	u8 *buf = NULL;
+	int err = 0;
+	int i;
 
-	if (!alg || !alg->shash || !data.data || !digest.data)
+	if (!alg || !alg->shash || !data || !digests.data)
 		return -EFAULT;
 
-	if (alg->digest_size > digest.len)
+	if (count <= 0 || alg->digest_size * count > digests.len)
 		return -EINVAL;
 
 	desc->tfm = alg->shash;
 
-	if (data.len < INCFS_DATA_FILE_BLOCK_SIZE) {
-		int err;
-		void *buf = kzalloc(INCFS_DATA_FILE_BLOCK_SIZE, GFP_NOFS);
+	for (i = 0; i < count; i++) {
+		u8 *digest = digests.data + i * alg->digest_size;
 
-		if (!buf)
-			return -ENOMEM;
+		if (!data[i].data) {
+			err = -EFAULT;
+			break;
+		}
 
-		memcpy(buf, data.data, data.len);
+		if (data[i].len >= INCFS_DATA_FILE_BLOCK_SIZE) {
+			err = crypto_shash_digest(desc, data[i].data,
+						  data[i].len, digest);
+			if (err)
+				break;
+			continue;
+		}
+
+		if (!buf) {
+			buf = kmalloc(INCFS_DATA_FILE_BLOCK_SIZE, GFP_NOFS);
+			if (!buf) {
+				err = -ENOMEM;
+				break;
+			}
+		}
+
+		memcpy(buf, data[i].data, data[i].len);
+		memset(buf + data[i].len, 0,
+		       INCFS_DATA_FILE_BLOCK_SIZE - data[i].len);
 		err = crypto_shash_digest(desc, buf, INCFS_DATA_FILE_BLOCK_SIZE,
-					  digest.data);
-		kfree(buf);
-		return err;
+					  digest);
+		if (err)
+			break;
 	}
-	return crypto_shash_digest(desc, data.data, data.len, digest.data);
+
+	kfree(buf);
+	return err;
 }
 
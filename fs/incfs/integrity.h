@@ -53,4 +53,7 @@ size_t incfs_get_mtree_hash_count(enum incfs_hash_tree_algorithm alg,
 int incfs_calc_digest(struct incfs_hash_alg *alg, struct mem_range data,
 			struct mem_range digest);
 
+int incfs_calc_digests(struct incfs_hash_alg *alg, struct mem_range *data,
+			int count, struct mem_range digests);
+
 #endif /* _INCFS_INTEGRITY_H */
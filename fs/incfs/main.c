@@ -30,8 +30,17 @@ static ssize_t corefs_show(struct kobject *kobj,
 
 static struct kobj_attribute corefs_attr = __ATTR_RO(corefs);
 
+static ssize_t read_window_show(struct kobject *kobj,
+			  struct kobj_attribute *attr, char *buff)
+{
+	return snprintf(buff, PAGE_SIZE, "supported\n");
+}
+
+static struct kobj_attribute read_window_attr = __ATTR_RO(read_window);
+
 static struct attribute *attributes[] = {
 	&corefs_attr.attr,
+	&read_window_attr.attr,
 	NULL,
 };
 
@@ -9,6 +9,7 @@
 #include <linux/file.h>
 #include <linux/fs.h>
 #include <linux/fs_stack.h>
+#include <linux/mm_inline.h>
 #include <linux/namei.h>
 #include <linux/parser.h>
 #include <linux/poll.h>
@@ -53,6 +54,8 @@ static int dir_rename(struct inode *old_dir, struct dentry *old_dentry,
 static int file_open(struct inode *inode, struct file *file);
 static int file_release(struct inode *inode, struct file *file);
 static int read_single_page(struct file *f, struct page *page);
+static int readpages(struct file *f, struct address_space *mapping,
+		     struct list_head *pages, unsigned int nr_pages);
 static long dispatch_ioctl(struct file *f, unsigned int req, unsigned long arg);
 
 static ssize_t pending_reads_read(struct file *f, char __user *buf, size_t len,
@@ -123,7 +126,7 @@ static const struct dentry_operations incfs_dentry_ops = {
 
 static const struct address_space_operations incfs_address_space_ops = {
 	.readpage = read_single_page,
-	/* .readpages = readpages */
+	.readpages = readpages,
 };
 
 static const struct file_operations incfs_file_ops = {
@@ -220,6 +223,7 @@ enum parse_parameter {
 	Opt_no_backing_file_readahead,
 	Opt_rlog_pages,
 	Opt_rlog_wakeup_cnt,
+	Opt_read_window,
 	Opt_err
 };
 
@@ -242,6 +246,7 @@ static const match_table_t option_tokens = {
 	{ Opt_no_backing_file_readahead, "no_bf_readahead=%u" },
 	{ Opt_rlog_pages, "rlog_pages=%u" },
 	{ Opt_rlog_wakeup_cnt, "rlog_wakeup_cnt=%u" },
+	{ Opt_read_window, "read_window=%u" },
 	{ Opt_err, NULL }
 };
 
@@ -258,6 +263,7 @@ static int parse_options(struct mount_options *opts, char *str)
 	opts->readahead_pages = 10;
 	opts->read_log_pages = 2;
 	opts->read_log_wakeup_count = 10;
+	opts->read_window = 0;
 	opts->no_backing_file_cache = false;
 	opts->no_backing_file_readahead = false;
 	if (str == NULL || *str == 0)
@@ -302,6 +308,13 @@ static int parse_options(struct mount_options *opts, char *str)
 				return -EINVAL;
 			opts->read_log_wakeup_count = value;
 			break;
+		case Opt_read_window:
+			if (match_int(&args[0], &value))
+				return -EINVAL;
+			if (value < 0 || value > INCFS_MAX_READ_WINDOW)
+				return -EINVAL;
+			opts->read_window = value;
+			break;
 		default:
 			return -EINVAL;
 		}
@@ -466,7 +479,12 @@ static ssize_t pending_reads_read(struct file *f, char __user *buf, size_t len,
 	struct pending_reads_state *pr_state = f->private_data;
 	struct mount_info *mi = get_mount_info(file_superblock(f));
 	struct incfs_pending_read_info *reads_buf = NULL;
-	size_t reads_to_collect = len / sizeof(*reads_buf);
+	struct incfs_pending_read_info2 *reads_buf2 = NULL;
+	bool report_window = mi->mi_options.read_window != 0;
+	size_t record_size = report_window ? sizeof(*reads_buf2) :
+					     sizeof(*reads_buf);
+	size_t reads_to_collect = len / record_size;
+	void *page = NULL;
 	int last_known_read_sn = READ_ONCE(pr_state->last_pending_read_sn);
 	int new_max_sn = last_known_read_sn;
 	int reads_collected = 0;
@@ -476,33 +494,42 @@ static ssize_t pending_reads_read(struct file *f, char __user *buf, size_t len,
 	if (!incfs_fresh_pending_reads_exist(mi, last_known_read_sn))
 		return 0;
 
-	reads_buf = (struct incfs_pending_read_info *)get_zeroed_page(GFP_NOFS);
-	if (!reads_buf)
+	page = (void *)get_zeroed_page(GFP_NOFS);
+	if (!page)
 		return -ENOMEM;
 
+	if (report_window)
+		reads_buf2 = page;
+	else
+		reads_buf = page;
+
 	reads_to_collect =
-		min_t(size_t, PAGE_SIZE / sizeof(*reads_buf), reads_to_collect);
+		min_t(size_t, PAGE_SIZE / record_size, reads_to_collect);
 
-	reads_collected = incfs_collect_pending_reads(
-		mi, last_known_read_sn, reads_buf, reads_to_collect);
+	reads_collected = incfs_collect_pending_reads(mi, last_known_read_sn,
+			reads_buf, reads_buf2, reads_to_collect);
 	if (reads_collected < 0) {
 		result = reads_collected;
 		goto out;
 	}
 
-	for (i = 0; i < reads_collected; i++)
-		if (reads_buf[i].serial_number > new_max_sn)
-			new_max_sn = reads_buf[i].serial_number;
+	for (i = 0; i < reads_collected; i++) {
+		int sn = reads_buf ? reads_buf[i].serial_number :
+				     reads_buf2[i].serial_number;
+
+		if (sn > new_max_sn)
+			new_max_sn = sn;
+	}
 
 	/*
 	 * Just to make sure that we don't accidentally copy more data
 	 * to reads buffer than userspace can handle.
 	 */
 	reads_collected = min_t(size_t, reads_collected, reads_to_collect);
-	result = reads_collected * sizeof(*reads_buf);
+	result = reads_collected * record_size;
 
 	/* Copy reads info to the userspace buffer */
-	if (copy_to_user(buf, reads_buf, result)) {
+	if (copy_to_user(buf, page, result)) {
 		result = -EFAULT;
 		goto out;
 	}
@@ -510,8 +537,7 @@ static ssize_t pending_reads_read(struct file *f, char __user *buf, size_t len,
 	WRITE_ONCE(pr_state->last_pending_read_sn, new_max_sn);
 	*ppos = 0;
 out:
-	if (reads_buf)
-		free_page((unsigned long)reads_buf);
+	free_page((unsigned long)page);
 	return result;
 }
 
@@ -846,6 +872,100 @@ static int read_single_page(struct file *f, struct page *page)
 	return result;
 }
 
+/*
+ * Reads @nr locked pages of consecutive indices as one batch and unlocks
+ * them. Pages past the first failure are left !Uptodate, so ->readpage
+ * retries them on its own and reports the error for the right page.
+ */
+static void read_page_batch(struct file *f, struct page **pages, int nr,
+			    struct mem_range tmp)
+{
+	struct data_file *df = get_incfs_data_file(f);
+	struct mem_range dst[INCFS_VERIFY_BATCH];
+	ssize_t res[INCFS_VERIFY_BATCH];
+	int timeout_ms = df->df_mount_info->mi_options.read_timeout_ms;
+	int done = 0;
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		loff_t offset = page_offset(pages[i]);
+
+		dst[i] = range(kmap(pages[i]),
+			       min_t(loff_t, df->df_size - offset, PAGE_SIZE));
+	}
+
+	while (done < nr) {
+		int read = incfs_read_data_file_blocks(dst + done, res + done,
+				nr - done, f, pages[done]->index, timeout_ms,
+				tmp);
+
+		if (read <= 0)
+			break;
+		done += read;
+	}
+
+	for (i = 0; i < nr; i++) {
+		if (i < done) {
+			if (res[i] < PAGE_SIZE)
+				zero_user(pages[i], res[i], PAGE_SIZE - res[i]);
+			SetPageUptodate(pages[i]);
+		}
+		flush_dcache_page(pages[i]);
+		kunmap(pages[i]);
+		unlock_page(pages[i]);
+		put_page(pages[i]);
+	}
+}
+
+static int readpages(struct file *f, struct address_space *mapping,
+		     struct list_head *pages, unsigned int nr_pages)
+{
+	struct data_file *df = get_incfs_data_file(f);
+	struct page *batch[INCFS_VERIFY_BATCH];
+	struct mem_range tmp = {
+		.len = 2 * INCFS_DATA_FILE_BLOCK_SIZE
+	};
+	int nr = 0;
+
+	if (!df)
+		return -EBADF;
+
+	tmp.data = (u8 *)__get_free_pages(GFP_NOFS, get_order(tmp.len));
+	if (!tmp.data)
+		return -ENOMEM;
+
+	while (!list_empty(pages)) {
+		struct page *page = lru_to_page(pages);
+
+		list_del(&page->lru);
+		if (add_to_page_cache_lru(page, mapping, page->index,
+					  readahead_gfp_mask(mapping))) {
+			put_page(page);
+			continue;
+		}
+
+		if (nr && (nr == INCFS_VERIFY_BATCH ||
+			   page->index != batch[nr - 1]->index + 1)) {
+			read_page_batch(f, batch, nr, tmp);
+			nr = 0;
+		}
+
+		if (page_offset(page) >= df->df_size) {
+			read_single_page(f, page);
+			put_page(page);
+			continue;
+		}
+
+		batch[nr++] = page;
+	}
+
+	if (nr)
+		read_page_batch(f, batch, nr, tmp);
+
+	free_pages((unsigned long)tmp.data, get_order(tmp.len));
+	return 0;
+}
+
 static char *file_id_to_str(incfs_uuid_t id)
 {
 	char *result = kmalloc(1 + sizeof(id.bytes) * 2, GFP_NOFS);
@@ -2296,6 +2416,8 @@ static int show_options(struct seq_file *m, struct dentry *root)
 
 	seq_printf(m, ",read_timeout_ms=%u", mi->mi_options.read_timeout_ms);
 	seq_printf(m, ",readahead=%u", mi->mi_options.readahead_pages);
+	if (mi->mi_options.read_window != 0)
+		seq_printf(m, ",read_window=%u", mi->mi_options.read_window);
 	if (mi->mi_options.read_log_pages != 0) {
 		seq_printf(m, ",rlog_pages=%u", mi->mi_options.read_log_pages);
 		seq_printf(m, ",rlog_wakeup_cnt=%u",
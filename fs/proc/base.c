@@ -82,6 +82,7 @@
 #include <linux/poll.h>
 #include <linux/nsproxy.h>
 #include <linux/oom.h>
+#include <linux/simple_lmk.h>
 #include <linux/elf.h>
 #include <linux/pid_namespace.h>
 #include <linux/user_namespace.h>
@@ -1056,12 +1057,15 @@ static int __set_oom_adj(struct file *file, int oom_adj, bool legacy)
 	if (likely(!legacy) && has_capability_noaudit(current, CAP_SYS_RESOURCE))
 		task->signal->oom_score_adj_min = (short)oom_adj;
 	trace_oom_score_adj_update(task);
+	simple_lmk_adj_changed(task->signal);
 
 	if (mm) {
 		struct task_struct *p;
 
 		rcu_read_lock();
 		for_each_process(p) {
+			bool updated = false;
+
 			if (same_thread_group(task, p))
 				continue;
 
@@ -1074,8 +1078,11 @@ static int __set_oom_adj(struct file *file, int oom_adj, bool legacy)
 				p->signal->oom_score_adj = oom_adj;
 				if (likely(!legacy) && has_capability_noaudit(current, CAP_SYS_RESOURCE))
 					p->signal->oom_score_adj_min = (short)oom_adj;
+				updated = true;
 			}
 			task_unlock(p);
+			if (updated)
+				simple_lmk_adj_changed(p->signal);
 		}
 		rcu_read_unlock();
 		mmdrop(mm);
@@ -3312,6 +3319,7 @@ static const struct pid_entry tgid_base_stuff[] = {
 	REG("clear_refs", S_IWUSR, proc_clear_refs_operations),
 	REG("smaps",      S_IRUGO, proc_pid_smaps_operations),
 	REG("smaps_rollup", S_IRUGO, proc_pid_smaps_rollup_operations),
+	ONE("mem_summary", S_IRUSR, proc_pid_mem_summary),
 	REG("pagemap",    S_IRUSR, proc_pagemap_operations),
 #endif
 #ifdef CONFIG_SECURITY
@@ -3722,6 +3730,7 @@ static const struct pid_entry tid_base_stuff[] = {
 	REG("clear_refs", S_IWUSR, proc_clear_refs_operations),
 	REG("smaps",     S_IRUGO, proc_tid_smaps_operations),
 	REG("smaps_rollup", S_IRUGO, proc_pid_smaps_rollup_operations),
+	ONE("mem_summary", S_IRUSR, proc_pid_mem_summary),
 	REG("pagemap",    S_IRUSR, proc_pagemap_operations),
 #endif
 #ifdef CONFIG_SECURITY
@@ -301,6 +301,8 @@ extern const struct file_operations proc_tid_numa_maps_operations;
 extern const struct file_operations proc_pid_smaps_operations;
 extern const struct file_operations proc_pid_smaps_rollup_operations;
 extern const struct file_operations proc_tid_smaps_operations;
+extern int proc_pid_mem_summary(struct seq_file *, struct pid_namespace *,
+				struct pid *, struct task_struct *);
 extern const struct file_operations proc_clear_refs_operations;
 extern const struct file_operations proc_pagemap_operations;
 
@@ -76,6 +76,14 @@ void task_mem(struct seq_file *m, struct mm_struct *mm)
 		    " kB\nVmPTE:\t", mm_pgtables_bytes(mm) >> 10, 8);
 	SEQ_PUT_DEC(" kB\nVmSwap:\t", swap);
 	seq_puts(m, " kB\n");
+#ifdef CONFIG_PROCESS_RECLAIM
+	SEQ_PUT_DEC("Reclaimed:\t",
+		    atomic_long_read(&mm->reclaim_nr_reclaimed));
+	seq_puts(m, " kB\n");
+	seq_put_decimal_ull(m, "ReclaimRefaults:\t",
+			    atomic_long_read(&mm->reclaim_nr_refaulted));
+	seq_putc(m, '\n');
+#endif
 	hugetlb_report_usage(m, mm);
 }
 #undef SEQ_PUT_DEC
@@ -509,6 +517,7 @@ struct mem_size_stats {
 	u64 pss;
 	u64 pss_locked;
 	u64 swap_pss;
+	u64 pss_counter[NR_MM_COUNTERS];	/* Pss split by mm_counter() */
 	bool check_shmem_swap;
 };
 
@@ -517,6 +526,7 @@ static void smaps_account(struct mem_size_stats *mss, struct page *page,
 {
 	int i, nr = compound ? 1 << compound_order(page) : 1;
 	unsigned long size = nr * PAGE_SIZE;
+	u64 *pss_counter = &mss->pss_counter[mm_counter(page)];
 
 	if (PageAnon(page)) {
 		mss->anonymous += size;
@@ -540,6 +550,7 @@ static void smaps_account(struct mem_size_stats *mss, struct page *page,
 		else
 			mss->private_clean += size;
 		mss->pss += (u64)size << PSS_SHIFT;
+		*pss_counter += (u64)size << PSS_SHIFT;
 		if (locked)
 			mss->pss_locked += (u64)size << PSS_SHIFT;
 		return;
@@ -555,6 +566,7 @@ static void smaps_account(struct mem_size_stats *mss, struct page *page,
 			else
 				mss->shared_clean += PAGE_SIZE;
 			mss->pss += pss / mapcount;
+			*pss_counter += pss / mapcount;
 			if (locked)
 				mss->pss_locked += pss / mapcount;
 		} else {
@@ -563,6 +575,7 @@ static void smaps_account(struct mem_size_stats *mss, struct page *page,
 			else
 				mss->private_clean += PAGE_SIZE;
 			mss->pss += pss;
+			*pss_counter += pss;
 			if (locked)
 				mss->pss_locked += pss;
 		}
@@ -798,6 +811,23 @@ void __weak arch_show_smap(struct seq_file *m, struct vm_area_struct *vma)
 {
 }
 
+/* Keep the result of a full rollup walk for proc_pid_mem_summary() */
+static void smaps_rollup_snapshot(struct mm_struct *mm,
+				  struct mem_size_stats *mss)
+{
+	struct mm_rollup_snapshot *snap = &mm->rollup_snap;
+	int i;
+
+	spin_lock(&snap->lock);
+	for (i = 0; i < NR_MM_COUNTERS; i++) {
+		snap->pss[i] = mss->pss_counter[i];
+		snap->rss[i] = get_mm_counter(mm, i);
+	}
+	snap->pss[MM_SWAPENTS] = mss->swap_pss;
+	snap->time_ns = ktime_get_ns();
+	spin_unlock(&snap->lock);
+}
+
 #define SEQ_PUT_DEC(str, val) \
 		seq_put_decimal_ull_width(m, str, (val) >> 10, 8)
 static int show_smap(struct seq_file *m, void *v, int is_pid)
@@ -869,6 +899,7 @@ static int show_smap(struct seq_file *m, void *v, int is_pid)
 			seq_putc(m, '\n');
 		}
 	} else if (last_vma) {
+		smaps_rollup_snapshot(vma->vm_mm, mss);
 		show_vma_header_prefix(
 			m, mss->first_vma_start, vma->vm_end, 0, 0, 0, 0);
 		seq_pad(m, ' ');
@@ -920,6 +951,84 @@ static int show_smap(struct seq_file *m, void *v, int is_pid)
 	m_cache_vma(m, vma);
 	return ret;
 }
+
+/*
+ * Scale the PSS of mm counter @i found by the last rollup walk to the
+ * current value of the counter, in bytes. Each page mapped or unmapped
+ * since the walk may be off by up to a page, added to @err.
+ */
+static u64 mem_summary_pss(struct mm_rollup_snapshot *snap, int i,
+			   unsigned long rss, u64 *err)
+{
+	unsigned long old = snap->time_ns ? snap->rss[i] : 0;
+
+	*err += (u64)(rss > old ? rss - old : old - rss) << PAGE_SHIFT;
+	if (!old)
+		return (u64)rss << PAGE_SHIFT;
+	return div64_u64((snap->pss[i] >> PSS_SHIFT) * rss, old);
+}
+
+/*
+ * /proc/pid/mem_summary: what smaps_rollup reports for RSS, PSS and swap,
+ * without a page walk. RSS and swap come from the mm counters, which rmap
+ * and swap keep up to date. PSS is the last smaps_rollup walk scaled to
+ * those counters, with a bound for the pages mapped and unmapped since.
+ * Other processes mapping or unmapping pages we share change our PSS too
+ * and are not seen here: SnapshotAge tells how old the walk is, read
+ * smaps_rollup again when an exact value is needed.
+ */
+int proc_pid_mem_summary(struct seq_file *m, struct pid_namespace *ns,
+			 struct pid *pid, struct task_struct *task)
+{
+	u64 pss = 0, pss_err = 0, swap_pss, swap_err = 0;
+	unsigned long rss[NR_MM_COUNTERS];
+	struct mm_rollup_snapshot *snap;
+	struct mm_struct *mm;
+	s64 age_ms = -1;
+	int i;
+
+	if (!ptrace_may_access(task, PTRACE_MODE_READ_FSCREDS))
+		return -EACCES;
+
+	mm = get_task_mm(task);
+	if (!mm)
+		return 0;
+
+	for (i = 0; i < NR_MM_COUNTERS; i++)
+		rss[i] = get_mm_counter(mm, i);
+
+	snap = &mm->rollup_snap;
+	spin_lock(&snap->lock);
+	pss += mem_summary_pss(snap, MM_FILEPAGES, rss[MM_FILEPAGES],
+			       &pss_err);
+	pss += mem_summary_pss(snap, MM_ANONPAGES, rss[MM_ANONPAGES],
+			       &pss_err);
+	pss += mem_summary_pss(snap, MM_SHMEMPAGES, rss[MM_SHMEMPAGES],
+			       &pss_err);
+	swap_pss = mem_summary_pss(snap, MM_SWAPENTS, rss[MM_SWAPENTS],
+				   &swap_err);
+	if (snap->time_ns)
+		age_ms = div_u64(ktime_get_ns() - snap->time_ns,
+				 NSEC_PER_MSEC);
+	spin_unlock(&snap->lock);
+	mmput(mm);
+
+	SEQ_PUT_DEC("Rss:            ", (rss[MM_FILEPAGES] +
+		rss[MM_ANONPAGES] + rss[MM_SHMEMPAGES]) << PAGE_SHIFT);
+	SEQ_PUT_DEC(" kB\nAnonymous:      ", rss[MM_ANONPAGES] << PAGE_SHIFT);
+	SEQ_PUT_DEC(" kB\nFile:           ", rss[MM_FILEPAGES] << PAGE_SHIFT);
+	SEQ_PUT_DEC(" kB\nShmem:          ", rss[MM_SHMEMPAGES] << PAGE_SHIFT);
+	SEQ_PUT_DEC(" kB\nSwap:           ", rss[MM_SWAPENTS] << PAGE_SHIFT);
+	SEQ_PUT_DEC(" kB\nPss:            ", pss);
+	SEQ_PUT_DEC(" kB\nPssError:       ", pss_err);
+	SEQ_PUT_DEC(" kB\nSwapPss:        ", swap_pss);
+	SEQ_PUT_DEC(" kB\nSwapPssError:   ", swap_err);
+	seq_puts(m, " kB\n");
+	seq_put_decimal_ll(m, "SnapshotAge:    ", age_ms);
+	seq_puts(m, " ms\n");
+
+	return 0;
+}
 #undef SEQ_PUT_DEC
 
 static int show_pid_smap(struct seq_file *m, void *v)
@@ -1692,6 +1801,21 @@ static int reclaim_pte_range(pmd_t *pmd, unsigned long addr,
 		if (!page)
 			continue;
 
+		if (rp->mark_idle) {
+			if (!PageLRU(page))
+				continue;
+			/* as page_idle_clear_pte_refs_one() does */
+			if (ptep_clear_young_notify(vma, addr, pte))
+				set_page_young(page);
+			set_page_idle(page);
+			continue;
+		}
+
+		/* referenced through this mm, or by anyone via rmap */
+		if (rp->idle_only &&
+		    (pte_young(ptent) || !page_is_idle(page)))
+			continue;
+
 		if (isolate_lru_page(page))
 			continue;
 
@@ -1716,7 +1840,11 @@ static int reclaim_pte_range(pmd_t *pmd, unsigned long addr,
 			break;
 	}
 	pte_unmap_unlock(pte - 1, ptl);
+	if (rp->mark_idle)
+		goto out;
+
 	reclaimed = reclaim_pages_from_list(&page_list, vma);
+	atomic_long_add(reclaimed, &vma->vm_mm->reclaim_nr_reclaimed);
 	rp->nr_reclaimed += reclaimed;
 	rp->nr_to_reclaim -= reclaimed;
 	if (rp->nr_to_reclaim < 0)
@@ -1724,7 +1852,7 @@ static int reclaim_pte_range(pmd_t *pmd, unsigned long addr,
 
 	if (rp->nr_to_reclaim && (addr != end))
 		goto cont;
-
+out:
 	cond_resched();
 	return 0;
 }
@@ -1736,8 +1864,14 @@ enum reclaim_type {
 	RECLAIM_RANGE,
 };
 
+/*
+ * With @idle_scans set, a task's anon pages are first marked idle and are
+ * only reclaimed @idle_scans passes later, skipping those that were
+ * touched in-between. The pass that marks the pages reclaims nothing, and
+ * neither do the passes before the pages are old enough.
+ */
 struct reclaim_param reclaim_task_anon(struct task_struct *task,
-		int nr_to_reclaim)
+		int nr_to_reclaim, unsigned int idle_scans)
 {
 	struct mm_struct *mm;
 	struct vm_area_struct *vma;
@@ -1751,6 +1885,20 @@ struct reclaim_param reclaim_task_anon(struct task_struct *task,
 	if (!mm)
 		goto out;
 
+	if (!IS_ENABLED(CONFIG_IDLE_PAGE_TRACKING))
+		idle_scans = 0;
+
+	if (idle_scans) {
+		if (!mm->reclaim_idle_age) {
+			rp.mark_idle = true;
+		} else if (mm->reclaim_idle_age < idle_scans) {
+			mm->reclaim_idle_age++;
+			goto out_mm;
+		} else {
+			rp.idle_only = true;
+		}
+	}
+
 	reclaim_walk.mm = mm;
 	reclaim_walk.pmd_entry = reclaim_pte_range;
 
@@ -1764,7 +1912,7 @@ struct reclaim_param reclaim_task_anon(struct task_struct *task,
 		if (vma->vm_file)
 			continue;
 
-		if (!rp.nr_to_reclaim)
+		if (!rp.nr_to_reclaim && !rp.mark_idle)
 			break;
 
 		rp.vma = vma;
@@ -1774,6 +1922,12 @@ struct reclaim_param reclaim_task_anon(struct task_struct *task,
 
 	flush_tlb_mm(mm);
 	up_read(&mm->mmap_sem);
+
+	if (idle_scans)
+		mm->reclaim_idle_age = rp.mark_idle ? 1 : 0;
+out_mm:
+	rp.mm_reclaimed = atomic_long_read(&mm->reclaim_nr_reclaimed);
+	rp.mm_refaulted = atomic_long_read(&mm->reclaim_nr_refaulted);
 	mmput(mm);
 out:
 	put_task_struct(task);
@@ -1857,6 +2011,8 @@ static ssize_t reclaim_write(struct file *file, const char __user *buf,
 
 	rp.nr_to_reclaim = INT_MAX;
 	rp.nr_reclaimed = 0;
+	rp.mark_idle = false;
+	rp.idle_only = false;
 	reclaim_walk.private = &rp;
 
 	down_read(&mm->mmap_sem);
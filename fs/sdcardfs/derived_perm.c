@@ -20,6 +20,8 @@
 
 #include "sdcardfs.h"
 
+static atomic64_t derived_perm_seq = ATOMIC64_INIT(0);
+
 /* copy derived state from parent inode */
 static void inherit_derived_state(struct inode *parent, struct inode *child)
 {
@@ -46,6 +48,40 @@ void setup_derived_state(struct inode *inode, perm_t perm, userid_t userid,
 	info->data->under_android = false;
 	info->data->under_cache = false;
 	info->data->under_obb = false;
+	info->data->perm_seq = atomic64_inc_return(&derived_perm_seq);
+}
+
+/*
+ * Deriving the state of a package directory hashes its name against the
+ * package list, and lookup does it again for every dentry it touches.
+ * Each dentry remembers the package list generation and the stamps of
+ * its own and its parent's state from the last time it was derived; as
+ * long as none of them moved, deriving again would give the same result.
+ */
+static bool derived_perm_cached(struct dentry *parent, struct dentry *dentry)
+{
+	struct sdcardfs_dentry_info *di = SDCARDFS_D(dentry);
+	struct sdcardfs_inode_data *data = SDCARDFS_I(d_inode(dentry))->data;
+	struct sdcardfs_inode_data *parent_data =
+				SDCARDFS_I(d_inode(parent))->data;
+
+	return di && di->perm_gen == atomic_read(&sdcardfs_packagelist_gen) &&
+		di->perm_seq == data->perm_seq &&
+		di->parent_perm_seq == parent_data->perm_seq;
+}
+
+static void derived_perm_stamp(struct dentry *parent, struct dentry *dentry,
+				unsigned int gen)
+{
+	struct sdcardfs_dentry_info *di = SDCARDFS_D(dentry);
+	struct sdcardfs_inode_data *data = SDCARDFS_I(d_inode(dentry))->data;
+
+	data->perm_seq = atomic64_inc_return(&derived_perm_seq);
+	if (!di)
+		return;
+	di->perm_gen = gen;
+	di->perm_seq = data->perm_seq;
+	di->parent_perm_seq = SDCARDFS_I(d_inode(parent))->data->perm_seq;
 }
 
 /* While renaming, there is a point where we want the path from dentry,
@@ -66,6 +102,8 @@ void get_derived_permission_new(struct dentry *parent, struct dentry *dentry,
 	struct qstr q_obb = QSTR_LITERAL("obb");
 	struct qstr q_media = QSTR_LITERAL("media");
 	struct qstr q_cache = QSTR_LITERAL("cache");
+	/* read first, a package list change racing with us must miss */
+	unsigned int gen = atomic_read(&sdcardfs_packagelist_gen);
 
 	/* By default, each inode inherits from its parent.
 	 * the properties are maintained on its private fields
@@ -80,7 +118,7 @@ void get_derived_permission_new(struct dentry *parent, struct dentry *dentry,
 	/* Files don't get special labels */
 	if (!S_ISDIR(d_inode(dentry)->i_mode)) {
 		set_top(info, parent_info);
-		return;
+		goto out;
 	}
 	/* Derive custom permissions based on parent and current node */
 	switch (parent_data->perm) {
@@ -143,10 +181,14 @@ void get_derived_permission_new(struct dentry *parent, struct dentry *dentry,
 		set_top(info, parent_info);
 		break;
 	}
+out:
+	derived_perm_stamp(parent, dentry, gen);
 }
 
 void get_derived_permission(struct dentry *parent, struct dentry *dentry)
 {
+	if (derived_perm_cached(parent, dentry))
+		return;
 	get_derived_permission_new(parent, dentry, &dentry->d_name);
 }
 
@@ -45,6 +45,9 @@ static DEFINE_HASHTABLE(ext_to_groupid, 8);
 
 static struct kmem_cache *hashtable_entry_cachep;
 
+/* Bumped on every change that derived permissions may depend on */
+atomic_t sdcardfs_packagelist_gen = ATOMIC_INIT(1);
+
 static unsigned int full_name_case_hash(const void *salt, const unsigned char *name, unsigned int len)
 {
 	unsigned long hash = init_name_hash(salt);
@@ -256,6 +259,8 @@ static void fixup_all_perms_name(const struct qstr *key)
 		.flags = BY_NAME,
 		.name = QSTR_INIT(key->name, key->len),
 	};
+
+	atomic_inc(&sdcardfs_packagelist_gen);
 	list_for_each_entry(sbinfo, &sdcardfs_super_list, list) {
 		if (sbinfo_has_sdcard_magic(sbinfo))
 			fixup_perms_recursive(sbinfo->sb->s_root, &limit);
@@ -270,6 +275,8 @@ static void fixup_all_perms_name_userid(const struct qstr *key, userid_t userid)
 		.name = QSTR_INIT(key->name, key->len),
 		.userid = userid,
 	};
+
+	atomic_inc(&sdcardfs_packagelist_gen);
 	list_for_each_entry(sbinfo, &sdcardfs_super_list, list) {
 		if (sbinfo_has_sdcard_magic(sbinfo))
 			fixup_perms_recursive(sbinfo->sb->s_root, &limit);
@@ -283,6 +290,8 @@ static void fixup_all_perms_userid(userid_t userid)
 		.flags = BY_USERID,
 		.userid = userid,
 	};
+
+	atomic_inc(&sdcardfs_packagelist_gen);
 	list_for_each_entry(sbinfo, &sdcardfs_super_list, list) {
 		if (sbinfo_has_sdcard_magic(sbinfo))
 			fixup_perms_recursive(sbinfo->sb->s_root, &limit);
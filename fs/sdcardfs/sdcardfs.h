@@ -169,6 +169,9 @@ struct sdcardfs_inode_data {
 	bool under_android;
 	bool under_cache;
 	bool under_obb;
+
+	/* stamp of the last time this state was derived */
+	u64 perm_seq;
 };
 
 /* sdcardfs inode data in memory */
@@ -190,6 +193,11 @@ struct sdcardfs_dentry_info {
 	spinlock_t lock;	/* protects lower_path */
 	struct path lower_path;
 	struct path orig_path;
+
+	/* derived permission cache, see get_derived_permission() */
+	unsigned int perm_gen;
+	u64 perm_seq;
+	u64 parent_perm_seq;
 };
 
 struct sdcardfs_mount_options {
@@ -496,6 +504,7 @@ extern appid_t is_excluded(const char *app_name, userid_t userid);
 extern int check_caller_access_to_name(struct inode *parent_node, const struct qstr *name);
 extern int packagelist_init(void);
 extern void packagelist_exit(void);
+extern atomic_t sdcardfs_packagelist_gen;
 
 /* for derived_perm.c */
 #define BY_NAME		(1 << 0)
@@ -327,8 +327,12 @@ s32 fsapi_write_inode(struct inode *inode, DIR_ENTRY_T *info, int sync)
 }
 EXPORT_SYMBOL(fsapi_write_inode);
 
-/* return the cluster number in the given cluster offset */
-s32 fsapi_map_clus(struct inode *inode, u32 clu_offset, u32 *clu, int dest)
+/* return the cluster number in the given cluster offset
+ * num_clus (optional) : in, the number of clusters the caller wants from
+ * clu_offset; out, the number of them mapped contiguously from *clu
+ */
+s32 fsapi_map_clus(struct inode *inode, u32 clu_offset, u32 *clu,
+		u32 *num_clus, int dest)
 {
 	s32 err;
 	struct super_block *sb = inode->i_sb;
@@ -339,7 +343,7 @@ s32 fsapi_map_clus(struct inode *inode, u32 clu_offset, u32 *clu, int dest)
 	mutex_lock(&(SDFAT_SB(sb)->s_vlock));
 	TMSG("%s entered (inode:%p clus:%08x dest:%d\n",
 				__func__, inode, *clu, dest);
-	err = fscore_map_clus(inode, clu_offset, clu, dest);
+	err = fscore_map_clus(inode, clu_offset, clu, num_clus, dest);
 	TMSG("%s exited (clu:%08x err:%d)\n", __func__, *clu, err);
 	mutex_unlock(&(SDFAT_SB(sb)->s_vlock));
 	return err;
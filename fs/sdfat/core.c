@@ -3136,7 +3136,13 @@ s32 fscore_write_inode(struct inode *inode, DIR_ENTRY_T *info, s32 sync)
  * Output: errcode, cluster number
  * *clu = (~0), if it's unable to allocate a new cluster
  */
-s32 fscore_map_clus(struct inode *inode, u32 clu_offset, u32 *clu, int dest)
+/*
+ * num_clus (optional) : in, the number of clusters the caller is going to
+ * write from clu_offset, all allocated at once if clu_offset is past the
+ * end of the file; out, how many of them follow *clu on disk (0 on EOF).
+ */
+s32 fscore_map_clus(struct inode *inode, u32 clu_offset, u32 *clu,
+		u32 *num_clus, int dest)
 {
 	s32 ret, modified = false;
 	u32 last_clu;
@@ -3150,6 +3156,8 @@ s32 fscore_map_clus(struct inode *inode, u32 clu_offset, u32 *clu, int dest)
 	u32 local_clu_offset = clu_offset;
 	s32 reserved_clusters = fsi->reserved_clusters;
 	u32 num_to_be_allocated = 0, num_clusters = 0;
+	u32 num_wanted = (num_clus && *num_clus) ? *num_clus : 1;
+	u32 num_extra = 0, num_free;
 
 	fid->rwoffset = (s64)(clu_offset) << fsi->cluster_size_bits;
 
@@ -3161,9 +3169,25 @@ s32 fscore_map_clus(struct inode *inode, u32 clu_offset, u32 *clu, int dest)
 
 	if ((dest == ALLOC_NOWHERE) && (num_to_be_allocated > 0)) {
 		*clu = CLUS_EOF;
+		if (num_clus)
+			*num_clus = 0;
 		return 0;
 	}
 
+	/*
+	 * Allocate the clusters after clu_offset the caller is about to write
+	 * together with it. Not with delayed allocation, where each cluster
+	 * was reserved by its own write_begin.
+	 */
+	if ((num_to_be_allocated > 0) && (num_wanted > 1) &&
+		!(SDFAT_SB(sb)->options.improved_allocation & SDFAT_ALLOC_DELAY)) {
+		num_free = fsi->num_clusters - CLUS_BASE - fsi->used_clusters;
+		if (num_free > num_to_be_allocated)
+			num_extra = min(num_wanted - 1,
+					num_free - num_to_be_allocated);
+		num_to_be_allocated += num_extra;
+	}
+
 	/* check always request cluster is 1 */
 	//ASSERT(num_to_be_allocated == 1);
 
@@ -3336,7 +3360,9 @@ s32 fscore_map_clus(struct inode *inode, u32 clu_offset, u32 *clu, int dest)
 		 * because the caller of this function expect *clu to be the last cluster.
 		 * This only works when num_to_be_allocated >= 2,
 		 * *clu = (the first cluster of the allocated chain) => (the last cluster of ...)
+		 * The extra clusters allocated for the caller stay after *clu.
 		 */
+		num_to_be_allocated -= num_extra;
 		if (fid->flags == 0x03) {
 			*clu += num_to_be_allocated - 1;
 		} else {
@@ -3352,6 +3378,19 @@ s32 fscore_map_clus(struct inode *inode, u32 clu_offset, u32 *clu, int dest)
 	/* update reserved_clusters */
 	fsi->reserved_clusters = reserved_clusters;
 
+	if (num_clus) {
+		if (IS_CLUS_EOF(*clu))
+			*num_clus = 0;
+		else if (fid->flags == 0x03)
+			*num_clus = min(num_wanted,
+					num_clusters - local_clu_offset);
+		else if ((num_wanted > 1) && (fid->type == TYPE_FILE))
+			*num_clus = extent_get_contig(inode, local_clu_offset,
+					*clu, num_wanted);
+		else
+			*num_clus = 1;
+	}
+
 	/* hint information */
 	fid->hint_bmap.off = local_clu_offset;
 	fid->hint_bmap.clu = *clu;
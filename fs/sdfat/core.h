@@ -95,7 +95,8 @@ s32 fscore_rename(struct inode *old_parent_inode, FILE_ID_T *fid,
 s32 fscore_remove(struct inode *inode, FILE_ID_T *fid);
 s32 fscore_read_inode(struct inode *inode, DIR_ENTRY_T *info);
 s32 fscore_write_inode(struct inode *inode, DIR_ENTRY_T *info, int sync);
-s32 fscore_map_clus(struct inode *inode, u32 clu_offset, u32 *clu, int dest);
+s32 fscore_map_clus(struct inode *inode, u32 clu_offset, u32 *clu,
+		u32 *num_clus, int dest);
 s32 fscore_reserve_clus(struct inode *inode);
 s32 fscore_unlink(struct inode *inode, FILE_ID_T *fid);
 
@@ -207,6 +208,7 @@ void extent_cache_init_inode(struct inode *inode);
 void extent_cache_inval_inode(struct inode *inode);
 s32 extent_get_clus(struct inode *inode, u32 cluster, u32 *fclus,
 		u32 *dclus, u32 *last_dclus, s32 allow_eof);
+u32 extent_get_contig(struct inode *inode, u32 fclus, u32 dclus, u32 max);
 /*----------------------------------------------------------------------*/
 /*  Wrapper Function                                                    */
 /*----------------------------------------------------------------------*/
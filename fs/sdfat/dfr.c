@@ -415,7 +415,8 @@ defrag_validate_cluster(
 
 	/* Check chunk's clusters */
 	for (i = 0; i < chunk->nr_clus; i++) {
-		err = fsapi_map_clus(inode, chunk->f_clus + i, &clus, ALLOC_NOWHERE);
+		err = fsapi_map_clus(inode, chunk->f_clus + i, &clus, NULL,
+				ALLOC_NOWHERE);
 		if (err || (chunk->d_clus + i != clus)) {
 			if (!err)
 				err = -ENXIO;
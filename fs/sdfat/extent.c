@@ -269,6 +269,51 @@ static inline void cache_init(struct extent_cache_id *cid, u32 fclus, u32 dclus)
 	cid->nr_contig = 0;
 }
 
+/*
+ * Number of clusters, up to "max", which follow each other on disk from
+ * the cluster "fclus" of the file, found at "dclus". What the cache does
+ * not know is looked up in the FAT, and the run found is cached so that
+ * mapping the rest of it later does not read the FAT again.
+ */
+u32 extent_get_contig(struct inode *inode, u32 fclus, u32 dclus, u32 max)
+{
+	struct super_block *sb = inode->i_sb;
+	EXTENT_T *extent = &(SDFAT_I(inode)->fid.extent);
+	struct extent_cache_id cid;
+	struct extent_cache *p;
+	u32 nr = 1, last, content;
+
+	spin_lock(&extent->cache_lru_lock);
+	list_for_each_entry(p, &extent->cache_lru, cache_list) {
+		if ((p->fcluster <= fclus) &&
+				(fclus <= p->fcluster + p->nr_contig) &&
+				(nr < p->fcluster + p->nr_contig - fclus + 1))
+			nr = p->fcluster + p->nr_contig - fclus + 1;
+	}
+	cid.id = extent->cache_valid_id;
+	spin_unlock(&extent->cache_lru_lock);
+
+	if (nr >= max)
+		return max;
+
+	last = dclus + nr - 1;
+	while (nr < max) {
+		if (fat_ent_get_safe(sb, last, &content))
+			break;
+		if (content != last + 1)
+			break;
+		last = content;
+		nr++;
+	}
+
+	cid.fcluster = fclus;
+	cid.dcluster = dclus;
+	cid.nr_contig = nr - 1;
+	extent_cache_add(inode, &cid);
+
+	return nr;
+}
+
 s32 extent_get_clus(struct inode *inode, u32 cluster, u32 *fclus,
 		u32 *dclus, u32 *last_dclus, s32 allow_eof)
 {
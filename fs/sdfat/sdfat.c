@@ -3169,8 +3169,18 @@ static const struct inode_operations sdfat_file_inode_operations = {
 #define BMAP_ADD_BLOCK				1
 #define BMAP_ADD_CLUSTER			2
 #define BLOCK_ADDED(bmap_ops)	(bmap_ops)
-static int sdfat_bmap(struct inode *inode, sector_t sector, sector_t *phys,
-				  unsigned long *mapped_blocks, int *create)
+/* Upper bound of one mapping, in bytes */
+#define SDFAT_MAX_MAP_BYTES			(4 << 20)
+
+/*
+ * Map up to max_blocks from sector. Blocks of the file that are contiguous
+ * on disk are mapped together, across clusters, so that readahead builds
+ * large bios. When appending, all the clusters of the request are
+ * allocated at once.
+ */
+static int sdfat_bmap(struct inode *inode, sector_t sector,
+		unsigned long max_blocks, sector_t *phys,
+		unsigned long *mapped_blocks, int *create)
 {
 	struct super_block *sb = inode->i_sb;
 	struct sdfat_sb_info *sbi = SDFAT_SB(sb);
@@ -3178,7 +3188,7 @@ static int sdfat_bmap(struct inode *inode, sector_t sector, sector_t *phys,
 	const unsigned long blocksize = sb->s_blocksize;
 	const unsigned char blocksize_bits = sb->s_blocksize_bits;
 	sector_t last_block;
-	unsigned int cluster, clu_offset, sec_offset;
+	unsigned int cluster, clu_offset, sec_offset, num_clus;
 	int err = 0;
 
 	*phys = 0;
@@ -3206,6 +3216,22 @@ static int sdfat_bmap(struct inode *inode, sector_t sector, sector_t *phys,
 
 	/* Is this block already allocated? */
 	clu_offset = sector >> fsi->sect_per_clus_bits;  /* cluster offset */
+	/* sector offset in cluster */
+	sec_offset = sector & (fsi->sect_per_clus - 1);
+
+	/*
+	 * The clusters covered by the request. Only an append allocates
+	 * more than one: inside the file, new clusters would not be seen
+	 * as added by the caller.
+	 */
+	num_clus = (u32)min_t(u64, ((u64)sec_offset + max_blocks +
+			fsi->sect_per_clus - 1) >> fsi->sect_per_clus_bits,
+			max_t(u32, SDFAT_MAX_MAP_BYTES >> fsi->cluster_size_bits, 1));
+	if ((sector < last_block) && BLOCK_ADDED(*create))
+		num_clus = 1;
+	else if (sector < last_block)
+		num_clus = min_t(u32, num_clus, ((last_block - 1) >>
+				fsi->sect_per_clus_bits) - clu_offset + 1);
 
 	SDFAT_I(inode)->fid.size = i_size_read(inode);
 
@@ -3215,11 +3241,14 @@ static int sdfat_bmap(struct inode *inode, sector_t sector, sector_t *phys,
 		(loff_t)((loff_t)(clu_offset + 1) << fsi->cluster_size_bits),
 			__func__))) {
 		err = __do_dfr_map_cluster(inode, clu_offset, &cluster);
+		num_clus = 1;
 	} else {
 		if (*create & BMAP_ADD_CLUSTER)
-			err = fsapi_map_clus(inode, clu_offset, &cluster, 1);
+			err = fsapi_map_clus(inode, clu_offset, &cluster,
+					&num_clus, 1);
 		else
-			err = fsapi_map_clus(inode, clu_offset, &cluster, ALLOC_NOWHERE);
+			err = fsapi_map_clus(inode, clu_offset, &cluster,
+					&num_clus, ALLOC_NOWHERE);
 	}
 
 	if (err) {
@@ -3233,11 +3262,11 @@ static int sdfat_bmap(struct inode *inode, sector_t sector, sector_t *phys,
 				clu_offset, *create & BMAP_ADD_CLUSTER);
 
 	if (!IS_CLUS_EOF(cluster)) {
-		/* sector offset in cluster */
-		sec_offset = sector & (fsi->sect_per_clus - 1);
-
 		*phys = CLUS_TO_SECT(fsi, cluster) + sec_offset;
-		*mapped_blocks = fsi->sect_per_clus - sec_offset;
+		*mapped_blocks = ((unsigned long)num_clus <<
+				fsi->sect_per_clus_bits) - sec_offset;
+		sdfat_statistics_set_map(num_clus,
+				BLOCK_ADDED(*create) && (sector >= last_block));
 	}
 #if 0
 	else {
@@ -3282,7 +3311,8 @@ static int sdfat_da_prep_block(struct inode *inode, sector_t iblock,
 	/* FAT32 only */
 	ASSERT(fsi->vol_type == FAT32);
 
-	err = sdfat_bmap(inode, iblock, &phys, &mapped_blocks, &bmap_create);
+	/* write_begin reserves one cluster at a time */
+	err = sdfat_bmap(inode, iblock, 1, &phys, &mapped_blocks, &bmap_create);
 	if (err) {
 		if (err != -ENOSPC)
 			sdfat_fs_error_ratelimit(sb, "%s: failed to bmap "
@@ -3413,7 +3443,8 @@ static int sdfat_get_block(struct inode *inode, sector_t iblock,
 	int bmap_create = create ? BMAP_ADD_CLUSTER : BMAP_NOT_CREATE;
 
 	__lock_super(sb);
-	err = sdfat_bmap(inode, iblock, &phys, &mapped_blocks, &bmap_create);
+	err = sdfat_bmap(inode, iblock, max_blocks, &phys, &mapped_blocks,
+			&bmap_create);
 	if (err) {
 		if (err != -ENOSPC)
 			sdfat_fs_error_ratelimit(sb, "%s: failed to bmap "
@@ -3428,8 +3459,11 @@ static int sdfat_get_block(struct inode *inode, sector_t iblock,
 		/* Treat newly added block / cluster */
 		if (BLOCK_ADDED(bmap_create) || buffer_delay(bh_result)) {
 
-			/* Update i_size_ondisk */
-			pos = (iblock + 1) << sb->s_blocksize_bits;
+			/*
+			 * Update i_size_ondisk, up to the end of the mapping
+			 * which may cover several newly allocated clusters
+			 */
+			pos = (iblock + max_blocks) << sb->s_blocksize_bits;
 			if (SDFAT_I(inode)->i_size_ondisk < pos) {
 				/* Debug purpose */
 				if ((pos - SDFAT_I(inode)->i_size_ondisk) > bh_result->b_size) {
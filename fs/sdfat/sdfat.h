@@ -313,6 +313,7 @@ extern void sdfat_statistics_set_create(u8 flags);
 extern void sdfat_statistics_set_rw(u8 flags, u32 clu_offset, s32 create);
 extern void sdfat_statistics_set_trunc(u8 flags, CHAIN_T *clu);
 extern void sdfat_statistics_set_vol_size(struct super_block *sb);
+extern void sdfat_statistics_set_map(u32 num_clus, s32 append);
 #else
 static inline int sdfat_statistics_init(struct kset *sdfat_kset)
 {
@@ -326,6 +327,7 @@ static inline void sdfat_statistics_set_create(u8 flags) {};
 static inline void sdfat_statistics_set_rw(u8 flags, u32 clu_offset, s32 create) {};
 static inline void sdfat_statistics_set_trunc(u8 flags, CHAIN_T *clu) {};
 static inline void sdfat_statistics_set_vol_size(struct super_block *sb) {};
+static inline void sdfat_statistics_set_map(u32 num_clus, s32 append) {};
 #endif
 
 /* sdfat/nls.c */
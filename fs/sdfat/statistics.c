@@ -2,6 +2,7 @@
 
 #define SDFAT_VF_CLUS_MAX	7	/* 512 Byte ~ 32 KByte */
 #define SDFAT_EF_CLUS_MAX	17	/* 512 Byte ~ 32 MByte */
+#define SDFAT_MAP_CLUS_MAX	6	/* 1 ~ 32 or more clusters */
 
 enum {
 	SDFAT_MNT_FAT12,
@@ -41,6 +42,8 @@ static struct sdfat_statistics {
 	u32 mnt_cnt[SDFAT_MNT_MAX];
 	u32 nofat_op[SDFAT_OP_MAX];
 	u32 vol_size[SDFAT_VOL_MAX];
+	u32 map_read[SDFAT_MAP_CLUS_MAX];
+	u32 map_append[SDFAT_MAP_CLUS_MAX];
 } statistics;
 
 static struct kset *sdfat_statistics_kset;
@@ -128,11 +131,30 @@ static ssize_t vol_size_show(struct kobject *kobj,
 			statistics.vol_size[SDFAT_VOL_XTB]);
 }
 
+static ssize_t map_clus_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buff)
+{
+	return snprintf(buff, PAGE_SIZE, "\"MAP_1_I\":\"%u\","
+			"\"MAP_2_I\":\"%u\",\"MAP_4_I\":\"%u\","
+			"\"MAP_8_I\":\"%u\",\"MAP_16_I\":\"%u\","
+			"\"MAP_32_I\":\"%u\",\"ALLOC_1_I\":\"%u\","
+			"\"ALLOC_2_I\":\"%u\",\"ALLOC_4_I\":\"%u\","
+			"\"ALLOC_8_I\":\"%u\",\"ALLOC_16_I\":\"%u\","
+			"\"ALLOC_32_I\":\"%u\"\n",
+			statistics.map_read[0], statistics.map_read[1],
+			statistics.map_read[2], statistics.map_read[3],
+			statistics.map_read[4], statistics.map_read[5],
+			statistics.map_append[0], statistics.map_append[1],
+			statistics.map_append[2], statistics.map_append[3],
+			statistics.map_append[4], statistics.map_append[5]);
+}
+
 static struct kobj_attribute vfat_cl_attr = __ATTR_RO(vfat_cl);
 static struct kobj_attribute exfat_cl_attr = __ATTR_RO(exfat_cl);
 static struct kobj_attribute mount_attr = __ATTR_RO(mount);
 static struct kobj_attribute nofat_op_attr = __ATTR_RO(nofat_op);
 static struct kobj_attribute vol_size_attr = __ATTR_RO(vol_size);
+static struct kobj_attribute map_clus_attr = __ATTR_RO(map_clus);
 
 static struct attribute *attributes_statistics[] = {
 	&vfat_cl_attr.attr,
@@ -140,6 +162,7 @@ static struct attribute *attributes_statistics[] = {
 	&mount_attr.attr,
 	&nofat_op_attr.attr,
 	&vol_size_attr.attr,
+	&map_clus_attr.attr,
 	NULL,
 };
 
@@ -279,3 +302,16 @@ void sdfat_statistics_set_vol_size(struct super_block *sb)
 	else
 		statistics.vol_size[SDFAT_VOL_XTB]++;
 }
+
+/* num_clus : clusters mapped by one get_block, by powers of two
+ * append : the clusters were allocated for an append
+ */
+void sdfat_statistics_set_map(u32 num_clus, s32 append)
+{
+	u32 i = min_t(u32, ilog2(num_clus), SDFAT_MAP_CLUS_MAX - 1);
+
+	if (append)
+		statistics.map_append[i]++;
+	else
+		statistics.map_read[i]++;
+}
@@ -266,7 +266,13 @@ static int do_fsync(unsigned int fd, int datasync)
 		return 0;
 
 	if (f.file) {
-		ret = vfs_fsync(f.file, datasync);
+#ifdef CONFIG_DYNAMIC_FSYNC
+		if (READ_ONCE(dyn_fsync_defer) &&
+		    dyn_fsync_queue(f.file, datasync))
+			ret = 0;
+		else
+#endif
+			ret = vfs_fsync(f.file, datasync);
 		fdput(f);
 		inc_syscfs(current);
 	}
@@ -211,6 +211,9 @@ struct request {
 	struct request_list *rl;		/* rl this rq is alloced from */
 	unsigned long long start_time_ns;
 	unsigned long long io_start_time_ns;    /* when passed to hardware */
+#endif
+#ifdef CONFIG_BLK_DEBUG_FS
+	u64 alloc_time_ns;		/* for the per class latency */
 #endif
 	/* Number of scatter-gather DMA addr+len pairs after
 	 * physical address coalescing is performed.
@@ -627,6 +630,15 @@ struct request_queue {
 
 #define BLK_MAX_WRITE_HINTS	5
 	u64			write_hints[BLK_MAX_WRITE_HINTS];
+
+#ifdef CONFIG_BLK_DEBUG_FS
+	/* blk-mq completion latency by ioprio class and data direction */
+	struct blk_class_lat {
+		atomic64_t	nr;
+		atomic64_t	total_ns;
+		u64		max_ns;
+	} class_lat[IOPRIO_CLASS_IDLE + 1][2];
+#endif
 };
 
 #define QUEUE_FLAG_QUEUED	0	/* uses generic tag queueing */
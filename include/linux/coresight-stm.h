@@ -4,6 +4,7 @@
 #include <asm/local.h>
 #include <linux/stm.h>
 #include <linux/bitmap.h>
+#include <linux/jump_label.h>
 #include <uapi/linux/coresight-stm.h>
 
 #define BYTES_PER_CHANNEL		256
@@ -37,6 +38,17 @@ enum stm_pkt_type {
 #define stm_log(entity_id, data, size)					\
 	stm_log_inv_ts(entity_id, 0, data, size)
 
+/* Marker ids: owner in the upper 16 bits, event of the owner below */
+#define STM_MARKER_ID(owner, ev)	(((owner) << 16) | ((ev) & 0xffff))
+
+enum stm_marker_owner {
+	STM_MARKER_TEST		= 0x0001,
+	STM_MARKER_SCHED	= 0x0002,
+	STM_MARKER_BINDER	= 0x0003,
+	STM_MARKER_KGSL		= 0x0004,
+	STM_MARKER_IPA		= 0x0005,
+};
+
 /**
  * struct channel_space - central management entity for extended ports
  * @base:		memory mapped base address where channels start.
@@ -101,6 +113,25 @@ extern int stm_trace(uint32_t flags, uint8_t entity_id, uint8_t proto_id,
 		     const void *data, uint32_t size);
 
 void stm_send(void *addr, const void *data, u32 size, u8 write_bytes);
+
+DECLARE_STATIC_KEY_FALSE(stm_marker_key);
+extern void __stm_marker(uint32_t id, uint32_t val);
+
+/**
+ * stm_marker - software trace marker over the STM
+ * @id: marker id, see STM_MARKER_ID()
+ * @val: 32 bit argument of the marker
+ *
+ * Costs a patched out branch unless markers are enabled through the
+ * "markers" attribute of the STM, and a single stimulus port write when
+ * they are. The STM timestamps the marker and the channel, one per cpu,
+ * tells where it came from.
+ */
+static __always_inline void stm_marker(uint32_t id, uint32_t val)
+{
+	if (static_branch_unlikely(&stm_marker_key))
+		__stm_marker(id, val);
+}
 #else
 static inline int stm_trace(uint32_t flags, uint8_t entity_id,
 			    uint8_t proto_id, const void *data, uint32_t size)
@@ -109,5 +140,6 @@ static inline int stm_trace(uint32_t flags, uint8_t entity_id,
 }
 static inline void stm_send(void *addr, const void *data, u32 size,
 			    u8 write_bytes) {}
+static inline void stm_marker(uint32_t id, uint32_t val) {}
 #endif
 #endif
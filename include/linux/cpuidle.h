@@ -285,4 +285,13 @@ static inline void cpuidle_set_idle_cpu(unsigned int cpu) { }
 static inline void cpuidle_clear_idle_cpu(unsigned int cpu) { }
 #endif
 
+#if defined(CONFIG_MSM_PM) && !defined(CONFIG_MSM_PM_LEGACY)
+unsigned int lpm_cpu_exit_latency(int cpu);
+#else
+static inline unsigned int lpm_cpu_exit_latency(int cpu)
+{
+	return 0;
+}
+#endif
+
 #endif /* _LINUX_CPUIDLE_H */
@@ -23,11 +23,24 @@
 #define QTI_ICE_MAX_BIST_CHECK_COUNT 100
 #define QTI_ICE_TYPE_NAME_LEN 8
 
+/* Key programming through SCM, updated under the keyslot manager lock */
+struct crypto_qti_key_stats {
+	u64 program_cnt;
+	u64 program_err;
+	u64 program_ns;
+	u64 program_max_ns;
+	u64 invalidate_cnt;
+	u64 invalidate_err;
+	u64 invalidate_ns;
+	u64 invalidate_max_ns;
+};
+
 struct crypto_vops_qti_entry {
 	void __iomem *icemmio_base;
 	uint32_t ice_hw_version;
 	uint8_t ice_dev_type[QTI_ICE_TYPE_NAME_LEN];
 	uint32_t flags;
+	struct crypto_qti_key_stats key_stats;
 };
 
 #if IS_ENABLED(CONFIG_QTI_CRYPTO_COMMON)
@@ -33,6 +33,9 @@ struct dma_fence_array_cb {
 	struct dma_fence_array *array;
 };
 
+/* Fences a merged array keeps without a separate allocation */
+#define DMA_FENCE_ARRAY_INLINE_FENCES 4
+
 /**
  * struct dma_fence_array - fence to represent an array of fences
  * @base: fence base class
@@ -40,6 +43,7 @@ struct dma_fence_array_cb {
  * @num_fences: number of fences in the array
  * @num_pending: fences in the array still pending
  * @fences: array of the fences
+ * @inline_fences: storage of @fences for small merged arrays
  */
 struct dma_fence_array {
 	struct dma_fence base;
@@ -50,6 +54,8 @@ struct dma_fence_array {
 	struct dma_fence **fences;
 
 	struct irq_work work;
+
+	struct dma_fence *inline_fences[DMA_FENCE_ARRAY_INLINE_FENCES];
 };
 
 extern const struct dma_fence_ops dma_fence_array_ops;
@@ -86,6 +92,10 @@ struct dma_fence_array *dma_fence_array_create(int num_fences,
 					       u64 context, unsigned seqno,
 					       bool signal_on_any);
 
+struct dma_fence *dma_fence_array_merge(int num_fences,
+					struct dma_fence **fences,
+					u64 context, unsigned seqno);
+
 bool dma_fence_match_context(struct dma_fence *fence, u64 context);
 
 #endif /* __LINUX_DMA_FENCE_ARRAY_H */
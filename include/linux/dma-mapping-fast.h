@@ -18,6 +18,8 @@
 
 struct dma_iommu_mapping;
 struct io_pgtable_ops;
+struct fast_iova_cache;
+struct dentry;
 
 struct dma_fast_smmu_mapping {
 	struct device		*dev;
@@ -40,6 +42,13 @@ struct dma_fast_smmu_mapping {
 
 	spinlock_t	lock;
 	struct notifier_block notifier;
+
+	struct fast_iova_cache __percpu *iova_cache;
+	u64		tlb_flush_started;
+	u64		tlb_flush_done;
+	unsigned long	stale_wrap_flushes;
+	unsigned long	cache_flushes;
+	struct dentry	*debugfs;
 };
 
 #ifdef CONFIG_IOMMU_IO_PGTABLE_FAST
@@ -6,9 +6,18 @@
  */
 
 #define DYN_FSYNC_ACTIVE_DEFAULT false
+#define DYN_FSYNC_DEFER_DEFAULT false
+#define DYN_FSYNC_WINDOW_MS_DEFAULT 50
+#define DYN_FSYNC_MAX_DIRTY_MS_DEFAULT 1000
+#define DYN_FSYNC_MAX_PENDING 256
 #define DYN_FSYNC_VERSION_MAJOR 2
-#define DYN_FSYNC_VERSION_MINOR 1
+#define DYN_FSYNC_VERSION_MINOR 2
+
+struct file;
 
 extern bool suspend_active;
 extern bool dyn_fsync_active;
+extern bool dyn_fsync_defer;
+
+extern bool dyn_fsync_queue(struct file *file, int datasync);
 
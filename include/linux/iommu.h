@@ -169,6 +169,7 @@ enum iommu_attr {
 	DOMAIN_ATTR_QCOM_MMU500_ERRATA_MIN_IOVA_ALIGN,
 	DOMAIN_ATTR_USE_LLC_NWA,
 	DOMAIN_ATTR_NO_CFRE,
+	DOMAIN_ATTR_DEFER_TLB_FLUSH,
 	DOMAIN_ATTR_MAX,
 };
 
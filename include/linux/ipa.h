@@ -118,12 +118,25 @@ enum ipa_aggr_mode {
  * invoked for on data path
  * @IPA_RECEIVE: data is struct sk_buff
  * @IPA_WRITE_DONE: data is struct sk_buff
+ * @IPA_RECEIVE_LIST: data is struct ipa_rx_list, the client takes all of
+ *  the packets off the list
  */
 enum ipa_dp_evt_type {
 	IPA_RECEIVE,
 	IPA_WRITE_DONE,
 	IPA_CLIENT_START_POLL,
 	IPA_CLIENT_COMP_NAPI,
+	IPA_RECEIVE_LIST,
+};
+
+/**
+ * struct ipa_rx_list - batch of received packets for IPA_RECEIVE_LIST
+ * @skbs: the packets in the order they were received
+ * @napi: NAPI context the batch is handed over from, usable for GRO
+ */
+struct ipa_rx_list {
+	struct sk_buff_head skbs;
+	struct napi_struct *napi;
 };
 
 /**
@@ -683,6 +696,8 @@ struct ipa_ext_intf {
  * @keep_ipa_awake: when true, IPA will not be clock gated
  * @napi_enabled: when true, IPA call client callback to start polling
  * @bypass_agg: when true, IPA bypasses the aggregation
+ * @rx_list: when true, packets received in a NAPI poll are handed to the
+ *  client with one IPA_RECEIVE_LIST event instead of one by one
  */
 struct ipa_sys_connect_params {
 	struct ipa_ep_cfg ipa_ep_cfg;
@@ -696,6 +711,7 @@ struct ipa_sys_connect_params {
 	bool napi_enabled;
 	bool recycle_enabled;
 	bool bypass_agg;
+	bool rx_list;
 };
 
 /**
@@ -0,0 +1,30 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _LINUX_LAUNCH_PREFETCH_H
+#define _LINUX_LAUNCH_PREFETCH_H
+
+#include <linux/jump_label.h>
+#include <linux/types.h>
+
+struct file;
+
+#ifdef CONFIG_LAUNCH_PREFETCH
+DECLARE_STATIC_KEY_FALSE(launch_prefetch_key);
+
+void __launch_prefetch_record(struct file *file, pgoff_t index,
+			      unsigned long nr);
+
+/* @nr pages at @index of @file are used by the current task */
+static inline void launch_prefetch_record(struct file *file, pgoff_t index,
+					  unsigned long nr)
+{
+	if (static_branch_unlikely(&launch_prefetch_key))
+		__launch_prefetch_record(file, index, nr);
+}
+#else
+static inline void launch_prefetch_record(struct file *file, pgoff_t index,
+					  unsigned long nr)
+{
+}
+#endif
+
+#endif /* _LINUX_LAUNCH_PREFETCH_H */
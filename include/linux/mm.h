@@ -2949,9 +2949,26 @@ struct reclaim_param {
 	int nr_to_reclaim;
 	/* pages reclaimed */
 	int nr_reclaimed;
+	/* only mark the pages idle, reclaim nothing */
+	bool mark_idle;
+	/* skip pages accessed since they were marked idle */
+	bool idle_only;
+	/* totals of the mm after this pass */
+	unsigned long mm_reclaimed;
+	unsigned long mm_refaulted;
 };
 extern struct reclaim_param reclaim_task_anon(struct task_struct *task,
-		int nr_to_reclaim);
+		int nr_to_reclaim, unsigned int idle_scans);
+
+static inline void reclaim_note_refault(struct mm_struct *mm)
+{
+	if (atomic_long_read(&mm->reclaim_nr_reclaimed))
+		atomic_long_inc(&mm->reclaim_nr_refaulted);
+}
+#else
+static inline void reclaim_note_refault(struct mm_struct *mm)
+{
+}
 #endif
 
 #endif /* __KERNEL__ */
@@ -371,6 +371,18 @@ struct core_state {
 	struct completion startup;
 };
 
+/*
+ * The last smaps_rollup walk of an mm: the PSS found for each mm counter
+ * (SwapPss for MM_SWAPENTS), and the counters at that time.
+ * /proc/pid/mem_summary scales it to the current counters.
+ */
+struct mm_rollup_snapshot {
+	spinlock_t lock;
+	u64 time_ns;			/* 0 before the first walk */
+	u64 pss[NR_MM_COUNTERS];	/* bytes << PSS_SHIFT */
+	unsigned long rss[NR_MM_COUNTERS];
+};
+
 struct kioctx_table;
 struct mm_struct {
 	struct vm_area_struct *mmap;		/* list of VMAs */
@@ -526,6 +538,17 @@ struct mm_struct {
 #endif
 	struct work_struct async_put_work;
 
+#ifdef CONFIG_PROCESS_RECLAIM
+	/* process reclaim passes since the anon pages were marked idle */
+	unsigned int reclaim_idle_age;
+	/* pages reclaimed by process reclaim, and swap-ins after that */
+	atomic_long_t reclaim_nr_reclaimed;
+	atomic_long_t reclaim_nr_refaulted;
+#endif
+#ifdef CONFIG_PROC_PAGE_MONITOR
+	struct mm_rollup_snapshot rollup_snap;
+#endif
+
 #if IS_ENABLED(CONFIG_HMM)
 	/* HMM needs to track a few things per mm */
 	struct hmm *hmm;
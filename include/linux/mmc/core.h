@@ -205,6 +205,7 @@ struct mmc_cmdq_req;
 extern int mmc_cmdq_discard_queue(struct mmc_host *host, u32 tasks);
 extern int mmc_cmdq_halt(struct mmc_host *host, bool enable);
 extern int mmc_cmdq_halt_on_empty_queue(struct mmc_host *host);
+extern void mmc_cmdq_commit(struct mmc_host *host);
 extern void mmc_cmdq_post_req(struct mmc_host *host, int tag, int err);
 extern int mmc_cmdq_start_req(struct mmc_host *host,
 			      struct mmc_cmdq_req *cmdq_req);
@@ -227,6 +228,10 @@ extern void __mmc_put_card(struct mmc_card *card);
 extern void mmc_blk_init_bkops_statistics(struct mmc_card *card);
 
 extern void mmc_deferred_scaling(struct mmc_host *host);
+extern void mmc_clk_scaling_boost(struct mmc_host *host, bool sync,
+	unsigned int depth);
+extern void mmc_clk_scaling_account_req(struct mmc_host *host,
+	ktime_t start);
 extern void mmc_cmdq_clk_scaling_start_busy(struct mmc_host *host,
 	bool lock_needed);
 extern void mmc_cmdq_clk_scaling_stop_busy(struct mmc_host *host,
@@ -122,6 +122,8 @@ struct mmc_cmdq_host_ops {
 	int (*halt)(struct mmc_host *host, bool halt);
 	void (*reset)(struct mmc_host *host, bool soft);
 	void (*dumpstate)(struct mmc_host *host);
+	/* Ring the doorbell for tasks queued while defer_dbr was set */
+	void (*commit)(struct mmc_host *host);
 	/*
 	 * Update the request queue with keyslot manager details. This keyslot
 	 * manager will be used by block crypto to configure the crypto Engine
@@ -350,6 +352,22 @@ struct mmc_cmdq_context_info {
 	wait_queue_head_t	wait;
 	int active_small_sector_read_reqs;
 	struct rw_semaphore err_rwsem;
+	bool defer_dbr; /* request() only queues the task */
+	u32 max_batch; /* tasks to queue ahead of one doorbell write */
+#define MMC_CMDQ_DEF_MAX_BATCH	8
+};
+
+/*
+ * Time from a task's doorbell write to its completion, kept per slot by
+ * the command queue host driver.
+ */
+#define MMC_CMDQ_STATS_SLOTS	32
+struct mmc_cmdq_slot_stats {
+	ktime_t	start;
+	u64	count;
+	u64	total_us;
+	u64	max_us;
+	u64	batched; /* rung together with other tasks */
 };
 
 /**
@@ -382,6 +400,20 @@ enum dev_state {
 	DEV_RESUMED,
 };
 
+/**
+ * struct mmc_clk_scaling_stats - clock scaling statistics of one frequency
+ * @time_us: time spent at the frequency
+ * @reqs: data requests completed at the frequency
+ * @lat_us: sum of the latencies of @reqs, issue to completion
+ * @max_lat_us: highest latency of @reqs
+ */
+struct mmc_clk_scaling_stats {
+	u64	time_us;
+	u64	reqs;
+	u64	lat_us;
+	u64	max_lat_us;
+};
+
 /**
  * struct mmc_devfeq_clk_scaling - main context for MMC clock scaling logic
  *
@@ -404,6 +436,14 @@ enum dev_state {
  * @is_busy_started: flag indicating if a request is handled by the HW
  * @enable: flag indicating if the clock scaling logic is enabled for this host
  * @is_suspended: to make devfreq request queued when mmc is suspened
+ * @boost: scale up at once on sync requests or a deep queue
+ * @boost_hold_ms: keep the frequency for that long after such a request
+ * @boost_depth: queued requests that make a deep queue
+ * @boost_count: frequency changes done because of @boost
+ * @last_boost: time of the last request that asked for a boost
+ * @freq_stamp: time @curr_freq was last accounted in @stats
+ * @curr_idx: index of @curr_freq in @freq_table
+ * @stats: time and request latency of each frequency of @freq_table
  */
 struct mmc_devfeq_clk_scaling {
 	spinlock_t	lock;
@@ -431,6 +471,14 @@ struct mmc_devfeq_clk_scaling {
 	bool		is_busy_started;
 	bool		enable;
 	bool		is_suspended;
+	bool		boost;
+	unsigned int	boost_hold_ms;
+	unsigned int	boost_depth;
+	unsigned long	boost_count;
+	ktime_t		last_boost;
+	ktime_t		freq_stamp;
+	int		curr_idx;
+	struct mmc_clk_scaling_stats	*stats;
 };
 
 struct mmc_host {
@@ -711,6 +759,7 @@ struct mmc_host {
 	enum dev_state dev_status;
 	bool			wakeup_on_idle;
 	struct mmc_cmdq_context_info	cmdq_ctx;
+	struct mmc_cmdq_slot_stats cmdq_slot_stats[MMC_CMDQ_STATS_SLOTS];
 	int num_cq_slots;
 	int dcmd_cq_slot;
 	bool			cmdq_thist_enabled;
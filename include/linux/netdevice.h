@@ -1387,6 +1387,8 @@ struct net_device_ops {
  *	entity (i.e. the master device for bridged veth)
  * @IFF_MACSEC: device is a MACsec device
  * @IFF_L3MDEV_RX_HANDLER: only invoke the rx handler of L3 master device
+ * @IFF_TX_EDT: device holds back TCP paced skbs until skb->tstamp, their
+ *	earliest departure time in the tcp_clock_ns() time base
  */
 enum netdev_priv_flags {
 	IFF_802_1Q_VLAN			= 1<<0,
@@ -1418,6 +1420,7 @@ enum netdev_priv_flags {
 	IFF_PHONY_HEADROOM		= 1<<26,
 	IFF_MACSEC			= 1<<27,
 	IFF_L3MDEV_RX_HANDLER		= 1<<28,
+	IFF_TX_EDT			= 1<<29,
 };
 
 #define IFF_802_1Q_VLAN			IFF_802_1Q_VLAN
@@ -1448,6 +1451,7 @@ enum netdev_priv_flags {
 #define IFF_RXFH_CONFIGURED		IFF_RXFH_CONFIGURED
 #define IFF_MACSEC			IFF_MACSEC
 #define IFF_L3MDEV_RX_HANDLER		IFF_L3MDEV_RX_HANDLER
+#define IFF_TX_EDT			IFF_TX_EDT
 
 /**
  *	struct net_device - The DEVICE structure.
@@ -49,10 +49,17 @@ struct wake_irq;
  * @relax_count: Number of times the wakeup source was deactivated.
  * @expire_count: Number of times the wakeup source's timeout has expired.
  * @wakeup_count: Number of times the wakeup source might abort suspend.
+ * @pcpu: Events on an already active source, not yet in @event_count and
+ *	  @wakeup_count.
  * @dev: Struct device for sysfs statistics about the wakeup source.
  * @active: Status of the wakeup source.
  * @has_timeout: The wakeup source has been activated with a timeout.
  */
+struct wakeup_source_pcpu {
+	unsigned long		event_count;
+	unsigned long		wakeup_count;
+};
+
 struct wakeup_source {
 	const char 		*name;
 	int			id;
@@ -71,9 +78,14 @@ struct wakeup_source {
 	unsigned long		relax_count;
 	unsigned long		expire_count;
 	unsigned long		wakeup_count;
+	struct wakeup_source_pcpu __percpu *pcpu;
 	struct device		*dev;
 	bool			active:1;
 	bool			autosleep_enabled:1;
+#ifdef CONFIG_BOEFFLA_WL_BLOCKER
+	/* Not a bitfield, it is written under events_lock rather than lock */
+	bool			wl_blocked;
+#endif
 };
 
 #ifdef CONFIG_PM_SLEEP
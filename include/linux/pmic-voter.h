@@ -36,6 +36,8 @@ int get_effective_result_locked(struct votable *votable);
 const char *get_effective_client(struct votable *votable);
 const char *get_effective_client_locked(struct votable *votable);
 int vote(struct votable *votable, const char *client_str, bool state, int val);
+int get_client_handle(struct votable *votable, const char *client_str);
+int vote_handle(struct votable *votable, int handle, bool state, int val);
 int vote_override(struct votable *votable, const char *override_client,
 		  bool state, int val);
 int rerun_election(struct votable *votable);
@@ -157,6 +157,7 @@ struct psi_group {
 	u32 nr_triggers[NR_PSI_STATES - 1];
 	u32 poll_states;
 	u64 poll_min_period;
+	u64 poll_min_window;
 
 	/* Total stall times at the start of monitor activation */
 	u64 polling_total[NR_PSI_STATES - 1];
@@ -826,6 +826,8 @@ struct task_struct {
 #endif
 #ifdef CONFIG_SCHED_TUNE
 	int				stune_idx;
+	/* jiffies of the last move to another boost group */
+	unsigned long			stune_attach_time;
 #endif
 	struct sched_dl_entity		dl;
 
@@ -1328,6 +1330,11 @@ struct task_struct {
 	unsigned long			trace_recursion;
 #endif /* CONFIG_TRACING */
 
+#ifdef CONFIG_LATENCY_HIST
+	/* Wakeup timestamp for the wakeup latency histogram: */
+	u64				lat_hist_wakeup_ts;
+#endif
+
 #ifdef CONFIG_KCOV
 	/* See kernel/kcov.c for more details. */
 
@@ -2024,6 +2031,21 @@ static inline void set_wake_up_idle(bool enabled)
 		current->flags &= ~PF_WAKE_UP_IDLE;
 }
 
+#ifdef CONFIG_SCHED_TUNE
+int schedtune_task_ioprio_class(struct task_struct *p);
+unsigned long schedtune_task_launch_time(struct task_struct *p);
+#else
+static inline int schedtune_task_ioprio_class(struct task_struct *p)
+{
+	return 0;
+}
+
+static inline unsigned long schedtune_task_launch_time(struct task_struct *p)
+{
+	return 0;
+}
+#endif
+
 #ifdef CONFIG_DYNAMIC_STUNE_BOOST
 int do_stune_boost(char *st_name, int boost, int *slot);
 int do_stune_sched_boost(char *st_name, int *slot);
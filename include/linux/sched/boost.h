@@ -0,0 +1,45 @@
+/* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __SCHED_BOOST_H
+#define __SCHED_BOOST_H
+
+#include <linux/sched/core_ctl.h>
+
+#define SCHED_BOOST_PROFILE_MAX_MS	5000
+
+/*
+ * A timed boost: @type takes the sched_boost sysctl values (0 for none),
+ * @freq_min is a cpufreq floor in kHz and @min_cpus a core_ctl floor,
+ * both indexed by cluster in ascending capacity order with 0 meaning no
+ * floor. Everything is dropped again after @duration_ms.
+ */
+struct sched_boost_profile {
+	int type;
+	unsigned int freq_min[MAX_CLUSTERS];
+	unsigned int min_cpus[MAX_CLUSTERS];
+	unsigned int duration_ms;
+};
+
+#ifdef CONFIG_SCHED_WALT
+int sched_boost_profile_start(const struct sched_boost_profile *profile);
+void sched_boost_profile_stop(void);
+#else
+static inline int
+sched_boost_profile_start(const struct sched_boost_profile *profile)
+{
+	return -EINVAL;
+}
+
+static inline void sched_boost_profile_stop(void) {}
+#endif
+#endif
@@ -17,6 +17,13 @@
 #define MAX_CPUS_PER_CLUSTER 6
 #define MAX_CLUSTERS 3
 
+/* Kernel users raising min_cpus, each with its own floor */
+enum core_ctl_min_cpus_client {
+	CORE_CTL_MIN_CPUS_BOOST,
+	CORE_CTL_MIN_CPUS_PERFLOCK,
+	CORE_CTL_MIN_CPUS_CLIENTS,
+};
+
 struct core_ctl_notif_data {
 	unsigned int nr_big;
 	unsigned int coloc_load_pct;
@@ -27,6 +34,7 @@ struct core_ctl_notif_data {
 #ifdef CONFIG_SCHED_CORE_CTL
 void core_ctl_check(u64 wallclock);
 int core_ctl_set_boost(bool boost);
+void core_ctl_set_min_cpus_floor(int client, const unsigned int *min_cpus);
 void core_ctl_notifier_register(struct notifier_block *n);
 void core_ctl_notifier_unregister(struct notifier_block *n);
 #else
@@ -35,6 +43,10 @@ static inline int core_ctl_set_boost(bool boost)
 {
 	return 0;
 }
+static inline void core_ctl_set_min_cpus_floor(int client,
+					       const unsigned int *min_cpus)
+{
+}
 static inline void core_ctl_notifier_register(struct notifier_block *n) {}
 static inline void core_ctl_notifier_unregister(struct notifier_block *n) {}
 #endif
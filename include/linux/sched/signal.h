@@ -219,6 +219,10 @@ struct signal_struct {
 					 * Only settable by CAP_SYS_RESOURCE. */
 	struct mm_struct *oom_mm;	/* recorded mm when the thread group got
 					 * killed by the oom killer */
+#ifdef CONFIG_ANDROID_SIMPLE_LMK
+	struct hlist_node slmk_node;	/* simple_lmk victim index linkage */
+	short slmk_bucket;		/* index bucket + 1, 0 if not indexed */
+#endif
 
 	struct mutex cred_guard_mutex;	/* guard against foreign influences on
 					 * credential calculations
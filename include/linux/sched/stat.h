@@ -38,6 +38,7 @@ static inline unsigned int sched_get_cpu_util(int cpu)
 #ifdef CONFIG_SCHED_WALT
 extern void sched_update_hyst_times(void);
 extern u64 sched_lpm_disallowed_time(int cpu);
+extern unsigned int sched_get_cpu_pred_util(int cpu);
 #else
 static inline void sched_update_hyst_times(void)
 {
@@ -46,6 +47,10 @@ static inline u64 sched_lpm_disallowed_time(int cpu)
 {
 	return 0;
 }
+static inline unsigned int sched_get_cpu_pred_util(int cpu)
+{
+	return 0;
+}
 #endif
 
 static inline int sched_info_on(void)
@@ -6,13 +6,27 @@
 #define _SIMPLE_LMK_H_
 
 struct mm_struct;
+struct signal_struct;
+struct task_struct;
 
 #ifdef CONFIG_ANDROID_SIMPLE_LMK
 void simple_lmk_mm_freed(struct mm_struct *mm);
+void simple_lmk_adj_changed(struct signal_struct *sig);
+void simple_lmk_task_fork(struct task_struct *p);
+void simple_lmk_signal_exit(struct signal_struct *sig);
 #else
 static inline void simple_lmk_mm_freed(struct mm_struct *mm)
 {
 }
+static inline void simple_lmk_adj_changed(struct signal_struct *sig)
+{
+}
+static inline void simple_lmk_task_fork(struct task_struct *p)
+{
+}
+static inline void simple_lmk_signal_exit(struct signal_struct *sig)
+{
+}
 #endif
 
 #endif /* _SIMPLE_LMK_H_ */
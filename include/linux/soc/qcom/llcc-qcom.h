@@ -95,6 +95,26 @@ int llcc_slice_activate(struct llcc_slice_desc *desc);
  */
 int llcc_slice_deactivate(struct llcc_slice_desc *desc);
 
+/**
+ * llcc_slice_is_active - whether the client activated the llcc slice
+ * @desc: Pointer to llcc slice descriptor
+ */
+bool llcc_slice_is_active(struct llcc_slice_desc *desc);
+
+/**
+ * llcc_slice_park - power an activated llcc slice down or up again
+ * @desc: Pointer to llcc slice descriptor
+ * @park: true to power the slice down
+ */
+int llcc_slice_park(struct llcc_slice_desc *desc, bool park);
+
+/**
+ * llcc_slice_resize - change the capacity of the llcc slice
+ * @desc: Pointer to llcc slice descriptor
+ * @size: New capacity in KB
+ */
+int llcc_slice_resize(struct llcc_slice_desc *desc, size_t size);
+
 /**
  * qcom_llcc_probe - program the sct table
  * @pdev: platform device pointer
@@ -137,6 +157,22 @@ static inline int llcc_slice_deactivate(struct llcc_slice_desc *desc)
 {
 	return -EINVAL;
 }
+
+static inline bool llcc_slice_is_active(struct llcc_slice_desc *desc)
+{
+	return false;
+}
+
+static inline int llcc_slice_park(struct llcc_slice_desc *desc, bool park)
+{
+	return -EINVAL;
+}
+
+static inline int llcc_slice_resize(struct llcc_slice_desc *desc,
+				    size_t size)
+{
+	return -EINVAL;
+}
 static inline int qcom_llcc_probe(struct platform_device *pdev,
 		      const struct llcc_slice_config *table, u32 sz)
 {
@@ -74,6 +74,8 @@ enum qmi_array_type {
  *		element in the data structure.
  * @ei_array:	Null-terminated array of @qmi_elem_info to describe nested
  *		structures.
+ * @plan:	Encode/decode plan compiled on first use, only set in the
+ *		first element of an array. Private to qmi_encdec.
  */
 struct qmi_elem_info {
 	enum qmi_elem_type data_type;
@@ -83,6 +85,9 @@ struct qmi_elem_info {
 	u8 tlv_type;
 	u32 offset;
 	struct qmi_elem_info *ei_array;
+#ifdef CONFIG_QCOM_QMI_ENCDEC_PLAN
+	void *plan;
+#endif
 };
 
 #define QMI_RESULT_SUCCESS_V01			0
@@ -175,6 +175,7 @@ struct thermal_cooling_device {
 	struct list_head node;
 	unsigned long sysfs_cur_state_req;
 	unsigned long sysfs_min_state_req;
+	void *stats;	/* time in each state, CONFIG_THERMAL_STATISTICS */
 };
 
 struct thermal_attr {
@@ -0,0 +1,63 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _NET_PAGE_POOL_H
+#define _NET_PAGE_POOL_H
+
+#include <linux/dma-direction.h>
+#include <linux/list.h>
+#include <linux/mm.h>
+#include <linux/types.h>
+
+/*
+ * Page pool for driver RX buffers.
+ *
+ * Every page of a pool stays DMA mapped and holds one reference of the
+ * pool. page_pool_alloc_pages() hands a page out with a second reference,
+ * which the driver passes on to the skb (skb_add_rx_frag() and friends).
+ * Once the stack frees the skb, on whichever cpu, the page is back to the
+ * pool reference only and the next allocation of its cpu reuses it without
+ * the page allocator or a new mapping.
+ *
+ * Allocations must not come from hard irq context.
+ */
+
+struct device;
+struct page_pool_cpu;
+
+struct page_pool_params {
+	const char		*name;
+	struct device		*dev;	/* no DMA mapping when NULL */
+	enum dma_data_direction	dma_dir;
+	unsigned int		order;
+	unsigned int		pool_size;	/* pages kept per cpu */
+	int			nid;
+};
+
+struct page_pool {
+	struct page_pool_params		p;
+	struct page_pool_cpu __percpu	*cpu;
+	struct list_head		list;
+};
+
+struct page_pool *page_pool_create(const struct page_pool_params *params);
+void page_pool_destroy(struct page_pool *pool);
+struct page *page_pool_alloc_pages(struct page_pool *pool, gfp_t gfp);
+
+static inline struct page *page_pool_dev_alloc_pages(struct page_pool *pool)
+{
+	return page_pool_alloc_pages(pool, GFP_ATOMIC | __GFP_NOWARN);
+}
+
+/* DMA address of a page of @pool, valid while the pool holds it */
+static inline dma_addr_t page_pool_get_dma_addr(struct page *page)
+{
+	return (dma_addr_t)page_private(page);
+}
+
+/* Give back a page the driver did not pass on to the stack */
+static inline void page_pool_put_page(struct page_pool *pool,
+				      struct page *page)
+{
+	put_page(page);
+}
+
+#endif /* _NET_PAGE_POOL_H */
@@ -38,16 +38,26 @@ static inline unsigned long long int msm_timer_get_sclk_ticks(void)
 static inline phys_addr_t msm_timer_get_pa(void) { return 0; }
 #endif
 
+struct device;
+struct device_driver;
+
 #ifdef CONFIG_MSM_BOOT_TIME_MARKER
 static inline int boot_marker_enabled(void) { return 1; }
 void place_marker(const char *name);
 void update_marker(const char *name);
 void measure_wake_up_time(void);
+void boot_timing_initcall(void *fn, u64 start_ns, int ret);
+void boot_timing_probe(struct device *dev, struct device_driver *drv,
+		u64 start_ns, int ret);
 #else
 static inline void place_marker(char *name) { };
 static inline void update_marker(const char *name) { };
 static inline int boot_marker_enabled(void) { return 0; }
 static inline void measure_wake_up_time(void) { };
+static inline void boot_timing_initcall(void *fn, u64 start_ns,
+		int ret) { };
+static inline void boot_timing_probe(struct device *dev,
+		struct device_driver *drv, u64 start_ns, int ret) { };
 #endif
 #ifdef CONFIG_QTI_RPM_STATS_LOG
 uint64_t get_sleep_exit_time(void);
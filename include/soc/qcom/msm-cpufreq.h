@@ -0,0 +1,37 @@
+/* Copyright (c) 2020, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __SOC_QCOM_MSM_CPUFREQ_H
+#define __SOC_QCOM_MSM_CPUFREQ_H
+
+/*
+ * A cpu clock provider whose rate change does not sleep can hand the
+ * msm cpufreq driver a set_rate callback for the cpu. The callback is
+ * called with interrupts disabled and must not go through the clock
+ * framework. It gets a rate in Hz taken from the cpu's frequency table.
+ */
+typedef int (*msm_cpufreq_fast_set_rate_t)(void *data, unsigned long rate);
+
+#ifdef CONFIG_CPU_FREQ_MSM
+int msm_cpufreq_register_fast_switch(int cpu,
+				     msm_cpufreq_fast_set_rate_t set_rate,
+				     void *data);
+#else
+static inline int msm_cpufreq_register_fast_switch(int cpu,
+				msm_cpufreq_fast_set_rate_t set_rate,
+				void *data)
+{
+	return -ENODEV;
+}
+#endif
+
+#endif /* __SOC_QCOM_MSM_CPUFREQ_H */
@@ -16,6 +16,8 @@
 #define __QCOM_SECURE_BUFFER_H__
 
 #include <linux/scatterlist.h>
+#include <linux/completion.h>
+#include <linux/workqueue.h>
 
 /*
  * if you add a secure VMID here make sure you update
@@ -53,6 +55,19 @@ enum vmid {
 #define PERM_WRITE                      0x2
 #define PERM_EXEC			0x1
 
+/* Request of hyp_assign_table_async(), owned by the caller */
+struct hyp_assign_async {
+	struct work_struct work;
+	struct completion done;
+	struct sg_table *table;
+	u32 *source_vm_list;
+	int source_nelems;
+	int *dest_vmids;
+	int *dest_perms;
+	int dest_nelems;
+	int ret;
+};
+
 #ifdef CONFIG_QCOM_SECURE_BUFFER
 int msm_secure_table(struct sg_table *table);
 int msm_unsecure_table(struct sg_table *table);
@@ -66,6 +81,13 @@ int try_hyp_assign_table(struct sg_table *table,
 			 int *dest_vmids, int *dest_perms,
 			 int dest_nelems);
 
+int hyp_assign_table_async(struct hyp_assign_async *req,
+			struct sg_table *table,
+			u32 *source_vm_list, int source_nelems,
+			int *dest_vmids, int *dest_perms,
+			int dest_nelems);
+int hyp_assign_wait(struct hyp_assign_async *req);
+
 extern int hyp_assign_phys(phys_addr_t addr, u64 size,
 			u32 *source_vmlist, int source_nelems,
 			int *dest_vmids, int *dest_perms, int dest_nelems);
@@ -104,6 +126,20 @@ static inline int try_hyp_assign_table(struct sg_table *table,
 	return -EINVAL;
 }
 
+static inline int hyp_assign_table_async(struct hyp_assign_async *req,
+			struct sg_table *table,
+			u32 *source_vm_list, int source_nelems,
+			int *dest_vmids, int *dest_perms,
+			int dest_nelems)
+{
+	return -EINVAL;
+}
+
+static inline int hyp_assign_wait(struct hyp_assign_async *req)
+{
+	return -EINVAL;
+}
+
 static inline int hyp_assign_phys(phys_addr_t addr, u64 size,
 			u32 *source_vmlist, int source_nelems,
 			int *dest_vmids, int *dest_perms, int dest_nelems)
@@ -50,6 +50,9 @@ enum early_subsys_notif_type {
  */
 void *subsys_notif_register_notifier(
 			const char *subsys_name, struct notifier_block *nb);
+/* Same, for a notifier that may run in parallel with the others in fast SSR */
+void *subsys_notif_register_independent_notifier(
+			const char *subsys_name, struct notifier_block *nb);
 int subsys_notif_unregister_notifier(void *subsys_handle,
 				struct notifier_block *nb);
 
@@ -62,6 +65,9 @@ void *subsys_notif_add_subsys(const char *subsys_name);
 int subsys_notif_queue_notification(void *subsys_handle,
 					enum subsys_notif_type notif_type,
 					void *data);
+int subsys_notif_queue_notification_parallel(void *subsys_handle,
+					enum subsys_notif_type notif_type,
+					void *data, bool parallel);
 void *subsys_get_early_notif_info(const char *subsys_name);
 int subsys_register_early_notifier(const char *subsys_name,
 				   enum early_subsys_notif_type notif_type,
@@ -78,6 +84,12 @@ static inline void *subsys_notif_register_notifier(
 	return NULL;
 }
 
+static inline void *subsys_notif_register_independent_notifier(
+			const char *subsys_name, struct notifier_block *nb)
+{
+	return NULL;
+}
+
 static inline int subsys_notif_unregister_notifier(void *subsys_handle,
 					struct notifier_block *nb)
 {
@@ -96,6 +108,14 @@ static inline int subsys_notif_queue_notification(void *subsys_handle,
 	return 0;
 }
 
+static inline int subsys_notif_queue_notification_parallel(
+					void *subsys_handle,
+					enum subsys_notif_type notif_type,
+					void *data, bool parallel)
+{
+	return 0;
+}
+
 static inline void *subsys_get_early_notif_info(const char *subsys_name)
 {
 	return NULL;
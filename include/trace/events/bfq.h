@@ -0,0 +1,78 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM bfq
+
+#if !defined(_TRACE_BFQ_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_BFQ_H
+
+#include <linux/tracepoint.h>
+#include <linux/types.h>
+
+/* Weight raising of a queue switching to busy, started or carried on */
+TRACE_EVENT(bfq_wr_raise,
+
+	TP_PROTO(const char *dev, pid_t pid, unsigned int old_coeff,
+		 unsigned int coeff, unsigned int max_time_ms, bool launch,
+		 bool interactive, bool soft_rt),
+
+	TP_ARGS(dev, pid, old_coeff, coeff, max_time_ms, launch, interactive,
+		soft_rt),
+
+	TP_STRUCT__entry(
+		__string(dev, dev)
+		__field(pid_t, pid)
+		__field(unsigned int, old_coeff)
+		__field(unsigned int, coeff)
+		__field(unsigned int, max_time_ms)
+		__field(bool, launch)
+		__field(bool, interactive)
+		__field(bool, soft_rt)
+	),
+
+	TP_fast_assign(
+		__assign_str(dev, dev);
+		__entry->pid		= pid;
+		__entry->old_coeff	= old_coeff;
+		__entry->coeff		= coeff;
+		__entry->max_time_ms	= max_time_ms;
+		__entry->launch		= launch;
+		__entry->interactive	= interactive;
+		__entry->soft_rt	= soft_rt;
+	),
+
+	TP_printk("dev=%s pid=%d coeff=%u->%u max_time=%ums launch=%d interactive=%d soft_rt=%d",
+		  __get_str(dev), __entry->pid, __entry->old_coeff,
+		  __entry->coeff, __entry->max_time_ms, __entry->launch,
+		  __entry->interactive, __entry->soft_rt)
+);
+
+TRACE_EVENT(bfq_wr_end,
+
+	TP_PROTO(const char *dev, pid_t pid, unsigned int coeff,
+		 unsigned int duration_ms),
+
+	TP_ARGS(dev, pid, coeff, duration_ms),
+
+	TP_STRUCT__entry(
+		__string(dev, dev)
+		__field(pid_t, pid)
+		__field(unsigned int, coeff)
+		__field(unsigned int, duration_ms)
+	),
+
+	TP_fast_assign(
+		__assign_str(dev, dev);
+		__entry->pid		= pid;
+		__entry->coeff		= coeff;
+		__entry->duration_ms	= duration_ms;
+	),
+
+	TP_printk("dev=%s pid=%d coeff=%u duration=%ums",
+		  __get_str(dev), __entry->pid, __entry->coeff,
+		  __entry->duration_ms)
+);
+
+#endif /* _TRACE_BFQ_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
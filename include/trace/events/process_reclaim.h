@@ -59,6 +59,34 @@ TRACE_EVENT(process_reclaim,
 			__entry->nr_to_reclaim)
 );
 
+TRACE_EVENT(process_reclaim_task,
+
+	TP_PROTO(struct task_struct *task, bool mark_idle,
+		unsigned long reclaimed, unsigned long refaulted),
+
+	TP_ARGS(task, mark_idle, reclaimed, refaulted),
+
+	TP_STRUCT__entry(
+		__array(char, comm, TASK_COMM_LEN)
+		__field(pid_t, pid)
+		__field(bool, mark_idle)
+		__field(unsigned long, reclaimed)
+		__field(unsigned long, refaulted)
+	),
+
+	TP_fast_assign(
+		memcpy(__entry->comm, task->comm, TASK_COMM_LEN);
+		__entry->pid		= task->pid;
+		__entry->mark_idle	= mark_idle;
+		__entry->reclaimed	= reclaimed;
+		__entry->refaulted	= refaulted;
+	),
+
+	TP_printk("%s %d, %d, %lu, %lu",
+			__entry->comm, __entry->pid, __entry->mark_idle,
+			__entry->reclaimed, __entry->refaulted)
+);
+
 TRACE_EVENT(process_reclaim_eff,
 
 	TP_PROTO(int efficiency, int reclaim_avg_efficiency),
@@ -1053,6 +1053,28 @@ TRACE_EVENT(core_ctl_eval_need,
 		  __entry->old_need, __entry->new_need, __entry->updated)
 );
 
+TRACE_EVENT(core_ctl_pred_need,
+
+	TP_PROTO(unsigned int cpu, unsigned int last_pred_need,
+		 unsigned int need, unsigned int pred_need),
+	TP_ARGS(cpu, last_pred_need, need, pred_need),
+	TP_STRUCT__entry(
+		__field(u32, cpu)
+		__field(u32, last_pred_need)
+		__field(u32, need)
+		__field(u32, pred_need)
+	),
+	TP_fast_assign(
+		__entry->cpu = cpu;
+		__entry->last_pred_need = last_pred_need;
+		__entry->need = need;
+		__entry->pred_need = pred_need;
+	),
+	TP_printk("cpu=%u, last_pred_need=%u, need=%u, pred_need=%u",
+		  __entry->cpu, __entry->last_pred_need, __entry->need,
+		  __entry->pred_need)
+);
+
 TRACE_EVENT(core_ctl_set_busy,
 
 	TP_PROTO(unsigned int cpu, unsigned int busy,
@@ -1320,6 +1342,38 @@ TRACE_EVENT(sched_find_best_target,
 		__entry->backup_cpu)
 );
 
+/*
+ * Tracepoint for the idle CPU picked for a prefer_shallow task, with the
+ * exit latency it costs and the worst one among the idle candidates.
+ */
+TRACE_EVENT(sched_shallow_idle_cpu,
+
+	TP_PROTO(struct task_struct *tsk, int cpu, unsigned int exit_lat,
+		 unsigned int max_exit_lat),
+
+	TP_ARGS(tsk, cpu, exit_lat, max_exit_lat),
+
+	TP_STRUCT__entry(
+		__array( char,	comm,	TASK_COMM_LEN	)
+		__field( pid_t,	pid			)
+		__field( int,	cpu			)
+		__field( unsigned int,	exit_lat	)
+		__field( unsigned int,	max_exit_lat	)
+	),
+
+	TP_fast_assign(
+		memcpy(__entry->comm, tsk->comm, TASK_COMM_LEN);
+		__entry->pid		= tsk->pid;
+		__entry->cpu		= cpu;
+		__entry->exit_lat	= exit_lat;
+		__entry->max_exit_lat	= max_exit_lat;
+	),
+
+	TP_printk("pid=%d comm=%s cpu=%d exit_lat=%u max_exit_lat=%u",
+		__entry->pid, __entry->comm, __entry->cpu,
+		__entry->exit_lat, __entry->max_exit_lat)
+);
+
 /*
  * Tracepoint for tasks' estimated utilization.
  */
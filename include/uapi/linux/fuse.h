@@ -116,6 +116,8 @@
  *
  *  7.27
  *  - add FUSE_ABORT_ERROR
+ *  - add FUSE_PASSTHROUGH, passthrough_fh in fuse_open_out and
+ *    FUSE_DEV_IOC_PASSTHROUGH_OPEN
  */
 
 #ifndef _LINUX_FUSE_H
@@ -251,6 +253,7 @@ struct fuse_file_lock {
  * FUSE_HANDLE_KILLPRIV: fs handles killing suid/sgid/cap on write/chown/trunc
  * FUSE_POSIX_ACL: filesystem supports posix acls
  * FUSE_ABORT_ERROR: reading the device after abort returns ECONNABORTED
+ * FUSE_PASSTHROUGH: read/write and mmap of opened files go to a lower file
  */
 #define FUSE_ASYNC_READ		(1 << 0)
 #define FUSE_POSIX_LOCKS	(1 << 1)
@@ -274,6 +277,7 @@ struct fuse_file_lock {
 #define FUSE_HANDLE_KILLPRIV	(1 << 19)
 #define FUSE_POSIX_ACL		(1 << 20)
 #define FUSE_ABORT_ERROR	(1 << 21)
+#define FUSE_PASSTHROUGH	(1 << 31)
 
 /**
  * CUSE INIT request/reply flags
@@ -506,7 +510,7 @@ struct fuse_create_in {
 struct fuse_open_out {
 	uint64_t	fh;
 	uint32_t	open_flags;
-	uint32_t	padding;
+	uint32_t	passthrough_fh;
 };
 
 struct fuse_release_in {
@@ -784,6 +788,16 @@ struct fuse_notify_retrieve_in {
 /* Device ioctls: */
 #define FUSE_DEV_IOC_CLONE	_IOR(229, 0, uint32_t)
 
+/* Only fd is read, the rest is reserved */
+struct fuse_passthrough_out {
+	uint32_t	fd;
+	uint32_t	len;
+	void		*vec;
+};
+
+#define FUSE_DEV_IOC_PASSTHROUGH_OPEN \
+	_IOW(229, 1, struct fuse_passthrough_out)
+
 struct fuse_lseek_in {
 	uint64_t	fh;
 	uint64_t	offset;
@@ -41,6 +41,19 @@ struct hgsl_fhi_issud_cmds {
 	uint64_t bos;
 };
 
+/*
+ * @cmds: array of @num_cmds struct hgsl_fhi_issud_cmds, all written to the
+ * doorbell queue before it is rung
+ * @num_issued: number of commands in the queue when the ioctl returns
+ */
+struct hgsl_fhi_issue_batch {
+	uint64_t cmds;
+	uint32_t num_cmds;
+	uint32_t num_issued;
+};
+
+#define HGSL_ISSUE_BATCH_MAX	32
+
 struct hgsl_db_queue_inf {
 	int32_t  fd;
 	uint32_t head_dwords;
@@ -50,6 +63,11 @@ struct hgsl_db_queue_inf {
 	uint32_t db_signal;
 };
 
+/*
+ * mmap() of the hgsl fd at offset context_id * page size maps the shadow
+ * buffer of a context created by the caller, read only, so that the
+ * retired timestamp can be polled without a syscall.
+ */
 struct hgsl_ctxt_create_info {
 	uint32_t context_id;
 	int32_t  shadow_fd;
@@ -77,6 +95,8 @@ struct hgsl_dbq_release_info {
 #define HGSL_IOCTL_DBQ_ASSIGN	HGSL_IORW(0x03, uint32_t)
 #define HGSL_IOCTL_DBQ_RELEASE	HGSL_IORW(0x04, uint32_t)
 #define HGSL_IOCTL_ISSUE_CMDS	HGSL_IORW(0x05, struct hgsl_fhi_issud_cmds)
+#define HGSL_IOCTL_ISSUE_CMDS_BATCH \
+				HGSL_IORW(0x06, struct hgsl_fhi_issue_batch)
 #define HGSL_IOCTL_CTXT_CREATE	HGSL_IOW(0x10,  struct hgsl_ctxt_create_info)
 #define HGSL_IOCTL_CTXT_DESTROY	HGSL_IOW(0x11,  uint32_t)
 #define HGSL_IOCTL_WAIT_TIMESTAMP \
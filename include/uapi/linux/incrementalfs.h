@@ -124,6 +124,33 @@ struct incfs_pending_read_info {
 	__u32 serial_number;
 };
 
+/*
+ * Description of a pending read as reported by .pending_reads when the
+ * filesystem is mounted with read_window > 0.
+ */
+struct incfs_pending_read_info2 {
+	/* Id of a file that is being read from. */
+	incfs_uuid_t file_id;
+
+	/* A number of microseconds since system boot to the read. */
+	__aligned_u64 timestamp_us;
+
+	/* Index of a file block that is being read. */
+	__u32 block_index;
+
+	/* A serial number of this pending read. */
+	__u32 serial_number;
+
+	/*
+	 * Number of consecutive missing blocks starting at block_index, at
+	 * most read_window. The ones after block_index are likely to be read
+	 * next and are worth fetching together with it.
+	 */
+	__u32 block_count;
+
+	__u32 reserved;
+};
+
 /*
  * Description of a data or hash block to add to a data file.
  */
@@ -223,6 +223,37 @@ struct input_mask {
 
 #define EVIOCSCLOCKID		_IOW('E', 0xa0, int)			/* Set clockid to be used for timestamps */
 
+/**
+ * struct input_mmap_ring - shared event ring of an evdev client
+ * @size: number of events in @events, a power of two
+ * @head: end of the last complete frame, written by the kernel
+ * @tail: first event not yet consumed, written by the reader
+ * @seq: number of frames published so far
+ * @overruns: number of frames dropped because the ring was full
+ * @events: the events, at index (position & (@size - 1))
+ *
+ * EVIOCSRING switches a client from read() to this ring, which is then
+ * mapped with mmap() at offset 0. @head and @tail are free running: the
+ * events from @tail up to @head are whole frames, each ending with
+ * SYN_REPORT. The kernel only advances @head once a frame is complete, so
+ * the reader should load it with acquire semantics and store @tail with
+ * release semantics after it is done with the events. A frame that does
+ * not fit in the free space is dropped as a whole and counted in
+ * @overruns. Only available to native (not compat) callers.
+ */
+struct input_mmap_ring {
+	__u32 size;
+	__u32 head;
+	__u32 tail;
+	__u32 seq;
+	__u32 overruns;
+	__u32 reserved[11];
+	struct input_event events[];
+};
+
+#define EVIOCSRING		_IOW('E', 0xa1, unsigned int)		/* Ring of given number of events */
+#define EVIOCGOVERRUNS		_IOR('E', 0xa2, unsigned int)		/* Get number of dropped frames */
+
 /*
  * IDs.
  */
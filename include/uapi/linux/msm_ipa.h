@@ -2755,6 +2755,67 @@ struct ipa_ioc_flt_rt_query {
 	uintptr_t stats;
 };
 
+#define IPA_HW_STATS_SHM_VERSION 1
+#define IPA_HW_STATS_SHM_MAX_TETH 32
+
+/**
+ * struct ipa_hw_stats_shm_pipe - per client pipe counters
+ * @num_ipv4_bytes: quota stats, IPv4 bytes
+ * @num_ipv6_bytes: quota stats, IPv6 bytes
+ * @num_ipv4_pkts: quota stats, IPv4 packets
+ * @num_ipv6_pkts: quota stats, IPv6 packets
+ * @drop_packet_cnt: drop stats, packets
+ * @drop_byte_cnt: drop stats, bytes
+ */
+struct ipa_hw_stats_shm_pipe {
+	uint64_t num_ipv4_bytes;
+	uint64_t num_ipv6_bytes;
+	uint32_t num_ipv4_pkts;
+	uint32_t num_ipv6_pkts;
+	uint32_t drop_packet_cnt;
+	uint32_t drop_byte_cnt;
+};
+
+/**
+ * struct ipa_hw_stats_shm_teth - accumulated tethering stats of a pair
+ * @prod: producer client, enum ipa_client_type
+ * @cons: consumer client, enum ipa_client_type
+ * @stats: the counters, drop fields unused
+ */
+struct ipa_hw_stats_shm_teth {
+	uint32_t prod;
+	uint32_t cons;
+	struct ipa_hw_stats_shm_pipe stats;
+};
+
+/**
+ * struct ipa_hw_stats_shm - HW stats the driver refreshes periodically in
+ * memory that is mapped read-only by mmap() of the ipa device
+ * @version: IPA_HW_STATS_SHM_VERSION
+ * @seq: odd while an update is in progress, re-read if it changed or was
+ *	odd while reading
+ * @update_time_ns: CLOCK_BOOTTIME of the last update
+ * @period_ms: update period
+ * @num_pipes: valid entries of @pipe, indexed by enum ipa_client_type
+ * @num_teth: valid entries of @teth
+ * @num_flt_rt: valid entries of @flt_rt, indexed by counter id - 1
+ * @pipe: per client pipe counters
+ * @teth: tethering counters of the monitored producer/consumer pairs
+ * @flt_rt: filter and route rule counters
+ */
+struct ipa_hw_stats_shm {
+	uint32_t version;
+	uint32_t seq;
+	uint64_t update_time_ns;
+	uint32_t period_ms;
+	uint32_t num_pipes;
+	uint32_t num_teth;
+	uint32_t num_flt_rt;
+	struct ipa_hw_stats_shm_pipe pipe[IPA_CLIENT_MAX];
+	struct ipa_hw_stats_shm_teth teth[IPA_HW_STATS_SHM_MAX_TETH];
+	struct ipa_flt_rt_stats flt_rt[IPA_MAX_FLT_RT_CNT_INDEX];
+};
+
 enum ipacm_client_enum {
 	IPACM_CLIENT_USB = 1,
 	IPACM_CLIENT_WLAN,
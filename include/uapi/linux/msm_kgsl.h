@@ -113,6 +113,8 @@
 /* Flags for GPU command memory objects */
 #define KGSL_OBJLIST_MEMOBJ  0x00000008U
 #define KGSL_OBJLIST_PROFILE 0x00000010U
+/* Frame deadline hint, size is the deadline in microseconds from submission */
+#define KGSL_OBJLIST_DEADLINE 0x00000020U
 
 /* Flags for GPU command sync points */
 #define KGSL_CMD_SYNCPOINT_TYPE_TIMESTAMP 0
@@ -339,6 +341,7 @@ enum kgsl_timestamp_type {
 #define KGSL_PROP_GAMING_BIN		0x26
 #define KGSL_PROP_CONTEXT_PROPERTY	0x28
 #define KGSL_PROP_MACROTILING_CHANNELS	0x29
+#define KGSL_PROP_CONTEXT_SCHED		0x2A
 
 
 struct kgsl_shadowprop {
@@ -395,6 +398,21 @@ struct kgsl_context_property_fault {
 /* Context property sub types */
 #define KGSL_CONTEXT_PROP_FAULTS 1
 
+/*
+ * struct kgsl_context_sched - Scheduling hints for a context
+ * @context_id: Context to update
+ * @weight: Share of the GPU relative to other contexts of the same priority,
+ * 1024 is the default
+ * @deadline_us: Default frame deadline in microseconds from submission for
+ * commands that don't carry a KGSL_OBJLIST_DEADLINE hint, 0 for none
+ */
+struct kgsl_context_sched {
+	__u32 context_id;
+	__u32 weight;
+	__u32 deadline_us;
+	__u32 __pad;
+};
+
 /* Performance counter groups */
 
 #define KGSL_PERFCOUNTER_GROUP_CP 0x0
@@ -0,0 +1,37 @@
+#ifndef _UAPI_MSM_PERFORMANCE_H
+#define _UAPI_MSM_PERFORMANCE_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+#define MSM_PERF_MAX_CLUSTERS	3
+
+/*
+ * struct msm_perf_lock - resources held together by one perf lock
+ * @freq_min: cpufreq floor per cluster in kHz, 0 for none
+ * @freq_max: cpufreq cap per cluster in kHz, 0 for none
+ * @min_cpus: core_ctl min_cpus floor per cluster, 0 for none
+ * @sched_boost: sched_boost type to hold, 0 for none
+ * @timeout_ms: release after this long, 0 to hold until released
+ * @handle: filled in by MSM_PERF_IOC_ACQUIRE
+ *
+ * Clusters are indexed in ascending capacity order. Locks held at the
+ * same time are combined: the highest floor and the lowest cap win.
+ * Closing the file releases every lock acquired through it.
+ */
+struct msm_perf_lock {
+	__u32 freq_min[MSM_PERF_MAX_CLUSTERS];
+	__u32 freq_max[MSM_PERF_MAX_CLUSTERS];
+	__u32 min_cpus[MSM_PERF_MAX_CLUSTERS];
+	__u32 sched_boost;
+	__u32 timeout_ms;
+	__s32 handle;
+};
+
+#define MSM_PERF_IOC_MAGIC	0xB7
+
+#define MSM_PERF_IOC_ACQUIRE	_IOWR(MSM_PERF_IOC_MAGIC, 1, \
+				      struct msm_perf_lock)
+#define MSM_PERF_IOC_RELEASE	_IOW(MSM_PERF_IOC_MAGIC, 2, __s32)
+
+#endif /* _UAPI_MSM_PERFORMANCE_H */
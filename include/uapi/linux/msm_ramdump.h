@@ -0,0 +1,25 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+#ifndef _UAPI_MSM_RAMDUMP_H_
+#define _UAPI_MSM_RAMDUMP_H_
+
+#include <linux/types.h>
+
+/*
+ * With the compress parameter of the ramdump driver set, a read of a
+ * ramdump device returns a stream of chunks instead of the raw dump. Each
+ * chunk is a struct ramdump_chunk_hdr followed by @len bytes, which hold
+ * the @raw_len bytes of the dump at @offset. The bytes are lz4 compressed
+ * unless RAMDUMP_CHUNK_RAW is set in @flags.
+ */
+#define RAMDUMP_CHUNK_MAGIC	0x4b484352	/* "RCHK" */
+#define RAMDUMP_CHUNK_RAW	(1 << 0)
+
+struct ramdump_chunk_hdr {
+	__u32 magic;
+	__u32 flags;
+	__u64 offset;
+	__u32 raw_len;
+	__u32 len;
+};
+
+#endif /* _UAPI_MSM_RAMDUMP_H_ */
@@ -0,0 +1,67 @@
+#ifndef _UAPI_SCHED_LOAD_TELEMETRY_H
+#define _UAPI_SCHED_LOAD_TELEMETRY_H
+
+#include <linux/types.h>
+
+#define SCHED_TELEMETRY_MAX_CPUS	8
+#define SCHED_TELEMETRY_MAX_CLUSTERS	3
+
+/*
+ * struct sched_telemetry_cpu - load of one cpu over the last window
+ * @nr_scaled: average nr_running * 100
+ * @nr_max: highest nr_running seen
+ * @nr_misfit: rounded average number of tasks too big for the cpu
+ * @util_pct: WALT busy time in % of the cpu's capacity
+ * @busy: core_ctl counts the cpu as busy
+ * @isolated: the cpu is isolated by core_ctl
+ */
+struct sched_telemetry_cpu {
+	__u32 nr_scaled;
+	__u32 nr_max;
+	__u32 nr_misfit;
+	__u32 util_pct;
+	__u8 busy;
+	__u8 isolated;
+	__u8 pad[2];
+};
+
+/*
+ * struct sched_telemetry_cluster - core_ctl state of one cluster
+ * @first_cpu: lowest cpu of the cluster
+ * @active_cpus: cpus neither offline nor isolated
+ * @need_cpus: cpus core_ctl wants active
+ * @nrrun: tasks core_ctl accounts to the cluster
+ */
+struct sched_telemetry_cluster {
+	__u32 first_cpu;
+	__u32 active_cpus;
+	__u32 need_cpus;
+	__u32 nrrun;
+};
+
+/*
+ * struct sched_load_telemetry - layout of the mmap-able
+ * /sys/devices/system/cpu/sched_load_telemetry page
+ *
+ * Rewritten by the scheduler once per WALT window. @seq is odd while an
+ * update is in progress; a reader copies what it needs and retries if
+ * @seq was odd or changed in the meantime:
+ *
+ *	do {
+ *		seq = READ_ONCE(t->seq);
+ *		rmb();
+ *		copy = *t;
+ *		rmb();
+ *	} while ((seq & 1) || seq != READ_ONCE(t->seq));
+ */
+struct sched_load_telemetry {
+	__u32 seq;
+	__u32 nr_cpus;
+	__u32 nr_clusters;
+	__u32 pad;
+	__u64 window_start_ns;
+	struct sched_telemetry_cpu cpu[SCHED_TELEMETRY_MAX_CPUS];
+	struct sched_telemetry_cluster cluster[SCHED_TELEMETRY_MAX_CLUSTERS];
+};
+
+#endif /* _UAPI_SCHED_LOAD_TELEMETRY_H */
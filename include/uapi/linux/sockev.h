@@ -27,5 +27,24 @@ struct sknlsockevmsg {
 	__u64 skflags; /* (struct socket*)->sk->sk_flags */
 };
 
+/********************************************************************
+ *		Listener filters
+ ****/
+
+/*
+ * Sent to the kernel by a listener. Events are only multicast when at
+ * least one registered filter matches them; without any filter the
+ * kernel sends bind and listen of AF_INET and AF_INET6 sockets.
+ */
+#define SOCKEV_MSG_FILTER	(NLMSG_MIN_TYPE + 0)
+
+#define SOCKEV_UID_ANY		((__u32)~0U)
+
+struct sknlsockevfilter {
+	__u32 events; /* bitmask of (1 << event), 0 drops the filter */
+	__u32 uid; /* uid of the task, or SOCKEV_UID_ANY */
+	__u64 families; /* bitmask of (1 << family), 0 for any family */
+};
+
 #endif /* _SOCKEV_H_ */
 
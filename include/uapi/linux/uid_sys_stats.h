@@ -0,0 +1,50 @@
+#ifndef _UAPI_UID_SYS_STATS_H
+#define _UAPI_UID_SYS_STATS_H
+
+#include <linux/types.h>
+
+#define UID_STATS_VERSION	1
+
+/*
+ * struct uid_stats_io - io of the tasks of a uid in one procstat state,
+ * the same counters as a /proc/uid_io/stats line
+ */
+struct uid_stats_io {
+	__u64 rchar;
+	__u64 wchar;
+	__u64 read_bytes;
+	__u64 write_bytes;
+	__u64 fsync;
+};
+
+/*
+ * struct uid_stats_record - everything known about one uid
+ * @uid: the uid
+ * @state: procstat state, 0 for foreground and 1 for background
+ * @utime_us: user time of the live and dead tasks of the uid
+ * @stime_us: system time of the live and dead tasks of the uid
+ * @io: io done in the foreground and in the background state
+ */
+struct uid_stats_record {
+	__u32 uid;
+	__u32 state;
+	__u64 utime_us;
+	__u64 stime_us;
+	struct uid_stats_io io[2];
+};
+
+/*
+ * struct uid_stats_header - start of /proc/uid_stats
+ *
+ * The file is a snapshot taken at open, a header followed by @nr_records
+ * records of @record_size bytes each. Newer versions only append fields
+ * to struct uid_stats_record, so readers must step by @record_size.
+ */
+struct uid_stats_header {
+	__u32 version;
+	__u32 record_size;
+	__u32 nr_records;
+	__u32 pad;
+};
+
+#endif /* _UAPI_UID_SYS_STATS_H */
@@ -0,0 +1,59 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+#ifndef _UAPI__LINUX_FUNCTIONFS_BATCH_H__
+#define _UAPI__LINUX_FUNCTIONFS_BATCH_H__
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+/*
+ * Batched transfers on a FunctionFS endpoint file.
+ *
+ * FUNCTIONFS_BATCH_SETUP preallocates nr_bufs requests of buf_size bytes
+ * each, buf_size being a multiple of the page size. The buffers are then
+ * mmap()ed from the endpoint file, buffer i at offset i * buf_size, and
+ * stay set up until the file is closed.
+ *
+ * FUNCTIONFS_BATCH_SUBMIT queues the buffers listed in ios: length bytes
+ * are sent on an IN endpoint, up to length bytes received on an OUT one.
+ * It returns the number of buffers queued, fewer than nr on error.
+ *
+ * FUNCTIONFS_BATCH_REAP waits for min_nr of the queued buffers to complete
+ * and returns up to nr of them in events, with status holding the number
+ * of bytes transferred or a negative errno. With O_NONBLOCK it fails with
+ * EAGAIN instead of waiting. The endpoint file polls readable while
+ * completions are pending, and the FUNCTIONFS_EVENTFD eventfd, if any, is
+ * signalled for each.
+ */
+
+struct usb_ffs_batch_setup {
+	__u32 nr_bufs;
+	__u32 buf_size;
+};
+
+struct usb_ffs_batch_io {
+	__u32 index;
+	__u32 length;
+};
+
+struct usb_ffs_batch_event {
+	__u32 index;
+	__s32 status;
+};
+
+struct usb_ffs_batch_submit {
+	__u64 ios;		/* struct usb_ffs_batch_io[nr] */
+	__u32 nr;
+	__u32 reserved;
+};
+
+struct usb_ffs_batch_reap {
+	__u64 events;		/* struct usb_ffs_batch_event[nr] */
+	__u32 nr;
+	__u32 min_nr;
+};
+
+#define	FUNCTIONFS_BATCH_SETUP	_IOW('g', 136, struct usb_ffs_batch_setup)
+#define	FUNCTIONFS_BATCH_SUBMIT	_IOW('g', 137, struct usb_ffs_batch_submit)
+#define	FUNCTIONFS_BATCH_REAP	_IOW('g', 138, struct usb_ffs_batch_reap)
+
+#endif /* _UAPI__LINUX_FUNCTIONFS_BATCH_H__ */
@@ -868,6 +868,7 @@ static int __init_or_module do_one_initcall_debug(initcall_t fn)
 int __init_or_module do_one_initcall(initcall_t fn)
 {
 	int count = preempt_count();
+	u64 start = ktime_get_ns();
 	int ret;
 	char msgbuf[64];
 
@@ -891,6 +892,7 @@ int __init_or_module do_one_initcall(initcall_t fn)
 	}
 	WARN(msgbuf[0], "initcall %pF returned with %s\n", fn, msgbuf);
 
+	boot_timing_initcall(fn, start, ret);
 	add_latent_entropy();
 	return ret;
 }
@@ -3344,6 +3344,22 @@ static int cgroup_stat_show(struct seq_file *seq, void *v)
 	return 0;
 }
 
+/* cgroups psi accounts for, see iterate_groups() */
+static bool cgroup_psi_tracked(struct cgroup *cgrp)
+{
+	if (cgroup_on_dfl(cgrp))
+		return true;
+#ifdef CONFIG_PSI_MEMCG_V1
+	if (cgrp->root->subsys_mask & (1 << memory_cgrp_id))
+		return true;
+#endif
+#ifdef CONFIG_PSI_CPUSET_V1
+	if (cgrp->root->subsys_mask & (1 << cpuset_cgrp_id))
+		return true;
+#endif
+	return false;
+}
+
 #ifdef CONFIG_PSI
 static int cgroup_io_pressure_show(struct seq_file *seq, void *v)
 {
@@ -4672,7 +4688,7 @@ static void css_free_rwork_fn(struct work_struct *work)
 			 */
 			cgroup_put(cgroup_parent(cgrp));
 			kernfs_put(cgrp->kn);
-			if (cgroup_on_dfl(cgrp))
+			if (cgroup_psi_tracked(cgrp))
 				psi_cgroup_free(cgrp);
 			kfree(cgrp);
 		} else {
@@ -4950,7 +4966,7 @@ static struct cgroup *cgroup_create(struct cgroup *parent)
 	if (!cgroup_on_dfl(cgrp))
 		cgrp->subtree_control = cgroup_control(cgrp);
 
-	if (cgroup_on_dfl(cgrp)) {
+	if (cgroup_psi_tracked(cgrp)) {
 		ret = psi_cgroup_alloc(cgrp);
 		if (ret)
 			goto out_idr_free;
@@ -63,6 +63,7 @@
 #include <linux/mutex.h>
 #include <linux/cgroup.h>
 #include <linux/wait.h>
+#include <linux/psi.h>
 
 DEFINE_STATIC_KEY_FALSE(cpusets_pre_enable_key);
 DEFINE_STATIC_KEY_FALSE(cpusets_enabled_key);
@@ -1851,6 +1852,40 @@ static s64 cpuset_read_s64(struct cgroup_subsys_state *css, struct cftype *cft)
 	return 0;
 }
 
+#ifdef CONFIG_PSI_CPUSET_V1
+/* For the pressure files, 'private' is the psi resource */
+static int cpuset_pressure_show(struct seq_file *m, void *v)
+{
+	return psi_show(m, cgroup_psi(seq_css(m)->cgroup), seq_cft(m)->private);
+}
+
+static ssize_t cpuset_pressure_write(struct kernfs_open_file *of,
+				     char *buf, size_t nbytes, loff_t off)
+{
+	struct psi_trigger *new;
+
+	new = psi_trigger_create(cgroup_psi(of_css(of)->cgroup), buf, nbytes,
+				 of_cft(of)->private);
+	if (IS_ERR(new))
+		return PTR_ERR(new);
+
+	psi_trigger_replace(&of->priv, new);
+
+	return nbytes;
+}
+
+static unsigned int cpuset_pressure_poll(struct kernfs_open_file *of,
+					 poll_table *pt)
+{
+	return psi_trigger_poll(&of->priv, of->file, pt);
+}
+
+static void cpuset_pressure_release(struct kernfs_open_file *of)
+{
+	psi_trigger_replace(&of->priv, NULL);
+}
+#endif
+
 
 /*
  * for the common functions, 'private' gives the type of file
@@ -1955,6 +1990,38 @@ static struct cftype files[] = {
 		.private = FILE_MEMORY_PRESSURE_ENABLED,
 	},
 
+#ifdef CONFIG_PSI_CPUSET_V1
+	{
+		.name = "cpu.pressure",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = cpuset_pressure_show,
+		.write = cpuset_pressure_write,
+		.poll = cpuset_pressure_poll,
+		.release = cpuset_pressure_release,
+		.private = PSI_CPU,
+	},
+
+	{
+		.name = "memory.pressure",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = cpuset_pressure_show,
+		.write = cpuset_pressure_write,
+		.poll = cpuset_pressure_poll,
+		.release = cpuset_pressure_release,
+		.private = PSI_MEM,
+	},
+
+	{
+		.name = "io.pressure",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = cpuset_pressure_show,
+		.write = cpuset_pressure_write,
+		.poll = cpuset_pressure_poll,
+		.release = cpuset_pressure_release,
+		.private = PSI_IO,
+	},
+#endif
+
 	{ }	/* terminate */
 };
 
@@ -56,6 +56,7 @@
 #include <trace/events/sched.h>
 #include <linux/hw_breakpoint.h>
 #include <linux/oom.h>
+#include <linux/simple_lmk.h>
 #include <linux/writeback.h>
 #include <linux/shm.h>
 #include <linux/kcov.h>
@@ -117,6 +118,7 @@ static void __exit_signal(struct task_struct *tsk)
 	if (group_dead) {
 		tty = sig->tty;
 		sig->tty = NULL;
+		simple_lmk_signal_exit(sig);
 	} else {
 		/*
 		 * If there is any task waiting for the group exit
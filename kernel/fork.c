@@ -857,6 +857,15 @@ static struct mm_struct *mm_init(struct mm_struct *mm, struct task_struct *p,
 	mm->pmd_huge_pte = NULL;
 #endif
 	mm_init_uprobes_state(mm);
+#ifdef CONFIG_PROCESS_RECLAIM
+	mm->reclaim_idle_age = 0;
+	atomic_long_set(&mm->reclaim_nr_reclaimed, 0);
+	atomic_long_set(&mm->reclaim_nr_refaulted, 0);
+#endif
+#ifdef CONFIG_PROC_PAGE_MONITOR
+	spin_lock_init(&mm->rollup_snap.lock);
+	mm->rollup_snap.time_ns = 0;
+#endif
 
 	if (current->mm) {
 		mm->flags = current->mm->flags & MMF_INIT_MASK;
@@ -1668,6 +1677,7 @@ static void copy_oom_score_adj(u64 clone_flags, struct task_struct *tsk)
 	tsk->signal->oom_score_adj = current->signal->oom_score_adj;
 	tsk->signal->oom_score_adj_min = current->signal->oom_score_adj_min;
 	mutex_unlock(&oom_adj_mutex);
+	simple_lmk_adj_changed(tsk->signal);
 }
 
 /*
@@ -2097,6 +2107,7 @@ static __latent_entropy struct task_struct *copy_process(
 							 p->real_parent->signal->is_child_subreaper;
 			list_add_tail(&p->sibling, &p->real_parent->children);
 			list_add_tail_rcu(&p->tasks, &init_task.tasks);
+			simple_lmk_task_fork(p);
 			attach_pid(p, PIDTYPE_PGID);
 			attach_pid(p, PIDTYPE_SID);
 			__this_cpu_inc(process_counts);
@@ -52,7 +52,10 @@ int pm_notifier_call_chain(unsigned long val)
 	return __pm_notifier_call_chain(val, -1, NULL);
 }
 
-/* If set, devices may be suspended and resumed asynchronously. */
+/*
+ * If set, devices may be suspended and resumed asynchronously. If 2, all of
+ * them are, ordered only by their parents and device links.
+ */
 int pm_async_enabled = 1;
 
 static ssize_t pm_async_show(struct kobject *kobj, struct kobj_attribute *attr,
@@ -69,7 +72,7 @@ static ssize_t pm_async_store(struct kobject *kobj, struct kobj_attribute *attr,
 	if (kstrtoul(buf, 10, &val))
 		return -EINVAL;
 
-	if (val > 1)
+	if (val > 2)
 		return -EINVAL;
 
 	pm_async_enabled = val;
@@ -13,7 +13,10 @@
 #include "sched.h"
 #include "walt.h"
 #include <linux/of.h>
+#include <linux/cpufreq.h>
+#include <linux/workqueue.h>
 #include <linux/sched/core_ctl.h>
+#include <linux/sched/boost.h>
 #include <trace/events/sched.h>
 #include <linux/battery_saver.h>
 
@@ -290,6 +293,7 @@ int sched_set_boost(int type)
 	mutex_unlock(&boost_mutex);
 	return ret;
 }
+EXPORT_SYMBOL(sched_set_boost);
 
 int sched_boost_handler(struct ctl_table *table, int write,
 		void __user *buffer, size_t *lenp,
@@ -314,3 +318,155 @@ int sched_boost_handler(struct ctl_table *table, int write,
 	mutex_unlock(&boost_mutex);
 	return ret;
 }
+
+/*
+ * Timed boost profiles bundle a boost type with cpufreq and core_ctl
+ * floors, so that an input driver can apply all of it with one call,
+ * even from atomic context. The request is only recorded there and a
+ * high priority work applies it and arms the expiry. A new request
+ * replaces the running profile and restarts its timer.
+ */
+static DEFINE_SPINLOCK(boost_profile_lock);
+static struct sched_boost_profile boost_profile_req;
+static unsigned long boost_profile_expires;
+/* Profile currently applied, protected by boost_mutex */
+static struct sched_boost_profile boost_profile_cur;
+static DEFINE_PER_CPU(unsigned int, boost_profile_freq_min);
+
+static void boost_profile_work_fn(struct work_struct *work);
+static DECLARE_WORK(boost_profile_work, boost_profile_work_fn);
+static DECLARE_DELAYED_WORK(boost_profile_expire_work, boost_profile_work_fn);
+
+static bool boost_profile_set_freq(const struct sched_boost_profile *p)
+{
+	bool changed = false;
+	unsigned int val;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		int id = cpu_cluster(cpu)->id;
+
+		val = id < MAX_CLUSTERS ? p->freq_min[id] : 0;
+		if (per_cpu(boost_profile_freq_min, cpu) != val) {
+			per_cpu(boost_profile_freq_min, cpu) = val;
+			changed = true;
+		}
+	}
+
+	return changed;
+}
+
+static void boost_profile_update_policy(void)
+{
+	int cpu;
+
+	get_online_cpus();
+	for_each_online_cpu(cpu)
+		cpufreq_update_policy(cpu);
+	put_online_cpus();
+}
+
+static void boost_profile_work_fn(struct work_struct *work)
+{
+	struct sched_boost_profile new;
+	unsigned long expires, flags;
+	bool freq_changed;
+
+	spin_lock_irqsave(&boost_profile_lock, flags);
+	if (boost_profile_req.duration_ms &&
+	    time_after_eq(jiffies, boost_profile_expires))
+		memset(&boost_profile_req, 0, sizeof(boost_profile_req));
+	new = boost_profile_req;
+	expires = boost_profile_expires;
+	spin_unlock_irqrestore(&boost_profile_lock, flags);
+
+	mutex_lock(&boost_mutex);
+	if (new.type != boost_profile_cur.type) {
+		if (boost_profile_cur.type)
+			_sched_set_boost(-boost_profile_cur.type);
+		if (new.type)
+			_sched_set_boost(new.type);
+	}
+	freq_changed = boost_profile_set_freq(&new);
+	core_ctl_set_min_cpus_floor(CORE_CTL_MIN_CPUS_BOOST, new.min_cpus);
+	boost_profile_cur = new;
+	mutex_unlock(&boost_mutex);
+
+	if (freq_changed)
+		boost_profile_update_policy();
+
+	if (new.duration_ms)
+		mod_delayed_work(system_highpri_wq, &boost_profile_expire_work,
+				 time_after(expires, jiffies) ?
+				 expires - jiffies : 0);
+}
+
+/**
+ * sched_boost_profile_start - apply a timed boost profile
+ * @profile: boost type, per-cluster floors and duration
+ *
+ * May be called from any context. Returns -EINVAL for an unknown boost
+ * type or a duration of 0 or above SCHED_BOOST_PROFILE_MAX_MS.
+ */
+int sched_boost_profile_start(const struct sched_boost_profile *profile)
+{
+	unsigned long flags;
+
+	if (profile->type < NO_BOOST || profile->type > RESTRAINED_BOOST ||
+	    !profile->duration_ms ||
+	    profile->duration_ms > SCHED_BOOST_PROFILE_MAX_MS)
+		return -EINVAL;
+
+	spin_lock_irqsave(&boost_profile_lock, flags);
+	boost_profile_req = *profile;
+	boost_profile_expires = jiffies +
+				msecs_to_jiffies(profile->duration_ms);
+	spin_unlock_irqrestore(&boost_profile_lock, flags);
+
+	queue_work(system_highpri_wq, &boost_profile_work);
+	return 0;
+}
+EXPORT_SYMBOL(sched_boost_profile_start);
+
+/**
+ * sched_boost_profile_stop - drop the running boost profile early
+ */
+void sched_boost_profile_stop(void)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&boost_profile_lock, flags);
+	memset(&boost_profile_req, 0, sizeof(boost_profile_req));
+	spin_unlock_irqrestore(&boost_profile_lock, flags);
+
+	queue_work(system_highpri_wq, &boost_profile_work);
+}
+EXPORT_SYMBOL(sched_boost_profile_stop);
+
+/* Keep policy->min at or above the floor of the running profile */
+static int boost_profile_adjust_notify(struct notifier_block *nb,
+				       unsigned long val, void *data)
+{
+	struct cpufreq_policy *policy = data;
+	unsigned int min;
+
+	if (val != CPUFREQ_ADJUST)
+		return NOTIFY_OK;
+
+	min = per_cpu(boost_profile_freq_min, policy->cpu);
+	if (min)
+		cpufreq_verify_within_limits(policy, min, UINT_MAX);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block boost_profile_adjust_nb = {
+	.notifier_call = boost_profile_adjust_notify,
+};
+
+static int __init sched_boost_profile_init(void)
+{
+	return cpufreq_register_notifier(&boost_profile_adjust_nb,
+					 CPUFREQ_POLICY_NOTIFIER);
+}
+late_initcall(sched_boost_profile_init);
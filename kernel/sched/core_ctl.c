@@ -21,7 +21,9 @@
 #include <linux/sched/rt.h>
 #include <linux/syscore_ops.h>
 #include <uapi/linux/sched/types.h>
+#include <uapi/linux/sched_load_telemetry.h>
 #include <linux/sched/core_ctl.h>
+#include <linux/mm.h>
 
 #include <trace/events/sched.h>
 #include "sched.h"
@@ -30,6 +32,7 @@
 struct cluster_data {
 	bool inited;
 	unsigned int min_cpus;
+	unsigned int floor_min_cpus[CORE_CTL_MIN_CPUS_CLIENTS];
 	unsigned int max_cpus;
 	unsigned int offline_delay_ms;
 	unsigned int busy_up_thres[MAX_CPUS_PER_CLUSTER];
@@ -55,11 +58,14 @@ struct cluster_data {
 	unsigned int boost;
 	struct kobject kobj;
 	unsigned int strict_nrrun;
+	bool predict;
+	unsigned int pred_need;
 };
 
 struct cpu_data {
 	bool is_busy;
 	unsigned int busy;
+	unsigned int pred_busy;
 	unsigned int cpu;
 	bool not_preferred;
 	struct cluster_data *cluster;
@@ -285,6 +291,30 @@ static ssize_t show_enable(const struct cluster_data *state, char *buf)
 	return scnprintf(buf, PAGE_SIZE, "%u\n", state->enable);
 }
 
+static ssize_t store_predict(struct cluster_data *state,
+				const char *buf, size_t count)
+{
+	unsigned int val;
+	bool bval;
+
+	if (sscanf(buf, "%u\n", &val) != 1)
+		return -EINVAL;
+
+	bval = !!val;
+	if (bval != state->predict) {
+		state->predict = bval;
+		state->pred_need = 0;
+		apply_need(state);
+	}
+
+	return count;
+}
+
+static ssize_t show_predict(const struct cluster_data *state, char *buf)
+{
+	return scnprintf(buf, PAGE_SIZE, "%u\n", state->predict);
+}
+
 static ssize_t show_need_cpus(const struct cluster_data *state, char *buf)
 {
 	return snprintf(buf, PAGE_SIZE, "%u\n", state->need_cpus);
@@ -419,6 +449,7 @@ core_ctl_attr_ro(active_cpus);
 core_ctl_attr_ro(global_state);
 core_ctl_attr_rw(not_preferred);
 core_ctl_attr_rw(enable);
+core_ctl_attr_rw(predict);
 
 static struct attribute *default_attrs[] = {
 	&min_cpus.attr,
@@ -433,6 +464,7 @@ static struct attribute *default_attrs[] = {
 	&active_cpus.attr,
 	&global_state.attr,
 	&not_preferred.attr,
+	&predict.attr,
 	NULL
 };
 
@@ -755,7 +787,13 @@ static unsigned int apply_task_need(const struct cluster_data *cluster,
 static unsigned int apply_limits(const struct cluster_data *cluster,
 				 unsigned int need_cpus)
 {
-	return min(max(cluster->min_cpus, need_cpus), cluster->max_cpus);
+	unsigned int min_cpus = cluster->min_cpus;
+	int client;
+
+	for (client = 0; client < CORE_CTL_MIN_CPUS_CLIENTS; client++)
+		min_cpus = max(min_cpus, cluster->floor_min_cpus[client]);
+
+	return min(max(min_cpus, need_cpus), cluster->max_cpus);
 }
 
 static unsigned int get_active_cpu_count(const struct cluster_data *cluster)
@@ -783,6 +821,31 @@ static bool need_all_cpus(const struct cluster_data *cluster)
 		sched_ravg_window < DEFAULT_SCHED_RAVG_WINDOW);
 }
 
+/*
+ * Forecast the need from the predicted demand of the runnable tasks
+ * rather than from last window's busy time, and take the previous
+ * cluster asking for assistance as a sign of load to come even below
+ * nr_prev_assist_thresh. Used to unisolate cores ahead of a burst.
+ */
+static unsigned int compute_pred_need(const struct cluster_data *cluster,
+				      unsigned int thres_idx)
+{
+	const struct cpu_data *c;
+	unsigned int need = 0;
+
+	list_for_each_entry(c, &cluster->lru, sib) {
+		if (max(c->busy, c->pred_busy) >=
+				cluster->busy_up_thres[thres_idx])
+			need++;
+	}
+
+	need = apply_task_need(cluster, need);
+	if (cluster->nr_prev_assist < cluster->nr_prev_assist_thresh)
+		need += cluster->nr_prev_assist;
+
+	return need;
+}
+
 static bool eval_need(struct cluster_data *cluster)
 {
 	unsigned long flags;
@@ -817,6 +880,17 @@ static bool eval_need(struct cluster_data *cluster)
 			need_cpus += c->is_busy;
 		}
 		need_cpus = apply_task_need(cluster, need_cpus);
+
+		if (cluster->predict) {
+			unsigned int pred_need;
+
+			pred_need = compute_pred_need(cluster, thres_idx);
+			trace_core_ctl_pred_need(cluster->first_cpu,
+						 cluster->pred_need, need_cpus,
+						 pred_need);
+			cluster->pred_need = pred_need;
+			need_cpus = max(need_cpus, pred_need);
+		}
 	}
 	new_need = apply_limits(cluster, need_cpus);
 	need_flag = adjustment_possible(cluster, new_need);
@@ -915,6 +989,40 @@ int core_ctl_set_boost(bool boost)
 }
 EXPORT_SYMBOL(core_ctl_set_boost);
 
+/*
+ * Raise the min_cpus of each cluster to @min_cpus[cluster index] on top
+ * of the sysfs setting, on behalf of @client. 0 removes the floor.
+ */
+void core_ctl_set_min_cpus_floor(int client, const unsigned int *min_cpus)
+{
+	struct cluster_data *cluster;
+	unsigned int index = 0;
+	bool changed[MAX_CLUSTERS] = { false };
+	unsigned long flags;
+
+	if (unlikely(!initialized) || client < 0 ||
+	    client >= CORE_CTL_MIN_CPUS_CLIENTS)
+		return;
+
+	spin_lock_irqsave(&state_lock, flags);
+	for_each_cluster(cluster, index) {
+		unsigned int val = min(min_cpus[index], cluster->max_cpus);
+
+		if (val != cluster->floor_min_cpus[client]) {
+			cluster->floor_min_cpus[client] = val;
+			changed[index] = true;
+		}
+	}
+	spin_unlock_irqrestore(&state_lock, flags);
+
+	index = 0;
+	for_each_cluster(cluster, index) {
+		if (changed[index])
+			apply_need(cluster);
+	}
+}
+EXPORT_SYMBOL(core_ctl_set_min_cpus_floor);
+
 void core_ctl_notifier_register(struct notifier_block *n)
 {
 	atomic_notifier_chain_register(&core_ctl_notifier, n);
@@ -949,6 +1057,111 @@ static void core_ctl_call_notifier(void)
 	atomic_notifier_call_chain(&core_ctl_notifier, 0, &ndata);
 }
 
+/* ========================= load telemetry page ======================== */
+
+/*
+ * The nr_running averages, WALT util and busy state core_ctl evaluates
+ * every window, published in a page userspace can mmap and read without
+ * a syscall or lock, see struct sched_load_telemetry.
+ */
+static struct sched_load_telemetry *telemetry;
+
+static void publish_telemetry(u64 window_start)
+{
+	struct sched_load_telemetry *t = telemetry;
+	struct cluster_data *cluster;
+	unsigned int index = 0;
+	unsigned long flags;
+	struct cpu_data *c;
+	int cpu;
+
+	if (!t)
+		return;
+
+	spin_lock_irqsave(&state_lock, flags);
+	WRITE_ONCE(t->seq, t->seq + 1);
+	smp_wmb();
+
+	t->window_start_ns = window_start;
+	t->nr_cpus = min_t(unsigned int, nr_cpu_ids, SCHED_TELEMETRY_MAX_CPUS);
+	for (cpu = 0; cpu < t->nr_cpus; cpu++) {
+		c = &per_cpu(cpu_state, cpu);
+		t->cpu[cpu].nr_scaled = nr_stats[cpu].nr_scaled;
+		t->cpu[cpu].nr_max = nr_stats[cpu].nr_max;
+		t->cpu[cpu].nr_misfit = nr_stats[cpu].nr_misfit;
+		t->cpu[cpu].util_pct = c->busy;
+		t->cpu[cpu].busy = c->is_busy;
+		t->cpu[cpu].isolated = cpu_isolated(cpu);
+	}
+
+	t->nr_clusters = min_t(unsigned int, num_clusters,
+			       SCHED_TELEMETRY_MAX_CLUSTERS);
+	for_each_cluster(cluster, index) {
+		if (index >= t->nr_clusters)
+			break;
+		t->cluster[index].first_cpu = cluster->first_cpu;
+		t->cluster[index].active_cpus = cluster->active_cpus;
+		t->cluster[index].need_cpus = cluster->need_cpus;
+		t->cluster[index].nrrun = cluster->nrrun;
+	}
+
+	smp_wmb();
+	WRITE_ONCE(t->seq, t->seq + 1);
+	spin_unlock_irqrestore(&state_lock, flags);
+}
+
+static ssize_t telemetry_read(struct file *filp, struct kobject *kobj,
+			      struct bin_attribute *attr, char *buf,
+			      loff_t off, size_t count)
+{
+	return memory_read_from_buffer(buf, count, &off, telemetry,
+				       sizeof(*telemetry));
+}
+
+static int telemetry_mmap(struct file *filp, struct kobject *kobj,
+			  struct bin_attribute *attr,
+			  struct vm_area_struct *vma)
+{
+	if (vma->vm_pgoff || vma->vm_end - vma->vm_start != PAGE_SIZE)
+		return -EINVAL;
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+	return remap_pfn_range(vma, vma->vm_start,
+			       page_to_pfn(virt_to_page(telemetry)),
+			       PAGE_SIZE, vma->vm_page_prot);
+}
+
+static struct bin_attribute telemetry_attr = {
+	.attr = {
+		.name = "sched_load_telemetry",
+		.mode = 0444,
+	},
+	.size = PAGE_SIZE,
+	.read = telemetry_read,
+	.mmap = telemetry_mmap,
+};
+
+static void telemetry_init(void)
+{
+	int ret;
+
+	BUILD_BUG_ON(sizeof(struct sched_load_telemetry) > PAGE_SIZE);
+
+	telemetry = (void *)get_zeroed_page(GFP_KERNEL);
+	if (!telemetry)
+		return;
+
+	ret = sysfs_create_bin_file(&cpu_subsys.dev_root->kobj,
+				    &telemetry_attr);
+	if (ret) {
+		pr_warn("unable to create load telemetry file: %d\n", ret);
+		free_page((unsigned long)telemetry);
+		telemetry = NULL;
+	}
+}
+
 void core_ctl_check(u64 window_start)
 {
 	int cpu;
@@ -975,6 +1188,8 @@ void core_ctl_check(u64 window_start)
 			continue;
 
 		c->busy = sched_get_cpu_util(cpu);
+		c->pred_busy = cluster->predict ?
+				sched_get_cpu_pred_util(cpu) : 0;
 	}
 	spin_unlock_irqrestore(&state_lock, flags);
 
@@ -985,6 +1200,7 @@ void core_ctl_check(u64 window_start)
 			wake_up_core_ctl_thread(cluster);
 	}
 
+	publish_telemetry(window_start);
 	core_ctl_call_notifier();
 }
 
@@ -1368,6 +1584,7 @@ static int __init core_ctl_init(void)
 			pr_warn("unable to create core ctl group: %d\n", ret);
 	}
 
+	telemetry_init();
 	initialized = true;
 	return 0;
 }
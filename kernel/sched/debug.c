@@ -781,6 +781,9 @@ do {									\
 		P(sched_goidle);
 		P(ttwu_count);
 		P(ttwu_local);
+		P(eas_util_cache_hit);
+		P(eas_cap_cache_hit);
+		P(eas_cap_cache_miss);
 	}
 #undef P
 
@@ -290,6 +290,9 @@ static int sched_energy_probe(struct platform_device *pdev)
 
 	kfree(max_frequencies);
 
+	/* Cached capacity state lookups refer to the old capacities */
+	WRITE_ONCE(sched_energy_gen, sched_energy_gen + 1);
+
 	dev_info(&pdev->dev, "Sched-energy-costs capacity updated\n");
 	return 0;
 
@@ -5988,6 +5988,10 @@ struct energy_env {
 	struct sched_group	*sg_top;
 	struct sched_group	*sg_cap;
 	struct sched_group	*sg;
+
+	/* Max util of util_sg's CPUs without the task, see group_max_util() */
+	struct sched_group	*util_sg;
+	unsigned long		util_sg_max;
 };
 
 /*
@@ -6096,26 +6100,38 @@ static unsigned long cpu_util_without(int cpu, struct task_struct *p)
 	return min_t(unsigned long, util, capacity_orig_of(cpu));
 }
 
+/*
+ * Placing the task on a CPU only raises that CPU's util, so the group max
+ * util for any candidate is the max without the task, computed once per
+ * group and wakeup, or the candidate's own util with the task added.
+ */
 static unsigned long group_max_util(struct energy_env *eenv, int cpu_idx)
 {
+	struct sched_group *sg = eenv->sg_cap;
+	int target = eenv->cpu[cpu_idx].cpu_id;
 	unsigned long max_util = 0;
-	unsigned long util;
 	int cpu;
 
-	for_each_cpu(cpu, sched_group_span(eenv->sg_cap)) {
-		util = cpu_util_without(cpu, eenv->p);
-
-		/*
-		 * If we are looking at the target CPU specified by the eenv,
-		 * then we should add the (estimated) utilization of the task
-		 * assuming we will wake it up on that CPU.
-		 */
-		if (unlikely(cpu == eenv->cpu[cpu_idx].cpu_id))
-			util += eenv->util_delta_boosted;
-
-		max_util = max(max_util, util);
+	if (eenv->util_sg == sg) {
+		max_util = eenv->util_sg_max;
+		schedstat_inc(this_rq()->eas_util_cache_hit);
+	} else {
+		for_each_cpu(cpu, sched_group_span(sg))
+			max_util = max(max_util,
+				       cpu_util_without(cpu, eenv->p));
+		eenv->util_sg = sg;
+		eenv->util_sg_max = max_util;
 	}
 
+	/*
+	 * If we are looking at the target CPU specified by the eenv,
+	 * then we should add the (estimated) utilization of the task
+	 * assuming we will wake it up on that CPU.
+	 */
+	if (target != -1 && cpumask_test_cpu(target, sched_group_span(sg)))
+		max_util = max(max_util, cpu_util_without(target, eenv->p) +
+					 eenv->util_delta_boosted);
+
 	return max_util;
 }
 
@@ -6154,11 +6170,49 @@ long group_norm_util(struct energy_env *eenv, int cpu_idx)
 	return util_sum;
 }
 
-static int find_new_capacity(struct energy_env *eenv, int cpu_idx)
+/*
+ * Per-cpu cache of capacity state lookups. An entry remembers the util
+ * range [lo, hi] of an energy table that maps to cap_idx, so that a max
+ * util falling in a recently used range skips the table walk. The whole
+ * cache is dropped when the energy driver rescales the tables.
+ */
+#define EAS_CAP_CACHE_SIZE	4
+
+unsigned int sched_energy_gen;
+
+struct eas_cap_cache {
+	struct {
+		const struct sched_group_energy *sge;
+		unsigned long lo;
+		unsigned long hi;
+		int cap_idx;
+	} entry[EAS_CAP_CACHE_SIZE];
+	unsigned int gen;
+	unsigned int next;
+};
+
+static DEFINE_PER_CPU(struct eas_cap_cache, eas_cap_cache);
+
+static int find_cap_idx(const struct sched_group_energy *sge,
+			unsigned long util)
 {
-	const struct sched_group_energy *sge = eenv->sg_cap->sge;
-	unsigned long util = group_max_util(eenv, cpu_idx);
-	int idx, cap_idx;
+	struct eas_cap_cache *cache = this_cpu_ptr(&eas_cap_cache);
+	unsigned int gen = READ_ONCE(sched_energy_gen);
+	int i, idx, cap_idx;
+
+	if (unlikely(cache->gen != gen)) {
+		memset(cache->entry, 0, sizeof(cache->entry));
+		cache->gen = gen;
+	}
+
+	for (i = 0; i < EAS_CAP_CACHE_SIZE; i++) {
+		if (cache->entry[i].sge == sge &&
+		    util >= cache->entry[i].lo && util <= cache->entry[i].hi) {
+			schedstat_inc(this_rq()->eas_cap_cache_hit);
+			return cache->entry[i].cap_idx;
+		}
+	}
+	schedstat_inc(this_rq()->eas_cap_cache_miss);
 
 	cap_idx = sge->nr_cap_states - 1;
 
@@ -6168,6 +6222,26 @@ static int find_new_capacity(struct energy_env *eenv, int cpu_idx)
 			break;
 		}
 	}
+
+	i = cache->next;
+	cache->next = (i + 1) % EAS_CAP_CACHE_SIZE;
+	cache->entry[i].sge = sge;
+	cache->entry[i].lo = cap_idx ? sge->cap_states[cap_idx - 1].cap + 1 : 0;
+	cache->entry[i].hi = cap_idx == sge->nr_cap_states - 1 ?
+			     ULONG_MAX : sge->cap_states[cap_idx].cap;
+	cache->entry[i].cap_idx = cap_idx;
+
+	return cap_idx;
+}
+
+static int find_new_capacity(struct energy_env *eenv, int cpu_idx)
+{
+	const struct sched_group_energy *sge = eenv->sg_cap->sge;
+	unsigned long util = group_max_util(eenv, cpu_idx);
+	int cap_idx;
+
+	cap_idx = find_cap_idx(sge, util);
+
 	/* Keep track of SG's capacity */
 	eenv->cpu[cpu_idx].cap = sge->cap_states[cap_idx].cap;
 	eenv->cpu[cpu_idx].cap_idx = cap_idx;
@@ -7433,8 +7507,26 @@ struct find_best_target_env {
 	int fastpath;
 	int skip_cpu;
 	int start_cpu;
+	bool prefer_shallow;
 };
 
+/*
+ * Exit latency of the idle mode @cpu is in. The platform idle driver knows
+ * about cluster modes entered on top of the cpu one, so ask it first.
+ * Must be called under rcu_read_lock().
+ */
+static inline unsigned int cpu_idle_exit_latency(int cpu)
+{
+	unsigned int latency = lpm_cpu_exit_latency(cpu);
+	struct cpuidle_state *state;
+
+	if (latency)
+		return latency;
+
+	state = idle_get_state(cpu_rq(cpu));
+	return state ? state->exit_latency : 0;
+}
+
 static inline void adjust_cpus_for_packing(struct task_struct *p,
 			int *target_cpu, int *best_idle_cpu,
 			int shallowest_idle_cstate,
@@ -7527,6 +7619,8 @@ static inline int find_best_target(struct task_struct *p, int *backup_cpu,
 	unsigned long best_idle_cuml_util = ULONG_MAX;
 	unsigned long best_idle_util = ULONG_MAX;
 	int best_idle_cstate = INT_MAX;
+	unsigned int best_idle_exit_lat = UINT_MAX;
+	unsigned int max_idle_exit_lat = 0;
 	struct sched_domain *sd;
 	struct sched_group *sg;
 	int best_active_cpu = -1;
@@ -7705,7 +7799,36 @@ static inline int find_best_target(struct task_struct *p, int *backup_cpu,
 				 * performance (i.e. biggest capacity_orig)
 				 * - for !boosted tasks: the most energy
 				 * efficient CPU (i.e. smallest capacity_orig)
+				 * - for prefer_shallow tasks: the CPU that
+				 * wakes up the fastest, capacity_orig only
+				 * breaking ties
 				 */
+				if (idle_cpu(i) && fbt_env->prefer_shallow) {
+					unsigned int lat =
+						cpu_idle_exit_latency(i);
+
+					max_idle_exit_lat =
+						max(max_idle_exit_lat, lat);
+					if (lat > best_idle_exit_lat)
+						continue;
+					/* Ties: same capacity rule as below */
+					if (lat == best_idle_exit_lat &&
+					    capacity_orig != target_capacity &&
+					    boosted == (capacity_orig <
+							target_capacity))
+						continue;
+					if (lat == best_idle_exit_lat &&
+					    capacity_orig == target_capacity &&
+					    best_idle_util <= new_util)
+						continue;
+
+					target_capacity = capacity_orig;
+					best_idle_exit_lat = lat;
+					best_idle_cstate = idle_idx;
+					best_idle_util = new_util;
+					best_idle_cpu = i;
+					continue;
+				}
 				if (idle_cpu(i)) {
 					if (boosted &&
 					    capacity_orig < target_capacity)
@@ -7902,8 +8025,11 @@ static inline int find_best_target(struct task_struct *p, int *backup_cpu,
 		 * group cpu capacity. For !prefer_idle && boosted case, don't
 		 * iterate lower capacity CPUs unless the task can't be
 		 * accommodated in the higher capacity CPUs.
+		 * prefer_shallow tasks look at every group, a shallower
+		 * idle CPU may be in any of them.
 		 */
-		if ((prefer_idle && best_idle_cpu != -1) ||
+		if ((prefer_idle && best_idle_cpu != -1 &&
+		     !fbt_env->prefer_shallow) ||
 		    (boosted && (best_idle_cpu != -1 || target_cpu != -1))) {
 			if (boosted) {
 				if (!next_group_higher_cap)
@@ -7949,6 +8075,10 @@ static inline int find_best_target(struct task_struct *p, int *backup_cpu,
 	}
 
 	if (prefer_idle && (best_idle_cpu != -1)) {
+		if (fbt_env->prefer_shallow)
+			trace_sched_shallow_idle_cpu(p, best_idle_cpu,
+						     best_idle_exit_lat,
+						     max_idle_exit_lat);
 		trace_sched_find_best_target(p, prefer_idle, min_util, start_cpu,
 					     best_idle_cpu, best_active_cpu,
 					     -1, best_idle_cpu, -1);
@@ -8303,6 +8433,8 @@ static int find_energy_efficient_cpu(struct sched_domain *sd,
 		fbt_env.skip_cpu = is_many_wakeup(sibling_count_hint) ?
 				   cpu : -1;
 		fbt_env.boosted = boosted;
+		fbt_env.prefer_shallow = prefer_idle &&
+					 schedtune_prefer_shallow(p) > 0;
 
 		/* Find a cpu with sufficient capacity */
 		target_cpu = find_best_target(p, &eenv->cpu[EAS_CPU_BKP].cpu_id,
@@ -168,6 +168,11 @@ __setup("psi=", setup_psi);
 #define WINDOW_MIN_US 500000	/* Min window size is 500ms */
 #define WINDOW_MAX_US 10000000	/* Max window size is 10s */
 #define UPDATES_PER_WINDOW 10	/* 10 updates per window */
+/*
+ * Evaluate triggers at least this often while polling, so that a crossed
+ * threshold is reported within a few ms whatever the window size.
+ */
+#define POLL_MAX_PERIOD_NS (5 * NSEC_PER_MSEC)
 
 /* Sampling frequency in nanoseconds */
 static u64 psi_period __read_mostly;
@@ -197,6 +202,7 @@ static void group_init(struct psi_group *group)
 	memset(group->nr_triggers, 0, sizeof(group->nr_triggers));
 	group->poll_states = 0;
 	group->poll_min_period = U32_MAX;
+	group->poll_min_window = U32_MAX;
 	memset(group->polling_total, 0, sizeof(group->polling_total));
 	group->polling_next_update = ULLONG_MAX;
 	group->polling_until = 0;
@@ -605,8 +611,7 @@ static void psi_poll_work(struct kthread_work *work)
 		 * minimum tracking window as long as monitor states are
 		 * changing.
 		 */
-		group->polling_until = now +
-			group->poll_min_period * UPDATES_PER_WINDOW;
+		group->polling_until = now + group->poll_min_window;
 	}
 
 	if (now > group->polling_until) {
@@ -721,17 +726,94 @@ static u32 psi_group_change(struct psi_group *group, int cpu,
 	return state_mask;
 }
 
+#ifdef CONFIG_PSI_MEMCG_V1
+/* The task's cgroup on a cgroup v1 hierarchy with the memory controller */
+static struct cgroup *task_memcg_v1_cgroup(struct task_struct *task)
+{
+	struct cgroup *cgroup;
+
+	if (cgroup_subsys_on_dfl(memory_cgrp_subsys))
+		return NULL;
+
+	cgroup = task->cgroups->subsys[memory_cgrp_id]->cgroup;
+	if (!cgroup_parent(cgroup))
+		return NULL;
+
+	return cgroup;
+}
+#else
+static inline struct cgroup *task_memcg_v1_cgroup(struct task_struct *task)
+{
+	return NULL;
+}
+#endif
+
+#ifdef CONFIG_PSI_CPUSET_V1
+/* The task's cgroup on a cgroup v1 hierarchy with the cpuset controller */
+static struct cgroup *task_cpuset_v1_cgroup(struct task_struct *task)
+{
+	struct cgroup *cgroup;
+
+	if (cgroup_subsys_on_dfl(cpuset_cgrp_subsys))
+		return NULL;
+
+	cgroup = task->cgroups->subsys[cpuset_cgrp_id]->cgroup;
+	if (!cgroup_parent(cgroup))
+		return NULL;
+
+#ifdef CONFIG_PSI_MEMCG_V1
+	/* Co-mounted with memcg, already walked as the memcg hierarchy */
+	if (cgroup->root->subsys_mask & (1 << memory_cgrp_id))
+		return NULL;
+#endif
+	return cgroup;
+}
+#else
+static inline struct cgroup *task_cpuset_v1_cgroup(struct task_struct *task)
+{
+	return NULL;
+}
+#endif
+
+/*
+ * Where to go once the root of the v1 hierarchy @done is reached: from the
+ * memcg hierarchy on to the cpuset one, from there to the default one.
+ */
+static struct cgroup *next_hierarchy(struct task_struct *task,
+				     struct cgroup *done)
+{
+	struct cgroup *cgroup = task_cpuset_v1_cgroup(task);
+
+	if (cgroup && cgroup->root != done->root)
+		return cgroup;
+
+	return task->cgroups->dfl_cgrp;
+}
+
+/*
+ * Walk the task's cgroup v1 memory cgroup and its ancestors, then its v1
+ * cpuset and ancestors, if any, then its cgroup2 cgroup and ancestors, and
+ * finally the system group.
+ */
 static struct psi_group *iterate_groups(struct task_struct *task, void **iter)
 {
 #ifdef CONFIG_CGROUPS
 	struct cgroup *cgroup = NULL;
 
-	if (!*iter)
-		cgroup = task->cgroups->dfl_cgrp;
-	else if (*iter == &psi_system)
+	if (!*iter) {
+		cgroup = task_memcg_v1_cgroup(task);
+		if (!cgroup)
+			cgroup = task_cpuset_v1_cgroup(task);
+		if (!cgroup)
+			cgroup = task->cgroups->dfl_cgrp;
+	} else if (*iter == &psi_system) {
 		return NULL;
-	else
+	} else {
 		cgroup = cgroup_parent(*iter);
+		/* done with a v1 hierarchy, continue on the next one */
+		if (cgroup && !cgroup_parent(cgroup) && !cgroup_on_dfl(cgroup))
+			cgroup = next_hierarchy(task, cgroup);
+	}
 
 	if (cgroup && cgroup_parent(cgroup)) {
 		*iter = cgroup;
@@ -1005,6 +1087,12 @@ static int psi_cpu_open(struct inode *inode, struct file *file)
 	return single_open(file, psi_cpu_show, NULL);
 }
 
+static u64 trigger_poll_period(struct psi_trigger *t)
+{
+	return min_t(u64, div_u64(t->win.size, UPDATES_PER_WINDOW),
+		     POLL_MAX_PERIOD_NS);
+}
+
 struct psi_trigger *psi_trigger_create(struct psi_group *group,
 			char *buf, size_t nbytes, enum psi_res res)
 {
@@ -1071,7 +1159,8 @@ struct psi_trigger *psi_trigger_create(struct psi_group *group,
 
 	list_add(&t->node, &group->triggers);
 	group->poll_min_period = min(group->poll_min_period,
-		div_u64(t->win.size, UPDATES_PER_WINDOW));
+				     trigger_poll_period(t));
+	group->poll_min_window = min(group->poll_min_window, t->win.size);
 	group->nr_triggers[t->state]++;
 	group->poll_states |= (1 << t->state);
 
@@ -1100,16 +1189,19 @@ static void psi_trigger_destroy(struct kref *ref)
 	if (!list_empty(&t->node)) {
 		struct psi_trigger *tmp;
 		u64 period = ULLONG_MAX;
+		u64 window = ULLONG_MAX;
 
 		list_del(&t->node);
 		group->nr_triggers[t->state]--;
 		if (!group->nr_triggers[t->state])
 			group->poll_states &= ~(1 << t->state);
 		/* reset min update period for the remaining triggers */
-		list_for_each_entry(tmp, &group->triggers, node)
-			period = min(period, div_u64(tmp->win.size,
-					UPDATES_PER_WINDOW));
+		list_for_each_entry(tmp, &group->triggers, node) {
+			period = min(period, trigger_poll_period(tmp));
+			window = min(window, tmp->win.size);
+		}
 		group->poll_min_period = period;
+		group->poll_min_window = window;
 		/* Destroy poll_kworker when the last trigger is destroyed */
 		if (group->poll_states == 0) {
 			group->polling_until = 0;
@@ -888,6 +888,9 @@ struct rq {
 	u64 nt_prev_runnable_sum;
 	u64 cum_window_demand_scaled;
 	struct group_cpu_time grp_time;
+	/* Window the busy time sums belong to, and their lockless reads */
+	u64 walt_sums_ws;
+	seqcount_t walt_seq;
 	struct load_subtractions load_subs[NUM_TRACKED_WINDOWS];
 	DECLARE_BITMAP_ARRAY(top_tasks_bitmap,
 			NUM_TRACKED_WINDOWS, NUM_LOAD_INDICES);
@@ -938,6 +941,11 @@ struct rq {
 	/* try_to_wake_up() stats */
 	unsigned int ttwu_count;
 	unsigned int ttwu_local;
+
+	/* energy estimate cache stats */
+	unsigned int eas_util_cache_hit;
+	unsigned int eas_cap_cache_hit;
+	unsigned int eas_cap_cache_miss;
 #endif
 
 #ifdef CONFIG_SMP
@@ -2371,6 +2379,7 @@ static inline void nohz_balance_exit_idle(unsigned int cpu) { }
 #ifdef CONFIG_SMP
 
 extern void init_energy_aware_data(int cpu);
+extern unsigned int sched_energy_gen;
 
 static inline
 void __dl_update(struct dl_bw *dl_b, s64 bw)
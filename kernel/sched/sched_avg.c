@@ -232,6 +232,7 @@ unsigned int sched_get_cpu_util(int cpu)
 	busy = div64_ul((util * 100), capacity);
 	return busy;
 }
+EXPORT_SYMBOL(sched_get_cpu_util);
 
 #ifdef CONFIG_SCHED_WALT
 u64 sched_lpm_disallowed_time(int cpu)
@@ -244,4 +245,19 @@ u64 sched_lpm_disallowed_time(int cpu)
 
 	return 0;
 }
+
+/*
+ * Returns the predicted demand of the tasks runnable on the CPU, as a %
+ * of its capacity. Unlike sched_get_cpu_util() this moves as soon as a
+ * task with a high predicted demand is woken, not a window later.
+ */
+unsigned int sched_get_cpu_pred_util(int cpu)
+{
+	struct rq *rq = cpu_rq(cpu);
+	unsigned long capacity = capacity_orig_of(cpu);
+	u64 util = READ_ONCE(rq->walt_stats.pred_demands_sum_scaled);
+
+	util = min_t(u64, util, capacity);
+	return div64_ul(util * 100, capacity);
+}
 #endif
@@ -6,6 +6,7 @@
 #include <linux/rcupdate.h>
 #include <linux/slab.h>
 #include <linux/battery_saver.h>
+#include <linux/ioprio.h>
 
 #include <trace/events/sched.h>
 #include <linux/list.h>
@@ -71,6 +72,21 @@ struct schedtune {
 	 * towards idle CPUs */
 	int prefer_idle;
 
+	/* Among idle CPUs, prefer the ones that wake up the fastest */
+	int prefer_shallow;
+
+	/*
+	 * I/O scheduling class given to bios of this group's tasks that
+	 * carry no ioprio of their own, IOPRIO_CLASS_NONE for none.
+	 */
+	int ioprio_class;
+
+	/*
+	 * Processes moved into this group are launching, so the block
+	 * schedulers may favour their I/O for a while (top-app).
+	 */
+	int app_launch;
+
 #ifdef CONFIG_DYNAMIC_STUNE_BOOST
 	/*
 	 * This tracks the default boost value and is used to restore
@@ -127,6 +143,9 @@ root_schedtune = {
 	.colocate_update_disabled = false,
 #endif
 	.prefer_idle = 0,
+	.prefer_shallow = 0,
+	.ioprio_class = IOPRIO_CLASS_NONE,
+	.app_launch = 0,
 #ifdef CONFIG_DYNAMIC_STUNE_BOOST
 	.boost_default = 0,
 	.sched_boost = 0,
@@ -575,6 +594,117 @@ int schedtune_prefer_idle(struct task_struct *p)
 	return prefer_idle;
 }
 
+int schedtune_prefer_shallow(struct task_struct *p)
+{
+	struct schedtune *st;
+	int prefer_shallow;
+
+	if (unlikely(!schedtune_initialized))
+		return 0;
+
+	rcu_read_lock();
+	st = task_schedtune(p);
+	prefer_shallow = st->prefer_shallow;
+	rcu_read_unlock();
+
+	return prefer_shallow;
+}
+
+int schedtune_task_ioprio_class(struct task_struct *p)
+{
+	struct schedtune *st;
+	int ioprio_class;
+
+	if (unlikely(!schedtune_initialized))
+		return IOPRIO_CLASS_NONE;
+
+	rcu_read_lock();
+	st = task_schedtune(p);
+	ioprio_class = READ_ONCE(st->ioprio_class);
+	rcu_read_unlock();
+
+	return ioprio_class;
+}
+
+/*
+ * When the task was moved into its app_launch group, 0 when its group is
+ * not one.
+ */
+unsigned long schedtune_task_launch_time(struct task_struct *p)
+{
+	struct schedtune *st;
+	unsigned long launch_time = 0;
+
+	if (unlikely(!schedtune_initialized))
+		return 0;
+
+	rcu_read_lock();
+	st = task_schedtune(p);
+	if (READ_ONCE(st->app_launch))
+		launch_time = READ_ONCE(p->stune_attach_time);
+	rcu_read_unlock();
+
+	return launch_time;
+}
+
+static u64
+app_launch_read(struct cgroup_subsys_state *css, struct cftype *cft)
+{
+	struct schedtune *st = css_st(css);
+
+	return st->app_launch;
+}
+
+static int
+app_launch_write(struct cgroup_subsys_state *css, struct cftype *cft,
+		 u64 app_launch)
+{
+	struct schedtune *st = css_st(css);
+
+	WRITE_ONCE(st->app_launch, !!app_launch);
+
+	return 0;
+}
+
+static u64
+ioprio_class_read(struct cgroup_subsys_state *css, struct cftype *cft)
+{
+	struct schedtune *st = css_st(css);
+
+	return st->ioprio_class;
+}
+
+static int
+ioprio_class_write(struct cgroup_subsys_state *css, struct cftype *cft,
+		   u64 ioprio_class)
+{
+	struct schedtune *st = css_st(css);
+
+	if (ioprio_class > IOPRIO_CLASS_IDLE)
+		return -EINVAL;
+	WRITE_ONCE(st->ioprio_class, ioprio_class);
+
+	return 0;
+}
+
+static u64
+prefer_shallow_read(struct cgroup_subsys_state *css, struct cftype *cft)
+{
+	struct schedtune *st = css_st(css);
+
+	return st->prefer_shallow;
+}
+
+static int
+prefer_shallow_write(struct cgroup_subsys_state *css, struct cftype *cft,
+		     u64 prefer_shallow)
+{
+	struct schedtune *st = css_st(css);
+	st->prefer_shallow = !!prefer_shallow;
+
+	return 0;
+}
+
 static u64
 prefer_idle_read(struct cgroup_subsys_state *css, struct cftype *cft)
 {
@@ -663,6 +793,7 @@ static void schedtune_attach(struct cgroup_taskset *tset)
 		}
 
 		task->stune_idx = dst_idx;
+		WRITE_ONCE(task->stune_attach_time, jiffies);
 
 		if (!task_on_rq_queued(task)) {
 			raw_spin_unlock(&bg->lock);
@@ -792,6 +923,21 @@ static struct cftype files[] = {
 		.read_u64 = prefer_idle_read,
 		.write_u64 = prefer_idle_write,
 	},
+	{
+		.name = "prefer_shallow",
+		.read_u64 = prefer_shallow_read,
+		.write_u64 = prefer_shallow_write,
+	},
+	{
+		.name = "ioprio_class",
+		.read_u64 = ioprio_class_read,
+		.write_u64 = ioprio_class_write,
+	},
+	{
+		.name = "app_launch",
+		.read_u64 = app_launch_read,
+		.write_u64 = app_launch_write,
+	},
 #ifdef CONFIG_DYNAMIC_STUNE_BOOST
 	{
 		.name = "sched_boost",
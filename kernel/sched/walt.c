@@ -115,6 +115,15 @@ __read_mostly unsigned int sysctl_sched_cpu_high_irqload = TICK_NSEC;
 unsigned int sysctl_sched_walt_rotate_big_tasks;
 unsigned int walt_rotation_enabled;
 
+/*
+ * When set, the window rollover irq work no longer takes every rq lock
+ * to roll all cpus at once. Each cpu rolls its busy time the next time
+ * it accounts anything, and readers of other cpus' sums project them to
+ * the latest window under rq->walt_seq. A window size change still
+ * takes all the locks.
+ */
+__read_mostly unsigned int sysctl_sched_walt_lazy_rollover;
+
 __read_mostly unsigned int sysctl_sched_asym_cap_sibling_freq_match_pct = 100;
 __read_mostly unsigned int sched_ravg_hist_size = 5;
 
@@ -505,7 +514,50 @@ static inline bool should_apply_suh_freq_boost(struct sched_cluster *cluster)
 	return is_cluster_hosting_top_app(cluster);
 }
 
-static inline u64 freq_policy_load(struct rq *rq)
+struct walt_prev_sums {
+	u64 prev_runnable_sum;
+	u64 nt_prev_runnable_sum;
+	u64 grp_prev_runnable_sum;
+	u64 grp_nt_prev_runnable_sum;
+};
+
+/*
+ * Read the busy time of the window before @ws. With lazy rollover a cpu
+ * that has not accounted anything since the last window boundary still
+ * has its sums one or more windows behind: its curr window is then the
+ * one asked for, or nothing ran in it at all.
+ */
+static void walt_read_prev_sums(struct rq *rq, u64 ws,
+				struct walt_prev_sums *s)
+{
+	unsigned int seq;
+	u64 sums_ws;
+
+	do {
+		seq = read_seqcount_begin(&rq->walt_seq);
+		sums_ws = READ_ONCE(rq->walt_sums_ws);
+
+		if (!sysctl_sched_walt_lazy_rollover || sums_ws >= ws) {
+			s->prev_runnable_sum = rq->prev_runnable_sum;
+			s->nt_prev_runnable_sum = rq->nt_prev_runnable_sum;
+			s->grp_prev_runnable_sum =
+					rq->grp_time.prev_runnable_sum;
+			s->grp_nt_prev_runnable_sum =
+					rq->grp_time.nt_prev_runnable_sum;
+		} else if (sums_ws + sched_ravg_window == ws) {
+			s->prev_runnable_sum = rq->curr_runnable_sum;
+			s->nt_prev_runnable_sum = rq->nt_curr_runnable_sum;
+			s->grp_prev_runnable_sum =
+					rq->grp_time.curr_runnable_sum;
+			s->grp_nt_prev_runnable_sum =
+					rq->grp_time.nt_curr_runnable_sum;
+		} else {
+			memset(s, 0, sizeof(*s));
+		}
+	} while (read_seqcount_retry(&rq->walt_seq, seq));
+}
+
+static inline u64 freq_policy_load(struct rq *rq, struct walt_prev_sums *s)
 {
 	unsigned int reporting_policy = sysctl_sched_freq_reporting_policy;
 	struct sched_cluster *cluster = rq->cluster;
@@ -519,9 +571,9 @@ static inline u64 freq_policy_load(struct rq *rq)
 	}
 
 	if (sched_freq_aggr_en)
-		load = rq->prev_runnable_sum + aggr_grp_load;
+		load = s->prev_runnable_sum + aggr_grp_load;
 	else
-		load = rq->prev_runnable_sum + rq->grp_time.prev_runnable_sum;
+		load = s->prev_runnable_sum + s->grp_prev_runnable_sum;
 
 	if (cpu_ksoftirqd && cpu_ksoftirqd->state == TASK_RUNNING)
 		load = max_t(u64, load, task_load(cpu_ksoftirqd));
@@ -563,16 +615,19 @@ __cpu_util_freq_walt(int cpu, struct sched_walt_cpu_load *walt_load)
 	u64 util, util_unboosted;
 	struct rq *rq = cpu_rq(cpu);
 	unsigned long capacity = capacity_orig_of(cpu);
+	struct walt_prev_sums sums;
 	int boost;
 
+	walt_read_prev_sums(rq, atomic64_read(&walt_irq_work_lastq_ws), &sums);
+
 	boost = per_cpu(sched_load_boost, cpu);
-	util_unboosted = util = freq_policy_load(rq);
+	util_unboosted = util = freq_policy_load(rq, &sums);
 	util = div64_u64(util * (100 + boost),
 			walt_cpu_util_freq_divisor);
 
 	if (walt_load) {
-		u64 nl = cpu_rq(cpu)->nt_prev_runnable_sum +
-				rq->grp_time.nt_prev_runnable_sum;
+		u64 nl = sums.nt_prev_runnable_sum +
+				sums.grp_nt_prev_runnable_sum;
 		u64 pl = rq->walt_stats.pred_demands_sum_scaled;
 
 		/* do_pl_notif() needs unboosted signals */
@@ -1013,6 +1068,7 @@ void set_window_start(struct rq *rq)
 
 	if (!sync_cpu_available) {
 		rq->window_start = 1;
+		rq->walt_sums_ws = rq->window_start;
 		sync_cpu_available = 1;
 		atomic64_set(&walt_irq_work_lastq_ws, rq->window_start);
 		walt_load_reported_window =
@@ -1026,6 +1082,7 @@ void set_window_start(struct rq *rq)
 		rq->window_start = sync_rq->window_start;
 		rq->curr_runnable_sum = rq->prev_runnable_sum = 0;
 		rq->nt_curr_runnable_sum = rq->nt_prev_runnable_sum = 0;
+		rq->walt_sums_ws = rq->window_start;
 		raw_spin_unlock(&sync_rq->lock);
 	}
 
@@ -1477,6 +1534,8 @@ static void rollover_cpu_window(struct rq *rq, bool full_window)
 		grp_nt_curr_sum = 0;
 	}
 
+	write_seqcount_begin(&rq->walt_seq);
+	rq->walt_sums_ws = rq->window_start;
 	rq->prev_runnable_sum = curr_sum;
 	rq->nt_prev_runnable_sum = nt_curr_sum;
 	rq->grp_time.prev_runnable_sum = grp_curr_sum;
@@ -1486,6 +1545,11 @@ static void rollover_cpu_window(struct rq *rq, bool full_window)
 	rq->nt_curr_runnable_sum = 0;
 	rq->grp_time.curr_runnable_sum = 0;
 	rq->grp_time.nt_curr_runnable_sum = 0;
+
+	/* Nobody else applies migration subtractions for us any more */
+	if (sysctl_sched_walt_lazy_rollover)
+		account_load_subtractions(rq);
+	write_seqcount_end(&rq->walt_seq);
 }
 
 /*
@@ -3328,17 +3392,24 @@ void walt_irq_work(struct irq_work *irq_work)
 	u64 total_grp_load = 0, min_cluster_grp_load = 0;
 	int level = 0;
 	unsigned long flags;
+	bool lazy;
 
 	/* Am I the window rollover work or the migration work? */
 	if (irq_work == &walt_migration_irq_work)
 		is_migration = true;
 
-	for_each_cpu(cpu, cpu_possible_mask) {
-		if (level == 0)
-			raw_spin_lock(&cpu_rq(cpu)->lock);
-		else
-			raw_spin_lock_nested(&cpu_rq(cpu)->lock, level);
-		level++;
+	lazy = !is_migration && sysctl_sched_walt_lazy_rollover &&
+		READ_ONCE(new_sched_ravg_window) == sched_ravg_window;
+
+	if (!lazy) {
+		for_each_cpu(cpu, cpu_possible_mask) {
+			if (level == 0)
+				raw_spin_lock(&cpu_rq(cpu)->lock);
+			else
+				raw_spin_lock_nested(&cpu_rq(cpu)->lock,
+						     level);
+			level++;
+		}
 	}
 
 	wc = sched_ktime_clock();
@@ -3350,7 +3421,13 @@ void walt_irq_work(struct irq_work *irq_work)
 
 		for_each_cpu(cpu, &cluster->cpus) {
 			rq = cpu_rq(cpu);
-			if (rq->curr) {
+			if (lazy) {
+				struct walt_prev_sums sums;
+
+				walt_read_prev_sums(rq,
+					walt_load_reported_window, &sums);
+				aggr_grp_load += sums.grp_prev_runnable_sum;
+			} else if (rq->curr) {
 				update_task_ravg(rq->curr, rq,
 						TASK_UPDATE, wc, 0);
 				account_load_subtractions(rq);
@@ -3424,7 +3501,7 @@ void walt_irq_work(struct irq_work *irq_work)
 	 * If the window change request is in pending, good place to
 	 * change sched_ravg_window since all rq locks are acquired.
 	 */
-	if (!is_migration) {
+	if (!is_migration && !lazy) {
 		spin_lock_irqsave(&sched_ravg_window_lock, flags);
 
 		if (sched_ravg_window != new_sched_ravg_window) {
@@ -3439,8 +3516,10 @@ void walt_irq_work(struct irq_work *irq_work)
 		spin_unlock_irqrestore(&sched_ravg_window_lock, flags);
 	}
 
-	for_each_cpu(cpu, cpu_possible_mask)
-		raw_spin_unlock(&cpu_rq(cpu)->lock);
+	if (!lazy) {
+		for_each_cpu(cpu, cpu_possible_mask)
+			raw_spin_unlock(&cpu_rq(cpu)->lock);
+	}
 
 	if (!is_migration)
 		core_ctl_check(this_rq()->window_start);
@@ -3587,6 +3666,8 @@ void walt_sched_init_rq(struct rq *rq)
 	rq->walt_stats.cumulative_runnable_avg_scaled = 0;
 	rq->prev_window_size = sched_ravg_window;
 	rq->window_start = 0;
+	rq->walt_sums_ws = 0;
+	seqcount_init(&rq->walt_seq);
 	rq->walt_stats.nr_big_tasks = 0;
 	rq->walt_flags = 0;
 	rq->cur_irqload = 0;
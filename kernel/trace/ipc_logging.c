@@ -39,6 +39,8 @@ static LIST_HEAD(ipc_log_context_list);
 static DEFINE_RWLOCK(context_list_lock_lha1);
 static void *get_deserialization_func(struct ipc_log_context *ilctxt,
 				      int type);
+static inline int tsv_write_header(struct encode_context *ectxt,
+				   uint32_t type, uint32_t size);
 
 static struct ipc_log_page *get_first_page(struct ipc_log_context *ilctxt)
 {
@@ -282,55 +284,269 @@ static void msg_drop(struct ipc_log_context *ilctxt)
 }
 
 /*
- * Commits messages to the FIFO.  If the FIFO is full, then enough
- * messages are dropped to create space for the new message.
+ * Copies one encoded message into the log pages.  If the FIFO is full,
+ * then enough messages are dropped to create space for the new message.
+ *
+ * Called with context_lock_lhb1 held.
  */
-void ipc_log_write(void *ctxt, struct encode_context *ectxt)
+static void ipc_log_commit(struct ipc_log_context *ilctxt,
+			   const char *buff, int len)
 {
-	struct ipc_log_context *ilctxt = (struct ipc_log_context *)ctxt;
 	int bytes_to_write;
-	unsigned long flags;
 
-	if (!ilctxt || !ectxt) {
-		pr_err("%s: Invalid ipc_log or encode context\n", __func__);
-		return;
-	}
-
-	read_lock_irqsave(&context_list_lock_lha1, flags);
-	spin_lock(&ilctxt->context_lock_lhb1);
-	while (ilctxt->write_avail <= ectxt->offset)
+	while (ilctxt->write_avail <= len)
 		msg_drop(ilctxt);
 
 	bytes_to_write = MIN(LOG_PAGE_DATA_SIZE
 				- ilctxt->write_page->hdr.write_offset,
-				ectxt->offset);
+				len);
 	memcpy((ilctxt->write_page->data +
 		ilctxt->write_page->hdr.write_offset),
-		ectxt->buff, bytes_to_write);
+		buff, bytes_to_write);
 
-	if (bytes_to_write != ectxt->offset) {
+	if (bytes_to_write != len) {
 		uint64_t t_now = sched_clock();
 
 		ilctxt->write_page->hdr.write_offset += bytes_to_write;
 		ilctxt->write_page->hdr.end_time = t_now;
 
 		ilctxt->write_page = get_next_page(ilctxt, ilctxt->write_page);
-		if (WARN_ON(ilctxt->write_page == NULL)) {
-			spin_unlock(&ilctxt->context_lock_lhb1);
-			read_unlock_irqrestore(&context_list_lock_lha1, flags);
+		if (WARN_ON(ilctxt->write_page == NULL))
 			return;
-		}
 		ilctxt->write_page->hdr.write_offset = 0;
 		ilctxt->write_page->hdr.start_time = t_now;
 		memcpy((ilctxt->write_page->data +
 			ilctxt->write_page->hdr.write_offset),
-		       (ectxt->buff + bytes_to_write),
-		       (ectxt->offset - bytes_to_write));
-		bytes_to_write = (ectxt->offset - bytes_to_write);
+		       (buff + bytes_to_write),
+		       (len - bytes_to_write));
+		bytes_to_write = (len - bytes_to_write);
 	}
 	ilctxt->write_page->hdr.write_offset += bytes_to_write;
-	ilctxt->write_avail -= ectxt->offset;
+	ilctxt->write_avail -= len;
 	complete(&ilctxt->read_avail);
+}
+
+#ifdef CONFIG_IPC_LOGGING_PERCPU
+/*
+ * Writers only append to the staging buffer of their own CPU, so the
+ * per-CPU lock is uncontended except against a flush swapping buffers.
+ * The flush is kicked when a buffer goes from empty to non-empty; at
+ * high rates it is already pending and nothing more is queued.
+ */
+static void ipc_log_pcpu_write(struct ipc_log_context *ilctxt,
+			       struct encode_context *ectxt)
+{
+	int need = IPC_LOG_PCPU_REC_LEN(ectxt->offset);
+	struct ipc_log_pcpu_rec *rec;
+	struct ipc_log_pcpu_buf *buf;
+	struct ipc_log_pcpu *pc;
+	unsigned long flags;
+	bool kick;
+
+	local_irq_save(flags);
+	pc = this_cpu_ptr(ilctxt->pcpu);
+	raw_spin_lock(&pc->lock);
+	buf = pc->active;
+	if (buf->len + need > IPC_LOG_PCPU_BUF_SIZE) {
+		raw_spin_unlock(&pc->lock);
+		local_irq_restore(flags);
+		atomic_inc(&ilctxt->pcpu_dropped);
+		irq_work_queue(&ilctxt->flush_irq_work);
+		return;
+	}
+
+	rec = (struct ipc_log_pcpu_rec *)(buf->data + buf->len);
+	rec->stamp = sched_clock();
+	rec->size = ectxt->offset;
+	memcpy(rec + 1, ectxt->buff, ectxt->offset);
+	kick = !buf->len;
+	buf->len += need;
+	raw_spin_unlock(&pc->lock);
+	local_irq_restore(flags);
+
+	if (kick)
+		irq_work_queue(&ilctxt->flush_irq_work);
+}
+
+/*
+ * Leaves a note in the log pages where messages went missing.  This is
+ * committed directly: going through staging would kick another flush,
+ * which must not happen while the context is torn down.
+ */
+static void ipc_log_pcpu_note_drops(struct ipc_log_context *ilctxt,
+				    int dropped)
+{
+	struct encode_context ectxt;
+	int data_size, hdr_size = sizeof(struct tsv_header);
+	unsigned long flags;
+
+	msg_encode_start(&ectxt, TSV_TYPE_STRING);
+	tsv_timestamp_write(&ectxt);
+	tsv_qtimer_write(&ectxt);
+	data_size = scnprintf((ectxt.buff + ectxt.offset + hdr_size),
+			      (MAX_MSG_SIZE - (ectxt.offset + hdr_size)),
+			      "ipc_logging: %d messages dropped", dropped);
+	tsv_write_header(&ectxt, TSV_TYPE_BYTE_ARRAY, data_size);
+	ectxt.offset += data_size;
+	msg_encode_end(&ectxt);
+
+	read_lock_irqsave(&context_list_lock_lha1, flags);
+	spin_lock(&ilctxt->context_lock_lhb1);
+	ipc_log_commit(ilctxt, ectxt.buff, ectxt.offset);
+	spin_unlock(&ilctxt->context_lock_lhb1);
+	read_unlock_irqrestore(&context_list_lock_lha1, flags);
+}
+
+/*
+ * Merges the staged messages of all CPUs into the log pages, oldest
+ * first.  The context lock is only held for one message at a time so
+ * interrupt latency stays what it was for a direct write.
+ */
+static void ipc_log_pcpu_flush(struct ipc_log_context *ilctxt)
+{
+	struct ipc_log_pcpu_rec *rec, *best;
+	struct ipc_log_pcpu *pc, *best_pc;
+	unsigned long flags;
+	int cpu, dropped;
+
+	mutex_lock(&ilctxt->flush_lock);
+	for_each_possible_cpu(cpu) {
+		pc = per_cpu_ptr(ilctxt->pcpu, cpu);
+		raw_spin_lock_irqsave(&pc->lock, flags);
+		pc->drain = pc->active;
+		pc->active = (pc->active == &pc->bufs[0]) ?
+				&pc->bufs[1] : &pc->bufs[0];
+		raw_spin_unlock_irqrestore(&pc->lock, flags);
+		pc->drain_off = 0;
+	}
+
+	for (;;) {
+		best = NULL;
+		best_pc = NULL;
+		for_each_possible_cpu(cpu) {
+			pc = per_cpu_ptr(ilctxt->pcpu, cpu);
+			if (pc->drain_off >= pc->drain->len)
+				continue;
+			rec = (struct ipc_log_pcpu_rec *)
+				(pc->drain->data + pc->drain_off);
+			if (!best || rec->stamp < best->stamp) {
+				best = rec;
+				best_pc = pc;
+			}
+		}
+		if (!best)
+			break;
+
+		read_lock_irqsave(&context_list_lock_lha1, flags);
+		spin_lock(&ilctxt->context_lock_lhb1);
+		ipc_log_commit(ilctxt, (const char *)(best + 1), best->size);
+		spin_unlock(&ilctxt->context_lock_lhb1);
+		read_unlock_irqrestore(&context_list_lock_lha1, flags);
+		best_pc->drain_off += IPC_LOG_PCPU_REC_LEN(best->size);
+	}
+
+	/* drained buffers are only handed back to writers by the next swap */
+	for_each_possible_cpu(cpu)
+		per_cpu_ptr(ilctxt->pcpu, cpu)->drain->len = 0;
+
+	dropped = atomic_read(&ilctxt->pcpu_dropped) - ilctxt->pcpu_reported;
+	if (dropped) {
+		ilctxt->pcpu_reported += dropped;
+		ipc_log_pcpu_note_drops(ilctxt, dropped);
+	}
+	mutex_unlock(&ilctxt->flush_lock);
+}
+
+static void ipc_log_pcpu_flush_work(struct work_struct *work)
+{
+	struct ipc_log_context *ilctxt = container_of(work,
+				struct ipc_log_context, flush_work);
+
+	ipc_log_pcpu_flush(ilctxt);
+}
+
+static void ipc_log_pcpu_irq_work(struct irq_work *work)
+{
+	struct ipc_log_context *ilctxt = container_of(work,
+				struct ipc_log_context, flush_irq_work);
+
+	schedule_work(&ilctxt->flush_work);
+}
+
+static int ipc_log_pcpu_init(struct ipc_log_context *ilctxt)
+{
+	struct ipc_log_pcpu *pc;
+	int cpu;
+
+	ilctxt->pcpu = alloc_percpu(struct ipc_log_pcpu);
+	if (!ilctxt->pcpu)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		pc = per_cpu_ptr(ilctxt->pcpu, cpu);
+		raw_spin_lock_init(&pc->lock);
+		pc->active = &pc->bufs[0];
+		pc->drain = &pc->bufs[1];
+	}
+	init_irq_work(&ilctxt->flush_irq_work, ipc_log_pcpu_irq_work);
+	INIT_WORK(&ilctxt->flush_work, ipc_log_pcpu_flush_work);
+	mutex_init(&ilctxt->flush_lock);
+	atomic_set(&ilctxt->pcpu_dropped, 0);
+	return 0;
+}
+
+static void ipc_log_pcpu_exit(struct ipc_log_context *ilctxt)
+{
+	if (!ilctxt->pcpu)
+		return;
+
+	irq_work_sync(&ilctxt->flush_irq_work);
+	cancel_work_sync(&ilctxt->flush_work);
+	free_percpu(ilctxt->pcpu);
+	ilctxt->pcpu = NULL;
+}
+#else
+static inline void ipc_log_pcpu_write(struct ipc_log_context *ilctxt,
+				      struct encode_context *ectxt)
+{
+}
+
+static inline void ipc_log_pcpu_flush(struct ipc_log_context *ilctxt)
+{
+}
+
+static inline int ipc_log_pcpu_init(struct ipc_log_context *ilctxt)
+{
+	return 0;
+}
+
+static inline void ipc_log_pcpu_exit(struct ipc_log_context *ilctxt)
+{
+}
+#endif
+
+/*
+ * Commits messages to the FIFO.  If the FIFO is full, then enough
+ * messages are dropped to create space for the new message.
+ */
+void ipc_log_write(void *ctxt, struct encode_context *ectxt)
+{
+	struct ipc_log_context *ilctxt = (struct ipc_log_context *)ctxt;
+	unsigned long flags;
+
+	if (!ilctxt || !ectxt) {
+		pr_err("%s: Invalid ipc_log or encode context\n", __func__);
+		return;
+	}
+
+	if (IS_ENABLED(CONFIG_IPC_LOGGING_PERCPU)) {
+		ipc_log_pcpu_write(ilctxt, ectxt);
+		return;
+	}
+
+	read_lock_irqsave(&context_list_lock_lha1, flags);
+	spin_lock(&ilctxt->context_lock_lhb1);
+	ipc_log_commit(ilctxt, ectxt->buff, ectxt->offset);
 	spin_unlock(&ilctxt->context_lock_lhb1);
 	read_unlock_irqrestore(&context_list_lock_lha1, flags);
 }
@@ -553,6 +769,9 @@ int ipc_log_extract(void *ctxt, char *buff, int size)
 	if (size < MAX_MSG_DECODED_SIZE)
 		return -EINVAL;
 
+	/* merge-on-read: bring in whatever is still staged per-CPU */
+	ipc_log_pcpu_flush(ilctxt);
+
 	dctxt.output_format = OUTPUT_DEBUGFS;
 	dctxt.buff = buff;
 	dctxt.size = size;
@@ -858,6 +1077,8 @@ void *ipc_log_context_create(int max_num_pages,
 	ctxt->header_size = sizeof(struct ipc_log_page_header);
 	kref_init(&ctxt->refcount);
 	ctxt->destroyed = false;
+	if (ipc_log_pcpu_init(ctxt))
+		goto release_ipc_log_context;
 	create_ctx_debugfs(ctxt, mod_name);
 
 	/* set magic last to signal context init is complete */
@@ -886,6 +1107,8 @@ void ipc_log_context_free(struct kref *kref)
 				struct ipc_log_context, refcount);
 	struct ipc_log_page *pg = NULL;
 
+	ipc_log_pcpu_exit(ilctxt);
+
 	while (!list_empty(&ilctxt->page_list)) {
 		pg = get_first_page(ilctxt);
 		list_del(&pg->hdr.list);
@@ -197,6 +197,10 @@ void create_ctx_debugfs(struct ipc_log_context *ctxt,
 				     ctxt, &debug_ops);
 			debug_create("log_cont", 0444, ctxt->dent,
 				     ctxt, &debug_ops_cont);
+#ifdef CONFIG_IPC_LOGGING_PERCPU
+			debugfs_create_atomic_t("dropped", 0444, ctxt->dent,
+						&ctxt->pcpu_dropped);
+#endif
 		}
 	}
 	add_deserialization_func((void *)ctxt,
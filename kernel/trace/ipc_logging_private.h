@@ -14,6 +14,10 @@
 #define _IPC_LOGGING_PRIVATE_H
 
 #include <linux/ipc_logging.h>
+#include <linux/irq_work.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/workqueue.h>
 
 #define IPC_LOG_VERSION 0x0003
 #define IPC_LOG_MAX_CONTEXT_NAME_LEN 32
@@ -70,6 +74,48 @@ struct ipc_log_page {
 	char data[PAGE_SIZE - sizeof(struct ipc_log_page_header)];
 };
 
+#ifdef CONFIG_IPC_LOGGING_PERCPU
+#define IPC_LOG_PCPU_BUF_SIZE 2048
+
+/**
+ * struct ipc_log_pcpu_rec - Staged message record
+ *
+ * @stamp:  Scheduler clock when the message was written
+ * @size:  Size of the encoded message that follows the record
+ */
+struct ipc_log_pcpu_rec {
+	uint64_t stamp;
+	uint16_t size;
+};
+
+#define IPC_LOG_PCPU_REC_LEN(size) \
+	ALIGN(sizeof(struct ipc_log_pcpu_rec) + (size), \
+	      sizeof(uint64_t))
+
+struct ipc_log_pcpu_buf {
+	uint16_t len;
+	char data[IPC_LOG_PCPU_BUF_SIZE] __aligned(sizeof(uint64_t));
+};
+
+/**
+ * struct ipc_log_pcpu - Per-CPU staging area of a logging context
+ *
+ * @lock:  Protects @active, only ever taken by the owning CPU and the
+ *         flush work
+ * @active:  Buffer that writers on this CPU append to
+ * @drain:  Buffer being merged into the log pages by the flush work
+ * @drain_off:  Merge position in @drain
+ * @bufs:  The two buffers swapped between @active and @drain
+ */
+struct ipc_log_pcpu {
+	raw_spinlock_t lock;
+	struct ipc_log_pcpu_buf *active;
+	struct ipc_log_pcpu_buf *drain;
+	uint16_t drain_off;
+	struct ipc_log_pcpu_buf bufs[2];
+};
+#endif
+
 /**
  * struct ipc_log_context - main logging context
  *
@@ -95,6 +141,13 @@ struct ipc_log_page {
  * @dfunc_info_list:  List of deserialization functions
  * @context_lock_lhb1:  Lock for entire structure
  * @read_avail:  Completed when new data is added to the log
+ *
+ * @pcpu:  Per-CPU staging areas written without the context lock
+ * @flush_irq_work:  Kicks @flush_work from any writer context
+ * @flush_work:  Merges the staged messages into the log pages
+ * @flush_lock:  Serializes merging between @flush_work and readers
+ * @pcpu_dropped:  Messages dropped because a staging area was full
+ * @pcpu_reported:  Part of @pcpu_dropped already noted in the log
  */
 struct ipc_log_context {
 	uint32_t magic;
@@ -121,6 +174,14 @@ struct ipc_log_context {
 	struct completion read_avail;
 	struct kref refcount;
 	bool destroyed;
+#ifdef CONFIG_IPC_LOGGING_PERCPU
+	struct ipc_log_pcpu __percpu *pcpu;
+	struct irq_work flush_irq_work;
+	struct work_struct flush_work;
+	struct mutex flush_lock;
+	atomic_t pcpu_dropped;
+	int pcpu_reported;
+#endif
 };
 
 struct dfunc_info {
@@ -25,8 +25,13 @@
 #include <linux/of.h>
 #include <linux/of_address.h>
 #include <linux/io.h>
+#include <linux/kallsyms.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/vmalloc.h>
 #include <asm-generic/sizes.h>
 #include <linux/msm_rtb.h>
+#include <asm/sections.h>
 #include <asm/timex.h>
 #include <soc/qcom/minidump.h>
 
@@ -36,6 +41,21 @@
 
 #define RTB_COMPAT_STR	"qcom,msm-rtb"
 
+/*
+ * readl/writel events can be restricted to physical address ranges and
+ * to calling functions. Both are looked up in bitmaps built when the
+ * filter is set: the physical map covers the low 4GB in 64KB granules,
+ * the caller map covers kernel text in 32 byte granules.
+ */
+#define RTB_PHYS_SHIFT		16
+#define RTB_PHYS_LIMIT		(1ULL << 32)
+#define RTB_PHYS_BITS		(RTB_PHYS_LIMIT >> RTB_PHYS_SHIFT)
+#define RTB_CALLER_SHIFT	5
+#define RTB_FILTER_LEN		256
+
+#define RTB_FILTER_PHYS		BIT(0)
+#define RTB_FILTER_CALLER	BIT(1)
+
 /* Write
  * 1) 3 bytes sentinel
  * 2) 1 bytes of log type
@@ -67,6 +87,8 @@ struct msm_rtb_state {
 	int initialized;
 	uint32_t filter;
 	int step_size;
+	unsigned int io_filter;
+	unsigned int sample_rate;
 };
 
 #if defined(CONFIG_QCOM_RTB_SEPARATE_CPUS)
@@ -80,8 +102,197 @@ static struct msm_rtb_state msm_rtb = {
 	.enabled = 1,
 };
 
+static DECLARE_BITMAP(msm_rtb_phys_map, RTB_PHYS_BITS);
+static unsigned long *msm_rtb_caller_map;
+static char msm_rtb_phys_str[RTB_FILTER_LEN];
+static char msm_rtb_caller_str[RTB_FILTER_LEN];
+static DEFINE_MUTEX(msm_rtb_filter_lock);
+static DEFINE_PER_CPU(unsigned int, msm_rtb_sample_cnt);
+
+/*
+ * phys_filter is a comma separated list of size@start ranges, as for
+ * memmap=. Only the low 4GB can be selected.
+ */
+static int msm_rtb_apply_phys_filter(void)
+{
+	char buf[RTB_FILTER_LEN], *cur = buf, *tok, *p;
+	unsigned long long start, size;
+	bool any = false;
+
+	WRITE_ONCE(msm_rtb.io_filter, msm_rtb.io_filter & ~RTB_FILTER_PHYS);
+	bitmap_zero(msm_rtb_phys_map, RTB_PHYS_BITS);
+
+	strlcpy(buf, msm_rtb_phys_str, sizeof(buf));
+	while ((tok = strsep(&cur, ",")) != NULL) {
+		tok = strim(tok);
+		if (!*tok)
+			continue;
+
+		size = memparse(tok, &p);
+		if (!size || *p != '@')
+			return -EINVAL;
+		start = memparse(p + 1, &p);
+		if (*p || start + size < start || start + size > RTB_PHYS_LIMIT)
+			return -EINVAL;
+
+		bitmap_set(msm_rtb_phys_map, start >> RTB_PHYS_SHIFT,
+			   ((start + size - 1) >> RTB_PHYS_SHIFT) -
+			   (start >> RTB_PHYS_SHIFT) + 1);
+		any = true;
+	}
+
+	if (any)
+		WRITE_ONCE(msm_rtb.io_filter,
+			   msm_rtb.io_filter | RTB_FILTER_PHYS);
+	return 0;
+}
+
+struct msm_rtb_caller_match {
+	const char *name;
+	size_t len;
+	bool prefix;
+	int found;
+	unsigned long *map;
+	unsigned long nbits;
+};
+
+static int msm_rtb_mark_caller(void *data, const char *name,
+			       struct module *mod, unsigned long addr)
+{
+	struct msm_rtb_caller_match *m = data;
+	unsigned long size, offset, first, last;
+
+	if (mod || addr < (unsigned long)_stext ||
+	    addr >= (unsigned long)_etext)
+		return 0;
+
+	if (m->prefix ? strncmp(name, m->name, m->len) :
+			strcmp(name, m->name))
+		return 0;
+
+	if (!kallsyms_lookup_size_offset(addr, &size, &offset) || !size)
+		return 0;
+
+	first = (addr - (unsigned long)_stext) >> RTB_CALLER_SHIFT;
+	last = (addr + size - 1 - (unsigned long)_stext) >> RTB_CALLER_SHIFT;
+	if (last >= m->nbits)
+		last = m->nbits - 1;
+	bitmap_set(m->map, first, last - first + 1);
+	m->found++;
+	return 0;
+}
+
+/*
+ * caller_filter is a comma separated list of kernel functions. A name
+ * ending in '*' selects every function with that prefix, which is the
+ * usual way to pick a whole driver, e.g. "ufshcd_*".
+ */
+static int msm_rtb_apply_caller_filter(void)
+{
+	char buf[RTB_FILTER_LEN], *cur = buf, *tok;
+	struct msm_rtb_caller_match m;
+	bool any = false;
+
+	WRITE_ONCE(msm_rtb.io_filter, msm_rtb.io_filter & ~RTB_FILTER_CALLER);
+
+	m.nbits = (((unsigned long)_etext - (unsigned long)_stext) >>
+		   RTB_CALLER_SHIFT) + 1;
+	m.map = msm_rtb_caller_map;
+
+	strlcpy(buf, msm_rtb_caller_str, sizeof(buf));
+	while ((tok = strsep(&cur, ",")) != NULL) {
+		tok = strim(tok);
+		if (!*tok)
+			continue;
+
+		if (!m.map) {
+			/* never freed, readers run without any lock */
+			m.map = vzalloc(BITS_TO_LONGS(m.nbits) *
+					sizeof(unsigned long));
+			if (!m.map)
+				return -ENOMEM;
+			WRITE_ONCE(msm_rtb_caller_map, m.map);
+		} else if (!any) {
+			bitmap_zero(m.map, m.nbits);
+		}
+
+		m.name = tok;
+		m.len = strlen(tok);
+		m.prefix = tok[m.len - 1] == '*';
+		if (m.prefix)
+			m.len--;
+		if (!m.len)
+			return -EINVAL;
+		m.found = 0;
+
+		kallsyms_on_each_symbol(msm_rtb_mark_caller, &m);
+		if (!m.found)
+			return -EINVAL;
+		any = true;
+	}
+
+	if (any) {
+		smp_wmb();
+		WRITE_ONCE(msm_rtb.io_filter,
+			   msm_rtb.io_filter | RTB_FILTER_CALLER);
+	}
+	return 0;
+}
+
+static int msm_rtb_apply_filters(void)
+{
+	int ret;
+
+	ret = msm_rtb_apply_phys_filter();
+	if (ret)
+		return ret;
+
+	return msm_rtb_apply_caller_filter();
+}
+
+/*
+ * Filters given on the command line are only resolved once the driver
+ * probes; until then every event is logged as before.
+ */
+static int msm_rtb_filter_set(const char *val, const struct kernel_param *kp)
+{
+	char old[RTB_FILTER_LEN];
+	char *str = kp->arg;
+	int ret = 0;
+
+	if (strlen(val) >= RTB_FILTER_LEN)
+		return -ENOSPC;
+
+	mutex_lock(&msm_rtb_filter_lock);
+	strlcpy(old, str, sizeof(old));
+	strlcpy(str, val, RTB_FILTER_LEN);
+	if (msm_rtb.initialized) {
+		ret = msm_rtb_apply_filters();
+		if (ret) {
+			strlcpy(str, old, RTB_FILTER_LEN);
+			msm_rtb_apply_filters();
+		}
+	}
+	mutex_unlock(&msm_rtb_filter_lock);
+
+	return ret;
+}
+
+static int msm_rtb_filter_get(char *buffer, const struct kernel_param *kp)
+{
+	return scnprintf(buffer, PAGE_SIZE, "%s\n", (char *)kp->arg);
+}
+
+static const struct kernel_param_ops msm_rtb_filter_ops = {
+	.set = msm_rtb_filter_set,
+	.get = msm_rtb_filter_get,
+};
+
 module_param_named(filter, msm_rtb.filter, uint, 0644);
 module_param_named(enable, msm_rtb.enabled, int, 0644);
+module_param_cb(phys_filter, &msm_rtb_filter_ops, msm_rtb_phys_str, 0644);
+module_param_cb(caller_filter, &msm_rtb_filter_ops, msm_rtb_caller_str, 0644);
+module_param_named(sample_rate, msm_rtb.sample_rate, uint, 0644);
 
 static int msm_rtb_panic_notifier(struct notifier_block *this,
 					unsigned long event, void *ptr)
@@ -102,6 +313,67 @@ int notrace msm_rtb_event_should_log(enum logk_event_type log_type)
 }
 EXPORT_SYMBOL(msm_rtb_event_should_log);
 
+static bool notrace msm_rtb_io_phys_match(void *addr)
+{
+	u64 phys;
+
+	if (!is_vmalloc_addr(addr))
+		return false;
+
+	phys = ((u64)vmalloc_to_pfn(addr) << PAGE_SHIFT) |
+		offset_in_page(addr);
+	if (phys >= RTB_PHYS_LIMIT)
+		return false;
+
+	return test_bit(phys >> RTB_PHYS_SHIFT, msm_rtb_phys_map);
+}
+
+static bool notrace msm_rtb_io_caller_match(void *caller)
+{
+	unsigned long pc = (unsigned long)caller;
+	unsigned long *map = READ_ONCE(msm_rtb_caller_map);
+
+	if (!map || pc < (unsigned long)_stext ||
+	    pc >= (unsigned long)_etext)
+		return false;
+
+	return test_bit((pc - (unsigned long)_stext) >> RTB_CALLER_SHIFT,
+			map);
+}
+
+/*
+ * Address/caller filters and sampling only apply to readl/writel. With
+ * sample_rate N > 1 one in N of the accesses passing the filters on a
+ * cpu is logged.
+ */
+static bool notrace msm_rtb_io_should_log(enum logk_event_type log_type,
+					  void *caller, void *data)
+{
+	unsigned int filter = READ_ONCE(msm_rtb.io_filter);
+	unsigned int rate = READ_ONCE(msm_rtb.sample_rate);
+	int type = log_type & ~LOGTYPE_NOPC;
+
+	if (likely(!filter && rate <= 1))
+		return true;
+
+	if (type != LOGK_READL && type != LOGK_WRITEL)
+		return true;
+
+	if ((filter & RTB_FILTER_CALLER) && !msm_rtb_io_caller_match(caller))
+		return false;
+
+	if ((filter & RTB_FILTER_PHYS) && !msm_rtb_io_phys_match(data))
+		return false;
+
+	if (rate > 1) {
+		if (this_cpu_inc_return(msm_rtb_sample_cnt) < rate)
+			return false;
+		this_cpu_write(msm_rtb_sample_cnt, 0);
+	}
+
+	return true;
+}
+
 static void msm_rtb_emit_sentinel(struct msm_rtb_layout *start)
 {
 	start->sentinel[0] = SENTINEL_BYTE_1;
@@ -226,6 +498,9 @@ int notrace uncached_logk_pc(enum logk_event_type log_type, void *caller,
 	if (!msm_rtb_event_should_log(log_type))
 		return 0;
 
+	if (!msm_rtb_io_should_log(log_type, caller, data))
+		return 0;
+
 	i = msm_rtb_get_idx();
 	uncached_logk_pc_idx(log_type, (uint64_t)((unsigned long) caller),
 				(uint64_t)((unsigned long) data), i);
@@ -316,7 +591,12 @@ static int msm_rtb_probe(struct platform_device *pdev)
 
 	atomic_notifier_chain_register(&panic_notifier_list,
 						&msm_rtb_panic_blk);
+
+	mutex_lock(&msm_rtb_filter_lock);
+	if (msm_rtb_apply_filters())
+		pr_err("msm_rtb: invalid I/O filter ignored\n");
 	msm_rtb.initialized = 1;
+	mutex_unlock(&msm_rtb_filter_lock);
 	return 0;
 }
 
@@ -1918,6 +1918,34 @@ static inline int tracing_alloc_snapshot_instance(struct trace_array *tr)
 
 extern struct trace_iterator *tracepoint_print_iter;
 
+enum lat_hist_type {
+	LAT_HIST_WAKEUP,
+	LAT_HIST_IRQSOFF,
+	LAT_HIST_PREEMPTOFF,
+	LAT_HIST_MAX,
+};
+
+#ifdef CONFIG_LATENCY_HIST
+extern struct static_key_false lat_hist_keys[LAT_HIST_MAX];
+void __lat_hist_start(enum lat_hist_type type);
+void __lat_hist_stop(enum lat_hist_type type);
+
+static __always_inline void lat_hist_start(enum lat_hist_type type)
+{
+	if (static_branch_unlikely(&lat_hist_keys[type]))
+		__lat_hist_start(type);
+}
+
+static __always_inline void lat_hist_stop(enum lat_hist_type type)
+{
+	if (static_branch_unlikely(&lat_hist_keys[type]))
+		__lat_hist_stop(type);
+}
+#else
+static inline void lat_hist_start(enum lat_hist_type type) { }
+static inline void lat_hist_stop(enum lat_hist_type type) { }
+#endif
+
 /*
  * Reset the state of the trace_iterator so that it can read consumed data.
  * Normally, the trace_iterator is used for reading the data when it is not
@@ -830,6 +830,7 @@ void trace_hardirqs_on(void)
 
 	trace_irq_enable_rcuidle(CALLER_ADDR0, CALLER_ADDR1);
 	tracer_hardirqs_on();
+	lat_hist_stop(LAT_HIST_IRQSOFF);
 
 	this_cpu_write(tracing_irq_cpu, 0);
 }
@@ -842,6 +843,7 @@ void trace_hardirqs_off(void)
 
 	this_cpu_write(tracing_irq_cpu, 1);
 
+	lat_hist_start(LAT_HIST_IRQSOFF);
 	trace_irq_disable_rcuidle(CALLER_ADDR0, CALLER_ADDR1);
 	tracer_hardirqs_off();
 }
@@ -854,6 +856,7 @@ __visible void trace_hardirqs_on_caller(unsigned long caller_addr)
 
 	trace_irq_enable_rcuidle(CALLER_ADDR0, caller_addr);
 	tracer_hardirqs_on_caller(caller_addr);
+	lat_hist_stop(LAT_HIST_IRQSOFF);
 
 	this_cpu_write(tracing_irq_cpu, 0);
 }
@@ -866,6 +869,7 @@ __visible void trace_hardirqs_off_caller(unsigned long caller_addr)
 
 	this_cpu_write(tracing_irq_cpu, 1);
 
+	lat_hist_start(LAT_HIST_IRQSOFF);
 	trace_irq_disable_rcuidle(CALLER_ADDR0, caller_addr);
 	tracer_hardirqs_off_caller(caller_addr);
 }
@@ -894,10 +898,12 @@ void trace_preempt_on(unsigned long a0, unsigned long a1)
 {
 	trace_preempt_enable_rcuidle(a0, a1);
 	tracer_preempt_on(a0, a1);
+	lat_hist_stop(LAT_HIST_PREEMPTOFF);
 }
 
 void trace_preempt_off(unsigned long a0, unsigned long a1)
 {
+	lat_hist_start(LAT_HIST_PREEMPTOFF);
 	trace_preempt_disable_rcuidle(a0, a1);
 	tracer_preempt_off(a0, a1);
 }
@@ -0,0 +1,316 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Per-cpu latency histograms for wakeup-to-run, irqs-off and
+ * preemption-off sections.
+ *
+ * The histogram triggers are built on tracing_map, which is shared by
+ * all cpus and costs a lookup per event. These latencies are hit far too
+ * often for that, so each one gets a fixed log2 histogram per cpu that
+ * is only ever written by its own cpu and summed up when read:
+ *
+ *   latency_hist/<type>/enable	- 0/1, off by default
+ *   latency_hist/<type>/hist	- summed histogram
+ *   latency_hist/<type>/reset	- write anything to clear
+ */
+#include <linux/uaccess.h>
+#include <linux/seq_file.h>
+#include <linux/trace_clock.h>
+#include <linux/tracefs.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <trace/events/sched.h>
+
+#include "trace.h"
+
+/* Bucket i holds latencies in [2^(i-1), 2^i) ns, the last one the rest */
+#define LAT_HIST_BUCKETS	40
+
+struct lat_hist_cpu {
+	u64	bucket[LAT_HIST_BUCKETS];
+	u64	sum;
+	u64	max;
+};
+
+static const char *const lat_hist_names[LAT_HIST_MAX] = {
+	[LAT_HIST_WAKEUP]	= "wakeup",
+	[LAT_HIST_IRQSOFF]	= "irqsoff",
+	[LAT_HIST_PREEMPTOFF]	= "preemptoff",
+};
+
+DEFINE_STATIC_KEY_ARRAY_FALSE(lat_hist_keys, LAT_HIST_MAX);
+
+static DEFINE_PER_CPU(struct lat_hist_cpu, lat_hist_data[LAT_HIST_MAX]);
+/* Start of the current irqs-off and preemption-off section */
+static DEFINE_PER_CPU(u64, lat_hist_ts[LAT_HIST_MAX]);
+/* Timestamps older than this were taken before the last enable */
+static u64 lat_hist_epoch[LAT_HIST_MAX];
+static DEFINE_MUTEX(lat_hist_mutex);
+
+static void lat_hist_record(enum lat_hist_type type, u64 delta)
+{
+	struct lat_hist_cpu *h = this_cpu_ptr(&lat_hist_data[type]);
+	unsigned int i;
+
+	i = min_t(unsigned int, fls64(delta), LAT_HIST_BUCKETS - 1);
+	h->bucket[i]++;
+	h->sum += delta;
+	if (delta > h->max)
+		h->max = delta;
+}
+
+/*
+ * Both hooks run with irqs or preemption disabled, so neither can
+ * migrate, and the only update of a given cpu's histogram that can
+ * interrupt them is one of a different type.
+ */
+void __lat_hist_start(enum lat_hist_type type)
+{
+	this_cpu_write(lat_hist_ts[type], trace_clock_local());
+}
+
+void __lat_hist_stop(enum lat_hist_type type)
+{
+	u64 ts = this_cpu_read(lat_hist_ts[type]);
+
+	if (!ts)
+		return;
+	this_cpu_write(lat_hist_ts[type], 0);
+
+	if (ts < READ_ONCE(lat_hist_epoch[type]))
+		return;
+	lat_hist_record(type, trace_clock_local() - ts);
+}
+
+static void
+lat_hist_probe_wakeup(void *ignore, struct task_struct *p)
+{
+	/* Keep the first wakeup if the task is woken again before it runs */
+	if (!p->lat_hist_wakeup_ts)
+		p->lat_hist_wakeup_ts = trace_clock_local();
+}
+
+static void
+lat_hist_probe_switch(void *ignore, bool preempt,
+		      struct task_struct *prev, struct task_struct *next)
+{
+	u64 ts = next->lat_hist_wakeup_ts;
+
+	/* A wakeup of a task that was still running is not a latency */
+	prev->lat_hist_wakeup_ts = 0;
+	if (!ts)
+		return;
+	next->lat_hist_wakeup_ts = 0;
+
+	if (ts < READ_ONCE(lat_hist_epoch[LAT_HIST_WAKEUP]))
+		return;
+	lat_hist_record(LAT_HIST_WAKEUP, trace_clock_local() - ts);
+}
+
+static int lat_hist_wakeup_register(void)
+{
+	int ret;
+
+	ret = register_trace_sched_wakeup(lat_hist_probe_wakeup, NULL);
+	if (ret)
+		return ret;
+
+	ret = register_trace_sched_wakeup_new(lat_hist_probe_wakeup, NULL);
+	if (ret)
+		goto fail_deprobe;
+
+	ret = register_trace_sched_switch(lat_hist_probe_switch, NULL);
+	if (ret)
+		goto fail_deprobe_wake_new;
+
+	return 0;
+fail_deprobe_wake_new:
+	unregister_trace_sched_wakeup_new(lat_hist_probe_wakeup, NULL);
+fail_deprobe:
+	unregister_trace_sched_wakeup(lat_hist_probe_wakeup, NULL);
+	return ret;
+}
+
+static void lat_hist_wakeup_unregister(void)
+{
+	unregister_trace_sched_switch(lat_hist_probe_switch, NULL);
+	unregister_trace_sched_wakeup_new(lat_hist_probe_wakeup, NULL);
+	unregister_trace_sched_wakeup(lat_hist_probe_wakeup, NULL);
+	tracepoint_synchronize_unregister();
+}
+
+static int lat_hist_set_enabled(enum lat_hist_type type, bool enable)
+{
+	int ret = 0;
+
+	mutex_lock(&lat_hist_mutex);
+	if (enable == static_key_enabled(&lat_hist_keys[type]))
+		goto out;
+
+	if (enable) {
+		WRITE_ONCE(lat_hist_epoch[type], trace_clock_local());
+		if (type == LAT_HIST_WAKEUP) {
+			ret = lat_hist_wakeup_register();
+			if (ret)
+				goto out;
+		}
+		static_branch_enable(&lat_hist_keys[type]);
+	} else {
+		static_branch_disable(&lat_hist_keys[type]);
+		if (type == LAT_HIST_WAKEUP)
+			lat_hist_wakeup_unregister();
+	}
+out:
+	mutex_unlock(&lat_hist_mutex);
+	return ret;
+}
+
+static enum lat_hist_type lat_hist_file_type(struct file *filp)
+{
+	return (enum lat_hist_type)(long)file_inode(filp)->i_private;
+}
+
+static ssize_t
+lat_hist_enable_read(struct file *filp, char __user *ubuf,
+		     size_t cnt, loff_t *ppos)
+{
+	enum lat_hist_type type = lat_hist_file_type(filp);
+	char buf[4];
+	int r;
+
+	r = snprintf(buf, sizeof(buf), "%d\n",
+		     static_key_enabled(&lat_hist_keys[type]));
+
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, r);
+}
+
+static ssize_t
+lat_hist_enable_write(struct file *filp, const char __user *ubuf,
+		      size_t cnt, loff_t *ppos)
+{
+	enum lat_hist_type type = lat_hist_file_type(filp);
+	bool enable;
+	int ret;
+
+	ret = kstrtobool_from_user(ubuf, cnt, &enable);
+	if (ret)
+		return ret;
+
+	ret = lat_hist_set_enabled(type, enable);
+	if (ret)
+		return ret;
+
+	*ppos += cnt;
+	return cnt;
+}
+
+static const struct file_operations lat_hist_enable_fops = {
+	.open		= tracing_open_generic,
+	.read		= lat_hist_enable_read,
+	.write		= lat_hist_enable_write,
+	.llseek		= generic_file_llseek,
+};
+
+static int lat_hist_show(struct seq_file *m, void *v)
+{
+	enum lat_hist_type type = (enum lat_hist_type)(long)m->private;
+	u64 bucket[LAT_HIST_BUCKETS] = { 0 };
+	u64 count = 0, sum = 0, max = 0;
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		struct lat_hist_cpu *h = per_cpu_ptr(&lat_hist_data[type], cpu);
+
+		for (i = 0; i < LAT_HIST_BUCKETS; i++)
+			bucket[i] += READ_ONCE(h->bucket[i]);
+		sum += READ_ONCE(h->sum);
+		max = max_t(u64, max, READ_ONCE(h->max));
+	}
+
+	for (i = 0; i < LAT_HIST_BUCKETS; i++)
+		count += bucket[i];
+
+	seq_printf(m, "# %s latency, ns\n", lat_hist_names[type]);
+	seq_printf(m, "# count: %llu\n", count);
+	seq_printf(m, "# avg: %llu\n", count ? div64_u64(sum, count) : 0);
+	seq_printf(m, "# max: %llu\n", max);
+	seq_puts(m, "#\n# >= ns          count\n");
+
+	for (i = 0; i < LAT_HIST_BUCKETS; i++) {
+		if (!bucket[i])
+			continue;
+		seq_printf(m, "%-15llu %llu\n", i ? 1ULL << (i - 1) : 0ULL,
+			   bucket[i]);
+	}
+
+	return 0;
+}
+
+static int lat_hist_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, lat_hist_show, inode->i_private);
+}
+
+static const struct file_operations lat_hist_fops = {
+	.open		= lat_hist_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/* Not atomic against cpus recording at the same time, which is fine */
+static ssize_t
+lat_hist_reset_write(struct file *filp, const char __user *ubuf,
+		     size_t cnt, loff_t *ppos)
+{
+	enum lat_hist_type type = lat_hist_file_type(filp);
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(&lat_hist_data[type], cpu), 0,
+		       sizeof(struct lat_hist_cpu));
+
+	*ppos += cnt;
+	return cnt;
+}
+
+static const struct file_operations lat_hist_reset_fops = {
+	.open		= tracing_open_generic,
+	.write		= lat_hist_reset_write,
+	.llseek		= generic_file_llseek,
+};
+
+static __init int lat_hist_init_tracefs(void)
+{
+	struct dentry *d_tracer, *top_dir, *dir;
+	long type;
+
+	d_tracer = tracing_init_dentry();
+	if (IS_ERR(d_tracer))
+		return 0;
+
+	top_dir = tracefs_create_dir("latency_hist", d_tracer);
+	if (!top_dir) {
+		pr_warn("Could not create tracefs 'latency_hist' directory\n");
+		return 0;
+	}
+
+	for (type = 0; type < LAT_HIST_MAX; type++) {
+		dir = tracefs_create_dir(lat_hist_names[type], top_dir);
+		if (!dir)
+			goto err;
+
+		trace_create_file("enable", 0644, dir, (void *)type,
+				  &lat_hist_enable_fops);
+		trace_create_file("hist", 0444, dir, (void *)type,
+				  &lat_hist_fops);
+		trace_create_file("reset", 0200, dir, (void *)type,
+				  &lat_hist_reset_fops);
+	}
+
+	return 0;
+err:
+	pr_warn("Could not create tracefs 'latency_hist' entries\n");
+	tracefs_remove_recursive(top_dir);
+	return 0;
+}
+fs_initcall(lat_hist_init_tracefs);
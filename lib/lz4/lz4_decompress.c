@@ -50,6 +50,71 @@
 #define assert(condition) ((void)0)
 #endif
 
+static const unsigned int inc32table[8] = {0, 1, 2, 1, 0, 4, 4, 4};
+static const int dec64table[8] = {0, 0, 0, -1, -4, 1, 2, 3};
+
+#if LZ4_FAST_DEC_LOOP
+static FORCE_INLINE void LZ4_memcpy_using_offset_base(BYTE *dstPtr,
+	const BYTE *srcPtr, BYTE *dstEnd, const size_t offset)
+{
+	if (offset < 8) {
+		dstPtr[0] = srcPtr[0];
+		dstPtr[1] = srcPtr[1];
+		dstPtr[2] = srcPtr[2];
+		dstPtr[3] = srcPtr[3];
+		srcPtr += inc32table[offset];
+		LZ4_memcpy(dstPtr + 4, srcPtr, 4);
+		srcPtr -= dec64table[offset];
+		dstPtr += 8;
+	} else {
+		LZ4_memcpy(dstPtr, srcPtr, 8);
+		dstPtr += 8;
+		srcPtr += 8;
+	}
+
+	LZ4_wildCopy(dstPtr, srcPtr, dstEnd);
+}
+
+/*
+ * Copy an overlapping match with @offset < 16. Presumes that
+ * dstEnd >= dstPtr + MINMATCH and that 8 bytes past dstEnd are writable.
+ */
+static FORCE_INLINE void LZ4_memcpy_using_offset(BYTE *dstPtr,
+	const BYTE *srcPtr, BYTE *dstEnd, const size_t offset)
+{
+	BYTE v[8];
+
+	assert(dstEnd >= dstPtr + MINMATCH);
+	/* silence an msan warning when offset == 0 */
+	LZ4_write32(dstPtr, 0);
+
+	switch (offset) {
+	case 1:
+		memset(v, *srcPtr, 8);
+		break;
+	case 2:
+		LZ4_memcpy(v, srcPtr, 2);
+		LZ4_memcpy(&v[2], srcPtr, 2);
+		LZ4_memcpy(&v[4], &v[0], 4);
+		break;
+	case 4:
+		LZ4_memcpy(v, srcPtr, 4);
+		LZ4_memcpy(&v[4], srcPtr, 4);
+		break;
+	default:
+		LZ4_memcpy_using_offset_base(dstPtr, srcPtr, dstEnd, offset);
+		return;
+	}
+
+	LZ4_memcpy(dstPtr, v, 8);
+	dstPtr += 8;
+	while (dstPtr < dstEnd) {
+		LZ4_memcpy(dstPtr, v, 8);
+		dstPtr += 8;
+	}
+}
+#endif
+
 /*
  * LZ4_decompress_generic() :
  * This generic decompression function covers all use cases.
@@ -87,9 +152,12 @@ static FORCE_INLINE int LZ4_decompress_generic(
 	BYTE * const oend = op + outputSize;
 	BYTE *cpy;
 
+	unsigned int token;
+	size_t length;
+	const BYTE *match;
+	size_t offset;
+
 	const BYTE * const dictEnd = (const BYTE *)dictStart + dictSize;
-	static const unsigned int inc32table[8] = {0, 1, 2, 1, 0, 4, 4, 4};
-	static const int dec64table[8] = {0, 0, 0, -1, -4, 1, 2, 3};
 
 	const int safeDecode = (endOnInput == endOnInputSize);
 	const int checkOffset = ((safeDecode) && (dictSize < (int)(64 * KB)));
@@ -117,14 +185,152 @@ static FORCE_INLINE int LZ4_decompress_generic(
 	if ((endOnInput) && unlikely(srcSize == 0))
 		return -1;
 
-	/* Main Loop : decode sequences */
+#if LZ4_FAST_DEC_LOOP
+	if ((oend - op) < FASTLOOP_SAFE_DISTANCE)
+		goto safe_decode;
+
+	/*
+	 * Fast loop : decode sequences while at least FASTLOOP_SAFE_DISTANCE
+	 * bytes are left in the output, so every copy can be a wild one.
+	 * Anything closer to either end is finished by the main loop.
+	 */
 	while (1) {
-		size_t length;
-		const BYTE *match;
-		size_t offset;
+		assert(oend - op >= FASTLOOP_SAFE_DISTANCE);
+		assert(!endOnInput || ip < iend);
+
+		token = *ip++;
+		length = token >> ML_BITS;
+
+		/* decode literal length */
+		if (length == RUN_MASK) {
+			unsigned int s;
+
+			if (unlikely(endOnInput ? ip >= iend - RUN_MASK : 0))
+				goto _output_error;
+			do {
+				s = *ip++;
+				length += s;
+			} while (likely(endOnInput
+				? ip < iend - RUN_MASK
+				: 1) & (s == 255));
+
+			if ((safeDecode)
+			    && unlikely((uptrval)(op) +
+					length < (uptrval)(op)))
+				goto _output_error;
+			if ((safeDecode)
+			    && unlikely((uptrval)(ip) +
+					length < (uptrval)(ip)))
+				goto _output_error;
+
+			/* copy literals */
+			cpy = op + length;
+			if (endOnInput) {
+				if ((cpy > oend - 32) ||
+				    (ip + length > iend - 32))
+					goto safe_literal_copy;
+				LZ4_wildCopy32(op, ip, cpy);
+			} else {
+				if (cpy > oend - 8)
+					goto safe_literal_copy;
+				LZ4_wildCopy(op, ip, cpy);
+			}
+			ip += length;
+			op = cpy;
+		} else {
+			cpy = op + length;
+			if (endOnInput) {
+				/* max literals + offset + next token */
+				if (ip > iend - (16 + 1))
+					goto safe_literal_copy;
+				/* at most 14 literals, copy a full register */
+				LZ4_memcpy(op, ip, 16);
+			} else {
+				/* the input length is not known here */
+				LZ4_memcpy(op, ip, 8);
+				if (length > 8)
+					LZ4_memcpy(op + 8, ip + 8, 8);
+			}
+			ip += length;
+			op = cpy;
+		}
 
+		/* get offset */
+		offset = LZ4_readLE16(ip);
+		ip += 2;
+		match = op - offset;
+		assert(match <= op);
+
+		/* get matchlength */
+		length = token & ML_MASK;
+
+		if (length == ML_MASK) {
+			unsigned int s;
+
+			if ((checkOffset) &&
+			    (unlikely(match + dictSize < lowPrefix)))
+				goto _output_error;
+			do {
+				s = *ip++;
+
+				if ((endOnInput) && (ip > iend - LASTLITERALS))
+					goto _output_error;
+
+				length += s;
+			} while (s == 255);
+
+			if ((safeDecode)
+				&& unlikely(
+					(uptrval)(op) + length < (uptrval)op))
+				goto _output_error;
+
+			length += MINMATCH;
+			if (op + length >= oend - FASTLOOP_SAFE_DISTANCE)
+				goto safe_match_copy;
+		} else {
+			length += MINMATCH;
+			if (op + length >= oend - FASTLOOP_SAFE_DISTANCE)
+				goto safe_match_copy;
+
+			/* Fastpath check: avoids a branch in LZ4_wildCopy32 */
+			if ((dict == withPrefix64k || match >= lowPrefix) &&
+			    offset >= 8) {
+				assert(match >= lowPrefix);
+				assert(op + 18 <= oend);
+
+				LZ4_memcpy(op, match, 8);
+				LZ4_memcpy(op + 8, match + 8, 8);
+				LZ4_memcpy(op + 16, match + 16, 2);
+				op += length;
+				continue;
+			}
+		}
+
+		if ((checkOffset) && (unlikely(match + dictSize < lowPrefix)))
+			goto _output_error;
+
+		/* matches into the external dictionary take the slow path */
+		if ((dict == usingExtDict) && (match < lowPrefix))
+			goto safe_match_copy;
+
+		/* copy match within block */
+		cpy = op + length;
+
+		assert((op <= oend) && (oend - op >= 32));
+		if (unlikely(offset < 16))
+			LZ4_memcpy_using_offset(op, match, cpy, offset);
+		else
+			LZ4_wildCopy32(op, match, cpy);
+
+		op = cpy; /* wildcopy correction */
+	}
+safe_decode:
+#endif
+
+	/* Main Loop : decode sequences */
+	while (1) {
 		/* get literal length */
-		unsigned int const token = *ip++;
+		token = *ip++;
 		length = token>>ML_BITS;
 
 		/* ip < iend before the increment */
@@ -216,6 +422,9 @@ static FORCE_INLINE int LZ4_decompress_generic(
 
 		/* copy literals */
 		cpy = op + length;
+#if LZ4_FAST_DEC_LOOP
+safe_literal_copy:
+#endif
 		LZ4_STATIC_ASSERT(MFLIMIT >= WILDCOPYLENGTH);
 
 		if (((endOnInput) && ((cpy > oend - MFLIMIT)
@@ -283,11 +492,6 @@ static FORCE_INLINE int LZ4_decompress_generic(
 		length = token & ML_MASK;
 
 _copy_match:
-		if ((checkOffset) && (unlikely(match + dictSize < lowPrefix))) {
-			/* Error : offset outside buffers */
-			goto _output_error;
-		}
-
 		/* costs ~1%; silence an msan warning when offset == 0 */
 		/*
 		 * note : when partialDecoding, there is no guarantee that
@@ -322,6 +526,14 @@ static FORCE_INLINE int LZ4_decompress_generic(
 
 		length += MINMATCH;
 
+#if LZ4_FAST_DEC_LOOP
+safe_match_copy:
+#endif
+		if ((checkOffset) && (unlikely(match + dictSize < lowPrefix))) {
+			/* Error : offset outside buffers */
+			goto _output_error;
+		}
+
 		/* match starting within external dictionary */
 		if ((dict == usingExtDict) && (match < lowPrefix)) {
 			if (unlikely(op + length > oend - LASTLITERALS)) {
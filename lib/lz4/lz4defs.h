@@ -67,6 +67,17 @@ typedef uintptr_t uptrval;
 #define LZ4_LITTLE_ENDIAN 0
 #endif
 
+/*
+ * Decode with 16 and 32 byte copies while the output is far from its end,
+ * as in LZ4 v1.9. On arm64 the 16 byte copies are single q register loads
+ * and stores.
+ */
+#if defined(CONFIG_ARM64)
+#define LZ4_FAST_DEC_LOOP 1
+#else
+#define LZ4_FAST_DEC_LOOP 0
+#endif
+
 /*-************************************
  *	Constants
  **************************************/
@@ -80,6 +91,7 @@ typedef uintptr_t uptrval;
  * without overflowing output buffer
  */
 #define MATCH_SAFEGUARD_DISTANCE  ((2 * WILDCOPYLENGTH) - MINMATCH)
+#define FASTLOOP_SAFE_DISTANCE 64
 
 /* Increase this value ==> compression run slower on incompressible data */
 #define LZ4_SKIPTRIGGER 6
@@ -180,6 +192,26 @@ static FORCE_INLINE void LZ4_wildCopy(void *dstPtr,
 	} while (d < e);
 }
 
+/*
+ * customized variant of memcpy,
+ * which can overwrite up to 32 bytes beyond dstEnd;
+ * copies two times 16 bytes to stay correct for offsets >= 16
+ */
+static FORCE_INLINE void LZ4_wildCopy32(void *dstPtr,
+	const void *srcPtr, void *dstEnd)
+{
+	BYTE *d = (BYTE *)dstPtr;
+	const BYTE *s = (const BYTE *)srcPtr;
+	BYTE *const e = (BYTE *)dstEnd;
+
+	do {
+		LZ4_memcpy(d, s, 16);
+		LZ4_memcpy(d + 16, s + 16, 16);
+		d += 32;
+		s += 32;
+	} while (d < e);
+}
+
 static FORCE_INLINE unsigned int LZ4_NbCommonBytes(register size_t val)
 {
 #if LZ4_LITTLE_ENDIAN
@@ -0,0 +1,135 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Round trip and throughput test for LZ4 decompression.
+ *
+ * Pages of several kinds of content are compressed once, then each one is
+ * decompressed @iterations times into a page sized buffer the way zram
+ * does it, checked against the source, and the rate is reported.
+ */
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/lz4.h>
+#include <linux/random.h>
+#include <linux/sched/clock.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+
+static unsigned int iterations = 1000;
+module_param(iterations, uint, 0444);
+MODULE_PARM_DESC(iterations, "decompressions per page pattern");
+
+enum {
+	TEST_LZ4_TEXT,		/* long matches far back */
+	TEST_LZ4_SHORT_OFF,	/* overlapping matches 1..15 bytes back */
+	TEST_LZ4_MIXED,		/* literal runs between short matches */
+	TEST_LZ4_RANDOM,	/* incompressible, all literals */
+	TEST_LZ4_MAX,
+};
+
+static const char *const test_lz4_names[TEST_LZ4_MAX] = {
+	[TEST_LZ4_TEXT]		= "text",
+	[TEST_LZ4_SHORT_OFF]	= "short-offset",
+	[TEST_LZ4_MIXED]	= "mixed",
+	[TEST_LZ4_RANDOM]	= "random",
+};
+
+static void __init test_lz4_fill(int type, u8 *buf, size_t len)
+{
+	static const char text[] =
+		"The quick brown fox jumps over the lazy dog. ";
+	size_t i, j;
+
+	switch (type) {
+	case TEST_LZ4_TEXT:
+		for (i = 0; i < len; i++)
+			buf[i] = text[i % (sizeof(text) - 1)];
+		break;
+	case TEST_LZ4_SHORT_OFF:
+		for (i = 0; i < len; i += j) {
+			size_t period = 1 + prandom_u32() % 15;
+
+			for (j = 0; j < 256 && i + j < len; j++)
+				buf[i + j] = 'a' + j % period;
+		}
+		break;
+	case TEST_LZ4_MIXED:
+		for (i = 0; i < len; i++)
+			buf[i] = prandom_u32() % 4 ? buf[i - min(i, (size_t)8)] :
+				prandom_u32();
+		break;
+	default:
+		prandom_bytes(buf, len);
+		break;
+	}
+}
+
+static int __init test_lz4_run(int type, u8 *src, u8 *comp, u8 *dst,
+			       void *wrkmem)
+{
+	int clen, ret;
+	unsigned int i;
+	u64 start, ns;
+
+	test_lz4_fill(type, src, PAGE_SIZE);
+	clen = LZ4_compress_default(src, comp, PAGE_SIZE,
+				    LZ4_compressBound(PAGE_SIZE), wrkmem);
+	if (clen <= 0) {
+		pr_err("%s: compression failed\n", test_lz4_names[type]);
+		return -EINVAL;
+	}
+
+	start = sched_clock();
+	for (i = 0; i < iterations; i++) {
+		ret = LZ4_decompress_safe(comp, dst, clen, PAGE_SIZE);
+		if (ret != PAGE_SIZE || memcmp(src, dst, PAGE_SIZE)) {
+			pr_err("%s: round trip failed (%d)\n",
+			       test_lz4_names[type], ret);
+			return -EINVAL;
+		}
+	}
+	ns = sched_clock() - start;
+
+	pr_info("%s: %d -> %lu bytes, %llu MB/s\n", test_lz4_names[type],
+		clen, PAGE_SIZE,
+		ns ? div64_u64((u64)iterations * PAGE_SIZE * 1000, ns) : 0);
+
+	return 0;
+}
+
+static int __init test_lz4_init(void)
+{
+	u8 *src, *comp, *dst;
+	void *wrkmem;
+	int type, ret = -ENOMEM;
+
+	src = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	comp = kmalloc(LZ4_compressBound(PAGE_SIZE), GFP_KERNEL);
+	dst = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	wrkmem = vmalloc(LZ4_MEM_COMPRESS);
+	if (!src || !comp || !dst || !wrkmem)
+		goto out;
+
+	for (type = 0; type < TEST_LZ4_MAX; type++) {
+		ret = test_lz4_run(type, src, comp, dst, wrkmem);
+		if (ret)
+			goto out;
+	}
+	pr_info("test passed\n");
+out:
+	vfree(wrkmem);
+	kfree(dst);
+	kfree(comp);
+	kfree(src);
+	return ret;
+}
+
+static void __exit test_lz4_exit(void)
+{
+}
+
+module_init(test_lz4_init);
+module_exit(test_lz4_exit);
+MODULE_DESCRIPTION("LZ4 decompression test");
+MODULE_LICENSE("GPL");
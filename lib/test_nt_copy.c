@@ -0,0 +1,205 @@
+/*
+ * Kernel module measuring where non-temporal copies start to pay off.
+ *
+ * For every size from 256 bytes up to max_size, memcpy(), copy_to_user()
+ * and copy_from_user() are timed once with arm64_nt_copy_threshold out
+ * of reach and once with it at zero, that is with normal and with
+ * non-temporal stores. After each copy a working set of wset bytes is
+ * read again, which is what the copy costs the rest of the system: the
+ * crossover is the first size at which copy plus reload is cheaper with
+ * non-temporal stores.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/ktime.h>
+#include <linux/mman.h>
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/sizes.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <asm/cpufeature.h>
+
+static unsigned long max_size = SZ_4M;
+module_param(max_size, ulong, 0444);
+MODULE_PARM_DESC(max_size, "largest copy to time, in bytes");
+
+static unsigned long wset = SZ_256K;
+module_param(wset, ulong, 0444);
+MODULE_PARM_DESC(wset, "working set reread after each copy, in bytes");
+
+static unsigned int iterations = 16;
+module_param(iterations, uint, 0444);
+MODULE_PARM_DESC(iterations, "copies per size and mode");
+
+enum nt_copy_op {
+	NT_MEMCPY,
+	NT_TO_USER,
+	NT_FROM_USER,
+	NT_OP_MAX,
+};
+
+static const char * const nt_copy_op_names[] = {
+	[NT_MEMCPY] = "memcpy",
+	[NT_TO_USER] = "copy_to_user",
+	[NT_FROM_USER] = "copy_from_user",
+};
+
+struct nt_copy_bufs {
+	void *src;
+	void *dst;
+	void __user *user;
+	unsigned long *wset;
+};
+
+static unsigned long nt_copy_reload(struct nt_copy_bufs *b)
+{
+	unsigned long i, sum = 0;
+
+	for (i = 0; i < wset / sizeof(*b->wset); i += L1_CACHE_BYTES /
+			sizeof(*b->wset))
+		sum += READ_ONCE(b->wset[i]);
+	return sum;
+}
+
+static int nt_copy_one(struct nt_copy_bufs *b, enum nt_copy_op op,
+		       size_t size)
+{
+	switch (op) {
+	case NT_MEMCPY:
+		memcpy(b->dst, b->src, size);
+		return 0;
+	case NT_TO_USER:
+		return copy_to_user(b->user, b->src, size) ? -EFAULT : 0;
+	case NT_FROM_USER:
+		return copy_from_user(b->dst, b->user, size) ? -EFAULT : 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+/* Average ns of a copy and of the working set reload that follows it */
+static int nt_copy_time(struct nt_copy_bufs *b, enum nt_copy_op op,
+			size_t size, u64 *copy_ns, u64 *reload_ns)
+{
+	ktime_t t0, t1, t2;
+	unsigned int i;
+	int ret;
+
+	*copy_ns = *reload_ns = 0;
+	for (i = 0; i < iterations; i++) {
+		nt_copy_reload(b);
+		t0 = ktime_get();
+		ret = nt_copy_one(b, op, size);
+		t1 = ktime_get();
+		nt_copy_reload(b);
+		t2 = ktime_get();
+		if (ret)
+			return ret;
+
+		*copy_ns += ktime_to_ns(ktime_sub(t1, t0));
+		*reload_ns += ktime_to_ns(ktime_sub(t2, t1));
+		cond_resched();
+	}
+	*copy_ns = div_u64(*copy_ns, iterations);
+	*reload_ns = div_u64(*reload_ns, iterations);
+	return 0;
+}
+
+static int nt_copy_run(struct nt_copy_bufs *b, enum nt_copy_op op)
+{
+	unsigned long saved = arm64_nt_copy_threshold;
+	u64 tc, tr, nc, nr;
+	size_t crossover = 0;
+	size_t size;
+	int ret = 0;
+
+	pr_info("%s: size copy_ns reload_ns nt_copy_ns nt_reload_ns\n",
+		nt_copy_op_names[op]);
+	for (size = 256; size <= max_size; size <<= 1) {
+		WRITE_ONCE(arm64_nt_copy_threshold, ULONG_MAX);
+		ret = nt_copy_time(b, op, size, &tc, &tr);
+		if (ret)
+			break;
+
+		WRITE_ONCE(arm64_nt_copy_threshold, 0);
+		ret = nt_copy_time(b, op, size, &nc, &nr);
+		if (ret)
+			break;
+
+		pr_info("%s: %zu %llu %llu %llu %llu\n", nt_copy_op_names[op],
+			size, tc, tr, nc, nr);
+		if (!crossover && nc + nr < tc + tr)
+			crossover = size;
+	}
+	WRITE_ONCE(arm64_nt_copy_threshold, saved);
+
+	if (crossover)
+		pr_info("%s: non-temporal pays off from %zu bytes\n",
+			nt_copy_op_names[op], crossover);
+	else if (!ret)
+		pr_info("%s: non-temporal never paid off\n",
+			nt_copy_op_names[op]);
+	return ret;
+}
+
+static int __init test_nt_copy_init(void)
+{
+	struct nt_copy_bufs b = { };
+	unsigned long user_addr;
+	int op, ret = -ENOMEM;
+
+	if (!cpus_have_const_cap(ARM64_HAS_NT_LARGE_COPY))
+		pr_warn("no non-temporal copy on this cpu, both runs are the same\n");
+
+	if (!iterations || max_size < 256 || !wset)
+		return -EINVAL;
+
+	b.src = vmalloc(max_size);
+	b.dst = vmalloc(max_size);
+	b.wset = vmalloc(wset);
+	if (!b.src || !b.dst || !b.wset)
+		goto out;
+	memset(b.src, 0x5a, max_size);
+	memset(b.dst, 0, max_size);
+	memset(b.wset, 0, wset);
+
+	user_addr = vm_mmap(NULL, 0, max_size, PROT_READ | PROT_WRITE,
+			    MAP_ANONYMOUS | MAP_PRIVATE | MAP_POPULATE, 0);
+	if (user_addr >= (unsigned long)(TASK_SIZE)) {
+		pr_warn("Failed to allocate user memory\n");
+		goto out;
+	}
+	b.user = (void __user *)user_addr;
+
+	ret = 0;
+	for (op = 0; op < NT_OP_MAX && !ret; op++)
+		ret = nt_copy_run(&b, op);
+
+	vm_munmap(user_addr, max_size);
+out:
+	vfree(b.wset);
+	vfree(b.dst);
+	vfree(b.src);
+	return ret;
+}
+
+static void __exit test_nt_copy_exit(void)
+{
+}
+
+module_init(test_nt_copy_init);
+module_exit(test_nt_copy_exit);
+
+MODULE_DESCRIPTION("Non-temporal copy crossover benchmark");
+MODULE_LICENSE("GPL");
@@ -38,6 +38,7 @@
 #include <linux/rmap.h>
 #include <linux/delayacct.h>
 #include <linux/psi.h>
+#include <linux/launch_prefetch.h>
 #include "internal.h"
 
 #define CREATE_TRACE_POINTS
@@ -2026,6 +2027,8 @@ static ssize_t generic_file_buffered_read(struct kiocb *iocb,
 	last_index = (*ppos + iter->count + PAGE_SIZE-1) >> PAGE_SHIFT;
 	offset = *ppos & ~PAGE_MASK;
 
+	launch_prefetch_record(filp, index, last_index - index);
+
 	for (;;) {
 		struct page *page;
 		pgoff_t end_index;
@@ -2503,6 +2506,8 @@ int filemap_fault(struct vm_fault *vmf)
 	if (unlikely(offset >= max_off))
 		return VM_FAULT_SIGBUS;
 
+	launch_prefetch_record(file, offset, 1);
+
 	/*
 	 * Do we have something in the page cache already?
 	 */
@@ -0,0 +1,570 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Replay the file pages of an app launch as readahead on its next launch.
+ *
+ * Launches read the same apk, odex and library pages every time, and on
+ * slow storage much of the launch is spent waiting for them. For the
+ * first window_ms after an app process is forked, every file page it
+ * faults in or reads is recorded as ranges per file, in a profile keyed
+ * by the app uid. When a process of that uid starts again, the last
+ * complete profile is read ahead from a worker while the new launch is
+ * recorded to replace it.
+ *
+ * Files are remembered by path and reopened in the initial mount
+ * namespace for the replay; one whose size or mtime changed since it was
+ * recorded, by an app update, is skipped. At most max_apps profiles are
+ * kept, the ones of the apps launched least recently are dropped first.
+ *
+ *   /sys/kernel/mm/launch_prefetch/enabled   - 0/1, off by default
+ *   /sys/kernel/mm/launch_prefetch/window_ms - recording window
+ *   /sys/kernel/mm/launch_prefetch/max_apps  - profiles kept
+ *   /sys/kernel/mm/launch_prefetch/stats     - counters
+ */
+
+#define pr_fmt(fmt) "launch_prefetch: " fmt
+
+#include <linux/cred.h>
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/hashtable.h>
+#include <linux/kobject.h>
+#include <linux/launch_prefetch.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/sysfs.h>
+#include <linux/workqueue.h>
+
+/* First uid of Android applications, system processes are left alone */
+#define LP_FIRST_APP_UID	10000
+/* Ranges this close are merged, about the fault-around size */
+#define LP_MERGE_PAGES		16
+/* Recent ranges of a file looked at for merging */
+#define LP_MERGE_SCAN		16
+#define LP_MAX_FILE_RANGES	1024
+#define LP_MAX_RANGES		8192
+#define LP_HASH_BITS		6
+
+struct lp_range {
+	pgoff_t start;
+	unsigned long nr;
+};
+
+struct lp_file {
+	struct list_head list;
+	/* identify the file while recording, replays go by path */
+	struct inode *inode;
+	unsigned long ino;
+	loff_t size;
+	struct timespec mtime;
+	unsigned int nr_ranges;
+	unsigned int max_ranges;
+	struct lp_range *ranges;
+	char *path;
+};
+
+/* The files and ranges of one launch */
+struct lp_profile {
+	struct list_head files;
+	unsigned int nr_ranges;
+};
+
+struct lp_app {
+	struct hlist_node node;
+	struct list_head lru;
+	uid_t uid;
+	/* last complete launch, read ahead by replay_work */
+	struct lp_profile *profile;
+	/* launch being recorded, until end_work */
+	struct lp_profile *session;
+	struct work_struct replay_work;
+	struct delayed_work end_work;
+};
+
+DEFINE_STATIC_KEY_FALSE(launch_prefetch_key);
+
+static DEFINE_HASHTABLE(lp_apps, LP_HASH_BITS);
+/* Most recently launched first */
+static LIST_HEAD(lp_lru);
+static unsigned int lp_nr_apps;
+static bool lp_enabled;
+/* Protects the above and the sessions */
+static DEFINE_SPINLOCK(lp_lock);
+/* Taken with lp_lock to change app->profile, held to read it */
+static DEFINE_MUTEX(lp_mutex);
+static DEFINE_MUTEX(lp_enable_mutex);
+
+static unsigned int lp_window_ms = 5000;
+static unsigned int lp_max_apps = 32;
+
+static atomic_long_t lp_launches;
+static atomic_long_t lp_replayed_pages;
+static atomic_long_t lp_stale_files;
+static atomic_long_t lp_evictions;
+
+static void lp_free_file(struct lp_file *f)
+{
+	if (!f)
+		return;
+	kfree(f->ranges);
+	kfree(f->path);
+	kfree(f);
+}
+
+static void lp_free_profile(struct lp_profile *p)
+{
+	struct lp_file *f, *tmp;
+
+	if (!p)
+		return;
+	list_for_each_entry_safe(f, tmp, &p->files, list) {
+		list_del(&f->list);
+		lp_free_file(f);
+	}
+	kfree(p);
+}
+
+static void lp_free_app(struct lp_app *app)
+{
+	cancel_delayed_work_sync(&app->end_work);
+	cancel_work_sync(&app->replay_work);
+	lp_free_profile(app->session);
+	lp_free_profile(app->profile);
+	kfree(app);
+}
+
+static struct lp_app *lp_find_app(uid_t uid)
+{
+	struct lp_app *app;
+
+	hash_for_each_possible(lp_apps, app, node, uid)
+		if (app->uid == uid)
+			return app;
+
+	return NULL;
+}
+
+static struct lp_file *lp_find_file(struct lp_profile *s, struct inode *inode)
+{
+	struct lp_file *f;
+
+	list_for_each_entry(f, &s->files, list) {
+		if (f->inode == inode && f->ino == inode->i_ino) {
+			/* faults come in runs on the same file */
+			list_move(&f->list, &s->files);
+			return f;
+		}
+	}
+
+	return NULL;
+}
+
+static struct lp_file *lp_alloc_file(struct file *file)
+{
+	struct inode *inode = file_inode(file);
+	struct lp_file *f;
+	char *buf, *path;
+
+	buf = __getname();
+	if (!buf)
+		return NULL;
+
+	f = kzalloc(sizeof(*f), GFP_KERNEL);
+	if (!f)
+		goto out;
+
+	path = d_path(&file->f_path, buf, PATH_MAX);
+	if (!IS_ERR(path))
+		f->path = kstrdup(path, GFP_KERNEL);
+	if (!f->path) {
+		kfree(f);
+		f = NULL;
+		goto out;
+	}
+
+	f->inode = inode;
+	f->ino = inode->i_ino;
+	f->size = i_size_read(inode);
+	f->mtime = inode->i_mtime;
+out:
+	__putname(buf);
+	return f;
+}
+
+static void lp_add_range(struct lp_profile *s, struct lp_file *f,
+			 pgoff_t start, unsigned long nr)
+{
+	struct lp_range *r;
+	unsigned int i, size;
+	pgoff_t end;
+
+	for (i = f->nr_ranges; i > 0 && f->nr_ranges - i < LP_MERGE_SCAN; i--) {
+		r = &f->ranges[i - 1];
+		if (start + nr + LP_MERGE_PAGES < r->start ||
+		    start > r->start + r->nr + LP_MERGE_PAGES)
+			continue;
+		end = max(start + nr, r->start + r->nr);
+		r->start = min(start, r->start);
+		r->nr = end - r->start;
+		return;
+	}
+
+	if (s->nr_ranges >= LP_MAX_RANGES)
+		return;
+
+	if (f->nr_ranges == f->max_ranges) {
+		size = f->max_ranges ? f->max_ranges * 2 : 16;
+		if (size > LP_MAX_FILE_RANGES)
+			return;
+		r = krealloc(f->ranges, size * sizeof(*r),
+			     GFP_NOWAIT | __GFP_NOWARN);
+		if (!r)
+			return;
+		f->ranges = r;
+		f->max_ranges = size;
+	}
+
+	r = &f->ranges[f->nr_ranges++];
+	r->start = start;
+	r->nr = nr;
+	s->nr_ranges++;
+}
+
+static unsigned long lp_replay_file(struct lp_file *f)
+{
+	unsigned long pages = 0;
+	struct inode *inode;
+	struct file *file;
+	unsigned int i;
+
+	file = filp_open(f->path, O_RDONLY | O_LARGEFILE, 0);
+	if (IS_ERR(file))
+		goto stale;
+
+	inode = file_inode(file);
+	if (i_size_read(inode) != f->size ||
+	    !timespec_equal(&inode->i_mtime, &f->mtime)) {
+		filp_close(file, NULL);
+		goto stale;
+	}
+
+	for (i = 0; i < f->nr_ranges; i++) {
+		force_page_cache_readahead(file->f_mapping, file,
+					   f->ranges[i].start, f->ranges[i].nr);
+		pages += f->ranges[i].nr;
+	}
+	filp_close(file, NULL);
+
+	return pages;
+stale:
+	atomic_long_inc(&lp_stale_files);
+	return 0;
+}
+
+static void lp_replay_fn(struct work_struct *work)
+{
+	struct lp_app *app = container_of(work, struct lp_app, replay_work);
+	unsigned long pages = 0;
+	struct lp_file *f;
+
+	mutex_lock(&lp_mutex);
+	if (app->profile) {
+		list_for_each_entry(f, &app->profile->files, list)
+			pages += lp_replay_file(f);
+	}
+	mutex_unlock(&lp_mutex);
+
+	atomic_long_add(pages, &lp_replayed_pages);
+}
+
+static void lp_end_fn(struct work_struct *work)
+{
+	struct lp_app *app = container_of(to_delayed_work(work),
+					  struct lp_app, end_work);
+	struct lp_app *victim, *tmp;
+	struct lp_profile *s, *old = NULL;
+	LIST_HEAD(victims);
+
+	mutex_lock(&lp_mutex);
+	spin_lock(&lp_lock);
+	s = app->session;
+	app->session = NULL;
+	if (s && s->nr_ranges) {
+		old = app->profile;
+		app->profile = s;
+		s = NULL;
+	}
+
+	/* Evict from the tail, never an app that is being recorded */
+	list_for_each_entry_safe_reverse(victim, tmp, &lp_lru, lru) {
+		if (lp_nr_apps <= READ_ONCE(lp_max_apps))
+			break;
+		if (victim->session || victim == app)
+			continue;
+		hash_del(&victim->node);
+		list_move(&victim->lru, &victims);
+		lp_nr_apps--;
+	}
+	spin_unlock(&lp_lock);
+	mutex_unlock(&lp_mutex);
+
+	lp_free_profile(s);
+	lp_free_profile(old);
+	list_for_each_entry_safe(victim, tmp, &victims, lru) {
+		list_del(&victim->lru);
+		lp_free_app(victim);
+		atomic_long_inc(&lp_evictions);
+	}
+}
+
+static int lp_start_session(uid_t uid)
+{
+	struct lp_app *app, *new_app;
+	struct lp_profile *s;
+
+	new_app = kzalloc(sizeof(*new_app), GFP_KERNEL);
+	s = kzalloc(sizeof(*s), GFP_KERNEL);
+	if (!new_app || !s) {
+		kfree(new_app);
+		kfree(s);
+		return -ENOMEM;
+	}
+	INIT_LIST_HEAD(&s->files);
+
+	spin_lock(&lp_lock);
+	if (!lp_enabled) {
+		spin_unlock(&lp_lock);
+		kfree(new_app);
+		kfree(s);
+		return -ENODEV;
+	}
+
+	app = lp_find_app(uid);
+	if (!app) {
+		app = new_app;
+		new_app = NULL;
+		app->uid = uid;
+		INIT_WORK(&app->replay_work, lp_replay_fn);
+		INIT_DELAYED_WORK(&app->end_work, lp_end_fn);
+		hash_add(lp_apps, &app->node, uid);
+		list_add(&app->lru, &lp_lru);
+		lp_nr_apps++;
+	}
+
+	if (!app->session) {
+		app->session = s;
+		s = NULL;
+		list_move(&app->lru, &lp_lru);
+		if (app->profile)
+			queue_work(system_unbound_wq, &app->replay_work);
+		queue_delayed_work(system_unbound_wq, &app->end_work,
+				   msecs_to_jiffies(READ_ONCE(lp_window_ms)));
+		atomic_long_inc(&lp_launches);
+	}
+	spin_unlock(&lp_lock);
+
+	kfree(new_app);
+	kfree(s);
+	return 0;
+}
+
+static bool lp_in_window(struct task_struct *p)
+{
+	u64 age = ktime_get_boot_ns() - p->group_leader->real_start_time;
+
+	return age < (u64)READ_ONCE(lp_window_ms) * NSEC_PER_MSEC;
+}
+
+void __launch_prefetch_record(struct file *file, pgoff_t index,
+			      unsigned long nr)
+{
+	struct inode *inode = file_inode(file);
+	struct lp_file *f, *new = NULL;
+	struct lp_profile *s;
+	struct lp_app *app;
+	uid_t uid;
+
+	if (!nr || (current->flags & PF_KTHREAD) || !lp_in_window(current))
+		return;
+
+	uid = from_kuid(&init_user_ns, current_uid());
+	if (uid < LP_FIRST_APP_UID)
+		return;
+
+	for (;;) {
+		spin_lock(&lp_lock);
+		app = lp_find_app(uid);
+		s = app ? app->session : NULL;
+		if (!s) {
+			spin_unlock(&lp_lock);
+			if (lp_start_session(uid))
+				goto out;
+			continue;
+		}
+
+		f = lp_find_file(s, inode);
+		if (f || new)
+			break;
+		spin_unlock(&lp_lock);
+
+		new = lp_alloc_file(file);
+		if (!new)
+			return;
+	}
+
+	if (!f) {
+		f = new;
+		new = NULL;
+		list_add(&f->list, &s->files);
+	}
+	lp_add_range(s, f, index, nr);
+	spin_unlock(&lp_lock);
+out:
+	lp_free_file(new);
+}
+
+static void lp_set_enabled(bool enable)
+{
+	struct lp_app *app, *next;
+	struct hlist_node *tmp;
+	LIST_HEAD(apps);
+	int bkt;
+
+	mutex_lock(&lp_enable_mutex);
+	if (enable == lp_enabled)
+		goto out;
+
+	if (enable) {
+		spin_lock(&lp_lock);
+		lp_enabled = true;
+		spin_unlock(&lp_lock);
+		static_branch_enable(&launch_prefetch_key);
+		goto out;
+	}
+
+	static_branch_disable(&launch_prefetch_key);
+	spin_lock(&lp_lock);
+	lp_enabled = false;
+	hash_for_each_safe(lp_apps, bkt, tmp, app, node) {
+		hash_del(&app->node);
+		list_move(&app->lru, &apps);
+	}
+	lp_nr_apps = 0;
+	spin_unlock(&lp_lock);
+
+	list_for_each_entry_safe(app, next, &apps, lru) {
+		list_del(&app->lru);
+		lp_free_app(app);
+	}
+out:
+	mutex_unlock(&lp_enable_mutex);
+}
+
+#define LP_ATTR(_name) \
+	static struct kobj_attribute _name##_attr = \
+		__ATTR(_name, 0644, _name##_show, _name##_store)
+
+static ssize_t enabled_show(struct kobject *kobj,
+			    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", READ_ONCE(lp_enabled));
+}
+
+static ssize_t enabled_store(struct kobject *kobj,
+			     struct kobj_attribute *attr,
+			     const char *buf, size_t count)
+{
+	bool enable;
+	int err;
+
+	err = kstrtobool(buf, &enable);
+	if (err)
+		return err;
+
+	lp_set_enabled(enable);
+	return count;
+}
+LP_ATTR(enabled);
+
+static ssize_t window_ms_show(struct kobject *kobj,
+			      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", READ_ONCE(lp_window_ms));
+}
+
+static ssize_t window_ms_store(struct kobject *kobj,
+			       struct kobj_attribute *attr,
+			       const char *buf, size_t count)
+{
+	unsigned int msecs;
+	int err;
+
+	err = kstrtouint(buf, 10, &msecs);
+	if (err || !msecs || msecs > 60 * MSEC_PER_SEC)
+		return -EINVAL;
+
+	WRITE_ONCE(lp_window_ms, msecs);
+	return count;
+}
+LP_ATTR(window_ms);
+
+static ssize_t max_apps_show(struct kobject *kobj,
+			     struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", READ_ONCE(lp_max_apps));
+}
+
+static ssize_t max_apps_store(struct kobject *kobj,
+			      struct kobj_attribute *attr,
+			      const char *buf, size_t count)
+{
+	unsigned int nr;
+	int err;
+
+	err = kstrtouint(buf, 10, &nr);
+	if (err || !nr || nr > 1024)
+		return -EINVAL;
+
+	/* applied as the next launch ends */
+	WRITE_ONCE(lp_max_apps, nr);
+	return count;
+}
+LP_ATTR(max_apps);
+
+static ssize_t stats_show(struct kobject *kobj,
+			  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf,
+		       "apps %u\nlaunches %ld\nreplayed_pages %ld\nstale_files %ld\nevictions %ld\n",
+		       READ_ONCE(lp_nr_apps),
+		       atomic_long_read(&lp_launches),
+		       atomic_long_read(&lp_replayed_pages),
+		       atomic_long_read(&lp_stale_files),
+		       atomic_long_read(&lp_evictions));
+}
+static struct kobj_attribute stats_attr = __ATTR_RO(stats);
+
+static struct attribute *lp_attrs[] = {
+	&enabled_attr.attr,
+	&window_ms_attr.attr,
+	&max_apps_attr.attr,
+	&stats_attr.attr,
+	NULL,
+};
+
+static const struct attribute_group lp_attr_group = {
+	.attrs = lp_attrs,
+	.name = "launch_prefetch",
+};
+
+static int __init launch_prefetch_init(void)
+{
+	int err;
+
+	err = sysfs_create_group(mm_kobj, &lp_attr_group);
+	if (err)
+		pr_err("register sysfs failed\n");
+
+	return err;
+}
+late_initcall(launch_prefetch_init);
@@ -58,6 +58,7 @@
 #include <linux/fs.h>
 #include <linux/seq_file.h>
 #include <linux/vmpressure.h>
+#include <linux/psi.h>
 #include <linux/mm_inline.h>
 #include <linux/swap_cgroup.h>
 #include <linux/cpu.h>
@@ -4027,6 +4028,39 @@ static ssize_t memcg_write_event_control(struct kernfs_open_file *of,
 	return ret;
 }
 
+#ifdef CONFIG_PSI_MEMCG_V1
+static int mem_cgroup_pressure_show(struct seq_file *m, void *v)
+{
+	return psi_show(m, cgroup_psi(seq_css(m)->cgroup), PSI_MEM);
+}
+
+static ssize_t mem_cgroup_pressure_write(struct kernfs_open_file *of,
+					 char *buf, size_t nbytes, loff_t off)
+{
+	struct psi_trigger *new;
+
+	new = psi_trigger_create(cgroup_psi(of_css(of)->cgroup), buf, nbytes,
+				 PSI_MEM);
+	if (IS_ERR(new))
+		return PTR_ERR(new);
+
+	psi_trigger_replace(&of->priv, new);
+
+	return nbytes;
+}
+
+static unsigned int mem_cgroup_pressure_poll(struct kernfs_open_file *of,
+					     poll_table *pt)
+{
+	return psi_trigger_poll(&of->priv, of->file, pt);
+}
+
+static void mem_cgroup_pressure_release(struct kernfs_open_file *of)
+{
+	psi_trigger_replace(&of->priv, NULL);
+}
+#endif
+
 static struct cftype mem_cgroup_legacy_files[] = {
 	{
 		.name = "usage_in_bytes",
@@ -4094,6 +4128,16 @@ static struct cftype mem_cgroup_legacy_files[] = {
 	{
 		.name = "pressure_level",
 	},
+#ifdef CONFIG_PSI_MEMCG_V1
+	{
+		.name = "pressure",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = mem_cgroup_pressure_show,
+		.write = mem_cgroup_pressure_write,
+		.poll = mem_cgroup_pressure_poll,
+		.release = mem_cgroup_pressure_release,
+	},
+#endif
 #ifdef CONFIG_NUMA
 	{
 		.name = "numa_stat",
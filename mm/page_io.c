@@ -25,15 +25,32 @@
 #include <linux/psi.h>
 #include <linux/uio.h>
 #include <linux/sched/task.h>
+#include <linux/sched/clock.h>
+#include <linux/swapfile.h>
 #include <asm/pgtable.h>
 
+/*
+ * Swap bios carry their submission time so that the completion can feed
+ * the per-device latency used by swap_ratio.
+ */
+struct swap_bio {
+	struct swap_info_struct *sis;
+	u64 start;
+	struct bio bio;
+};
+
+static struct bio_set *swap_bio_set;
+
 static struct bio *get_swap_bio(gfp_t gfp_flags,
 				struct page *page, bio_end_io_t end_io)
 {
 	int i, nr = hpage_nr_pages(page);
 	struct bio *bio;
 
-	bio = bio_alloc(gfp_flags, nr);
+	if (swap_bio_set)
+		bio = bio_alloc_bioset(gfp_flags, nr, swap_bio_set);
+	else
+		bio = bio_alloc(gfp_flags, nr);
 	if (bio) {
 		struct block_device *bdev;
 
@@ -44,14 +61,46 @@ static struct bio *get_swap_bio(gfp_t gfp_flags,
 		for (i = 0; i < nr; i++)
 			bio_add_page(bio, page + i, PAGE_SIZE, 0);
 		VM_BUG_ON(bio->bi_iter.bi_size != PAGE_SIZE * nr);
+
+		if (swap_bio_set && bio->bi_pool == swap_bio_set) {
+			struct swap_bio *sbio;
+
+			sbio = container_of(bio, struct swap_bio, bio);
+			sbio->sis = page_swap_info(page);
+			sbio->start = local_clock();
+		}
 	}
 	return bio;
 }
 
+static void swap_bio_account(struct bio *bio, bool write)
+{
+	struct swap_bio *sbio;
+
+	if (!swap_bio_set || bio->bi_pool != swap_bio_set || bio->bi_status)
+		return;
+
+	sbio = container_of(bio, struct swap_bio, bio);
+	swap_ratio_account(sbio->sis, write, local_clock() - sbio->start);
+}
+
+static int __init swap_bio_init(void)
+{
+	swap_bio_set = bioset_create(BIO_POOL_SIZE,
+				     offsetof(struct swap_bio, bio), 0);
+	if (!swap_bio_set)
+		pr_warn("swap: no bioset, swap latency is not measured\n");
+
+	return 0;
+}
+subsys_initcall(swap_bio_init);
+
 void end_swap_bio_write(struct bio *bio)
 {
 	struct page *page = bio->bi_io_vec[0].bv_page;
 
+	swap_bio_account(bio, true);
+
 	if (bio->bi_status) {
 		SetPageError(page);
 		/*
@@ -127,6 +176,8 @@ static void end_swap_bio_read(struct bio *bio)
 	struct page *page = bio->bi_io_vec[0].bv_page;
 	struct task_struct *waiter = bio->bi_private;
 
+	swap_bio_account(bio, false);
+
 	if (bio->bi_status) {
 		SetPageError(page);
 		ClearPageUptodate(page);
@@ -278,6 +329,7 @@ int __swap_writepage(struct page *page, struct writeback_control *wbc,
 	struct bio *bio;
 	int ret;
 	struct swap_info_struct *sis = page_swap_info(page);
+	u64 start;
 
 	VM_BUG_ON_PAGE(!PageSwapCache(page), page);
 	if (sis->flags & SWP_FILE) {
@@ -321,9 +373,11 @@ int __swap_writepage(struct page *page, struct writeback_control *wbc,
 		return ret;
 	}
 
+	start = local_clock();
 	ret = bdev_write_page(sis->bdev, map_swap_page(page, &sis->bdev),
 			      page, wbc);
 	if (!ret) {
+		swap_ratio_account(sis, true, local_clock() - start);
 		count_swpout_vm_event(page);
 		return 0;
 	}
@@ -353,6 +407,7 @@ int swap_readpage(struct page *page, bool synchronous)
 	blk_qc_t qc;
 	struct gendisk *disk;
 	unsigned long pflags;
+	u64 start;
 
 	VM_BUG_ON_PAGE(!PageSwapCache(page) && !synchronous, page);
 	VM_BUG_ON_PAGE(!PageLocked(page), page);
@@ -381,8 +436,10 @@ int swap_readpage(struct page *page, bool synchronous)
 		goto out;
 	}
 
+	start = local_clock();
 	ret = bdev_read_page(sis->bdev, map_swap_page(page, &sis->bdev), page);
 	if (!ret) {
+		swap_ratio_account(sis, false, local_clock() - start);
 		if (trylock_page(page)) {
 			swap_slot_free_notify(page);
 			unlock_page(page);
@@ -49,6 +49,14 @@ module_param_named(pressure_max, pressure_max, ulong, 0644);
 static short min_score_adj = 360;
 module_param_named(min_score_adj, min_score_adj, short, 0644);
 
+/*
+ * When non-zero, only reclaim anon pages that stayed idle for this many
+ * process reclaim passes over the task, as seen by idle page tracking.
+ * Hot pages are left alone so that they don't refault right away.
+ */
+static unsigned int idle_scans;
+module_param_named(idle_scans, idle_scans, uint, 0644);
+
 /*
  * Scheduling process reclaim workqueue unecessarily
  * when the reclaim efficiency is low does not make
@@ -185,12 +193,15 @@ static void swap_fn(struct work_struct *work)
 		if (!nr_to_reclaim)
 			nr_to_reclaim = 1;
 
-		rp = reclaim_task_anon(selected[si].p, nr_to_reclaim);
+		rp = reclaim_task_anon(selected[si].p, nr_to_reclaim,
+				idle_scans);
 
 		trace_process_reclaim(selected[si].tasksize,
 				selected[si].oom_score_adj, rp.nr_scanned,
 				rp.nr_reclaimed, per_swap_size, total_sz,
 				nr_to_reclaim);
+		trace_process_reclaim_task(selected[si].p, rp.mark_idle,
+				rp.mm_reclaimed, rp.mm_refaulted);
 		total_scan += rp.nr_scanned;
 		total_reclaimed += rp.nr_reclaimed;
 		put_task_struct(selected[si].p);
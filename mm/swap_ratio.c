@@ -14,6 +14,9 @@
 #include <linux/mm_types.h>
 #include <linux/swapfile.h>
 #include <linux/swap.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/math64.h>
 
 #define SWAP_RATIO_GROUP_START (SWAP_FLAG_PRIO_MASK - 9) /* 32758 */
 #define SWAP_RATIO_GROUP_END (SWAP_FLAG_PRIO_MASK) /* 32767 */
@@ -31,6 +34,48 @@ int sysctl_swap_ratio = 100;
 /* Enable the swap ratio feature */
 int sysctl_swap_ratio_enable;
 
+/*
+ * Derive the ratio from the measured swap-in plus swap-out latency of
+ * the two devices instead of using sysctl_swap_ratio.
+ */
+int sysctl_swap_ratio_adaptive;
+
+/* weight of a new sample in the latency averages, 1/2^SWAP_LAT_SHIFT */
+#define SWAP_LAT_SHIFT	3
+
+void swap_ratio_account(struct swap_info_struct *si, bool write, u64 lat)
+{
+	unsigned long *avg = write ? &si->swpout_lat : &si->swpin_lat;
+	unsigned long old = READ_ONCE(*avg);
+
+	if (!old)
+		WRITE_ONCE(*avg, lat);
+	else
+		WRITE_ONCE(*avg, old - (old >> SWAP_LAT_SHIFT) +
+			   ((unsigned long)lat >> SWAP_LAT_SHIFT));
+}
+
+/*
+ * Share of writes for the fast device so that each device gets traffic
+ * in inverse proportion to its cost. Falls back to @ratio until both
+ * devices have latency samples.
+ */
+static int swap_ratio_adaptive(struct swap_info_struct *fast,
+			       struct swap_info_struct *slow, int ratio)
+{
+	u64 cost_fast = (u64)READ_ONCE(fast->swpin_lat) +
+			READ_ONCE(fast->swpout_lat);
+	u64 cost_slow = (u64)READ_ONCE(slow->swpin_lat) +
+			READ_ONCE(slow->swpout_lat);
+
+	if (!cost_fast || !cost_slow)
+		return ratio;
+
+	ratio = div64_u64(cost_slow * 100, cost_fast + cost_slow);
+
+	return clamp(ratio, 1, 100);
+}
+
 static bool is_same_group(struct swap_info_struct *a,
 		struct swap_info_struct *b)
 {
@@ -61,6 +106,9 @@ static int calculate_write_pending(struct swap_info_struct *si,
 	if ((n->flags & SWP_SYNCHRONOUS_IO) || !is_same_group(si, n))
 		return -ENODEV;
 
+	if (sysctl_swap_ratio_adaptive)
+		ratio = swap_ratio_adaptive(si, n, ratio);
+
 	si->max_writes = ratio ? SWAP_FAST_WRITES : 0;
 	n->max_writes  = ratio ? (SWAP_FAST_WRITES * 100) /
 			ratio - SWAP_FAST_WRITES : SWAP_SLOW_WRITES;
@@ -198,3 +246,40 @@ int swap_ratio(struct swap_info_struct **si, int node)
 	else
 		return -ENODEV;
 }
+
+static int swap_latency_show(struct seq_file *m, void *v)
+{
+	struct swap_info_struct *si;
+
+	seq_puts(m, "Filename\t\t\t\tPriority\tSwapIn(us)\tSwapOut(us)\n");
+
+	spin_lock(&swap_lock);
+	plist_for_each_entry(si, &swap_active_head, list) {
+		seq_file_path(m, si->swap_file, " \t\n\\");
+		seq_printf(m, "\t%d\t\t%lu\t\t%lu\n", si->prio,
+			   READ_ONCE(si->swpin_lat) / NSEC_PER_USEC,
+			   READ_ONCE(si->swpout_lat) / NSEC_PER_USEC);
+	}
+	spin_unlock(&swap_lock);
+
+	return 0;
+}
+
+static int swap_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, swap_latency_show, NULL);
+}
+
+static const struct file_operations proc_swap_latency_operations = {
+	.open		= swap_latency_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init swap_latency_init(void)
+{
+	proc_create("swap_latency", 0444, NULL, &proc_swap_latency_operations);
+	return 0;
+}
+__initcall(swap_latency_init);
@@ -74,6 +74,9 @@
 #include <linux/oom.h>
 #include <linux/numa.h>
 #include <linux/sradix-tree.h>
+#include <linux/cpumask.h>
+#include <linux/thermal.h>
+#include <linux/power_supply.h>
 
 #include <asm/tlbflush.h>
 #include "internal.h"
@@ -185,6 +188,128 @@ static int is_full_zero(const void *s1, size_t len)
 }
 #endif
 
+#if defined(CONFIG_ARM64) && defined(CONFIG_KERNEL_MODE_NEON)
+#include <linux/jump_label.h>
+#include <asm/hwcap.h>
+#include <asm/neon.h>
+#include <asm/simd.h>
+
+/*
+ * NEON page kernels, picked at boot when the CPU has Advanced SIMD.
+ * Both work on 64 bytes per iteration, so len must be a multiple of 64.
+ */
+static DEFINE_STATIC_KEY_FALSE(uksm_neon_key);
+
+static int is_full_zero_neon(const void *s1, size_t len)
+{
+	const void *end = s1 + len;
+	unsigned long nz;
+
+	asm volatile(
+	"1:	ld1	{v0.16b-v3.16b}, [%[p]], #64\n"
+	"	orr	v0.16b, v0.16b, v1.16b\n"
+	"	orr	v2.16b, v2.16b, v3.16b\n"
+	"	orr	v0.16b, v0.16b, v2.16b\n"
+	"	umaxv	s0, v0.4s\n"
+	"	fmov	%w[nz], s0\n"
+	"	cbnz	%w[nz], 2f\n"
+	"	cmp	%[p], %[end]\n"
+	"	b.lo	1b\n"
+	"2:\n"
+	: [p] "+r" (s1), [nz] "=&r" (nz)
+	: [end] "r" (end)
+	: "v0", "v1", "v2", "v3", "cc", "memory");
+
+	return !nz;
+}
+
+/*
+ * Find the first 64-byte block that differs and let memcmp() order it,
+ * so the result is the same as a plain memcmp() of the whole range.
+ */
+static int memcmp_neon(const void *s1, const void *s2, size_t len)
+{
+	const void *p1 = s1, *p2 = s2;
+	unsigned long nz;
+
+	asm volatile(
+	"1:	ld1	{v0.16b-v3.16b}, [%[p1]], #64\n"
+	"	ld1	{v4.16b-v7.16b}, [%[p2]], #64\n"
+	"	eor	v0.16b, v0.16b, v4.16b\n"
+	"	eor	v1.16b, v1.16b, v5.16b\n"
+	"	eor	v2.16b, v2.16b, v6.16b\n"
+	"	eor	v3.16b, v3.16b, v7.16b\n"
+	"	orr	v0.16b, v0.16b, v1.16b\n"
+	"	orr	v2.16b, v2.16b, v3.16b\n"
+	"	orr	v0.16b, v0.16b, v2.16b\n"
+	"	umaxv	s0, v0.4s\n"
+	"	fmov	%w[nz], s0\n"
+	"	cbnz	%w[nz], 2f\n"
+	"	subs	%[len], %[len], #64\n"
+	"	b.ne	1b\n"
+	"2:\n"
+	: [p1] "+r" (p1), [p2] "+r" (p2), [len] "+r" (len), [nz] "=&r" (nz)
+	:
+	: "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7", "cc", "memory");
+
+	if (!nz)
+		return 0;
+
+	return memcmp(p1 - 64, p2 - 64, 64);
+}
+
+static int uksm_page_memcmp(void *s1, void *s2)
+{
+	int ret;
+
+	if (!static_branch_likely(&uksm_neon_key) || !may_use_simd())
+		return memcmp(s1, s2, PAGE_SIZE);
+
+	kernel_neon_begin();
+	ret = memcmp_neon(s1, s2, PAGE_SIZE);
+	kernel_neon_end();
+
+	return ret;
+}
+
+static int uksm_page_is_zero(const void *s1)
+{
+	int ret;
+
+	if (!static_branch_likely(&uksm_neon_key) || !may_use_simd())
+		return is_full_zero(s1, PAGE_SIZE);
+
+	kernel_neon_begin();
+	ret = is_full_zero_neon(s1, PAGE_SIZE);
+	kernel_neon_end();
+
+	return ret;
+}
+
+static void __init uksm_select_kernels(void)
+{
+	if (!(elf_hwcap & HWCAP_ASIMD))
+		return;
+
+	static_branch_enable(&uksm_neon_key);
+	pr_info("uksm: using NEON page compare and zero check\n");
+}
+#else
+static int uksm_page_memcmp(void *s1, void *s2)
+{
+	return memcmp(s1, s2, PAGE_SIZE);
+}
+
+static int uksm_page_is_zero(const void *s1)
+{
+	return is_full_zero(s1, PAGE_SIZE);
+}
+
+static void __init uksm_select_kernels(void)
+{
+}
+#endif
+
 #define UKSM_RUNG_ROUND_FINISHED  (1 << 0)
 #define TIME_RATIO_SCALE	10000
 
@@ -1458,7 +1583,7 @@ static int memcmp_pages(struct page *page1, struct page *page2,
 
 	addr1 = kmap_atomic(page1);
 	addr2 = kmap_atomic(page2);
-	ret = memcmp(addr1, addr2, PAGE_SIZE);
+	ret = uksm_page_memcmp(addr1, addr2);
 	kunmap_atomic(addr2);
 	kunmap_atomic(addr1);
 
@@ -1479,7 +1604,7 @@ static inline int is_page_full_zero(struct page *page)
 	int ret;
 
 	addr = kmap_atomic(page);
-	ret = is_full_zero(addr, PAGE_SIZE);
+	ret = uksm_page_is_zero(addr);
 	kunmap_atomic(addr);
 
 	return ret;
@@ -4672,22 +4797,145 @@ static int ksmd_should_run(void)
 	return uksm_run & UKSM_RUN_MERGE;
 }
 
-static int uksm_scan_thread(void *nothing)
+/*
+ * Scan workers. uksmd is worker 0 and up to UKSM_MAX_WORKERS - 1 more
+ * can be started through the "workers" attribute. They share the scan
+ * ladder and take turns on it under uksm_thread_mutex, each resuming the
+ * slot tree walk where the previous one stopped, so together they sweep
+ * it several times per sleep period. All of them are kept on
+ * uksm_worker_cpus, the cluster of CPU 0 by default.
+ *
+ * Only as many workers as there are idle CPUs in that mask get to run.
+ * Above thermal_limit on thermal_zone, or on battery below battery_limit,
+ * only uksmd runs and it sleeps twice as long.
+ */
+#define UKSM_MAX_WORKERS	4
+
+struct uksm_worker {
+	struct task_struct *task;
+	int id;
+	unsigned long runs;
+	u64 pages_scanned;
+	u64 pages_merged;
+	u64 scan_time;
+};
+
+static struct uksm_worker uksm_workers[UKSM_MAX_WORKERS];
+static unsigned int uksm_nr_workers = 1;
+/* serializes worker start/stop, never taken under uksm_thread_mutex */
+static DEFINE_MUTEX(uksm_workers_mutex);
+static struct cpumask uksm_worker_cpus;
+
+static char uksm_thermal_zone[THERMAL_NAME_LENGTH];
+/* in millicelsius, 0 disables the thermal check */
+static int uksm_thermal_limit;
+/* in percent, 0 disables the battery check */
+static unsigned int uksm_battery_limit;
+static bool uksm_throttled;
+
+static bool uksm_thermal_throttled(void)
 {
+	struct thermal_zone_device *tz;
+	int temp;
+
+	if (!uksm_thermal_limit || !uksm_thermal_zone[0])
+		return false;
+
+	tz = thermal_zone_get_zone_by_name(uksm_thermal_zone);
+	if (IS_ERR(tz) || thermal_zone_get_temp(tz, &temp))
+		return false;
+
+	return temp >= uksm_thermal_limit;
+}
+
+static bool uksm_battery_throttled(void)
+{
+	union power_supply_propval status, capacity;
+	struct power_supply *psy;
+	bool ret = false;
+
+	if (!IS_ENABLED(CONFIG_POWER_SUPPLY) || !uksm_battery_limit)
+		return false;
+
+	psy = power_supply_get_by_name("battery");
+	if (!psy)
+		return false;
+
+	if (!power_supply_get_property(psy, POWER_SUPPLY_PROP_STATUS,
+				       &status) &&
+	    status.intval == POWER_SUPPLY_STATUS_DISCHARGING &&
+	    !power_supply_get_property(psy, POWER_SUPPLY_PROP_CAPACITY,
+				       &capacity))
+		ret = capacity.intval < uksm_battery_limit;
+
+	power_supply_put(psy);
+	return ret;
+}
+
+static bool uksm_worker_may_run(struct uksm_worker *w)
+{
+	int cpu, idle = 0;
+
+	if (!w->id)
+		return true;
+
+	if (READ_ONCE(uksm_throttled) || w->id >= uksm_nr_workers)
+		return false;
+
+	for_each_cpu_and(cpu, &uksm_worker_cpus, cpu_online_mask)
+		if (idle_cpu(cpu))
+			idle++;
+
+	return w->id < idle;
+}
+
+static void uksm_worker_scan(struct uksm_worker *w)
+{
+	u64 scanned = uksm_pages_scanned;
+	unsigned long sharing = uksm_pages_sharing;
+	u64 start = task_sched_runtime(current);
+
+	uksm_do_scan();
+
+	w->runs++;
+	w->scan_time += task_sched_runtime(current) - start;
+	/* the scan counter is reset when it would overflow */
+	if (uksm_pages_scanned > scanned)
+		w->pages_scanned += uksm_pages_scanned - scanned;
+	if (uksm_pages_sharing > sharing)
+		w->pages_merged += uksm_pages_sharing - sharing;
+}
+
+static int uksm_scan_thread(void *data)
+{
+	struct uksm_worker *w = data;
+
 	set_freezable();
 	set_user_nice(current, 5);
 
 	while (!kthread_should_stop()) {
-		mutex_lock(&uksm_thread_mutex);
-		if (ksmd_should_run())
-			uksm_do_scan();
-		mutex_unlock(&uksm_thread_mutex);
+		unsigned int sleep;
+
+		if (!w->id)
+			WRITE_ONCE(uksm_throttled, uksm_thermal_throttled() ||
+						   uksm_battery_throttled());
+
+		if (uksm_worker_may_run(w)) {
+			mutex_lock(&uksm_thread_mutex);
+			if (ksmd_should_run())
+				uksm_worker_scan(w);
+			mutex_unlock(&uksm_thread_mutex);
+		}
 
 		try_to_freeze();
 
 		if (ksmd_should_run()) {
-			schedule_timeout_interruptible(uksm_sleep_real);
-			uksm_sleep_times++;
+			sleep = uksm_sleep_real;
+			if (READ_ONCE(uksm_throttled))
+				sleep *= 2;
+			schedule_timeout_interruptible(sleep);
+			if (!w->id)
+				uksm_sleep_times++;
 		} else {
 			wait_event_freezable(uksm_thread_wait,
 				ksmd_should_run() || kthread_should_stop());
@@ -5263,6 +5511,269 @@ static ssize_t sleep_times_show(struct kobject *kobj,
 UKSM_ATTR_RO(sleep_times);
 
 
+static int uksm_start_worker(int id)
+{
+	struct uksm_worker *w = &uksm_workers[id];
+	struct task_struct *tsk;
+
+	w->id = id;
+	tsk = kthread_create(uksm_scan_thread, w, "uksmd/%d", id);
+	if (IS_ERR(tsk))
+		return PTR_ERR(tsk);
+
+	set_cpus_allowed_ptr(tsk, &uksm_worker_cpus);
+	w->task = tsk;
+	wake_up_process(tsk);
+
+	return 0;
+}
+
+static ssize_t workers_show(struct kobject *kobj,
+			    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", uksm_nr_workers);
+}
+
+static ssize_t workers_store(struct kobject *kobj,
+			     struct kobj_attribute *attr,
+			     const char *buf, size_t count)
+{
+	unsigned long nr;
+	int err = 0, i;
+
+	err = kstrtoul(buf, 10, &nr);
+	if (err || !nr || nr > UKSM_MAX_WORKERS)
+		return -EINVAL;
+
+	mutex_lock(&uksm_workers_mutex);
+	for (i = uksm_nr_workers; i < nr; i++) {
+		err = uksm_start_worker(i);
+		if (err)
+			break;
+	}
+	nr = i;
+	for (i = uksm_nr_workers - 1; i >= (int)nr; i--) {
+		kthread_stop(uksm_workers[i].task);
+		uksm_workers[i].task = NULL;
+	}
+	uksm_nr_workers = nr;
+	mutex_unlock(&uksm_workers_mutex);
+
+	return err ? err : count;
+}
+UKSM_ATTR(workers);
+
+static ssize_t worker_cpus_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%*pbl\n", cpumask_pr_args(&uksm_worker_cpus));
+}
+
+static ssize_t worker_cpus_store(struct kobject *kobj,
+				 struct kobj_attribute *attr,
+				 const char *buf, size_t count)
+{
+	cpumask_var_t mask;
+	int err, i;
+
+	if (!alloc_cpumask_var(&mask, GFP_KERNEL))
+		return -ENOMEM;
+
+	err = cpulist_parse(buf, mask);
+	if (!err && !cpumask_intersects(mask, cpu_online_mask))
+		err = -EINVAL;
+
+	if (!err) {
+		mutex_lock(&uksm_workers_mutex);
+		cpumask_copy(&uksm_worker_cpus, mask);
+		for (i = 0; i < uksm_nr_workers; i++)
+			set_cpus_allowed_ptr(uksm_workers[i].task, mask);
+		mutex_unlock(&uksm_workers_mutex);
+	}
+
+	free_cpumask_var(mask);
+	return err ? err : count;
+}
+UKSM_ATTR(worker_cpus);
+
+static ssize_t thermal_zone_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%s\n", uksm_thermal_zone);
+}
+
+static ssize_t thermal_zone_store(struct kobject *kobj,
+				  struct kobj_attribute *attr,
+				  const char *buf, size_t count)
+{
+	char name[THERMAL_NAME_LENGTH];
+
+	strlcpy(name, buf, sizeof(name));
+	strim(name);
+
+	mutex_lock(&uksm_thread_mutex);
+	strlcpy(uksm_thermal_zone, name, sizeof(uksm_thermal_zone));
+	mutex_unlock(&uksm_thread_mutex);
+
+	return count;
+}
+UKSM_ATTR(thermal_zone);
+
+static ssize_t thermal_limit_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", uksm_thermal_limit);
+}
+
+static ssize_t thermal_limit_store(struct kobject *kobj,
+				   struct kobj_attribute *attr,
+				   const char *buf, size_t count)
+{
+	int err, limit;
+
+	err = kstrtoint(buf, 10, &limit);
+	if (err)
+		return -EINVAL;
+
+	uksm_thermal_limit = limit;
+
+	return count;
+}
+UKSM_ATTR(thermal_limit);
+
+static ssize_t battery_limit_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", uksm_battery_limit);
+}
+
+static ssize_t battery_limit_store(struct kobject *kobj,
+				   struct kobj_attribute *attr,
+				   const char *buf, size_t count)
+{
+	unsigned long limit;
+	int err;
+
+	err = kstrtoul(buf, 10, &limit);
+	if (err || limit > 100)
+		return -EINVAL;
+
+	uksm_battery_limit = limit;
+
+	return count;
+}
+UKSM_ATTR(battery_limit);
+
+static ssize_t worker_stat_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	ssize_t len = 0;
+	int i;
+
+	mutex_lock(&uksm_workers_mutex);
+	len += sprintf(buf, "throttled %d\n", READ_ONCE(uksm_throttled));
+	for (i = 0; i < uksm_nr_workers; i++) {
+		struct uksm_worker *w = &uksm_workers[i];
+
+		len += sprintf(buf + len, "%d %lu %llu %llu %llu\n", i,
+			       w->runs, w->pages_scanned, w->pages_merged,
+			       div_u64(w->scan_time, NSEC_PER_MSEC));
+	}
+	mutex_unlock(&uksm_workers_mutex);
+
+	return len;
+}
+UKSM_ATTR_RO(worker_stat);
+
+/*
+ * Microbenchmark of the page kernels in use: reading runs each of them
+ * for a while on scratch pages and reports the pages per second it did.
+ */
+#define UKSM_BENCH_NS		(20 * NSEC_PER_MSEC)
+
+struct uksm_bench {
+	const char *name;
+	int (*fn)(void *addr1, void *addr2);
+};
+
+static int uksm_bench_hash(void *addr1, void *addr2)
+{
+	return random_sample_hash(addr1, HASH_STRENGTH_FULL);
+}
+
+static int uksm_bench_zero(void *addr1, void *addr2)
+{
+	return uksm_page_is_zero(addr2);
+}
+
+static int uksm_bench_cmp(void *addr1, void *addr2)
+{
+	return uksm_page_memcmp(addr1, addr2);
+}
+
+static int uksm_bench_zero_generic(void *addr1, void *addr2)
+{
+	return is_full_zero(addr2, PAGE_SIZE);
+}
+
+static int uksm_bench_cmp_generic(void *addr1, void *addr2)
+{
+	return memcmp(addr1, addr2, PAGE_SIZE);
+}
+
+static const struct uksm_bench uksm_benches[] = {
+	{ "hash", uksm_bench_hash },
+	{ "zero", uksm_bench_zero },
+	{ "zero_generic", uksm_bench_zero_generic },
+	{ "cmp", uksm_bench_cmp },
+	{ "cmp_generic", uksm_bench_cmp_generic },
+};
+
+static ssize_t kernel_bench_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	void *addr1, *addr2;
+	ssize_t len = 0;
+	int i;
+
+	addr1 = (void *)__get_free_page(GFP_KERNEL);
+	addr2 = (void *)get_zeroed_page(GFP_KERNEL);
+	if (!addr1 || !addr2) {
+		len = -ENOMEM;
+		goto out;
+	}
+
+	/* equal to the zero page but for the last byte, the worst case */
+	((char *)addr1)[PAGE_SIZE - 1] = 1;
+
+	for (i = 0; i < ARRAY_SIZE(uksm_benches); i++) {
+		const struct uksm_bench *b = &uksm_benches[i];
+		volatile int ret;
+		u64 start, elapsed;
+		unsigned long loops = 0;
+
+		start = ktime_get_ns();
+		do {
+			int j;
+
+			for (j = 0; j < 64; j++)
+				ret = b->fn(addr1, addr2);
+			loops += 64;
+			elapsed = ktime_get_ns() - start;
+			cond_resched();
+		} while (elapsed < UKSM_BENCH_NS);
+
+		len += sprintf(buf + len, "%s %llu\n", b->name,
+			       div64_u64((u64)loops * NSEC_PER_SEC, elapsed));
+	}
+out:
+	free_page((unsigned long)addr1);
+	free_page((unsigned long)addr2);
+
+	return len;
+}
+UKSM_ATTR_RO(kernel_bench);
+
 static struct attribute *uksm_attrs[] = {
 	&max_cpu_percentage_attr.attr,
 	&sleep_millisecs_attr.attr,
@@ -5280,6 +5791,13 @@ static struct attribute *uksm_attrs[] = {
 	&abundant_threshold_attr.attr,
 	&cpu_ratios_attr.attr,
 	&eval_intervals_attr.attr,
+	&kernel_bench_attr.attr,
+	&workers_attr.attr,
+	&worker_cpus_attr.attr,
+	&thermal_zone_attr.attr,
+	&thermal_limit_attr.attr,
+	&battery_limit_attr.attr,
+	&worker_stat_attr.attr,
 	NULL,
 };
 
@@ -5521,6 +6039,8 @@ static int __init uksm_init(void)
 	uksm_sleep_jiffies = msecs_to_jiffies(100);
 	uksm_sleep_saved = uksm_sleep_jiffies;
 
+	uksm_select_kernels();
+
 	slot_tree_init();
 	init_scan_ladder();
 
@@ -5537,12 +6057,21 @@ static int __init uksm_init(void)
 	if (err)
 		goto out_free0;
 
-	uksm_thread = kthread_run(uksm_scan_thread, NULL, "uksmd");
+	cpumask_and(&uksm_worker_cpus, topology_core_cpumask(0),
+		    cpu_possible_mask);
+	if (cpumask_empty(&uksm_worker_cpus))
+		cpumask_copy(&uksm_worker_cpus, cpu_possible_mask);
+
+	uksm_thread = kthread_create(uksm_scan_thread, &uksm_workers[0],
+				     "uksmd");
 	if (IS_ERR(uksm_thread)) {
 		pr_err("uksm: creating kthread failed\n");
 		err = PTR_ERR(uksm_thread);
 		goto out_free;
 	}
+	set_cpus_allowed_ptr(uksm_thread, &uksm_worker_cpus);
+	uksm_workers[0].task = uksm_thread;
+	wake_up_process(uksm_thread);
 
 #ifdef CONFIG_SYSFS
 	err = sysfs_create_group(mm_kobj, &uksm_attr_group);
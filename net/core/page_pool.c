@@ -0,0 +1,246 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * net/core/page_pool.c - recycled, DMA mapped pages for driver RX
+ *
+ * Each cpu keeps the pages it handed out on a ring, oldest first. An
+ * allocation reuses the oldest page once its only user left is the pool,
+ * otherwise it takes a new page from the page allocator. When the ring is
+ * full of pages the stack still holds, the oldest one leaves the pool and
+ * goes back to the page allocator on its last put_page().
+ */
+
+#include <linux/debugfs.h>
+#include <linux/dma-mapping.h>
+#include <linux/export.h>
+#include <linux/interrupt.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <net/page_pool.h>
+
+#define PAGE_POOL_SIZE_DEFAULT	256
+
+struct page_pool_cpu {
+	struct page	**ring;
+	unsigned int	head;
+	unsigned int	count;
+	u64		recycled;
+	u64		allocated;
+	u64		released;
+};
+
+static LIST_HEAD(page_pools);
+static DEFINE_MUTEX(page_pools_lock);
+static struct dentry *page_pool_debugfs;
+
+static void page_pool_release(struct page_pool *pool, struct page *page)
+{
+	/* the stack may still read it, its cache lines are not ours */
+	if (pool->p.dev)
+		dma_unmap_page_attrs(pool->p.dev, page_pool_get_dma_addr(page),
+				     PAGE_SIZE << pool->p.order,
+				     pool->p.dma_dir, DMA_ATTR_SKIP_CPU_SYNC);
+	set_page_private(page, 0);
+	put_page(page);
+}
+
+static struct page *page_pool_new_page(struct page_pool *pool, gfp_t gfp)
+{
+	struct page *page;
+	dma_addr_t dma = 0;
+
+	if (pool->p.order)
+		gfp |= __GFP_COMP;
+
+	page = alloc_pages_node(pool->p.nid, gfp, pool->p.order);
+	if (!page)
+		return NULL;
+
+	if (pool->p.dev) {
+		dma = dma_map_page_attrs(pool->p.dev, page, 0,
+					 PAGE_SIZE << pool->p.order,
+					 pool->p.dma_dir,
+					 DMA_ATTR_SKIP_CPU_SYNC);
+		if (dma_mapping_error(pool->p.dev, dma)) {
+			put_page(page);
+			return NULL;
+		}
+	}
+	set_page_private(page, dma);
+
+	return page;
+}
+
+struct page *page_pool_alloc_pages(struct page_pool *pool, gfp_t gfp)
+{
+	unsigned int size = pool->p.pool_size;
+	struct page_pool_cpu *pc;
+	struct page *page = NULL;
+	bool recycled = false;
+
+	local_bh_disable();
+	pc = this_cpu_ptr(pool->cpu);
+
+	if (pc->count) {
+		page = pc->ring[pc->head];
+		if (page_ref_count(page) == 1) {
+			/* move it to the tail, as the newest one */
+			pc->ring[(pc->head + pc->count) % size] = page;
+			pc->head = (pc->head + 1) % size;
+			pc->recycled++;
+			recycled = true;
+			goto out;
+		}
+
+		if (pc->count == size) {
+			pc->head = (pc->head + 1) % size;
+			pc->count--;
+			pc->released++;
+			page_pool_release(pool, page);
+		}
+	}
+
+	page = page_pool_new_page(pool, gfp);
+	if (!page)
+		goto unlock;
+	pc->ring[(pc->head + pc->count) % size] = page;
+	pc->count++;
+	pc->allocated++;
+out:
+	/* the reference of the caller, the ring keeps its own */
+	page_ref_inc(page);
+unlock:
+	local_bh_enable();
+
+	/* the CPU may have written to it while the stack had it */
+	if (recycled && pool->p.dev)
+		dma_sync_single_for_device(pool->p.dev,
+					   page_pool_get_dma_addr(page),
+					   PAGE_SIZE << pool->p.order,
+					   pool->p.dma_dir);
+
+	return page;
+}
+EXPORT_SYMBOL(page_pool_alloc_pages);
+
+struct page_pool *page_pool_create(const struct page_pool_params *params)
+{
+	struct page_pool *pool;
+	struct page_pool_cpu *pc;
+	int cpu;
+
+	pool = kzalloc(sizeof(*pool), GFP_KERNEL);
+	if (!pool)
+		return ERR_PTR(-ENOMEM);
+
+	pool->p = *params;
+	if (!pool->p.pool_size)
+		pool->p.pool_size = PAGE_POOL_SIZE_DEFAULT;
+	if (!pool->p.name)
+		pool->p.name = "unnamed";
+
+	pool->cpu = alloc_percpu(struct page_pool_cpu);
+	if (!pool->cpu)
+		goto err_free;
+
+	for_each_possible_cpu(cpu) {
+		pc = per_cpu_ptr(pool->cpu, cpu);
+		pc->ring = kcalloc_node(pool->p.pool_size, sizeof(*pc->ring),
+					GFP_KERNEL, cpu_to_node(cpu));
+		if (!pc->ring)
+			goto err_ring;
+	}
+
+	mutex_lock(&page_pools_lock);
+	list_add_tail(&pool->list, &page_pools);
+	mutex_unlock(&page_pools_lock);
+
+	return pool;
+
+err_ring:
+	for_each_possible_cpu(cpu)
+		kfree(per_cpu_ptr(pool->cpu, cpu)->ring);
+	free_percpu(pool->cpu);
+err_free:
+	kfree(pool);
+	return ERR_PTR(-ENOMEM);
+}
+EXPORT_SYMBOL(page_pool_create);
+
+/* Pages still held by the stack are freed on their last put_page() */
+void page_pool_destroy(struct page_pool *pool)
+{
+	struct page_pool_cpu *pc;
+	int cpu;
+
+	if (!pool)
+		return;
+
+	mutex_lock(&page_pools_lock);
+	list_del(&pool->list);
+	mutex_unlock(&page_pools_lock);
+
+	for_each_possible_cpu(cpu) {
+		pc = per_cpu_ptr(pool->cpu, cpu);
+		while (pc->count) {
+			page_pool_release(pool, pc->ring[pc->head]);
+			pc->head = (pc->head + 1) % pool->p.pool_size;
+			pc->count--;
+		}
+		kfree(pc->ring);
+	}
+	free_percpu(pool->cpu);
+	kfree(pool);
+}
+EXPORT_SYMBOL(page_pool_destroy);
+
+static int page_pool_stats_show(struct seq_file *s, void *unused)
+{
+	struct page_pool_cpu *pc;
+	struct page_pool *pool;
+	u64 recycled, allocated, released;
+	unsigned int count;
+	int cpu;
+
+	seq_printf(s, "%-16s %8s %12s %12s %12s\n", "name", "pages",
+		   "recycled", "allocated", "released");
+
+	mutex_lock(&page_pools_lock);
+	list_for_each_entry(pool, &page_pools, list) {
+		recycled = allocated = released = 0;
+		count = 0;
+		for_each_possible_cpu(cpu) {
+			pc = per_cpu_ptr(pool->cpu, cpu);
+			count += READ_ONCE(pc->count);
+			recycled += READ_ONCE(pc->recycled);
+			allocated += READ_ONCE(pc->allocated);
+			released += READ_ONCE(pc->released);
+		}
+		seq_printf(s, "%-16s %8u %12llu %12llu %12llu\n",
+			   pool->p.name, count, recycled, allocated, released);
+	}
+	mutex_unlock(&page_pools_lock);
+
+	return 0;
+}
+
+static int page_pool_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, page_pool_stats_show, inode->i_private);
+}
+
+static const struct file_operations page_pool_stats_fops = {
+	.open		= page_pool_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init page_pool_init(void)
+{
+	page_pool_debugfs = debugfs_create_file("page_pool", 0444, NULL, NULL,
+						&page_pool_stats_fops);
+	return 0;
+}
+late_initcall(page_pool_init);
@@ -21,20 +21,286 @@
 #include <linux/export.h>
 #include <linux/netlink.h>
 #include <linux/sockev.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/rculist.h>
+#include <linux/workqueue.h>
+#include <net/netlink.h>
 #include <net/sock.h>
 
+#define SOCKEV_EV_MAX		8
+#define SOCKEV_FILTERS_MAX	16
+
+/* Events queued for up to this long are sent together, 0 sends at once */
+static unsigned int sockev_batch_ms;
+module_param(sockev_batch_ms, uint, 0644);
+MODULE_PARM_DESC(sockev_batch_ms, "Delay to batch socket events in one skb");
+
+struct sockev_filter {
+	struct list_head list;
+	struct rcu_head rcu;
+	u32 portid;
+	struct sknlsockevfilter f;
+};
+
+struct sockev_stats {
+	atomic_long_t sent;
+	atomic_long_t suppressed;
+	atomic_long_t dropped;
+};
+
 static int registration_status;
 static struct sock *socknlmsgsk;
 
+static LIST_HEAD(sockev_filters);
+static DEFINE_MUTEX(sockev_filter_lock);
+static int sockev_nr_filters;
+
+static struct sockev_stats sockev_stats[SOCKEV_EV_MAX];
+
+/* events not sent yet when batching, under sockev_batch_lock */
+static DEFINE_MUTEX(sockev_batch_lock);
+static struct sk_buff *sockev_batch_skb;
+static unsigned int sockev_batch_cnt[SOCKEV_EV_MAX];
+static void sockev_batch_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(sockev_batch_work, sockev_batch_work_fn);
+
+static struct dentry *sockev_debugfs;
+
+static struct sockev_filter *sockev_filter_find(u32 portid)
+{
+	struct sockev_filter *filter;
+
+	list_for_each_entry(filter, &sockev_filters, list)
+		if (filter->portid == portid)
+			return filter;
+
+	return NULL;
+}
+
+static void sockev_filter_del(u32 portid)
+{
+	struct sockev_filter *filter;
+
+	mutex_lock(&sockev_filter_lock);
+	filter = sockev_filter_find(portid);
+	if (filter) {
+		list_del_rcu(&filter->list);
+		sockev_nr_filters--;
+		kfree_rcu(filter, rcu);
+	}
+	mutex_unlock(&sockev_filter_lock);
+}
+
+static int sockev_filter_set(u32 portid, struct sknlsockevfilter *f)
+{
+	struct sockev_filter *filter, *old;
+	int ret = 0;
+
+	if (!f->events) {
+		sockev_filter_del(portid);
+		return 0;
+	}
+
+	filter = kzalloc(sizeof(*filter), GFP_KERNEL);
+	if (!filter)
+		return -ENOMEM;
+	filter->portid = portid;
+	filter->f = *f;
+
+	mutex_lock(&sockev_filter_lock);
+	old = sockev_filter_find(portid);
+	if (old) {
+		list_replace_rcu(&old->list, &filter->list);
+		kfree_rcu(old, rcu);
+	} else if (sockev_nr_filters >= SOCKEV_FILTERS_MAX) {
+		kfree(filter);
+		ret = -ENOSPC;
+	} else {
+		list_add_tail_rcu(&filter->list, &sockev_filters);
+		sockev_nr_filters++;
+	}
+	mutex_unlock(&sockev_filter_lock);
+
+	return ret;
+}
+
+static int sockev_rcv_msg(struct sk_buff *skb, struct nlmsghdr *nlh,
+			  struct netlink_ext_ack *extack)
+{
+	if (nlh->nlmsg_type != SOCKEV_MSG_FILTER)
+		return -EOPNOTSUPP;
+
+	if (!netlink_capable(skb, CAP_NET_ADMIN))
+		return -EPERM;
+
+	if (nlmsg_len(nlh) < sizeof(struct sknlsockevfilter))
+		return -EINVAL;
+
+	return sockev_filter_set(NETLINK_CB(skb).portid, nlmsg_data(nlh));
+}
+
 static void sockev_skmsg_recv(struct sk_buff *skb)
 {
-	pr_debug("%s(): Got unsolicited request\n", __func__);
+	netlink_rcv_skb(skb, &sockev_rcv_msg);
 }
 
+static int sockev_netlink_event(struct notifier_block *nb,
+				unsigned long event, void *ptr)
+{
+	struct netlink_notify *n = ptr;
+
+	if (event == NETLINK_URELEASE && n->protocol == NETLINK_SOCKEV)
+		sockev_filter_del(n->portid);
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block sockev_netlink_notifier = {
+	.notifier_call = sockev_netlink_event,
+};
+
 static struct netlink_kernel_cfg nlcfg = {
 	.input = sockev_skmsg_recv
 };
 
+/* Only events some listener asked for are worth an skb */
+static bool sockev_wanted(unsigned long event, struct sock *sk)
+{
+	struct sockev_filter *filter;
+	u32 uid;
+	bool wanted = false;
+
+	rcu_read_lock();
+	if (list_empty(&sockev_filters)) {
+		rcu_read_unlock();
+		return (sk->sk_family == AF_INET ||
+			sk->sk_family == AF_INET6) &&
+		       (event == SOCKEV_BIND || event == SOCKEV_LISTEN);
+	}
+
+	uid = from_kuid_munged(&init_user_ns, current_uid());
+	list_for_each_entry_rcu(filter, &sockev_filters, list) {
+		if (!(filter->f.events & BIT(event)))
+			continue;
+		if (filter->f.uid != SOCKEV_UID_ANY && filter->f.uid != uid)
+			continue;
+		if (filter->f.families && (sk->sk_family >= 64 ||
+		    !(filter->f.families & BIT_ULL(sk->sk_family))))
+			continue;
+		wanted = true;
+		break;
+	}
+	rcu_read_unlock();
+
+	return wanted;
+}
+
+static void sockev_fill(struct nlmsghdr *nlh, unsigned long event,
+			struct sock *sk);
+
+static void sockev_send(struct sk_buff *skb, unsigned int *cnt)
+{
+	int ret, i;
+
+	ret = nlmsg_notify(socknlmsgsk, skb, 0, SKNLGRP_SOCKEV, 0, GFP_KERNEL);
+	for (i = 0; i < SOCKEV_EV_MAX; i++) {
+		if (!cnt[i])
+			continue;
+		if (ret && ret != -ESRCH)
+			atomic_long_add(cnt[i], &sockev_stats[i].dropped);
+		else
+			atomic_long_add(cnt[i], &sockev_stats[i].sent);
+	}
+}
+
+static void sockev_batch_flush(void)
+{
+	unsigned int cnt[SOCKEV_EV_MAX];
+	struct sk_buff *skb;
+
+	mutex_lock(&sockev_batch_lock);
+	skb = sockev_batch_skb;
+	sockev_batch_skb = NULL;
+	memcpy(cnt, sockev_batch_cnt, sizeof(cnt));
+	memset(sockev_batch_cnt, 0, sizeof(sockev_batch_cnt));
+	mutex_unlock(&sockev_batch_lock);
+
+	if (skb)
+		sockev_send(skb, cnt);
+}
+
+static void sockev_batch_work_fn(struct work_struct *work)
+{
+	sockev_batch_flush();
+}
+
+/* Append the event to the pending skb, sent when full or on timeout */
+static void sockev_batch_add(unsigned long event, struct sock *sk)
+{
+	unsigned int cnt[SOCKEV_EV_MAX];
+	struct sk_buff *full = NULL;
+	struct nlmsghdr *nlh;
+
+	mutex_lock(&sockev_batch_lock);
+	if (sockev_batch_skb) {
+		nlh = nlmsg_put(sockev_batch_skb, 0, 0, event,
+				sizeof(struct sknlsockevmsg), 0);
+		if (nlh)
+			goto fill;
+		full = sockev_batch_skb;
+		sockev_batch_skb = NULL;
+		memcpy(cnt, sockev_batch_cnt, sizeof(cnt));
+		memset(sockev_batch_cnt, 0, sizeof(sockev_batch_cnt));
+	}
+
+	sockev_batch_skb = nlmsg_new(NLMSG_GOODSIZE, GFP_KERNEL);
+	if (!sockev_batch_skb) {
+		atomic_long_inc(&sockev_stats[event].dropped);
+		goto unlock;
+	}
+	NETLINK_CB(sockev_batch_skb).dst_group = SKNLGRP_SOCKEV;
+	nlh = nlmsg_put(sockev_batch_skb, 0, 0, event,
+			sizeof(struct sknlsockevmsg), 0);
+	schedule_delayed_work(&sockev_batch_work,
+			      msecs_to_jiffies(sockev_batch_ms));
+fill:
+	sockev_fill(nlh, event, sk);
+	sockev_batch_cnt[event]++;
+unlock:
+	mutex_unlock(&sockev_batch_lock);
+
+	if (full)
+		sockev_send(full, cnt);
+}
+
+static int sockev_stats_show(struct seq_file *s, void *unused)
+{
+	int i;
+
+	seq_printf(s, "%-6s %12s %12s %12s\n", "event", "sent",
+		   "suppressed", "dropped");
+	for (i = 0; i < SOCKEV_EV_MAX; i++)
+		seq_printf(s, "%-6d %12ld %12ld %12ld\n", i,
+			   atomic_long_read(&sockev_stats[i].sent),
+			   atomic_long_read(&sockev_stats[i].suppressed),
+			   atomic_long_read(&sockev_stats[i].dropped));
+
+	return 0;
+}
+
+static int sockev_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sockev_stats_show, inode->i_private);
+}
+
+static const struct file_operations sockev_stats_fops = {
+	.open		= sockev_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static void _sockev_event(unsigned long event, __u8 *evstr, int buflen)
 {
 
@@ -62,53 +328,69 @@ static void _sockev_event(unsigned long event, __u8 *evstr, int buflen)
 	}
 }
 
+static void sockev_fill(struct nlmsghdr *nlh, unsigned long event,
+			struct sock *sk)
+{
+	struct sknlsockevmsg *smsg;
+
+	smsg = nlmsg_data(nlh);
+	memset(smsg, 0, sizeof(struct sknlsockevmsg));
+	smsg->pid = current->pid;
+	_sockev_event(event, smsg->event, sizeof(smsg->event));
+	smsg->skfamily = sk->sk_family;
+	smsg->skstate = sk->sk_state;
+	smsg->skprotocol = sk->sk_protocol;
+	smsg->sktype = sk->sk_type;
+	smsg->skflags = sk->sk_flags;
+}
+
 static int sockev_client_cb(struct notifier_block *nb,
 			    unsigned long event, void *data)
 {
+	unsigned int cnt[SOCKEV_EV_MAX] = { 0 };
 	struct sk_buff *skb;
 	struct nlmsghdr *nlh;
-	struct sknlsockevmsg *smsg;
 	struct socket *sock;
 	struct sock *sk;
 
 	sock = (struct socket *)data;
-	if (!socknlmsgsk || !sock)
+	if (!socknlmsgsk || !sock || event >= SOCKEV_EV_MAX)
 		goto sk_null;
 
 	sk = sock->sk;
 	if (!sk)
 		goto sk_null;
 
-	sock_hold(sk);
+	if (!netlink_has_listeners(socknlmsgsk, SKNLGRP_SOCKEV) ||
+	    !sockev_wanted(event, sk)) {
+		atomic_long_inc(&sockev_stats[event].suppressed);
+		goto sk_null;
+	}
 
-	if (sk->sk_family != AF_INET && sk->sk_family != AF_INET6)
-		goto done;
+	sock_hold(sk);
 
-	if (event != SOCKEV_BIND && event != SOCKEV_LISTEN)
+	if (sockev_batch_ms) {
+		sockev_batch_add(event, sk);
 		goto done;
+	}
 
 	skb = nlmsg_new(sizeof(struct sknlsockevmsg), GFP_KERNEL);
 	if (!skb)
-		goto done;
+		goto drop;
 
 	nlh = nlmsg_put(skb, 0, 0, event, sizeof(struct sknlsockevmsg), 0);
 	if (!nlh) {
 		kfree_skb(skb);
-		goto done;
+		goto drop;
 	}
 
 	NETLINK_CB(skb).dst_group = SKNLGRP_SOCKEV;
-
-	smsg = nlmsg_data(nlh);
-	memset(smsg, 0, sizeof(struct sknlsockevmsg));
-	smsg->pid = current->pid;
-	_sockev_event(event, smsg->event, sizeof(smsg->event));
-	smsg->skfamily = sk->sk_family;
-	smsg->skstate = sk->sk_state;
-	smsg->skprotocol = sk->sk_protocol;
-	smsg->sktype = sk->sk_type;
-	smsg->skflags = sk->sk_flags;
-	nlmsg_notify(socknlmsgsk, skb, 0, SKNLGRP_SOCKEV, 0, GFP_KERNEL);
+	sockev_fill(nlh, event, sk);
+	cnt[event] = 1;
+	sockev_send(skb, cnt);
+	goto done;
+drop:
+	atomic_long_inc(&sockev_stats[event].dropped);
 done:
 	sock_put(sk);
 sk_null:
@@ -139,8 +421,13 @@ static int __init sockev_client_init(void)
 		if (registration_status)
 			sockev_unregister_notify(&sockev_notifier_client);
 		registration_status = 0;
+		return rc;
 	}
 
+	netlink_register_notifier(&sockev_netlink_notifier);
+	sockev_debugfs = debugfs_create_file("sockev_stats", 0444, NULL, NULL,
+					     &sockev_stats_fops);
+
 	return rc;
 }
 
@@ -148,6 +435,10 @@ static void __exit sockev_client_exit(void)
 {
 	if (registration_status)
 		sockev_unregister_notify(&sockev_notifier_client);
+	cancel_delayed_work_sync(&sockev_batch_work);
+	sockev_batch_flush();
+	netlink_unregister_notifier(&sockev_netlink_notifier);
+	debugfs_remove(sockev_debugfs);
 }
 
 module_init(sockev_client_init)
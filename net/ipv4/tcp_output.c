@@ -949,22 +949,40 @@ enum hrtimer_restart tcp_pace_kick(struct hrtimer *timer)
 	return HRTIMER_NORESTART;
 }
 
-static void tcp_internal_pacing(struct sock *sk, const struct sk_buff *skb)
+/* The egress device releases skbs at their departure time itself */
+static bool tcp_pacing_offloaded(const struct sock *sk)
 {
-	u64 len_ns;
+	const struct dst_entry *dst = __sk_dst_get(sk);
+
+	return dst && dst->dev && (dst->dev->priv_flags & IFF_TX_EDT);
+}
+
+/* Returns the departure time of skb when the device paces it, else 0 */
+static u64 tcp_internal_pacing(struct sock *sk, const struct sk_buff *skb)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	u64 len_ns, edt_ns;
 	u32 rate;
 
 	if (!tcp_needs_internal_pacing(sk))
-		return;
+		return 0;
 	rate = sk->sk_pacing_rate;
 	if (!rate || rate == ~0U)
-		return;
+		return 0;
 
 	len_ns = (u64)skb->len * NSEC_PER_SEC;
 	do_div(len_ns, rate);
-	hrtimer_start(&tcp_sk(sk)->pacing_timer,
+
+	if (tcp_pacing_offloaded(sk)) {
+		edt_ns = tp->tcp_wstamp_ns;
+		tp->tcp_wstamp_ns += len_ns;
+		return edt_ns;
+	}
+
+	hrtimer_start(&tp->pacing_timer,
 		      ktime_add_ns(ktime_get(), len_ns),
 		      HRTIMER_MODE_ABS_PINNED);
+	return 0;
 }
 
 /* This routine actually transmits TCP packets queued in by
@@ -990,6 +1008,7 @@ static int __tcp_transmit_skb(struct sock *sk, struct sk_buff *skb,
 	struct sk_buff *oskb = NULL;
 	struct tcp_md5sig_key *md5;
 	struct tcphdr *th;
+	u64 edt_ns = 0;
 	int err;
 
 	BUG_ON(!skb || !tcp_skb_pcount(skb));
@@ -1098,7 +1117,7 @@ static int __tcp_transmit_skb(struct sock *sk, struct sk_buff *skb,
 	if (skb->len != tcp_header_size) {
 		tcp_event_data_sent(tp, sk);
 		tp->data_segs_out += tcp_skb_pcount(skb);
-		tcp_internal_pacing(sk, skb);
+		edt_ns = tcp_internal_pacing(sk, skb);
 	}
 
 	if (after(tcb->end_seq, tp->snd_nxt) || tcb->seq == tcb->end_seq)
@@ -1110,8 +1129,10 @@ static int __tcp_transmit_skb(struct sock *sk, struct sk_buff *skb,
 	skb_shinfo(skb)->gso_segs = tcp_skb_pcount(skb);
 	skb_shinfo(skb)->gso_size = tcp_skb_mss(skb);
 
-	/* Our usage of tstamp should remain private */
-	skb->tstamp = 0;
+	/* Our usage of tstamp should remain private, only a departure
+	 * time for an IFF_TX_EDT device is passed down
+	 */
+	skb->tstamp = edt_ns;
 
 	/* Cleanup our debris for IP stacks */
 	memset(skb->cb, 0, max(sizeof(struct inet_skb_parm),
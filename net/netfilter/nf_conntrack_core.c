@@ -103,6 +103,37 @@ static __read_mostly bool nf_conntrack_locks_all;
 
 static struct conntrack_gc_work conntrack_gc_work;
 
+/*
+ * Per-cpu cache of assured conntracks in front of the hash table, for the
+ * lookups of established flows. A slot holds a reference on its conntrack
+ * and is only ever taken or refilled with xchg(), the gc worker drops the
+ * ones that died or expired.
+ */
+#define NF_CT_PCPU_CACHE_SIZE	64
+
+struct nf_ct_pcpu_cache_slot {
+	struct nf_conntrack_tuple_hash	*h;
+	u32				hash;
+	unsigned int			gen;
+	unsigned long			stamp;
+};
+
+struct nf_ct_pcpu_cache {
+	struct nf_ct_pcpu_cache_slot	slot[NF_CT_PCPU_CACHE_SIZE];
+};
+
+static DEFINE_PER_CPU(struct nf_ct_pcpu_cache, nf_ct_pcpu_cache);
+/* bumped when conntracks change under the cache, e.g. on a flush */
+static atomic_t nf_ct_pcpu_cache_gen;
+
+static bool nf_ct_pcpu_cache_enable __read_mostly = true;
+module_param_named(pcpu_cache, nf_ct_pcpu_cache_enable, bool, 0644);
+MODULE_PARM_DESC(pcpu_cache, "Cache established conntracks per cpu");
+
+static unsigned int nf_ct_pcpu_cache_ttl_ms __read_mostly = 1000;
+module_param_named(pcpu_cache_ttl_ms, nf_ct_pcpu_cache_ttl_ms, uint, 0644);
+MODULE_PARM_DESC(pcpu_cache_ttl_ms, "Lifetime of a per cpu cache entry");
+
 void nf_conntrack_lock(spinlock_t *lock) __acquires(lock)
 {
 	/* 1) Acquire the lock */
@@ -649,6 +680,112 @@ ____nf_conntrack_find(struct net *net, const struct nf_conntrack_zone *zone,
 	return NULL;
 }
 
+static void nf_ct_pcpu_cache_drop(struct nf_conntrack_tuple_hash *h)
+{
+	if (h)
+		nf_ct_put(nf_ct_tuplehash_to_ctrack(h));
+}
+
+static bool nf_ct_pcpu_cache_stale(const struct nf_ct_pcpu_cache_slot *slot,
+				   struct nf_conn *ct)
+{
+	return !nf_ct_pcpu_cache_enable ||
+	       slot->gen != atomic_read(&nf_ct_pcpu_cache_gen) ||
+	       time_after(jiffies, slot->stamp +
+			  msecs_to_jiffies(nf_ct_pcpu_cache_ttl_ms)) ||
+	       nf_ct_is_dying(ct) || nf_ct_is_expired(ct);
+}
+
+/* Disables preemption until put_cpu_ptr(&nf_ct_pcpu_cache) */
+static struct nf_ct_pcpu_cache_slot *nf_ct_pcpu_cache_slot(u32 hash)
+{
+	struct nf_ct_pcpu_cache *cache = get_cpu_ptr(&nf_ct_pcpu_cache);
+
+	return &cache->slot[hash & (NF_CT_PCPU_CACHE_SIZE - 1)];
+}
+
+/* Returns the cached conntrack with a reference for the caller */
+static struct nf_conntrack_tuple_hash *
+nf_ct_pcpu_cache_get(struct net *net, const struct nf_conntrack_zone *zone,
+		     const struct nf_conntrack_tuple *tuple, u32 hash)
+{
+	struct nf_ct_pcpu_cache_slot *slot;
+	struct nf_conntrack_tuple_hash *h, *old = NULL;
+	struct nf_conn *ct;
+
+	slot = nf_ct_pcpu_cache_slot(hash);
+	h = xchg(&slot->h, NULL);
+	if (!h)
+		goto out;
+
+	ct = nf_ct_tuplehash_to_ctrack(h);
+	if (nf_ct_pcpu_cache_stale(slot, ct)) {
+		old = h;
+		h = NULL;
+		goto out;
+	}
+
+	if (slot->hash != hash || !nf_ct_key_equal(h, tuple, zone, net)) {
+		old = xchg(&slot->h, h);
+		h = NULL;
+		goto out;
+	}
+
+	/* the slot keeps its own reference */
+	atomic_inc(&ct->ct_general.use);
+	old = xchg(&slot->h, h);
+out:
+	put_cpu_ptr(&nf_ct_pcpu_cache);
+	nf_ct_pcpu_cache_drop(old);
+
+	return h;
+}
+
+static void nf_ct_pcpu_cache_add(struct nf_conntrack_tuple_hash *h, u32 hash)
+{
+	struct nf_conn *ct = nf_ct_tuplehash_to_ctrack(h);
+	struct nf_ct_pcpu_cache_slot *slot;
+	struct nf_conntrack_tuple_hash *old;
+
+	if (!nf_ct_pcpu_cache_enable || !test_bit(IPS_ASSURED_BIT, &ct->status))
+		return;
+
+	/* the caller holds a reference */
+	atomic_inc(&ct->ct_general.use);
+
+	slot = nf_ct_pcpu_cache_slot(hash);
+	slot->hash = hash;
+	slot->gen = atomic_read(&nf_ct_pcpu_cache_gen);
+	slot->stamp = jiffies;
+	old = xchg(&slot->h, h);
+	put_cpu_ptr(&nf_ct_pcpu_cache);
+
+	nf_ct_pcpu_cache_drop(old);
+}
+
+/* Drop stale slots of all cpus, or every slot when @all */
+static void nf_ct_pcpu_cache_flush(bool all)
+{
+	struct nf_ct_pcpu_cache_slot *slot;
+	struct nf_conntrack_tuple_hash *h;
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		for (i = 0; i < NF_CT_PCPU_CACHE_SIZE; i++) {
+			slot = &per_cpu_ptr(&nf_ct_pcpu_cache, cpu)->slot[i];
+			if (!READ_ONCE(slot->h))
+				continue;
+
+			h = xchg(&slot->h, NULL);
+			if (h && !all &&
+			    !nf_ct_pcpu_cache_stale(slot,
+					nf_ct_tuplehash_to_ctrack(h)))
+				h = xchg(&slot->h, h);
+			nf_ct_pcpu_cache_drop(h);
+		}
+	}
+}
+
 /* Find a connection corresponding to a tuple. */
 static struct nf_conntrack_tuple_hash *
 __nf_conntrack_find_get(struct net *net, const struct nf_conntrack_zone *zone,
@@ -657,6 +794,12 @@ __nf_conntrack_find_get(struct net *net, const struct nf_conntrack_zone *zone,
 	struct nf_conntrack_tuple_hash *h;
 	struct nf_conn *ct;
 
+	if (nf_ct_pcpu_cache_enable) {
+		h = nf_ct_pcpu_cache_get(net, zone, tuple, hash);
+		if (h)
+			return h;
+	}
+
 	rcu_read_lock();
 begin:
 	h = ____nf_conntrack_find(net, zone, tuple, hash);
@@ -670,6 +813,7 @@ __nf_conntrack_find_get(struct net *net, const struct nf_conntrack_zone *zone,
 				nf_ct_put(ct);
 				goto begin;
 			}
+			nf_ct_pcpu_cache_add(h, hash);
 		}
 	}
 	rcu_read_unlock();
@@ -1160,6 +1304,8 @@ static void gc_worker(struct work_struct *work)
 		cond_resched_tasks_rcu_qs();
 	} while (++buckets < goal);
 
+	nf_ct_pcpu_cache_flush(false);
+
 	if (gc_work->exiting)
 		return;
 
@@ -1876,7 +2022,10 @@ void nf_ct_iterate_cleanup_net(struct net *net,
 	d.data = data;
 	d.net = net;
 
+	/* entries may be rewritten or gone after this, e.g. masquerade */
+	atomic_inc(&nf_ct_pcpu_cache_gen);
 	nf_ct_iterate_cleanup(iter_net_only, &d, portid, report);
+	nf_ct_pcpu_cache_flush(false);
 }
 EXPORT_SYMBOL_GPL(nf_ct_iterate_cleanup_net);
 
@@ -1988,6 +2137,7 @@ void nf_conntrack_cleanup_net_list(struct list_head *net_exit_list)
 	synchronize_net();
 i_see_dead_people:
 	busy = 0;
+	nf_ct_pcpu_cache_flush(true);
 	list_for_each_entry(net, net_exit_list, exit_list) {
 		nf_ct_iterate_cleanup(kill_all, net, 0, 0);
 		if (atomic_read(&net->ct.count) != 0)
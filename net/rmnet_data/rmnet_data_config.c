@@ -928,6 +928,12 @@ int _rmnet_set_logical_endpoint_config(struct net_device *dev,
 	else
 		epconfig_l->mux_id = config_id;
 
+	/* A VND paces like the device its uplink goes out on */
+	if (config_id == RMNET_LOCAL_LOGICAL_ENDPOINT &&
+	    rmnet_vnd_is_vnd(dev) &&
+	    (epconfig_l->egress_dev->priv_flags & IFF_TX_EDT))
+		dev->priv_flags |= IFF_TX_EDT;
+
 	/* Explicitly hold a reference to the egress device */
 	dev_hold(epconfig_l->egress_dev);
 	return RMNET_CONFIG_OK;
@@ -963,6 +969,9 @@ int _rmnet_unset_logical_endpoint_config(struct net_device *dev,
 	if (!epconfig_l || !epconfig_l->refcount)
 		return RMNET_CONFIG_NO_SUCH_DEVICE;
 
+	if (config_id == RMNET_LOCAL_LOGICAL_ENDPOINT && rmnet_vnd_is_vnd(dev))
+		dev->priv_flags &= ~IFF_TX_EDT;
+
 	/* Explicitly release the reference from the egress device */
 	dev_put(epconfig_l->egress_dev);
 	memset(epconfig_l, 0, sizeof(struct rmnet_logical_ep_conf_s));
@@ -121,6 +121,7 @@ struct msm_sdw_priv {
 
 	struct mutex sdw_read_lock;
 	struct mutex sdw_write_lock;
+	ktime_t sdw_wr_time;	/* of the last SWR bridge write */
 	struct mutex sdw_clk_lock;
 	int sdw_clk_users;
 	int sdw_mclk_users;
@@ -53,6 +53,7 @@
  * after Sub System Restart
  */
 #define ADSP_STATE_READY_TIMEOUT_MS 200
+#define MSM_SDW_BRIDGE_WR_US 100
 
 static const DECLARE_TLV_DB_SCALE(digital_gain, 0, 1, 0);
 static struct snd_soc_dai_driver msm_sdw_dai[];
@@ -1127,37 +1128,44 @@ static int msm_sdw_swrm_read(void *handle, int reg)
 	return ret;
 }
 
+/*
+ * SWR slave write takes time, allow for any previous pending write to
+ * complete. Only what is left of it is slept, back to back writes still
+ * wait the whole time.
+ */
+static void msm_sdw_bridge_wait(struct msm_sdw_priv *msm_sdw)
+{
+	s64 us = ktime_us_delta(ktime_get(), msm_sdw->sdw_wr_time);
+
+	if (us >= 0 && us < MSM_SDW_BRIDGE_WR_US)
+		usleep_range(MSM_SDW_BRIDGE_WR_US - us,
+			     MSM_SDW_BRIDGE_WR_US - us + 5);
+}
+
 static int msm_sdw_bulk_write(struct msm_sdw_priv *msm_sdw,
 				struct msm_sdw_reg_val *bulk_reg,
 				size_t len)
 {
 	int i, ret = 0;
-	unsigned short sdw_wr_addr_base;
 	unsigned short sdw_wr_data_base;
+	u8 buf[8];
 
-	sdw_wr_addr_base = MSM_SDW_AHB_BRIDGE_WR_ADDR_0;
+	/* WR_ADDR_0..3 follow WR_DATA_0..3, so one transfer covers both */
+	BUILD_BUG_ON(MSM_SDW_AHB_BRIDGE_WR_ADDR_0 !=
+		     MSM_SDW_AHB_BRIDGE_WR_DATA_0 + 4 * 4);
 	sdw_wr_data_base = MSM_SDW_AHB_BRIDGE_WR_DATA_0;
 
 	for (i = 0; i < len; i += 2) {
-		/*
-		 * Add sleep as SWR slave write takes time.
-		 * Allow for any previous pending write to complete.
-		 */
-		usleep_range(100, 105);
-		/* First Write the Data to register */
-		ret = regmap_bulk_write(msm_sdw->regmap,
-			sdw_wr_data_base, bulk_reg[i].buf, 4);
-		if (ret < 0) {
-			dev_err(msm_sdw->dev, "%s: WR Data Failure\n",
-				__func__);
-			break;
-		}
-		/* Next Write Address */
+		msm_sdw_bridge_wait(msm_sdw);
+		/* Data first, the Address write starts the SWR transfer */
+		memcpy(buf, bulk_reg[i].buf, 4);
+		memcpy(buf + 4, bulk_reg[i+1].buf, 4);
 		ret = regmap_bulk_write(msm_sdw->regmap,
-			sdw_wr_addr_base, bulk_reg[i+1].buf, 4);
+			sdw_wr_data_base, buf, sizeof(buf));
+		msm_sdw->sdw_wr_time = ktime_get();
 		if (ret < 0) {
 			dev_err(msm_sdw->dev,
-				"%s: WR Addr Failure: 0x%x\n",
+				"%s: WR Failure: 0x%x\n",
 				__func__, (u32)(bulk_reg[i+1].buf[0]));
 			break;
 		}
@@ -1746,6 +1754,7 @@ static int msm_sdw_notifier_service_cb(struct notifier_block *nb,
 	bool adsp_ready = false;
 	unsigned long timeout;
 	static bool initial_boot = true;
+	ktime_t start;
 
 	pr_debug("%s: Service opcode 0x%lx\n", __func__, opcode);
 
@@ -1786,12 +1795,15 @@ static int msm_sdw_notifier_service_cb(struct notifier_block *nb,
 		}
 powerup:
 		if (adsp_ready) {
+			start = ktime_get();
 			msm_sdw->dev_up = true;
 			msm_sdw_init_reg(msm_sdw->codec);
 			regcache_mark_dirty(msm_sdw->regmap);
 			regcache_sync(msm_sdw->regmap);
 			msm_sdw_set_spkr_mode(msm_sdw->codec,
 					      msm_sdw->spkr_mode);
+			dev_info(msm_sdw->dev, "%s: codec restored in %lld us\n",
+				 __func__, ktime_us_delta(ktime_get(), start));
 		}
 		break;
 	default:
@@ -127,7 +127,7 @@ static int regmap_bus_gather_write(void *context,
 	struct device *dev = context;
 	struct msm_sdw_priv *msm_sdw = dev_get_drvdata(dev);
 	unsigned short c_reg;
-	int ret, i;
+	int ret, i, n;
 
 	if (!msm_sdw) {
 		dev_err(dev, "%s: msm_sdw is NULL\n", __func__);
@@ -148,21 +148,36 @@ static int regmap_bus_gather_write(void *context,
 		return 0;
 	}
 
-	mutex_lock(&msm_sdw->io_lock);
-	c_reg = *(u16 *)reg;
-	ret = msm_sdw_page_write(msm_sdw, c_reg);
-	if (ret)
-		goto err;
-
 	for (i = 0; i < val_size; i++)
 		dev_dbg(dev, "Write %02x to 0x%x\n", ((u8 *)val)[i],
-			c_reg + i*4);
+			*(u16 *)reg + i*4);
 
-	ret = msm_sdw->write_dev(msm_sdw, c_reg, val_size, (void *) val);
-	if (ret < 0)
-		dev_err(dev,
-			"%s: Codec write failed (%d), reg:0x%x, size:%zd\n",
-			__func__, ret, c_reg, val_size);
+	mutex_lock(&msm_sdw->io_lock);
+	/*
+	 * regcache_sync() hands over whole blocks of contiguous registers,
+	 * split them where the page changes.
+	 */
+	for (c_reg = *(u16 *)reg, i = 0; i < val_size; i += n) {
+		for (n = 1; i + n < val_size; n++)
+			if (c_reg + n * 4 >= MSM_SDW_MAX_REGISTER ||
+			    msm_sdw_page_map[c_reg + n * 4] !=
+			    msm_sdw_page_map[c_reg])
+				break;
+
+		ret = msm_sdw_page_write(msm_sdw, c_reg);
+		if (ret)
+			goto err;
+
+		ret = msm_sdw->write_dev(msm_sdw, c_reg, n,
+					 (u8 *)val + i);
+		if (ret < 0) {
+			dev_err(dev,
+				"%s: Codec write failed (%d), reg:0x%x, size:%d\n",
+				__func__, ret, c_reg, n);
+			goto err;
+		}
+		c_reg += n * 4;
+	}
 
 err:
 	mutex_unlock(&msm_sdw->io_lock);
@@ -135,7 +135,6 @@ struct apr_svc {
 	apr_fn fn;
 	void *priv;
 	struct mutex m_lock;
-	spinlock_t w_lock;
 	uint8_t pkt_owner;
 };
 
@@ -146,6 +145,8 @@ struct apr_client {
 	struct mutex m_lock;
 	struct apr_svc_ch_dev *handle;
 	struct apr_svc svc[APR_SVC_MAX];
+	/* registered services indexed by service id, for the RX path */
+	struct apr_svc __rcu *svc_map[APR_SVC_MAX];
 };
 
 struct apr_rx_intents {
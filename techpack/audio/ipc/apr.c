@@ -27,6 +27,9 @@
 #include <linux/device.h>
 #include <linux/of.h>
 #include <linux/slab.h>
+#include <linux/rcupdate.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
 #include <linux/ipc_logging.h>
 #include <linux/of_platform.h>
 #include <soc/qcom/subsystem_restart.h>
@@ -69,6 +72,34 @@ struct apr_private {
 static struct apr_private *apr_priv;
 static bool apr_cf_debug;
 
+/*
+ * Round trip latency of sequenced commands, from apr_send_pkt() to the
+ * APR_BASIC_RSP_RESULT carrying the same opcode and token. The last
+ * APR_LAT_PENDING commands are remembered per service, older ones are
+ * dropped uncounted. Bucket i counts [2^(i-1), 2^i) us.
+ */
+#define APR_LAT_PENDING	8
+#define APR_LAT_BUCKETS	16
+
+struct apr_lat_pending {
+	uint32_t opcode;
+	uint32_t token;
+	ktime_t ts;
+};
+
+struct apr_lat_svc {
+	struct apr_lat_pending pending[APR_LAT_PENDING];
+	unsigned int next;
+	uint32_t bucket[APR_LAT_BUCKETS];
+	uint64_t count;
+	uint64_t total_us;
+	uint64_t max_us;
+};
+
+static bool apr_lat_enable;
+static DEFINE_SPINLOCK(apr_lat_lock);
+static struct apr_lat_svc apr_lat[APR_DEST_MAX][APR_SVC_MAX];
+
 #ifdef CONFIG_DEBUG_FS
 static struct dentry *debugfs_apr_debug;
 static ssize_t apr_debug_write(struct file *filp, const char __user *ubuf,
@@ -87,6 +118,69 @@ static ssize_t apr_debug_write(struct file *filp, const char __user *ubuf,
 static const struct file_operations apr_debug_ops = {
 	.write = apr_debug_write,
 };
+
+static struct dentry *debugfs_apr_latency;
+
+static int apr_latency_show(struct seq_file *m, void *v)
+{
+	struct apr_lat_svc *lat;
+	unsigned long flags;
+	int i, j, k;
+
+	seq_printf(m, "enabled: %d\n", READ_ONCE(apr_lat_enable));
+
+	spin_lock_irqsave(&apr_lat_lock, flags);
+	for (i = 0; i < APR_DEST_MAX; i++) {
+		for (j = 0; j < APR_SVC_MAX; j++) {
+			lat = &apr_lat[i][j];
+			if (!lat->count)
+				continue;
+			seq_printf(m, "dest %d svc 0x%x: count %llu avg %llu max %llu us:",
+				   i, j, lat->count,
+				   div64_u64(lat->total_us, lat->count),
+				   lat->max_us);
+			for (k = 0; k < APR_LAT_BUCKETS; k++)
+				seq_printf(m, " %u", lat->bucket[k]);
+			seq_putc(m, '\n');
+		}
+	}
+	spin_unlock_irqrestore(&apr_lat_lock, flags);
+
+	return 0;
+}
+
+static int apr_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, apr_latency_show, inode->i_private);
+}
+
+/* '1' clears the histograms and starts measuring, '0' stops */
+static ssize_t apr_latency_write(struct file *filp, const char __user *ubuf,
+				 size_t cnt, loff_t *ppos)
+{
+	unsigned long flags;
+	char cmd;
+
+	if (copy_from_user(&cmd, ubuf, 1))
+		return -EFAULT;
+
+	if (cmd == '1') {
+		spin_lock_irqsave(&apr_lat_lock, flags);
+		memset(apr_lat, 0, sizeof(apr_lat));
+		spin_unlock_irqrestore(&apr_lat_lock, flags);
+	}
+	WRITE_ONCE(apr_lat_enable, cmd == '1');
+
+	return cnt;
+}
+
+static const struct file_operations apr_latency_ops = {
+	.open = apr_latency_open,
+	.read = seq_read,
+	.write = apr_latency_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
 #endif
 
 #define APR_PKT_INFO(x...) \
@@ -350,6 +444,55 @@ struct apr_client *apr_get_client(int dest_id, int client_id)
 	return &client[dest_id][client_id];
 }
 
+static void apr_lat_tx(struct apr_svc *svc, struct apr_hdr *hdr)
+{
+	struct apr_lat_svc *lat = &apr_lat[svc->dest_id][svc->id];
+	struct apr_lat_pending *p;
+	unsigned long flags;
+
+	if (((hdr->hdr_field >> 0x08) & 0x0003) != APR_MSG_TYPE_SEQ_CMD)
+		return;
+
+	spin_lock_irqsave(&apr_lat_lock, flags);
+	p = &lat->pending[lat->next];
+	lat->next = (lat->next + 1) % APR_LAT_PENDING;
+	p->opcode = hdr->opcode;
+	p->token = hdr->token;
+	p->ts = ktime_get();
+	spin_unlock_irqrestore(&apr_lat_lock, flags);
+}
+
+static void apr_lat_rx(uint16_t src, uint16_t svc, struct apr_hdr *hdr,
+		       struct apr_client_data *data)
+{
+	struct apr_lat_svc *lat = &apr_lat[src][svc];
+	struct apr_lat_pending *p;
+	unsigned long flags;
+	uint64_t us;
+	int i;
+
+	if (hdr->opcode != APR_BASIC_RSP_RESULT || data->payload_size < 4)
+		return;
+
+	spin_lock_irqsave(&apr_lat_lock, flags);
+	for (i = 0; i < APR_LAT_PENDING; i++) {
+		p = &lat->pending[i];
+		if (!ktime_to_ns(p->ts) || p->token != hdr->token ||
+		    p->opcode != *(uint32_t *)data->payload)
+			continue;
+
+		us = ktime_us_delta(ktime_get(), p->ts);
+		p->ts = 0;
+		lat->bucket[min_t(int, fls64(us), APR_LAT_BUCKETS - 1)]++;
+		lat->count++;
+		lat->total_us += us;
+		if (us > lat->max_us)
+			lat->max_us = us;
+		break;
+	}
+	spin_unlock_irqrestore(&apr_lat_lock, flags);
+}
+
 /**
  * apr_send_pkt - Clients call to send packet
  * to destination processor.
@@ -357,18 +500,20 @@ struct apr_client *apr_get_client(int dest_id, int client_id)
  * @handle: APR service handle
  * @buf: payload to send to destination processor.
  *
+ * Packets are sent without waiting for a response, the transport
+ * serializes writes to the channel, so no service lock is taken here.
+ *
  * Returns Bytes(>0)pkt_size on success or error on failure.
  */
 int apr_send_pkt(void *handle, uint32_t *buf)
 {
 	struct apr_svc *svc = handle;
-	struct apr_client *clnt;
+	struct apr_svc_ch_dev *ch;
 	struct apr_hdr *hdr;
 	uint16_t dest_id;
 	uint16_t client_id;
 	uint16_t w_len;
 	int rc;
-	unsigned long flags;
 
 	if (!handle || !buf) {
 		pr_err("APR: Wrong parameters\n");
@@ -389,14 +534,12 @@ int apr_send_pkt(void *handle, uint32_t *buf)
 		return -ENETRESET;
 	}
 
-	spin_lock_irqsave(&svc->w_lock, flags);
 	dest_id = svc->dest_id;
 	client_id = svc->client_id;
-	clnt = &client[dest_id][client_id];
+	ch = READ_ONCE(client[dest_id][client_id].handle);
 
-	if (!client[dest_id][client_id].handle) {
+	if (!ch) {
 		pr_err_ratelimited("APR: Still service is not yet opened\n");
-		spin_unlock_irqrestore(&svc->w_lock, flags);
 		return -EINVAL;
 	}
 	hdr = (struct apr_hdr *)buf;
@@ -414,7 +557,10 @@ int apr_send_pkt(void *handle, uint32_t *buf)
 		hdr->token);
 	}
 
-	rc = apr_tal_write(clnt->handle, buf,
+	if (unlikely(READ_ONCE(apr_lat_enable)))
+		apr_lat_tx(svc, hdr);
+
+	rc = apr_tal_write(ch, buf,
 			(struct apr_pkt_priv *)&svc->pkt_owner,
 			hdr->pkt_size);
 	if (rc >= 0) {
@@ -434,7 +580,6 @@ int apr_send_pkt(void *handle, uint32_t *buf)
 			rc = -ENETRESET;
 		}
 	}
-	spin_unlock_irqrestore(&svc->w_lock, flags);
 
 	return rc;
 }
@@ -569,6 +714,7 @@ struct apr_svc *apr_register(char *dest, char *svc_name, apr_fn svc_fn,
 	svc->client_id = client_id;
 	svc->dest_domain = domain_id;
 	svc->pkt_owner = APR_PKT_OWNER_DRIVER;
+	rcu_assign_pointer(clnt->svc_map[svc_id], svc);
 
 	if (src_port != 0xFFFFFFFF) {
 		temp_port = ((src_port >> 8) * 8) + (src_port & 0xFF);
@@ -706,18 +852,18 @@ void apr_cb_func(void *buf, int len, void *priv)
 
 	pr_debug("src =%d clnt = %d\n", src, clnt);
 	apr_client = &client[src][clnt];
-	for (i = 0; i < APR_SVC_MAX; i++)
-		if (apr_client->svc[i].id == svc) {
-			pr_debug("%d\n", apr_client->svc[i].id);
-			c_svc = &apr_client->svc[i];
-			break;
-		}
-
-	if (i == APR_SVC_MAX) {
+	/*
+	 * The services are static, the read side only orders against
+	 * apr_register() filling in the service before publishing it.
+	 */
+	rcu_read_lock();
+	c_svc = rcu_dereference(apr_client->svc_map[svc]);
+	rcu_read_unlock();
+
+	if (!c_svc) {
 		pr_err("APR: service is not registered\n");
 		return;
 	}
-	pr_debug("svc_idx = %d\n", i);
 	pr_debug("%x %x %x %pK %pK\n", c_svc->id, c_svc->dest_id,
 		 c_svc->client_id, c_svc->fn, c_svc->priv);
 	data.payload_size = hdr->pkt_size - hdr_size;
@@ -731,6 +877,9 @@ void apr_cb_func(void *buf, int len, void *priv)
 	if (data.payload_size > 0)
 		data.payload = (char *)hdr + hdr_size;
 
+	if (unlikely(READ_ONCE(apr_lat_enable)))
+		apr_lat_rx(src, svc, hdr, &data);
+
 	if (unlikely(apr_cf_debug)) {
 		if (hdr->opcode == APR_BASIC_RSP_RESULT && data.payload) {
 			uint32_t *ptr = data.payload;
@@ -949,6 +1098,8 @@ int apr_deregister(void *handle)
 	}
 
 	if (!svc->svc_cnt) {
+		if (rcu_access_pointer(clnt->svc_map[svc->id]) == svc)
+			RCU_INIT_POINTER(clnt->svc_map[svc->id], NULL);
 		svc->priv = NULL;
 		svc->id = 0;
 		svc->fn = NULL;
@@ -1120,6 +1271,9 @@ static int __init apr_debug_init(void)
 	debugfs_apr_debug = debugfs_create_file("msm_apr_debug",
 						 S_IFREG | 0444, NULL, NULL,
 						 &apr_debug_ops);
+	debugfs_apr_latency = debugfs_create_file("msm_apr_latency",
+						 S_IFREG | 0644, NULL, NULL,
+						 &apr_latency_ops);
 	return 0;
 }
 #else
@@ -1149,6 +1303,7 @@ static void apr_cleanup(void)
 	}
 #ifdef CONFIG_DEBUG_FS
 	debugfs_remove(debugfs_apr_debug);
+	debugfs_remove(debugfs_apr_latency);
 #endif
 }
 
@@ -1171,7 +1326,6 @@ static int apr_probe(struct platform_device *pdev)
 			mutex_init(&client[i][j].m_lock);
 			for (k = 0; k < APR_SVC_MAX; k++) {
 				mutex_init(&client[i][j].svc[k].m_lock);
-				spin_lock_init(&client[i][j].svc[k].w_lock);
 			}
 		}
 	apr_set_subsys_state();
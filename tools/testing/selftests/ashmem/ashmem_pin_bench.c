@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Pin/unpin throughput of an ashmem area holding many unpinned ranges.
+ *
+ * Every other page of the area is unpinned first, so the area tracks
+ * nr_pages / 2 separate ranges. Then random pages are pinned and
+ * unpinned again and the rate is reported.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ashmem.h"
+
+/* Kselftest framework requirement - SKIP code is 4. */
+#define KSFT_SKIP	4
+
+static int pin_ioctl(int fd, unsigned int cmd, unsigned long page,
+		     unsigned long page_size)
+{
+	struct ashmem_pin pin = {
+		.offset = page * page_size,
+		.len = page_size,
+	};
+
+	return ioctl(fd, cmd, &pin);
+}
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long page_size = sysconf(_SC_PAGESIZE);
+	unsigned long nr_pages = argc > 1 ? strtoul(argv[1], NULL, 0) : 16384;
+	unsigned long iters = argc > 2 ? strtoul(argv[2], NULL, 0) : 100000;
+	unsigned long i, page;
+	double start, elapsed;
+	void *map;
+	int fd;
+
+	fd = open("/dev/ashmem", O_RDWR);
+	if (fd < 0) {
+		printf("/dev/ashmem not available, skipping\n");
+		return KSFT_SKIP;
+	}
+
+	if (ioctl(fd, ASHMEM_SET_SIZE, nr_pages * page_size) < 0) {
+		perror("ASHMEM_SET_SIZE");
+		return 1;
+	}
+
+	map = mmap(NULL, nr_pages * page_size, PROT_READ | PROT_WRITE,
+		   MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+	memset(map, 0xa5, nr_pages * page_size);
+
+	start = now_sec();
+	for (page = 0; page < nr_pages; page += 2) {
+		if (pin_ioctl(fd, ASHMEM_UNPIN, page, page_size) < 0) {
+			perror("ASHMEM_UNPIN");
+			return 1;
+		}
+	}
+	elapsed = now_sec() - start;
+	printf("unpin %lu ranges: %.0f ops/s\n", nr_pages / 2,
+	       (nr_pages / 2) / elapsed);
+
+	srand(1);
+	start = now_sec();
+	for (i = 0; i < iters; i++) {
+		page = (rand() % (nr_pages / 2)) * 2;
+		if (pin_ioctl(fd, ASHMEM_PIN, page, page_size) < 0 ||
+		    pin_ioctl(fd, ASHMEM_UNPIN, page, page_size) < 0) {
+			perror("ASHMEM_PIN/UNPIN");
+			return 1;
+		}
+	}
+	elapsed = now_sec() - start;
+	printf("pin+unpin with %lu ranges: %.0f ops/s, %.0f ns/op\n",
+	       nr_pages / 2, 2 * iters / elapsed, elapsed * 1e9 / (2 * iters));
+
+	start = now_sec();
+	for (i = 0; i < iters; i++) {
+		page = rand() % nr_pages;
+		if (pin_ioctl(fd, ASHMEM_GET_PIN_STATUS, page, page_size) < 0) {
+			perror("ASHMEM_GET_PIN_STATUS");
+			return 1;
+		}
+	}
+	elapsed = now_sec() - start;
+	printf("pin status with %lu ranges: %.0f ops/s\n", nr_pages / 2,
+	       iters / elapsed);
+
+	munmap(map, nr_pages * page_size);
+	close(fd);
+	return 0;
+}